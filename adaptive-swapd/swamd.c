@@ -2,6 +2,7 @@
  * swamd - dynamically add and remove swap-format files
  */ 
 
+# define _GNU_SOURCE		/* fallocate */
 # include <stdio.h>
 # include <string.h>
 # include <syslog.h>
@@ -11,17 +12,60 @@
 # include <getopt.h>
 # include <signal.h>
 # include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
 # include <sys/stat.h>
 # include <sys/file.h>
 # include <sys/vfs.h>
 # include <sys/resource.h>
 # include <sys/swap.h>
+# include <sys/sysmacros.h>
+# include <sys/ioctl.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <sys/time.h>
+# include <dirent.h>
+# include <ctype.h>
 # include <sys/user.h>
 # include <sched.h>
+# include <pthread.h>
+# include <time.h>
+# include <linux/fs.h>
+# include <linux/fiemap.h>
 
 /* A header fie */
 # include "swamd.h"
 
+# ifndef SYS_pidfd_open
+#  define SYS_pidfd_open	434
+# endif
+# ifndef SYS_process_madvise
+#  define SYS_process_madvise	440
+# endif
+/* extents fetched by each FIEMAP call */
+# define FIEMAPNR	64
+
+# ifndef EXT4_IOC_MOVE_EXT
+struct move_extent {
+    __s32   reserved;		/* original file descriptor */
+    __u32   donor_fd;		/* donor file descriptor */
+    __u64   orig_start;		/* logical start offset in block for orig */
+    __u64   donor_start;	/* logical start offset in block for donor */
+    __u64   len;		/* block length to be moved */
+    __u64   moved_len;		/* moved block length */
+};
+#  define EXT4_IOC_MOVE_EXT	_IOWR ( 'f', 15, struct move_extent )
+# endif
+# ifndef MADV_COLD
+#  define MADV_COLD	20
+# endif
+# ifndef MADV_PAGEOUT
+#  define MADV_PAGEOUT	21
+# endif
+
 /* Data structure */
 int     priority  = PRIORITY;   /* -p */
 int     chunksz   = CHUNKSZ;    /* -s */
@@ -30,14 +74,134 @@ int     lower     = LOWER;      /* -l */
 int     upper     = UPPER;      /* -u */
 int     interval  = INTERVAL;   /* -i */
 char   *tmpdir    = TMPDIR;     /* -d */
+int     events    = 0;          /* -e */
+int     psistall  = PSISTALL;   /* -t */
+int     psiwindow = PSIWINDOW;  /* -w */
+char   *memcg     = NULL;       /* -c */
+int     predict   = 0;          /* -F */
+int     horizon   = HORIZON;    /* -H */
+int     hold      = HOLD;       /* -r */
+int     swapinlow = SWAPINLOW;  /* -q */
+int     staged    = 0;          /* -S */
+long    zramsz    = 0;          /* -z */
+char   *backdev   = NULL;       /* -b */
+char   *zramalgo  = NULL;       /* -a */
+char   *recompalgo = NULL;      /* -R */
+int     wbinterval = WBINTERVAL; /* -W */
+char   *hintpath  = NULL;       /* -A */
+char   *ctlpath   = NULL;       /* -C */
+int     minextent = MINEXTENT;  /* -x */
+int     swaplatmax = SWAPLATMAX; /* -L */
 
 int	debug	= 0;		/* -D */
 
 char  **swamfile;		/* the names of swam files created */
+int    *swamsize;		/* the sizes of swam files created */
 int     chunks	= 0;		/* number of swam files currently alloc'ed */
 
-int     addswap ( int );
+char   *swamdirs [ MAXDIRS ];	/* the directories of -d, fastest first */
+double  dirrate [ MAXDIRS ];	/* their write throughput in bytes a second */
+int     ndirs	= 0;		/* number of directories */
+int     namelen	= 0;		/* longest swam file name, with the nul */
+
+int     poolsz    = POOLSZ;     /* -P */
+char  **poolfile  = NULL;	/* swam files ready to swapon */
+int     pooled	= 0;		/* number of swam files in the pool */
+pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  poolcond = PTHREAD_COND_INITIALIZER;
+
+/* /proc/vmstat counters used by the predictive controller */
+enum { VM_PSWPIN, VM_PSWPOUT, VM_PGMAJFAULT, VM_NR };
+
+/* the state of a swam file with staged removal */
+enum { SWAM_ACTIVE, SWAM_DRAINING };
+
+int    *swamstate;		/* the states of swam files created */
+char   *retired;		/* the swam file being swapped off */
+double  drainstart;		/* when the newest swam file started draining */
+int     drained   = 0;		/* bytes of swap removed by the drain worker */
+pthread_mutex_t drainlock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  draincond = PTHREAD_COND_INITIALIZER;
+
+/* the swap tiers, fastest first */
+enum { TIER_ZRAM, TIER_FILE, TIER_NR };
+
+struct tierstat {
+    unsigned long size;		/* bytes of swap in the tier */
+    unsigned long used;		/* bytes swapped out to the tier */
+    unsigned long stored;	/* bytes of memory or disk they take */
+    unsigned long reads;	/* block device reads */
+    unsigned long readms;	/* milliseconds spent reading */
+    unsigned long writes;	/* block device writes */
+    unsigned long writems;	/* milliseconds spent writing */
+    unsigned long backed;	/* zram pages written back */
+};
+
+struct tierstat tiers [ TIER_NR ];
+int     zramid    = -1;		/* zram device number of the zram tier */
+int     zramadded = 0;		/* zram device was hot added */
+
+double  swaplatms  = 0;		/* mean I/O latency of the swam file devices */
+double  faultlatms = 0;		/* mean memory stall of a major fault */
+double  swapinrate = 0;		/* swap ins a second */
+int     slowswap  = 0;		/* swap I/O latency is over -L */
+int     holdswap  = 0;		/* new swam files are held off */
+unsigned long holdoffs = 0;	/* swam files held off as swap was slow */
+
+/* the state of an app in the background */
+enum { APP_BACKGROUND, APP_COLD, APP_PAGEDOUT };
+
+struct app {
+    pid_t   pid;		/* 0 for a free slot */
+    int     state;
+    double  since;		/* when it went to the background */
+};
+
+struct app apps [ MAXAPPS ];
+long    reclaims  = 0;		/* apps paged out */
+long    reclaimed = 0;		/* bytes of apps paged out */
+int     psifd     = -1;		/* memory pressure trigger */
+int     memcgfd   = -1;		/* cgroup memory.events */
+int     hintfd    = -1;		/* app hint FIFO */
+int     ctlfd     = -1;		/* control socket */
+
+double  started;		/* when the daemon started */
+unsigned long adds = 0;		/* swam files added */
+unsigned long addfailures = 0;	/* swam files that could not be added */
+unsigned long removes = 0;	/* swam files removed */
+unsigned long addhist [ HISTNR ];	/* add latency histogram */
+unsigned long removehist [ HISTNR ];	/* swapoff latency histogram */
+
+int     ctlopen ( char * );
+void    ctlaccept ( int );
+void    histadd ( unsigned long [ HISTNR ], double );
+long    getswap ();
+int     suffix ( char ** );
+void    dirsplit ( char *, char * );
+void    dirrank ();
+void	usage ( char *, char * );
+void    getvmstat ( long [ VM_NR ] );
+
+int     hintopen ( char * );
+void    hintread ( int );
+void    appreclaim ( int );
+int     sysread ( char *, char *, int );
+int     zramstart ();
+void    zramstop ( int );
+void    tierupdate ();
+void    swaplat ( long );
+double  tiermean ( unsigned long, unsigned long );
+void   *tierthread ( void * );
+long    swapused ( char * );
+int     addswap ( int, int );
 int     delswap ( int );
+int     removeswam ( char * );
+int     growswap ( int );
+int     shrinkswap ();
+void   *drainthread ( void * );
+double  now ();
+void    poolcleanup ();
+void   *poolthread ( void * );
 
 /*
  * Check the parameters (either given or compiled in) for sense.
@@ -46,15 +210,31 @@ void	ckconf ( char *argv0 )
 {
     struct stat st;
     char *msg = NULL;
+    int i;
 
-    if ( lstat ( tmpdir, &st ) < 0 || ! S_ISDIR ( st.st_mode ) )
-	msg = "tmpdir is not a directory";
-    else if ( chunksz < 2 * PAGE_SIZE )
+    if ( chunksz < 2 * PAGE_SIZE )
 	msg = "size too small for swamfile";
-    else if ( chunksz > ( PAGE_SIZE - 10 ) * 8 * PAGE_SIZE )
-	msg = "size too large for swamfile (strange, but true)";
+    else if ( predict && (long) chunksz * GROWTH > 0x7fffffffL )
+	msg = "size too large to grow for predictive swam files";
+    else if ( zramsz && zramsz < 2 * PAGE_SIZE )
+	msg = "size too small for zram";
+    else if ( zramsz && ZRAMPRIO <= SWAMPRIO )
+	msg = "zram priority must be above the swam file priorities";
+    else if ( poolsz < 0 || poolsz > numchunks )
+	msg = "swam file pool is larger than the maximum number of swam files";
+    else if ( minextent < 0 )
+	msg = "smallest extent size must not be negative";
     else if ( upper < lower )
 	msg = "lower limit is smaller than upper limit";
+    else if ( psiwindow < 500 || psiwindow > 10000 )
+	msg = "pressure window must be 500 to 10000 milliseconds";
+    else if ( psistall <= 0 || psistall > psiwindow )
+	msg = "pressure stall must be within the pressure window";
+    else if ( memcg && ( lstat ( memcg, &st ) < 0 || ! S_ISDIR ( st.st_mode ) ) )
+	msg = "memory cgroup is not a directory";
+    for ( i = 0; ! msg && i < ndirs; i++ )
+	if ( lstat ( swamdirs[i], &st ) < 0 || ! S_ISDIR ( st.st_mode ) )
+	    msg = "tmpdir is not a directory";
 
     if ( msg ) {
 	fprintf ( stderr, "%s: %s\n", argv0, msg );
@@ -70,6 +250,12 @@ void	cleanup ()
     while ( chunks ) {
         delswap ( --chunks );
     }
+    if ( retired && *retired )
+	(void) removeswam ( retired );
+    poolcleanup ();
+    zramstop ( 1 );
+    if ( ctlfd >= 0 )
+	(void) unlink ( ctlpath );
 }
 
 /*
@@ -91,7 +277,11 @@ void	usage ( char *argv0, char *str )
     if ( str && *str )
 	(void) fprintf ( stderr, "%s: %s\n", argv0, str );
     (void) fprintf ( stderr, "usage: %s "
-	    "[-p prio] [-d dir] [-i interval] [-n num] [-s size] [-l lower] [-u upper]\n",
+	    "[-p prio] [-d dir[:dir...]] [-i interval] [-n num] [-s size] [-l lower] [-u upper]\n"
+	    "\t[-e] [-t stall] [-w window] [-c cgroup] [-P pool]\n"
+	    "\t[-F] [-H horizon] [-r hold] [-q swapins] [-S]\n"
+	    "\t[-z size] [-a algo] [-b backing] [-R algo] [-W interval] [-A hints]\n"
+	    "\t[-C socket] [-x extent] [-L latency]\n",
 	    argv0 );
     exit ( 1 );
 }
@@ -103,12 +293,32 @@ void	help ( char *argv0 )
 {
     (void) fprintf ( stderr, "%s: dynamically maintain swap-style swam files\n"
 	    "\t-p\tpriority to run at\n"
-	    "\t-d\tdirectory to create swam files in\n"
+	    "\t-d\tdirectories to create swam files in, ranked by throughput\n"
 	    "\t-i\tinterval to check system\n"
 	    "\t-s\tsize of each swam file\n"
 	    "\t-l\tlower limit for spare VM (trigger to add swam)\n"
 	    "\t-u\tupper limit for spare VM (trigger to remove swam)\n"
-	    "\t-n\tmaximum number of swam files to create\n", argv0 );
+	    "\t-n\tmaximum number of swam files to create\n"
+	    "\t-e\twait on memory pressure events instead of polling\n"
+	    "\t-t\tmemory stall in milliseconds per window that is an event\n"
+	    "\t-w\twindow in milliseconds the memory stall is measured over\n"
+	    "\t-c\tmemory cgroup directory whose memory.events are watched\n"
+	    "\t-P\tnumber of swam files to keep prepared in advance\n"
+	    "\t-F\tforecast demand and provision swam files ahead of it\n"
+	    "\t-H\tseconds ahead to forecast the spare VM\n"
+	    "\t-r\tseconds of steady or rising spare VM before removing swam\n"
+	    "\t-q\tswap ins per second below which swam may be removed\n"
+	    "\t-S\tlet swam files drain before swapping them off\n"
+	    "\t-z\tsize of a zram device to use as the first swap tier\n"
+	    "\t-a\tcompression algorithm of the zram device\n"
+	    "\t-b\tblock device idle zram pages are written back to\n"
+	    "\t-R\talgorithm idle zram pages are recompressed with\n"
+	    "\t-W\tinterval between zram recompression and writeback passes\n"
+	    "\t-A\tFIFO to read app background and foreground hints from\n"
+	    "\t-C\tunix socket to serve metrics and take settings on\n"
+	    "\t-x\tsmallest mean extent of a swam file that is not defragmented\n"
+	    "\t-L\tswap I/O latency in milliseconds above which no swam file is added\n",
+	    argv0 );
 }
 
 /*
@@ -135,19 +345,325 @@ int suffix ( char **str )
     return mult;
 }
 
+/*
+ * Split the colon separated list of directories given with -d.
+ */
+void    dirsplit ( char *argv0, char *list )
+{
+    char   *dir;
+
+    if ( ( list = strdup ( list ) ) == NULL ) {
+	(void) fprintf ( stderr, "%s: malloc failed\n", argv0 );
+	exit ( 1 );
+    }
+    for ( dir = strtok ( list, ":" ); dir; dir = strtok ( NULL, ":" ) ) {
+	if ( ndirs >= MAXDIRS )
+	    usage ( argv0, "too many directories for swam files" );
+	swamdirs[ndirs++] = dir;
+	if ( strlen ( dir ) + sizeof ( SUFFIX ) > namelen )
+	    namelen = strlen ( dir ) + sizeof ( SUFFIX );
+    }
+    if ( ! ndirs )
+	usage ( argv0, "no directory for swam files" );
+}
+
+/*
+ * Measure how fast each directory takes writes and sort them fastest first,
+ * so that swam files go on the fastest storage with room for them.
+ */
+void    dirrank ()
+{
+    int     iosz = PROBESZ < 1024 * 1024 ? PROBESZ : 1024 * 1024;
+    char   *buf = memalign ( PAGE_SIZE, iosz );
+    char   *name = malloc ( namelen );
+    int     i, j;
+
+    if ( ndirs < 2 || buf == NULL || name == NULL ) {
+	free ( buf );
+	free ( name );
+	return;
+    }
+    for ( i = 0; i < iosz; i++ )
+	buf[i] = random ();
+
+    for ( i = 0; i < ndirs; i++ ) {
+	double  t;
+	long    done = 0;
+	int     fd;
+
+	dirrate[i] = 0;
+	/* bypass the page cache where the file system lets us */
+	strcpy ( name, swamdirs[i] );
+	strcat ( name, SUFFIX );
+	if ( ( fd = mkostemp ( name, O_DIRECT ) ) < 0 ) {
+	    strcpy ( name, swamdirs[i] );
+	    strcat ( name, SUFFIX );
+	    fd = mkstemp ( name );
+	}
+	if ( fd < 0 ) {
+	    syslog ( LOG_WARNING, "can't measure \"%s\": %m", swamdirs[i] );
+	    continue;
+	}
+	t = now ();
+	while ( done < PROBESZ && write ( fd, buf, iosz ) == iosz )
+	    done += iosz;
+	if ( done >= PROBESZ && fdatasync ( fd ) == 0 )
+	    dirrate[i] = done / ( now () - t + 1e-6 );
+	(void) close ( fd );
+	(void) unlink ( name );
+	syslog ( LOG_INFO, "\"%s\" takes writes at %.1f MB/s", swamdirs[i],
+		dirrate[i] / ( 1024 * 1024 ) );
+    }
+
+    for ( i = 1; i < ndirs; i++ ) {
+	char   *dir = swamdirs[i];
+	double  rate = dirrate[i];
+
+	for ( j = i; j > 0 && dirrate[j-1] < rate; j-- ) {
+	    swamdirs[j] = swamdirs[j-1];
+	    dirrate[j] = dirrate[j-1];
+	}
+	swamdirs[j] = dir;
+	dirrate[j] = rate;
+    }
+    free ( buf );
+    free ( name );
+}
+
+/*
+ * Open the memory pressure stall information and register a trigger on it,
+ * so that poll() wakes us when tasks stall for psistall milliseconds within
+ * any psiwindow milliseconds.  Returns the fd or -1 if PSI is not available.
+ */
+int     psiopen ()
+{
+    char    trigger [ 64 ];
+    int     fd, n;
+
+    if ( ( fd = open ( PSIFILE, O_RDWR | O_NONBLOCK ) ) < 0 ) {
+	syslog ( LOG_WARNING, "can't open \"%s\": %m", PSIFILE );
+	return -1;
+    }
+    (void) snprintf ( trigger, sizeof(trigger), "some %d %d",
+	    psistall * 1000, psiwindow * 1000 );
+    n = write ( fd, trigger, strlen ( trigger ) + 1 );
+    /*
+     * Without CAP_SYS_RESOURCE in the initial namespace the window must be a
+     * multiple of 2 seconds; stretch it and the stall in proportion.
+     */
+    if ( n < 0 && errno == EINVAL && psiwindow % 2000 ) {
+	int window = ( psiwindow / 2000 + 1 ) * 2000;
+
+	(void) snprintf ( trigger, sizeof(trigger), "some %ld %d",
+		(long) psistall * window / psiwindow * 1000, window * 1000 );
+	syslog ( LOG_WARNING, "unprivileged pressure trigger, window is now %d ms",
+		window );
+	n = write ( fd, trigger, strlen ( trigger ) + 1 );
+    }
+    if ( n < 0 ) {
+	syslog ( LOG_WARNING, "can't set trigger \"%s\" on \"%s\": %m",
+		trigger, PSIFILE );
+	(void) close ( fd );
+	return -1;
+    }
+    syslog ( LOG_DEBUG, "memory pressure trigger \"%s\"", trigger );
+    return fd;
+}
+
+/*
+ * Read the memory.events of a cgroup.  The kernel notifies every poller of
+ * the file when one of its counters changes; reading it re-arms that.
+ */
+void    memcgread ( int fd )
+{
+    char    buffer [ 256 ];
+
+    if ( lseek ( fd, 0, SEEK_SET ) == EOF )
+	return;
+    while ( read ( fd, buffer, sizeof(buffer) ) > 0 )
+	;
+}
+
+/*
+ * Open the memory.events of the cgroup to watch.  Returns the fd or -1.
+ */
+int     memcgopen ( char *dir )
+{
+    char    path [ 4096 ];
+    int     fd;
+
+    (void) snprintf ( path, sizeof(path), "%s/memory.events", dir );
+    if ( ( fd = open ( path, O_RDONLY | O_NONBLOCK ) ) < 0 ) {
+	syslog ( LOG_WARNING, "can't open \"%s\": %m", path );
+	return -1;
+    }
+    memcgread ( fd );
+    return fd;
+}
+
+/*
+ * Sleep until a memory pressure event or for timeout seconds.
+ * Returns 1 if there was an event.  A PSI trigger that reports an error has
+ * gone away, so it is closed and the caller falls back to its timeout.
+ * App hints are read as they come, but are not memory pressure.
+ */
+int     waitevent ( struct pollfd *pfd, int *npfd, int timeout )
+{
+    int     i, n, event = 0;
+
+    n = poll ( pfd, *npfd, timeout * 1000 );
+    if ( n < 0 ) {
+	if ( errno != EINTR )
+	    syslog ( LOG_ERR, "poll failed: %m" );
+	return 0;
+    }
+    for ( i = 0; n > 0 && i < *npfd; i++ ) {
+	if ( ! pfd[i].revents )
+	    continue;
+	if ( pfd[i].fd == hintfd ) {
+	    hintread ( hintfd );
+	    continue;
+	}
+	if ( pfd[i].fd == ctlfd ) {
+	    ctlaccept ( ctlfd );
+	    continue;
+	}
+	if ( pfd[i].fd == psifd && ( pfd[i].revents & POLLERR ) ) {
+	    syslog ( LOG_WARNING, "memory pressure trigger lost, falling back to polling" );
+	    (void) close ( psifd );
+	    psifd = -1;
+	    pfd[i] = pfd[--(*npfd)];
+	    i--;
+	    continue;
+	}
+	/* kernfs flags a changed memory.events with POLLPRI and POLLERR */
+	if ( pfd[i].fd == memcgfd )
+	    memcgread ( memcgfd );
+	event = 1;
+    }
+    return event;
+}
+
+/*
+ * Read the swap in/out and major fault counters from /proc/vmstat.
+ */
+void    getvmstat ( long vm [ VM_NR ] )
+{
+    static  char   *names [ VM_NR ] = { "pswpin ", "pswpout ", "pgmajfault " };
+    char    line [ 128 ];
+    FILE   *fp;
+    int     i;
+
+    for ( i = 0; i < VM_NR; i++ )
+	vm[i] = 0;
+    if ( ( fp = fopen ( "/proc/vmstat", "r" ) ) == NULL )
+	return;
+    while ( fgets ( line, sizeof(line), fp ) ) {
+	for ( i = 0; i < VM_NR; i++ ) {
+	    if ( strncmp ( line, names[i], strlen ( names[i] ) ) == 0 )
+		vm[i] = atol ( line + strlen ( names[i] ) );
+	}
+    }
+    (void) fclose ( fp );
+}
+
+/*
+ * Seconds since some fixed point, for rates.
+ */
+double  now ()
+{
+    struct  timespec ts;
+
+    (void) clock_gettime ( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * The predictive controller.
+ * Track the slope of the available VM and the swap in/out and major fault
+ * rates as moving averages, and add swam files ahead of demand, sized to
+ * cover the available VM forecast horizon seconds ahead.  A swam file is
+ * only removed once the available VM has not been falling and swap ins
+ * have been low for hold seconds, which stops the add/remove oscillation
+ * of the plain high and low water marks.
+ */
+void    forecast ( long swap )
+{
+    static  double  last = 0, stable, slope = 0;
+    static  double  rate [ VM_NR ];
+    static  long    prevswap, prevvm [ VM_NR ];
+    long    vm [ VM_NR ], predicted, need;
+    double  t = now (), dt;
+    int     i, size;
+
+    getvmstat ( vm );
+    /* swap the drain worker took away is not a change in demand */
+    prevswap -= drained;
+    drained = 0;
+    if ( last == 0 ) {
+	stable = t;
+	for ( i = 0; i < VM_NR; i++ )
+	    rate[i] = 0;
+    } else if ( ( dt = t - last ) > 0 ) {
+	slope = ALPHA * ( swap - prevswap ) / dt + ( 1 - ALPHA ) * slope;
+	for ( i = 0; i < VM_NR; i++ )
+	    rate[i] = ALPHA * ( vm[i] - prevvm[i] ) / dt + ( 1 - ALPHA ) * rate[i];
+    }
+    last = t;
+    prevswap = swap;
+    for ( i = 0; i < VM_NR; i++ )
+	prevvm[i] = vm[i];
+
+    predicted = swap + (long) ( slope * horizon );
+    syslog ( LOG_DEBUG, "forecast %ld available in %d seconds, %ld per second, "
+	    "%.0f swap ins %.0f swap outs %.0f major faults per second",
+	    predicted / 1024, horizon, (long) slope / 1024,
+	    rate[VM_PSWPIN], rate[VM_PSWPOUT], rate[VM_PGMAJFAULT] );
+
+    if ( ( predicted < lower || swap < lower ) && chunks < numchunks ) {
+	need = lower - ( predicted < swap ? predicted : swap );
+	if ( need < chunksz )
+	    size = chunksz;
+	else if ( need >= (long) chunksz * GROWTH )
+	    size = chunksz * GROWTH;
+	else
+	    size = ( need + chunksz - 1 ) / chunksz * chunksz;
+	/* the new swap is not a change in demand */
+	if ( ( size = growswap ( size ) ) > 0 )
+	    prevswap += size;
+	stable = t;
+	return;
+    }
+
+    if ( slope < 0 || rate[VM_PSWPIN] > swapinlow )
+	stable = t;
+    if ( chunks > 0 && t - stable >= hold &&
+	 swamstate[chunks-1] == SWAM_ACTIVE &&
+	 swap - swamsize[chunks-1] > upper &&
+	 predicted - swamsize[chunks-1] > upper ) {
+	if ( ( size = shrinkswap () ) >= 0 ) {
+	    prevswap -= size;
+	    stable = t;
+	}
+    }
+}
+
 /*
  * The main program.
  * Parse arguments, prepare for battle stations.
  * Loop repeatedly, deciding whether to add or remove swam files based on swap
- * currently available, and the high and low water marks.
+ * currently available, and the high and low water marks.  With -e the loop
+ * sleeps until memory pressure or cgroup memory events instead of polling.
  */
 int     main ( int argc, char *argv[] )
 {
     long    swap, getswap();
     struct  sigaction act;
-    int     i;
+    struct  pollfd pfd [ 4 ];
+    int     npfd = 0, event, added, pressure;
+    int     i, intervalset = 0;
 
-    while ( ( i = getopt ( argc, argv, "vhp:d:i:l:n:s:u:D" ) ) != -1 ) {
+    while ( ( i = getopt ( argc, argv, "vhp:d:i:l:n:s:u:Det:w:c:P:FH:r:q:Sz:a:b:R:W:A:C:x:L:" ) ) != -1 ) {
 	switch ( i ) {
 	case '?':
 	    usage ( argv[0], "unknown flag, use -h for help" );
@@ -170,6 +686,7 @@ int     main ( int argc, char *argv[] )
 	    interval = strtol ( optarg, &optarg, 10 );
 	    if ( interval < 0 || *optarg != '\0' )
 	        usage ( argv[0], "bad value for interval" );
+	    intervalset = 1;
 	    break;
 	case 'l':
 	    lower = strtol ( optarg, &optarg, 10 );
@@ -198,6 +715,86 @@ int     main ( int argc, char *argv[] )
 	case 'D':
 	    debug = 1;
 	    break;
+	case 'e':
+	    events = 1;
+	    break;
+	case 't':
+	    psistall = strtol ( optarg, &optarg, 10 );
+	    if ( psistall <= 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for pressure stall" );
+	    break;
+	case 'w':
+	    psiwindow = strtol ( optarg, &optarg, 10 );
+	    if ( psiwindow <= 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for pressure window" );
+	    break;
+	case 'c':
+	    memcg = optarg;
+	    events = 1;
+	    break;
+	case 'P':
+	    poolsz = strtol ( optarg, &optarg, 10 );
+	    if ( poolsz < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for swam file pool" );
+	    break;
+	case 'F':
+	    predict = 1;
+	    break;
+	case 'H':
+	    horizon = strtol ( optarg, &optarg, 10 );
+	    if ( horizon < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for forecast horizon" );
+	    break;
+	case 'r':
+	    hold = strtol ( optarg, &optarg, 10 );
+	    if ( hold < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for removal hold" );
+	    break;
+	case 'q':
+	    swapinlow = strtol ( optarg, &optarg, 10 );
+	    if ( swapinlow < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for swap in rate" );
+	    break;
+	case 'S':
+	    staged = 1;
+	    break;
+	case 'z':
+	    zramsz = strtol ( optarg, &optarg, 10 );
+	    zramsz *= suffix ( &optarg );
+	    if ( zramsz <= 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for size of zram" );
+	    break;
+	case 'a':
+	    zramalgo = optarg;
+	    break;
+	case 'b':
+	    backdev = optarg;
+	    break;
+	case 'R':
+	    recompalgo = optarg;
+	    break;
+	case 'W':
+	    wbinterval = strtol ( optarg, &optarg, 10 );
+	    if ( wbinterval < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for writeback interval" );
+	    break;
+	case 'A':
+	    hintpath = optarg;
+	    break;
+	case 'C':
+	    ctlpath = optarg;
+	    break;
+	case 'x':
+	    minextent = strtol ( optarg, &optarg, 10 );
+	    minextent *= suffix ( &optarg );
+	    if ( minextent < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for smallest extent size" );
+	    break;
+	case 'L':
+	    swaplatmax = strtol ( optarg, &optarg, 10 );
+	    if ( swaplatmax < 0 || *optarg != '\0' )
+		usage ( argv[0], "bad value for swap latency" );
+	    break;
 	default:
 	    usage ( argv[0], "internal getopt foulup" );
 	    break;
@@ -208,6 +805,11 @@ int     main ( int argc, char *argv[] )
 	usage ( argv[0], "" );
     }
 
+    /* between events the check is only a fallback, so it can be lazy */
+    if ( events && ! intervalset )
+	interval = EVINTERVAL;
+
+    dirsplit ( argv[0], tmpdir );
     ckconf ( argv[0] );
 
     if ( geteuid () ) {
@@ -254,20 +856,64 @@ int     main ( int argc, char *argv[] )
     openlog ( "swamd", LOG_DAEMON | LOG_CONS | (debug ? LOG_PERROR : 0), 0 );
     setlogmask ( debug ? LOG_UPTO ( LOG_DEBUG ) : LOG_UPTO ( LOG_WARNING ) );
 
+    dirrank ();
+
     /* allocate memory needed at start, rather than leaving to later */
     swamfile = malloc ( sizeof(char*) * numchunks );
-    if ( swamfile == NULL ) {
+    swamsize = malloc ( sizeof(int) * numchunks );
+    swamstate = calloc ( numchunks, sizeof(int) );
+    retired = malloc ( namelen );
+    if ( swamfile == NULL || swamsize == NULL || swamstate == NULL ||
+	 retired == NULL ) {
         syslog ( LOG_ERR, "malloc failed... bye" );
         exit ( 1 );
     }
     for ( i = 0; i < numchunks; i++ ) {
-        swamfile[i] = malloc ( strlen ( tmpdir ) + sizeof ( SUFFIX ) );
+        swamfile[i] = malloc ( namelen );
 	if ( swamfile[i] == NULL ) {
 	    syslog ( LOG_ERR, "malloc failed... bye" );
 	    exit ( 1 );
 	}
     }
 
+    if ( poolsz ) {
+	pthread_t tid;
+
+	poolfile = malloc ( sizeof(char*) * poolsz );
+	for ( i = 0; poolfile && i < poolsz; i++ ) {
+	    poolfile[i] = malloc ( namelen );
+	    if ( poolfile[i] == NULL ) {
+		syslog ( LOG_ERR, "malloc failed... bye" );
+		exit ( 1 );
+	    }
+	}
+	if ( poolfile == NULL ) {
+	    syslog ( LOG_ERR, "malloc failed... bye" );
+	    exit ( 1 );
+	}
+	if ( pthread_create ( &tid, NULL, poolthread, NULL ) ) {
+	    syslog ( LOG_WARNING, "can't start the swam file pool thread" );
+	    free ( poolfile );
+	    poolfile = NULL;
+	}
+    }
+
+    *retired = '\0';
+    if ( zramsz && zramstart () && wbinterval && ( backdev || recompalgo ) ) {
+	pthread_t tid;
+
+	if ( pthread_create ( &tid, NULL, tierthread, NULL ) )
+	    syslog ( LOG_WARNING, "can't start the zram writeback thread" );
+    }
+    if ( staged ) {
+	pthread_t tid;
+
+	if ( pthread_create ( &tid, NULL, drainthread, NULL ) ) {
+	    syslog ( LOG_WARNING, "can't start the drain thread, swapoff is immediate" );
+	    staged = 0;
+	}
+    }
+
     act.sa_handler = sighandler;
     sigfillset ( &act.sa_mask );
     act.sa_flags = 0;
@@ -276,17 +922,56 @@ int     main ( int argc, char *argv[] )
     (void) sigaction ( SIGQUIT, &act, (struct sigaction*)NULL );
     (void) sigaction ( SIGTERM, &act, (struct sigaction*)NULL );
 
+    if ( events ) {
+	if ( ( pfd[npfd].fd = psifd = psiopen () ) >= 0 )
+	    pfd[npfd++].events = POLLPRI;
+	if ( memcg && ( pfd[npfd].fd = memcgfd = memcgopen ( memcg ) ) >= 0 )
+	    pfd[npfd++].events = POLLPRI;
+	if ( ! npfd )
+	    syslog ( LOG_WARNING, "no memory pressure events, polling every %d seconds",
+		    interval );
+    }
+
+    if ( hintpath && ( pfd[npfd].fd = hintfd = hintopen ( hintpath ) ) >= 0 )
+	pfd[npfd++].events = POLLIN;
+    if ( ctlpath && ( pfd[npfd].fd = ctlfd = ctlopen ( ctlpath ) ) >= 0 )
+	pfd[npfd++].events = POLLIN;
+    started = now ();
+
     for ( ; ; ) {
 	swap = getswap();
 	syslog ( LOG_DEBUG, "%ld available swap", swap / 1024 );
-	if ( swap < lower && chunks < numchunks ) {
-	    if ( addswap ( chunks ) )
-		chunks++;
-	}
-	if ( swap > chunksz + upper && chunks > 0 ) {
-	    delswap ( --chunks );
+	if ( zramid >= 0 )
+	    tierupdate ();
+	swaplat ( swap );
+	if ( staged )
+	    pthread_mutex_lock ( &drainlock );
+	added = chunks;
+	if ( predict ) {
+	    forecast ( swap );
+	} else {
+	    if ( swap < lower && chunks < numchunks )
+		(void) growswap ( chunksz );
+	    if ( chunks > 0 && swamstate[chunks-1] == SWAM_ACTIVE &&
+		 swap > swamsize[chunks-1] + upper )
+		(void) shrinkswap ();
 	}
-	sleep ( interval );
+	added = chunks > added;
+	if ( staged )
+	    pthread_mutex_unlock ( &drainlock );
+	if ( hintfd >= 0 )
+	    appreclaim ( holdswap && zramid >= 0 );
+	/* under pressure keep adding without waiting for the next event */
+	pressure = ( psifd >= 0 ) + ( memcgfd >= 0 );
+	if ( pressure && added )
+	    continue;
+	/* background apps are checked at least every COLDAGE seconds */
+	event = npfd ? waitevent ( pfd, &npfd,
+		hintfd >= 0 && interval > COLDAGE ? COLDAGE : interval ) : 0;
+	if ( event )
+	    syslog ( LOG_DEBUG, "memory pressure event" );
+	else if ( ! npfd )
+	    sleep ( interval );
     }
 }
 
@@ -313,7 +998,7 @@ int     main ( int argc, char *argv[] )
 long getswap ()
 {
     static  int     fd	= -1;		/* fd to read meminfo from */
-    static  char    buffer [ 1024 ];	/* enough to slurp meminfo into */
+    static  char    buffer [ 8192 ];	/* enough to slurp meminfo into */
     char   *cp;
     long    memfree, buffers, cached, swapfree;
     int     n;
@@ -402,91 +1087,1315 @@ long getswap ()
 }
 
 /*
- * Add swamfile number i.
+ * The version 1 swap header that mkswap writes in the first page.
+ * The "SWAPSPACE2" magic goes in the last 10 bytes of that page.
  */
-int addswap ( int i )
+struct swaphdr {
+    char            bootbits [ 1024 ];	/* space for a disk label */
+    unsigned int    version;
+    unsigned int    last_page;
+    unsigned int    nr_badpages;
+    unsigned char   uuid [ 16 ];
+    char            volume_name [ 16 ];
+    unsigned int    padding [ 117 ];
+    unsigned int    badpages [ 1 ];
+};
+
+/*
+ * Write the swap header, which is all that mkswap does to a file.
+ */
+int writehdr ( int fd, char *name, long size )
 {
-    static  char    page [ PAGE_SIZE ];	/* one page of memory used to make swap file */
+    static  char    page [ PAGE_SIZE ];	/* the first page of the swam file */
+    struct  swaphdr *hdr = (struct swaphdr *) page;
+    int     i;
 
-    struct  statfs  fsstat;
-    int     fd;
-    int     pages   = chunksz / sizeof(page);
-    int     clean   = 0;
+    memset ( page, 0, sizeof(page) );
+    hdr->version = 1;
+    hdr->last_page = size / sizeof(page) - 1;
+    for ( i = 0; i < sizeof(hdr->uuid); i++ )
+	hdr->uuid[i] = random ();
+    memcpy ( page + sizeof(page) - 10, "SWAPSPACE2", 10 );
 
-    if ( statfs ( tmpdir, &fsstat ) < 0 ) {
-        syslog ( LOG_ERR, "statfs failed on \"%s\": %m", tmpdir );
-        cleanup ();
-        exit ( 1 );
-    }
-    if ( fsstat.f_bsize * fsstat.f_bavail < chunksz ) {
-        syslog ( LOG_WARNING, "no space for swamfile on \"%s\"", tmpdir );
+    if ( pwrite ( fd, page, sizeof(page), 0 ) != sizeof(page) ) {
+	syslog ( LOG_WARNING, "write failed on \"%s\": %m", name );
 	return 0;
     }
+    return 1;
+}
 
-    strcpy ( swamfile[i], tmpdir );
-    strcat ( swamfile[i], SUFFIX );
-    if ( ( fd = mkstemp ( swamfile[i] ) ) < 0 ) {
-	syslog ( LOG_ERR, "mkstemp failed: %m" );
-	cleanup ();
-	exit ( 1 );
-    }
-
-    /* add a swap signature */
-    memcpy ( page + sizeof(page) - 10, "SWAP-SPACE", 10 );
-
-    /* mark all pages as being valid */
-    memset ( page, 0xFF, ( pages + 7 ) / 8 );
-    page [ 0 ] &= 0xFE;
-    if ( pages % 8 )
-	page [ ( pages + 7 ) / 8 - 1 ] &= ( 0xFF >> ( 8 - ( pages % 8 ) ) );
+/*
+ * Fill a swam file by writing every page, for file systems that can't swap
+ * on preallocated extents.
+ */
+int writeswam ( int fd, char *name, int size )
+{
+    static  char    page [ PAGE_SIZE ];	/* a page of zeros */
+    int     pages   = size / sizeof(page);
 
-    /* stick the pages for swapping onto disk */
+    if ( lseek ( fd, 0, SEEK_SET ) == EOF ) {
+	syslog ( LOG_WARNING, "lseek failed on \"%s\": %m", name );
+	return 0;
+    }
     while ( pages-- > 0 ) {
         if ( write ( fd, page, sizeof(page) ) != sizeof(page) ) {
-	    syslog ( LOG_WARNING, "write failed on \"%s\": %m", swamfile[i] );
-	    (void) close ( fd );
-	    (void) unlink ( swamfile[i] );
+	    syslog ( LOG_WARNING, "write failed on \"%s\": %m", name );
 	    return 0;
 	}
-	if ( ! clean++ )
-	    memset ( page, 0, sizeof(page) );
     }
-    if ( fsync ( fd ) < 0 ) {
-	syslog ( LOG_ERR, "fsync failed on \"%s\": %m", swamfile[i] );
-	close ( fd );
-	(void) unlink ( swamfile[i] );
-	return 0;
+    return 1;
+}
+
+/*
+ * The number of physically contiguous runs of blocks a file is made of,
+ * mapped with FIEMAP as filefrag does.  Returns -1 if it can't be mapped.
+ */
+int     swamextents ( int fd, char *name )
+{
+    union {
+	struct  fiemap  fm;
+	char    buf [ sizeof(struct fiemap) + FIEMAPNR * sizeof(struct fiemap_extent) ];
+    } map;
+    struct  fiemap *fm = &map.fm;
+    unsigned long long next = 0;	/* block after the last run */
+    int     runs = 0, last = 0, i;
+
+    memset ( fm, 0, sizeof(*fm) );
+    while ( ! last ) {
+	fm->fm_flags = FIEMAP_FLAG_SYNC;
+	fm->fm_length = ~0ULL - fm->fm_start;
+	fm->fm_extent_count = FIEMAPNR;
+	if ( ioctl ( fd, FS_IOC_FIEMAP, fm ) < 0 ) {
+	    syslog ( LOG_DEBUG, "FIEMAP failed on \"%s\": %m", name );
+	    return -1;
+	}
+	if ( fm->fm_mapped_extents == 0 )
+	    break;
+	for ( i = 0; i < fm->fm_mapped_extents; i++ ) {
+	    struct  fiemap_extent *fe = &fm->fm_extents[i];
+
+	    if ( ! runs || fe->fe_physical != next )
+		runs++;
+	    next = fe->fe_physical + fe->fe_length;
+	    if ( fe->fe_flags & FIEMAP_EXTENT_LAST )
+		last = 1;
+	}
+	fm->fm_start = fm->fm_extents[i-1].fe_logical +
+	    fm->fm_extents[i-1].fe_length;
     }
-    if ( close ( fd ) < 0 ) {
-	syslog ( LOG_ERR, "fsync failed on \"%s\": %m", swamfile[i] );
-	(void) unlink ( swamfile[i] );
-	return 0;
+    return runs;
+}
+
+/*
+ * Whether a swam file of size bytes in runs extents is too fragmented.
+ */
+int     fragmented ( int size, int runs )
+{
+    return minextent && runs > 1 && size / runs < minextent;
+}
+
+/*
+ * Give a fragmented swam file a freshly allocated, less fragmented set of
+ * blocks, moving them in with EXT4_IOC_MOVE_EXT as e4defrag does, or on
+ * other file systems by renaming the new file over it.  The swam file has
+ * no data yet so nothing is copied.  Returns the extents it is left with.
+ */
+int     swamdefrag ( int fd, char *name, char *dir, int size, int runs )
+{
+    struct  move_extent me;
+    struct  statfs  fsstat;
+    char   *donor = malloc ( namelen );
+    int     dfd, druns;
+
+    if ( donor == NULL )
+	return runs;
+    strcpy ( donor, dir );
+    strcat ( donor, SUFFIX );
+    if ( ( dfd = mkstemp ( donor ) ) < 0 ) {
+	syslog ( LOG_WARNING, "mkstemp failed: %m" );
+	free ( donor );
+	return runs;
+    }
+    if ( fallocate ( dfd, 0, 0, size ) < 0 ||
+	 ( druns = swamextents ( dfd, donor ) ) < 0 || druns >= runs ) {
+	syslog ( LOG_DEBUG, "no less fragmented space for \"%s\"", name );
+	goto done;
     }
 
-    syslog ( LOG_INFO, "adding \"%s\" as swap", swamfile[i] );
-    if ( swapon ( swamfile[i], 0 ) < 0 ) {
-	syslog ( LOG_ERR, "swapon failed on \"%s\": %m", swamfile[i] );
-	(void) unlink ( swamfile[i] );
-	return 0;
+    memset ( &me, 0, sizeof(me) );
+    me.donor_fd = dfd;
+    if ( fstatfs ( fd, &fsstat ) == 0 )
+	me.len = ( size + fsstat.f_bsize - 1 ) / fsstat.f_bsize;
+    if ( me.len && ioctl ( fd, EXT4_IOC_MOVE_EXT, &me ) == 0 &&
+	 me.moved_len == me.len ) {
+	/* the donor now has the old blocks */
+	syslog ( LOG_DEBUG, "moved new extents into \"%s\"", name );
+    } else if ( rename ( donor, name ) == 0 ) {
+	syslog ( LOG_DEBUG, "renamed new blocks over \"%s\"", name );
+	(void) dup2 ( dfd, fd );
+	*donor = '\0';
+    } else {
+	syslog ( LOG_WARNING, "can't defragment \"%s\": %m", name );
+	goto done;
     }
+    druns = swamextents ( fd, name );
+    syslog ( LOG_INFO, "defragmented \"%s\" from %d to %d extents",
+	    name, runs, druns );
+    if ( druns > 0 )
+	runs = druns;
 
-    return 1;
+done:
+    (void) close ( dfd );
+    if ( *donor )
+	(void) unlink ( donor );
+    free ( donor );
+    return runs;
 }
 
 /*
- * Remove swamfile number i.
+ * Whether a directory has room for a swam file of size bytes.
  */
-int delswap ( int i )
+int     dirspace ( char *dir, int size )
 {
-    if ( swapoff ( swamfile[i] ) < 0 ) {
-	syslog ( LOG_ERR, "swapoff failed on \"%s\": %m", swamfile[i] );
+    struct  statfs  fsstat;
+
+    if ( statfs ( dir, &fsstat ) < 0 ) {
+        syslog ( LOG_ERR, "statfs failed on \"%s\": %m", dir );
 	return 0;
     }
-    if ( unlink ( swamfile[i] ) < 0 ) {
-        syslog ( LOG_ERR, "unlink of \"%s\" failed: %m", swamfile[i] );
+    if ( fsstat.f_bsize * fsstat.f_bavail < size ) {
+        syslog ( LOG_WARNING, "no space for swamfile on \"%s\"", dir );
+	return 0;
     }
+    return 1;
+}
+
+/*
+ * Create a swam file ready for swapon, preallocating it with fallocate() and
+ * writing pages only where the file system can't do that.  The directories
+ * are tried fastest first, passing over one whose file is still fragmented
+ * after defragmenting while a slower one has room.  The name buffer holds
+ * the created file's name on return.
+ */
+int makeswam ( char *name, int size, int prealloc )
+{
+    int     d, e, fd, runs;
 
-    syslog ( LOG_INFO, "removed \"%s\" as swap", swamfile[i] );
+    for ( d = 0; d < ndirs; d++ ) {
+	if ( ! dirspace ( swamdirs[d], size ) )
+	    continue;
 
-    return 1;
+	strcpy ( name, swamdirs[d] );
+	strcat ( name, SUFFIX );
+	if ( ( fd = mkstemp ( name ) ) < 0 ) {
+	    syslog ( LOG_ERR, "mkstemp failed on \"%s\": %m", swamdirs[d] );
+	    continue;
+	}
+
+	if ( ! prealloc || fallocate ( fd, 0, 0, size ) < 0 ) {
+	    if ( prealloc )
+		syslog ( LOG_DEBUG, "fallocate failed on \"%s\": %m", name );
+	    if ( ! writeswam ( fd, name, size ) )
+		goto fail;
+	}
+
+	runs = swamextents ( fd, name );
+	if ( fragmented ( size, runs ) )
+	    runs = swamdefrag ( fd, name, swamdirs[d], size, runs );
+	if ( fragmented ( size, runs ) ) {
+	    for ( e = d + 1; e < ndirs && ! dirspace ( swamdirs[e], size ); e++ )
+		;
+	    if ( e < ndirs ) {
+		syslog ( LOG_INFO, "\"%s\" is in %d extents, trying \"%s\"",
+			name, runs, swamdirs[e] );
+		(void) close ( fd );
+		(void) unlink ( name );
+		continue;
+	    }
+	    syslog ( LOG_WARNING, "\"%s\" is fragmented into %d extents",
+		    name, runs );
+	}
+
+	if ( ! writehdr ( fd, name, size ) )
+	    goto fail;
+	if ( fsync ( fd ) < 0 ) {
+	    syslog ( LOG_ERR, "fsync failed on \"%s\": %m", name );
+	    goto fail;
+	}
+	if ( close ( fd ) < 0 ) {
+	    syslog ( LOG_ERR, "close failed on \"%s\": %m", name );
+	    (void) unlink ( name );
+	    return 0;
+	}
+	return 1;
+
+fail:
+	(void) close ( fd );
+	(void) unlink ( name );
+    }
+    return 0;
+}
+
+/*
+ * Background thread keeping the pool topped up with swam files that are
+ * ready to swapon, so that adding swap under pressure costs only the swapon.
+ */
+void   *poolthread ( void *arg )
+{
+    char   *name = malloc ( namelen );
+    sigset_t set;
+
+    /* signals are for the main loop */
+    sigfillset ( &set );
+    pthread_sigmask ( SIG_BLOCK, &set, NULL );
+
+    if ( name == NULL ) {
+	syslog ( LOG_ERR, "malloc failed, no swam file pool" );
+	return NULL;
+    }
+    pthread_mutex_lock ( &poollock );
+    for ( ; ; ) {
+	int     size;
+
+	while ( pooled >= poolsz || chunks + pooled >= numchunks )
+	    pthread_cond_wait ( &poolcond, &poollock );
+	size = chunksz;
+	pthread_mutex_unlock ( &poollock );
+
+	if ( ! makeswam ( name, size, 1 ) ) {
+	    /* out of space; try again when the pool is next drawn on */
+	    pthread_mutex_lock ( &poollock );
+	    pthread_cond_wait ( &poolcond, &poollock );
+	    continue;
+	}
+	syslog ( LOG_DEBUG, "prepared \"%s\" for the pool", name );
+
+	pthread_mutex_lock ( &poollock );
+	/* the swam file size may have been changed meanwhile */
+	if ( size == chunksz )
+	    strcpy ( poolfile[pooled++], name );
+	else
+	    (void) unlink ( name );
+    }
+    return NULL;
+}
+
+/*
+ * Remove the swam files in the pool that were never swapped on.
+ * Only called on the way out, so the pool is not locked: the signal may
+ * have come while the main loop held the lock.
+ */
+void poolcleanup ()
+{
+    if ( ! poolfile )
+	return;
+    while ( pooled )
+	(void) unlink ( poolfile[--pooled] );
+}
+
+/*
+ * The swapon flags for swamfile number i.  With staged removal each newer
+ * swam file gets a lower priority, so the one that is removed next is the
+ * one the kernel puts pages on last.  With a zram tier they are all below it.
+ */
+int swapflags ( int i )
+{
+    int     prio = SWAMPRIO - i;
+
+    if ( ! staged && zramid < 0 )
+	return 0;
+    if ( prio < 0 )
+	prio = 0;
+    return SWAP_FLAG_PREFER |
+	( ( prio << SWAP_FLAG_PRIO_SHIFT ) & SWAP_FLAG_PRIO_MASK );
+}
+
+/*
+ * Add swamfile number i of size bytes, taking a ready one from the pool if
+ * there is one of that size.
+ */
+int addswap ( int i, int size )
+{
+    int     frompool = 0;
+
+    swamsize[i] = size;
+    if ( poolfile && size == chunksz ) {
+	pthread_mutex_lock ( &poollock );
+	if ( pooled ) {
+	    strcpy ( swamfile[i], poolfile[--pooled] );
+	    frompool = 1;
+	}
+	pthread_cond_signal ( &poolcond );
+	pthread_mutex_unlock ( &poollock );
+    }
+    if ( ! frompool && ! makeswam ( swamfile[i], size, 1 ) )
+	return 0;
+
+    syslog ( LOG_INFO, "adding \"%s\" as %d KB swap%s", swamfile[i],
+	    size / 1024, frompool ? " from the pool" : "" );
+    if ( swapon ( swamfile[i], swapflags ( i ) ) < 0 ) {
+	int     fd;
+
+	/* the file system may not swap on unwritten extents: write them */
+	if ( errno != EINVAL ||
+	     ( fd = open ( swamfile[i], O_WRONLY ) ) < 0 ) {
+	    syslog ( LOG_ERR, "swapon failed on \"%s\": %m", swamfile[i] );
+	    (void) unlink ( swamfile[i] );
+	    return 0;
+	}
+	syslog ( LOG_DEBUG, "swapon refused preallocated \"%s\", writing it",
+		swamfile[i] );
+	if ( ! writeswam ( fd, swamfile[i], size ) ||
+	     ! writehdr ( fd, swamfile[i], size ) || fsync ( fd ) < 0 ) {
+	    (void) close ( fd );
+	    (void) unlink ( swamfile[i] );
+	    return 0;
+	}
+	(void) close ( fd );
+	if ( swapon ( swamfile[i], swapflags ( i ) ) < 0 ) {
+	    syslog ( LOG_ERR, "swapon failed on \"%s\": %m", swamfile[i] );
+	    (void) unlink ( swamfile[i] );
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+/*
+ * Swapoff and remove a swam file.
+ */
+int removeswam ( char *name )
+{
+    double  t = now ();
+
+    if ( swapoff ( name ) < 0 ) {
+	syslog ( LOG_ERR, "swapoff failed on \"%s\": %m", name );
+	return 0;
+    }
+    histadd ( removehist, now () - t );
+    removes++;
+    if ( unlink ( name ) < 0 ) {
+        syslog ( LOG_ERR, "unlink of \"%s\" failed: %m", name );
+    }
+
+    syslog ( LOG_INFO, "removed \"%s\" as swap", name );
+
+    return 1;
+}
+
+/*
+ * Remove swamfile number i.
+ */
+int delswap ( int i )
+{
+    return removeswam ( swamfile[i] );
+}
+
+/*
+ * Staged removal.
+ * swapoff faults every page still on the file back into RAM, which can take
+ * seconds and spike memory use.  With -S the newest swam file, which has
+ * the lowest priority so the kernel puts pages there last, is only marked
+ * as draining.  A worker thread watches its usage in /proc/swaps as pages
+ * are swapped back in naturally, and only swapoffs it once it is nearly
+ * empty, or has been draining for DRAINMAX seconds.  If pressure returns
+ * before then, the drain is cancelled instead of adding a new swam file.
+ */
+
+/*
+ * Return the kilobytes used on a swap file, or -1 if it is not swapped on.
+ */
+long    swapused ( char *name )
+{
+    char    line [ 4096 + 128 ], file [ 4096 ];
+    long    size, used = -1;
+    FILE   *fp;
+
+    if ( ( fp = fopen ( "/proc/swaps", "r" ) ) == NULL )
+	return -1;
+    while ( fgets ( line, sizeof(line), fp ) ) {
+	if ( sscanf ( line, "%4095s %*s %ld %ld", file, &size, &used ) == 3 &&
+	     strcmp ( file, name ) == 0 )
+	    break;
+	used = -1;
+    }
+    (void) fclose ( fp );
+    return used;
+}
+
+/*
+ * Add swap of size bytes, or cancel the drain of the newest swam file.
+ * Returns the bytes of new swap, 0 if a drain was cancelled or -1.
+ * With -S the caller holds drainlock.
+ */
+int     growswap ( int size )
+{
+    double  t = now ();
+
+    if ( staged && chunks > 0 && swamstate[chunks-1] == SWAM_DRAINING ) {
+	swamstate[chunks-1] = SWAM_ACTIVE;
+	syslog ( LOG_INFO, "keeping draining \"%s\" as swap", swamfile[chunks-1] );
+	return 0;
+    }
+    if ( chunks >= numchunks )
+	return -1;
+    if ( holdswap ) {
+	syslog ( LOG_DEBUG, "holding off a swam file, swap I/O takes %.1f ms",
+		swaplatms );
+	holdoffs++;
+	return -1;
+    }
+    if ( ! addswap ( chunks, size ) ) {
+	addfailures++;
+	return -1;
+    }
+    histadd ( addhist, now () - t );
+    adds++;
+    swamstate[chunks++] = SWAM_ACTIVE;
+    return size;
+}
+
+/*
+ * Remove the newest swam file, or with -S start draining it.
+ * Returns the bytes of swap removed now, 0 if it is draining or -1.
+ * With -S the caller holds drainlock.
+ */
+int     shrinkswap ()
+{
+    if ( chunks <= 0 )
+	return -1;
+    if ( ! staged ) {
+	if ( ! delswap ( chunks - 1 ) )
+	    return -1;
+	return swamsize[--chunks];
+    }
+    if ( swamstate[chunks-1] != SWAM_DRAINING ) {
+	swamstate[chunks-1] = SWAM_DRAINING;
+	drainstart = now ();
+	syslog ( LOG_INFO, "draining \"%s\"", swamfile[chunks-1] );
+	pthread_cond_signal ( &draincond );
+    }
+    return 0;
+}
+
+/*
+ * The drain worker: swapoff the newest swam file once it has drained.
+ */
+void   *drainthread ( void *arg )
+{
+    struct  timespec ts;
+    sigset_t set;
+    long    used;
+    int     size;
+
+    /* signals are for the main loop */
+    sigfillset ( &set );
+    pthread_sigmask ( SIG_BLOCK, &set, NULL );
+
+    pthread_mutex_lock ( &drainlock );
+    for ( ; ; ) {
+	if ( chunks <= 0 || swamstate[chunks-1] != SWAM_DRAINING ) {
+	    pthread_cond_wait ( &draincond, &drainlock );
+	    continue;
+	}
+	/* /proc/swaps is only read without the lock held */
+	strcpy ( retired, swamfile[chunks-1] );
+	size = swamsize[chunks-1];
+	pthread_mutex_unlock ( &drainlock );
+	used = swapused ( retired );
+	pthread_mutex_lock ( &drainlock );
+
+	if ( chunks <= 0 || swamstate[chunks-1] != SWAM_DRAINING ||
+	     strcmp ( retired, swamfile[chunks-1] ) != 0 ) {
+	    *retired = '\0';
+	    continue;
+	}
+	if ( used >= 0 && used * 1024 > (long) size / 100 * DRAINLOW &&
+	     now () - drainstart < DRAINMAX ) {
+	    syslog ( LOG_DEBUG, "\"%s\" has %ld KB left to drain", retired, used );
+	    clock_gettime ( CLOCK_REALTIME, &ts );
+	    ts.tv_sec += DRAINPOLL;
+	    pthread_cond_timedwait ( &draincond, &drainlock, &ts );
+	    continue;
+	}
+
+	/* take it out of the swam files so the main loop can carry on */
+	swamstate[chunks-1] = SWAM_ACTIVE;
+	chunks--;
+	pthread_mutex_unlock ( &drainlock );
+
+	syslog ( LOG_DEBUG, "swapoff \"%s\" with %ld KB left", retired, used );
+	if ( removeswam ( retired ) ) {
+	    pthread_mutex_lock ( &drainlock );
+	    drained += size;
+	} else {
+	    /* still swapped on: put it back as the newest again */
+	    pthread_mutex_lock ( &drainlock );
+	    if ( chunks < numchunks ) {
+		strcpy ( swamfile[chunks], retired );
+		swamsize[chunks] = size;
+		swamstate[chunks++] = SWAM_ACTIVE;
+	    }
+	}
+	*retired = '\0';
+    }
+    return NULL;
+}
+
+/*
+ * Tiers.
+ * With -z a zram device is the first tier: compressed RAM swap at priority
+ * ZRAMPRIO, above every swam file, which become the second tier.  The zram
+ * disksize can only be set while the device is reset, so it is sized once at
+ * start up.  With -b, a block device (for example a loop device on a file) is
+ * the zram backing device, and every -W seconds pages that have not been
+ * touched since the previous pass are recompressed with the -R algorithm, if
+ * there is one, and written back to it, at most WBLIMIT pages per pass.
+ * Usage and mean read and write latencies of both tiers are tracked from
+ * mm_stat, /proc/swaps and the block device stat files.
+ */
+
+/*
+ * Write a value to a zram device attribute.
+ */
+int     zramwrite ( char *attr, char *val )
+{
+    char    path [ 64 ];
+    int     fd, n;
+
+    (void) snprintf ( path, sizeof(path), "/sys/block/zram%d/%s", zramid, attr );
+    if ( ( fd = open ( path, O_WRONLY ) ) < 0 )
+	return -1;
+    n = write ( fd, val, strlen ( val ) );
+    (void) close ( fd );
+    return n < 0 ? -1 : 0;
+}
+
+/*
+ * Read a zram device or zram-control attribute.
+ */
+int     sysread ( char *path, char *buf, int len )
+{
+    int     fd, n;
+
+    if ( ( fd = open ( path, O_RDONLY ) ) < 0 )
+	return -1;
+    n = read ( fd, buf, len - 1 );
+    (void) close ( fd );
+    if ( n < 0 )
+	return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/*
+ * Read the I/Os and milliseconds spent on them from a block device stat.
+ */
+void    blockstat ( char *dev, struct tierstat *ts )
+{
+    char    path [ 128 ], buf [ 256 ];
+
+    (void) snprintf ( path, sizeof(path), "/sys/%s/stat", dev );
+    if ( sysread ( path, buf, sizeof(buf) ) <= 0 )
+	return;
+    (void) sscanf ( buf, "%lu %*u %*u %lu %lu %*u %*u %lu",
+	    &ts->reads, &ts->readms, &ts->writes, &ts->writems );
+}
+
+/*
+ * Set up the zram tier: add a device, size it and swap on it.
+ */
+int     zramstart ()
+{
+    char    buf [ 256 ], dev [ 32 ];
+    int     fd;
+
+    if ( sysread ( "/sys/class/zram-control/hot_add", buf, sizeof(buf) ) > 0 ) {
+	zramid = atoi ( buf );
+	zramadded = 1;
+    } else {
+	/* no zram-control: use zram0 if it is not in use */
+	zramid = 0;
+	(void) snprintf ( dev, sizeof(dev), "/sys/block/zram0/disksize" );
+	if ( sysread ( dev, buf, sizeof(buf) ) <= 0 || atol ( buf ) != 0 ) {
+	    syslog ( LOG_WARNING, "no free zram device, no zram tier" );
+	    return 0;
+	}
+    }
+    (void) snprintf ( dev, sizeof(dev), "/dev/zram%d", zramid );
+
+    if ( zramalgo && zramwrite ( "comp_algorithm", zramalgo ) < 0 )
+	syslog ( LOG_WARNING, "can't use \"%s\" for %s: %m", zramalgo, dev );
+    if ( recompalgo ) {
+	(void) snprintf ( buf, sizeof(buf), "algo=%s", recompalgo );
+	if ( zramwrite ( "recomp_algorithm", buf ) < 0 ) {
+	    syslog ( LOG_WARNING, "can't recompress %s with \"%s\": %m", dev, recompalgo );
+	    recompalgo = NULL;
+	}
+    }
+    if ( backdev && zramwrite ( "backing_dev", backdev ) < 0 ) {
+	syslog ( LOG_WARNING, "can't use \"%s\" as backing device of %s: %m",
+		backdev, dev );
+	backdev = NULL;
+    }
+    if ( backdev && WBLIMIT ) {
+	(void) snprintf ( buf, sizeof(buf), "%d", WBLIMIT );
+	if ( zramwrite ( "writeback_limit_enable", "1" ) < 0 ||
+	     zramwrite ( "writeback_limit", buf ) < 0 )
+	    syslog ( LOG_WARNING, "can't limit writeback of %s: %m", dev );
+    }
+    (void) snprintf ( buf, sizeof(buf), "%ld", zramsz );
+    if ( zramwrite ( "disksize", buf ) < 0 ) {
+	syslog ( LOG_ERR, "can't set disksize of %s: %m", dev );
+	goto fail;
+    }
+    if ( ( fd = open ( dev, O_WRONLY ) ) < 0 ) {
+	syslog ( LOG_ERR, "can't open \"%s\": %m", dev );
+	goto fail;
+    }
+    if ( ! writehdr ( fd, dev, zramsz ) || fsync ( fd ) < 0 ) {
+	(void) close ( fd );
+	goto fail;
+    }
+    (void) close ( fd );
+    if ( swapon ( dev, SWAP_FLAG_PREFER |
+	    ( ( ZRAMPRIO << SWAP_FLAG_PRIO_SHIFT ) & SWAP_FLAG_PRIO_MASK ) ) < 0 ) {
+	syslog ( LOG_ERR, "swapon failed on \"%s\": %m", dev );
+	goto fail;
+    }
+    syslog ( LOG_INFO, "adding \"%s\" as %ld KB zram swap%s%s", dev, zramsz / 1024,
+	    backdev ? " backed by " : "", backdev ? backdev : "" );
+    return 1;
+
+fail:
+    zramstop ( 0 );
+    return 0;
+}
+
+/*
+ * Take down the zram tier.
+ */
+void    zramstop ( int on )
+{
+    char    buf [ 32 ];
+    int     fd;
+
+    if ( zramid < 0 )
+	return;
+    if ( on ) {
+	(void) snprintf ( buf, sizeof(buf), "/dev/zram%d", zramid );
+	if ( swapoff ( buf ) < 0 )
+	    syslog ( LOG_ERR, "swapoff failed on \"%s\": %m", buf );
+    }
+    (void) zramwrite ( "reset", "1" );
+    if ( zramadded &&
+	 ( fd = open ( "/sys/class/zram-control/hot_remove", O_WRONLY ) ) >= 0 ) {
+	(void) snprintf ( buf, sizeof(buf), "%d", zramid );
+	(void) write ( fd, buf, strlen ( buf ) );
+	(void) close ( fd );
+    }
+    zramid = -1;
+}
+
+/*
+ * Update the usage and latency stats of both tiers.
+ */
+void    tierupdate ()
+{
+    char    path [ 64 ], buf [ 256 ];
+    unsigned long orig = 0, compr = 0, memused = 0;	/* mm_stat */
+    struct  stat st;
+    int     i;
+
+    if ( zramid >= 0 ) {
+	(void) snprintf ( path, sizeof(path), "/sys/block/zram%d/mm_stat", zramid );
+	if ( sysread ( path, buf, sizeof(buf) ) > 0 )
+	    (void) sscanf ( buf, "%lu %lu %lu", &orig, &compr, &memused );
+	tiers[TIER_ZRAM].size = zramsz;
+	tiers[TIER_ZRAM].used = orig;
+	tiers[TIER_ZRAM].stored = compr > memused ? compr : memused;
+	(void) snprintf ( path, sizeof(path), "block/zram%d", zramid );
+	blockstat ( path, &tiers[TIER_ZRAM] );
+	(void) snprintf ( path, sizeof(path), "/sys/block/zram%d/bd_stat", zramid );
+	if ( backdev && sysread ( path, buf, sizeof(buf) ) > 0 )
+	    (void) sscanf ( buf, "%lu", &tiers[TIER_ZRAM].backed );
+    }
+
+    tiers[TIER_FILE].size = tiers[TIER_FILE].used = 0;
+    for ( i = 0; i < chunks; i++ ) {
+	long used = swapused ( swamfile[i] );
+
+	tiers[TIER_FILE].size += swamsize[i];
+	if ( used > 0 )
+	    tiers[TIER_FILE].used += used * 1024;
+    }
+    tiers[TIER_FILE].stored = tiers[TIER_FILE].used;
+    if ( stat ( swamdirs[0], &st ) == 0 ) {
+	(void) snprintf ( path, sizeof(path), "dev/block/%u:%u",
+		major ( st.st_dev ), minor ( st.st_dev ) );
+	blockstat ( path, &tiers[TIER_FILE] );
+    }
+
+    syslog ( LOG_DEBUG, "zram tier %lu of %lu KB used in %lu KB, "
+	    "%.2f ms reads %.2f ms writes, %lu pages written back",
+	    tiers[TIER_ZRAM].used / 1024, tiers[TIER_ZRAM].size / 1024,
+	    tiers[TIER_ZRAM].stored / 1024,
+	    tiermean ( tiers[TIER_ZRAM].readms, tiers[TIER_ZRAM].reads ),
+	    tiermean ( tiers[TIER_ZRAM].writems, tiers[TIER_ZRAM].writes ),
+	    tiers[TIER_ZRAM].backed );
+    syslog ( LOG_DEBUG, "file tier %lu of %lu KB used, "
+	    "%.2f ms reads %.2f ms writes on its device",
+	    tiers[TIER_FILE].used / 1024, tiers[TIER_FILE].size / 1024,
+	    tiermean ( tiers[TIER_FILE].readms, tiers[TIER_FILE].reads ),
+	    tiermean ( tiers[TIER_FILE].writems, tiers[TIER_FILE].writes ) );
+}
+
+/*
+ * The mean latency in milliseconds of an I/O.
+ */
+double  tiermean ( unsigned long ms, unsigned long ios )
+{
+    return ios ? (double) ms / ios : 0.0;
+}
+
+/*
+ * The swap latency monitor.
+ * Adding swap on a flash device that is already saturated makes every swap
+ * in slower still, so at every check the daemon samples how slow swapping
+ * is: the mean milliseconds per I/O on the devices of the -d directories,
+ * from their block layer stat, the swap in rate, and the memory stall of a
+ * major fault, estimated from the PSI stall time over the major faults.
+ * They are moving averages, as in the predictive controller.  Swap is slow
+ * once the device latency, or the stall of the faults while swap ins are
+ * over -q a second, is over -L milliseconds.  New swam files are then held
+ * off while the zram tier has room for a swam file, so pages are reclaimed
+ * into compressed RAM instead, and without one until the spare VM falls
+ * below half the lower limit, when slow swap still beats the OOM killer.
+ */
+void    swaplat ( long swap )
+{
+    static  double  last = 0;
+    static  unsigned long prevms, previos, prevstall;
+    static  long    prevvm [ VM_NR ];
+    struct  tierstat ts;
+    struct  stat st;
+    dev_t   devs [ MAXDIRS ];
+    unsigned long ms = 0, ios = 0, stall = 0;
+    char    path [ 64 ], buf [ 256 ], *p;
+    long    vm [ VM_NR ], faults;
+    double  t = now (), dt;
+    int     i, j, ndevs = 0, slow, room;
+
+    for ( i = 0; i < ndirs; i++ ) {
+	if ( stat ( swamdirs[i], &st ) < 0 )
+	    continue;
+	/* directories on the same device count once */
+	for ( j = 0; j < ndevs && devs[j] != st.st_dev; j++ )
+	    ;
+	if ( j < ndevs )
+	    continue;
+	devs[ndevs++] = st.st_dev;
+	memset ( &ts, 0, sizeof(ts) );
+	(void) snprintf ( path, sizeof(path), "dev/block/%u:%u",
+		major ( st.st_dev ), minor ( st.st_dev ) );
+	blockstat ( path, &ts );
+	ms += ts.readms + ts.writems;
+	ios += ts.reads + ts.writes;
+    }
+    /* the first line is "some ... total=<microseconds>" */
+    if ( sysread ( PSIFILE, buf, sizeof(buf) ) > 0 &&
+	 ( p = strstr ( buf, "total=" ) ) != NULL )
+	stall = strtoul ( p + 6, NULL, 10 );
+    getvmstat ( vm );
+
+    if ( last && ( dt = t - last ) > 0 ) {
+	faults = vm[VM_PGMAJFAULT] - prevvm[VM_PGMAJFAULT];
+	swaplatms = ALPHA * tiermean ( ms - prevms, ios - previos ) +
+		( 1 - ALPHA ) * swaplatms;
+	faultlatms = ALPHA * ( faults > 0 && stall >= prevstall ?
+		( stall - prevstall ) / 1000.0 / faults : 0.0 ) +
+		( 1 - ALPHA ) * faultlatms;
+	swapinrate = ALPHA * ( vm[VM_PSWPIN] - prevvm[VM_PSWPIN] ) / dt +
+		( 1 - ALPHA ) * swapinrate;
+    }
+    last = t;
+    prevms = ms;
+    previos = ios;
+    prevstall = stall;
+    for ( i = 0; i < VM_NR; i++ )
+	prevvm[i] = vm[i];
+
+    syslog ( LOG_DEBUG, "swap I/O %.2f ms, %.2f ms stall per major fault, "
+	    "%.0f swap ins per second", swaplatms, faultlatms, swapinrate );
+
+    slow = swaplatmax && ( swaplatms > swaplatmax ||
+	    ( swapinrate > swapinlow && faultlatms > swaplatmax ) );
+    if ( slow != slowswap )
+	syslog ( slow ? LOG_WARNING : LOG_INFO, "swap I/O is %s, %.1f ms per I/O, "
+		"%.1f ms per major fault", slow ? "slow" : "fast again",
+		swaplatms, faultlatms );
+    slowswap = slow;
+    room = zramid >= 0 && tiers[TIER_ZRAM].used + chunksz <= tiers[TIER_ZRAM].size;
+    holdswap = slow && ( room || ( zramid < 0 && swap >= lower / 2 ) );
+}
+
+/*
+ * The writeback worker: every wbinterval seconds recompress and write back
+ * the pages that stayed idle since the previous pass, then mark every page
+ * idle again for the next one.
+ */
+void   *tierthread ( void *arg )
+{
+    sigset_t set;
+
+    /* signals are for the main loop */
+    sigfillset ( &set );
+    pthread_sigmask ( SIG_BLOCK, &set, NULL );
+
+    (void) zramwrite ( "idle", "all" );
+    for ( ; ; ) {
+	sleep ( wbinterval );
+	if ( zramid < 0 )
+	    break;
+	if ( recompalgo && zramwrite ( "recompress", "type=idle" ) < 0 )
+	    syslog ( LOG_WARNING, "zram recompression failed: %m" );
+	if ( backdev ) {
+	    char    buf [ 32 ];
+
+	    /* the limit counts down as pages are written back: refill it */
+	    (void) snprintf ( buf, sizeof(buf), "%d", WBLIMIT );
+	    if ( WBLIMIT )
+		(void) zramwrite ( "writeback_limit", buf );
+	    if ( zramwrite ( "writeback", "idle" ) < 0 && errno != EIO )
+		syslog ( LOG_WARNING, "zram writeback failed: %m" );
+	}
+	syslog ( LOG_DEBUG, "zram idle pages %s%s", recompalgo ? "recompressed" : "",
+		backdev ? ( recompalgo ? " and written back" : "written back" ) : "" );
+	(void) zramwrite ( "idle", "all" );
+    }
+    return NULL;
+}
+
+/*
+ * Per-app reclaim.
+ * With -A the daemon reads hints on the state of apps, one per line, from
+ * a FIFO, for example fed from the app usage statistics:
+ *     background <pid|process name>
+ *     foreground <pid|process name>
+ * A process name matches every process whose command line starts with it,
+ * or with it and a ":" as Android names an app's other processes.  Apps that
+ * stay in the background for COLDAGE seconds have their private memory
+ * deactivated with process_madvise(MADV_COLD), and after PAGEOUTAGE seconds
+ * paged out to swap with MADV_PAGEOUT, ahead of any global memory pressure.
+ * A foreground hint forgets the app; its pages come back as it touches them.
+ */
+
+/*
+ * Find the app slot of a pid, or a free one.
+ */
+struct app *appslot ( pid_t pid, int alloc )
+{
+    struct  app *free = NULL;
+    int     i;
+
+    for ( i = 0; i < MAXAPPS; i++ ) {
+	if ( apps[i].pid == pid )
+	    return &apps[i];
+	if ( ! apps[i].pid && ! free )
+	    free = &apps[i];
+    }
+    return alloc ? free : NULL;
+}
+
+/*
+ * Apply a hint to one process.
+ */
+void    apphint ( pid_t pid, int background )
+{
+    struct  app *a = appslot ( pid, background );
+
+    if ( ! a ) {
+	if ( background )
+	    syslog ( LOG_WARNING, "too many background apps, ignoring %d", pid );
+	return;
+    }
+    if ( ! background ) {
+	a->pid = 0;
+	return;
+    }
+    if ( a->pid != pid ) {
+	a->pid = pid;
+	a->state = APP_BACKGROUND;
+	a->since = now ();
+    }
+}
+
+/*
+ * Apply a hint to the processes a process name matches.
+ */
+void    apphintname ( char *name, int background )
+{
+    char    path [ 300 ], cmd [ 256 ];
+    struct  dirent *d;
+    DIR    *dir;
+    size_t  len = strlen ( name );
+
+    if ( ( dir = opendir ( "/proc" ) ) == NULL )
+	return;
+    while ( ( d = readdir ( dir ) ) != NULL ) {
+	if ( ! isdigit ( d->d_name[0] ) )
+	    continue;
+	(void) snprintf ( path, sizeof(path), "/proc/%s/cmdline", d->d_name );
+	if ( sysread ( path, cmd, sizeof(cmd) ) <= 0 )
+	    continue;
+	if ( strncmp ( cmd, name, len ) == 0 &&
+	     ( cmd[len] == '\0' || cmd[len] == ':' ) )
+	    apphint ( atoi ( d->d_name ), background );
+    }
+    (void) closedir ( dir );
+}
+
+/*
+ * Read the hints waiting in the FIFO.
+ */
+void    hintread ( int fd )
+{
+    static  char    buffer [ 4096 ];
+    static  int     len = 0;
+    char   *line, *nl, state [ 16 ], who [ 256 ];
+    int     n, background;
+
+    while ( ( n = read ( fd, buffer + len, sizeof(buffer) - 1 - len ) ) > 0 ) {
+	len += n;
+	buffer[len] = '\0';
+	line = buffer;
+	while ( ( nl = strchr ( line, '\n' ) ) != NULL ) {
+	    *nl = '\0';
+	    if ( sscanf ( line, "%15s %255s", state, who ) == 2 ) {
+		background = strcmp ( state, "background" ) == 0 ||
+			     strcmp ( state, "bg" ) == 0;
+		if ( ! background && strcmp ( state, "foreground" ) &&
+		     strcmp ( state, "fg" ) )
+		    syslog ( LOG_WARNING, "unknown app hint \"%s\"", line );
+		else if ( isdigit ( who[0] ) )
+		    apphint ( atoi ( who ), background );
+		else
+		    apphintname ( who, background );
+	    }
+	    line = nl + 1;
+	}
+	/* keep a partial line for the next read */
+	len = strlen ( line );
+	memmove ( buffer, line, len );
+	if ( len == sizeof(buffer) - 1 )
+	    len = 0;
+    }
+}
+
+/*
+ * Create and open the hint FIFO.  It is opened for writing too, so it does
+ * not read end of file whenever the last hint writer closes it.
+ */
+int     hintopen ( char *path )
+{
+    int     fd;
+
+    if ( mkfifo ( path, 0600 ) < 0 && errno != EEXIST ) {
+	syslog ( LOG_ERR, "can't create \"%s\": %m", path );
+	return -1;
+    }
+    if ( ( fd = open ( path, O_RDWR | O_NONBLOCK ) ) < 0 ) {
+	syslog ( LOG_ERR, "can't open \"%s\": %m", path );
+	return -1;
+    }
+    return fd;
+}
+
+/*
+ * Advise the kernel about the private memory of a process.
+ * Returns the bytes advised, or -1 if the process has gone.
+ */
+long    appadvise ( pid_t pid, int advice )
+{
+    struct  iovec iov [ IOVMAX ];
+    char    path [ 64 ], line [ 512 ], perms [ 8 ], name [ 256 ];
+    unsigned long start, end, inode;
+    long    total = 0, n;
+    int     pidfd, niov = 0;
+    FILE   *fp;
+
+    if ( ( pidfd = syscall ( SYS_pidfd_open, pid, 0 ) ) < 0 )
+	return -1;
+    (void) snprintf ( path, sizeof(path), "/proc/%d/maps", pid );
+    if ( ( fp = fopen ( path, "r" ) ) == NULL ) {
+	(void) close ( pidfd );
+	return -1;
+    }
+    while ( fgets ( line, sizeof(line), fp ) ) {
+	*name = '\0';
+	if ( sscanf ( line, "%lx-%lx %7s %*s %*s %lu %255s",
+		&start, &end, perms, &inode, name ) < 4 )
+	    continue;
+	/* private writable memory is what ends up in swap */
+	if ( perms[1] != 'w' || perms[3] != 'p' || *name == '[' )
+	    continue;
+	iov[niov].iov_base = (void *) start;
+	iov[niov++].iov_len = end - start;
+	if ( niov == IOVMAX ) {
+	    if ( ( n = syscall ( SYS_process_madvise, pidfd, iov, niov, advice, 0 ) ) > 0 )
+		total += n;
+	    niov = 0;
+	}
+    }
+    if ( niov && ( n = syscall ( SYS_process_madvise, pidfd, iov, niov, advice, 0 ) ) > 0 )
+	total += n;
+    if ( ! total && errno == ESRCH )
+	total = -1;
+    (void) fclose ( fp );
+    (void) close ( pidfd );
+    return total;
+}
+
+/*
+ * Reclaim the apps that have been in the background long enough.  With
+ * early set cold apps are paged out at once, to the zram tier.
+ */
+void    appreclaim ( int early )
+{
+    double  t = now (), start;
+    long    bytes;
+    int     i, advice;
+
+    for ( i = 0; i < MAXAPPS; i++ ) {
+	struct  app *a = &apps[i];
+
+	if ( ! a->pid || a->state == APP_PAGEDOUT )
+	    continue;
+	if ( t - a->since >= PAGEOUTAGE || ( early && a->state == APP_COLD ) )
+	    advice = MADV_PAGEOUT;
+	else if ( a->state == APP_BACKGROUND && t - a->since >= COLDAGE )
+	    advice = MADV_COLD;
+	else
+	    continue;
+
+	start = now ();
+	bytes = appadvise ( a->pid, advice );
+	if ( bytes < 0 ) {
+	    syslog ( LOG_DEBUG, "app %d has gone", a->pid );
+	    a->pid = 0;
+	    continue;
+	}
+	a->state = advice == MADV_PAGEOUT ? APP_PAGEDOUT : APP_COLD;
+	if ( advice == MADV_PAGEOUT ) {
+	    reclaims++;
+	    reclaimed += bytes;
+	}
+	syslog ( LOG_INFO, "%s %ld KB of app %d in %.1f ms",
+		advice == MADV_PAGEOUT ? "paged out" : "deactivated",
+		bytes / 1024, a->pid, ( now () - start ) * 1000 );
+    }
+}
+
+/*
+ * Control and metrics socket.
+ * With -C the daemon listens on a unix stream socket for one command per
+ * connection and answers with "key value" lines:
+ *     stats              the counters, histograms, rates and settings
+ *     set <key> <value>  change lower, upper, size, interval or latency at run time
+ * The counters are plain integers bumped where the work is done, so keeping
+ * them costs next to nothing; the rates are worked out when they are asked
+ * for, over the time since the previous stats command.
+ */
+
+/*
+ * Account a latency in a histogram of power of two millisecond buckets.
+ */
+void    histadd ( unsigned long hist [ HISTNR ], double seconds )
+{
+    double  ms = seconds * 1000;
+    int     i;
+
+    for ( i = 0; i < HISTNR - 1 && ms >= ( 1 << i ); i++ )
+	;
+    hist[i]++;
+}
+
+/*
+ * Create the control socket.
+ */
+int     ctlopen ( char *path )
+{
+    struct  sockaddr_un addr;
+    int     fd;
+
+    if ( strlen ( path ) >= sizeof(addr.sun_path) ) {
+	syslog ( LOG_ERR, "control socket path \"%s\" is too long", path );
+	return -1;
+    }
+    if ( ( fd = socket ( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 ) ) < 0 ) {
+	syslog ( LOG_ERR, "can't create control socket: %m" );
+	return -1;
+    }
+    memset ( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strcpy ( addr.sun_path, path );
+    (void) unlink ( path );
+    if ( bind ( fd, (struct sockaddr *) &addr, sizeof(addr) ) < 0 ||
+	 listen ( fd, 4 ) < 0 ) {
+	syslog ( LOG_ERR, "can't listen on \"%s\": %m", path );
+	(void) close ( fd );
+	return -1;
+    }
+    return fd;
+}
+
+/*
+ * Append a histogram to a reply.
+ */
+int     histprint ( char *buf, int len, char *name, unsigned long hist [ HISTNR ] )
+{
+    int     i, n = 0;
+
+    for ( i = 0; i < HISTNR - 1; i++ )
+	n += snprintf ( buf + n, len > n ? len - n : 0, "%s_ms_lt_%d %lu\n",
+		name, 1 << i, hist[i] );
+    n += snprintf ( buf + n, len > n ? len - n : 0, "%s_ms_ge_%d %lu\n",
+	    name, 1 << ( HISTNR - 2 ), hist[HISTNR-1] );
+    return n;
+}
+
+/*
+ * The reply to a stats command.
+ */
+int     ctlstats ( char *buf, int len )
+{
+    static  double  last = 0;
+    static  long    prevvm [ VM_NR ];
+    double  t = now (), dt;
+    long    vm [ VM_NR ];
+    int     i, n = 0;
+
+    getvmstat ( vm );
+    if ( last == 0 ) {
+	last = started;
+	for ( i = 0; i < VM_NR; i++ )
+	    prevvm[i] = 0;
+    }
+    dt = t - last > 0 ? t - last : 1;
+
+    n += snprintf ( buf + n, len - n,
+	    "chunks %d\n" "draining %d\n" "pooled %d\n" "available_kb %ld\n"
+	    "adds %lu\n" "add_failures %lu\n" "removes %lu\n",
+	    chunks, chunks > 0 && swamstate[chunks-1] == SWAM_DRAINING, pooled,
+	    getswap () / 1024, adds, addfailures, removes );
+    n += histprint ( buf + n, len - n, "add_latency", addhist );
+    n += histprint ( buf + n, len - n, "remove_latency", removehist );
+    n += snprintf ( buf + n, len - n,
+	    "pswpin_per_sec %.1f\n" "pswpout_per_sec %.1f\n" "pgmajfault_per_sec %.1f\n",
+	    ( vm[VM_PSWPIN] - prevvm[VM_PSWPIN] ) / dt,
+	    ( vm[VM_PSWPOUT] - prevvm[VM_PSWPOUT] ) / dt,
+	    ( vm[VM_PGMAJFAULT] - prevvm[VM_PGMAJFAULT] ) / dt );
+    n += snprintf ( buf + n, len - n,
+	    "swap_latency_ms %.2f\n" "majfault_latency_ms %.2f\n" "swap_slow %d\n"
+	    "swap_holdoffs %lu\n",
+	    swaplatms, faultlatms, slowswap, holdoffs );
+    if ( zramid >= 0 )
+	n += snprintf ( buf + n, len - n,
+		"zram_size_kb %lu\n" "zram_used_kb %lu\n" "zram_stored_kb %lu\n"
+		"zram_written_back_pages %lu\n" "file_size_kb %lu\n" "file_used_kb %lu\n",
+		tiers[TIER_ZRAM].size / 1024, tiers[TIER_ZRAM].used / 1024,
+		tiers[TIER_ZRAM].stored / 1024, tiers[TIER_ZRAM].backed,
+		tiers[TIER_FILE].size / 1024, tiers[TIER_FILE].used / 1024 );
+    if ( hintfd >= 0 )
+	n += snprintf ( buf + n, len - n, "app_reclaims %ld\n" "app_reclaimed_kb %ld\n",
+		reclaims, reclaimed / 1024 );
+    n += snprintf ( buf + n, len - n,
+	    "lower %d\n" "upper %d\n" "size %d\n" "interval %d\n" "latency %d\n",
+	    lower, upper, chunksz, interval, swaplatmax );
+
+    last = t;
+    for ( i = 0; i < VM_NR; i++ )
+	prevvm[i] = vm[i];
+    return n;
+}
+
+/*
+ * The reply to a set command.  The new value has to pass the same checks as
+ * the command line ones, against the other current settings.
+ */
+int     ctlset ( char *key, char *val, char *buf, int len )
+{
+    char   *end = val;
+    long    v = strtol ( val, &end, 10 );
+    char   *msg = NULL;
+
+    if ( strcmp ( key, "interval" ) && strcmp ( key, "latency" ) )
+	v *= suffix ( &end );
+    if ( *end != '\0' || v < 0 || v > 0x7fffffffL )
+	msg = "bad value";
+    else if ( strcmp ( key, "lower" ) == 0 ) {
+	if ( v <= 0 || v > upper )
+	    msg = "lower limit must be positive and no more than the upper limit";
+	else
+	    lower = v;
+    } else if ( strcmp ( key, "upper" ) == 0 ) {
+	if ( v <= 0 || v < lower )
+	    msg = "upper limit must be positive and no less than the lower limit";
+	else
+	    upper = v;
+    } else if ( strcmp ( key, "size" ) == 0 ) {
+	if ( v < 2 * PAGE_SIZE || ( predict && v * GROWTH > 0x7fffffffL ) )
+	    msg = "bad size for swam files";
+	else if ( v != chunksz ) {
+	    /* the prepared swam files are the old size now */
+	    pthread_mutex_lock ( &poollock );
+	    chunksz = v;
+	    poolcleanup ();
+	    pthread_cond_signal ( &poolcond );
+	    pthread_mutex_unlock ( &poollock );
+	}
+    } else if ( strcmp ( key, "interval" ) == 0 ) {
+	interval = v;
+    } else if ( strcmp ( key, "latency" ) == 0 ) {
+	swaplatmax = v;
+    } else
+	msg = "unknown setting";
+
+    if ( msg )
+	return snprintf ( buf, len, "error %s\n", msg );
+    syslog ( LOG_INFO, "%s set to %ld", key, v );
+    return snprintf ( buf, len, "ok\n" );
+}
+
+/*
+ * Answer one command on the control socket.
+ */
+void    ctlaccept ( int lfd )
+{
+    static  char    reply [ 8192 ];
+    char    cmd [ 256 ], key [ 32 ], val [ 64 ];
+    struct  timeval tv = { 0, CTLTIMEOUT * 1000 };
+    int     fd, n;
+
+    while ( ( fd = accept4 ( lfd, NULL, NULL, SOCK_CLOEXEC ) ) >= 0 ) {
+	/* a slow client must not stall the daemon */
+	(void) setsockopt ( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+	(void) setsockopt ( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) );
+	if ( ( n = read ( fd, cmd, sizeof(cmd) - 1 ) ) <= 0 ) {
+	    (void) close ( fd );
+	    continue;
+	}
+	cmd[n] = '\0';
+	if ( strncmp ( cmd, "stats", 5 ) == 0 )
+	    n = ctlstats ( reply, sizeof(reply) );
+	else if ( sscanf ( cmd, "set %31s %63s", key, val ) == 2 )
+	    n = ctlset ( key, val, reply, sizeof(reply) );
+	else
+	    n = snprintf ( reply, sizeof(reply), "error unknown command\n" );
+	if ( n > sizeof(reply) - 1 )
+	    n = sizeof(reply) - 1;
+	(void) write ( fd, reply, n );
+	(void) close ( fd );
+    }
 }
@@ -7,9 +7,24 @@
 #  define TMPDIR	"/var/tmp"
 # endif
 
+/* The most directories swam files may be spread over */
+# ifndef MAXDIRS
+#  define MAXDIRS	8
+# endif
+
+/* The bytes written to each directory to rank them by write throughput */
+# ifndef PROBESZ
+#  define PROBESZ	(8*1024*1024)
+# endif
+
+/* The smallest mean extent (in bytes) of a swam file that is not fragmented */
+# ifndef MINEXTENT
+#  define MINEXTENT	(4*1024*1024)
+# endif
+
 /* The swam file name template to be created in the temporary directory */
 # ifndef SUFFIX
-#  define SUFFIX	"/swamd-XXX"
+#  define SUFFIX	"/swamd-XXXXXX"
 # endif
 
 /* The priority to raise program to (negative) */
@@ -22,11 +37,131 @@
 #  define INTERVAL	1
 # endif
 
+/* The interval (in seconds) between checks when waiting on pressure events */
+# ifndef EVINTERVAL
+#  define EVINTERVAL	60
+# endif
+
+/* The memory stall (in milliseconds) per window that raises a pressure event */
+# ifndef PSISTALL
+#  define PSISTALL	100
+# endif
+
+/* The window (in milliseconds) the memory stall is measured over, 500 to 10000 */
+# ifndef PSIWINDOW
+#  define PSIWINDOW	1000
+# endif
+
+/* The system wide memory pressure stall information */
+# ifndef PSIFILE
+#  define PSIFILE	"/proc/pressure/memory"
+# endif
+
 /* The maximum number of extra swam files that will be created */
 # ifndef NUMCHUNKS
 #  define NUMCHUNKS	8
 # endif
 
+/* How far ahead (in seconds) the predictive controller forecasts spare VM */
+# ifndef HORIZON
+#  define HORIZON	10
+# endif
+
+/* The largest predictive swam file, as a multiple of the swam file size */
+# ifndef GROWTH
+#  define GROWTH	8
+# endif
+
+/* How long (in seconds) spare VM must hold steady before swam is removed */
+# ifndef HOLD
+#  define HOLD		30
+# endif
+
+/* Swap ins per second above which swam is still in use and not removed */
+# ifndef SWAPINLOW
+#  define SWAPINLOW	16
+# endif
+
+/* Swap I/O latency (in milliseconds) above which no swam file is added, 0 for none */
+# ifndef SWAPLATMAX
+#  define SWAPLATMAX	20
+# endif
+
+/* Weight of the newest sample in the predictive controller's moving averages */
+# ifndef ALPHA
+#  define ALPHA		0.3
+# endif
+
+/* The swap priority of the first swam file with staged removal, newer ones get less */
+# ifndef SWAMPRIO
+#  define SWAMPRIO	16
+# endif
+
+/* A draining swam file is swapped off once this percentage of it is in use */
+# ifndef DRAINLOW
+#  define DRAINLOW	5
+# endif
+
+/* The longest (in seconds) a swam file drains before it is swapped off anyway */
+# ifndef DRAINMAX
+#  define DRAINMAX	300
+# endif
+
+/* The interval (in seconds) between checks on a draining swam file */
+# ifndef DRAINPOLL
+#  define DRAINPOLL	2
+# endif
+
+/* The swap priority of the zram tier, above all the swam files */
+# ifndef ZRAMPRIO
+#  define ZRAMPRIO	100
+# endif
+
+/* The interval (in seconds) between zram recompression and writeback passes */
+# ifndef WBINTERVAL
+#  define WBINTERVAL	300
+# endif
+
+/* The most zram pages written back per pass, 0 for no limit */
+# ifndef WBLIMIT
+#  define WBLIMIT	65536
+# endif
+
+/* The most background apps tracked for reclaim */
+# ifndef MAXAPPS
+#  define MAXAPPS	64
+# endif
+
+/* How long (in seconds) an app is in the background before it is made cold */
+# ifndef COLDAGE
+#  define COLDAGE	10
+# endif
+
+/* How long (in seconds) an app is in the background before it is paged out */
+# ifndef PAGEOUTAGE
+#  define PAGEOUTAGE	60
+# endif
+
+/* The most memory ranges passed to one process_madvise() call */
+# ifndef IOVMAX
+#  define IOVMAX	1024
+# endif
+
+/* The buckets in latency histograms: under 1, 2, 4 .. 1024 ms and the rest */
+# ifndef HISTNR
+#  define HISTNR	12
+# endif
+
+/* The longest (in milliseconds) a control socket client may take */
+# ifndef CTLTIMEOUT
+#  define CTLTIMEOUT	100
+# endif
+
+/* The number of swam files prepared in advance, ready to swapon */
+# ifndef POOLSZ
+#  define POOLSZ	1
+# endif
+
 /* The size of each extra swam file */
 # ifndef CHUNKSZ
 #  define CHUNKSZ	4 * 1024 * 1024
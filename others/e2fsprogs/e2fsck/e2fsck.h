@@ -441,6 +441,9 @@ struct e2fsck_struct {
 	/* How much are we allowed to readahead? */
 	unsigned long long readahead_kb;
 
+	/* Pass 1 prefetch threads; -1 means one per CPU, 0 disables */
+	int readahead_threads;
+
 	/*
 	 * Inodes to rebuild extent trees
 	 */
@@ -629,6 +632,14 @@ errcode_t e2fsck_readahead_dblist(ext2_filsys fs, int flags,
 				  unsigned long long count);
 int e2fsck_can_readahead(ext2_filsys fs);
 unsigned long long e2fsck_guess_readahead(ext2_filsys fs);
+#define E2FSCK_RA_MAX_THREADS	16
+struct e2fsck_ra_threads;
+struct e2fsck_ra_threads *e2fsck_readahead_threads_start(ext2_filsys fs,
+							 int nthreads,
+							 dgrp_t window);
+void e2fsck_readahead_threads_advance(struct e2fsck_ra_threads *rt,
+				      dgrp_t group);
+void e2fsck_readahead_threads_stop(struct e2fsck_ra_threads *rt);
 
 /* region.c */
 extern region_t region_create(region_addr_t min, region_addr_t max);
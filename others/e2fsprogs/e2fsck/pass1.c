@@ -119,6 +119,7 @@ struct process_inode_block {
 struct scan_callback_struct {
 	e2fsck_t	ctx;
 	char		*block_buf;
+	struct e2fsck_ra_threads *ra_threads;
 };
 
 /*
@@ -1171,6 +1172,7 @@ void e2fsck_pass1(e2fsck_t ctx)
 	int		failed_csum = 0;
 	ext2_ino_t	ino_threshold = 0;
 	dgrp_t		ra_group = 0;
+	struct e2fsck_ra_threads *ra_threads = NULL;
 	struct ea_quota	ea_ibody_quota;
 
 	init_resource_track(&rtrack, ctx->fs->io);
@@ -1181,7 +1183,17 @@ void e2fsck_pass1(e2fsck_t ctx)
 		ctx->readahead_kb = 0;
 	else if (ctx->readahead_kb == ~0ULL)
 		ctx->readahead_kb = e2fsck_guess_readahead(ctx->fs);
-	pass1_readahead(ctx, &ra_group, &ino_threshold);
+	if (ctx->readahead_kb && ctx->readahead_threads)
+		ra_threads = e2fsck_readahead_threads_start(fs,
+				ctx->readahead_threads,
+				ctx->readahead_kb * 1024 /
+				((unsigned long long) fs->blocksize *
+				 fs->inode_blocks_per_group));
+	/* The prefetch threads read the inode tables themselves */
+	if (ra_threads)
+		ino_threshold = ~0U;
+	else
+		pass1_readahead(ctx, &ra_group, &ino_threshold);
 
 	if (!(ctx->options & E2F_OPT_PREEN))
 		fix_problem(ctx, PR_1_PASS_HEADER, &pctx);
@@ -1245,7 +1257,7 @@ void e2fsck_pass1(e2fsck_t ctx)
 		return;
 	}
 	pctx.errcode = e2fsck_allocate_subcluster_bitmap(fs,
-			_("in-use block map"), EXT2FS_BMAP64_RBTREE,
+			_("in-use block map"), EXT2FS_BMAP64_HYBRID,
 			"block_found_map", &ctx->block_found_map);
 	if (pctx.errcode) {
 		pctx.num = 1;
@@ -1254,7 +1266,7 @@ void e2fsck_pass1(e2fsck_t ctx)
 		return;
 	}
 	pctx.errcode = e2fsck_allocate_block_bitmap(fs,
-			_("metadata block map"), EXT2FS_BMAP64_RBTREE,
+			_("metadata block map"), EXT2FS_BMAP64_HYBRID,
 			"block_metadata_map", &ctx->block_metadata_map);
 	if (pctx.errcode) {
 		pctx.num = 1;
@@ -1344,6 +1356,7 @@ void e2fsck_pass1(e2fsck_t ctx)
 	ctx->stashed_inode = inode;
 	scan_struct.ctx = ctx;
 	scan_struct.block_buf = block_buf;
+	scan_struct.ra_threads = ra_threads;
 	ext2fs_set_inode_callback(scan, scan_callback, &scan_struct);
 	if (ctx->progress && ((ctx->progress)(ctx, 1, 0,
 					      ctx->fs->group_desc_count)))
@@ -1983,6 +1996,8 @@ void e2fsck_pass1(e2fsck_t ctx)
 	process_inodes(ctx, block_buf);
 	ext2fs_close_inode_scan(scan);
 	scan = NULL;
+	e2fsck_readahead_threads_stop(ra_threads);
+	ra_threads = NULL;
 
 	reserve_block_for_root_repair(ctx);
 	reserve_block_for_lnf_repair(ctx);
@@ -2082,6 +2097,7 @@ void e2fsck_pass1(e2fsck_t ctx)
 	}
 	ctx->flags |= E2F_FLAG_ALLOC_OK;
 endit:
+	e2fsck_readahead_threads_stop(ra_threads);
 	e2fsck_use_inode_shortcuts(ctx, 0);
 	ext2fs_free_mem(&inodes_to_process);
 	inodes_to_process = 0;
@@ -2121,6 +2137,7 @@ static errcode_t scan_callback(ext2_filsys fs,
 	ctx = scan_struct->ctx;
 
 	process_inodes((e2fsck_t) fs->priv_data, scan_struct->block_buf);
+	e2fsck_readahead_threads_advance(scan_struct->ra_threads, group + 1);
 
 	if (ctx->progress)
 		if ((ctx->progress)(ctx, 1, group+1,
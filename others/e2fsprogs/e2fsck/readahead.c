@@ -11,8 +11,12 @@
 
 #include "config.h"
 #include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "e2fsck.h"
+#include "ext2fs/ext3_extents.h"
 
 #undef DEBUG
 
@@ -252,3 +256,292 @@ unsigned long long e2fsck_guess_readahead(ext2_filsys fs)
 
 	return 0;
 }
+
+#ifdef HAVE_PTHREAD
+/*
+ * Pass 1 prefetch threads.  The inode scan itself stays serial, since
+ * every problem it finds may be fixed interactively and changes shared
+ * state, but the I/O it waits for can be started early.  Each thread
+ * takes the next block group inside a window ahead of the scan, reads
+ * that group's inode table and issues readahead for the extent index,
+ * indirect and EA blocks of the inodes in use, so that check_blocks()
+ * finds them in the page cache.  The threads never report problems, so
+ * the output of e2fsck does not depend on the number of threads.
+ */
+struct ra_group {
+	blk64_t		itable;
+	blk_t		blocks;
+};
+
+struct e2fsck_ra_threads {
+	ext2_filsys	fs;
+	io_channel	io;
+	struct ra_group	*groups;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	dgrp_t		next;		/* next group to prefetch */
+	dgrp_t		limit;		/* don't prefetch this group or later */
+	dgrp_t		window;
+	int		stop;
+	int		nthreads;
+	pthread_t	*tids;
+};
+
+struct ra_run {
+	io_channel	io;
+	blk64_t		first, last;
+	blk64_t		run_start;
+	blk64_t		run_len;
+};
+
+static void ra_block(struct ra_run *r, blk64_t blk)
+{
+	if (blk < r->first || blk >= r->last)
+		return;
+	if (r->run_len && blk == r->run_start + r->run_len) {
+		r->run_len++;
+		return;
+	}
+	if (r->run_len)
+		io_channel_cache_readahead(r->io, r->run_start, r->run_len);
+	r->run_start = blk;
+	r->run_len = 1;
+}
+
+static void ra_inode(ext2_filsys fs, struct ra_run *r,
+		     struct ext2_inode *inode)
+{
+	__u32 flags = ext2fs_le32_to_cpu(inode->i_flags);
+	blk64_t blk;
+	int i;
+
+	if (!inode->i_links_count || inode->i_dtime)
+		return;
+
+	blk = ext2fs_le32_to_cpu(inode->i_file_acl);
+	if (ext2fs_has_feature_64bit(fs->super))
+		blk |= ((blk64_t) ext2fs_le16_to_cpu(
+				inode->osd2.linux2.l_i_file_acl_high)) << 32;
+	if (blk)
+		ra_block(r, blk);
+
+	if (flags & EXT4_INLINE_DATA_FL ||
+	    LINUX_S_ISLNK(ext2fs_le16_to_cpu(inode->i_mode)))
+		return;
+
+	if (flags & EXT4_EXTENTS_FL) {
+		struct ext3_extent_header *eh;
+		struct ext3_extent_idx *ix;
+		int entries;
+
+		eh = (struct ext3_extent_header *) inode->i_block;
+		if (ext2fs_le16_to_cpu(eh->eh_magic) != EXT3_EXT_MAGIC ||
+		    !eh->eh_depth)
+			return;
+		entries = ext2fs_le16_to_cpu(eh->eh_entries);
+		if (entries > 4)
+			entries = 4;
+		ix = EXT_FIRST_INDEX(eh);
+		for (i = 0; i < entries; i++, ix++)
+			ra_block(r, ext2fs_le32_to_cpu(ix->ei_leaf) |
+				 ((blk64_t) ext2fs_le16_to_cpu(ix->ei_leaf_hi)
+				  << 32));
+		return;
+	}
+
+	for (i = EXT2_IND_BLOCK; i <= EXT2_TIND_BLOCK; i++)
+		if (inode->i_block[i])
+			ra_block(r, ext2fs_le32_to_cpu(inode->i_block[i]));
+}
+
+static void ra_group_inodes(struct e2fsck_ra_threads *rt, dgrp_t group,
+			    char *buf, blk_t bufblocks)
+{
+	ext2_filsys fs = rt->fs;
+	unsigned int inode_size = EXT2_INODE_SIZE(fs->super);
+	struct ra_group *g = &rt->groups[group];
+	struct ra_run r;
+	blk_t done, n;
+	unsigned int i;
+
+	memset(&r, 0, sizeof(r));
+	r.io = rt->io;
+	r.first = fs->super->s_first_data_block;
+	r.last = ext2fs_blocks_count(fs->super);
+
+	for (done = 0; done < g->blocks; done += n) {
+		n = g->blocks - done;
+		if (n > bufblocks)
+			n = bufblocks;
+		/*
+		 * A negative count is a byte count; it bypasses the io
+		 * cache so the scan's cached blocks aren't evicted.
+		 */
+		if (io_channel_read_blk64(rt->io, g->itable + done,
+					  -(int) (n * fs->blocksize), buf))
+			break;
+		for (i = 0; i < n * fs->blocksize; i += inode_size)
+			ra_inode(fs, &r, (struct ext2_inode *) (buf + i));
+	}
+	if (r.run_len)
+		io_channel_cache_readahead(r.io, r.run_start, r.run_len);
+}
+
+static void *ra_thread(void *arg)
+{
+	struct e2fsck_ra_threads *rt = arg;
+	blk_t bufblocks = EXT2_INODE_SCAN_DEFAULT_BUFFER_BLOCKS;
+	char *buf;
+	dgrp_t group;
+
+	if (ext2fs_get_mem(bufblocks * rt->fs->blocksize, &buf))
+		return NULL;
+
+	pthread_mutex_lock(&rt->mutex);
+	while (!rt->stop && rt->next < rt->fs->group_desc_count) {
+		if (rt->next >= rt->limit) {
+			pthread_cond_wait(&rt->cond, &rt->mutex);
+			continue;
+		}
+		group = rt->next++;
+		pthread_mutex_unlock(&rt->mutex);
+		if (rt->groups[group].blocks)
+			ra_group_inodes(rt, group, buf, bufblocks);
+		pthread_mutex_lock(&rt->mutex);
+	}
+	pthread_mutex_unlock(&rt->mutex);
+	ext2fs_free_mem(&buf);
+	return NULL;
+}
+
+/*
+ * Start nthreads (-1: one per CPU) prefetch threads which stay at most
+ * window groups ahead of the scan.  Returns NULL if prefetching isn't
+ * possible, in which case the caller carries on without it.
+ */
+struct e2fsck_ra_threads *e2fsck_readahead_threads_start(ext2_filsys fs,
+							 int nthreads,
+							 dgrp_t window)
+{
+	struct e2fsck_ra_threads *rt;
+	unsigned int inode_size = EXT2_INODE_SIZE(fs->super);
+	dgrp_t i;
+
+	if (!(fs->io->flags & CHANNEL_FLAGS_THREADS) || nthreads == 0 ||
+	    fs->group_desc_count < 2)
+		return NULL;
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+	if (nthreads < 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	/* The threads mostly wait for I/O, so use at least two */
+	if (nthreads < 2)
+		nthreads = 2;
+	if (nthreads > E2FSCK_RA_MAX_THREADS)
+		nthreads = E2FSCK_RA_MAX_THREADS;
+	if (window < (dgrp_t) nthreads * 2)
+		window = nthreads * 2;
+
+	if (ext2fs_get_memzero(sizeof(*rt), &rt))
+		return NULL;
+	if (ext2fs_get_array(fs->group_desc_count, sizeof(*rt->groups),
+			     &rt->groups) ||
+	    ext2fs_get_array(nthreads, sizeof(*rt->tids), &rt->tids))
+		goto errout;
+
+	/* Snapshot what the threads need; pass 1 may change descriptors */
+	for (i = 0; i < fs->group_desc_count; i++) {
+		struct ra_group *g = &rt->groups[i];
+		blk64_t blocks;
+
+		g->itable = ext2fs_inode_table_loc(fs, i);
+		g->blocks = 0;
+		if (ext2fs_bg_flags_test(fs, i, EXT2_BG_INODE_UNINIT) ||
+		    ext2fs_bg_free_inodes_count(fs, i) >=
+				fs->super->s_inodes_per_group ||
+		    g->itable < fs->super->s_first_data_block)
+			continue;
+		blocks = fs->inode_blocks_per_group -
+			 ((blk64_t) ext2fs_bg_itable_unused(fs, i) *
+			  inode_size / fs->blocksize);
+		if (blocks > fs->inode_blocks_per_group ||
+		    g->itable + blocks > ext2fs_blocks_count(fs->super))
+			continue;
+		g->blocks = blocks;
+	}
+
+	rt->fs = fs;
+	rt->io = fs->io;
+	rt->window = window;
+	rt->limit = window;
+	pthread_mutex_init(&rt->mutex, NULL);
+	pthread_cond_init(&rt->cond, NULL);
+	for (i = 0; i < (dgrp_t) nthreads; i++) {
+		if (pthread_create(&rt->tids[i], NULL, ra_thread, rt))
+			break;
+		rt->nthreads++;
+	}
+	if (rt->nthreads)
+		return rt;
+
+	pthread_cond_destroy(&rt->cond);
+	pthread_mutex_destroy(&rt->mutex);
+errout:
+	ext2fs_free_mem(&rt->tids);
+	ext2fs_free_mem(&rt->groups);
+	ext2fs_free_mem(&rt);
+	return NULL;
+}
+
+/* The scan has reached group; let the threads move the window along. */
+void e2fsck_readahead_threads_advance(struct e2fsck_ra_threads *rt,
+				      dgrp_t group)
+{
+	if (!rt)
+		return;
+	pthread_mutex_lock(&rt->mutex);
+	if (group + rt->window > rt->limit) {
+		rt->limit = group + rt->window;
+		pthread_cond_broadcast(&rt->cond);
+	}
+	pthread_mutex_unlock(&rt->mutex);
+}
+
+void e2fsck_readahead_threads_stop(struct e2fsck_ra_threads *rt)
+{
+	int i;
+
+	if (!rt)
+		return;
+	pthread_mutex_lock(&rt->mutex);
+	rt->stop = 1;
+	pthread_cond_broadcast(&rt->cond);
+	pthread_mutex_unlock(&rt->mutex);
+	for (i = 0; i < rt->nthreads; i++)
+		pthread_join(rt->tids[i], NULL);
+	pthread_cond_destroy(&rt->cond);
+	pthread_mutex_destroy(&rt->mutex);
+	ext2fs_free_mem(&rt->tids);
+	ext2fs_free_mem(&rt->groups);
+	ext2fs_free_mem(&rt);
+}
+#else
+struct e2fsck_ra_threads *e2fsck_readahead_threads_start(
+			ext2_filsys fs EXT2FS_ATTR((unused)),
+			int nthreads EXT2FS_ATTR((unused)),
+			dgrp_t window EXT2FS_ATTR((unused)))
+{
+	return NULL;
+}
+
+void e2fsck_readahead_threads_advance(
+			struct e2fsck_ra_threads *rt EXT2FS_ATTR((unused)),
+			dgrp_t group EXT2FS_ATTR((unused)))
+{
+}
+
+void e2fsck_readahead_threads_stop(
+			struct e2fsck_ra_threads *rt EXT2FS_ATTR((unused)))
+{
+}
+#endif /* HAVE_PTHREAD */
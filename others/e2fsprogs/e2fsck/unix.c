@@ -665,6 +665,7 @@ static void parse_extended_opts(e2fsck_t ctx, const char *opts)
 	int	ea_ver;
 	int	extended_usage = 0;
 	unsigned long long reada_kb;
+	long	reada_threads;
 
 	buf = string_copy(ctx, opts, 0);
 	for (token = buf; token && *token; token = next) {
@@ -706,6 +707,19 @@ static void parse_extended_opts(e2fsck_t ctx, const char *opts)
 				continue;
 			}
 			ctx->readahead_kb = reada_kb;
+		} else if (strcmp(token, "readahead_threads") == 0) {
+			if (!arg) {
+				extended_usage++;
+				continue;
+			}
+			reada_threads = strtol(arg, &p, 0);
+			if (*p || reada_threads < 0) {
+				fprintf(stderr, "%s",
+					_("Invalid readahead thread count.\n"));
+				extended_usage++;
+				continue;
+			}
+			ctx->readahead_threads = reada_threads;
 		} else if (strcmp(token, "fragcheck") == 0) {
 			ctx->options |= E2F_OPT_FRAGCHECK;
 			continue;
@@ -786,6 +800,7 @@ static void parse_extended_opts(e2fsck_t ctx, const char *opts)
 		fputs("\tinode_count_fullmap\n", stderr);
 		fputs("\tno_inode_count_fullmap\n", stderr);
 		fputs(_("\treadahead_kb=<buffer size>\n"), stderr);
+		fputs(_("\treadahead_threads=<thread count>\n"), stderr);
 		fputs("\tbmap2extent\n", stderr);
 		fputs("\tunshare_blocks\n", stderr);
 		fputs("\tfixes_only\n", stderr);
@@ -853,6 +868,7 @@ static errcode_t PRS(int argc, char *argv[], e2fsck_t *ret_ctx)
 
 	phys_mem_kb = get_memory_size() / 1024;
 	ctx->readahead_kb = ~0ULL;
+	ctx->readahead_threads = -1;
 	while ((c = getopt(argc, argv, "panyrcC:B:dE:fvtFVM:b:I:j:P:l:L:N:SsDkz:")) != EOF)
 		switch (c) {
 		case 'C':
@@ -1081,6 +1097,10 @@ static errcode_t PRS(int argc, char *argv[], e2fsck_t *ret_ctx)
 		    ctx->readahead_kb > phys_mem_kb)
 			ctx->readahead_kb = phys_mem_kb;
 	}
+	if (ctx->readahead_threads < 0)
+		profile_get_integer(ctx->profile, "options",
+				    "readahead_threads", 0, -1,
+				    &ctx->readahead_threads);
 
 	/* Turn off discard in read-only mode */
 	if ((ctx->options & E2F_OPT_NO) &&
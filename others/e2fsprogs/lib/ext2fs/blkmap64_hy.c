@@ -0,0 +1,911 @@
+/*
+ * blkmap64_hy.c --- Hybrid chunked implementation for bitmaps
+ *
+ * %Begin-Header%
+ * This file may be redistributed under the terms of the GNU Public
+ * License.
+ * %End-Header%
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <fcntl.h>
+#include <time.h>
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#if HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#include "ext2_fs.h"
+#include "ext2fsP.h"
+#include "bmap64.h"
+
+/*
+ * The bitmap is cut into chunks of 64k bits, and each chunk is kept in
+ * whichever container suits its contents:
+ *
+ *	HY_EMPTY	no bit set; no memory
+ *	HY_FULL		every bit set; no memory
+ *	HY_RUNS		sorted array of maximal runs of set bits
+ *	HY_BITS		flat 8KiB bit array
+ *
+ * The flat bitarray wastes memory on huge, mostly empty or mostly full
+ * file systems, and the rbtree gets slow once the map is fragmented.
+ * Here a chunk only costs memory in proportion to its fragmentation, and
+ * never more than the bitarray would, while every lookup is an array
+ * index plus at most a binary search over one chunk's runs.
+ *
+ * A run container is turned into a bit array when it would outgrow one,
+ * and any chunk whose last bit is cleared or whose final free bit is
+ * set collapses to HY_EMPTY or HY_FULL.  Ranges loaded with
+ * set_bmap_range() are re-encoded into the smallest container, which is
+ * how block and inode bitmaps read from disk end up compact.  Range
+ * operations on bit arrays work a 64-bit word at a time.
+ */
+
+#define HY_CHUNK_BITS	16
+#define HY_CHUNK_SIZE	(1U << HY_CHUNK_BITS)
+#define HY_CHUNK_MASK	(HY_CHUNK_SIZE - 1)
+#define HY_WORDS	(HY_CHUNK_SIZE / 64)
+
+#define HY_EMPTY	0
+#define HY_FULL		1
+#define HY_RUNS		2
+#define HY_BITS		3
+
+/* An inclusive run of set bits, relative to the start of its chunk */
+struct hy_run {
+	__u16	start;
+	__u16	last;
+};
+
+/* A run container never takes more memory than a bit array */
+#define HY_MAX_RUNS	(HY_CHUNK_SIZE / 8 / sizeof(struct hy_run))
+
+struct hy_chunk {
+	__u32		card;		/* number of bits set */
+	__u16		type;
+	__u16		nruns;
+	__u16		maxruns;
+	union {
+		struct hy_run	*runs;
+		__u64		*bits;
+	} u;
+};
+
+struct ext2fs_hy_private {
+	__u64		nchunks;
+	struct hy_chunk	*chunks;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define hy_popcount(x)	__builtin_popcountll(x)
+#define hy_ctz(x)	__builtin_ctzll(x)
+#else
+static inline int hy_popcount(__u64 x)
+{
+	int n = 0;
+
+	for (; x; x &= x - 1)
+		n++;
+	return n;
+}
+
+static inline int hy_ctz(__u64 x)
+{
+	int n = 0;
+
+	for (; !(x & 1); x >>= 1)
+		n++;
+	return n;
+}
+#endif
+
+static __u64 hy_nchunks(__u64 start, __u64 real_end)
+{
+	return ((real_end - start) >> HY_CHUNK_BITS) + 1;
+}
+
+static void hy_chunk_free(struct hy_chunk *c)
+{
+	if (c->type == HY_RUNS)
+		ext2fs_free_mem(&c->u.runs);
+	else if (c->type == HY_BITS)
+		ext2fs_free_mem(&c->u.bits);
+	memset(c, 0, sizeof(*c));
+}
+
+/*
+ * Word helpers for bit arrays.  Bit i of a chunk is bit (i % 64) of
+ * word (i / 64).  first and last are inclusive.
+ */
+static inline __u64 hy_mask(unsigned int first, unsigned int last)
+{
+	return (~0ULL << (first & 63)) & (~0ULL >> (63 - (last & 63)));
+}
+
+static unsigned int bits_set(__u64 *w, unsigned int first, unsigned int last)
+{
+	unsigned int i, added = 0;
+	__u64 m;
+
+	for (i = first >> 6; i <= last >> 6; i++) {
+		m = hy_mask(i == first >> 6 ? first : 0,
+			    i == last >> 6 ? last : 63);
+		added += hy_popcount(m & ~w[i]);
+		w[i] |= m;
+	}
+	return added;
+}
+
+static unsigned int bits_clear(__u64 *w, unsigned int first,
+			       unsigned int last)
+{
+	unsigned int i, removed = 0;
+	__u64 m;
+
+	for (i = first >> 6; i <= last >> 6; i++) {
+		m = hy_mask(i == first >> 6 ? first : 0,
+			    i == last >> 6 ? last : 63);
+		removed += hy_popcount(m & w[i]);
+		w[i] &= ~m;
+	}
+	return removed;
+}
+
+/* Find the first bit equal to set in [first, last]; -1 if none */
+static int bits_find(const __u64 *w, unsigned int first, unsigned int last,
+		     int set)
+{
+	unsigned int i;
+	__u64 x;
+
+	for (i = first >> 6; i <= last >> 6; i++) {
+		x = set ? w[i] : ~w[i];
+		x &= hy_mask(i == first >> 6 ? first : 0,
+			     i == last >> 6 ? last : 63);
+		if (x)
+			return (i << 6) + hy_ctz(x);
+	}
+	return -1;
+}
+
+/* Index of the first run whose last bit is at or after bit */
+static unsigned int runs_search(const struct hy_chunk *c, unsigned int bit)
+{
+	unsigned int lo = 0, hi = c->nruns, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (c->u.runs[mid].last < bit)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static errcode_t runs_reserve(struct hy_chunk *c, unsigned int nruns)
+{
+	unsigned int newmax;
+	errcode_t retval;
+
+	if (nruns <= c->maxruns)
+		return 0;
+	newmax = c->maxruns ? c->maxruns * 2 : 4;
+	if (newmax > HY_MAX_RUNS)
+		newmax = HY_MAX_RUNS;
+	retval = ext2fs_resize_mem(c->maxruns * sizeof(struct hy_run),
+				   newmax * sizeof(struct hy_run), &c->u.runs);
+	if (retval)
+		return retval;
+	c->maxruns = newmax;
+	return 0;
+}
+
+/* Expand any container into a bit array of HY_WORDS words */
+static void hy_expand(const struct hy_chunk *c, __u64 *w)
+{
+	unsigned int i;
+
+	switch (c->type) {
+	case HY_EMPTY:
+		memset(w, 0, HY_CHUNK_SIZE / 8);
+		break;
+	case HY_FULL:
+		memset(w, 0xff, HY_CHUNK_SIZE / 8);
+		break;
+	case HY_RUNS:
+		memset(w, 0, HY_CHUNK_SIZE / 8);
+		for (i = 0; i < c->nruns; i++)
+			bits_set(w, c->u.runs[i].start, c->u.runs[i].last);
+		break;
+	case HY_BITS:
+		memcpy(w, c->u.bits, HY_CHUNK_SIZE / 8);
+		break;
+	}
+}
+
+static errcode_t hy_to_bits(struct hy_chunk *c)
+{
+	errcode_t retval;
+	__u64 *w;
+
+	retval = ext2fs_get_mem(HY_CHUNK_SIZE / 8, &w);
+	if (retval)
+		return retval;
+	hy_expand(c, w);
+	if (c->type == HY_RUNS)
+		ext2fs_free_mem(&c->u.runs);
+	c->type = HY_BITS;
+	c->nruns = c->maxruns = 0;
+	c->u.bits = w;
+	return 0;
+}
+
+/* Collapse chunks that became empty or full */
+static void hy_settle(struct hy_chunk *c)
+{
+	if (c->card == 0) {
+		hy_chunk_free(c);
+	} else if (c->card == HY_CHUNK_SIZE && c->type != HY_FULL) {
+		hy_chunk_free(c);
+		c->type = HY_FULL;
+		c->card = HY_CHUNK_SIZE;
+	}
+}
+
+/*
+ * Re-encode a chunk from the bit array w, picking the smallest
+ * container.  w is consumed if the chunk keeps it as a bit array.
+ */
+static errcode_t hy_encode(struct hy_chunk *c, __u64 **wp)
+{
+	__u64 *w = *wp;
+	unsigned int i, card = 0, nruns = 0;
+	int start, bit;
+	errcode_t retval;
+
+	for (i = 0; i < HY_WORDS; i++) {
+		card += hy_popcount(w[i]);
+		/* Count the 0 -> 1 transitions, carrying in from below */
+		nruns += hy_popcount(w[i] &
+			~((w[i] << 1) | (i ? w[i - 1] >> 63 : 0)));
+	}
+
+	hy_chunk_free(c);
+	c->card = card;
+	if (card == 0)
+		return 0;
+	if (card == HY_CHUNK_SIZE) {
+		c->type = HY_FULL;
+		return 0;
+	}
+	if (nruns > HY_MAX_RUNS / 2) {
+		c->type = HY_BITS;
+		c->u.bits = w;
+		*wp = NULL;
+		return 0;
+	}
+
+	c->type = HY_RUNS;
+	retval = ext2fs_get_array(nruns, sizeof(struct hy_run), &c->u.runs);
+	if (retval) {
+		c->type = HY_EMPTY;
+		c->card = 0;
+		return retval;
+	}
+	c->maxruns = nruns;
+	for (bit = 0; bit < (int) HY_CHUNK_SIZE; ) {
+		start = bits_find(w, bit, HY_CHUNK_MASK, 1);
+		if (start < 0)
+			break;
+		bit = bits_find(w, start, HY_CHUNK_MASK, 0);
+		if (bit < 0)
+			bit = HY_CHUNK_SIZE;
+		c->u.runs[c->nruns].start = start;
+		c->u.runs[c->nruns].last = bit - 1;
+		c->nruns++;
+	}
+	return 0;
+}
+
+/* Set [first, last] in a chunk; returns the number of bits newly set */
+static unsigned int hy_chunk_set(struct hy_chunk *c, unsigned int first,
+				 unsigned int last)
+{
+	unsigned int i, j, k, added, covered = 0;
+	struct hy_run *r;
+
+	if (c->type == HY_FULL)
+		return 0;
+	if (first == 0 && last == HY_CHUNK_MASK) {
+		added = HY_CHUNK_SIZE - c->card;
+		hy_chunk_free(c);
+		c->type = HY_FULL;
+		c->card = HY_CHUNK_SIZE;
+		return added;
+	}
+	if (c->type == HY_EMPTY)
+		c->type = HY_RUNS;
+
+	if (c->type == HY_RUNS) {
+		/* Runs i..j-1 overlap or touch [first, last] */
+		i = runs_search(c, first ? first - 1 : 0);
+		for (j = i; j < c->nruns && c->u.runs[j].start <= last + 1; j++)
+			;
+		if (i == j && (c->nruns >= HY_MAX_RUNS ||
+			       runs_reserve(c, c->nruns + 1))) {
+			/* Out of runs (or memory for them) */
+			if (hy_to_bits(c))
+				return 0;
+			goto bits;
+		}
+		r = c->u.runs;
+		if (i == j) {
+			memmove(&r[i + 1], &r[i],
+				(c->nruns - i) * sizeof(struct hy_run));
+			c->nruns++;
+			r[i].start = first;
+			r[i].last = last;
+			added = last - first + 1;
+		} else {
+			for (k = i; k < j; k++)
+				covered += r[k].last - r[k].start + 1;
+			if (r[i].start < first)
+				first = r[i].start;
+			if (r[j - 1].last > last)
+				last = r[j - 1].last;
+			added = last - first + 1 - covered;
+			r[i].start = first;
+			r[i].last = last;
+			memmove(&r[i + 1], &r[j],
+				(c->nruns - j) * sizeof(struct hy_run));
+			c->nruns -= j - i - 1;
+		}
+		c->card += added;
+		hy_settle(c);
+		return added;
+	}
+bits:
+	added = bits_set(c->u.bits, first, last);
+	c->card += added;
+	hy_settle(c);
+	return added;
+}
+
+/* Clear [first, last] in a chunk; returns the number of bits cleared */
+static unsigned int hy_chunk_clear(struct hy_chunk *c, unsigned int first,
+				   unsigned int last)
+{
+	unsigned int i, j, removed = 0;
+	struct hy_run *r;
+
+	if (c->type == HY_EMPTY)
+		return 0;
+	if (first == 0 && last == HY_CHUNK_MASK) {
+		removed = c->card;
+		hy_chunk_free(c);
+		return removed;
+	}
+	if (c->type == HY_FULL) {
+		c->type = HY_RUNS;
+		if (runs_reserve(c, 1)) {
+			c->type = HY_FULL;
+			return 0;
+		}
+		c->u.runs[0].start = 0;
+		c->u.runs[0].last = HY_CHUNK_MASK;
+		c->nruns = 1;
+	}
+
+	if (c->type == HY_RUNS) {
+		i = runs_search(c, first);
+		r = c->u.runs;
+		if (i < c->nruns && r[i].start < first && r[i].last > last) {
+			/* Punch a hole in the middle of one run */
+			if (c->nruns >= HY_MAX_RUNS ||
+			    runs_reserve(c, c->nruns + 1)) {
+				if (hy_to_bits(c))
+					return 0;
+				goto bits;
+			}
+			r = c->u.runs;
+			memmove(&r[i + 1], &r[i],
+				(c->nruns - i) * sizeof(struct hy_run));
+			c->nruns++;
+			r[i].last = first - 1;
+			r[i + 1].start = last + 1;
+			removed = last - first + 1;
+		} else {
+			if (i < c->nruns && r[i].start < first) {
+				removed += r[i].last - first + 1;
+				r[i].last = first - 1;
+				i++;
+			}
+			for (j = i; j < c->nruns && r[j].last <= last; j++)
+				removed += r[j].last - r[j].start + 1;
+			if (j < c->nruns && r[j].start <= last) {
+				removed += last - r[j].start + 1;
+				r[j].start = last + 1;
+			}
+			memmove(&r[i], &r[j],
+				(c->nruns - j) * sizeof(struct hy_run));
+			c->nruns -= j - i;
+		}
+		c->card -= removed;
+		hy_settle(c);
+		return removed;
+	}
+bits:
+	removed = bits_clear(c->u.bits, first, last);
+	c->card -= removed;
+	hy_settle(c);
+	return removed;
+}
+
+static int hy_chunk_test(const struct hy_chunk *c, unsigned int bit)
+{
+	unsigned int i;
+
+	switch (c->type) {
+	case HY_FULL:
+		return 1;
+	case HY_RUNS:
+		i = runs_search(c, bit);
+		return i < c->nruns && c->u.runs[i].start <= bit;
+	case HY_BITS:
+		return (c->u.bits[bit >> 6] >> (bit & 63)) & 1;
+	}
+	return 0;
+}
+
+/* First bit equal to set in [first, last] of a chunk; -1 if none */
+static int hy_chunk_find(const struct hy_chunk *c, unsigned int first,
+			 unsigned int last, int set)
+{
+	unsigned int i;
+
+	switch (c->type) {
+	case HY_EMPTY:
+		return set ? -1 : (int) first;
+	case HY_FULL:
+		return set ? (int) first : -1;
+	case HY_RUNS:
+		i = runs_search(c, first);
+		if (set) {
+			if (i == c->nruns || c->u.runs[i].start > last)
+				return -1;
+			return c->u.runs[i].start > first ?
+				c->u.runs[i].start : first;
+		}
+		if (i == c->nruns || c->u.runs[i].start > first)
+			return first;
+		/* Runs are maximal, so the bit after one is clear */
+		if (c->u.runs[i].last >= last)
+			return -1;
+		return c->u.runs[i].last + 1;
+	case HY_BITS:
+		return bits_find(c->u.bits, first, last, set);
+	}
+	return -1;
+}
+
+/*
+ * Walk the chunks covering num bits from bitmap-relative bit start,
+ * running body with c, first and last (chunk-relative, inclusive) set.
+ */
+#define HY_FOR_EACH_PIECE(bp, start, num, c, first, last, body)		\
+	do {								\
+		__u64 _bit = (start), _left = (num);			\
+		while (_left) {						\
+			__u64 _n;					\
+			(c) = &(bp)->chunks[_bit >> HY_CHUNK_BITS];	\
+			(first) = _bit & HY_CHUNK_MASK;			\
+			_n = HY_CHUNK_SIZE - (first);			\
+			if (_n > _left)					\
+				_n = _left;				\
+			(last) = (first) + _n - 1;			\
+			body;						\
+			_bit += _n;					\
+			_left -= _n;					\
+		}							\
+	} while (0)
+
+static errcode_t hy_new_bmap(ext2_filsys fs EXT2FS_ATTR((unused)),
+			     ext2fs_generic_bitmap_64 bitmap)
+{
+	struct ext2fs_hy_private *bp;
+	errcode_t retval;
+
+	retval = ext2fs_get_memzero(sizeof(struct ext2fs_hy_private), &bp);
+	if (retval)
+		return retval;
+	bp->nchunks = hy_nchunks(bitmap->start, bitmap->real_end);
+	retval = ext2fs_get_arrayzero(bp->nchunks, sizeof(struct hy_chunk),
+				      &bp->chunks);
+	if (retval) {
+		ext2fs_free_mem(&bp);
+		return retval;
+	}
+	bitmap->private = (void *) bp;
+	return 0;
+}
+
+static void hy_free_bmap(ext2fs_generic_bitmap_64 bitmap)
+{
+	struct ext2fs_hy_private *bp;
+	__u64 i;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	if (!bp)
+		return;
+	for (i = 0; i < bp->nchunks; i++)
+		hy_chunk_free(&bp->chunks[i]);
+	ext2fs_free_mem(&bp->chunks);
+	ext2fs_free_mem(&bp);
+	bitmap->private = NULL;
+}
+
+static errcode_t hy_copy_bmap(ext2fs_generic_bitmap_64 src,
+			      ext2fs_generic_bitmap_64 dest)
+{
+	struct ext2fs_hy_private *src_bp, *dest_bp;
+	struct hy_chunk *s, *d;
+	errcode_t retval;
+	__u64 i;
+
+	src_bp = (struct ext2fs_hy_private *) src->private;
+	retval = hy_new_bmap(src->fs, dest);
+	if (retval)
+		return retval;
+	dest_bp = (struct ext2fs_hy_private *) dest->private;
+
+	for (i = 0; i < src_bp->nchunks; i++) {
+		s = &src_bp->chunks[i];
+		d = &dest_bp->chunks[i];
+		*d = *s;
+		if (s->type == HY_RUNS) {
+			retval = ext2fs_get_array(s->maxruns,
+						  sizeof(struct hy_run),
+						  &d->u.runs);
+			if (!retval)
+				memcpy(d->u.runs, s->u.runs,
+				       s->nruns * sizeof(struct hy_run));
+		} else if (s->type == HY_BITS) {
+			retval = ext2fs_get_mem(HY_CHUNK_SIZE / 8, &d->u.bits);
+			if (!retval)
+				memcpy(d->u.bits, s->u.bits, HY_CHUNK_SIZE / 8);
+		}
+		if (retval) {
+			memset(d, 0, sizeof(*d));
+			hy_free_bmap(dest);
+			return retval;
+		}
+	}
+	return 0;
+}
+
+static errcode_t hy_resize_bmap(ext2fs_generic_bitmap_64 bmap,
+				__u64 new_end, __u64 new_real_end)
+{
+	struct ext2fs_hy_private *bp = (struct ext2fs_hy_private *) bmap->private;
+	__u64 keep, nchunks, i;
+	unsigned int first, last;
+	struct hy_chunk *c;
+	errcode_t retval;
+
+	/* Nothing past the smaller end survives, as for the bit array */
+	keep = (new_end < bmap->end ? new_end : bmap->end) - bmap->start + 1;
+	if (keep < bmap->real_end - bmap->start + 1)
+		HY_FOR_EACH_PIECE(bp, keep, bmap->real_end - bmap->start + 1 -
+				  keep, c, first, last,
+				  hy_chunk_clear(c, first, last));
+
+	nchunks = hy_nchunks(bmap->start, new_real_end);
+	if (nchunks != bp->nchunks) {
+		for (i = nchunks; i < bp->nchunks; i++)
+			hy_chunk_free(&bp->chunks[i]);
+		retval = ext2fs_resize_mem(bp->nchunks * sizeof(struct hy_chunk),
+					   nchunks * sizeof(struct hy_chunk),
+					   &bp->chunks);
+		if (retval)
+			return retval;
+		if (nchunks > bp->nchunks)
+			memset(bp->chunks + bp->nchunks, 0,
+			       (nchunks - bp->nchunks) * sizeof(struct hy_chunk));
+		bp->nchunks = nchunks;
+	}
+
+	bmap->end = new_end;
+	bmap->real_end = new_real_end;
+	return 0;
+}
+
+static int hy_mark_bmap(ext2fs_generic_bitmap_64 bitmap, __u64 arg)
+{
+	struct ext2fs_hy_private *bp;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	arg -= bitmap->start;
+
+	return !hy_chunk_set(&bp->chunks[arg >> HY_CHUNK_BITS],
+			     arg & HY_CHUNK_MASK, arg & HY_CHUNK_MASK);
+}
+
+static int hy_unmark_bmap(ext2fs_generic_bitmap_64 bitmap, __u64 arg)
+{
+	struct ext2fs_hy_private *bp;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	arg -= bitmap->start;
+
+	return hy_chunk_clear(&bp->chunks[arg >> HY_CHUNK_BITS],
+			      arg & HY_CHUNK_MASK, arg & HY_CHUNK_MASK);
+}
+
+static int hy_test_bmap(ext2fs_generic_bitmap_64 bitmap, __u64 arg)
+{
+	struct ext2fs_hy_private *bp;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	arg -= bitmap->start;
+
+	return hy_chunk_test(&bp->chunks[arg >> HY_CHUNK_BITS],
+			     arg & HY_CHUNK_MASK);
+}
+
+static void hy_mark_bmap_extent(ext2fs_generic_bitmap_64 bitmap, __u64 arg,
+				unsigned int num)
+{
+	struct ext2fs_hy_private *bp;
+	unsigned int first, last;
+	struct hy_chunk *c;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	HY_FOR_EACH_PIECE(bp, arg - bitmap->start, num, c, first, last,
+			  hy_chunk_set(c, first, last));
+}
+
+static void hy_unmark_bmap_extent(ext2fs_generic_bitmap_64 bitmap, __u64 arg,
+				  unsigned int num)
+{
+	struct ext2fs_hy_private *bp;
+	unsigned int first, last;
+	struct hy_chunk *c;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	HY_FOR_EACH_PIECE(bp, arg - bitmap->start, num, c, first, last,
+			  hy_chunk_clear(c, first, last));
+}
+
+static int hy_test_clear_bmap_extent(ext2fs_generic_bitmap_64 bitmap,
+				     __u64 start, unsigned int len)
+{
+	struct ext2fs_hy_private *bp;
+	unsigned int first, last;
+	struct hy_chunk *c;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	HY_FOR_EACH_PIECE(bp, start - bitmap->start, len, c, first, last,
+		if (hy_chunk_find(c, first, last, 1) >= 0)
+			return 0);
+	return 1;
+}
+
+/* Copy n bits from chunk words w at off to the byte array out at pos */
+static void hy_get_bits(const __u64 *w, unsigned int off, unsigned char *out,
+			__u64 pos, unsigned int n)
+{
+	unsigned int i;
+
+	if (((off | pos) & 7) == 0) {
+		for (i = 0; i + 8 <= n; i += 8)
+			out[(pos + i) >> 3] = w[(off + i) >> 6] >>
+					      ((off + i) & 63);
+	} else
+		i = 0;
+	for (; i < n; i++) {
+		if ((w[(off + i) >> 6] >> ((off + i) & 63)) & 1)
+			ext2fs_fast_set_bit64(pos + i, out);
+		else
+			ext2fs_fast_clear_bit64(pos + i, out);
+	}
+}
+
+/* Set or clear n bits of the byte array out from pos */
+static void hy_fill_bits(unsigned char *out, __u64 pos, unsigned int n,
+			 int set)
+{
+	for (; n && (pos & 7); n--, pos++)
+		if (set)
+			ext2fs_fast_set_bit64(pos, out);
+		else
+			ext2fs_fast_clear_bit64(pos, out);
+	memset(out + (pos >> 3), set ? 0xff : 0, n >> 3);
+	pos += n & ~7U;
+	for (n &= 7; n; n--, pos++)
+		if (set)
+			ext2fs_fast_set_bit64(pos, out);
+		else
+			ext2fs_fast_clear_bit64(pos, out);
+}
+
+static errcode_t hy_set_bmap_range(ext2fs_generic_bitmap_64 bitmap,
+				   __u64 start, size_t num, void *in)
+{
+	struct ext2fs_hy_private *bp;
+	const unsigned char *cp = in;
+	unsigned int first, last, i;
+	struct hy_chunk *c;
+	errcode_t retval = 0;
+	__u64 pos = 0, *w = NULL;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+
+	HY_FOR_EACH_PIECE(bp, start - bitmap->start, num, c, first, last,
+		if (!w) {
+			retval = ext2fs_get_mem(HY_CHUNK_SIZE / 8, &w);
+			if (retval)
+				return retval;
+		}
+		if (first || last != HY_CHUNK_MASK)
+			hy_expand(c, w);
+		i = first;
+		if (((first | pos) & 7) == 0) {
+			for (; i + 7 <= last; i += 8, pos += 8) {
+				w[i >> 6] &= ~(0xffULL << (i & 63));
+				w[i >> 6] |= (__u64) cp[pos >> 3] << (i & 63);
+			}
+		}
+		for (; i <= last; i++, pos++) {
+			if (ext2fs_test_bit64(pos, cp))
+				w[i >> 6] |= 1ULL << (i & 63);
+			else
+				w[i >> 6] &= ~(1ULL << (i & 63));
+		}
+		retval = hy_encode(c, &w);
+		if (retval)
+			break);
+
+	if (w)
+		ext2fs_free_mem(&w);
+	return retval;
+}
+
+static errcode_t hy_get_bmap_range(ext2fs_generic_bitmap_64 bitmap,
+				   __u64 start, size_t num, void *out)
+{
+	struct ext2fs_hy_private *bp;
+	unsigned int first, last;
+	struct hy_chunk *c;
+	__u64 pos = 0, *w = NULL;
+	errcode_t retval;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+
+	HY_FOR_EACH_PIECE(bp, start - bitmap->start, num, c, first, last,
+		switch (c->type) {
+		case HY_BITS:
+			hy_get_bits(c->u.bits, first, out, pos,
+				    last - first + 1);
+			break;
+		case HY_RUNS:
+			if (!w) {
+				retval = ext2fs_get_mem(HY_CHUNK_SIZE / 8, &w);
+				if (retval)
+					return retval;
+			}
+			hy_expand(c, w);
+			hy_get_bits(w, first, out, pos, last - first + 1);
+			break;
+		default:
+			hy_fill_bits(out, pos, last - first + 1,
+				     c->type == HY_FULL);
+		}
+		pos += last - first + 1);
+
+	if (w)
+		ext2fs_free_mem(&w);
+	return 0;
+}
+
+static void hy_clear_bmap(ext2fs_generic_bitmap_64 bitmap)
+{
+	struct ext2fs_hy_private *bp;
+	__u64 i;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	for (i = 0; i < bp->nchunks; i++)
+		hy_chunk_free(&bp->chunks[i]);
+}
+
+#ifdef ENABLE_BMAP_STATS
+static void hy_print_stats(ext2fs_generic_bitmap_64 bitmap)
+{
+	struct ext2fs_hy_private *bp;
+	__u64 count[4] = { 0, 0, 0, 0 }, runs = 0, bytes, i;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	for (i = 0; i < bp->nchunks; i++) {
+		count[bp->chunks[i].type]++;
+		runs += bp->chunks[i].maxruns;
+	}
+	bytes = sizeof(struct ext2fs_hy_private) +
+		bp->nchunks * sizeof(struct hy_chunk) +
+		runs * sizeof(struct hy_run) + count[HY_BITS] * HY_CHUNK_SIZE / 8;
+
+	fprintf(stderr, "%16llu empty, %llu full, %llu run and %llu bit "
+		"array chunks\n", (unsigned long long) count[HY_EMPTY],
+		(unsigned long long) count[HY_FULL],
+		(unsigned long long) count[HY_RUNS],
+		(unsigned long long) count[HY_BITS]);
+	fprintf(stderr, "%16llu Bytes used by hybrid bitmap\n",
+		(unsigned long long) bytes);
+}
+#else
+static void hy_print_stats(ext2fs_generic_bitmap_64 bitmap EXT2FS_ATTR((unused)))
+{
+}
+#endif
+
+static errcode_t hy_find_first(ext2fs_generic_bitmap_64 bitmap,
+			       __u64 start, __u64 end, __u64 *out, int set)
+{
+	struct ext2fs_hy_private *bp;
+	unsigned int first, last;
+	struct hy_chunk *c;
+	__u64 base = start - bitmap->start;
+	int found;
+
+	bp = (struct ext2fs_hy_private *) bitmap->private;
+	HY_FOR_EACH_PIECE(bp, base, end - start + 1, c, first, last,
+		found = hy_chunk_find(c, first, last, set);
+		if (found >= 0) {
+			*out = bitmap->start +
+			       ((__u64) (c - bp->chunks) << HY_CHUNK_BITS) +
+			       found;
+			return 0;
+		});
+	return ENOENT;
+}
+
+/* Find the first zero bit between start and end, inclusive. */
+static errcode_t hy_find_first_zero(ext2fs_generic_bitmap_64 bitmap,
+				    __u64 start, __u64 end, __u64 *out)
+{
+	return hy_find_first(bitmap, start, end, out, 0);
+}
+
+/* Find the first one bit between start and end, inclusive. */
+static errcode_t hy_find_first_set(ext2fs_generic_bitmap_64 bitmap,
+				   __u64 start, __u64 end, __u64 *out)
+{
+	return hy_find_first(bitmap, start, end, out, 1);
+}
+
+struct ext2_bitmap_ops ext2fs_blkmap64_hybrid = {
+	.type = EXT2FS_BMAP64_HYBRID,
+	.new_bmap = hy_new_bmap,
+	.free_bmap = hy_free_bmap,
+	.copy_bmap = hy_copy_bmap,
+	.resize_bmap = hy_resize_bmap,
+	.mark_bmap = hy_mark_bmap,
+	.unmark_bmap = hy_unmark_bmap,
+	.test_bmap = hy_test_bmap,
+	.test_clear_bmap_extent = hy_test_clear_bmap_extent,
+	.mark_bmap_extent = hy_mark_bmap_extent,
+	.unmark_bmap_extent = hy_unmark_bmap_extent,
+	.set_bmap_range = hy_set_bmap_range,
+	.get_bmap_range = hy_get_bmap_range,
+	.clear_bmap = hy_clear_bmap,
+	.print_stats = hy_print_stats,
+	.find_first_zero = hy_find_first_zero,
+	.find_first_set = hy_find_first_set
+};
@@ -32,6 +32,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #define min(x, y)		((x) > (y) ? (y) : (x))
 #define __ALIGN_KERNEL_MASK(x, mask)	(((x) + (mask)) & ~(mask))
 #define __ALIGN_KERNEL(x, a)	__ALIGN_KERNEL_MASK(x, (__typeof__(x))(a) - 1)
@@ -183,11 +184,126 @@ static inline uint32_t crc32_le_generic(uint32_t crc, unsigned char const *p,
 	return crc;
 }
 
-uint32_t ext2fs_crc32c_le(uint32_t crc, unsigned char const *p, size_t len)
+static uint32_t crc32c_le_sw(uint32_t crc, unsigned char const *p, size_t len)
 {
 	return crc32_le_generic(crc, p, len, crc32ctable_le, CRC32C_POLY_LE);
 }
 
+/*
+ * Both x86 (SSE4.2) and ARMv8 have an instruction that folds 1, 2, 4
+ * or 8 bytes into a crc32c at a time.  They use the same reflected
+ * polynomial and bit order as crc32c_le_sw(), so the results are
+ * interchangeable.  The compiler is told to generate the instruction
+ * for these functions only; whether the CPU really has it is checked
+ * once at runtime in crc32c_le_init().
+ */
+#if !defined(WORDS_BIGENDIAN) && defined(__GNUC__) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32C_HW
+#define CRC32C_HW_TARGET	__attribute__((target("sse4.2")))
+#define crc32c_hw_u8(crc, v)	__builtin_ia32_crc32qi((crc), (v))
+#define crc32c_hw_u16(crc, v)	__builtin_ia32_crc32hi((crc), (v))
+#define crc32c_hw_u32(crc, v)	__builtin_ia32_crc32si((crc), (v))
+#ifdef __x86_64__
+#define crc32c_hw_u64(crc, v)	((uint32_t) __builtin_ia32_crc32di((crc), (v)))
+#endif
+#define crc32c_hw_supported()	(__builtin_cpu_init(), \
+				 __builtin_cpu_supports("sse4.2"))
+#elif !defined(WORDS_BIGENDIAN) && defined(__GNUC__) && \
+	defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32		(1 << 7)
+#endif
+#define HAVE_CRC32C_HW
+#ifdef __clang__
+#define CRC32C_HW_TARGET	__attribute__((target("crc")))
+#define crc32c_hw_u8(crc, v)	__builtin_arm_crc32cb((crc), (v))
+#define crc32c_hw_u16(crc, v)	__builtin_arm_crc32ch((crc), (v))
+#define crc32c_hw_u32(crc, v)	__builtin_arm_crc32cw((crc), (v))
+#define crc32c_hw_u64(crc, v)	__builtin_arm_crc32cd((crc), (v))
+#else
+#define CRC32C_HW_TARGET	__attribute__((target("+crc")))
+#define crc32c_hw_u8(crc, v)	__builtin_aarch64_crc32cb((crc), (v))
+#define crc32c_hw_u16(crc, v)	__builtin_aarch64_crc32ch((crc), (v))
+#define crc32c_hw_u32(crc, v)	__builtin_aarch64_crc32cw((crc), (v))
+#define crc32c_hw_u64(crc, v)	__builtin_aarch64_crc32cx((crc), (v))
+#endif
+#define crc32c_hw_supported()	(getauxval(AT_HWCAP) & HWCAP_CRC32)
+#endif
+
+#ifdef HAVE_CRC32C_HW
+CRC32C_HW_TARGET
+static uint32_t crc32c_le_hw(uint32_t crc, unsigned char const *p, size_t len)
+{
+	/* The loads below are unaligned-safe on both architectures */
+	if (len >= 8) {
+		while ((unsigned long) p & 7) {
+			crc = crc32c_hw_u8(crc, *p++);
+			len--;
+		}
+	}
+#ifdef crc32c_hw_u64
+	while (len >= 8) {
+		uint64_t q;
+
+		memcpy(&q, p, sizeof(q));
+		crc = crc32c_hw_u64(crc, q);
+		p += 8;
+		len -= 8;
+	}
+#endif
+	while (len >= 4) {
+		uint32_t w;
+
+		memcpy(&w, p, sizeof(w));
+		crc = crc32c_hw_u32(crc, w);
+		p += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		uint16_t h;
+
+		memcpy(&h, p, sizeof(h));
+		crc = crc32c_hw_u16(crc, h);
+		p += 2;
+		len -= 2;
+	}
+	if (len)
+		crc = crc32c_hw_u8(crc, *p);
+	return crc;
+}
+#endif
+
+static uint32_t crc32c_le_init(uint32_t crc, unsigned char const *p,
+			       size_t len);
+
+/*
+ * Chosen on first use.  Racing threads all store the same value, so
+ * no locking is needed.
+ */
+static uint32_t (*crc32c_le_fn)(uint32_t, unsigned char const *, size_t) =
+	crc32c_le_init;
+
+static uint32_t crc32c_le_init(uint32_t crc, unsigned char const *p,
+			       size_t len)
+{
+	uint32_t (*fn)(uint32_t, unsigned char const *, size_t) =
+		crc32c_le_sw;
+
+#ifdef HAVE_CRC32C_HW
+	if (crc32c_hw_supported())
+		fn = crc32c_le_hw;
+#endif
+	crc32c_le_fn = fn;
+	return fn(crc, p, len);
+}
+
+uint32_t ext2fs_crc32c_le(uint32_t crc, unsigned char const *p, size_t len)
+{
+	return crc32c_le_fn(crc, p, len);
+}
+
 /**
  * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
  * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
@@ -894,14 +1010,15 @@ static struct crc_test {
 	{0, 0, 0, 0, 0},
 };
 
-static int test_crc32c(void)
+static int test_crc32c(uint32_t (*crc32c_le)(uint32_t, unsigned char const *,
+					    size_t))
 {
 	struct crc_test *t = test;
 	int failures = 0;
 
 	while (t->length) {
 		uint32_t be, le;
-		le = ext2fs_crc32c_le(t->crc, test_buf + t->start, t->length);
+		le = crc32c_le(t->crc, test_buf + t->start, t->length);
 		be = ext2fs_crc32_be(t->crc, test_buf + t->start, t->length);
 		if (le != t->crc32c_le) {
 			printf("Test %d LE fails, %x != %x\n",
@@ -923,7 +1040,14 @@ int main(int argc, char *argv[])
 {
 	int ret;
 
-	ret = test_crc32c();
+	ret = test_crc32c(crc32c_le_sw);
+	ret += test_crc32c(ext2fs_crc32c_le);
+#ifdef HAVE_CRC32C_HW
+	if (crc32c_hw_supported())
+		ret += test_crc32c(crc32c_le_hw);
+	else
+		printf("No hardware crc32c on this CPU.\n");
+#endif
 	if (!ret)
 		printf("No failures.\n");
 
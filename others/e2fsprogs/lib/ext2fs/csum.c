@@ -618,54 +618,57 @@ errcode_t ext2fs_block_bitmap_csum_set(ext2_filsys fs, dgrp_t group,
 	return 0;
 }
 
-static errcode_t ext2fs_inode_csum(ext2_filsys fs, ext2_ino_t inum,
-			       struct ext2_inode_large *inode,
-			       __u32 *crc, int has_hi)
+/*
+ * The checksum fields are summed as zeroes.  Rather than clearing them
+ * and putting them back, feed the bytes around them to crc32c, with a
+ * zero pair standing in for each field; this leaves @inode untouched
+ * so that it can point into a read-only inode table buffer.
+ */
+static __u32 ext2fs_inode_csum(ext2_filsys fs, ext2_ino_t inum,
+			       const struct ext2_inode_large *inode,
+			       int has_hi)
 {
-	__u32 gen;
-	struct ext2_inode_large *desc = inode;
+	static const unsigned char zero[2];
+	const unsigned char *cp = (const unsigned char *) inode;
 	size_t size = EXT2_INODE_SIZE(fs->super);
-	__u16 old_lo;
-	__u16 old_hi = 0;
-
-	old_lo = inode->i_checksum_lo;
-	inode->i_checksum_lo = 0;
-	if (has_hi) {
-		old_hi = inode->i_checksum_hi;
-		inode->i_checksum_hi = 0;
-	}
+	size_t lo = offsetof(struct ext2_inode_large, i_checksum_lo);
+	size_t hi = offsetof(struct ext2_inode_large, i_checksum_hi);
+	__u32 gen, crc;
 
 	inum = ext2fs_cpu_to_le32(inum);
 	gen = inode->i_generation;
-	*crc = ext2fs_crc32c_le(fs->csum_seed, (unsigned char *)&inum,
-				sizeof(inum));
-	*crc = ext2fs_crc32c_le(*crc, (unsigned char *)&gen, sizeof(gen));
-	*crc = ext2fs_crc32c_le(*crc, (unsigned char *)desc, size);
+	crc = ext2fs_crc32c_le(fs->csum_seed, (unsigned char *)&inum,
+			       sizeof(inum));
+	crc = ext2fs_crc32c_le(crc, (unsigned char *)&gen, sizeof(gen));
+	crc = ext2fs_crc32c_le(crc, cp, lo);
+	crc = ext2fs_crc32c_le(crc, zero, sizeof(zero));
+	lo += sizeof(zero);
+	if (has_hi) {
+		crc = ext2fs_crc32c_le(crc, cp + lo, hi - lo);
+		crc = ext2fs_crc32c_le(crc, zero, sizeof(zero));
+		lo = hi + sizeof(zero);
+	}
+	return ext2fs_crc32c_le(crc, cp + lo, size - lo);
+}
 
-	inode->i_checksum_lo = old_lo;
-	if (has_hi)
-		inode->i_checksum_hi = old_hi;
-	return 0;
+static int inode_csum_has_hi(ext2_filsys fs,
+			     const struct ext2_inode_large *inode)
+{
+	return (EXT2_INODE_SIZE(fs->super) > EXT2_GOOD_OLD_INODE_SIZE &&
+		ext2fs_le16_to_cpu(inode->i_extra_isize) >=
+		EXT4_INODE_CSUM_HI_EXTRA_END);
 }
 
-int ext2fs_inode_csum_verify(ext2_filsys fs, ext2_ino_t inum,
-			     struct ext2_inode_large *inode)
+static int inode_csum_ok(ext2_filsys fs, ext2_ino_t inum,
+			 const struct ext2_inode_large *inode)
 {
-	errcode_t retval;
 	__u32 provided, calculated;
 	unsigned int i, has_hi;
-	char *cp;
-
-	if (!ext2fs_has_feature_metadata_csum(fs->super))
-		return 1;
-
-	has_hi = (EXT2_INODE_SIZE(fs->super) > EXT2_GOOD_OLD_INODE_SIZE &&
-		  inode->i_extra_isize >= EXT4_INODE_CSUM_HI_EXTRA_END);
+	const char *cp;
 
+	has_hi = inode_csum_has_hi(fs, inode);
 	provided = ext2fs_le16_to_cpu(inode->i_checksum_lo);
-	retval = ext2fs_inode_csum(fs, inum, inode, &calculated, has_hi);
-	if (retval)
-		return 0;
+	calculated = ext2fs_inode_csum(fs, inum, inode, has_hi);
 	if (has_hi) {
 		__u32 hi = ext2fs_le16_to_cpu(inode->i_checksum_hi);
 		provided |= hi << 16;
@@ -683,7 +686,7 @@ int ext2fs_inode_csum_verify(ext2_filsys fs, ext2_ino_t inum,
 	 * worth the bother to figure out how much of the extended
 	 * inode, if any, is present.)
 	 */
-	for (cp = (char *) inode, i = 0;
+	for (cp = (const char *) inode, i = 0;
 	     i < sizeof(struct ext2_inode);
 	     cp++, i++)
 		if (*cp)
@@ -691,25 +694,81 @@ int ext2fs_inode_csum_verify(ext2_filsys fs, ext2_ino_t inum,
 	return 1;		/* Inode must have been all zero's */
 }
 
+static void inode_csum_store(ext2_filsys fs, ext2_ino_t inum,
+			     struct ext2_inode_large *inode)
+{
+	int has_hi = inode_csum_has_hi(fs, inode);
+	__u32 crc = ext2fs_inode_csum(fs, inum, inode, has_hi);
+
+	inode->i_checksum_lo = ext2fs_cpu_to_le16(crc & 0xFFFF);
+	if (has_hi)
+		inode->i_checksum_hi = ext2fs_cpu_to_le16(crc >> 16);
+}
+
+int ext2fs_inode_csum_verify(ext2_filsys fs, ext2_ino_t inum,
+			     struct ext2_inode_large *inode)
+{
+	if (!ext2fs_has_feature_metadata_csum(fs->super))
+		return 1;
+
+	return inode_csum_ok(fs, inum, inode);
+}
+
 errcode_t ext2fs_inode_csum_set(ext2_filsys fs, ext2_ino_t inum,
 			   struct ext2_inode_large *inode)
 {
-	errcode_t retval;
-	__u32 crc;
-	int has_hi;
-
 	if (!ext2fs_has_feature_metadata_csum(fs->super))
 		return 0;
 
-	has_hi = (EXT2_INODE_SIZE(fs->super) > EXT2_GOOD_OLD_INODE_SIZE &&
-		  inode->i_extra_isize >= EXT4_INODE_CSUM_HI_EXTRA_END);
+	inode_csum_store(fs, inum, inode);
+	return 0;
+}
 
-	retval = ext2fs_inode_csum(fs, inum, inode, &crc, has_hi);
-	if (retval)
-		return retval;
-	inode->i_checksum_lo = ext2fs_cpu_to_le16(crc & 0xFFFF);
-	if (has_hi)
-		inode->i_checksum_hi = ext2fs_cpu_to_le16(crc >> 16);
+/*
+ * Verify @count consecutive on-disk inodes starting at @buf, the first
+ * of which is inode @inum, e.g. one block of an inode table.  Returns
+ * the number of inodes whose checksum is wrong; if @bad is not NULL,
+ * bad[i] is set to 1 for each such inode and to 0 for the others.
+ */
+unsigned int ext2fs_inode_csum_verify_many(ext2_filsys fs, ext2_ino_t inum,
+					   const void *buf,
+					   unsigned int count, char *bad)
+{
+	const char *cp = buf;
+	unsigned int i, failures = 0;
+	int ok;
+
+	if (!ext2fs_has_feature_metadata_csum(fs->super)) {
+		if (bad)
+			memset(bad, 0, count);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++, inum++, cp += EXT2_INODE_SIZE(fs->super)) {
+		ok = inode_csum_ok(fs, inum,
+				   (const struct ext2_inode_large *) cp);
+		if (bad)
+			bad[i] = !ok;
+		failures += !ok;
+	}
+	return failures;
+}
+
+/*
+ * Set the checksums of @count consecutive on-disk inodes starting at
+ * @buf, the first of which is inode @inum.
+ */
+errcode_t ext2fs_inode_csum_set_many(ext2_filsys fs, ext2_ino_t inum,
+				     void *buf, unsigned int count)
+{
+	char *cp = buf;
+	unsigned int i;
+
+	if (!ext2fs_has_feature_metadata_csum(fs->super))
+		return 0;
+
+	for (i = 0; i < count; i++, inum++, cp += EXT2_INODE_SIZE(fs->super))
+		inode_csum_store(fs, inum, (struct ext2_inode_large *) cp);
 	return 0;
 }
 
@@ -332,6 +332,7 @@ struct struct_ext2_filsys {
 #define EXT2FS_BMAP64_BITARRAY	1
 #define EXT2FS_BMAP64_RBTREE	2
 #define EXT2FS_BMAP64_AUTODIR	3
+#define EXT2FS_BMAP64_HYBRID	4
 
 /*
  * Return flags for the block iterator functions
@@ -1114,6 +1115,13 @@ extern errcode_t ext2fs_inode_csum_set(ext2_filsys fs, ext2_ino_t inum,
 				       struct ext2_inode_large *inode);
 extern int ext2fs_inode_csum_verify(ext2_filsys fs, ext2_ino_t inum,
 				    struct ext2_inode_large *inode);
+extern errcode_t ext2fs_inode_csum_set_many(ext2_filsys fs, ext2_ino_t inum,
+					    void *buf, unsigned int count);
+extern unsigned int ext2fs_inode_csum_verify_many(ext2_filsys fs,
+						  ext2_ino_t inum,
+						  const void *buf,
+						  unsigned int count,
+						  char *bad);
 extern void ext2fs_group_desc_csum_set(ext2_filsys fs, dgrp_t group);
 extern int ext2fs_group_desc_csum_verify(ext2_filsys fs, dgrp_t group);
 extern errcode_t ext2fs_set_gdt_csum(ext2_filsys fs);
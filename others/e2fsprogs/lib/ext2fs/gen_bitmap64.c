@@ -117,6 +117,9 @@ errcode_t ext2fs_alloc_generic_bmap(ext2_filsys fs, errcode_t magic,
 		else
 			ops = &ext2fs_blkmap64_rbtree;
 		break;
+	case EXT2FS_BMAP64_HYBRID:
+		ops = &ext2fs_blkmap64_hybrid;
+		break;
 	default:
 		return EINVAL;
 	}
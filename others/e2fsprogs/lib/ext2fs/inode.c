@@ -434,7 +434,8 @@ static void check_inode_block_sanity(ext2_inode_scan scan, blk64_t num_blocks)
 	char		*p;
 	struct ext2_inode_large *inode;
 	char		*block_status;
-	unsigned int	blk, bad_csum;
+	unsigned int	blk, bad_csum, n, csum_idx = 0;
+	char		csum_bad[EXT2_MAX_BLOCK_SIZE / EXT2_GOOD_OLD_INODE_SIZE];
 
 	if (!(scan->scan_flags & EXT2_SF_WARN_GARBAGE_INODES))
 		return;
@@ -461,8 +462,18 @@ static void check_inode_block_sanity(ext2_inode_scan scan, blk64_t num_blocks)
 
 	while (inodes_to_scan > 0) {
 		blk = (p - (char *)scan->inode_buffer) / scan->fs->blocksize;
-		bad_csum = ext2fs_inode_csum_verify(scan->fs, ino,
-				(struct ext2_inode_large *) p) == 0;
+
+		/* Check the rest of this inode table block in one go */
+		if (p == (char *) scan->inode_buffer ||
+		    (ino - 1) % inodes_per_block == 0) {
+			n = inodes_per_block - ((ino - 1) % inodes_per_block);
+			if (n > inodes_to_scan)
+				n = inodes_to_scan;
+			ext2fs_inode_csum_verify_many(scan->fs, ino, p, n,
+						      csum_bad);
+			csum_idx = 0;
+		}
+		bad_csum = csum_bad[csum_idx++];
 
 #ifdef WORDS_BIGENDIAN
 		ext2fs_swap_inode_full(scan->fs,
@@ -32,6 +32,9 @@ extern int optind;
 # include <fcntl.h>
 # include <limits.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "ext2fs/ext2_fs.h"
 #include "ext2fs/ext2fs.h"
@@ -48,9 +51,19 @@ extern int optind;
 #define PATH_MAX 4096
 #endif
 
+/*
+ * The bitmap is exported SCAN_BITS at a time and scanned a 64-bit word
+ * at a time.  Each scan thread gets at least SCAN_MIN_BLKS blocks.
+ */
+#define SCAN_BITS		(1U << 20)
+#define SCAN_MIN_BLKS		(4ULL * SCAN_BITS)
+#define SCAN_MAX_THREADS	64
+
+static int scan_threads;	/* -j, 0 means one per CPU */
+
 static void usage(const char *prog)
 {
-	fprintf(stderr, "usage: %s [-c chunksize in kb] [-h] "
+	fprintf(stderr, "usage: %s [-c chunksize in kb] [-j threads] [-h] "
 		"device_name\n", prog);
 #ifndef DEBUGFS
 	exit(1);
@@ -111,7 +124,7 @@ static void update_chunk_stats(struct chunk_info *info,
 	info->real_free_chunks++;
 }
 
-static void scan_block_bitmap(ext2_filsys fs, struct chunk_info *info)
+static void scan_block_bitmap_bits(ext2_filsys fs, struct chunk_info *info)
 {
 	unsigned long long blocks_count = ext2fs_blocks_count(fs->super);
 	unsigned long long chunks = (blocks_count + info->blks_in_chunk) >>
@@ -161,6 +174,239 @@ static void scan_block_bitmap(ext2_filsys fs, struct chunk_info *info)
 		update_chunk_stats(info, last_chunk_size);
 }
 
+/*
+ * A slice of the block bitmap scanned by one thread.  Free extents
+ * which touch either end of the slice may continue into the neighbour,
+ * so they are returned in head and tail and only the extents wholly
+ * inside the slice are accounted in info.  head equal to the slice
+ * length means the whole slice is free.
+ */
+struct scan_slice {
+	ext2_filsys		fs;
+	struct chunk_info	info;
+	blk64_t			start, end;
+	blk64_t			head, tail;
+	errcode_t		retval;
+};
+
+static void add_free_extent(struct chunk_info *info, blk64_t start,
+			    blk64_t len)
+{
+	int shift = info->chunkbits - info->blocksize_bits;
+	blk64_t first = (start + info->blks_in_chunk - 1) >> shift;
+	blk64_t last = (start + len) >> shift;
+
+	update_chunk_stats(info, len);
+	if (last > first)
+		info->free_chunks += last - first;
+}
+
+static void slice_free_extent(struct scan_slice *s, blk64_t start,
+			      blk64_t len)
+{
+	if (start == s->start)
+		s->head = len;
+	else if (start + len == s->end)
+		s->tail = len;
+	else
+		add_free_extent(&s->info, start, len);
+}
+
+static void scan_slice(struct scan_slice *s)
+{
+	__u64 *map;
+	blk64_t blk, run_start = 0;
+	unsigned long run = 0;
+
+	map = malloc(SCAN_BITS / 8);
+	if (!map) {
+		s->retval = EXT2_ET_NO_MEMORY;
+		return;
+	}
+
+	for (blk = s->start; blk < s->end; blk += SCAN_BITS) {
+		unsigned int n = SCAN_BITS, words, i;
+
+		if (blk + n > s->end)
+			n = s->end - blk;
+		s->retval = ext2fs_get_block_bitmap_range2(s->fs->block_map,
+							   blk, n, map);
+		if (s->retval)
+			break;
+		words = (n + 63) / 64;
+		/* Bits past the end of the slice count as in use */
+		if (n % 64)
+			map[words - 1] |= ext2fs_cpu_to_le64(~0ULL << (n % 64));
+
+		for (i = 0; i < words; i++) {
+			__u64 used = ext2fs_le64_to_cpu(map[i]);
+			blk64_t base = blk + (blk64_t) i * 64;
+			unsigned int bit = 0;
+
+			if (used == 0) {
+				if (!run)
+					run_start = base;
+				run += 64;
+				continue;
+			}
+			if (used == ~0ULL && !run)
+				continue;
+			while (bit < 64) {
+				__u64 x;
+
+				if (!run) {
+					x = ~used >> bit;
+					if (!x)
+						break;
+					bit += __builtin_ctzll(x);
+					run_start = base + bit;
+				}
+				x = used >> bit;
+				if (!x) {
+					run += 64 - bit;
+					break;
+				}
+				run += __builtin_ctzll(x);
+				bit += __builtin_ctzll(x);
+				slice_free_extent(s, run_start, run);
+				run = 0;
+			}
+		}
+	}
+	if (run && !s->retval)
+		slice_free_extent(s, run_start, run);
+	free(map);
+}
+
+#ifdef HAVE_PTHREAD
+static void *scan_slice_thread(void *arg)
+{
+	scan_slice(arg);
+	return NULL;
+}
+#endif
+
+static int scan_nthreads(blk64_t blocks)
+{
+	int n = scan_threads;
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_SYSCONF) && \
+	defined(_SC_NPROCESSORS_ONLN)
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	n = 1;
+#endif
+	if (n > SCAN_MAX_THREADS)
+		n = SCAN_MAX_THREADS;
+	if ((blk64_t) n * SCAN_MIN_BLKS > blocks)
+		n = blocks / SCAN_MIN_BLKS;
+	return n < 1 ? 1 : n;
+}
+
+/*
+ * Split the bitmap into slices, scan them (in parallel when possible)
+ * and stitch the free extents which cross slice boundaries back
+ * together, walking the slices in block order.
+ */
+static errcode_t scan_block_bitmap(ext2_filsys fs, struct chunk_info *info)
+{
+	blk64_t first = fs->super->s_first_data_block;
+	blk64_t blocks_count = ext2fs_blocks_count(fs->super);
+	blk64_t per, carry = 0, carry_start = 0;
+	struct scan_slice *slices;
+	errcode_t retval = 0;
+	int nslices, i;
+
+	/* The word scan works on blocks; bigalloc maps clusters */
+	if (fs->cluster_ratio_bits || blocks_count <= first) {
+		scan_block_bitmap_bits(fs, info);
+		return 0;
+	}
+
+	nslices = scan_nthreads(blocks_count - first);
+	slices = calloc(nslices, sizeof(*slices));
+	if (!slices)
+		return EXT2_ET_NO_MEMORY;
+	per = (blocks_count - first + nslices - 1) / nslices;
+	per = (per + SCAN_BITS - 1) & ~((blk64_t) SCAN_BITS - 1);
+	for (i = 0; i < nslices; i++) {
+		slices[i].fs = fs;
+		slices[i].info = *info;
+		slices[i].start = first + i * per;
+		slices[i].end = slices[i].start + per;
+		if (slices[i].start > blocks_count)
+			slices[i].start = blocks_count;
+		if (slices[i].end > blocks_count || i == nslices - 1)
+			slices[i].end = blocks_count;
+	}
+
+#ifdef HAVE_PTHREAD
+	if (nslices > 1) {
+		pthread_t *tids = calloc(nslices, sizeof(*tids));
+		int started = 0;
+
+		if (!tids) {
+			free(slices);
+			return EXT2_ET_NO_MEMORY;
+		}
+		for (i = 1; i < nslices; i++) {
+			if (pthread_create(&tids[i], NULL, scan_slice_thread,
+					   &slices[i]))
+				break;
+			started = i;
+		}
+		/* Slices without a thread are scanned here */
+		scan_slice(&slices[0]);
+		for (i = started + 1; i < nslices; i++)
+			scan_slice(&slices[i]);
+		for (i = 1; i <= started; i++)
+			pthread_join(tids[i], NULL);
+		free(tids);
+	} else
+#endif
+		scan_slice(&slices[0]);
+
+	for (i = 0; i < nslices; i++) {
+		struct scan_slice *s = &slices[i];
+		int j;
+
+		if (s->retval) {
+			retval = s->retval;
+			break;
+		}
+		for (j = 0; j < MAX_HIST; j++) {
+			info->histogram.fc_chunks[j] +=
+				s->info.histogram.fc_chunks[j];
+			info->histogram.fc_blocks[j] +=
+				s->info.histogram.fc_blocks[j];
+		}
+		if (s->info.min < info->min)
+			info->min = s->info.min;
+		if (s->info.max > info->max)
+			info->max = s->info.max;
+		info->avg += s->info.avg;
+		info->real_free_chunks += s->info.real_free_chunks;
+		info->free_chunks += s->info.free_chunks;
+
+		if (s->head == s->end - s->start) {
+			if (!carry)
+				carry_start = s->start;
+			carry += s->head;
+			continue;
+		}
+		if (carry || s->head)
+			add_free_extent(info, carry ? carry_start : s->start,
+					carry + s->head);
+		carry = s->tail;
+		carry_start = s->end - s->tail;
+	}
+	if (!retval && carry)
+		add_free_extent(info, carry_start, carry);
+	free(slices);
+	return retval;
+}
+
 #if defined(HAVE_EXT2_IOCTLS) && !defined(DEBUGFS)
 # define FSMAP_EXTENTS	1024
 static int scan_online(ext2_filsys fs, struct chunk_info *info,
@@ -251,8 +497,7 @@ static errcode_t scan_offline(ext2_filsys fs, struct chunk_info *info,
 	retval = ext2fs_read_block_bitmap(fs);
 	if (retval)
 		return retval;
-	scan_block_bitmap(fs, info);
-	return 0;
+	return scan_block_bitmap(fs, info);
 }
 
 static errcode_t dump_chunk_info(ext2_filsys fs, struct chunk_info *info,
@@ -401,7 +646,8 @@ int main(int argc, char *argv[])
 	progname = argv[0];
 	memset(&chunk_info, 0, sizeof(chunk_info));
 
-	while ((c = getopt(argc, argv, "c:h")) != EOF) {
+	scan_threads = 0;
+	while ((c = getopt(argc, argv, "c:j:h")) != EOF) {
 		switch (c) {
 		case 'c':
 			chunk_info.chunkbytes = strtoull(optarg, &end, 0);
@@ -418,6 +664,14 @@ int main(int argc, char *argv[])
 			}
 			chunk_info.chunkbytes *= 1024;
 			break;
+		case 'j':
+			scan_threads = strtol(optarg, &end, 0);
+			if (*end != '\0' || scan_threads < 0) {
+				fprintf(stderr, "%s: bad thread count '%s'\n",
+					progname, optarg);
+				usage(progname);
+			}
+			break;
 		case 'h':
 		default:
 			usage(progname);
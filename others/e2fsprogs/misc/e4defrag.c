@@ -40,6 +40,10 @@
 #include <sys/stat.h>
 #include <sys/statfs.h>
 #include <sys/vfs.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "../version.h"
 
@@ -114,7 +118,8 @@
 
 /* The following macros are error message */
 #define MSG_USAGE		\
-"Usage	: e4defrag [-v] file...| directory...| device...\n\
+"Usage	: e4defrag [-v] [-j threads] [-b rate] [-B budget] [-p profile]\n\
+	           file...| directory...| device...\n\
 	: e4defrag  -c  file...| directory...| device...\n"
 
 #define NGMSG_EXT4		"Filesystem is not ext4 filesystem"
@@ -182,6 +187,49 @@ static __u32 feature_incompat;
 static ext4_fsblk_t	files_block_count;
 static struct frag_statistic_ino	frag_rank[SHOW_FRAG_FILES];
 
+/*
+ * The scheduler (-j, -b or -B) first collects the fragmented files of a
+ * directory or device, then defragments them in priority order, several at
+ * a time in different block groups, within a bandwidth and I/O budget.
+ */
+#define SCHED_MAX_THREADS	64
+/* Block group span to use when the super block can't be read */
+#define SCHED_GROUP_BLOCKS	32768
+
+struct defrag_cand {
+	char		*file;		/* pathname of the file */
+	struct stat64	st;
+	double		priority;	/* fragmentation score x access */
+	__u64		bytes;		/* data to be moved */
+	unsigned long	group;		/* (flex) block group of its data */
+	int		hot;		/* read according to the profile */
+	int		taken;		/* dispatched or skipped */
+};
+
+/* A file of the access profile (-p) and how often it is read */
+struct hot_file {
+	char		*file;
+	unsigned long	reads;
+};
+
+static int	sched_mode;
+static int	sched_threads = 1;		/* -j */
+static unsigned long long	sched_rate;	/* -b, bytes per second */
+static unsigned long long	sched_budget;	/* -B, bytes */
+static unsigned long long	sched_used;	/* bytes dispatched */
+static double	sched_clock;		/* when the next file may start */
+static struct defrag_cand	*sched_cands;
+static unsigned int	sched_count, sched_alloc, sched_skipped;
+static unsigned int	sched_pos;		/* first file not taken */
+static long	sched_busy[SCHED_MAX_THREADS];	/* groups being worked on */
+static int	sched_running;	/* workers drop the lock for I/O */
+static struct hot_file	*hot_files;	/* sorted by name */
+static unsigned int	hot_count, sched_hot;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t	sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	sched_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
 
 /*
  * We prefer posix_fadvise64 when available, as it allows 64bit offset on
@@ -199,6 +247,121 @@ static struct frag_statistic_ino	frag_rank[SHOW_FRAG_FILES];
 #error fallocate64 not available!
 #endif /* ! HAVE_FALLOCATE64 */
 
+/*
+ * defrag_io_begin(), defrag_io_end() -	Bracket heavy I/O on a file.
+ *
+ * Scheduler workers run file_defrag() holding sched_lock, which guards the
+ * counters and keeps each file's messages together, and drop it only while
+ * data is synced, allocated or moved.
+ */
+static void defrag_io_begin(void)
+{
+#ifdef HAVE_PTHREAD
+	if (sched_running)
+		pthread_mutex_unlock(&sched_lock);
+#endif
+}
+
+static void defrag_io_end(void)
+{
+#ifdef HAVE_PTHREAD
+	if (sched_running)
+		pthread_mutex_lock(&sched_lock);
+#endif
+}
+
+static int hot_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct hot_file *)a)->file,
+		      ((const struct hot_file *)b)->file);
+}
+
+/*
+ * hot_reads() -	Get how often the access profile says a file is read.
+ *
+ * @file:		the file's full path.
+ */
+static unsigned long hot_reads(const char *file)
+{
+	struct hot_file	key, *hot;
+
+	if (hot_count == 0)
+		return 0;
+	key.file = (char *)file;
+	hot = bsearch(&key, hot_files, hot_count, sizeof(*hot_files), hot_cmp);
+	return hot ? hot->reads : 0;
+}
+
+/*
+ * load_profile() -	Read the access profile of hot files.
+ *
+ * Each line names a file, optionally after a read count and white space,
+ * such as an app launch file list or a recorded trace of opened files.
+ * A file listed more than once has its reads added up.
+ *
+ * @profile:		the profile's name.
+ */
+static int load_profile(const char *profile)
+{
+	FILE	*fp;
+	char	line[PATH_MAX + 32], path[PATH_MAX + 1];
+	char	*name, *end;
+	unsigned long	reads;
+	unsigned int	i, j, alloc = 0;
+
+	fp = fopen(profile, "r");
+	if (fp == NULL) {
+		perror("Failed to open the access profile");
+		PRINT_FILE_NAME(profile);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+		name = line;
+		reads = strtoul(line, &end, 10);
+		if (end != line && (*end == ' ' || *end == '\t')) {
+			name = end + strspn(end, " \t");
+		} else
+			reads = 1;
+		if (*name == '\0' || *name == '#' || reads == 0)
+			continue;
+		/* Match the full paths the tree walk sees */
+		if (realpath(name, path) == NULL)
+			continue;
+
+		if (hot_count == alloc) {
+			struct hot_file	*tmp;
+
+			alloc = alloc ? alloc * 2 : 256;
+			tmp = realloc(hot_files, alloc * sizeof(*hot_files));
+			if (tmp == NULL)
+				goto nomem;
+			hot_files = tmp;
+		}
+		hot_files[hot_count].file = strdup(path);
+		if (hot_files[hot_count].file == NULL)
+			goto nomem;
+		hot_files[hot_count++].reads = reads;
+	}
+	fclose(fp);
+
+	qsort(hot_files, hot_count, sizeof(*hot_files), hot_cmp);
+	for (i = 0, j = 0; i < hot_count; i++) {
+		if (j && !strcmp(hot_files[j - 1].file, hot_files[i].file)) {
+			hot_files[j - 1].reads += hot_files[i].reads;
+			free(hot_files[i].file);
+		} else
+			hot_files[j++] = hot_files[i];
+	}
+	hot_count = j;
+	return 0;
+
+nomem:
+	fclose(fp);
+	PRINT_ERR_MSG("Out of memory reading the access profile");
+	return -1;
+}
+
 /*
  * get_mount_point() -	Get device's mount point.
  *
@@ -1321,6 +1484,8 @@ static int call_defrag(int fd, int donor_fd, const char *file,
 	unsigned char	*vec = NULL;
 	int	defraged_ret = 0;
 	int	ret;
+	/* Hot files are about to be read again: keep their pages cached */
+	int	keep_cached = hot_reads(file) != 0;
 	struct move_extent	move_data;
 	struct fiemap_extent_list	*ext_list_tmp = NULL;
 
@@ -1338,7 +1503,8 @@ static int call_defrag(int fd, int donor_fd, const char *file,
 		move_data.len = ext_list_tmp->data.len;
 		move_data.moved_len = 0;
 
-		ret = page_in_core(fd, move_data, &vec, &page_num);
+		ret = keep_cached ? 0 :
+			page_in_core(fd, move_data, &vec, &page_num);
 		if (ret < 0) {
 			if (mode_flag & DETAIL) {
 				printf("\n");
@@ -1351,11 +1517,14 @@ static int call_defrag(int fd, int donor_fd, const char *file,
 		}
 
 		/* EXT4_IOC_MOVE_EXT */
+		defrag_io_begin();
 		defraged_ret =
 			ioctl(fd, EXT4_IOC_MOVE_EXT, &move_data);
+		defrag_io_end();
 
 		/* Free pages */
-		ret = defrag_fadvise(fd, move_data, vec, page_num);
+		ret = keep_cached ? 0 :
+			defrag_fadvise(fd, move_data, vec, page_num);
 		if (vec) {
 			free(vec);
 			vec = NULL;
@@ -1515,7 +1684,10 @@ static int file_defrag(const char *file, const struct stat64 *buf,
 	if (file_check(fd, buf, file, file_frags_start, blk_count) < 0)
 		goto out;
 
-	if (fsync(fd) < 0) {
+	defrag_io_begin();
+	ret = fsync(fd);
+	defrag_io_end();
+	if (ret < 0) {
 		if (mode_flag & DETAIL) {
 			PRINT_FILE_NAME(file);
 			PRINT_ERR_MSG_WITH_ERRNO("Failed to sync(fsync)");
@@ -1568,9 +1740,11 @@ static int file_defrag(const char *file, const struct stat64 *buf,
 	/* Allocate space for donor inode */
 	orig_group_tmp = orig_group_head;
 	do {
+		defrag_io_begin();
 		ret = fallocate64(donor_fd, 0,
 		  (ext2_loff_t)orig_group_tmp->start->data.logical * block_size,
 		  (ext2_loff_t)orig_group_tmp->len * block_size);
+		defrag_io_end();
 		if (ret < 0) {
 			if (mode_flag & DETAIL) {
 				PRINT_FILE_NAME(file);
@@ -1675,6 +1849,324 @@ out:
 	return 0;
 }
 
+/*
+ * sched_now() -	Get the monotonic time in seconds.
+ */
+static double sched_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * parse_size() -	Parse a byte count with an optional K, M or G suffix.
+ *
+ * @str:		the string to parse.
+ * @size:		the parsed byte count.
+ */
+static int parse_size(const char *str, unsigned long long *size)
+{
+	char	*end;
+
+	errno = 0;
+	*size = strtoull(str, &end, 0);
+	if (errno || end == str)
+		return -1;
+	switch (*end) {
+	case 'g':
+	case 'G':
+		*size <<= 10;
+		/* fall through */
+	case 'm':
+	case 'M':
+		*size <<= 10;
+		/* fall through */
+	case 'k':
+	case 'K':
+		*size <<= 10;
+		end++;
+		break;
+	}
+	return *end == '\0' && *size ? 0 : -1;
+}
+
+/*
+ * get_first_physical() -	Get the physical block of a file's first extent.
+ *
+ * @fd:			the file's descriptor.
+ */
+static ext4_fsblk_t get_first_physical(int fd)
+{
+	__u64	buf[(sizeof(struct fiemap) +
+		     sizeof(struct fiemap_extent)) / sizeof(__u64)];
+	struct fiemap	*fiemap_buf = (struct fiemap *)buf;
+
+	memset(buf, 0, sizeof(buf));
+	fiemap_buf->fm_length = FIEMAP_MAX_OFFSET;
+	fiemap_buf->fm_extent_count = 1;
+	if (ioctl(fd, FS_IOC_FIEMAP, fiemap_buf) < 0 ||
+	    fiemap_buf->fm_mapped_extents == 0)
+		return 0;
+	return fiemap_buf->fm_extents[0].fe_physical / block_size;
+}
+
+/*
+ * sched_access_weight() -	Estimate how often a file is read.
+ *
+ * Recently read files are weighted up, as the atime of a file read in the
+ * last day is recent even with relatime.
+ *
+ * @buf:		the pointer of the struct stat64.
+ */
+static double sched_access_weight(const struct stat64 *buf)
+{
+	double	age_days = difftime(time(NULL), buf->st_atime) / 86400;
+
+	if (age_days < 0)
+		age_days = 0;
+	return 1.0 / (1.0 + age_days);
+}
+
+/*
+ * sched_collect() -	Queue a fragmented file for the scheduler.
+ *
+ * @file:		the file's name.
+ * @buf:		the pointer of the struct stat64.
+ * @flag:		file type.
+ * @ftwbuf:		the pointer of a struct FTW.
+ */
+static int sched_collect(const char *file, const struct stat64 *buf,
+			int flag EXT2FS_ATTR((unused)),
+			struct FTW *ftwbuf EXT2FS_ATTR((unused)))
+{
+	struct defrag_cand	*cand;
+	ext4_fsblk_t	blk_count;
+	unsigned long	group_blocks, reads;
+	int	fd, extents, best;
+
+	if (!S_ISREG(buf->st_mode) || buf->st_size == 0 ||
+	    buf->st_blocks == 0)
+		return 0;
+	if (lost_found_dir[0] != '\0' &&
+	    !memcmp(file, lost_found_dir, strnlen(lost_found_dir, PATH_MAX)))
+		return 0;
+	if (current_uid != ROOT_UID && buf->st_uid != current_uid)
+		return 0;
+
+	fd = open64(file, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	extents = file_frag_count(fd);
+	blk_count = ((ext4_fsblk_t)buf->st_blocks * 512 + block_size - 1) /
+		    block_size;
+	best = get_best_count(blk_count);
+	if (extents <= best) {
+		close(fd);
+		return 0;
+	}
+
+	if (sched_count == sched_alloc) {
+		unsigned int	alloc = sched_alloc ? sched_alloc * 2 : 1024;
+
+		cand = realloc(sched_cands, alloc * sizeof(*cand));
+		if (cand == NULL) {
+			close(fd);
+			return -1;
+		}
+		sched_cands = cand;
+		sched_alloc = alloc;
+	}
+	cand = &sched_cands[sched_count];
+	cand->file = strdup(file);
+	if (cand->file == NULL) {
+		close(fd);
+		return -1;
+	}
+	sched_count++;
+
+	group_blocks = blocks_per_group ? blocks_per_group : SCHED_GROUP_BLOCKS;
+	if (feature_incompat & EXT4_FEATURE_INCOMPAT_FLEX_BG)
+		group_blocks <<= log_groups_per_flex;
+
+	cand->st = *buf;
+	cand->bytes = blk_count * block_size;
+	cand->group = get_first_physical(fd) / group_blocks;
+	/* Profiled files by reads, ahead of the rest by atime */
+	reads = hot_reads(file);
+	cand->hot = reads != 0;
+	cand->priority = (extents - best) *
+		(reads ? (double)reads : sched_access_weight(buf));
+	cand->taken = 0;
+	if (cand->hot)
+		sched_hot++;
+	close(fd);
+	return 0;
+}
+
+/*
+ * sched_cmp() -	Order files by descending priority.
+ */
+static int sched_cmp(const void *a, const void *b)
+{
+	const struct defrag_cand	*ca = a, *cb = b;
+
+	if (ca->hot != cb->hot)
+		return cb->hot - ca->hot;
+	if (ca->priority != cb->priority)
+		return ca->priority < cb->priority ? 1 : -1;
+	return 0;
+}
+
+/*
+ * sched_pick() -	Take the next file for a worker, called locked.
+ *
+ * Returns the highest priority file not in a block group another worker is
+ * in, skipping those over the I/O budget, or NULL when none are left.
+ *
+ * @slot:		the worker's slot.
+ */
+static struct defrag_cand *sched_pick(int slot)
+{
+	struct defrag_cand	*cand;
+	unsigned int	i;
+	int	j, waiting;
+
+	for (;;) {
+		waiting = 0;
+		while (sched_pos < sched_count && sched_cands[sched_pos].taken)
+			sched_pos++;
+		for (i = sched_pos; i < sched_count; i++) {
+			cand = &sched_cands[i];
+			if (cand->taken)
+				continue;
+			if (sched_budget &&
+			    sched_used + cand->bytes > sched_budget) {
+				cand->taken = 1;
+				sched_skipped++;
+				continue;
+			}
+			for (j = 0; j < sched_threads; j++)
+				if (j != slot &&
+				    sched_busy[j] == (long)cand->group)
+					break;
+			if (j < sched_threads) {
+				waiting = 1;
+				continue;
+			}
+			cand->taken = 1;
+			sched_used += cand->bytes;
+			sched_busy[slot] = cand->group;
+			return cand;
+		}
+		if (!waiting)
+			return NULL;
+#ifdef HAVE_PTHREAD
+		pthread_cond_wait(&sched_cond, &sched_lock);
+#endif
+	}
+}
+
+/*
+ * sched_worker() -	Defragment files picked by the scheduler.
+ *
+ * @arg:		the worker's slot.
+ */
+static void *sched_worker(void *arg)
+{
+	struct defrag_cand	*cand;
+	int	slot = (long)arg;
+	double	delay;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&sched_lock);
+#endif
+	while ((cand = sched_pick(slot)) != NULL) {
+		/* Pace the files started to the bandwidth limit */
+		if (sched_rate) {
+			double	now = sched_now();
+
+			if (sched_clock < now)
+				sched_clock = now;
+			delay = sched_clock - now;
+			sched_clock += (double)cand->bytes / sched_rate;
+			if (delay > 0) {
+				struct timespec ts;
+
+				ts.tv_sec = delay;
+				ts.tv_nsec = (delay - ts.tv_sec) * 1e9;
+				defrag_io_begin();
+				nanosleep(&ts, NULL);
+				defrag_io_end();
+			}
+		}
+		file_defrag(cand->file, &cand->st, FTW_F, NULL);
+		sched_busy[slot] = -1;
+#ifdef HAVE_PTHREAD
+		pthread_cond_broadcast(&sched_cond);
+#endif
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&sched_lock);
+#endif
+	return NULL;
+}
+
+/*
+ * sched_defrag() -	Defragment a directory tree's files by priority.
+ *
+ * @dir_name:		the directory to defragment.
+ * @flags:		the nftw64() flags.
+ */
+static void sched_defrag(const char *dir_name, int flags)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t	threads[SCHED_MAX_THREADS];
+	int	started = 0;
+#endif
+	unsigned int	i;
+	int	j;
+
+	sched_count = sched_pos = sched_skipped = sched_hot = 0;
+	sched_used = 0;
+	sched_clock = 0;
+	if (nftw64(dir_name, sched_collect, FTW_OPEN_FD, flags) < 0)
+		PRINT_ERR_MSG_WITH_ERRNO("Failed to collect files");
+	qsort(sched_cands, sched_count, sizeof(*sched_cands), sched_cmp);
+	total_count = sched_count;
+	for (j = 0; j < SCHED_MAX_THREADS; j++)
+		sched_busy[j] = -1;
+
+#ifdef HAVE_PTHREAD
+	if (sched_threads > 1) {
+		sched_running = 1;
+		for (j = 0; j < sched_threads; j++) {
+			if (pthread_create(&threads[j], NULL, sched_worker,
+					   (void *)(long)j) != 0)
+				break;
+			started++;
+		}
+		for (j = 0; j < started; j++)
+			pthread_join(threads[j], NULL);
+		sched_running = 0;
+		if (started == 0)
+			sched_worker((void *)0);
+	} else
+#endif
+		sched_worker((void *)0);
+
+	total_count -= sched_skipped;
+	if (hot_count)
+		printf("\n\tFragmented files in the profile:\t[ %u/%u ]",
+		       sched_hot, sched_count);
+	if (sched_skipped)
+		printf("\n\tSkipped over the I/O budget:\t[ %u/%u ]",
+		       sched_skipped, sched_count);
+	for (i = 0; i < sched_count; i++)
+		free(sched_cands[i].file);
+}
+
 /*
  * main() -		Ext4 online defrag.
  *
@@ -1689,6 +2181,7 @@ int main(int argc, char *argv[])
 	int	arg_type = -1;
 	int	mount_dir_len = 0;
 	int	success_flag = 0;
+	char	*end;
 	char	dir_name[PATH_MAX + 1];
 	char	dev_name[PATH_MAX + 1];
 	struct stat64	buf;
@@ -1700,7 +2193,7 @@ int main(int argc, char *argv[])
 	if (argc == 1)
 		goto out;
 
-	while ((opt = getopt(argc, argv, "vc")) != EOF) {
+	while ((opt = getopt(argc, argv, "b:B:cj:p:v")) != EOF) {
 		switch (opt) {
 		case 'v':
 			mode_flag |= DETAIL;
@@ -1708,6 +2201,39 @@ int main(int argc, char *argv[])
 		case 'c':
 			mode_flag |= STATISTIC;
 			break;
+		case 'j':
+			sched_threads = strtol(optarg, &end, 0);
+			if (*end || sched_threads < 1 ||
+			    sched_threads > SCHED_MAX_THREADS) {
+				fprintf(stderr, "Invalid number of threads "
+					"%s (1 to %d)\n", optarg,
+					SCHED_MAX_THREADS);
+				goto out;
+			}
+#ifndef HAVE_PTHREAD
+			sched_threads = 1;
+#endif
+			sched_mode = 1;
+			break;
+		case 'b':
+			if (parse_size(optarg, &sched_rate) < 0) {
+				fprintf(stderr, "Invalid rate %s\n", optarg);
+				goto out;
+			}
+			sched_mode = 1;
+			break;
+		case 'B':
+			if (parse_size(optarg, &sched_budget) < 0) {
+				fprintf(stderr, "Invalid budget %s\n", optarg);
+				goto out;
+			}
+			sched_mode = 1;
+			break;
+		case 'p':
+			if (load_profile(optarg) < 0)
+				exit(1);
+			sched_mode = 1;
+			break;
 		default:
 			goto out;
 		}
@@ -1926,7 +2452,11 @@ int main(int argc, char *argv[])
 				break;
 			}
 			/* File tree walk */
-			nftw64(dir_name, file_defrag, FTW_OPEN_FD, flags);
+			if (sched_mode)
+				sched_defrag(dir_name, flags);
+			else
+				nftw64(dir_name, file_defrag, FTW_OPEN_FD,
+				       flags);
 			printf("\n\tSuccess:\t\t\t[ %u/%u ]\n", succeed_cnt,
 				total_count);
 			printf("\tFailure:\t\t\t[ %u/%u ]\n",
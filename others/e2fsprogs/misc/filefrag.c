@@ -35,6 +35,7 @@ int main(void) {
 #include <time.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <ftw.h>
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #else
@@ -48,6 +49,9 @@ extern int optind;
 #ifdef HAVE_LINUX_FD_H
 #include <linux/fd.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #include <ext2fs/ext2fs.h>
 #include <ext2fs/ext2_types.h>
 #include <ext2fs/fiemap.h>
@@ -64,6 +68,34 @@ int logical_width = 8;
 int physical_width = 10;
 const char *ext_fmt = "%4d: %*llu..%*llu: %*llu..%*llu: %6llu: %s\n";
 const char *hex_fmt = "%4d: %*llx..%*llx: %*llx..%*llx: %6llx: %s\n";
+int recursive;		/* descend into directories */
+int num_threads = 1;	/* files mapped in parallel */
+
+#define FTW_OPEN_FD	64	/* directories nftw64() keeps open */
+
+enum { SUMMARY_NONE, SUMMARY_CSV, SUMMARY_JSON };
+int summary = SUMMARY_NONE;	/* per-file fragmentation records */
+int summary_count;		/* records printed so far */
+const char *cache_file;		/* extent counts kept between runs */
+
+/*
+ * Per-thread state: the file system details cached across files on the
+ * same device, and the FIEMAP buffer, which grows for fragmented files.
+ */
+struct frag_ctx {
+	struct statfs	fsinfo;
+	unsigned int	blksize;
+	dev_t		last_device;
+	__u64		*fiemap_buf;	/* __u64 for proper field alignment */
+	size_t		fiemap_size;	/* in bytes */
+};
+
+#define FIEMAP_BUF_MIN	(2048 * sizeof(__u64))
+#define FIEMAP_BUF_MAX	(sizeof(struct fiemap) + \
+			 65536 * sizeof(struct fiemap_extent))
+
+/* The longest extent ext4 can map, in blocks */
+#define EXT_MAX_BLOCKS	32768
 
 #define FILEFRAG_FIEMAP_FLAGS_COMPAT (FIEMAP_FLAG_SYNC | FIEMAP_FLAG_XATTR)
 
@@ -217,15 +249,32 @@ static void print_extent_info(struct fiemap_extent *fm_extent, int cur_ex,
 	       ext_len, flags);
 }
 
-static int filefrag_fiemap(int fd, int blk_shift, int *num_extents,
-			   ext2fs_struct_stat *st)
+/*
+ * Double the FIEMAP buffer when a file has filled it, so highly fragmented
+ * files are mapped in fewer ioctls.  The mapping request in it is kept.
+ */
+static int fiemap_buf_grow(struct frag_ctx *ctx)
 {
-	__u64 buf[2048];	/* __u64 for proper field alignment */
-	struct fiemap *fiemap = (struct fiemap *)buf;
-	struct fiemap_extent *fm_ext = &fiemap->fm_extents[0];
+	size_t size = ctx->fiemap_size ? ctx->fiemap_size * 2 : FIEMAP_BUF_MIN;
+	__u64 *buf;
+
+	if (size > FIEMAP_BUF_MAX)
+		return ctx->fiemap_buf ? 0 : -ENOMEM;
+	buf = realloc(ctx->fiemap_buf, size);
+	if (!buf)
+		return ctx->fiemap_buf ? 0 : -ENOMEM;
+	ctx->fiemap_buf = buf;
+	ctx->fiemap_size = size;
+	return 1;
+}
+
+static int filefrag_fiemap(struct frag_ctx *ctx, int fd, int blk_shift,
+			   int *num_extents, ext2fs_struct_stat *st)
+{
+	struct fiemap *fiemap;
+	struct fiemap_extent *fm_ext;
 	struct fiemap_extent fm_last;
-	int count = (sizeof(buf) - sizeof(*fiemap)) /
-			sizeof(struct fiemap_extent);
+	int count;
 	unsigned long long expected = 0;
 	unsigned long long expected_dense = 0;
 	unsigned long flags = 0;
@@ -236,6 +285,9 @@ static int filefrag_fiemap(int fd, int blk_shift, int *num_extents,
 	int last = 0;
 	int rc;
 
+	if (!ctx->fiemap_buf && fiemap_buf_grow(ctx) < 0)
+		return -ENOMEM;
+	fiemap = (struct fiemap *)ctx->fiemap_buf;
 	memset(fiemap, 0, sizeof(struct fiemap));
 	memset(&fm_last, 0, sizeof(fm_last));
 
@@ -252,6 +304,10 @@ static int filefrag_fiemap(int fd, int blk_shift, int *num_extents,
 		cmd = EXT4_IOC_GET_ES_CACHE;
 
 	do {
+		fiemap = (struct fiemap *)ctx->fiemap_buf;
+		fm_ext = &fiemap->fm_extents[0];
+		count = (ctx->fiemap_size - sizeof(*fiemap)) /
+			sizeof(struct fiemap_extent);
 		fiemap->fm_length = ~0ULL;
 		fiemap->fm_flags = flags;
 		fiemap->fm_extent_count = count;
@@ -303,6 +359,8 @@ static int filefrag_fiemap(int fd, int blk_shift, int *num_extents,
 
 		fiemap->fm_start = (fm_ext[i - 1].fe_logical +
 				    fm_ext[i - 1].fe_length);
+		if (!last && fiemap->fm_mapped_extents == (__u32) count)
+			fiemap_buf_grow(ctx);
 	} while (last == 0);
 
 	*num_extents = tot_extents;
@@ -402,20 +460,311 @@ static int filefrag_fibmap(int fd, int blk_shift, int *num_extents,
 	return count;
 }
 
-static int frag_report(const char *filename)
+static void print_csv_string(const char *str)
+{
+	if (!strpbrk(str, ",\"\r\n")) {
+		fputs(str, stdout);
+		return;
+	}
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"')
+			putchar('"');
+		putchar(*str);
+	}
+	putchar('"');
+}
+
+static void print_json_string(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+/*
+ * Print the fragmentation record of a file for -o.  The ideal extent count
+ * is the file's blocks split into the longest extents ext4 allows, and the
+ * score is the percentage of extents beyond that: 0 for a file laid out as
+ * well as it can be, approaching 100 when every block is an extent.
+ */
+static void print_summary(const char *filename, ext2fs_struct_stat *st,
+			  unsigned long long numblocks, int num_extents)
+{
+	unsigned long long ideal;
+	double score = 0.0;
+
+	ideal = numblocks ? (numblocks - 1) / EXT_MAX_BLOCKS + 1 : 0;
+	if (num_extents > 0 && (unsigned long long) num_extents > ideal)
+		score = 100.0 * (num_extents - ideal) / num_extents;
+
+	flockfile(stdout);
+	if (summary == SUMMARY_CSV) {
+		print_csv_string(filename);
+		printf(",%llu,%llu,%d,%llu,%.1f\n",
+		       (unsigned long long) st->st_size, numblocks,
+		       num_extents, ideal, score);
+	} else {
+		fputs(summary_count ? ",\n{\"file\": " : "{\"file\": ", stdout);
+		print_json_string(filename);
+		printf(", \"size\": %llu, \"blocks\": %llu, \"extents\": %d, "
+		       "\"ideal_extents\": %llu, \"score\": %.1f}",
+		       (unsigned long long) st->st_size, numblocks,
+		       num_extents, ideal, score);
+	}
+	summary_count++;
+	funlockfile(stdout);
+}
+
+/*
+ * With -c the extent count of each file is remembered in a cache file
+ * between runs.  A file whose inode, generation, size and times are
+ * what they were when it was last mapped is reported from the cache
+ * without asking the kernel for its mapping again, so that repeated
+ * audits only map the files that changed.  The file is in host byte
+ * order: it is a cache for this machine, not an interchange format.
+ */
+#define CACHE_MAGIC	"FFCACHE1"
+
+struct cache_hdr {
+	char		magic[8];
+	__u32		rec_size;
+	__u32		options;	/* options that change the counts */
+	__u64		count;
+};
+
+struct cache_rec {
+	__u64		dev;
+	__u64		ino;
+	__u64		size;
+	__s64		mtime_ns;
+	__s64		ctime_ns;
+	__u64		numblocks;
+	__u32		generation;
+	__s32		num_extents;
+	__s32		expected;	/* perfection for indirect files */
+	__u32		is_ext2;
+};
+
+static struct cache_rec *cache_recs;
+static size_t cache_count, cache_alloc;
+static size_t *cache_index;	/* open addressing, record number + 1 */
+static size_t cache_index_size;	/* a power of two */
+static int cache_dirty;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static __u32 cache_options(void)
+{
+	return (force_bmap ? 1 : 0) | (xattr_map ? 2 : 0);
+}
+
+static size_t cache_slot(__u64 dev, __u64 ino)
+{
+	__u64 h = (ino ^ (dev << 32 | dev >> 32)) * 0x9e3779b97f4a7c15ULL;
+
+	return (h >> 32) & (cache_index_size - 1);
+}
+
+static struct cache_rec *cache_find(__u64 dev, __u64 ino, size_t *slot)
+{
+	size_t i = cache_slot(dev, ino);
+	struct cache_rec *rec;
+
+	while (cache_index[i]) {
+		rec = &cache_recs[cache_index[i] - 1];
+		if (rec->dev == dev && rec->ino == ino)
+			return rec;
+		i = (i + 1) & (cache_index_size - 1);
+	}
+	*slot = i;
+	return NULL;
+}
+
+/* Keep the index at most half full */
+static int cache_grow_index(void)
+{
+	size_t i, slot, size = cache_index_size ? cache_index_size * 2 : 1024;
+	size_t *index = calloc(size, sizeof(*index));
+
+	if (!index)
+		return -ENOMEM;
+	free(cache_index);
+	cache_index = index;
+	cache_index_size = size;
+	for (i = 0; i < cache_count; i++) {
+		cache_find(cache_recs[i].dev, cache_recs[i].ino, &slot);
+		cache_index[slot] = i + 1;
+	}
+	return 0;
+}
+
+static int cache_add(const struct cache_rec *new)
+{
+	struct cache_rec *rec;
+	size_t slot;
+
+	if ((cache_count + 1) * 2 > cache_index_size && cache_grow_index())
+		return -ENOMEM;
+	rec = cache_find(new->dev, new->ino, &slot);
+	if (rec) {
+		*rec = *new;
+		return 0;
+	}
+	if (cache_count == cache_alloc) {
+		size_t n = cache_alloc ? cache_alloc * 2 : 1024;
+
+		rec = realloc(cache_recs, n * sizeof(*rec));
+		if (!rec)
+			return -ENOMEM;
+		cache_recs = rec;
+		cache_alloc = n;
+	}
+	cache_recs[cache_count++] = *new;
+	cache_index[slot] = cache_count;
+	return 0;
+}
+
+/* A missing, foreign or outdated cache file just starts an empty cache */
+static void cache_load(void)
+{
+	struct cache_hdr hdr;
+	struct cache_rec rec;
+	FILE *f = fopen(cache_file, "r");
+	__u64 i;
+
+	if (!f)
+		return;
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    memcmp(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.rec_size != sizeof(rec) || hdr.options != cache_options())
+		goto out;
+	for (i = 0; i < hdr.count; i++) {
+		if (fread(&rec, sizeof(rec), 1, f) != 1 || cache_add(&rec))
+			break;
+	}
+out:
+	fclose(f);
+	cache_dirty = 0;
+}
+
+/* Write to a temporary file and rename it, so readers never see half */
+static void cache_save(void)
+{
+	struct cache_hdr hdr;
+	char *tmp;
+	FILE *f;
+
+	if (!cache_dirty)
+		return;
+	tmp = malloc(strlen(cache_file) + 16);
+	if (!tmp) {
+		perror("malloc");
+		return;
+	}
+	sprintf(tmp, "%s.%u", cache_file, (unsigned) getpid());
+	f = fopen(tmp, "w");
+	if (!f) {
+		perror(tmp);
+		free(tmp);
+		return;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.rec_size = sizeof(struct cache_rec);
+	hdr.options = cache_options();
+	hdr.count = cache_count;
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    (cache_count &&
+	     fwrite(cache_recs, sizeof(*cache_recs), cache_count, f) !=
+	     cache_count)) {
+		perror(tmp);
+		fclose(f);
+		unlink(tmp);
+	} else if (fclose(f) || rename(tmp, cache_file)) {
+		perror(cache_file);
+		unlink(tmp);
+	}
+	free(tmp);
+}
+
+static void cache_key(struct cache_rec *rec, int fd, ext2fs_struct_stat *st)
+{
+	long generation = 0;
+
+	memset(rec, 0, sizeof(*rec));
+	/* not every file system has inode generations */
+	if (ioctl(fd, EXT2_IOC_GETVERSION, &generation) < 0)
+		generation = 0;
+	rec->dev = st->st_dev;
+	rec->ino = st->st_ino;
+	rec->size = st->st_size;
+	rec->mtime_ns = st->st_mtim.tv_sec * 1000000000LL +
+		st->st_mtim.tv_nsec;
+	rec->ctime_ns = st->st_ctim.tv_sec * 1000000000LL +
+		st->st_ctim.tv_nsec;
+	rec->generation = generation;
+}
+
+static int cache_lookup(struct cache_rec *key)
+{
+	struct cache_rec *rec = NULL;
+	size_t slot;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&cache_lock);
+#endif
+	if (cache_index_size)
+		rec = cache_find(key->dev, key->ino, &slot);
+	if (rec && (rec->size != key->size ||
+		    rec->mtime_ns != key->mtime_ns ||
+		    rec->ctime_ns != key->ctime_ns ||
+		    rec->generation != key->generation))
+		rec = NULL;
+	if (rec)
+		*key = *rec;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&cache_lock);
+#endif
+	return rec != NULL;
+}
+
+static void cache_store(struct cache_rec *rec)
 {
-	static struct statfs fsinfo;
-	static unsigned int blksize;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&cache_lock);
+#endif
+	if (cache_add(rec) == 0)
+		cache_dirty = 1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&cache_lock);
+#endif
+}
+
+static int frag_report(struct frag_ctx *ctx, const char *filename)
+{
+	struct statfs *fsinfo = &ctx->fsinfo;
 	ext2fs_struct_stat st;
+	unsigned int	blksize;
 	int		blk_shift;
 	long		fd;
 	unsigned long long	numblocks;
 	int		data_blocks_per_cyl = 1;
 	int		num_extents = 1, expected = ~0;
 	int		is_ext2 = 0;
-	static dev_t	last_device;
 	int		width;
 	int		rc = 0;
+	struct cache_rec cached;
 
 #if defined(HAVE_OPEN64) && !defined(__OSX_AVAILABLE_BUT_DEPRECATED)
 	fd = open64(filename, O_RDONLY);
@@ -438,21 +787,33 @@ static int frag_report(const char *filename)
 		goto out_close;
 	}
 
-	if ((last_device != st.st_dev) || !st.st_dev) {
-		if (fstatfs(fd, &fsinfo) < 0) {
+	if (cache_file) {
+		cache_key(&cached, fd, &st);
+		if (cache_lookup(&cached)) {
+			numblocks = cached.numblocks;
+			num_extents = cached.num_extents;
+			expected = cached.expected;
+			is_ext2 = cached.is_ext2;
+			goto report;
+		}
+	}
+
+	if ((ctx->last_device != st.st_dev) || !st.st_dev) {
+		if (fstatfs(fd, fsinfo) < 0) {
 			rc = -errno;
 			perror("fstatfs");
 			goto out_close;
 		}
-		if ((ioctl(fd, FIGETBSZ, &blksize) < 0) || !blksize)
-			blksize = fsinfo.f_bsize;
+		if ((ioctl(fd, FIGETBSZ, &ctx->blksize) < 0) || !ctx->blksize)
+			ctx->blksize = fsinfo->f_bsize;
 		if (verbose)
 			printf("Filesystem type is: %lx\n",
-			       (unsigned long)fsinfo.f_type);
+			       (unsigned long)fsinfo->f_type);
 	}
+	blksize = ctx->blksize;
 	st.st_blksize = blksize;
-	if (fsinfo.f_type == 0xef51 || fsinfo.f_type == 0xef52 ||
-	    fsinfo.f_type == 0xef53) {
+	if (fsinfo->f_type == 0xef51 || fsinfo->f_type == 0xef52 ||
+	    fsinfo->f_type == 0xef53) {
 		unsigned int	flags;
 
 		if (ioctl(fd, EXT3_IOC_GETFLAGS, &flags) == 0 &&
@@ -461,19 +822,20 @@ static int frag_report(const char *filename)
 	}
 
 	if (is_ext2) {
-		long cylgroups = div_ceil(fsinfo.f_blocks, blksize * 8);
+		long cylgroups = div_ceil(fsinfo->f_blocks, blksize * 8);
 
-		if (verbose && last_device != st.st_dev)
+		if (verbose && ctx->last_device != st.st_dev)
 			printf("Filesystem cylinder groups approximately %ld\n",
 			       cylgroups);
 
 		data_blocks_per_cyl = blksize * 8 -
-					(fsinfo.f_files / 8 / cylgroups) - 3;
+					(fsinfo->f_files / 8 / cylgroups) - 3;
 	}
-	last_device = st.st_dev;
+	ctx->last_device = st.st_dev;
 
-	width = ulong_log10(fsinfo.f_blocks);
-	if (width > physical_width)
+	/* only used for verbose output, which is never multithreaded */
+	width = ulong_log10(fsinfo->f_blocks);
+	if (verbose && width > physical_width)
 		physical_width = width;
 
 	numblocks = (st.st_size + blksize - 1) / blksize;
@@ -486,7 +848,7 @@ static int frag_report(const char *filename)
 		width = 10;
 	else
 		width = ulong_log10(numblocks);
-	if (width > logical_width)
+	if (verbose && width > logical_width)
 		logical_width = width;
 	if (verbose) {
 		__u32 state;
@@ -503,7 +865,7 @@ static int frag_report(const char *filename)
 	}
 
 	if (!force_bmap) {
-		rc = filefrag_fiemap(fd, blk_shift, &num_extents, &st);
+		rc = filefrag_fiemap(ctx, fd, blk_shift, &num_extents, &st);
 		expected = 0;
 		if (rc < 0 &&
 		    (use_extent_cache || precache_file || xattr_map)) {
@@ -540,6 +902,21 @@ static int frag_report(const char *filename)
 		expected = expected / data_blocks_per_cyl + 1;
 	}
 
+	if (cache_file) {
+		cached.numblocks = numblocks;
+		cached.num_extents = num_extents;
+		cached.expected = expected;
+		cached.is_ext2 = is_ext2;
+		cache_store(&cached);
+	}
+
+report:
+	if (summary != SUMMARY_NONE) {
+		print_summary(filename, &st, numblocks, num_extents);
+		goto out_close;
+	}
+
+	flockfile(stdout);
 	if (num_extents == 1)
 		printf("%s: 1 extent found", filename);
 	else
@@ -550,15 +927,147 @@ static int frag_report(const char *filename)
 			(expected > 1) ? "s" : "");
 	else
 		fputc('\n', stdout);
+	funlockfile(stdout);
 out_close:
 	close(fd);
 
 	return rc;
 }
 
+/*
+ * With -j the files given and found by -r are queued for a pool of worker
+ * threads, each with its own struct frag_ctx.  Otherwise they are reported
+ * one at a time as before.
+ */
+#define QUEUE_LEN	1024
+#define QUEUE_BATCH	32
+#define MAX_THREADS	256
+
+static struct frag_ctx main_ctx;
+static int report_rc;		/* the first error reporting a file */
+#ifdef HAVE_PTHREAD
+static char *queue[QUEUE_LEN];
+static int queue_head, queue_count, queue_done;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+static pthread_t *threads;
+static int threads_started;
+
+static void *frag_worker(void *arg EXT2FS_ATTR((unused)))
+{
+	struct frag_ctx ctx;
+	char *batch[QUEUE_BATCH];
+	int i, n, rc, batch_rc;
+
+	memset(&ctx, 0, sizeof(ctx));
+	pthread_mutex_lock(&queue_lock);
+	for (;;) {
+		while (queue_count == 0 && !queue_done)
+			pthread_cond_wait(&queue_not_empty, &queue_lock);
+		if (queue_count == 0)
+			break;
+		/* take several files at once to keep the lock quiet */
+		for (n = 0; n < QUEUE_BATCH && queue_count; n++) {
+			batch[n] = queue[queue_head];
+			queue_head = (queue_head + 1) % QUEUE_LEN;
+			queue_count--;
+		}
+		pthread_cond_signal(&queue_not_full);
+		pthread_mutex_unlock(&queue_lock);
+
+		batch_rc = 0;
+		for (i = 0; i < n; i++) {
+			rc = frag_report(&ctx, batch[i]);
+			if (rc < 0 && batch_rc == 0)
+				batch_rc = rc;
+			free(batch[i]);
+		}
+
+		pthread_mutex_lock(&queue_lock);
+		if (batch_rc < 0 && report_rc == 0)
+			report_rc = batch_rc;
+	}
+	pthread_mutex_unlock(&queue_lock);
+	free(ctx.fiemap_buf);
+	return NULL;
+}
+
+static void start_workers(void)
+{
+	int i;
+
+	threads = calloc(num_threads, sizeof(pthread_t));
+	if (!threads)
+		return;
+	for (i = 0; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, frag_worker, NULL))
+			break;
+		threads_started++;
+	}
+}
+
+static void stop_workers(void)
+{
+	int i;
+
+	pthread_mutex_lock(&queue_lock);
+	queue_done = 1;
+	pthread_cond_broadcast(&queue_not_empty);
+	pthread_mutex_unlock(&queue_lock);
+	for (i = 0; i < threads_started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+#endif
+
+static void submit_file(const char *filename)
+{
+	int rc;
+
+#ifdef HAVE_PTHREAD
+	if (threads_started) {
+		char *name = strdup(filename);
+
+		if (!name) {
+			perror("strdup");
+			pthread_mutex_lock(&queue_lock);
+			if (report_rc == 0)
+				report_rc = -ENOMEM;
+			pthread_mutex_unlock(&queue_lock);
+			return;
+		}
+		pthread_mutex_lock(&queue_lock);
+		while (queue_count == QUEUE_LEN)
+			pthread_cond_wait(&queue_not_full, &queue_lock);
+		queue[(queue_head + queue_count++) % QUEUE_LEN] = name;
+		/* wake a worker for each batch's worth of files */
+		if (queue_count % QUEUE_BATCH == 1)
+			pthread_cond_signal(&queue_not_empty);
+		pthread_mutex_unlock(&queue_lock);
+		return;
+	}
+#endif
+	rc = frag_report(&main_ctx, filename);
+	if (rc < 0 && report_rc == 0)
+		report_rc = rc;
+}
+
+static int walk_entry(const char *file, const struct stat64 *st,
+		      int flag, struct FTW *ftwbuf EXT2FS_ATTR((unused)))
+{
+	if (flag == FTW_F && S_ISREG(st->st_mode))
+		submit_file(file);
+	else if (flag == FTW_DNR || flag == FTW_NS)
+		fprintf(stderr, "%s: %s\n", file, flag == FTW_DNR ?
+			"cannot read directory" : "cannot stat");
+	return 0;
+}
+
 static void usage(const char *progname)
 {
-	fprintf(stderr, "Usage: %s [-b{blocksize}[KMG]] [-BeEksvxX] file ...\n",
+	fprintf(stderr, "Usage: %s [-b{blocksize}[KMG]] [-BeEkrsvxX] "
+		"[-c cachefile] [-j threads] [-o csv|json] file ...\n",
 		progname);
 	exit(1);
 }
@@ -566,9 +1075,9 @@ static void usage(const char *progname)
 int main(int argc, char**argv)
 {
 	char **cpp;
-	int rc = 0, c;
+	int c;
 
-	while ((c = getopt(argc, argv, "Bb::eEkPsvxX")) != EOF) {
+	while ((c = getopt(argc, argv, "Bb::c:eEj:ko:PrsvxX")) != EOF) {
 		switch (c) {
 		case 'B':
 			force_bmap++;
@@ -622,6 +1131,9 @@ int main(int argc, char**argv)
 				blocksize = 1024;
 			}
 			break;
+		case 'c':
+			cache_file = optarg;
+			break;
 		case 'E':
 			use_extent_cache++;
 			/* fallthrough */
@@ -630,9 +1142,35 @@ int main(int argc, char**argv)
 			if (!verbose)
 				verbose++;
 			break;
+		case 'j': {
+			char *end;
+
+			num_threads = strtol(optarg, &end, 0);
+			if (*end || num_threads < 0 ||
+			    num_threads > MAX_THREADS) {
+				fprintf(stderr, "%s: bad number of threads "
+					"%s\n", argv[0], optarg);
+				usage(argv[0]);
+			}
+			break;
+		}
 		case 'k':
 			blocksize = 1024;
 			break;
+		case 'o':
+			if (!strcmp(optarg, "csv"))
+				summary = SUMMARY_CSV;
+			else if (!strcmp(optarg, "json"))
+				summary = SUMMARY_JSON;
+			else {
+				fprintf(stderr, "%s: unknown output format "
+					"%s\n", argv[0], optarg);
+				usage(argv[0]);
+			}
+			break;
+		case 'r':
+			recursive++;
+			break;
 		case 'P':
 			precache_file++;
 			break;
@@ -657,13 +1195,56 @@ int main(int argc, char**argv)
 	if (optind == argc)
 		usage(argv[0]);
 
-	for (cpp = argv + optind; *cpp != NULL; cpp++) {
-		int rc2 = frag_report(*cpp);
+	if (summary != SUMMARY_NONE && verbose) {
+		fprintf(stderr, "%s: -o can't be used with -e, -E or -v\n",
+			argv[0]);
+		usage(argv[0]);
+	}
+	if (cache_file && verbose) {
+		fprintf(stderr, "%s: -c can't be used with -e, -E or -v\n",
+			argv[0]);
+		usage(argv[0]);
+	}
+	if (cache_file)
+		cache_load();
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+	if (num_threads == 0)
+		num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	/* extent listings of files mapped in parallel would interleave */
+	if (verbose)
+		num_threads = 1;
+#ifdef HAVE_PTHREAD
+	if (num_threads > 1)
+		start_workers();
+#endif
 
-		if (rc2 < 0 && rc == 0)
-			rc = rc2;
+	if (summary == SUMMARY_CSV)
+		puts("file,size,blocks,extents,ideal_extents,score");
+	else if (summary == SUMMARY_JSON)
+		puts("[");
+
+	for (cpp = argv + optind; *cpp != NULL; cpp++) {
+		ext2fs_struct_stat st;
+
+		if (recursive && lstat64(*cpp, &st) == 0 &&
+		    S_ISDIR(st.st_mode))
+			nftw64(*cpp, walk_entry, FTW_OPEN_FD,
+			       FTW_PHYS | FTW_MOUNT);
+		else
+			submit_file(*cpp);
 	}
 
-	return -rc;
+#ifdef HAVE_PTHREAD
+	if (threads_started)
+		stop_workers();
+#endif
+	if (summary == SUMMARY_JSON)
+		fputs(summary_count ? "\n]\n" : "]\n", stdout);
+	free(main_ctx.fiemap_buf);
+	if (cache_file)
+		cache_save();
+
+	return -report_rc;
 }
 #endif
@@ -48,7 +48,7 @@ static void usage (char *prog)
 {
 	fprintf (stderr, _("Usage: %s [-d debug_flags] [-f] [-F] [-M] [-P] "
 			   "[-p] device [-b|-s|new_size] [-S RAID-stride] "
-			   "[-z undo_file]\n\n"),
+			   "[-g groups] [-w pause_ms] [-z undo_file]\n\n"),
 		 prog);
 
 	exit (1);
@@ -268,8 +268,10 @@ int main (int argc, char ** argv)
 	unsigned int	blocksize;
 	long		sysval;
 	int		len, mount_flags;
-	char		*mtpt, *undo_file = NULL;
+	char		*mtpt, *undo_file = NULL, *tmp;
 	dgrp_t		new_group_desc_count;
+	dgrp_t		batch_groups = 0;
+	unsigned int	pause_ms = 0;
 	unsigned long	new_desc_blocks;
 
 #ifdef ENABLE_NLS
@@ -287,7 +289,7 @@ int main (int argc, char ** argv)
 	if (argc && *argv)
 		program_name = *argv;
 
-	while ((c = getopt(argc, argv, "d:fFhMPpS:bsz:")) != EOF) {
+	while ((c = getopt(argc, argv, "d:fFg:hMPpS:bsw:z:")) != EOF) {
 		switch (c) {
 		case 'h':
 			usage(program_name);
@@ -319,6 +321,22 @@ int main (int argc, char ** argv)
 		case 's':
 			flags |= RESIZE_DISABLE_64BIT;
 			break;
+		case 'g':
+			batch_groups = strtoul(optarg, &tmp, 0);
+			if (*tmp || !batch_groups) {
+				com_err(program_name, 0,
+					_("bad batch size - %s"), optarg);
+				exit(1);
+			}
+			break;
+		case 'w':
+			pause_ms = strtoul(optarg, &tmp, 0);
+			if (*tmp) {
+				com_err(program_name, 0,
+					_("bad pause time - %s"), optarg);
+				exit(1);
+			}
+			break;
 		case 'z':
 			undo_file = optarg;
 			break;
@@ -418,7 +436,7 @@ int main (int argc, char ** argv)
 		printf("%s", _("Couldn't find valid filesystem superblock.\n"));
 		exit (1);
 	}
-	fs->default_bitmap_type = EXT2FS_BMAP64_RBTREE;
+	fs->default_bitmap_type = EXT2FS_BMAP64_HYBRID;
 
 	/*
 	 * Before acting on an unmounted filesystem, make sure it's ok,
@@ -628,7 +646,8 @@ int main (int argc, char ** argv)
 		exit(1);
 	}
 	if (mount_flags & EXT2_MF_MOUNTED) {
-		retval = online_resize_fs(fs, mtpt, &new_size, flags);
+		retval = online_resize_fs(fs, mtpt, &new_size, flags,
+					  batch_groups, pause_ms);
 	} else {
 		bigalloc_check(fs, force);
 		if (flags & RESIZE_ENABLE_64BIT)
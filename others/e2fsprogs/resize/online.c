@@ -16,6 +16,7 @@
 #endif
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
 
 extern char *program_name;
 
@@ -46,12 +47,130 @@ static int parse_version_number(const char *s)
 
 #define VERSION_CODE(a,b,c) (((a) << 16) + ((b) << 8) + (c))
 
+/*
+ * With a batch size, the filesystem is grown a bounded number of
+ * groups per ioctl, optionally pausing between steps, so that a live
+ * workload never waits behind the whole resize at once.
+ */
+struct online_batch {
+	dgrp_t		groups;		/* groups per step, 0 = all at once */
+	unsigned int	pause_ms;	/* sleep between steps */
+	int		report;		/* print progress after each step */
+	dgrp_t		old_groups, new_groups;
+	blk64_t		old_blocks;
+	struct timeval	start;
+};
+
+static double batch_elapsed(struct online_batch *ob)
+{
+	struct timeval now;
+
+	gettimeofday(&now, 0);
+	return (now.tv_sec - ob->start.tv_sec) +
+		(now.tv_usec - ob->start.tv_usec) / 1000000.0;
+}
+
+static void batch_pause(struct online_batch *ob)
+{
+	if (!ob->pause_ms)
+		return;
+#ifdef HAVE_NANOSLEEP
+	{
+		struct timespec ts;
+
+		ts.tv_sec = ob->pause_ms / 1000;
+		ts.tv_nsec = (ob->pause_ms % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+	}
+#elif defined(HAVE_USLEEP)
+	if (ob->pause_ms >= 1000)
+		sleep(ob->pause_ms / 1000);
+	usleep((ob->pause_ms % 1000) * 1000);
+#else
+	sleep((ob->pause_ms + 999) / 1000);
+#endif
+}
+
+static void batch_report(ext2_filsys fs, struct online_batch *ob,
+			 dgrp_t groups, blk64_t blocks)
+{
+	double secs = batch_elapsed(ob);
+	double mb = (double) (blocks - ob->old_blocks) * fs->blocksize /
+		(1024 * 1024);
+
+	if (!ob->report)
+		return;
+	printf(_("Grown to %llu blocks (group %u of %u, %.0f%%), "
+		 "%.1f MB/s\n"), (unsigned long long) blocks,
+	       groups, ob->new_groups,
+	       ob->new_groups == ob->old_groups ? 100.0 :
+	       100.0 * (groups - ob->old_groups) /
+	       (ob->new_groups - ob->old_groups),
+	       secs > 0 ? mb / secs : 0.0);
+	fflush(stdout);
+}
+
+static void batch_done(ext2_filsys fs, struct online_batch *ob,
+		       blk64_t blocks)
+{
+	double secs = batch_elapsed(ob);
+
+	if (!ob->report)
+		return;
+	printf(_("Added %u groups (%llu blocks) in %.1f seconds\n"),
+	       ob->new_groups - ob->old_groups,
+	       (unsigned long long) (blocks - ob->old_blocks), secs);
+}
+
+/*
+ * Grow with EXT4_IOC_RESIZE_FS, ob->groups block groups per call.
+ * Returns 0 when done, or -1 with errno set if the very first call
+ * failed so that the caller can fall back to the old interface.
+ */
+static int resize_fs_batched(ext2_filsys fs, int fd, blk64_t new_size,
+			     struct online_batch *ob)
+{
+	blk64_t first = fs->super->s_first_data_block;
+	blk64_t bpg = EXT2_BLOCKS_PER_GROUP(fs->super);
+	blk64_t size = ext2fs_blocks_count(fs->super);
+	dgrp_t groups = fs->group_desc_count;
+	int first_step = 1;
+
+	while (size < new_size) {
+		blk64_t target;
+
+		groups += ob->groups;
+		target = first + (blk64_t) groups * bpg;
+		if (groups > ob->new_groups || target > new_size) {
+			groups = ob->new_groups;
+			target = new_size;
+		}
+		if (ioctl(fd, EXT4_IOC_RESIZE_FS, &target)) {
+			if (first_step)
+				return -1;
+			com_err(program_name, errno,
+				_("While growing the filesystem to %llu blocks"),
+				(unsigned long long) target);
+			exit(1);
+		}
+		first_step = 0;
+		size = target;
+		batch_report(fs, ob, groups, size);
+		if (size < new_size)
+			batch_pause(ob);
+	}
+	batch_done(fs, ob, size);
+	return 0;
+}
+
 #endif
 
 errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
-			   blk64_t *new_size, int flags EXT2FS_ATTR((unused)))
+			   blk64_t *new_size, int flags,
+			   dgrp_t batch_groups, unsigned int pause_ms)
 {
 #ifdef __linux__
+	struct online_batch	ob;
 	struct ext2_new_group_input input;
 	struct ext4_new_group_input input64;
 	struct ext2_super_block *sb = fs->super;
@@ -131,6 +250,26 @@ errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
 		}
 	}
 
+	memset(&ob, 0, sizeof(ob));
+	ob.groups = batch_groups;
+	ob.pause_ms = pause_ms;
+	ob.report = batch_groups || (flags & RESIZE_PERCENT_COMPLETE);
+	ob.old_groups = fs->group_desc_count;
+	ob.new_groups = ext2fs_div64_ceil(*new_size -
+					  fs->super->s_first_data_block,
+					  EXT2_BLOCKS_PER_GROUP(fs->super));
+	ob.old_blocks = ext2fs_blocks_count(sb);
+	gettimeofday(&ob.start, 0);
+
+	/*
+	 * The kernel leaves the inode tables of new groups to the lazy
+	 * itable init thread only when it can mark them uninitialized.
+	 */
+	if (batch_groups && !ext2fs_has_group_desc_csum(fs))
+		printf(_("Note: without the uninit_bg or metadata_csum "
+			 "feature, every new inode table is zeroed while "
+			 "the filesystem is grown.\n"));
+
 	fd = open(mtpt, O_RDONLY);
 	if (fd < 0) {
 		com_err(program_name, errno,
@@ -140,7 +279,9 @@ errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
 
 	if (no_resize_ioctl) {
 		printf(_("Old resize interface requested.\n"));
-	} else if (ioctl(fd, EXT4_IOC_RESIZE_FS, new_size)) {
+	} else if (batch_groups ?
+		   resize_fs_batched(fs, fd, *new_size, &ob) :
+		   ioctl(fd, EXT4_IOC_RESIZE_FS, new_size)) {
 		/*
 		 * If kernel does not support EXT4_IOC_RESIZE_FS, use the
 		 * old online resize. Note that the old approach does not
@@ -166,6 +307,8 @@ errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
 			exit(1);
 		}
 	} else {
+		if (!batch_groups)
+			batch_done(fs, &ob, *new_size);
 		close(fd);
 		return 0;
 	}
@@ -261,7 +404,7 @@ errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
 
 		if (use_old_ioctl &&
 		    ioctl(fd, EXT2_IOC_GROUP_ADD, &input) == 0)
-			continue;
+			goto added;
 		else
 			use_old_ioctl = 0;
 
@@ -279,7 +422,17 @@ errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
 				input.group);
 			exit(1);
 		}
+	added:
+		/* This interface adds one group per call; pace per batch */
+		if (batch_groups &&
+		    (i + 1 - fs->group_desc_count) % batch_groups == 0 &&
+		    i + 1 < new_fs->group_desc_count) {
+			batch_report(fs, &ob, i + 1,
+				     ext2fs_group_last_block2(new_fs, i) + 1);
+			batch_pause(&ob);
+		}
 	}
+	batch_done(fs, &ob, *new_size);
 
 	ext2fs_free(new_fs);
 	close(fd);
@@ -168,7 +168,8 @@ extern char *program_name;
 
 /* online.c */
 extern errcode_t online_resize_fs(ext2_filsys fs, const char *mtpt,
-				  blk64_t *new_size, int flags);
+				  blk64_t *new_size, int flags,
+				  dgrp_t batch_groups, unsigned int pause_ms);
 
 /* resource_track.c */
 extern void init_resource_track(struct resource_track *track, const char *desc,
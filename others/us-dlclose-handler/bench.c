@@ -0,0 +1,716 @@
+/*
+ * dlbench: measure what loading a shared library costs.
+ *
+ * Every thread loops dlopen -> dlsym -> first call -> dlclose over the
+ * libraries given on the command line and the latency of each step is
+ * recorded.  Libraries built by genlib.sh export their symbol count,
+ * so all of their symbols are looked up and the first call of sym_0
+ * walks the whole chain of PLT calls (lazy binding happens there, or
+ * already in dlopen with RTLD_NOW).  Any other library is only opened
+ * and closed.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <elf.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __GLIBC__
+#include <gnu/libc-version.h>
+#endif
+
+#define MAX_LIBS 64
+
+enum { PH_OPEN, PH_SYM, PH_CALL, PH_CLOSE, PH_NUM };
+static const char *phase_name[PH_NUM] = { "dlopen", "dlsym", "call", "dlclose" };
+
+struct LibInfo
+{
+    const char *path;
+    unsigned long size;         /* bytes mapped by PT_LOAD segments */
+    unsigned long rel_relative; /* relocations needing no symbol lookup */
+    unsigned long rel_symbol;   /* relocations resolved by symbol */
+    unsigned long rel_plt;      /* PLT slots, bound lazily or at load */
+    int bind_now;
+    int symbolic;
+    int nsyms;
+};
+
+struct Samples
+{
+    double *us;
+    long count;
+};
+
+struct Worker
+{
+    pthread_t thread;
+    int id;
+    struct Samples phase[MAX_LIBS][PH_NUM];
+};
+
+static struct LibInfo libs[MAX_LIBS];
+static int nlibs;
+static int iterations = 100;
+static int nthreads = 1;
+static int open_flags = RTLD_LAZY;
+static int csv;
+static int distinct;                    /* thread i only loads library i */
+static int sweep;                       /* run 1, 2, 4 ... nthreads threads */
+static int unload;                      /* memory accounting of dlclose */
+static int drop_cache;                  /* evict the library between cycles */
+static pthread_barrier_t start_barrier;
+
+static double NowUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void AddSample(struct Samples *s, double us)
+{
+    s->us[s->count++] = us;
+}
+
+static const char *BaseName(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+
+    return slash ? slash + 1 : path;
+}
+
+/*
+ * Sum up the dynamic relocations of a loaded library.  dl_iterate_phdr()
+ * is used rather than dlinfo() because bionic has it too.
+ */
+static int InspectPhdr(struct dl_phdr_info *info, size_t size, void *arg)
+{
+    struct LibInfo *lib = arg;
+    const ElfW(Dyn) *dyn = NULL;
+    unsigned long relsz = 0, relent = 0, relcount = 0, pltrelsz = 0;
+    unsigned long pltent = sizeof(ElfW(Rela));
+    int i;
+
+    (void)size;
+    if (!info->dlpi_name || strcmp(BaseName(info->dlpi_name), BaseName(lib->path)))
+        return 0;
+
+    for (i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+
+        if (ph->p_type == PT_LOAD)
+            lib->size += ph->p_memsz;
+        else if (ph->p_type == PT_DYNAMIC)
+            dyn = (const ElfW(Dyn) *)(info->dlpi_addr + ph->p_vaddr);
+    }
+
+    for (; dyn && dyn->d_tag != DT_NULL; dyn++)
+    {
+        switch (dyn->d_tag)
+        {
+        case DT_RELASZ:
+        case DT_RELSZ:
+            relsz += dyn->d_un.d_val;
+            break;
+        case DT_RELAENT:
+        case DT_RELENT:
+            relent = dyn->d_un.d_val;
+            break;
+        case DT_RELACOUNT:
+        case DT_RELCOUNT:
+            relcount = dyn->d_un.d_val;
+            break;
+        case DT_PLTRELSZ:
+            pltrelsz = dyn->d_un.d_val;
+            break;
+        case DT_PLTREL:
+            pltent = dyn->d_un.d_val == DT_REL ? sizeof(ElfW(Rel)) : sizeof(ElfW(Rela));
+            break;
+        case DT_BIND_NOW:
+            lib->bind_now = 1;
+            break;
+        case DT_FLAGS:
+            if (dyn->d_un.d_val & DF_BIND_NOW)
+                lib->bind_now = 1;
+            if (dyn->d_un.d_val & DF_SYMBOLIC)
+                lib->symbolic = 1;
+            break;
+        case DT_FLAGS_1:
+            if (dyn->d_un.d_val & DF_1_NOW)
+                lib->bind_now = 1;
+            break;
+        case DT_SYMBOLIC:
+            lib->symbolic = 1;
+            break;
+        }
+    }
+
+    if (relent)
+    {
+        lib->rel_relative = relcount;
+        lib->rel_symbol = relsz / relent - relcount;
+    }
+    lib->rel_plt = pltrelsz / pltent;
+    return 1;
+}
+
+static int InspectLib(struct LibInfo *lib)
+{
+    void *handle = dlopen(lib->path, RTLD_LAZY);
+    int *nsyms;
+
+    if (handle == NULL)
+    {
+        printf("ERROR:%s:dlopen\n", dlerror());
+        return -1;
+    }
+    nsyms = (int *)dlsym(handle, "dlbench_nsyms");
+    lib->nsyms = nsyms ? *nsyms : 0;
+    dl_iterate_phdr(InspectPhdr, lib);
+    dlclose(handle);
+    return 0;
+}
+
+static void *LoadRun(void *arg)
+{
+    struct Worker *w = arg;
+    char name[32];
+    double t0, t1;
+    int it, l, s;
+
+    pthread_barrier_wait(&start_barrier);
+    for (it = 0; it < iterations; it++)
+    {
+        for (l = distinct ? w->id % nlibs : 0; l < nlibs; l++)
+        {
+            struct LibInfo *lib = &libs[l];
+            int (*sym0)(int) = NULL;
+            void *handle;
+
+            t0 = NowUs();
+            handle = dlopen(lib->path, open_flags);
+            t1 = NowUs();
+            if (handle == NULL)
+            {
+                printf("ERROR:%s:dlopen\n", dlerror());
+                return (void *)-1;
+            }
+            AddSample(&w->phase[l][PH_OPEN], t1 - t0);
+
+            if (lib->nsyms > 0)
+            {
+                t0 = NowUs();
+                for (s = 0; s < lib->nsyms; s++)
+                {
+                    void *p;
+
+                    snprintf(name, sizeof(name), "sym_%d", s);
+                    p = dlsym(handle, name);
+                    if (p == NULL)
+                    {
+                        printf("ERROR:%s:dlsym\n", dlerror());
+                        dlclose(handle);
+                        return (void *)-1;
+                    }
+                    if (s == 0)
+                        sym0 = (int (*)(int))p;
+                }
+                t1 = NowUs();
+                AddSample(&w->phase[l][PH_SYM], t1 - t0);
+
+                t0 = NowUs();
+                /* sym_i(d) adds one per hop down to sym_{N-1}(0) = N - 1 */
+                if (sym0(lib->nsyms - 1) != 2 * (lib->nsyms - 1))
+                    printf("ERROR:%s: unexpected call result\n", lib->path);
+                t1 = NowUs();
+                AddSample(&w->phase[l][PH_CALL], t1 - t0);
+            }
+
+            t0 = NowUs();
+            dlclose(handle);
+            t1 = NowUs();
+            AddSample(&w->phase[l][PH_CLOSE], t1 - t0);
+            if (distinct)
+                break;
+        }
+    }
+    return NULL;
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void PrintStats(const char *lib, const char *what, struct Samples *s)
+{
+    double sum = 0;
+    long i;
+
+    if (s->count == 0)
+        return;
+    qsort(s->us, s->count, sizeof(double), CompareDouble);
+    for (i = 0; i < s->count; i++)
+        sum += s->us[i];
+    printf(csv ? "%s,%s,%ld,%.2f,%.2f,%.2f,%.2f,%.2f\n" :
+           "%-24s %-8s %8ld %10.2f %10.2f %10.2f %10.2f %10.2f\n", lib, what, s->count,
+           s->us[0], s->us[s->count / 2], s->us[s->count * 99 / 100],
+           s->us[s->count - 1], sum / s->count);
+}
+
+/* Which loader is being measured, for comparing glibc and bionic runs */
+static void PrintLoader(void)
+{
+#if defined(__BIONIC__)
+    printf("%sloader: bionic, API level %d\n", csv ? "# " : "", __ANDROID_API__);
+#elif defined(__GLIBC__)
+    printf("%sloader: glibc %s\n", csv ? "# " : "", gnu_get_libc_version());
+#else
+    printf("%sloader: unknown libc\n", csv ? "# " : "");
+#endif
+}
+
+static void PrintLibs(void)
+{
+    int i;
+
+    if (csv)
+        printf("library,size,symbols,rel_relative,rel_symbol,rel_plt,bind_now,symbolic\n");
+    else
+        printf("%-24s %10s %8s %10s %10s %8s %s\n", "library", "size", "symbols",
+               "relative", "symbolic", "plt", "flags");
+    for (i = 0; i < nlibs; i++)
+    {
+        struct LibInfo *lib = &libs[i];
+
+        if (csv)
+            printf("%s,%lu,%d,%lu,%lu,%lu,%d,%d\n", lib->path, lib->size, lib->nsyms,
+                   lib->rel_relative, lib->rel_symbol, lib->rel_plt,
+                   lib->bind_now, lib->symbolic);
+        else
+            printf("%-24s %10lu %8d %10lu %10lu %8lu %s%s\n", lib->path, lib->size,
+                   lib->nsyms, lib->rel_relative, lib->rel_symbol, lib->rel_plt,
+                   lib->bind_now ? "now " : "lazy ", lib->symbolic ? "symbolic" : "");
+    }
+}
+
+/*
+ * Run `threads` loaders at once.  Returns the workers with their samples
+ * and the wall time from the start barrier until the last one finished.
+ */
+static struct Worker *RunLoaders(int threads, double *elapsed, int *rc)
+{
+    struct Worker *workers = calloc(threads, sizeof(*workers));
+    double t0;
+    int i, l, p;
+
+    for (i = 0; i < threads; i++)
+        for (l = 0; l < nlibs; l++)
+            for (p = 0; p < PH_NUM; p++)
+                workers[i].phase[l][p].us = calloc(iterations, sizeof(double));
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, &LoadRun, &workers[i]);
+    }
+    pthread_barrier_wait(&start_barrier);
+    t0 = NowUs();
+    for (i = 0; i < threads; i++)
+    {
+        void *status;
+
+        pthread_join(workers[i].thread, &status);
+        if (status != NULL)
+            *rc = 1;
+    }
+    *elapsed = NowUs() - t0;
+    pthread_barrier_destroy(&start_barrier);
+    return workers;
+}
+
+/* Gather one library's (or with lib < 0, every library's) phase samples */
+static void Collect(struct Worker *workers, int threads, int lib, int phase,
+                    struct Samples *total)
+{
+    int i, l;
+
+    total->count = 0;
+    for (i = 0; i < threads; i++)
+    {
+        for (l = 0; l < nlibs; l++)
+        {
+            struct Samples *s = &workers[i].phase[l][phase];
+
+            if (lib >= 0 && l != lib)
+                continue;
+            memcpy(total->us + total->count, s->us, s->count * sizeof(double));
+            total->count += s->count;
+        }
+    }
+}
+
+static void FreeWorkers(struct Worker *workers, int threads)
+{
+    int i, l, p;
+
+    for (i = 0; i < threads; i++)
+        for (l = 0; l < nlibs; l++)
+            for (p = 0; p < PH_NUM; p++)
+                free(workers[i].phase[l][p].us);
+    free(workers);
+}
+
+/*
+ * Resident and proportional set size of the whole process in kB, from
+ * smaps_rollup, or by adding up smaps on kernels older than 4.14.
+ */
+static int ReadMemory(long *rss_kb, long *pss_kb)
+{
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long v;
+
+    *rss_kb = *pss_kb = 0;
+    if (f == NULL)
+        f = fopen("/proc/self/smaps", "r");
+    if (f == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "Rss: %ld kB", &v) == 1)
+            *rss_kb += v;
+        else if (sscanf(line, "Pss: %ld kB", &v) == 1)
+            *pss_kb += v;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* How much of a file is in the page cache, in kB, without faulting it in */
+static long CachedKb(const char *path, long *size_kb)
+{
+    long page = sysconf(_SC_PAGESIZE), pages, resident = 0, i;
+    unsigned char *vec;
+    struct stat st;
+    void *map;
+    int fd;
+
+    *size_kb = 0;
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *size_kb = (st.st_size + 1023) / 1024;
+    pages = (st.st_size + page - 1) / page;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    vec = malloc(pages);
+    if (map != MAP_FAILED && vec && mincore(map, st.st_size, vec) == 0)
+        for (i = 0; i < pages; i++)
+            resident += vec[i] & 1;
+    else
+        resident = -1;
+    if (map != MAP_FAILED)
+        munmap(map, st.st_size);
+    free(vec);
+    close(fd);
+    if (resident < 0)
+        return -1;
+    /* the last page is partly beyond end of file */
+    return resident * (page / 1024) < *size_kb ? resident * (page / 1024) : *size_kb;
+}
+
+/*
+ * Stand-in for memory pressure: evict the file's unmapped pages.  Dirty
+ * pages of a freshly built library can't be dropped, so write them first.
+ */
+static void DropCache(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+struct UnloadCycle
+{
+    double load_us;                     /* dlopen + dlsym + first call */
+    long cached_kb;                     /* page cache before loading */
+    long rss_loaded, pss_loaded;
+    long rss_unloaded, pss_unloaded;
+    long cached_after;                  /* page cache after dlclose */
+};
+
+/*
+ * Load, use and unload one library `iterations` times, recording what the
+ * process and the page cache hold in between.  What dlclose releases is
+ * the loaded minus the unloaded set size; what unloading costs is the
+ * reload time, which grows once the library drops out of the page cache.
+ */
+static int RunUnload(struct LibInfo *lib)
+{
+    struct UnloadCycle *cy = calloc(iterations, sizeof(*cy));
+    long base_rss, base_pss, size_kb;
+    double reload = 0, rss_freed = 0, pss_freed = 0, rss_kept = 0, pss_kept = 0;
+    char name[32];
+    int it, s;
+
+    ReadMemory(&base_rss, &base_pss);
+    CachedKb(lib->path, &size_kb);
+    for (it = 0; it < iterations; it++)
+    {
+        struct UnloadCycle *c = &cy[it];
+        int (*sym0)(int) = NULL;
+        void *handle;
+        double t0;
+
+        if (drop_cache)
+            DropCache(lib->path);
+        c->cached_kb = CachedKb(lib->path, &size_kb);
+
+        t0 = NowUs();
+        handle = dlopen(lib->path, open_flags);
+        if (handle == NULL)
+        {
+            printf("ERROR:%s:dlopen\n", dlerror());
+            free(cy);
+            return -1;
+        }
+        for (s = 0; s < lib->nsyms; s++)
+        {
+            void *p;
+
+            snprintf(name, sizeof(name), "sym_%d", s);
+            p = dlsym(handle, name);
+            if (s == 0)
+                sym0 = (int (*)(int))p;
+        }
+        if (sym0)
+            sym0(lib->nsyms - 1);
+        c->load_us = NowUs() - t0;
+        ReadMemory(&c->rss_loaded, &c->pss_loaded);
+
+        dlclose(handle);
+        ReadMemory(&c->rss_unloaded, &c->pss_unloaded);
+        c->cached_after = CachedKb(lib->path, &size_kb);
+
+        if (csv)
+            printf("%s,%d,%.2f,%ld,%ld,%ld,%ld,%ld,%ld\n", lib->path, it, c->load_us,
+                   c->cached_kb, c->rss_loaded, c->pss_loaded, c->rss_unloaded,
+                   c->pss_unloaded, c->cached_after);
+        if (it > 0)
+            reload += c->load_us;
+        rss_freed += c->rss_loaded - c->rss_unloaded;
+        pss_freed += c->pss_loaded - c->pss_unloaded;
+        rss_kept += c->rss_unloaded - base_rss;
+        pss_kept += c->pss_unloaded - base_pss;
+    }
+
+    if (iterations > 1)
+        reload /= iterations - 1;
+    printf("%s%s: %ld kB file, %lu kB mapped, %d cycle(s)%s\n", csv ? "# " : "\n",
+           lib->path, size_kb, lib->size / 1024, iterations,
+           drop_cache ? ", page cache dropped each cycle" : "");
+    printf("%s  first load %.2f us with %ld kB cached, reload mean %.2f us\n",
+           csv ? "# " : "", cy[0].load_us, cy[0].cached_kb, iterations > 1 ? reload : cy[0].load_us);
+    printf("%s  dlclose releases RSS %.0f kB, PSS %.0f kB; "
+           "left over after unload RSS %.0f kB, PSS %.0f kB\n",
+           csv ? "# " : "", rss_freed / iterations, pss_freed / iterations,
+           rss_kept / iterations, pss_kept / iterations);
+    printf("%s  page cache keeps %ld of %ld kB after the last dlclose\n",
+           csv ? "# " : "", cy[iterations - 1].cached_after, size_kb);
+    free(cy);
+    return 0;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-cdDSU] [-n iterations] [-t threads] [-m lazy|now] library...\n"
+            "  -c  print CSV instead of a table\n"
+            "  -d  thread i loads only library i %% count (distinct), not all (shared)\n"
+            "  -D  with -U, drop the library from the page cache before each cycle\n"
+            "  -n  load cycles per thread and library (default 100)\n"
+            "  -S  scaling sweep over 1, 2, 4 ... threads up to -t\n"
+            "  -U  RSS, PSS and page cache before and after dlclose, per cycle\n"
+            "  -t  threads loading concurrently (default 1)\n"
+            "  -m  dlopen with RTLD_LAZY (default) or RTLD_NOW\n",
+            prog);
+    exit(1);
+}
+
+/*
+ * One line per thread count: total and per-thread throughput, the speedup
+ * over a single loader, and the dlopen latency seen by each call.  With
+ * a global loader lock the speedup stays near 1 however many threads run.
+ */
+static int RunSweep(struct Samples *total)
+{
+    double elapsed, base = 0;
+    int t, rc = 0;
+
+    if (csv)
+        printf("threads,mode,loads,loads_per_s,per_thread_per_s,speedup,"
+               "dlopen_p50_us,dlopen_p99_us,cycle_mean_us\n");
+    else
+        printf("%7s %-8s %8s %11s %11s %7s %10s %10s %10s\n", "threads", "mode",
+               "loads", "loads/s", "/s/thread", "speedup", "open_p50", "open_p99",
+               "cycle_us");
+    for (t = 1; t <= nthreads; t = t < nthreads && t * 2 > nthreads ? nthreads : t * 2)
+    {
+        struct Worker *workers = RunLoaders(t, &elapsed, &rc);
+        double cycle = 0, rate;
+        long loads;
+        int p;
+
+        for (p = 0; p < PH_NUM; p++)
+        {
+            long i;
+
+            Collect(workers, t, -1, p, total);
+            for (i = 0; i < total->count; i++)
+                cycle += total->us[i];
+        }
+        Collect(workers, t, -1, PH_OPEN, total);
+        loads = total->count;
+        cycle /= loads;
+        qsort(total->us, total->count, sizeof(double), CompareDouble);
+        rate = loads / (elapsed / 1e6);
+        if (t == 1)
+            base = rate;
+        printf(csv ? "%d,%s,%ld,%.0f,%.0f,%.2f,%.2f,%.2f,%.2f\n" :
+               "%7d %-8s %8ld %11.0f %11.0f %7.2f %10.2f %10.2f %10.2f\n",
+               t, distinct ? "distinct" : "shared", loads, rate, rate / t, rate / base,
+               total->us[loads / 2], total->us[loads * 99 / 100], cycle);
+        fflush(stdout);
+        FreeWorkers(workers, t);
+    }
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    struct Worker *workers;
+    struct Samples total;
+    double elapsed;
+    long loads = 0;
+    int c, i, l, p, rc = 0;
+
+    while ((c = getopt(argc, argv, "cdDSUn:t:m:")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            csv = 1;
+            break;
+        case 'd':
+            distinct = 1;
+            break;
+        case 'D':
+            drop_cache = 1;
+            break;
+        case 'S':
+            sweep = 1;
+            break;
+        case 'U':
+            unload = 1;
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'm':
+            if (strcmp(optarg, "lazy") == 0)
+                open_flags = RTLD_LAZY;
+            else if (strcmp(optarg, "now") == 0)
+                open_flags = RTLD_NOW;
+            else
+                Usage(argv[0]);
+            break;
+        default:
+            Usage(argv[0]);
+        }
+    }
+    if (optind == argc || iterations <= 0 || nthreads <= 0 || argc - optind > MAX_LIBS)
+        Usage(argv[0]);
+
+    for (i = optind; i < argc; i++)
+    {
+        libs[nlibs].path = argv[i];
+        if (InspectLib(&libs[nlibs]))
+            return 1;
+        nlibs++;
+    }
+
+    PrintLoader();
+    PrintLibs();
+    if (unload && csv)
+        printf("library,cycle,load_us,cached_kb,rss_loaded_kb,pss_loaded_kb,"
+               "rss_unloaded_kb,pss_unloaded_kb,cached_after_kb\n");
+    total.us = calloc((size_t)nthreads * iterations * nlibs, sizeof(double));
+
+    if (unload)
+    {
+        for (l = 0; l < nlibs; l++)
+            if (RunUnload(&libs[l]))
+                rc = 1;
+        free(total.us);
+        return rc;
+    }
+
+    if (sweep)
+    {
+        printf("%s%d cycle(s) per thread, %s\n", csv ? "# " : "\n", iterations,
+               open_flags == RTLD_NOW ? "RTLD_NOW" : "RTLD_LAZY");
+        rc = RunSweep(&total);
+        free(total.us);
+        return rc;
+    }
+
+    workers = RunLoaders(nthreads, &elapsed, &rc);
+    for (i = 0; i < nthreads; i++)
+        for (l = 0; l < nlibs; l++)
+            loads += workers[i].phase[l][PH_OPEN].count;
+
+    printf("%s%d thread(s) x %d cycle(s), %s%s, %.0f loads/s\n", csv ? "# " : "\n",
+           nthreads, iterations, open_flags == RTLD_NOW ? "RTLD_NOW" : "RTLD_LAZY",
+           distinct ? ", distinct" : "", loads / (elapsed / 1e6));
+    if (csv)
+        printf("library,phase,count,min_us,p50_us,p99_us,max_us,mean_us\n");
+    else
+        printf("%-24s %-8s %8s %10s %10s %10s %10s %10s\n", "library", "phase",
+               "count", "min_us", "p50_us", "p99_us", "max_us", "mean_us");
+    for (l = 0; l < nlibs; l++)
+    {
+        for (p = 0; p < PH_NUM; p++)
+        {
+            Collect(workers, nthreads, l, p, &total);
+            PrintStats(libs[l].path, phase_name[p], &total);
+        }
+    }
+    FreeWorkers(workers, nthreads);
+    free(total.us);
+    return rc;
+}
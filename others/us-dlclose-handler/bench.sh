@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+#
+# Build dlbench and a set of generated libraries, then measure load cost
+# against symbol count, library size, binding mode and concurrent loaders.
+# ITER=n and THREADS=n override the defaults; extra arguments go to dlbench.
+
+set -e
+cd "$(dirname "$0")"
+iter=${ITER:-100}
+threads=${THREADS:-4}
+
+gcc -O2 -o dlbench bench.c -ldl -lpthread
+
+# symbol count, with relocations growing alongside
+for syms in 10 100 1000 10000; do
+    bash ./genlib.sh sym$syms $syms $syms 4
+done
+# library size, at a fixed symbol count
+for kb in 64 1024 16384; do
+    bash ./genlib.sh pad$kb 100 100 $kb
+done
+# binding: the same library bound at load time, and with its own
+# references bound by the static linker (what prelinking used to buy)
+bash ./genlib.sh now1000 1000 1000 4 -Wl,-z,now
+bash ./genlib.sh symbolic1000 1000 1000 4 -Wl,-Bsymbolic
+# one copy per thread for the distinct-library scaling run
+dists=
+for ((i = 0; i < threads; i++)); do
+    bash ./genlib.sh dist$i 1000 1000 4
+    dists="$dists ./libdist$i.so"
+done
+
+syms="./libsym10.so ./libsym100.so ./libsym1000.so ./libsym10000.so"
+pads="./libpad64.so ./libpad1024.so ./libpad16384.so"
+binds="./libsym1000.so ./libnow1000.so ./libsymbolic1000.so"
+
+echo "=== symbol count ==="
+./dlbench -n "$iter" "$@" $syms
+echo "=== library size ==="
+./dlbench -n "$iter" "$@" $pads
+echo "=== lazy vs. BIND_NOW vs. -Bsymbolic ==="
+./dlbench -n "$iter" "$@" $binds
+./dlbench -n "$iter" -m now "$@" $binds
+echo "=== $threads concurrent loaders ==="
+./dlbench -n "$iter" -t "$threads" "$@" $binds
+echo "=== loader lock scaling: one shared library vs. one library per thread ==="
+./dlbench -n "$iter" -t "$threads" -S "$@" ./libsym1000.so
+./dlbench -n "$iter" -t "$threads" -S -d "$@" $dists
+echo "=== unload/reload: memory released by dlclose vs. reload time ==="
+./dlbench -n "$iter" -U "$@" ./libpad16384.so ./libsym10000.so
+./dlbench -n "$iter" -U -D "$@" ./libpad16384.so ./libsym10000.so
@@ -0,0 +1,40 @@
+#!/usr/bin/env bash
+#
+# genlib.sh NAME SYMS RELOCS PAD_KB [LDFLAGS...]
+#
+# Generate and build libNAME.so for dlbench:
+#   SYMS    exported functions sym_0..sym_{SYMS-1}; each one calls the next
+#           through the PLT, so the first call of sym_0 binds all of them
+#   RELOCS  entries of a table of function pointers, one relocation each
+#   PAD_KB  kilobytes of read-only data, to vary the size of the library
+# Extra arguments are passed to the linker driver (e.g. -Wl,-z,now);
+# CC selects the compiler (default gcc).
+
+if [ $# -lt 4 ]; then
+    echo "usage: $0 NAME SYMS RELOCS PAD_KB [LDFLAGS...]" >&2
+    exit 1
+fi
+
+name=$1 syms=$2 relocs=$3 pad_kb=$4
+shift 4
+src=gen_$name.c
+
+{
+    echo "int dlbench_nsyms = $syms;"
+    for ((i = 0; i < syms; i++)); do
+        echo "int sym_$i(int d);"
+    done
+    for ((i = 0; i < syms; i++)); do
+        echo "int sym_$i(int d) { return d > 0 ? sym_$(( (i + 1) % syms ))(d - 1) + 1 : $i; }"
+    done
+    echo "int (*const dlbench_table[])(int) = {"
+    for ((i = 0; i < relocs; i++)); do
+        echo "    sym_$(( i % syms )),"
+    done
+    echo "    0 };"
+    echo "const char dlbench_pad[$pad_kb * 1024 + 1] = {"
+    echo "    $(seq -s, 1 $(( pad_kb > 0 ? 64 : 1 )))"
+    echo "};"
+} > "$src"
+
+${CC:-gcc} -O1 -fPIC -shared -o "lib$name.so" "$src" "$@" && rm -f "$src"
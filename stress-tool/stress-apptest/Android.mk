@@ -5,16 +5,40 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
 	src/main.cc \
 	src/adler32memcpy.cc \
+	src/checkpoint.cc \
+	src/report.cc \
+	src/cpu_kernels.cc \
+	src/cpu_topology.cc \
 	src/disk_blocks.cc \
+	src/disk_orchestrator.cc \
+	src/disk_uring.cc \
+	src/dram_map.cc \
+	src/edac_monitor.cc \
 	src/error_diag.cc \
+	src/error_log.cc \
 	src/finelock_queue.cc \
+	src/latency_histogram.cc \
+	src/io_buffers.cc \
 	src/logger.cc \
+	src/march.cc \
+	src/net_coordinator.cc \
+	src/net_rdma.cc \
 	src/os.cc \
 	src/os_factory.cc \
+	src/page_table.cc \
+	src/pagemap_index.cc \
 	src/pattern.cc \
+	src/power_wave.cc \
+	src/prng.cc \
 	src/queue.cc \
+	src/region_source.cc \
 	src/sat.cc \
 	src/sat_factory.cc \
+	src/scrub.cc \
+	src/shard.cc \
+	src/sharded_queue.cc \
+	src/split_queue.cc \
+	src/telemetry.cc \
 	src/worker.cc
 
 # Build 64 bit by default
@@ -27,3 +51,54 @@ LOCAL_CFLAGS := -DHAVE_CONFIG_H -DANDROID -DNDEBUG -UDEBUG -DCHECKOPTS
 LOCAL_CPP_EXTENSION := .cc
 
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	src/adler32memcpy.cc \
+	src/checkpoint.cc \
+	src/report.cc \
+	src/cpu_kernels.cc \
+	src/cpu_topology.cc \
+	src/disk_blocks.cc \
+	src/disk_orchestrator.cc \
+	src/disk_uring.cc \
+	src/dram_map.cc \
+	src/edac_monitor.cc \
+	src/error_diag.cc \
+	src/error_log.cc \
+	src/finelock_queue.cc \
+	src/latency_histogram.cc \
+	src/io_buffers.cc \
+	src/logger.cc \
+	src/march.cc \
+	src/net_coordinator.cc \
+	src/net_rdma.cc \
+	src/os.cc \
+	src/os_factory.cc \
+	src/page_table.cc \
+	src/pagemap_index.cc \
+	src/pattern.cc \
+	src/power_wave.cc \
+	src/prng.cc \
+	src/queue.cc \
+	src/region_source.cc \
+	src/sat.cc \
+	src/sat_api.cc \
+	src/sat_factory.cc \
+	src/scrub.cc \
+	src/shard.cc \
+	src/sharded_queue.cc \
+	src/split_queue.cc \
+	src/telemetry.cc \
+	src/worker.cc
+
+LOCAL_MODULE:= libstressapptest
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -DHAVE_CONFIG_H -DANDROID -DNDEBUG -UDEBUG -DCHECKOPTS
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/src
+
+include $(BUILD_STATIC_LIBRARY)
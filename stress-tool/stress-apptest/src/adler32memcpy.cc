@@ -14,6 +14,15 @@
 
 #include "adler32memcpy.h"
 
+#if defined(STRESSAPPTEST_CPU_X86_64) && defined(__GNUC__)
+#include <immintrin.h>
+#define STRESSAPPTEST_ADLER_AVX 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STRESSAPPTEST_ADLER_NEON 1
+#endif
+
 // We are using (a modified form of) adler-32 checksum algorithm instead
 // of CRC since adler-32 is faster than CRC.
 // (Comparison: http://guru.multimedia.cx/crc32-vs-adler32/)
@@ -521,3 +530,673 @@ bool AdlerMemcpyAsm(uint64 *dstmem64, uint64 *srcmem64,
   return AdlerMemcpyWarmC(dstmem64, srcmem64, size_in_bytes, checksum);
 #endif
 }
+
+// Wide vector Adler copies.
+// A vector register of 128 bits holds two 64 bit words, which go to the a1
+// and a2 streams exactly as in the SSE2 code above. Wider registers, or
+// several registers processed per iteration, hold 'halves' such 128 bit
+// slices. Each slice is summed on its own, into lanes 2*h (a1 stream) and
+// 2*h+1 (a2 stream), and AdlerFoldLanes() merges the lane sums back into the
+// sequential result.
+//
+// In one iteration a stream gets 2*H dwords, dword r (0 based) coming from
+// slice h = r/2 as its even (s=1) or odd (s=2) dword. Over 'blocks'
+// iterations the sequential b term weights dword r of iteration j by
+// 2H(blocks-j) - r, while the lane b term weights it by 2(blocks-j) - s + 1.
+// The sequential term is thus H times the lane term plus a correction of
+// -2h for even dwords and H-1-2h for odd dwords. All arithmetic is modulo
+// 2^64, like the sequential code, so the results are bit identical.
+namespace {
+void AdlerFoldLanes(int halves, uint64 blocks, const uint64 *lane_a,
+                    const uint64 *lane_b, const uint64 *lane_even,
+                    uint64 *a, uint64 *b) {
+  uint64 per_stream = 2ULL * halves * blocks;
+  for (int t = 0; t < 2; t++) {
+    uint64 sum_a = 0;
+    uint64 sum_b = b[t] + per_stream * a[t];
+    for (int h = 0; h < halves; h++) {
+      uint64 even = lane_even[2 * h + t];
+      uint64 odd = lane_a[2 * h + t] - even;
+      sum_a += lane_a[2 * h + t];
+      sum_b += static_cast<uint64>(halves) * lane_b[2 * h + t];
+      sum_b += static_cast<uint64>(-2LL * h) * even;
+      sum_b += static_cast<uint64>(halves - 1LL - 2LL * h) * odd;
+    }
+    a[t] += sum_a;
+    b[t] = sum_b;
+  }
+}
+
+// Finish the words left over after the vector loop, continuing from the
+// running checksum terms.
+void AdlerMemcpyTail(uint64 *dstmem64, uint64 *srcmem64, unsigned int count,
+                     uint64 *a, uint64 *b) {
+  datacast_t data;
+  unsigned int i = 0;
+  while (i < count) {
+    data.l64 = srcmem64[i];
+    a[0] = a[0] + data.l32.l;
+    b[0] = b[0] + a[0];
+    a[0] = a[0] + data.l32.h;
+    b[0] = b[0] + a[0];
+    dstmem64[i] = data.l64;
+    i++;
+
+    data.l64 = srcmem64[i];
+    a[1] = a[1] + data.l32.l;
+    b[1] = b[1] + a[1];
+    a[1] = a[1] + data.l32.h;
+    b[1] = b[1] + a[1];
+    dstmem64[i] = data.l64;
+    i++;
+  }
+}
+}  // namespace
+
+// x86_64 AVX2 implementation of Adler memory copy, 64 bytes per iteration.
+#ifdef STRESSAPPTEST_ADLER_AVX
+__attribute__((target("avx2")))
+#endif
+bool AdlerMemcpyAvx2(uint64 *dstmem64, uint64 *srcmem64,
+                     unsigned int size_in_bytes, AdlerChecksum *checksum) {
+#ifdef STRESSAPPTEST_ADLER_AVX
+  if ((size_in_bytes >> 19) > 0) {
+    // Size is too large. Must be less than 2^19 bytes = 512 KB.
+    return false;
+  }
+
+  const int kHalves = 4;
+  uint64 blocks = size_in_bytes / 64;
+  const __m256i mask = _mm256_set1_epi64x(0xffffffffLL);
+  __m256i a0 = _mm256_setzero_si256();
+  __m256i b0 = _mm256_setzero_si256();
+  __m256i e0 = _mm256_setzero_si256();
+  __m256i a1 = _mm256_setzero_si256();
+  __m256i b1 = _mm256_setzero_si256();
+  __m256i e1 = _mm256_setzero_si256();
+  const __m256i *src = reinterpret_cast<const __m256i*>(srcmem64);
+  __m256i *dst = reinterpret_cast<__m256i*>(dstmem64);
+  // Use non temporal stores like the SSE2 copy when alignment allows.
+  bool stream = !(reinterpret_cast<uintptr_t>(dstmem64) & 31);
+
+  for (uint64 i = 0; i < blocks; i++) {
+    __m256i v0 = _mm256_loadu_si256(src + 2 * i);
+    __m256i v1 = _mm256_loadu_si256(src + 2 * i + 1);
+    if (stream) {
+      _mm256_stream_si256(dst + 2 * i, v0);
+      _mm256_stream_si256(dst + 2 * i + 1, v1);
+    } else {
+      _mm256_storeu_si256(dst + 2 * i, v0);
+      _mm256_storeu_si256(dst + 2 * i + 1, v1);
+    }
+
+    __m256i lo0 = _mm256_and_si256(v0, mask);
+    __m256i lo1 = _mm256_and_si256(v1, mask);
+    a0 = _mm256_add_epi64(a0, lo0);
+    a1 = _mm256_add_epi64(a1, lo1);
+    e0 = _mm256_add_epi64(e0, lo0);
+    e1 = _mm256_add_epi64(e1, lo1);
+    b0 = _mm256_add_epi64(b0, a0);
+    b1 = _mm256_add_epi64(b1, a1);
+    a0 = _mm256_add_epi64(a0, _mm256_srli_epi64(v0, 32));
+    a1 = _mm256_add_epi64(a1, _mm256_srli_epi64(v1, 32));
+    b0 = _mm256_add_epi64(b0, a0);
+    b1 = _mm256_add_epi64(b1, a1);
+  }
+  _mm_sfence();
+
+  uint64 lane_a[2 * kHalves], lane_b[2 * kHalves], lane_e[2 * kHalves];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_a), a0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_a + 4), a1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_b), b0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_b + 4), b1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_e), e0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_e + 4), e1);
+
+  uint64 a[2] = {1, 1};
+  uint64 b[2] = {0, 0};
+  AdlerFoldLanes(kHalves, blocks, lane_a, lane_b, lane_e, a, b);
+  AdlerMemcpyTail(dstmem64 + blocks * 8, srcmem64 + blocks * 8,
+                  (size_in_bytes - blocks * 64) / 8, a, b);
+
+  if (checksum != NULL) {
+    checksum->Set(a[0], a[1], b[0], b[1]);
+  }
+  return true;
+#else
+  return AdlerMemcpyWarmC(dstmem64, srcmem64, size_in_bytes, checksum);
+#endif
+}
+
+// x86_64 AVX-512 implementation of Adler memory copy, 128 bytes per
+// iteration.
+#ifdef STRESSAPPTEST_ADLER_AVX
+__attribute__((target("avx512f")))
+#endif
+bool AdlerMemcpyAvx512(uint64 *dstmem64, uint64 *srcmem64,
+                       unsigned int size_in_bytes, AdlerChecksum *checksum) {
+#ifdef STRESSAPPTEST_ADLER_AVX
+  if ((size_in_bytes >> 19) > 0) {
+    // Size is too large. Must be less than 2^19 bytes = 512 KB.
+    return false;
+  }
+
+  const int kHalves = 8;
+  uint64 blocks = size_in_bytes / 128;
+  const __m512i mask = _mm512_set1_epi64(0xffffffffLL);
+  __m512i a0 = _mm512_setzero_si512();
+  __m512i b0 = _mm512_setzero_si512();
+  __m512i e0 = _mm512_setzero_si512();
+  __m512i a1 = _mm512_setzero_si512();
+  __m512i b1 = _mm512_setzero_si512();
+  __m512i e1 = _mm512_setzero_si512();
+  const __m512i *src = reinterpret_cast<const __m512i*>(srcmem64);
+  __m512i *dst = reinterpret_cast<__m512i*>(dstmem64);
+  // Use non temporal stores like the SSE2 copy when alignment allows.
+  bool stream = !(reinterpret_cast<uintptr_t>(dstmem64) & 63);
+
+  for (uint64 i = 0; i < blocks; i++) {
+    __m512i v0 = _mm512_loadu_si512(src + 2 * i);
+    __m512i v1 = _mm512_loadu_si512(src + 2 * i + 1);
+    if (stream) {
+      _mm512_stream_si512(dst + 2 * i, v0);
+      _mm512_stream_si512(dst + 2 * i + 1, v1);
+    } else {
+      _mm512_storeu_si512(dst + 2 * i, v0);
+      _mm512_storeu_si512(dst + 2 * i + 1, v1);
+    }
+
+    __m512i lo0 = _mm512_and_si512(v0, mask);
+    __m512i lo1 = _mm512_and_si512(v1, mask);
+    a0 = _mm512_add_epi64(a0, lo0);
+    a1 = _mm512_add_epi64(a1, lo1);
+    e0 = _mm512_add_epi64(e0, lo0);
+    e1 = _mm512_add_epi64(e1, lo1);
+    b0 = _mm512_add_epi64(b0, a0);
+    b1 = _mm512_add_epi64(b1, a1);
+    // Zero masked shift, the unmasked form trips -Wmaybe-uninitialized.
+    a0 = _mm512_add_epi64(a0, _mm512_maskz_srli_epi64(0xff, v0, 32));
+    a1 = _mm512_add_epi64(a1, _mm512_maskz_srli_epi64(0xff, v1, 32));
+    b0 = _mm512_add_epi64(b0, a0);
+    b1 = _mm512_add_epi64(b1, a1);
+  }
+  _mm_sfence();
+
+  uint64 lane_a[2 * kHalves], lane_b[2 * kHalves], lane_e[2 * kHalves];
+  _mm512_storeu_si512(lane_a, a0);
+  _mm512_storeu_si512(lane_a + 8, a1);
+  _mm512_storeu_si512(lane_b, b0);
+  _mm512_storeu_si512(lane_b + 8, b1);
+  _mm512_storeu_si512(lane_e, e0);
+  _mm512_storeu_si512(lane_e + 8, e1);
+
+  uint64 a[2] = {1, 1};
+  uint64 b[2] = {0, 0};
+  AdlerFoldLanes(kHalves, blocks, lane_a, lane_b, lane_e, a, b);
+  AdlerMemcpyTail(dstmem64 + blocks * 16, srcmem64 + blocks * 16,
+                  (size_in_bytes - blocks * 128) / 8, a, b);
+
+  if (checksum != NULL) {
+    checksum->Set(a[0], a[1], b[0], b[1]);
+  }
+  return true;
+#else
+  return AdlerMemcpyWarmC(dstmem64, srcmem64, size_in_bytes, checksum);
+#endif
+}
+
+// ARMv8 NEON implementation of Adler memory copy, 64 bytes per iteration.
+bool AdlerMemcpyNeon(uint64 *dstmem64, uint64 *srcmem64,
+                     unsigned int size_in_bytes, AdlerChecksum *checksum) {
+#ifdef STRESSAPPTEST_ADLER_NEON
+  if ((size_in_bytes >> 19) > 0) {
+    // Size is too large. Must be less than 2^19 bytes = 512 KB.
+    return false;
+  }
+
+  const int kHalves = 4;
+  uint64 blocks = size_in_bytes / 64;
+  const uint64x2_t mask = vdupq_n_u64(0xffffffffULL);
+  uint64x2_t a[kHalves], b[kHalves], e[kHalves];
+  for (int h = 0; h < kHalves; h++) {
+    a[h] = vdupq_n_u64(0);
+    b[h] = vdupq_n_u64(0);
+    e[h] = vdupq_n_u64(0);
+  }
+
+  for (uint64 i = 0; i < blocks; i++) {
+    const uint64_t *src = reinterpret_cast<const uint64_t*>(srcmem64 + i * 8);
+    uint64_t *dst = reinterpret_cast<uint64_t*>(dstmem64 + i * 8);
+    for (int h = 0; h < kHalves; h++) {
+      uint64x2_t v = vld1q_u64(src + 2 * h);
+      vst1q_u64(dst + 2 * h, v);
+      uint64x2_t lo = vandq_u64(v, mask);
+      a[h] = vaddq_u64(a[h], lo);
+      e[h] = vaddq_u64(e[h], lo);
+      b[h] = vaddq_u64(b[h], a[h]);
+      a[h] = vaddq_u64(a[h], vshrq_n_u64(v, 32));
+      b[h] = vaddq_u64(b[h], a[h]);
+    }
+  }
+
+  uint64 lane_a[2 * kHalves], lane_b[2 * kHalves], lane_e[2 * kHalves];
+  for (int h = 0; h < kHalves; h++) {
+    vst1q_u64(reinterpret_cast<uint64_t*>(lane_a + 2 * h), a[h]);
+    vst1q_u64(reinterpret_cast<uint64_t*>(lane_b + 2 * h), b[h]);
+    vst1q_u64(reinterpret_cast<uint64_t*>(lane_e + 2 * h), e[h]);
+  }
+
+  uint64 sum_a[2] = {1, 1};
+  uint64 sum_b[2] = {0, 0};
+  AdlerFoldLanes(kHalves, blocks, lane_a, lane_b, lane_e, sum_a, sum_b);
+  AdlerMemcpyTail(dstmem64 + blocks * 8, srcmem64 + blocks * 8,
+                  (size_in_bytes - blocks * 64) / 8, sum_a, sum_b);
+
+  if (checksum != NULL) {
+    checksum->Set(sum_a[0], sum_a[1], sum_b[0], sum_b[1]);
+  }
+  return true;
+#else
+  return AdlerMemcpyWarmC(dstmem64, srcmem64, size_in_bytes, checksum);
+#endif
+}
+
+// Direct pattern compare kernels. Memory is checked 64 words at a time,
+// so that the common case of an intact chunk costs one reduction and one
+// branch, and mismatching chunks produce their bitmap word without another
+// pass over memory.
+unsigned int PatternCompareC(const uint64 *mem, const uint64 *expected,
+                             unsigned int words, uint64 *mismatch) {
+  unsigned int errors = 0;
+  for (unsigned int base = 0; base < words; base += 64) {
+    unsigned int chunk = words - base;
+    if (chunk > 64)
+      chunk = 64;
+
+    uint64 diff = 0;
+    for (unsigned int i = 0; i < chunk; i++)
+      diff |= mem[base + i] ^ expected[base + i];
+
+    uint64 bits = 0;
+    if (diff) {
+      for (unsigned int i = 0; i < chunk; i++) {
+        if (mem[base + i] != expected[base + i])
+          bits |= 1ULL << i;
+      }
+      errors += __builtin_popcountll(bits);
+    }
+    mismatch[base / 64] = bits;
+  }
+  return errors;
+}
+
+#ifdef STRESSAPPTEST_ADLER_AVX
+__attribute__((target("avx2")))
+#endif
+unsigned int PatternCompareAvx2(const uint64 *mem, const uint64 *expected,
+                                unsigned int words, uint64 *mismatch) {
+#ifdef STRESSAPPTEST_ADLER_AVX
+  unsigned int errors = 0;
+  unsigned int vectorwords = words & ~63U;
+  for (unsigned int base = 0; base < vectorwords; base += 64) {
+    const __m256i *m = reinterpret_cast<const __m256i*>(mem + base);
+    const __m256i *e = reinterpret_cast<const __m256i*>(expected + base);
+
+    __m256i diff = _mm256_setzero_si256();
+    for (int i = 0; i < 16; i++) {
+      diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256(m + i),
+                                                    _mm256_loadu_si256(e + i)));
+    }
+
+    uint64 bits = 0;
+    if (!_mm256_testz_si256(diff, diff)) {
+      for (int i = 0; i < 16; i++) {
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256(m + i),
+                                        _mm256_loadu_si256(e + i));
+        uint64 equal = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        bits |= (~equal & 0xf) << (4 * i);
+      }
+      errors += __builtin_popcountll(bits);
+    }
+    mismatch[base / 64] = bits;
+  }
+  if (vectorwords < words) {
+    errors += PatternCompareC(mem + vectorwords, expected + vectorwords,
+                              words - vectorwords, mismatch + vectorwords / 64);
+  }
+  return errors;
+#else
+  return PatternCompareC(mem, expected, words, mismatch);
+#endif
+}
+
+#ifdef STRESSAPPTEST_ADLER_AVX
+__attribute__((target("avx512f")))
+#endif
+unsigned int PatternCompareAvx512(const uint64 *mem, const uint64 *expected,
+                                  unsigned int words, uint64 *mismatch) {
+#ifdef STRESSAPPTEST_ADLER_AVX
+  unsigned int errors = 0;
+  unsigned int vectorwords = words & ~63U;
+  for (unsigned int base = 0; base < vectorwords; base += 64) {
+    const __m512i *m = reinterpret_cast<const __m512i*>(mem + base);
+    const __m512i *e = reinterpret_cast<const __m512i*>(expected + base);
+
+    // Mask compares give the bitmap directly, no separate slow pass.
+    uint64 bits = 0;
+    for (int i = 0; i < 8; i++) {
+      __mmask8 ne = _mm512_cmpneq_epi64_mask(_mm512_loadu_si512(m + i),
+                                            _mm512_loadu_si512(e + i));
+      bits |= static_cast<uint64>(ne) << (8 * i);
+    }
+    if (bits)
+      errors += __builtin_popcountll(bits);
+    mismatch[base / 64] = bits;
+  }
+  if (vectorwords < words) {
+    errors += PatternCompareC(mem + vectorwords, expected + vectorwords,
+                              words - vectorwords, mismatch + vectorwords / 64);
+  }
+  return errors;
+#else
+  return PatternCompareC(mem, expected, words, mismatch);
+#endif
+}
+
+// CRC32C (Castagnoli) kernels, four lanes of interleaved words, see
+// adler32memcpy.h. Lanes start at ~0 and are not inverted at the end,
+// they are only ever compared with each other.
+
+namespace {
+// Reflected CRC32C polynomial.
+const uint32 kCrc32cPoly = 0x82f63b78;
+
+// Byte at a time lookup table for the software fallback.
+struct Crc32cTable {
+  uint32 entry[256];
+  Crc32cTable() {
+    for (uint32 i = 0; i < 256; i++) {
+      uint32 crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ (crc & 1 ? kCrc32cPoly : 0);
+      entry[i] = crc;
+    }
+  }
+};
+
+inline uint32 Crc32cWordC(const Crc32cTable &table, uint32 crc, uint64 word) {
+  for (int byte = 0; byte < 8; byte++) {
+    crc = table.entry[(crc ^ word) & 0xff] ^ (crc >> 8);
+    word >>= 8;
+  }
+  return crc;
+}
+
+const Crc32cTable &Crc32cLookup() {
+  static const Crc32cTable table;
+  return table;
+}
+}  // namespace
+
+bool CalculateCrc32cChecksum(const uint64 *data64, unsigned int size_in_bytes,
+                             AdlerChecksum *checksum) {
+  const Crc32cTable &table = Crc32cLookup();
+  unsigned int count = size_in_bytes / sizeof(*data64);
+  uint32 crc[4] = { ~0U, ~0U, ~0U, ~0U };
+  for (unsigned int i = 0; i < count; i += 4) {
+    for (int lane = 0; lane < 4; lane++)
+      crc[lane] = Crc32cWordC(table, crc[lane], data64[i + lane]);
+  }
+  checksum->Set(crc[0], crc[1], crc[2], crc[3]);
+  return true;
+}
+
+bool Crc32cMemcpyC(uint64 *dstmem64, uint64 *srcmem64,
+                   unsigned int size_in_bytes, AdlerChecksum *checksum) {
+  const Crc32cTable &table = Crc32cLookup();
+  unsigned int count = size_in_bytes / sizeof(*srcmem64);
+  uint32 crc[4] = { ~0U, ~0U, ~0U, ~0U };
+  for (unsigned int i = 0; i < count; i += 4) {
+    for (int lane = 0; lane < 4; lane++) {
+      uint64 data = srcmem64[i + lane];
+      crc[lane] = Crc32cWordC(table, crc[lane], data);
+      dstmem64[i + lane] = data;
+    }
+  }
+  checksum->Set(crc[0], crc[1], crc[2], crc[3]);
+  return true;
+}
+
+#if defined(STRESSAPPTEST_CPU_X86_64) && defined(__GNUC__)
+#define STRESSAPPTEST_CRC32C_HW 1
+#define CRC32C_WORD(crc, data) \
+  static_cast<uint32>(__builtin_ia32_crc32di((crc), (data)))
+__attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define STRESSAPPTEST_CRC32C_HW 1
+#if defined(__clang__)
+#define CRC32C_WORD(crc, data) __builtin_arm_crc32cd((crc), (data))
+__attribute__((target("crc")))
+#else
+#define CRC32C_WORD(crc, data) __builtin_aarch64_crc32cx((crc), (data))
+__attribute__((target("+crc")))
+#endif
+#endif
+bool Crc32cMemcpyHw(uint64 *dstmem64, uint64 *srcmem64,
+                    unsigned int size_in_bytes, AdlerChecksum *checksum) {
+#ifdef STRESSAPPTEST_CRC32C_HW
+  unsigned int count = size_in_bytes / sizeof(*srcmem64);
+  uint64 crc0 = ~0U, crc1 = ~0U, crc2 = ~0U, crc3 = ~0U;
+  for (unsigned int i = 0; i < count; i += 4) {
+    uint64 data0 = srcmem64[i + 0];
+    uint64 data1 = srcmem64[i + 1];
+    uint64 data2 = srcmem64[i + 2];
+    uint64 data3 = srcmem64[i + 3];
+    crc0 = CRC32C_WORD(crc0, data0);
+    crc1 = CRC32C_WORD(crc1, data1);
+    crc2 = CRC32C_WORD(crc2, data2);
+    crc3 = CRC32C_WORD(crc3, data3);
+    dstmem64[i + 0] = data0;
+    dstmem64[i + 1] = data1;
+    dstmem64[i + 2] = data2;
+    dstmem64[i + 3] = data3;
+  }
+  checksum->Set(crc0, crc1, crc2, crc3);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Plain copy kernels for the CopyThread copy engines. Sizes are assumed to
+// be a multiple of 64 bytes, any remainder is copied with memcpy.
+
+// Copy with streaming stores that bypass the cache, so the copy measures
+// and stresses the path to DRAM rather than the last level cache.
+void MemcpyNonTemporal(void *dst, const void *src, unsigned int size) {
+  unsigned int lines = size / 64;
+  char *d = static_cast<char*>(dst);
+  const char *s = static_cast<const char*>(src);
+#if defined(STRESSAPPTEST_ADLER_AVX)
+  if ((reinterpret_cast<uintptr_t>(d) & 15) == 0) {
+    for (unsigned int i = 0; i < lines; i++) {
+      const __m128i *sv = reinterpret_cast<const __m128i*>(s);
+      __m128i *dv = reinterpret_cast<__m128i*>(d);
+      __m128i x0 = _mm_loadu_si128(sv + 0);
+      __m128i x1 = _mm_loadu_si128(sv + 1);
+      __m128i x2 = _mm_loadu_si128(sv + 2);
+      __m128i x3 = _mm_loadu_si128(sv + 3);
+      _mm_stream_si128(dv + 0, x0);
+      _mm_stream_si128(dv + 1, x1);
+      _mm_stream_si128(dv + 2, x2);
+      _mm_stream_si128(dv + 3, x3);
+      d += 64;
+      s += 64;
+    }
+    // Streaming stores are weakly ordered, fence before anyone else reads
+    // the page.
+    _mm_sfence();
+    lines = 0;
+  }
+#elif defined(__aarch64__)
+  for (unsigned int i = 0; i < lines; i++) {
+    asm volatile("ldp q0, q1, [%0]\n\t"
+                 "ldp q2, q3, [%0, #32]\n\t"
+                 "stnp q0, q1, [%1]\n\t"
+                 "stnp q2, q3, [%1, #32]\n\t"
+                 :
+                 : "r" (s), "r" (d)
+                 : "v0", "v1", "v2", "v3", "memory");
+    d += 64;
+    s += 64;
+  }
+  asm volatile("dmb ishst" : : : "memory");
+  lines = 0;
+#endif
+  memcpy(d, s, lines * 64 + size % 64);
+}
+
+// Copy one cacheline at a time, prefetching 'distance' bytes ahead of the
+// load stream so that the loads don't wait on the hardware prefetcher.
+void MemcpyPrefetch(void *dst, const void *src, unsigned int size,
+                    unsigned int distance) {
+  unsigned int lines = size / 64;
+  char *d = static_cast<char*>(dst);
+  const char *s = static_cast<const char*>(src);
+  for (unsigned int i = 0; i < lines; i++) {
+    // Prefetching past the end of the source is harmless, it can't fault.
+    __builtin_prefetch(s + distance, 0, 0);
+    memcpy(d, s, 64);
+    d += 64;
+    s += 64;
+  }
+  memcpy(d, s, size % 64);
+}
+
+// Copy with a single string move, which cpus with enhanced rep movsb
+// (ERMS) turn into their internal fast string copy.
+void MemcpyRepMovsb(void *dst, const void *src, unsigned int size) {
+#if defined(STRESSAPPTEST_CPU_X86_64) || defined(STRESSAPPTEST_CPU_I686)
+  size_t count = size;
+  asm volatile("rep movsb"
+               : "+D" (dst), "+S" (src), "+c" (count)
+               :
+               : "memory");
+#else
+  memcpy(dst, src, size);
+#endif
+}
+
+// Invert kernels for the InvertThread, one 64 byte line at a time, in the
+// order given by 'down'.
+
+void InvertMemoryC(void *mem, unsigned int size, bool down) {
+  uint64 *words = static_cast<uint64*>(mem);
+  unsigned int lines = size / 64;
+  for (unsigned int i = 0; i < lines; i++) {
+    uint64 *line = words + 8 * (down ? lines - 1 - i : i);
+    for (int j = 0; j < 8; j++)
+      line[j] = ~line[j];
+  }
+}
+
+void InvertMemoryVector(void *mem, unsigned int size, bool down) {
+  char *base = static_cast<char*>(mem);
+  unsigned int lines = size / 64;
+#if defined(STRESSAPPTEST_ADLER_AVX)
+  const __m128i ones = _mm_set1_epi32(-1);
+  for (unsigned int i = 0; i < lines; i++) {
+    __m128i *line = reinterpret_cast<__m128i*>(
+        base + 64 * (down ? lines - 1 - i : i));
+    __m128i x0 = _mm_loadu_si128(line + 0);
+    __m128i x1 = _mm_loadu_si128(line + 1);
+    __m128i x2 = _mm_loadu_si128(line + 2);
+    __m128i x3 = _mm_loadu_si128(line + 3);
+    _mm_storeu_si128(line + 0, _mm_xor_si128(x0, ones));
+    _mm_storeu_si128(line + 1, _mm_xor_si128(x1, ones));
+    _mm_storeu_si128(line + 2, _mm_xor_si128(x2, ones));
+    _mm_storeu_si128(line + 3, _mm_xor_si128(x3, ones));
+  }
+#elif defined(STRESSAPPTEST_ADLER_NEON)
+  for (unsigned int i = 0; i < lines; i++) {
+    uint8_t *line = reinterpret_cast<uint8_t*>(
+        base + 64 * (down ? lines - 1 - i : i));
+    uint8x16_t x0 = vld1q_u8(line + 0);
+    uint8x16_t x1 = vld1q_u8(line + 16);
+    uint8x16_t x2 = vld1q_u8(line + 32);
+    uint8x16_t x3 = vld1q_u8(line + 48);
+    vst1q_u8(line + 0, vmvnq_u8(x0));
+    vst1q_u8(line + 16, vmvnq_u8(x1));
+    vst1q_u8(line + 32, vmvnq_u8(x2));
+    vst1q_u8(line + 48, vmvnq_u8(x3));
+  }
+#else
+  InvertMemoryC(base, lines * 64, down);
+#endif
+}
+
+#ifdef STRESSAPPTEST_ADLER_AVX
+__attribute__((target("avx2")))
+#endif
+void InvertMemoryAvx2(void *mem, unsigned int size, bool down) {
+#ifdef STRESSAPPTEST_ADLER_AVX
+  char *base = static_cast<char*>(mem);
+  unsigned int lines = size / 64;
+  const __m256i ones = _mm256_set1_epi32(-1);
+  for (unsigned int i = 0; i < lines; i++) {
+    __m256i *line = reinterpret_cast<__m256i*>(
+        base + 64 * (down ? lines - 1 - i : i));
+    __m256i x0 = _mm256_loadu_si256(line + 0);
+    __m256i x1 = _mm256_loadu_si256(line + 1);
+    _mm256_storeu_si256(line + 0, _mm256_xor_si256(x0, ones));
+    _mm256_storeu_si256(line + 1, _mm256_xor_si256(x1, ones));
+  }
+#else
+  InvertMemoryVector(mem, size, down);
+#endif
+}
+
+// Invert with streaming stores. The stores replace the cached lines and
+// go to DRAM through the write combining buffers, so no flush is needed
+// for the next pass to read from memory.
+void InvertMemoryNonTemporal(void *mem, unsigned int size, bool down) {
+  char *base = static_cast<char*>(mem);
+  unsigned int lines = size / 64;
+#if defined(STRESSAPPTEST_ADLER_AVX)
+  if ((reinterpret_cast<uintptr_t>(base) & 15) == 0) {
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (unsigned int i = 0; i < lines; i++) {
+      __m128i *line = reinterpret_cast<__m128i*>(
+          base + 64 * (down ? lines - 1 - i : i));
+      __m128i x0 = _mm_load_si128(line + 0);
+      __m128i x1 = _mm_load_si128(line + 1);
+      __m128i x2 = _mm_load_si128(line + 2);
+      __m128i x3 = _mm_load_si128(line + 3);
+      _mm_stream_si128(line + 0, _mm_xor_si128(x0, ones));
+      _mm_stream_si128(line + 1, _mm_xor_si128(x1, ones));
+      _mm_stream_si128(line + 2, _mm_xor_si128(x2, ones));
+      _mm_stream_si128(line + 3, _mm_xor_si128(x3, ones));
+    }
+    _mm_sfence();
+    return;
+  }
+#elif defined(__aarch64__)
+  for (unsigned int i = 0; i < lines; i++) {
+    char *line = base + 64 * (down ? lines - 1 - i : i);
+    asm volatile("ldp q0, q1, [%0]\n\t"
+                 "ldp q2, q3, [%0, #32]\n\t"
+                 "mvn v0.16b, v0.16b\n\t"
+                 "mvn v1.16b, v1.16b\n\t"
+                 "mvn v2.16b, v2.16b\n\t"
+                 "mvn v3.16b, v3.16b\n\t"
+                 "stnp q0, q1, [%0]\n\t"
+                 "stnp q2, q3, [%0, #32]\n\t"
+                 :
+                 : "r" (line)
+                 : "v0", "v1", "v2", "v3", "memory");
+  }
+  asm volatile("dmb ishst" : : : "memory");
+  return;
+#endif
+  InvertMemoryC(base, lines * 64, down);
+}
@@ -55,5 +55,59 @@ bool AdlerMemcpyWarmC(uint64 *dstmem64, uint64 *srcmem64,
 bool AdlerMemcpyAsm(uint64 *dstmem64, uint64 *srcmem64,
                     unsigned int size_in_bytes, AdlerChecksum *checksum);
 
+// Wide vector implementations of Adler memory copy. These produce the same
+// checksum as AdlerMemcpyC. The caller must check that the cpu supports the
+// instruction set, on other architectures they fall back to AdlerMemcpyWarmC.
+bool AdlerMemcpyAvx2(uint64 *dstmem64, uint64 *srcmem64,
+                     unsigned int size_in_bytes, AdlerChecksum *checksum);
+bool AdlerMemcpyAvx512(uint64 *dstmem64, uint64 *srcmem64,
+                       unsigned int size_in_bytes, AdlerChecksum *checksum);
+bool AdlerMemcpyNeon(uint64 *dstmem64, uint64 *srcmem64,
+                     unsigned int size_in_bytes, AdlerChecksum *checksum);
+
+// CRC32C page checksums, used instead of Adler with --checksum crc32c.
+// 64 bit word i of the data goes to lane i % 4 and every lane gets its
+// own CRC32C, so that the cpu's crc unit always has four independent
+// chains in flight. The four lane CRCs are kept in an AdlerChecksum.
+// Sizes are a multiple of 32 bytes. Crc32cMemcpyHw needs sse4.2 on x86
+// or the crc extension on aarch64, and returns false without them.
+bool CalculateCrc32cChecksum(const uint64 *data64, unsigned int size_in_bytes,
+                             AdlerChecksum *checksum);
+bool Crc32cMemcpyC(uint64 *dstmem64, uint64 *srcmem64,
+                   unsigned int size_in_bytes, AdlerChecksum *checksum);
+bool Crc32cMemcpyHw(uint64 *dstmem64, uint64 *srcmem64,
+                    unsigned int size_in_bytes, AdlerChecksum *checksum);
+
+// Compare 'words' 64 bit words of memory against the expected data.
+// Bit i of 'mismatch' (which must hold (words + 63) / 64 entries) is set
+// if word i differs. Returns the number of mismatching words. The wide
+// variants have the same cpu support requirements as the copies above.
+unsigned int PatternCompareC(const uint64 *mem, const uint64 *expected,
+                             unsigned int words, uint64 *mismatch);
+unsigned int PatternCompareAvx2(const uint64 *mem, const uint64 *expected,
+                                unsigned int words, uint64 *mismatch);
+unsigned int PatternCompareAvx512(const uint64 *mem, const uint64 *expected,
+                                  unsigned int words, uint64 *mismatch);
+
+// Plain memory copies without a checksum, used by the CopyThread copy
+// engines: streaming non-temporal stores, software prefetch of the source
+// 'distance' bytes ahead, and a single rep movsb string move. On
+// architectures without the instructions they fall back to memcpy.
+void MemcpyNonTemporal(void *dst, const void *src, unsigned int size);
+void MemcpyPrefetch(void *dst, const void *src, unsigned int size,
+                    unsigned int distance);
+void MemcpyRepMovsb(void *dst, const void *src, unsigned int size);
+
+// In place inversion kernels for the InvertThread. 'size' is a multiple of
+// 64 bytes, and 'down' walks the buffer from its last cacheline to its
+// first. InvertMemoryVector uses sse2 or neon, InvertMemoryAvx2 needs avx2
+// like the copies above, and InvertMemoryNonTemporal writes the result back
+// with streaming stores, fenced before it returns. Without the instructions
+// they all fall back to InvertMemoryC.
+void InvertMemoryC(void *mem, unsigned int size, bool down);
+void InvertMemoryVector(void *mem, unsigned int size, bool down);
+void InvertMemoryAvx2(void *mem, unsigned int size, bool down);
+void InvertMemoryNonTemporal(void *mem, unsigned int size, bool down);
+
 
 #endif  // STRESSAPPTEST_ADLER32MEMCPY_H_
@@ -0,0 +1,135 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checkpoint file reading and writing, see checkpoint.h.
+//
+// The file is plain text, one record per line:
+//   stressapptest_checkpoint <version>
+//   config <hash>
+//   elapsed <seconds>
+//   runs <count>
+//   errors <count>
+//   status <count>
+//   type <name> <pages> <errors> <MB>
+//   device <fatal> <correctable> <name>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "checkpoint.h"
+
+namespace {
+const int kCheckpointVersion = 1;
+}  // namespace
+
+void ResetCheckpoint(struct CheckpointState *state) {
+  state->config = 0;
+  state->elapsed = 0;
+  state->runs = 0;
+  state->errors = 0;
+  state->status = 0;
+  state->types.clear();
+  state->devices.clear();
+}
+
+bool LoadCheckpoint(const char *path, struct CheckpointState *state) {
+  ResetCheckpoint(state);
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return false;
+
+  char line[4096];
+  int version = 0;
+  bool ok = fgets(line, sizeof(line), file) &&
+            sscanf(line, "stressapptest_checkpoint %d", &version) == 1 &&
+            version == kCheckpointVersion;
+  while (ok && fgets(line, sizeof(line), file)) {
+    char name[4096];
+    long long a, b;  // NOLINT
+    double data;
+    int used = 0;
+    if (sscanf(line, "config %llx", &state->config) == 1 ||
+        sscanf(line, "elapsed %lld", &state->elapsed) == 1 ||
+        sscanf(line, "runs %d", &state->runs) == 1 ||
+        sscanf(line, "errors %lld", &state->errors) == 1 ||
+        sscanf(line, "status %lld", &state->status) == 1) {
+      continue;
+    } else if (sscanf(line, "type %4095s %lld %lld %lf", name, &a, &b,
+                      &data) == 4) {
+      struct CheckpointCounts *counts = &state->types[name];
+      counts->pages = a;
+      counts->errors = b;
+      counts->data = data;
+    } else if (sscanf(line, "device %lld %lld %n", &a, &b, &used) == 2 &&
+               used) {
+      // The name is the rest of the line.
+      string device = line + used;
+      if (!device.empty() && device[device.size() - 1] == '\n')
+        device.erase(device.size() - 1);
+      state->devices[device].fatal = a;
+      state->devices[device].correctable = b;
+    } else {
+      ok = false;
+    }
+  }
+  fclose(file);
+  if (!ok)
+    ResetCheckpoint(state);
+  return ok;
+}
+
+bool SaveCheckpoint(const char *path, const struct CheckpointState &state) {
+  string temp = string(path) + ".tmp";
+  FILE *file = fopen(temp.c_str(), "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "stressapptest_checkpoint %d\n", kCheckpointVersion);
+  fprintf(file, "config %llx\n", state.config);
+  fprintf(file, "elapsed %lld\n", state.elapsed);
+  fprintf(file, "runs %d\n", state.runs);
+  fprintf(file, "errors %lld\n", state.errors);
+  fprintf(file, "status %lld\n", state.status);
+  for (map<string, struct CheckpointCounts>::const_iterator it =
+           state.types.begin(); it != state.types.end(); ++it) {
+    fprintf(file, "type %s %lld %lld %.3f\n", it->first.c_str(),
+            it->second.pages, it->second.errors, it->second.data);
+  }
+  for (DeviceErrorMap::const_iterator it = state.devices.begin();
+       it != state.devices.end(); ++it) {
+    fprintf(file, "device %lld %lld %s\n", it->second.fatal,
+            it->second.correctable, it->first.c_str());
+  }
+
+  bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+  int error = errno;
+  if (fclose(file) && ok) {
+    ok = false;
+    error = errno;
+  }
+  if (ok && rename(temp.c_str(), path)) {
+    ok = false;
+    error = errno;
+  }
+  if (!ok) {
+    unlink(temp.c_str());
+    errno = error;
+  }
+  return ok;
+}
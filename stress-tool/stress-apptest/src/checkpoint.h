@@ -0,0 +1,59 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Run state saved periodically so that a restarted run can carry on with
+// the totals of the interrupted one.
+
+#ifndef STRESSAPPTEST_CHECKPOINT_H_
+#define STRESSAPPTEST_CHECKPOINT_H_
+
+#include <map>
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "error_diag.h"
+#include "sattypes.h"
+
+// Totals of one thread type.
+struct CheckpointCounts {
+  int64 pages;
+  int64 errors;
+  double data;                      // In MB.
+};
+
+// Everything a resumed run adds to its own results.
+struct CheckpointState {
+  uint64 config;                    // Hash of the command line.
+  int64 elapsed;                    // Seconds run so far.
+  int runs;                         // Runs that contributed.
+  int64 errors;                     // Hardware incidents.
+  int64 status;                     // Procedural errors.
+  map<string, struct CheckpointCounts> types;  // By thread type name.
+  DeviceErrorMap devices;           // Errors by device.
+};
+
+// Clear 'state' to that of a fresh run.
+void ResetCheckpoint(struct CheckpointState *state);
+
+// Read 'path' into 'state'. Returns false if there is no checkpoint or it
+// can't be parsed, leaving 'state' reset.
+bool LoadCheckpoint(const char *path, struct CheckpointState *state);
+
+// Replace 'path' with 'state'. The file is written next to 'path' and
+// renamed over it, so a crash leaves either the old or the new checkpoint.
+// Returns false and sets errno on failure.
+bool SaveCheckpoint(const char *path, const struct CheckpointState &state);
+
+#endif  // STRESSAPPTEST_CHECKPOINT_H_
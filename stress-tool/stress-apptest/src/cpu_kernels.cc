@@ -0,0 +1,406 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cpu stress kernels, see cpu_kernels.h.
+
+#include <math.h>
+#include <string.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "cpu_kernels.h"
+
+#if defined(STRESSAPPTEST_CPU_X86_64) && defined(__GNUC__)
+#include <immintrin.h>
+// Built with target attributes, so that the rest of the binary still runs
+// on cpus without these extensions.
+#define STRESSAPPTEST_X86_KERNELS 1
+#endif
+
+#if defined(STRESSAPPTEST_CPU_AARCH64)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// A chaotic fma iteration, x = x * x + c, on kFmaLanes doubles.
+// Each lane stays in (-2, 2) for c above -2, and a wrong bit anywhere
+// spreads to the whole value within a few dozen iterations.
+const int kFmaLanes = 64;
+const int kFmaIterations = 100000;
+
+typedef void (*FmaIterate)(double *x, double c, int iterations);
+
+class FmaKernel : public CpuKernel {
+ public:
+  FmaKernel(const char *name, FmaIterate iterate)
+    : CpuKernel(name), iterate_(iterate) {}
+
+  virtual void Prepare() {
+    // The reference uses the scalar fma(), which rounds exactly like the
+    // vector instructions.
+    for (int seed = 0; seed < kSeeds; seed++) {
+      double c = Constant(seed);
+      Input(seed, reference_[seed]);
+      for (int lane = 0; lane < kFmaLanes; lane++) {
+        double x = reference_[seed][lane];
+        for (int i = 0; i < kFmaIterations; i++)
+          x = fma(x, x, c);
+        reference_[seed][lane] = x;
+      }
+    }
+  }
+
+  virtual int Run(int seed) {
+    double x[kFmaLanes];
+    Input(seed, x);
+    iterate_(x, Constant(seed), kFmaIterations);
+    int errors = 0;
+    for (int lane = 0; lane < kFmaLanes; lane++) {
+      if (memcmp(&x[lane], &reference_[seed][lane], sizeof(x[lane])))
+        errors++;
+    }
+    return errors;
+  }
+
+  virtual int results() const { return kFmaLanes; }
+  virtual int64 ops() const {
+    return static_cast<int64>(kFmaLanes) * kFmaIterations;
+  }
+
+ private:
+  static double Constant(int seed) {
+    return -1.99 + 0.01 * seed;
+  }
+  static void Input(int seed, double *x) {
+    for (int lane = 0; lane < kFmaLanes; lane++)
+      x[lane] = -0.9 + 1.8 * ((lane * 37 + seed * 11) % 101) / 101.;
+  }
+
+  FmaIterate iterate_;
+  double reference_[kSeeds][kFmaLanes];
+};
+
+#ifdef STRESSAPPTEST_X86_KERNELS
+// Eight independent zmm chains cover the fma latency of both ports.
+__attribute__((target("avx512f")))
+void FmaIterate512(double *x, double c, int iterations) {
+  __m512d cv = _mm512_set1_pd(c);
+  __m512d x0 = _mm512_loadu_pd(x);
+  __m512d x1 = _mm512_loadu_pd(x + 8);
+  __m512d x2 = _mm512_loadu_pd(x + 16);
+  __m512d x3 = _mm512_loadu_pd(x + 24);
+  __m512d x4 = _mm512_loadu_pd(x + 32);
+  __m512d x5 = _mm512_loadu_pd(x + 40);
+  __m512d x6 = _mm512_loadu_pd(x + 48);
+  __m512d x7 = _mm512_loadu_pd(x + 56);
+  for (int i = 0; i < iterations; i++) {
+    x0 = _mm512_fmadd_pd(x0, x0, cv);
+    x1 = _mm512_fmadd_pd(x1, x1, cv);
+    x2 = _mm512_fmadd_pd(x2, x2, cv);
+    x3 = _mm512_fmadd_pd(x3, x3, cv);
+    x4 = _mm512_fmadd_pd(x4, x4, cv);
+    x5 = _mm512_fmadd_pd(x5, x5, cv);
+    x6 = _mm512_fmadd_pd(x6, x6, cv);
+    x7 = _mm512_fmadd_pd(x7, x7, cv);
+  }
+  _mm512_storeu_pd(x, x0);
+  _mm512_storeu_pd(x + 8, x1);
+  _mm512_storeu_pd(x + 16, x2);
+  _mm512_storeu_pd(x + 24, x3);
+  _mm512_storeu_pd(x + 32, x4);
+  _mm512_storeu_pd(x + 40, x5);
+  _mm512_storeu_pd(x + 48, x6);
+  _mm512_storeu_pd(x + 56, x7);
+}
+
+// Sixteen ymm registers don't hold all 64 lanes, so do them in two halves.
+__attribute__((target("avx2,fma")))
+void FmaIterate256(double *x, double c, int iterations) {
+  __m256d cv = _mm256_set1_pd(c);
+  for (int half = 0; half < kFmaLanes; half += 32) {
+    double *h = x + half;
+    __m256d x0 = _mm256_loadu_pd(h);
+    __m256d x1 = _mm256_loadu_pd(h + 4);
+    __m256d x2 = _mm256_loadu_pd(h + 8);
+    __m256d x3 = _mm256_loadu_pd(h + 12);
+    __m256d x4 = _mm256_loadu_pd(h + 16);
+    __m256d x5 = _mm256_loadu_pd(h + 20);
+    __m256d x6 = _mm256_loadu_pd(h + 24);
+    __m256d x7 = _mm256_loadu_pd(h + 28);
+    for (int i = 0; i < iterations; i++) {
+      x0 = _mm256_fmadd_pd(x0, x0, cv);
+      x1 = _mm256_fmadd_pd(x1, x1, cv);
+      x2 = _mm256_fmadd_pd(x2, x2, cv);
+      x3 = _mm256_fmadd_pd(x3, x3, cv);
+      x4 = _mm256_fmadd_pd(x4, x4, cv);
+      x5 = _mm256_fmadd_pd(x5, x5, cv);
+      x6 = _mm256_fmadd_pd(x6, x6, cv);
+      x7 = _mm256_fmadd_pd(x7, x7, cv);
+    }
+    _mm256_storeu_pd(h, x0);
+    _mm256_storeu_pd(h + 4, x1);
+    _mm256_storeu_pd(h + 8, x2);
+    _mm256_storeu_pd(h + 12, x3);
+    _mm256_storeu_pd(h + 16, x4);
+    _mm256_storeu_pd(h + 20, x5);
+    _mm256_storeu_pd(h + 24, x6);
+    _mm256_storeu_pd(h + 28, x7);
+  }
+}
+#endif  // STRESSAPPTEST_X86_KERNELS
+
+#if defined(STRESSAPPTEST_CPU_AARCH64)
+// Sixteen lanes at a time in eight q registers.
+void FmaIterateNeon(double *x, double c, int iterations) {
+  float64x2_t cv = vdupq_n_f64(c);
+  for (int part = 0; part < kFmaLanes; part += 16) {
+    double *p = x + part;
+    float64x2_t x0 = vld1q_f64(p);
+    float64x2_t x1 = vld1q_f64(p + 2);
+    float64x2_t x2 = vld1q_f64(p + 4);
+    float64x2_t x3 = vld1q_f64(p + 6);
+    float64x2_t x4 = vld1q_f64(p + 8);
+    float64x2_t x5 = vld1q_f64(p + 10);
+    float64x2_t x6 = vld1q_f64(p + 12);
+    float64x2_t x7 = vld1q_f64(p + 14);
+    for (int i = 0; i < iterations; i++) {
+      x0 = vfmaq_f64(cv, x0, x0);
+      x1 = vfmaq_f64(cv, x1, x1);
+      x2 = vfmaq_f64(cv, x2, x2);
+      x3 = vfmaq_f64(cv, x3, x3);
+      x4 = vfmaq_f64(cv, x4, x4);
+      x5 = vfmaq_f64(cv, x5, x5);
+      x6 = vfmaq_f64(cv, x6, x6);
+      x7 = vfmaq_f64(cv, x7, x7);
+    }
+    vst1q_f64(p, x0);
+    vst1q_f64(p + 2, x1);
+    vst1q_f64(p + 4, x2);
+    vst1q_f64(p + 6, x3);
+    vst1q_f64(p + 8, x4);
+    vst1q_f64(p + 10, x5);
+    vst1q_f64(p + 12, x6);
+    vst1q_f64(p + 14, x7);
+  }
+}
+#endif  // STRESSAPPTEST_CPU_AARCH64
+
+#ifdef __SIZEOF_INT128__
+// Chains of 64x64->128 bit multiplies, each folding the product back into
+// 64 bits. The reference builds the same products from 32 bit halves, so
+// it doesn't go through the wide multiplier at all.
+const int kMulChains = 16;
+const int kMulIterations = 100000;
+
+class IntMulKernel : public CpuKernel {
+ public:
+  IntMulKernel() : CpuKernel("intmul") {}
+
+  virtual void Prepare() {
+    for (int seed = 0; seed < kSeeds; seed++) {
+      Input(seed, reference_[seed]);
+      for (int chain = 0; chain < kMulChains; chain++) {
+        uint64 x = reference_[seed][chain];
+        for (int i = 0; i < kMulIterations; i++)
+          x = SlowStep(x, Multiplier(chain), chain);
+        reference_[seed][chain] = x;
+      }
+    }
+  }
+
+  virtual int Run(int seed) {
+    uint64 x[kMulChains];
+    Input(seed, x);
+    for (int i = 0; i < kMulIterations; i++) {
+      for (int chain = 0; chain < kMulChains; chain++) {
+        unsigned __int128 p =
+            static_cast<unsigned __int128>(x[chain]) * Multiplier(chain);
+        x[chain] = (static_cast<uint64>(p) ^ static_cast<uint64>(p >> 64)) +
+                   chain;
+      }
+    }
+    int errors = 0;
+    for (int chain = 0; chain < kMulChains; chain++) {
+      if (x[chain] != reference_[seed][chain])
+        errors++;
+    }
+    return errors;
+  }
+
+  virtual int results() const { return kMulChains; }
+  virtual int64 ops() const {
+    return static_cast<int64>(kMulChains) * kMulIterations;
+  }
+
+ private:
+  static uint64 Multiplier(int chain) {
+    // Odd, with bits set all over.
+    return 0x9E3779B97F4A7C15ULL + 2ULL * chain * 0x2545F4914F6CDD1DULL;
+  }
+  static void Input(int seed, uint64 *x) {
+    for (int chain = 0; chain < kMulChains; chain++)
+      x[chain] = 0xD1B54A32D192ED03ULL * (seed * kMulChains + chain + 1);
+  }
+  static uint64 SlowStep(uint64 x, uint64 m, int chain) {
+    uint64 xl = x & 0xffffffffULL, xh = x >> 32;
+    uint64 ml = m & 0xffffffffULL, mh = m >> 32;
+    uint64 ll = xl * ml, lh = xl * mh, hl = xh * ml, hh = xh * mh;
+    uint64 mid = (ll >> 32) + (lh & 0xffffffffULL) + (hl & 0xffffffffULL);
+    uint64 lo = (ll & 0xffffffffULL) | (mid << 32);
+    uint64 hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return (lo ^ hi) + chain;
+  }
+
+  uint64 reference_[kSeeds][kMulChains];
+};
+#endif  // __SIZEOF_INT128__
+
+#ifdef STRESSAPPTEST_X86_KERNELS
+// Full AES encryption of kAesBlocks blocks, then decryption back with
+// AESIMC and AESDECLAST. Any wrong round shows up as a block that doesn't
+// come back.
+const int kAesBlocks = 8;
+const int kAesRounds = 10;
+const int kAesIterations = 5000;
+
+__attribute__((target("aes,sse2")))
+void AesRoundTrip(const uint64 *keys, const uint64 *input, uint64 *output,
+                 int iterations) {
+  __m128i key[kAesRounds];
+  for (int r = 0; r < kAesRounds; r++)
+    key[r] = _mm_set_epi64x(keys[2 * r + 1], keys[2 * r]);
+  __m128i block[kAesBlocks];
+  for (int b = 0; b < kAesBlocks; b++)
+    block[b] = _mm_set_epi64x(input[2 * b + 1], input[2 * b]);
+  __m128i zero = _mm_setzero_si128();
+
+  for (int i = 0; i < iterations; i++) {
+    for (int r = 0; r < kAesRounds; r++) {
+      for (int b = 0; b < kAesBlocks; b++)
+        block[b] = _mm_aesenc_si128(block[b], key[r]);
+    }
+    // AESENC is MixColumns(SubBytes(ShiftRows(s))) ^ key, so undo the key,
+    // then MixColumns, then the rest.
+    for (int r = kAesRounds - 1; r >= 0; r--) {
+      for (int b = 0; b < kAesBlocks; b++) {
+        __m128i mixed = _mm_aesimc_si128(_mm_xor_si128(block[b], key[r]));
+        block[b] = _mm_aesdeclast_si128(mixed, zero);
+      }
+    }
+  }
+
+  for (int b = 0; b < kAesBlocks; b++)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * b), block[b]);
+}
+
+class AesKernel : public CpuKernel {
+ public:
+  AesKernel() : CpuKernel("aes") {}
+
+  virtual int Run(int seed) {
+    uint64 keys[2 * kAesRounds];
+    uint64 input[2 * kAesBlocks];
+    uint64 output[2 * kAesBlocks];
+    for (int i = 0; i < 2 * kAesRounds; i++)
+      keys[i] = 0xA0761D6478BD642FULL * (seed * 2 * kAesRounds + i + 1);
+    for (int i = 0; i < 2 * kAesBlocks; i++)
+      input[i] = 0xE7037ED1A0B428DBULL * (seed * 2 * kAesBlocks + i + 1);
+    AesRoundTrip(keys, input, output, kAesIterations);
+    int errors = 0;
+    for (int b = 0; b < kAesBlocks; b++) {
+      if (memcmp(&input[2 * b], &output[2 * b], 2 * sizeof(*input)))
+        errors++;
+    }
+    return errors;
+  }
+
+  virtual int results() const { return kAesBlocks; }
+  virtual int64 ops() const {
+    // Encryption round and decryption round, which is two instructions.
+    return static_cast<int64>(kAesBlocks) * kAesRounds * 3 * kAesIterations;
+  }
+};
+
+bool HasAes() {
+  unsigned int eax = 1, ebx, ecx, edx;
+  cpuid(&eax, &ebx, &ecx, &edx);
+  return ecx & (1 << 25);
+}
+#endif  // STRESSAPPTEST_X86_KERNELS
+
+// The kernels, widest fma first. Kernels that aren't built for this
+// architecture return NULL.
+CpuKernel *NewKernel(const string &name) {
+#ifdef STRESSAPPTEST_X86_KERNELS
+  // __builtin_cpu_supports also checks that the OS saves the registers.
+  if (name == "fma512" && __builtin_cpu_supports("avx512f"))
+    return new FmaKernel("fma512", FmaIterate512);
+  if (name == "fma256" && __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma"))
+    return new FmaKernel("fma256", FmaIterate256);
+  if (name == "aes" && HasAes())
+    return new AesKernel();
+#endif
+#if defined(STRESSAPPTEST_CPU_AARCH64)
+  if (name == "neon")
+    return new FmaKernel("neon", FmaIterateNeon);
+#endif
+#ifdef __SIZEOF_INT128__
+  if (name == "intmul")
+    return new IntMulKernel();
+#endif
+  return NULL;
+}
+
+const char *kKernelNames[] = { "fma512", "fma256", "neon", "intmul", "aes" };
+const int kKernelCount = sizeof(kKernelNames) / sizeof(*kKernelNames);
+
+}  // namespace
+
+bool CpuKernel::Known(const string &name) {
+  if (name == "float" || name == "all" || name == "fma")
+    return true;
+  for (int i = 0; i < kKernelCount; i++) {
+    if (name == kKernelNames[i])
+      return true;
+  }
+  return false;
+}
+
+string CpuKernel::Names() {
+  string names = "float, all, fma";
+  for (int i = 0; i < kKernelCount; i++) {
+    names += ", ";
+    names += kKernelNames[i];
+  }
+  return names;
+}
+
+void CpuKernel::Create(const string &name, vector<CpuKernel*> *kernels) {
+  for (int i = 0; i < kKernelCount; i++) {
+    string kernel_name = kKernelNames[i];
+    bool fma = kernel_name == "fma512" || kernel_name == "fma256" ||
+               kernel_name == "neon";
+    if (name != "all" && name != kernel_name && !(name == "fma" && fma))
+      continue;
+    CpuKernel *kernel = NewKernel(kernel_name);
+    if (!kernel)
+      continue;
+    kernels->push_back(kernel);
+    // Only the widest for "fma".
+    if (name == "fma")
+      break;
+  }
+}
@@ -0,0 +1,70 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Self-checking vector, multiplier and crypto workloads for the cpu stress
+// threads. These keep the wide and high current units of a core busy, where
+// the scalar OsLayer::CpuStressWorkload() never goes, and check every
+// result so that silent data corruption on those paths is caught.
+
+#ifndef STRESSAPPTEST_CPU_KERNELS_H_
+#define STRESSAPPTEST_CPU_KERNELS_H_
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// One workload. Run() repeats a fixed computation on one of kSeeds input
+// sets and compares the results with a reference worked out another way,
+// or checks that the computation undoes itself.
+//
+// Not threadsafe, each cpu stress thread creates its own kernels.
+class CpuKernel {
+ public:
+  static const int kSeeds = 4;  // Input sets with a reference each.
+
+  // Returns true if 'name' is float, all, fma or one of the kernels.
+  static bool Known(const string &name);
+  // All names accepted by Known(), comma separated.
+  static string Names();
+  // Add the kernels 'name' selects that this cpu can run to 'kernels'.
+  // "float" selects none, "fma" the widest fma kernel, "all" every one.
+  // The caller owns the kernels.
+  static void Create(const string &name, vector<CpuKernel*> *kernels);
+
+  virtual ~CpuKernel() {}
+
+  const char *name() const { return name_; }
+  // Work out the reference results. Called once before Run().
+  virtual void Prepare() {}
+  // Run the workload on input set 'seed', 0 to kSeeds - 1. Returns the
+  // number of results that are wrong.
+  virtual int Run(int seed) = 0;
+  // Results checked by each Run().
+  virtual int results() const = 0;
+  // Arithmetic operations done by each Run().
+  virtual int64 ops() const = 0;
+
+ protected:
+  explicit CpuKernel(const char *name) : name_(name) {}
+
+ private:
+  const char *name_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuKernel);
+};
+
+#endif  // STRESSAPPTEST_CPU_KERNELS_H_
@@ -0,0 +1,311 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cpu and cache topology from sysfs, see cpu_topology.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "cpu_topology.h"
+
+bool ReadSysfsList(const char *path, vector<int> *ids) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return false;
+  char line[4096];
+  bool got_line = fgets(line, sizeof(line), file) != NULL;
+  fclose(file);
+  if (!got_line)
+    return false;
+
+  char *pos = line;
+  while (*pos && *pos != '\n') {
+    char *end;
+    int first = strtol(pos, &end, 10);
+    if (end == pos)
+      return false;
+    int last = first;
+    pos = end;
+    if (*pos == '-') {
+      pos++;
+      last = strtol(pos, &end, 10);
+      if (end == pos)
+        return false;
+      pos = end;
+    }
+    for (int i = first; i <= last; i++)
+      ids->push_back(i);
+    if (*pos == ',')
+      pos++;
+  }
+  return true;
+}
+
+string FormatSysfsList(const vector<int> &ids) {
+  string list;
+  for (size_t i = 0; i < ids.size(); i++) {
+    size_t last = i;
+    while (last + 1 < ids.size() && ids[last + 1] == ids[last] + 1)
+      last++;
+    char range[32];
+    if (last == i)
+      snprintf(range, sizeof(range), "%d", ids[i]);
+    else
+      snprintf(range, sizeof(range), "%d-%d", ids[i], ids[last]);
+    if (!list.empty())
+      list += ",";
+    list += range;
+    i = last;
+  }
+  return list;
+}
+
+namespace {
+// Lowest cpu of 'ids' that is also in 'cpus', or -1.
+int LowestCpu(const vector<int> &ids, const cpu_set_t *cpus) {
+  int lowest = -1;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (ids[i] >= 0 && ids[i] < CPU_SETSIZE && CPU_ISSET(ids[i], cpus) &&
+        (lowest < 0 || ids[i] < lowest))
+      lowest = ids[i];
+  }
+  return lowest;
+}
+
+// Cpus sharing the highest level cache of 'cpu', empty if sysfs has no
+// cache information.
+vector<int> LastLevelCache(int cpu) {
+  vector<int> shared;
+  int highest = 0;
+  for (int index = 0; ; index++) {
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+    FILE *file = fopen(path, "r");
+    if (!file)
+      break;
+    int level = 0;
+    bool got_level = fscanf(file, "%d", &level) == 1;
+    fclose(file);
+    if (!got_level || level < highest)
+      continue;
+
+    vector<int> ids;
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list",
+             cpu, index);
+    if (ReadSysfsList(path, &ids)) {
+      highest = level;
+      shared = ids;
+    }
+  }
+  return shared;
+}
+}  // namespace
+
+CpuTopology::CpuTopology() {
+  cores_ = 0;
+  caches_ = 0;
+}
+
+bool CpuTopology::CpuBefore(const struct Cpu &a, const struct Cpu &b) {
+  if (a.cache != b.cache)
+    return a.cache < b.cache;
+  if (a.core != b.core)
+    return a.core < b.core;
+  return a.cpu < b.cpu;
+}
+
+bool CpuTopology::Load(const cpu_set_t *cpus) {
+  cpus_.clear();
+  spread_order_.clear();
+  cores_ = 0;
+  caches_ = 0;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, cpus))
+      continue;
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+             cpu);
+    vector<int> siblings;
+    if (!ReadSysfsList(path, &siblings)) {
+      logprintf(5, "Log: No topology for cpu %d, can't place threads by "
+                "topology.\n", cpu);
+      cpus_.clear();
+      return false;
+    }
+    struct Cpu entry;
+    entry.cpu = cpu;
+    entry.core = LowestCpu(siblings, cpus);
+    if (entry.core < 0)
+      entry.core = cpu;
+    // Without cache information all cpus share one cache.
+    entry.cache = LowestCpu(LastLevelCache(cpu), cpus);
+    if (entry.cache < 0)
+      entry.cache = 0;
+    entry.thread = 0;
+    cpus_.push_back(entry);
+  }
+  if (cpus_.empty())
+    return false;
+  std::sort(cpus_.begin(), cpus_.end(), CpuBefore);
+
+  // Number the threads of each core, and the cores of each cache.
+  vector<int> core_rank(cpus_.size(), 0);
+  vector<int> cache_index(cpus_.size(), 0);
+  int max_thread = 0;
+  int max_core = 0;
+  for (size_t i = 0; i < cpus_.size(); i++) {
+    if (i == 0 || cpus_[i].cache != cpus_[i - 1].cache) {
+      caches_++;
+      cores_++;
+      core_rank[i] = 0;
+    } else if (cpus_[i].core != cpus_[i - 1].core) {
+      cores_++;
+      core_rank[i] = core_rank[i - 1] + 1;
+    } else {
+      core_rank[i] = core_rank[i - 1];
+      cpus_[i].thread = cpus_[i - 1].thread + 1;
+    }
+    cache_index[i] = caches_ - 1;
+    max_thread = std::max(max_thread, cpus_[i].thread);
+    max_core = std::max(max_core, core_rank[i]);
+  }
+
+  // Deal the cpus out by thread of the core, then core of the cache, then
+  // cache, so that consecutive entries share as little as possible.
+  for (int thread = 0; thread <= max_thread; thread++) {
+    for (int core = 0; core <= max_core; core++) {
+      for (int cache = 0; cache < caches_; cache++) {
+        for (size_t i = 0; i < cpus_.size(); i++) {
+          if (cpus_[i].thread == thread && core_rank[i] == core &&
+              cache_index[i] == cache)
+            spread_order_.push_back(cpus_[i].cpu);
+        }
+      }
+    }
+  }
+
+  logprintf(5, "Log: Cpu topology: %d cpus, %d cores, %d last level "
+            "caches.\n", static_cast<int>(cpus_.size()), cores_, caches_);
+  return true;
+}
+
+int CpuTopology::Sibling(int cpu) const {
+  int core = -1;
+  for (size_t i = 0; i < cpus_.size(); i++) {
+    if (cpus_[i].cpu == cpu)
+      core = cpus_[i].core;
+  }
+  for (size_t i = 0; i < cpus_.size(); i++) {
+    if (core >= 0 && cpus_[i].core == core && cpus_[i].cpu != cpu)
+      return cpus_[i].cpu;
+  }
+  return -1;
+}
+
+namespace {
+// The first number in the sysfs file 'path', or 'fallback'.
+int64 ReadSysfsNumber(const char *path, int64 fallback) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return fallback;
+  long long value = 0;
+  bool got_value = fscanf(file, "%lld", &value) == 1;
+  fclose(file);
+  return got_value ? value : fallback;
+}
+
+// Orders clusters fastest first, then by their lowest cpu.
+bool ClusterBefore(const struct CpuCluster &a, const struct CpuCluster &b) {
+  if (a.capacity != b.capacity)
+    return a.capacity > b.capacity;
+  if (a.max_khz != b.max_khz)
+    return a.max_khz > b.max_khz;
+  return a.cpus[0] < b.cpus[0];
+}
+}  // namespace
+
+bool LoadCpuClusters(const cpu_set_t *cpus,
+                     vector<struct CpuCluster> *clusters) {
+  clusters->clear();
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, cpus))
+      continue;
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    int capacity = static_cast<int>(ReadSysfsNumber(path, 0));
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+    int64 max_khz = ReadSysfsNumber(path, 0);
+
+    size_t c = 0;
+    while (c < clusters->size() &&
+           !((*clusters)[c].capacity == capacity &&
+             (capacity || (*clusters)[c].max_khz == max_khz)))
+      c++;
+    if (c == clusters->size()) {
+      struct CpuCluster cluster;
+      cluster.capacity = capacity;
+      cluster.max_khz = max_khz;
+      clusters->push_back(cluster);
+    }
+    // Cpus of one capacity may sit in several policies, keep the fastest.
+    (*clusters)[c].max_khz = std::max((*clusters)[c].max_khz, max_khz);
+    (*clusters)[c].cpus.push_back(cpu);
+  }
+  if (clusters->empty())
+    return false;
+  std::sort(clusters->begin(), clusters->end(), ClusterBefore);
+
+  static const char *kNames[][3] = {
+    { "all" },
+    { "big", "little" },
+    { "prime", "big", "little" },
+  };
+  for (size_t c = 0; c < clusters->size(); c++) {
+    if (clusters->size() <= 3) {
+      (*clusters)[c].name = kNames[clusters->size() - 1][c];
+    } else {
+      char name[32];
+      snprintf(name, sizeof(name), "cluster%d", static_cast<int>(c));
+      (*clusters)[c].name = name;
+    }
+  }
+  return true;
+}
+
+int64 ClusterCurrentKHz(const struct CpuCluster &cluster) {
+  int64 total = 0;
+  int count = 0;
+  for (size_t i = 0; i < cluster.cpus.size(); i++) {
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",
+             cluster.cpus[i]);
+    int64 khz = ReadSysfsNumber(path, 0);
+    if (khz > 0) {
+      total += khz;
+      count++;
+    }
+  }
+  return count ? total / count : 0;
+}
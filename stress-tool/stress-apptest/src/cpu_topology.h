@@ -0,0 +1,94 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cpu and cache topology from /sys/devices/system/cpu, used to place
+// worker threads.
+
+#ifndef STRESSAPPTEST_CPU_TOPOLOGY_H_
+#define STRESSAPPTEST_CPU_TOPOLOGY_H_
+
+#include <sched.h>
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// Parse a sysfs list such as "0-3,8,10-11" into 'ids'. An empty list is
+// valid. Returns false if the file can't be read or parsed.
+bool ReadSysfsList(const char *path, vector<int> *ids);
+
+// Format sorted 'ids' as a sysfs list, the reverse of ReadSysfsList().
+string FormatSysfsList(const vector<int> &ids);
+
+// Which cpus share a core and which share the last level cache, for a set
+// of cpus.
+class CpuTopology {
+ public:
+  CpuTopology();
+
+  // Read the topology of the cpus in 'cpus'. Returns false if there are
+  // none or sysfs doesn't list their core siblings.
+  bool Load(const cpu_set_t *cpus);
+
+  // The cpus ordered to spread threads out: one per last level cache
+  // first, then one per core of each cache, then the remaining SMT
+  // siblings.
+  const vector<int> &spread_order() const { return spread_order_; }
+
+  // Another hardware thread of the core of 'cpu', or -1 if there is none.
+  int Sibling(int cpu) const;
+
+  int cores() const { return cores_; }
+  int caches() const { return caches_; }
+
+ private:
+  struct Cpu {
+    int cpu;
+    int core;                       // Lowest cpu of the core.
+    int cache;                      // Lowest cpu sharing the last level.
+    int thread;                     // Index among the core's cpus.
+  };
+  // Orders cpus by cache, then core, then cpu number.
+  static bool CpuBefore(const struct Cpu &a, const struct Cpu &b);
+
+  vector<struct Cpu> cpus_;         // Sorted by CpuBefore().
+  vector<int> spread_order_;
+  int cores_;
+  int caches_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuTopology);
+};
+
+// A set of cpus of the same capacity, such as the prime, big or little
+// cluster of a heterogeneous SoC.
+struct CpuCluster {
+  string name;                      // "prime", "big", "little", ...
+  vector<int> cpus;
+  int capacity;                     // cpu_capacity, or 0 if not listed.
+  int64 max_khz;                    // cpuinfo_max_freq, or 0 if unknown.
+};
+
+// Group the cpus in 'cpus' into clusters, fastest first. Cpus are grouped
+// by cpu_capacity, or by the maximum frequency of their cpufreq policy
+// where the kernel lists no capacities. A homogeneous system is a single
+// cluster named "all". Returns false if there are no cpus.
+bool LoadCpuClusters(const cpu_set_t *cpus, vector<struct CpuCluster> *clusters);
+
+// The mean current frequency of the cpus of 'cluster' in kHz, or 0 if
+// cpufreq doesn't report it.
+int64 ClusterCurrentKHz(const struct CpuCluster &cluster);
+
+#endif  // STRESSAPPTEST_CPU_TOPOLOGY_H_
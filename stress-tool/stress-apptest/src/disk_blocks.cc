@@ -17,164 +17,329 @@
 // This file must work with autoconf on its public version,
 // so these includes are correct.
 #include "disk_blocks.h"
+#include "prng.h"
 
-#include <utility>
+#include <string.h>
+#include <sys/mman.h>
 
-// BlockData
-BlockData::BlockData() : address_(0), size_(0),
-                         references_(0), initialized_(false),
-                         pattern_(NULL) {
-  pthread_mutex_init(&data_mutex_, NULL);
-}
-
-BlockData::~BlockData() {
-  pthread_mutex_destroy(&data_mutex_);
-}
-
-void BlockData::set_initialized() {
-  pthread_mutex_lock(&data_mutex_);
-  initialized_ = true;
-  pthread_mutex_unlock(&data_mutex_);
-}
+#include <new>
+#include <utility>
 
-bool BlockData::initialized() const {
-  pthread_mutex_lock(&data_mutex_);
-  bool initialized = initialized_;
-  pthread_mutex_unlock(&data_mutex_);
-  return initialized;
+namespace {
+// Spread the bits of a block number over the whole word.
+uint64 MixBlock(uint64 index) {
+  index = (index ^ (index >> 31)) * 0x7FB5D329728EA185ULL;
+  index = (index ^ (index >> 27)) * 0x81DADEF4BC2DD44DULL;
+  return index ^ (index >> 33);
 }
+}  // namespace
 
 // DiskBlockTable
 DiskBlockTable::DiskBlockTable() : sector_size_(0), write_block_size_(0),
                                    device_name_(""), device_sectors_(0),
-                                   segment_size_(0), size_(0) {
+                                   segment_size_(0), size_(0),
+                                   in_flight_(0), chunk_count_(0),
+                                   free_record_(-1), slot_bytes_(0) {
+  for (int i = 0; i < kStripes; i++) {
+    pthread_mutex_init(&stripes_[i].lock, NULL);
+    stripes_[i].slots = NULL;
+    stripes_[i].capacity = 0;
+    stripes_[i].count = 0;
+  }
+  for (uint32 i = 0; i < kMaxChunks; i++)
+    chunks_[i] = NULL;
+  pthread_mutex_init(&pool_mutex_, NULL);
   pthread_mutex_init(&data_mutex_, NULL);
   pthread_mutex_init(&parameter_mutex_, NULL);
   pthread_cond_init(&data_condition_, NULL);
 }
 
 DiskBlockTable::~DiskBlockTable() {
+  for (int i = 0; i < kStripes; i++) {
+    pthread_mutex_destroy(&stripes_[i].lock);
+    delete[] stripes_[i].slots;
+  }
+  for (uint32 i = 0; i < chunk_count_; i++)
+    munmap(chunks_[i], kChunkRecords * sizeof(BlockData));
+  pthread_mutex_destroy(&pool_mutex_);
   pthread_mutex_destroy(&data_mutex_);
   pthread_mutex_destroy(&parameter_mutex_);
   pthread_cond_destroy(&data_condition_);
 }
 
-// 64-bit non-negative random number generator.  Stolen from
-// depot/google3/base/tracecontext_unittest.cc.
+// 64-bit non-negative random number, from the calling thread's generator
+// so that a disk thread's sequence of blocks can be repeated with --seed.
 int64 DiskBlockTable::Random64() {
-  int64 x = random();
-  x = (x << 30) ^ random();
-  x = (x << 30) ^ random();
-  if (x >= 0)
-    return x;
-  else
-    return -x;
+  return static_cast<int64>(ThreadRandom64() & 0x7FFFFFFFFFFFFFFFULL);
 }
 
 uint64 DiskBlockTable::Size() {
-  pthread_mutex_lock(&data_mutex_);
-  uint64 size = size_;
-  pthread_mutex_unlock(&data_mutex_);
-  return size;
+  return size_;
 }
 
-void DiskBlockTable::InsertOnStructure(BlockData *block) {
-  int64 address = block->address();
-  StorageData *sd = new StorageData();
-  sd->block = block;
-  sd->pos = size_;
-  // Creating new block ...
-  pthread_mutex_lock(&data_mutex_);
-  if (pos_to_addr_.size() <= size_) {
-    pos_to_addr_.insert(pos_to_addr_.end(), address);
-  } else {
-    pos_to_addr_[size_] = address;
+uint64 DiskBlockTable::MemoryUsage() {
+  pthread_mutex_lock(&pool_mutex_);
+  uint64 bytes = static_cast<uint64>(chunk_count_) * kChunkRecords *
+                 sizeof(BlockData);
+  pthread_mutex_unlock(&pool_mutex_);
+  return bytes + slot_bytes_;
+}
+
+int64 DiskBlockTable::AllocateRecord() {
+  pthread_mutex_lock(&pool_mutex_);
+  if (free_record_ < 0 && chunk_count_ < kMaxChunks) {
+    // Anonymous memory, so records cost nothing until first touched.
+    void *chunk = mmap(NULL, kChunkRecords * sizeof(BlockData),
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (chunk != MAP_FAILED) {
+      BlockData *records = static_cast<BlockData*>(chunk);
+      uint32 first = chunk_count_ * kChunkRecords;
+      // Link the new records in ascending order, so the pool fills up
+      // a page at a time.
+      for (uint32 i = 0; i < kChunkRecords; i++) {
+        records[i].Clear();
+        records[i].address_ = (i + 1 < kChunkRecords) ? first + i + 1 : -1;
+      }
+      chunks_[chunk_count_++] = records;
+      free_record_ = first;
+    }
+  }
+  int64 number = free_record_;
+  if (number >= 0)
+    free_record_ = static_cast<int64>(Record(number)->address_);
+  pthread_mutex_unlock(&pool_mutex_);
+  return number;
+}
+
+void DiskBlockTable::FreeRecord(uint32 number) {
+  pthread_mutex_lock(&pool_mutex_);
+  BlockData *record = Record(number);
+  record->Clear();
+  record->address_ = free_record_;
+  free_record_ = number;
+  pthread_mutex_unlock(&pool_mutex_);
+}
+
+DiskBlockTable::Stripe *DiskBlockTable::StripeOf(int64 address) {
+  // Block addresses are multiples of the block size in sectors, so drop
+  // the low bits that are always the same before picking a stripe.
+  int64 block_sectors = 1;
+  if (sector_size_ > 0 && write_block_size_ > sector_size_)
+    block_sectors = write_block_size_ / sector_size_;
+  uint64 index = static_cast<uint64>(address / block_sectors);
+  index = (index * 0x9E3779B97F4A7C15ULL) >> 32;
+  return &stripes_[index & (kStripes - 1)];
+}
+
+uint32 DiskBlockTable::FindSlot(Stripe *stripe, uint64 address) {
+  int64 block_sectors = 1;
+  if (sector_size_ > 0 && write_block_size_ > sector_size_)
+    block_sectors = write_block_size_ / sector_size_;
+  uint32 mask = stripe->capacity - 1;
+  uint32 slot = MixBlock(address / block_sectors) & mask;
+  // Linear probing, there is always at least one free slot.
+  while (stripe->slots[slot] &&
+         Record(stripe->slots[slot] - 1)->address_ != address)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+bool DiskBlockTable::Resize(Stripe *stripe, uint32 capacity) {
+  uint32 *slots = new(std::nothrow) uint32[capacity];
+  if (!slots)
+    return false;
+  memset(slots, 0, capacity * sizeof(*slots));
+  uint32 *old_slots = stripe->slots;
+  uint32 old_capacity = stripe->capacity;
+  stripe->slots = slots;
+  stripe->capacity = capacity;
+  for (uint32 i = 0; i < old_capacity; i++) {
+    if (old_slots[i])
+      slots[FindSlot(stripe, Record(old_slots[i] - 1)->address_)] =
+          old_slots[i];
+  }
+  delete[] old_slots;
+  __sync_add_and_fetch(&slot_bytes_,
+                       (static_cast<int64>(capacity) - old_capacity) *
+                       sizeof(*slots));
+  return true;
+}
+
+void DiskBlockTable::EraseSlot(Stripe *stripe, uint32 slot) {
+  uint32 mask = stripe->capacity - 1;
+  FreeRecord(stripe->slots[slot] - 1);
+  stripe->slots[slot] = 0;
+  stripe->count--;
+  // Shift later blocks of the probe run back, so lookups don't stop at
+  // the hole.
+  int64 block_sectors = 1;
+  if (sector_size_ > 0 && write_block_size_ > sector_size_)
+    block_sectors = write_block_size_ / sector_size_;
+  uint32 hole = slot;
+  for (uint32 next = (slot + 1) & mask; stripe->slots[next];
+       next = (next + 1) & mask) {
+    uint32 home = MixBlock(Record(stripe->slots[next] - 1)->address_ /
+                           block_sectors) & mask;
+    // Move it if its home slot is not between the hole and it.
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      stripe->slots[hole] = stripe->slots[next];
+      stripe->slots[next] = 0;
+      hole = next;
+    }
+  }
+  // Shrink sparse tables so random picks don't scan far.
+  if (stripe->capacity > kMinSlots && stripe->count < stripe->capacity / 8)
+    Resize(stripe, stripe->capacity / 2);
+}
+
+bool DiskBlockTable::InsertOnStructure(uint32 number) {
+  BlockData *block = Record(number);
+  uint64 address = block->address();
+  Stripe *stripe = StripeOf(address);
+  pthread_mutex_lock(&stripe->lock);
+  // Keep the hash table at most half full.
+  if ((stripe->count + 1) * 2 > stripe->capacity &&
+      !Resize(stripe, stripe->capacity ? stripe->capacity * 2 : kMinSlots)) {
+    pthread_mutex_unlock(&stripe->lock);
+    return false;
+  }
+  uint32 slot = FindSlot(stripe, address);
+  if (stripe->slots[slot]) {
+    pthread_mutex_unlock(&stripe->lock);
+    return false;
+  }
+  stripe->slots[slot] = number + 1;
+  stripe->count++;
+  pthread_mutex_unlock(&stripe->lock);
+
+  // Wake up random threads waiting for the first block, going through
+  // data_mutex_ so that a waiter can't miss the broadcast.
+  if (__sync_fetch_and_add(&size_, 1) == 0) {
+    pthread_mutex_lock(&data_mutex_);
+    pthread_cond_broadcast(&data_condition_);
+    pthread_mutex_unlock(&data_mutex_);
   }
-  addr_to_block_[address] = sd;
-  size_++;
-  pthread_cond_broadcast(&data_condition_);
-  pthread_mutex_unlock(&data_mutex_);
+  return true;
 }
 
 int DiskBlockTable::RemoveBlock(BlockData *block) {
   // For write threads, check the reference counter and remove
   // it from the structure.
-  int64 address = block->address();
-  AddrToBlockMap::iterator it = addr_to_block_.find(address);
+  sat_assert(!block->in_flight());
+  uint64 address = block->address();
+  Stripe *stripe = StripeOf(address);
   int ret = 1;
-  if (it != addr_to_block_.end()) {
-    int curr_pos = it->second->pos;
-    int last_pos = size_ - 1;
-    AddrToBlockMap::iterator last_it = addr_to_block_.find(
-        pos_to_addr_[last_pos]);
-    sat_assert(size_ > 0);
-    sat_assert(last_it != addr_to_block_.end());
-    // Everything is fine, removing block from table.
-    pthread_mutex_lock(&data_mutex_);
-    pos_to_addr_[curr_pos] = pos_to_addr_[last_pos];
-    last_it->second->pos = curr_pos;
-    delete it->second;
-    addr_to_block_.erase(it);
-    size_--;
-    block->DecreaseReferenceCounter();
-    if (block->GetReferenceCounter() == 0)
-      delete block;
-    else if (block->GetReferenceCounter() < 0)
-      ret = 0;
-    pthread_cond_broadcast(&data_condition_);
-    pthread_mutex_unlock(&data_mutex_);
+  pthread_mutex_lock(&stripe->lock);
+  uint32 slot = stripe->capacity ? FindSlot(stripe, address) : 0;
+  if (stripe->capacity && stripe->slots[slot] &&
+      Record(stripe->slots[slot] - 1) == block &&
+      !(block->state_ & BlockData::kRetired) &&
+      block->GetReferenceCounter() > 0) {
+    __sync_sub_and_fetch(&size_, 1);
+    // Random threads still reading the block keep its address taken
+    // until the last one releases it.
+    __sync_fetch_and_or(&block->state_, BlockData::kRetired);
+    if (block->DecreaseReferenceCounter() == 0)
+      EraseSlot(stripe, slot);
   } else {
     ret = 0;
   }
+  pthread_mutex_unlock(&stripe->lock);
   return ret;
 }
 
+void DiskBlockTable::SetInFlight(BlockData *block, bool in_flight) {
+  if (block->in_flight() == in_flight)
+    return;
+  if (in_flight) {
+    __sync_fetch_and_or(&block->state_, BlockData::kInFlight);
+    __sync_add_and_fetch(&in_flight_, 1);
+  } else {
+    __sync_fetch_and_and(&block->state_,
+                         static_cast<uint8>(~BlockData::kInFlight));
+    __sync_sub_and_fetch(&in_flight_, 1);
+  }
+}
+
+uint64 DiskBlockTable::InFlight() {
+  return in_flight_;
+}
+
 int DiskBlockTable::ReleaseBlock(BlockData *block) {
-  // If caller is a random thread, just check the reference counter.
-  int ret = 1;
-  pthread_mutex_lock(&data_mutex_);
+  // If caller is a random thread, just drop the reference. While the
+  // block is stored the write thread holds one too, so only a retired
+  // block can run out of references.
   int references = block->GetReferenceCounter();
-  if (references == 1)
-    delete block;
-  else if (references > 0)
-    block->DecreaseReferenceCounter();
-  else
-    ret = 0;
-  pthread_mutex_unlock(&data_mutex_);
-  return ret;
+  if (references <= 0)
+    return 0;
+  if (block->DecreaseReferenceCounter() > 0)
+    return 1;
+
+  uint64 address = block->address();
+  Stripe *stripe = StripeOf(address);
+  pthread_mutex_lock(&stripe->lock);
+  uint32 slot = FindSlot(stripe, address);
+  sat_assert(stripe->slots[slot] && Record(stripe->slots[slot] - 1) == block);
+  EraseSlot(stripe, slot);
+  pthread_mutex_unlock(&stripe->lock);
+  return 1;
 }
 
 BlockData *DiskBlockTable::GetRandomBlock() {
-  struct timespec ts;
-  struct timeval tp;
-  gettimeofday(&tp, NULL);
-  ts.tv_sec  = tp.tv_sec;
-  ts.tv_nsec = tp.tv_usec * 1000;
-  ts.tv_sec += 2;  // Wait for 2 seconds.
-  int result = 0;
-  pthread_mutex_lock(&data_mutex_);
-  while (!size_ && result != ETIMEDOUT) {
-    result = pthread_cond_timedwait(&data_condition_, &data_mutex_, &ts);
-  }
-  if (result == ETIMEDOUT) {
+  if (!size_) {
+    struct timespec ts;
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    ts.tv_sec  = tp.tv_sec;
+    ts.tv_nsec = tp.tv_usec * 1000;
+    ts.tv_sec += 2;  // Wait for 2 seconds.
+    int result = 0;
+    pthread_mutex_lock(&data_mutex_);
+    while (!size_ && result != ETIMEDOUT) {
+      result = pthread_cond_timedwait(&data_condition_, &data_mutex_, &ts);
+    }
     pthread_mutex_unlock(&data_mutex_);
-    return NULL;
-  } else {
-    int64 random_number = Random64();
-    int64 random_pos = random_number % size_;
-    int64 address = pos_to_addr_[random_pos];
-    AddrToBlockMap::const_iterator it = addr_to_block_.find(address);
-    sat_assert(it != addr_to_block_.end());
-    BlockData *b = it->second->block;
+    if (result == ETIMEDOUT)
+      return NULL;
+  }
+
+  // Start from a random stripe and move on to the next ones if it
+  // happens to be empty.
+  int64 random_number = Random64();
+  int first = random_number & (kStripes - 1);
+  random_number /= kStripes;
+  for (int i = 0; i < kStripes; i++) {
+    Stripe *stripe = &stripes_[(first + i) & (kStripes - 1)];
+    pthread_mutex_lock(&stripe->lock);
+    if (!stripe->count) {
+      pthread_mutex_unlock(&stripe->lock);
+      continue;
+    }
+    // The table is between 1/8 and 1/2 full, so a stored block is
+    // usually a few slots away.
+    uint32 mask = stripe->capacity - 1;
+    uint32 slot = random_number & mask;
+    BlockData *b = NULL;
+    for (uint32 j = 0; j <= mask && !b; j++, slot = (slot + 1) & mask) {
+      if (stripe->slots[slot] &&
+          !(Record(stripe->slots[slot] - 1)->state_ & BlockData::kRetired))
+        b = Record(stripe->slots[slot] - 1);
+    }
+    if (!b) {
+      pthread_mutex_unlock(&stripe->lock);
+      continue;
+    }
     // A block is returned only if its content is written on disk.
     if (b->initialized()) {
       b->IncreaseReferenceCounter();
     } else {
       b = NULL;
     }
-    pthread_mutex_unlock(&data_mutex_);
+    pthread_mutex_unlock(&stripe->lock);
     return b;
   }
+  return NULL;
 }
 
 void DiskBlockTable::SetParameters(int sector_size,
@@ -194,19 +359,21 @@ void DiskBlockTable::SetParameters(int sector_size,
 
 BlockData *DiskBlockTable::GetUnusedBlock(int64 segment) {
   int64 sector = 0;
-  BlockData *block = new BlockData();
+  int64 number = AllocateRecord();
   bool good_sequence = false;
-  if (block == NULL) {
+  if (number < 0) {
     logprintf(0, "Process Error: Unable to allocate memory "
               "for sector data for disk %s.\n", device_name_.c_str());
     return NULL;
   }
+  BlockData *block = Record(number);
   pthread_mutex_lock(&parameter_mutex_);
   sat_assert(device_sectors_ != 0);
   // Align the first sector with the beginning of a write block
   int num_sectors = write_block_size_ / sector_size_;
+  block->set_size(write_block_size_);
+  block->IncreaseReferenceCounter();
   for (int i = 0; i < kBlockRetry && !good_sequence; i++) {
-    good_sequence = true;
     // Use the entire disk or a small segment of the disk to allocate the first
     // sector in the block from.
     if (segment_size_ == -1) {
@@ -219,36 +386,24 @@ BlockData *DiskBlockTable::GetUnusedBlock(int64 segment) {
       sector *= num_sectors;
       sector += segment * segment_size_;
       // Make sure the block is within the segment.
-      if (sector + num_sectors > (segment + 1) * segment_size_) {
-        good_sequence = false;
+      if (sector + num_sectors > (segment + 1) * segment_size_)
         continue;
-      }
     }
     // Make sure the entire block is in range.
-    if (sector + num_sectors > device_sectors_) {
-      good_sequence = false;
+    if (sector + num_sectors > device_sectors_)
       continue;
-    }
-    // Check to see if the block is free. Since the blocks are
+    // Claim the block if it is free. Since the blocks are
     // now aligned to the write_block_size, it is not necessary
     // to check each sector, just the first block (a sector
     // overlap will never occur).
-    pthread_mutex_lock(&data_mutex_);
-    if (addr_to_block_.find(sector) != addr_to_block_.end()) {
-      good_sequence = false;
-    }
-    pthread_mutex_unlock(&data_mutex_);
+    block->set_address(sector);
+    good_sequence = InsertOnStructure(number);
   }
 
-  if (good_sequence) {
-    block->set_address(sector);
-    block->set_size(write_block_size_);
-    block->IncreaseReferenceCounter();
-    InsertOnStructure(block);
-  } else {
+  if (!good_sequence) {
     // No contiguous sequence of num_sectors sectors was found within
     // kBlockRetry iterations so return an error value.
-    delete block;
+    FreeRecord(number);
     block = NULL;
   }
   pthread_mutex_unlock(&parameter_mutex_);
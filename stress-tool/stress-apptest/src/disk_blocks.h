@@ -22,56 +22,89 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
-#include <map>
 #include <vector>
 #include <string>
 
 #include "sattypes.h"
 
-class Pattern;
-
 // Data about a block written to disk so that it can be verified later.
-// Thread-unsafe, must be used with locks on non-const methods,
-// except for initialized accessor/mutator, which are thread-safe
-// (and in fact, is the only method supposed to be accessed from
-// someone which is not the thread-safe DiskBlockTable).
+//
+// A fixed size 16 byte record, kept in DiskBlockTable's record pool so
+// that a table of many millions of blocks stays small. The reference count
+// and state are atomic. Apart from initialized(), which any thread may set
+// once the block is on disk, they are only changed by DiskBlockTable.
 class BlockData {
  public:
-  BlockData();
-  ~BlockData();
-
-  // These are reference counters used to control how many
-  // threads currently have a copy of this particular block.
-  void IncreaseReferenceCounter() { references_++; }
-  void DecreaseReferenceCounter() { references_--; }
-  int GetReferenceCounter() const { return references_; }
+  BlockData() { Clear(); }
 
   // Controls whether the block was written on disk or not.
   // Once written, you cannot "un-written" then without destroying
   // this object.
-  void set_initialized();
-  bool initialized() const;
+  void set_initialized() { __sync_fetch_and_or(&state_, kInitialized); }
+  bool initialized() const { return state_ & kInitialized; }
+
+  // Whether a write or verification of the block is in progress. Use
+  // DiskBlockTable::SetInFlight to change it.
+  bool in_flight() const { return state_ & kInFlight; }
 
   // Accessor methods for some data related to blocks.
   void set_address(uint64 address) { address_ = address; }
   uint64 address() const { return address_; }
   void set_size(uint64 size) { size_ = size; }
   uint64 size() const { return size_; }
-  void set_pattern(Pattern *p) { pattern_ = p; }
-  Pattern *pattern() { return pattern_; }
+  // The pattern is stored as its PatternList index, -1 for none.
+  void set_pattern_index(int index) {
+    pattern_ = (index < 0 || index >= kNoPattern) ? kNoPattern : index;
+  }
+  int pattern_index() const {
+    return pattern_ == kNoPattern ? -1 : pattern_;
+  }
+
  private:
-  uint64 address_;  // Address of first sector in block
-  uint64 size_;  // Size of block
-  int references_;  // Reference counter
-  bool initialized_;  // Flag indicating the block was written on disk
-  Pattern *pattern_;
-  mutable pthread_mutex_t data_mutex_;
+  friend class DiskBlockTable;
+
+  // State bits.
+  static const uint8 kInitialized = 1;  // Content is on disk.
+  static const uint8 kInFlight = 2;     // An I/O is in progress.
+  static const uint8 kRetired = 4;      // Removed, but still referenced.
+  static const uint8 kNoPattern = 0xff;
+
+  void Clear() {
+    address_ = 0;
+    size_ = 0;
+    references_ = 0;
+    pattern_ = kNoPattern;
+    state_ = 0;
+  }
+
+  // These are reference counters used to control how many
+  // threads currently have a copy of this particular block.
+  void IncreaseReferenceCounter() { __sync_add_and_fetch(&references_, 1); }
+  // Returns the references left.
+  int DecreaseReferenceCounter() {
+    return __sync_sub_and_fetch(&references_, 1);
+  }
+  int GetReferenceCounter() const { return references_; }
+
+  uint64 address_;              // Address of first sector in block
+  uint32 size_;                 // Size of block
+  volatile uint16 references_;  // Reference counter
+  uint8 pattern_;               // PatternList index, or kNoPattern
+  volatile uint8 state_;        // kInitialized, kInFlight, kRetired bits
   DISALLOW_COPY_AND_ASSIGN(BlockData);
 };
 
 // A thread-safe table used to store block data and control access
 // to these blocks, letting several threads read and write blocks on
 // disk.
+//
+// Block records live in a pool of mmap'd arrays and are never moved, so
+// callers can hold on to them. Blocks are spread by address over a number
+// of stripes, each with its own lock, so random threads picking blocks
+// don't serialize with each other or with the write thread. Each stripe
+// indexes its blocks by address in an open addressing hash table of
+// record numbers, which also serves random selection: a random slot is
+// picked and the next stored block from there is returned.
 class DiskBlockTable {
  public:
   DiskBlockTable();
@@ -126,25 +159,40 @@ class DiskBlockTable {
   // 1 if successful, 0 otherwise.
   int ReleaseBlock(BlockData *block);
 
+  // Marks whether a write thread has an I/O in progress on the block.
+  // Blocks can't be removed while in flight.
+  void SetInFlight(BlockData *block, bool in_flight);
+
+  // Returns number of blocks with an I/O in progress.
+  uint64 InFlight();
+
+  // Returns the bytes of memory the table is using.
+  uint64 MemoryUsage();
+
  protected:
-  struct StorageData {
-    BlockData *block;
-    int pos;
+  // One lock's worth of the table.
+  struct Stripe {
+    pthread_mutex_t lock;
+    // Record numbers plus one by address, 0 for an empty slot. Holds the
+    // stored blocks and the removed ones that random threads are still
+    // reading, which must not be handed out again until released.
+    uint32 *slots;
+    uint32 capacity;  // Slots, a power of 2 or 0.
+    uint32 count;     // Used slots.
+    char pad[64];  // Keep neighbouring locks off the same cache line.
   };
-  typedef map<int64, StorageData*> AddrToBlockMap;
-  typedef vector<int64> PosToAddrVector;
 
-  // Inserts block in structure, used in tests and by other methods.
-  void InsertOnStructure(BlockData *block);
+  // Returns the stripe holding blocks at 'address'.
+  Stripe *StripeOf(int64 address);
+
+  // Inserts pool record 'number' in structure, used in tests and by other
+  // methods. Returns false if its address is already taken.
+  bool InsertOnStructure(uint32 number);
 
   // Generates a random 64-bit integer.
   // Virtual method so it can be overridden by the tests.
   virtual int64 Random64();
 
-  // Accessor methods for testing.
-  const PosToAddrVector& pos_to_addr() const { return pos_to_addr_; }
-  const AddrToBlockMap& addr_to_block() const { return addr_to_block_; }
-
   int sector_size() const { return sector_size_; }
   int write_block_size() const { return write_block_size_; }
   const string& device_name() const { return device_name_; }
@@ -154,9 +202,36 @@ class DiskBlockTable {
  private:
   // Number of retries to allocate sectors.
   static const int kBlockRetry = 100;
+  // Number of stripes, must be a power of 2.
+  static const int kStripes = 64;
+  // Records per pool chunk, must be a power of 2.
+  static const uint32 kChunkRecords = 1 << 16;
+  // Pool chunks, which bounds the table to kChunkRecords * kMaxChunks
+  // blocks.
+  static const uint32 kMaxChunks = 1 << 12;
+  // Smallest stripe hash table.
+  static const uint32 kMinSlots = 16;
   // Actual tables.
-  PosToAddrVector pos_to_addr_;
-  AddrToBlockMap addr_to_block_;
+  Stripe stripes_[kStripes];
+
+  // Returns record 'number' of the pool.
+  BlockData *Record(uint32 number) {
+    return &chunks_[number / kChunkRecords][number % kChunkRecords];
+  }
+  // Take a record off the free list, growing the pool if needed. Returns
+  // its number, or -1 if the pool is exhausted.
+  int64 AllocateRecord();
+  void FreeRecord(uint32 number);
+
+  // Slot of 'stripe' where a block at 'address' is or would go. Called
+  // with the stripe lock held.
+  uint32 FindSlot(Stripe *stripe, uint64 address);
+  // Rehash 'stripe' into 'capacity' slots. Called with the stripe lock
+  // held. Returns false if the memory could not be allocated.
+  bool Resize(Stripe *stripe, uint32 capacity);
+  // Remove the block in 'slot' from its stripe and free its record.
+  // Called with the stripe lock held.
+  void EraseSlot(Stripe *stripe, uint32 slot);
 
   // Configuration parameters for block selection
   int sector_size_;  // Sector size, in bytes
@@ -164,7 +239,15 @@ class DiskBlockTable {
   string device_name_;  // Device name
   int64 device_sectors_;  // Number of sectors in device
   int64 segment_size_;  // Segment size in bytes
-  uint64 size_;  // Number of elements on table
+  volatile uint64 size_;  // Number of elements on table
+  volatile uint64 in_flight_;  // Number of elements with I/O in progress
+  // Record pool. Free records are linked through their address_ field.
+  BlockData *chunks_[kMaxChunks];
+  uint32 chunk_count_;
+  int64 free_record_;  // First free record, -1 for none.
+  volatile uint64 slot_bytes_;  // Memory used by the stripe hash tables.
+  pthread_mutex_t pool_mutex_;
+  // Only used by random threads waiting for the table to fill up.
   pthread_mutex_t data_mutex_;
   pthread_cond_t data_condition_;
   pthread_mutex_t parameter_mutex_;
@@ -0,0 +1,187 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Disk thread balancing across devices, see disk_orchestrator.h.
+
+#include <string.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "disk_orchestrator.h"
+#include "latency_histogram.h"
+#include "os.h"
+#include "worker.h"
+
+const double DiskOrchestrator::kMinGain = 1.05;
+
+DiskOrchestrator::DiskOrchestrator() {
+  last_us_ = 0;
+}
+
+DiskOrchestrator::Device *DiskOrchestrator::FindDevice(const string &name) {
+  for (size_t i = 0; i < devices_.size(); i++) {
+    if (devices_[i].name == name)
+      return &devices_[i];
+  }
+  Device device;
+  device.name = name;
+  device.node = -1;
+  device.tunable = true;
+  device.max_depth = DiskThread::kMaxQueueDepth;
+  device.depth = 0;
+  device.best_depth = 0;
+  device.best_mbps = 0;
+  device.mbps = 0;
+  device.settled = false;
+  device.settled_steps = 0;
+  device.last_data = 0;
+  devices_.push_back(device);
+  return &devices_.back();
+}
+
+void DiskOrchestrator::AddThread(DiskThread *thread) {
+  Device *device = FindDevice(thread->device_name());
+  device->threads.push_back(thread);
+  device->tunable = device->tunable && thread->uses_uring();
+  if (thread->queue_depth() < device->max_depth)
+    device->max_depth = thread->queue_depth();
+}
+
+void DiskOrchestrator::PinThreads(OsLayer *os) {
+  for (size_t i = 0; i < devices_.size(); i++) {
+    Device *device = &devices_[i];
+    cpu_set_t cpus;
+    device->node = os->FindDiskNode(device->name, &cpus);
+    if (device->node < 0) {
+      logprintf(12, "Log: Disk %s has no NUMA node, not pinning its "
+                "threads\n", device->name.c_str());
+      continue;
+    }
+    for (size_t j = 0; j < device->threads.size(); j++)
+      device->threads[j]->set_cpu_mask(&cpus);
+    logprintf(9, "Log: Disk %s is on node %d, %d threads pinned there\n",
+              device->name.c_str(), device->node,
+              static_cast<int>(device->threads.size()));
+  }
+}
+
+double DiskOrchestrator::DeviceData(const Device &device) {
+  double data = 0;
+  for (size_t i = 0; i < device.threads.size(); i++)
+    data += device.threads[i]->GetDeviceCopiedData();
+  return data;
+}
+
+void DiskOrchestrator::SetDepth(Device *device, int depth) {
+  if (depth > device->max_depth)
+    depth = device->max_depth;
+  device->depth = depth;
+  for (size_t i = 0; i < device->threads.size(); i++)
+    device->threads[i]->set_active_depth(depth);
+}
+
+bool DiskOrchestrator::Start() {
+  int tunable = 0;
+  for (size_t i = 0; i < devices_.size(); i++) {
+    Device *device = &devices_[i];
+    device->last_data = DeviceData(*device);
+    if (!device->tunable) {
+      logprintf(5, "Log: Disk %s doesn't use io_uring, not balancing its "
+                "queue depth\n", device->name.c_str());
+      continue;
+    }
+    tunable++;
+    device->settled = false;
+    device->best_depth = 0;
+    device->best_mbps = 0;
+    SetDepth(device, kStartDepth);
+  }
+  last_us_ = sat_get_time_us();
+  if (!tunable)
+    return false;
+  logprintf(5, "Log: Balancing queue depth on %d of %d disks\n", tunable,
+            static_cast<int>(devices_.size()));
+  return true;
+}
+
+void DiskOrchestrator::Step() {
+  int64 now_us = sat_get_time_us();
+  double seconds = (now_us - last_us_) / 1e6;
+  last_us_ = now_us;
+  if (seconds <= 0)
+    return;
+
+  for (size_t i = 0; i < devices_.size(); i++) {
+    Device *device = &devices_[i];
+    double data = DeviceData(*device);
+    device->mbps = (data - device->last_data) / seconds;
+    device->last_data = data;
+    if (!device->tunable)
+      continue;
+
+    if (device->settled) {
+      // Climb again from below the best depth now and then.
+      if (++device->settled_steps < kSettledSteps)
+        continue;
+      device->settled = false;
+      device->best_mbps = 0;
+      SetDepth(device, device->best_depth > 1 ? device->best_depth / 2 : 1);
+      continue;
+    }
+
+    if (device->mbps > device->best_mbps * kMinGain) {
+      device->best_mbps = device->mbps;
+      device->best_depth = device->depth;
+      if (device->depth < device->max_depth) {
+        SetDepth(device, device->depth * 2);
+        continue;
+      }
+    }
+    // Deeper didn't help, go back to the best depth.
+    SetDepth(device, device->best_depth);
+    device->settled = true;
+    device->settled_steps = 0;
+    logprintf(9, "Log: Disk %s settled on queue depth %d at %.2fMB/s\n",
+              device->name.c_str(), device->depth, device->best_mbps);
+  }
+}
+
+void DiskOrchestrator::Report() {
+  for (size_t i = 0; i < devices_.size(); i++) {
+    Device *device = &devices_[i];
+    double data = 0, bandwidth = 0;
+    LatencyHistogram reads, writes;
+    for (size_t j = 0; j < device->threads.size(); j++) {
+      DiskThread *thread = device->threads[j];
+      data += thread->GetDeviceCopiedData();
+      bandwidth += thread->GetDeviceBandwidth();
+      reads.Add(thread->read_latency());
+      writes.Add(thread->write_latency());
+    }
+
+    char depth[32] = "";
+    if (device->tunable && device->depth)
+      snprintf(depth, sizeof(depth), ", depth %d", device->depth);
+    logprintf(4, "Stats: Disk %s: %.2fM at %.2fMB/s%s\n",
+              device->name.c_str(), data, bandwidth, depth);
+    if (reads.count())
+      logprintf(4, "Stats: Disk %s: %lld reads, %s\n", device->name.c_str(),
+                static_cast<int64>(reads.count()),
+                reads.Summary().c_str());
+    if (writes.count())
+      logprintf(4, "Stats: Disk %s: %lld writes, %s\n", device->name.c_str(),
+                static_cast<int64>(writes.count()),
+                writes.Summary().c_str());
+  }
+}
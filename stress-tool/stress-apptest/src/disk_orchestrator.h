@@ -0,0 +1,99 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Balances the disk threads of many devices at once: pins each device's
+// threads to the cpus of the NUMA node the device hangs off, tunes how many
+// io_uring requests each device keeps in flight, and reports throughput
+// and latency per device.
+
+#ifndef STRESSAPPTEST_DISK_ORCHESTRATOR_H_
+#define STRESSAPPTEST_DISK_ORCHESTRATOR_H_
+
+#include <sched.h>
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+class DiskThread;
+class OsLayer;
+
+// The disk threads grouped by device. Each step measures a device's
+// throughput since the previous step and climbs its queue depth in powers
+// of two for as long as throughput keeps improving, then settles on the
+// best depth. Settled devices probe again now and then, since the best
+// depth moves with the load on the rest of the machine.
+//
+// Not threadsafe, driven from the main thread. The disk threads pick up
+// new depths on their own.
+class DiskOrchestrator {
+ public:
+  DiskOrchestrator();
+
+  // Add a disk thread. Call before the threads start.
+  void AddThread(DiskThread *thread);
+  // Pin every device's threads to its NUMA node. Call before the threads
+  // start.
+  void PinThreads(OsLayer *os);
+
+  // Set every io_uring device to its starting depth and begin measuring.
+  // Returns false if there is nothing to balance.
+  bool Start();
+  // Measure and adjust every device.
+  void Step();
+
+  // Log throughput, depth, and read and write latency percentiles for each
+  // device.
+  void Report();
+
+  int devices() const { return devices_.size(); }
+
+ private:
+  // Depth every device starts its climb from.
+  static const int kStartDepth = 4;
+  // A depth must beat the best one by this much to count as better.
+  static const double kMinGain;
+  // Steps a device stays settled before probing again.
+  static const int kSettledSteps = 30;
+
+  struct Device {
+    string name;
+    int node;                     // NUMA node, -1 if unknown.
+    vector<DiskThread*> threads;
+    bool tunable;                 // All threads use io_uring.
+    int max_depth;                // Smallest queue depth of its threads.
+    int depth;                    // Depth being measured.
+    int best_depth;
+    double best_mbps;             // At best_depth.
+    double mbps;                  // Over the last step.
+    bool settled;                 // Running at best_depth.
+    int settled_steps;            // Steps since it settled.
+    double last_data;             // MB moved by the last step.
+  };
+
+  // Returns the device 'name', adding it if it's new.
+  Device *FindDevice(const string &name);
+  // MB moved by all of a device's threads so far.
+  double DeviceData(const Device &device);
+  void SetDepth(Device *device, int depth);
+
+  vector<Device> devices_;
+  int64 last_us_;                 // Time of the last step.
+
+  DISALLOW_COPY_AND_ASSIGN(DiskOrchestrator);
+};
+
+#endif  // STRESSAPPTEST_DISK_ORCHESTRATOR_H_
@@ -0,0 +1,284 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Thin io_uring wrapper used by DiskThread, see disk_uring.h.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "disk_uring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+// Completion timeouts need the extended io_uring_enter arguments.
+#if defined(__NR_io_uring_setup) && defined(IORING_ENTER_EXT_ARG)
+#define STRESSAPPTEST_DISK_URING 1
+#endif
+#endif
+
+DiskUring::DiskUring() {
+  ring_fd_ = -1;
+  registered_ = false;
+  sq_ring_ = NULL;
+  sq_ring_size_ = 0;
+  cq_ring_ = NULL;
+  cq_ring_size_ = 0;
+  sqes_ = NULL;
+  sqes_size_ = 0;
+  sq_head_ = NULL;
+  sq_tail_ = NULL;
+  sq_array_ = NULL;
+  sq_mask_ = 0;
+  sq_entries_ = 0;
+  sq_local_tail_ = 0;
+  cq_head_ = NULL;
+  cq_tail_ = NULL;
+  cqes_ = NULL;
+  cq_mask_ = 0;
+}
+
+DiskUring::~DiskUring() {
+  Destroy();
+}
+
+bool DiskUring::Available() {
+#ifdef STRESSAPPTEST_DISK_URING
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef STRESSAPPTEST_DISK_URING
+
+int DiskUring::Initialize(unsigned int entries) {
+  Destroy();
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0)
+    return -errno;
+  ring_fd_ = fd;
+
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    Destroy();
+    return -EOPNOTSUPP;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32);
+  cq_ring_size_ = params.cq_off.cqes +
+                  params.cq_entries * sizeof(struct io_uring_cqe);
+  // Newer kernels map both rings with a single mmap.
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cq_ring_size_ > sq_ring_size_)
+      sq_ring_size_ = cq_ring_size_;
+    cq_ring_size_ = sq_ring_size_;
+  }
+
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    int error = errno;
+    sq_ring_ = NULL;
+    Destroy();
+    return -error;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      int error = errno;
+      cq_ring_ = NULL;
+      Destroy();
+      return -error;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    int error = errno;
+    sqes_ = NULL;
+    Destroy();
+    return -error;
+  }
+
+  char *sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<volatile uint32*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<volatile uint32*>(sq + params.sq_off.tail);
+  sq_array_ = reinterpret_cast<uint32*>(sq + params.sq_off.array);
+  sq_mask_ = *reinterpret_cast<uint32*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_local_tail_ = *sq_tail_;
+
+  char *cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<volatile uint32*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<volatile uint32*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32*>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  return 0;
+}
+
+int DiskUring::RegisterBuffers(void **buffers, int count, int64 size) {
+  if (ring_fd_ < 0)
+    return -EBADF;
+
+  struct iovec *iovecs = new struct iovec[count];
+  for (int i = 0; i < count; i++) {
+    iovecs[i].iov_base = buffers[i];
+    iovecs[i].iov_len = size;
+  }
+  int result = syscall(__NR_io_uring_register, ring_fd_,
+                       IORING_REGISTER_BUFFERS, iovecs, count);
+  int error = errno;
+  delete[] iovecs;
+  if (result < 0)
+    return -error;
+  registered_ = true;
+  return 0;
+}
+
+bool DiskUring::Queue(bool write, int fd, void *buf, int64 size,
+                      int64 offset, int buffer_index, uint64 user_data) {
+  if (sq_local_tail_ - *sq_head_ >= sq_entries_)
+    return false;
+
+  uint32 index = sq_local_tail_ & sq_mask_;
+  struct io_uring_sqe *sqe =
+      static_cast<struct io_uring_sqe*>(sqes_) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  if (registered_ && buffer_index >= 0) {
+    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->buf_index = buffer_index;
+  } else {
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  }
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64>(buf);
+  sqe->len = size;
+  sqe->off = offset;
+  sqe->user_data = user_data;
+
+  sq_array_[index] = index;
+  sq_local_tail_++;
+  return true;
+}
+
+int DiskUring::Submit() {
+  // Publish the new entries before the tail that makes them visible.
+  __sync_synchronize();
+  *sq_tail_ = sq_local_tail_;
+  __sync_synchronize();
+
+  uint32 pending = sq_local_tail_ - *sq_head_;
+  while (pending) {
+    int result = syscall(__NR_io_uring_enter, ring_fd_, pending, 0, 0,
+                         NULL, 0);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    pending = sq_local_tail_ - *sq_head_;
+  }
+  return 0;
+}
+
+int DiskUring::WaitCompletion(uint64 *user_data, int64 *result,
+                              int64 timeout) {
+  while (true) {
+    uint32 head = *cq_head_;
+    uint32 tail = *cq_tail_;
+    // Read the entry only after seeing the tail that published it.
+    __sync_synchronize();
+    if (head != tail) {
+      struct io_uring_cqe *cqe =
+          static_cast<struct io_uring_cqe*>(cqes_) + (head & cq_mask_);
+      *user_data = cqe->user_data;
+      *result = cqe->res;
+      __sync_synchronize();
+      *cq_head_ = head + 1;
+      return 0;
+    }
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000000;
+    ts.tv_nsec = (timeout % 1000000) * 1000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64>(&ts);
+    int ret = syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                      &arg, sizeof(arg));
+    if (ret < 0)
+      return -errno;
+  }
+}
+
+void DiskUring::Destroy() {
+  if (sqes_)
+    munmap(sqes_, sqes_size_);
+  if (cq_ring_ && cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_)
+    munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0)
+    close(ring_fd_);
+  ring_fd_ = -1;
+  registered_ = false;
+  sq_ring_ = NULL;
+  cq_ring_ = NULL;
+  sqes_ = NULL;
+  sq_entries_ = 0;
+}
+
+#else  // !STRESSAPPTEST_DISK_URING
+
+int DiskUring::Initialize(unsigned int entries) {
+  return -ENOSYS;
+}
+
+int DiskUring::RegisterBuffers(void **buffers, int count, int64 size) {
+  return -ENOSYS;
+}
+
+bool DiskUring::Queue(bool write, int fd, void *buf, int64 size,
+                      int64 offset, int buffer_index, uint64 user_data) {
+  return false;
+}
+
+int DiskUring::Submit() {
+  return -ENOSYS;
+}
+
+int DiskUring::WaitCompletion(uint64 *user_data, int64 *result,
+                              int64 timeout) {
+  return -ENOSYS;
+}
+
+void DiskUring::Destroy() {
+}
+
+#endif  // STRESSAPPTEST_DISK_URING
@@ -0,0 +1,98 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Minimal io_uring submission and completion ring for the disk threads,
+// talking to the kernel through the raw system calls so that no liburing
+// is needed.
+
+#ifndef STRESSAPPTEST_DISK_URING_H_
+#define STRESSAPPTEST_DISK_URING_H_
+
+#include <sys/types.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// One io_uring instance. Requests are queued into the submission ring,
+// handed to the kernel in batches with Submit(), and their results are
+// collected one at a time with WaitCompletion().
+//
+// Not threadsafe, each disk thread owns its own ring.
+class DiskUring {
+ public:
+  DiskUring();
+  ~DiskUring();
+
+  // Returns true if io_uring support was compiled in.
+  static bool Available();
+
+  // Create a ring with room for 'entries' submissions. Returns 0, or
+  // -errno on failure.
+  int Initialize(unsigned int entries);
+
+  // Register 'count' buffers of 'size' bytes for fixed buffer I/O.
+  // Returns 0, or -errno on failure, in which case requests still work
+  // with unregistered buffers.
+  int RegisterBuffers(void **buffers, int count, int64 size);
+
+  // Queue a read or a write of 'size' bytes at 'offset'. 'buffer_index'
+  // is the registered buffer that contains 'buf', or -1. 'user_data' is
+  // handed back with the completion. Returns false if the submission
+  // ring is full.
+  bool Queue(bool write, int fd, void *buf, int64 size, int64 offset,
+             int buffer_index, uint64 user_data);
+
+  // Pass all queued requests to the kernel. Returns 0, or -errno.
+  int Submit();
+
+  // Wait up to 'timeout' microseconds for a completion. Returns 0 and
+  // fills in 'user_data' and the request's 'result' (bytes transferred or
+  // -errno), or returns -ETIME on timeout, -EINTR on a signal, -errno on
+  // other failures.
+  int WaitCompletion(uint64 *user_data, int64 *result, int64 timeout);
+
+  // Release the ring and its mappings.
+  void Destroy();
+
+  unsigned int entries() const { return sq_entries_; }
+  bool registered() const { return registered_; }
+
+ private:
+  int ring_fd_;                   // Ring file descriptor, -1 if not set up.
+  bool registered_;               // Buffers are registered.
+
+  void *sq_ring_;                 // Submission ring mapping.
+  size_t sq_ring_size_;
+  void *cq_ring_;                 // Completion ring mapping, may be sq_ring_.
+  size_t cq_ring_size_;
+  void *sqes_;                    // Submission queue entries.
+  size_t sqes_size_;
+
+  volatile uint32 *sq_head_;      // Consumed by the kernel.
+  volatile uint32 *sq_tail_;      // Produced by us.
+  uint32 *sq_array_;              // Ring slot to sqe index.
+  uint32 sq_mask_;
+  uint32 sq_entries_;
+  uint32 sq_local_tail_;          // Queued but not yet published tail.
+
+  volatile uint32 *cq_head_;      // Consumed by us.
+  volatile uint32 *cq_tail_;      // Produced by the kernel.
+  void *cqes_;                    // Completion queue entries.
+  uint32 cq_mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiskUring);
+};
+
+#endif  // STRESSAPPTEST_DISK_URING_H_
@@ -0,0 +1,126 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// DRAM bank and row mapping, see dram_map.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "dram_map.h"
+
+DramMap::DramMap() {
+  row_shift_ = 18;
+  bank_masks_.push_back(0x2040);
+  bank_masks_.push_back(0x24000);
+  bank_masks_.push_back(0x48000);
+  bank_masks_.push_back(0x90000);
+}
+
+bool DramMap::Parse(const char *description) {
+  char *end;
+  long shift = strtol(description, &end, 10);  // NOLINT
+  if (end == description || *end != ':' || shift < 6 || shift > 40)
+    return false;
+
+  vector<uint64> masks;
+  const char *pos = end + 1;
+  while (*pos) {
+    uint64 mask = strtoull(pos, &end, 0);
+    if (end == pos || !mask ||
+        static_cast<int>(masks.size()) == kMaxBankBits)
+      return false;
+    masks.push_back(mask);
+    pos = end;
+    if (*pos == ',')
+      pos++;
+    else if (*pos)
+      return false;
+  }
+  if (masks.empty())
+    return false;
+
+  row_shift_ = shift;
+  bank_masks_ = masks;
+  return true;
+}
+
+string DramMap::Format() const {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%d:", row_shift_);
+  string format = buf;
+  for (size_t i = 0; i < bank_masks_.size(); i++) {
+    snprintf(buf, sizeof(buf), "%s%#llx", i ? "," : "", bank_masks_[i]);
+    format += buf;
+  }
+  return format;
+}
+
+const char *ChannelMap::ParseMasks(const char *pos, int max,
+                                   vector<uint64> *masks) {
+  masks->clear();
+  while (*pos && *pos != ';') {
+    char *end;
+    uint64 mask = strtoull(pos, &end, 0);
+    if (end == pos || !mask || static_cast<int>(masks->size()) == max)
+      return NULL;
+    masks->push_back(mask);
+    pos = end;
+    if (*pos == ',')
+      pos++;
+    else if (*pos && *pos != ';')
+      return NULL;
+  }
+  return masks->empty() ? NULL : pos;
+}
+
+bool ChannelMap::Parse(const char *description) {
+  vector<uint64> channels;
+  vector<uint64> ranks;
+  const char *pos = description;
+  while (pos && *pos) {
+    if (!strncmp(pos, "channel=", 8))
+      pos = ParseMasks(pos + 8, kMaxChannelBits, &channels);
+    else if (!strncmp(pos, "rank=", 5))
+      pos = ParseMasks(pos + 5, kMaxRankBits, &ranks);
+    else
+      return false;
+    if (pos && *pos == ';')
+      pos++;
+  }
+  if (!pos || channels.empty())
+    return false;
+
+  channel_masks_ = channels;
+  rank_masks_ = ranks;
+  return true;
+}
+
+string ChannelMap::Format() const {
+  char buf[32];
+  string format = "channel=";
+  for (size_t i = 0; i < channel_masks_.size(); i++) {
+    snprintf(buf, sizeof(buf), "%s%#llx", i ? "," : "", channel_masks_[i]);
+    format += buf;
+  }
+  if (!rank_masks_.empty())
+    format += ";rank=";
+  for (size_t i = 0; i < rank_masks_.size(); i++) {
+    snprintf(buf, sizeof(buf), "%s%#llx", i ? "," : "", rank_masks_[i]);
+    format += buf;
+  }
+  return format;
+}
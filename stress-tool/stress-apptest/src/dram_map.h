@@ -0,0 +1,111 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Description of how physical addresses map onto DRAM banks and rows,
+// used to find physically adjacent rows.
+
+#ifndef STRESSAPPTEST_DRAM_MAP_H_
+#define STRESSAPPTEST_DRAM_MAP_H_
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// Rows start at bit 'row_shift' of the physical address. Each bank bit is
+// the parity of the address bits in one mask, which covers the plain and
+// the XOR hashed bank selection of most memory controllers.
+//
+// The description format is "row_shift:mask,mask,...", with masks in hex
+// or decimal, for example "18:0x2040,0x24000,0x48000,0x90000".
+class DramMap {
+ public:
+  // Starts with the example mapping above, a common dual channel layout.
+  DramMap();
+
+  // Replace the mapping with 'description'. Returns false and keeps the
+  // old mapping if it doesn't parse.
+  bool Parse(const char *description);
+
+  uint64 Row(uint64 paddr) const { return paddr >> row_shift_; }
+  uint32 Bank(uint64 paddr) const {
+    uint32 bank = 0;
+    for (size_t i = 0; i < bank_masks_.size(); i++)
+      bank |= __builtin_parityll(paddr & bank_masks_[i]) << i;
+    return bank;
+  }
+
+  // The mapping in the description format.
+  string Format() const;
+
+ private:
+  static const int kMaxBankBits = 16;
+
+  int row_shift_;
+  vector<uint64> bank_masks_;
+};
+
+// Channels and ranks of physical addresses, in the same parity of masks
+// form as the banks above. Used to schedule pages by channel and to name
+// the device errors are counted against.
+//
+// The description format is "channel=mask,...[;rank=mask,...]", for
+// example "channel=0x100000;rank=0x200000" for two channels interleaved
+// every megabyte with two ranks each. Without masks every address is in
+// channel 0, rank 0.
+class ChannelMap {
+ public:
+  ChannelMap() {}
+
+  // Replace the mapping with 'description'. Returns false and keeps the
+  // old mapping if it doesn't parse.
+  bool Parse(const char *description);
+
+  bool enabled() const { return !channel_masks_.empty(); }
+  int channels() const { return 1 << channel_masks_.size(); }
+  int ranks() const { return 1 << rank_masks_.size(); }
+  int Channel(uint64 paddr) const { return Decode(channel_masks_, paddr); }
+  int Rank(uint64 paddr) const { return Decode(rank_masks_, paddr); }
+  // Address bits that select the channel.
+  uint64 channel_bits() const {
+    uint64 bits = 0;
+    for (size_t i = 0; i < channel_masks_.size(); i++)
+      bits |= channel_masks_[i];
+    return bits;
+  }
+
+  // The mapping in the description format.
+  string Format() const;
+
+ private:
+  static const int kMaxChannelBits = 4;
+  static const int kMaxRankBits = 4;
+
+  static int Decode(const vector<uint64> &masks, uint64 paddr) {
+    int value = 0;
+    for (size_t i = 0; i < masks.size(); i++)
+      value |= __builtin_parityll(paddr & masks[i]) << i;
+    return value;
+  }
+  // Parse "mask,mask,..." up to the end or a ';', into 'masks'.
+  static const char *ParseMasks(const char *pos, int max,
+                                vector<uint64> *masks);
+
+  vector<uint64> channel_masks_;
+  vector<uint64> rank_masks_;
+};
+
+#endif  // STRESSAPPTEST_DRAM_MAP_H_
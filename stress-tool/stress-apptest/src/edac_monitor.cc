@@ -0,0 +1,445 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Memory controller error polling through EDAC, see edac_monitor.h.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "edac_monitor.h"
+#include "error_diag.h"
+#include "os.h"
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#ifdef __NR_perf_event_open
+#define STRESSAPPTEST_EDAC_TRACE 1
+#endif
+#endif
+
+namespace {
+const char kEdacPath[] = "/sys/devices/system/edac/mc";
+// Where tracefs may be mounted.
+const char *const kTracingPaths[] = {
+  "/sys/kernel/tracing/events/ras/mc_event",
+  "/sys/kernel/debug/tracing/events/ras/mc_event",
+};
+// enum hw_event_mc_err_type of the kernel.
+const int kCorrectedError = 0;
+const int kInfoError = 4;
+
+// Returns the first line of 'path' without the newline, or "".
+string ReadLine(const string &path) {
+  char buf[256] = "";
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+    return "";
+  if (!fgets(buf, sizeof(buf), file))
+    buf[0] = '\0';
+  fclose(file);
+  size_t len = strlen(buf);
+  while (len && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+    buf[--len] = '\0';
+  return buf;
+}
+
+// Returns the names in 'dir' starting with 'prefix', sorted.
+vector<string> ListDir(const string &dir, const char *prefix) {
+  vector<string> names;
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return names;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (!strncmp(entry->d_name, prefix, strlen(prefix)))
+      names.push_back(entry->d_name);
+  }
+  closedir(d);
+  sort(names.begin(), names.end());
+  return names;
+}
+
+// Read a little endian field of 'size' bytes from a raw sample.
+uint32 RawField(const char *raw, int offset, int size) {
+  uint32 value = 0;
+  memcpy(&value, raw + offset, size > 4 ? 4 : size);
+  return value;
+}
+}  // namespace
+
+EdacMonitor::EdacMonitor() {
+  format_.error_type = -1;
+  format_.error_count = -1;
+  format_.label = -1;
+  format_.error_type_size = 0;
+  format_.error_count_size = 0;
+  page_size_ = sysconf(_SC_PAGESIZE);
+  lost_ = 0;
+}
+
+EdacMonitor::~EdacMonitor() {
+  for (size_t i = 0; i < rings_.size(); i++) {
+    munmap(rings_[i].base, (kRingPages + 1) * page_size_);
+    close(rings_[i].fd);
+  }
+}
+
+bool EdacMonitor::Initialize() {
+  vector<string> mcs = ListDir(kEdacPath, "mc");
+  for (size_t i = 0; i < mcs.size(); i++)
+    FindCounters(mcs[i]);
+  // Only count errors from now on.
+  for (size_t i = 0; i < counters_.size(); i++) {
+    counters_[i].ce = ReadCounter(counters_[i].ce_path);
+    counters_[i].ue = ReadCounter(counters_[i].ue_path);
+  }
+
+  if (OpenRings()) {
+    logprintf(5, "Log: Watching memory controller errors through "
+                 "ras:mc_event on %d cpus.\n",
+              static_cast<int>(rings_.size()));
+  } else if (!counters_.empty()) {
+    logprintf(5, "Log: Polling %d EDAC error counters.\n",
+              static_cast<int>(counters_.size()));
+  } else {
+    logprintf(5, "Log: No EDAC memory controllers found, "
+                 "not polling for ECC errors.\n");
+    return false;
+  }
+  return true;
+}
+
+void EdacMonitor::FindCounters(const string &mc) {
+  string dir = string(kEdacPath) + "/" + mc;
+  struct Counter counter;
+
+  // Errors the controller couldn't attribute to a DIMM.
+  counter.label = mc;
+  counter.ce_path = dir + "/ce_noinfo_count";
+  counter.ue_path = dir + "/ue_noinfo_count";
+  counters_.push_back(counter);
+
+  // Newer kernels list each DIMM, or each rank without DIMM information.
+  vector<string> dimms = ListDir(dir, "dimm");
+  if (dimms.empty())
+    dimms = ListDir(dir, "rank");
+  for (size_t i = 0; i < dimms.size(); i++) {
+    string dimm = dir + "/" + dimms[i];
+    counter.label = ReadLine(dimm + "/dimm_label");
+    if (counter.label.empty())
+      counter.label = mc + " " + dimms[i];
+    counter.ce_path = dimm + "/dimm_ce_count";
+    counter.ue_path = dimm + "/dimm_ue_count";
+    counters_.push_back(counter);
+  }
+
+  // Older ones only count per chip select row and channel, and count
+  // uncorrected errors per row.
+  if (dimms.empty()) {
+    vector<string> csrows = ListDir(dir, "csrow");
+    for (size_t i = 0; i < csrows.size(); i++) {
+      string csrow = dir + "/" + csrows[i];
+      for (int ch = 0; ; ch++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/ch%d_ce_count", ch);
+        if (access((csrow + name).c_str(), R_OK))
+          break;
+        counter.ce_path = csrow + name;
+        snprintf(name, sizeof(name), "/ch%d_dimm_label", ch);
+        counter.label = ReadLine(csrow + name);
+        if (counter.label.empty()) {
+          snprintf(name, sizeof(name), " ch%d", ch);
+          counter.label = mc + " " + csrows[i] + name;
+        }
+        counter.ue_path = "";
+        counters_.push_back(counter);
+      }
+      counter.label = mc + " " + csrows[i];
+      counter.ce_path = "";
+      counter.ue_path = csrow + "/ue_count";
+      counters_.push_back(counter);
+    }
+  }
+}
+
+int64 EdacMonitor::ReadCounter(const string &path) {
+  if (path.empty())
+    return -1;
+  string line = ReadLine(path);
+  if (line.empty())
+    return -1;
+  return strtoll(line.c_str(), NULL, 10);
+}
+
+void EdacMonitor::ReportErrors(const string &label, int64 count, bool fatal,
+                               ErrorDiag *diag, OsLayer *os) {
+  if (count <= 0)
+    return;
+  os->ErrorReport(label.c_str(), fatal ? "uecc" : "cecc", count);
+  if (!diag)
+    return;
+  for (int64 i = 0; i < count; i++) {
+    if (fatal)
+      diag->AddUeccError(label);
+    else
+      diag->AddCeccError(label);
+  }
+}
+
+int EdacMonitor::Poll(ErrorDiag *diag, OsLayer *os) {
+  int fatal = 0;
+  if (tracing()) {
+    for (size_t i = 0; i < rings_.size(); i++)
+      fatal += DrainRing(&rings_[i], diag, os);
+    return fatal;
+  }
+
+  for (size_t i = 0; i < counters_.size(); i++) {
+    struct Counter *counter = &counters_[i];
+    int64 ce = ReadCounter(counter->ce_path);
+    int64 ue = ReadCounter(counter->ue_path);
+    // A write to reset_counters starts them over from zero.
+    if (ce >= 0 && counter->ce >= 0 && ce > counter->ce)
+      ReportErrors(counter->label, ce - counter->ce, false, diag, os);
+    if (ue >= 0 && counter->ue >= 0 && ue > counter->ue) {
+      ReportErrors(counter->label, ue - counter->ue, true, diag, os);
+      fatal += ue - counter->ue;
+    }
+    counter->ce = ce;
+    counter->ue = ue;
+  }
+  return fatal;
+}
+
+#ifdef STRESSAPPTEST_EDAC_TRACE
+
+bool EdacMonitor::ParseFormat(const string &path) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+    return false;
+  // Lines look like
+  //   field:unsigned int error_type;  offset:8;  size:4;  signed:0;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    char *field = strstr(line, "field:");
+    char *semicolon = field ? strchr(field, ';') : NULL;
+    char *offset = strstr(line, "offset:");
+    char *size = strstr(line, "size:");
+    if (!semicolon || !offset || !size)
+      continue;
+    *semicolon = '\0';
+    char *name = strrchr(field, ' ');
+    name = name ? name + 1 : field + strlen("field:");
+    // Arrays are declared as "char label[]", strip the brackets.
+    char *bracket = strchr(name, '[');
+    if (bracket)
+      *bracket = '\0';
+    int off = strtol(offset + strlen("offset:"), NULL, 10);
+    int sz = strtol(size + strlen("size:"), NULL, 10);
+    if (!strcmp(name, "error_type")) {
+      format_.error_type = off;
+      format_.error_type_size = sz;
+    } else if (!strcmp(name, "error_count")) {
+      format_.error_count = off;
+      format_.error_count_size = sz;
+    } else if (!strcmp(name, "label")) {
+      format_.label = off;
+    }
+  }
+  fclose(file);
+  return format_.error_type >= 0 && format_.error_count >= 0 &&
+         format_.label >= 0;
+}
+
+bool EdacMonitor::OpenRings() {
+  string events;
+  int64 id = -1;
+  for (size_t i = 0; i < sizeof(kTracingPaths) / sizeof(*kTracingPaths);
+       i++) {
+    string line = ReadLine(string(kTracingPaths[i]) + "/id");
+    if (!line.empty()) {
+      events = kTracingPaths[i];
+      id = strtoll(line.c_str(), NULL, 10);
+      break;
+    }
+  }
+  if (id < 0 || !ParseFormat(events + "/format"))
+    return false;
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_TRACEPOINT;
+  attr.size = sizeof(attr);
+  attr.config = id;
+  attr.sample_period = 1;
+  attr.sample_type = PERF_SAMPLE_RAW;
+  attr.wakeup_events = 1;
+
+  int cpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (int cpu = 0; cpu < cpus; cpu++) {
+    int fd = syscall(__NR_perf_event_open, &attr, -1, cpu, -1, 0);
+    if (fd < 0) {
+      // Offline cpus fail with ENODEV, anything else is not allowed.
+      if (errno == ENODEV)
+        continue;
+      logprintf(12, "Log: Can't open ras:mc_event on cpu %d: %s\n",
+                cpu, ErrorString(errno).c_str());
+      break;
+    }
+    void *base = mmap(NULL, (kRingPages + 1) * page_size_,
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      close(fd);
+      break;
+    }
+    struct Ring ring = { fd, static_cast<char*>(base) };
+    rings_.push_back(ring);
+  }
+  // Either every cpu is watched, or the counters are polled.
+  if (static_cast<int>(rings_.size()) < sysconf(_SC_NPROCESSORS_ONLN)) {
+    for (size_t i = 0; i < rings_.size(); i++) {
+      munmap(rings_[i].base, (kRingPages + 1) * page_size_);
+      close(rings_[i].fd);
+    }
+    rings_.clear();
+  }
+  return !rings_.empty();
+}
+
+int EdacMonitor::DrainRing(struct Ring *ring, ErrorDiag *diag, OsLayer *os) {
+  struct perf_event_mmap_page *meta =
+      reinterpret_cast<struct perf_event_mmap_page*>(ring->base);
+  char *data = ring->base + page_size_;
+  uint64 size = kRingPages * page_size_;
+  uint64 head = meta->data_head;
+  // Read the records only after seeing the head that published them.
+  __sync_synchronize();
+  uint64 tail = meta->data_tail;
+
+  int fatal = 0;
+  vector<char> record;
+  while (tail < head) {
+    struct perf_event_header header;
+    uint64 pos = tail % size;
+    // Records may wrap around the end of the ring.
+    for (size_t i = 0; i < sizeof(header); i++)
+      reinterpret_cast<char*>(&header)[i] = data[(pos + i) % size];
+    if (header.size < sizeof(header) || tail + header.size > head)
+      break;
+    record.resize(header.size);
+    for (size_t i = 0; i < header.size; i++)
+      record[i] = data[(pos + i) % size];
+
+    const char *body = &record[sizeof(header)];
+    if (header.type == PERF_RECORD_SAMPLE &&
+        header.size >= sizeof(header) + sizeof(uint32)) {
+      uint32 raw_size;
+      memcpy(&raw_size, body, sizeof(raw_size));
+      if (sizeof(header) + sizeof(raw_size) + raw_size <= header.size)
+        fatal += ReportEvent(body + sizeof(raw_size), raw_size, diag, os);
+    } else if (header.type == PERF_RECORD_LOST &&
+               header.size >= sizeof(header) + 2 * sizeof(uint64)) {
+      uint64 lost;
+      memcpy(&lost, body + sizeof(uint64), sizeof(lost));
+      lost_ += lost;
+      logprintf(0, "Warning: %lld memory controller error events lost, "
+                   "ECC error counts are low.\n",
+                static_cast<int64>(lost));
+    }
+    tail += header.size;
+  }
+  // Hand the space back only after the records are read.
+  __sync_synchronize();
+  meta->data_tail = tail;
+  return fatal;
+}
+
+int EdacMonitor::ReportEvent(const char *raw, uint32 size, ErrorDiag *diag,
+                             OsLayer *os) {
+  if (format_.error_type + format_.error_type_size > static_cast<int>(size) ||
+      format_.error_count + format_.error_count_size > static_cast<int>(size) ||
+      format_.label + 4 > static_cast<int>(size))
+    return 0;
+  int type = RawField(raw, format_.error_type, format_.error_type_size);
+  int64 count = RawField(raw, format_.error_count, format_.error_count_size);
+  if (type == kInfoError)
+    return 0;
+
+  // A __data_loc field holds the length above the offset of the string.
+  uint32 loc = RawField(raw, format_.label, 4);
+  uint32 offset = loc & 0xffff;
+  uint32 length = loc >> 16;
+  string label;
+  if (offset + length <= size)
+    label.assign(raw + offset, strnlen(raw + offset, length));
+  if (label.empty() || label == "any memory")
+    label = "unknown";
+
+  bool fatal = type != kCorrectedError;
+  ReportErrors(label, count, fatal, diag, os);
+  return fatal ? count : 0;
+}
+
+void EdacMonitor::Wait(int timeout_ms) {
+  if (!tracing()) {
+    sat_sleep(timeout_ms / 1000);
+    return;
+  }
+  vector<struct pollfd> fds(rings_.size());
+  for (size_t i = 0; i < rings_.size(); i++) {
+    fds[i].fd = rings_[i].fd;
+    fds[i].events = POLLIN;
+    fds[i].revents = 0;
+  }
+  poll(&fds[0], fds.size(), timeout_ms);
+}
+
+#else  // !STRESSAPPTEST_EDAC_TRACE
+
+bool EdacMonitor::ParseFormat(const string &path) {
+  return false;
+}
+
+bool EdacMonitor::OpenRings() {
+  return false;
+}
+
+int EdacMonitor::DrainRing(struct Ring *ring, ErrorDiag *diag, OsLayer *os) {
+  return 0;
+}
+
+int EdacMonitor::ReportEvent(const char *raw, uint32 size, ErrorDiag *diag,
+                             OsLayer *os) {
+  return 0;
+}
+
+void EdacMonitor::Wait(int timeout_ms) {
+  sat_sleep(timeout_ms / 1000);
+}
+
+#endif  // STRESSAPPTEST_EDAC_TRACE
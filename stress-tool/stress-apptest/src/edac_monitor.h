@@ -0,0 +1,110 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Memory controller error counters from Linux EDAC, and the ras:mc_event
+// tracepoint for seeing each error as it happens.
+
+#ifndef STRESSAPPTEST_EDAC_MONITOR_H_
+#define STRESSAPPTEST_EDAC_MONITOR_H_
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+class ErrorDiag;
+class OsLayer;
+
+// Watches the memory controllers for corrected and uncorrected errors.
+//
+// When the ras:mc_event tracepoint can be opened, every error arrives
+// through a perf ring buffer per CPU with its DIMM label as it is logged,
+// and Wait() returns as soon as one does. Otherwise the per DIMM counters
+// under /sys/devices/system/edac/mc are read on each Poll() and compared
+// with the previous reading.
+//
+// Not threadsafe, owned by the error poll thread.
+class EdacMonitor {
+ public:
+  EdacMonitor();
+  ~EdacMonitor();
+
+  // Find the counters and open the tracepoint rings. Returns false if
+  // there is neither.
+  bool Initialize();
+
+  // Report the errors since the last call to 'diag' and 'os'. Returns the
+  // number of uncorrected errors found.
+  int Poll(ErrorDiag *diag, OsLayer *os);
+
+  // Wait up to 'timeout_ms' for the next event, or sleep that long.
+  void Wait(int timeout_ms);
+
+  bool tracing() const { return !rings_.empty(); }
+
+ private:
+  // Pages of each ring buffer, a power of two.
+  static const int kRingPages = 8;
+
+  // A DIMM (or csrow channel) and its counters.
+  struct Counter {
+    string label;
+    string ce_path;
+    string ue_path;             // Empty if only the csrow counts them.
+    int64 ce;
+    int64 ue;
+  };
+  // A tracepoint ring of one CPU.
+  struct Ring {
+    int fd;
+    char *base;                 // Metadata page, then the data pages.
+  };
+  // Offsets of the mc_event fields in the raw sample.
+  struct EventFormat {
+    int error_type;
+    int error_type_size;
+    int error_count;
+    int error_count_size;
+    int label;                  // A __data_loc string.
+  };
+
+  // Add the counters of one memory controller directory.
+  void FindCounters(const string &mc);
+  // Read counter 'path', -1 on failure.
+  static int64 ReadCounter(const string &path);
+  // Find the mc_event tracepoint and open its rings.
+  bool OpenRings();
+  // Parse the tracepoint format at 'path'. Returns false if a field is
+  // missing.
+  bool ParseFormat(const string &path);
+  // Report the events in 'ring'. Returns the uncorrected errors.
+  int DrainRing(struct Ring *ring, ErrorDiag *diag, OsLayer *os);
+  // Report one raw mc_event sample. Returns the uncorrected errors.
+  int ReportEvent(const char *raw, uint32 size, ErrorDiag *diag, OsLayer *os);
+  // Report 'count' corrected or uncorrected errors on 'label'.
+  static void ReportErrors(const string &label, int64 count, bool fatal,
+                           ErrorDiag *diag, OsLayer *os);
+
+  vector<struct Counter> counters_;
+  vector<struct Ring> rings_;
+  struct EventFormat format_;
+  int64 page_size_;
+  int64 lost_;                  // Events dropped by full rings.
+
+  DISALLOW_COPY_AND_ASSIGN(EdacMonitor);
+};
+
+#endif  // STRESSAPPTEST_EDAC_MONITOR_H_
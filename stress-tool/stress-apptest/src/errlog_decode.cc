@@ -0,0 +1,230 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// errlog_decode.cc : renders a binary error log written by
+// stressapptest --binary_error_log as text log lines or as CSV.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "error_log.h"
+#include "sattypes.h"
+
+namespace {
+
+// Strings defined so far, by id.
+vector<string> g_strings(65536);
+
+const char *StringOf(uint16 id, const char *none) {
+  if (id == 0 || g_strings[id].empty())
+    return none;
+  return g_strings[id].c_str();
+}
+
+// Formats a wall clock time like the text log timestamps, with
+// microseconds added.
+string TimeOf(uint64 time_us) {
+  time_t seconds = time_us / 1000000;
+  struct tm time_struct;
+  localtime_r(&seconds, &time_struct);
+  char date[64];
+  char zone[16];
+  strftime(date, sizeof(date), "%Y/%m/%d-%H:%M:%S", &time_struct);
+  strftime(zone, sizeof(zone), "%Z", &time_struct);
+  char buffer[96];
+  snprintf(buffer, sizeof(buffer), "%s.%06llu(%s)", date,
+           time_us % 1000000, zone);
+  return buffer;
+}
+
+const char *KindOf(uint16 kind) {
+  switch (kind) {
+    case kErrorKindMemory:
+      return "memory";
+    case kErrorKindTag:
+      return "tag";
+    case kErrorKindFile:
+      return "file";
+    default:
+      return "unknown";
+  }
+}
+
+// Prints 'text' as a CSV field.
+void PrintCsvString(const char *text) {
+  putchar('"');
+  for (const char *p = text; *p; p++) {
+    if (*p == '"')
+      putchar('"');
+    putchar(*p);
+  }
+  putchar('"');
+}
+
+void PrintCsvHeader() {
+  printf("timestamp_us,kind,message,thread,cpu,lastcpu,vaddr,paddr,dimm,"
+         "tagvaddr,tagpaddr,tag_dimm,device,expected,actual,reread,"
+         "pattern\n");
+}
+
+void PrintCsv(const struct ErrorLogMiscompare &r) {
+  printf("%llu,%s,", r.timestamp_us, KindOf(r.kind));
+  PrintCsvString(StringOf(r.message_id, ""));
+  printf(",%d,%d,%d,0x%llx,0x%llx,", r.thread, r.cpu, r.lastcpu,
+         r.vaddr, r.paddr);
+  PrintCsvString(StringOf(r.dimm_id, ""));
+  printf(",0x%llx,0x%llx,", r.tagvaddr, r.tagpaddr);
+  PrintCsvString(StringOf(r.tag_dimm_id, ""));
+  putchar(',');
+  PrintCsvString(StringOf(r.device_id, ""));
+  printf(",0x%016llx,0x%016llx,0x%016llx,", r.expected, r.actual, r.reread);
+  PrintCsvString(StringOf(r.pattern_id, "None"));
+  putchar('\n');
+}
+
+// Prints the record the way the text log would have.
+void PrintText(const struct ErrorLogMiscompare &r) {
+  string when = TimeOf(r.timestamp_us);
+  const char *message = StringOf(r.message_id, "Error");
+  const char *dimm = StringOf(r.dimm_id, "");
+  switch (r.kind) {
+    case kErrorKindTag:
+      printf("%s %s: Tag from 0x%llx(0x%llx:%s) (%s) "
+             "miscompare on CPU %d at 0x%llx(0x%llx:%s): "
+             "read:0x%016llx, reread:0x%016llx expected:0x%016llx\n",
+             when.c_str(), message, r.tagvaddr, r.tagpaddr,
+             StringOf(r.tag_dimm_id, ""),
+             (r.actual != r.reread) ? "read error" : "write error",
+             r.cpu, r.vaddr, r.paddr, dimm, r.actual, r.reread, r.expected);
+      break;
+    case kErrorKindFile:
+      printf("%s %s: miscompare on %s at 0x%llx(0x%llx:%s): "
+             "read:0x%016llx, reread:0x%016llx expected:0x%016llx\n",
+             when.c_str(), message, StringOf(r.device_id, "unknown"),
+             r.vaddr, r.paddr, dimm, r.actual, r.reread, r.expected);
+      break;
+    default:
+      printf("%s %s: miscompare on CPU %d(<-%d) at 0x%llx(0x%llx:%s): "
+             "read:0x%016llx, reread:0x%016llx expected:0x%016llx. "
+             "'%s'%s.\n",
+             when.c_str(), message, r.cpu, r.lastcpu, r.vaddr, r.paddr,
+             dimm, r.actual, r.reread, r.expected,
+             StringOf(r.pattern_id, "None"),
+             (r.reread == r.expected) ? " read error" : "");
+      break;
+  }
+}
+
+void Usage() {
+  fprintf(stderr, "Usage: errlog_decode [--csv] file\n"
+                  " --csv   print one comma separated line per miscompare\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool csv = false;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv")) {
+      csv = true;
+    } else if (!path && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (!path) {
+    Usage();
+    return 1;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Error: cannot open %s\n", path);
+    return 1;
+  }
+
+  struct ErrorLogHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, kErrorLogMagic, sizeof(header.magic))) {
+    fprintf(stderr, "Error: %s is not a binary error log\n", path);
+    fclose(file);
+    return 1;
+  }
+  if (header.version != kErrorLogVersion) {
+    fprintf(stderr, "Error: %s has unsupported version %u\n", path,
+            header.version);
+    fclose(file);
+    return 1;
+  }
+
+  if (csv)
+    PrintCsvHeader();
+  else
+    printf("Log: binary error log started %s\n",
+           TimeOf(header.start_time_us).c_str());
+
+  int64 records = 0;
+  int result = 0;
+  char buffer[65536];
+  struct ErrorLogRecordHeader *record =
+      reinterpret_cast<struct ErrorLogRecordHeader*>(buffer);
+  while (fread(record, sizeof(*record), 1, file) == 1) {
+    if (record->length < sizeof(*record)) {
+      fprintf(stderr, "Error: bad record length %u after %lld records\n",
+              record->length, records);
+      result = 1;
+      break;
+    }
+    size_t rest = record->length - sizeof(*record);
+    if (rest && fread(buffer + sizeof(*record), rest, 1, file) != 1) {
+      fprintf(stderr, "Error: truncated record after %lld records\n",
+              records);
+      result = 1;
+      break;
+    }
+
+    if (record->type == kErrorLogString &&
+        record->length >= sizeof(struct ErrorLogString)) {
+      struct ErrorLogString *definition =
+          reinterpret_cast<struct ErrorLogString*>(buffer);
+      g_strings[definition->id].assign(
+          buffer + sizeof(*definition),
+          record->length - sizeof(*definition));
+    } else if (record->type == kErrorLogMiscompare &&
+               record->length >= sizeof(struct ErrorLogMiscompare)) {
+      struct ErrorLogMiscompare miscompare;
+      memcpy(&miscompare, buffer, sizeof(miscompare));
+      if (csv)
+        PrintCsv(miscompare);
+      else
+        PrintText(miscompare);
+      records++;
+    }
+    // Records of unknown types are skipped.
+  }
+
+  if (!csv)
+    printf("Log: %lld miscompares\n", records);
+  fclose(file);
+  return result;
+}
@@ -27,7 +27,7 @@
 
 // DeviceTree constructor.
 DeviceTree::DeviceTree(string name)
-  : parent_(0), name_(name) {
+  : logged_(0), correctable_(0), fatal_(0), parent_(0), name_(name) {
   pthread_mutex_init(&device_tree_mutex_, NULL);
 }
 
@@ -79,6 +79,16 @@ DeviceTree *DeviceTree::UnlockedFindInSubTree(string name) {
 
 // Atomically add error instance to device.
 void DeviceTree::AddErrorInstance(ErrorInstance *error_instance) {
+  if (error_instance->severity_ == SAT_ERROR_FATAL)
+    __sync_fetch_and_add(&fatal_, 1);
+  else
+    __sync_fetch_and_add(&correctable_, 1);
+
+  // A failing DIMM can see millions of errors, only log the first ones.
+  if (__sync_fetch_and_add(&logged_, 1) >= kMaxLoggedErrors) {
+    delete error_instance;
+    return;
+  }
   pthread_mutex_lock(&device_tree_mutex_);
   errors_.push_back(error_instance);
   pthread_mutex_unlock(&device_tree_mutex_);
@@ -117,32 +127,65 @@ void DeviceTree::InsertSubDevice(string name) {
 }
 
 
-// Returns true of any error associated with this device is fatal.
-bool DeviceTree::KnownBad() {
+void DeviceTree::CollectErrors(DeviceErrorMap *errors) {
   pthread_mutex_lock(&device_tree_mutex_);
-  for (std::list<ErrorInstance*>::iterator itr = errors_.begin();
-      itr != errors_.end();
+  int64 fatal = __atomic_load_n(&fatal_, __ATOMIC_RELAXED);
+  int64 correctable = __atomic_load_n(&correctable_, __ATOMIC_RELAXED);
+  if (fatal || correctable) {
+    struct DeviceErrors *counts = &(*errors)[name_];
+    counts->fatal += fatal;
+    counts->correctable += correctable;
+  }
+  for (std::map<string, DeviceTree*>::iterator itr = subdevices_.begin();
+      itr != subdevices_.end();
       ++itr) {
-    if ((*itr)->severity_ == SAT_ERROR_FATAL) {
-      pthread_mutex_unlock(&device_tree_mutex_);
-      return true;
-    }
+    itr->second->CollectErrors(errors);
   }
   pthread_mutex_unlock(&device_tree_mutex_);
-  return false;
 }
 
-
 // ErrorDiag constructor.
 ErrorDiag::ErrorDiag() {
   os_ = 0;
   system_tree_root_ = 0;
+  for (int i = 0; i < kIndexStripes; i++)
+    pthread_rwlock_init(&index_[i].lock, NULL);
 }
 
 // ErrorDiag destructor.
 ErrorDiag::~ErrorDiag() {
   if (system_tree_root_)
     delete system_tree_root_;
+  for (int i = 0; i < kIndexStripes; i++)
+    pthread_rwlock_destroy(&index_[i].lock);
+}
+
+// Returns the index entry of the named device, adding it to the tree and
+// the index the first time.
+DeviceTree *ErrorDiag::FindOrAddDevice(const string &name) {
+  // FNV-1a picks the stripe.
+  uint32 hash = 2166136261U;
+  for (string::size_type i = 0; i < name.size(); i++)
+    hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619U;
+  struct IndexStripe *stripe = &index_[hash % kIndexStripes];
+
+  DeviceTree *device = NULL;
+  pthread_rwlock_rdlock(&stripe->lock);
+  std::map<string, DeviceTree*>::const_iterator it =
+      stripe->devices.find(name);
+  if (it != stripe->devices.end())
+    device = it->second;
+  pthread_rwlock_unlock(&stripe->lock);
+  if (device)
+    return device;
+
+  pthread_rwlock_wrlock(&stripe->lock);
+  DeviceTree **entry = &stripe->devices[name];
+  if (!*entry)
+    *entry = system_tree_root_->FindOrAddDevice(name);
+  device = *entry;
+  pthread_rwlock_unlock(&stripe->lock);
+  return device;
 }
 
 // Set platform specific handle and initialize device tree.
@@ -152,6 +195,25 @@ bool ErrorDiag::set_os(OsLayer *os) {
   return(InitializeDeviceTree());
 }
 
+void ErrorDiag::CollectErrors(DeviceErrorMap *errors) {
+  system_tree_root_->CollectErrors(errors);
+}
+
+// The restored errors keep their severity, so devices stay known bad, but
+// not their type or address.
+void ErrorDiag::RestoreErrors(const DeviceErrorMap &errors) {
+  for (DeviceErrorMap::const_iterator it = errors.begin();
+       it != errors.end(); ++it) {
+    DeviceTree *device = FindOrAddDevice(it->first);
+    for (int64 i = 0; i < it->second.fatal + it->second.correctable; i++) {
+      ErrorInstance *error = new ErrorInstance;
+      error->severity_ = i < it->second.fatal ? SAT_ERROR_FATAL :
+                                                SAT_ERROR_CORRECTABLE;
+      device->AddErrorInstance(error);
+    }
+  }
+}
+
 // Create and initialize system device tree.
 // Returns false on error. true otherwise.
 bool ErrorDiag::InitializeDeviceTree() {
@@ -164,7 +226,7 @@ bool ErrorDiag::InitializeDeviceTree() {
 // Logs info about a CECC.
 // Returns -1 on error, 1 if diagnoser reports error externally; 0 otherwise.
 int ErrorDiag::AddCeccError(string dimm_string) {
-  DeviceTree *dimm_device = system_tree_root_->FindOrAddDevice(dimm_string);
+  DeviceTree *dimm_device = FindOrAddDevice(dimm_string);
   ECCErrorInstance *error = new ECCErrorInstance;
   if (!error)
     return -1;
@@ -176,7 +238,7 @@ int ErrorDiag::AddCeccError(string dimm_string) {
 // Logs info about a UECC.
 // Returns -1 on error, 1 if diagnoser reports error externally; 0 otherwise.
 int ErrorDiag::AddUeccError(string dimm_string) {
-  DeviceTree *dimm_device = system_tree_root_->FindOrAddDevice(dimm_string);
+  DeviceTree *dimm_device = FindOrAddDevice(dimm_string);
   ECCErrorInstance *error = new ECCErrorInstance;
   if (!error)
     return -1;
@@ -188,7 +250,7 @@ int ErrorDiag::AddUeccError(string dimm_string) {
 // Logs info about a miscompare.
 // Returns -1 on error, 1 if diagnoser reports error externally; 0 otherwise.
 int ErrorDiag::AddMiscompareError(string dimm_string, uint64 addr, int count) {
-  DeviceTree *dimm_device = system_tree_root_->FindOrAddDevice(dimm_string);
+  DeviceTree *dimm_device = FindOrAddDevice(dimm_string);
   MiscompareErrorInstance *error = new MiscompareErrorInstance;
   if (!error)
     return -1;
@@ -230,7 +292,7 @@ int ErrorDiag::AddHDDMiscompareError(string devicename, int block, int offset,
   // DIMM name look up success
   if (src_dimm.compare("DIMM Unknown")) {
     // Add src DIMM as possible miscompare cause.
-    DeviceTree *src_dimm_dev = system_tree_root_->FindOrAddDevice(src_dimm);
+    DeviceTree *src_dimm_dev = FindOrAddDevice(src_dimm);
     error->causes_.insert(src_dimm_dev);
     if (src_dimm_dev->KnownBad()) {
       mask_hdd_error = true;
@@ -240,7 +302,7 @@ int ErrorDiag::AddHDDMiscompareError(string devicename, int block, int offset,
   }
   if (dst_dimm.compare("DIMM Unknown")) {
     // Add dst DIMM as possible miscompare cause.
-    DeviceTree *dst_dimm_dev = system_tree_root_->FindOrAddDevice(dst_dimm);
+    DeviceTree *dst_dimm_dev = FindOrAddDevice(dst_dimm);
     error->causes_.insert(dst_dimm_dev);
     if (dst_dimm_dev->KnownBad()) {
       mask_hdd_error = true;
@@ -250,13 +312,15 @@ int ErrorDiag::AddHDDMiscompareError(string devicename, int block, int offset,
     }
   }
 
-  DeviceTree *hdd_dev = system_tree_root_->FindOrAddDevice(devicename);
+  // HDD error was not masked by bad DIMMs: it counts against the HDD.
+  if (!mask_hdd_error)
+    error->severity_ = SAT_ERROR_FATAL;
+  DeviceTree *hdd_dev = FindOrAddDevice(devicename);
   hdd_dev->AddErrorInstance(error);
 
-  // HDD error was not masked by bad DIMMs: report bad HDD.
+  // Report bad HDD.
   if (!mask_hdd_error) {
     os_->ErrorReport(devicename.c_str(), "miscompare", 1);
-    error->severity_ = SAT_ERROR_FATAL;
     return 1;
   }
   return 0;
@@ -284,7 +348,7 @@ int ErrorDiag::AddHDDSectorTagError(string devicename, int block, int offset,
   // DIMM name look up success
   if (src_dimm.compare("DIMM Unknown")) {
     // Add src DIMM as possible miscompare cause.
-    DeviceTree *src_dimm_dev = system_tree_root_->FindOrAddDevice(src_dimm);
+    DeviceTree *src_dimm_dev = FindOrAddDevice(src_dimm);
     error->causes_.insert(src_dimm_dev);
     if (src_dimm_dev->KnownBad()) {
       mask_hdd_error = true;
@@ -294,7 +358,7 @@ int ErrorDiag::AddHDDSectorTagError(string devicename, int block, int offset,
   }
   if (dst_dimm.compare("DIMM Unknown")) {
     // Add dst DIMM as possible miscompare cause.
-    DeviceTree *dst_dimm_dev = system_tree_root_->FindOrAddDevice(dst_dimm);
+    DeviceTree *dst_dimm_dev = FindOrAddDevice(dst_dimm);
     error->causes_.insert(dst_dimm_dev);
     if (dst_dimm_dev->KnownBad()) {
       mask_hdd_error = true;
@@ -304,13 +368,15 @@ int ErrorDiag::AddHDDSectorTagError(string devicename, int block, int offset,
     }
   }
 
-  DeviceTree *hdd_dev = system_tree_root_->FindOrAddDevice(devicename);
+  // HDD error was not masked by bad DIMMs: it counts against the HDD.
+  if (!mask_hdd_error)
+    error->severity_ = SAT_ERROR_FATAL;
+  DeviceTree *hdd_dev = FindOrAddDevice(devicename);
   hdd_dev->AddErrorInstance(error);
 
-  // HDD error was not masked by bad DIMMs: report bad HDD.
+  // Report bad HDD.
   if (!mask_hdd_error) {
     os_->ErrorReport(devicename.c_str(), "sector", 1);
-    error->severity_ = SAT_ERROR_FATAL;
     return 1;
   }
   return 0;
@@ -30,6 +30,14 @@
 
 class ErrorInstance;
 
+// Errors recorded against one device, as saved in a checkpoint.
+struct DeviceErrors {
+  int64 correctable;
+  int64 fatal;
+};
+// Device name to its errors.
+typedef std::map<string, struct DeviceErrors> DeviceErrorMap;
+
 // This describes the components of the system.
 class DeviceTree {
  public:
@@ -46,19 +54,31 @@ class DeviceTree {
   DeviceTree *GetParent() { return parent_; }
   // Pretty prints device tree.
   void PrettyPrint(string spacer = " ");
-  // Atomically add error instance to device.
+  // Count an error against the device without locking, and keep it in the
+  // error log while that has room. Takes ownership of 'error_instance',
+  // which may be freed right away.
   void AddErrorInstance(ErrorInstance *error_instance);
   // Returns true of device is known to be bad.
-  bool KnownBad();
+  bool KnownBad() {
+    return __atomic_load_n(&fatal_, __ATOMIC_RELAXED) != 0;
+  }
+  // Add the error counts of this device and its sub devices to 'errors'.
+  void CollectErrors(DeviceErrorMap *errors);
   // Returns number of direct sub devices.
   int NumDirectSubDevices() { return subdevices_.size(); }
 
  private:
+  // Errors kept in errors_, later ones are only counted.
+  static const int64 kMaxLoggedErrors = 1024;
+
   // Unlocked version of FindInSubTree.
   DeviceTree *UnlockedFindInSubTree(string name);
 
   std::map<string, DeviceTree*> subdevices_;    // Map of sub-devices.
-  std::list<ErrorInstance*> errors_;            // Log of errors.
+  std::list<ErrorInstance*> errors_;            // Log of the first errors.
+  volatile int64 logged_;                       // Errors offered to errors_.
+  volatile int64 correctable_;                  // Correctable errors seen.
+  volatile int64 fatal_;                        // Fatal errors seen.
   DeviceTree *parent_;                          // Pointer to parent device.
   string name_;                                 // Device name.
   pthread_mutex_t device_tree_mutex_;           // Mutex protecting device tree.
@@ -150,6 +170,12 @@ class ErrorDiag {
   // Set platform specific handle and initialize device tree.
   bool set_os(OsLayer *os);
 
+  // Error counts of every device that has errors.
+  void CollectErrors(DeviceErrorMap *errors);
+  // Record the errors of an earlier run, as returned by CollectErrors(),
+  // without reporting them again.
+  void RestoreErrors(const DeviceErrorMap &errors);
+
  protected:
   // Create and initialize system device tree.
   virtual bool InitializeDeviceTree();
@@ -157,10 +183,25 @@ class ErrorDiag {
   // Utility Function to translate a virtual address to DIMM number.
   string AddressToDimmString(OsLayer *os, void *addr, int offset);
 
+  // Find or add the named device through the device index, which only
+  // touches the tree the first time a name is seen.
+  DeviceTree *FindOrAddDevice(const string &name);
+
   DeviceTree *system_tree_root_;  // System device tree.
   OsLayer *os_;                   // Platform handle.
 
  private:
+  static const int kIndexStripes = 16;
+
+  // Devices in the tree by name, spread over kIndexStripes stripes by a
+  // hash of the name so that errors on different devices don't share a
+  // lock, and lookups of the same device only take it for reading.
+  struct IndexStripe {
+    pthread_rwlock_t lock;
+    std::map<string, DeviceTree*> devices;
+  };
+  struct IndexStripe index_[kIndexStripes];
+
   DISALLOW_COPY_AND_ASSIGN(ErrorDiag);
 };
 
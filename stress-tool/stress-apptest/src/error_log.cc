@@ -0,0 +1,123 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Binary error log writer, see error_log.h.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "error_log.h"
+#include "logger.h"
+
+ErrorLog::ErrorLog() : fd_(-1), next_id_(1) {
+  pthread_mutex_init(&strings_lock_, NULL);
+}
+
+ErrorLog::~ErrorLog() {
+  Close();
+  pthread_mutex_destroy(&strings_lock_);
+}
+
+bool ErrorLog::Open(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0)
+    return false;
+
+  struct ErrorLogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kErrorLogMagic, sizeof(header.magic));
+  header.version = kErrorLogVersion;
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  header.start_time_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+  if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+    close(fd);
+    return false;
+  }
+
+  fd_ = fd;
+  Logger::GlobalLogger()->SetBinaryFd(fd_);
+  return true;
+}
+
+void ErrorLog::Close() {
+  if (fd_ < 0)
+    return;
+  Logger::GlobalLogger()->SetBinaryFd(-1);
+  close(fd_);
+  fd_ = -1;
+}
+
+uint16 ErrorLog::StringId(const char *text) {
+  if (!text || !text[0])
+    return 0;
+  map<string, uint16>::const_iterator it = strings_.find(text);
+  if (it != strings_.end())
+    return it->second;
+  // Out of ids, later strings are recorded as missing.
+  if (next_id_ == 0)
+    return 0;
+
+  char buffer[sizeof(struct ErrorLogString) + kErrorLogMaxString];
+  struct ErrorLogString *record =
+      reinterpret_cast<struct ErrorLogString*>(buffer);
+  size_t length = strlen(text);
+  if (length > static_cast<size_t>(kErrorLogMaxString))
+    length = kErrorLogMaxString;
+  record->header.type = kErrorLogString;
+  record->header.length = sizeof(*record) + length;
+  record->id = next_id_;
+  record->reserved = 0;
+  memcpy(buffer + sizeof(*record), text, length);
+  // If the definition was dropped, try again with the next record rather
+  // than refer to a string the decoder never sees.
+  if (!Logger::GlobalLogger()->LogBinary(buffer, record->header.length))
+    return 0;
+
+  strings_[text] = next_id_;
+  return next_id_++;
+}
+
+void ErrorLog::LogMiscompare(struct ErrorLogMiscompare *record,
+                             const char *message, const char *pattern,
+                             const char *dimm, const char *tag_dimm,
+                             const char *device) {
+  if (fd_ < 0)
+    return;
+
+  record->header.type = kErrorLogMiscompare;
+  record->header.length = sizeof(*record);
+  record->reserved = 0;
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  record->timestamp_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+
+  // Definitions are queued while holding the lock, so they are always
+  // ahead of any record that uses their id.
+  pthread_mutex_lock(&strings_lock_);
+  record->message_id = StringId(message);
+  record->pattern_id = StringId(pattern);
+  record->dimm_id = StringId(dimm);
+  record->tag_dimm_id = StringId(tag_dimm);
+  record->device_id = StringId(device);
+  pthread_mutex_unlock(&strings_lock_);
+
+  Logger::GlobalLogger()->LogBinary(record, sizeof(*record));
+}
@@ -0,0 +1,124 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Binary error log, an optional compact stream of miscompare records
+// written with --binary_error_log and rendered by errlog_decode.
+//
+// The file starts with an ErrorLogHeader, followed by records that each
+// start with an ErrorLogRecordHeader. Strings, such as pattern and DIMM
+// names, are sent once as an ErrorLogString record and referred to by id
+// from then on. All values are in host byte order.
+
+#ifndef STRESSAPPTEST_ERROR_LOG_H_
+#define STRESSAPPTEST_ERROR_LOG_H_
+
+#include <pthread.h>
+
+#include <map>
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+static const char kErrorLogMagic[8] = {'S', 'A', 'T', 'E', 'R', 'R', 'L', 'G'};
+static const uint32 kErrorLogVersion = 1;
+
+// Longest string stored in an ErrorLogString record.
+static const int kErrorLogMaxString = 255;
+
+// Record types.
+static const uint16 kErrorLogString = 1;
+static const uint16 kErrorLogMiscompare = 2;
+
+// Kinds of miscompare, matching the text log line they replace.
+static const uint16 kErrorKindMemory = 0;  // WorkerThread::ProcessError
+static const uint16 kErrorKindTag = 1;     // WorkerThread::ProcessTagError
+static const uint16 kErrorKindFile = 2;    // FileThread::ProcessError
+
+struct ErrorLogHeader {
+  char magic[8];
+  uint32 version;
+  uint32 reserved;
+  uint64 start_time_us;  // Wall clock time the log was opened.
+};
+
+struct ErrorLogRecordHeader {
+  uint16 type;
+  uint16 length;         // Whole record, including this header.
+};
+
+// Defines string 'id', the text follows without a terminating NUL.
+struct ErrorLogString {
+  struct ErrorLogRecordHeader header;
+  uint16 id;
+  uint16 reserved;
+};
+
+// One miscompare. String ids are 0 when there is no string.
+struct ErrorLogMiscompare {
+  struct ErrorLogRecordHeader header;
+  uint16 kind;
+  uint16 message_id;     // "Hardware Error" and the like.
+  uint16 pattern_id;
+  uint16 dimm_id;
+  uint16 tag_dimm_id;
+  uint16 device_id;      // File threads only.
+  int32 thread;
+  int32 cpu;             // CPU that found the error.
+  int32 lastcpu;         // CPU that probably wrote the data.
+  int32 reserved;
+  uint64 timestamp_us;   // Wall clock time.
+  uint64 vaddr;
+  uint64 paddr;
+  uint64 tagvaddr;       // Tag errors only.
+  uint64 tagpaddr;
+  uint64 expected;
+  uint64 actual;
+  uint64 reread;
+};
+
+// Writes records to the binary error log through the logging thread, so
+// worker threads only pay for filling in a record. Threadsafe.
+class ErrorLog {
+ public:
+  ErrorLog();
+  ~ErrorLog();
+
+  // Creates 'path' and writes the file header. Returns false on failure.
+  bool Open(const char *path);
+  void Close();
+  bool enabled() const { return fd_ >= 0; }
+
+  // Queues a miscompare. The id fields of 'record' are filled in from
+  // the strings, any of which may be NULL.
+  void LogMiscompare(struct ErrorLogMiscompare *record,
+                     const char *message, const char *pattern,
+                     const char *dimm, const char *tag_dimm,
+                     const char *device);
+
+ private:
+  // Returns the id of 'text', sending its definition first if it's new.
+  // Must be called with strings_lock_ held.
+  uint16 StringId(const char *text);
+
+  int fd_;
+  pthread_mutex_t strings_lock_;
+  map<string, uint16> strings_;
+  uint16 next_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(ErrorLog);
+};
+
+#endif  // STRESSAPPTEST_ERROR_LOG_H_
@@ -19,6 +19,7 @@
 // so these includes are correct.
 #include "finelock_queue.h"
 #include "os.h"
+#include "prng.h"
 
 // Page entry queue implementation follows.
 // Push and Get functions are analogous to lock and unlock operations on a given
@@ -35,14 +36,20 @@
 
 // Constructor: Allocates memory and initialize locks.
 FineLockPEQueue::FineLockPEQueue(
-                 uint64 queuesize, int64 pagesize) {
+                 uint64 queuesize, int64 pagesize)
+    : pages_(queuesize, pagesize) {
   q_size_ = queuesize;
-  pages_ = new struct page_entry[q_size_];
   pagelocks_ = new pthread_mutex_t[q_size_];
   page_size_ = pagesize;
 
   // What metric should we measure this run.
   queue_metric_ = kTouch;
+  oldest_first_ = false;
+  channel_schedule_ = kChannelRandom;
+  channels_ = 0;
+  active_channel_ = 0;
+  next_channel_[0] = 0;
+  next_channel_[1] = 0;
 
   {  // Init all the page locks.
     for (uint64 i = 0; i < q_size_; i++) {
@@ -56,13 +63,6 @@ FineLockPEQueue::FineLockPEQueue(
     }
   }
 
-  {  // Init the random number generator.
-    for (int i = 0; i < 4; i++) {
-      rand_seed_[i] = i + 0xbeef;
-      pthread_mutex_init(&(randlocks_[i]), NULL);
-    }
-  }
-
   // Try to make a linear congruential generator with our queue size.
   // We need this to deterministically search all the queue (being able to find
   // a single available element is a design requirement), but we don't want to
@@ -151,10 +151,6 @@ FineLockPEQueue::~FineLockPEQueue() {
   for (i = 0; i < q_size_; i++)
     pthread_mutex_destroy(&(pagelocks_[i]));
   delete[] pagelocks_;
-  delete[] pages_;
-  for (i = 0; i < 4; i++) {
-    pthread_mutex_destroy(&(randlocks_[i]));
-  }
 }
 
 
@@ -174,7 +170,7 @@ bool FineLockPEQueue::QueueAnalysis() {
 
   // Bucketize the page counts by highest bit set.
   for (uint64 i = 0; i < q_size_; i++) {
-    uint32 readcount = pages_[i].touch;
+    uint32 readcount = pages_.touch(i);
     int b = 0;
     for (b = 0; b < 31; b++) {
       if (readcount < (1u << b))
@@ -269,53 +265,64 @@ bool FineLockPEQueue::ErrorLogCallback(uint64 paddr, string *message) {
 
 bool FineLockPEQueue::GetPageFromPhysical(uint64 paddr,
                                           struct page_entry *pe) {
+  // The reverse pagemap index finds the page directly.
+  if (g_os) {
+    int64 offset = g_os->FindTestMemOffset(paddr);
+    if (offset >= 0 && valid_index(offset / page_size_)) {
+      pages_.Load(offset / page_size_, pe);
+      return true;
+    }
+  }
+
   // Traverse through array until finding a page
   // that contains the address we want..
   for (uint64 i = 0; i < q_size_; i++) {
-    uint64 page_addr = pages_[i].paddr;
+    uint64 page_addr = pages_.paddr(i);
     // This assumes linear vaddr.
     if ((page_addr <= paddr) && (page_addr + page_size_ > paddr)) {
-      *pe = pages_[i];
+      pages_.Load(i, pe);
       return true;
     }
   }
   return false;
 }
 
-
-// Get a random number from the slot we locked.
-uint64 FineLockPEQueue::GetRandom64FromSlot(int slot) {
-  // 64 bit LCG numbers suggested on the internets by
-  // http://nuclear.llnl.gov/CNP/rng/rngman/node4.html and others.
-  uint64 result = 2862933555777941757ULL * rand_seed_[slot] + 3037000493ULL;
-  rand_seed_[slot] = result;
-  return result;
+void FineLockPEQueue::SetChannels(int channels) {
+  channels_ = channels;
+  page_channels_.assign(q_size_, kMixedChannel);
+  channel_pages_.assign(2 * channels, 0);
 }
 
-// Get a random number, we have 4 generators to choose from so hopefully we
-// won't be blocking on this.
-uint64 FineLockPEQueue::GetRandom64() {
-  // Try each available slot.
-  for (int i = 0; i < 4; i++) {
-    if (pthread_mutex_trylock(&(randlocks_[i])) == 0) {
-      uint64 result = GetRandom64FromSlot(i);
-      pthread_mutex_unlock(&(randlocks_[i]));
-      return result;
-    }
-  }
-  // Forget it, just wait.
-  int i = 0;
-  if (pthread_mutex_lock(&(randlocks_[i])) == 0) {
-    uint64 result = GetRandom64FromSlot(i);
-    pthread_mutex_unlock(&(randlocks_[i]));
-    return result;
-  }
+void FineLockPEQueue::SetPageChannel(uint64 offset, uint8 channel) {
+  uint64 index = offset / page_size_;
+  if (index < page_channels_.size())
+    page_channels_[index] = channel;
+}
 
-  logprintf(0, "Process Error: Could not acquire random lock.\n");
-  sat_assert(0);
-  return 0;
+void FineLockPEQueue::ChannelTraffic(int channel, uint64 *valid,
+                                     uint64 *empty) const {
+  *valid = 0;
+  *empty = 0;
+  if (channel < 0 || channel >= channels_)
+    return;
+  *empty = __atomic_load_n(&channel_pages_[2 * channel], __ATOMIC_RELAXED);
+  *valid = __atomic_load_n(&channel_pages_[2 * channel + 1],
+                           __ATOMIC_RELAXED);
 }
 
+// Valid and empty pages take separate turns, so that a copy takes both
+// from the same channel and leaves each channel's share of them alone.
+int FineLockPEQueue::NextChannel(bool valid) {
+  switch (channel_schedule_) {
+    case kChannelSweep:
+      return __atomic_load_n(&active_channel_, __ATOMIC_RELAXED);
+    case kChannelEven:
+      return __atomic_fetch_add(&next_channel_[valid], 1, __ATOMIC_RELAXED) %
+             channels_;
+    default:
+      return -1;
+  }
+}
 
 // Helper function to get a random page entry with given predicate,
 // ie, page_is_valid() or page_is_empty() as defined in finelock_queue.h.
@@ -323,19 +330,40 @@ uint64 FineLockPEQueue::GetRandom64() {
 // Setting tag to a value other than kDontCareTag (-1)
 // indicates that we need a tag match, otherwise any tag will do.
 //
+// With a channel schedule, pages of the scheduled channel are looked for
+// first, then any page, so that workers never stall on a busy channel.
+//
 // Returns true on success, false on failure.
 bool FineLockPEQueue::GetRandomWithPredicateTag(struct page_entry *pe,
-                      bool (*pred_func)(struct page_entry*),
+                      bool (*pred_func)(const PageTable&, PageHandle),
                       int32 tag) {
   if (!pe || !q_size_)
     return false;
 
+  int channel = NextChannel(pred_func == page_is_valid);
+  uint64 tries = q_size_ < kChannelTries ? q_size_ : kChannelTries;
+  if (channel >= 0 && FindPage(pe, pred_func, tag, channel, tries))
+    return true;
+  return FindPage(pe, pred_func, tag, -1, q_size_);
+}
+
+bool FineLockPEQueue::FindPage(struct page_entry *pe,
+                               bool (*pred_func)(const PageTable&,
+                                                 PageHandle),
+                               int32 tag, int channel, uint64 tries) {
   // Randomly index into page entry array.
-  uint64 first_try = GetRandom64() % q_size_;
+  uint64 first_try = Prng::ThreadPrng()->Below(q_size_);
   uint64 next_try = 1;
 
+  // In oldest first mode, pick the least recently read of the next few
+  // matching pages on the path. Timestamps are compared without locks, a
+  // stale one only makes for a worse pick.
+  bool oldest = oldest_first_ && pred_func == page_is_valid;
+  int64 best = -1;
+  int candidates = 0;
+
   // Traverse through array until finding a page meeting given predicate.
-  for (uint64 i = 0; i < q_size_; i++) {
+  for (uint64 i = 0; i < tries; i++) {
     uint64 index = (next_try + first_try) % q_size_;
     // Go through the loop linear conguentially. We are offsetting by
     // 'first_try' so this path will be a different sequence for every
@@ -348,44 +376,88 @@ bool FineLockPEQueue::GetRandomWithPredicateTag(struct page_entry *pe,
     }
 
     // If page does not meet predicate, don't trylock (expensive).
-    if (!(pred_func)(&pages_[index]))
+    if (!(pred_func)(pages_, index))
       continue;
 
     // If page does not meet tag predicate, don't trylock (expensive).
-    if ((tag != kDontCareTag) && !(pages_[index].tag & tag))
+    if ((tag != kDontCareTag) && !(pages_.tag(index) & tag))
       continue;
 
-    if (pthread_mutex_trylock(&(pagelocks_[index])) == 0) {
-      // If page property (valid/empty) changes before successfully locking,
-      // release page and move on.
-      if (!(pred_func)(&pages_[index])) {
-        pthread_mutex_unlock(&(pagelocks_[index]));
+    if (channel >= 0 && page_channels_[index] != channel)
+      continue;
+
+    if (oldest) {
+      if (best < 0 || pages_.timestamp(index) < pages_.timestamp(best))
+        best = index;
+      if (++candidates < kOldestCandidates)
         continue;
-      } else {
-        // A page entry with given predicate is locked, returns success.
-        *pe = pages_[index];
-
-        // Add metrics as necessary.
-        if (pred_func == page_is_valid) {
-          // Measure time to fetch valid page.
-          if (queue_metric_ == kTries)
-            pe->touch = i;
-          // Measure number of times each page is read.
-          if (queue_metric_ == kTouch)
-            pe->touch++;
-        }
-
-        return true;
-      }
+      index = best;
+      best = -1;
+      candidates = 0;
     }
+
+    if (TakePage(index, pred_func, i, pe))
+      return true;
   }
 
+  // The path ran out before a full set of candidates.
+  if (best >= 0 && TakePage(best, pred_func, q_size_, pe))
+    return true;
   return false;
 }
 
+bool FineLockPEQueue::TakePage(uint64 index,
+                               bool (*pred_func)(const PageTable&, PageHandle),
+                               uint64 tries, struct page_entry *pe) {
+  if (pthread_mutex_trylock(&(pagelocks_[index])) != 0)
+    return false;
+  // If page property (valid/empty) changes before successfully locking,
+  // release page and move on.
+  if (!(pred_func)(pages_, index)) {
+    pthread_mutex_unlock(&(pagelocks_[index]));
+    return false;
+  }
+  // A page entry with given predicate is locked, returns success.
+  pages_.Load(index, pe);
+  CountChannel(index, pred_func == page_is_valid);
+
+  // Add metrics as necessary.
+  if (pred_func == page_is_valid) {
+    // Measure time to fetch valid page.
+    if (queue_metric_ == kTries)
+      pe->touch = tries;
+    // Measure number of times each page is read.
+    if (queue_metric_ == kTouch)
+      pe->touch++;
+  }
+  return true;
+}
+
+bool FineLockPEQueue::ClaimPage(int64 index, bool valid, int32 tag,
+                                struct page_entry *pe) {
+  if (!pe || !valid_index(index))
+    return false;
+  if (pages_.is_valid(index) != valid)
+    return false;
+  if ((tag != kDontCareTag) && !(pages_.tag(index) & tag))
+    return false;
+  if (pthread_mutex_trylock(&(pagelocks_[index])) != 0)
+    return false;
+  // The page may have changed before we locked it.
+  if (pages_.is_valid(index) != valid) {
+    pthread_mutex_unlock(&(pagelocks_[index]));
+    return false;
+  }
+  pages_.Load(index, pe);
+  CountChannel(index, valid);
+  if (valid && queue_metric_ == kTouch)
+    pe->touch++;
+  return true;
+}
+
 // Without tag hint.
 bool FineLockPEQueue::GetRandomWithPredicate(struct page_entry *pe,
-                      bool (*pred_func)(struct page_entry*)) {
+                      bool (*pred_func)(const PageTable&, PageHandle)) {
   return GetRandomWithPredicateTag(pe, pred_func, kDontCareTag);
 }
 
@@ -425,9 +497,8 @@ bool FineLockPEQueue::PutEmpty(struct page_entry *pe) {
   if (!valid_index(index))
     return false;
 
-  pages_[index] = *pe;
   // Enforce that page entry is indeed empty.
-  pages_[index].pattern = 0;
+  pages_.Store(index, pe, false);
   return (pthread_mutex_unlock(&(pagelocks_[index])) == 0);
 }
 
@@ -436,13 +507,13 @@ bool FineLockPEQueue::PutEmpty(struct page_entry *pe) {
 //
 // Returns true on success, false on failure.
 bool FineLockPEQueue::PutValid(struct page_entry *pe) {
-  if (!pe || !page_is_valid(pe) || !q_size_)
+  if (!pe || !pe->pattern || !q_size_)
     return false;
 
   int64 index = pe->offset / page_size_;
   if (!valid_index(index))
     return false;
 
-  pages_[index] = *pe;
+  pages_.Store(index, pe, true);
   return (pthread_mutex_unlock(&(pagelocks_[index])) == 0);
 }
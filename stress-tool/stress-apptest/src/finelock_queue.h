@@ -20,10 +20,12 @@
 #define STRESSAPPTEST_FINELOCK_QUEUE_H_
 
 #include <string>
+#include <vector>
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
 #include "sattypes.h"
+#include "page_table.h"
 #include "pattern.h"
 #include "queue.h"     // Using page_entry struct.
 #include "os.h"
@@ -45,6 +47,40 @@ class FineLockPEQueue {
   bool GetEmpty(struct page_entry *pe, int32 tag);
   bool GetValid(struct page_entry *pe, int32 tag);
 
+  // Get the page at 'index' if it is available and valid (or empty) with a
+  // matching tag, for building spans of consecutive pages.
+  bool ClaimPage(int64 index, bool valid, int32 tag, struct page_entry *pe);
+
+  // Hand out the least recently read of several valid pages instead of
+  // the first one found, so that every page gets checked in turn.
+  void set_oldest_first(bool oldest_first) { oldest_first_ = oldest_first; }
+
+  // How pages are chosen by the DRAM channel they are in.
+  enum ChannelSchedule {
+    kChannelRandom = 0,   // Any channel, the default.
+    kChannelSweep = 1,    // Only the active channel, to load it alone.
+    kChannelEven = 2,     // Each channel in turn, to load all alike.
+  };
+  // Channel of pages that span several channels, which are only handed
+  // out when no page of the wanted channel is free.
+  static const uint8 kMixedChannel = 0xff;
+
+  // Track pages over 'channels' channels, then give each page's channel
+  // with SetPageChannel() and pick the schedule once they are all set.
+  void SetChannels(int channels);
+  void SetPageChannel(uint64 offset, uint8 channel);
+  void set_channel_schedule(int schedule) { channel_schedule_ = schedule; }
+  // The channel kChannelSweep hands out pages of.
+  void set_active_channel(int channel) {
+    __atomic_store_n(&active_channel_, channel, __ATOMIC_RELAXED);
+  }
+  // Pages of 'channel' handed out since ResetChannelTraffic(), valid and
+  // empty.
+  void ChannelTraffic(int channel, uint64 *valid, uint64 *empty) const;
+  void ResetChannelTraffic() {
+    channel_pages_.assign(channel_pages_.size(), 0);
+  }
+
   bool QueueAnalysis();
   bool GetPageFromPhysical(uint64 paddr, struct page_entry *pe);
   void set_os(OsLayer *os);
@@ -52,33 +88,56 @@ class FineLockPEQueue {
   bool ErrorLogCallback(uint64 paddr, string *buf);
 
  private:
-  // Not that much blocking random number generator.
-  uint64 GetRandom64();
-  uint64 GetRandom64FromSlot(int slot);
-
   // Helper function to check index range, returns true if index is valid.
   bool valid_index(int64 index) {
     return index >= 0 && static_cast<uint64>(index) < q_size_;
   }
 
   // Returns true if page entry is valid, false otherwise.
-  static bool page_is_valid(struct page_entry *pe) {
-    return pe->pattern != NULL;
+  static bool page_is_valid(const PageTable &pages, PageHandle page) {
+    return pages.is_valid(page);
   }
   // Returns true if page entry is empty, false otherwise.
-  static bool page_is_empty(struct page_entry *pe) {
-    return pe->pattern == NULL;
+  static bool page_is_empty(const PageTable &pages, PageHandle page) {
+    return !pages.is_valid(page);
   }
 
+  // Valid pages compared in oldest first mode.
+  static const int kOldestCandidates = 8;
+  // Pages looked at for one in the scheduled channel before taking any.
+  static const uint64 kChannelTries = 1024;
+
+  // Lock page 'index' if it still meets 'pred_func' and load it into 'pe'.
+  // 'tries' is the number of pages looked at to find it.
+  bool TakePage(uint64 index, bool (*pred_func)(const PageTable&, PageHandle),
+                uint64 tries, struct page_entry *pe);
+
   // Helper function to get a random page entry with given predicate,
   // ie, page_is_valid() or page_is_empty() as defined above.
   bool GetRandomWithPredicate(struct page_entry *pe,
-                              bool (*pred_func)(struct page_entry*));
+                              bool (*pred_func)(const PageTable&,
+                                                PageHandle));
+
+  // Channel the next valid or empty page should come from, or -1 for any.
+  int NextChannel(bool valid);
+  // Count page 'index' as handed out.
+  void CountChannel(uint64 index, bool valid) {
+    if (!page_channels_.empty() && page_channels_[index] != kMixedChannel)
+      __atomic_fetch_add(&channel_pages_[2 * page_channels_[index] + valid],
+                         1, __ATOMIC_RELAXED);
+  }
+
+  // Random page meeting the predicates below, in 'channel' unless that
+  // is -1, looking at no more than 'tries' pages.
+  bool FindPage(struct page_entry *pe,
+                bool (*pred_func)(const PageTable&, PageHandle),
+                int32 tag, int channel, uint64 tries);
 
   // Helper function to get a random page entry with given predicate,
   // ie, page_is_valid() or page_is_empty() as defined above.
   bool GetRandomWithPredicateTag(struct page_entry *pe,
-                                 bool (*pred_func)(struct page_entry*),
+                                 bool (*pred_func)(const PageTable&,
+                                                   PageHandle),
                                  int32 tag);
 
   // Used to make a linear congruential path through the queue.
@@ -86,9 +145,16 @@ class FineLockPEQueue {
   int64 getC(int64 m);
 
   pthread_mutex_t *pagelocks_;  // Per-page-entry locks.
-  struct page_entry *pages_;     // Where page entries are held.
+  PageTable pages_;              // Where page entries are held.
   uint64 q_size_;                // Size of the queue.
   int64 page_size_;              // For calculating array index from offset.
+  bool oldest_first_;            // See set_oldest_first().
+  int channel_schedule_;         // ChannelSchedule of the pages.
+  int channels_;                 // Channels scheduled over.
+  int active_channel_;           // Channel of kChannelSweep.
+  uint32 next_channel_[2];       // Turns of kChannelEven, empty and valid.
+  vector<uint8> page_channels_;  // Channel of each page.
+  vector<uint64> channel_pages_;  // Empty and valid pages handed out.
 
   enum {
     kTries = 1,     // Measure the number of attempts in the queue
@@ -109,9 +175,6 @@ class FineLockPEQueue {
                                  // generate a good progression through the
                                  // list.
 
-  uint64 rand_seed_[4];          // Random number state for 4 generators.
-  pthread_mutex_t randlocks_[4];  // Per-random-generator locks.
-
   DISALLOW_COPY_AND_ASSIGN(FineLockPEQueue);
 };
 
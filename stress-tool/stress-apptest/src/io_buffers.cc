@@ -0,0 +1,79 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "io_buffers.h"
+
+#include <sys/mman.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "os.h"
+#include "sattypes.h"
+
+namespace {
+// Bytes mapped at a time, unless one buffer needs more.
+const int64 kChunkSize = 2 * kMegabyte;
+}  // namespace
+
+IoBufferPool::IoBufferPool() : os_(NULL), size_(0) {
+  sat_assert(!pthread_mutex_init(&lock_, NULL));
+}
+
+IoBufferPool::~IoBufferPool() {
+  for (size_t i = 0; i < mappings_.size(); i++)
+    munmap(mappings_[i], mapping_lengths_[i]);
+  pthread_mutex_destroy(&lock_);
+}
+
+void IoBufferPool::Initialize(OsLayer *os, int64 size) {
+  os_ = os;
+  size_ = (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+bool IoBufferPool::Grow() {
+  int64 count = kChunkSize / size_;
+  if (count < 1)
+    count = 1;
+  int64 mapped = 0;
+  char *chunk = static_cast<char*>(
+      os_->AllocatePinnedMem(count * size_, -1, &mapped));
+  if (!chunk)
+    return false;
+  mappings_.push_back(chunk);
+  mapping_lengths_.push_back(mapped);
+  // Use all of the mapping, it's rounded up to whole hugepages.
+  for (int64 offset = 0; offset + size_ <= mapped; offset += size_)
+    free_.push_back(chunk + offset);
+  return true;
+}
+
+void *IoBufferPool::Get() {
+  sat_assert(os_);
+  void *buffer = NULL;
+  pthread_mutex_lock(&lock_);
+  if (!free_.empty() || Grow()) {
+    buffer = free_.back();
+    free_.pop_back();
+  }
+  pthread_mutex_unlock(&lock_);
+  return buffer;
+}
+
+void IoBufferPool::Put(void *buffer) {
+  if (!buffer)
+    return;
+  pthread_mutex_lock(&lock_);
+  free_.push_back(buffer);
+  pthread_mutex_unlock(&lock_);
+}
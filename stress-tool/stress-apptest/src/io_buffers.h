@@ -0,0 +1,67 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Pool of page sized I/O buffers shared by the file and disk threads.
+
+#ifndef STRESSAPPTEST_IO_BUFFERS_H_
+#define STRESSAPPTEST_IO_BUFFERS_H_
+
+#include <pthread.h>
+
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+class OsLayer;
+
+// Buffers for direct and registered I/O, carved out of pinned, hugepage
+// backed mappings from OsLayer::AllocatePinnedMem(). Every buffer is
+// aligned to kAlignment, which covers the logical block size of any
+// device, and the mappings grow a hugepage or so at a time as threads ask
+// for more, so no thread allocates its own.
+class IoBufferPool {
+ public:
+  static const int64 kAlignment = 4096;
+
+  IoBufferPool();
+  ~IoBufferPool();
+
+  // Hand out buffers of 'size' bytes.
+  void Initialize(OsLayer *os, int64 size);
+
+  // Returns a buffer, or NULL if no more memory could be mapped.
+  void *Get();
+  // Return a buffer from Get(). Buffers that the kernel may still write
+  // into, like those of abandoned async requests, must not be returned.
+  void Put(void *buffer);
+
+  int64 size() const { return size_; }
+
+ private:
+  // Map another chunk of buffers onto free_. Call with lock_ held.
+  bool Grow();
+
+  OsLayer *os_;
+  int64 size_;                      // Bytes per buffer, rounded up.
+  pthread_mutex_t lock_;            // Guards the vectors.
+  vector<void*> free_;              // Buffers ready to hand out.
+  vector<void*> mappings_;          // Chunks to unmap.
+  vector<int64> mapping_lengths_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoBufferPool);
+};
+
+#endif  // STRESSAPPTEST_IO_BUFFERS_H_
@@ -0,0 +1,108 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Log-linear latency histogram, see latency_histogram.h.
+
+#include <stdio.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+void LatencyHistogram::Reset() {
+  for (int i = 0; i < kBuckets; i++)
+    counts_[i] = 0;
+  count_ = 0;
+  max_ = 0;
+}
+
+int LatencyHistogram::Bucket(uint64 value) {
+  if (value < static_cast<uint64>(kSubBuckets))
+    return value;
+  int msb = 63 - __builtin_clzll(value);
+  if (msb >= kMaxBits)
+    return kBuckets - 1;
+  // Values in [2^msb, 2^(msb+1)) land in group msb - kSubBucketBits + 1,
+  // each of its buckets 2^(msb - kSubBucketBits) wide.
+  int shift = msb - kSubBucketBits;
+  int group = shift + 1;
+  return group * kSubBuckets + (value >> shift) - kSubBuckets;
+}
+
+uint64 LatencyHistogram::BucketHigh(int index) {
+  int group = index / kSubBuckets;
+  uint64 sub = index % kSubBuckets;
+  if (group == 0)
+    return sub;
+  int shift = group - 1;
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64 usec) {
+  if (usec < 0)
+    usec = 0;
+  __sync_fetch_and_add(&counts_[Bucket(usec)], 1);
+  __sync_fetch_and_add(&count_, 1);
+  int64 max = max_;
+  while (usec > max) {
+    int64 seen = __sync_val_compare_and_swap(&max_, max, usec);
+    if (seen == max)
+      break;
+    max = seen;
+  }
+}
+
+void LatencyHistogram::Add(const LatencyHistogram &other) {
+  for (int i = 0; i < kBuckets; i++) {
+    if (other.counts_[i])
+      __sync_fetch_and_add(&counts_[i], other.counts_[i]);
+  }
+  __sync_fetch_and_add(&count_, other.count_);
+  if (other.max_ > max_)
+    max_ = other.max_;
+}
+
+int64 LatencyHistogram::Percentile(double fraction) const {
+  // Sum the buckets rather than trust count_, which a racing Record() may
+  // have updated separately.
+  uint64 total = 0;
+  for (int i = 0; i < kBuckets; i++)
+    total += counts_[i];
+  if (!total)
+    return 0;
+
+  uint64 target = static_cast<uint64>(fraction * total + 0.5);
+  if (target < 1)
+    target = 1;
+  uint64 seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= target) {
+      int64 high = BucketHigh(i);
+      return high < max_ ? high : max_;
+    }
+  }
+  return max_;
+}
+
+string LatencyHistogram::Summary() const {
+  char buf[128];
+  snprintf(buf, sizeof(buf), "p50 %lldus p99 %lldus p99.9 %lldus max %lldus",
+           Percentile(0.5), Percentile(0.99), Percentile(0.999), max());
+  return buf;
+}
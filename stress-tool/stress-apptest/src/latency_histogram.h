@@ -0,0 +1,73 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Fixed size log-linear latency histogram, in the style of HdrHistogram,
+// cheap enough to record every I/O into.
+
+#ifndef STRESSAPPTEST_LATENCY_HISTOGRAM_H_
+#define STRESSAPPTEST_LATENCY_HISTOGRAM_H_
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// Counts of latencies in microseconds. Values under kSubBuckets are kept
+// exactly, above that each power of two is split into kSubBuckets linear
+// buckets, so percentiles are within about 3% of the true value from a
+// microsecond up to kMaxBits worth of microseconds.
+//
+// Record() is lock-free and may race with readers on other threads, which
+// then see a slightly stale but consistent enough snapshot.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  // Count one latency of 'usec' microseconds.
+  void Record(int64 usec);
+  // Add the counts of 'other' to this histogram.
+  void Add(const LatencyHistogram &other);
+  // Forget all counts.
+  void Reset();
+
+  // Number of latencies recorded.
+  uint64 count() const { return count_; }
+  // Largest latency recorded.
+  int64 max() const { return max_; }
+  // Returns the latency, in microseconds, which 'fraction' of the recorded
+  // ones did not exceed. 0 if nothing was recorded.
+  int64 Percentile(double fraction) const;
+  // Returns "p50 Xus p99 Xus p99.9 Xus max Xus".
+  string Summary() const;
+
+ private:
+  static const int kSubBucketBits = 5;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxBits = 40;             // Larger values are clamped.
+  static const int kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  // Returns the bucket counting 'value'.
+  static int Bucket(uint64 value);
+  // Returns the largest value counted by bucket 'index'.
+  static uint64 BucketHigh(int index);
+
+  volatile uint64 counts_[kBuckets];
+  volatile uint64 count_;
+  volatile int64 max_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+#endif  // STRESSAPPTEST_LATENCY_HISTOGRAM_H_
@@ -14,11 +14,14 @@
 
 #include "logger.h"
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include <string>
 #include <vector>
@@ -33,31 +36,135 @@ Logger *Logger::GlobalLogger() {
   return &logger;
 }
 
-void Logger::VLogF(int priority, const char *format, va_list args) {
-  if (priority > verbosity_) {
-    return;
-  }
-  char buffer[4096];
+size_t Logger::FormatLine(char *buffer, const char *format, va_list args) {
   size_t length = 0;
   if (log_timestamps_) {
     time_t raw_time;
     time(&raw_time);
     struct tm time_struct;
     localtime_r(&raw_time, &time_struct);
-    length = strftime(buffer, sizeof(buffer), "%Y/%m/%d-%H:%M:%S(%Z) ",
+    length = strftime(buffer, kLogLineSize, "%Y/%m/%d-%H:%M:%S(%Z) ",
                       &time_struct);
     LOGGER_ASSERT(length);  // Catch if the buffer is set too small.
   }
-  length += vsnprintf(buffer + length, sizeof(buffer) - length, format, args);
-  if (length >= sizeof(buffer)) {
-    length = sizeof(buffer);
-    buffer[sizeof(buffer) - 1] = '\n';
+  length += vsnprintf(buffer + length, kLogLineSize - length, format, args);
+  if (length >= kLogLineSize) {
+    length = kLogLineSize;
+    buffer[kLogLineSize - 1] = '\n';
+  }
+  return length;
+}
+
+size_t Logger::FormatLineF(char *buffer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t length = FormatLine(buffer, format, args);
+  va_end(args);
+  return length;
+}
+
+void Logger::VLogF(int priority, const char *format, va_list args) {
+  if (priority > verbosity_) {
+    return;
+  }
+
+  if (!thread_running_) {
+    char buffer[kLogLineSize];
+    size_t length = FormatLine(buffer, format, args);
+    LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
+    WriteLogLine(buffer, length);
+    LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
+    return;
+  }
+
+  // Producers format their line in place once they own a record.
+  uint64 pos;
+  struct LogRecord *record = ClaimRecord(&pos);
+  if (!record)
+    return;
+  record->length = FormatLine(record->text, format, args);
+  record->binary = false;
+  PublishRecord(record, pos);
+}
+
+bool Logger::LogBinary(const void *data, size_t length) {
+  LOGGER_ASSERT(length <= kLogLineSize);
+  if (binary_fd_ < 0) {
+    return false;
+  }
+
+  if (!thread_running_) {
+    LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
+    ssize_t bytes_written = write(binary_fd_, data, length);
+    LOGGER_ASSERT(bytes_written == static_cast<ssize_t>(length));
+    LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
+    return true;
   }
-  QueueLogLine(new string(buffer, length));
+
+  uint64 pos;
+  struct LogRecord *record = ClaimRecord(&pos);
+  if (!record)
+    return false;
+  memcpy(record->text, data, length);
+  record->length = length;
+  record->binary = true;
+  PublishRecord(record, pos);
+  return true;
+}
+
+struct Logger::LogRecord *Logger::ClaimRecord(uint64 *pos_out) {
+  // Producers only contend on push_pos_.
+  uint64 pos = push_pos_;
+  while (true) {
+    struct LogRecord *record = &ring_[pos & (kLogRingSize - 1)];
+    int64 diff = static_cast<int64>(record->seq - pos);
+    if (diff == 0) {
+      if (__sync_bool_compare_and_swap(&push_pos_, pos, pos + 1)) {
+        *pos_out = pos;
+        return record;
+      }
+      pos = push_pos_;
+    } else if (diff < 0) {
+      // The logging thread is a full ring behind, drop the line rather
+      // than stall the caller.
+      __sync_fetch_and_add(&dropped_lines_, 1);
+      return NULL;
+    } else {
+      pos = push_pos_;
+    }
+  }
+}
+
+void Logger::PublishRecord(struct LogRecord *record, uint64 pos) {
+  __sync_synchronize();
+  record->seq = pos + 1;
+  // Pairs with the barrier in ThreadMain(), so that either we see the
+  // logging thread waiting or it sees this record.
+  __sync_synchronize();
+  if (thread_waiting_)
+    WakeThread();
+}
+
+void Logger::WakeThread() {
+  LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
+  LOGGER_ASSERT(0 == pthread_cond_signal(&queued_lines_cond_));
+  LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
 }
 
 void Logger::StartThread() {
   LOGGER_ASSERT(!thread_running_);
+  if (!ring_) {
+    ring_ = new struct LogRecord[kLogRingSize];
+  }
+  for (size_t i = 0; i < kLogRingSize; i++) {
+    ring_[i].seq = i;
+    ring_[i].length = 0;
+    ring_[i].binary = false;
+  }
+  push_pos_ = 0;
+  pop_pos_ = 0;
+  stop_requested_ = false;
+  thread_waiting_ = false;
   thread_running_ = true;
   LOGGER_ASSERT(0 == pthread_create(&thread_, NULL, &StartRoutine, this));
 }
@@ -67,65 +174,90 @@ void Logger::StopThread() {
   if (!thread_running_) {
     return;
   }
-  thread_running_ = false;
-  int retval = pthread_mutex_lock(&queued_lines_mutex_);
-  LOGGER_ASSERT(0 == retval);
-  bool need_cond_signal = queued_lines_.empty();
-  queued_lines_.push_back(NULL);
-  retval = pthread_mutex_unlock(&queued_lines_mutex_);
-  LOGGER_ASSERT(0 == retval);
-  if (need_cond_signal) {
-    retval = pthread_cond_signal(&queued_lines_cond_);
-    LOGGER_ASSERT(0 == retval);
-  }
-  retval = pthread_join(thread_, NULL);
+  stop_requested_ = true;
+  __sync_synchronize();
+  WakeThread();
+  int retval = pthread_join(thread_, NULL);
   LOGGER_ASSERT(0 == retval);
+  thread_running_ = false;
 }
 
 Logger::Logger()
     : verbosity_(20),
       log_fd_(-1),
+      binary_fd_(-1),
       thread_running_(false),
-      log_timestamps_(true) {
+      log_timestamps_(true),
+      stdout_enabled_(true),
+      line_handler_(NULL),
+      line_handler_arg_(NULL),
+      ring_(NULL),
+      push_pos_(0),
+      pop_pos_(0),
+      dropped_lines_(0),
+      reported_drops_(0),
+      stop_requested_(false),
+      thread_waiting_(false) {
   LOGGER_ASSERT(0 == pthread_mutex_init(&queued_lines_mutex_, NULL));
   LOGGER_ASSERT(0 == pthread_cond_init(&queued_lines_cond_, NULL));
-  LOGGER_ASSERT(0 == pthread_cond_init(&full_queue_cond_, NULL));
 }
 
 Logger::~Logger() {
   LOGGER_ASSERT(0 == pthread_mutex_destroy(&queued_lines_mutex_));
   LOGGER_ASSERT(0 == pthread_cond_destroy(&queued_lines_cond_));
-  LOGGER_ASSERT(0 == pthread_cond_destroy(&full_queue_cond_));
+  delete[] ring_;
 }
 
-void Logger::QueueLogLine(string *line) {
+void Logger::WriteLogLine(const char *line, size_t length) {
   LOGGER_ASSERT(line != NULL);
-  LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
-  if (thread_running_) {
-    if (queued_lines_.size() >= kMaxQueueSize) {
-      LOGGER_ASSERT(0 == pthread_cond_wait(&full_queue_cond_,
-                                           &queued_lines_mutex_));
+  ssize_t bytes_written;
+  if (log_fd_ >= 0) {
+    bytes_written = write(log_fd_, line, length);
+    LOGGER_ASSERT(bytes_written == static_cast<ssize_t>(length));
+  }
+  if (stdout_enabled_) {
+    bytes_written = write(STDOUT_FILENO, line, length);
+    LOGGER_ASSERT(bytes_written == static_cast<ssize_t>(length));
+  }
+  if (line_handler_)
+    line_handler_(line, length, line_handler_arg_);
+}
+
+void Logger::WriteFully(int fd, struct iovec *iov, int count) {
+  while (count) {
+    ssize_t bytes_written = writev(fd, iov, count);
+    if (bytes_written < 0 && errno == EINTR)
+      continue;
+    LOGGER_ASSERT(bytes_written > 0);
+    // Skip whatever made it out, and retry with the rest.
+    while (count && static_cast<size_t>(bytes_written) >= iov->iov_len) {
+      bytes_written -= iov->iov_len;
+      iov++;
+      count--;
     }
-    if (queued_lines_.empty()) {
-      LOGGER_ASSERT(0 == pthread_cond_signal(&queued_lines_cond_));
+    if (count) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + bytes_written;
+      iov->iov_len -= bytes_written;
     }
-    queued_lines_.push_back(line);
-  } else {
-    WriteAndDeleteLogLine(line);
   }
-  LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
 }
 
-void Logger::WriteAndDeleteLogLine(string *line) {
-  LOGGER_ASSERT(line != NULL);
-  ssize_t bytes_written;
+void Logger::WriteLogLines(struct iovec *iov, int count) {
+  // WriteFully() consumes its iovec, keep the original for the others.
+  struct iovec copy[kLogWriteBatch];
   if (log_fd_ >= 0) {
-    bytes_written = write(log_fd_, line->data(), line->size());
-    LOGGER_ASSERT(bytes_written == static_cast<ssize_t>(line->size()));
+    memcpy(copy, iov, count * sizeof(*iov));
+    WriteFully(log_fd_, copy, count);
+  }
+  if (stdout_enabled_) {
+    memcpy(copy, iov, count * sizeof(*iov));
+    WriteFully(STDOUT_FILENO, copy, count);
+  }
+  if (line_handler_) {
+    for (int i = 0; i < count; i++)
+      line_handler_(static_cast<const char*>(iov[i].iov_base),
+                    iov[i].iov_len, line_handler_arg_);
   }
-  bytes_written = write(STDOUT_FILENO, line->data(), line->size());
-  LOGGER_ASSERT(bytes_written == static_cast<ssize_t>(line->size()));
-  delete line;
 }
 
 void *Logger::StartRoutine(void *ptr) {
@@ -135,36 +267,72 @@ void *Logger::StartRoutine(void *ptr) {
 }
 
 void Logger::ThreadMain() {
-  vector<string*> local_queue;
-  LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
+  struct iovec iov[kLogWriteBatch];
+  char drop_line[kLogLineSize];
 
   for (;;) {
-    if (queued_lines_.empty()) {
-      LOGGER_ASSERT(0 == pthread_cond_wait(&queued_lines_cond_,
-                                           &queued_lines_mutex_));
-      continue;
+    // Gather the run of records that are ready, in order, and going to
+    // the same place.
+    int count = 0;
+    bool binary = false;
+    while (count < kLogWriteBatch) {
+      struct LogRecord *record = &ring_[(pop_pos_ + count) &
+                                        (kLogRingSize - 1)];
+      if (record->seq != pop_pos_ + count + 1)
+        break;
+      __sync_synchronize();
+      if (count == 0)
+        binary = record->binary;
+      else if (record->binary != binary)
+        break;
+      iov[count].iov_base = record->text;
+      iov[count].iov_len = record->length;
+      count++;
     }
 
-    // We move the log lines into a local queue so we can release the lock
-    // while writing them to disk, preventing other threads from blocking on
-    // our writes.
-    local_queue.swap(queued_lines_);
-    if (local_queue.size() >= kMaxQueueSize) {
-      LOGGER_ASSERT(0 == pthread_cond_broadcast(&full_queue_cond_));
+    if (count) {
+      if (binary)
+        WriteFully(binary_fd_, iov, count);
+      else
+        WriteLogLines(iov, count);
+      // Hand the records back to the producers of the next lap.
+      for (int i = 0; i < count; i++) {
+        ring_[pop_pos_ & (kLogRingSize - 1)].seq = pop_pos_ + kLogRingSize;
+        pop_pos_++;
+      }
     }
 
-    // Unlock while we process our local queue.
-    LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
-    for (vector<string*>::const_iterator it = local_queue.begin();
-         it != local_queue.end(); ++it) {
-      if (*it == NULL) {
-        // NULL is guaranteed to be at the end.
-        return;
-      }
-      WriteAndDeleteLogLine(*it);
+    uint64 dropped = dropped_lines_;
+    if (dropped != reported_drops_) {
+      size_t length = FormatLineF(drop_line,
+                                  "Log: Logger dropped %llu lines, "
+                                  "%llu total\n",
+                                  dropped - reported_drops_, dropped);
+      WriteLogLine(drop_line, length);
+      reported_drops_ = dropped;
     }
-    local_queue.clear();
-    // We must hold the lock at the start of each iteration of this for loop.
+
+    if (count)
+      continue;
+
+    // Nothing ready.  Tell producers we're going to sleep, then check
+    // again, so that a line queued meanwhile isn't left behind.
     LOGGER_ASSERT(0 == pthread_mutex_lock(&queued_lines_mutex_));
+    thread_waiting_ = true;
+    __sync_synchronize();
+    struct LogRecord *next = &ring_[pop_pos_ & (kLogRingSize - 1)];
+    bool ready = (next->seq == pop_pos_ + 1);
+    bool claimed = (push_pos_ != pop_pos_);
+    if (!ready && !claimed && stop_requested_) {
+      thread_waiting_ = false;
+      LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
+      return;
+    }
+    if (!ready && !claimed) {
+      LOGGER_ASSERT(0 == pthread_cond_wait(&queued_lines_cond_,
+                                           &queued_lines_mutex_));
+    }
+    thread_waiting_ = false;
+    LOGGER_ASSERT(0 == pthread_mutex_unlock(&queued_lines_mutex_));
   }
 }
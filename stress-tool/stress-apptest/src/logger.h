@@ -17,6 +17,7 @@
 
 #include <pthread.h>
 #include <stdarg.h>
+#include <sys/uio.h>
 
 #include <string>
 #include <vector>
@@ -25,10 +26,16 @@
 // so these includes are correct.
 #include "sattypes.h"
 
-// Attempts to log additional lines will block when the queue reaches this size.
-// Due to how the logging thread works, up to twice this many log lines may be
-// outstanding at any point.
-static const size_t kMaxQueueSize = 250;
+// Number of log lines that can be queued for the logging thread.  Attempts to
+// log additional lines are dropped, and counted, rather than blocking the
+// caller.  Must be a power of 2.
+static const size_t kLogRingSize = 1024;
+
+// Longest log line, including the timestamp.  Longer lines are truncated.
+static const size_t kLogLineSize = 4096;
+
+// Most lines handed to a single writev(2) by the logging thread.
+static const int kLogWriteBatch = 64;
 
 
 // This is only for use by the Logger class, do not use it elsewhere!
@@ -83,6 +90,28 @@ class Logger {
     log_fd_ = -1;
   }
 
+  // Enable or disable writing to stdout.  May not be called while multiple
+  // threads are running.
+  void SetStdoutEnabled(bool enabled) {
+    stdout_enabled_ = enabled;
+  }
+
+  // Hands every text line, with its trailing newline, to 'handler' after it
+  // has been written out.  The handler runs in whichever thread writes the
+  // line, one line at a time, and must not log.  NULL removes it.  May not be
+  // called while multiple threads are running.
+  typedef void (*LineHandler)(const char *line, size_t length, void *arg);
+  void SetLineHandler(LineHandler handler, void *arg) {
+    line_handler_ = handler;
+    line_handler_arg_ = arg;
+  }
+
+  // Sets the file that LogBinary() records go to, or -1 for none.  May not be
+  // called while multiple threads are running.
+  virtual void SetBinaryFd(int binary_fd) {
+    binary_fd_ = binary_fd;
+  }
+
   // Enable or disable logging of timestamps.
   void SetTimestampLogging(bool log_ts_enabled) {
     log_timestamps_ = log_ts_enabled;
@@ -90,8 +119,8 @@ class Logger {
 
   // Logs a line, with a vprintf(3)-like interface.  This will block on writing
   // the line to stdout/disk iff the dedicated logging thread is not running.
-  // This will block on adding the line to the queue if doing so would exceed
-  // kMaxQueueSize.
+  // Otherwise the line is formatted straight into the queue without taking
+  // any lock, and dropped if the queue already holds kLogRingSize lines.
   //
   // Args:
   //   priority: If this is numerically greater than the verbosity, the line
@@ -100,6 +129,10 @@ class Logger {
   //   args: see vprintf(3)
   void VLogF(int priority, const char *format, va_list args);
 
+  // Queues a binary record of at most kLogLineSize bytes for the binary file,
+  // in order with the text lines.  Returns false if it was dropped.
+  bool LogBinary(const void *data, size_t length);
+
   // Starts the dedicated logging thread.  May not be called while multiple
   // threads are already running.
   void StartThread();
@@ -109,19 +142,46 @@ class Logger {
   // before this returns.  Waits for the thread to finish before returning.
   void StopThread();
 
+  // Returns the number of lines dropped because the queue was full.
+  uint64 DroppedLines() const { return dropped_lines_; }
+
  protected:
   Logger();
 
   virtual ~Logger();
 
  private:
-  // Args:
-  //   line: Must be non-NULL.  This function takes ownership of it.
-  void QueueLogLine(string *line);
-
-  // Args:
-  //   line: Must be non-NULL.  This function takes ownership of it.
-  void WriteAndDeleteLogLine(string *line);
+  // One queued log line.  'seq' tells whose turn it is: the producer
+  // claiming position p may fill the record when seq == p, the logging thread
+  // may write it out when seq == p + 1.
+  struct LogRecord {
+    volatile uint64 seq;
+    size_t length;
+    bool binary;       // Goes to binary_fd_ rather than the text outputs.
+    char text[kLogLineSize];
+  };
+
+  // Claims the next free record, or returns NULL after counting a drop.
+  // Publish it with PublishRecord() once filled in.
+  struct LogRecord *ClaimRecord(uint64 *pos);
+  void PublishRecord(struct LogRecord *record, uint64 pos);
+
+  // Formats a line, with timestamp, into 'buffer' of kLogLineSize bytes.
+  // Returns the length of the line.
+  size_t FormatLine(char *buffer, const char *format, va_list args);
+  size_t FormatLineF(char *buffer, const char *format, ...);
+
+  // Writes a line to stdout and the log file.
+  void WriteLogLine(const char *line, size_t length);
+
+  // Writes 'count' lines to stdout and the log file.  Modifies 'iov'.
+  void WriteLogLines(struct iovec *iov, int count);
+
+  // Writes all of 'count' buffers to 'fd', picking up after short writes.
+  static void WriteFully(int fd, struct iovec *iov, int count);
+
+  // Wakes up the logging thread if it is waiting for lines.
+  void WakeThread();
 
   // Callback for pthread_create(3).
   static void *StartRoutine(void *ptr);
@@ -132,16 +192,29 @@ class Logger {
   pthread_t thread_;
   int verbosity_;
   int log_fd_;
-  bool thread_running_;
+  int binary_fd_;
+  volatile bool thread_running_;
   bool log_timestamps_;
-  vector<string*> queued_lines_;
-  // This doubles as a mutex for log_fd_ when the logging thread is not running.
+  bool stdout_enabled_;
+  LineHandler line_handler_;
+  void *line_handler_arg_;
+
+  struct LogRecord *ring_;        // kLogRingSize queued lines.
+  char pad0_[64];
+  volatile uint64 push_pos_;      // Next record to be claimed by a producer.
+  char pad1_[64];
+  uint64 pop_pos_;                // Next record to be written out, only
+                                  // touched by the logging thread.
+  volatile uint64 dropped_lines_;
+  uint64 reported_drops_;         // Drops already logged.
+  volatile bool stop_requested_;
+  volatile bool thread_waiting_;  // Logging thread is about to sleep.
+
+  // Serializes writes when the logging thread is not running, and guards
+  // the logging thread's sleep.
   pthread_mutex_t queued_lines_mutex_;
   // Lets the logging thread know that the queue is no longer empty.
   pthread_cond_t queued_lines_cond_;
-  // Lets the threads blocked on the queue having reached kMaxQueueSize know
-  // that the queue has been emptied.
-  pthread_cond_t full_queue_cond_;
 
   DISALLOW_COPY_AND_ASSIGN(Logger);
 };
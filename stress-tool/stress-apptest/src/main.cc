@@ -24,9 +24,18 @@ int main(int argc, char **argv) {
     return 255;
   }
 
+  int retval = -1;
   if (!sat->ParseArgs(argc, argv)) {
     logprintf(0, "Process Error: Sat::ParseArgs() failed\n");
     sat->bad_status();
+  } else if ((retval = sat->RunShards()) >= 0) {
+    // The shards did the run.
+    delete sat;
+    return retval;
+  } else if ((retval = sat->RunScrubber()) >= 0) {
+    // The scrub slices did the run.
+    delete sat;
+    return retval;
   } else if (!sat->Initialize()) {
     logprintf(0, "Process Error: Sat::Initialize() failed\n");
     sat->bad_status();
@@ -40,7 +49,6 @@ int main(int argc, char **argv) {
     sat->bad_status();
   }
 
-  int retval;
   if (sat->status() != 0) {
     logprintf(0, "Process Error: Fatal issue encountered. See above logs for "
               "details.\n");
@@ -0,0 +1,104 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// March algorithm descriptions, see march.h.
+
+#include <string.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "march.h"
+
+namespace {
+struct NamedMarch {
+  const char *name;
+  const char *description;
+};
+
+// Van de Goor's notation, with the initial write element of each.
+const struct NamedMarch kNamedMarches[] = {
+  { "mats+", "b(w0);u(r0,w1);d(r1,w0)" },
+  { "march_c-", "b(w0);u(r0,w1);u(r1,w0);d(r0,w1);d(r1,w0);b(r0)" },
+  { "march_b", "b(w0);u(r0,w1,r1,w0,r0,w1);u(r1,w0,w1);d(r1,w0,w1,w0);"
+               "d(r0,w1,w0)" },
+};
+}  // namespace
+
+MarchTest::MarchTest() {
+  Parse("march_c-");
+}
+
+bool MarchTest::Parse(const char *description) {
+  string name = description;
+  for (size_t i = 0; i < sizeof(kNamedMarches) / sizeof(*kNamedMarches);
+       i++) {
+    if (!strcmp(description, kNamedMarches[i].name)) {
+      description = kNamedMarches[i].description;
+      break;
+    }
+  }
+
+  vector<struct MarchElement> elements;
+  int ops = 0;
+  bool ones = false;  // What the cells hold at this point.
+  const char *p = description;
+  while (*p) {
+    struct MarchElement element;
+    if (*p == 'u' || *p == 'b') {
+      element.down = false;
+    } else if (*p == 'd') {
+      element.down = true;
+    } else {
+      return false;
+    }
+    if (*++p != '(')
+      return false;
+    while (true) {
+      p++;
+      struct MarchOp op;
+      if (*p == 'w')
+        op.write = true;
+      else if (*p == 'r')
+        op.write = false;
+      else
+        return false;
+      p++;
+      if (*p != '0' && *p != '1')
+        return false;
+      op.ones = *p == '1';
+      if (op.write)
+        ones = op.ones;
+      else if (op.ones != ones)
+        return false;
+      element.ops.push_back(op);
+      p++;
+      if (*p == ')')
+        break;
+      if (*p != ',')
+        return false;
+    }
+    ops += element.ops.size();
+    elements.push_back(element);
+    p++;
+    if (*p == ';')
+      p++;
+  }
+  if (elements.empty() || ones)
+    return false;
+
+  elements_ = elements;
+  ops_ = ops;
+  name_ = name;
+  return true;
+}
@@ -0,0 +1,70 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// March memory test algorithms, described as sequences of elements that
+// read and write every cell of a region in ascending or descending order.
+
+#ifndef STRESSAPPTEST_MARCH_H_
+#define STRESSAPPTEST_MARCH_H_
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// One operation on a cell: read and expect, or write, the background data
+// (0) or its inverse (1).
+struct MarchOp {
+  bool write;
+  bool ones;
+};
+
+// Operations applied to each cell in turn before moving to the next one.
+struct MarchElement {
+  bool down;                    // Visit cells from the top.
+  vector<struct MarchOp> ops;
+};
+
+// A March algorithm, either one of the named ones or a description such as
+// "u(w0);u(r0,w1);d(r1,w0)". Each element is u (ascending), d (descending)
+// or b (either, run ascending) followed by its operations, r0, r1, w0 or w1.
+//
+// Cells start out holding the background data, and an algorithm must leave
+// them that way, so that a region can be handed back without refilling.
+// Reads must expect the value the cell holds at that point.
+class MarchTest {
+ public:
+  // Starts as March C-.
+  MarchTest();
+
+  // Replace the algorithm with the named one (mats+, march_c-, march_b) or
+  // with 'description'. Returns false and keeps the old algorithm if it
+  // doesn't parse or doesn't follow the rules above.
+  bool Parse(const char *description);
+
+  const vector<struct MarchElement> &elements() const { return elements_; }
+  // Operations on each cell over the whole algorithm.
+  int ops() const { return ops_; }
+  // The name, or the description for unnamed algorithms.
+  const string &name() const { return name_; }
+
+ private:
+  vector<struct MarchElement> elements_;
+  int ops_;
+  string name_;
+};
+
+#endif  // STRESSAPPTEST_MARCH_H_
@@ -0,0 +1,479 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Network test coordinator and its client, see net_coordinator.h.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "net_coordinator.h"
+
+namespace {
+
+// Split 'line' at spaces.
+vector<string> SplitWords(const string &line) {
+  vector<string> words;
+  string::size_type start = 0;
+  while (start < line.size()) {
+    string::size_type end = line.find(' ', start);
+    if (end == string::npos)
+      end = line.size();
+    if (end > start)
+      words.push_back(line.substr(start, end - start));
+    start = end + 1;
+  }
+  return words;
+}
+
+// Send all of 'text'. Returns false if the connection failed.
+bool SendText(int sock, const string &text) {
+  string::size_type done = 0;
+  while (done < text.size()) {
+    ssize_t sent = send(sock, text.data() + done, text.size() - done,
+                        MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    done += sent;
+  }
+  return true;
+}
+
+// Take the first complete line out of 'input' into 'line'.
+bool TakeLine(string *input, string *line) {
+  string::size_type end = input->find('\n');
+  if (end == string::npos)
+    return false;
+  *line = input->substr(0, end);
+  input->erase(0, end + 1);
+  return true;
+}
+
+// Receive whatever is waiting into 'input'. Returns false once the
+// connection is closed or failed.
+bool ReceiveText(int sock, string *input) {
+  char buffer[4096];
+  ssize_t got;
+  do {
+    got = recv(sock, buffer, sizeof(buffer), 0);
+  } while (got < 0 && errno == EINTR);
+  if (got <= 0)
+    return false;
+  input->append(buffer, got);
+  return true;
+}
+
+// Wait up to 'timeout_ms' for a whole line on 'sock'.
+bool ReadLine(int sock, string *input, int timeout_ms, string *line) {
+  int64 deadline = sat_get_time_us() + timeout_ms * 1000LL;
+  while (!TakeLine(input, line)) {
+    int64 left = (deadline - sat_get_time_us()) / 1000;
+    if (left <= 0)
+      return false;
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int ready = poll(&pfd, 1, left);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0 || !ReceiveText(sock, input))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+NetCoordinator::NetCoordinator() {
+  listen_sock_ = -1;
+}
+
+NetCoordinator::~NetCoordinator() {
+  Close();
+}
+
+bool NetCoordinator::ParseTopology(const char *name, NetTopology *topology) {
+  if (!strcmp(name, "ring")) {
+    *topology = kNetTopologyRing;
+  } else if (!strcmp(name, "all")) {
+    *topology = kNetTopologyAllToAll;
+  } else if (!strcmp(name, "bisection")) {
+    *topology = kNetTopologyBisection;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *NetCoordinator::TopologyName(NetTopology topology) {
+  switch (topology) {
+    case kNetTopologyAllToAll:
+      return "all";
+    case kNetTopologyBisection:
+      return "bisection";
+    default:
+      return "ring";
+  }
+}
+
+bool NetCoordinator::CheckHosts(NetTopology topology, int hosts,
+                                string *reason) {
+  if (hosts < 2) {
+    *reason = "needs at least 2 hosts";
+    return false;
+  }
+  if (topology == kNetTopologyBisection && hosts % 2) {
+    *reason = "bisection needs an even number of hosts";
+    return false;
+  }
+  return true;
+}
+
+vector<int> NetCoordinator::Peers(NetTopology topology, int index,
+                                  int hosts) {
+  vector<int> peers;
+  if (hosts < 2)
+    return peers;
+  switch (topology) {
+    case kNetTopologyAllToAll:
+      for (int i = 0; i < hosts; i++) {
+        if (i != index)
+          peers.push_back(i);
+      }
+      break;
+    case kNetTopologyBisection: {
+      int half = hosts / 2;
+      if (index < half)
+        peers.push_back(index + half);
+      else if (index - half < half)
+        peers.push_back(index - half);
+      break;
+    }
+    default:
+      peers.push_back((index + 1) % hosts);
+      break;
+  }
+  return peers;
+}
+
+bool NetCoordinator::Listen(uint16 port) {
+  listen_sock_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_sock_ < 0) {
+    logprintf(0, "Process Error: net coordinator cannot create socket: %s\n",
+              ErrorString(errno).c_str());
+    return false;
+  }
+  int on = 1;
+  setsockopt(listen_sock_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = INADDR_ANY;
+  if (bind(listen_sock_, reinterpret_cast<struct sockaddr*>(&sa),
+           sizeof(sa)) || listen(listen_sock_, SOMAXCONN)) {
+    logprintf(0, "Process Error: net coordinator cannot listen on port %d: "
+              "%s\n", port, ErrorString(errno).c_str());
+    close(listen_sock_);
+    listen_sock_ = -1;
+    return false;
+  }
+  logprintf(5, "Log: Net coordinator listening on port %d\n", port);
+  return true;
+}
+
+int NetCoordinator::Register(int hosts, int timeout_ms) {
+  // Registering hosts send one line straight after connecting.
+  static const int kRegisterLineMs = 5000;
+  int64 deadline = sat_get_time_us() + timeout_ms * 1000LL;
+  while (static_cast<int>(hosts_.size()) < hosts) {
+    int64 left = (deadline - sat_get_time_us()) / 1000;
+    if (left <= 0)
+      break;
+    struct pollfd pfd = { listen_sock_, POLLIN, 0 };
+    if (poll(&pfd, 1, left) <= 0)
+      continue;
+
+    struct sockaddr_in sa;
+    socklen_t sa_length = sizeof(sa);
+    int sock = accept(listen_sock_, reinterpret_cast<struct sockaddr*>(&sa),
+                      &sa_length);
+    if (sock < 0)
+      continue;
+
+    Host host;
+    host.sock = sock;
+    host.address = inet_ntoa(sa.sin_addr);
+    host.seconds = 0;
+    host.done = false;
+    host.errors = 0;
+    string line;
+    vector<string> words;
+    if (ReadLine(sock, &host.input, kRegisterLineMs, &line))
+      words = SplitWords(line);
+    if (words.size() != 3 || words[0] != "register" ||
+        atoi(words[1].c_str()) != kVersion) {
+      logprintf(0, "Process Error: net coordinator got a bad registration "
+                "from %s: '%s'\n", host.address.c_str(), line.c_str());
+      close(sock);
+      continue;
+    }
+    host.seconds = atoi(words[2].c_str());
+    hosts_.push_back(host);
+    logprintf(5, "Log: Net coordinator registered host %d of %d, %s\n",
+              static_cast<int>(hosts_.size()), hosts,
+              host.address.c_str());
+  }
+  return hosts_.size();
+}
+
+bool NetCoordinator::Assign(NetTopology topology, int delay_ms) {
+  // No more hosts are taken.
+  if (listen_sock_ >= 0)
+    close(listen_sock_);
+  listen_sock_ = -1;
+
+  bool result = true;
+  int count = hosts_.size();
+  for (int i = 0; i < count; i++) {
+    vector<int> peers = Peers(topology, i, count);
+    char header[64];
+    snprintf(header, sizeof(header), "assign %d %d %d", i, count, delay_ms);
+    string line(header);
+    for (size_t j = 0; j < peers.size(); j++)
+      line += " " + hosts_[peers[j]].address;
+    logprintf(5, "Log: Net coordinator host %d, %s streams to%s\n", i,
+              hosts_[i].address.c_str(), line.c_str() + strlen(header));
+    if (!SendText(hosts_[i].sock, line + "\n")) {
+      logprintf(0, "Process Error: net coordinator lost host %s\n",
+                hosts_[i].address.c_str());
+      CloseHost(&hosts_[i]);
+      result = false;
+    }
+  }
+  return result;
+}
+
+bool NetCoordinator::Collect(int timeout_ms) {
+  vector<struct pollfd> pfds;
+  vector<Host*> polled;
+  for (size_t i = 0; i < hosts_.size(); i++) {
+    if (hosts_[i].sock < 0)
+      continue;
+    struct pollfd pfd = { hosts_[i].sock, POLLIN, 0 };
+    pfds.push_back(pfd);
+    polled.push_back(&hosts_[i]);
+  }
+  if (pfds.empty())
+    return true;
+
+  if (poll(&pfds[0], pfds.size(), timeout_ms) <= 0)
+    return false;
+  for (size_t i = 0; i < pfds.size(); i++) {
+    if (!pfds[i].revents)
+      continue;
+    Host *host = polled[i];
+    bool open = ReceiveText(host->sock, &host->input);
+    string line;
+    while (host->sock >= 0 && TakeLine(&host->input, &line))
+      HandleLine(host, line);
+    if (!open && host->sock >= 0) {
+      if (!host->done)
+        logprintf(0, "Process Error: net host %s went away without "
+                  "reporting\n", host->address.c_str());
+      CloseHost(host);
+    }
+  }
+  for (size_t i = 0; i < hosts_.size(); i++) {
+    if (hosts_[i].sock >= 0)
+      return false;
+  }
+  return true;
+}
+
+void NetCoordinator::HandleLine(Host *host, const string &line) {
+  vector<string> words = SplitWords(line);
+  if (words.size() == 5 && words[0] == "link") {
+    struct NetLinkResult link;
+    link.from = host->address;
+    link.to = words[1];
+    link.mbytes = atof(words[2].c_str());
+    link.seconds = atof(words[3].c_str());
+    link.errors = strtoll(words[4].c_str(), NULL, 10);
+    links_.push_back(link);
+  } else if (words.size() == 2 && words[0] == "done") {
+    host->done = true;
+    host->errors = strtoll(words[1].c_str(), NULL, 10);
+    CloseHost(host);
+  } else {
+    logprintf(0, "Process Error: net coordinator got a bad report from %s: "
+              "'%s'\n", host->address.c_str(), line.c_str());
+  }
+}
+
+void NetCoordinator::CloseHost(Host *host) {
+  if (host->sock >= 0)
+    close(host->sock);
+  host->sock = -1;
+}
+
+void NetCoordinator::Close() {
+  for (size_t i = 0; i < hosts_.size(); i++)
+    CloseHost(&hosts_[i]);
+  if (listen_sock_ >= 0)
+    close(listen_sock_);
+  listen_sock_ = -1;
+}
+
+int NetCoordinator::reported() const {
+  int count = 0;
+  for (size_t i = 0; i < hosts_.size(); i++) {
+    if (hosts_[i].done)
+      count++;
+  }
+  return count;
+}
+
+int64 NetCoordinator::host_errors() const {
+  int64 errors = 0;
+  for (size_t i = 0; i < hosts_.size(); i++)
+    errors += hosts_[i].errors;
+  return errors;
+}
+
+int NetCoordinator::max_host_seconds() const {
+  int seconds = 0;
+  for (size_t i = 0; i < hosts_.size(); i++) {
+    if (hosts_[i].seconds > seconds)
+      seconds = hosts_[i].seconds;
+  }
+  return seconds;
+}
+
+NetCoordinatorClient::NetCoordinatorClient() {
+  sock_ = -1;
+  index_ = -1;
+  hosts_ = 0;
+  delay_ms_ = 0;
+}
+
+NetCoordinatorClient::~NetCoordinatorClient() {
+  Close();
+}
+
+bool NetCoordinatorClient::Join(const char *address, uint16 port,
+                                int seconds, int timeout_ms) {
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  if (inet_aton(address, &sa.sin_addr) == 0) {
+    logprintf(0, "Process Error: Cannot resolve net coordinator %s\n",
+              address);
+    return false;
+  }
+
+  // The coordinator may not be up yet, keep trying once a second.
+  int64 deadline = sat_get_time_us() + timeout_ms * 1000LL;
+  while (true) {
+    sock_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_ < 0) {
+      logprintf(0, "Process Error: Cannot create socket: %s\n",
+                ErrorString(errno).c_str());
+      return false;
+    }
+    if (!connect(sock_, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)))
+      break;
+    int err = errno;
+    Close();
+    if (sat_get_time_us() >= deadline) {
+      logprintf(0, "Process Error: Cannot connect to net coordinator %s: "
+                "%s\n", address, ErrorString(err).c_str());
+      return false;
+    }
+    sat_sleep(1);
+  }
+
+  char text[64];
+  snprintf(text, sizeof(text), "register %d %d\n", NetCoordinator::kVersion,
+           seconds);
+  logprintf(5, "Log: Registered with net coordinator %s, waiting for the "
+            "other hosts\n", address);
+  string input;
+  string line;
+  int left = (deadline - sat_get_time_us()) / 1000;
+  if (!SendText(sock_, text) ||
+      !ReadLine(sock_, &input, left > 0 ? left : 0, &line)) {
+    logprintf(0, "Process Error: No assignment from net coordinator %s\n",
+              address);
+    Close();
+    return false;
+  }
+
+  vector<string> words = SplitWords(line);
+  if (words.size() < 4 || words[0] != "assign") {
+    logprintf(0, "Process Error: Bad assignment from net coordinator %s: "
+              "'%s'\n", address, line.c_str());
+    Close();
+    return false;
+  }
+  index_ = atoi(words[1].c_str());
+  hosts_ = atoi(words[2].c_str());
+  delay_ms_ = atoi(words[3].c_str());
+  peers_.assign(words.begin() + 4, words.end());
+  logprintf(5, "Log: Net host %d of %d, streaming to %d peers in %dms\n",
+            index_, hosts_, static_cast<int>(peers_.size()), delay_ms_);
+  return true;
+}
+
+bool NetCoordinatorClient::Report(const vector<NetLinkResult> &links,
+                                  int64 errors) {
+  if (sock_ < 0)
+    return false;
+  string text;
+  for (size_t i = 0; i < links.size(); i++) {
+    char line[384];
+    snprintf(line, sizeof(line), "link %s %.2f %.3f %lld\n",
+             links[i].to.c_str(), links[i].mbytes, links[i].seconds,
+             links[i].errors);
+    text += line;
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "done %lld\n", errors);
+  text += line;
+  bool result = SendText(sock_, text);
+  if (!result)
+    logprintf(0, "Process Error: Cannot report to net coordinator\n");
+  Close();
+  return result;
+}
+
+void NetCoordinatorClient::Close() {
+  if (sock_ >= 0)
+    close(sock_);
+  sock_ = -1;
+}
@@ -0,0 +1,148 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Coordinator for network tests across many hosts: hosts register with it,
+// get their peers from a topology, and report per-link results back.
+
+#ifndef STRESSAPPTEST_NET_COORDINATOR_H_
+#define STRESSAPPTEST_NET_COORDINATOR_H_
+
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// How registered hosts are paired up. Every link is a NetworkThread on one
+// host streaming pages to the listen thread of its peer, which echoes them,
+// so each link carries traffic both ways.
+enum NetTopology {
+  kNetTopologyRing = 0,       // Each host streams to the next one.
+  kNetTopologyAllToAll = 1,   // Each host streams to every other one.
+  kNetTopologyBisection = 2,  // Host i and host i + n/2 stream to each other.
+};
+
+// What a host measured on one of its links.
+struct NetLinkResult {
+  string from;          // Host running the NetworkThread.
+  string to;            // Peer reflecting its pages.
+  double mbytes;        // Data moved both ways, in MB.
+  double seconds;       // Time spent streaming.
+  int64 errors;         // Miscompares and failures on the link.
+};
+
+// The coordinator side, run by NetCoordinatorThread. Hosts connect to it
+// with a NetCoordinatorClient and speak a line based text protocol:
+//   host:        register <version> <seconds to run>
+//   coordinator: assign <index> <hosts> <start delay ms> <peer>...
+//   host:        link <peer> <mbytes> <seconds> <errors>   (one per link)
+//   host:        done <errors>
+//
+// Not threadsafe, one thread drives it.
+class NetCoordinator {
+ public:
+  NetCoordinator();
+  ~NetCoordinator();
+
+  // Parse "ring", "all" or "bisection". Returns false if unknown.
+  static bool ParseTopology(const char *name, NetTopology *topology);
+  static const char *TopologyName(NetTopology topology);
+  // Returns false with a reason for 'hosts' not fitting 'topology'.
+  static bool CheckHosts(NetTopology topology, int hosts, string *reason);
+  // Indices of the hosts that host 'index' of 'hosts' streams to.
+  static vector<int> Peers(NetTopology topology, int index, int hosts);
+
+  // Listen for hosts on 'port'. Returns false on failure.
+  bool Listen(uint16 port);
+  // Accept registrations for up to 'timeout_ms' or until 'hosts' are in.
+  // Returns the number registered so far.
+  int Register(int hosts, int timeout_ms);
+  // Send every registered host its peers under 'topology', to start
+  // streaming 'delay_ms' from now. Returns false if a host went away.
+  bool Assign(NetTopology topology, int delay_ms);
+  // Read reports for up to 'timeout_ms'. Returns true once every host is
+  // done or gone.
+  bool Collect(int timeout_ms);
+  // Close all connections.
+  void Close();
+
+  int hosts() const { return hosts_.size(); }
+  // Hosts that sent all their results.
+  int reported() const;
+  // Errors the hosts reported in total, on and off the fabric.
+  int64 host_errors() const;
+  // Longest run time any host registered with.
+  int max_host_seconds() const;
+  const vector<NetLinkResult> &links() const { return links_; }
+
+  static const int kVersion = 1;
+  // Longest a host waits for the others to register.
+  static const int kJoinTimeoutMs = 600000;
+
+ private:
+  struct Host {
+    int sock;           // -1 once closed.
+    string address;     // Address the host registered from.
+    string input;       // Received text not yet split into lines.
+    int seconds;        // Time it runs for.
+    bool done;          // Sent its done line.
+    int64 errors;       // From its done line.
+  };
+
+  // Handle one line of a host's report.
+  void HandleLine(Host *host, const string &line);
+  void CloseHost(Host *host);
+
+  int listen_sock_;
+  vector<Host> hosts_;
+  vector<NetLinkResult> links_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetCoordinator);
+};
+
+// The host side, used by Sat to get its peers before the threads start
+// and to send their results once they are done.
+class NetCoordinatorClient {
+ public:
+  NetCoordinatorClient();
+  ~NetCoordinatorClient();
+
+  // Register with the coordinator at 'address' to run for 'seconds', and
+  // wait up to 'timeout_ms' for the assignment. Returns false on failure.
+  bool Join(const char *address, uint16 port, int seconds, int timeout_ms);
+  // Send the results of this host's links and its error count, then
+  // close the connection.
+  bool Report(const vector<NetLinkResult> &links, int64 errors);
+
+  bool joined() const { return sock_ >= 0; }
+  const vector<string> &peers() const { return peers_; }
+  int index() const { return index_; }
+  int hosts() const { return hosts_; }
+  int delay_ms() const { return delay_ms_; }
+
+ private:
+  void Close();
+
+  int sock_;             // Connection to the coordinator, or -1.
+  vector<string> peers_;
+  int index_;            // This host's place in the topology.
+  int hosts_;            // Hosts in the test.
+  int delay_ms_;         // Time from the assignment to streaming.
+
+  DISALLOW_COPY_AND_ASSIGN(NetCoordinatorClient);
+};
+
+#endif  // STRESSAPPTEST_NET_COORDINATOR_H_
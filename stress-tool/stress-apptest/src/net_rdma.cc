@@ -0,0 +1,558 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// RDMA verbs transport for the network threads, see net_rdma.h.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "net_rdma.h"
+
+#ifdef HAVE_INFINIBAND_VERBS_H
+#include <infiniband/verbs.h>
+#define STRESSAPPTEST_NET_RDMA 1
+#endif
+
+RdmaDevice::RdmaDevice() {
+  port_ = 1;
+  gid_index_ = 0;
+  context_ = NULL;
+  pd_ = NULL;
+  arena_mr_ = NULL;
+  base_ = NULL;
+  length_ = 0;
+  lid_ = 0;
+  mtu_ = 0;
+  memset(gid_, 0, sizeof(gid_));
+}
+
+RdmaDevice::~RdmaDevice() {
+  Close();
+}
+
+bool RdmaDevice::Available() {
+#ifdef STRESSAPPTEST_NET_RDMA
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool RdmaDevice::Parse(const char *description) {
+  string text(description);
+  string::size_type colon = text.find(':');
+  name_ = text.substr(0, colon);
+  if (name_.empty())
+    return false;
+  if (colon == string::npos)
+    return true;
+
+  char *end = NULL;
+  port_ = strtol(text.c_str() + colon + 1, &end, 10);
+  if (port_ < 1 || (*end && *end != ':'))
+    return false;
+  if (!*end)
+    return true;
+  const char *gid = end + 1;
+  gid_index_ = strtol(gid, &end, 10);
+  return end != gid && !*end && gid_index_ >= 0;
+}
+
+bool RdmaDevice::Contains(const void *addr, uint64 length) const {
+  const char *start = static_cast<const char*>(addr);
+  return start >= base_ && start + length <= base_ + length_;
+}
+
+RdmaConnection::RdmaConnection() {
+  device_ = NULL;
+  send_cq_ = NULL;
+  recv_cq_ = NULL;
+  qp_ = NULL;
+  exposed_mr_ = NULL;
+  remote_addr_ = 0;
+  remote_rkey_ = 0;
+  remote_length_ = 0;
+  psn_ = 0;
+}
+
+RdmaConnection::~RdmaConnection() {
+  Close();
+}
+
+#ifdef STRESSAPPTEST_NET_RDMA
+
+namespace {
+
+// Send all of 'text' on the TCP socket.
+bool SendLine(int sock, const string &text) {
+  string::size_type done = 0;
+  while (done < text.size()) {
+    ssize_t sent = send(sock, text.data() + done, text.size() - done,
+                        MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    done += sent;
+  }
+  return true;
+}
+
+// Read one line from the TCP socket, a byte at a time so that nothing
+// after it is consumed.
+bool ReadLine(int sock, int timeout_ms, string *line) {
+  line->clear();
+  int64 deadline = sat_get_time_us() + timeout_ms * 1000LL;
+  while (true) {
+    int64 left = (deadline - sat_get_time_us()) / 1000;
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int ready = left > 0 ? poll(&pfd, 1, left) : 0;
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return false;
+    char c;
+    ssize_t got = recv(sock, &c, 1, 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    if (c == '\n')
+      return true;
+    line->push_back(c);
+  }
+}
+
+}  // namespace
+
+bool RdmaDevice::Open(void *base, uint64 length) {
+  Close();
+  int count = 0;
+  struct ibv_device **devices = ibv_get_device_list(&count);
+  if (!devices || !count) {
+    logprintf(0, "Process Error: No RDMA devices found\n");
+    if (devices)
+      ibv_free_device_list(devices);
+    return false;
+  }
+  struct ibv_device *device = NULL;
+  for (int i = 0; i < count && !device; i++) {
+    if (name_.empty() || name_ == ibv_get_device_name(devices[i]))
+      device = devices[i];
+  }
+  if (!device) {
+    logprintf(0, "Process Error: No RDMA device %s\n", name_.c_str());
+    ibv_free_device_list(devices);
+    return false;
+  }
+  name_ = ibv_get_device_name(device);
+  context_ = ibv_open_device(device);
+  ibv_free_device_list(devices);
+  if (!context_) {
+    logprintf(0, "Process Error: Cannot open RDMA device %s: %s\n",
+              name_.c_str(), ErrorString(errno).c_str());
+    return false;
+  }
+
+  struct ibv_port_attr port;
+  memset(&port, 0, sizeof(port));
+  union ibv_gid gid;
+  if (ibv_query_port(context_, port_, &port) ||
+      ibv_query_gid(context_, port_, gid_index_, &gid)) {
+    logprintf(0, "Process Error: Cannot query RDMA device %s port %d "
+              "gid %d\n", name_.c_str(), port_, gid_index_);
+    Close();
+    return false;
+  }
+  if (port.state != IBV_PORT_ACTIVE)
+    logprintf(0, "Log: RDMA device %s port %d is not active\n",
+              name_.c_str(), port_);
+  lid_ = port.lid;
+  mtu_ = port.active_mtu;
+  memcpy(gid_, gid.raw, sizeof(gid_));
+
+  pd_ = ibv_alloc_pd(context_);
+  if (!pd_) {
+    logprintf(0, "Process Error: Cannot allocate RDMA protection domain on "
+              "%s\n", name_.c_str());
+    Close();
+    return false;
+  }
+  arena_mr_ = ibv_reg_mr(pd_, base, length, IBV_ACCESS_LOCAL_WRITE);
+  if (!arena_mr_) {
+    logprintf(0, "Process Error: Cannot register %lldMB of test memory with "
+              "RDMA device %s: %s\n", static_cast<int64>(length >> 20),
+              name_.c_str(), ErrorString(errno).c_str());
+    Close();
+    return false;
+  }
+  base_ = static_cast<char*>(base);
+  length_ = length;
+  logprintf(5, "Log: RDMA device %s port %d, %lldMB of test memory "
+            "registered\n", name_.c_str(), port_,
+            static_cast<int64>(length >> 20));
+  return true;
+}
+
+void RdmaDevice::Close() {
+  if (arena_mr_)
+    ibv_dereg_mr(arena_mr_);
+  arena_mr_ = NULL;
+  if (pd_)
+    ibv_dealloc_pd(pd_);
+  pd_ = NULL;
+  if (context_)
+    ibv_close_device(context_);
+  context_ = NULL;
+  base_ = NULL;
+  length_ = 0;
+}
+
+bool RdmaConnection::Connect(RdmaDevice *device, int sock, void *exposed,
+                             uint64 exposed_length) {
+  Close();
+  device_ = device;
+  send_cq_ = ibv_create_cq(device->context_, 4, NULL, NULL, 0);
+  recv_cq_ = ibv_create_cq(device->context_, kReceives, NULL, NULL, 0);
+  if (!send_cq_ || !recv_cq_) {
+    logprintf(0, "Process Error: Cannot create RDMA completion queues\n");
+    Close();
+    return false;
+  }
+
+  struct ibv_qp_init_attr init;
+  memset(&init, 0, sizeof(init));
+  init.send_cq = send_cq_;
+  init.recv_cq = recv_cq_;
+  init.qp_type = IBV_QPT_RC;
+  init.cap.max_send_wr = 4;
+  init.cap.max_recv_wr = kReceives;
+  init.cap.max_send_sge = 1;
+  init.cap.max_recv_sge = 1;
+  qp_ = ibv_create_qp(device->pd_, &init);
+  if (!qp_) {
+    logprintf(0, "Process Error: Cannot create RDMA queue pair: %s\n",
+              ErrorString(errno).c_str());
+    Close();
+    return false;
+  }
+
+  uint32 rkey = 0;
+  if (exposed) {
+    exposed_mr_ = ibv_reg_mr(device->pd_, exposed, exposed_length,
+                             IBV_ACCESS_LOCAL_WRITE |
+                             IBV_ACCESS_REMOTE_WRITE |
+                             IBV_ACCESS_REMOTE_READ);
+    if (!exposed_mr_) {
+      logprintf(0, "Process Error: Cannot register RDMA buffer: %s\n",
+                ErrorString(errno).c_str());
+      Close();
+      return false;
+    }
+    rkey = exposed_mr_->rkey;
+  }
+
+  // Swap queue pair details with the peer.
+  psn_ = random() & 0xffffff;
+  char text[256];
+  int used = snprintf(text, sizeof(text), "rdma %u %u %d %u %llx %llx ",
+                      qp_->qp_num, psn_, device->lid_, rkey,
+                      static_cast<unsigned long long>(  // NOLINT
+                          reinterpret_cast<uintptr_t>(exposed)),
+                      static_cast<unsigned long long>(  // NOLINT
+                          exposed ? exposed_length : 0));
+  for (int i = 0; i < 16; i++)
+    used += snprintf(text + used, sizeof(text) - used, "%02x",
+                     device->gid_[i]);
+  snprintf(text + used, sizeof(text) - used, "\n");
+  string line;
+  if (!SendLine(sock, text) || !ReadLine(sock, kTimeoutMs, &line)) {
+    logprintf(0, "Process Error: RDMA peer did not send its queue pair\n");
+    Close();
+    return false;
+  }
+
+  unsigned int qpn = 0, peer_psn = 0, peer_rkey = 0;
+  int lid = 0;
+  unsigned long long addr = 0, length = 0;  // NOLINT
+  char gid_text[33] = "";
+  if (sscanf(line.c_str(), "rdma %u %u %d %u %llx %llx %32s", &qpn,
+             &peer_psn, &lid, &peer_rkey, &addr, &length, gid_text) != 7 ||
+      strlen(gid_text) != 32) {
+    logprintf(0, "Process Error: Bad RDMA queue pair from peer: '%s'\n",
+              line.c_str());
+    Close();
+    return false;
+  }
+  unsigned char gid[16];
+  for (int i = 0; i < 16; i++) {
+    char byte[3] = { gid_text[2 * i], gid_text[2 * i + 1], 0 };
+    gid[i] = strtoul(byte, NULL, 16);
+  }
+  remote_addr_ = addr;
+  remote_rkey_ = peer_rkey;
+  remote_length_ = length;
+
+  for (int i = 0; i < kReceives; i++) {
+    if (!PostReceive()) {
+      Close();
+      return false;
+    }
+  }
+  if (!Activate(qpn, peer_psn, lid, gid)) {
+    Close();
+    return false;
+  }
+  // Hold on until the peer's queue pair is ready to receive too.
+  if (!SendLine(sock, "ready\n") || !ReadLine(sock, kTimeoutMs, &line) ||
+      line != "ready") {
+    logprintf(0, "Process Error: RDMA peer did not get ready\n");
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool RdmaConnection::Activate(uint32 qpn, uint32 psn, int lid,
+                              const unsigned char *gid) {
+  struct ibv_qp_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_INIT;
+  attr.pkey_index = 0;
+  attr.port_num = device_->port_;
+  attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
+  if (ibv_modify_qp(qp_, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX |
+                    IBV_QP_PORT | IBV_QP_ACCESS_FLAGS)) {
+    logprintf(0, "Process Error: Cannot initialize RDMA queue pair\n");
+    return false;
+  }
+
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_RTR;
+  attr.path_mtu = static_cast<enum ibv_mtu>(device_->mtu_);
+  attr.dest_qp_num = qpn;
+  attr.rq_psn = psn;
+  attr.max_dest_rd_atomic = 1;
+  attr.min_rnr_timer = 12;
+  attr.ah_attr.dlid = lid;
+  attr.ah_attr.port_num = device_->port_;
+  // RoCE has no LIDs, it is routed by GID.
+  static const unsigned char kNoGid[16] = { 0 };
+  if (memcmp(gid, kNoGid, sizeof(kNoGid))) {
+    attr.ah_attr.is_global = 1;
+    memcpy(attr.ah_attr.grh.dgid.raw, gid, 16);
+    attr.ah_attr.grh.sgid_index = device_->gid_index_;
+    attr.ah_attr.grh.hop_limit = 64;
+  }
+  if (ibv_modify_qp(qp_, &attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU |
+                    IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                    IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER)) {
+    logprintf(0, "Process Error: Cannot connect RDMA queue pair to %06x\n",
+              qpn);
+    return false;
+  }
+
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_RTS;
+  attr.timeout = 14;
+  attr.retry_cnt = 7;
+  attr.rnr_retry = 7;
+  attr.sq_psn = psn_;
+  attr.max_rd_atomic = 1;
+  if (ibv_modify_qp(qp_, &attr, IBV_QP_STATE | IBV_QP_TIMEOUT |
+                    IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                    IBV_QP_MAX_QP_RD_ATOMIC)) {
+    logprintf(0, "Process Error: Cannot start RDMA queue pair\n");
+    return false;
+  }
+  return true;
+}
+
+void RdmaConnection::Close() {
+  if (qp_)
+    ibv_destroy_qp(qp_);
+  qp_ = NULL;
+  if (exposed_mr_)
+    ibv_dereg_mr(exposed_mr_);
+  exposed_mr_ = NULL;
+  if (send_cq_)
+    ibv_destroy_cq(send_cq_);
+  send_cq_ = NULL;
+  if (recv_cq_)
+    ibv_destroy_cq(recv_cq_);
+  recv_cq_ = NULL;
+  device_ = NULL;
+  remote_addr_ = 0;
+  remote_rkey_ = 0;
+  remote_length_ = 0;
+}
+
+bool RdmaConnection::PostReceive() {
+  struct ibv_recv_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  struct ibv_recv_wr *bad = NULL;
+  // Immediate data needs no buffer.
+  if (ibv_post_recv(qp_, &wr, &bad)) {
+    logprintf(0, "Process Error: Cannot post RDMA receive\n");
+    return false;
+  }
+  return true;
+}
+
+bool RdmaConnection::WaitSend(const char *what) {
+  int64 deadline = sat_get_time_us() + kTimeoutMs * 1000LL;
+  struct ibv_wc wc;
+  int polled;
+  while ((polled = ibv_poll_cq(send_cq_, 1, &wc)) == 0) {
+    if (sat_get_time_us() > deadline) {
+      logprintf(0, "Process Error: RDMA %s timed out\n", what);
+      return false;
+    }
+  }
+  if (polled < 0 || wc.status != IBV_WC_SUCCESS) {
+    logprintf(0, "Process Error: RDMA %s failed: %s\n", what,
+              polled < 0 ? "poll error" : ibv_wc_status_str(wc.status));
+    return false;
+  }
+  return true;
+}
+
+bool RdmaConnection::Write(const void *local, uint64 length, uint32 imm) {
+  if (length > remote_length_ || !device_->Contains(local, length))
+    return false;
+  struct ibv_sge sge;
+  sge.addr = reinterpret_cast<uintptr_t>(local);
+  sge.length = length;
+  sge.lkey = device_->arena_mr_->lkey;
+  struct ibv_send_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  wr.sg_list = &sge;
+  wr.num_sge = 1;
+  wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+  wr.send_flags = IBV_SEND_SIGNALED;
+  wr.imm_data = htonl(imm);
+  wr.wr.rdma.remote_addr = remote_addr_;
+  wr.wr.rdma.rkey = remote_rkey_;
+  struct ibv_send_wr *bad = NULL;
+  if (ibv_post_send(qp_, &wr, &bad)) {
+    logprintf(0, "Process Error: Cannot post RDMA write\n");
+    return false;
+  }
+  return WaitSend("write");
+}
+
+bool RdmaConnection::Read(void *local, uint64 length) {
+  if (length > remote_length_ || !device_->Contains(local, length))
+    return false;
+  struct ibv_sge sge;
+  sge.addr = reinterpret_cast<uintptr_t>(local);
+  sge.length = length;
+  sge.lkey = device_->arena_mr_->lkey;
+  struct ibv_send_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  wr.sg_list = &sge;
+  wr.num_sge = 1;
+  wr.opcode = IBV_WR_RDMA_READ;
+  wr.send_flags = IBV_SEND_SIGNALED;
+  wr.wr.rdma.remote_addr = remote_addr_;
+  wr.wr.rdma.rkey = remote_rkey_;
+  struct ibv_send_wr *bad = NULL;
+  if (ibv_post_send(qp_, &wr, &bad)) {
+    logprintf(0, "Process Error: Cannot post RDMA read\n");
+    return false;
+  }
+  return WaitSend("read");
+}
+
+bool RdmaConnection::Send(uint32 imm) {
+  struct ibv_send_wr wr;
+  memset(&wr, 0, sizeof(wr));
+  wr.opcode = IBV_WR_SEND_WITH_IMM;
+  wr.send_flags = IBV_SEND_SIGNALED;
+  wr.imm_data = htonl(imm);
+  struct ibv_send_wr *bad = NULL;
+  if (ibv_post_send(qp_, &wr, &bad)) {
+    logprintf(0, "Process Error: Cannot post RDMA send\n");
+    return false;
+  }
+  return WaitSend("send");
+}
+
+int RdmaConnection::Receive(uint32 *imm, int timeout_ms) {
+  int64 start = sat_get_time_us();
+  int64 deadline = start + timeout_ms * 1000LL;
+  struct ibv_wc wc;
+  int polled;
+  while ((polled = ibv_poll_cq(recv_cq_, 1, &wc)) == 0) {
+    int64 now = sat_get_time_us();
+    if (now > deadline)
+      return 0;
+    // Spin while a reply is likely to be close, then back off.
+    if (now - start > 1000)
+      sat_usleep(100);
+  }
+  if (polled < 0 || wc.status != IBV_WC_SUCCESS) {
+    logprintf(0, "Process Error: RDMA receive failed: %s\n",
+              polled < 0 ? "poll error" : ibv_wc_status_str(wc.status));
+    return -1;
+  }
+  *imm = ntohl(wc.imm_data);
+  return PostReceive() ? 1 : -1;
+}
+
+#else  // !STRESSAPPTEST_NET_RDMA
+
+bool RdmaDevice::Open(void *base, uint64 length) {
+  logprintf(0, "Process Error: RDMA support was not compiled in\n");
+  return false;
+}
+
+void RdmaDevice::Close() {
+}
+
+bool RdmaConnection::Connect(RdmaDevice *device, int sock, void *exposed,
+                             uint64 exposed_length) {
+  return false;
+}
+
+void RdmaConnection::Close() {
+}
+
+bool RdmaConnection::Write(const void *local, uint64 length, uint32 imm) {
+  return false;
+}
+
+bool RdmaConnection::Read(void *local, uint64 length) {
+  return false;
+}
+
+bool RdmaConnection::Send(uint32 imm) {
+  return false;
+}
+
+int RdmaConnection::Receive(uint32 *imm, int timeout_ms) {
+  return -1;
+}
+
+#endif  // STRESSAPPTEST_NET_RDMA
@@ -0,0 +1,142 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// RDMA verbs transport for the network threads, so that pages move by NIC
+// DMA straight between the test memory of two hosts.
+
+#ifndef STRESSAPPTEST_NET_RDMA_H_
+#define STRESSAPPTEST_NET_RDMA_H_
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+struct ibv_context;
+struct ibv_pd;
+struct ibv_mr;
+struct ibv_cq;
+struct ibv_qp;
+
+// One RDMA device port with the whole test memory registered on it, shared
+// by every network thread. Registering once pins the arena up front, so
+// pages go straight from the page queues to the wire.
+class RdmaDevice {
+ public:
+  RdmaDevice();
+  ~RdmaDevice();
+
+  // Returns true if verbs support was compiled in.
+  static bool Available();
+
+  // Set the device from "<name>[:<port>[:<gid index>]]". Returns false if
+  // it doesn't parse. Without it the first device, port 1, gid 0 is used.
+  bool Parse(const char *description);
+
+  // Open the device and register 'length' bytes at 'base'. Returns false
+  // on failure.
+  bool Open(void *base, uint64 length);
+  void Close();
+  bool opened() const { return pd_ != NULL; }
+
+  // Returns true if 'length' bytes at 'addr' are in the registered arena.
+  bool Contains(const void *addr, uint64 length) const;
+
+  // The device name, for messages.
+  const string &name() const { return name_; }
+
+ private:
+  friend class RdmaConnection;
+
+  string name_;               // Device name, empty for the first one.
+  int port_;                  // Port number, from 1.
+  int gid_index_;             // Source GID, for RoCE.
+  struct ibv_context *context_;
+  struct ibv_pd *pd_;
+  struct ibv_mr *arena_mr_;   // The test memory.
+  char *base_;
+  uint64 length_;
+  int lid_;                   // Port LID, 0 on RoCE.
+  int mtu_;                   // Active path MTU, as an ibv_mtu.
+  unsigned char gid_[16];
+
+  DISALLOW_COPY_AND_ASSIGN(RdmaDevice);
+};
+
+// A reliable connected queue pair to one peer. The queue pair details are
+// swapped over the thread's TCP connection, which stays open so that either
+// side can tell when the other one is gone.
+//
+// The sender RDMA writes a page into the buffer its peer exposed, with the
+// pattern as immediate data. The peer checks the page against that pattern
+// and sends back its miscompare count, then the sender RDMA reads the page
+// back and checks it itself. Operations wait for their completions one at
+// a time.
+//
+// Not threadsafe, each network thread owns its own connection.
+class RdmaConnection {
+ public:
+  RdmaConnection();
+  ~RdmaConnection();
+
+  // Create the queue pair on 'device' and connect it with the peer on 'sock'.
+  // 'exposed' is a buffer of 'exposed_length' bytes the peer may write and
+  // read, or NULL. Returns false on failure.
+  bool Connect(RdmaDevice *device, int sock, void *exposed,
+               uint64 exposed_length);
+  void Close();
+
+  // Write 'length' bytes at 'local' into the peer's buffer, with 'imm' as
+  // immediate data for it to receive. 'local' must be in the arena.
+  bool Write(const void *local, uint64 length, uint32 imm);
+  // Read 'length' bytes from the peer's buffer into 'local', in the arena.
+  bool Read(void *local, uint64 length);
+  // Send just 'imm' to the peer.
+  bool Send(uint32 imm);
+  // Wait up to 'timeout_ms' for immediate data from the peer. Returns 1 if
+  // some arrived, 0 on timeout, -1 on failure.
+  int Receive(uint32 *imm, int timeout_ms);
+
+  // Size of the peer's exposed buffer.
+  uint64 remote_length() const { return remote_length_; }
+
+ private:
+  // Receives posted at any one time.
+  static const int kReceives = 16;
+  // Longest a single operation may take.
+  static const int kTimeoutMs = 10000;
+
+  // Post a receive for immediate data.
+  bool PostReceive();
+  // Wait for the completion of the last send queue operation.
+  bool WaitSend(const char *what);
+  // Move the queue pair to ready to send, aimed at the peer.
+  bool Activate(uint32 qpn, uint32 psn, int lid, const unsigned char *gid);
+
+  RdmaDevice *device_;
+  struct ibv_cq *send_cq_;
+  struct ibv_cq *recv_cq_;
+  struct ibv_qp *qp_;
+  struct ibv_mr *exposed_mr_;  // Buffer the peer accesses, or NULL.
+  uint64 remote_addr_;         // Peer's exposed buffer.
+  uint32 remote_rkey_;
+  uint64 remote_length_;
+  uint32 psn_;                 // Our first packet sequence number.
+
+  DISALLOW_COPY_AND_ASSIGN(RdmaConnection);
+};
+
+#endif  // STRESSAPPTEST_NET_RDMA_H_
@@ -24,30 +24,68 @@
 #include <fcntl.h>
 #include <linux/types.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #ifdef HAVE_SYS_SHM_H
 #include <sys/shm.h>
+#include <sys/vfs.h>
 #endif
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
 #ifndef SHM_HUGETLB
 #define SHM_HUGETLB      04000  // remove when glibc defines it
 #endif
 
+#ifndef MPOL_BIND
+#define MPOL_BIND        2      // From linux/mempolicy.h.
+#endif
+
+// Hugepage flags for older headers.
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB      0x40000
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT   26
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB      4      // Takes its page size at MAP_HUGE_SHIFT too.
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE    14
+#endif
+
+#if defined(STRESSAPPTEST_CPU_AARCH64)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32      (1 << 7)
+#endif
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <set>
 #include <string>
 #include <list>
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
 #include "sattypes.h"
+#include "cpu_topology.h"
+#include "dram_map.h"
 #include "error_diag.h"
+#include "edac_monitor.h"
 #include "clock.h"
 
 // OsLayer initialization.
@@ -62,8 +100,14 @@ OsLayer::OsLayer() {
   use_posix_shm_ = false;
   dynamic_mapped_shmem_ = false;
   mmapped_allocation_ = false;
+  mmapped_length_ = 0;
+  hugepage_mode_ = kHugepageShm;
+  hugepage_size_ = 0;
+  numa_alloc_ = false;
+  numa_slab_size_ = 0;
   shmid_ = 0;
   channels_ = NULL;
+  channel_map_ = NULL;
 
   time_initialized_ = 0;
 
@@ -80,11 +124,17 @@ OsLayer::OsLayer() {
   address_mode_ = sizeof(pvoid) * 8;
 
   has_clflush_ = false;
+  has_clflushopt_ = false;
+  has_clwb_ = false;
+  has_crc32c_ = false;
   has_vector_ = false;
+  has_avx2_ = false;
+  has_avx512_ = false;
 
   use_flush_page_cache_ = false;
 
   clock_ = NULL;
+  edac_ = NULL;
 }
 
 // OsLayer cleanup.
@@ -93,6 +143,7 @@ OsLayer::~OsLayer() {
     delete error_diagnoser_;
   if (clock_)
     delete clock_;
+  delete edac_;
 }
 
 // OsLayer initialization.
@@ -110,6 +161,11 @@ bool OsLayer::Initialize() {
     num_cpus_ = sysconf(_SC_NPROCESSORS_ONLN);
     num_cpus_per_node_ = num_cpus_ / num_nodes_;
   }
+  if (numa_alloc_ && !FindNumaNodes()) {
+    logprintf(0, "Log: Can't read the NUMA layout, "
+                 "allocating test memory as one buffer.\n");
+    numa_alloc_ = false;
+  }
   logprintf(5, "Log: %d nodes, %d cpus.\n", num_nodes_, num_cpus_);
   cpu_sets_.resize(num_nodes_);
   cpu_sets_valid_.resize(num_nodes_);
@@ -140,6 +196,10 @@ int OsLayer::AddressMode() {
 
 // Translates user virtual to physical address.
 uint64 OsLayer::VirtualToPhysical(void *vaddr) {
+  // Test memory is translated through the cached index.
+  if (pagemap_.Contains(vaddr))
+    return pagemap_.VirtualToPhysical(vaddr);
+
   uint64 frame, paddr, pfnmask, pagemask;
   int pagesize = sysconf(_SC_PAGESIZE);
   off64_t off = ((uintptr_t)vaddr) / pagesize * 8;
@@ -178,6 +238,15 @@ uint64 OsLayer::VirtualToPhysical(void *vaddr) {
   return paddr;
 }
 
+void OsLayer::VirtualToPhysicalBulk(void *const *vaddrs, int count,
+                                    uint64 *paddrs) {
+  pagemap_.VirtualToPhysicalBulk(vaddrs, count, paddrs);
+}
+
+int64 OsLayer::FindTestMemOffset(uint64 paddr) {
+  return pagemap_.PhysicalToOffset(paddr);
+}
+
 // Returns the HD device that contains this file.
 string OsLayer::FindFileDevice(string filename) {
   return "hdUnknown";
@@ -190,6 +259,128 @@ list<string> OsLayer::FindFileDevices() {
   return locations;
 }
 
+namespace {
+// Returns the entries of directory 'path', without . and ..
+vector<string> ListDirectory(const string &path) {
+  vector<string> entries;
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return entries;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+      entries.push_back(entry->d_name);
+  }
+  closedir(dir);
+  return entries;
+}
+
+// Returns the "major:minor" numbers of every mounted and swap device.
+// Mounts are matched by number, the root device may be named /dev/root.
+set<string> FindUsedDevices() {
+  set<string> used;
+  std::ifstream mounts("/proc/self/mountinfo");
+  string id, parent, numbers, line;
+  while (mounts >> id >> parent >> numbers) {
+    used.insert(numbers);
+    std::getline(mounts, line);
+  }
+  std::ifstream swaps("/proc/swaps");
+  string path;
+  while (swaps >> path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISBLK(st.st_mode)) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%u:%u", major(st.st_rdev),
+               minor(st.st_rdev));
+      used.insert(buf);
+    }
+    std::getline(swaps, line);
+  }
+  return used;
+}
+}  // namespace
+
+list<string> OsLayer::FindDiskDevices() {
+  list<string> devices;
+  set<string> used = FindUsedDevices();
+
+  // Virtual, removable and stacked devices are never tested.
+  static const char *kSkipped[] = {
+    "loop", "ram", "zram", "dm-", "md", "sr", "fd", "nbd", "mtd", NULL
+  };
+  vector<string> disks = ListDirectory("/sys/block");
+  std::sort(disks.begin(), disks.end());
+  for (size_t i = 0; i < disks.size(); i++) {
+    const string &disk = disks[i];
+    bool skip = false;
+    for (int j = 0; kSkipped[j] && !skip; j++)
+      skip = !disk.compare(0, strlen(kSkipped[j]), kSkipped[j]);
+    string base = "/sys/block/" + disk;
+    std::ifstream removable((base + "/removable").c_str());
+    std::ifstream read_only((base + "/ro").c_str());
+    int is_removable = 0, is_read_only = 0;
+    if ((removable >> is_removable && is_removable) ||
+        (read_only >> is_read_only && is_read_only))
+      skip = true;
+    if (skip)
+      continue;
+
+    // The disk and each of its partitions must be unused.
+    vector<string> parts(1, disk);
+    vector<string> entries = ListDirectory(base);
+    for (size_t j = 0; j < entries.size(); j++) {
+      if (!entries[j].compare(0, disk.size(), disk))
+        parts.push_back(entries[j]);
+    }
+    for (size_t j = 0; j < parts.size() && !skip; j++) {
+      string dir = j ? base + "/" + parts[j] : base;
+      std::ifstream dev((dir + "/dev").c_str());
+      string numbers;
+      // Unreadable devices count as used.
+      if (!(dev >> numbers) || used.count(numbers) ||
+          !ListDirectory(dir + "/holders").empty())
+        skip = true;
+    }
+    if (skip) {
+      logprintf(12, "Log: Disk %s is in use, not testing it\n",
+                disk.c_str());
+      continue;
+    }
+    devices.push_back("/dev/" + disk);
+  }
+  return devices;
+}
+
+int OsLayer::FindDiskNode(const string &device, cpu_set_t *cpus) {
+  // A partition's node is its disk's node.
+  string name = device.substr(device.rfind('/') + 1);
+  char path[256];
+  snprintf(path, sizeof(path), "/sys/class/block/%s/partition", name.c_str());
+  if (access(path, F_OK) == 0)
+    snprintf(path, sizeof(path), "/sys/class/block/%s/../device/numa_node",
+             name.c_str());
+  else
+    snprintf(path, sizeof(path), "/sys/class/block/%s/device/numa_node",
+             name.c_str());
+  std::ifstream file(path);
+  int node = -1;
+  if (!(file >> node) || node < 0)
+    return -1;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+           node);
+  vector<int> ids;
+  if (!ReadSysfsList(path, &ids) || ids.empty())
+    return -1;
+  CPU_ZERO(cpus);
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (ids[i] < CPU_SETSIZE)
+      CPU_SET(ids[i], cpus);
+  }
+  return node;
+}
+
 
 // Get HW core features from cpuid instruction.
 void OsLayer::GetFeatures() {
@@ -198,16 +389,53 @@ void OsLayer::GetFeatures() {
   cpuid(&eax, &ebx, &ecx, &edx);
   has_clflush_ = (edx >> 19) & 1;
   has_vector_ = (edx >> 26) & 1;  // SSE2 caps bit.
+  has_crc32c_ = (ecx >> 20) & 1;  // SSE4.2 caps bit.
 
   logprintf(9, "Log: has clflush: %s, has sse2: %s\n",
             has_clflush_ ? "true" : "false",
             has_vector_ ? "true" : "false");
+
+#if defined(STRESSAPPTEST_CPU_X86_64)
+  // Wide vector state must be enabled by the OS, not only by the cpu.
+  bool os_avx = false;
+  bool os_avx512 = false;
+  if ((ecx >> 27) & 1) {  // OSXSAVE caps bit.
+    unsigned int xcr0_lo, xcr0_hi;
+    asm volatile("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    os_avx = (xcr0_lo & 0x6) == 0x6;        // XMM and YMM state.
+    os_avx512 = (xcr0_lo & 0xe6) == 0xe6;   // Plus opmask and ZMM state.
+  }
+
+  eax = 0;
+  cpuid(&eax, &ebx, &ecx, &edx);
+  if (eax >= 7) {
+    eax = 7;
+    cpuid(&eax, &ebx, &ecx, &edx);
+    has_avx2_ = os_avx && ((ebx >> 5) & 1);
+    has_avx512_ = os_avx512 && ((ebx >> 16) & 1);
+    has_clflushopt_ = (ebx >> 23) & 1;
+    has_clwb_ = (ebx >> 24) & 1;
+  }
+
+  logprintf(9, "Log: has avx2: %s, has avx512f: %s\n",
+            has_avx2_ ? "true" : "false",
+            has_avx512_ ? "true" : "false");
+  logprintf(9, "Log: has clflushopt: %s, has clwb: %s\n",
+            has_clflushopt_ ? "true" : "false",
+            has_clwb_ ? "true" : "false");
+#endif
 #elif defined(STRESSAPPTEST_CPU_PPC)
   // All PPC implementations have cache flush instructions.
   has_clflush_ = true;
 #elif defined(STRESSAPPTEST_CPU_MIPS)
   // All MIPS implementations have cache flush instructions.
   has_clflush_ = true;
+#elif defined(STRESSAPPTEST_CPU_AARCH64)
+  // Advanced SIMD is mandatory on ARMv8.
+  has_vector_ = true;
+  // The crc instructions are optional before ARMv8.1.
+  has_crc32c_ = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+  logprintf(9, "Log: has crc32: %s\n", has_crc32c_ ? "true" : "false");
 #elif defined(STRESSAPPTEST_CPU_ARMV7A)
   // TODO(nsanders): add detect from /proc/cpuinfo or /proc/self/auxv.
   // For now assume neon and don't run -W if you don't have it.
@@ -258,6 +486,59 @@ bool OsLayer::FlushPageCache(void) {
   return true;
 }
 
+bool OsLayer::EvictFileCache(int fd, int64 offset, int64 length,
+                             bool verify) {
+#if defined(POSIX_FADV_DONTNEED) && defined(SYNC_FILE_RANGE_WRITE)
+  // Files on tmpfs live in the page cache, nothing reads them from a disk.
+  static const int64 kTmpfsMagic = 0x01021994;
+  struct statfs fs;
+  if (verify && !fstatfs(fd, &fs) && fs.f_type == kTmpfsMagic) {
+    logprintf(6, "Log: file is on tmpfs, reads will come from memory\n");
+    return true;
+  }
+
+  // DONTNEED skips dirty pages, so wait for them to be written first.
+  if (sync_file_range(fd, offset, length, SYNC_FILE_RANGE_WAIT_BEFORE |
+                      SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER)) {
+    int err = errno;
+    logprintf(6, "Log: sync_file_range failed - err %d (%s)\n", err,
+              ErrorString(err).c_str());
+    return false;
+  }
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+  if (err) {
+    logprintf(6, "Log: posix_fadvise failed - err %d (%s)\n", err,
+              ErrorString(err).c_str());
+    return false;
+  }
+  if (!verify || length <= 0)
+    return true;
+
+  // Count what's still resident.
+  int64 page = sysconf(_SC_PAGESIZE);
+  int64 start = offset / page * page;
+  int64 span = offset + length - start;
+  void *map = mmap(NULL, span, PROT_READ, MAP_SHARED, fd, start);
+  if (map == MAP_FAILED)
+    return true;  // Can't tell, trust the kernel.
+  int64 pages = (span + page - 1) / page;
+  vector<unsigned char> resident(pages);
+  int64 cached = 0;
+  if (!mincore(map, span, &resident[0])) {
+    for (int64 i = 0; i < pages; i++)
+      cached += resident[i] & 1;
+  }
+  munmap(map, span);
+  if (cached) {
+    logprintf(6, "Log: %lld of %lld pages stayed cached after "
+              "posix_fadvise\n", cached, pages);
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
 
 // We need to flush the cacheline here.
 void OsLayer::Flush(void *vaddr) {
@@ -273,19 +554,114 @@ void OsLayer::Flush(void *vaddr) {
 bool OsLayer::AdlerMemcpyWarm(uint64 *dstmem, uint64 *srcmem,
                               unsigned int size_in_bytes,
                               AdlerChecksum *checksum) {
-  if (has_vector_) {
+  if (has_avx512_) {
+    return AdlerMemcpyAvx512(dstmem, srcmem, size_in_bytes, checksum);
+  } else if (has_avx2_) {
+    return AdlerMemcpyAvx2(dstmem, srcmem, size_in_bytes, checksum);
+  } else if (has_vector_) {
+#if defined(__aarch64__)
+    return AdlerMemcpyNeon(dstmem, srcmem, size_in_bytes, checksum);
+#else
     return AdlerMemcpyAsm(dstmem, srcmem, size_in_bytes, checksum);
+#endif
   } else {
     return AdlerMemcpyWarmC(dstmem, srcmem, size_in_bytes, checksum);
   }
 }
 
 
+// Run C or vector compare as appropriate.
+unsigned int OsLayer::PatternCompare(const uint64 *mem,
+                                     const uint64 *expected,
+                                     unsigned int words,
+                                     uint64 *mismatch) {
+  if (has_avx512_) {
+    return PatternCompareAvx512(mem, expected, words, mismatch);
+  } else if (has_avx2_) {
+    return PatternCompareAvx2(mem, expected, words, mismatch);
+  } else {
+    return PatternCompareC(mem, expected, words, mismatch);
+  }
+}
+
+
+// Run the C or hardware CRC32C copy as appropriate.
+bool OsLayer::Crc32cMemcpy(uint64 *dstmem, uint64 *srcmem,
+                           unsigned int size_in_bytes,
+                           AdlerChecksum *checksum) {
+  if (has_crc32c_)
+    return Crc32cMemcpyHw(dstmem, srcmem, size_in_bytes, checksum);
+  return Crc32cMemcpyC(dstmem, srcmem, size_in_bytes, checksum);
+}
+
+
+// Run C or vector invert as appropriate.
+void OsLayer::InvertMemory(void *mem, unsigned int size, bool down) {
+  if (has_avx2_) {
+    InvertMemoryAvx2(mem, size, down);
+  } else if (has_vector_) {
+    InvertMemoryVector(mem, size, down);
+  } else {
+    InvertMemoryC(mem, size, down);
+  }
+}
+
+
+// Flush a range of cachelines behind one fence. Unlike FastFlush() this
+// doesn't order the flushes against earlier loads, only against the
+// stores to the same lines, which is all a batch of writes needs.
+void OsLayer::FlushRange(void *vaddr, unsigned int size, bool writeback) {
+  char *addr = static_cast<char*>(vaddr);
+  char *end = addr + size;
+#if defined(STRESSAPPTEST_CPU_X86_64) || defined(STRESSAPPTEST_CPU_I686)
+  // Encoded by hand so that older assemblers don't need the mnemonics:
+  // clwb is 66 0f ae /6 and clflushopt is 66 0f ae /7.
+  if (writeback && has_clwb_) {
+    for (; addr < end; addr += 64)
+      asm volatile(".byte 0x66; xsaveopt (%0)" : : "r" (addr) : "memory");
+    asm volatile("sfence" : : : "memory");
+  } else if (has_clflushopt_) {
+    for (; addr < end; addr += 64)
+      asm volatile(".byte 0x66; clflush (%0)" : : "r" (addr) : "memory");
+    asm volatile("sfence" : : : "memory");
+  } else if (has_clflush_) {
+    // Plain clflush is only ordered by mfence.
+    for (; addr < end; addr += 64)
+      asm volatile("clflush (%0)" : : "r" (addr) : "memory");
+    asm volatile("mfence" : : : "memory");
+  }
+#elif defined(STRESSAPPTEST_CPU_AARCH64)
+  // Smallest data cacheline, log2 of words in CTR_EL0.DminLine.
+  uint64 ctr;
+  asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+  unsigned int line = 4 << ((ctr >> 16) & 0xf);
+  addr -= reinterpret_cast<uintptr_t>(addr) & (line - 1);
+  if (writeback) {
+    for (; addr < end; addr += line)
+      asm volatile("dc cvac, %0" : : "r" (addr) : "memory");
+  } else {
+    for (; addr < end; addr += line)
+      asm volatile("dc civac, %0" : : "r" (addr) : "memory");
+  }
+  asm volatile("dsb ish" : : : "memory");
+#else
+  for (; addr < end; addr += 32)
+    FastFlushHint(addr);
+  FastFlushSync();
+#endif
+}
+
+
 // Translate physical address to memory module/chip name.
 // Assumes interleaving between two memory channels based on the XOR of
 // all address bits in the 'channel_hash' mask, with repeated 'channel_width_'
 // blocks with bits distributed from each chip in that channel.
 int OsLayer::FindDimm(uint64 addr, char *buf, int len) {
+  if (!channels_ && channel_map_ && channel_map_->enabled()) {
+    snprintf(buf, len, "Channel %d Rank %d", channel_map_->Channel(addr),
+             channel_map_->Rank(addr));
+    return 1;
+  }
   if (!channels_) {
     snprintf(buf, len, "DIMM Unknown");
     return -1;
@@ -334,6 +710,17 @@ int32 OsLayer::FindRegion(uint64 addr) {
   return region_num;
 }
 
+// Per node test memory is laid out as consecutive slabs, one per region.
+int32 OsLayer::FindNumaRegion(uint64 offset) {
+  if (!numa_slab_size_)
+    return -1;
+  int64 region = offset / numa_slab_size_;
+  // The last slab also holds the remainder.
+  if (region >= num_nodes_)
+    region = num_nodes_ - 1;
+  return region;
+}
+
 // Report which cores are associated with a given region.
 cpu_set_t *OsLayer::FindCoreMask(int32 region) {
   sat_assert(region >= 0);
@@ -407,6 +794,111 @@ int64 OsLayer::FindHugePages() {
   return pages;
 }
 
+namespace {
+// Bind 'length' bytes at 'addr' to NUMA node 'node'.
+// Returns false and sets errno on failure.
+bool BindToNode(void *addr, uint64 length, int node) {
+#ifdef __NR_mbind
+  static const int kNodeMaskBits = 1024;
+  static const int kBitsPerLong = 8 * sizeof(unsigned long);  // NOLINT
+  unsigned long mask[kNodeMaskBits / kBitsPerLong];  // NOLINT
+  if (node < 0 || node >= kNodeMaskBits) {
+    errno = EINVAL;
+    return false;
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+  // The kernel reads maxnode - 1 bits of the mask.
+  return syscall(__NR_mbind, addr, length, MPOL_BIND, mask,
+                 kNodeMaskBits + 1, 0) == 0;
+#else
+  errno = ENOSYS;
+  return false;
+#endif
+}
+
+// One slab of per node test memory, and the cpus that fault it in.
+struct NumaSlab {
+  char *start;
+  int64 length;
+  cpu_set_t cpus;
+};
+
+// Fault in every page of a slab from the slab's own node, so memory that
+// couldn't be bound still lands there by first touch.
+void *TouchNumaSlab(void *arg) {
+  struct NumaSlab *slab = static_cast<struct NumaSlab*>(arg);
+#ifdef HAVE_SCHED_GETAFFINITY
+  if (sched_setaffinity(0, sizeof(slab->cpus), &slab->cpus))
+    logprintf(3, "Log: Can't pin NUMA first touch thread: %s\n",
+              strerror(errno));
+#endif
+  int64 page = sysconf(_SC_PAGESIZE);
+  volatile char *mem = slab->start;
+  for (int64 i = 0; i < slab->length; i += page)
+    mem[i] = 0;
+  return NULL;
+}
+
+// A stretch of test memory to give back to the kernel.
+struct ReleaseSlice {
+  char *start;
+  int64 length;
+  int advice;
+};
+
+void *ReleaseTestMemSlice(void *arg) {
+  struct ReleaseSlice *slice = static_cast<struct ReleaseSlice*>(arg);
+  madvise(slice->start, slice->length, slice->advice);
+  return NULL;
+}
+}  // namespace
+
+// Regions are the online nodes that have cpus, memory only nodes can't
+// do their own first touch.
+bool OsLayer::FindNumaNodes() {
+  vector<int> nodes;
+  if (!ReadSysfsList("/sys/devices/system/node/online", &nodes) ||
+      nodes.empty())
+    return false;
+
+  vector<int> node_ids;
+  vector<cpu_set_t> node_cpus;
+  for (uint i = 0; i < nodes.size(); i++) {
+    // Region tags are single bits of an int32.
+    if (node_ids.size() == 32) {
+      logprintf(0, "Log: Only using the first 32 NUMA nodes.\n");
+      break;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             nodes[i]);
+    vector<int> cpus;
+    if (!ReadSysfsList(path, &cpus) || cpus.empty())
+      continue;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (uint j = 0; j < cpus.size(); j++) {
+      if (cpus[j] < CPU_SETSIZE)
+        CPU_SET(cpus[j], &cpuset);
+    }
+    node_ids.push_back(nodes[i]);
+    node_cpus.push_back(cpuset);
+  }
+  if (node_ids.empty())
+    return false;
+
+  numa_node_ids_ = node_ids;
+  num_nodes_ = node_ids.size();
+  num_cpus_per_node_ = num_cpus_ / num_nodes_;
+  cpu_sets_ = node_cpus;
+  cpu_sets_valid_.assign(num_nodes_, true);
+  for (int region = 0; region < num_nodes_; region++)
+    logprintf(5, "Log: NUMA region %d is node %d, cpus 0x%s\n", region,
+              numa_node_ids_[region], FindCoreMaskFormat(region).c_str());
+  return true;
+}
+
 int64 OsLayer::FindFreeMemSize() {
   int64 size = 0;
   int64 minsize = 0;
@@ -502,6 +994,179 @@ int64 OsLayer::AllocateAllMem() {
     return 0;
 }
 
+// Hugetlb mappings must be whole pages, so the mapping may be longer than
+// the test memory.
+void *OsLayer::AllocateHugeMem(int64 length) {
+  int64 page_size = hugepage_size_ ? hugepage_size_ : 2 * kMegabyte;
+  int64 map_length = (length + page_size - 1) / page_size * page_size;
+  // Both mmap and memfd_create take log2 of the page size.
+  int size_flags = 0;
+  if (hugepage_size_ && hugepage_mode_ != kHugepageThp) {
+    int shift = 0;
+    while ((1LL << shift) < hugepage_size_)
+      shift++;
+    size_flags = shift << MAP_HUGE_SHIFT;
+  }
+
+  const char *method = "";
+  void *buf = MAP_FAILED;
+  if (hugepage_mode_ == kHugepageMmap) {
+    method = "MAP_HUGETLB";
+    buf = mmap(NULL, map_length, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flags, -1, 0);
+  } else if (hugepage_mode_ == kHugepageMemfd) {
+    method = "memfd hugetlb";
+#ifdef __NR_memfd_create
+    int fd = syscall(__NR_memfd_create, "stressapptest",
+                     MFD_HUGETLB | size_flags);
+    if (fd >= 0) {
+      if (ftruncate(fd, map_length) == 0)
+        buf = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+      // The mapping keeps the file alive.
+      int err = errno;
+      close(fd);
+      errno = err;
+    }
+#else
+    errno = ENOSYS;
+#endif
+  } else if (hugepage_mode_ == kHugepageThp) {
+    method = "transparent hugepage";
+    // Map one extra page so the buffer can start on a hugepage boundary,
+    // then trim the ends.
+    void *raw = mmap(NULL, map_length + page_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw != MAP_FAILED) {
+      char *start = static_cast<char*>(raw);
+      char *aligned = reinterpret_cast<char*>(
+          (reinterpret_cast<uintptr_t>(start) + page_size - 1) &
+          ~static_cast<uintptr_t>(page_size - 1));
+      if (aligned > start)
+        munmap(start, aligned - start);
+      if (start + page_size > aligned)
+        munmap(aligned + map_length, start + page_size - aligned);
+      buf = aligned;
+      if (madvise(buf, map_length, MADV_HUGEPAGE)) {
+        int err = errno;
+        logprintf(3, "Log: madvise(MADV_HUGEPAGE) failed - err %d (%s), "
+                     "check /sys/kernel/mm/transparent_hugepage/enabled\n",
+                  err, ErrorString(err).c_str());
+      }
+    }
+  }
+
+  if (buf == MAP_FAILED) {
+    int err = errno;
+    logprintf(3, "Log: failed to allocate %s memory - err %d (%s)\n",
+              method, err, ErrorString(err).c_str());
+    return NULL;
+  }
+  mmapped_length_ = map_length;
+  logprintf(0, "Log: Using %s allocation at %p, %lldkB pages requested.\n",
+            method, buf, page_size / 1024);
+  return buf;
+}
+
+// Slabs are bound before anything touches them, so the kernel places every
+// page on the slab's node even when first touch from that node isn't
+// possible.
+void *OsLayer::AllocateNumaMem(int64 length) {
+  // Whole 2MB slabs keep transparent hugepages from straddling two nodes.
+  int64 slab_size = (length / num_nodes_) & ~(2 * kMegabyte - 1);
+  if (slab_size == 0) {
+    logprintf(0, "Log: %lldMB is too little memory to split over "
+                 "%d NUMA nodes.\n", length / kMegabyte, num_nodes_);
+    return NULL;
+  }
+
+  void *buf = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED) {
+    logprintf(0, "Process Error: NUMA allocation mmap failed: %s\n",
+              strerror(errno));
+    return NULL;
+  }
+
+  vector<struct NumaSlab> slabs(num_nodes_);
+  for (int region = 0; region < num_nodes_; region++) {
+    struct NumaSlab *slab = &slabs[region];
+    slab->start = static_cast<char*>(buf) + region * slab_size;
+    slab->length = (region == num_nodes_ - 1) ?
+                   length - region * slab_size : slab_size;
+    slab->cpus = *FindCoreMask(region);
+    if (!BindToNode(slab->start, slab->length, numa_node_ids_[region]))
+      logprintf(3, "Log: Can't bind region %d to node %d: %s, "
+                   "relying on first touch.\n",
+                region, numa_node_ids_[region], strerror(errno));
+  }
+
+  // Touch all slabs at once, each from its own node.
+  vector<pthread_t> threads(num_nodes_);
+  vector<bool> started(num_nodes_);
+  for (int region = 0; region < num_nodes_; region++) {
+    started[region] = pthread_create(&threads[region], NULL, TouchNumaSlab,
+                                     &slabs[region]) == 0;
+    if (!started[region])
+      TouchNumaSlab(&slabs[region]);
+  }
+  for (int region = 0; region < num_nodes_; region++) {
+    if (started[region])
+      pthread_join(threads[region], NULL);
+  }
+
+  numa_slab_size_ = slab_size;
+  logprintf(0, "Log: Using NUMA allocation at %p, %d slabs of %lldMB.\n",
+            buf, num_nodes_, slab_size / kMegabyte);
+  return buf;
+}
+
+void *OsLayer::AllocatePinnedMem(int64 length, int node, int64 *mapped) {
+  static const int64 kHugepageSize = 2 * kMegabyte;
+  int64 map_length = (length + kHugepageSize - 1) & ~(kHugepageSize - 1);
+  const char *method = "MAP_HUGETLB";
+  void *buf = mmap(NULL, map_length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (buf == MAP_FAILED) {
+    // Without reserved hugepages, ask for a transparent one on an aligned
+    // stretch of a mapping one hugepage larger.
+    method = "transparent hugepage";
+    char *raw = static_cast<char*>(mmap(NULL, map_length + kHugepageSize,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+      int err = errno;
+      logprintf(0, "Process Error: pinned memory mmap failed: %s\n",
+                ErrorString(err).c_str());
+      return NULL;
+    }
+    char *aligned = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(raw) + kHugepageSize - 1) &
+        ~static_cast<uintptr_t>(kHugepageSize - 1));
+    if (aligned > raw)
+      munmap(raw, aligned - raw);
+    if (raw + kHugepageSize > aligned)
+      munmap(aligned + map_length, raw + kHugepageSize - aligned);
+    buf = aligned;
+    if (madvise(buf, map_length, MADV_HUGEPAGE))
+      method = "small page";
+  }
+
+  // Bind before the first touch places the pages.
+  if (node >= 0 && !BindToNode(buf, map_length, node)) {
+    int err = errno;
+    logprintf(3, "Log: Can't bind pinned memory to node %d: %s, relying on "
+                 "first touch.\n", node, ErrorString(err).c_str());
+  }
+  memset(buf, 0, map_length);
+  // Locked memory may be limited, pinning is only a bonus.
+  bool pinned = mlock(buf, map_length) == 0;
+  *mapped = map_length;
+  logprintf(5, "Log: Using %s%s memory at %p, %lldkB, node %d.\n",
+            pinned ? "pinned " : "", method, buf, map_length / 1024, node);
+  return buf;
+}
+
 // Allocate the target memory. This may be from malloc, hugepage pool
 // or other platform specific sources.
 bool OsLayer::AllocateTestMem(int64 length, uint64 paddr_base) {
@@ -514,6 +1179,32 @@ bool OsLayer::AllocateTestMem(int64 length, uint64 paddr_base) {
     logprintf(0, "Process Error: non zero paddr_base %#llx is not supported,"
               " ignore.\n", paddr_base);
 
+  if (numa_alloc_) {
+    buf = AllocateNumaMem(length);
+    if (buf) {
+      mmapped_allocation_ = true;
+      testmem_ = buf;
+      testmemsize_ = length;
+      pagemap_.Initialize(buf, length);
+      return true;
+    }
+    logprintf(0, "Log: NUMA allocation failed, "
+                 "allocating test memory as one buffer.\n");
+  }
+
+  if (hugepage_mode_ != kHugepageShm) {
+    buf = AllocateHugeMem(length);
+    if (buf) {
+      mmapped_allocation_ = true;
+      testmem_ = buf;
+      testmemsize_ = length;
+      pagemap_.Initialize(buf, length);
+      return true;
+    }
+    logprintf(0, "Log: Hugepage allocation failed, "
+                 "falling back to the default allocation.\n");
+  }
+
   // Determine optimal memory allocation path.
   bool prefer_hugepages = false;
   bool prefer_posix_shm = false;
@@ -671,13 +1362,61 @@ bool OsLayer::AllocateTestMem(int64 length, uint64 paddr_base) {
   } else {
     testmemsize_ = 0;
   }
+  // Dynamically mapped memory moves around, so it can't be indexed.
+  if (buf)
+    pagemap_.Initialize(buf, length);
 
   return (buf != 0) || dynamic_mapped_shmem_;
 }
 
+// Freeing a terabyte of pages takes minutes on one cpu, and the unmap that
+// does it holds the mm's lock. madvise() only needs it shared, so slices
+// of the memory are released side by side first, leaving the unmap little
+// to do. Shared memory has to be punched out of its file to be freed.
+void OsLayer::ReleaseTestMemPages() {
+  static const int kMaxThreads = 32;
+  static const int64 kSlice = 1024 * kMegabyte;
+  int64 slices = testmemsize_ / kSlice;
+  int threads = num_cpus_;
+  if (threads > kMaxThreads)
+    threads = kMaxThreads;
+  if (threads > slices)
+    threads = slices;
+  if (threads < 2)
+    return;
+
+  int64 start_us = sat_get_time_us();
+  int advice = (use_hugepages_ || use_posix_shm_) ? MADV_REMOVE :
+                                                    MADV_DONTNEED;
+  vector<struct ReleaseSlice> parts(threads);
+  vector<pthread_t> tids(threads);
+  vector<bool> started(threads);
+  for (int i = 0; i < threads; i++) {
+    // Slices stay 1GB aligned for any size of hugepage.
+    int64 first = slices * i / threads * kSlice;
+    int64 last = (i == threads - 1) ? testmemsize_ :
+                                      slices * (i + 1) / threads * kSlice;
+    parts[i].start = static_cast<char*>(testmem_) + first;
+    parts[i].length = last - first;
+    parts[i].advice = advice;
+    started[i] = pthread_create(&tids[i], NULL, ReleaseTestMemSlice,
+                                &parts[i]) == 0;
+    if (!started[i])
+      ReleaseTestMemSlice(&parts[i]);
+  }
+  for (int i = 0; i < threads; i++) {
+    if (started[i])
+      pthread_join(tids[i], NULL);
+  }
+  logprintf(6, "Log: Released %lldMB of test memory with %d threads in "
+            "%.2fs\n", testmemsize_ / kMegabyte, threads,
+            (sat_get_time_us() - start_us) / 1000000.);
+}
+
 // Free the test memory.
 void OsLayer::FreeTestMem() {
   if (testmem_) {
+    ReleaseTestMemPages();
     if (use_hugepages_) {
 #ifdef HAVE_SYS_SHM_H
       shmdt(testmem_);
@@ -689,16 +1428,66 @@ void OsLayer::FreeTestMem() {
       }
       close(shmid_);
     } else if (mmapped_allocation_) {
-      munmap(testmem_, testmemsize_);
+      munmap(testmem_, mmapped_length_ ? mmapped_length_ : testmemsize_);
     } else {
       free(testmem_);
     }
     testmem_ = 0;
     testmemsize_ = 0;
+    mmapped_length_ = 0;
+    pagemap_.Reset();
+    numa_slab_size_ = 0;
   }
 }
 
 
+// Sum up the smaps entries of every mapping that overlaps test memory,
+// mbind() and madvise() may have split it into several.
+void OsLayer::ReportTestMemPageSize() {
+  if (!testmem_ || !testmemsize_)
+    return;
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if (!smaps) {
+    logprintf(12, "Log: can't open /proc/self/smaps to check page size\n");
+    return;
+  }
+
+  uint64 mem_start = reinterpret_cast<uint64>(testmem_);
+  uint64 mem_end = mem_start + testmemsize_;
+  bool in_testmem = false;
+  int64 min_page_kb = 0;
+  int64 max_page_kb = 0;
+  int64 thp_kb = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), smaps)) {
+    unsigned long long start, end;  // NOLINT
+    int64 value;
+    if (sscanf(line, "%llx-%llx ", &start, &end) == 2) {
+      in_testmem = (start < mem_end) && (end > mem_start);
+    } else if (!in_testmem) {
+      continue;
+    } else if (sscanf(line, "KernelPageSize: %lld kB", &value) == 1) {
+      if (!min_page_kb || value < min_page_kb)
+        min_page_kb = value;
+      if (value > max_page_kb)
+        max_page_kb = value;
+    } else if (sscanf(line, "AnonHugePages: %lld kB", &value) == 1) {
+      thp_kb += value;
+    }
+  }
+  fclose(smaps);
+
+  if (min_page_kb == max_page_kb) {
+    logprintf(5, "Log: Test memory uses %lldkB pages, "
+                 "%lldMB on transparent hugepages.\n",
+              min_page_kb, thp_kb / 1024);
+  } else {
+    logprintf(5, "Log: Test memory uses %lldkB to %lldkB pages, "
+                 "%lldMB on transparent hugepages.\n",
+              min_page_kb, max_page_kb, thp_kb / 1024);
+  }
+}
+
 // Prepare the target memory. It may requre mapping in, or this may be a noop.
 void *OsLayer::PrepareTestMem(uint64 offset, uint64 length) {
   sat_assert((offset + length) <= testmemsize_);
@@ -741,13 +1530,23 @@ void OsLayer::ReleaseTestMem(void *addr, uint64 offset, uint64 length) {
   }
 }
 
-// No error polling on unknown systems.
+// Report the ECC errors logged by the memory controllers.
 int OsLayer::ErrorPoll() {
-  return 0;
+  if (!edac_) {
+    // Without EDAC there is nothing to poll, and Poll() returns at once.
+    edac_ = new EdacMonitor();
+    edac_->Initialize();
+  }
+  return edac_->Poll(error_diagnoser_, this);
 }
 
-// Generally, poll for errors once per second.
+// Generally, poll for errors once per second, or as soon as the memory
+// controller logs one.
 void OsLayer::ErrorWait() {
+  if (edac_) {
+    edac_->Wait(1000);
+    return;
+  }
   sat_sleep(1);
   return;
 }
@@ -900,6 +1699,25 @@ bool OsLayer::WriteMSR(uint32 core, uint32 address, uint64 *data) {
   return res;
 }
 
+// Thermal zones are numbered from 0 without gaps.
+int64 OsLayer::MaxTemperature() {
+  int64 hottest = -1;
+  for (int zone = 0; ; zone++) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/temp",
+             zone);
+    FILE *file = fopen(path, "r");
+    if (!file)
+      break;
+    long long temp;  // NOLINT
+    // Some zones can't be read while their sensor is off.
+    if (fscanf(file, "%lld", &temp) == 1 && temp > hottest)
+      hottest = temp;
+    fclose(file);
+  }
+  return hottest;
+}
+
 // Extract bits [n+len-1, n] from a 32 bit word.
 // so GetBitField(0x0f00, 8, 4) == 0xf.
 uint32 OsLayer::GetBitField(uint32 val, uint32 n, uint32 len) {
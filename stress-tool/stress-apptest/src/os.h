@@ -31,6 +31,7 @@
 #include "adler32memcpy.h"  // NOLINT
 #include "sattypes.h"       // NOLINT
 #include "clock.h"          // NOLINT
+#include "pagemap_index.h"  // NOLINT
 
 const char kPagemapPath[] = "/proc/self/pagemap";
 
@@ -51,6 +52,8 @@ class ErrorDiag;
 
 class Clock;
 
+class EdacMonitor;
+
 // This class implements OS/Platform specific funtions.
 class OsLayer {
  public:
@@ -70,6 +73,29 @@ class OsLayer {
     reserve_mb_ = reserve_mb;
   }
 
+  // Ways of backing test memory with hugepages.
+  enum HugepageMode {
+    kHugepageShm = 0,      // SysV SHM_HUGETLB if enough are reserved.
+    kHugepageMmap = 1,     // Anonymous MAP_HUGETLB mapping.
+    kHugepageMemfd = 2,    // Mapping of a memfd_create(MFD_HUGETLB) file.
+    kHugepageThp = 3       // Transparent hugepages, madvise(MADV_HUGEPAGE).
+  };
+
+  // Select how test memory is backed by hugepages, and the hugetlb page
+  // size in bytes (0 for the system default) for kHugepageMmap and
+  // kHugepageMemfd. Must be set before AllocateTestMem().
+  void SetHugepageMode(int mode, int64 page_size) {
+    hugepage_mode_ = mode;
+    hugepage_size_ = page_size;
+  }
+
+  // Allocate test memory as one slab per NUMA node, each bound to its node
+  // and first touched by threads running on that node.
+  // Must be set before Initialize().
+  void SetNumaAllocation(bool numa_alloc) {
+    numa_alloc_ = numa_alloc;
+  }
+
   // Set parameters needed to translate physical address to memory module.
   void SetDramMappingParams(uintptr_t channel_hash, int channel_width,
                             vector< vector<string> > *channels) {
@@ -77,6 +103,11 @@ class OsLayer {
     channel_width_ = channel_width;
     channels_ = channels;
   }
+  // Name addresses by the channel and rank of 'channel_map' when there
+  // are no module names.
+  void SetChannelMap(const class ChannelMap *channel_map) {
+    channel_map_ = channel_map;
+  }
 
   // Initializes data strctures and open files.
   // Returns false on error.
@@ -86,6 +117,13 @@ class OsLayer {
   // subclasses to implement.
   // Takes a pointer, and returns the corresponding bus address.
   virtual uint64 VirtualToPhysical(void *vaddr);
+  // Translate 'count' addresses at once into 'paddrs', 0 for the ones that
+  // can't be translated.
+  virtual void VirtualToPhysicalBulk(void *const *vaddrs, int count,
+                                     uint64 *paddrs);
+  // Returns the offset into test memory of bus address 'paddr', or -1 if
+  // it's not part of test memory.
+  virtual int64 FindTestMemOffset(uint64 paddr);
 
   // Prints failed dimm. This implementation is optional for
   // subclasses to implement.
@@ -99,6 +137,9 @@ class OsLayer {
   // Classifies addresses according to "regions"
   // This may mean different things on different platforms.
   virtual int32 FindRegion(uint64 paddr);
+  // Returns the region whose NUMA slab holds test memory at 'offset',
+  // or -1 if test memory wasn't allocated per node.
+  virtual int32 FindNumaRegion(uint64 offset);
   // Find cpu cores associated with a region. Either NUMA or arbitrary.
   virtual cpu_set_t *FindCoreMask(int32 region);
   // Return cpu cores associated with a region in a hex string.
@@ -110,8 +151,17 @@ class OsLayer {
   // Returns a list of paths coresponding to HD devices found on this machine.
   virtual list<string> FindFileDevices();
 
+  // Returns the whole disks that nothing uses: no partition is mounted or
+  // used as swap, and no md or device mapper device sits on top.
+  virtual list<string> FindDiskDevices();
+  // Returns the NUMA node block device 'device' is attached to, and its
+  // cpus in 'cpus', or -1 if it isn't known.
+  virtual int FindDiskNode(const string &device, cpu_set_t *cpus);
+
   // Polls for errors. This implementation is optional.
   // This will poll once for errors and return zero iff no errors were found.
+  // The default reports the memory controller errors seen by EDAC, and only
+  // counts the uncorrected ones.
   virtual int ErrorPoll();
 
   // Delay an appropriate amount of time between polling.
@@ -129,6 +179,13 @@ class OsLayer {
   virtual bool FlushPageCache(void);
   // Enable FlushPageCache() to actually do the flush instead of being a NOP.
   virtual void ActivateFlushPageCache(void);
+  // Write back and drop just 'length' bytes of 'fd' at 'offset' from the
+  // page cache, or all of it from 'offset' on for 0, so that the next reads
+  // come from the disk without emptying every other file's cache. With
+  // 'verify', also check that the pages really left the cache. Returns
+  // false if they may not have, in which case only FlushPageCache() helps.
+  virtual bool EvictFileCache(int fd, int64 offset, int64 length,
+                              bool verify);
 
   // Flushes cacheline. Used to distinguish read or write errors.
   // Subclasses may implement this in machine specific ways..
@@ -299,12 +356,21 @@ class OsLayer {
   // Returns success.
   virtual bool AllocateTestMem(int64 length, uint64 paddr_base);
   virtual void FreeTestMem();
+  // Map 'length' zeroed and locked bytes for buffers and shared cache
+  // lines, on hugepages when possible so TLB misses stay out of the way,
+  // and bound to NUMA node 'node' unless that is -1. Sets the bytes to
+  // munmap() in 'mapped'. Returns the buffer, or NULL.
+  virtual void *AllocatePinnedMem(int64 length, int node, int64 *mapped);
 
   // Prepares the memory for use. You must call this
   // before using test memory, and after you are done.
   virtual void *PrepareTestMem(uint64 offset, uint64 length);
   virtual void ReleaseTestMem(void *addr, uint64 offset, uint64 length);
 
+  // Log the page size the kernel actually backs test memory with, and how
+  // much of it sits on transparent hugepages.
+  virtual void ReportTestMemPageSize();
+
   // Machine type detected. Can we implement all these functions correctly?
   // Returns true if machine type is detected and implemented.
   virtual bool IsSupported();
@@ -323,6 +389,10 @@ class OsLayer {
   virtual bool ReadMSR(uint32 core, uint32 address, uint64 *data);
   virtual bool WriteMSR(uint32 core, uint32 address, uint64 *data);
 
+  // Temperature of the hottest thermal zone in millidegrees Celsius,
+  // or -1 if there are none.
+  virtual int64 MaxTemperature();
+
   // Extract bits [n+len-1, n] from a 32 bit word.
   // so GetBitField(0x0f00, 8, 4) == 0xf.
   virtual uint32 GetBitField(uint32 val, uint32 n, uint32 len);
@@ -339,6 +409,12 @@ class OsLayer {
   // Is SAT using normal malloc'd memory, or exotic mmap'd memory.
   bool normal_mem() const { return normal_mem_; }
 
+  // The whole test memory, if it is mapped all at once, else NULL.
+  void *testmem() const {
+    return dynamic_mapped_shmem_ ? NULL : testmem_;
+  }
+  uint64 testmemsize() const { return testmemsize_; }
+
   // Get numa config, if available..
   int num_nodes() const { return num_nodes_; }
   int num_cpus() const { return num_cpus_; }
@@ -351,6 +427,30 @@ class OsLayer {
                                unsigned int size_in_bytes,
                                AdlerChecksum *checksum);
 
+  // Compare memory with expected data using the widest available compare.
+  // See PatternCompareC for the mismatch bitmap format.
+  virtual unsigned int PatternCompare(const uint64 *mem,
+                                      const uint64 *expected,
+                                      unsigned int words,
+                                      uint64 *mismatch);
+
+  // Copy memory while taking its CRC32C, with the cpu's crc instructions
+  // when it has them. See CalculateCrc32cChecksum for the layout.
+  virtual bool Crc32cMemcpy(uint64 *dstmem, uint64 *srcmem,
+                            unsigned int size_in_bytes,
+                            AdlerChecksum *checksum);
+  // Whether Crc32cMemcpy uses hardware crc instructions.
+  bool has_crc32c() const { return has_crc32c_; }
+
+  // Invert memory in place using the widest available kernel, see
+  // InvertMemoryC.
+  virtual void InvertMemory(void *mem, unsigned int size, bool down);
+
+  // Flush every cacheline of a range with a single fence at the end, using
+  // clflushopt where available. With 'writeback' the lines are written
+  // back but may stay cached (clwb), where the cpu supports it.
+  virtual void FlushRange(void *vaddr, unsigned int size, bool writeback);
+
   // Store a callback to use to print
   // app-specific info about the last error location.
   // This call back is called with a physical address, and the app can fill in
@@ -383,10 +483,18 @@ class OsLayer {
   bool  use_posix_shm_;          // Use 4k page shmem?
   bool  dynamic_mapped_shmem_;   // Conserve virtual address space.
   bool  mmapped_allocation_;     // Was memory allocated using mmap()?
+  int64 mmapped_length_;         // Length of that mapping, if rounded up.
+  int   hugepage_mode_;          // HugepageMode to allocate test memory by.
+  int64 hugepage_size_;          // Requested hugetlb page size, or 0.
+  PagemapIndex pagemap_;         // Cached translation of test memory.
+  bool  numa_alloc_;             // Allocate test memory per NUMA node?
+  int64 numa_slab_size_;         // Test memory per node, 0 if not per node.
+  vector<int> numa_node_ids_;    // Kernel node number of each region.
   int   shmid_;                  // Handle to shmem
   vector< vector<string> > *channels_;  // Memory module names per channel.
   uint64 channel_hash_;          // Mask of address bits XORed for channel.
   int channel_width_;            // Channel width in bits.
+  const class ChannelMap *channel_map_;  // Channel and rank decode, or NULL.
 
   int64 regionsize_;             // Size of memory "regions"
   int   regioncount_;            // Number of memory "regions"
@@ -395,7 +503,12 @@ class OsLayer {
   int   num_cpus_per_node_;      // Number of cpus per node in the system.
   int   address_mode_;           // Are we running 32 or 64 bit?
   bool  has_vector_;             // Do we have sse2/neon instructions?
+  bool  has_avx2_;               // Do we have usable avx2 instructions?
+  bool  has_avx512_;             // Do we have usable avx512f instructions?
   bool  has_clflush_;            // Do we have clflush instructions?
+  bool  has_clflushopt_;         // Do we have clflushopt instructions?
+  bool  has_clwb_;               // Do we have clwb instructions?
+  bool  has_crc32c_;             // Do we have crc32c instructions?
   bool  use_flush_page_cache_;   // Do we need to flush the page cache?
 
 
@@ -410,12 +523,28 @@ class OsLayer {
   // Look up how many hugepages there are.
   virtual int64 FindHugePages();
 
+  // Read the online NUMA nodes and their cpus from sysfs, one region per
+  // node with cpus. Returns false if the layout can't be read.
+  virtual bool FindNumaNodes();
+  // Map 'length' bytes as selected by hugepage_mode_, for any mode other
+  // than kHugepageShm. Returns the buffer, or NULL.
+  virtual void *AllocateHugeMem(int64 length);
+  // Map 'length' bytes split into one bound slab per region and fault
+  // each slab in from its own cpus. Returns the buffer, or NULL.
+  virtual void *AllocateNumaMem(int64 length);
+  // Give the pages of large test memory back from several threads at once
+  // before it's unmapped.
+  void ReleaseTestMemPages();
+
   // Link to find last transaction at an error location.
   ErrCallback err_log_callback_;
 
   // Object to wrap the time function.
   Clock *clock_;
 
+  // Memory controller error source, set up on the first ErrorPoll().
+  EdacMonitor *edac_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(OsLayer);
 };
@@ -0,0 +1,49 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Struct of arrays page metadata, see page_table.h.
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "page_table.h"
+
+PageTable::PageTable(uint64 count, int64 page_size) {
+  sat_assert(count <= kMaxPageHandles);
+  count_ = count;
+  page_size_ = page_size;
+  patterns_ = new class Pattern*[count_];
+  tags_ = new int32[count_];
+  paddrs_ = new uint64[count_];
+  touches_ = new uint32[count_];
+  timestamps_ = new uint64[count_];
+  lastcpus_ = new uint32[count_];
+  lastpatterns_ = new class Pattern*[count_];
+
+  struct page_entry pe;
+  init_pe(&pe);
+  pe.paddr = 0;
+  pe.lastpattern = NULL;
+  for (uint64 i = 0; i < count_; i++)
+    Store(i, &pe, false);
+}
+
+PageTable::~PageTable() {
+  delete[] patterns_;
+  delete[] tags_;
+  delete[] paddrs_;
+  delete[] touches_;
+  delete[] timestamps_;
+  delete[] lastcpus_;
+  delete[] lastpatterns_;
+}
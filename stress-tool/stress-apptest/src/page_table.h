@@ -0,0 +1,104 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Page entry metadata shared by the queue implementations, stored as one
+// array per field and addressed by a 32 bit page handle.
+
+#ifndef STRESSAPPTEST_PAGE_TABLE_H_
+#define STRESSAPPTEST_PAGE_TABLE_H_
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+#include "queue.h"     // Using page_entry struct.
+
+// Index of a page of the test memory, its offset divided by the page size.
+typedef uint32 PageHandle;
+static const uint64 kMaxPageHandles = 0xffffffffULL;
+
+// Metadata of every page of the test memory in struct of arrays form. The
+// fields a search looks at, pattern and tag, are packed densely apart from
+// the ones only copied when a page is handed out or given back, so probing
+// for a page of the right kind touches as few cachelines as possible, and
+// lists of pages only need to move handles.
+//
+// A page_entry is the unpacked working copy a worker thread holds while it
+// owns a page. Its offset comes from the handle and its addr isn't stored,
+// Sat maps the page on every Get.
+//
+// Not threadsafe, the queues serialize access to each page.
+class PageTable {
+ public:
+  PageTable(uint64 count, int64 page_size);
+  ~PageTable();
+
+  uint64 count() const { return count_; }
+  bool valid_handle(int64 index) const {
+    return index >= 0 && static_cast<uint64>(index) < count_;
+  }
+  // Handle of the page at 'offset' into the test memory. Check it with
+  // valid_handle() first.
+  int64 HandleOf(uint64 offset) const { return offset / page_size_; }
+
+  // Hot fields.
+  bool is_valid(PageHandle page) const { return patterns_[page] != NULL; }
+  int32 tag(PageHandle page) const { return tags_[page]; }
+  // Cold fields.
+  uint64 paddr(PageHandle page) const { return paddrs_[page]; }
+  uint32 touch(PageHandle page) const { return touches_[page]; }
+  uint64 timestamp(PageHandle page) const { return timestamps_[page]; }
+
+  // Unpack page 'page' into 'pe'.
+  void Load(PageHandle page, struct page_entry *pe) const {
+    pe->offset = static_cast<uint64>(page) * page_size_;
+    pe->addr = NULL;
+    pe->paddr = paddrs_[page];
+    pe->pattern = patterns_[page];
+    pe->tag = tags_[page];
+    pe->touch = touches_[page];
+    pe->ts = timestamps_[page];
+    pe->lastcpu = lastcpus_[page];
+    pe->lastpattern = lastpatterns_[page];
+  }
+
+  // Pack 'pe' into page 'page'. An empty page loses its pattern.
+  void Store(PageHandle page, const struct page_entry *pe, bool valid) {
+    paddrs_[page] = pe->paddr;
+    patterns_[page] = valid ? pe->pattern : NULL;
+    tags_[page] = pe->tag;
+    touches_[page] = pe->touch;
+    timestamps_[page] = pe->ts;
+    lastcpus_[page] = pe->lastcpu;
+    lastpatterns_[page] = pe->lastpattern;
+  }
+
+ private:
+  uint64 count_;                 // Number of pages.
+  int64 page_size_;              // For calculating offsets from handles.
+
+  // Searched for a page of the right kind.
+  class Pattern **patterns_;     // Expected pattern, NULL if empty.
+  int32 *tags_;                  // NUMA or region tag.
+
+  // Only copied on get and put.
+  uint64 *paddrs_;
+  uint32 *touches_;              // Reads from this page.
+  uint64 *timestamps_;           // Time of the last read.
+  uint32 *lastcpus_;             // Last CPU to write this page.
+  class Pattern **lastpatterns_;  // Expected pattern at the last read.
+
+  DISALLOW_COPY_AND_ASSIGN(PageTable);
+};
+
+#endif  // STRESSAPPTEST_PAGE_TABLE_H_
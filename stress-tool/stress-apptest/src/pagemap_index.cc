@@ -0,0 +1,245 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cached pagemap translation of the test memory, see pagemap_index.h.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "pagemap_index.h"
+#include "os.h"
+
+namespace {
+// https://www.kernel.org/doc/Documentation/vm/pagemap.txt
+const uint64 kPagePresent = 1ULL << 63;
+const uint64 kPageSwapped = 1ULL << 62;
+const uint64 kPfnMask = (1ULL << 55) - 1;
+}  // namespace
+
+PagemapIndex::PagemapIndex() {
+  base_ = NULL;
+  length_ = 0;
+  page_size_ = sysconf(_SC_PAGESIZE);
+  pages_ = 0;
+  chunks_ = NULL;
+  chunk_count_ = 0;
+  fd_ = -1;
+  runs_built_ = false;
+  pthread_mutex_init(&lock_, NULL);
+  pthread_mutex_init(&runs_lock_, NULL);
+}
+
+PagemapIndex::~PagemapIndex() {
+  Reset();
+  pthread_mutex_destroy(&lock_);
+  pthread_mutex_destroy(&runs_lock_);
+}
+
+void PagemapIndex::Initialize(void *base, uint64 length) {
+  Reset();
+  base_ = static_cast<char*>(base);
+  length_ = length;
+  // The range may start and end part way into a page.
+  uint64 first = reinterpret_cast<uintptr_t>(base_) / page_size_;
+  uint64 last = (reinterpret_cast<uintptr_t>(base_) + length_ - 1) /
+                page_size_;
+  pages_ = length_ ? last - first + 1 : 0;
+  chunk_count_ = (pages_ + kChunkPages - 1) / kChunkPages;
+  chunks_ = new uint64*[chunk_count_];
+  for (uint64 i = 0; i < chunk_count_; i++)
+    chunks_[i] = NULL;
+}
+
+void PagemapIndex::Reset() {
+  for (uint64 i = 0; i < chunk_count_; i++)
+    delete[] chunks_[i];
+  delete[] chunks_;
+  chunks_ = NULL;
+  chunk_count_ = 0;
+  base_ = NULL;
+  length_ = 0;
+  pages_ = 0;
+  runs_.clear();
+  runs_built_ = false;
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+}
+
+int PagemapIndex::PagemapFd() {
+  if (fd_ >= 0)
+    return fd_;
+  int fd = open(kPagemapPath, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  // Another thread may have opened it meanwhile.
+  if (!__sync_bool_compare_and_swap(&fd_, -1, fd))
+    close(fd);
+  return fd_;
+}
+
+bool PagemapIndex::ReadEntries(uint64 vpage, uint64 count, uint64 *entries) {
+  int fd = PagemapFd();
+  if (fd < 0)
+    return false;
+
+  char *buf = reinterpret_cast<char*>(entries);
+  uint64 want = count * sizeof(*entries);
+  off64_t off = vpage * sizeof(*entries);
+  uint64 done = 0;
+  while (done < want) {
+    ssize_t got = pread64(fd, buf + done, want - done, off + done);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      int err = errno;
+      logprintf(0, "Process Error: failed to access %s with errno %d (%s)\n",
+                kPagemapPath, err, ErrorString(err).c_str());
+      return false;
+    }
+    done += got;
+  }
+  return true;
+}
+
+uint64 *PagemapIndex::Chunk(uint64 page) {
+  uint64 index = page / kChunkPages;
+  uint64 *chunk = chunks_[index];
+  // Read the entries only after seeing the pointer that published them.
+  __sync_synchronize();
+  if (chunk)
+    return chunk;
+
+  pthread_mutex_lock(&lock_);
+  chunk = chunks_[index];
+  if (!chunk) {
+    uint64 first = reinterpret_cast<uintptr_t>(base_) / page_size_ +
+                   index * kChunkPages;
+    uint64 count = kChunkPages;
+    if (index * kChunkPages + count > pages_)
+      count = pages_ - index * kChunkPages;
+    chunk = new uint64[kChunkPages];
+    if (ReadEntries(first, count, chunk)) {
+      __sync_synchronize();
+      chunks_[index] = chunk;
+    } else {
+      delete[] chunk;
+      chunk = NULL;
+    }
+  }
+  pthread_mutex_unlock(&lock_);
+  return chunk;
+}
+
+uint64 PagemapIndex::EntryToPhysical(uint64 entry, const void *vaddr) const {
+  // Check if page is present and not swapped.
+  if (!(entry & kPagePresent) || (entry & kPageSwapped))
+    return 0;
+  return ((entry & kPfnMask) * page_size_) |
+         (reinterpret_cast<uintptr_t>(vaddr) & (page_size_ - 1));
+}
+
+uint64 PagemapIndex::VirtualToPhysical(const void *vaddr) {
+  uint64 vpage = reinterpret_cast<uintptr_t>(vaddr) / page_size_;
+  uint64 entry = 0;
+  if (Contains(vaddr)) {
+    uint64 page = vpage - reinterpret_cast<uintptr_t>(base_) / page_size_;
+    uint64 *chunk = Chunk(page);
+    if (!chunk)
+      return 0;
+    entry = chunk[page % kChunkPages];
+    if (entry & kPagePresent)
+      return EntryToPhysical(entry, vaddr);
+    // Not faulted in when the chunk was read, it may be by now.
+  }
+  if (!ReadEntries(vpage, 1, &entry))
+    return 0;
+  return EntryToPhysical(entry, vaddr);
+}
+
+void PagemapIndex::VirtualToPhysicalBulk(void *const *vaddrs, int count,
+                                         uint64 *paddrs) {
+  for (int i = 0; i < count; i++)
+    paddrs[i] = VirtualToPhysical(vaddrs[i]);
+}
+
+void PagemapIndex::BuildRuns() {
+  runs_.clear();
+  for (uint64 page = 0; page < pages_; page++) {
+    uint64 *chunk = Chunk(page);
+    if (!chunk) {
+      // Skip the rest of an unreadable chunk.
+      page = (page / kChunkPages + 1) * kChunkPages - 1;
+      continue;
+    }
+    uint64 entry = chunk[page % kChunkPages];
+    if (!(entry & kPagePresent) || (entry & kPageSwapped) ||
+        !(entry & kPfnMask))
+      continue;
+
+    uint64 paddr = (entry & kPfnMask) * page_size_;
+    // Offset of the page start, which is before base_ for the first page.
+    uint64 offset = page * page_size_ -
+                    (reinterpret_cast<uintptr_t>(base_) % page_size_);
+    if (!runs_.empty()) {
+      struct Run *last = &runs_.back();
+      if (last->paddr + last->length == paddr &&
+          last->offset + last->length == offset) {
+        last->length += page_size_;
+        continue;
+      }
+    }
+    struct Run run = { paddr, offset, page_size_ };
+    runs_.push_back(run);
+  }
+  std::sort(runs_.begin(), runs_.end(), RunBefore);
+  logprintf(12, "Log: Pagemap index has %lld physical runs.\n",
+            static_cast<int64>(runs_.size()));
+}
+
+int64 PagemapIndex::PhysicalToOffset(uint64 paddr) {
+  if (!base_)
+    return -1;
+  if (!runs_built_) {
+    pthread_mutex_lock(&runs_lock_);
+    if (!runs_built_) {
+      BuildRuns();
+      __sync_synchronize();
+      runs_built_ = true;
+    }
+    pthread_mutex_unlock(&runs_lock_);
+  }
+  // Read runs_ only after seeing the flag that published it.
+  __sync_synchronize();
+
+  // Find the last run starting at or below paddr.
+  struct Run key = { paddr, 0, 0 };
+  vector<struct Run>::const_iterator it =
+      std::upper_bound(runs_.begin(), runs_.end(), key, RunBefore);
+  if (it == runs_.begin())
+    return -1;
+  --it;
+  if (paddr >= it->paddr + it->length)
+    return -1;
+  int64 offset = it->offset + (paddr - it->paddr);
+  // The first page may start before base_.
+  if (offset < 0 || static_cast<uint64>(offset) >= length_)
+    return -1;
+  return offset;
+}
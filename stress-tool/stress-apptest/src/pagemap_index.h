@@ -0,0 +1,109 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cached virtual to physical translation of the test memory, read from
+// /proc/self/pagemap in large batches instead of one open and read per
+// address.
+
+#ifndef STRESSAPPTEST_PAGEMAP_INDEX_H_
+#define STRESSAPPTEST_PAGEMAP_INDEX_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// Pagemap entries of one contiguous virtual range, read a chunk at a time
+// on first use. A reverse index of physically contiguous runs is built the
+// first time a physical address is looked up.
+//
+// Pages are assumed not to move once faulted in, which holds for hugepage
+// and mlocked memory. Lookups of pages that weren't present when their
+// chunk was read go back to pagemap.
+//
+// Lookups are threadsafe, Initialize() and Reset() are not.
+class PagemapIndex {
+ public:
+  PagemapIndex();
+  ~PagemapIndex();
+
+  // Cover 'length' bytes starting at 'base'.
+  void Initialize(void *base, uint64 length);
+  // Drop the index and close pagemap.
+  void Reset();
+
+  // Returns true if 'vaddr' is in the indexed range.
+  bool Contains(const void *vaddr) const {
+    const char *addr = static_cast<const char*>(vaddr);
+    return base_ && addr >= base_ && addr < base_ + length_;
+  }
+
+  // Returns the physical address of 'vaddr', or 0 if the page is not
+  // present or pagemap can't be read.
+  uint64 VirtualToPhysical(const void *vaddr);
+
+  // Translate 'count' addresses into 'paddrs', 0 for the ones that fail.
+  // Addresses outside the indexed range are read from pagemap directly.
+  void VirtualToPhysicalBulk(void *const *vaddrs, int count, uint64 *paddrs);
+
+  // Returns the offset into the indexed range of physical address 'paddr',
+  // or -1 if it isn't part of the range.
+  int64 PhysicalToOffset(uint64 paddr);
+
+ private:
+  static const uint64 kChunkPages = 4096;  // Entries read per pread.
+
+  // A run of pages that are contiguous both virtually and physically.
+  struct Run {
+    uint64 paddr;
+    uint64 offset;
+    uint64 length;
+  };
+  // Orders runs by physical address.
+  static bool RunBefore(const struct Run &a, const struct Run &b) {
+    return a.paddr < b.paddr;
+  }
+
+  // Returns the pagemap fd, opening it on first use.
+  int PagemapFd();
+  // Read pagemap entries for 'count' pages starting at virtual page 'vpage'.
+  // Returns false on failure.
+  bool ReadEntries(uint64 vpage, uint64 count, uint64 *entries);
+  // Returns the chunk holding page 'page' of the range, reading it first
+  // if needed. NULL on failure.
+  uint64 *Chunk(uint64 page);
+  // Turn pagemap 'entry' for 'vaddr' into a physical address, or 0.
+  uint64 EntryToPhysical(uint64 entry, const void *vaddr) const;
+  // Build runs_ from every chunk. Called with runs_lock_ held.
+  void BuildRuns();
+
+  char *base_;                       // Start of the indexed range.
+  uint64 length_;                    // Length of the indexed range.
+  uint64 page_size_;                 // OS page size.
+  uint64 pages_;                     // OS pages in the range.
+  uint64 **chunks_;                  // kChunkPages entries each, or NULL.
+  uint64 chunk_count_;
+  volatile int fd_;                  // Open pagemap, or -1.
+  volatile bool runs_built_;         // runs_ is ready.
+  vector<struct Run> runs_;          // Sorted by physical address.
+  pthread_mutex_t lock_;             // Serializes chunk reads.
+  pthread_mutex_t runs_lock_;        // Serializes building runs_.
+
+  DISALLOW_COPY_AND_ASSIGN(PagemapIndex);
+};
+
+#endif  // STRESSAPPTEST_PAGEMAP_INDEX_H_
@@ -14,11 +14,15 @@
 
 // pattern.cc : library of stressful data patterns
 
+#include <pthread.h>
 #include <sys/types.h>
 
+#include <vector>
+
 // This file must work with autoconf on its public version,
 // so these includes are correct.
 #include "pattern.h"
+#include "prng.h"
 #include "sattypes.h"
 
 // Static data patterns.
@@ -233,19 +237,33 @@ static const struct PatternData pattern_array[] = {
 static const int pattern_array_size =
     sizeof pattern_array / sizeof pattern_array[0];
 
+// Tables of one pattern variant, which never change once built.
+struct PatternTables {
+  const struct PatternData *data;
+  int busshift;
+  bool invert;
+  AdlerChecksum crc;
+  AdlerChecksum crc32c;
+  uint64 expected[Pattern::kExpandedWords];
+};
+// Every variant built so far. Later PatternLists, such as the ones of
+// repeated runs through the library, reuse them.
+static vector<struct PatternTables*> table_cache;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
 Pattern::Pattern() {
   crc_ = NULL;
+  crc32c_ = NULL;
+  expected_ = NULL;
+  prepared_ = 0;
 }
 
 Pattern::~Pattern() {
-  if (crc_ != NULL) {
-    delete crc_;
-  }
 }
 
-// Calculate CRC for this pattern. This must match
+// Calculate CRC of the expanded 'block'. This must match
 // the CRC calculation in worker.cc.
-int Pattern::CalculateCrc() {
+void Pattern::CalculateCrc(const uint64 *block, AdlerChecksum *crc) {
   // TODO(johnhuang):
   // Consider refactoring to the form:
   // while (i < count) AdlerInc(uint64, uint64, AdlerChecksum*)
@@ -254,34 +272,71 @@ int Pattern::CalculateCrc() {
   uint64 b1 = 0;
   uint64 b2 = 0;
 
-  // checksum is calculated using only the first 4096 bytes of data.
-  int i = 0;
-  int blocksize = 4096;
-  int count = blocksize / sizeof i;
-  while (i < count) {
-    a1 += pattern(i);
+  // checksum is calculated using only the first 4096 bytes of data,
+  // which is the expanded block.
+  for (int i = 0; i < kExpandedWords; i += 2) {
+    datacast_t data;
+    data.l64 = block[i];
+    a1 += data.l32.l;
     b1 += a1;
-    i++;
-    a1 += pattern(i);
+    a1 += data.l32.h;
     b1 += a1;
-    i++;
 
-    a2 += pattern(i);
+    data.l64 = block[i + 1];
+    a2 += data.l32.l;
     b2 += a2;
-    i++;
-    a2 += pattern(i);
+    a2 += data.l32.h;
     b2 += a2;
-    i++;
   }
-  if (crc_ != NULL) {
-    delete crc_;
+  crc->Set(a1, a2, b1, b2);
+}
+
+// Expand the block the CRC covers into 64 bit words, so that checks can
+// compare memory against it directly instead of checksumming.
+void Pattern::ExpandBlock(uint64 *block) {
+  // word() relies on the whole period fitting in the block.
+  sat_assert(((pattern_->mask + 1) << busshift_) <= 2 * kExpandedWords);
+  for (int i = 0; i < kExpandedWords; i++) {
+    datacast_t data;
+    data.l32.l = pattern(i << 1);
+    data.l32.h = pattern((i << 1) + 1);
+    block[i] = data.l64;
   }
-  crc_ = new AdlerChecksum();
-  crc_->Set(a1, a2, b1, b2);
-  return 0;
 }
 
-// Initialize pattern's CRC.
+// Find or build the tables of this variant.
+void Pattern::BuildTables() {
+  pthread_mutex_lock(&table_lock);
+  if (!prepared_) {
+    struct PatternTables *tables = NULL;
+    for (size_t i = 0; i < table_cache.size(); i++) {
+      if (table_cache[i]->data == pattern_ &&
+          table_cache[i]->busshift == busshift_ &&
+          table_cache[i]->invert == inverse_) {
+        tables = table_cache[i];
+        break;
+      }
+    }
+    if (!tables) {
+      tables = new struct PatternTables;
+      tables->data = pattern_;
+      tables->busshift = busshift_;
+      tables->invert = inverse_;
+      ExpandBlock(tables->expected);
+      CalculateCrc(tables->expected, &tables->crc);
+      CalculateCrc32cChecksum(tables->expected, kExpandedWords * 8,
+                              &tables->crc32c);
+      table_cache.push_back(tables);
+    }
+    crc_ = &tables->crc;
+    crc32c_ = &tables->crc32c;
+    expected_ = tables->expected;
+    // Publish the tables only after they are written.
+    __atomic_store_n(&prepared_, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&table_lock);
+}
+
 int Pattern::Initialize(const struct PatternData &pattern_init,
                         int buswidth,
                         bool invert,
@@ -318,7 +373,11 @@ int Pattern::Initialize(const struct PatternData &pattern_init,
     result = 0;
   }
 
-  CalculateCrc();
+  // A reused Pattern may have been a different variant.
+  crc_ = NULL;
+  crc32c_ = NULL;
+  expected_ = NULL;
+  prepared_ = 0;
 
   return result;
 }
@@ -394,6 +453,7 @@ int PatternList::Destroy() {
 // Return pattern numbered "i"
 Pattern *PatternList::GetPattern(int i) {
   if (static_cast<unsigned int>(i) < size_) {
+    patterns_[i].Prepare();
     return &patterns_[i];
   }
 
@@ -403,9 +463,8 @@ Pattern *PatternList::GetPattern(int i) {
 
 // Return a randomly selected pattern.
 Pattern *PatternList::GetRandomPattern() {
-  int target = random();
   unsigned int i = 0;
-  target = (target % weightcount_) + 1;
+  int target = Prng::ThreadPrng()->Below(weightcount_) + 1;
 
   do {
     target -= patterns_[i].weight();
@@ -415,6 +474,7 @@ Pattern *PatternList::GetRandomPattern() {
   } while (i < size_);
 
   if (i < size_) {
+    patterns_[i].Prepare();
     return &patterns_[i];
   }
 
@@ -50,7 +50,7 @@ class Pattern {
  public:
   Pattern();
   ~Pattern();
-  // Fill pattern data and calculate CRC.
+  // Set up the pattern. Its CRC and expanded block are built by Prepare().
   int Initialize(const struct PatternData &pattern_init,
                  int buswidth,
                  bool invert,
@@ -65,17 +65,41 @@ class Pattern {
       data = ~data;
     return data;
   }
+  // Build the CRC and expanded block, unless that already happened. They
+  // are shared by every Pattern with the same data, width and inversion,
+  // and are kept for the life of the process. Threadsafe.
+  void Prepare() {
+    if (!__atomic_load_n(&prepared_, __ATOMIC_ACQUIRE))
+      BuildTables();
+  }
   const AdlerChecksum *crc() {return crc_;}
+  // The same block's lanes of CRC32C, see CalculateCrc32cChecksum.
+  const AdlerChecksum *crc32c() {return crc32c_;}
+  // First 4096 bytes of data, as 64 bit words, for direct comparison.
+  // Every pattern repeats within this block.
+  static const int kExpandedWords = 512;
+  const uint64 *expected_block() const {return expected_;}
+  // 64 bit word 'index' of the data, the same as pattern(2 * index) and
+  // pattern(2 * index + 1) combined, without the bus shift, mask and
+  // inversion of each 32 bit lookup.
+  uint64 word(uint64 index) const {
+    return expected_[index & (kExpandedWords - 1)];
+  }
   unsigned int mask() {return pattern_->mask;}
   unsigned int weight() {return weight_;}
   const char *name() {return name_.c_str();}
 
  private:
-  int CalculateCrc();
+  void BuildTables();
+  void CalculateCrc(const uint64 *block, AdlerChecksum *crc);
+  void ExpandBlock(uint64 *block);
   const struct PatternData *pattern_;
   int busshift_;        // Target data bus width.
   bool inverse_;        // Invert the data from the original pattern.
-  AdlerChecksum *crc_;  // CRC of this pattern.
+  const AdlerChecksum *crc_;  // CRC of this pattern.
+  const AdlerChecksum *crc32c_;  // CRC32C of this pattern.
+  const uint64 *expected_;    // Expanded first block of this pattern.
+  int prepared_;        // crc_, crc32c_ and expected_ are set.
   string name_;         // The human readable pattern name.
   int weight_;          // This is the likelihood that this
                         // pattern will be chosen.
@@ -88,16 +112,24 @@ class PatternList {
  public:
   PatternList();
   ~PatternList();
-  // Initialize pointers to global data patterns, and calculate CRC.
+  // Initialize pointers to global data patterns. Their CRCs are calculated
+  // when a pattern is first returned.
   int Initialize();
   int Destroy();
 
-  // Return the pattern designated by index i.
+  // Return the pattern designated by index i, prepared for use.
   Pattern *GetPattern(int i);
   // Return a random pattern according to the specified weighted probability.
   Pattern *GetRandomPattern();
   // Return the number of patterns available.
   int Size() {return size_;}
+  // Return the index of 'pattern', which GetPattern() maps back to it,
+  // or -1 if it isn't in this list.
+  int IndexOf(const Pattern *pattern) const {
+    if (!size_ || pattern < &patterns_[0] || pattern >= &patterns_[0] + size_)
+      return -1;
+    return pattern - &patterns_[0];
+  }
 
  private:
   vector<class Pattern> patterns_;
@@ -0,0 +1,113 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Square and ramp load waveforms, see power_wave.h.
+
+#include <stdlib.h>
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "power_wave.h"
+
+PowerWave::PowerWave() {
+  ramp_ = false;
+  period_ns_ = 0;
+  on_ns_ = 0;
+  slice_ns_ = 0;
+  start_ns_ = 0;
+}
+
+bool PowerWave::Parse(const char *description) {
+  string text = description;
+  size_t comma = text.find(',');
+  if (comma == string::npos)
+    return false;
+  string shape = text.substr(0, comma);
+  string rest = text.substr(comma + 1);
+  string duty_text;
+  comma = rest.find(',');
+  if (comma != string::npos) {
+    duty_text = rest.substr(comma + 1);
+    rest = rest.substr(0, comma);
+  }
+
+  char *end;
+  double hz = strtod(rest.c_str(), &end);
+  if (rest.empty() || *end || !(hz > 0) || hz > kMaxHz)
+    return false;
+  double duty = 50;
+  if (!duty_text.empty()) {
+    duty = strtod(duty_text.c_str(), &end);
+    if (*end || !(duty > 0) || duty >= 100)
+      return false;
+  }
+
+  if (shape == "square") {
+    ramp_ = false;
+  } else if (shape == "ramp" && duty_text.empty()) {
+    ramp_ = true;
+  } else {
+    return false;
+  }
+  period_ns_ = static_cast<int64>(1e9 / hz);
+  on_ns_ = static_cast<int64>(period_ns_ * duty / 100);
+  slice_ns_ = kSliceNs;
+  if (slice_ns_ * kMinSlices > period_ns_)
+    slice_ns_ = period_ns_ / kMinSlices;
+  name_ = description;
+  return period_ns_ > 0 && on_ns_ > 0 && slice_ns_ > 0;
+}
+
+void PowerWave::Start() {
+  // Round to a millisecond, which makes traces easy to line up.
+  static const int64 kRoundNs = 1000000;
+  start_ns_ = (sat_get_time_ns() + kStartDelayNs) / kRoundNs * kRoundNs;
+}
+
+bool PowerWave::Level(int64 now_ns, int64 *until_ns) const {
+  if (now_ns < start_ns_) {
+    *until_ns = start_ns_;
+    return false;
+  }
+  int64 phase = (now_ns - start_ns_) % period_ns_;
+  int64 period_start = now_ns - phase;
+  if (!ramp_) {
+    if (phase < on_ns_) {
+      *until_ns = period_start + on_ns_;
+      return true;
+    }
+    *until_ns = period_start + period_ns_;
+    return false;
+  }
+
+  // Each slice is busy for the share of the period gone by at its middle.
+  int64 slice_phase = phase % slice_ns_;
+  int64 slice_start = now_ns - slice_phase;
+  int64 middle = phase - slice_phase + slice_ns_ / 2;
+  int64 on = slice_ns_ * middle / period_ns_;
+  int64 slice_end = slice_start + slice_ns_;
+  // The last slice may be cut short by the end of the period.
+  if (slice_end > period_start + period_ns_)
+    slice_end = period_start + period_ns_;
+  if (slice_phase < on) {
+    *until_ns = slice_start + on;
+    if (*until_ns > slice_end)
+      *until_ns = slice_end;
+    return true;
+  }
+  *until_ns = slice_end;
+  return false;
+}
@@ -0,0 +1,71 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Load waveforms for power transient testing: when the power wave threads
+// should be busy and when idle, worked out from the clock alone so that
+// every thread switches at the same instant.
+
+#ifndef STRESSAPPTEST_POWER_WAVE_H_
+#define STRESSAPPTEST_POWER_WAVE_H_
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// A square wave with a duty cycle, or a ramp from idle to full load over
+// each period, made of short on/off slices whose on time grows.
+//
+// Every thread calls Level() with its own reading of CLOCK_MONOTONIC,
+// which the vDSO takes from the TSC, so threads see the same edges without
+// telling each other anything. Start() is the only write and must happen
+// before the threads run.
+class PowerWave {
+ public:
+  PowerWave();
+
+  // Set the wave from "square,<hz>[,<duty %>]" or "ramp,<hz>". Returns
+  // false if it doesn't parse.
+  bool Parse(const char *description);
+  bool enabled() const { return period_ns_ != 0; }
+
+  // Line the first period up on a round time shortly after now.
+  void Start();
+
+  // Returns true if the threads should be busy at 'now_ns', and sets
+  // 'until_ns' to the time that changes.
+  bool Level(int64 now_ns, int64 *until_ns) const;
+
+  // The description, for messages.
+  const string &name() const { return name_; }
+
+ private:
+  static const int64 kMaxHz = 10000;
+  // Ramps are made of slices this long, or 1/kMinSlices of the period for
+  // fast ramps.
+  static const int64 kSliceNs = 20000;
+  static const int kMinSlices = 16;
+  // Time threads get to reach the wave before the first edge.
+  static const int64 kStartDelayNs = 10000000;
+
+  bool ramp_;
+  int64 period_ns_;           // 0 if disabled.
+  int64 on_ns_;               // Busy part of each square period.
+  int64 slice_ns_;            // Ramp slice.
+  int64 start_ns_;            // First edge.
+  string name_;
+};
+
+#endif  // STRESSAPPTEST_POWER_WAVE_H_
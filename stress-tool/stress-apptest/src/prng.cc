@@ -0,0 +1,78 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Per thread pseudo random numbers, see prng.h.
+
+#include <unistd.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "prng.h"
+
+namespace {
+// splitmix64, used to spread a seed over the generator state.
+uint64 SplitMix64(uint64 *x) {
+  uint64 z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// The generator of each thread, NULL until it needs one.
+__thread Prng *thread_prng = NULL;
+}  // namespace
+
+uint64 Prng::master_seed_ = 1;
+volatile uint64 Prng::next_stream_ = 0;
+
+Prng::Prng() {
+  Seed(NewStream());
+}
+
+void Prng::Seed(uint64 stream) {
+  uint64 x = master_seed_;
+  // Mix the stream in separately, so that nearby seeds and streams don't
+  // give overlapping states.
+  uint64 y = stream;
+  x ^= SplitMix64(&y);
+  for (int i = 0; i < 4; i++)
+    state_[i] = SplitMix64(&x);
+}
+
+void Prng::SetMasterSeed(uint64 seed) {
+  master_seed_ = seed;
+}
+
+uint64 Prng::TimeSeed() {
+  uint64 x = sat_get_time_ns() ^ (static_cast<uint64>(getpid()) << 32);
+  uint64 seed = SplitMix64(&x);
+  // 0 means pick one on the command line.
+  return seed ? seed : 1;
+}
+
+uint64 Prng::NewStream() {
+  return __sync_fetch_and_add(&next_stream_, 1);
+}
+
+void Prng::SetThreadPrng(Prng *prng) {
+  thread_prng = prng;
+}
+
+Prng *Prng::ThreadPrng() {
+  if (!thread_prng) {
+    // Lasts as long as the process, threads that aren't workers are few.
+    thread_prng = new Prng();
+  }
+  return thread_prng;
+}
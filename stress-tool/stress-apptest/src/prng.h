@@ -0,0 +1,95 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Seeded per thread pseudo random numbers, so that the random choices of a
+// run can be repeated with --seed.
+
+#ifndef STRESSAPPTEST_PRNG_H_
+#define STRESSAPPTEST_PRNG_H_
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// xoshiro256** generator. Every generator draws its state from the master
+// seed and a stream number, and streams are numbered in the order they are
+// created, so the same command line with the same seed gives every worker
+// the same sequence.
+//
+// A generator is not threadsafe. Workers install their own as the thread's
+// generator, other threads get one of their own on first use.
+class Prng {
+ public:
+  // Seeded with the next stream.
+  Prng();
+
+  // Restart as stream 'stream' of the master seed.
+  void Seed(uint64 stream);
+
+  // Returns the next 64 random bits.
+  uint64 Next() {
+    uint64 result = Rotate(state_[1] * 5, 7) * 9;
+    uint64 t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = Rotate(state_[3], 45);
+    return result;
+  }
+  // Returns a number in [0, n), n > 0.
+  uint64 Below(uint64 n) {
+#ifdef __SIZEOF_INT128__
+    // Lemire's multiply and shift, cheaper than a division.
+    return (static_cast<unsigned __int128>(Next()) * n) >> 64;
+#else
+    return Next() % n;
+#endif
+  }
+
+  // Set the seed every generator is derived from. Generators created
+  // before keep their sequence.
+  static void SetMasterSeed(uint64 seed);
+  static uint64 master_seed() { return master_seed_; }
+  // Returns a seed that differs from run to run.
+  static uint64 TimeSeed();
+
+  // Returns the next unused stream number.
+  static uint64 NewStream();
+
+  // Make 'prng' the calling thread's generator, NULL to drop it.
+  static void SetThreadPrng(Prng *prng);
+  // Returns the calling thread's generator.
+  static Prng *ThreadPrng();
+
+ private:
+  static uint64 Rotate(uint64 x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64 state_[4];
+
+  static uint64 master_seed_;
+  static volatile uint64 next_stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(Prng);
+};
+
+// The calling thread's next 64 random bits.
+inline uint64 ThreadRandom64() {
+  return Prng::ThreadPrng()->Next();
+}
+
+#endif  // STRESSAPPTEST_PRNG_H_
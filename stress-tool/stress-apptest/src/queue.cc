@@ -18,6 +18,7 @@
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
+#include "prng.h"
 #include "queue.h"
 #include "sattypes.h"
 
@@ -77,9 +78,7 @@ int PageEntryQueue::PopRandom(struct page_entry *pe) {
   if (!pe)
     return 0;
 
-  // TODO(nsanders): we should improve random to get 64 bit randoms, and make
-  // it more thread friendly.
-  uint64 rand = random();
+  uint64 rand = ThreadRandom64();
 
   int retval = pthread_mutex_lock(&q_mutex_);
   if (retval)
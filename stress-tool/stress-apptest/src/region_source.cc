@@ -0,0 +1,278 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Regions for the memory region threads, see region_source.h.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "region_source.h"
+
+#ifndef MPOL_BIND
+#define MPOL_BIND        2      // From linux/mempolicy.h.
+#endif
+
+namespace {
+// Parse a whole decimal number into 'value'.
+bool ParseNumber(const string &text, int64 *value) {
+  if (text.empty())
+    return false;
+  char *end;
+  errno = 0;
+  *value = strtoll(text.c_str(), &end, 10);
+  return !errno && !*end && *value >= 0;
+}
+
+// Bind 'length' bytes at 'addr' to NUMA node 'node'.
+// Returns false and sets errno on failure.
+bool BindToNode(void *addr, uint64 length, int node) {
+#ifdef __NR_mbind
+  static const int kNodeMaskBits = 1024;
+  static const int kBitsPerLong = 8 * sizeof(unsigned long);  // NOLINT
+  unsigned long mask[kNodeMaskBits / kBitsPerLong];  // NOLINT
+  if (node < 0 || node >= kNodeMaskBits) {
+    errno = EINVAL;
+    return false;
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+  return syscall(__NR_mbind, addr, length, MPOL_BIND, mask,
+                 kNodeMaskBits + 1, 0) == 0;
+#else
+  errno = ENOSYS;
+  return false;
+#endif
+}
+}  // namespace
+
+RegionSource::RegionSource() {
+  kind_ = kDax;
+  node_ = -1;
+  size_ = 0;
+  width_ = 0;
+  threads_ = 1;
+  fd_ = -1;
+  base_ = NULL;
+  mapped_ = 0;
+}
+
+RegionSource::~RegionSource() {
+  Unmap();
+}
+
+bool RegionSource::Parse(const char *description) {
+  name_ = description;
+  string text = description;
+  size_t colon = text.find(':');
+  if (colon == string::npos)
+    return false;
+  string kind = text.substr(0, colon);
+  // Paths can have commas only before the options, so split on the
+  // first ",<option>=".
+  string rest = text.substr(colon + 1);
+  string options;
+  size_t option = rest.find(',');
+  while (option != string::npos) {
+    size_t equals = rest.find('=', option);
+    size_t next = rest.find(',', option + 1);
+    if (equals != string::npos && (next == string::npos || equals < next)) {
+      options = rest.substr(option);
+      rest = rest.substr(0, option);
+      break;
+    }
+    option = next;
+  }
+
+  if (kind == "dax") {
+    kind_ = kDax;
+  } else if (kind == "pmem") {
+    kind_ = kPmem;
+  } else if (kind == "resource") {
+    kind_ = kResource;
+    width_ = 4;
+  } else if (kind == "node") {
+    int64 node;
+    if (!ParseNumber(rest, &node))
+      return false;
+    kind_ = kNode;
+    node_ = node;
+    size_ = kDefaultNodeBytes;
+  } else {
+    return false;
+  }
+  if (kind_ != kNode) {
+    if (rest.empty())
+      return false;
+    path_ = rest;
+  }
+
+  while (!options.empty()) {
+    // Drop the leading comma.
+    size_t next = options.find(',', 1);
+    string item = options.substr(1, next == string::npos ? string::npos :
+                                    next - 1);
+    options = next == string::npos ? "" : options.substr(next);
+    size_t equals = item.find('=');
+    if (equals == string::npos)
+      return false;
+    string key = item.substr(0, equals);
+    int64 value;
+    if (!ParseNumber(item.substr(equals + 1), &value))
+      return false;
+    if (key == "size" && value > 0) {
+      size_ = value << 20;
+    } else if (key == "width" && (value == 0 || value == 1 || value == 2 ||
+                                  value == 4 || value == 8)) {
+      width_ = value;
+    } else if (key == "threads" && value > 0 && value <= 1024) {
+      threads_ = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64 RegionSource::DaxSize(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISCHR(st.st_mode))
+    return 0;
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/size",
+           major(st.st_rdev), minor(st.st_rdev));
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return 0;
+  long long size = 0;  // NOLINT
+  if (fscanf(file, "%lld", &size) != 1)
+    size = 0;
+  fclose(file);
+  return size;
+}
+
+bool RegionSource::Map(int64 page_length) {
+  Unmap();
+  if (kind_ == kNode) {
+    mapped_ = size_ / page_length * page_length;
+    if (!mapped_) {
+      logprintf(0, "Process Error: region %s is smaller than a page\n",
+                name_.c_str());
+      return false;
+    }
+    void *base = mmap(NULL, mapped_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      int err = errno;
+      logprintf(0, "Process Error: failed to allocate %lldMB for region "
+                "%s: %s\n", mapped_ >> 20, name_.c_str(),
+                ErrorString(err).c_str());
+      return false;
+    }
+    // Bind before the first touch, so no page lands anywhere else.
+    if (!BindToNode(base, mapped_, node_)) {
+      int err = errno;
+      logprintf(0, "Process Error: failed to bind region %s to node %d: "
+                "%s\n", name_.c_str(), node_, ErrorString(err).c_str());
+      munmap(base, mapped_);
+      return false;
+    }
+    memset(base, 0, mapped_);
+    base_ = base;
+    size_ = mapped_;
+    return true;
+  }
+
+  int flags = O_RDWR;
+  // Register writes shouldn't sit in a cache.
+  if (kind_ == kResource)
+    flags |= O_SYNC;
+  // A pmem file is created if needed, with the size given.
+  if (kind_ == kPmem)
+    flags |= O_CREAT;
+  fd_ = open(path_.c_str(), flags, 0600);
+  if (fd_ < 0) {
+    int err = errno;
+    logprintf(0, "Process Error: failed to open region %s: %s\n",
+              name_.c_str(), ErrorString(err).c_str());
+    return false;
+  }
+
+  int64 size = size_;
+  int64 align = kind_ == kDax ? kDaxAlign : page_length;
+  if (!size) {
+    if (kind_ == kDax) {
+      size = DaxSize(fd_);
+    } else {
+      // Resource files report the BAR length.
+      struct stat st;
+      if (!fstat(fd_, &st))
+        size = st.st_size;
+    }
+  } else if (kind_ == kPmem) {
+    struct stat st;
+    if (!fstat(fd_, &st) && st.st_size < size && ftruncate(fd_, size)) {
+      int err = errno;
+      logprintf(0, "Process Error: failed to extend region %s to %lldMB: "
+                "%s\n", name_.c_str(), size >> 20, ErrorString(err).c_str());
+      Unmap();
+      return false;
+    }
+  }
+  if (align % page_length)
+    align = page_length;
+  mapped_ = size / align * align;
+  if (!mapped_) {
+    logprintf(0, "Process Error: could not find the size of region %s, "
+              "or it is smaller than a page; give it a size\n",
+              name_.c_str());
+    Unmap();
+    return false;
+  }
+
+  void *base = mmap(NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd_, 0);
+  if (base == MAP_FAILED) {
+    int err = errno;
+    logprintf(0, "Process Error: failed to map %lldMB of region %s: %s\n",
+              mapped_ >> 20, name_.c_str(), ErrorString(err).c_str());
+    mapped_ = 0;
+    Unmap();
+    return false;
+  }
+  base_ = base;
+  size_ = mapped_;
+  return true;
+}
+
+void RegionSource::Unmap() {
+  if (base_)
+    munmap(base_, mapped_);
+  base_ = NULL;
+  mapped_ = 0;
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+}
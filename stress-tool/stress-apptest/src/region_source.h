@@ -0,0 +1,87 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Memory outside the test allocation for MemoryRegionThread to stress:
+// device-dax and pmem, PCI BARs, and memory of CPU-less (CXL) NUMA nodes.
+
+#ifndef STRESSAPPTEST_REGION_SOURCE_H_
+#define STRESSAPPTEST_REGION_SOURCE_H_
+
+#include <sys/types.h>
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// One region from a --region description:
+//   dax:<device>       a device-dax character device, such as /dev/dax0.0
+//   pmem:<file>        a file on pmem or any other file system
+//   resource:<file>    a PCI BAR, such as .../0000:03:00.0/resource2
+//   node:<node>        anonymous memory bound to NUMA node <node>
+// followed by any of ",size=<mbytes>", ",width=<bytes>" and
+// ",threads=<count>". The size defaults to the whole device, file or BAR,
+// and to 256MB for a node. Width 1, 2, 4 or 8 makes the threads access the
+// region only with loads and stores of that size, which device registers
+// may need; the default 0 uses the normal copy and check routines, and is 4
+// for BARs. Threads defaults to 1.
+//
+// Not threadsafe.
+class RegionSource {
+ public:
+  RegionSource();
+  ~RegionSource();
+
+  // Fill in the region from 'description'. Returns false if it doesn't
+  // parse.
+  bool Parse(const char *description);
+
+  // Map the region, rounding its size down to 'page_length'. Returns false
+  // on failure after logging why.
+  bool Map(int64 page_length);
+  // Release the mapping.
+  void Unmap();
+
+  void *base() const { return base_; }
+  int64 size() const { return size_; }
+  int width() const { return width_; }
+  int threads() const { return threads_; }
+  // The description, for messages.
+  const string &name() const { return name_; }
+
+ private:
+  enum Kind { kDax, kPmem, kResource, kNode };
+  static const int64 kDefaultNodeBytes = 256LL << 20;
+  // Device-dax mappings must be whole 2MB pages.
+  static const int64 kDaxAlign = 2LL << 20;
+
+  // Size of the device-dax 'fd' from sysfs, or 0.
+  static int64 DaxSize(int fd);
+
+  Kind kind_;
+  string path_;             // Device or file, empty for a node.
+  int node_;
+  int64 size_;              // Requested, then mapped size in bytes.
+  int width_;
+  int threads_;
+  string name_;
+
+  int fd_;                  // Open device or file, or -1.
+  void *base_;              // Mapping, or NULL.
+  int64 mapped_;            // Length of the mapping.
+
+  DISALLOW_COPY_AND_ASSIGN(RegionSource);
+};
+
+#endif  // STRESSAPPTEST_REGION_SOURCE_H_
@@ -0,0 +1,193 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Run report writing, see report.h.
+//
+// The report is one JSON object:
+//   {"version":1,"final":..,"status":..,"time":..,"elapsed":..,
+//    "config":{"cmdline":..,"sat_version":..,"seed":..,"runtime_seconds":..,
+//              "memory_mb":..,"page_length":..},
+//    "errors":..,"status_errors":..,
+//    "types":{"<name>":{"threads":..,"pages":..,"errors":..,"mb":..,
+//                       "mbps":..}, ...},
+//    "devices":[{"kind":..,"name":..,"mb":..,"mbps":..,
+//                "reads":{"count":..,"p50_us":..,"p99_us":..,
+//                         "p999_us":..,"max_us":..},"writes":{..}}, ...],
+//    "clusters":[{"name":..,"cpus":..,"capacity":..,"copy_threads":..,
+//                 "cpu_threads":..,"mb":..,"mbps":..,"max_khz":..,
+//                 "mean_khz":..,"min_khz":..,"peak_khz":..}, ...],
+//    "hardware":[{"device":..,"correctable":..,"fatal":..}, ...]}
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "report.h"
+
+namespace {
+const int kReportVersion = 1;
+
+// Append 'value' as a quoted JSON string.
+void AppendString(string *out, const string &value) {
+  out->push_back('"');
+  for (size_t i = 0; i < value.size(); i++) {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out->append(escape);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendLatency(string *out, const struct ReportLatency &latency) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "{\"count\":%llu,\"p50_us\":%lld,\"p99_us\":%lld,"
+           "\"p999_us\":%lld,\"max_us\":%lld}",
+           latency.count, latency.p50, latency.p99, latency.p999,
+           latency.max);
+  out->append(buf);
+}
+}  // namespace
+
+void ReportLatencyOf(const LatencyHistogram &histogram,
+                     struct ReportLatency *latency) {
+  latency->count = histogram.count();
+  latency->p50 = histogram.Percentile(0.5);
+  latency->p99 = histogram.Percentile(0.99);
+  latency->p999 = histogram.Percentile(0.999);
+  latency->max = histogram.max();
+}
+
+string ReportJson(const struct RunReport &report) {
+  char buf[256];
+  string out;
+  snprintf(buf, sizeof(buf),
+           "{\"version\":%d,\"final\":%s,\"status\":", kReportVersion,
+           report.final ? "true" : "false");
+  out.append(buf);
+  AppendString(&out, report.status);
+  snprintf(buf, sizeof(buf), ",\"time\":%lld,\"elapsed\":%.3f,"
+           "\"config\":{\"cmdline\":", report.time, report.elapsed);
+  out.append(buf);
+  AppendString(&out, report.cmdline);
+  out.append(",\"sat_version\":");
+  AppendString(&out, report.version);
+  snprintf(buf, sizeof(buf),
+           ",\"seed\":%llu,\"runtime_seconds\":%d,\"memory_mb\":%lld,"
+           "\"page_length\":%lld},\"errors\":%lld,\"status_errors\":%lld,"
+           "\"types\":{",
+           report.seed, report.runtime_seconds, report.memory_mb,
+           report.page_length, report.errors, report.status_errors);
+  out.append(buf);
+
+  for (map<string, struct ReportType>::const_iterator it =
+           report.types.begin(); it != report.types.end(); ++it) {
+    if (it != report.types.begin())
+      out.push_back(',');
+    AppendString(&out, it->first);
+    snprintf(buf, sizeof(buf),
+             ":{\"threads\":%d,\"pages\":%lld,\"errors\":%lld,"
+             "\"mb\":%.2f,\"mbps\":%.2f}",
+             it->second.threads, it->second.pages, it->second.errors,
+             it->second.data, it->second.bandwidth);
+    out.append(buf);
+  }
+
+  out.append("},\"devices\":[");
+  for (size_t i = 0; i < report.devices.size(); i++) {
+    const struct ReportDevice &device = report.devices[i];
+    if (i)
+      out.push_back(',');
+    out.append("{\"kind\":");
+    AppendString(&out, device.kind);
+    out.append(",\"name\":");
+    AppendString(&out, device.name);
+    snprintf(buf, sizeof(buf), ",\"mb\":%.2f,\"mbps\":%.2f,\"reads\":",
+             device.data, device.bandwidth);
+    out.append(buf);
+    AppendLatency(&out, device.reads);
+    out.append(",\"writes\":");
+    AppendLatency(&out, device.writes);
+    out.push_back('}');
+  }
+
+  out.append("],\"clusters\":[");
+  for (size_t i = 0; i < report.clusters.size(); i++) {
+    const struct ReportCluster &cluster = report.clusters[i];
+    if (i)
+      out.push_back(',');
+    out.append("{\"name\":");
+    AppendString(&out, cluster.name);
+    out.append(",\"cpus\":");
+    AppendString(&out, cluster.cpus);
+    snprintf(buf, sizeof(buf),
+             ",\"capacity\":%d,\"copy_threads\":%d,\"cpu_threads\":%d,"
+             "\"mb\":%.2f,\"mbps\":%.2f,\"max_khz\":%lld,"
+             "\"mean_khz\":%lld,\"min_khz\":%lld,\"peak_khz\":%lld}",
+             cluster.capacity, cluster.copy_threads, cluster.cpu_threads,
+             cluster.data, cluster.bandwidth, cluster.max_khz,
+             cluster.mean_khz, cluster.min_khz, cluster.peak_khz);
+    out.append(buf);
+  }
+
+  out.append("],\"hardware\":[");
+  for (DeviceErrorMap::const_iterator it = report.hardware.begin();
+       it != report.hardware.end(); ++it) {
+    if (it != report.hardware.begin())
+      out.push_back(',');
+    out.append("{\"device\":");
+    AppendString(&out, it->first);
+    snprintf(buf, sizeof(buf), ",\"correctable\":%lld,\"fatal\":%lld}",
+             it->second.correctable, it->second.fatal);
+    out.append(buf);
+  }
+  out.append("]}");
+  return out;
+}
+
+bool SaveReport(const char *path, const struct RunReport &report) {
+  string temp = string(path) + ".tmp";
+  FILE *file = fopen(temp.c_str(), "w");
+  if (!file)
+    return false;
+
+  string json = ReportJson(report);
+  bool ok = fwrite(json.data(), 1, json.size(), file) == json.size() &&
+            fputc('\n', file) != EOF &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+  int error = errno;
+  if (fclose(file) && ok) {
+    ok = false;
+    error = errno;
+  }
+  if (ok && rename(temp.c_str(), path)) {
+    ok = false;
+    error = errno;
+  }
+  if (!ok) {
+    unlink(temp.c_str());
+    errno = error;
+  }
+  return ok;
+}
@@ -0,0 +1,111 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Machine readable run report, written with --report as one JSON document
+// so that a fleet harness can ingest the results without parsing the
+// Stats lines of the log.
+
+#ifndef STRESSAPPTEST_REPORT_H_
+#define STRESSAPPTEST_REPORT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "error_diag.h"
+#include "latency_histogram.h"
+#include "sattypes.h"
+
+// Percentiles of an I/O latency histogram, in microseconds.
+struct ReportLatency {
+  uint64 count;
+  int64 p50;
+  int64 p99;
+  int64 p999;
+  int64 max;
+};
+
+// Totals of one thread type.
+struct ReportType {
+  int threads;
+  int64 pages;
+  int64 errors;
+  double data;                      // In MB.
+  double bandwidth;                 // In MB/s.
+};
+
+// Traffic of one disk or file device.
+struct ReportDevice {
+  string kind;                      // "disk" or "file".
+  string name;
+  double data;                      // In MB.
+  double bandwidth;                 // In MB/s.
+  struct ReportLatency reads;
+  struct ReportLatency writes;
+};
+
+// Placement, traffic and frequency of one cpu cluster.
+struct ReportCluster {
+  string name;
+  string cpus;                      // As a sysfs list.
+  int capacity;
+  int copy_threads;
+  int cpu_threads;
+  double data;                      // Copy thread MB.
+  double bandwidth;                 // Copy thread MB/s.
+  int64 max_khz;                    // cpuinfo_max_freq, 0 if unknown.
+  // Sampled scaling_cur_freq, 0 if unknown.
+  int64 mean_khz;
+  int64 min_khz;
+  int64 peak_khz;
+};
+
+// Everything in a report. Interval reports are written while the threads
+// run, with status "RUNNING" and bandwidth over the elapsed time.
+struct RunReport {
+  bool final;
+  string status;                    // "PASS", "FAIL" or "RUNNING".
+  int64 time;                       // Unix time of the report.
+  double elapsed;                   // Seconds since the threads started.
+  // Configuration.
+  string cmdline;
+  string version;
+  uint64 seed;
+  int runtime_seconds;
+  int64 memory_mb;
+  int64 page_length;
+  // Results.
+  int64 errors;                     // Hardware incidents.
+  int64 status_errors;              // Procedural errors.
+  map<string, struct ReportType> types;  // By thread type name.
+  vector<struct ReportDevice> devices;
+  vector<struct ReportCluster> clusters;  // Empty unless placed by cluster.
+  DeviceErrorMap hardware;          // Errors by DIMM or other device.
+};
+
+// Copy the percentiles of 'histogram' into 'latency'.
+void ReportLatencyOf(const LatencyHistogram &histogram,
+                     struct ReportLatency *latency);
+
+// Returns 'report' as a JSON object.
+string ReportJson(const struct RunReport &report);
+
+// Replace 'path' with 'report'. The file is written next to 'path' and
+// renamed over it, so readers see either the old or the new report.
+// Returns false and sets errno on failure.
+bool SaveReport(const char *path, const struct RunReport &report);
+
+#endif  // STRESSAPPTEST_REPORT_H_
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/times.h>
 
@@ -36,14 +37,18 @@
 // #define __USE_LARGEFILE64
 #include <fcntl.h>
 
+#include <algorithm>
 #include <list>
 #include <string>
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
+#include "cpu_kernels.h"
+#include "cpu_topology.h"
 #include "disk_blocks.h"
 #include "logger.h"
 #include "os.h"
+#include "prng.h"
 #include "sat.h"
 #include "sattypes.h"
 #include "worker.h"
@@ -55,6 +60,47 @@ static const char* kVersion = "1.0.0";
 static const char* kVersion = PACKAGE_VERSION;
 #endif
 
+const char *const Sat::kPauseGroupNames[Sat::kPauseGroupCount] = {
+  "memory", "file", "disk", "cpu_freq",
+};
+
+// Names of the thread types in telemetry and checkpoints, indexed by
+// Sat::ThreadType.
+static const char *const kThreadTypeNames[] = {
+  "memory", "file", "net", "net_slave", "check", "invert",
+  "disk", "random_disk", "cpu", "error", "cc", "cpu_freq",
+  "latency", "rowhammer", "march", "region", "power_wave",
+  "net_coordinator", "tlb",
+};
+
+static const char *ThreadTypeName(int type) {
+  static const int kCount = sizeof(kThreadTypeNames) /
+                            sizeof(*kThreadTypeNames);
+  return type >= 0 && type < kCount ? kThreadTypeNames[type] : "unknown";
+}
+
+// Returns the thread type called 'name', or -1.
+static int ThreadTypeFromName(const string &name) {
+  static const int kCount = sizeof(kThreadTypeNames) /
+                            sizeof(*kThreadTypeNames);
+  for (int type = 0; type < kCount; type++) {
+    if (name == kThreadTypeNames[type])
+      return type;
+  }
+  return -1;
+}
+
+// Add the counts of all thread types in 'types' to 'sum'.
+static void SumTypeCounts(const map<string, struct CheckpointCounts> &types,
+                          struct CheckpointCounts *sum) {
+  for (map<string, struct CheckpointCounts>::const_iterator it =
+           types.begin(); it != types.end(); ++it) {
+    sum->pages += it->second.pages;
+    sum->errors += it->second.errors;
+    sum->data += it->second.data;
+  }
+}
+
 // Global stressapptest reference, for use by signal handler.
 // This makes Sat objects not safe for multiple instances.
 namespace {
@@ -102,6 +148,24 @@ bool Sat::InitializeLogfile() {
     }
     Logger::GlobalLogger()->SetLogFd(logfile_);
   }
+  // Open binary error log.
+  if (binary_error_log_[0]) {
+    if (!error_log_.Open(binary_error_log_)) {
+      printf("Fatal Error: cannot open file %s for binary error log\n",
+             binary_error_log_);
+      bad_status();
+      return false;
+    }
+  }
+  // Open telemetry file or socket.
+  if (telemetry_target_[0]) {
+    if (!telemetry_.Open(telemetry_target_)) {
+      printf("Fatal Error: cannot open %s for telemetry\n",
+             telemetry_target_);
+      bad_status();
+      return false;
+    }
+  }
   return true;
 }
 
@@ -145,15 +209,28 @@ bool Sat::CheckEnvironment() {
     }
   }
 
+  // A shard only uses the cpus of its node.
+  int cpus = os_->num_cpus();
+  if (shard_ >= 0) {
+    cpus = cpuset_count(&shards_.node(shard_).cpus);
+    logprintf(5, "Log: NUMA shard %d of %d on node %d, %d cpus\n",
+              shard_, shards_.shards(), shards_.node(shard_).node, cpus);
+    if (fill_threads_ == 0)
+      fill_threads_ = cpus;
+  }
+
   // Use all CPUs if nothing is specified.
   if (memory_threads_ == -1) {
-    memory_threads_ = os_->num_cpus();
+    memory_threads_ = cpus;
     logprintf(7, "Log: Defaulting to %d copy threads\n", memory_threads_);
   }
 
   // Use all memory if no size is specified.
   if (size_mb_ == 0)
     size_mb_ = os_->FindFreeMemSize() / kMegabyte;
+  // Shards split the memory between them.
+  if (shard_ >= 0)
+    size_mb_ /= shards_.shards();
   size_ = static_cast<int64>(size_mb_) * kMegabyte;
 
   // Autodetect file locations.
@@ -175,6 +252,25 @@ bool Sat::CheckEnvironment() {
     }
   }
 
+  // Autodetect disks.
+  if (disk_discover_) {
+    list<string> disks = os_->FindDiskDevices();
+    int found = 0;
+    for (list<string>::iterator it = disks.begin(); it != disks.end(); ++it) {
+      if (std::find(diskfilename_.begin(), diskfilename_.end(), *it) !=
+          diskfilename_.end())
+        continue;
+      logprintf(5, "Log: Found unused disk %s\n", it->c_str());
+      disk_threads_++;
+      diskfilename_.push_back(*it);
+      blocktables_.push_back(new DiskBlockTable());
+      found++;
+    }
+    if (found && !non_destructive_)
+      logprintf(1, "Log: --destructive will overwrite %d discovered disks\n",
+                found);
+  }
+
   // We'd better have some memory by this point.
   if (size_ < 1) {
     logprintf(0, "Process Error: No memory found to test.\n");
@@ -184,7 +280,7 @@ bool Sat::CheckEnvironment() {
 
   if (tag_mode_ && ((file_threads_ > 0) ||
                     (disk_threads_ > 0) ||
-                    (net_threads_ > 0))) {
+                    (net_threads_ > 0) || net_register_[0])) {
     logprintf(0, "Process Error: Memory tag mode incompatible "
                  "with disk/network DMA.\n");
     bad_status();
@@ -257,6 +353,10 @@ bool Sat::GetValid(struct page_entry *pe, int32 tag) {
   // Get valid page depending on implementation.
   if (pe_q_implementation_ == SAT_FINELOCK)
     result = finelock_q_->GetValid(pe, tag);
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    result = sharded_q_->GetValid(pe, tag);
+  else if (pe_q_implementation_ == SAT_SPLIT)
+    result = split_q_->GetValid(pe, tag);
   else if (pe_q_implementation_ == SAT_ONELOCK)
     result = valid_->PopRandom(pe);
 
@@ -266,9 +366,14 @@ bool Sat::GetValid(struct page_entry *pe, int32 tag) {
     // Tag this access and current pattern.
     pe->ts = os_->GetTimestamp();
     pe->lastpattern = pe->pattern;
+    CoverageUpdate(pe);
 
     return (pe->addr != 0);     // Return success or failure.
   }
+  // With per node memory, hand out pages from other nodes once the tagged
+  // ones run out rather than stalling the thread.
+  if (numa_alloc_ && tag != kDontCareTag && tag != kInvalidTag)
+    return GetValid(pe, kDontCareTag);
   return false;
 }
 
@@ -280,6 +385,10 @@ bool Sat::PutValid(struct page_entry *pe) {
   // Put valid page depending on implementation.
   if (pe_q_implementation_ == SAT_FINELOCK)
     return finelock_q_->PutValid(pe);
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    return sharded_q_->PutValid(pe);
+  else if (pe_q_implementation_ == SAT_SPLIT)
+    return split_q_->PutValid(pe);
   else if (pe_q_implementation_ == SAT_ONELOCK)
     return valid_->Push(pe);
   else
@@ -296,6 +405,10 @@ bool Sat::GetEmpty(struct page_entry *pe, int32 tag) {
   // Get empty page depending on implementation.
   if (pe_q_implementation_ == SAT_FINELOCK)
     result = finelock_q_->GetEmpty(pe, tag);
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    result = sharded_q_->GetEmpty(pe, tag);
+  else if (pe_q_implementation_ == SAT_SPLIT)
+    result = split_q_->GetEmpty(pe, tag);
   else if (pe_q_implementation_ == SAT_ONELOCK)
     result = empty_->PopRandom(pe);
 
@@ -303,6 +416,8 @@ bool Sat::GetEmpty(struct page_entry *pe, int32 tag) {
     pe->addr = os_->PrepareTestMem(pe->offset, page_length_);  // Map it.
     return (pe->addr != 0);     // Return success or failure.
   }
+  if (numa_alloc_ && tag != kDontCareTag && tag != kInvalidTag)
+    return GetEmpty(pe, kDontCareTag);
   return false;
 }
 
@@ -314,12 +429,66 @@ bool Sat::PutEmpty(struct page_entry *pe) {
   // Put empty page depending on implementation.
   if (pe_q_implementation_ == SAT_FINELOCK)
     return finelock_q_->PutEmpty(pe);
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    return sharded_q_->PutEmpty(pe);
+  else if (pe_q_implementation_ == SAT_SPLIT)
+    return split_q_->PutEmpty(pe);
   else if (pe_q_implementation_ == SAT_ONELOCK)
     return empty_->Push(pe);
   else
     return false;
 }
 
+bool Sat::ClaimPage(int64 index, bool valid, int32 tag,
+                    struct page_entry *pe) {
+  bool result = false;
+  // Only the queues that keep pages in place can hand out a given page.
+  if (pe_q_implementation_ == SAT_FINELOCK)
+    result = finelock_q_->ClaimPage(index, valid, tag, pe);
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    result = sharded_q_->ClaimPage(index, valid, tag, pe);
+  if (!result)
+    return false;
+
+  pe->addr = os_->PrepareTestMem(pe->offset, page_length_);  // Map it.
+  if (!pe->addr) {
+    if (valid)
+      PutValid(pe);
+    else
+      PutEmpty(pe);
+    return false;
+  }
+  if (valid) {
+    pe->ts = os_->GetTimestamp();
+    pe->lastpattern = pe->pattern;
+    CoverageUpdate(pe);
+  }
+  return true;
+}
+
+int Sat::GetSpan(struct page_entry *pes, int count, int32 tag, bool valid) {
+  if (count < 1)
+    return 0;
+  if (!(valid ? GetValid(&pes[0], tag) : GetEmpty(&pes[0], tag)))
+    return 0;
+  // Extend the span past the random first page for as long as the
+  // following pages are free, and of the same kind and tag.
+  int64 first = pes[0].offset / page_length_;
+  int found = 1;
+  while (found < count &&
+         ClaimPage(first + found, valid, pes[0].tag, &pes[found]))
+    found++;
+  return found;
+}
+
+int Sat::GetValidSpan(struct page_entry *pes, int count, int32 tag) {
+  return GetSpan(pes, count, tag, true);
+}
+
+int Sat::GetEmptySpan(struct page_entry *pes, int count, int32 tag) {
+  return GetSpan(pes, count, tag, false);
+}
+
 // Set up the bitmap of physical pages in case we want to see which pages were
 // accessed under this run of SAT.
 void Sat::AddrMapInit() {
@@ -354,8 +523,15 @@ void Sat::AddrMapUpdate(struct page_entry *pe) {
   uint64 arraysize = page_bitmap_size_ / 4096 / 8;
 
   char *base = reinterpret_cast<char*>(pe->addr);
-  for (int i = 0; i < page_length_; i += 4096) {
-    uint64 paddr = os_->VirtualToPhysical(base + i);
+  int count = (page_length_ + 4095) / 4096;
+  vector<void*> vaddrs(count);
+  vector<uint64> paddrs(count);
+  for (int i = 0; i < count; i++)
+    vaddrs[i] = base + i * 4096;
+  os_->VirtualToPhysicalBulk(&vaddrs[0], count, &paddrs[0]);
+
+  for (int i = 0; i < count; i++) {
+    uint64 paddr = paddrs[i];
 
     uint32 offset = paddr / 4096 / 8;
     unsigned char mask = 1 << ((paddr / 4096) % 8);
@@ -398,12 +574,59 @@ void Sat::AddrMapPrint() {
   logprintf(4, "Log: Done printing physical ranges.\n");
 }
 
+// One bit per page of test memory, set when the page is handed out to be
+// read. Pages stay at the same physical address for the whole run, so this
+// is also the physical coverage of the test memory.
+void Sat::CoverageUpdate(const struct page_entry *pe) {
+  if (!coverage_bitmap_)
+    return;
+  uint64 page = pe->offset / page_length_;
+  __sync_fetch_and_or(&coverage_bitmap_[page / 64], 1ULL << (page % 64));
+}
+
+void Sat::CoverageReport(time_t seconds) {
+  if (!coverage_bitmap_)
+    return;
+  int64 covered = 0;
+  for (uint64 i = 0; i < coverage_words_; i++)
+    covered += __builtin_popcountll(
+        __atomic_exchange_n(&coverage_bitmap_[i], 0ULL, __ATOMIC_RELAXED));
+  logprintf(5, "Log: Coverage: read %lld of %lld pages (%.1f%%) in the "
+            "last %d seconds\n", covered, pages_,
+            pages_ ? covered * 100. / pages_ : 0.,
+            static_cast<int>(seconds));
+}
+
 // Initializes page lists and fills pages with data patterns.
+// Run a thread that works through pages from 'first_page' on their own
+// node, and spread the other threads one per cpu.
+void Sat::PlaceRangeThread(WorkerThread *thread, int i, int64 first_page) {
+  int32 region = os_->FindNumaRegion(first_page * page_length_);
+  if (region >= 0) {
+    thread->set_cpu_mask(os_->FindCoreMask(region));
+    return;
+  }
+  cpu_set_t available_cpus;
+  thread->AvailableCpus(&available_cpus);
+  int cores = cpuset_count(&available_cpus);
+  int nth = cores ? i % cores : -1;
+  for (int cpu = 0; nth >= 0 && cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &available_cpus))
+      continue;
+    if (nth == 0)
+      thread->set_cpu_mask_to_cpu(cpu);
+    nth--;
+  }
+}
+
 bool Sat::InitializePages() {
   int result = 1;
   // Calculate needed page totals.
   int64 neededpages = memory_threads_ +
     invert_threads_ +
+    latency_threads_ +
+    rowhammer_threads_ * RowhammerThread::kHammerPages +
+    march_threads_ +
     check_threads_ +
     net_threads_ +
     file_threads_;
@@ -411,8 +634,11 @@ bool Sat::InitializePages() {
   // Empty-valid page ratio is adjusted depending on queue implementation.
   // since fine-grain-locked queue keeps both valid and empty entries in the
   // same queue and randomly traverse to find pages, the empty-valid ratio
-  // should be more even.
-  if (pe_q_implementation_ == SAT_FINELOCK)
+  // should be more even. The sharded queue shares that layout. The split
+  // queue, like the coarse-grain-locked one, keeps empty pages in their own
+  // list and only needs a small pool of them.
+  if ((pe_q_implementation_ == SAT_FINELOCK) ||
+      (pe_q_implementation_ == SAT_SHARDED))
     freepages_ = pages_ / 5 * 2;  // Mark roughly 2/5 of all pages as Empty.
   else
     freepages_ = (pages_ / 100) + (2 * neededpages);
@@ -440,45 +666,35 @@ bool Sat::InitializePages() {
             pages_,
             freepages_);
 
-  // Initialize page locations.
-  for (int64 i = 0; i < pages_; i++) {
-    struct page_entry pe;
-    init_pe(&pe);
-    pe.offset = i * page_length_;
-    result &= PutEmpty(&pe);
-  }
-
-  if (!result) {
-    logprintf(0, "Process Error: while initializing empty_ list\n");
-    bad_status();
-    return false;
-  }
-
   // Fill valid pages with test patterns.
-  // Use fill threads to do this.
+  // Use fill threads to do this. Each thread fills one contiguous range of
+  // the page array and hands the pages straight to the valid list, so the
+  // pages don't pass through the empty list first.
   WorkerStatus fill_status;
   WorkerVector fill_vector;
 
+  if (fill_threads_ == 0)
+    fill_threads_ = os_->num_cpus();
+  int fill_threads = fill_threads_;
+  if (fill_threads > pages_)
+    fill_threads = pages_;
+
   logprintf(12, "Starting Fill threads: %d threads, %d pages\n",
-            fill_threads_, pages_);
+            fill_threads, pages_);
   // Initialize the fill threads.
-  for (int i = 0; i < fill_threads_; i++) {
+  for (int i = 0; i < fill_threads; i++) {
     FillThread *thread = new FillThread();
     thread->InitThread(i, this, os_, patternlist_, &fill_status);
-    if (i != fill_threads_ - 1) {
-        logprintf(12, "Starting Fill Threads %d: %d pages\n",
-                  i, pages_ / fill_threads_);
-        thread->SetFillPages(pages_ / fill_threads_);
-      // The last thread finishes up all the leftover pages.
-    } else {
-      logprintf(12, "Starting Fill Threads %d: %d pages\n",
-                i, pages_ - pages_ / fill_threads_ * i);
-        thread->SetFillPages(pages_ - pages_ / fill_threads_ * i);
-    }
+    int64 first_page = pages_ * i / fill_threads;
+    int64 num_pages = pages_ * (i + 1) / fill_threads - first_page;
+    logprintf(12, "Starting Fill Threads %d: %d pages\n", i, num_pages);
+    thread->SetFillRange(first_page, num_pages);
+    PlaceRangeThread(thread, i, first_page);
     fill_vector.push_back(thread);
   }
 
   // Spawn the fill threads.
+  int64 fill_start_us = sat_get_time_us();
   fill_status.Initialize();
   for (WorkerVector::const_iterator it = fill_vector.begin();
        it != fill_vector.end(); ++it)
@@ -499,18 +715,33 @@ bool Sat::InitializePages() {
   }
   fill_vector.clear();
   fill_status.Destroy();
+  int64 fill_us = sat_get_time_us() - fill_start_us;
+  if (fill_us < 1)
+    fill_us = 1;
+  logprintf(5, "Stats: Filled %lldMB in %.2fs with %d threads, %.2fGB/s\n",
+            size_ / kMegabyte, fill_us / 1000000.0, fill_threads,
+            size_ * 1.0 / (1024 * kMegabyte) /
+            (fill_us / 1000000.0));
   logprintf(12, "Log: Done filling pages.\n");
   logprintf(12, "Log: Allocating pages.\n");
 
   AddrMapInit();
 
+  bool channels = channel_map_.enabled() && finelock_q_;
+  vector<int64> channel_pages(channel_map_.channels() + 1);
+  if (channels)
+    finelock_q_->SetChannels(channel_map_.channels());
+
   // Initialize page locations.
   for (int64 i = 0; i < pages_; i++) {
     struct page_entry pe;
     // Only get valid pages with uninitialized tags here.
     if (GetValid(&pe, kInvalidTag)) {
       int64 paddr = os_->VirtualToPhysical(pe.addr);
-      int32 region = os_->FindRegion(paddr);
+      // Per node memory is tagged by the slab it was allocated in.
+      int32 region = os_->FindNumaRegion(pe.offset);
+      if (region < 0)
+        region = os_->FindRegion(paddr);
       region_[region]++;
       pe.paddr = paddr;
       pe.tag = 1 << region;
@@ -519,6 +750,14 @@ bool Sat::InitializePages() {
       // Generate a physical region map
       AddrMapUpdate(&pe);
 
+      if (channels) {
+        int channel = PageChannel(pe);
+        finelock_q_->SetPageChannel(pe.offset, channel);
+        if (channel == FineLockPEQueue::kMixedChannel)
+          channel = channel_map_.channels();
+        channel_pages[channel]++;
+      }
+
       // Note: this does not allocate free pages among all regions
       // fairly. However, with large enough (thousands) random number
       // of pages being marked free in each region, the free pages
@@ -538,6 +777,17 @@ bool Sat::InitializePages() {
 
   AddrMapPrint();
 
+  if (channels) {
+    for (int i = 0; i < channel_map_.channels(); i++)
+      logprintf(5, "Log: Channel %d: %lld pages.\n", i, channel_pages[i]);
+    int64 mixed = channel_pages[channel_map_.channels()];
+    if (mixed)
+      logprintf(5, "Log: %lld of %lld pages span channels and are only "
+                "scheduled as a last resort.\n", mixed, pages_);
+    finelock_q_->set_channel_schedule(channel_schedule_);
+    finelock_q_->set_active_channel(0);
+  }
+
   for (int i = 0; i < 32; i++) {
     if (region_mask_ & (1 << i)) {
       region_count_++;
@@ -549,6 +799,23 @@ bool Sat::InitializePages() {
   return true;
 }
 
+// The channel of every 4k frame of a page must agree for the page to be in
+// one channel, as pages bigger than a frame need not be contiguous.
+int Sat::PageChannel(const struct page_entry &pe) {
+  static const int64 kFrameSize = 4096;
+  if (!pe.paddr || (channel_map_.channel_bits() & (kFrameSize - 1)))
+    return FineLockPEQueue::kMixedChannel;
+  int channel = channel_map_.Channel(pe.paddr);
+  for (int64 offset = kFrameSize; offset < page_length_;
+       offset += kFrameSize) {
+    uint64 paddr = os_->VirtualToPhysical(
+        reinterpret_cast<char*>(pe.addr) + offset);
+    if (!paddr || channel_map_.Channel(paddr) != channel)
+      return FineLockPEQueue::kMixedChannel;
+  }
+  return channel;
+}
+
 // Print SAT version info.
 bool Sat::PrintVersion() {
   logprintf(1, "Stats: SAT revision %s, %d bit binary\n",
@@ -573,6 +840,8 @@ bool Sat::Initialize() {
 
   logprintf(5, "Log: Commandline - %s\n", cmdline_.c_str());
   PrintVersion();
+  logprintf(5, "Log: Random seed %llu, run again with --seed %llu to repeat "
+            "the random choices of each thread.\n", seed_, seed_);
 
   std::map<std::string, std::string> options;
 
@@ -591,6 +860,11 @@ bool Sat::Initialize() {
   if (reserve_mb_ > 0)
     os_->SetReserveSize(reserve_mb_);
 
+  if (numa_alloc_)
+    os_->SetNumaAllocation(true);
+
+  os_->SetHugepageMode(hugepage_mode_, hugepage_size_mb_ * kMegabyte);
+
   if (channels_.size() > 0) {
     logprintf(6, "Log: Decoding memory: %dx%d bit channels,"
         "%d modules per channel (x%d), decoding hash 0x%x\n",
@@ -598,6 +872,12 @@ bool Sat::Initialize() {
         channel_width_/channels_[0].size(), channel_hash_);
     os_->SetDramMappingParams(channel_hash_, channel_width_, &channels_);
   }
+  if (channel_map_.enabled()) {
+    logprintf(6, "Log: Decoding memory: %d channels, %d ranks, map %s\n",
+              channel_map_.channels(), channel_map_.ranks(),
+              channel_map_.Format().c_str());
+    os_->SetChannelMap(&channel_map_);
+  }
 
   if (!os_->Initialize()) {
     logprintf(0, "Process Error: Failed to initialize OS layer\n");
@@ -605,11 +885,15 @@ bool Sat::Initialize() {
     delete os_;
     return false;
   }
+  io_buffers_.Initialize(os_, page_length_);
 
   // Checks that OS/Build/Platform is supported.
   if (!CheckEnvironment())
     return false;
 
+  if (checkpoint_file_[0])
+    ResumeCheckpoint();
+
   if (error_injection_)
     os_->set_error_injection(true);
 
@@ -624,6 +908,8 @@ bool Sat::Initialize() {
   // Allocate the memory to test.
   if (!AllocateMemory())
     return false;
+  if (scrub_slice_ >= 0)
+    scrubber_.Claim(os_);
 
   logprintf(5, "Stats: Starting SAT, %dM, %d seconds\n",
             static_cast<int>(size_/kMegabyte),
@@ -634,6 +920,11 @@ bool Sat::Initialize() {
 
   // Initialize memory allocation.
   pages_ = size_ / page_length_;
+  if (coverage_window_) {
+    coverage_words_ = (pages_ + 63) / 64;
+    coverage_bitmap_ = new uint64[coverage_words_];
+    memset(coverage_bitmap_, 0, coverage_words_ * sizeof(*coverage_bitmap_));
+  }
 
   // Allocate page queue depending on queue implementation switch.
   if (pe_q_implementation_ == SAT_FINELOCK) {
@@ -641,7 +932,20 @@ bool Sat::Initialize() {
       if (finelock_q_ == NULL)
         return false;
       finelock_q_->set_os(os_);
+      finelock_q_->set_oldest_first(coverage_targeting_);
       os_->set_err_log_callback(finelock_q_->get_err_log_callback());
+  } else if (pe_q_implementation_ == SAT_SHARDED) {
+      sharded_q_ = new ShardedPEQueue(pages_, page_length_, os_->num_cpus());
+      if (sharded_q_ == NULL)
+        return false;
+      sharded_q_->set_os(os_);
+      os_->set_err_log_callback(sharded_q_->get_err_log_callback());
+  } else if (pe_q_implementation_ == SAT_SPLIT) {
+      split_q_ = new SplitPEQueue(pages_, page_length_);
+      if (split_q_ == NULL)
+        return false;
+      split_q_->set_os(os_);
+      os_->set_err_log_callback(split_q_->get_err_log_callback());
   } else if (pe_q_implementation_ == SAT_ONELOCK) {
       empty_ = new PageEntryQueue(pages_);
       valid_ = new PageEntryQueue(pages_);
@@ -654,6 +958,31 @@ bool Sat::Initialize() {
     return false;
   }
 
+  for (size_t i = 0; i < regions_.size(); i++) {
+    if (!regions_[i]->Map(page_length_)) {
+      bad_status();
+      return false;
+    }
+    logprintf(5, "Log: Region %s: %lldMB at %p, %d threads\n",
+              regions_[i]->name().c_str(), regions_[i]->size() >> 20,
+              regions_[i]->base(), regions_[i]->threads());
+  }
+  os_->ReportTestMemPageSize();
+
+  // Register the test memory for RDMA once, every network thread uses it.
+  if (net_rdma_ && (net_threads_ || listen_threads_ || net_register_[0])) {
+    if (!os_->testmem()) {
+      logprintf(0, "Process Error: --net_rdma needs the test memory "
+                "mapped all at once.\n");
+      bad_status();
+      return false;
+    }
+    if (!rdma_.Open(os_->testmem(), os_->testmemsize())) {
+      bad_status();
+      return false;
+    }
+  }
+
   return true;
 }
 
@@ -662,20 +991,30 @@ Sat::Sat() {
   // Set defaults, command line might override these.
   runtime_seconds_ = 20;
   page_length_ = kSatPageSize;
+  copy_page_size_ = 0;
+  copy_span_pages_ = 1;
   disk_pages_ = kSatDiskPage;
   pages_ = 0;
   size_mb_ = 0;
   size_ = size_mb_ * kMegabyte;
   reserve_mb_ = 0;
   min_hugepages_mbytes_ = 0;
+  hugepage_mode_ = OsLayer::kHugepageShm;
+  hugepage_size_mb_ = 0;
   freepages_ = 0;
   paddr_base_ = 0;
   channel_hash_ = kCacheLineSize;
   channel_width_ = 64;
 
   user_break_ = false;
+  embedded_ = false;
+  pause_requested_ = false;
+  final_totals_.pages = 0;
+  final_totals_.errors = 0;
+  final_totals_.data = 0.;
   verbosity_ = 8;
   Logger::GlobalLogger()->SetVerbosity(verbosity_);
+  seed_ = 0;
   print_delay_ = 10;
   strict_ = 1;
   warm_ = 0;
@@ -696,6 +1035,10 @@ Sat::Sat() {
   do_page_map_ = false;
   page_bitmap_ = 0;
   page_bitmap_size_ = 0;
+  coverage_window_ = 0;
+  coverage_targeting_ = false;
+  coverage_bitmap_ = 0;
+  coverage_words_ = 0;
 
   // Cache coherency data initialization.
   cc_test_ = false;         // Flag to trigger cc threads.
@@ -703,6 +1046,13 @@ Sat::Sat() {
   cc_cacheline_size_ = 0;   // Size of a cacheline (0 for auto-detect).
   cc_inc_count_ = 1000;     // Number of times to increment the shared variable.
   cc_cacheline_data_ = 0;   // Cache Line size datastructure.
+  cc_line_pairs_ = false;
+  cc_threads_per_line_ = 0;
+  cc_node_ = 0;
+  cc_line_mem_ = NULL;
+  cc_line_mem_length_ = 0;
+  cc_pairs_ = false;        // Bounce lines between core pairs.
+  memset(&cc_pair_schedule_, 0, sizeof(cc_pair_schedule_));
 
   // Cpu frequency data initialization.
   cpu_freq_test_ = false;   // Flag to trigger cpu frequency thread.
@@ -713,12 +1063,36 @@ Sat::Sat() {
   file_threads_ = 0;
   net_threads_ = 0;
   listen_threads_ = 0;
+  net_zerocopy_ = false;
+  net_event_threads_ = 0;
+  net_rdma_ = false;
+  net_rdma_device_[0] = '\0';
+  net_coordinator_hosts_ = 0;
+  net_topology_ = kNetTopologyRing;
+  net_register_[0] = '\0';
+  net_start_us_ = 0;
   // Default to autodetect number of cpus, and run that many threads.
   memory_threads_ = -1;
+  autotune_seconds_ = 0;
+  autotune_max_temp_ = 0;
+  autotune_step_ = 0;
+  autotune_step_seconds_ = 0;
+  autotune_last_data_ = 0.;
+  autotune_last_us_ = 0;
   invert_threads_ = 0;
-  fill_threads_ = 8;
+  latency_threads_ = 0;
+  tlb_threads_ = 0;
+  tlb_mb_ = 256;
+  rowhammer_threads_ = 0;
+  rowhammer_count_ = 200000;
+  channel_schedule_ = FineLockPEQueue::kChannelRandom;
+  channel_sweep_seconds_ = 30;
+  channel_start_us_ = 0;
+  march_threads_ = 0;
+  fill_threads_ = 0;
   check_threads_ = 0;
   cpu_stress_threads_ = 0;
+  cpu_stress_kernel_ = "float";
   disk_threads_ = 0;
   total_threads_ = 0;
 
@@ -728,6 +1102,17 @@ Sat::Sat() {
     region_[i] = 0;
   }
   region_mode_ = 0;
+  numa_alloc_ = false;
+  numa_shards_ = false;
+  shard_ = -1;
+  scrub_mb_ = 0;
+  scrub_slice_seconds_ = 300;
+  scrub_pause_seconds_ = 60;
+  scrub_cgroup_[0] = 0;
+  scrub_slice_ = -1;
+  topology_placement_ = false;
+  cluster_placement_[0] = 0;
+  cluster_khz_samples_ = 0;
 
   errorcount_ = 0;
   statuscount_ = 0;
@@ -735,12 +1120,25 @@ Sat::Sat() {
   valid_ = 0;
   empty_ = 0;
   finelock_q_ = 0;
+  sharded_q_ = 0;
+  split_q_ = 0;
   // Default to use fine-grain lock for better performance.
   pe_q_implementation_ = SAT_FINELOCK;
 
   os_ = 0;
   patternlist_ = 0;
   logfilename_[0] = 0;
+  binary_error_log_[0] = 0;
+  telemetry_target_[0] = 0;
+  telemetry_interval_ = 10;
+  checkpoint_file_[0] = 0;
+  checkpoint_interval_ = 60;
+  ResetCheckpoint(&resumed_);
+  report_file_[0] = 0;
+  report_interval_ = 60;
+  report_start_us_ = 0;
+  telemetry_start_us_ = 0;
+  telemetry_last_us_ = 0;
 
   read_block_size_ = 512;
   write_block_size_ = -1;
@@ -750,12 +1148,25 @@ Sat::Sat() {
   read_threshold_ = -1;
   write_threshold_ = -1;
   non_destructive_ = 1;
+  disk_io_engine_ = DiskThread::kIoEngineAio;
+  disk_queue_depth_ = 32;
+  disk_pipeline_ = false;
+  disk_discover_ = false;
+  disk_balance_seconds_ = 0;
+  file_uring_ = false;
+  file_queue_depth_ = 32;
+  files_per_thread_ = 1;
   monitor_mode_ = 0;
   tag_mode_ = 0;
+  crc32c_checksum_ = false;
   random_threads_ = 0;
 
   pause_delay_ = 600;
   pause_duration_ = 15;
+  pause_groups_ = (1 << kPauseGroupCount) - 1;
+  power_wave_threads_ = 0;
+
+  prefetch_distance_ = 512;
 }
 
 // Destructor.
@@ -799,6 +1210,12 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Switch to fall back to corase-grain-lock queue. (for benchmarking)
     ARG_KVALUE("--coarse_grain_lock", pe_q_implementation_, SAT_ONELOCK);
 
+    // Switch to the lock-free sharded queue.
+    ARG_KVALUE("--sharded_queue", pe_q_implementation_, SAT_SHARDED);
+
+    // Switch to separate empty and valid page lists.
+    ARG_KVALUE("--split_queue", pe_q_implementation_, SAT_SPLIT);
+
     // Set number of megabyte to use.
     ARG_IVALUE("-M", size_mb_);
 
@@ -808,15 +1225,115 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Set minimum megabytes of hugepages to require.
     ARG_IVALUE("-H", min_hugepages_mbytes_);
 
+    // How to back test memory with hugepages.
+    if (!strcmp(argv[i], "--hugepage_mode")) {
+      i++;
+      if (i < argc) {
+        if (!strcmp(argv[i], "shm")) {
+          hugepage_mode_ = OsLayer::kHugepageShm;
+        } else if (!strcmp(argv[i], "mmap")) {
+          hugepage_mode_ = OsLayer::kHugepageMmap;
+        } else if (!strcmp(argv[i], "memfd")) {
+          hugepage_mode_ = OsLayer::kHugepageMemfd;
+        } else if (!strcmp(argv[i], "thp")) {
+          hugepage_mode_ = OsLayer::kHugepageThp;
+        } else {
+          logprintf(6, "Process Error: Unknown hugepage mode %s\n", argv[i]);
+          bad_status();
+          return false;
+        }
+      }
+      continue;
+    }
+
+    // Set hugetlb page size in megabytes, such as 2 or 1024.
+    ARG_IVALUE("--hugepage_size", hugepage_size_mb_);
+
     // Set number of seconds to run.
     ARG_IVALUE("-s", runtime_seconds_);
 
     // Set number of memory copy threads.
     ARG_IVALUE("-m", memory_threads_);
 
+    // Warmup seconds spent tuning the number of memory copy threads.
+    ARG_IVALUE("--autotune", autotune_seconds_);
+
+    // Temperature the autotune warmup must stay below.
+    ARG_IVALUE("--autotune_max_temp", autotune_max_temp_);
+
     // Set number of memory invert threads.
     ARG_IVALUE("-i", invert_threads_);
 
+    // Set number of memory latency threads.
+    ARG_IVALUE("--latency_threads", latency_threads_);
+
+    // Set number of TLB threads, and the memory each one walks.
+    ARG_IVALUE("--tlb_threads", tlb_threads_);
+    ARG_IVALUE("--tlb_mb", tlb_mb_);
+
+    // Set number of rowhammer threads, and how hard they hammer.
+    ARG_IVALUE("--rowhammer_threads", rowhammer_threads_);
+    ARG_IVALUE("--rowhammer_count", rowhammer_count_);
+
+    // Physical address to DRAM bank and row mapping.
+    if (!strcmp(argv[i], "--rowhammer_map")) {
+      i++;
+      if (i >= argc || !dram_map_.Parse(argv[i])) {
+        logprintf(6, "Process Error: --rowhammer_map needs "
+                  "row_shift:mask,mask,...\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+
+    // Physical address to DRAM channel and rank mapping.
+    if (!strcmp(argv[i], "--channel_map")) {
+      i++;
+      if (i >= argc || !channel_map_.Parse(argv[i])) {
+        logprintf(6, "Process Error: --channel_map needs "
+                  "channel=mask,...[;rank=mask,...]\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+
+    // Which channels pages are taken from.
+    if (!strcmp(argv[i], "--channel_schedule")) {
+      i++;
+      const char *schedule = i < argc ? argv[i] : "";
+      if (!strcmp(schedule, "random")) {
+        channel_schedule_ = FineLockPEQueue::kChannelRandom;
+      } else if (!strcmp(schedule, "even")) {
+        channel_schedule_ = FineLockPEQueue::kChannelEven;
+      } else if (!strncmp(schedule, "sweep", 5) &&
+                 (!schedule[5] || schedule[5] == ':')) {
+        channel_schedule_ = FineLockPEQueue::kChannelSweep;
+        if (schedule[5])
+          channel_sweep_seconds_ = strtol(schedule + 6, NULL, 0);
+      } else {
+        logprintf(6, "Process Error: --channel_schedule needs random, "
+                  "even or sweep[:seconds]\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+
+    // Set number of March test threads, and their algorithm.
+    ARG_IVALUE("--march_threads", march_threads_);
+    if (!strcmp(argv[i], "--march_algorithm")) {
+      i++;
+      if (i >= argc || !march_test_.Parse(argv[i])) {
+        logprintf(6, "Process Error: --march_algorithm needs mats+, "
+                  "march_c-, march_b or a March description\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+
     // Set number of check-only threads.
     ARG_IVALUE("-c", check_threads_);
 
@@ -829,9 +1346,29 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Override the detected or assumed cache line size.
     ARG_IVALUE("--cc_line_size", cc_cacheline_size_);
 
+    // Layout and placement of the cache line structures.
+    if (!strcmp(argv[i], "--cc_layout")) {
+      i++;
+      if (i < argc && !strcmp(argv[i], "line")) {
+        cc_line_pairs_ = false;
+      } else if (i < argc && !strcmp(argv[i], "pair")) {
+        cc_line_pairs_ = true;
+      } else {
+        logprintf(6, "Process Error: --cc_layout needs line or pair\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+    ARG_IVALUE("--cc_threads_per_line", cc_threads_per_line_);
+    ARG_IVALUE("--cc_node", cc_node_);
+
     // Flag set when cache coherency tests need to be run
     ARG_KVALUE("--cc_test", cc_test_, true);
 
+    // Time cacheline transfers between each pair of cores.
+    ARG_KVALUE("--cc_pairs", cc_pairs_, true);
+
     // Set when the cpu_frequency test needs to be run
     ARG_KVALUE("--cpu_freq_test", cpu_freq_test_, true);
 
@@ -844,16 +1381,55 @@ bool Sat::ParseArgs(int argc, char **argv) {
 
     // Set number of CPU stress threads.
     ARG_IVALUE("-C", cpu_stress_threads_);
+    if (!strcmp(argv[i], "--cpu_stress_kernel")) {
+      i++;
+      if (i >= argc || !CpuKernel::Known(argv[i])) {
+        logprintf(6, "Process Error: --cpu_stress_kernel needs one of %s\n",
+                  CpuKernel::Names().c_str());
+        bad_status();
+        return false;
+      }
+      cpu_stress_kernel_ = argv[i];
+      vector<CpuKernel*> kernels;
+      CpuKernel::Create(cpu_stress_kernel_, &kernels);
+      if (kernels.empty() && cpu_stress_kernel_ != "float") {
+        logprintf(6, "Process Error: This cpu can't run the %s "
+                  "cpu stress kernel\n", cpu_stress_kernel_.c_str());
+        bad_status();
+        return false;
+      }
+      for (size_t k = 0; k < kernels.size(); k++)
+        delete kernels[k];
+      continue;
+    }
 
     // Set logfile name.
     ARG_SVALUE("-l", logfilename_);
 
+    // Set binary error log name.
+    ARG_SVALUE("--binary_error_log", binary_error_log_);
+
+    // Set telemetry file or unix socket, and how often to report.
+    ARG_SVALUE("--telemetry", telemetry_target_);
+    ARG_IVALUE("--telemetry_interval", telemetry_interval_);
+
+    // Periodically save the run totals, and resume from them.
+    ARG_SVALUE("--checkpoint", checkpoint_file_);
+    ARG_IVALUE("--checkpoint_interval", checkpoint_interval_);
+
+    // Write a JSON report at intervals and at the end of the run.
+    ARG_SVALUE("--report", report_file_);
+    ARG_IVALUE("--report_interval", report_interval_);
+
     // Verbosity level.
     ARG_IVALUE("-v", verbosity_);
 
     // Chatty printout level.
     ARG_IVALUE("--printsec", print_delay_);
 
+    // Seed of every thread's random numbers.
+    ARG_IVALUE("--seed", seed_);
+
     // Turn off timestamps logging.
     ARG_KVALUE("--no_timestamps", log_timestamps_, false);
 
@@ -863,6 +1439,9 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Set pattern block size.
     ARG_IVALUE("-p", page_length_);
 
+    // Set the size of the contiguous runs memory copy threads work on.
+    ARG_IVALUE("--copy_page_size", copy_page_size_);
+
     // Set pattern block size.
     ARG_IVALUE("--filesize", filesize);
 
@@ -870,6 +1449,41 @@ bool Sat::ParseArgs(int argc, char **argv) {
     ARG_KVALUE("--local_numa", region_mode_, kLocalNuma);
     ARG_KVALUE("--remote_numa", region_mode_, kRemoteNuma);
 
+    // Add a device or memory range for memory region threads.
+    if (!strcmp(argv[i], "--region")) {
+      i++;
+      RegionSource *region = new RegionSource();
+      if (i >= argc || !region->Parse(argv[i])) {
+        delete region;
+        logprintf(6, "Process Error: --region needs dax:<device>, "
+                  "pmem:<file>, resource:<file> or node:<node>, then "
+                  "optionally ,size=<mbytes>, ,width=<bytes> and "
+                  ",threads=<count>\n");
+        bad_status();
+        return false;
+      }
+      regions_.push_back(region);
+      continue;
+    }
+    ARG_KVALUE("--numa_alloc", numa_alloc_, true);
+    ARG_KVALUE("--numa_shards", numa_shards_, true);
+
+    // Low impact scrubber: window size, time per window and between
+    // windows, and the cgroup to run in.
+    ARG_IVALUE("--scrub", scrub_mb_);
+    ARG_IVALUE("--scrub_slice", scrub_slice_seconds_);
+    ARG_IVALUE("--scrub_pause", scrub_pause_seconds_);
+    ARG_SVALUE("--scrub_cgroup", scrub_cgroup_);
+
+    // Thread placement by core and cache sharing.
+    ARG_KVALUE("--topology_placement", topology_placement_, true);
+
+    // Thread placement by cpu cluster.
+    ARG_SVALUE("--cluster_placement", cluster_placement_);
+
+    // Set number of threads filling memory at startup, 0 for one per cpu.
+    ARG_IVALUE("--fill_threads", fill_threads_);
+
     // Autodetect tempfile locations.
     ARG_KVALUE("--findfiles", findfiles_, 1);
 
@@ -891,6 +1505,57 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Warm the cpu as you go.
     ARG_KVALUE("-W", warm_, 1);
 
+    // Copy engines for memory copy threads, assigned round robin.
+    if (!strcmp(argv[i], "--copy_engine")) {
+      i++;
+      if (i < argc) {
+        char *name = argv[i];
+        while (true) {
+          char *next = strchr(name, ',');
+          string engine = next ? string(name, next - name) : string(name);
+          int value = CopyEngineFromName(engine.c_str());
+          if (value < 0) {
+            logprintf(6, "Process Error: Unknown copy engine %s\n",
+                      engine.c_str());
+            bad_status();
+            return false;
+          }
+          copy_engines_.push_back(value);
+          if (!next)
+            break;
+          name = next + 1;
+        }
+      }
+      continue;
+    }
+
+    // Bytes ahead of the copy for the prefetch copy engine.
+    ARG_IVALUE("--prefetch_distance", prefetch_distance_);
+
+    // Flush policies for invert threads, assigned round robin.
+    if (!strcmp(argv[i], "--invert_flush")) {
+      i++;
+      if (i < argc) {
+        char *name = argv[i];
+        while (true) {
+          char *next = strchr(name, ',');
+          string flush = next ? string(name, next - name) : string(name);
+          int value = InvertFlushFromName(flush.c_str());
+          if (value < 0) {
+            logprintf(6, "Process Error: Unknown invert flush policy %s\n",
+                      flush.c_str());
+            bad_status();
+            return false;
+          }
+          invert_flushes_.push_back(value);
+          if (!next)
+            break;
+          name = next + 1;
+        }
+      }
+      continue;
+    }
+
     // Allow runnign on unknown systems with base unimplemented OsLayer
     ARG_KVALUE("-A", run_on_anything_, 1);
 
@@ -918,15 +1583,65 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Do not write anything to disk in the disk test.
     ARG_KVALUE("--destructive", non_destructive_, 0);
 
+    // Asynchronous I/O engine for the disk test.
+    if (!strcmp(argv[i], "--disk_engine")) {
+      i++;
+      if (i < argc) {
+        if (!strcmp(argv[i], "aio")) {
+          disk_io_engine_ = DiskThread::kIoEngineAio;
+        } else if (!strcmp(argv[i], "io_uring")) {
+          disk_io_engine_ = DiskThread::kIoEngineUring;
+        } else {
+          logprintf(6, "Process Error: Unknown disk engine %s\n", argv[i]);
+          bad_status();
+          return false;
+        }
+      }
+      continue;
+    }
+
+    // Number of io_uring requests in flight per disk thread.
+    ARG_IVALUE("--disk_queue_depth", disk_queue_depth_);
+
+    // Keep writes and verification of disk blocks in flight together.
+    ARG_KVALUE("--disk_pipeline", disk_pipeline_, true);
+
+    // Add a disk thread for every disk nothing is using.
+    ARG_KVALUE("--disk_discover", disk_discover_, true);
+
+    // Pin disk threads to their device's node and tune queue depths.
+    ARG_IVALUE("--disk_balance", disk_balance_seconds_);
+
     // Run SAT in monitor mode. No test load at all.
     ARG_KVALUE("--monitor_mode", monitor_mode_, true);
 
     // Run SAT in address mode. Tag all cachelines by virt addr.
     ARG_KVALUE("--tag_mode", tag_mode_, true);
 
+    // Page checksum of the copy threads.
+    if (!strcmp(argv[i], "--checksum")) {
+      i++;
+      if (i < argc) {
+        if (!strcmp(argv[i], "crc32c")) {
+          crc32c_checksum_ = true;
+        } else if (!strcmp(argv[i], "adler")) {
+          crc32c_checksum_ = false;
+        } else {
+          logprintf(6, "Process Error: Unknown checksum %s\n", argv[i]);
+          bad_status();
+          return false;
+        }
+      }
+      continue;
+    }
+
     // Dump range map of tested pages..
     ARG_KVALUE("--do_page_map", do_page_map_, true);
 
+    // Report the pages read in each window, and read the oldest first.
+    ARG_IVALUE("--coverage_window", coverage_window_);
+    ARG_KVALUE("--coverage_targeting", coverage_targeting_, true);
+
     // Specify the physical address base to test.
     ARG_IVALUE("--paddr_base", paddr_base_);
 
@@ -936,6 +1651,75 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Specify the duration of each pause (for power spikes).
     ARG_IVALUE("--pause_duration", pause_duration_);
 
+    // Load waveform for power transients, and its threads.
+    if (!strcmp(argv[i], "--power_wave")) {
+      i++;
+      if (i >= argc || !power_wave_.Parse(argv[i])) {
+        logprintf(6, "Process Error: --power_wave needs "
+                  "square,<hz>[,<duty %%>] or ramp,<hz>, up to 10kHz\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+    ARG_IVALUE("--power_wave_threads", power_wave_threads_);
+
+    // Thread groups paused for power spikes.
+    if (!strcmp(argv[i], "--pause_groups")) {
+      i++;
+      if (i < argc) {
+        pause_groups_ = 0;
+        char *name = argv[i];
+        while (true) {
+          char *next = strchr(name, ',');
+          string group = next ? string(name, next - name) : string(name);
+          int value = 0;
+          while (value < kPauseGroupCount &&
+                 group != kPauseGroupNames[value])
+            value++;
+          if (value == kPauseGroupCount) {
+            logprintf(6, "Process Error: Unknown pause group %s\n",
+                      group.c_str());
+            bad_status();
+            return false;
+          }
+          pause_groups_ |= 1 << value;
+          if (!next)
+            break;
+          name = next + 1;
+        }
+      }
+      continue;
+    }
+
+    // Bandwidth caps per thread type, as type:MB/s pairs.
+    if (!strcmp(argv[i], "--rate_limit")) {
+      i++;
+      if (i < argc) {
+        char *name = argv[i];
+        while (true) {
+          char *next = strchr(name, ',');
+          string limit = next ? string(name, next - name) : string(name);
+          string::size_type colon = limit.find(':');
+          int type = ThreadTypeFromName(limit.substr(0, colon));
+          char *end = NULL;
+          double mbps = colon == string::npos ? 0 :
+              strtod(limit.c_str() + colon + 1, &end);
+          if (type < 0 || !end || *end || mbps < 1) {
+            logprintf(6, "Process Error: Invalid rate limit %s\n",
+                      limit.c_str());
+            bad_status();
+            return false;
+          }
+          rate_limits_[type] = mbps;
+          if (!next)
+            break;
+          name = next + 1;
+        }
+      }
+      continue;
+    }
+
     // Disk device names
     if (!strcmp(argv[i], "-d")) {
       i++;
@@ -960,6 +1744,29 @@ bool Sat::ParseArgs(int argc, char **argv) {
       continue;
     }
 
+    // I/O engine for the file threads.
+    if (!strcmp(argv[i], "--file_engine")) {
+      i++;
+      if (i < argc) {
+        if (!strcmp(argv[i], "sync")) {
+          file_uring_ = false;
+        } else if (!strcmp(argv[i], "io_uring")) {
+          file_uring_ = true;
+        } else {
+          logprintf(6, "Process Error: Unknown file engine %s\n", argv[i]);
+          bad_status();
+          return false;
+        }
+      }
+      continue;
+    }
+
+    // Number of io_uring requests in flight per file thread.
+    ARG_IVALUE("--file_queue_depth", file_queue_depth_);
+
+    // Number of files sharing each io_uring file thread.
+    ARG_IVALUE("--files_per_thread", files_per_thread_);
+
     // Set a hostname to use in a network thread.
     if (!strcmp(argv[i], "-n")) {
       i++;
@@ -973,6 +1780,37 @@ bool Sat::ParseArgs(int argc, char **argv) {
     // Run threads that listen for incoming SAT net connections.
     ARG_KVALUE("--listen", listen_threads_, 1);
 
+    // Send network pages without copying them into the socket buffer.
+    ARG_KVALUE("--net_zerocopy", net_zerocopy_, true);
+
+    // Serve incoming network connections from a pool of epoll threads.
+    ARG_IVALUE("--net_event_threads", net_event_threads_);
+
+    // Move network pages by RDMA rather than through the sockets.
+    ARG_KVALUE("--net_rdma", net_rdma_, true);
+
+    // RDMA device to use, as name[:port[:gid index]].
+    ARG_SVALUE("--net_rdma_device", net_rdma_device_);
+
+    // Coordinate a network test across this many registering hosts.
+    ARG_IVALUE("--net_coordinator", net_coordinator_hosts_);
+
+    // How the coordinator pairs up the hosts.
+    if (!strcmp(argv[i], "--net_topology")) {
+      i++;
+      if (i >= argc ||
+          !NetCoordinator::ParseTopology(argv[i], &net_topology_)) {
+        logprintf(6, "Process Error: --net_topology needs ring, all or "
+                  "bisection\n");
+        bad_status();
+        return false;
+      }
+      continue;
+    }
+
+    // Get network peers from the coordinator at this address.
+    ARG_SVALUE("--net_register", net_register_);
+
     if (CheckGoogleSpecificArgs(argc, argv, &i)) {
       continue;
     }
@@ -995,6 +1833,12 @@ bool Sat::ParseArgs(int argc, char **argv) {
     }
 
     // Default:
+    if (embedded_) {
+      // Don't print help or exit the host process.
+      logprintf(0, "Process Error: Unknown argument %s\n", argv[i]);
+      bad_status();
+      return false;
+    }
     PrintVersion();
     PrintHelp();
     if (strcmp(argv[i], "-h") && strcmp(argv[i], "--help")) {
@@ -1009,6 +1853,11 @@ bool Sat::ParseArgs(int argc, char **argv) {
 
   Logger::GlobalLogger()->SetVerbosity(verbosity_);
 
+  // Threads are seeded as they are set up, after this.
+  if (!seed_)
+    seed_ = Prng::TimeSeed();
+  Prng::SetMasterSeed(seed_);
+
   // Update relevant data members with parsed input.
   // Translate MB into bytes.
   size_ = static_cast<int64>(size_mb_) * kMegabyte;
@@ -1031,7 +1880,20 @@ bool Sat::ParseArgs(int argc, char **argv) {
     return false;
   }
 
-  // Set disk_pages_ if filesize or page size changed.
+  if (copy_page_size_) {
+    if (copy_page_size_ < page_length_ || copy_page_size_ % page_length_) {
+      logprintf(6, "Process Error: Copy page size %lld is not a multiple "
+                "of the page size %d\n", copy_page_size_, page_length_);
+      bad_status();
+      return false;
+    }
+    copy_span_pages_ = copy_page_size_ / page_length_;
+    if (copy_span_pages_ > 1)
+      logprintf(12, "Log: Copy threads work on spans of %d pages\n",
+                copy_span_pages_);
+  }
+
+  // Set disk_pages_ if filesize or page size changed.
   if (filesize != static_cast<uint64>(page_length_) *
                   static_cast<uint64>(disk_pages_)) {
     disk_pages_ = filesize / page_length_;
@@ -1039,6 +1901,302 @@ bool Sat::ParseArgs(int argc, char **argv) {
       disk_pages_ = 1;
   }
 
+  // Address tags are folded into the Adler checksum.
+  if (tag_mode_ && crc32c_checksum_) {
+    logprintf(6, "Process Error: --checksum crc32c can't be used with "
+              "--tag_mode.\n");
+    bad_status();
+    return false;
+  }
+
+  // Copy engines don't preserve address tags.
+  if (tag_mode_) {
+    for (uint i = 0; i < copy_engines_.size(); i++) {
+      if (copy_engines_[i] != kCopyEngineDefault) {
+        logprintf(6, "Process Error: "
+            "Copy engine %s can't be used with --tag_mode.\n",
+            CopyEngineName(copy_engines_[i]));
+        bad_status();
+        return false;
+      }
+    }
+  }
+  if (prefetch_distance_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid prefetch distance %d\n", prefetch_distance_);
+    bad_status();
+    return false;
+  }
+
+  if (file_uring_ && !DiskUring::Available()) {
+    logprintf(6, "Process Error: --file_engine io_uring is not supported "
+        "by this build.\n");
+    bad_status();
+    return false;
+  }
+  if (file_queue_depth_ < 1 ||
+      file_queue_depth_ > DiskThread::kMaxQueueDepth) {
+    logprintf(6, "Process Error: Invalid file queue depth %d\n",
+        file_queue_depth_);
+    bad_status();
+    return false;
+  }
+  if (files_per_thread_ < 1) {
+    logprintf(6, "Process Error: Invalid files per thread %d\n",
+        files_per_thread_);
+    bad_status();
+    return false;
+  }
+  if (files_per_thread_ > 1 && !file_uring_) {
+    logprintf(6, "Process Error: --files_per_thread requires "
+        "--file_engine io_uring.\n");
+    bad_status();
+    return false;
+  }
+
+  if (disk_balance_seconds_ < 0) {
+    logprintf(6, "Process Error: Invalid --disk_balance %d seconds.\n",
+              disk_balance_seconds_);
+    bad_status();
+    return false;
+  }
+
+  if (disk_pipeline_ && disk_io_engine_ != DiskThread::kIoEngineUring) {
+    logprintf(6, "Process Error: --disk_pipeline requires "
+        "--disk_engine io_uring.\n");
+    bad_status();
+    return false;
+  }
+
+  // Slices are separate runs, they can't share checkpoints or binary logs.
+  if (scrub_mb_ < 0 || scrub_slice_seconds_ <= 0 ||
+      scrub_pause_seconds_ < 0) {
+    logprintf(6, "Process Error: Invalid scrub window %dMB, slice %ds, "
+              "pause %ds\n", scrub_mb_, scrub_slice_seconds_,
+              scrub_pause_seconds_);
+    bad_status();
+    return false;
+  }
+  if (scrub_mb_ && (numa_shards_ || monitor_mode_ || checkpoint_file_[0] ||
+                    binary_error_log_[0])) {
+    logprintf(6, "Process Error: --scrub can't be combined with "
+              "--numa_shards, --monitor_mode, --checkpoint or "
+              "--binary_error_log.\n");
+    bad_status();
+    return false;
+  }
+
+  // Each shard only has the memory of its own node.
+  if (numa_shards_ && numa_alloc_) {
+    logprintf(6, "Process Error: --numa_shards and --numa_alloc can't be "
+                 "used together\n");
+    bad_status();
+    return false;
+  }
+
+  // Per node memory is only useful if threads stay near it.
+  if (numa_alloc_ && !region_mode_)
+    region_mode_ = kLocalNuma;
+
+  if (hugepage_size_mb_ < 0 ||
+      (hugepage_size_mb_ & (hugepage_size_mb_ - 1))) {
+    logprintf(6, "Process Error: "
+        "Hugepage size %lldMB is not a power of two\n", hugepage_size_mb_);
+    bad_status();
+    return false;
+  }
+
+  if (march_threads_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid number of March threads %d\n", march_threads_);
+    bad_status();
+    return false;
+  }
+
+  if (power_wave_threads_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid number of power wave threads %d\n", power_wave_threads_);
+    bad_status();
+    return false;
+  }
+
+  if (rowhammer_count_ <= 0) {
+    logprintf(6, "Process Error: "
+        "Invalid rowhammer count %d\n", rowhammer_count_);
+    bad_status();
+    return false;
+  }
+  if (tlb_threads_ > 0 && tlb_mb_ <= 0) {
+    logprintf(6, "Process Error: "
+        "Invalid tlb memory %dMB\n", tlb_mb_);
+    bad_status();
+    return false;
+  }
+
+  if (fill_threads_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid number of fill threads %d\n", fill_threads_);
+    bad_status();
+    return false;
+  }
+
+  if (autotune_seconds_ < 0 || autotune_max_temp_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid autotune setting %d seconds, %d degrees\n",
+        autotune_seconds_, autotune_max_temp_);
+    bad_status();
+    return false;
+  }
+
+  if (coverage_window_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid coverage window %d\n", coverage_window_);
+    bad_status();
+    return false;
+  }
+  if (coverage_targeting_ && pe_q_implementation_ != SAT_FINELOCK) {
+    logprintf(6, "Process Error: --coverage_targeting requires the default "
+        "page queue.\n");
+    bad_status();
+    return false;
+  }
+  if (channel_schedule_ != FineLockPEQueue::kChannelRandom) {
+    if (!channel_map_.enabled() || pe_q_implementation_ != SAT_FINELOCK) {
+      logprintf(6, "Process Error: --channel_schedule requires "
+          "--channel_map and the default page queue.\n");
+      bad_status();
+      return false;
+    }
+    // Pages are scheduled whole, so each 4k frame must sit in one channel.
+    if (channel_map_.channel_bits() & 4095) {
+      logprintf(6, "Process Error: --channel_schedule needs channels "
+          "interleaved at 4k or coarser, not by mask 0x%llx.\n",
+          channel_map_.channel_bits());
+      bad_status();
+      return false;
+    }
+    if (channel_schedule_ == FineLockPEQueue::kChannelSweep &&
+        channel_sweep_seconds_ <= 0) {
+      logprintf(6, "Process Error: "
+          "Invalid channel sweep time %d\n", channel_sweep_seconds_);
+      bad_status();
+      return false;
+    }
+  }
+
+  if (checkpoint_interval_ <= 0) {
+    logprintf(6, "Process Error: "
+        "Invalid checkpoint interval %d\n", checkpoint_interval_);
+    bad_status();
+    return false;
+  }
+
+  // Heterogeneous cpus are reported by cluster, and placed by cluster on
+  // request.
+  cpu_set_t cluster_cpus;
+  CPU_ZERO(&cluster_cpus);
+#ifdef HAVE_SCHED_GETAFFINITY
+  sched_getaffinity(0, sizeof(cluster_cpus), &cluster_cpus);
+#endif
+  LoadCpuClusters(&cluster_cpus, &clusters_);
+  if (cluster_placement_[0]) {
+    bool known = !strcmp(cluster_placement_, "spread") ||
+                 !strcmp(cluster_placement_, "fill");
+    string names;
+    for (size_t c = 0; c < clusters_.size(); c++) {
+      known |= clusters_[c].name == cluster_placement_;
+      names += " " + clusters_[c].name;
+    }
+    if (!known) {
+      logprintf(6, "Process Error: --cluster_placement needs spread, fill "
+                "or a cluster:%s\n", names.c_str());
+      bad_status();
+      return false;
+    }
+    if (topology_placement_) {
+      logprintf(6, "Process Error: --cluster_placement and "
+                "--topology_placement are exclusive.\n");
+      bad_status();
+      return false;
+    }
+  } else if (clusters_.size() < 2) {
+    clusters_.clear();
+  }
+  for (size_t c = 0; c < clusters_.size(); c++) {
+    logprintf(5, "Log: Cpu cluster %s: cpus %s, capacity %d, max %lldMHz\n",
+              clusters_[c].name.c_str(),
+              FormatSysfsList(clusters_[c].cpus).c_str(),
+              clusters_[c].capacity, clusters_[c].max_khz / 1000);
+  }
+  cluster_khz_total_.assign(clusters_.size(), 0);
+  cluster_khz_min_.assign(clusters_.size(), 0);
+  cluster_khz_max_.assign(clusters_.size(), 0);
+
+  if (report_interval_ <= 0) {
+    logprintf(6, "Process Error: "
+        "Invalid report interval %d\n", report_interval_);
+    bad_status();
+    return false;
+  }
+
+  if (telemetry_interval_ <= 0) {
+    logprintf(6, "Process Error: "
+        "Invalid telemetry interval %d\n", telemetry_interval_);
+    bad_status();
+    return false;
+  }
+
+  if (net_event_threads_ < 0) {
+    logprintf(6, "Process Error: "
+        "Invalid number of network event threads %d\n", net_event_threads_);
+    bad_status();
+    return false;
+  }
+  if (net_event_threads_ && !listen_threads_ && !net_register_[0]) {
+    logprintf(6, "Process Error: --net_event_threads requires --listen.\n");
+    bad_status();
+    return false;
+  }
+  if (net_rdma_device_[0]) {
+    net_rdma_ = true;
+    if (!rdma_.Parse(net_rdma_device_)) {
+      logprintf(6, "Process Error: --net_rdma_device %s should be "
+                "name[:port[:gid index]].\n", net_rdma_device_);
+      bad_status();
+      return false;
+    }
+  }
+  if (net_rdma_) {
+    if (!RdmaDevice::Available()) {
+      logprintf(6, "Process Error: --net_rdma needs libibverbs, which this "
+                "build doesn't have.\n");
+      bad_status();
+      return false;
+    }
+    if (net_event_threads_ || net_zerocopy_) {
+      logprintf(6, "Process Error: --net_rdma can't be used with "
+                "--net_event_threads or --net_zerocopy.\n");
+      bad_status();
+      return false;
+    }
+  }
+  if (net_coordinator_hosts_) {
+    string reason;
+    if (!NetCoordinator::CheckHosts(net_topology_, net_coordinator_hosts_,
+                                    &reason)) {
+      logprintf(6, "Process Error: --net_coordinator %d: %s.\n",
+                net_coordinator_hosts_, reason.c_str());
+      bad_status();
+      return false;
+    }
+    if (net_register_[0]) {
+      logprintf(6, "Process Error: --net_coordinator and --net_register "
+                "need separate runs.\n");
+      bad_status();
+      return false;
+    }
+  }
+
   // Validate memory channel parameters if supplied
   if (channels_.size()) {
     if (channels_.size() == 1) {
@@ -1098,26 +2256,103 @@ void Sat::PrintHelp() {
          " -H mbytes        minimum megabytes of hugepages to require\n"
          " -s seconds       number of seconds to run\n"
          " -m threads       number of memory copy threads to run\n"
+         " --autotune secs  spend the first 'secs' seconds finding the "
+         "number of memory copy threads, up to -m, with the most bandwidth\n"
+         " --autotune_max_temp degrees  stop adding threads once a thermal "
+         "zone reaches 'degrees' Celsius\n"
          " -i threads       number of memory invert threads to run\n"
+         " --latency_threads threads  number of pointer chasing memory "
+         "latency threads to run\n"
+         " --tlb_threads threads  number of threads touching a cacheline of "
+         "each small page of their own memory, to load the page walkers\n"
+         " --tlb_mb mb  memory mapped by each tlb thread, on top of -M "
+         "(default 256)\n"
+         " --rowhammer_threads threads  number of threads hammering "
+         "physically adjacent DRAM rows\n"
+         " --rowhammer_count n  reads of each aggressor row per victim row, "
+         "default 200000\n"
+         " --rowhammer_map shift:mask,...  physical address bit where rows "
+         "start, and one mask of XORed address bits per bank bit\n"
+         " --channel_map channel=mask,...[;rank=mask,...]  one mask of "
+         "XORed physical address bits per channel and rank bit\n"
+         " --channel_schedule s  take pages from any channel (random), each "
+         "in turn (even), or one at a time (sweep[:seconds], default 30)\n"
+         " --march_threads threads  number of March test threads to run\n"
+         " --march_algorithm a  March algorithm of those threads: mats+, "
+         "march_c- (default), march_b, or a description such as "
+         "'u(w0);u(r0,w1);d(r1,w0)'\n"
          " -C threads       number of memory CPU stress threads to run\n"
+         " --cpu_stress_kernel k  workload of the CPU stress threads: float "
+         "(default), self-checking fma512, fma256, neon, intmul or aes, "
+         "fma for the widest fma, or all of them in turn\n"
          " --findfiles      find locations to do disk IO automatically\n"
          " -d device        add a direct write disk thread with block "
          "device (or file) 'device'\n"
          " -f filename      add a disk thread with "
          "tempfile 'filename'\n"
+         " --file_engine e  file I/O engine, sync or io_uring (-f)\n"
+         " --file_queue_depth n  io_uring requests in flight per file "
+         "thread, default 32 (-f)\n"
+         " --files_per_thread n  files sharing each io_uring file "
+         "thread, default 1 (-f)\n"
          " -l logfile       log output to file 'logfile'\n"
+         " --binary_error_log file  write miscompares as binary records "
+         "to 'file', see errlog_decode\n"
+         " --telemetry target  write interval throughput as JSON lines to "
+         "file 'target', or to unix socket 'path' if 'target' is "
+         "unix:path\n"
+         " --telemetry_interval secs  seconds between telemetry lines, "
+         "default 10\n"
+         " --checkpoint file  save the run totals to 'file' periodically "
+         "and resume from it when restarted with the same arguments\n"
+         " --checkpoint_interval secs  seconds between checkpoints, "
+         "default 60\n"
+         " --report file  write a JSON report of the configuration and "
+         "results to 'file' periodically and at the end of the run\n"
+         " --report_interval secs  seconds between reports, default 60\n"
+         " --coverage_window secs  log the share of memory read back in "
+         "every 'secs' seconds\n"
+         " --coverage_targeting  read the least recently read memory first\n"
          " --no_timestamps  do not prefix timestamps to log messages\n"
          " --max_errors n   exit early after finding 'n' errors\n"
          " -v level         verbosity (0-20), default is 8\n"
          " --printsec secs  How often to print 'seconds remaining'\n"
+         " --seed n         seed each thread's random choices from n, "
+         "default is logged at start\n"
          " -W               Use more CPU-stressful memory copy\n"
+         " --checksum adler|crc32c  page checksum of the checksumming "
+         "copies, crc32c uses the cpu's crc instructions\n"
+         " --copy_engine e1,e2  memory copy engines (default, nt, prefetch, "
+         "erms), assigned round robin to the memory copy threads\n"
+         " --prefetch_distance bytes  how far ahead the prefetch copy "
+         "engine prefetches, default 512\n"
+         " --invert_flush p1,p2  invert thread flush policies (line, batch, "
+         "clwb, nt), assigned round robin to the invert threads\n"
          " -A               run in degraded mode on incompatible systems\n"
          " -p pagesize      size in bytes of memory chunks\n"
+         " --copy_page_size bytes  size of the contiguous runs of memory "
+         "chunks each copy thread works on, a multiple of -p\n"
+         " --sharded_queue  use the lock-free per-cpu sharded page queue\n"
+         " --split_queue    keep empty and valid pages in separate lists\n"
          " --filesize size  size of disk IO tempfiles\n"
          " -n ipaddr        add a network thread connecting to "
          "system at 'ipaddr'\n"
          " --listen         run a thread to listen for and respond "
          "to network threads.\n"
+         " --net_event_threads n  serve --listen connections from n epoll "
+         "threads instead of one thread per connection\n"
+         " --net_zerocopy   send network pages with MSG_ZEROCOPY and "
+         "receive whole pages per call\n"
+         " --net_rdma       move network pages by RDMA write and read, "
+         "peers must run with the same pattern options\n"
+         " --net_rdma_device name[:port[:gid]]  RDMA device to use, implies "
+         "--net_rdma, default the first one\n"
+         " --net_coordinator n  wait for n hosts to register, assign their "
+         "network peers and report every link\n"
+         " --net_topology ring|all|bisection  how the coordinator pairs "
+         "hosts, default ring\n"
+         " --net_register ipaddr  get network peers from the coordinator "
+         "at 'ipaddr' and report back to it\n"
          " --no_errors      run without checking for ECC or other errors\n"
          " --force_errors   inject false errors to test error handling\n"
          " --force_errors_like_crazy   inject a lot of false errors "
@@ -1139,6 +2374,15 @@ void Sat::PrintHelp() {
          " --random-threads      number of random threads for each disk "
          "write thread (-d)\n"
          " --destructive    write/wipe disk partition (-d)\n"
+         " --disk_engine e  disk I/O engine, aio or io_uring (-d)\n"
+         " --disk_queue_depth n  io_uring requests in flight per disk "
+         "thread, default 32 (-d)\n"
+         " --disk_pipeline  overlap writing new blocks with verifying "
+         "older ones, needs io_uring (-d)\n"
+         " --disk_discover  add a disk thread for every disk with no "
+         "mounted, swap or stacked partitions\n"
+         " --disk_balance n  pin disk threads to their disk's NUMA node and "
+         "tune each disk's io_uring depth every n seconds (-d)\n"
          " --monitor_mode   only do ECC error polling, no stress load.\n"
          " --cc_test        do the cache coherency testing\n"
          " --cc_inc_count   number of times to increment the "
@@ -1146,19 +2390,60 @@ void Sat::PrintHelp() {
          " --cc_line_count  number of cache line sized datastructures "
          "to allocate for the cache coherency threads to operate\n"
          " --cc_line_size   override the auto-detected cache line size\n"
+         " --cc_layout line|pair  pad each line's counters to a cache line, "
+         "or to a 128 byte adjacent line pair\n"
+         " --cc_threads_per_line n  threads whose counters share each line, "
+         "default as many as fit\n"
+         " --cc_node n      NUMA node of the cache lines, -1 for first touch "
+         "(default 0)\n"
+         " --cc_pairs       bounce a cacheline between each pair of cores "
+         "in turn and report the transfer latency matrix (with --cc_test)\n"
          " --cpu_freq_test  enable the cpu frequency test (requires the "
          "--cpu_freq_threshold argument to be set)\n"
          " --cpu_freq_threshold  fail the cpu frequency test if the frequency "
          "goes below this value (specified in MHz)\n"
          " --cpu_freq_round round the computed frequency to this value, if set"
          " to zero, only round to the nearest MHz\n"
+         " --hugepage_mode m back memory with shm (default), mmap or memfd "
+         "hugetlb, or thp transparent hugepages\n"
+         " --hugepage_size mb  hugetlb page size for --hugepage_mode mmap or "
+         "memfd, such as 2 or 1024\n"
          " --paddr_base     allocate memory starting from this address\n"
          " --pause_delay    delay (in seconds) between power spikes\n"
          " --pause_duration duration (in seconds) of each pause\n"
+         " --pause_groups g1,g2  thread groups paused for power spikes "
+         "(memory, file, disk, cpu_freq), default all\n"
+         " --power_wave square,hz[,duty] or ramp,hz  run threads that load "
+         "and idle their cpus together on this waveform, up to 10kHz\n"
+         " --power_wave_threads n  number of those threads, 0 for one per "
+         "cpu (the default)\n"
+         " --rate_limit t:mbps,...  cap the combined bandwidth of all "
+         "threads of type t (memory, file, disk, check, ...) to mbps MB/s\n"
          " --local_numa     choose memory regions associated with "
          "each CPU to be tested by that CPU\n"
          " --remote_numa    choose memory regions not associated with "
          "each CPU to be tested by that CPU\n"
+         " --region kind:where[,size=mb][,width=bytes][,threads=n]  copy "
+         "test pages through a dax:<device>, pmem:<file>, PCI "
+         "resource:<file> or node:<node> region, repeatable\n"
+         " --fill_threads n number of threads filling memory at startup, "
+         "0 for one per cpu (the default)\n"
+         " --numa_alloc     allocate memory per NUMA node, bound to and "
+         "first touched from that node, implies --local_numa\n"
+         " --numa_shards    run one process per NUMA node on that node's "
+         "cpus and memory, splitting -M between them\n"
+         " --scrub mbytes   low impact scrubber, test memory in windows "
+         "of this size at SCHED_IDLE, a fresh process per window\n"
+         " --scrub_slice secs  how long each scrub window is tested, "
+         "default 300\n"
+         " --scrub_pause secs  idle time between scrub windows, default 60\n"
+         " --scrub_cgroup dir  run the scrubber in this cgroup, to bound "
+         "its cpu and memory use\n"
+         " --topology_placement  place copy threads one per last level "
+         "cache, then per core, and check threads on their SMT siblings\n"
+         " --cluster_placement p  pin copy and cpu stress threads by cpu "
+         "cluster: spread round robin over the clusters, fill the fastest "
+         "first, or only use the named cluster (prime, big, little, ...)\n"
          " --channel_hash   mask of address bits XORed to determine channel. "
          "Mask 0x40 interleaves cachelines between channels\n"
          " --channel_width bits     width in bits of each memory channel\n"
@@ -1206,10 +2491,34 @@ void Sat::InitializeThreads() {
     return;
   }
 
+  // With --topology_placement the copy threads go one per last level cache
+  // first, then one per core, and the check threads onto their cores' SMT
+  // siblings.
+  CpuTopology topology;
+  vector<int> copy_cpus;
+  if (topology_placement_ && !((region_count_ > 1) && (region_mode_))) {
+    cpu_set_t available_cpus;
+    CPU_ZERO(&available_cpus);
+#ifdef HAVE_SCHED_GETAFFINITY
+    sched_getaffinity(0, sizeof(available_cpus), &available_cpus);
+#endif
+    if (!topology.Load(&available_cpus))
+      logprintf(5, "Log: Using the default thread placement.\n");
+  }
+  const vector<int> &spread = topology.spread_order();
+  bool by_cluster = cluster_placement_[0] &&
+                    !((region_count_ > 1) && (region_mode_));
+  copy_clusters_.clear();
+  cpu_clusters_.clear();
+
   for (int i = 0; i < memory_threads_; i++) {
     CopyThread *thread = new CopyThread();
     thread->InitThread(total_threads_++, this, os_, patternlist_,
-                       &power_spike_status_);
+                       &power_spike_status_[kPauseMemory]);
+    if (copy_engines_.size()) {
+      thread->set_copy_engine(copy_engines_[i % copy_engines_.size()],
+                              prefetch_distance_);
+    }
 
     if ((region_count_ > 1) && (region_mode_)) {
       int32 region = region_find(i % region_count_);
@@ -1224,6 +2533,18 @@ void Sat::InitializeThreads() {
         thread->set_cpu_mask(cpuset);
         thread->set_tag(region_mask_ & ~(1 << region));
       }
+    } else if (!spread.empty()) {
+      int cpu = spread[i % spread.size()];
+      logprintf(9, "Log: Placing memory copy thread %d on cpu %d\n", i, cpu);
+      thread->set_cpu_mask_to_cpu(cpu);
+      copy_cpus.push_back(cpu);
+    } else if (by_cluster) {
+      int cluster;
+      int cpu = ClusterCpu(i, &cluster);
+      logprintf(9, "Log: Placing memory copy thread %d on cpu %d (%s)\n", i,
+                cpu, clusters_[cluster].name.c_str());
+      thread->set_cpu_mask_to_cpu(cpu);
+      copy_clusters_.push_back(cluster);
     } else {
       cpu_set_t available_cpus;
       thread->AvailableCpus(&available_cpus);
@@ -1256,11 +2577,23 @@ void Sat::InitializeThreads() {
 
   // File IO threads.
   WorkerVector *fileio_vector = new WorkerVector();
-  for (int i = 0; i < file_threads_; i++) {
-    FileThread *thread = new FileThread();
-    thread->InitThread(total_threads_++, this, os_, patternlist_,
-                       &power_spike_status_);
-    thread->SetFile(filename_[i].c_str());
+  // Without io_uring there is one file per thread.
+  for (int i = 0; i < file_threads_; i += files_per_thread_) {
+    FileThread *thread;
+    if (file_uring_) {
+      AsyncFileThread *async = new AsyncFileThread();
+      async->InitThread(total_threads_++, this, os_, patternlist_,
+                        &power_spike_status_[kPauseFile]);
+      async->SetQueueDepth(file_queue_depth_);
+      for (int j = i; j < i + files_per_thread_ && j < file_threads_; j++)
+        async->AddFile(filename_[j].c_str());
+      thread = async;
+    } else {
+      thread = new FileThread();
+      thread->InitThread(total_threads_++, this, os_, patternlist_,
+                         &power_spike_status_[kPauseFile]);
+      thread->SetFile(filename_[i].c_str());
+    }
     // Set disk threads high priority. They don't take much processor time,
     // but blocking them will delay disk IO.
     thread->SetPriority(WorkerThread::High);
@@ -1291,12 +2624,32 @@ void Sat::InitializeThreads() {
   workers_map_.insert(make_pair(kNetIOType, netio_vector));
   workers_map_.insert(make_pair(kNetSlaveType, netslave_vector));
 
+  // Network test coordinator.
+  WorkerVector *coordinator_vector = new WorkerVector();
+  if (net_coordinator_hosts_) {
+    NetCoordinatorThread *thread = new NetCoordinatorThread(
+        &net_coordinator_, net_topology_, net_coordinator_hosts_);
+    thread->InitThread(total_threads_++, this, os_, patternlist_,
+                       &continuous_status_);
+    coordinator_vector->insert(coordinator_vector->end(), thread);
+  }
+  workers_map_.insert(make_pair(kNetCoordinatorType, coordinator_vector));
+
   // Result check threads.
   WorkerVector *check_vector = new WorkerVector();
   for (int i = 0; i < check_threads_; i++) {
     CheckThread *thread = new CheckThread();
     thread->InitThread(total_threads_++, this, os_, patternlist_,
                        &continuous_status_);
+    if (!copy_cpus.empty()) {
+      // Share a core with a copy thread, or take the next free cpu if
+      // there's no SMT.
+      int cpu = topology.Sibling(copy_cpus[i % copy_cpus.size()]);
+      if (cpu < 0)
+        cpu = spread[(copy_cpus.size() + i) % spread.size()];
+      logprintf(9, "Log: Placing check thread %d on cpu %d\n", i, cpu);
+      thread->set_cpu_mask_to_cpu(cpu);
+    }
 
     check_vector->insert(check_vector->end(), thread);
   }
@@ -1309,11 +2662,118 @@ void Sat::InitializeThreads() {
     InvertThread *thread = new InvertThread();
     thread->InitThread(total_threads_++, this, os_, patternlist_,
                        &continuous_status_);
+    if (invert_flushes_.size())
+      thread->set_invert_flush(invert_flushes_[i % invert_flushes_.size()]);
 
     invert_vector->insert(invert_vector->end(), thread);
   }
   workers_map_.insert(make_pair(kInvertType, invert_vector));
 
+  // Memory latency threads.
+  logprintf(12, "Log: Starting latency threads\n");
+  WorkerVector *latency_vector = new WorkerVector();
+  for (int i = 0; i < latency_threads_; i++) {
+    LatencyThread *thread = new LatencyThread();
+    thread->InitThread(total_threads_++, this, os_, patternlist_,
+                       &power_spike_status_[kPauseMemory]);
+    // Walk each region from its own cores, like the copy threads.
+    if ((region_count_ > 1) && (region_mode_)) {
+      int32 region = region_find(i % region_count_);
+      cpu_set_t *cpuset = os_->FindCoreMask(region);
+      sat_assert(cpuset);
+      thread->set_cpu_mask(cpuset);
+      if (region_mode_ == kLocalNuma)
+        thread->set_tag(1 << region);
+      else if (region_mode_ == kRemoteNuma)
+        thread->set_tag(region_mask_ & ~(1 << region));
+    }
+
+    latency_vector->insert(latency_vector->end(), thread);
+  }
+  workers_map_.insert(make_pair(kLatencyType, latency_vector));
+
+  // TLB threads, each on memory of its own.
+  WorkerVector *tlb_vector = new WorkerVector();
+  for (int i = 0; i < tlb_threads_; i++) {
+    TlbThread *thread = new TlbThread(tlb_mb_ * kMegabyte);
+    thread->InitThread(total_threads_++, this, os_, patternlist_,
+                       &power_spike_status_[kPauseMemory]);
+    tlb_vector->insert(tlb_vector->end(), thread);
+  }
+  workers_map_.insert(make_pair(kTlbType, tlb_vector));
+
+  // Rowhammer threads.
+  WorkerVector *rowhammer_vector = new WorkerVector();
+  for (int i = 0; i < rowhammer_threads_; i++) {
+    RowhammerThread *thread = new RowhammerThread();
+    thread->InitThread(total_threads_++, this, os_, patternlist_,
+                       &power_spike_status_[kPauseMemory]);
+    rowhammer_vector->insert(rowhammer_vector->end(), thread);
+  }
+  workers_map_.insert(make_pair(kRowhammerType, rowhammer_vector));
+
+  // March test threads.
+  WorkerVector *march_vector = new WorkerVector();
+  for (int i = 0; i < march_threads_; i++) {
+    MarchThread *thread = new MarchThread(&march_test_);
+    thread->InitThread(total_threads_++, this, os_, patternlist_,
+                       &power_spike_status_[kPauseMemory]);
+    // Test each region from its own cores, like the copy threads.
+    if ((region_count_ > 1) && (region_mode_)) {
+      int32 region = region_find(i % region_count_);
+      cpu_set_t *cpuset = os_->FindCoreMask(region);
+      sat_assert(cpuset);
+      thread->set_cpu_mask(cpuset);
+      if (region_mode_ == kLocalNuma)
+        thread->set_tag(1 << region);
+      else if (region_mode_ == kRemoteNuma)
+        thread->set_tag(region_mask_ & ~(1 << region));
+    }
+    march_vector->insert(march_vector->end(), thread);
+  }
+  workers_map_.insert(make_pair(kMarchType, march_vector));
+
+  // Memory region threads, copying test pages through each region.
+  WorkerVector *region_vector = new WorkerVector();
+  for (size_t r = 0; r < regions_.size(); r++) {
+    RegionSource *region = regions_[r];
+    // Each thread gets a slice of its own, a whole number of pages.
+    int64 slice = region->size() / page_length_ / region->threads() *
+                  page_length_;
+    for (int i = 0; i < region->threads() && slice; i++) {
+      MemoryRegionThread *thread = new MemoryRegionThread();
+      thread->InitThread(total_threads_++, this, os_, patternlist_,
+                         &power_spike_status_[kPauseMemory]);
+      char *base = static_cast<char*>(region->base()) + i * slice;
+      sat_assert(thread->SetRegion(base, slice));
+      thread->SetIdentifier(region->name());
+      thread->set_access_width(region->width());
+      region_vector->insert(region_vector->end(), thread);
+    }
+  }
+  workers_map_.insert(make_pair(kRegionType, region_vector));
+
+  // Power wave threads, one per cpu unless told otherwise.
+  WorkerVector *wave_vector = new WorkerVector();
+  if (power_wave_.enabled()) {
+    int threads = power_wave_threads_ ? power_wave_threads_ : CpuCount();
+    for (int i = 0; i < threads; i++) {
+      PowerWaveThread *thread = new PowerWaveThread(&power_wave_);
+      // Power spike pauses would break up the wave.
+      thread->InitThread(total_threads_++, this, os_, patternlist_,
+                         &continuous_status_);
+      cpu_set_t available_cpus;
+      thread->AvailableCpus(&available_cpus);
+      int cores = cpuset_count(&available_cpus);
+      if (threads <= cores)
+        thread->set_cpu_mask_to_cpu(i);
+      wave_vector->insert(wave_vector->end(), thread);
+    }
+    // Before the threads start, they only ever read it.
+    power_wave_.Start();
+  }
+  workers_map_.insert(make_pair(kPowerWaveType, wave_vector));
+
   // Disk stress threads.
   WorkerVector *disk_vector = new WorkerVector();
   WorkerVector *random_vector = new WorkerVector();
@@ -1322,14 +2782,17 @@ void Sat::InitializeThreads() {
     // Creating write threads
     DiskThread *thread = new DiskThread(blocktables_[i]);
     thread->InitThread(total_threads_++, this, os_, patternlist_,
-                       &power_spike_status_);
+                       &power_spike_status_[kPauseDisk]);
     thread->SetDevice(diskfilename_[i].c_str());
     if (thread->SetParameters(read_block_size_, write_block_size_,
                               segment_size_, cache_size_,
                               blocks_per_segment_,
                               read_threshold_, write_threshold_,
-                              non_destructive_)) {
+                              non_destructive_) &&
+        thread->SetIoEngine(disk_io_engine_, disk_queue_depth_,
+                            disk_pipeline_)) {
       disk_vector->insert(disk_vector->end(), thread);
+      disk_orchestrator_.AddThread(thread);
     } else {
       logprintf(12, "Log: DiskThread::SetParameters() failed\n");
       delete thread;
@@ -1339,14 +2802,17 @@ void Sat::InitializeThreads() {
       // Creating random threads
       RandomDiskThread *rthread = new RandomDiskThread(blocktables_[i]);
       rthread->InitThread(total_threads_++, this, os_, patternlist_,
-                          &power_spike_status_);
+                          &power_spike_status_[kPauseDisk]);
       rthread->SetDevice(diskfilename_[i].c_str());
       if (rthread->SetParameters(read_block_size_, write_block_size_,
                                  segment_size_, cache_size_,
                                  blocks_per_segment_,
                                  read_threshold_, write_threshold_,
-                                 non_destructive_)) {
+                                 non_destructive_) &&
+          rthread->SetIoEngine(disk_io_engine_, disk_queue_depth_,
+                               disk_pipeline_)) {
         random_vector->insert(random_vector->end(), rthread);
+        disk_orchestrator_.AddThread(rthread);
       } else {
       logprintf(12, "Log: RandomDiskThread::SetParameters() failed\n");
         delete rthread;
@@ -1356,12 +2822,15 @@ void Sat::InitializeThreads() {
 
   workers_map_.insert(make_pair(kDiskType, disk_vector));
   workers_map_.insert(make_pair(kRandomDiskType, random_vector));
+  if (disk_balance_seconds_)
+    disk_orchestrator_.PinThreads(os_);
 
   // CPU stress threads.
   WorkerVector *cpu_vector = new WorkerVector();
   logprintf(12, "Log: Starting cpu stress threads\n");
   for (int i = 0; i < cpu_stress_threads_; i++) {
     CpuStressThread *thread = new CpuStressThread();
+    thread->set_kernel(cpu_stress_kernel_);
     thread->InitThread(total_threads_++, this, os_, patternlist_,
                        &continuous_status_);
 
@@ -1370,7 +2839,15 @@ void Sat::InitializeThreads() {
     cpu_set_t available_cpus;
     thread->AvailableCpus(&available_cpus);
     int cores = cpuset_count(&available_cpus);
-    if (cpu_stress_threads_ + memory_threads_ <= cores) {
+    if (by_cluster) {
+      // Carry on where the copy threads left off.
+      int cluster;
+      int cpu = ClusterCpu(memory_threads_ + i, &cluster);
+      logprintf(9, "Log: Placing cpu stress thread %d on cpu %d (%s)\n", i,
+                cpu, clusters_[cluster].name.c_str());
+      thread->set_cpu_mask_to_cpu(cpu);
+      cpu_clusters_.push_back(cluster);
+    } else if (cpu_stress_threads_ + memory_threads_ <= cores) {
       // Place a thread on alternating cores first.
       // Go in reverse order for CPU stress threads. This assures interleaved
       // core use with no overlap.
@@ -1409,7 +2886,6 @@ void Sat::InitializeThreads() {
            sizeof(cc_cacheline_data) * cc_cacheline_count_);
 
     int num_cpus = CpuCount();
-    char *num;
     // Calculate the number of cache lines needed just to give each core
     // its own counter.
     int line_size = cc_cacheline_size_;
@@ -1419,28 +2895,58 @@ void Sat::InitializeThreads() {
         line_size = kCacheLineSize;
       logprintf(12, "Log: Using %d as cache line size\n", line_size);
     }
-    // The number of cache lines needed to hold an array of num_cpus.
-    // "num" must be the same type as cc_cacheline_data[X].num or the memory
-    // size calculations will fail.
-    int needed_lines = (sizeof(*num) * num_cpus + line_size - 1) / line_size;
-    // Allocate all the nums once so that we get a single chunk
-    // of contiguous memory.
-#ifdef HAVE_POSIX_MEMALIGN
-    int err_result = posix_memalign(
-        reinterpret_cast<void**>(&num),
-        line_size, line_size * needed_lines * cc_cacheline_count_);
-#else
-    num = reinterpret_cast<int*>(memalign(
-        line_size, line_size * needed_lines * cc_cacheline_count_));
-    int err_result = (num == 0);
-#endif
-    sat_assert(err_result == 0);
-
-    int cline;
-    for (cline = 0; cline < cc_cacheline_count_; cline++) {
-      memset(num, 0, sizeof(*num) * num_cpus);
-      cc_cacheline_data_[cline].num = num;
-      num += (line_size * needed_lines) / sizeof(*num);
+    // Counters are bytes, up to a line of them share a line. With pairs
+    // each line gets the adjacent line too, so the adjacent line
+    // prefetcher never pulls in another group's line.
+    static const int kAdjacentLinePair = 128;
+    int per_line = cc_threads_per_line_;
+    if (per_line <= 0 || per_line > line_size)
+      per_line = line_size;
+    int stride = line_size;
+    if (cc_line_pairs_ && stride < kAdjacentLinePair)
+      stride = kAdjacentLinePair;
+    int64 structure_size =
+        static_cast<int64>((num_cpus + per_line - 1) / per_line) * stride;
+    // Allocate all the nums once so that we get a single chunk of
+    // contiguous memory, with the pair mode line after them.
+    cc_line_mem_ = static_cast<char*>(os_->AllocatePinnedMem(
+        structure_size * cc_cacheline_count_ + stride, cc_node_,
+        &cc_line_mem_length_));
+    sat_assert(cc_line_mem_ != NULL);
+    logprintf(12, "Log: %d cache line structures of %lld bytes, %d "
+              "counters per %d bytes\n", cc_cacheline_count_,
+              structure_size, per_line, stride);
+
+    for (int cline = 0; cline < cc_cacheline_count_; cline++)
+      cc_cacheline_data_[cline].num = cc_line_mem_ + cline * structure_size;
+
+    // Every pair of cores takes turns, one thread per core.
+    if (cc_pairs_ && num_cpus < 2) {
+      logprintf(5, "Log: Only one cpu, can't bounce cachelines between "
+                "cores\n");
+    } else if (cc_pairs_) {
+      struct cc_pair_schedule *schedule = &cc_pair_schedule_;
+      int pairs = num_cpus * (num_cpus - 1) / 2;
+      schedule->turn = 0;
+      schedule->pairs = pairs;
+      schedule->first = new int[pairs];
+      schedule->second = new int[pairs];
+      schedule->transfers = new int64[pairs];
+      schedule->ns = new int64[pairs];
+      int pair = 0;
+      for (int a = 0; a < num_cpus; a++) {
+        for (int b = a + 1; b < num_cpus; b++) {
+          schedule->first[pair] = a;
+          schedule->second[pair] = b;
+          schedule->transfers[pair] = 0;
+          schedule->ns[pair] = 0;
+          pair++;
+        }
+      }
+      schedule->line = reinterpret_cast<uint64*>(
+          cc_line_mem_ + structure_size * cc_cacheline_count_);
+      logprintf(12, "Log: Bouncing a cacheline between %d cpu pairs\n",
+                pairs);
     }
 
     int tnum;
@@ -1450,6 +2956,9 @@ void Sat::InitializeThreads() {
                                       tnum, num_cpus, cc_inc_count_);
       thread->InitThread(total_threads_++, this, os_, patternlist_,
                          &continuous_status_);
+      if (cc_pair_schedule_.pairs)
+        thread->set_pair_schedule(&cc_pair_schedule_);
+      thread->set_line_layout(per_line, stride);
       // Pin the thread to a particular core.
       thread->set_cpu_mask_to_cpu(tnum);
 
@@ -1467,13 +2976,28 @@ void Sat::InitializeThreads() {
                                               cpu_freq_round_);
     // This thread should be paused when other threads are paused.
     thread->InitThread(total_threads_++, this, os_, NULL,
-                       &power_spike_status_);
+                       &power_spike_status_[kPauseCpuFreq]);
 
     WorkerVector *cpu_freq_vector = new WorkerVector();
     cpu_freq_vector->insert(cpu_freq_vector->end(), thread);
     workers_map_.insert(make_pair(kCPUFreqType, cpu_freq_vector));
   }
 
+  // Each capped type shares one limiter between all of its threads.
+  for (map<int, double>::const_iterator it = rate_limits_.begin();
+       it != rate_limits_.end(); ++it) {
+    WorkerMap::const_iterator workers = workers_map_.find(it->first);
+    if (workers == workers_map_.end())
+      continue;
+    logprintf(12, "Log: Limiting %s threads to %.2fMB/s\n",
+              ThreadTypeName(it->first), it->second);
+    RateLimiter *limiter = new RateLimiter(it->second);
+    rate_limiters_.push_back(limiter);
+    for (WorkerVector::const_iterator thread = workers->second->begin();
+         thread != workers->second->end(); ++thread)
+      (*thread)->set_rate_limiter(limiter);
+  }
+
   ReleaseWorkerLock();
 }
 
@@ -1495,10 +3019,49 @@ int Sat::CacheLineSize() {
   return max_linesize;
 }
 
+// Register with the net coordinator, then add a network thread for every
+// peer it assigns and a listen thread for the peers streaming to us.
+bool Sat::JoinNetCoordinator() {
+  if (!net_client_.Join(net_register_, kNetCoordinatorPort, runtime_seconds_,
+                        NetCoordinator::kJoinTimeoutMs))
+    return false;
+  const vector<string> &peers = net_client_.peers();
+  for (size_t i = 0; i < peers.size(); i++) {
+    ipaddrs_.push_back(peers[i]);
+    net_threads_++;
+  }
+  listen_threads_ = 1;
+  net_start_us_ = sat_get_time_us() + net_client_.delay_ms() * 1000LL;
+  return true;
+}
+
+// Send the coordinator the results of the links it assigned, the last
+// network threads.
+void Sat::ReportNetCoordinator() {
+  WorkerVector *net = workers_map_[kNetIOType];
+  int first = net->size() - net_client_.peers().size();
+  vector<NetLinkResult> links;
+  for (int i = first; i < static_cast<int>(net->size()); i++) {
+    NetworkThread *thread = static_cast<NetworkThread*>((*net)[i]);
+    struct NetLinkResult link;
+    link.to = thread->ipaddr();
+    link.mbytes = thread->GetDeviceCopiedData();
+    link.seconds = thread->stream_usec() / 1000000.;
+    // A link that never came up is an error too.
+    link.errors = thread->GetErrorCount() + (thread->GetStatus() ? 0 : 1);
+    links.push_back(link);
+  }
+  net_client_.Report(links, errorcount_);
+}
+
 // Notify and reap worker threads.
 void Sat::JoinThreads() {
   logprintf(12, "Log: Joining worker threads\n");
-  power_spike_status_.StopWorkers();
+  // Every group is told to stop before the first join, so the threads wind
+  // down together and the joins wait for the slowest one only.
+  int64 stop_us = sat_get_time_us();
+  for (int i = 0; i < kPauseGroupCount; i++)
+    power_spike_status_[i].StopWorkers();
   continuous_status_.StopWorkers();
 
   AcquireWorkerLock();
@@ -1511,23 +3074,36 @@ void Sat::JoinThreads() {
     }
   }
   ReleaseWorkerLock();
+  int64 check_us = sat_get_time_us();
 
   QueueStats();
 
   // Finish up result checking.
-  // Spawn 4 check threads to minimize check time.
+  // Spawn a check thread per fill thread to minimize check time.
   logprintf(12, "Log: Finished countdown, begin to result check\n");
   WorkerStatus reap_check_status;
   WorkerVector reap_check_vector;
 
   // No need for check threads for monitor mode.
   if (!monitor_mode_) {
+    // Queues that keep pages in place let each check thread walk a slice
+    // of them from the slice's node, like the fill threads.
+    bool ranges = (pe_q_implementation_ == SAT_FINELOCK ||
+                   pe_q_implementation_ == SAT_SHARDED);
+    int check_threads = fill_threads_;
+    if (check_threads > pages_)
+      check_threads = pages_;
     // Initialize the check threads.
-    for (int i = 0; i < fill_threads_; i++) {
+    for (int i = 0; i < check_threads; i++) {
       CheckThread *thread = new CheckThread();
       thread->InitThread(total_threads_++, this, os_, patternlist_,
                          &reap_check_status);
-      logprintf(12, "Log: Finished countdown, begin to result check\n");
+      if (ranges) {
+        int64 first_page = pages_ * i / check_threads;
+        thread->SetCheckRange(first_page,
+                              pages_ * (i + 1) / check_threads - first_page);
+        PlaceRangeThread(thread, i, first_page);
+      }
       reap_check_vector.push_back(thread);
     }
   }
@@ -1549,6 +3125,11 @@ void Sat::JoinThreads() {
     logprintf(12, "Log: Joining thread %d\n", (*it)->ThreadID());
     (*it)->JoinThread();
   }
+  int64 done_us = sat_get_time_us();
+  logprintf(6, "Log: Stopped the workers in %.2fs, checked the pages with "
+            "%d threads in %.2fs\n", (check_us - stop_us) / 1000000.,
+            static_cast<int>(reap_check_vector.size()),
+            (done_us - check_us) / 1000000.);
 
   // Reap all children. Stopped threads should have already ended.
   // Result checking threads will end when they have finished
@@ -1606,7 +3187,12 @@ void Sat::JoinThreads() {
 
 // Print queuing information.
 void Sat::QueueStats() {
-  finelock_q_->QueueAnalysis();
+  if (pe_q_implementation_ == SAT_FINELOCK)
+    finelock_q_->QueueAnalysis();
+  else if (pe_q_implementation_ == SAT_SHARDED)
+    sharded_q_->QueueAnalysis();
+  else if (pe_q_implementation_ == SAT_SPLIT)
+    split_q_->QueueAnalysis();
 }
 
 void Sat::AnalysisAllStats() {
@@ -1628,6 +3214,12 @@ void Sat::AnalysisAllStats() {
     }
   }
 
+  // Include the runs this one resumed.
+  for (map<string, struct CheckpointCounts>::const_iterator it =
+           resumed_.types.begin(); it != resumed_.types.end(); ++it)
+    total_data += it->second.data;
+  max_runtime_sec += resumed_.elapsed;
+
   total_bandwidth = total_data / max_runtime_sec;
 
   logprintf(0, "Stats: Completed: %.2fM in %.2fs %.2fMB/s, "
@@ -1662,6 +3254,27 @@ void Sat::MemoryStats() {
   logprintf(4, "Stats: Memory Copy: %.2fM at %.2fMB/s\n",
             memcopy_data,
             memcopy_bandwidth);
+
+  // Break copy thread bandwidth down by engine, when engines were chosen.
+  if (copy_engines_.size()) {
+    float engine_data[kCopyEngineCount] = { 0. };
+    float engine_bandwidth[kCopyEngineCount] = { 0. };
+    for (WorkerVector::const_iterator it = mem_it->second->begin();
+         it != mem_it->second->end(); ++it) {
+      int engine = static_cast<CopyThread*>(*it)->copy_engine();
+      engine_data[engine] += (*it)->GetMemoryCopiedData();
+      engine_bandwidth[engine] += (*it)->GetMemoryBandwidth();
+    }
+    for (int engine = 0; engine < kCopyEngineCount; engine++) {
+      if (find(copy_engines_.begin(), copy_engines_.end(), engine) ==
+          copy_engines_.end())
+        continue;
+      logprintf(4, "Stats: Memory Copy (%s): %.2fM at %.2fMB/s\n",
+                CopyEngineName(engine),
+                engine_data[engine],
+                engine_bandwidth[engine]);
+    }
+  }
 }
 
 void Sat::GoogleMemoryStats(float *memcopy_data,
@@ -1683,6 +3296,35 @@ void Sat::FileStats() {
   logprintf(4, "Stats: File Copy: %.2fM at %.2fMB/s\n",
             file_data,
             file_bandwidth);
+
+  // Latencies per device, over all the threads with files on it.
+  vector<string> devices;
+  for (WorkerVector::const_iterator it = file_it->second->begin();
+       it != file_it->second->end(); ++it) {
+    const string &device =
+        static_cast<FileThread*>(*it)->device_name();
+    if (std::find(devices.begin(), devices.end(), device) == devices.end())
+      devices.push_back(device);
+  }
+  for (size_t i = 0; i < devices.size(); i++) {
+    LatencyHistogram reads, writes;
+    for (WorkerVector::const_iterator it = file_it->second->begin();
+         it != file_it->second->end(); ++it) {
+      FileThread *thread = static_cast<FileThread*>(*it);
+      if (thread->device_name() != devices[i])
+        continue;
+      reads.Add(thread->read_latency());
+      writes.Add(thread->write_latency());
+    }
+    if (reads.count())
+      logprintf(4, "Stats: File %s: %lld reads, %s\n", devices[i].c_str(),
+                static_cast<int64>(reads.count()),
+                reads.Summary().c_str());
+    if (writes.count())
+      logprintf(4, "Stats: File %s: %lld writes, %s\n", devices[i].c_str(),
+                static_cast<int64>(writes.count()),
+                writes.Summary().c_str());
+  }
 }
 
 void Sat::CheckStats() {
@@ -1739,6 +3381,56 @@ void Sat::InvertStats() {
   logprintf(4, "Stats: Invert Data: %.2fM at %.2fMB/s\n",
             invert_data,
             invert_bandwidth);
+
+  // Break invert bandwidth down by flush policy, when policies were chosen.
+  if (invert_flushes_.size()) {
+    float flush_data[kInvertFlushCount] = { 0. };
+    float flush_bandwidth[kInvertFlushCount] = { 0. };
+    for (WorkerVector::const_iterator it = invert_it->second->begin();
+         it != invert_it->second->end(); ++it) {
+      int flush = static_cast<InvertThread*>(*it)->invert_flush();
+      flush_data[flush] += (*it)->GetMemoryCopiedData();
+      flush_bandwidth[flush] += (*it)->GetMemoryBandwidth();
+    }
+    for (int flush = 0; flush < kInvertFlushCount; flush++) {
+      if (find(invert_flushes_.begin(), invert_flushes_.end(), flush) ==
+          invert_flushes_.end())
+        continue;
+      logprintf(4, "Stats: Invert Data (%s): %.2fM at %.2fMB/s\n",
+                InvertFlushName(flush),
+                flush_data[flush],
+                flush_bandwidth[flush]);
+    }
+  }
+}
+
+// Traffic and errors of each channel of --channel_map.
+void Sat::ChannelStats() {
+  if (!channel_map_.enabled() || !finelock_q_)
+    return;
+  int64 elapsed_us = sat_get_time_us() - channel_start_us_;
+  if (!channel_start_us_ || elapsed_us < 1)
+    elapsed_us = 1;
+  DeviceErrorMap errors;
+  os_->error_diagnoser_->CollectErrors(&errors);
+  for (int channel = 0; channel < channel_map_.channels(); channel++) {
+    uint64 valid, empty;
+    finelock_q_->ChannelTraffic(channel, &valid, &empty);
+    float data = (valid + empty) * page_length_ * 1.0 / kMegabyte;
+    logprintf(4, "Stats: Channel %d: %.2fM at %.2fMB/s, "
+              "%llu valid and %llu empty pages\n", channel, data,
+              data * 1000000.0 / elapsed_us, valid, empty);
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "Channel %d ", channel);
+    for (DeviceErrorMap::const_iterator it = errors.begin();
+         it != errors.end(); ++it) {
+      if (it->first.compare(0, strlen(prefix), prefix))
+        continue;
+      logprintf(4, "Stats: %s: %lld correctable, %lld fatal errors\n",
+                it->first.c_str(), it->second.correctable,
+                it->second.fatal);
+    }
+  }
 }
 
 void Sat::DiskStats() {
@@ -1764,10 +3456,523 @@ void Sat::DiskStats() {
   logprintf(4, "Stats: Disk: %.2fM at %.2fMB/s\n",
             disk_data,
             disk_bandwidth);
+  disk_orchestrator_.Report();
+}
+
+// Write one telemetry line with the throughput of each thread type since
+// the previous line. The counters are read without stopping the threads,
+// so a line may be a page or so behind.
+void Sat::TelemetryReport(bool final) {
+  int64 now_us = sat_get_time_us();
+  if (!telemetry_start_us_) {
+    telemetry_start_us_ = now_us;
+    telemetry_last_us_ = now_us;
+  }
+  double interval = (now_us - telemetry_last_us_) / 1000000.;
+  double elapsed = (now_us - telemetry_start_us_) / 1000000.;
+  // Rates are zero for the first line rather than undefined.
+  double per_sec = interval > 0 ? 1. / interval : 0;
+  telemetry_last_us_ = now_us;
+
+  string types;
+  int64 total_errors = 0;
+  float interval_data = 0.;
+  char buf[512];
+  AcquireWorkerLock();
+  for (WorkerMap::const_iterator map_it = workers_map_.begin();
+       map_it != workers_map_.end(); ++map_it) {
+    if (map_it->second->empty())
+      continue;
+    struct TelemetryCounts counts = { 0, 0, 0. };
+    for (WorkerVector::const_iterator it = map_it->second->begin();
+         it != map_it->second->end(); ++it) {
+      counts.pages += (*it)->GetPageCount();
+      counts.errors += (*it)->GetErrorCount();
+      counts.data += (*it)->GetMemoryCopiedData();
+      counts.data += (*it)->GetDeviceCopiedData();
+    }
+    total_errors += counts.errors;
+
+    struct TelemetryCounts last = { 0, 0, 0. };
+    map<int, struct TelemetryCounts>::const_iterator last_it =
+        telemetry_last_.find(map_it->first);
+    if (last_it != telemetry_last_.end())
+      last = last_it->second;
+    telemetry_last_[map_it->first] = counts;
+    interval_data += counts.data - last.data;
+
+    int type = map_it->first;
+    double pages_per_sec = (counts.pages - last.pages) * per_sec;
+    // Threads moving data to or from a device count a page or block as
+    // one I/O.
+    bool io = type == kFileIOType || type == kNetIOType ||
+              type == kNetSlaveType || type == kDiskType ||
+              type == kRandomDiskType;
+    snprintf(buf, sizeof(buf),
+             "%s\"%s\":{\"threads\":%d,\"pages\":%lld,"
+             "\"pages_per_sec\":%.1f,\"gbps\":%.3f,\"iops\":%.1f,"
+             "\"errors\":%lld,\"new_errors\":%lld}",
+             types.empty() ? "" : ",",
+             ThreadTypeName(type),
+             static_cast<int>(map_it->second->size()), counts.pages,
+             pages_per_sec, (counts.data - last.data) * per_sec / 1024.,
+             io ? pages_per_sec : 0., counts.errors,
+             counts.errors - last.errors);
+    types += buf;
+  }
+  CpuFreqThread *cpu_freq = FindCpuFreqThread();
+  struct PowerSample sample;
+  string power;
+  if (cpu_freq && cpu_freq->LastSample(&sample)) {
+    double watts = sample.package_watts + sample.dram_watts;
+    double gbps = interval_data * per_sec / 1024.;
+    snprintf(buf, sizeof(buf),
+             ",\"power\":{\"package_watts\":%.2f,\"dram_watts\":%.2f,"
+             "\"mhz_avg\":%.0f,\"mhz_min\":%d,\"mhz_max\":%d,"
+             "\"throttled_cpus\":%d,\"gbps_per_watt\":%.4f}",
+             sample.package_watts, sample.dram_watts, sample.avg_mhz,
+             sample.min_mhz, sample.max_mhz, sample.throttled_cpus,
+             watts > 0 ? gbps / watts : 0.);
+    power = buf;
+  }
+  ReleaseWorkerLock();
+
+  snprintf(buf, sizeof(buf),
+           "{\"time\":%lld,\"elapsed\":%.3f,\"interval\":%.3f,"
+           "\"final\":%s,\"errors\":%lld,\"types\":{",
+           static_cast<int64>(time(NULL)), elapsed, interval,
+           final ? "true" : "false", total_errors);
+  if (!telemetry_.WriteLine(buf + types + "}" + power + "}"))
+    logprintf(12, "Log: Dropped telemetry line\n");
+}
+
+// The cpu frequency thread, or NULL if it isn't running.
+CpuFreqThread *Sat::FindCpuFreqThread() {
+  WorkerMap::const_iterator freq_it = workers_map_.find(
+      static_cast<int>(kCPUFreqType));
+  if (freq_it == workers_map_.end() || freq_it->second->empty())
+    return NULL;
+  return static_cast<CpuFreqThread*>(freq_it->second->front());
+}
+
+// Average power over the run and the bandwidth it bought, when the cpu
+// frequency thread could read the RAPL energy counters.
+void Sat::PowerStats() {
+  CpuFreqThread *cpu_freq = FindCpuFreqThread();
+  if (!cpu_freq || !cpu_freq->has_energy())
+    return;
+  double package_joules, dram_joules, seconds;
+  cpu_freq->TotalEnergy(&package_joules, &dram_joules, &seconds);
+  if (seconds <= 0)
+    return;
+
+  float max_runtime_sec = 0.;
+  float total_data = 0.;
+  for (WorkerMap::const_iterator map_it = workers_map_.begin();
+       map_it != workers_map_.end(); ++map_it) {
+    for (WorkerVector::const_iterator it = map_it->second->begin();
+         it != map_it->second->end(); ++it) {
+      float thread_runtime_sec = (*it)->GetRunDurationUSec() / 1000000.;
+      total_data += (*it)->GetMemoryCopiedData();
+      total_data += (*it)->GetDeviceCopiedData();
+      if (thread_runtime_sec > max_runtime_sec)
+        max_runtime_sec = thread_runtime_sec;
+    }
+  }
+  double watts = (package_joules + dram_joules) / seconds;
+  double gbps = max_runtime_sec > 0 ? total_data / max_runtime_sec / 1024. : 0;
+  logprintf(4, "Stats: Power: %.1fW package, %.1fW DRAM, "
+            "%.3f GB/s per watt\n",
+            package_joules / seconds, dram_joules / seconds,
+            watts > 0 ? gbps / watts : 0.);
+}
+
+// Bandwidth through each --region, when there are any.
+void Sat::RegionStats() {
+  WorkerMap::const_iterator region_it = workers_map_.find(
+      static_cast<int>(kRegionType));
+  sat_assert(region_it != workers_map_.end());
+  for (size_t r = 0; r < regions_.size(); r++) {
+    float region_data = 0.;
+    float region_bandwidth = 0.;
+    for (WorkerVector::const_iterator it = region_it->second->begin();
+         it != region_it->second->end(); ++it) {
+      MemoryRegionThread *thread = static_cast<MemoryRegionThread*>(*it);
+      if (thread->identifier() != regions_[r]->name())
+        continue;
+      region_data += thread->GetDeviceCopiedData();
+      region_bandwidth += thread->GetDeviceBandwidth();
+    }
+    logprintf(4, "Stats: Region %s: %.2fM at %.2fMB/s\n",
+              regions_[r]->name().c_str(), region_data, region_bandwidth);
+  }
+}
+
+// How closely the power wave threads kept to the wave.
+void Sat::PowerWaveStats() {
+  WorkerMap::const_iterator wave_it = workers_map_.find(
+      static_cast<int>(kPowerWaveType));
+  sat_assert(wave_it != workers_map_.end());
+  if (wave_it->second->empty())
+    return;
+
+  int64 edges = 0;
+  int64 late_edges = 0;
+  int64 max_late_ns = 0;
+  for (WorkerVector::const_iterator it = wave_it->second->begin();
+       it != wave_it->second->end(); ++it) {
+    PowerWaveThread *thread = static_cast<PowerWaveThread*>(*it);
+    edges += thread->edges();
+    late_edges += thread->late_edges();
+    if (thread->max_late_ns() > max_late_ns)
+      max_late_ns = thread->max_late_ns();
+  }
+  logprintf(4, "Stats: Power wave %s: %d threads, %lld edges, %lld later "
+            "than %lldus, worst %.1fus\n", power_wave_.name().c_str(),
+            static_cast<int>(wave_it->second->size()), edges, late_edges,
+            PowerWaveThread::kLateNs / 1000, max_late_ns / 1000.);
+}
+
+// Every link the net coordinator heard about, and the fabric as a whole.
+void Sat::NetCoordinatorStats() {
+  WorkerMap::const_iterator coordinator_it = workers_map_.find(
+      static_cast<int>(kNetCoordinatorType));
+  sat_assert(coordinator_it != workers_map_.end());
+  if (coordinator_it->second->empty())
+    return;
+
+  const vector<NetLinkResult> &links = net_coordinator_.links();
+  double total_rate = 0.;
+  double slowest_rate = 0.;
+  int64 link_errors = 0;
+  for (size_t i = 0; i < links.size(); i++) {
+    double rate = links[i].seconds > 0 ?
+        links[i].mbytes / links[i].seconds / 1024. : 0.;
+    logprintf(4, "Stats: Net link %s -> %s: %.2fM in %.1fs at %.2fGB/s, "
+              "%lld errors\n", links[i].from.c_str(), links[i].to.c_str(),
+              links[i].mbytes, links[i].seconds, rate, links[i].errors);
+    total_rate += rate;
+    if (!i || rate < slowest_rate)
+      slowest_rate = rate;
+    link_errors += links[i].errors;
+  }
+  logprintf(4, "Stats: Net fabric %s: %d of %d hosts reported, %d links "
+            "at %.2fGB/s, slowest %.2fGB/s, %lld link errors, %lld host "
+            "errors\n", NetCoordinator::TopologyName(net_topology_),
+            net_coordinator_.reported(), net_coordinator_hosts_,
+            static_cast<int>(links.size()), total_rate, slowest_rate,
+            link_errors, net_coordinator_.host_errors());
+}
+
+// Bandwidth of the March threads, when there are any.
+void Sat::MarchStats() {
+  WorkerMap::const_iterator march_it = workers_map_.find(
+      static_cast<int>(kMarchType));
+  sat_assert(march_it != workers_map_.end());
+  if (march_it->second->empty())
+    return;
+
+  float march_data = 0.;
+  float march_bandwidth = 0.;
+  for (WorkerVector::const_iterator it = march_it->second->begin();
+       it != march_it->second->end(); ++it) {
+    march_data += (*it)->GetMemoryCopiedData();
+    march_bandwidth += (*it)->GetMemoryBandwidth();
+  }
+  logprintf(4, "Stats: March (%s): %.2fM at %.2fMB/s\n",
+            march_test_.name().c_str(),
+            march_data,
+            march_bandwidth);
 }
 
 // Process worker thread data for bandwidth information, and error results.
 // You can add more methods here just subclassing SAT.
+// Latency percentiles of each memory region, from the histograms of all
+// latency threads.
+void Sat::LatencyStats() {
+  WorkerMap::const_iterator latency_it = workers_map_.find(
+      static_cast<int>(kLatencyType));
+  sat_assert(latency_it != workers_map_.end());
+  if (latency_it->second->empty())
+    return;
+
+  for (int region = 0; region < LatencyThread::kRegions; region++) {
+    uint64 histogram[LatencyThread::kBuckets] = { 0 };
+    uint64 walks = 0;
+    for (WorkerVector::const_iterator it = latency_it->second->begin();
+         it != latency_it->second->end(); ++it) {
+      const uint64 *thread_histogram =
+          static_cast<LatencyThread*>(*it)->histogram(region);
+      for (int bucket = 0; bucket < LatencyThread::kBuckets; bucket++) {
+        histogram[bucket] += thread_histogram[bucket];
+        walks += thread_histogram[bucket];
+      }
+    }
+    if (!walks)
+      continue;
+
+    // Upper bound of the bucket holding each percentile.
+    static const int kPercentiles[] = { 50, 90, 99 };
+    int64 ns[3] = { 0 };
+    for (int p = 0; p < 3; p++) {
+      uint64 seen = 0;
+      for (int bucket = 0; bucket < LatencyThread::kBuckets; bucket++) {
+        seen += histogram[bucket];
+        if (seen * 100 >= walks * kPercentiles[p]) {
+          ns[p] = (bucket + 1) * LatencyThread::kBucketNs;
+          break;
+        }
+      }
+    }
+    char name[16];
+    if (region == LatencyThread::kRegions - 1)
+      snprintf(name, sizeof(name), "mixed");
+    else
+      snprintf(name, sizeof(name), "%d", region);
+    logprintf(4, "Stats: Latency region %s: %lld walks, p50 %lldns, "
+              "p90 %lldns, p99 %lldns per load\n", name, walks,
+              ns[0], ns[1], ns[2]);
+    for (int bucket = 0; bucket < LatencyThread::kBuckets; bucket++) {
+      if (histogram[bucket])
+        logprintf(12, "Log: Latency region %s: %d-%dns: %lld\n", name,
+                  bucket * LatencyThread::kBucketNs,
+                  (bucket + 1) * LatencyThread::kBucketNs, histogram[bucket]);
+    }
+  }
+}
+
+// Pages walked by the TLB threads and the time per line, which is mostly
+// the page walk.
+void Sat::TlbStats() {
+  WorkerMap::const_iterator tlb_it = workers_map_.find(
+      static_cast<int>(kTlbType));
+  sat_assert(tlb_it != workers_map_.end());
+  if (tlb_it->second->empty())
+    return;
+
+  uint64 histogram[LatencyThread::kBuckets] = { 0 };
+  uint64 batches = 0;
+  float data = 0.;
+  float bandwidth = 0.;
+  int64 mapped = 0;
+  for (WorkerVector::const_iterator it = tlb_it->second->begin();
+       it != tlb_it->second->end(); ++it) {
+    TlbThread *thread = static_cast<TlbThread*>(*it);
+    for (int bucket = 0; bucket < LatencyThread::kBuckets; bucket++) {
+      histogram[bucket] += thread->histogram()[bucket];
+      batches += thread->histogram()[bucket];
+    }
+    data += thread->GetMemoryCopiedData();
+    bandwidth += thread->GetMemoryBandwidth();
+    mapped += thread->size();
+  }
+
+  static const int kPercentiles[] = { 50, 90, 99 };
+  int64 ns[3] = { 0 };
+  for (int p = 0; p < 3 && batches; p++) {
+    uint64 seen = 0;
+    for (int bucket = 0; bucket < LatencyThread::kBuckets; bucket++) {
+      seen += histogram[bucket];
+      if (seen * 100 >= batches * kPercentiles[p]) {
+        ns[p] = (bucket + 1) * LatencyThread::kBucketNs;
+        break;
+      }
+    }
+  }
+  logprintf(4, "Stats: TLB Data: %.2fM at %.2fMB/s over %lldMB, "
+            "p50 %lldns, p90 %lldns, p99 %lldns per line\n", data, bandwidth,
+            mapped / kMegabyte, ns[0], ns[1], ns[2]);
+}
+
+// Core by core matrix of cacheline transfer latencies from --cc_pairs,
+// and the averages within and between NUMA nodes, to point at slow links.
+void Sat::CcPairStats() {
+  const struct cc_pair_schedule *schedule = &cc_pair_schedule_;
+  if (!schedule->pairs)
+    return;
+
+  int cpus = CpuCount();
+  int nodes = os_->num_nodes();
+  if (nodes < 1)
+    nodes = 1;
+  vector<int> node(cpus, 0);
+  for (int region = 0; region < nodes; region++) {
+    cpu_set_t *cpuset = os_->FindCoreMask(region);
+    for (int cpu = 0; cpu < cpus; cpu++) {
+      if (CPU_ISSET(cpu, cpuset))
+        node[cpu] = region;
+    }
+  }
+
+  vector<double> ns(cpus * cpus, 0.);
+  vector<int64> node_transfers(nodes * nodes, 0);
+  vector<int64> node_ns(nodes * nodes, 0);
+  int slowest = -1;
+  for (int pair = 0; pair < schedule->pairs; pair++) {
+    if (!schedule->transfers[pair])
+      continue;
+    int a = schedule->first[pair];
+    int b = schedule->second[pair];
+    double pair_ns = static_cast<double>(schedule->ns[pair]) /
+                     schedule->transfers[pair];
+    ns[a * cpus + b] = pair_ns;
+    ns[b * cpus + a] = pair_ns;
+    int link = node[a] * nodes + node[b];
+    node_transfers[link] += schedule->transfers[pair];
+    node_ns[link] += schedule->ns[pair];
+    if (slowest < 0 || pair_ns > ns[schedule->first[slowest] * cpus +
+                                    schedule->second[slowest]])
+      slowest = pair;
+  }
+  if (slowest < 0) {
+    logprintf(4, "Stats: CC pairs: no turns completed\n");
+    return;
+  }
+
+  string row = "cpu  ";
+  char cell[16];
+  for (int b = 0; b < cpus; b++) {
+    snprintf(cell, sizeof(cell), " %5d", b);
+    row += cell;
+  }
+  logprintf(4, "Stats: CC pair ns per cacheline transfer, %s\n",
+            row.c_str());
+  for (int a = 0; a < cpus; a++) {
+    snprintf(cell, sizeof(cell), "%-5d", a);
+    row = cell;
+    for (int b = 0; b < cpus; b++) {
+      if (ns[a * cpus + b] > 0.)
+        snprintf(cell, sizeof(cell), " %5.0f", ns[a * cpus + b]);
+      else
+        snprintf(cell, sizeof(cell), " %5s", "-");
+      row += cell;
+    }
+    logprintf(4, "Stats: CC pair ns per cacheline transfer, %s\n",
+              row.c_str());
+  }
+
+  for (int a = 0; a < nodes; a++) {
+    for (int b = a; b < nodes; b++) {
+      int64 transfers = node_transfers[a * nodes + b] +
+                        (a != b ? node_transfers[b * nodes + a] : 0);
+      int64 total_ns = node_ns[a * nodes + b] +
+                       (a != b ? node_ns[b * nodes + a] : 0);
+      if (!transfers)
+        continue;
+      logprintf(4, "Stats: CC node %d - node %d: %.1fns per transfer, "
+                "%.2fM transfers/s\n", a, b,
+                static_cast<double>(total_ns) / transfers,
+                transfers * 1e3 / total_ns);
+    }
+  }
+  int a = schedule->first[slowest];
+  int b = schedule->second[slowest];
+  logprintf(4, "Stats: CC slowest pair: cpu %d (node %d) - cpu %d (node %d) "
+            "%.1fns per transfer, %.2fM transfers/s\n", a, node[a], b,
+            node[b], ns[a * cpus + b], 1e3 / ns[a * cpus + b]);
+}
+
+int Sat::ClusterCpu(int n, int *cluster) {
+  int count = clusters_.size();
+  if (!strcmp(cluster_placement_, "spread")) {
+    // One thread per cluster in turn, fastest first.
+    *cluster = n % count;
+    const vector<int> &cpus = clusters_[*cluster].cpus;
+    return cpus[(n / count) % cpus.size()];
+  }
+  if (!strcmp(cluster_placement_, "fill")) {
+    // Every cpu of a cluster before the next cluster.
+    int total = 0;
+    for (int c = 0; c < count; c++)
+      total += clusters_[c].cpus.size();
+    n %= total;
+    for (int c = 0; c < count; c++) {
+      int size = clusters_[c].cpus.size();
+      if (n < size) {
+        *cluster = c;
+        return clusters_[c].cpus[n];
+      }
+      n -= size;
+    }
+  }
+  // Only the named cluster, checked by ParseArgs().
+  *cluster = 0;
+  for (int c = 0; c < count; c++) {
+    if (clusters_[c].name == cluster_placement_)
+      *cluster = c;
+  }
+  const vector<int> &cpus = clusters_[*cluster].cpus;
+  return cpus[n % cpus.size()];
+}
+
+void Sat::SampleClusters() {
+  for (size_t c = 0; c < clusters_.size(); c++) {
+    int64 khz = ClusterCurrentKHz(clusters_[c]);
+    cluster_khz_total_[c] += khz;
+    if (!cluster_khz_min_[c] || khz < cluster_khz_min_[c])
+      cluster_khz_min_[c] = khz;
+    cluster_khz_max_[c] = max(cluster_khz_max_[c], khz);
+  }
+  cluster_khz_samples_++;
+}
+
+void Sat::FillClusters(bool final, double seconds,
+                       vector<struct ReportCluster> *clusters) {
+  clusters->clear();
+  for (size_t c = 0; c < clusters_.size(); c++) {
+    struct ReportCluster cluster;
+    cluster.name = clusters_[c].name;
+    cluster.cpus = FormatSysfsList(clusters_[c].cpus);
+    cluster.capacity = clusters_[c].capacity;
+    cluster.copy_threads = 0;
+    cluster.cpu_threads = 0;
+    cluster.data = 0.;
+    cluster.bandwidth = 0.;
+    cluster.max_khz = clusters_[c].max_khz;
+    cluster.mean_khz = cluster_khz_samples_ ?
+                       cluster_khz_total_[c] / cluster_khz_samples_ : 0;
+    cluster.min_khz = cluster_khz_min_[c];
+    cluster.peak_khz = cluster_khz_max_[c];
+    clusters->push_back(cluster);
+  }
+
+  // Threads placed some other way aren't in a cluster.
+  WorkerMap::const_iterator mem_it = workers_map_.find(kMemoryType);
+  if (mem_it != workers_map_.end()) {
+    for (size_t i = 0; i < mem_it->second->size() &&
+                       i < copy_clusters_.size(); i++) {
+      WorkerThread *thread = (*mem_it->second)[i];
+      struct ReportCluster &cluster = (*clusters)[copy_clusters_[i]];
+      double data = thread->GetMemoryCopiedData();
+      cluster.copy_threads++;
+      cluster.data += data;
+      if (!final)
+        cluster.bandwidth += data / seconds;
+      else if (thread->GetRunDurationUSec() > 0)
+        cluster.bandwidth += thread->GetMemoryBandwidth();
+    }
+  }
+  for (size_t i = 0; i < cpu_clusters_.size(); i++)
+    (*clusters)[cpu_clusters_[i]].cpu_threads++;
+}
+
+void Sat::ClusterStats() {
+  if (clusters_.empty())
+    return;
+  vector<struct ReportCluster> clusters;
+  FillClusters(true, 1., &clusters);
+  for (size_t c = 0; c < clusters.size(); c++) {
+    logprintf(4, "Stats: Cluster %s (cpus %s): Memory Copy: %.2fM at "
+              "%.2fMB/s, %d copy and %d cpu threads, %lld/%lld/%lldMHz "
+              "mean/min/peak of %lldMHz\n", clusters[c].name.c_str(),
+              clusters[c].cpus.c_str(), clusters[c].data,
+              clusters[c].bandwidth, clusters[c].copy_threads,
+              clusters[c].cpu_threads, clusters[c].mean_khz / 1000,
+              clusters[c].min_khz / 1000, clusters[c].peak_khz / 1000,
+              clusters[c].max_khz / 1000);
+  }
+}
+
 void Sat::RunAnalysis() {
   AnalysisAllStats();
   MemoryStats();
@@ -1775,7 +3980,17 @@ void Sat::RunAnalysis() {
   NetStats();
   CheckStats();
   InvertStats();
+  ChannelStats();
   DiskStats();
+  LatencyStats();
+  TlbStats();
+  MarchStats();
+  RegionStats();
+  PowerWaveStats();
+  NetCoordinatorStats();
+  CcPairStats();
+  ClusterStats();
+  PowerStats();
 }
 
 // Get total error count, summing across all threads..
@@ -1797,7 +4012,8 @@ int64 Sat::GetTotalErrorCount() {
 
 void Sat::SpawnThreads() {
   logprintf(12, "Log: Initializing WorkerStatus objects\n");
-  power_spike_status_.Initialize();
+  for (int i = 0; i < kPauseGroupCount; i++)
+    power_spike_status_[i].Initialize();
   continuous_status_.Initialize();
   logprintf(12, "Log: Spawning worker threads\n");
   for (WorkerMap::const_iterator map_it = workers_map_.begin();
@@ -1810,9 +4026,30 @@ void Sat::SpawnThreads() {
   }
 }
 
+void Sat::PauseWorkers() {
+  for (int i = 0; i < kPauseGroupCount; i++) {
+    if (pause_groups_ & (1 << i))
+      power_spike_status_[i].PauseWorkers();
+  }
+}
+
+void Sat::ResumeWorkers() {
+  for (int i = 0; i < kPauseGroupCount; i++) {
+    if (pause_groups_ & (1 << i))
+      power_spike_status_[i].ResumeWorkers();
+  }
+}
+
 // Delete used worker thread objects.
 void Sat::DeleteThreads() {
   logprintf(12, "Log: Deleting worker threads\n");
+  // LiveTotals() may be looking at the workers from another thread.
+  AcquireWorkerLock();
+  if (!workers_map_.empty()) {
+    map<string, struct CheckpointCounts> types;
+    CollectTypeCounts(&types);
+    SumTypeCounts(types, &final_totals_);
+  }
   for (WorkerMap::const_iterator map_it = workers_map_.begin();
        map_it != workers_map_.end(); ++map_it) {
     for (WorkerVector::const_iterator it = map_it->second->begin();
@@ -1823,8 +4060,13 @@ void Sat::DeleteThreads() {
     delete map_it->second;
   }
   workers_map_.clear();
+  ReleaseWorkerLock();
+  for (size_t i = 0; i < rate_limiters_.size(); i++)
+    delete rate_limiters_[i];
+  rate_limiters_.clear();
   logprintf(12, "Log: Destroying WorkerStatus objects\n");
-  power_spike_status_.Destroy();
+  for (int i = 0; i < kPauseGroupCount; i++)
+    power_spike_status_[i].Destroy();
   continuous_status_.Destroy();
 }
 
@@ -1846,6 +4088,103 @@ inline time_t NextOccurance(time_t frequency, time_t start, time_t now) {
 }
 }
 
+// Add the shard number to a file name, so the shards don't share the file.
+static void ShardFileName(char *name, size_t size, int shard) {
+  if (!name[0])
+    return;
+  size_t len = strlen(name);
+  snprintf(name + len, size - len, ".shard%d", shard);
+}
+
+int Sat::RunShards() {
+  if (!numa_shards_)
+    return -1;
+  if (!shards_.FindNodes() || shards_.shards() < 2) {
+    logprintf(5, "Log: Less than two NUMA nodes, running as one process.\n");
+    return -1;
+  }
+
+  logprintf(5, "Log: Starting %d NUMA shards.\n", shards_.shards());
+  int shard;
+  if (!shards_.Spawn(&shard)) {
+    bad_status();
+    return 1;
+  }
+  if (shard < 0)
+    return shards_.Wait();
+
+  shard_ = shard;
+  shards_.Bind(shard_);
+  // Forked shards would otherwise pick the same patterns and pages. Shard
+  // 0 keeps the default seed.
+  srandom(shard_ + 1);
+  Prng::SetMasterSeed(seed_ + shard_);
+  ShardFileName(logfilename_, sizeof(logfilename_), shard_);
+  ShardFileName(binary_error_log_, sizeof(binary_error_log_), shard_);
+  ShardFileName(checkpoint_file_, sizeof(checkpoint_file_), shard_);
+  // Devices and system errors are the same for every shard, only the first
+  // one tests and polls them.
+  if (shard_ > 0) {
+    file_threads_ = 0;
+    filename_.clear();
+    findfiles_ = false;
+    disk_discover_ = false;
+    disk_threads_ = 0;
+    random_threads_ = 0;
+    diskfilename_.clear();
+    net_threads_ = 0;
+    listen_threads_ = 0;
+    ipaddrs_.clear();
+    net_coordinator_hosts_ = 0;
+    net_register_[0] = '\0';
+    for (size_t i = 0; i < regions_.size(); i++)
+      delete regions_[i];
+    regions_.clear();
+    error_poll_ = false;
+  }
+  return -1;
+}
+
+int Sat::RunScrubber() {
+  if (!scrub_mb_)
+    return -1;
+  if (!scrubber_.Throttle(scrub_cgroup_) || !scrubber_.Setup()) {
+    bad_status();
+    return 1;
+  }
+
+  logprintf(5, "Log: Scrubbing %dMB windows for %d seconds each, %d "
+            "seconds apart.\n", scrub_mb_, scrub_slice_seconds_,
+            scrub_pause_seconds_);
+  const time_t end = time(NULL) + runtime_seconds_;
+  while (!scrubber_.stopped()) {
+    time_t remaining = end - time(NULL);
+    if (remaining <= 0)
+      break;
+    int slice;
+    if (!scrubber_.Spawn(&slice)) {
+      bad_status();
+      break;
+    }
+    if (slice >= 0) {
+      scrub_slice_ = slice;
+      size_mb_ = scrub_mb_;
+      runtime_seconds_ = static_cast<int>(
+          min(static_cast<time_t>(scrub_slice_seconds_), remaining));
+      // Vary the patterns and page choices from slice to slice.
+      srandom(seed_ + scrub_slice_ + 1);
+      Prng::SetMasterSeed(seed_ + scrub_slice_);
+      return -1;
+    }
+    scrubber_.WaitSlice();
+    if (end - time(NULL) <= scrub_pause_seconds_)
+      break;
+    if (!scrubber_.Pause(scrub_pause_seconds_))
+      break;
+  }
+  return scrubber_.Finish();
+}
+
 // Run the actual test.
 bool Sat::Run() {
   // Install signal handlers to gracefully exit in the middle of a run.
@@ -1867,6 +4206,11 @@ bool Sat::Run() {
   // be called in the same thread that reads the "volatile sig_atomic_t"
   // variable it sets.  We enforce that by blocking the signals in question in
   // the worker threads, forcing them to be handled by this thread.
+  // Coordinated hosts get their peers once they are ready to run, so that
+  // they all start streaming together.
+  if (net_register_[0] && !JoinNetCoordinator())
+    return false;
+
   logprintf(12, "Log: Installing signal handlers\n");
   sigset_t new_blocked_signals;
   sigemptyset(&new_blocked_signals);
@@ -1874,8 +4218,13 @@ bool Sat::Run() {
   sigaddset(&new_blocked_signals, SIGTERM);
   sigset_t prev_blocked_signals;
   pthread_sigmask(SIG_BLOCK, &new_blocked_signals, &prev_blocked_signals);
-  sighandler_t prev_sigint_handler = signal(SIGINT, SatHandleBreak);
-  sighandler_t prev_sigterm_handler = signal(SIGTERM, SatHandleBreak);
+  // An embedded run leaves the host's handlers in place.
+  sighandler_t prev_sigint_handler = NULL;
+  sighandler_t prev_sigterm_handler = NULL;
+  if (!embedded_) {
+    prev_sigint_handler = signal(SIGINT, SatHandleBreak);
+    prev_sigterm_handler = signal(SIGTERM, SatHandleBreak);
+  }
 
   // Kick off all the worker threads.
   logprintf(12, "Log: Launching worker threads\n");
@@ -1886,7 +4235,8 @@ bool Sat::Run() {
   logprintf(12, "Log: Starting countdown with %d seconds\n", runtime_seconds_);
 
   // In seconds.
-  static const time_t kSleepFrequency = 5;
+  // Embedded runs check for control requests more often.
+  const time_t kSleepFrequency = embedded_ ? 1 : 5;
   // All of these are in seconds.  You probably want them to be >=
   // kSleepFrequency and multiples of kSleepFrequency, but neither is necessary.
   static const time_t kInjectionFrequency = 10;
@@ -1904,6 +4254,48 @@ bool Sat::Run() {
   } else {
     next_injection = 0;
   }
+  time_t next_telemetry = 0;
+  if (telemetry_.enabled()) {
+    TelemetryReport(false);
+    next_telemetry = start + telemetry_interval_;
+  }
+  time_t next_checkpoint = 0;
+  if (checkpoint_file_[0])
+    next_checkpoint = start + checkpoint_interval_;
+  report_start_us_ = sat_get_time_us();
+  time_t next_report = 0;
+  if (report_file_[0])
+    next_report = start + report_interval_;
+  time_t next_coverage = 0;
+  time_t coverage_start = start;
+  if (coverage_window_)
+    next_coverage = start + coverage_window_;
+  // Cleared if the run is cut short and should be resumed later.
+  bool finished = true;
+  bool user_paused = false;
+  time_t next_autotune = 0;
+  if (autotune_seconds_) {
+    int step = AutotuneStart();
+    if (step)
+      next_autotune = start + step;
+  }
+  time_t next_disk_balance = 0;
+  if (disk_balance_seconds_ && disk_orchestrator_.Start())
+    next_disk_balance = start + disk_balance_seconds_;
+  channel_start_us_ = sat_get_time_us();
+  if (channel_map_.enabled() && finelock_q_)
+    finelock_q_->ResetChannelTraffic();
+  time_t next_channel = 0;
+  int active_channel = 0;
+  time_t next_cluster = 0;
+  if (!clusters_.empty()) {
+    SampleClusters();
+    next_cluster = start + 1;
+  }
+  if (channel_schedule_ == FineLockPEQueue::kChannelSweep) {
+    logprintf(5, "Log: Scheduling channel %d\n", active_channel);
+    next_channel = start + channel_sweep_seconds_;
+  }
 
   while (now < end) {
     // This is an int because it's for logprintf().
@@ -1913,6 +4305,7 @@ bool Sat::Run() {
       // Handle early exit.
       logprintf(0, "Log: User exiting early (%d seconds remaining)\n",
                 seconds_remaining);
+      finished = false;
       break;
     }
 
@@ -1934,6 +4327,49 @@ bool Sat::Run() {
       next_print = NextOccurance(print_delay_, start, now);
     }
 
+    if (next_telemetry && now >= next_telemetry) {
+      TelemetryReport(false);
+      next_telemetry = NextOccurance(telemetry_interval_, start, now);
+    }
+
+    if (next_checkpoint && now >= next_checkpoint) {
+      WriteCheckpoint(now - start);
+      next_checkpoint = NextOccurance(checkpoint_interval_, start, now);
+    }
+
+    if (next_report && now >= next_report) {
+      WriteReport(false);
+      next_report = NextOccurance(report_interval_, start, now);
+    }
+
+    if (next_coverage && now >= next_coverage) {
+      CoverageReport(now - coverage_start);
+      coverage_start = now;
+      next_coverage = NextOccurance(coverage_window_, start, now);
+    }
+
+    if (next_autotune && now >= next_autotune) {
+      int step = AutotuneStep();
+      next_autotune = step ? now + step : 0;
+    }
+
+    if (next_disk_balance && now >= next_disk_balance) {
+      disk_orchestrator_.Step();
+      next_disk_balance = NextOccurance(disk_balance_seconds_, start, now);
+    }
+
+    if (next_channel && now >= next_channel) {
+      active_channel = (active_channel + 1) % channel_map_.channels();
+      logprintf(5, "Log: Scheduling channel %d\n", active_channel);
+      finelock_q_->set_active_channel(active_channel);
+      next_channel = NextOccurance(channel_sweep_seconds_, start, now);
+    }
+
+    if (next_cluster && now >= next_cluster) {
+      SampleClusters();
+      next_cluster = now + 1;
+    }
+
     if (next_injection && now >= next_injection) {
       // Inject an error.
       logprintf(4, "Log: Injecting error (%d seconds remaining)\n",
@@ -1945,51 +4381,422 @@ bool Sat::Run() {
       next_injection = NextOccurance(kInjectionFrequency, start, now);
     }
 
-    if (next_pause && now >= next_pause) {
+    if (pause_requested_ != user_paused) {
+      user_paused = pause_requested_;
+      logprintf(4, "Log: %s worker threads on request (%d seconds "
+                "remaining)\n", user_paused ? "Pausing" : "Resuming",
+                seconds_remaining);
+      for (int i = 0; i < kPauseGroupCount; i++) {
+        if (user_paused)
+          power_spike_status_[i].PauseWorkers();
+        else
+          power_spike_status_[i].ResumeWorkers();
+      }
+    }
+
+    // Power spikes wait while paused on request.
+    if (!user_paused && next_pause && now >= next_pause) {
       // Tell worker threads to pause in preparation for a power spike.
       logprintf(4, "Log: Pausing worker threads in preparation for power spike "
                 "(%d seconds remaining)\n", seconds_remaining);
-      power_spike_status_.PauseWorkers();
+      PauseWorkers();
       logprintf(12, "Log: Worker threads paused\n");
       next_pause = 0;
       next_resume = now + pause_duration_;
     }
 
-    if (next_resume && now >= next_resume) {
+    if (!user_paused && next_resume && now >= next_resume) {
       // Tell worker threads to resume in order to cause a power spike.
       logprintf(4, "Log: Resuming worker threads to cause a power spike (%d "
                 "seconds remaining)\n", seconds_remaining);
-      power_spike_status_.ResumeWorkers();
+      ResumeWorkers();
       logprintf(12, "Log: Worker threads resumed\n");
       next_pause = NextOccurance(pause_delay_, start, now);
       next_resume = 0;
     }
 
-    sat_sleep(NextOccurance(kSleepFrequency, start, now) - now);
+    time_t next_wakeup = NextOccurance(kSleepFrequency, start, now);
+    if (next_telemetry && next_telemetry < next_wakeup)
+      next_wakeup = next_telemetry;
+    if (next_autotune && next_autotune < next_wakeup)
+      next_wakeup = next_autotune;
+    if (next_disk_balance && next_disk_balance < next_wakeup)
+      next_wakeup = next_disk_balance;
+    if (next_checkpoint && next_checkpoint < next_wakeup)
+      next_wakeup = next_checkpoint;
+    if (next_report && next_report < next_wakeup)
+      next_wakeup = next_report;
+    if (next_coverage && next_coverage < next_wakeup)
+      next_wakeup = next_coverage;
+    if (next_cluster && next_cluster < next_wakeup)
+      next_wakeup = next_cluster;
+    // Runs shorter than the sleep period stop on time.
+    if (end < next_wakeup)
+      next_wakeup = end;
+    sat_sleep(next_wakeup - now);
     now = time(NULL);
   }
 
+  // The last window may be cut short. Reads while the threads drain their
+  // pages don't count.
+  if (next_coverage && now > coverage_start)
+    CoverageReport(now - coverage_start);
+
   JoinThreads();
 
+  if (checkpoint_file_[0]) {
+    if (finished) {
+      // A later run with the same arguments starts over.
+      unlink(checkpoint_file_);
+    } else {
+      WriteCheckpoint(time(NULL) - start);
+    }
+  }
+  errorcount_ += resumed_.errors;
+  statuscount_ += resumed_.status;
+
+  if (net_client_.joined())
+    ReportNetCoordinator();
+
+  if (telemetry_.enabled())
+    TelemetryReport(true);
+
   logprintf(0, "Stats: Found %lld hardware incidents\n", errorcount_);
 
   if (!monitor_mode_)
     RunAnalysis();
 
+  if (report_file_[0])
+    WriteReport(true);
+
   DeleteThreads();
 
-  logprintf(12, "Log: Uninstalling signal handlers\n");
-  signal(SIGINT, prev_sigint_handler);
-  signal(SIGTERM, prev_sigterm_handler);
+  if (!embedded_) {
+    logprintf(12, "Log: Uninstalling signal handlers\n");
+    signal(SIGINT, prev_sigint_handler);
+    signal(SIGTERM, prev_sigterm_handler);
+  }
 
   return true;
 }
 
+void Sat::AutotuneSetActive(int count) {
+  WorkerVector *memory = workers_map_[kMemoryType];
+  for (int i = 0; i < static_cast<int>(memory->size()); i++)
+    (*memory)[i]->set_parked(i >= count);
+}
+
+float Sat::AutotuneBandwidth() {
+  WorkerVector *memory = workers_map_[kMemoryType];
+  float data = 0.;
+  for (WorkerVector::const_iterator it = memory->begin();
+       it != memory->end(); ++it)
+    data += (*it)->GetMemoryCopiedData();
+  int64 now_us = sat_get_time_us();
+  float mbps = 0.;
+  if (now_us > autotune_last_us_)
+    mbps = (data - autotune_last_data_) * 1e6 / (now_us - autotune_last_us_);
+  autotune_last_data_ = data;
+  autotune_last_us_ = now_us;
+  return mbps;
+}
+
+// Ramp the memory copy threads up in powers of two to the -m count, and
+// keep the count that moved the most data.
+int Sat::AutotuneStart() {
+  int threads = workers_map_[kMemoryType]->size();
+  if (threads < 2) {
+    logprintf(5, "Log: Autotune needs at least two memory copy threads, "
+              "not tuning\n");
+    return 0;
+  }
+  autotune_counts_.clear();
+  autotune_mbps_.clear();
+  for (int count = 1; count < threads; count *= 2)
+    autotune_counts_.push_back(count);
+  autotune_counts_.push_back(threads);
+  autotune_step_ = 0;
+  autotune_step_seconds_ = autotune_seconds_ / autotune_counts_.size();
+  if (autotune_step_seconds_ < 1)
+    autotune_step_seconds_ = 1;
+
+  logprintf(5, "Log: Autotuning %d memory copy threads for %d seconds per "
+            "step\n", threads, autotune_step_seconds_);
+  AutotuneSetActive(autotune_counts_[0]);
+  AutotuneBandwidth();
+  return autotune_step_seconds_;
+}
+
+int Sat::AutotuneStep() {
+  int count = autotune_counts_[autotune_step_];
+  float mbps = AutotuneBandwidth();
+  bool hot = false;
+  int64 temp = autotune_max_temp_ ? os_->MaxTemperature() : -1;
+  if (autotune_max_temp_ && temp >= autotune_max_temp_ * 1000LL) {
+    logprintf(5, "Log: Autotune: %d memory copy threads reached %lld "
+              "millidegrees C\n", count, temp);
+    hot = true;
+  } else {
+    logprintf(5, "Log: Autotune: %d memory copy threads, %.2fMB/s\n",
+              count, mbps);
+    autotune_mbps_.push_back(mbps);
+    if (++autotune_step_ < static_cast<int>(autotune_counts_.size())) {
+      AutotuneSetActive(autotune_counts_[autotune_step_]);
+      AutotuneBandwidth();
+      return autotune_step_seconds_;
+    }
+  }
+
+  // Settle on the best count that stayed within the thermal limit.
+  int best = 0;
+  for (int i = 1; i < static_cast<int>(autotune_mbps_.size()); i++) {
+    if (autotune_mbps_[i] > autotune_mbps_[best])
+      best = i;
+  }
+  count = autotune_counts_[best];
+  AutotuneSetActive(count);
+  if (autotune_mbps_.empty()) {
+    logprintf(4, "Log: Autotune settled on %d memory copy threads, "
+              "too hot to measure\n", count);
+  } else {
+    logprintf(4, "Log: Autotune settled on %d memory copy threads at "
+              "%.2fMB/s%s\n", count, autotune_mbps_[best],
+              hot ? ", limited by temperature" : "");
+  }
+  return 0;
+}
+
+void Sat::ResumeCheckpoint() {
+  uint64 config = 14695981039346656037ULL;  // FNV-1a of the command line.
+  for (size_t i = 0; i < cmdline_.size(); i++)
+    config = (config ^ static_cast<unsigned char>(cmdline_[i])) *
+             1099511628211ULL;
+
+  struct CheckpointState state;
+  if (!LoadCheckpoint(checkpoint_file_, &state)) {
+    if (access(checkpoint_file_, F_OK) == 0)
+      logprintf(0, "Log: Ignoring unreadable checkpoint %s\n",
+                checkpoint_file_);
+    resumed_.config = config;
+    return;
+  }
+  if (state.config != config) {
+    logprintf(0, "Log: Ignoring checkpoint %s of a different command "
+              "line\n", checkpoint_file_);
+    resumed_.config = config;
+    return;
+  }
+
+  resumed_ = state;
+  os_->error_diagnoser_->RestoreErrors(resumed_.devices);
+  int remaining = runtime_seconds_ - resumed_.elapsed;
+  if (remaining < 0)
+    remaining = 0;
+  logprintf(0, "Log: Resuming from checkpoint %s after %d runs, %lld "
+            "seconds and %lld hardware incidents, %d seconds left\n",
+            checkpoint_file_, resumed_.runs, resumed_.elapsed,
+            resumed_.errors, remaining);
+  runtime_seconds_ = remaining;
+}
+
+void Sat::CollectTypeCounts(map<string, struct CheckpointCounts> *types) {
+  for (WorkerMap::const_iterator map_it = workers_map_.begin();
+       map_it != workers_map_.end(); ++map_it) {
+    if (map_it->second->empty())
+      continue;
+    struct CheckpointCounts *counts =
+        &(*types)[ThreadTypeName(map_it->first)];
+    for (WorkerVector::const_iterator it = map_it->second->begin();
+         it != map_it->second->end(); ++it) {
+      counts->pages += (*it)->GetPageCount();
+      counts->errors += (*it)->GetErrorCount();
+      counts->data += (*it)->GetMemoryCopiedData();
+      counts->data += (*it)->GetDeviceCopiedData();
+    }
+  }
+}
+
+void Sat::LiveTotals(struct CheckpointCounts *totals) {
+  map<string, struct CheckpointCounts> types;
+  AcquireWorkerLock();
+  if (workers_map_.empty()) {
+    *totals = final_totals_;
+    ReleaseWorkerLock();
+    return;
+  }
+  CollectTypeCounts(&types);
+  ReleaseWorkerLock();
+  totals->pages = 0;
+  totals->errors = 0;
+  totals->data = 0.;
+  SumTypeCounts(types, totals);
+}
+
+void Sat::WriteCheckpoint(int64 elapsed) {
+  struct CheckpointState state = resumed_;
+  state.elapsed += elapsed;
+  state.runs++;
+  state.status += statuscount_;
+
+  map<string, struct CheckpointCounts> types;
+  AcquireWorkerLock();
+  CollectTypeCounts(&types);
+  ReleaseWorkerLock();
+  for (map<string, struct CheckpointCounts>::const_iterator it =
+           types.begin(); it != types.end(); ++it) {
+    struct CheckpointCounts *counts = &state.types[it->first];
+    counts->pages += it->second.pages;
+    counts->errors += it->second.errors;
+    counts->data += it->second.data;
+    state.errors += it->second.errors;
+  }
+  // The diagnoser already holds the restored errors.
+  state.devices.clear();
+  os_->error_diagnoser_->CollectErrors(&state.devices);
+
+  if (!SaveCheckpoint(checkpoint_file_, state)) {
+    int err = errno;
+    logprintf(0, "Log: Failed to write checkpoint %s: %s\n",
+              checkpoint_file_, ErrorString(err).c_str());
+    return;
+  }
+  logprintf(12, "Log: Wrote checkpoint %s\n", checkpoint_file_);
+}
+
+void Sat::FillReport(bool final, struct RunReport *report) {
+  int64 now_us = sat_get_time_us();
+  report->final = final;
+  report->time = time(NULL);
+  report->elapsed = report_start_us_ ?
+                    (now_us - report_start_us_) / 1000000. : 0.;
+  report->cmdline = cmdline_;
+  report->version = kVersion;
+  report->seed = seed_;
+  report->runtime_seconds = runtime_seconds_;
+  report->memory_mb = size_mb_;
+  report->page_length = page_length_;
+  report->errors = final ? errorcount_ : GetTotalErrorCount();
+  report->status_errors = statuscount_;
+  if (!final)
+    report->status = "RUNNING";
+  else if (statuscount_ || errorcount_)
+    report->status = "FAIL";
+  else
+    report->status = "PASS";
+
+  // Running threads have no run time yet, their bandwidth is over the time
+  // since they started.
+  double seconds = report->elapsed > 0 ? report->elapsed : 1.;
+  AcquireWorkerLock();
+  for (WorkerMap::const_iterator map_it = workers_map_.begin();
+       map_it != workers_map_.end(); ++map_it) {
+    if (map_it->second->empty())
+      continue;
+    struct ReportType type = { 0, 0, 0, 0., 0. };
+    for (WorkerVector::const_iterator it = map_it->second->begin();
+         it != map_it->second->end(); ++it) {
+      double data = (*it)->GetMemoryCopiedData() +
+                    (*it)->GetDeviceCopiedData();
+      type.threads++;
+      type.pages += (*it)->GetPageCount();
+      type.errors += (*it)->GetErrorCount();
+      type.data += data;
+      if (!final)
+        type.bandwidth += data / seconds;
+      else if ((*it)->GetRunDurationUSec() > 0)
+        type.bandwidth += (*it)->GetMemoryBandwidth() +
+                          (*it)->GetDeviceBandwidth();
+    }
+    report->types[ThreadTypeName(map_it->first)] = type;
+  }
+
+  // Traffic per device, over all the threads on it.
+  static const int kDeviceTypes[] = { kFileIOType, kDiskType,
+                                      kRandomDiskType };
+  vector<LatencyHistogram*> latencies;  // Reads and writes of each device.
+  for (size_t t = 0; t < sizeof(kDeviceTypes) / sizeof(kDeviceTypes[0]);
+       t++) {
+    WorkerMap::const_iterator type_it = workers_map_.find(kDeviceTypes[t]);
+    if (type_it == workers_map_.end())
+      continue;
+    bool file = kDeviceTypes[t] == kFileIOType;
+    for (WorkerVector::const_iterator it = type_it->second->begin();
+         it != type_it->second->end(); ++it) {
+      FileThread *file_thread = file ? static_cast<FileThread*>(*it) : NULL;
+      DiskThread *disk_thread = file ? NULL : static_cast<DiskThread*>(*it);
+      const string &name = file ? file_thread->device_name() :
+                                  disk_thread->device_name();
+      size_t d = 0;
+      while (d < report->devices.size() &&
+             !(report->devices[d].name == name &&
+               (report->devices[d].kind == "file") == file))
+        d++;
+      if (d == report->devices.size()) {
+        struct ReportDevice device;
+        device.kind = file ? "file" : "disk";
+        device.name = name;
+        device.data = 0.;
+        device.bandwidth = 0.;
+        report->devices.push_back(device);
+        latencies.push_back(new LatencyHistogram());
+        latencies.push_back(new LatencyHistogram());
+      }
+      double data = (*it)->GetDeviceCopiedData();
+      report->devices[d].data += data;
+      if (!final)
+        report->devices[d].bandwidth += data / seconds;
+      else if ((*it)->GetRunDurationUSec() > 0)
+        report->devices[d].bandwidth += (*it)->GetDeviceBandwidth();
+      latencies[2 * d]->Add(file ? file_thread->read_latency() :
+                                   disk_thread->read_latency());
+      latencies[2 * d + 1]->Add(file ? file_thread->write_latency() :
+                                       disk_thread->write_latency());
+    }
+  }
+  for (size_t d = 0; d < report->devices.size(); d++) {
+    ReportLatencyOf(*latencies[2 * d], &report->devices[d].reads);
+    ReportLatencyOf(*latencies[2 * d + 1], &report->devices[d].writes);
+    delete latencies[2 * d];
+    delete latencies[2 * d + 1];
+  }
+  if (!clusters_.empty())
+    FillClusters(final, seconds, &report->clusters);
+  ReleaseWorkerLock();
+
+  os_->error_diagnoser_->CollectErrors(&report->hardware);
+}
+
+void Sat::WriteReport(bool final) {
+  struct RunReport report;
+  FillReport(final, &report);
+  if (!SaveReport(report_file_, report)) {
+    int err = errno;
+    logprintf(0, "Log: Failed to write report %s: %s\n",
+              report_file_, ErrorString(err).c_str());
+    return;
+  }
+  logprintf(12, "Log: Wrote report %s\n", report_file_);
+}
+
 // Clean up all resources.
 bool Sat::Cleanup() {
+  if (shard_ >= 0 || scrub_slice_ >= 0) {
+    struct CheckpointCounts totals;
+    LiveTotals(&totals);
+    struct ShardResult result;
+    result.pages = totals.pages;
+    result.errors = errorcount_;
+    result.status = statuscount_;
+    result.data = totals.data;
+    if (shard_ >= 0)
+      shards_.Report(result);
+    else
+      scrubber_.Report(result);
+  }
   g_sat = NULL;
   Logger::GlobalLogger()->StopThread();
   Logger::GlobalLogger()->SetStdoutOnly();
+  error_log_.Close();
   if (logfile_) {
     close(logfile_);
     logfile_ = 0;
@@ -1999,6 +4806,9 @@ bool Sat::Cleanup() {
     delete patternlist_;
     patternlist_ = 0;
   }
+  for (size_t i = 0; i < regions_.size(); i++)
+    delete regions_[i];
+  regions_.clear();
   if (os_) {
     os_->FreeTestMem();
     delete os_;
@@ -2016,27 +4826,45 @@ bool Sat::Cleanup() {
     delete finelock_q_;
     finelock_q_ = 0;
   }
+  if (sharded_q_) {
+    delete sharded_q_;
+    sharded_q_ = 0;
+  }
+  if (split_q_) {
+    delete split_q_;
+    split_q_ = 0;
+  }
   if (page_bitmap_) {
     delete[] page_bitmap_;
   }
+  if (coverage_bitmap_) {
+    delete[] coverage_bitmap_;
+    coverage_bitmap_ = 0;
+  }
 
   for (size_t i = 0; i < blocktables_.size(); i++) {
     delete blocktables_[i];
   }
 
   if (cc_cacheline_data_) {
-    // The num integer arrays for all the cacheline structures are
-    // allocated as a single chunk. The pointers in the cacheline struct
-    // are populated accordingly. Hence calling free on the first
-    // cacheline's num's address is going to free the entire array.
+    // The num arrays for all the cacheline structures, and the pair mode
+    // line, are in the one mapping from OsLayer::AllocatePinnedMem(), which
+    // outlives os_.
     // TODO(aganti): Refactor this to have a class for the cacheline
     // structure (currently defined in worker.h) and clean this up
     // in the destructor of that class.
-    if (cc_cacheline_data_[0].num) {
-      free(cc_cacheline_data_[0].num);
-    }
+    if (cc_line_mem_)
+      munmap(cc_line_mem_, cc_line_mem_length_);
+    cc_line_mem_ = NULL;
     free(cc_cacheline_data_);
   }
+  if (cc_pair_schedule_.pairs) {
+    delete[] cc_pair_schedule_.first;
+    delete[] cc_pair_schedule_.second;
+    delete[] cc_pair_schedule_.transfers;
+    delete[] cc_pair_schedule_.ns;
+    memset(&cc_pair_schedule_, 0, sizeof(cc_pair_schedule_));
+  }
 
   sat_assert(0 == pthread_mutex_destroy(&worker_lock_));
 
@@ -25,9 +25,26 @@
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
+#include "checkpoint.h"
+#include "cpu_topology.h"
+#include "disk_orchestrator.h"
+#include "dram_map.h"
+#include "error_log.h"
 #include "finelock_queue.h"
+#include "io_buffers.h"
+#include "march.h"
+#include "net_coordinator.h"
+#include "net_rdma.h"
+#include "power_wave.h"
 #include "queue.h"
+#include "region_source.h"
+#include "report.h"
+#include "sharded_queue.h"
+#include "split_queue.h"
 #include "sattypes.h"
+#include "scrub.h"
+#include "shard.h"
+#include "telemetry.h"
 #include "worker.h"
 #include "os.h"
 
@@ -35,7 +52,7 @@
 class Sat {
  public:
   // Enum for page queue implementation switch.
-  enum PageQueueType { SAT_ONELOCK, SAT_FINELOCK };
+  enum PageQueueType { SAT_ONELOCK, SAT_FINELOCK, SAT_SHARDED, SAT_SPLIT };
 
   Sat();
   virtual ~Sat();
@@ -48,6 +65,17 @@ class Sat {
   // Called after ParseArgs().
   bool Initialize();
 
+  // With --numa_shards, fork one process per NUMA node after ParseArgs().
+  // Returns the exit status in the supervisor, which is done once all
+  // shards are, or -1 in each shard and when not sharding, where the run
+  // goes on as usual.
+  int RunShards();
+
+  // With --scrub, test the memory in small windows, one forked process
+  // per window, until the run time is up. Returns the exit status in the
+  // supervisor, or -1 in each slice and when not scrubbing.
+  int RunScrubber();
+
   // Execute the test. Initialize() and ParseArgs() must be called first.
   // This must be called from a single-threaded program.
   bool Run();
@@ -67,9 +95,21 @@ class Sat {
   // Called last.
   bool Cleanup();
 
-  // Abort Run().  Only for use by Run()-installed signal handlers.
+  // Abort Run().  Only for use by Run()-installed signal handlers, or by
+  // another thread of an embedded run.
   void Break() { user_break_ = true; }
 
+  // Run inside a host process: ParseArgs() fails rather than exits on
+  // unknown flags, and Run() leaves SIGINT and SIGTERM alone and checks
+  // Break() and RequestPause() every second.  Set before ParseArgs().
+  void set_embedded(bool embedded) { embedded_ = embedded; }
+  // Ask Run() to pause or resume all worker threads.  The run time keeps
+  // counting while paused.
+  void RequestPause(bool pause) { pause_requested_ = pause; }
+  // Running totals of all workers, or the final ones once Run() is done.
+  // Safe to call from any thread.
+  void LiveTotals(struct CheckpointCounts *totals);
+
   // Fetch and return empty and full pages into the empty and full pools.
   bool GetValid(struct page_entry *pe);
   bool PutValid(struct page_entry *pe);
@@ -77,20 +117,44 @@ class Sat {
   bool PutEmpty(struct page_entry *pe);
 
   bool GetValid(struct page_entry *pe, int32 tag);
+  // Claim the valid page at 'index' for checking, if it's free.
+  bool ClaimValid(int64 index, struct page_entry *pe) {
+    return ClaimPage(index, true, kDontCareTag, pe);
+  }
   bool GetEmpty(struct page_entry *pe, int32 tag);
 
+  // Fetch up to 'count' pages that follow each other in the test memory
+  // into 'pes', the first one as GetValid() or GetEmpty() would. Returns
+  // the number of pages, 0 on failure. Each page is put back on its own.
+  int GetValidSpan(struct page_entry *pes, int count, int32 tag);
+  int GetEmptySpan(struct page_entry *pes, int count, int32 tag);
+
   // Accessor functions.
   int verbosity() const { return verbosity_; }
   int logfile() const { return logfile_; }
   int page_length() const { return page_length_; }
+  int copy_span_pages() const { return copy_span_pages_; }
+  const DramMap &dram_map() const { return dram_map_; }
+  // Pinned, aligned buffers for the I/O threads.
+  IoBufferPool *io_buffers() { return &io_buffers_; }
+  int rowhammer_count() const { return rowhammer_count_; }
   int disk_pages() const { return disk_pages_; }
   int strict() const { return strict_; }
   int tag_mode() const { return tag_mode_; }
+  bool crc32c_checksum() const { return crc32c_checksum_; }
   int status() const { return statuscount_; }
   void bad_status() { statuscount_++; }
   int errors() const { return errorcount_; }
   int warm() const { return warm_; }
   bool stop_on_error() const { return stop_on_error_; }
+  ErrorLog *error_log() { return &error_log_; }
+  bool net_zerocopy() const { return net_zerocopy_; }
+  int net_event_threads() const { return net_event_threads_; }
+  // Network pages move by RDMA on this device.
+  bool net_rdma() const { return net_rdma_; }
+  RdmaDevice *rdma() { return &rdma_; }
+  // Time the net coordinator told the network threads to start, or 0.
+  int64 net_start_us() const { return net_start_us_; }
   int32 region_mask() const { return region_mask_; }
   // Semi-accessor to find the "nth" region to avoid replicated bit searching..
   int32 region_find(int32 num) const {
@@ -120,6 +184,14 @@ class Sat {
   bool InitializePatterns();
   // Initializes test memory with datapatterns.
   bool InitializePages();
+  // Pin a thread that works through pages from 'first_page', the i-th of
+  // its kind.
+  void PlaceRangeThread(WorkerThread *thread, int i, int64 first_page);
+
+  // Claim the page at 'index' for a span, mapped. Returns false if it isn't
+  // available or valid (or empty) with a matching tag.
+  bool ClaimPage(int64 index, bool valid, int32 tag, struct page_entry *pe);
+  int GetSpan(struct page_entry *pes, int count, int32 tag, bool valid);
 
   // Start up worker threads.
   virtual void InitializeThreads();
@@ -127,6 +199,10 @@ class Sat {
   void SpawnThreads();
   // Reap worker threads.
   void JoinThreads();
+  // Get this host's peers from the net coordinator, and send it the
+  // results of their links once the run is over.
+  bool JoinNetCoordinator();
+  void ReportNetCoordinator();
   // Run bandwidth and error analysis.
   virtual void RunAnalysis();
   // Delete worker threads.
@@ -146,12 +222,16 @@ class Sat {
   // Memory and test configuration.
   int runtime_seconds_;               // Seconds to run.
   int page_length_;                   // Length of each memory block.
+  int64 copy_page_size_;              // Bytes per copy thread span, or 0.
+  int copy_span_pages_;               // Queue pages per copy thread span.
   int64 pages_;                       // Number of memory blocks.
   int64 size_;                        // Size of memory tested, in bytes.
   int64 size_mb_;                     // Size of memory tested, in MB.
   int64 reserve_mb_;                  // Reserve at least this amount of memory
                                       // for the system, in MB.
   int64 min_hugepages_mbytes_;        // Minimum hugepages size.
+  int hugepage_mode_;                 // OsLayer::HugepageMode to allocate by.
+  int64 hugepage_size_mb_;            // Hugetlb page size, 0 for default.
   int64 freepages_;                   // How many invalid pages we need.
   int disk_pages_;                    // Number of pages per temp file.
   uint64 paddr_base_;                 // Physical address base.
@@ -162,10 +242,17 @@ class Sat {
   // Control flags.
   volatile sig_atomic_t user_break_;  // User has signalled early exit.  Used as
                                       // a boolean.
+  bool embedded_;                     // Running inside a host process.
+  volatile bool pause_requested_;     // Hold all workers paused.
+  struct CheckpointCounts final_totals_;  // LiveTotals() after Run().
   int verbosity_;                     // How much to print.
+  uint64 seed_;                       // Master random seed, 0 to pick one.
   int print_delay_;                   // Chatty update frequency.
   int strict_;                        // Check results per transaction.
   int warm_;                          // FPU warms CPU while copying.
+  vector<int> copy_engines_;          // CopyEngine per copy thread, cycled.
+  int prefetch_distance_;             // Prefetch distance of copy engine.
+  vector<int> invert_flushes_;        // InvertFlush per invert thread.
   int address_mode_;                  // 32 or 64 bit binary.
   bool stop_on_error_;                // Exit immendiately on any error.
   bool findfiles_;                    // Autodetect tempfile locations.
@@ -178,6 +265,17 @@ class Sat {
   char logfilename_[255];             // Name of file to log to.
   int logfile_;                       // File handle to log to.
   bool log_timestamps_;               // Whether to add timestamps to log lines.
+  char binary_error_log_[255];        // Name of binary error log file.
+  ErrorLog error_log_;                // Binary miscompare records.
+  char telemetry_target_[255];        // File or unix socket for telemetry.
+  int telemetry_interval_;            // Seconds between telemetry lines.
+  Telemetry telemetry_;               // Interval throughput reports.
+  char checkpoint_file_[255];         // Run state for resuming, or empty.
+  int checkpoint_interval_;           // Seconds between checkpoints.
+  struct CheckpointState resumed_;    // Totals of the runs resumed from.
+  char report_file_[255];             // JSON run report, or empty.
+  int report_interval_;               // Seconds between interval reports.
+  int64 report_start_us_;             // Time the threads started.
 
   // Disk thread options.
   int read_block_size_;               // Size of block to read from disk.
@@ -191,6 +289,13 @@ class Sat {
                                       // take before warning of a slow write.
   int non_destructive_;               // Whether to use non-destructive mode for
                                       // the disk test.
+  int disk_io_engine_;                // DiskThread::IoEngine to use.
+  int disk_queue_depth_;              // io_uring requests in flight per
+                                      // disk thread.
+  bool disk_pipeline_;                // Overlap disk writes and verification.
+  bool disk_discover_;                // Test every unused disk.
+  int disk_balance_seconds_;          // Queue depth balancing step, 0 off.
+  DiskOrchestrator disk_orchestrator_;  // Disk threads grouped by device.
 
   // Generic Options.
   int monitor_mode_;                  // Switch for monitor-only mode SAT.
@@ -199,8 +304,13 @@ class Sat {
                                       // polling threads.
   int tag_mode_;                      // Do tagging of memory and strict
                                       // checking for misplaced cachelines.
+  bool crc32c_checksum_;              // Checksum copies with CRC32C.
 
   bool do_page_map_;                  // Should we print a list of used pages?
+  int coverage_window_;               // Seconds per coverage report, or 0.
+  bool coverage_targeting_;           // Check least recently read pages.
+  uint64 *coverage_bitmap_;           // Pages read in the current window.
+  uint64 coverage_words_;             // Length of coverage_bitmap_.
   unsigned char *page_bitmap_;        // Store bitmap of physical pages seen.
   uint64 page_bitmap_size_;           // Length of physical memory represented.
 
@@ -211,6 +321,10 @@ class Sat {
   int cc_cacheline_size_;             // Size of a cache line.
   int cc_inc_count_;                  // Number of times to increment the shared
                                       // cache lines structure members.
+  bool cc_pairs_;                     // Bounce a line between core pairs.
+  bool cc_line_pairs_;                // Pad lines to adjacent line pairs.
+  int cc_threads_per_line_;           // Counters per line, 0 for all.
+  int cc_node_;                       // NUMA node of the lines, -1 for any.
 
   // Cpu Frequency Options.
   bool cpu_freq_test_;                // Flag to decide whether to start the
@@ -224,11 +338,40 @@ class Sat {
   int file_threads_;                  // Threads of file IO.
   int net_threads_;                   // Threads of network IO.
   int listen_threads_;                // Threads for network IO to connect.
+  bool net_zerocopy_;                 // Send network pages with MSG_ZEROCOPY.
+  int net_event_threads_;             // Threads multiplexing listen
+                                      // connections, 0 for one per socket.
+  bool net_rdma_;                     // Move network pages by RDMA.
+  char net_rdma_device_[256];         // RDMA device, port and gid.
+  RdmaDevice rdma_;                   // Device with the test memory on it.
+  int net_coordinator_hosts_;         // Hosts to coordinate, 0 for none.
+  NetTopology net_topology_;          // How the coordinator pairs them.
+  NetCoordinator net_coordinator_;    // Coordinator side state.
+  char net_register_[256];            // Coordinator to get peers from.
+  NetCoordinatorClient net_client_;   // Host side of the coordination.
+  int64 net_start_us_;                // Assigned start, 0 if not assigned.
   int memory_threads_;                // Threads of memcpy.
+  int autotune_seconds_;              // Warmup tuning memory_threads_.
+  int autotune_max_temp_;             // Don't tune past this many degrees C.
   int invert_threads_;                // Threads of invert.
-  int fill_threads_;                  // Threads of memset.
+  int latency_threads_;               // Threads of pointer chasing.
+  int tlb_threads_;                   // Threads walking small pages.
+  int tlb_mb_;                        // Memory mapped by each of them.
+  int rowhammer_threads_;             // Threads hammering adjacent rows.
+  int rowhammer_count_;               // Reads of each aggressor per row.
+  DramMap dram_map_;                  // Physical address to bank and row.
+  IoBufferPool io_buffers_;           // Buffers of the I/O threads.
+  ChannelMap channel_map_;            // Physical address to channel and rank.
+  int channel_schedule_;              // FineLockPEQueue::ChannelSchedule.
+  int channel_sweep_seconds_;         // Time on each channel of a sweep.
+  int64 channel_start_us_;            // Start of the scheduled run.
+  int march_threads_;                 // Threads running march_test_.
+  MarchTest march_test_;              // March algorithm of those threads.
+  vector<RegionSource*> regions_;     // Devices for memory region threads.
+  int fill_threads_;                  // Threads of memset, 0 for one per cpu.
   int check_threads_;                 // Threads of strcmp.
   int cpu_stress_threads_;            // Threads of CPU stress workload.
+  string cpu_stress_kernel_;          // Kernels of those threads.
   int disk_threads_;                  // Threads of disk test.
   int random_threads_;                // Number of random disk threads.
   int total_threads_;                 // Total threads used.
@@ -238,7 +381,16 @@ class Sat {
   cc_cacheline_data *cc_cacheline_data_;  // The cache line sized datastructure
                                           // used by the ccache threads
                                           // (in worker.h).
+  char *cc_line_mem_;                 // Mapping holding the lines.
+  int64 cc_line_mem_length_;          // Its length.
+  struct cc_pair_schedule cc_pair_schedule_;  // Turns of --cc_pairs.
   vector<string> filename_;           // Filenames for file IO.
+  bool file_uring_;                   // File threads use io_uring.
+  int file_queue_depth_;              // io_uring requests in flight per
+                                      // file thread.
+  int files_per_thread_;              // Files handled by each file thread.
+  map<int, double> rate_limits_;      // MB/s cap per thread type.
+  vector<RateLimiter*> rate_limiters_;  // Shared by the capped threads.
   vector<string> ipaddrs_;            // Addresses for network IO.
   vector<string> diskfilename_;       // Filename for disk IO device.
   // Block table for IO device.
@@ -250,6 +402,26 @@ class Sat {
   int region_mode_;                   // What to do with NUMA hints?
   static const int kLocalNuma = 1;    // Target local memory.
   static const int kRemoteNuma = 2;   // Target remote memory.
+  bool numa_alloc_;                   // Allocate test memory per NUMA node.
+  bool numa_shards_;                  // Run one process per NUMA node.
+  int shard_;                         // This process' shard, or -1.
+  ShardSupervisor shards_;            // The shards and their nodes.
+  int scrub_mb_;                      // Scrub window size, 0 for off.
+  int scrub_slice_seconds_;           // How long each window is tested.
+  int scrub_pause_seconds_;           // Idle time between windows.
+  char scrub_cgroup_[256];            // Cgroup to scrub in, if any.
+  int scrub_slice_;                   // This process' slice, or -1.
+  ScrubSupervisor scrubber_;          // The slices and their coverage.
+  bool topology_placement_;           // Place threads by cache topology.
+  char cluster_placement_[32];        // Copy thread cluster policy, or "".
+  vector<struct CpuCluster> clusters_;  // Cpu clusters, fastest first.
+  vector<int> copy_clusters_;         // Cluster of each copy thread, or -1.
+  vector<int> cpu_clusters_;          // And of each cpu stress thread.
+  // Sampled scaling_cur_freq of each cluster, in kHz.
+  vector<int64> cluster_khz_total_;
+  vector<int64> cluster_khz_min_;
+  vector<int64> cluster_khz_max_;
+  int cluster_khz_samples_;
 
   // Results.
   int64 errorcount_;                  // Total hardware incidents seen.
@@ -269,6 +441,13 @@ class Sat {
     kErrorType = 9,
     kCCType = 10,
     kCPUFreqType = 11,
+    kLatencyType = 12,
+    kRowhammerType = 13,
+    kMarchType = 14,
+    kRegionType = 15,
+    kPowerWaveType = 16,
+    kNetCoordinatorType = 17,
+    kTlbType = 18,
   };
 
   // Helper functions.
@@ -283,8 +462,24 @@ class Sat {
   time_t pause_delay_;
   // The duration of each pause (for power spikes).
   time_t pause_duration_;
-  // For the workers we pause and resume to create power spikes.
-  WorkerStatus power_spike_status_;
+  // Groups of workers that can be paused on their own, so that e.g. only
+  // the disk threads stop for a power spike.
+  enum PauseGroup {
+    kPauseMemory = 0,
+    kPauseFile = 1,
+    kPauseDisk = 2,
+    kPauseCpuFreq = 3,
+    kPauseGroupCount = 4,
+  };
+  static const char *const kPauseGroupNames[kPauseGroupCount];
+  int pause_groups_;                  // Mask of groups paused for spikes.
+  PowerWave power_wave_;              // Load waveform of power wave threads.
+  int power_wave_threads_;            // 0 for one per cpu.
+  // Pause or resume every group in pause_groups_.
+  void PauseWorkers();
+  void ResumeWorkers();
+  // For the workers we pause and resume to create power spikes, per group.
+  WorkerStatus power_spike_status_[kPauseGroupCount];
   // For the workers we never pause.
   WorkerStatus continuous_status_;
 
@@ -298,14 +493,82 @@ class Sat {
   void NetStats();
   void CheckStats();
   void InvertStats();
+  void ChannelStats();
   void DiskStats();
-
+  void LatencyStats();
+  void TlbStats();
+  void MarchStats();
+  void RegionStats();
+  void PowerWaveStats();
+  void NetCoordinatorStats();
+  void CcPairStats();
+  void ClusterStats();
+  void PowerStats();
+  // The cpu frequency thread, or NULL if it isn't running.
+  class CpuFreqThread *FindCpuFreqThread();
+
+  // Channel of the page 'pe', or kMixedChannel if it spans channels.
+  int PageChannel(const struct page_entry &pe);
   void QueueStats();
 
+  // Interval telemetry. Counters of each thread type at the last report.
+  struct TelemetryCounts {
+    int64 pages;
+    int64 errors;
+    float data;                         // In MB.
+  };
+  void TelemetryReport(bool final);
+  map<int, struct TelemetryCounts> telemetry_last_;
+  int64 telemetry_start_us_;            // Time of the first report.
+  int64 telemetry_last_us_;             // Time of the last report.
+
+  // Cluster placement. Cpu of the n-th thread placed by
+  // cluster_placement_, and the cluster it is in.
+  int ClusterCpu(int n, int *cluster);
+  // Take a frequency sample of each cluster.
+  void SampleClusters();
+  // Copy thread traffic and frequency of each cluster.
+  void FillClusters(bool final, double seconds,
+                    vector<struct ReportCluster> *clusters);
+
+  // Fill 'report' with the configuration and the results so far, final
+  // ones once the threads are done.
+  void FillReport(bool final, struct RunReport *report);
+  // Write report_file_.
+  void WriteReport(bool final);
+
+  // Load checkpoint_file_ into resumed_ if it belongs to this command
+  // line, and shorten the run by the time already done.
+  void ResumeCheckpoint();
+  // Save resumed_ plus this run's first 'elapsed' seconds.
+  void WriteCheckpoint(int64 elapsed);
+  // Add the totals of every thread type with workers to 'types'.  Called
+  // with the worker lock held.
+  void CollectTypeCounts(map<string, struct CheckpointCounts> *types);
+
+  // Memory copy thread autotuning. Returns the seconds until the next step,
+  // or 0 once settled.
+  int AutotuneStart();
+  int AutotuneStep();
+  // Run only the first 'count' memory copy threads, park the others.
+  void AutotuneSetActive(int count);
+  // Bandwidth of the memory copy threads since the last call, in MB/s.
+  float AutotuneBandwidth();
+  vector<int> autotune_counts_;         // Copy thread counts to try.
+  vector<float> autotune_mbps_;         // Bandwidth measured with each.
+  int autotune_step_;                   // Count being measured.
+  int autotune_step_seconds_;           // Time spent measuring each count.
+  float autotune_last_data_;            // Copied MB at the last call.
+  int64 autotune_last_us_;              // Time of the last call.
+
   // Physical page use reporting.
   void AddrMapInit();
   void AddrMapUpdate(struct page_entry *pe);
   void AddrMapPrint();
+  // Record that the valid page 'pe' was handed out to be read.
+  void CoverageUpdate(const struct page_entry *pe);
+  // Log and clear the pages read in the last 'seconds'.
+  void CoverageReport(time_t seconds);
 
   // additional memory data from google-specific tests.
   virtual void GoogleMemoryStats(float *memcopy_data,
@@ -313,12 +576,14 @@ class Sat {
 
   virtual void GoogleOsOptions(std::map<std::string, std::string> *options);
 
-  // Page queues, only one of (valid_+empty_) or (finelock_q_) will be used
-  // at a time. A commandline switch controls which queue implementation will
-  // be used.
+  // Page queues, only one of (valid_+empty_), (finelock_q_), (sharded_q_)
+  // or (split_q_) will be used at a time. A commandline switch controls
+  // which queue implementation will be used.
   class PageEntryQueue *valid_;        // Page queue structure, valid pages.
   class PageEntryQueue *empty_;        // Page queue structure, free pages.
   class FineLockPEQueue *finelock_q_;  // Page queue with fine-grain locks
+  class ShardedPEQueue *sharded_q_;    // Lock-free per-cpu sharded queue
+  class SplitPEQueue *split_q_;        // Separate empty and valid lists
   Sat::PageQueueType pe_q_implementation_;   // Queue implementation switch
 
   DISALLOW_COPY_AND_ASSIGN(Sat);
@@ -0,0 +1,279 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// In-process control of a stressapptest run, see sat_api.h.
+
+#include <string.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sat_api.h"
+#include "sat.h"
+#include "logger.h"
+
+namespace {
+// Set while a SatRunner owns the process wide logger and Sat state.
+volatile int g_runner_active = 0;
+}  // namespace
+
+SatRunConfig::SatRunConfig()
+    : seconds(20),
+      memory_mb(0),
+      memory_threads(-1),
+      invert_threads(-1),
+      check_threads(-1),
+      cpu_threads(-1),
+      max_errors(0),
+      verbosity(8),
+      log_stdout(false) {
+}
+
+SatRunner::SatRunner()
+    : sat_(NULL),
+      thread_started_(false),
+      running_(false),
+      paused_(false),
+      result_(1),
+      start_(0),
+      end_(0),
+      cleaned_up_(false),
+      dropped_errors_(0) {
+  memset(&final_, 0, sizeof(final_));
+  pthread_mutex_init(&state_lock_, NULL);
+  pthread_mutex_init(&lock_, NULL);
+}
+
+SatRunner::~SatRunner() {
+  if (thread_started_) {
+    Stop();
+    Wait();
+  }
+  delete sat_;
+  pthread_mutex_destroy(&state_lock_);
+  pthread_mutex_destroy(&lock_);
+}
+
+bool SatRunner::Start(const SatRunConfig &config) {
+  if (thread_started_ ||
+      !__sync_bool_compare_and_swap(&g_runner_active, 0, 1))
+    return false;
+
+  delete sat_;
+  sat_ = NULL;
+  paused_ = false;
+  result_ = 1;
+  start_ = 0;
+  end_ = 0;
+  cleaned_up_ = false;
+  pthread_mutex_lock(&lock_);
+  errors_.clear();
+  dropped_errors_ = 0;
+  pthread_mutex_unlock(&lock_);
+
+  // The same flags as a command line run.
+  vector<string> args;
+  args.push_back("stressapptest");
+  char value[32];
+  snprintf(value, sizeof(value), "%d", config.seconds);
+  args.push_back("-s");
+  args.push_back(value);
+  snprintf(value, sizeof(value), "%d", config.verbosity);
+  args.push_back("-v");
+  args.push_back(value);
+  if (config.memory_mb > 0) {
+    snprintf(value, sizeof(value), "%d", config.memory_mb);
+    args.push_back("-M");
+    args.push_back(value);
+  }
+  if (config.memory_threads >= 0) {
+    snprintf(value, sizeof(value), "%d", config.memory_threads);
+    args.push_back("-m");
+    args.push_back(value);
+  }
+  if (config.invert_threads >= 0) {
+    snprintf(value, sizeof(value), "%d", config.invert_threads);
+    args.push_back("-i");
+    args.push_back(value);
+  }
+  if (config.check_threads >= 0) {
+    snprintf(value, sizeof(value), "%d", config.check_threads);
+    args.push_back("-c");
+    args.push_back(value);
+  }
+  if (config.cpu_threads >= 0) {
+    snprintf(value, sizeof(value), "%d", config.cpu_threads);
+    args.push_back("-C");
+    args.push_back(value);
+  }
+  if (config.max_errors > 0) {
+    snprintf(value, sizeof(value), "%d", config.max_errors);
+    args.push_back("--max_errors");
+    args.push_back(value);
+  }
+  args.insert(args.end(), config.args.begin(), config.args.end());
+  vector<char*> argv;
+  for (size_t i = 0; i < args.size(); i++)
+    argv.push_back(const_cast<char*>(args[i].c_str()));
+  argv.push_back(NULL);
+
+  Logger *logger = Logger::GlobalLogger();
+  logger->SetStdoutEnabled(config.log_stdout);
+  logger->SetLineHandler(HandleLine, this);
+
+  sat_ = SatFactory();
+  if (sat_ == NULL) {
+    logprintf(0, "Process Error: failed to allocate Sat object\n");
+    Finish();
+    return false;
+  }
+  sat_->set_embedded(true);
+  if (!sat_->ParseArgs(argv.size() - 1, &argv[0])) {
+    logprintf(0, "Process Error: Sat::ParseArgs() failed\n");
+    Finish();
+    return false;
+  }
+  if (!sat_->Initialize()) {
+    logprintf(0, "Process Error: Sat::Initialize() failed\n");
+    sat_->Cleanup();
+    Finish();
+    return false;
+  }
+
+  start_ = time(NULL);
+  running_ = true;
+  if (pthread_create(&thread_, NULL, &StartRoutine, this)) {
+    logprintf(0, "Process Error: failed to start the run thread\n");
+    running_ = false;
+    sat_->Cleanup();
+    Finish();
+    return false;
+  }
+  thread_started_ = true;
+  return true;
+}
+
+void *SatRunner::StartRoutine(void *ptr) {
+  static_cast<SatRunner*>(ptr)->RunMain();
+  return NULL;
+}
+
+void SatRunner::RunMain() {
+  if (!sat_->Run()) {
+    logprintf(0, "Process Error: Sat::Run() failed\n");
+    sat_->bad_status();
+  }
+  sat_->PrintResults();
+
+  // Cleanup() takes apart what LiveTotals() looks at.
+  struct CheckpointCounts totals;
+  sat_->LiveTotals(&totals);
+  pthread_mutex_lock(&state_lock_);
+  final_.pages = totals.pages;
+  final_.errors = totals.errors;
+  final_.data_mb = totals.data;
+  cleaned_up_ = true;
+  pthread_mutex_unlock(&state_lock_);
+
+  if (!sat_->Cleanup()) {
+    logprintf(0, "Process Error: Sat::Cleanup() failed\n");
+    sat_->bad_status();
+  }
+  result_ = (sat_->status() != 0 || sat_->errors() != 0) ? 1 : 0;
+  end_ = time(NULL);
+  __sync_synchronize();
+  running_ = false;
+}
+
+void SatRunner::Finish() {
+  Logger *logger = Logger::GlobalLogger();
+  logger->SetLineHandler(NULL, NULL);
+  logger->SetStdoutEnabled(true);
+  __sync_synchronize();
+  g_runner_active = 0;
+}
+
+bool SatRunner::Poll(SatRunStats *stats) {
+  if (!sat_ || !start_)
+    return false;
+  pthread_mutex_lock(&state_lock_);
+  if (cleaned_up_) {
+    *stats = final_;
+  } else {
+    struct CheckpointCounts totals;
+    sat_->LiveTotals(&totals);
+    stats->pages = totals.pages;
+    stats->errors = totals.errors;
+    stats->data_mb = totals.data;
+  }
+  pthread_mutex_unlock(&state_lock_);
+  stats->running = running_;
+  __sync_synchronize();
+  stats->paused = stats->running && paused_;
+  stats->seconds = (stats->running ? time(NULL) : end_) - start_;
+  return true;
+}
+
+void SatRunner::Pause() {
+  if (!running_)
+    return;
+  paused_ = true;
+  sat_->RequestPause(true);
+}
+
+void SatRunner::Resume() {
+  if (!running_)
+    return;
+  paused_ = false;
+  sat_->RequestPause(false);
+}
+
+void SatRunner::Stop() {
+  if (!running_)
+    return;
+  sat_->Break();
+}
+
+int SatRunner::Wait() {
+  if (!thread_started_)
+    return result_;
+  pthread_join(thread_, NULL);
+  thread_started_ = false;
+  Finish();
+  return result_;
+}
+
+int64_t SatRunner::Errors(std::vector<std::string> *lines) {
+  pthread_mutex_lock(&lock_);
+  *lines = errors_;
+  int64_t dropped = dropped_errors_;
+  pthread_mutex_unlock(&lock_);
+  return dropped;
+}
+
+void SatRunner::HandleLine(const char *line, size_t length, void *arg) {
+  SatRunner *runner = static_cast<SatRunner*>(arg);
+  // "Report Error:", "Hardware Error:", "Process Error:" and the like.
+  const char *error = static_cast<const char*>(
+      memmem(line, length, "Error: ", 7));
+  if (!error)
+    return;
+  while (length && line[length - 1] == '\n')
+    length--;
+  pthread_mutex_lock(&runner->lock_);
+  if (runner->errors_.size() < static_cast<size_t>(kMaxErrorLines))
+    runner->errors_.push_back(string(line, length));
+  else
+    runner->dropped_errors_++;
+  pthread_mutex_unlock(&runner->lock_);
+}
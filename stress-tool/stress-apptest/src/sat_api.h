@@ -0,0 +1,126 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// In-process control of a stressapptest run, for programs that embed the
+// test instead of running the stressapptest binary and reading its output.
+//
+// This header is installed with libstressapptest.a and does not need any
+// of the other stressapptest headers.
+
+#ifndef STRESSAPPTEST_SAT_API_H_
+#define STRESSAPPTEST_SAT_API_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+class Sat;
+
+// What to run.  Thread counts of -1 keep the stressapptest defaults.
+struct SatRunConfig {
+  SatRunConfig();
+
+  int seconds;                    // Run time, -s.
+  int memory_mb;                  // Memory to test, -M.  0 for the default.
+  int memory_threads;             // Memory copy threads, -m.
+  int invert_threads;             // Memory invert threads, -i.
+  int check_threads;              // Memory check threads, -c.
+  int cpu_threads;                // CPU stress threads, -C.
+  int max_errors;                 // Stop after this many errors, 0 for no
+                                  // limit.
+  int verbosity;                  // Log verbosity, -v.
+  bool log_stdout;                // Also write the log to stdout.
+  std::vector<std::string> args;  // Any further command line flags.
+};
+
+// Progress of a run.
+struct SatRunStats {
+  bool running;                   // Started and not finished yet.
+  bool paused;                    // Workers are held by Pause().
+  int64_t seconds;                // Since Start(), until the run finished.
+  int64_t pages;                  // Pages processed by all workers.
+  int64_t errors;                 // Errors found by all workers.
+  double data_mb;                 // Data copied by all workers, in MB.
+};
+
+// One stressapptest run in a background thread of the calling process.
+//
+// stressapptest keeps process wide state, so only one run can be active in
+// a process at a time.  The run leaves SIGINT and SIGTERM to the host.
+class SatRunner {
+ public:
+  // Most error lines kept for Errors(), later ones are only counted.
+  static const int kMaxErrorLines = 1000;
+
+  SatRunner();
+  // Stops a run that is still going and waits for it.
+  ~SatRunner();
+
+  // Set up and start a run.  Returns false if the configuration is rejected,
+  // setup fails, or another run is active.  Errors() tells why.
+  bool Start(const SatRunConfig &config);
+
+  // Fill in 'stats'.  Returns false if Start() hasn't succeeded.
+  bool Poll(SatRunStats *stats);
+
+  // Hold all workers until Resume().  Takes effect within a second.
+  void Pause();
+  void Resume();
+
+  // End the run early.  Takes effect within a second, Wait() for it.
+  void Stop();
+
+  // Wait for the run to end.  Returns 0 if it passed and 1 if it found
+  // errors or failed, the same as the stressapptest exit status.
+  int Wait();
+
+  // Copy the error lines logged since Start(), oldest first.  Returns the
+  // number of lines that didn't fit in kMaxErrorLines.
+  int64_t Errors(std::vector<std::string> *lines);
+
+ private:
+  // Callbacks for pthread_create(3) and the logger.
+  static void *StartRoutine(void *ptr);
+  static void HandleLine(const char *line, size_t length, void *arg);
+
+  // Run, report and clean up, in the background thread.
+  void RunMain();
+  // Detach from the logger and let another run start.
+  void Finish();
+
+  Sat *sat_;                      // The last run, NULL before Start().
+  pthread_t thread_;
+  bool thread_started_;           // thread_ needs to be joined.
+  volatile bool running_;         // RunMain() hasn't returned yet.
+  bool paused_;
+  int result_;                    // Wait() return value.
+  time_t start_;                  // Time of Start().
+  time_t end_;                    // Time the run finished, 0 before.
+
+  pthread_mutex_t state_lock_;    // Guards the fields below.
+  bool cleaned_up_;               // sat_ can't be asked for totals anymore.
+  struct SatRunStats final_;      // Totals once cleaned_up_.
+
+  pthread_mutex_t lock_;          // Guards the fields below.
+  std::vector<std::string> errors_;
+  int64_t dropped_errors_;
+
+  SatRunner(const SatRunner&);
+  void operator=(const SatRunner&);
+};
+
+#endif  // STRESSAPPTEST_SAT_API_H_
@@ -0,0 +1,717 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// sat_bench.cc : times the primitives that bound stressapptest throughput,
+// each on its own, across thread counts and sizes, and prints the results
+// as CSV. Built with 'make bench'.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "adler32memcpy.h"
+#include "finelock_queue.h"
+#include "logger.h"
+#include "os.h"
+#include "pattern.h"
+#include "queue.h"
+#include "sat.h"
+#include "sattypes.h"
+#include "worker.h"
+
+namespace {
+
+// Iterations between looks at the clock.
+const int kBatch = 16;
+// Alignment of the copy and check buffers.
+const int kBufferAlignment = 4096;
+// Page size the queues hand out.
+const int kQueuePageSize = 4096;
+// Priority of the lines queued by the logger benchmark.
+const int kLogPriority = 5;
+// Page size of the error path benchmark, the stressapptest default is 1MB
+// but smaller pages make for more checks per second.
+const int kErrorPageSize = 65536;
+
+// Results of one benchmark run.
+struct Result {
+  uint64 ops;
+  double seconds;
+};
+
+class Benchmark;
+
+// Per thread state of a run.
+struct BenchArgs {
+  Benchmark *bench;
+  int thread;
+  pthread_barrier_t *barrier;
+  double seconds;                 // How long to run.
+  uint64 ops;                     // Out: iterations done.
+  double elapsed;                 // Out: seconds taken.
+};
+
+// One primitive under test. Setup() runs before the threads start,
+// Iterate() in every thread until time is up, Teardown() after.
+class Benchmark {
+ public:
+  // What the size argument of a benchmark counts.
+  enum Axis {
+    kBytes,    // Bytes per iteration, from --sizes.
+    kPages,    // Pages in a queue, from --pages.
+    kErrors,   // Miscompares per iteration, from --errors.
+  };
+
+  Benchmark(const char *name, Axis axis) : name_(name), axis_(axis) {}
+  virtual ~Benchmark() {}
+
+  const char *name() const { return name_; }
+  Axis axis() const { return axis_; }
+  // Bytes handled per iteration with 'size', for a bandwidth.
+  virtual double Bytes(int size) const { return axis_ == kBytes ? size : 0; }
+  // If the primitive handles 'size' at all.
+  virtual bool Supports(int size) const { return true; }
+  // Extra results of the last run, as key=value pairs split by ';'.
+  virtual string Notes() const { return ""; }
+
+  virtual bool Setup(int threads, int size) = 0;
+  // Do kBatch iterations on thread 'thread'.
+  virtual void Iterate(int thread) = 0;
+  virtual void Teardown() = 0;
+
+  // Run Iterate() on 'threads' threads for 'seconds'.
+  struct Result Run(int threads, double seconds);
+
+ private:
+  static void *ThreadMain(void *ptr);
+
+  const char *name_;
+  Axis axis_;
+};
+
+void *Benchmark::ThreadMain(void *ptr) {
+  struct BenchArgs *args = static_cast<struct BenchArgs*>(ptr);
+  pthread_barrier_wait(args->barrier);
+  int64 start = sat_get_time_ns();
+  int64 end = start + static_cast<int64>(args->seconds * 1e9);
+  int64 now = start;
+  uint64 ops = 0;
+  while (now < end) {
+    args->bench->Iterate(args->thread);
+    ops += kBatch;
+    now = sat_get_time_ns();
+  }
+  args->ops = ops;
+  args->elapsed = (now - start) / 1e9;
+  return NULL;
+}
+
+struct Result Benchmark::Run(int threads, double seconds) {
+  vector<struct BenchArgs> args(threads);
+  vector<pthread_t> tids(threads);
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, threads);
+  for (int i = 0; i < threads; i++) {
+    args[i].bench = this;
+    args[i].thread = i;
+    args[i].barrier = &barrier;
+    args[i].seconds = seconds;
+    args[i].ops = 0;
+    args[i].elapsed = 0;
+    sat_assert(!pthread_create(&tids[i], NULL, ThreadMain, &args[i]));
+  }
+  struct Result result = { 0, 0 };
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+    result.ops += args[i].ops;
+    if (args[i].elapsed > result.seconds)
+      result.seconds = args[i].elapsed;
+  }
+  pthread_barrier_destroy(&barrier);
+  return result;
+}
+
+// Buffers of 'size' bytes, two per thread.
+class BufferSet {
+ public:
+  BufferSet() : size_(0) {}
+  ~BufferSet() { Free(); }
+
+  bool Allocate(int count, int size) {
+    Free();
+    size_ = size;
+    for (int i = 0; i < count; i++) {
+      void *buffer = NULL;
+      if (posix_memalign(&buffer, kBufferAlignment, size))
+        return false;
+      memset(buffer, i + 1, size);
+      buffers_.push_back(static_cast<uint64*>(buffer));
+    }
+    return true;
+  }
+  void Free() {
+    for (size_t i = 0; i < buffers_.size(); i++)
+      free(buffers_[i]);
+    buffers_.clear();
+  }
+  uint64 *get(int i) const { return buffers_[i]; }
+  int size() const { return size_; }
+
+ private:
+  vector<uint64*> buffers_;
+  int size_;
+};
+
+// Checksummed copy with one of the Adler memcpy routines.
+class AdlerCopyBench : public Benchmark {
+ public:
+  typedef bool (*CopyFunction)(uint64 *dst, uint64 *src,
+                               unsigned int size_in_bytes,
+                               AdlerChecksum *checksum);
+  AdlerCopyBench(const char *name, CopyFunction copy, int max_size)
+      : Benchmark(name, kBytes), copy_(copy), max_size_(max_size) {}
+
+  virtual bool Supports(int size) const { return size <= max_size_; }
+
+  virtual bool Setup(int threads, int size) {
+    return buffers_.Allocate(threads * 2, size);
+  }
+  virtual void Iterate(int thread) {
+    AdlerChecksum checksum;
+    for (int i = 0; i < kBatch; i++)
+      copy_(buffers_.get(thread * 2), buffers_.get(thread * 2 + 1),
+            buffers_.size(), &checksum);
+  }
+  virtual void Teardown() { buffers_.Free(); }
+
+ private:
+  CopyFunction copy_;
+  int max_size_;                  // Largest copy it does.
+  BufferSet buffers_;
+};
+
+// Exposes the page helpers of a worker.
+class BenchWorker : public WorkerThread {
+ public:
+  bool Fill(struct page_entry *pe) { return FillPage(pe); }
+  int Check(struct page_entry *pe) { return CrcCheckPage(pe); }
+};
+
+// WorkerThread::CrcCheckPage() on a page filled with a pattern. The page
+// size is the size argument.
+class CrcCheckBench : public Benchmark {
+ public:
+  CrcCheckBench()
+      : Benchmark("crc_check_page", kBytes), sat_(NULL), os_(NULL) {}
+
+  // Pages are a power of two, checked 4KB at a time.
+  virtual bool Supports(int size) const {
+    return size >= 4096 && !(size & (size - 1));
+  }
+
+  virtual bool Setup(int threads, int size) {
+    // Worker methods read the page size and tag mode from a Sat.
+    sat_ = SatFactory();
+    char page_size[32];
+    snprintf(page_size, sizeof(page_size), "%d", size);
+    const char *argv[] = { "sat_bench", "-v", "0", "-p", page_size };
+    if (!sat_->ParseArgs(5, const_cast<char**>(argv)))
+      return false;
+    std::map<std::string, std::string> options;
+    os_ = OsLayerFactory(options);
+    if (!os_ || !os_->Initialize())
+      return false;
+    if (!patterns_.Initialize())
+      return false;
+    status_.Initialize();
+    if (!buffers_.Allocate(threads, size))
+      return false;
+
+    for (int i = 0; i < threads; i++) {
+      BenchWorker *worker = new BenchWorker();
+      worker->InitThread(i, sat_, os_, &patterns_, &status_);
+      struct page_entry pe;
+      memset(&pe, 0, sizeof(pe));
+      pe.addr = buffers_.get(i);
+      pe.pattern = patterns_.GetRandomPattern();
+      worker->Fill(&pe);
+      workers_.push_back(worker);
+      pages_.push_back(pe);
+    }
+    return true;
+  }
+  virtual void Iterate(int thread) {
+    for (int i = 0; i < kBatch; i++)
+      sat_assert(!workers_[thread]->Check(&pages_[thread]));
+  }
+  virtual void Teardown() {
+    for (size_t i = 0; i < workers_.size(); i++)
+      delete workers_[i];
+    workers_.clear();
+    pages_.clear();
+    buffers_.Free();
+    status_.Destroy();
+    patterns_.Destroy();
+    delete os_;
+    os_ = NULL;
+    delete sat_;
+    sat_ = NULL;
+  }
+
+ private:
+  Sat *sat_;
+  OsLayer *os_;
+  PatternList patterns_;
+  WorkerStatus status_;
+  BufferSet buffers_;
+  vector<BenchWorker*> workers_;
+  vector<struct page_entry> pages_;
+};
+
+// FineLockPEQueue Get and Put pairs from every thread at once, as the
+// copy threads do. The size argument is the number of pages.
+class FineLockBench : public Benchmark {
+ public:
+  FineLockBench() : Benchmark("finelock_get_put", kPages), queue_(NULL) {}
+
+  virtual bool Setup(int threads, int size) {
+    // Any pattern marks a page valid, none of them is looked at.
+    if (!patterns_.Initialize())
+      return false;
+    queue_ = new FineLockPEQueue(size, kQueuePageSize);
+    for (int i = 0; i < size; i++) {
+      struct page_entry pe;
+      memset(&pe, 0, sizeof(pe));
+      pe.offset = static_cast<uint64>(i) * kQueuePageSize;
+      if (i % 2) {
+        pe.pattern = patterns_.GetPattern(0);
+        queue_->PutValid(&pe);
+      } else {
+        queue_->PutEmpty(&pe);
+      }
+    }
+    return true;
+  }
+  virtual void Iterate(int thread) {
+    for (int i = 0; i < kBatch; i++) {
+      struct page_entry src, dst;
+      sat_assert(queue_->GetValid(&src));
+      sat_assert(queue_->GetEmpty(&dst));
+      dst.pattern = src.pattern;
+      src.pattern = NULL;
+      sat_assert(queue_->PutValid(&dst));
+      sat_assert(queue_->PutEmpty(&src));
+    }
+  }
+  virtual void Teardown() {
+    delete queue_;
+    queue_ = NULL;
+    patterns_.Destroy();
+  }
+
+ private:
+  FineLockPEQueue *queue_;
+  PatternList patterns_;
+};
+
+// PageEntryQueue::PopRandom() and Push() pairs. The size argument is the
+// number of pages.
+class PopRandomBench : public Benchmark {
+ public:
+  PopRandomBench() : Benchmark("pe_queue_pop_random", kPages), queue_(NULL) {}
+
+  virtual bool Setup(int threads, int size) {
+    // The queue needs a free slot to push into.
+    queue_ = new PageEntryQueue(size + 1);
+    for (int i = 0; i < size; i++) {
+      struct page_entry pe;
+      memset(&pe, 0, sizeof(pe));
+      pe.offset = static_cast<uint64>(i) * kQueuePageSize;
+      queue_->Push(&pe);
+    }
+    return true;
+  }
+  virtual void Iterate(int thread) {
+    for (int i = 0; i < kBatch; i++) {
+      struct page_entry pe;
+      if (queue_->PopRandom(&pe))
+        queue_->Push(&pe);
+    }
+  }
+  virtual void Teardown() {
+    delete queue_;
+    queue_ = NULL;
+  }
+
+ private:
+  PageEntryQueue *queue_;
+};
+
+// Lines queued to the logging thread, which writes them to /dev/null. The
+// size argument is the length of the lines.
+class LoggerBench : public Benchmark {
+ public:
+  LoggerBench() : Benchmark("logger_queue_line", kBytes), null_fd_(-1) {}
+
+  virtual bool Supports(int size) const {
+    return size > 1 && size < static_cast<int>(kLogLineSize);
+  }
+
+  virtual bool Setup(int threads, int size) {
+    null_fd_ = open("/dev/null", O_WRONLY);
+    if (null_fd_ < 0)
+      return false;
+    line_.assign(size - 1, 'x');
+    Logger *logger = Logger::GlobalLogger();
+    logger->SetLogFd(null_fd_);
+    logger->SetStdoutEnabled(false);
+    logger->SetVerbosity(kLogPriority);
+    logger->StartThread();
+    return true;
+  }
+  virtual void Iterate(int thread) {
+    for (int i = 0; i < kBatch; i++)
+      logprintf(kLogPriority, "%s\n", line_.c_str());
+  }
+  virtual void Teardown() {
+    Logger *logger = Logger::GlobalLogger();
+    logger->StopThread();
+    logger->SetVerbosity(0);
+    logger->SetStdoutOnly();
+    logger->SetStdoutEnabled(true);
+    close(null_fd_);
+    null_fd_ = -1;
+  }
+
+ private:
+  int null_fd_;
+  string line_;
+};
+
+// WorkerThread::CrcCheckPage() on pages with the size argument of
+// miscompares injected before every check, so that each check runs the
+// whole error path: the slow compare, ProcessError(), the "Hardware Error"
+// and "Report Error" lines, and ErrorDiag. Compare the bandwidth against
+// the run with no errors to see what the errors cost. The logger writes to
+// /dev/null, and a probe line from thread 0 measures how far behind the
+// logging thread falls.
+class ErrorPathBench : public Benchmark {
+ public:
+  ErrorPathBench()
+      : Benchmark("crc_check_errors", kErrors), sat_(NULL), os_(NULL),
+        errors_(0), null_fd_(-1), probes_(0), probe_ns_(0),
+        max_probe_ns_(0), dropped_(0), diag_ns_(0) {}
+
+  // More than CheckRegion() records per 4KB block is a page error, which
+  // takes another path.
+  virtual bool Supports(int size) const { return size <= 1024; }
+  virtual double Bytes(int size) const { return kErrorPageSize; }
+
+  virtual bool Setup(int threads, int size) {
+    errors_ = size;
+    probes_ = probe_ns_ = max_probe_ns_ = 0;
+    sat_ = SatFactory();
+    char page_size[32];
+    snprintf(page_size, sizeof(page_size), "%d", kErrorPageSize);
+    const char *argv[] = { "sat_bench", "-v", "0", "-p", page_size };
+    if (!sat_->ParseArgs(5, const_cast<char**>(argv)))
+      return false;
+    std::map<std::string, std::string> options;
+    os_ = OsLayerFactory(options);
+    if (!os_ || !os_->Initialize())
+      return false;
+    if (!patterns_.Initialize())
+      return false;
+    status_.Initialize();
+    if (!buffers_.Allocate(threads, kErrorPageSize))
+      return false;
+
+    null_fd_ = open("/dev/null", O_WRONLY);
+    if (null_fd_ < 0)
+      return false;
+    Logger *logger = Logger::GlobalLogger();
+    logger->SetLogFd(null_fd_);
+    logger->SetStdoutEnabled(false);
+    logger->SetVerbosity(kLogPriority);
+    logger->SetLineHandler(ProbeLine, this);
+    dropped_ = logger->DroppedLines();
+    logger->StartThread();
+
+    for (int i = 0; i < threads; i++) {
+      BenchWorker *worker = new BenchWorker();
+      worker->InitThread(i, sat_, os_, &patterns_, &status_);
+      struct page_entry pe;
+      memset(&pe, 0, sizeof(pe));
+      pe.addr = buffers_.get(i);
+      pe.pattern = patterns_.GetRandomPattern();
+      worker->Fill(&pe);
+      workers_.push_back(worker);
+      pages_.push_back(pe);
+    }
+    return true;
+  }
+  virtual void Iterate(int thread) {
+    static const int kWords = kErrorPageSize / sizeof(uint64);
+    struct page_entry *pe = &pages_[thread];
+    uint64 *words = static_cast<uint64*>(pe->addr);
+    for (int i = 0; i < kBatch; i++) {
+      // Spread the miscompares over the page, one bit each.
+      if (errors_) {
+        uint64 first = Prng::ThreadPrng()->Below(kWords / errors_);
+        for (int e = 0; e < errors_; e++)
+          words[first + e * (kWords / errors_)] ^= 1ULL << (e & 63);
+      }
+      // ProcessError() puts the data back.
+      sat_assert(workers_[thread]->Check(pe) == errors_);
+    }
+    if (!thread)
+      logprintf(kLogPriority, "%s%lld\n", kProbe, sat_get_time_ns());
+  }
+  virtual void Teardown() {
+    Logger *logger = Logger::GlobalLogger();
+    if (null_fd_ >= 0) {
+      // Time a diagnosis with all of the run's errors recorded.
+      int64 start = sat_get_time_ns();
+      os_->error_diagnoser_->AddMiscompareError("DIMM Unknown", 0, 1);
+      diag_ns_ = sat_get_time_ns() - start;
+      logger->StopThread();
+      dropped_ = logger->DroppedLines() - dropped_;
+      logger->SetLineHandler(NULL, NULL);
+      logger->SetVerbosity(0);
+      logger->SetStdoutOnly();
+      logger->SetStdoutEnabled(true);
+      close(null_fd_);
+      null_fd_ = -1;
+    }
+    for (size_t i = 0; i < workers_.size(); i++)
+      delete workers_[i];
+    workers_.clear();
+    pages_.clear();
+    buffers_.Free();
+    status_.Destroy();
+    patterns_.Destroy();
+    delete os_;
+    os_ = NULL;
+    delete sat_;
+    sat_ = NULL;
+  }
+  virtual string Notes() const {
+    char notes[160];
+    snprintf(notes, sizeof(notes), "log_delay_us=%.1f;log_delay_max_us=%.1f;"
+             "log_dropped=%llu;diag_us=%.1f",
+             probes_ ? probe_ns_ / 1e3 / probes_ : 0, max_probe_ns_ / 1e3,
+             dropped_, diag_ns_ / 1e3);
+    return notes;
+  }
+
+ private:
+  static const char kProbe[];
+
+  // Logger line handler, on the logging thread.
+  static void ProbeLine(const char *line, size_t length, void *arg) {
+    ErrorPathBench *bench = static_cast<ErrorPathBench*>(arg);
+    const char *probe = strstr(line, kProbe);
+    if (!probe)
+      return;
+    int64 ns = sat_get_time_ns() - strtoll(probe + strlen(kProbe), NULL, 10);
+    bench->probes_++;
+    bench->probe_ns_ += ns;
+    if (ns > bench->max_probe_ns_)
+      bench->max_probe_ns_ = ns;
+  }
+
+  Sat *sat_;
+  OsLayer *os_;
+  PatternList patterns_;
+  WorkerStatus status_;
+  BufferSet buffers_;
+  vector<BenchWorker*> workers_;
+  vector<struct page_entry> pages_;
+  int errors_;                    // Miscompares per check.
+  int null_fd_;
+  uint64 probes_;                 // Probe lines written.
+  int64 probe_ns_;                // Their total time in the queue.
+  int64 max_probe_ns_;
+  uint64 dropped_;                // Lines dropped during the run.
+  int64 diag_ns_;                 // A diagnosis after the run.
+};
+
+const char ErrorPathBench::kProbe[] = "sat_bench probe ";
+
+// Parses a comma separated list of numbers of at least 'min' into 'values'.
+bool ParseList(const char *text, vector<int> *values, int min = 1) {
+  values->clear();
+  char *end = NULL;
+  for (const char *p = text; *p; p = end + (*end == ',')) {
+    long value = strtol(p, &end, 0);  // NOLINT
+    if (end == p || value < min || (*end && *end != ','))
+      return false;
+    values->push_back(value);
+  }
+  return !values->empty();
+}
+
+void PrintUsage() {
+  printf("Usage: sat_bench [options]\n"
+         " --bench name,...   benchmarks to run, default all of:\n"
+         "                    adler_memcpy_c adler_memcpy_asm crc_check_page\n"
+         "                    finelock_get_put pe_queue_pop_random"
+         " logger_queue_line\n"
+         "                    crc_check_errors\n"
+         " --threads n,...    thread counts, default 1,2,4.. up to the cpus\n"
+         " --sizes n,...      bytes per copy, check or log line, default\n"
+         "                    256,4096,65536,1048576, skipping the ones a\n"
+         "                    primitive can't do\n"
+         " --pages n,...      pages in the queues, default 1024,65536\n"
+         " --errors n,...     miscompares per 64KB page check, default\n"
+         "                    0,1,8,64,512\n"
+         " --seconds s        time per run, default 0.5\n"
+         "Prints one CSV line per run: benchmark, threads, size (bytes, or\n"
+         "pages for the queues), iterations, seconds, nanoseconds per\n"
+         "iteration on each thread, MB/s over all threads, and notes.\n"
+         "Log lines dropped because the logging thread fell behind count\n"
+         "too. The notes of crc_check_errors are the average and worst\n"
+         "time lines wait for the logging thread, the lines it dropped,\n"
+         "and the time of one diagnosis once all the errors are recorded.\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  vector<int> threads;
+  vector<int> sizes;
+  vector<int> pages;
+  vector<int> errors;
+  vector<string> selected;
+  double seconds = 0.5;
+
+  int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int n = 1; n < cpus; n *= 2)
+    threads.push_back(n);
+  threads.push_back(cpus > 0 ? cpus : 1);
+  sizes.push_back(256);
+  sizes.push_back(4096);
+  sizes.push_back(65536);
+  sizes.push_back(1048576);
+  pages.push_back(1024);
+  pages.push_back(65536);
+  errors.push_back(0);
+  errors.push_back(1);
+  errors.push_back(8);
+  errors.push_back(64);
+  errors.push_back(512);
+
+  for (int i = 1; i < argc; i++) {
+    bool ok = i + 1 < argc;
+    if (ok && !strcmp(argv[i], "--threads")) {
+      ok = ParseList(argv[++i], &threads);
+    } else if (ok && !strcmp(argv[i], "--sizes")) {
+      ok = ParseList(argv[++i], &sizes);
+    } else if (ok && !strcmp(argv[i], "--pages")) {
+      ok = ParseList(argv[++i], &pages);
+    } else if (ok && !strcmp(argv[i], "--errors")) {
+      ok = ParseList(argv[++i], &errors, 0);
+    } else if (ok && !strcmp(argv[i], "--seconds")) {
+      seconds = strtod(argv[++i], NULL);
+      ok = seconds > 0;
+    } else if (ok && !strcmp(argv[i], "--bench")) {
+      string list = argv[++i];
+      size_t start = 0;
+      while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos)
+          comma = list.size();
+        selected.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      PrintUsage();
+      return strcmp(argv[i], "-h") && strcmp(argv[i], "--help") ? 1 : 0;
+    }
+  }
+
+  // Only the logger benchmark logs, everything else stays quiet.
+  Logger::GlobalLogger()->SetVerbosity(0);
+
+  vector<Benchmark*> benchmarks;
+  benchmarks.push_back(new AdlerCopyBench("adler_memcpy_c", AdlerMemcpyC,
+                                          INT_MAX));
+  // The assembly copy stops short of 512KB.
+  benchmarks.push_back(new AdlerCopyBench("adler_memcpy_asm", AdlerMemcpyAsm,
+                                          (1 << 19) - 1));
+  benchmarks.push_back(new CrcCheckBench());
+  benchmarks.push_back(new FineLockBench());
+  benchmarks.push_back(new PopRandomBench());
+  benchmarks.push_back(new LoggerBench());
+  benchmarks.push_back(new ErrorPathBench());
+
+  int status = 0;
+  printf("benchmark,threads,size,iterations,seconds,ns_per_iteration,"
+         "mb_per_s,notes\n");
+  for (size_t b = 0; b < benchmarks.size(); b++) {
+    Benchmark *bench = benchmarks[b];
+    bool wanted = selected.empty();
+    for (size_t i = 0; i < selected.size(); i++)
+      wanted = wanted || selected[i] == bench->name();
+    if (!wanted)
+      continue;
+
+    const vector<int> &bench_sizes =
+        bench->axis() == Benchmark::kBytes ? sizes :
+        bench->axis() == Benchmark::kPages ? pages : errors;
+    for (size_t s = 0; s < bench_sizes.size(); s++) {
+      if (!bench->Supports(bench_sizes[s]))
+        continue;
+      for (size_t t = 0; t < threads.size(); t++) {
+        if (!bench->Setup(threads[t], bench_sizes[s])) {
+          fprintf(stderr, "sat_bench: %s failed to set up with size %d\n",
+                  bench->name(), bench_sizes[s]);
+          bench->Teardown();
+          status = 1;
+          continue;
+        }
+        struct Result result = bench->Run(threads[t], seconds);
+        bench->Teardown();
+
+        double ns = result.ops ?
+            result.seconds * 1e9 * threads[t] / result.ops : 0;
+        double mbps = 0;
+        if (result.seconds > 0)
+          mbps = result.ops * bench->Bytes(bench_sizes[s]) /
+                 result.seconds / kMegabyte;
+        printf("%s,%d,%d,%llu,%.3f,%.1f,%.1f,%s\n", bench->name(),
+               threads[t], bench_sizes[s], result.ops, result.seconds, ns,
+               mbps, bench->Notes().c_str());
+        fflush(stdout);
+      }
+    }
+  }
+
+  for (size_t b = 0; b < benchmarks.size(); b++)
+    delete benchmarks[b];
+  return status;
+}
@@ -195,7 +195,7 @@ inline string ErrorString(int error_num) {
 inline void cpuid(
   unsigned int *eax, unsigned int *ebx, unsigned int *ecx, unsigned int *edx) {
   *ebx = 0;
-  *ecx = 0;
+  *ecx = 0;  // Subleaf 0 for leaves which have them.
   *edx = 0;
   // CPUID features documented at:
   // http://www.sandpile.org/ia32/cpuid.htm
@@ -212,7 +212,7 @@ inline void cpuid(
     // Output registers.
     : "=a" (*eax), "=D" (*ebx), "=c" (*ecx), "=d" (*edx)
     // Input registers.
-    : "a" (*eax)
+    : "a" (*eax), "c" (*ecx)
   );  // Asm
 #else
   asm(
@@ -220,7 +220,7 @@ inline void cpuid(
     // Output registers.
     : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
     // Input registers.
-    : "a" (*eax)
+    : "a" (*eax), "c" (*ecx)
   );  // Asm
 #endif  // defined(__PIC__) && defined(STRESSAPPTEST_CPU_I686)
 #elif defined(STRESSAPPTEST_CPU_MIPS)
@@ -242,6 +242,12 @@ inline int64 sat_get_time_us() {
   return ts.tv_sec * 1000000ULL + ts.tv_nsec/1000ULL;
 }
 
+inline int64 sat_get_time_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 // Define handy constants here
 static const int kTicksPerSec = 100;
 static const int kMegabyte = (1024LL*1024LL);
@@ -250,5 +256,6 @@ static const int kSatDiskPage = 8;
 static const int kSatPageSize = (1024LL*1024LL);
 static const int kCacheLineSize = 64;
 static const uint16_t kNetworkPort = 19996;
+static const uint16_t kNetCoordinatorPort = 19997;
 
 #endif  // STRESSAPPTEST_SATTYPES_H_
@@ -0,0 +1,291 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Low impact scrubber mode, see scrub.h.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "scrub.h"
+#include "os.h"
+
+#ifndef SCHED_IDLE
+#define SCHED_IDLE       5      // From linux/sched.h.
+#endif
+
+namespace {
+// The slice ForwardSignal() passes signals on to.
+volatile pid_t slice_pid = 0;
+volatile sig_atomic_t slice_stop = 0;
+
+// Pages translated per pagemap lookup when recording frames.
+const int kClaimBatch = 512;
+}  // namespace
+
+ScrubSupervisor::ScrubSupervisor() {
+  frames_ = NULL;
+  frame_count_ = 0;
+  phys_pages_ = 0;
+  memset(&total_, 0, sizeof(total_));
+  slices_ = 0;
+  pid_ = 0;
+  fd_ = -1;
+  report_fd_ = -1;
+  start_us_ = 0;
+}
+
+ScrubSupervisor::~ScrubSupervisor() {
+  if (frames_)
+    munmap(frames_, (frame_count_ + 63) / 64 * sizeof(*frames_));
+  if (fd_ >= 0)
+    close(fd_);
+  if (report_fd_ >= 0)
+    close(report_fd_);
+}
+
+bool ScrubSupervisor::Throttle(const char *cgroup) {
+  if (cgroup && cgroup[0]) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup);
+    int fd = open(path, O_WRONLY);
+    char pid[32];
+    int length = snprintf(pid, sizeof(pid), "%d\n", getpid());
+    if (fd < 0 || write(fd, pid, length) != length) {
+      logprintf(0, "Process Error: Can't join cgroup %s: %s\n",
+                cgroup, ErrorString(errno).c_str());
+      if (fd >= 0)
+        close(fd);
+      return false;
+    }
+    close(fd);
+    logprintf(5, "Log: Scrubbing in cgroup %s.\n", cgroup);
+  }
+
+  // Only runs when the cpu would otherwise be idle, threads inherit it.
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  if (sched_setscheduler(0, SCHED_IDLE, &param))
+    logprintf(5, "Log: Can't switch to SCHED_IDLE: %s\n",
+              ErrorString(errno).c_str());
+  return true;
+}
+
+bool ScrubSupervisor::Setup() {
+  long pages = sysconf(_SC_PHYS_PAGES);  // NOLINT
+  if (pages <= 0)
+    return false;
+  phys_pages_ = pages;
+  // Frame numbers run past the page count by the holes in the physical
+  // address map, frames beyond the bitmap aren't counted.
+  frame_count_ = 2 * phys_pages_;
+  size_t length = (frame_count_ + 63) / 64 * sizeof(*frames_);
+  void *map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    logprintf(0, "Process Error: Can't map the scrub frame bitmap: %s\n",
+              ErrorString(errno).c_str());
+    frame_count_ = 0;
+    return false;
+  }
+  frames_ = static_cast<uint64*>(map);
+
+  signal(SIGINT, ForwardSignal);
+  signal(SIGTERM, ForwardSignal);
+  return true;
+}
+
+bool ScrubSupervisor::Spawn(int *slice) {
+  *slice = -1;
+  if (!start_us_)
+    start_us_ = sat_get_time_us();
+
+  int fds[2];
+  if (pipe(fds)) {
+    logprintf(0, "Process Error: Can't create scrub slice pipe: %s\n",
+              ErrorString(errno).c_str());
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    logprintf(0, "Process Error: Can't start scrub slice %d: %s\n",
+              slices_, ErrorString(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    report_fd_ = fds[1];
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    *slice = slices_;
+    return true;
+  }
+  close(fds[1]);
+  fd_ = fds[0];
+  pid_ = pid;
+  slice_pid = pid;
+  slices_++;
+  return true;
+}
+
+void ScrubSupervisor::Claim(OsLayer *os) {
+  char *mem = static_cast<char*>(os->testmem());
+  uint64 length = os->testmemsize();
+  if (mlock(mem, length))
+    logprintf(5, "Log: Can't lock the scrub window in memory: %s\n",
+              ErrorString(errno).c_str());
+
+  const uint64 pagesize = sysconf(_SC_PAGESIZE);
+  uint64 pages = length / pagesize;
+  void *vaddrs[kClaimBatch];
+  uint64 paddrs[kClaimBatch];
+  for (uint64 page = 0; page < pages; page += kClaimBatch) {
+    int count = pages - page < kClaimBatch ? pages - page : kClaimBatch;
+    for (int i = 0; i < count; i++) {
+      // Make sure the page is present, the fill threads haven't run yet.
+      vaddrs[i] = mem + (page + i) * pagesize;
+      *static_cast<volatile char*>(vaddrs[i]) =
+          *static_cast<volatile char*>(vaddrs[i]);
+    }
+    os->VirtualToPhysicalBulk(vaddrs, count, paddrs);
+    for (int i = 0; i < count; i++) {
+      uint64 frame = paddrs[i] / pagesize;
+      if (paddrs[i] && frame < frame_count_)
+        __sync_fetch_and_or(&frames_[frame / 64], 1ULL << (frame % 64));
+    }
+  }
+}
+
+void ScrubSupervisor::Report(const struct ShardResult &result) {
+  if (report_fd_ < 0)
+    return;
+  if (write(report_fd_, &result, sizeof(result)) != sizeof(result))
+    logprintf(0, "Log: Can't report scrub slice results: %s\n",
+              ErrorString(errno).c_str());
+  close(report_fd_);
+  report_fd_ = -1;
+}
+
+void ScrubSupervisor::WaitSlice() {
+  if (!pid_)
+    return;
+  // Results are far below PIPE_BUF, so they arrive in one piece.
+  struct ShardResult result;
+  ssize_t got;
+  do {
+    got = read(fd_, &result, sizeof(result));
+  } while (got < 0 && errno == EINTR);
+  bool reported = got == sizeof(result);
+  close(fd_);
+  fd_ = -1;
+
+  int status = 0;
+  while (waitpid(pid_, &status, 0) < 0 && errno == EINTR) {}
+  pid_ = 0;
+  slice_pid = 0;
+  int slice = slices_ - 1;
+  if (WIFSIGNALED(status)) {
+    logprintf(0, "Process Error: Scrub slice %d killed by signal %d\n",
+              slice, WTERMSIG(status));
+    total_.status++;
+  } else if (!reported) {
+    logprintf(0, "Process Error: Scrub slice %d exited with %d before "
+                 "reporting its results\n", slice, WEXITSTATUS(status));
+    total_.status++;
+  }
+  if (!reported)
+    return;
+
+  total_.pages += result.pages;
+  total_.errors += result.errors;
+  total_.status += result.status;
+  total_.data += result.data;
+  double coverage = Coverage();
+  if (coverage < 0) {
+    logprintf(4, "Stats: Scrub slice %d: %.2fM, with %lld hardware "
+                 "incidents, %lld errors\n", slice, result.data,
+              result.errors, result.status);
+  } else {
+    logprintf(4, "Stats: Scrub slice %d: %.2fM, with %lld hardware "
+                 "incidents, %lld errors, %.2f%% of memory scrubbed\n",
+              slice, result.data, result.errors, result.status, coverage);
+  }
+}
+
+bool ScrubSupervisor::Pause(int seconds) {
+  struct timespec left;
+  left.tv_sec = seconds;
+  left.tv_nsec = 0;
+  while (!slice_stop && nanosleep(&left, &left) && errno == EINTR) {}
+  return !slice_stop;
+}
+
+bool ScrubSupervisor::stopped() const {
+  return slice_stop;
+}
+
+void ScrubSupervisor::ForwardSignal(int signum) {
+  slice_stop = 1;
+  if (slice_pid)
+    kill(slice_pid, signum);
+}
+
+double ScrubSupervisor::Coverage() const {
+  uint64 seen = 0;
+  for (uint64 i = 0; i < (frame_count_ + 63) / 64; i++)
+    seen += __builtin_popcountll(frames_[i]);
+  if (!seen)
+    return -1.;
+  return 100. * seen / phys_pages_;
+}
+
+int ScrubSupervisor::Finish() {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+
+  double seconds = (sat_get_time_us() - start_us_) / 1000000.;
+  logprintf(0, "Stats: Completed %d scrub slices: %.2fM in %.2fs %.2fMB/s, "
+               "with %lld hardware incidents, %lld errors\n",
+            slices_, total_.data, seconds,
+            seconds > 0 ? total_.data / seconds : 0., total_.errors,
+            total_.status);
+  double coverage = Coverage();
+  if (coverage < 0)
+    logprintf(4, "Log: Physical coverage unknown, pagemap shows frame "
+                 "numbers to CAP_SYS_ADMIN only.\n");
+  else
+    logprintf(4, "Stats: Scrubbed %.2f%% of the machine's memory.\n",
+              coverage);
+  logprintf(4, "\n");
+  if (total_.status) {
+    logprintf(4, "Status: FAIL - test encountered procedural errors\n");
+  } else if (total_.errors) {
+    logprintf(4, "Status: FAIL - test discovered HW problems\n");
+  } else {
+    logprintf(4, "Status: PASS - please verify no corrected errors\n");
+  }
+  logprintf(4, "\n");
+  return (total_.status || total_.errors) ? 1 : 0;
+}
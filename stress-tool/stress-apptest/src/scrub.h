@@ -0,0 +1,94 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Supervisor for the low impact scrubber mode: a small window of memory is
+// tested at a time, each window by a fresh child process, so that every
+// slice gets new physical pages from the kernel and gives them back when
+// it ends. Over many slices the scrubber works its way through the memory
+// that production leaves free.
+
+#ifndef STRESSAPPTEST_SCRUB_H_
+#define STRESSAPPTEST_SCRUB_H_
+
+#include <sys/types.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+#include "shard.h"
+
+class OsLayer;
+
+// Forks and reaps the slices one after another, and keeps a bitmap of
+// the physical frames they tested, shared with the slices, for coverage.
+//
+// Not threadsafe. Spawn() must be called before any other thread starts.
+class ScrubSupervisor {
+ public:
+  ScrubSupervisor();
+  ~ScrubSupervisor();
+
+  // Lower this process, and so every slice, to SCHED_IDLE, and move it
+  // into 'cgroup' when given, so that the cgroup's cpu.max and io limits
+  // bound the scrubber. Returns false if the cgroup can't be joined.
+  bool Throttle(const char *cgroup);
+
+  // Map the frame bitmap. Returns false if it can't be allocated.
+  bool Setup();
+
+  // Fork the next slice. Sets 'slice' to the slice number in the child,
+  // which goes on to do the run, and to -1 in the supervisor. Returns
+  // false if the child can't be started.
+  bool Spawn(int *slice);
+
+  // In a slice: lock the test memory so it stays resident under memory
+  // pressure, and record which physical frames it got.
+  void Claim(OsLayer *os);
+  // In a slice: send 'result' to the supervisor.
+  void Report(const struct ShardResult &result);
+
+  // In the supervisor: wait for the running slice and log its results and
+  // the coverage so far.
+  void WaitSlice();
+  // In the supervisor: sleep between slices. Returns false if the run
+  // was interrupted.
+  bool Pause(int seconds);
+  // True once SIGINT or SIGTERM was received.
+  bool stopped() const;
+
+  // In the supervisor: print the merged results of all slices. Returns
+  // the exit status.
+  int Finish();
+
+ private:
+  // Pass SIGINT or SIGTERM on to the running slice and stop.
+  static void ForwardSignal(int signum);
+  // Percentage of the frames of the machine tested so far, or -1 if
+  // pagemap gave no physical addresses.
+  double Coverage() const;
+
+  uint64 *frames_;                  // Shared bitmap, one bit per frame.
+  uint64 frame_count_;              // Frames the bitmap covers.
+  uint64 phys_pages_;               // Frames of memory in the machine.
+  struct ShardResult total_;        // Merged results of the slices.
+  int slices_;                      // Slices started.
+  pid_t pid_;                       // Running slice, or 0.
+  int fd_;                          // Read end of its result pipe.
+  int report_fd_;                   // Write end in a slice, else -1.
+  int64 start_us_;                  // When the first slice was started.
+
+  DISALLOW_COPY_AND_ASSIGN(ScrubSupervisor);
+};
+
+#endif  // STRESSAPPTEST_SCRUB_H_
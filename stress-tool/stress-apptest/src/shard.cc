@@ -0,0 +1,270 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// One stressapptest process per NUMA node, see shard.h.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "shard.h"
+#include "cpu_topology.h"
+
+#ifndef MPOL_BIND
+#define MPOL_BIND        2      // From linux/mempolicy.h.
+#endif
+
+namespace {
+// Region tags are single bits of an int32, as for --numa_alloc.
+const int kMaxShards = 32;
+
+// The shards ForwardSignal() passes signals on to.
+pid_t shard_pids[kMaxShards];
+volatile int shard_count = 0;
+
+// Read or write all of 'length' bytes. Returns false on EOF or failure.
+bool ReadAll(int fd, void *buf, size_t length) {
+  char *p = static_cast<char*>(buf);
+  while (length) {
+    ssize_t got = read(fd, p, length);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    p += got;
+    length -= got;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void *buf, size_t length) {
+  const char *p = static_cast<const char*>(buf);
+  while (length) {
+    ssize_t done = write(fd, p, length);
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0)
+      return false;
+    p += done;
+    length -= done;
+  }
+  return true;
+}
+}  // namespace
+
+ShardSupervisor::ShardSupervisor() {
+  report_fd_ = -1;
+  start_us_ = 0;
+}
+
+ShardSupervisor::~ShardSupervisor() {
+  for (size_t i = 0; i < fds_.size(); i++)
+    if (fds_[i] >= 0)
+      close(fds_[i]);
+  if (report_fd_ >= 0)
+    close(report_fd_);
+}
+
+bool ShardSupervisor::FindNodes() {
+  vector<int> nodes;
+  if (!ReadSysfsList("/sys/devices/system/node/online", &nodes) ||
+      nodes.empty())
+    return false;
+
+  nodes_.clear();
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (nodes_.size() == static_cast<size_t>(kMaxShards)) {
+      logprintf(0, "Log: Only using the first %d NUMA nodes.\n", kMaxShards);
+      break;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             nodes[i]);
+    vector<int> cpus;
+    // Memory only nodes are tested by the shards of their neighbours.
+    if (!ReadSysfsList(path, &cpus) || cpus.empty())
+      continue;
+    struct ShardNode node;
+    node.node = nodes[i];
+    CPU_ZERO(&node.cpus);
+    for (size_t j = 0; j < cpus.size(); j++) {
+      if (cpus[j] < CPU_SETSIZE)
+        CPU_SET(cpus[j], &node.cpus);
+    }
+    nodes_.push_back(node);
+  }
+  return !nodes_.empty();
+}
+
+bool ShardSupervisor::Spawn(int *shard) {
+  *shard = -1;
+  start_us_ = sat_get_time_us();
+  for (int i = 0; i < shards(); i++) {
+    int fds[2];
+    if (pipe(fds)) {
+      logprintf(0, "Process Error: Can't create shard pipe: %s\n",
+                ErrorString(errno).c_str());
+      KillAll();
+      return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      logprintf(0, "Process Error: Can't start shard %d: %s\n",
+                i, ErrorString(errno).c_str());
+      close(fds[0]);
+      close(fds[1]);
+      KillAll();
+      return false;
+    }
+    if (pid == 0) {
+      // The child only keeps its own write end.
+      close(fds[0]);
+      for (size_t j = 0; j < fds_.size(); j++)
+        close(fds_[j]);
+      fds_.clear();
+      pids_.clear();
+      report_fd_ = fds[1];
+      *shard = i;
+      return true;
+    }
+    close(fds[1]);
+    fds_.push_back(fds[0]);
+    pids_.push_back(pid);
+    shard_pids[i] = pid;
+    shard_count = i + 1;
+  }
+
+  signal(SIGINT, ForwardSignal);
+  signal(SIGTERM, ForwardSignal);
+  return true;
+}
+
+bool ShardSupervisor::Bind(int shard) {
+  const struct ShardNode &node = nodes_[shard];
+  bool bound = false;
+#ifdef HAVE_SCHED_GETAFFINITY
+  if (sched_setaffinity(0, sizeof(node.cpus), &node.cpus) == 0)
+    bound = true;
+  else
+    logprintf(0, "Log: Can't pin shard %d to node %d cpus: %s\n",
+              shard, node.node, ErrorString(errno).c_str());
+#endif
+#ifdef __NR_set_mempolicy
+  static const int kNodeMaskBits = 1024;
+  static const int kBitsPerLong = 8 * sizeof(unsigned long);  // NOLINT
+  unsigned long mask[kNodeMaskBits / kBitsPerLong];  // NOLINT
+  if (node.node < kNodeMaskBits) {
+    memset(mask, 0, sizeof(mask));
+    mask[node.node / kBitsPerLong] |= 1UL << (node.node % kBitsPerLong);
+    // The kernel reads maxnode - 1 bits of the mask.
+    if (syscall(__NR_set_mempolicy, MPOL_BIND, mask, kNodeMaskBits + 1) == 0)
+      bound = true;
+    else
+      logprintf(0, "Log: Can't bind shard %d to node %d memory: %s\n",
+                shard, node.node, ErrorString(errno).c_str());
+  }
+#endif
+  return bound;
+}
+
+void ShardSupervisor::Report(const struct ShardResult &result) {
+  if (report_fd_ < 0)
+    return;
+  if (!WriteAll(report_fd_, &result, sizeof(result)))
+    logprintf(0, "Log: Can't report shard results: %s\n",
+              ErrorString(errno).c_str());
+  close(report_fd_);
+  report_fd_ = -1;
+}
+
+void ShardSupervisor::ForwardSignal(int signum) {
+  for (int i = 0; i < shard_count; i++)
+    kill(shard_pids[i], signum);
+}
+
+void ShardSupervisor::KillAll() {
+  for (size_t i = 0; i < pids_.size(); i++)
+    kill(pids_[i], SIGTERM);
+  for (size_t i = 0; i < pids_.size(); i++) {
+    while (waitpid(pids_[i], NULL, 0) < 0 && errno == EINTR) {}
+    close(fds_[i]);
+  }
+  pids_.clear();
+  fds_.clear();
+  shard_count = 0;
+}
+
+int ShardSupervisor::Wait() {
+  struct ShardResult total;
+  memset(&total, 0, sizeof(total));
+  for (size_t i = 0; i < pids_.size(); i++) {
+    struct ShardResult result;
+    bool reported = ReadAll(fds_[i], &result, sizeof(result));
+    close(fds_[i]);
+    fds_[i] = -1;
+
+    int status = 0;
+    while (waitpid(pids_[i], &status, 0) < 0 && errno == EINTR) {}
+    if (WIFSIGNALED(status)) {
+      logprintf(0, "Process Error: Shard %d on node %d killed by signal %d\n",
+                static_cast<int>(i), nodes_[i].node, WTERMSIG(status));
+      total.status++;
+    } else if (!reported) {
+      logprintf(0, "Process Error: Shard %d on node %d exited with %d "
+                   "before reporting its results\n",
+                static_cast<int>(i), nodes_[i].node, WEXITSTATUS(status));
+      total.status++;
+    }
+    if (!reported)
+      continue;
+
+    logprintf(4, "Stats: Shard %d on node %d: %.2fM, "
+                 "with %lld hardware incidents, %lld errors\n",
+              static_cast<int>(i), nodes_[i].node, result.data,
+              result.errors, result.status);
+    total.pages += result.pages;
+    total.errors += result.errors;
+    total.status += result.status;
+    total.data += result.data;
+  }
+  shard_count = 0;
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+
+  // Includes each shard's setup, which is short next to the run.
+  double seconds = (sat_get_time_us() - start_us_) / 1000000.;
+  logprintf(0, "Stats: Completed %d shards: %.2fM in %.2fs %.2fMB/s, "
+               "with %lld hardware incidents, %lld errors\n",
+            shards(), total.data, seconds,
+            seconds > 0 ? total.data / seconds : 0., total.errors,
+            total.status);
+  logprintf(4, "\n");
+  if (total.status) {
+    logprintf(4, "Status: FAIL - test encountered procedural errors\n");
+  } else if (total.errors) {
+    logprintf(4, "Status: FAIL - test discovered HW problems\n");
+  } else {
+    logprintf(4, "Status: PASS - please verify no corrected errors\n");
+  }
+  logprintf(4, "\n");
+  return (total.status || total.errors) ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Supervisor for running one stressapptest process per NUMA node.
+
+#ifndef STRESSAPPTEST_SHARD_H_
+#define STRESSAPPTEST_SHARD_H_
+
+#include <sched.h>
+#include <sys/types.h>
+#include <vector>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// A NUMA node and its cpus.
+struct ShardNode {
+  int node;
+  cpu_set_t cpus;
+};
+
+// What a shard sends back to the supervisor when it's done.
+struct ShardResult {
+  int64 pages;
+  int64 errors;                     // Hardware incidents.
+  int64 status;                     // Procedural errors.
+  double data;                      // In MB.
+};
+
+// Forks one shard per node. Each shard is bound to the cpus and memory of
+// its node, so the shards share no queue, allocation or mm locks. The
+// supervisor forwards SIGINT and SIGTERM to them and merges their results.
+//
+// Not threadsafe. Spawn() must be called before any other thread starts.
+class ShardSupervisor {
+ public:
+  ShardSupervisor();
+  ~ShardSupervisor();
+
+  // Find the online NUMA nodes that have cpus. Returns false if the layout
+  // can't be read.
+  bool FindNodes();
+  int shards() const { return nodes_.size(); }
+  const struct ShardNode &node(int shard) const { return nodes_[shard]; }
+
+  // Fork one child per node. Sets 'shard' to the shard number in each
+  // child, which goes on to do the run, and to -1 in the supervisor.
+  // Returns false if not every child could be started.
+  bool Spawn(int *shard);
+
+  // In a shard: keep the process on the cpus and memory of its node.
+  // Returns false if neither can be set.
+  bool Bind(int shard);
+  // In a shard: send 'result' to the supervisor.
+  void Report(const struct ShardResult &result);
+
+  // In the supervisor: wait for every shard and print their merged
+  // results. Returns the exit status.
+  int Wait();
+
+ private:
+  // Send SIGINT or SIGTERM on to every shard.
+  static void ForwardSignal(int signum);
+  // Stop and reap the shards started so far.
+  void KillAll();
+
+  vector<struct ShardNode> nodes_;
+  vector<pid_t> pids_;
+  vector<int> fds_;                 // Read end of each shard's result pipe.
+  int report_fd_;                   // Write end in a shard, else -1.
+  int64 start_us_;                  // When the shards were started.
+
+  DISALLOW_COPY_AND_ASSIGN(ShardSupervisor);
+};
+
+#endif  // STRESSAPPTEST_SHARD_H_
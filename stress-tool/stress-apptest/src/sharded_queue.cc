@@ -0,0 +1,395 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This is an interface to a lock-free, sharded container of page entries,
+// used to hold data blocks and patterns.
+
+#include <sched.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sharded_queue.h"
+#include "os.h"
+#include "prng.h"
+
+// Sharded page entry queue implementation follows.
+// As in FineLockPEQueue the 'queue' is an array of page entries which is
+// never reordered. Get functions claim a random entry of the requested type
+// and Put functions hand it back. Instead of a mutex, each entry has a state
+// word which is moved between empty/valid and owned with compare-and-swap,
+// so claiming a page is a single atomic operation and costs 4 bytes per page.
+//
+// The array is split into contiguous shards, roughly one per cpu. Threads
+// search the shard belonging to their current cpu first and only move on to
+// other shards when it has nothing suitable.
+
+namespace {
+// Don't bother sharding below this many page entries per shard.
+const uint64 kMinShardLength = 16;
+
+uint64 Gcd(uint64 a, uint64 b) {
+  while (b) {
+    uint64 t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+}  // namespace
+
+// Constructor: Allocates memory and lays out shards.
+ShardedPEQueue::ShardedPEQueue(uint64 queuesize, int64 pagesize,
+                               int32 shards)
+    : pages_(queuesize, pagesize) {
+  q_size_ = queuesize;
+  page_size_ = pagesize;
+  states_ = new uint32[q_size_];
+
+  // Pages start out owned by Sat::InitializePages, as they are in
+  // FineLockPEQueue. They become available once inserted with a Put call.
+  for (uint64 i = 0; i < q_size_; i++)
+    states_[i] = kSlotOwned;
+
+  if (shards < 1)
+    shards = 1;
+  if (static_cast<uint64>(shards) > q_size_ / kMinShardLength)
+    shards = q_size_ / kMinShardLength;
+  if (shards < 1)
+    shards = 1;
+
+  shard_length_ = (q_size_ + shards - 1) / shards;
+  if (shard_length_ == 0)
+    shard_length_ = 1;
+  // Rounding up the length may leave trailing shards with nothing in them.
+  shard_count_ = (q_size_ + shard_length_ - 1) / shard_length_;
+  if (shard_count_ < 1)
+    shard_count_ = 1;
+
+  shards_ = new struct Shard[shard_count_];
+  for (int32 i = 0; i < shard_count_; i++) {
+    struct Shard *shard = &shards_[i];
+    shard->first = i * shard_length_;
+    shard->count = q_size_ - shard->first;
+    if (shard->count > shard_length_)
+      shard->count = shard_length_;
+    shard->nempty = 0;
+    shard->nvalid = 0;
+    shard->tags = 0;
+
+    // Step through the shard with a stride coprime to its length, so that
+    // every entry is visited, without the bunching a sequential scan causes
+    // around runs of same-state pages.
+    uint64 stride = 1;
+    if (shard->count > 2) {
+      stride = (shard->count * 5) / 8;
+      while (Gcd(stride, shard->count) != 1)
+        stride++;
+    }
+    shard->stride = stride;
+  }
+
+  logprintf(12, "Log: Sharded queue: %lld pages in %d shards of %lld\n",
+            q_size_, shard_count_, shard_length_);
+}
+
+// Destructor: Clean-up allocated memory.
+ShardedPEQueue::~ShardedPEQueue() {
+  delete[] shards_;
+  delete[] states_;
+}
+
+bool ShardedPEQueue::QueueAnalysis() {
+  uint64 buckets[32];
+
+  // Buckets for each log2 access counts.
+  for (int b = 0; b < 32; b++) {
+    buckets[b] = 0;
+  }
+
+  // Bucketize the page counts by highest bit set.
+  for (uint64 i = 0; i < q_size_; i++) {
+    uint32 readcount = pages_.touch(i);
+    int b = 0;
+    for (b = 0; b < 31; b++) {
+      if (readcount < (1u << b))
+        break;
+    }
+
+    buckets[b]++;
+  }
+
+  logprintf(12, "Log:  Reads per page histogram\n");
+  for (int b = 0; b < 32; b++) {
+    if (buckets[b])
+      logprintf(12, "Log:  %12d - %12d: %12d\n",
+          ((1 << b) >> 1), 1 << b, buckets[b]);
+  }
+
+  for (int32 i = 0; i < shard_count_; i++) {
+    logprintf(12, "Log:  Shard %d: %lld empty, %lld valid, tags %#x\n",
+              i, shards_[i].nempty, shards_[i].nvalid, shards_[i].tags);
+  }
+
+  return true;
+}
+
+namespace {
+// Callback mechanism for exporting last action.
+OsLayer *g_os;
+ShardedPEQueue *g_shqueue = 0;
+
+// Global callback to hook into Os object.
+bool err_log_callback(uint64 paddr, string *buf) {
+  if (g_shqueue) {
+    return g_shqueue->ErrorLogCallback(paddr, buf);
+  }
+  return false;
+}
+}
+
+// Setup global state for exporting callback.
+void ShardedPEQueue::set_os(OsLayer *os) {
+  g_os = os;
+  g_shqueue = this;
+}
+
+OsLayer::ErrCallback ShardedPEQueue::get_err_log_callback() {
+  return err_log_callback;
+}
+
+// This call is used to export last transaction info on a particular physical
+// address.
+bool ShardedPEQueue::ErrorLogCallback(uint64 paddr, string *message) {
+  struct page_entry pe;
+  OsLayer *os = g_os;
+  sat_assert(g_os);
+  char buf[256];
+
+  // Find the page of this paddr.
+  int gotpage = GetPageFromPhysical(paddr, &pe);
+  if (!gotpage) {
+    return false;
+  }
+
+  // Find offset into the page.
+  uint64 addr_diff = paddr - pe.paddr;
+
+  // Find vaddr of this paddr. Make sure it matches,
+  // as sometimes virtual memory is not contiguous.
+  char *vaddr =
+    reinterpret_cast<char*>(os->PrepareTestMem(pe.offset, page_size_));
+  uint64 new_paddr = os->VirtualToPhysical(vaddr + addr_diff);
+  os->ReleaseTestMem(vaddr, pe.offset, page_size_);
+
+  // Is the physical address at this page offset the same as
+  // the physical address we were given?
+  if (new_paddr != paddr) {
+    return false;
+  }
+
+  // Print all the info associated with this page.
+  message->assign(" (Last Transaction:");
+
+  if (pe.lastpattern) {
+    int offset = addr_diff / 8;
+    datacast_t data;
+
+    data.l32.l = pe.lastpattern->pattern(offset << 1);
+    data.l32.h = pe.lastpattern->pattern((offset << 1) + 1);
+
+    snprintf(buf, sizeof(buf), " %s data=%#016llx",
+                  pe.lastpattern->name(), data.l64);
+    message->append(buf);
+  }
+  snprintf(buf, sizeof(buf), " tsc=%#llx)", pe.ts);
+  message->append(buf);
+  return true;
+}
+
+bool ShardedPEQueue::GetPageFromPhysical(uint64 paddr,
+                                         struct page_entry *pe) {
+  // The reverse pagemap index finds the page directly.
+  if (g_os) {
+    int64 offset = g_os->FindTestMemOffset(paddr);
+    if (offset >= 0 && valid_index(offset / page_size_)) {
+      pages_.Load(offset / page_size_, pe);
+      return true;
+    }
+  }
+
+  // Traverse through array until finding a page
+  // that contains the address we want..
+  for (uint64 i = 0; i < q_size_; i++) {
+    uint64 page_addr = pages_.paddr(i);
+    // This assumes linear vaddr.
+    if ((page_addr <= paddr) && (page_addr + page_size_ > paddr)) {
+      pages_.Load(i, pe);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Threads are expected to be pinned, so the current cpu is a stable
+// choice of shard that keeps different threads apart.
+int32 ShardedPEQueue::HomeShard() {
+  int cpu = sched_getcpu();
+  if (cpu < 0)
+    cpu = 0;
+  return cpu % shard_count_;
+}
+
+// Claim a random page entry in 'state' from one shard.
+//
+// Setting tag to a value other than kDontCareTag (-1)
+// indicates that we need a tag match, otherwise any tag will do.
+//
+// Returns true on success, false on failure.
+bool ShardedPEQueue::GetFromShard(struct Shard *shard, struct page_entry *pe,
+                                  uint32 state, int32 tag) {
+  volatile int64 *counter =
+    (state == kSlotValid) ? &shard->nvalid : &shard->nempty;
+  if (*counter <= 0)
+    return false;
+  if ((tag != kDontCareTag) && !(shard->tags & tag))
+    return false;
+
+  uint64 position = Prng::ThreadPrng()->Below(shard->count);
+
+  for (uint64 i = 0; i < shard->count; i++) {
+    uint64 index = shard->first + position;
+    position += shard->stride;
+    if (position >= shard->count)
+      position %= shard->count;
+
+    // Plain reads first, the CAS pulls the line in exclusive.
+    if (states_[index] != state)
+      continue;
+    if ((tag != kDontCareTag) && !(pages_.tag(index) & tag))
+      continue;
+
+    if (__sync_bool_compare_and_swap(&states_[index], state, kSlotOwned)) {
+      __sync_fetch_and_sub(counter, 1);
+      pages_.Load(index, pe);
+      // Measure number of times each page is read.
+      if (state == kSlotValid)
+        pe->touch++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ShardedPEQueue::GetWithState(struct page_entry *pe, uint32 state,
+                                  int32 tag) {
+  if (!pe || !q_size_)
+    return false;
+
+  int32 home = HomeShard();
+  for (int32 i = 0; i < shard_count_; i++) {
+    if (GetFromShard(&shards_[(home + i) % shard_count_], pe, state, tag))
+      return true;
+  }
+  return false;
+}
+
+bool ShardedPEQueue::ClaimPage(int64 index, bool valid, int32 tag,
+                               struct page_entry *pe) {
+  if (!pe || !valid_index(index))
+    return false;
+  uint32 state = valid ? kSlotValid : kSlotEmpty;
+  if (states_[index] != state)
+    return false;
+  if ((tag != kDontCareTag) && !(pages_.tag(index) & tag))
+    return false;
+  if (!__sync_bool_compare_and_swap(&states_[index], state, kSlotOwned))
+    return false;
+
+  struct Shard *shard = &shards_[index / shard_length_];
+  __sync_fetch_and_sub(valid ? &shard->nvalid : &shard->nempty, 1);
+  pages_.Load(index, pe);
+  if (valid)
+    pe->touch++;
+  return true;
+}
+
+// Store the page entry, then make it available in 'state'.
+//
+// Returns true on success, false if the page wasn't owned by the caller.
+bool ShardedPEQueue::Release(struct page_entry *pe, uint32 state) {
+  if (!pe || !q_size_)
+    return false;
+
+  int64 index = pe->offset / page_size_;
+  if (!valid_index(index))
+    return false;
+
+  struct Shard *shard = &shards_[index / shard_length_];
+  // Enforce that an empty page entry is indeed empty.
+  pages_.Store(index, pe, state == kSlotValid);
+  if (pe->tag != kDontCareTag)
+    __sync_fetch_and_or(&shard->tags, pe->tag);
+
+  // Count the page before publishing it so the hint never underflows.
+  volatile int64 *counter =
+    (state == kSlotValid) ? &shard->nvalid : &shard->nempty;
+  __sync_fetch_and_add(counter, 1);
+  if (!__sync_bool_compare_and_swap(&states_[index], kSlotOwned, state)) {
+    __sync_fetch_and_sub(counter, 1);
+    logprintf(0, "Process Error: page %lld released while not owned\n",
+              index);
+    return false;
+  }
+  return true;
+}
+
+// GetValid() randomly finds a valid page, claims it and returns page entry by
+// pointer.
+//
+// Returns true on success, false on failure.
+bool ShardedPEQueue::GetValid(struct page_entry *pe) {
+  return GetWithState(pe, kSlotValid, kDontCareTag);
+}
+
+bool ShardedPEQueue::GetValid(struct page_entry *pe, int32 mask) {
+  return GetWithState(pe, kSlotValid, mask);
+}
+
+// GetEmpty() randomly finds an empty page, claims it and returns page entry by
+// pointer.
+//
+// Returns true on success, false on failure.
+bool ShardedPEQueue::GetEmpty(struct page_entry *pe, int32 mask) {
+  return GetWithState(pe, kSlotEmpty, mask);
+}
+bool ShardedPEQueue::GetEmpty(struct page_entry *pe) {
+  return GetWithState(pe, kSlotEmpty, kDontCareTag);
+}
+
+// PutEmpty puts an empty page back into the queue, making it available.
+//
+// Returns true on success, false on failure.
+bool ShardedPEQueue::PutEmpty(struct page_entry *pe) {
+  return Release(pe, kSlotEmpty);
+}
+
+// PutValid puts a valid page back into the queue, making it available.
+//
+// Returns true on success, false on failure.
+bool ShardedPEQueue::PutValid(struct page_entry *pe) {
+  if (!pe || pe->pattern == NULL)
+    return false;
+  return Release(pe, kSlotValid);
+}
@@ -0,0 +1,112 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This page entry queue implementation replaces the per-page mutexes of
+// FineLockPEQueue with an atomic state word per page entry, and splits the
+// entries into shards so that threads on different cpus mostly search
+// disjoint parts of the queue.
+
+#ifndef STRESSAPPTEST_SHARDED_QUEUE_H_
+#define STRESSAPPTEST_SHARDED_QUEUE_H_
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+#include "page_table.h"
+#include "pattern.h"
+#include "queue.h"     // Using page_entry struct.
+#include "os.h"
+
+// This is a threadsafe randomized queue of pages, claimed and released with
+// compare-and-swap on a per-page state word instead of a lock.
+class ShardedPEQueue {
+ public:
+  ShardedPEQueue(uint64 queuesize, int64 pagesize, int32 shards);
+  ~ShardedPEQueue();
+
+  // Put and get functions for page entries.
+  bool GetEmpty(struct page_entry *pe);
+  bool GetValid(struct page_entry *pe);
+  bool PutEmpty(struct page_entry *pe);
+  bool PutValid(struct page_entry *pe);
+
+  // Put and get functions for page entries, selecting on tags.
+  bool GetEmpty(struct page_entry *pe, int32 tag);
+  bool GetValid(struct page_entry *pe, int32 tag);
+
+  // Get the page at 'index' if it is available and valid (or empty) with a
+  // matching tag, for building spans of consecutive pages.
+  bool ClaimPage(int64 index, bool valid, int32 tag, struct page_entry *pe);
+
+  bool QueueAnalysis();
+  bool GetPageFromPhysical(uint64 paddr, struct page_entry *pe);
+  void set_os(OsLayer *os);
+  OsLayer::ErrCallback get_err_log_callback();
+  bool ErrorLogCallback(uint64 paddr, string *buf);
+
+ private:
+  // State of each page entry slot. An owned slot is held by a worker thread
+  // (or by Sat::InitializePages before it is first inserted) and must not
+  // be handed out.
+  enum SlotState {
+    kSlotOwned = 0,
+    kSlotEmpty = 1,
+    kSlotValid = 2
+  };
+
+  // A contiguous range of page entries. Counters and tag mask are only
+  // hints used to skip shards that can't satisfy a request, they may be
+  // transiently stale. Padded so that shards don't share a cacheline.
+  struct Shard {
+    uint64 first;              // Index of first page entry in this shard.
+    uint64 count;              // Number of page entries in this shard.
+    uint64 stride;             // Probe step, coprime with 'count'.
+    volatile int64 nempty;     // Approximate number of empty entries.
+    volatile int64 nvalid;     // Approximate number of valid entries.
+    volatile int32 tags;       // Union of tags ever inserted in this shard.
+    char padding[12];
+  };
+
+  // Helper function to check index range, returns true if index is valid.
+  bool valid_index(int64 index) {
+    return index >= 0 && static_cast<uint64>(index) < q_size_;
+  }
+
+  // Pick the shard a thread running on the current cpu searches first.
+  int32 HomeShard();
+
+  // Try to claim a page in 'state' with a matching tag from one shard.
+  bool GetFromShard(struct Shard *shard, struct page_entry *pe,
+                    uint32 state, int32 tag);
+
+  // Search all shards, starting with the home shard.
+  bool GetWithState(struct page_entry *pe, uint32 state, int32 tag);
+
+  // Store page entry and hand ownership of the slot back to the queue.
+  bool Release(struct page_entry *pe, uint32 state);
+
+  PageTable pages_;              // Where page entries are held.
+  volatile uint32 *states_;      // Per-page-entry SlotState.
+  struct Shard *shards_;         // Shard descriptors.
+  int32 shard_count_;            // Number of shards.
+  uint64 shard_length_;          // Page entries per shard, except the last.
+  uint64 q_size_;                // Size of the queue.
+  int64 page_size_;              // For calculating array index from offset.
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedPEQueue);
+};
+
+#endif  // STRESSAPPTEST_SHARDED_QUEUE_H_
@@ -0,0 +1,382 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This is an interface to a thread safe container with separate free lists
+// for empty and valid pages, used to hold data blocks and patterns.
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "split_queue.h"
+#include "os.h"
+
+// Page index ring implementation follows.
+// Cell 'i' is free for the producer at position 'p' when seq == p, and holds
+// data for the consumer at position 'p' when seq == p + 1. A consumer hands
+// the cell back to the producer of the next lap by setting seq to
+// p + capacity. Sequence numbers are kept modulo 2^32 so that a cell is
+// only 8 bytes, which is fine as long as the capacity is below 2^31.
+
+PageIndexRing::PageIndexRing(uint64 capacity) {
+  uint64 size = 2;
+  while (size < capacity)
+    size <<= 1;
+  sat_assert(size <= (1ULL << 31));
+  cells_ = new struct Cell[size];
+  for (uint64 i = 0; i < size; i++) {
+    cells_[i].seq = i;
+    cells_[i].page = 0;
+  }
+  mask_ = size - 1;
+  push_pos_ = 0;
+  pop_pos_ = 0;
+}
+
+PageIndexRing::~PageIndexRing() {
+  delete[] cells_;
+}
+
+bool PageIndexRing::Push(PageHandle page) {
+  uint64 pos = push_pos_;
+  while (true) {
+    struct Cell *cell = &cells_[pos & mask_];
+    uint32 seq = cell->seq;
+    int32 diff = static_cast<int32>(seq - static_cast<uint32>(pos));
+    if (diff == 0) {
+      if (__sync_bool_compare_and_swap(&push_pos_, pos, pos + 1)) {
+        cell->page = page;
+        __sync_synchronize();
+        cell->seq = pos + 1;
+        return true;
+      }
+      pos = push_pos_;
+    } else if (diff < 0) {
+      // A full lap behind: the ring is full.
+      return false;
+    } else {
+      pos = push_pos_;
+    }
+  }
+}
+
+bool PageIndexRing::Pop(PageHandle *page) {
+  uint64 pos = pop_pos_;
+  while (true) {
+    struct Cell *cell = &cells_[pos & mask_];
+    uint32 seq = cell->seq;
+    int32 diff = static_cast<int32>(seq - static_cast<uint32>(pos + 1));
+    if (diff == 0) {
+      if (__sync_bool_compare_and_swap(&pop_pos_, pos, pos + 1)) {
+        *page = cell->page;
+        __sync_synchronize();
+        cell->seq = pos + mask_ + 1;
+        return true;
+      }
+      pos = pop_pos_;
+    } else if (diff < 0) {
+      // Nothing published here yet: the ring is empty.
+      return false;
+    } else {
+      pos = pop_pos_;
+    }
+  }
+}
+
+// Split page entry queue implementation follows.
+// Page entries live in an array indexed by offset, as in FineLockPEQueue,
+// but availability is tracked by pushing the index of each page onto either
+// an empty or a valid list instead of by locking it in place. A Get pops one
+// index, a Put pushes it back, so neither has to probe past pages of the
+// wrong kind.
+//
+// Each distinct tag value gets its own pair of lists, so NUMA tagged
+// requests only look at lists whose tag matches.
+
+// Constructor: Allocates memory and initialize locks.
+SplitPEQueue::SplitPEQueue(uint64 queuesize, int64 pagesize)
+    : pages_(queuesize, pagesize) {
+  q_size_ = queuesize;
+  page_size_ = pagesize;
+
+  for (int i = 0; i < kMaxTagLists; i++) {
+    lists_[i].tag = 0;
+    lists_[i].empty = 0;
+    lists_[i].valid = 0;
+  }
+  list_count_ = 0;
+  next_list_ = 0;
+  pthread_mutex_init(&list_lock_, NULL);
+}
+
+// Destructor: Clean-up allocated memory and destroy pthread locks.
+SplitPEQueue::~SplitPEQueue() {
+  for (int i = 0; i < list_count_; i++) {
+    delete lists_[i].empty;
+    delete lists_[i].valid;
+  }
+  pthread_mutex_destroy(&list_lock_);
+}
+
+bool SplitPEQueue::QueueAnalysis() {
+  uint64 buckets[32];
+
+  // Buckets for each log2 access counts.
+  for (int b = 0; b < 32; b++) {
+    buckets[b] = 0;
+  }
+
+  // Bucketize the page counts by highest bit set.
+  for (uint64 i = 0; i < q_size_; i++) {
+    uint32 readcount = pages_.touch(i);
+    int b = 0;
+    for (b = 0; b < 31; b++) {
+      if (readcount < (1u << b))
+        break;
+    }
+
+    buckets[b]++;
+  }
+
+  logprintf(12, "Log:  Reads per page histogram\n");
+  for (int b = 0; b < 32; b++) {
+    if (buckets[b])
+      logprintf(12, "Log:  %12d - %12d: %12d\n",
+          ((1 << b) >> 1), 1 << b, buckets[b]);
+  }
+
+  return true;
+}
+
+namespace {
+// Callback mechanism for exporting last action.
+OsLayer *g_os;
+SplitPEQueue *g_spqueue = 0;
+
+// Global callback to hook into Os object.
+bool err_log_callback(uint64 paddr, string *buf) {
+  if (g_spqueue) {
+    return g_spqueue->ErrorLogCallback(paddr, buf);
+  }
+  return false;
+}
+}
+
+// Setup global state for exporting callback.
+void SplitPEQueue::set_os(OsLayer *os) {
+  g_os = os;
+  g_spqueue = this;
+}
+
+OsLayer::ErrCallback SplitPEQueue::get_err_log_callback() {
+  return err_log_callback;
+}
+
+// This call is used to export last transaction info on a particular physical
+// address.
+bool SplitPEQueue::ErrorLogCallback(uint64 paddr, string *message) {
+  struct page_entry pe;
+  OsLayer *os = g_os;
+  sat_assert(g_os);
+  char buf[256];
+
+  // Find the page of this paddr.
+  int gotpage = GetPageFromPhysical(paddr, &pe);
+  if (!gotpage) {
+    return false;
+  }
+
+  // Find offset into the page.
+  uint64 addr_diff = paddr - pe.paddr;
+
+  // Find vaddr of this paddr. Make sure it matches,
+  // as sometimes virtual memory is not contiguous.
+  char *vaddr =
+    reinterpret_cast<char*>(os->PrepareTestMem(pe.offset, page_size_));
+  uint64 new_paddr = os->VirtualToPhysical(vaddr + addr_diff);
+  os->ReleaseTestMem(vaddr, pe.offset, page_size_);
+
+  // Is the physical address at this page offset the same as
+  // the physical address we were given?
+  if (new_paddr != paddr) {
+    return false;
+  }
+
+  // Print all the info associated with this page.
+  message->assign(" (Last Transaction:");
+
+  if (pe.lastpattern) {
+    int offset = addr_diff / 8;
+    datacast_t data;
+
+    data.l32.l = pe.lastpattern->pattern(offset << 1);
+    data.l32.h = pe.lastpattern->pattern((offset << 1) + 1);
+
+    snprintf(buf, sizeof(buf), " %s data=%#016llx",
+                  pe.lastpattern->name(), data.l64);
+    message->append(buf);
+  }
+  snprintf(buf, sizeof(buf), " tsc=%#llx)", pe.ts);
+  message->append(buf);
+  return true;
+}
+
+bool SplitPEQueue::GetPageFromPhysical(uint64 paddr,
+                                       struct page_entry *pe) {
+  // The reverse pagemap index finds the page directly.
+  if (g_os) {
+    int64 offset = g_os->FindTestMemOffset(paddr);
+    if (offset >= 0 && valid_index(offset / page_size_)) {
+      pages_.Load(offset / page_size_, pe);
+      return true;
+    }
+  }
+
+  // Traverse through array until finding a page
+  // that contains the address we want..
+  for (uint64 i = 0; i < q_size_; i++) {
+    uint64 page_addr = pages_.paddr(i);
+    // This assumes linear vaddr.
+    if ((page_addr <= paddr) && (page_addr + page_size_ > paddr)) {
+      pages_.Load(i, pe);
+      return true;
+    }
+  }
+  return false;
+}
+
+// New tag values only show up while Sat::InitializePages tags pages by
+// region, so the lock is off the hot path. Published entries are never
+// modified, readers only need list_count_ to be read after the entry.
+struct SplitPEQueue::TagList *SplitPEQueue::FindTagList(int32 tag) {
+  int count = list_count_;
+  for (int i = 0; i < count; i++) {
+    if (lists_[i].tag == tag)
+      return &lists_[i];
+  }
+
+  struct TagList *list = 0;
+  pthread_mutex_lock(&list_lock_);
+  for (int i = 0; i < list_count_; i++) {
+    if (lists_[i].tag == tag) {
+      list = &lists_[i];
+      break;
+    }
+  }
+  if (!list && list_count_ < kMaxTagLists) {
+    list = &lists_[list_count_];
+    list->tag = tag;
+    // Every page could end up in either list of this tag.
+    list->empty = new PageIndexRing(q_size_);
+    list->valid = new PageIndexRing(q_size_);
+    __sync_synchronize();
+    list_count_ = list_count_ + 1;
+  }
+  pthread_mutex_unlock(&list_lock_);
+
+  if (!list)
+    logprintf(0, "Process Error: too many page tags, can't add %#x\n", tag);
+  return list;
+}
+
+// Setting mask to a value other than kDontCareTag (-1)
+// indicates that we need a tag match, otherwise any tag will do.
+//
+// Returns true on success, false on failure.
+bool SplitPEQueue::GetFromLists(struct page_entry *pe, bool valid,
+                                int32 mask) {
+  if (!pe || !q_size_)
+    return false;
+
+  int count = list_count_;
+  if (count == 0)
+    return false;
+
+  // Rotate the starting list so untagged requests spread over regions.
+  int first = __sync_fetch_and_add(&next_list_, 1) % count;
+  for (int i = 0; i < count; i++) {
+    struct TagList *list = &lists_[(first + i) % count];
+    if ((mask != kDontCareTag) && !(list->tag & mask))
+      continue;
+
+    PageHandle index;
+    PageIndexRing *ring = valid ? list->valid : list->empty;
+    if (ring->Pop(&index)) {
+      pages_.Load(index, pe);
+      // Measure number of times each page is read.
+      if (valid)
+        pe->touch++;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SplitPEQueue::PutToList(struct page_entry *pe, bool valid) {
+  if (!pe || !q_size_)
+    return false;
+
+  int64 index = pe->offset / page_size_;
+  if (!valid_index(index))
+    return false;
+
+  struct TagList *list = FindTagList(pe->tag);
+  if (!list)
+    return false;
+
+  // Enforce that an empty page entry is indeed empty.
+  pages_.Store(index, pe, valid);
+
+  PageIndexRing *ring = valid ? list->valid : list->empty;
+  if (!ring->Push(index)) {
+    logprintf(0, "Process Error: page list for tag %#x is full\n", pe->tag);
+    return false;
+  }
+  return true;
+}
+
+// GetValid() pops a valid page and returns page entry by pointer.
+//
+// Returns true on success, false on failure.
+bool SplitPEQueue::GetValid(struct page_entry *pe) {
+  return GetFromLists(pe, true, kDontCareTag);
+}
+
+bool SplitPEQueue::GetValid(struct page_entry *pe, int32 mask) {
+  return GetFromLists(pe, true, mask);
+}
+
+// GetEmpty() pops an empty page and returns page entry by pointer.
+//
+// Returns true on success, false on failure.
+bool SplitPEQueue::GetEmpty(struct page_entry *pe, int32 mask) {
+  return GetFromLists(pe, false, mask);
+}
+bool SplitPEQueue::GetEmpty(struct page_entry *pe) {
+  return GetFromLists(pe, false, kDontCareTag);
+}
+
+// PutEmpty pushes an empty page onto the empty list for its tag.
+//
+// Returns true on success, false on failure.
+bool SplitPEQueue::PutEmpty(struct page_entry *pe) {
+  return PutToList(pe, false);
+}
+
+// PutValid pushes a valid page onto the valid list for its tag.
+//
+// Returns true on success, false on failure.
+bool SplitPEQueue::PutValid(struct page_entry *pe) {
+  if (!pe || pe->pattern == NULL)
+    return false;
+  return PutToList(pe, true);
+}
@@ -0,0 +1,123 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This page entry queue implementation keeps empty and valid pages in
+// separate lists, so retrieving a page of either kind doesn't depend on
+// how many pages of the other kind are in the queue.
+
+#ifndef STRESSAPPTEST_SPLIT_QUEUE_H_
+#define STRESSAPPTEST_SPLIT_QUEUE_H_
+
+#include <pthread.h>
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+#include "page_table.h"
+#include "pattern.h"
+#include "queue.h"     // Using page_entry struct.
+#include "os.h"
+
+// Bounded multi-producer multi-consumer FIFO of page handles.
+// Each cell carries a sequence number which tells producers and consumers
+// whether the cell is ready for them, so both sides only CAS their own
+// position counter.
+class PageIndexRing {
+ public:
+  explicit PageIndexRing(uint64 capacity);
+  ~PageIndexRing();
+
+  // Returns false if the ring is full.
+  bool Push(PageHandle page);
+  // Returns false if the ring is empty.
+  bool Pop(PageHandle *page);
+
+ private:
+  struct Cell {
+    volatile uint32 seq;
+    PageHandle page;
+  };
+
+  struct Cell *cells_;
+  uint64 mask_;                   // Capacity - 1, capacity is a power of 2.
+  char pad0_[64];
+  volatile uint64 push_pos_;      // Next cell to be filled.
+  char pad1_[64];
+  volatile uint64 pop_pos_;       // Next cell to be drained.
+  char pad2_[64];
+
+  DISALLOW_COPY_AND_ASSIGN(PageIndexRing);
+};
+
+// This is a threadsafe queue of pages with separate empty and valid lists,
+// and one pair of lists per distinct page tag, for worker threads to use.
+class SplitPEQueue {
+ public:
+  SplitPEQueue(uint64 queuesize, int64 pagesize);
+  ~SplitPEQueue();
+
+  // Put and get functions for page entries.
+  bool GetEmpty(struct page_entry *pe);
+  bool GetValid(struct page_entry *pe);
+  bool PutEmpty(struct page_entry *pe);
+  bool PutValid(struct page_entry *pe);
+
+  // Put and get functions for page entries, selecting on tags.
+  bool GetEmpty(struct page_entry *pe, int32 tag);
+  bool GetValid(struct page_entry *pe, int32 tag);
+
+  bool QueueAnalysis();
+  bool GetPageFromPhysical(uint64 paddr, struct page_entry *pe);
+  void set_os(OsLayer *os);
+  OsLayer::ErrCallback get_err_log_callback();
+  bool ErrorLogCallback(uint64 paddr, string *buf);
+
+ private:
+  // Pages with one tag value. Region tags are single bits, so there are
+  // at most 32 of these plus one for the untagged pages at startup.
+  static const int kMaxTagLists = 34;
+  struct TagList {
+    int32 tag;
+    PageIndexRing *empty;
+    PageIndexRing *valid;
+  };
+
+  // Helper function to check index range, returns true if index is valid.
+  bool valid_index(int64 index) {
+    return index >= 0 && static_cast<uint64>(index) < q_size_;
+  }
+
+  // Find the list pair for exactly this tag, creating it if needed.
+  struct TagList *FindTagList(int32 tag);
+
+  // Pop a page from any list pair whose tag matches 'mask'.
+  bool GetFromLists(struct page_entry *pe, bool valid, int32 mask);
+
+  // Store page entry and push its index on the right list.
+  bool PutToList(struct page_entry *pe, bool valid);
+
+  PageTable pages_;              // Where page entries are held.
+  uint64 q_size_;                // Size of the queue.
+  int64 page_size_;              // For calculating array index from offset.
+
+  struct TagList lists_[kMaxTagLists];
+  volatile int32 list_count_;    // Published list pairs in lists_.
+  pthread_mutex_t list_lock_;    // Serializes creation of list pairs.
+  volatile uint64 next_list_;    // Rotates the first list pair searched.
+
+  DISALLOW_COPY_AND_ASSIGN(SplitPEQueue);
+};
+
+#endif  // STRESSAPPTEST_SPLIT_QUEUE_H_
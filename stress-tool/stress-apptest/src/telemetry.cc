@@ -0,0 +1,119 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Telemetry line writer, see telemetry.h.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "telemetry.h"
+
+Telemetry::Telemetry() : socket_(false), fd_(-1) {
+}
+
+Telemetry::~Telemetry() {
+  Close();
+}
+
+bool Telemetry::Open(const char *target) {
+  Close();
+  size_t prefix = sizeof(kTelemetryUnixPrefix) - 1;
+  if (!strncmp(target, kTelemetryUnixPrefix, prefix)) {
+    socket_ = true;
+    target_ = target + prefix;
+    struct sockaddr_un addr;
+    if (target_.empty() || target_.size() >= sizeof(addr.sun_path)) {
+      target_.clear();
+      return false;
+    }
+    if (!Connect()) {
+      target_.clear();
+      return false;
+    }
+    return true;
+  }
+
+  socket_ = false;
+  fd_ = open(target, O_WRONLY | O_CREAT | O_APPEND,
+             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd_ < 0)
+    return false;
+  target_ = target;
+  return true;
+}
+
+void Telemetry::Close() {
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+  target_.clear();
+}
+
+bool Telemetry::Connect() {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, target_.c_str(), target_.size());
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+              sizeof(addr)) < 0) {
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+  return true;
+}
+
+bool Telemetry::WriteLine(const string &line) {
+  if (target_.empty())
+    return false;
+  if (fd_ < 0 && !(socket_ && Connect()))
+    return false;
+
+  string buf = line + "\n";
+  size_t done = 0;
+  while (done < buf.size()) {
+    ssize_t sent;
+    if (socket_) {
+      // Don't let a stalled reader hold up the main thread, or a closed
+      // one kill us with SIGPIPE.
+      sent = send(fd_, buf.data() + done, buf.size() - done,
+                  MSG_DONTWAIT | MSG_NOSIGNAL);
+    } else {
+      sent = write(fd_, buf.data() + done, buf.size() - done);
+    }
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0) {
+      // Drop the line. A partly sent line would garble the stream, so
+      // start over on a new connection.
+      if (socket_ && (done || (errno != EAGAIN && errno != EWOULDBLOCK))) {
+        close(fd_);
+        fd_ = -1;
+      }
+      return false;
+    }
+    done += sent;
+  }
+  return true;
+}
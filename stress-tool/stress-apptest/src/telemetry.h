@@ -0,0 +1,61 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//      http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Interval throughput telemetry, written with --telemetry as one JSON
+// object per line so that a fleet orchestrator can spot throttled or
+// underperforming machines while the test is still running.
+
+#ifndef STRESSAPPTEST_TELEMETRY_H_
+#define STRESSAPPTEST_TELEMETRY_H_
+
+#include <string>
+
+// This file must work with autoconf on its public version,
+// so these includes are correct.
+#include "sattypes.h"
+
+// Prefix of a telemetry target that names a unix stream socket.
+static const char kTelemetryUnixPrefix[] = "unix:";
+
+// Sink for telemetry lines, either a file or a unix socket that some other
+// process is listening on. Lines are dropped rather than blocking the
+// caller when a socket reader falls behind, and a socket that went away is
+// reconnected on the next write. Not threadsafe, only the main thread
+// reports.
+class Telemetry {
+ public:
+  Telemetry();
+  ~Telemetry();
+
+  // Opens 'target', a path or "unix:" followed by a socket path. Returns
+  // false on failure.
+  bool Open(const char *target);
+  void Close();
+  bool enabled() const { return !target_.empty(); }
+
+  // Writes 'line' followed by a newline. Returns false if it was dropped.
+  bool WriteLine(const string &line);
+
+ private:
+  // Connects to the socket at target_. Returns false on failure.
+  bool Connect();
+
+  string target_;   // Path of the file or socket, empty if not opened.
+  bool socket_;     // Target is a unix socket.
+  int fd_;          // Open file or connected socket, or -1.
+
+  DISALLOW_COPY_AND_ASSIGN(Telemetry);
+};
+
+#endif  // STRESSAPPTEST_TELEMETRY_H_
@@ -26,8 +26,12 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/times.h>
 
@@ -39,6 +43,7 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <linux/unistd.h>  // for gettid
+#include <linux/errqueue.h>  // for zero copy completions
 
 // For size of block device
 #include <sys/ioctl.h>
@@ -50,14 +55,18 @@
 
 #include <sys/syscall.h>
 
+#include <algorithm>
+#include <new>
 #include <set>
 #include <string>
 
 // This file must work with autoconf on its public version,
 // so these includes are correct.
+#include "cpu_kernels.h"  // NOLINT
 #include "error_diag.h"  // NOLINT
 #include "os.h"          // NOLINT
 #include "pattern.h"     // NOLINT
+#include "power_wave.h"  // NOLINT
 #include "queue.h"       // NOLINT
 #include "sat.h"         // NOLINT
 #include "sattypes.h"    // NOLINT
@@ -70,6 +79,15 @@
 #endif
 
 #define gettid() syscall(__NR_gettid)
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define STRESSAPPTEST_NET_ZEROCOPY 1
+#endif
+#ifndef MADV_NOHUGEPAGE
+#define MADV_NOHUGEPAGE  15
+#endif
+
 #if !defined(CPU_SETSIZE)
 _syscall3(int, sched_getaffinity, pid_t, pid,
           unsigned int, len, cpu_set_t*, mask)
@@ -99,6 +117,34 @@ namespace {
   inline uint64 addr_to_tag(void *address) {
     return reinterpret_cast<uint64>(address);
   }
+
+  // Words CheckRegion compares per call to FindMismatches.
+  const int kScanChunkWords = 4096;
+
+  // Compare 'words' words at 'mem' with 'pattern' from its word 'first'
+  // on, and set a bit in 'bits' for each word that differs. The pattern is
+  // read from its expanded block, and the tag mode is a template argument,
+  // so the untagged inner loop has no per word branches or lookups left
+  // for the compiler to unroll and vectorize around.
+  template <bool kTagged>
+  void FindMismatches(const uint64 *mem, const Pattern *pattern,
+                      uint64 first, int words, uint64 *bits) {
+    const uint64 *block = pattern->expected_block();
+    const int kBlockMask = Pattern::kExpandedWords - 1;
+    for (int group = 0; group < words; group += 64) {
+      int count = words - group < 64 ? words - group : 64;
+      uint64 group_bits = 0;
+      for (int j = 0; j < count; j++) {
+        const uint64 *addr = mem + group + j;
+        uint64 expected = block[(first + group + j) & kBlockMask];
+        // Each cacheline starts with its address.
+        if (kTagged && !(reinterpret_cast<uintptr_t>(addr) & 0x3f))
+          expected = reinterpret_cast<uint64>(addr);
+        group_bits |= static_cast<uint64>(*addr != expected) << j;
+      }
+      bits[group >> 6] = group_bits;
+    }
+  }
 }  // namespace
 
 #if !defined(O_DIRECT)
@@ -203,10 +249,10 @@ bool WorkerStatus::ContinueRunningNoPause() {
 }
 
 void WorkerStatus::RemoveSelf() {
-  // Acquire a read lock on status_rwlock_ while (status_ != PAUSE).
+  // Acquire a read lock on status_rwlock_ while (GetStatus() != PAUSE).
   for (;;) {
     AcquireStatusReadLock();
-    if (status_ != PAUSE)
+    if (GetStatus() != PAUSE)
       break;
     // We need to obey PauseWorkers() just like ContinueRunning() would, so that
     // the other threads won't wait on pause_barrier_ forever.
@@ -223,7 +269,7 @@ void WorkerStatus::RemoveSelf() {
   // ContinueRunning() to wait on this one.  Using a separate lock avoids that.
   AcquireNumWorkersLock();
   // Decrement num_workers_ and reinitialize pause_barrier_, which we know isn't
-  // in use because (status != PAUSE).
+  // in use because (GetStatus() != PAUSE).
 #ifdef HAVE_PTHREAD_BARRIERS
   sat_assert(0 == pthread_barrier_destroy(&pause_barrier_));
   sat_assert(0 == pthread_barrier_init(&pause_barrier_, NULL, num_workers_));
@@ -236,23 +282,103 @@ void WorkerStatus::RemoveSelf() {
 }
 
 
+WorkerStats *WorkerStats::Create() {
+  void *block;
+#ifdef HAVE_POSIX_MEMALIGN
+  int err_result = posix_memalign(&block, kCacheLineSize,
+                                  sizeof(WorkerStats));
+#else
+  block = memalign(kCacheLineSize, sizeof(WorkerStats));
+  int err_result = (block == 0);
+#endif
+  sat_assert(err_result == 0);
+  return new(block) WorkerStats();
+}
+
+void WorkerStats::Destroy(WorkerStats *stats) {
+  stats->~WorkerStats();
+  free(stats);
+}
+
+RateLimiter::RateLimiter(double mb_per_sec) {
+  mb_per_sec_ = mb_per_sec;
+  ns_per_mb_ = 1000000000. / mb_per_sec;
+  next_ns_ = sat_get_time_ns();
+}
+
+void RateLimiter::Consume(double mb) {
+  int64 cost = static_cast<int64>(mb * ns_per_mb_);
+  int64 now = sat_get_time_ns();
+  int64 due;
+  while (true) {
+    int64 prev = next_ns_;
+    int64 base = prev;
+    if (base < now - kBurstNs)
+      base = now - kBurstNs;
+    due = base + cost;
+    if (__sync_bool_compare_and_swap(&next_ns_, prev, due))
+      break;
+  }
+  // Ahead of the rate, wait until this data is due.
+  if (due > now) {
+    struct timespec ts;
+    ts.tv_sec = (due - now) / 1000000000LL;
+    ts.tv_nsec = (due - now) % 1000000000LL;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+  }
+}
+
 // Parent thread class.
 WorkerThread::WorkerThread() {
   status_ = false;
-  pages_copied_ = 0;
-  errorcount_ = 0;
+  stats_ = WorkerStats::Create();
   runduration_usec_ = 1;
   priority_ = Normal;
   worker_status_ = NULL;
   thread_spawner_ = &ThreadSpawnerGeneric;
   tag_mode_ = false;
+  crc32c_ = false;
+  nontemporal_fill_ = false;
+  parked_ = false;
+  rate_limiter_ = NULL;
+  throttled_data_ = 0;
+  cached_io_ = false;
+  cache_verified_ = false;
 }
 
-WorkerThread::~WorkerThread() {}
+bool WorkerThread::BypassPageCache(int fd, int64 offset, int64 length) {
+  // Still flush if another thread fell back to the global flush.
+  if (!cached_io_)
+    return os_->FlushPageCache();  // If O_DIRECT worked, this will be a NOP.
+  bool verify = !cache_verified_;
+  cache_verified_ = true;
+  if (os_->EvictFileCache(fd, offset, length, verify))
+    return true;
+  logprintf(3, "Log: thread %d can't drop its own pages from the page "
+            "cache, flushing all of it instead\n", thread_num_);
+  os_->ActivateFlushPageCache();
+  cached_io_ = false;
+  return os_->FlushPageCache();
+}
+
+WorkerThread::~WorkerThread() {
+  WorkerStats::Destroy(stats_);
+}
+
+void WorkerThread::Throttle() {
+  float data = GetMemoryCopiedData() + GetDeviceCopiedData();
+  float moved = data - throttled_data_;
+  throttled_data_ = data;
+  if (moved > 0)
+    rate_limiter_->Consume(moved);
+}
 
 // Constructors. Just init some default values.
 FillThread::FillThread() {
+  first_page_ = 0;
   num_pages_to_fill_ = 0;
+  nontemporal_fill_ = true;
 }
 
 // Initialize file name to empty.
@@ -263,6 +389,7 @@ FileThread::FileThread() {
   page_io_ = true;
   crc_page_ = -1;
   local_page_ = NULL;
+  sector_size_ = 512;
 }
 
 // If file thread used bounce buffer in memory, account for the extra
@@ -278,12 +405,28 @@ float FileThread::GetMemoryCopiedData() {
 NetworkThread::NetworkThread() {
   snprintf(ipaddr_, sizeof(ipaddr_), "Unknown");
   sock_ = 0;
+  zerocopy_ = false;
+  zerocopy_sent_ = 0;
+  zerocopy_done_ = 0;
+  zerocopy_copied_ = 0;
+  stream_usec_ = 0;
+  rdma_ = NULL;
 }
 
 // Initialize?
 NetworkSlaveThread::NetworkSlaveThread() {
 }
 
+NetworkEventThread::NetworkEventThread() {
+  epoll_fd_ = -1;
+  stop_ = false;
+  pthread_mutex_init(&pending_lock_, NULL);
+}
+
+NetworkEventThread::~NetworkEventThread() {
+  pthread_mutex_destroy(&pending_lock_);
+}
+
 // Initialize?
 NetworkListenThread::NetworkListenThread() {
 }
@@ -307,6 +450,10 @@ void WorkerThread::InitThread(int thread_num_init,
   tag_ = 0xffffffff;
 
   tag_mode_ = sat_->tag_mode();
+  crc32c_ = sat_->crc32c_checksum();
+  // Streams are handed out in the order threads are set up, which the
+  // same command line repeats.
+  prng_.Seed(Prng::NewStream());
 }
 
 
@@ -380,11 +527,13 @@ bool WorkerThread::JoinThread() {
 
 
 void WorkerThread::StartRoutine() {
+  Prng::SetThreadPrng(&prng_);
   InitPriority();
   StartThreadTimer();
   Work();
   StopThreadTimer();
   worker_status_->RemoveSelf();
+  Prng::SetThreadPrng(NULL);
 }
 
 
@@ -468,6 +617,9 @@ bool WorkerThread::YieldSelf() {
 
 // Fill this page with its pattern.
 bool WorkerThread::FillPage(struct page_entry *pe) {
+  // Size of the expanded pattern block, see Pattern::expected_block().
+  static const int kFillBlockSize = 4096;
+
   // Error check arguments.
   if (pe == 0) {
     logprintf(0, "Process Error: Fill Page entry null\n");
@@ -490,11 +642,21 @@ bool WorkerThread::FillPage(struct page_entry *pe) {
       if ((i & 0x7) == 0) {
         data.l64 = addr_to_tag(&memwords[i]);
       } else {
-        data.l32.l = pe->pattern->pattern(i << 1);
-        data.l32.h = pe->pattern->pattern((i << 1) + 1);
+        data.l64 = pe->pattern->word(i);
       }
       memwords[i] = data.l64;
     }
+  } else if (length % kFillBlockSize == 0) {
+    // Without tags every block holds the pattern's expanded first block,
+    // so fill with wide block copies.
+    const uint64 *block = pe->pattern->expected_block();
+    char *mem = static_cast<char*>(pe->addr);
+    for (int offset = 0; offset < length; offset += kFillBlockSize) {
+      if (nontemporal_fill_)
+        MemcpyNonTemporal(mem + offset, block, kFillBlockSize);
+      else
+        memcpy(mem + offset, block, kFillBlockSize);
+    }
   } else {
     // Just fill in untagged data directly.
     for (int i = 0; i < length / wordsize_; i++) {
@@ -510,9 +672,10 @@ bool WorkerThread::FillPage(struct page_entry *pe) {
 }
 
 
-// Tell the thread how many pages to fill.
-void FillThread::SetFillPages(int64 num_pages_to_fill_init) {
-  num_pages_to_fill_ = num_pages_to_fill_init;
+// Tell the thread which pages to fill.
+void FillThread::SetFillRange(int64 first_page, int64 num_pages) {
+  first_page_ = first_page;
+  num_pages_to_fill_ = num_pages;
 }
 
 // Fill this page with a random pattern.
@@ -551,12 +714,17 @@ bool FillThread::Work() {
   // stop when we've filled that many.
   // We also want to capture early break
   struct page_entry pe;
+  int64 page_length = sat_->page_length();
   int64 loops = 0;
   while (IsReadyToRun() && (loops < num_pages_to_fill_)) {
-    result = result && sat_->GetEmpty(&pe);
-    if (!result) {
-      logprintf(0, "Process Error: fill_thread failed to pop pages, "
+    // The pages are still owned by Sat::InitializePages, not queued yet.
+    init_pe(&pe);
+    pe.offset = (first_page_ + loops) * page_length;
+    pe.addr = os_->PrepareTestMem(pe.offset, page_length);
+    if (!pe.addr) {
+      logprintf(0, "Process Error: fill_thread failed to map page, "
                 "bailing\n");
+      result = false;
       break;
     }
 
@@ -572,13 +740,13 @@ bool FillThread::Work() {
       break;
     }
     loops++;
+    stats_->set_pages(loops);
   }
 
   // Fill in thread status.
-  pages_copied_ = loops;
   status_ = result;
   logprintf(9, "Log: Completed %d: Fill thread. Status %d, %d pages filled\n",
-            thread_num_, status_, pages_copied_);
+            thread_num_, status_, stats_->pages());
   return result;
 }
 
@@ -620,20 +788,23 @@ void WorkerThread::ProcessError(struct ErrorRecord *error,
                                               reinterpret_cast<uint64>
                                               (error->vaddr), 1);
 
-    logprintf(priority,
-              "%s: miscompare on CPU %d(<-%d) at %p(0x%llx:%s): "
-              "read:0x%016llx, reread:0x%016llx expected:0x%016llx. '%s'%s.\n",
-              message,
-              core_id,
-              error->lastcpu,
-              error->vaddr,
-              error->paddr,
-              dimm_string,
-              error->actual,
-              error->reread,
-              error->expected,
-              (error->patternname) ? error->patternname : "None",
-              (error->reread == error->expected) ? " read error" : "");
+    if (!LogBinaryError(kErrorKindMemory, error, message, core_id,
+                        dimm_string, NULL, NULL))
+      logprintf(priority,
+                "%s: miscompare on CPU %d(<-%d) at %p(0x%llx:%s): "
+                "read:0x%016llx, reread:0x%016llx expected:0x%016llx. "
+                "'%s'%s.\n",
+                message,
+                core_id,
+                error->lastcpu,
+                error->vaddr,
+                error->paddr,
+                dimm_string,
+                error->actual,
+                error->reread,
+                error->expected,
+                (error->patternname) ? error->patternname : "None",
+                (error->reread == error->expected) ? " read error" : "");
   }
 
 
@@ -690,18 +861,20 @@ void FileThread::ProcessError(struct ErrorRecord *error,
                                               (error->vaddr), 1);
   }
 
-  logprintf(priority,
-            "%s: miscompare on %s at %p(0x%llx:%s): read:0x%016llx, "
-            "reread:0x%016llx expected:0x%016llx\n",
-            message,
-            devicename_.c_str(),
-            error->vaddr,
-            error->paddr,
-            dimm_string,
-            error->actual,
-            error->reread,
-            error->expected,
-            (error->patternname) ? error->patternname : "None");
+  if (!LogBinaryError(kErrorKindFile, error, message, sched_getcpu(),
+                      dimm_string, NULL, devicename_.c_str()))
+    logprintf(priority,
+              "%s: miscompare on %s at %p(0x%llx:%s): read:0x%016llx, "
+              "reread:0x%016llx expected:0x%016llx\n",
+              message,
+              devicename_.c_str(),
+              error->vaddr,
+              error->paddr,
+              dimm_string,
+              error->actual,
+              error->reread,
+              error->expected,
+              (error->patternname) ? error->patternname : "None");
 
   // Overwrite incorrect data with correct data to prevent
   // future miscompares when this data is reused.
@@ -717,7 +890,8 @@ int WorkerThread::CheckRegion(void *addr,
                               uint32 lastcpu,
                               int64 length,
                               int offset,
-                              int64 pattern_offset) {
+                              int64 pattern_offset,
+                              const uint64 *mismatch) {
   uint64 *memblock = static_cast<uint64*>(addr);
   const int kErrorLimit = 128;
   int errors = 0;
@@ -727,17 +901,51 @@ int WorkerThread::CheckRegion(void *addr,
   struct ErrorRecord
     recorded[kErrorLimit];  // Queued errors for later printing.
 
+  // Patterns starting on a 64 bit word boundary can be looked up by word,
+  // and scanned a chunk at a time when the caller has no mismatch map.
+  bool word_aligned = !(pattern_offset & 1);
+  uint64 first_word = pattern_offset / 2;
+  bool scan = word_aligned && !mismatch;
+  uint64 chunk_bits[kScanChunkWords / 64];
+  int words = length / wordsize_;
+
   // For each word in the data region.
-  for (int i = 0; i < length / wordsize_; i++) {
+  for (int i = 0; i < words; i++) {
+    if (scan && !(i & (kScanChunkWords - 1))) {
+      int count = words - i < kScanChunkWords ? words - i : kScanChunkWords;
+      if (tag_mode_)
+        FindMismatches<true>(memblock + i, pattern, first_word + i, count,
+                             chunk_bits);
+      else
+        FindMismatches<false>(memblock + i, pattern, first_word + i, count,
+                              chunk_bits);
+    }
+
+    // Skip ahead to the next flagged word, if we already know.
+    if (mismatch || scan) {
+      uint64 bits = scan ?
+          chunk_bits[(i & (kScanChunkWords - 1)) >> 6] : mismatch[i >> 6];
+      bits >>= (i & 63);
+      if (!bits) {
+        i |= 63;
+        continue;
+      }
+      i += __builtin_ctzll(bits);
+    }
+
     uint64 actual = memblock[i];
     uint64 expected;
 
     // Determine the value that should be there.
-    datacast_t data;
-    int index = 2 * i + pattern_offset;
-    data.l32.l = pattern->pattern(index);
-    data.l32.h = pattern->pattern(index + 1);
-    expected = data.l64;
+    if (word_aligned) {
+      expected = pattern->word(first_word + i);
+    } else {
+      datacast_t data;
+      int index = 2 * i + pattern_offset;
+      data.l32.l = pattern->pattern(index);
+      data.l32.h = pattern->pattern(index + 1);
+      expected = data.l64;
+    }
     // Check tags if necessary.
     if (tag_mode_ && ((reinterpret_cast<uint64>(&memblock[i]) & 0x3f) == 0)) {
       expected = addr_to_tag(&memblock[i]);
@@ -849,7 +1057,7 @@ int WorkerThread::CheckRegion(void *addr,
   // Process error queue after all errors have been recorded.
   for (int err = 0; err < errors; err++) {
     int priority = 5;
-    if (errorcount_ + err < 30)
+    if (stats_->errors() + err < 30)
       priority = 0;  // Bump up the priority for the first few errors.
     ProcessError(&recorded[err], priority, errormessage.c_str());
   }
@@ -889,12 +1097,12 @@ int WorkerThread::CheckRegion(void *addr,
   }
 
   // Keep track of observed errors.
-  errorcount_ += errors + overflowerrors;
+  stats_->AddErrors(errors + overflowerrors);
   return errors + overflowerrors;
 }
 
 float WorkerThread::GetCopiedData() {
-  return pages_copied_ * sat_->page_length() / kMegabyte;
+  return stats_->pages() * sat_->page_length() / kMegabyte;
 }
 
 // Calculate the CRC of a region.
@@ -905,11 +1113,30 @@ int WorkerThread::CrcCheckPage(struct page_entry *srcpe) {
   int errors = 0;
 
   const AdlerChecksum *expectedcrc = srcpe->pattern->crc();
+  const uint64 *expectedblock = srcpe->pattern->expected_block();
   uint64 *memblock = static_cast<uint64*>(srcpe->addr);
   int blocks = sat_->page_length() / blocksize;
   for (int currentblock = 0; currentblock < blocks; currentblock++) {
     uint64 *memslice = memblock + currentblock * blockwords;
 
+    // Without tags every block holds the same data, so compare it directly
+    // and hand only the mismatching words to the slow path.
+    if (!tag_mode_) {
+      uint64 mismatch[blockwords / 64];
+      if (os_->PatternCompare(memslice, expectedblock, blockwords,
+                              mismatch)) {
+        logprintf(11, "Log: CrcCheckPage falling through to slow compare "
+                  "on block %d\n", currentblock);
+        errors += CheckRegion(memslice,
+                              srcpe->pattern,
+                              srcpe->lastcpu,
+                              blocksize,
+                              currentblock * blocksize, 0,
+                              mismatch);
+      }
+      continue;
+    }
+
     AdlerChecksum crc;
     if (tag_mode_) {
       AdlerAddrCrcC(memslice, blocksize, &crc, srcpe);
@@ -952,6 +1179,35 @@ int WorkerThread::CrcCheckPage(struct page_entry *srcpe) {
 }
 
 
+bool WorkerThread::LogBinaryError(uint16 kind,
+                                  const struct ErrorRecord *error,
+                                  const char *message, int core_id,
+                                  const char *dimm, const char *tag_dimm,
+                                  const char *device) {
+  ErrorLog *error_log = sat_->error_log();
+  if (!error_log->enabled())
+    return false;
+
+  struct ErrorLogMiscompare record;
+  memset(&record, 0, sizeof(record));
+  record.kind = kind;
+  record.thread = thread_num_;
+  record.cpu = core_id;
+  record.lastcpu = error->lastcpu;
+  record.vaddr = reinterpret_cast<uint64>(error->vaddr);
+  record.paddr = error->paddr;
+  if (kind == kErrorKindTag) {
+    record.tagvaddr = reinterpret_cast<uint64>(error->tagvaddr);
+    record.tagpaddr = error->tagpaddr;
+  }
+  record.expected = error->expected;
+  record.actual = error->actual;
+  record.reread = error->reread;
+  error_log->LogMiscompare(&record, message, error->patternname,
+                           dimm, tag_dimm, device);
+  return true;
+}
+
 // Print error information about a data miscompare.
 void WorkerThread::ProcessTagError(struct ErrorRecord *error,
                                    int priority,
@@ -985,7 +1241,9 @@ void WorkerThread::ProcessTagError(struct ErrorRecord *error,
   os_->FindDimm(error->tagpaddr, tag_dimm_string, sizeof(tag_dimm_string));
 
   // Report parseable error.
-  if (priority < 5) {
+  if (priority < 5 &&
+      !LogBinaryError(kErrorKindTag, error, message, core_id,
+                      dimm_string, tag_dimm_string, NULL)) {
     logprintf(priority,
               "%s: Tag from %p(0x%llx:%s) (%s) "
               "miscompare on CPU %d(0x%s) at %p(0x%llx:%s): "
@@ -1004,7 +1262,7 @@ void WorkerThread::ProcessTagError(struct ErrorRecord *error,
               error->expected);
   }
 
-  errorcount_ += 1;
+  stats_->AddErrors(1);
 
   // Overwrite incorrect data with correct data to prevent
   // future miscompares when this data is reused.
@@ -1068,8 +1326,7 @@ bool WorkerThread::AdlerAddrMemcpyC(uint64 *dstmem64,
       if (dstdata.l64 != dst_tag)
         ReportTagError(&dstmem64[i], dstdata.l64, dst_tag);
 
-      data.l32.l = pattern->pattern(i << 1);
-      data.l32.h = pattern->pattern((i << 1) + 1);
+      data.l64 = pattern->word(i);
       a1 = a1 + data.l32.l;
       b1 = b1 + a1;
       a1 = a1 + data.l32.h;
@@ -1178,8 +1435,7 @@ bool WorkerThread::AdlerAddrCrcC(uint64 *srcmem64,
       if (data.l64 != src_tag)
         ReportTagError(&srcmem64[i], data.l64, src_tag);
 
-      data.l32.l = pattern->pattern(i << 1);
-      data.l32.h = pattern->pattern((i << 1) + 1);
+      data.l64 = pattern->word(i);
       a1 = a1 + data.l32.l;
       b1 = b1 + a1;
       a1 = a1 + data.l32.h;
@@ -1217,7 +1473,8 @@ int WorkerThread::CrcCopyPage(struct page_entry *dstpe,
   uint64 *targetmembase = static_cast<uint64*>(dstpe->addr);
   uint64 *sourcemembase = static_cast<uint64*>(srcpe->addr);
   // Remember the expected CRC
-  const AdlerChecksum *expectedcrc = srcpe->pattern->crc();
+  const AdlerChecksum *expectedcrc = crc32c_ ? srcpe->pattern->crc32c() :
+                                               srcpe->pattern->crc();
 
   for (int currentblock = 0; currentblock < blocks; currentblock++) {
     uint64 *targetmem = targetmembase + currentblock * blockwords;
@@ -1226,6 +1483,8 @@ int WorkerThread::CrcCopyPage(struct page_entry *dstpe,
     AdlerChecksum crc;
     if (tag_mode_) {
       AdlerAddrMemcpyC(targetmem, sourcemem, blocksize, &crc, srcpe);
+    } else if (crc32c_) {
+      os_->Crc32cMemcpy(targetmem, sourcemem, blocksize, &crc);
     } else {
       AdlerMemcpyC(targetmem, sourcemem, blocksize, &crc);
     }
@@ -1272,7 +1531,7 @@ int WorkerThread::CrcCopyPage(struct page_entry *dstpe,
             er.patternname = srcpe->pattern->name();
             ProcessError(&er, 0, "Hardware Error");
             errors += 1;
-            errorcount_ ++;
+            stats_->AddErrors(1);
           }
         }
       }
@@ -1312,25 +1571,62 @@ int WorkerThread::CrcCopyPage(struct page_entry *dstpe,
 
 
 
+namespace {
+// Command line names of the invert flush policies, indexed by InvertFlush.
+const char *const kInvertFlushNames[kInvertFlushCount] = {
+  "line", "batch", "clwb", "nt"
+};
+}  // namespace
+
+const char *InvertFlushName(int flush) {
+  if (flush < 0 || flush >= kInvertFlushCount)
+    return "unknown";
+  return kInvertFlushNames[flush];
+}
+
+int InvertFlushFromName(const char *name) {
+  for (int i = 0; i < kInvertFlushCount; i++) {
+    if (!strcmp(name, kInvertFlushNames[i]))
+      return i;
+  }
+  return -1;
+}
+
+// Invert a 4k block in place and push it out of the cache, so the next
+// pass reads it back from memory.
+void InvertThread::InvertBlock(char *block, bool down) {
+  const unsigned int blocksize = 4096;
+  // The line policy keeps the historical flush granularity.
+  const unsigned int linesize = 128;
+
+  switch (flush_) {
+    case kInvertFlushNonTemporal:
+      InvertMemoryNonTemporal(block, blocksize, down);
+      break;
+    case kInvertFlushBatch:
+    case kInvertFlushWriteback:
+      os_->InvertMemory(block, blocksize, down);
+      os_->FlushRange(block, blocksize, flush_ == kInvertFlushWriteback);
+      break;
+    default:
+      for (unsigned int i = 0; i < blocksize; i += linesize) {
+        char *line = block + (down ? blocksize - linesize - i : i);
+        os_->InvertMemory(line, linesize, down);
+        OsLayer::FastFlush(line);
+      }
+      break;
+  }
+}
+
 // Invert a block of memory quickly, traversing downwards.
 int InvertThread::InvertPageDown(struct page_entry *srcpe) {
   const int blocksize = 4096;
-  const int blockwords = blocksize / wordsize_;
   int blocks = sat_->page_length() / blocksize;
 
-  // Base addresses for memory copy
-  unsigned int *sourcemembase = static_cast<unsigned int *>(srcpe->addr);
-
-  for (int currentblock = blocks-1; currentblock >= 0; currentblock--) {
-    unsigned int *sourcemem = sourcemembase + currentblock * blockwords;
-    for (int i = blockwords - 32; i >= 0; i -= 32) {
-      for (int index = i + 31; index >= i; --index) {
-        unsigned int actual = sourcemem[index];
-        sourcemem[index] = ~actual;
-      }
-      OsLayer::FastFlush(&sourcemem[i]);
-    }
-  }
+  char *sourcemembase = static_cast<char *>(srcpe->addr);
+
+  for (int currentblock = blocks-1; currentblock >= 0; currentblock--)
+    InvertBlock(sourcemembase + currentblock * blocksize, true);
 
   srcpe->lastcpu = sched_getcpu();
   return 0;
@@ -1339,22 +1635,12 @@ int InvertThread::InvertPageDown(struct page_entry *srcpe) {
 // Invert a block of memory, traversing upwards.
 int InvertThread::InvertPageUp(struct page_entry *srcpe) {
   const int blocksize = 4096;
-  const int blockwords = blocksize / wordsize_;
   int blocks = sat_->page_length() / blocksize;
 
-  // Base addresses for memory copy
-  unsigned int *sourcemembase = static_cast<unsigned int *>(srcpe->addr);
+  char *sourcemembase = static_cast<char *>(srcpe->addr);
 
-  for (int currentblock = 0; currentblock < blocks; currentblock++) {
-    unsigned int *sourcemem = sourcemembase + currentblock * blockwords;
-    for (int i = 0; i < blockwords; i += 32) {
-      for (int index = i; index <= i + 31; ++index) {
-        unsigned int actual = sourcemem[index];
-        sourcemem[index] = ~actual;
-      }
-      OsLayer::FastFlush(&sourcemem[i]);
-    }
-  }
+  for (int currentblock = 0; currentblock < blocks; currentblock++)
+    InvertBlock(sourcemembase + currentblock * blocksize, false);
 
   srcpe->lastcpu = sched_getcpu();
   return 0;
@@ -1373,7 +1659,8 @@ int WorkerThread::CrcWarmCopyPage(struct page_entry *dstpe,
   uint64 *targetmembase = static_cast<uint64*>(dstpe->addr);
   uint64 *sourcemembase = static_cast<uint64*>(srcpe->addr);
   // Remember the expected CRC
-  const AdlerChecksum *expectedcrc = srcpe->pattern->crc();
+  const AdlerChecksum *expectedcrc = crc32c_ ? srcpe->pattern->crc32c() :
+                                               srcpe->pattern->crc();
 
   for (int currentblock = 0; currentblock < blocks; currentblock++) {
     uint64 *targetmem = targetmembase + currentblock * blockwords;
@@ -1382,6 +1669,8 @@ int WorkerThread::CrcWarmCopyPage(struct page_entry *dstpe,
     AdlerChecksum crc;
     if (tag_mode_) {
       AdlerAddrMemcpyWarm(targetmem, sourcemem, blocksize, &crc, srcpe);
+    } else if (crc32c_) {
+      os_->Crc32cMemcpy(targetmem, sourcemem, blocksize, &crc);
     } else {
       os_->AdlerMemcpyWarm(targetmem, sourcemem, blocksize, &crc);
     }
@@ -1427,7 +1716,7 @@ int WorkerThread::CrcWarmCopyPage(struct page_entry *dstpe,
             er.patternname = srcpe->pattern->name();
             ProcessError(&er, 0, "Hardware Error");
             errors ++;
-            errorcount_ ++;
+            stats_->AddErrors(1);
           }
         }
       }
@@ -1469,6 +1758,12 @@ int WorkerThread::CrcWarmCopyPage(struct page_entry *dstpe,
 
 
 // Memory check work loop. Execute until done, then exhaust pages.
+// Tell the thread which pages to check first.
+void CheckThread::SetCheckRange(int64 first_page, int64 num_pages) {
+  first_page_ = first_page;
+  num_pages_to_check_ = num_pages;
+}
+
 bool CheckThread::Work() {
   struct page_entry pe;
   bool result = true;
@@ -1476,6 +1771,23 @@ bool CheckThread::Work() {
 
   logprintf(9, "Log: Starting Check thread %d\n", thread_num_);
 
+  // The final check walks its own slice of the pages, the random search of
+  // the queue gets slower as the valid pages run out. Pages another thread
+  // holds are left for the queue loop below.
+  for (int64 i = 0; i < num_pages_to_check_; i++) {
+    if (!sat_->ClaimValid(first_page_ + i, &pe))
+      continue;
+    CrcCheckPage(&pe);
+    if (!sat_->PutEmpty(&pe)) {
+      logprintf(0, "Process Error: check_thread failed to push pages, "
+                "bailing\n");
+      status_ = false;
+      return false;
+    }
+    loops++;
+    stats_->set_pages(loops);
+  }
+
   // We want to check all the pages, and
   // stop when there aren't any left.
   while (true) {
@@ -1504,177 +1816,837 @@ bool CheckThread::Work() {
       break;
     }
     loops++;
+    stats_->set_pages(loops);
   }
 
-  pages_copied_ = loops;
   status_ = result;
   logprintf(9, "Log: Completed %d: Check thread. Status %d, %d pages checked\n",
-            thread_num_, status_, pages_copied_);
+            thread_num_, status_, stats_->pages());
   return result;
 }
 
 
-// Memory copy work loop. Execute until marked done.
-bool CopyThread::Work() {
-  struct page_entry src;
-  struct page_entry dst;
+
+namespace {
+// Word of each cacheline that holds its chain link. Word 0 may be an
+// address tag, word 1 always holds pattern data.
+const int kLinkWord = 1;
+// Walks between reshuffles of the chain.
+const int kShuffleInterval = 16;
+
+// Histogram region of a page with tag 'tag'.
+int LatencyRegion(int32 tag) {
+  if (tag > 0 && !(tag & (tag - 1)))
+    return __builtin_ctz(tag);
+  return LatencyThread::kRegions - 1;
+}
+}  // namespace
+
+LatencyThread::LatencyThread() {
+  seed_ = 0;
+  memset(histogram_, 0, sizeof(histogram_));
+}
+
+// Sattolo's shuffle, which only produces single cycles, so every walk
+// visits every line.
+void LatencyThread::ShuffleChain(int lines) {
+  vector<uint32> order(lines);
+  for (int i = 0; i < lines; i++)
+    order[i] = i;
+  for (int i = lines - 1; i > 0; i--) {
+    // xorshift64.
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 7;
+    seed_ ^= seed_ << 17;
+    int j = seed_ % i;
+    uint32 tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+  next_.resize(lines);
+  for (int i = 0; i < lines; i++)
+    next_[order[i]] = order[(i + 1) % lines];
+}
+
+void LatencyThread::ApplyChain(struct page_entry *pe, int lines) {
+  static const int kLineWords = kCacheLineSize / sizeof(uint64);
+  uint64 *memwords = static_cast<uint64*>(pe->addr);
+  for (int i = 0; i < lines; i++) {
+    int word = i * kLineWords + kLinkWord;
+    uint64 link = reinterpret_cast<uint64>(
+        &memwords[next_[i] * kLineWords + kLinkWord]);
+    memwords[word] ^= pe->pattern->word(word) ^ link;
+  }
+}
+
+bool LatencyThread::WalkChain(struct page_entry *pe, int lines, int64 *ns) {
+  uint64 base = reinterpret_cast<uint64>(pe->addr);
+  uint64 length = static_cast<uint64>(lines) * kCacheLineSize;
+  uint64 start = base + kLinkWord * sizeof(uint64);
+  uint64 link = start;
+  int step;
+
+  int64 begin = sat_get_time_ns();
+  for (step = 0; step < lines; step++) {
+    link = *reinterpret_cast<volatile uint64*>(link);
+    // Don't follow a corrupted link out of the page. The check is off the
+    // dependency chain, so it hardly shows in the timing.
+    if (link - base >= length ||
+        (link - base) % kCacheLineSize != kLinkWord * sizeof(uint64))
+      break;
+  }
+  *ns = sat_get_time_ns() - begin;
+
+  if (step == lines && link == start)
+    return true;
+
+  logprintf(0, "Hardware Error: latency chain broken on CPU %d in page at "
+            "%p(%#llx) after %d of %d loads, read %#llx\n",
+            sched_getcpu(), pe->addr, os_->VirtualToPhysical(pe->addr),
+            step, lines, link);
+  return false;
+}
+
+bool LatencyThread::Work() {
+  struct page_entry pe;
   bool result = true;
   int64 loops = 0;
+  int lines = sat_->page_length() / kCacheLineSize;
+
+  seed_ = prng_.Next();
+  if (!seed_)
+    seed_ = 0xbeef;
 
-  logprintf(9, "Log: Starting copy thread %d: cpu %s, mem %x\n",
-            thread_num_, cpuset_format(&cpu_mask_).c_str(), tag_);
+  logprintf(9, "Log: Starting latency thread %d: cpu %s, mem %x, %d lines "
+            "per walk\n", thread_num_, cpuset_format(&cpu_mask_).c_str(),
+            tag_, lines);
 
   while (IsReadyToRun()) {
-    // Pop the needed pages.
-    result = result && sat_->GetValid(&src, tag_);
-    result = result && sat_->GetEmpty(&dst, tag_);
+    result = result && sat_->GetValid(&pe, tag_);
     if (!result) {
-      logprintf(0, "Process Error: copy_thread failed to pop pages, "
+      logprintf(0, "Process Error: latency_thread failed to pop pages, "
                 "bailing\n");
       break;
     }
 
-    // Force errors for unittests.
-    if (sat_->error_injection()) {
-      if ((random() % 50000) == 8) {
-        char *addr = reinterpret_cast<char*>(src.addr);
-        int offset = random() % sat_->page_length();
-        addr[offset] = 0xba;
-      }
-    }
-
-    // We can use memcpy, or CRC check while we copy.
-    if (sat_->warm()) {
-      CrcWarmCopyPage(&dst, &src);
-    } else if (sat_->strict()) {
-      CrcCopyPage(&dst, &src);
+    if (loops % kShuffleInterval == 0)
+      ShuffleChain(lines);
+    ApplyChain(&pe, lines);
+    int64 ns = 0;
+    if (WalkChain(&pe, lines, &ns)) {
+      int bucket = ns / lines / kBucketNs;
+      if (bucket >= kBuckets)
+        bucket = kBuckets - 1;
+      histogram_[LatencyRegion(pe.tag)][bucket]++;
     } else {
-      memcpy(dst.addr, src.addr, sat_->page_length());
-      dst.pattern = src.pattern;
-      dst.lastcpu = sched_getcpu();
+      stats_->AddErrors(1);
     }
+    // Restore the pattern, the links only depend on next_.
+    ApplyChain(&pe, lines);
 
-    result = result && sat_->PutValid(&dst);
-    result = result && sat_->PutEmpty(&src);
-
-    // Copy worker-threads yield themselves at the end of each copy loop,
-    // to avoid threads from preempting each other in the middle of the inner
-    // copy-loop. Cooperations between Copy worker-threads results in less
-    // unnecessary cache thrashing (which happens when context-switching in the
-    // middle of the inner copy-loop).
-    YieldSelf();
-
+    result = result && sat_->PutValid(&pe);
     if (!result) {
-      logprintf(0, "Process Error: copy_thread failed to push pages, "
+      logprintf(0, "Process Error: latency_thread failed to push pages, "
                 "bailing\n");
       break;
     }
     loops++;
+    stats_->set_pages(loops);
   }
 
-  pages_copied_ = loops;
   status_ = result;
-  logprintf(9, "Log: Completed %d: Copy thread. Status %d, %d pages copied\n",
-            thread_num_, status_, pages_copied_);
+  logprintf(9, "Log: Completed %d: Latency thread. Status %d, %d pages "
+            "walked\n", thread_num_, status_, stats_->pages());
   return result;
 }
 
-// Memory invert work loop. Execute until marked done.
-bool InvertThread::Work() {
-  struct page_entry src;
+void RowhammerThread::MapLines(struct page_entry *pages, int count) {
+  const DramMap &map = sat_->dram_map();
+  int64 os_page = sysconf(_SC_PAGESIZE);
+  lines_.clear();
+  for (int i = 0; i < count; i++) {
+    char *base = static_cast<char*>(pages[i].addr);
+    for (int64 chunk = 0; chunk < sat_->page_length(); chunk += os_page) {
+      // Physically contiguous only within an OS page.
+      uint64 paddr = os_->VirtualToPhysical(base + chunk);
+      if (!paddr)
+        continue;
+      for (int64 line = 0; line < os_page; line += kCacheLineSize) {
+        struct Line entry;
+        entry.bank = map.Bank(paddr + line);
+        entry.row = map.Row(paddr + line);
+        entry.addr = base + chunk + line;
+        lines_.push_back(entry);
+      }
+    }
+  }
+  std::sort(lines_.begin(), lines_.end(), LineBefore);
+  lines_.erase(std::unique(lines_.begin(), lines_.end(), SameRow),
+               lines_.end());
+}
+
+void RowhammerThread::Hammer(char *a, char *b, int count) {
+  volatile char *first = a;
+  volatile char *second = b;
+  for (int i = 0; i < count; i++) {
+    *first;
+    *second;
+    OsLayer::FastFlush(a);
+    OsLayer::FastFlush(b);
+  }
+}
+
+int RowhammerThread::HammerRows() {
+  int rows = 0;
+  for (size_t i = 1; i + 1 < lines_.size(); i++) {
+    const struct Line &below = lines_[i - 1];
+    const struct Line &victim = lines_[i];
+    const struct Line &above = lines_[i + 1];
+    if (below.bank != victim.bank || above.bank != victim.bank ||
+        below.row + 1 != victim.row || victim.row + 1 != above.row)
+      continue;
+    if (!IsReadyToRunNoPause())
+      break;
+    logprintf(20, "Log: Rowhammer thread %d: bank %d row %#llx, aggressors "
+              "%p and %p\n", thread_num_, victim.bank, victim.row,
+              below.addr, above.addr);
+    Hammer(below.addr, above.addr, sat_->rowhammer_count());
+    rows++;
+  }
+  return rows;
+}
+
+bool RowhammerThread::Work() {
+  struct page_entry pages[kHammerPages];
   bool result = true;
   int64 loops = 0;
+  int64 rows = 0;
+  bool warned = false;
 
-  logprintf(9, "Log: Starting invert thread %d\n", thread_num_);
+  logprintf(9, "Log: Starting rowhammer thread %d: cpu %s, mem %x, "
+            "mapping %s\n", thread_num_, cpuset_format(&cpu_mask_).c_str(),
+            tag_, sat_->dram_map().Format().c_str());
 
   while (IsReadyToRun()) {
-    // Pop the needed pages.
-    result = result && sat_->GetValid(&src);
-    if (!result) {
-      logprintf(0, "Process Error: invert_thread failed to pop pages, "
-                "bailing\n");
-      break;
+    int held;
+    for (held = 0; held < kHammerPages; held++) {
+      if (!sat_->GetValid(&pages[held], tag_)) {
+        logprintf(0, "Process Error: rowhammer_thread failed to pop pages, "
+                  "bailing\n");
+        result = false;
+        break;
+      }
     }
 
-    if (sat_->strict())
-      CrcCheckPage(&src);
-
-    // For the same reason CopyThread yields itself (see YieldSelf comment
-    // in CopyThread::Work(), InvertThread yields itself after each invert
-    // operation to improve cooperation between different worker threads
-    // stressing the memory/cache.
-    InvertPageUp(&src);
-    YieldSelf();
-    InvertPageDown(&src);
-    YieldSelf();
-    InvertPageDown(&src);
-    YieldSelf();
-    InvertPageUp(&src);
-    YieldSelf();
-
-    if (sat_->strict())
-      CrcCheckPage(&src);
+    if (result) {
+      MapLines(pages, held);
+      int hammered = HammerRows();
+      if (!hammered && !warned) {
+        logprintf(5, "Log: Rowhammer thread %d found no adjacent rows in "
+                  "%d pages, larger physically contiguous pages or "
+                  "--rowhammer_map may help\n", thread_num_, held);
+        warned = true;
+      }
+      rows += hammered;
+      // The victims are somewhere in the held pages.
+      for (int i = 0; i < held; i++)
+        CrcCheckPage(&pages[i]);
+    }
 
-    result = result && sat_->PutValid(&src);
-    if (!result) {
-      logprintf(0, "Process Error: invert_thread failed to push pages, "
-                "bailing\n");
-      break;
+    for (int i = 0; i < held; i++) {
+      if (!sat_->PutValid(&pages[i])) {
+        logprintf(0, "Process Error: rowhammer_thread failed to push pages, "
+                  "bailing\n");
+        result = false;
+      }
     }
-    loops++;
+    if (!result)
+      break;
+    loops += held;
+    stats_->set_pages(loops);
   }
 
-  pages_copied_ = loops * 2;
   status_ = result;
-  logprintf(9, "Log: Completed %d: Copy thread. Status %d, %d pages copied\n",
-            thread_num_, status_, pages_copied_);
+  logprintf(9, "Log: Completed %d: Rowhammer thread. Status %d, %d pages "
+            "checked, %lld rows hammered\n", thread_num_, status_,
+            stats_->pages(), rows);
   return result;
 }
 
+TlbThread::TlbThread(int64 size) {
+  size_ = size;
+  page_size_ = sysconf(_SC_PAGESIZE);
+  mem_ = NULL;
+  pattern_ = NULL;
+  pass_ = 0;
+  lines_ = 0;
+  memset(histogram_, 0, sizeof(histogram_));
+}
 
-// Set file name to use for File IO.
-void FileThread::SetFile(const char *filename_init) {
-  filename_ = filename_init;
-  devicename_ = os_->FindFileDevice(filename_);
+TlbThread::~TlbThread() {
+  if (mem_)
+    munmap(mem_, size_);
 }
 
-// Open the file for access.
-bool FileThread::OpenFile(int *pfile) {
-  int flags = O_RDWR | O_CREAT | O_SYNC;
-  int fd = open(filename_.c_str(), flags | O_DIRECT, 0644);
-  if (O_DIRECT != 0 && fd < 0 && errno == EINVAL) {
-    fd = open(filename_.c_str(), flags, 0644);  // Try without O_DIRECT
-    os_->ActivateFlushPageCache();  // Not using O_DIRECT fixed EINVAL
-  }
-  if (fd < 0) {
-    logprintf(0, "Process Error: Failed to create file %s!!\n",
-              filename_.c_str());
-    pages_copied_ = 0;
-    return false;
+void TlbThread::ShufflePages() {
+  for (uint64 i = order_.size() - 1; i > 0; i--) {
+    uint64 j = prng_.Below(i + 1);
+    uint32 tmp = order_[i];
+    order_[i] = order_[j];
+    order_[j] = tmp;
   }
-  *pfile = fd;
-  return true;
 }
 
-// Close the file.
-bool FileThread::CloseFile(int fd) {
-  close(fd);
-  return true;
+// The page number is mixed into the pattern, so that a walk that lands in
+// the wrong page reads the wrong data even for a solid pattern.
+uint64 TlbThread::Expected(uint64 page, int word) const {
+  static const int kLineWords = kCacheLineSize / sizeof(uint64);
+  return pattern_->word(page * kLineWords + word) ^
+         (page * 0x9e3779b97f4a7c15ULL);
 }
 
-// Check sector tagging.
-bool FileThread::SectorTagPage(struct page_entry *src, int block) {
-  int page_length = sat_->page_length();
-  struct FileThread::SectorTag *tag =
-    (struct FileThread::SectorTag *)(src->addr);
+// The line moves each pass and differs between pages, so that the lines
+// touched don't all crowd into one cache set.
+char *TlbThread::Line(uint64 page) const {
+  int lines = page_size_ / kCacheLineSize;
+  return mem_ + page * page_size_ +
+         ((page + pass_) % lines) * kCacheLineSize;
+}
+
+void TlbThread::WriteLines() {
+  static const int kLineWords = kCacheLineSize / sizeof(uint64);
+  for (size_t i = 0; i < order_.size(); i++) {
+    uint64 page = order_[i];
+    uint64 *line = reinterpret_cast<uint64*>(Line(page));
+    for (int word = 0; word < kLineWords; word++)
+      line[word] = Expected(page, word);
+  }
+}
+
+int64 TlbThread::CheckLines() {
+  static const int kLineWords = kCacheLineSize / sizeof(uint64);
+  int64 errors = 0;
+  for (size_t batch = 0; batch < order_.size(); batch += kBatchLines) {
+    if (!IsReadyToRun())
+      return -1;
+    size_t end = batch + kBatchLines;
+    if (end > order_.size())
+      end = order_.size();
+    // Only the first word of each line is timed, the rest of it is
+    // already on its way.
+    uint64 bad = 0;
+    int64 begin = sat_get_time_ns();
+    for (size_t i = batch; i < end; i++) {
+      uint64 page = order_[i];
+      bad |= *reinterpret_cast<volatile uint64*>(Line(page)) ^
+             Expected(page, 0);
+    }
+    int64 ns = sat_get_time_ns() - begin;
+    int bucket = ns / static_cast<int64>(end - batch) /
+                 LatencyThread::kBucketNs;
+    if (bucket >= LatencyThread::kBuckets)
+      bucket = LatencyThread::kBuckets - 1;
+    histogram_[bucket]++;
+
+    for (size_t i = batch; i < end; i++) {
+      uint64 page = order_[i];
+      volatile uint64 *line = reinterpret_cast<volatile uint64*>(Line(page));
+      for (int word = bad ? 0 : 1; word < kLineWords; word++) {
+        uint64 expected = Expected(page, word);
+        uint64 actual = line[word];
+        if (actual == expected)
+          continue;
+        // A fresh read that matches points at the translation rather
+        // than the memory.
+        uint64 reread = line[word];
+        logprintf(0, "Hardware Error: tlb miscompare on CPU %d at "
+                  "%p(0x%llx): read:0x%016llx, reread:0x%016llx "
+                  "expected:0x%016llx\n", sched_getcpu(), &line[word],
+                  os_->VirtualToPhysical(const_cast<uint64*>(&line[word])),
+                  actual, reread, expected);
+        line[word] = expected;
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+bool TlbThread::Work() {
+  bool result = true;
+  uint64 pages = size_ / page_size_;
+  if (!pages || pages > 0xffffffffULL) {
+    logprintf(0, "Process Error: tlb_thread can't map %lld pages\n", pages);
+    status_ = false;
+    return false;
+  }
+  size_ = pages * page_size_;
+
+  mem_ = static_cast<char*>(mmap(NULL, size_, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (mem_ == MAP_FAILED) {
+    char buf[256];
+    sat_strerror(errno, buf, sizeof(buf));
+    mem_ = NULL;
+    logprintf(0, "Process Error: tlb_thread failed to map %lldMB: %s\n",
+              size_ / kMegabyte, buf);
+    status_ = false;
+    return false;
+  }
+  // Every page needs its own TLB entry and walk.
+  if (madvise(mem_, size_, MADV_NOHUGEPAGE)) {
+    char buf[256];
+    sat_strerror(errno, buf, sizeof(buf));
+    logprintf(5, "Log: tlb_thread madvise(MADV_NOHUGEPAGE) failed: %s\n",
+              buf);
+  }
+
+  order_.resize(pages);
+  for (uint64 i = 0; i < pages; i++)
+    order_[i] = i;
+
+  logprintf(9, "Log: Starting tlb thread %d: cpu %s, %lld pages of %lld "
+            "bytes\n", thread_num_, cpuset_format(&cpu_mask_).c_str(),
+            pages, page_size_);
+
+  while (IsReadyToRun()) {
+    pattern_ = patternlist_->GetRandomPattern();
+    ShufflePages();
+    WriteLines();
+    // Check in a different order than written.
+    ShufflePages();
+    int64 errors = CheckLines();
+    if (errors < 0)
+      break;
+    stats_->AddErrors(errors);
+    lines_ += 2 * pages;
+    pass_++;
+  }
+
+  status_ = result;
+  logprintf(9, "Log: Completed %d: TLB thread. Status %d, %lld passes over "
+            "%lld pages\n", thread_num_, status_, pass_, pages);
+  return result;
+}
+
+namespace {
+// Command line names of the copy engines, indexed by CopyEngine.
+const char *const kCopyEngineNames[kCopyEngineCount] = {
+  "default", "nt", "prefetch", "erms"
+};
+}  // namespace
+
+const char *CopyEngineName(int engine) {
+  if (engine < 0 || engine >= kCopyEngineCount)
+    return "unknown";
+  return kCopyEngineNames[engine];
+}
+
+int CopyEngineFromName(const char *name) {
+  for (int i = 0; i < kCopyEngineCount; i++) {
+    if (!strcmp(name, kCopyEngineNames[i]))
+      return i;
+  }
+  return -1;
+}
+
+// Copy a page with this thread's copy engine. The engines don't checksum
+// on the fly, so in strict mode the destination is compared against the
+// pattern afterwards. A mismatching block is checked at the source first,
+// so errors are reported where they were read, then at the destination.
+int CopyThread::EngineCopyPage(struct page_entry *dstpe,
+                               struct page_entry *srcpe) {
+  int errors = 0;
+  const int blocksize = 4096;
+  const int blockwords = blocksize / wordsize_;
+  int length = sat_->page_length();
+
+  switch (engine_) {
+    case kCopyEngineNonTemporal:
+      MemcpyNonTemporal(dstpe->addr, srcpe->addr, length);
+      break;
+    case kCopyEnginePrefetch:
+      MemcpyPrefetch(dstpe->addr, srcpe->addr, length, prefetch_distance_);
+      break;
+    case kCopyEngineRepMovsb:
+      MemcpyRepMovsb(dstpe->addr, srcpe->addr, length);
+      break;
+    default:
+      memcpy(dstpe->addr, srcpe->addr, length);
+      break;
+  }
+
+  if (sat_->strict()) {
+    const uint64 *expectedblock = srcpe->pattern->expected_block();
+    uint64 *targetmembase = static_cast<uint64*>(dstpe->addr);
+    uint64 *sourcemembase = static_cast<uint64*>(srcpe->addr);
+    int blocks = length / blocksize;
+    for (int currentblock = 0; currentblock < blocks; currentblock++) {
+      uint64 *targetmem = targetmembase + currentblock * blockwords;
+      uint64 *sourcemem = sourcemembase + currentblock * blockwords;
+      uint64 mismatch[blockwords / 64];
+      if (!os_->PatternCompare(targetmem, expectedblock, blockwords,
+                               mismatch))
+        continue;
+
+      logprintf(11, "Log: EngineCopyPage (%s) falling through to slow "
+                "compare on block %d\n", CopyEngineName(engine_),
+                currentblock);
+      int errorcount = CheckRegion(sourcemem,
+                                   srcpe->pattern,
+                                   srcpe->lastcpu,
+                                   blocksize,
+                                   currentblock * blocksize, 0);
+      // A clean source means the corruption happened on the way to, or
+      // in, the destination.
+      if (errorcount == 0) {
+        errorcount = CheckRegion(targetmem,
+                                 srcpe->pattern,
+                                 srcpe->lastcpu,
+                                 blocksize,
+                                 currentblock * blocksize, 0,
+                                 mismatch);
+      }
+      // Recopy the corrected source so the destination holds good data.
+      memcpy(targetmem, sourcemem, blocksize);
+      errors += errorcount;
+    }
+  }
+
+  dstpe->pattern = srcpe->pattern;
+  dstpe->lastcpu = sched_getcpu();
+  return errors;
+}
+
+// Memory copy work loop. Execute until marked done.
+bool CopyThread::Work() {
+  // Streaming copies work on spans of consecutive pages, so that each
+  // thread sweeps through longer contiguous runs of memory.
+  int span = sat_->copy_span_pages();
+  vector<struct page_entry> src(span);
+  vector<struct page_entry> dst(span);
+  bool result = true;
+  int64 loops = 0;
+
+  logprintf(9, "Log: Starting copy thread %d: cpu %s, mem %x, engine %s, "
+            "span %d\n", thread_num_, cpuset_format(&cpu_mask_).c_str(),
+            tag_, CopyEngineName(engine_), span);
+
+  while (IsReadyToRun()) {
+    // Pop the needed pages.
+    int count = result ? sat_->GetValidSpan(&src[0], span, tag_) : 0;
+    int empty = count ? sat_->GetEmptySpan(&dst[0], count, tag_) : 0;
+    result = result && count && empty;
+    if (!result) {
+      logprintf(0, "Process Error: copy_thread failed to pop pages, "
+                "bailing\n");
+      break;
+    }
+    // Hand back the source pages there is no room for.
+    for (int i = empty; i < count; i++)
+      result = result && sat_->PutValid(&src[i]);
+    count = empty;
+
+    for (int i = 0; i < count; i++) {
+      // Force errors for unittests.
+      if (sat_->error_injection()) {
+        if (prng_.Below(50000) == 8) {
+          char *addr = reinterpret_cast<char*>(src[i].addr);
+          int offset = prng_.Below(sat_->page_length());
+          addr[offset] = 0xba;
+        }
+      }
+
+      // We can use memcpy, or CRC check while we copy.
+      if (engine_ != kCopyEngineDefault) {
+        EngineCopyPage(&dst[i], &src[i]);
+      } else if (sat_->warm()) {
+        CrcWarmCopyPage(&dst[i], &src[i]);
+      } else if (sat_->strict()) {
+        CrcCopyPage(&dst[i], &src[i]);
+      } else {
+        memcpy(dst[i].addr, src[i].addr, sat_->page_length());
+        dst[i].pattern = src[i].pattern;
+        dst[i].lastcpu = sched_getcpu();
+      }
+    }
+
+    for (int i = 0; i < count; i++) {
+      result = result && sat_->PutValid(&dst[i]);
+      result = result && sat_->PutEmpty(&src[i]);
+    }
+
+    // Copy worker-threads yield themselves at the end of each copy loop,
+    // to avoid threads from preempting each other in the middle of the inner
+    // copy-loop. Cooperations between Copy worker-threads results in less
+    // unnecessary cache thrashing (which happens when context-switching in the
+    // middle of the inner copy-loop).
+    YieldSelf();
+
+    if (!result) {
+      logprintf(0, "Process Error: copy_thread failed to push pages, "
+                "bailing\n");
+      break;
+    }
+    loops += count;
+    stats_->set_pages(loops);
+  }
+
+  status_ = result;
+  logprintf(9, "Log: Completed %d: Copy thread. Status %d, %d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  return result;
+}
+
+// Memory invert work loop. Execute until marked done.
+bool InvertThread::Work() {
+  struct page_entry src;
+  bool result = true;
+  int64 loops = 0;
+
+  logprintf(9, "Log: Starting invert thread %d\n", thread_num_);
+
+  while (IsReadyToRun()) {
+    // Pop the needed pages.
+    result = result && sat_->GetValid(&src);
+    if (!result) {
+      logprintf(0, "Process Error: invert_thread failed to pop pages, "
+                "bailing\n");
+      break;
+    }
+
+    if (sat_->strict())
+      CrcCheckPage(&src);
+
+    // For the same reason CopyThread yields itself (see YieldSelf comment
+    // in CopyThread::Work(), InvertThread yields itself after each invert
+    // operation to improve cooperation between different worker threads
+    // stressing the memory/cache.
+    InvertPageUp(&src);
+    YieldSelf();
+    InvertPageDown(&src);
+    YieldSelf();
+    InvertPageDown(&src);
+    YieldSelf();
+    InvertPageUp(&src);
+    YieldSelf();
+
+    if (sat_->strict())
+      CrcCheckPage(&src);
+
+    result = result && sat_->PutValid(&src);
+    if (!result) {
+      logprintf(0, "Process Error: invert_thread failed to push pages, "
+                "bailing\n");
+      break;
+    }
+    loops++;
+    stats_->set_pages(loops * 2);
+  }
+
+  status_ = result;
+  logprintf(9, "Log: Completed %d: Copy thread. Status %d, %d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  return result;
+}
+
+
+// Cells are accessed through a volatile pointer so that every read of the
+// algorithm goes to memory, even right after a write of the same cell.
+int MarchThread::RunElement(struct page_entry *pe,
+                            const struct MarchElement &element,
+                            int reported) {
+  const int kLineWords = 64 / wordsize_;
+  volatile uint64 *cells = static_cast<volatile uint64*>(pe->addr);
+  const uint64 *background = pe->pattern->expected_block();
+  const struct MarchOp *ops = &element.ops[0];
+  int num_ops = element.ops.size();
+  int words = sat_->page_length() / wordsize_;
+  int errors = 0;
+
+  for (int n = 0; n < words; n++) {
+    int i = element.down ? words - 1 - n : n;
+    uint64 *cell = const_cast<uint64*>(&cells[i]);
+    uint64 zero = background[i & (Pattern::kExpandedWords - 1)];
+    if (tag_mode_ && !(i % kLineWords))
+      zero = addr_to_tag(cell);
+
+    for (int op = 0; op < num_ops; op++) {
+      uint64 value = ops[op].ones ? ~zero : zero;
+      if (ops[op].write) {
+        cells[i] = value;
+        continue;
+      }
+      uint64 actual = cells[i];
+      if (actual == value)
+        continue;
+      if (reported + errors < kErrorLimit) {
+        struct ErrorRecord er;
+        er.actual = actual;
+        er.expected = value;
+        er.vaddr = cell;
+        er.patternname = pe->pattern->name();
+        er.lastcpu = pe->lastcpu;
+        int priority = stats_->errors() + reported + errors < 30 ? 0 : 5;
+        // Puts the expected value back.
+        ProcessError(&er, priority, "Hardware Error");
+      } else {
+        cells[i] = value;
+      }
+      errors++;
+    }
+
+    // Done with this line for this element, the next one reads it from
+    // memory again.
+    if ((element.down ? i : i + 1) % kLineWords == 0)
+      OsLayer::FastFlushHint(cell);
+  }
+  OsLayer::FastFlushSync();
+  return errors;
+}
+
+bool MarchThread::Work() {
+  struct page_entry pe;
+  bool result = true;
+  int64 loops = 0;
+
+  logprintf(9, "Log: Starting March thread %d: %s, cpu %s, mem %x\n",
+            thread_num_, march_->name().c_str(),
+            cpuset_format(&cpu_mask_).c_str(), tag_);
+
+  while (IsReadyToRun()) {
+    result = result && sat_->GetValid(&pe, tag_);
+    if (!result) {
+      logprintf(0, "Process Error: march_thread failed to pop pages, "
+                "bailing\n");
+      break;
+    }
+
+    // Algorithms that start by writing wouldn't see what the page held.
+    if (sat_->strict())
+      CrcCheckPage(&pe);
+
+    const vector<struct MarchElement> &elements = march_->elements();
+    int errors = 0;
+    for (size_t i = 0; i < elements.size(); i++) {
+      errors += RunElement(&pe, elements[i], errors);
+      YieldSelf();
+    }
+    if (errors)
+      stats_->AddErrors(errors);
+    pe.lastcpu = sched_getcpu();
+
+    result = result && sat_->PutValid(&pe);
+    if (!result) {
+      logprintf(0, "Process Error: march_thread failed to push pages, "
+                "bailing\n");
+      break;
+    }
+    loops++;
+    stats_->set_pages(loops * march_->ops());
+  }
+
+  status_ = result;
+  logprintf(9, "Log: Completed %d: March thread. Status %d, %d page "
+            "passes\n", thread_num_, status_, stats_->pages());
+  return result;
+}
+
+
+// Set file name to use for File IO.
+void FileThread::SetFile(const char *filename_init) {
+  filename_ = filename_init;
+  devicename_ = os_->FindFileDevice(filename_);
+}
+
+// Open the file for access.
+bool FileThread::OpenFile(int *pfile) {
+  return OpenPath(filename_, pfile);
+}
+
+bool FileThread::OpenPath(const string &path, int *pfile) {
+  int flags = O_RDWR | O_CREAT | O_SYNC;
+  int fd = open(path.c_str(), flags | O_DIRECT, 0644);
+  if (O_DIRECT != 0 && fd < 0 && errno == EINVAL) {
+    fd = open(path.c_str(), flags, 0644);  // Try without O_DIRECT
+    // Not using O_DIRECT fixed EINVAL, the page cache has to be bypassed.
+    cached_io_ = true;
+  }
+  if (fd < 0) {
+    logprintf(0, "Process Error: Failed to create file %s!!\n",
+              path.c_str());
+    stats_->set_pages(0);
+    return false;
+  }
+  // Tag every logical block, so that 4Kn drives aren't tagged per 512 bytes.
+  // Files of one thread may be on different devices, their largest block
+  // size is a multiple of the others.
+  int sector_size = LogicalBlockSize(fd);
+  if (sector_size > sector_size_)
+    sector_size_ = sector_size;
+  *pfile = fd;
+  return true;
+}
+
+int FileThread::LogicalBlockSize(int fd) {
+  int size = 0;
+  struct stat st;
+  if (fstat(fd, &st))
+    return 512;
+  if (S_ISBLK(st.st_mode)) {
+    if (ioctl(fd, BLKSSZGET, &size))
+      size = 0;
+  } else {
+    // A file takes it from the device under its filesystem, which for a
+    // partition is the queue of its parent disk.
+    const char *queues[] = { "queue", "../queue" };
+    for (int i = 0; i < 2 && size <= 0; i++) {
+      char path[128];
+      snprintf(path, sizeof(path),
+               "/sys/dev/block/%u:%u/%s/logical_block_size",
+               major(st.st_dev), minor(st.st_dev), queues[i]);
+      FILE *file = fopen(path, "r");
+      if (!file)
+        continue;
+      if (fscanf(file, "%d", &size) != 1)
+        size = 0;
+      fclose(file);
+    }
+  }
+  // Tags need whole sectors in every page.
+  int page_length = sat_->page_length();
+  if (size < 512 || (size & (size - 1)) || size > page_length ||
+      page_length % size)
+    return 512;
+  return size;
+}
+
+// Close the file.
+bool FileThread::CloseFile(int fd) {
+  close(fd);
+  return true;
+}
+
+// Check sector tagging.
+uint32 FileThread::SectorTagWord(int block, int sec) const {
+  struct SectorTag tag;
+  tag.magic = (0xba + thread_num_) & 0xff;
+  tag.block = block & 0xff;
+  tag.sector = sec & 0xff;
+  tag.pass = pass_ & 0xff;
+  uint32 word;
+  memcpy(&word, &tag, sizeof(word));
+  return word;
+}
+
+bool FileThread::SectorTagPage(struct page_entry *src, int block) {
+  int page_length = sat_->page_length();
+  char *data = static_cast<char*>(src->addr);
 
   // Tag each sector.
-  unsigned char magic = ((0xba + thread_num_) & 0xff);
-  for (int sec = 0; sec < page_length / 512; sec++) {
-    tag[sec].magic = magic;
-    tag[sec].block = block & 0xff;
-    tag[sec].sector = sec & 0xff;
-    tag[sec].pass = pass_ & 0xff;
+  for (int sec = 0; sec < page_length / sector_size_; sec++) {
+    *reinterpret_cast<uint32*>(data + sec * sector_size_) =
+        SectorTagWord(block, sec);
   }
   return true;
 }
@@ -1682,11 +2654,13 @@ bool FileThread::SectorTagPage(struct page_entry *src, int block) {
 bool FileThread::WritePageToFile(int fd, struct page_entry *src) {
   int page_length = sat_->page_length();
   // Fill the file with our data.
+  int64 start_time = sat_get_time_us();
   int64 size = write(fd, src->addr, page_length);
+  write_latency_.Record(sat_get_time_us() - start_time);
 
   if (size != page_length) {
     os_->ErrorReport(devicename_.c_str(), "write-error", 1);
-    errorcount_++;
+    stats_->AddErrors(1);
     logprintf(0, "Block Error: file_thread failed to write, "
               "bailing\n");
     return false;
@@ -1722,7 +2696,9 @@ bool FileThread::WritePages(int fd) {
     if (!result)
       return false;
   }
-  return os_->FlushPageCache();  // If O_DIRECT worked, this will be a NOP.
+  return BypassPageCache(fd, 0,
+                         static_cast<int64>(sat_->disk_pages()) *
+                         sat_->page_length());
 }
 
 // Copy data from file into memory block.
@@ -1730,117 +2706,206 @@ bool FileThread::ReadPageFromFile(int fd, struct page_entry *dst) {
   int page_length = sat_->page_length();
 
   // Do the actual read.
+  int64 start_time = sat_get_time_us();
   int64 size = read(fd, dst->addr, page_length);
+  read_latency_.Record(sat_get_time_us() - start_time);
   if (size != page_length) {
     os_->ErrorReport(devicename_.c_str(), "read-error", 1);
     logprintf(0, "Block Error: file_thread failed to read, "
               "bailing\n");
-    errorcount_++;
+    stats_->AddErrors(1);
     return false;
   }
   return true;
 }
 
-// Check sector tagging.
-bool FileThread::SectorValidatePage(const struct PageRec &page,
-                                    struct page_entry *dst, int block) {
-  // Error injection.
+// Error injection.
+void FileThread::SectorInjectErrors(struct page_entry *dst) {
   static int calls = 0;
   calls++;
+  if (!sat_->error_injection())
+    return;
+
+  char *data = static_cast<char*>(dst->addr);
+  int sectors = sat_->page_length() / sector_size_;
+  if (calls == 2) {
+    for (int badsec = 8; badsec < 17 && badsec < sectors; badsec++) {
+      struct SectorTag *tag =
+          reinterpret_cast<struct SectorTag*>(data + badsec * sector_size_);
+      tag->pass = 27;
+    }
+  }
+  if (calls == 18) {
+    (static_cast<int32*>(dst->addr))[27] = 0xbadda7a;
+  }
+}
 
-  // Do sector tag compare.
-  int firstsector = -1;
-  int lastsector = -1;
-  bool badsector = false;
+void FileThread::SectorTagError(const struct PageRec &page,
+                                struct page_entry *dst, int block, int sec) {
   int page_length = sat_->page_length();
+  const struct SectorTag *tag = reinterpret_cast<const struct SectorTag*>(
+      static_cast<char*>(dst->addr) + sec * sector_size_);
+  unsigned char magic = ((0xba + thread_num_) & 0xff);
 
-  // Cast data block into an array of tagged sectors.
-  struct FileThread::SectorTag *tag =
-  (struct FileThread::SectorTag *)(dst->addr);
-
-  sat_assert(sizeof(*tag) == 512);
+  // Offset calculation for tag location.
+  int offset = sec * sector_size_;
+  if (tag->block != (block & 0xff))
+    offset += 1 * sizeof(uint8);
+  else if (tag->sector != (sec & 0xff))
+    offset += 2 * sizeof(uint8);
+  else if (tag->pass != (pass_ & 0xff))
+    offset += 3 * sizeof(uint8);
+
+  // Run sector tag error through diagnoser for logging and reporting.
+  stats_->AddErrors(1);
+  os_->error_diagnoser_->AddHDDSectorTagError(devicename_, tag->block,
+                                              offset,
+                                              tag->sector,
+                                              page.src, page.dst);
+
+  stats_->AddErrors(1);
+  logprintf(5, "Sector Error: Sector tag @ 0x%x, pass %d/%d. "
+            "sec %x/%x, block %d/%d, magic %x/%x, File: %s \n",
+            block * page_length + sector_size_ * sec,
+            (pass_ & 0xff), (unsigned int)tag->pass,
+            sec, (unsigned int)tag->sector,
+            block, (unsigned int)tag->block,
+            magic, (unsigned int)tag->magic,
+            filename_.c_str());
+}
 
-  // Error injection.
-  if (sat_->error_injection()) {
-    if (calls == 2) {
-      for (int badsec = 8; badsec < 17; badsec++)
-        tag[badsec].pass = 27;
-    }
-    if (calls == 18) {
-      (static_cast<int32*>(dst->addr))[27] = 0xbadda7a;
+void FileThread::SectorRangeError(struct page_entry *dst, int firstsector,
+                                  int lastsector) {
+  int page_length = sat_->page_length();
+  logprintf(5, "Log: file sector miscompare at offset %x-%x. File: %s\n",
+            firstsector * sector_size_,
+            ((lastsector + 1) * sector_size_) - 1,
+            filename_.c_str());
+
+  // Either exit immediately, or patch the data up and continue.
+  if (sat_->stop_on_error()) {
+    exit(1);
+  } else {
+    // Patch up bad pages.
+    for (int block = (firstsector * sector_size_) / page_length;
+        block <= (lastsector * sector_size_) / page_length;
+        block++) {
+      unsigned int *memblock = static_cast<unsigned int *>(dst->addr);
+      int length = page_length / wordsize_;
+      for (int i = 0; i < length; i++) {
+        memblock[i] = dst->pattern->pattern(i);
+      }
     }
   }
+}
 
-  // Check each sector for the correct tag we added earlier,
-  // then revert the tag to the to normal data pattern.
-  unsigned char magic = ((0xba + thread_num_) & 0xff);
-  for (int sec = 0; sec < page_length / 512; sec++) {
-    // Check magic tag.
-    if ((tag[sec].magic != magic) ||
-        (tag[sec].block != (block & 0xff)) ||
-        (tag[sec].sector != (sec & 0xff)) ||
-        (tag[sec].pass != (pass_ & 0xff))) {
-      // Offset calculation for tag location.
-      int offset = sec * sizeof(SectorTag);
-      if (tag[sec].block != (block & 0xff))
-        offset += 1 * sizeof(uint8);
-      else if (tag[sec].sector != (sec & 0xff))
-        offset += 2 * sizeof(uint8);
-      else if (tag[sec].pass != (pass_ & 0xff))
-        offset += 3 * sizeof(uint8);
-
-      // Run sector tag error through diagnoser for logging and reporting.
-      errorcount_ += 1;
-      os_->error_diagnoser_->AddHDDSectorTagError(devicename_, tag[sec].block,
-                                                  offset,
-                                                  tag[sec].sector,
-                                                  page.src, page.dst);
-
-      errorcount_ += 1;
-      logprintf(5, "Sector Error: Sector tag @ 0x%x, pass %d/%d. "
-                "sec %x/%x, block %d/%d, magic %x/%x, File: %s \n",
-                block * page_length + 512 * sec,
-                (pass_ & 0xff), (unsigned int)tag[sec].pass,
-                sec, (unsigned int)tag[sec].sector,
-                block, (unsigned int)tag[sec].block,
-                magic, (unsigned int)tag[sec].magic,
-                filename_.c_str());
+// Check sector tagging.
+bool FileThread::SectorValidatePage(const struct PageRec &page,
+                                    struct page_entry *dst, int block) {
+  // Do sector tag compare.
+  int firstsector = -1;
+  int lastsector = -1;
+  int page_length = sat_->page_length();
+  int sectors = page_length / sector_size_;
+  char *data = static_cast<char*>(dst->addr);
 
+  SectorInjectErrors(dst);
+
+  // Check each sector for the correct tag we added earlier, a whole word
+  // at a time, then revert the tag to the to normal data pattern.
+  for (int sec = 0; sec < sectors; sec++) {
+    uint32 *addr = reinterpret_cast<uint32*>(data + sec * sector_size_);
+    if (*addr != SectorTagWord(block, sec)) {
+      SectorTagError(page, dst, block, sec);
       // Keep track of first and last bad sector.
       if (firstsector == -1)
-        firstsector = (block * page_length / 512) + sec;
-      lastsector = (block * page_length / 512) + sec;
-      badsector = true;
+        firstsector = block * sectors + sec;
+      lastsector = block * sectors + sec;
     }
     // Patch tag back to proper pattern.
-    unsigned int *addr = (unsigned int *)(&tag[sec]);
-    *addr = dst->pattern->pattern(512 * sec / sizeof(*addr));
+    *addr = dst->pattern->pattern(sec * sector_size_ / sizeof(*addr));
   }
 
   // If we found sector errors:
-  if (badsector == true) {
-    logprintf(5, "Log: file sector miscompare at offset %x-%x. File: %s\n",
-              firstsector * 512,
-              ((lastsector + 1) * 512) - 1,
-              filename_.c_str());
-
-    // Either exit immediately, or patch the data up and continue.
-    if (sat_->stop_on_error()) {
-      exit(1);
-    } else {
-      // Patch up bad pages.
-      for (int block = (firstsector * 512) / page_length;
-          block <= (lastsector * 512) / page_length;
-          block++) {
-        unsigned int *memblock = static_cast<unsigned int *>(dst->addr);
-        int length = page_length / wordsize_;
-        for (int i = 0; i < length; i++) {
-          memblock[i] = dst->pattern->pattern(i);
-        }
+  if (firstsector != -1)
+    SectorRangeError(dst, firstsector, lastsector);
+  return true;
+}
+
+int FileThread::SectorCheckPage(const struct PageRec &page,
+                                struct page_entry *dst, int block) {
+  const int blockwords = Pattern::kExpandedWords;
+  const int blocksize = blockwords * sizeof(uint64);
+  int page_length = sat_->page_length();
+
+  // Address tags change the data of every block, and short pages don't
+  // fill one, so those use the separate passes.
+  if (tag_mode_ || page_length % blocksize) {
+    SectorValidatePage(page, dst, block);
+    return CrcCheckPage(dst);
+  }
+
+  SectorInjectErrors(dst);
+
+  int sectors = page_length / sector_size_;
+  int firstsector = -1;
+  int lastsector = -1;
+  int errors = 0;
+  uint64 *memblock = static_cast<uint64*>(dst->addr);
+  const uint64 *pattern_block = dst->pattern->expected_block();
+  uint64 expected[blockwords];
+  uint64 mismatch[blockwords / 64];
+  memcpy(expected, pattern_block, sizeof(expected));
+
+  int sec = 0;
+  for (int currentblock = 0; currentblock < page_length / blocksize;
+       currentblock++) {
+    uint64 *memslice = memblock + currentblock * blockwords;
+    int start = currentblock * blocksize;
+    int end = start + blocksize;
+    // Sectors starting in this block are [sec, last).
+    int last = sec;
+    while (last < sectors && last * sector_size_ < end)
+      last++;
+
+    // Expect the tags in place of the data they cover.
+    for (int s = sec; s < last; s++) {
+      uint32 tag = SectorTagWord(block, s);
+      memcpy(reinterpret_cast<char*>(expected) + s * sector_size_ - start,
+             &tag, sizeof(tag));
+    }
+
+    int bad = os_->PatternCompare(memslice, expected, blockwords, mismatch);
+
+    // Check the tags that differ and revert all of them to the pattern.
+    for (; sec < last; sec++) {
+      int word = (sec * sector_size_ - start) / sizeof(*memslice);
+      uint32 *addr = reinterpret_cast<uint32*>(memslice + word);
+      if (bad && (mismatch[word / 64] & (1ULL << (word & 63))) &&
+          *addr != SectorTagWord(block, sec)) {
+        SectorTagError(page, dst, block, sec);
+        // Keep track of first and last bad sector.
+        if (firstsector == -1)
+          firstsector = block * sectors + sec;
+        lastsector = block * sectors + sec;
       }
+      *addr = dst->pattern->pattern(sec * sector_size_ / sizeof(*addr));
+      expected[word] = pattern_block[word];
+    }
+
+    // Flagged words that are still wrong with the tags reverted are data
+    // errors.
+    if (bad) {
+      logprintf(11, "Log: SectorCheckPage falling through to slow compare "
+                "on block %d\n", currentblock);
+      errors += CheckRegion(memslice, dst->pattern, dst->lastcpu, blocksize,
+                            start, 0, mismatch);
     }
   }
-  return true;
+
+  if (firstsector != -1)
+    SectorRangeError(dst, firstsector, lastsector);
+  return errors;
 }
 
 // Get memory for an incoming data transfer..
@@ -1848,18 +2913,12 @@ bool FileThread::PagePrepare() {
   // We can only do direct IO to SAT pages if it is normal mem.
   page_io_ = os_->normal_mem();
 
-  // Init a local buffer if we need it.
+  // Borrow a local buffer if we need it.
   if (!page_io_) {
-#ifdef HAVE_POSIX_MEMALIGN
-    int result = posix_memalign(&local_page_, 512, sat_->page_length());
-#else
-    local_page_ = memalign(512, sat_->page_length());
-    int result = (local_page_ == 0);
-#endif
-    if (result) {
-      logprintf(0, "Process Error: disk thread posix_memalign "
-                   "returned %d (fail)\n",
-                result);
+    local_page_ = sat_->io_buffers()->Get();
+    if (!local_page_) {
+      logprintf(0, "Process Error: file thread %d failed to get an I/O "
+                   "buffer\n", thread_num_);
       status_ = false;
       return false;
     }
@@ -1870,9 +2929,10 @@ bool FileThread::PagePrepare() {
 
 // Remove memory allocated for data transfer.
 bool FileThread::PageTeardown() {
-  // Free a local buffer if we need to.
+  // Return a local buffer if we need to.
   if (!page_io_) {
-    free(local_page_);
+    sat_->io_buffers()->Put(local_page_);
+    local_page_ = NULL;
   }
   return true;
 }
@@ -1954,13 +3014,13 @@ bool FileThread::ReadPages(int fd) {
         return false;
     }
 
-    SectorValidatePage(page_recs_[i], &dst, i);
-
     // Ensure that the transfer ended up with correct data.
-    if (strict) {
+    if (!strict) {
+      SectorValidatePage(page_recs_[i], &dst, i);
+    } else {
       // Record page index currently CRC checked.
       crc_page_ = i;
-      int errors = CrcCheckPage(&dst);
+      int errors = SectorCheckPage(page_recs_[i], &dst, i);
       if (errors) {
         logprintf(5, "Log: file miscompare at block %d, "
                   "offset %x-%x. File: %s\n",
@@ -1969,7 +3029,7 @@ bool FileThread::ReadPages(int fd) {
         result = false;
       }
       crc_page_ = -1;
-      errorcount_ += errors;
+      stats_->AddErrors(errors);
     }
     if (!PutValidPage(&dst))
       return false;
@@ -1992,47 +3052,377 @@ bool FileThread::Work() {
     return false;
   }
 
-  // Open the data IO file.
-  int fd = 0;
-  if (!OpenFile(&fd)) {
-    status_ = false;
+  // Open the data IO file.
+  int fd = 0;
+  if (!OpenFile(&fd)) {
+    status_ = false;
+    return false;
+  }
+
+  pass_ = 0;
+
+  // Load patterns into page records.
+  page_recs_ = new struct PageRec[sat_->disk_pages()];
+  for (int i = 0; i < sat_->disk_pages(); i++) {
+    page_recs_[i].pattern = new class Pattern();
+  }
+
+  // Loop until done.
+  while (IsReadyToRun()) {
+    // Do the file write.
+    if (!(result = result && WritePages(fd)))
+      break;
+
+    // Do the file read.
+    if (!(result = result && ReadPages(fd)))
+      break;
+
+    loops++;
+    pass_ = loops;
+    stats_->set_pages(loops * sat_->disk_pages());
+  }
+
+
+  // Clean up.
+  CloseFile(fd);
+  PageTeardown();
+
+  logprintf(9, "Log: Completed %d: file thread status %d, %d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  // Failure to read from device indicates hardware,
+  // rather than procedural SW error.
+  status_ = true;
+  return true;
+}
+
+AsyncFileThread::AsyncFileThread() {
+  queue_depth_ = 32;
+  uring_ = NULL;
+  inflight_ = 0;
+  abandoned_ = false;
+}
+
+AsyncFileThread::~AsyncFileThread() {
+  TeardownBuffers();
+}
+
+void AsyncFileThread::AddFile(const char *filename) {
+  struct TestFile file;
+  file.name = filename;
+  file.device = os_->FindFileDevice(file.name);
+  file.fd = -1;
+  file.recs = NULL;
+  files_.push_back(file);
+  // The first file names the thread in logs.
+  if (files_.size() == 1)
+    SetFile(filename);
+}
+
+bool AsyncFileThread::SetupBuffers() {
+  for (int i = 0; i < queue_depth_; i++) {
+    void *buffer = sat_->io_buffers()->Get();
+    if (!buffer) {
+      logprintf(0, "Process Error: Unable to get file buffers "
+                   "(thread %d).\n", thread_num_);
+      return false;
+    }
+    buffers_.push_back(buffer);
+    struct Slot slot = { -1, 0, false };
+    slots_.push_back(slot);
+    free_slots_.push_back(i);
+  }
+
+  uring_ = new DiskUring();
+  int error = -uring_->Initialize(queue_depth_);
+  if (error) {
+    char buf[256];
+    sat_strerror(error, buf, sizeof(buf));
+    logprintf(0, "Log: Unable to create io_uring for file thread %d, "
+                 "Error %d, %s. Using synchronous I/O instead.\n",
+              thread_num_, error, buf);
+    delete uring_;
+    uring_ = NULL;
+    return true;
+  }
+
+  // The buffers live as long as the thread, register them once.
+  error = -uring_->RegisterBuffers(&buffers_[0], buffers_.size(),
+                                   sat_->page_length());
+  if (error) {
+    char buf[256];
+    sat_strerror(error, buf, sizeof(buf));
+    logprintf(5, "Log: Unable to register io_uring buffers for file "
+                 "thread %d, Error %d, %s.\n", thread_num_, error, buf);
+  }
+  logprintf(9, "Log: Using io_uring with queue depth %d for %d files "
+               "(thread %d).\n",
+            queue_depth_, static_cast<int>(files_.size()), thread_num_);
+  return true;
+}
+
+void AsyncFileThread::TeardownBuffers() {
+  delete uring_;
+  uring_ = NULL;
+  inflight_ = 0;
+  // The kernel may still write into buffers of abandoned requests.
+  if (!abandoned_) {
+    for (size_t i = 0; i < buffers_.size(); i++)
+      sat_->io_buffers()->Put(buffers_[i]);
+  }
+  buffers_.clear();
+  slots_.clear();
+  free_slots_.clear();
+  sync_done_.clear();
+}
+
+void AsyncFileThread::SelectFile(int file) {
+  filename_ = files_[file].name;
+  devicename_ = files_[file].device;
+  page_recs_ = files_[file].recs;
+}
+
+int AsyncFileThread::FreeSlot() {
+  while (free_slots_.empty()) {
+    if (!ReapOne())
+      return -1;
+  }
+  int slot = free_slots_.back();
+  free_slots_.pop_back();
+  return slot;
+}
+
+bool AsyncFileThread::QueueIO(int slot, int file, int block, bool write) {
+  int page_length = sat_->page_length();
+  int64 offset = static_cast<int64>(block) * page_length;
+  slots_[slot].file = file;
+  slots_[slot].block = block;
+  slots_[slot].write = write;
+  slots_[slot].start_time = sat_get_time_us();
+  inflight_++;
+
+  if (!uring_) {
+    int fd = files_[file].fd;
+    int64 size = write ?
+        pwrite64(fd, buffers_[slot], page_length, offset) :
+        pread64(fd, buffers_[slot], page_length, offset);
+    if (size < 0)
+      size = -errno;
+    sync_done_.push_back(make_pair(slot, size));
+    return true;
+  }
+
+  if (uring_->Queue(write, files_[file].fd, buffers_[slot], page_length,
+                    offset, slot, slot))
+    return true;
+  // The submission ring is full, hand it to the kernel and retry.
+  int error = -uring_->Submit();
+  if (!error && uring_->Queue(write, files_[file].fd, buffers_[slot],
+                              page_length, offset, slot, slot))
+    return true;
+  inflight_--;
+  char buf[256];
+  sat_strerror(error, buf, sizeof(buf));
+  logprintf(0, "Process Error: file thread %d failed to queue I/O, "
+               "Error %d, %s.\n", thread_num_, error, buf);
+  return false;
+}
+
+bool AsyncFileThread::ReapOne() {
+  int slot;
+  int64 result;
+  if (!uring_) {
+    if (sync_done_.empty())
+      return false;
+    slot = sync_done_.back().first;
+    result = sync_done_.back().second;
+    sync_done_.pop_back();
+  } else {
+    int error = -uring_->Submit();
+    uint64 user_data = 0;
+    while (!error) {
+      error = -uring_->WaitCompletion(&user_data, &result, kIoTimeoutUs);
+      if (error != EINTR)
+        break;
+      error = 0;
+    }
+    if (error) {
+      char buf[256];
+      sat_strerror(error, buf, sizeof(buf));
+      logprintf(0, "Block Error: file thread %d gave up waiting for %d "
+                   "requests on %s, Error %d, %s.\n",
+                thread_num_, inflight_, filename_.c_str(), error, buf);
+      stats_->AddErrors(1);
+      abandoned_ = true;
+      return false;
+    }
+    slot = user_data;
+  }
+  inflight_--;
+  bool ok = FinishSlot(slot, result);
+  free_slots_.push_back(slot);
+  return ok;
+}
+
+bool AsyncFileThread::Drain() {
+  bool result = true;
+  while (inflight_ && !abandoned_)
+    result = ReapOne() && result;
+  return result && !abandoned_;
+}
+
+bool AsyncFileThread::FinishSlot(int slot, int64 result) {
+  int page_length = sat_->page_length();
+  const struct Slot &request = slots_[slot];
+  SelectFile(request.file);
+  LatencyHistogram *latency = request.write ? &write_latency_ :
+                                              &read_latency_;
+  latency->Record(sat_get_time_us() - request.start_time);
+
+  if (result != page_length) {
+    os_->ErrorReport(devicename_.c_str(),
+                     request.write ? "write-error" : "read-error", 1);
+    stats_->AddErrors(1);
+    logprintf(0, "Block Error: file_thread failed to %s %s at block %d "
+              "(%lld), bailing\n", request.write ? "write" : "read",
+              filename_.c_str(), request.block, result);
+    return false;
+  }
+  if (request.write)
+    return true;
+
+  // The read data, with the sector tags written along with it.
+  struct PageRec &rec = page_recs_[request.block];
+  struct page_entry src;
+  memset(&src, 0, sizeof(src));
+  src.addr = buffers_[slot];
+  src.pattern = rec.pattern;
+  SectorValidatePage(rec, &src, request.block);
+
+  struct page_entry dst;
+  if (!sat_->GetEmpty(&dst))
+    return false;
+  dst.pattern = rec.pattern;
+  dst.lastcpu = sched_getcpu();
+  // Check the data on its way back into the page pool.
+  crc_page_ = request.block;
+  int errors = CrcCopyPage(&dst, &src);
+  crc_page_ = -1;
+  if (errors) {
+    logprintf(5, "Log: file miscompare at block %d, "
+              "offset %x-%x. File: %s\n",
+              request.block, request.block * page_length,
+              ((request.block + 1) * page_length) - 1, filename_.c_str());
+    stats_->AddErrors(errors);
+  }
+  return sat_->PutValid(&dst);
+}
+
+bool AsyncFileThread::WriteFiles() {
+  int files = files_.size();
+  // Interleave the files so that all of them have requests in flight.
+  for (int block = 0; block < sat_->disk_pages(); block++) {
+    for (int file = 0; file < files; file++) {
+      int slot = FreeSlot();
+      if (slot < 0)
+        return false;
+      struct page_entry src;
+      if (!sat_->GetValid(&src)) {
+        free_slots_.push_back(slot);
+        return false;
+      }
+      struct page_entry buffer;
+      memset(&buffer, 0, sizeof(buffer));
+      buffer.addr = buffers_[slot];
+      buffer.pattern = src.pattern;
+      // CRC check the page while taking it out of the pool.
+      int errors = CrcCopyPage(&buffer, &src);
+      if (errors)
+        stats_->AddErrors(errors);
+      files_[file].recs[block].pattern = src.pattern;
+      files_[file].recs[block].src = src.addr;
+      SectorTagPage(&buffer, block);
+      // The data lives in the file until it is read back.
+      bool result = sat_->PutEmpty(&src);
+      result = result && QueueIO(slot, file, block, true);
+      if (!result) {
+        free_slots_.push_back(slot);
+        return false;
+      }
+    }
+  }
+  if (!Drain())
     return false;
+  for (int file = 0; file < files; file++) {
+    if (!BypassPageCache(files_[file].fd, 0,
+                         static_cast<int64>(sat_->disk_pages()) *
+                         sat_->page_length()))
+      return false;
   }
+  return true;
+}
 
-  pass_ = 0;
-
-  // Load patterns into page records.
-  page_recs_ = new struct PageRec[sat_->disk_pages()];
-  for (int i = 0; i < sat_->disk_pages(); i++) {
-    page_recs_[i].pattern = new class Pattern();
+bool AsyncFileThread::ReadFiles() {
+  int files = files_.size();
+  for (int block = 0; block < sat_->disk_pages(); block++) {
+    for (int file = 0; file < files; file++) {
+      int slot = FreeSlot();
+      if (slot < 0)
+        return false;
+      files_[file].recs[block].dst = buffers_[slot];
+      if (!QueueIO(slot, file, block, false)) {
+        free_slots_.push_back(slot);
+        return false;
+      }
+    }
   }
+  return Drain();
+}
 
-  // Loop until done.
-  while (IsReadyToRun()) {
-    // Do the file write.
-    if (!(result = result && WritePages(fd)))
-      break;
+bool AsyncFileThread::Work() {
+  int64 loops = 0;
+  int files = files_.size();
+
+  logprintf(9, "Log: Starting async file thread %d, %d files, "
+            "queue depth %d\n", thread_num_, files, queue_depth_);
+
+  bool setup = true;
+  for (int i = 0; i < files && setup; i++) {
+    setup = OpenPath(files_[i].name, &files_[i].fd);
+    if (setup) {
+      files_[i].recs = new struct PageRec[sat_->disk_pages()];
+      memset(files_[i].recs, 0,
+             sat_->disk_pages() * sizeof(*files_[i].recs));
+    }
+  }
+  setup = setup && SetupBuffers();
 
-    // Do the file read.
-    if (!(result = result && ReadPages(fd)))
+  pass_ = 0;
+  while (setup && IsReadyToRun()) {
+    if (!WriteFiles() || !ReadFiles())
       break;
-
     loops++;
     pass_ = loops;
+    stats_->set_pages(loops * sat_->disk_pages() * files);
   }
-
-  pages_copied_ = loops * sat_->disk_pages();
+  Drain();
 
   // Clean up.
-  CloseFile(fd);
-  PageTeardown();
+  TeardownBuffers();
+  for (int i = 0; i < files; i++) {
+    if (files_[i].fd >= 0)
+      CloseFile(files_[i].fd);
+    files_[i].fd = -1;
+    delete[] files_[i].recs;
+    files_[i].recs = NULL;
+  }
+  page_recs_ = NULL;
 
-  logprintf(9, "Log: Completed %d: file thread status %d, %d pages copied\n",
-            thread_num_, status_, pages_copied_);
   // Failure to read from device indicates hardware,
   // rather than procedural SW error.
-  status_ = true;
-  return true;
+  status_ = setup;
+  logprintf(9, "Log: Completed %d: async file thread status %d, %d pages "
+            "copied\n", thread_num_, status_, stats_->pages());
+  return status_;
 }
 
 bool NetworkThread::IsNetworkStopSet() {
@@ -2057,7 +3447,7 @@ bool NetworkThread::CreateSocket(int *psocket) {
   int sock = socket(AF_INET, SOCK_STREAM, 0);
   if (sock == -1) {
     logprintf(0, "Process Error: Cannot open socket\n");
-    pages_copied_ = 0;
+    stats_->set_pages(0);
     status_ = false;
     return false;
   }
@@ -2081,7 +3471,7 @@ bool NetworkThread::Connect(int sock) {
   // Translate dot notation to u32.
   if (inet_aton(ipaddr_, &dest_addr.sin_addr) == 0) {
     logprintf(0, "Process Error: Cannot resolve %s\n", ipaddr_);
-    pages_copied_ = 0;
+    stats_->set_pages(0);
     status_ = false;
     return false;
   }
@@ -2089,7 +3479,7 @@ bool NetworkThread::Connect(int sock) {
   if (-1 == connect(sock, reinterpret_cast<struct sockaddr *>(&dest_addr),
                     sizeof(struct sockaddr))) {
     logprintf(0, "Process Error: Cannot connect %s\n", ipaddr_);
-    pages_copied_ = 0;
+    stats_->set_pages(0);
     status_ = false;
     return false;
   }
@@ -2110,11 +3500,12 @@ bool NetworkListenThread::Listen() {
     char buf[256];
     sat_strerror(errno, buf, sizeof(buf));
     logprintf(0, "Process Error: Cannot bind socket: %s\n", buf);
-    pages_copied_ = 0;
+    stats_->set_pages(0);
     status_ = false;
     return false;
   }
-  listen(sock_, 3);
+  // An event thread pool is meant to take many connections at once.
+  listen(sock_, sat_->net_event_threads() ? SOMAXCONN : 3);
   return true;
 }
 
@@ -2144,7 +3535,7 @@ bool NetworkListenThread::GetConnection(int *pnewsock) {
   int newsock = accept(sock_, reinterpret_cast<struct sockaddr *>(&sa), &size);
   if (newsock < 0)  {
     logprintf(0, "Process Error: Did not receive connection\n");
-    pages_copied_ = 0;
+    stats_->set_pages(0);
     status_ = false;
     return false;
   }
@@ -2157,10 +3548,43 @@ bool NetworkThread::SendPage(int sock, struct page_entry *src) {
   int page_length = sat_->page_length();
   char *address = static_cast<char*>(src->addr);
 
+  if (rdma_) {
+    // The peer checks the page against the pattern sent with it, and
+    // replies with its miscompare count.
+    uint32 errors = 0;
+    if (!rdma_->Write(address, page_length,
+                      patternlist_->IndexOf(src->pattern)) ||
+        rdma_->Receive(&errors, kRdmaReplyMs) != 1) {
+      if (!IsNetworkStopSet()) {
+        logprintf(0, "Process Error: Thread %d, "
+                     "RDMA write to %s failed, bailing.\n",
+                  thread_num_, ipaddr_);
+        status_ = false;
+      }
+      return false;
+    }
+    if (errors)
+      logprintf(0, "Log: Thread %d, %s saw %u miscompares in an RDMA "
+                "written page\n", thread_num_, ipaddr_, errors);
+    return true;
+  }
+
+  int flags = 0;
+#ifdef STRESSAPPTEST_NET_ZEROCOPY
+  if (zerocopy_)
+    flags |= MSG_ZEROCOPY;
+#endif
+
   // Send our data over the network.
   int size = page_length;
   while (size) {
-    int transferred = send(sock, address + (page_length - size), size, 0);
+    int transferred = send(sock, address + (page_length - size), size, flags);
+    if ((transferred == -1) && (errno == ENOBUFS) && zerocopy_) {
+      // Out of memory to pin pages with, let earlier sends complete.
+      if (!WaitZeroCopy(sock, zerocopy_sent_))
+        return false;
+      continue;
+    }
     if ((transferred == 0) || (transferred == -1)) {
       if (!IsNetworkStopSet()) {
         char buf[256] = "";
@@ -2172,6 +3596,9 @@ bool NetworkThread::SendPage(int sock, struct page_entry *src) {
       }
       return false;
     }
+    // Each successful zero copy send gets the next completion id.
+    if (zerocopy_)
+      zerocopy_sent_++;
     size = size - transferred;
   }
   return true;
@@ -2182,10 +3609,27 @@ bool NetworkThread::ReceivePage(int sock, struct page_entry *dst) {
   int page_length = sat_->page_length();
   char *address = static_cast<char*>(dst->addr);
 
+  if (rdma_) {
+    if (!rdma_->Read(address, page_length)) {
+      if (!IsNetworkStopSet()) {
+        logprintf(0, "Process Error: Thread %d, "
+                     "RDMA read from %s failed, bailing.\n",
+                  thread_num_, ipaddr_);
+        status_ = false;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  // In zero copy mode, ask for the whole page in one call rather than
+  // returning to user space for each chunk that arrives.
+  int flags = zerocopy_ ? MSG_WAITALL : 0;
+
   // Maybe we will get our data back again, maybe not.
   int size = page_length;
   while (size) {
-    int transferred = recv(sock, address + (page_length - size), size, 0);
+    int transferred = recv(sock, address + (page_length - size), size, flags);
     if ((transferred == 0) || (transferred == -1)) {
       // Typically network slave thread should exit as network master
       // thread stops sending data.
@@ -2225,6 +3669,105 @@ bool NetworkThread::ReceivePage(int sock, struct page_entry *dst) {
   return true;
 }
 
+// Turn on zero copy sends for this socket.
+void NetworkThread::SetupZeroCopy(int sock) {
+  if (!sat_->net_zerocopy())
+    return;
+#ifdef STRESSAPPTEST_NET_ZEROCOPY
+  int one = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+    zerocopy_ = true;
+    return;
+  }
+  char buf[256] = "";
+  sat_strerror(errno, buf, sizeof(buf));
+  logprintf(6, "Log: Thread %d, can't enable zero copy sends (%s), "
+               "using regular sends.\n", thread_num_, buf);
+#else
+  logprintf(6, "Log: Thread %d, zero copy sends not compiled in, "
+               "using regular sends.\n", thread_num_);
+#endif
+}
+
+// Wait until the kernel has released the first 'sent' zero copy sends.
+// Completions arrive on the socket error queue as ranges of send ids.
+bool NetworkThread::WaitZeroCopy(int sock, uint32 sent) {
+#ifdef STRESSAPPTEST_NET_ZEROCOPY
+  while (static_cast<int32>(zerocopy_done_ - sent) < 0) {
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = 0;
+    pfd.revents = 0;
+    // The error queue is always polled for, as POLLERR.
+    int ready = poll(&pfd, 1, 1000);
+    if (ready == 0 || (ready == -1 && errno == EINTR)) {
+      if (IsNetworkStopSet())
+        return false;
+      continue;
+    }
+
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (ready == -1 || recvmsg(sock, &msg, MSG_ERRQUEUE) == -1) {
+      int err = errno;
+      if (err == EAGAIN) {
+        // Woken up by a pending socket error rather than a completion.
+        socklen_t len = sizeof(err);
+        err = 0;
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (!err && !(pfd.revents & POLLHUP))
+          continue;
+      }
+      if (!IsNetworkStopSet()) {
+        char buf[256] = "";
+        sat_strerror(err, buf, sizeof(buf));
+        logprintf(0, "Process Error: Thread %d, "
+                     "zero copy completion failed, bailing. (%s)\n",
+                  thread_num_, buf);
+        status_ = false;
+      }
+      return false;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        continue;
+      struct sock_extended_err *ee =
+          reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+      if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      // Sends ee_info through ee_data are done with the page.
+#ifdef SO_EE_CODE_ZEROCOPY_COPIED
+      if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        zerocopy_copied_ += ee->ee_data - ee->ee_info + 1;
+#endif
+      zerocopy_done_ = ee->ee_data + 1;
+    }
+  }
+#endif
+  return true;
+}
+
+// Connect the RDMA queue pair, using the socket to find the peer.
+bool NetworkThread::ConnectRdma(int sock, void *exposed, uint64 length) {
+  rdma_ = new RdmaConnection;
+  if (rdma_->Connect(sat_->rdma(), sock, exposed, length)) {
+    logprintf(9, "Log: Thread %d, RDMA connected on %s\n", thread_num_,
+              sat_->rdma()->name().c_str());
+    return true;
+  }
+  logprintf(0, "Process Error: Thread %d, RDMA connection failed\n",
+            thread_num_);
+  delete rdma_;
+  rdma_ = NULL;
+  return false;
+}
+
 // Network IO work loop. Execute until marked done.
 // Return true if the thread ran as expected.
 bool NetworkThread::Work() {
@@ -2240,8 +3783,17 @@ bool NetworkThread::Work() {
   // Network IO loop requires network slave thread to have already initialized.
   // We will sleep here for awhile to ensure that the slave thread will be
   // listening by the time we connect.
-  // Sleep for 15 seconds.
-  sat_sleep(15);
+  // Sleep for 15 seconds, or until the start the net coordinator gave.
+  int64 start_us = sat_->net_start_us();
+  if (!start_us) {
+    sat_sleep(15);
+  } else {
+    int64 delay = start_us - sat_get_time_us();
+    while (delay > 0 && IsReadyToRunNoPause()) {
+      sat_usleep(delay < 1000000 ? delay : 1000000);
+      delay = start_us - sat_get_time_us();
+    }
+  }
   logprintf(9, "Log: Starting execution of network thread %d, ip %s\n",
             thread_num_,
             ipaddr_);
@@ -2250,11 +3802,18 @@ bool NetworkThread::Work() {
   // Connect to a slave thread.
   if (!Connect(sock))
     return false;
+  SetupZeroCopy(sock);
+  if (sat_->net_rdma() && !ConnectRdma(sock, NULL, 0)) {
+    CloseSocket(sock);
+    status_ = false;
+    return false;
+  }
 
   // Loop until done.
   bool result = true;
   int strict = sat_->strict();
   int64 loops = 0;
+  int64 stream_start = sat_get_time_us();
   while (IsReadyToRun()) {
     struct page_entry src;
     struct page_entry dst;
@@ -2282,6 +3841,10 @@ bool NetworkThread::Work() {
     if (!(result = result && ReceivePage(sock, &dst)))
       break;
 
+    // The kernel may still be sending straight out of src.
+    if (!(result = result && WaitZeroCopy(sock, zerocopy_sent_)))
+      break;
+
     // Ensure that the transfer ended up with correct data.
     if (strict)
       CrcCheckPage(&dst);
@@ -2295,17 +3858,23 @@ bool NetworkThread::Work() {
       break;
     }
     loops++;
+    stats_->set_pages(loops);
   }
+  stream_usec_ = sat_get_time_us() - stream_start;
 
-  pages_copied_ = loops;
   status_ = result;
 
   // Clean up.
+  delete rdma_;
+  rdma_ = NULL;
   CloseSocket(sock);
 
+  if (zerocopy_ && zerocopy_copied_)
+    logprintf(9, "Log: Thread %d, %lld of %u zero copy sends were copied\n",
+              thread_num_, zerocopy_copied_, zerocopy_sent_);
   logprintf(9, "Log: Completed %d: network thread status %d, "
                "%d pages copied\n",
-            thread_num_, status_, pages_copied_);
+            thread_num_, status_, stats_->pages());
   return result;
 }
 
@@ -2325,12 +3894,41 @@ bool NetworkListenThread::SpawnSlave(int newsock, int threadid) {
   return true;
 }
 
+// Spawn the event threads that serve all incoming connections.
+bool NetworkListenThread::SpawnEventThreads(int count) {
+  logprintf(12, "Log: Listen thread spawning %d event threads\n", count);
+
+  for (int i = 0; i < count; i++) {
+    EventWorker *event_worker = new EventWorker;
+    event_worker->thread.InitThread(i, sat_, os_, patternlist_,
+                                    &event_worker->status);
+    event_worker->status.Initialize();
+    event_worker->thread.SpawnThread();
+    event_workers_.push_back(event_worker);
+  }
+  return true;
+}
+
 // Reap slave threads.
 bool NetworkListenThread::ReapSlaves() {
   bool result = true;
   // Gather status and reap threads.
   logprintf(12, "Log: Joining all outstanding threads\n");
 
+  for (size_t i = 0; i < event_workers_.size(); i++)
+    event_workers_[i]->thread.Stop();
+  for (size_t i = 0; i < event_workers_.size(); i++) {
+    NetworkEventThread& event_thread = event_workers_[i]->thread;
+    logprintf(12, "Log: Joining event thread %d\n", i);
+    event_thread.JoinThread();
+    if (event_thread.GetStatus() != 1) {
+      logprintf(0, "Process Error: Event Thread %d failed with status %d\n",
+                i, event_thread.GetStatus());
+      result = false;
+    }
+    stats_->set_pages(stats_->pages() + event_thread.GetPageCount());
+  }
+
   for (size_t i = 0; i < child_workers_.size(); i++) {
     NetworkSlaveThread& child_thread = child_workers_[i]->thread;
     logprintf(12, "Log: Joining slave thread %d\n", i);
@@ -2340,10 +3938,10 @@ bool NetworkListenThread::ReapSlaves() {
                 child_thread.GetStatus());
       result = false;
     }
-    errorcount_ += child_thread.GetErrorCount();
+    stats_->AddErrors(child_thread.GetErrorCount());
     logprintf(9, "Log: Slave Thread %d found %lld miscompares\n", i,
               child_thread.GetErrorCount());
-    pages_copied_ += child_thread.GetPageCount();
+    stats_->set_pages(stats_->pages() + child_thread.GetPageCount());
   }
 
   return result;
@@ -2368,7 +3966,12 @@ bool NetworkListenThread::Work() {
   Listen();
   logprintf(12, "Log: Listen thread waiting for incoming connections\n");
 
-  // Wait on incoming connections, and spawn worker threads for them.
+  int event_threads = sat_->net_event_threads();
+  if (event_threads)
+    SpawnEventThreads(event_threads);
+
+  // Wait on incoming connections, and spawn worker threads for them,
+  // or spread them over the event threads.
   int threadcount = 0;
   while (IsReadyToRun()) {
     // Poll for connections that we can accept().
@@ -2376,98 +3979,458 @@ bool NetworkListenThread::Work() {
       // Accept those connections.
       logprintf(12, "Log: Listen thread found incoming connection\n");
       if (GetConnection(&newsock)) {
-        SpawnSlave(newsock, threadcount);
+        if (event_threads)
+          event_workers_[threadcount % event_threads]->thread.AddSock(newsock);
+        else
+          SpawnSlave(newsock, threadcount);
         threadcount++;
       }
     }
-  }
+  }
+
+  // Gather status and join spawned threads.
+  ReapSlaves();
+
+  // Delete the child workers.
+  for (ChildVector::iterator it = child_workers_.begin();
+       it != child_workers_.end(); ++it) {
+    (*it)->status.Destroy();
+    delete *it;
+  }
+  child_workers_.clear();
+  for (EventVector::iterator it = event_workers_.begin();
+       it != event_workers_.end(); ++it) {
+    (*it)->status.Destroy();
+    delete *it;
+  }
+  event_workers_.clear();
+
+  CloseSocket(sock_);
+
+  status_ = true;
+  logprintf(9,
+            "Log: Completed %d: network listen thread status %d, "
+            "%d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  return true;
+}
+
+NetCoordinatorThread::NetCoordinatorThread(NetCoordinator *coordinator,
+                                           NetTopology topology, int hosts) {
+  coordinator_ = coordinator;
+  topology_ = topology;
+  hosts_ = hosts;
+}
+
+// Register the hosts, hand out their peers and collect their results.
+bool NetCoordinatorThread::Work() {
+  logprintf(9, "Log: Starting net coordinator thread %d for %d hosts, %s\n",
+            thread_num_, hosts_, NetCoordinator::TopologyName(topology_));
+  if (!coordinator_->Listen(kNetCoordinatorPort)) {
+    status_ = false;
+    return false;
+  }
+
+  while (coordinator_->hosts() < hosts_ && IsReadyToRunNoPause())
+    coordinator_->Register(hosts_, kPollMs);
+  if (coordinator_->hosts() < hosts_) {
+    logprintf(0, "Process Error: Only %d of %d hosts registered with the "
+              "net coordinator\n", coordinator_->hosts(), hosts_);
+    coordinator_->Close();
+    status_ = false;
+    return false;
+  }
+
+  bool result = coordinator_->Assign(topology_, kStartDelayMs);
+
+  // The hosts run for their own time from here on, which may end well
+  // after this run does.
+  int64 deadline = sat_get_time_us() + kStartDelayMs * 1000LL +
+      (coordinator_->max_host_seconds() + kReportGraceSeconds) * 1000000LL;
+  while (!coordinator_->Collect(kPollMs)) {
+    if (sat_get_time_us() > deadline) {
+      logprintf(0, "Process Error: Net coordinator timed out waiting for "
+                "host reports\n");
+      break;
+    }
+  }
+  coordinator_->Close();
+
+  if (coordinator_->reported() < hosts_) {
+    logprintf(0, "Process Error: Only %d of %d hosts reported to the net "
+              "coordinator\n", coordinator_->reported(), hosts_);
+    result = false;
+  }
+  // Errors on the links count against the fabric.
+  const vector<NetLinkResult> &links = coordinator_->links();
+  for (size_t i = 0; i < links.size(); i++)
+    stats_->AddErrors(links[i].errors);
+
+  status_ = result;
+  logprintf(9, "Log: Completed %d: net coordinator thread status %d, "
+            "%d links\n", thread_num_, status_,
+            static_cast<int>(links.size()));
+  return result;
+}
+
+// Set network reflector socket struct.
+void NetworkSlaveThread::SetSock(int sock) {
+  sock_ = sock;
+}
+
+// Network reflector IO work loop. Execute until marked done.
+// Return false on fatal software error.
+bool NetworkSlaveThread::Work() {
+  logprintf(9, "Log: Starting network slave thread %d\n",
+            thread_num_);
+
+  // Verify that we have a socket.
+  int sock = sock_;
+  if (!sock) {
+    status_ = false;
+    return false;
+  }
+
+  if (sat_->net_rdma())
+    return ReflectRdma(sock);
+
+  SetupZeroCopy(sock);
+
+  // Loop until done.
+  int64 loops = 0;
+  // Init local buffers for storing data. With zero copy sends, the kernel
+  // may still be transmitting one page while the next one is received
+  // into the other buffer.
+  int buffers = zerocopy_ ? 2 : 1;
+  void *local_pages[2] = { NULL, NULL };
+  uint32 sent_mark[2] = { 0, 0 };
+  for (int i = 0; i < buffers; i++) {
+#ifdef HAVE_POSIX_MEMALIGN
+    int result = posix_memalign(&local_pages[i], 512, sat_->page_length());
+#else
+    local_pages[i] = memalign(512, sat_->page_length());
+    int result = (local_pages[i] == 0);
+#endif
+    if (result) {
+      logprintf(0, "Process Error: net slave posix_memalign "
+                   "returned %d (fail)\n",
+                result);
+      free(local_pages[0]);
+      status_ = false;
+      return false;
+    }
+  }
+
+  struct page_entry page;
+
+  // This thread will continue to run as long as the thread on the other end of
+  // the socket is still sending and receiving data.
+  while (1) {
+    int current = loops % buffers;
+    page.addr = local_pages[current];
+
+    // Don't overwrite a page the kernel is still sending from.
+    if (!WaitZeroCopy(sock, sent_mark[current]))
+      break;
+
+    // Do the network read.
+    if (!ReceivePage(sock, &page))
+      break;
+
+    // Do the network write.
+    if (!SendPage(sock, &page))
+      break;
+    sent_mark[current] = zerocopy_sent_;
+
+    loops++;
+    stats_->set_pages(loops);
+  }
+
+  // Sends still in flight may point into the local pages.
+  WaitZeroCopy(sock, zerocopy_sent_);
+  for (int i = 0; i < buffers; i++)
+    free(local_pages[i]);
+
+  stats_->set_pages(loops);
+  // No results provided from this type of thread.
+  status_ = true;
+
+  // Clean up.
+  CloseSocket(sock);
+
+  logprintf(9,
+            "Log: Completed %d: network slave thread status %d, "
+            "%d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  return true;
+}
+
+bool NetworkSlaveThread::ReflectRdma(int sock) {
+  int page_length = sat_->page_length();
+  void *buffer = NULL;
+#ifdef HAVE_POSIX_MEMALIGN
+  int result = posix_memalign(&buffer, 4096, page_length);
+#else
+  buffer = memalign(4096, page_length);
+  int result = (buffer == 0);
+#endif
+  if (result) {
+    logprintf(0, "Process Error: net slave posix_memalign "
+                 "returned %d (fail)\n",
+              result);
+    CloseSocket(sock);
+    status_ = false;
+    return false;
+  }
+  if (!ConnectRdma(sock, buffer, page_length)) {
+    free(buffer);
+    CloseSocket(sock);
+    status_ = false;
+    return false;
+  }
+
+  struct page_entry page;
+  init_pe(&page);
+  page.addr = buffer;
+  int64 loops = 0;
+  int64 errors = 0;
+  while (1) {
+    uint32 index = 0;
+    int received = rdma_->Receive(&index, 1000);
+    if (received < 0)
+      break;
+    if (!received) {
+      // The sender is done once it closes the socket.
+      char byte;
+      if (recv(sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+        break;
+      continue;
+    }
 
-  // Gather status and join spawned threads.
-  ReapSlaves();
+    // Check the page as it landed, before it is read back.
+    uint32 miscompares = 0;
+    page.pattern = NULL;
+    if (index < static_cast<uint32>(patternlist_->Size()))
+      page.pattern = patternlist_->GetPattern(index);
+    if (page.pattern)
+      miscompares = CrcCheckPage(&page);
+    errors += miscompares;
+    if (!rdma_->Send(miscompares))
+      break;
 
-  // Delete the child workers.
-  for (ChildVector::iterator it = child_workers_.begin();
-       it != child_workers_.end(); ++it) {
-    (*it)->status.Destroy();
-    delete *it;
+    loops++;
+    stats_->set_pages(loops);
   }
-  child_workers_.clear();
-
-  CloseSocket(sock_);
 
+  delete rdma_;
+  rdma_ = NULL;
+  free(buffer);
+  CloseSocket(sock);
   status_ = true;
-  logprintf(9,
-            "Log: Completed %d: network listen thread status %d, "
-            "%d pages copied\n",
-            thread_num_, status_, pages_copied_);
+
+  logprintf(9, "Log: Completed %d: network slave thread status %d, "
+               "%d pages checked by RDMA, %lld miscompares\n",
+            thread_num_, status_, stats_->pages(), errors);
   return true;
 }
 
-// Set network reflector socket struct.
-void NetworkSlaveThread::SetSock(int sock) {
-  sock_ = sock;
+bool NetworkEventThread::IsNetworkStopSet() {
+  // Like the slave threads, connections end when the other side stops.
+  return true;
 }
 
-// Network reflector IO work loop. Execute until marked done.
-// Return false on fatal software error.
-bool NetworkSlaveThread::Work() {
-  logprintf(9, "Log: Starting network slave thread %d\n",
-            thread_num_);
+void NetworkEventThread::AddSock(int sock) {
+  pthread_mutex_lock(&pending_lock_);
+  pending_socks_.push_back(sock);
+  pthread_mutex_unlock(&pending_lock_);
+}
 
-  // Verify that we have a socket.
-  int sock = sock_;
-  if (!sock) {
-    status_ = false;
-    return false;
-  }
+void NetworkEventThread::Stop() {
+  stop_ = true;
+}
 
-  // Loop until done.
-  int64 loops = 0;
-  // Init a local buffer for storing data.
-  void *local_page = NULL;
+bool NetworkEventThread::AddPendingConnections() {
+  vector<int> socks;
+  pthread_mutex_lock(&pending_lock_);
+  socks.swap(pending_socks_);
+  pthread_mutex_unlock(&pending_lock_);
+
+  bool result = true;
+  for (size_t i = 0; i < socks.size(); i++) {
+    int sock = socks[i];
+    Connection *conn = new Connection;
+    conn->sock = sock;
+    conn->page = NULL;
+    conn->done = 0;
+    conn->sending = false;
+    conn->events = EPOLLIN;
+    conn->index = connections_.size();
 #ifdef HAVE_POSIX_MEMALIGN
-  int result = posix_memalign(&local_page, 512, sat_->page_length());
+    void *page = NULL;
+    int error = posix_memalign(&page, 512, sat_->page_length());
+    conn->page = static_cast<char*>(page);
 #else
-  local_page = memalign(512, sat_->page_length());
-  int result = (local_page == 0);
+    conn->page = static_cast<char*>(memalign(512, sat_->page_length()));
+    int error = (conn->page == 0);
 #endif
-  if (result) {
-    logprintf(0, "Process Error: net slave posix_memalign "
-                 "returned %d (fail)\n",
-              result);
+    if (error) {
+      logprintf(0, "Process Error: net event thread posix_memalign "
+                   "returned %d (fail)\n", error);
+      close(sock);
+      delete conn;
+      result = false;
+      continue;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = conn->events;
+    event.data.ptr = conn;
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1 ||
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &event) == -1) {
+      char buf[256] = "";
+      sat_strerror(errno, buf, sizeof(buf));
+      logprintf(0, "Process Error: Thread %d, can't watch socket (%s)\n",
+                thread_num_, buf);
+      close(sock);
+      free(conn->page);
+      delete conn;
+      result = false;
+      continue;
+    }
+    connections_.push_back(conn);
+  }
+  return result;
+}
+
+bool NetworkEventThread::Service(Connection *conn) {
+  int page_length = sat_->page_length();
+  while (true) {
+    int transferred;
+    if (conn->sending)
+      transferred = send(conn->sock, conn->page + conn->done,
+                         page_length - conn->done, MSG_NOSIGNAL);
+    else
+      transferred = recv(conn->sock, conn->page + conn->done,
+                         page_length - conn->done, 0);
+
+    if (transferred == -1 && errno == EINTR)
+      continue;
+    if (transferred == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // Wait for the socket to become ready the way we now need it.
+      uint32 events = conn->sending ? EPOLLOUT : EPOLLIN;
+      if (events != conn->events) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = events;
+        event.data.ptr = conn;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->sock, &event) == -1)
+          return false;
+        conn->events = events;
+      }
+      return true;
+    }
+    if (transferred == 0 && !conn->sending) {
+      // The other side is done with this connection.
+      return false;
+    }
+    if (transferred <= 0) {
+      char buf[256] = "";
+      sat_strerror(errno, buf, sizeof(buf));
+      logprintf(0, "Process Error: Thread %d, Network %s failed, "
+                   "closing connection (%s).\n",
+                thread_num_, conn->sending ? "write" : "read", buf);
+      return false;
+    }
+
+    conn->done += transferred;
+    if (conn->done == page_length) {
+      // Switch between receiving a page and sending it back.
+      if (conn->sending)
+        stats_->set_pages(stats_->pages() + 1);
+      conn->sending = !conn->sending;
+      conn->done = 0;
+    }
+  }
+}
+
+void NetworkEventThread::CloseConnection(Connection *conn) {
+  // Closing the socket also drops it from the epoll set.
+  CloseSocket(conn->sock);
+  free(conn->page);
+  Connection *last = connections_.back();
+  connections_[conn->index] = last;
+  last->index = conn->index;
+  connections_.pop_back();
+  delete conn;
+}
+
+// Network event IO work loop. Execute until stopped and all
+// connections are closed.
+// Return false on fatal software error.
+bool NetworkEventThread::Work() {
+  logprintf(9, "Log: Starting network event thread %d\n", thread_num_);
+
+  epoll_fd_ = epoll_create1(0);
+  if (epoll_fd_ == -1) {
+    char buf[256] = "";
+    sat_strerror(errno, buf, sizeof(buf));
+    logprintf(0, "Process Error: Thread %d, epoll_create1 failed (%s)\n",
+              thread_num_, buf);
     status_ = false;
     return false;
   }
 
-  struct page_entry page;
-  page.addr = local_page;
-
-  // This thread will continue to run as long as the thread on the other end of
-  // the socket is still sending and receiving data.
-  while (1) {
-    // Do the network read.
-    if (!ReceivePage(sock, &page))
+  bool result = true;
+  int idle_polls = 0;
+  struct epoll_event events[kMaxEvents];
+  while (true) {
+    result = AddPendingConnections() && result;
+    if (stop_ && connections_.empty())
       break;
 
-    // Do the network write.
-    if (!SendPage(sock, &page))
+    int ready = epoll_wait(epoll_fd_, events, kMaxEvents, kPollTimeout);
+    if (ready == -1) {
+      if (errno == EINTR)
+        continue;
+      char buf[256] = "";
+      sat_strerror(errno, buf, sizeof(buf));
+      logprintf(0, "Process Error: Thread %d, epoll_wait failed (%s)\n",
+                thread_num_, buf);
+      result = false;
       break;
+    }
 
-    loops++;
-  }
+    // Give up on connections the other side stopped using but didn't
+    // close, instead of waiting for them forever.
+    if (ready == 0 && stop_) {
+      if (++idle_polls >= kStopIdlePolls) {
+        logprintf(12, "Log: Thread %d closing %d idle connections\n",
+                  thread_num_, connections_.size());
+        break;
+      }
+      continue;
+    }
+    idle_polls = 0;
 
-  pages_copied_ = loops;
-  // No results provided from this type of thread.
-  status_ = true;
+    for (int i = 0; i < ready; i++) {
+      Connection *conn = static_cast<Connection*>(events[i].data.ptr);
+      if (!Service(conn))
+        CloseConnection(conn);
+    }
+  }
 
-  // Clean up.
-  CloseSocket(sock);
+  while (!connections_.empty())
+    CloseConnection(connections_.back());
+  close(epoll_fd_);
+  epoll_fd_ = -1;
 
-  logprintf(9,
-            "Log: Completed %d: network slave thread status %d, "
-            "%d pages copied\n",
-            thread_num_, status_, pages_copied_);
-  return true;
+  status_ = result;
+  logprintf(9, "Log: Completed %d: network event thread status %d, "
+               "%d pages copied\n",
+            thread_num_, status_, stats_->pages());
+  return result;
 }
 
 // Thread work loop. Execute until marked finished.
@@ -2476,12 +4439,12 @@ bool ErrorPollThread::Work() {
 
   // This calls a generic error polling function in the Os abstraction layer.
   do {
-    errorcount_ += os_->ErrorPoll();
+    stats_->AddErrors(os_->ErrorPoll());
     os_->ErrorWait();
   } while (IsReadyToRun());
 
   logprintf(9, "Log: Finished system error poll thread %d: %d errors\n",
-            thread_num_, errorcount_);
+            thread_num_, stats_->errors());
   status_ = true;
   return true;
 }
@@ -2491,11 +4454,19 @@ bool ErrorPollThread::Work() {
 bool CpuStressThread::Work() {
   logprintf(9, "Log: Starting CPU stress thread %d\n", thread_num_);
 
-  do {
-    // Run ludloff's platform/CPU-specific assembly workload.
-    os_->CpuStressWorkload();
-    YieldSelf();
-  } while (IsReadyToRun());
+  vector<CpuKernel*> kernels;
+  CpuKernel::Create(kernel_name_, &kernels);
+  if (!kernels.empty()) {
+    RunKernels(kernels);
+    for (size_t i = 0; i < kernels.size(); i++)
+      delete kernels[i];
+  } else {
+    do {
+      // Run ludloff's platform/CPU-specific assembly workload.
+      os_->CpuStressWorkload();
+      YieldSelf();
+    } while (IsReadyToRun());
+  }
 
   logprintf(9, "Log: Finished CPU stress thread %d:\n",
             thread_num_);
@@ -2503,6 +4474,139 @@ bool CpuStressThread::Work() {
   return true;
 }
 
+void CpuStressThread::RunKernels(const vector<CpuKernel*> &kernels) {
+  for (size_t i = 0; i < kernels.size(); i++)
+    kernels[i]->Prepare();
+
+  vector<int64> runs(kernels.size(), 0);
+  vector<int64> errors(kernels.size(), 0);
+  // Spread the threads over the kernels.
+  size_t current = thread_num_ % kernels.size();
+  int64 slice_start = sat_get_time_us();
+  int seed = 0;
+  do {
+    CpuKernel *kernel = kernels[current];
+    int wrong = kernel->Run(seed);
+    if (sat_->error_injection())
+      wrong++;
+    runs[current]++;
+    if (wrong) {
+      errors[current] += wrong;
+      stats_->AddErrors(wrong);
+      logprintf(0, "Hardware Error: %s kernel got %d of %d results wrong "
+                "on input %d, thread %d on cpu %d\n", kernel->name(), wrong,
+                kernel->results(), seed, thread_num_, sched_getcpu());
+    }
+    seed = (seed + 1) % CpuKernel::kSeeds;
+
+    int64 now = sat_get_time_us();
+    if (now - slice_start >= kKernelSliceUs) {
+      current = (current + 1) % kernels.size();
+      slice_start = now;
+      YieldSelf();
+    }
+  } while (IsReadyToRun());
+
+  for (size_t i = 0; i < kernels.size(); i++) {
+    logprintf(4, "Stats: CPU stress thread %d: %s kernel, %lld runs, "
+              "%.2fG operations, %lld wrong results\n", thread_num_,
+              kernels[i]->name(), runs[i],
+              runs[i] * kernels[i]->ops() / 1e9, errors[i]);
+  }
+}
+
+PowerWaveThread::PowerWaveThread(const PowerWave *wave)
+  : wave_(wave),
+    edges_(0),
+    late_edges_(0),
+    max_late_ns_(0),
+    sink_(0.) {
+}
+
+void PowerWaveThread::Load(int64 until_ns) {
+  // Independent multiply-add chains, a few dozen ns between clock reads.
+  double a = 1.0 + sink_, b = 1.1, c = 1.2, d = 1.3;
+  const double m = 0.9999999, k = 1e-7;
+  do {
+    for (int i = 0; i < 16; i++) {
+      a = a * m + k;
+      b = b * m + k;
+      c = c * m + k;
+      d = d * m + k;
+    }
+  } while (sat_get_time_ns() < until_ns);
+  sink_ = a + b + c + d;
+}
+
+void PowerWaveThread::Idle(int64 until_ns) {
+  int64 now = sat_get_time_ns();
+  if (until_ns - now > 2 * kSpinAheadNs) {
+    // Sleep through most of it so the core can drop into a C-state.
+    int64 wake = until_ns - kSpinAheadNs;
+    struct timespec ts;
+    ts.tv_sec = wake / 1000000000LL;
+    ts.tv_nsec = wake % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+  }
+  while (sat_get_time_ns() < until_ns) {
+#if defined(STRESSAPPTEST_CPU_X86_64) || defined(STRESSAPPTEST_CPU_I686)
+    __builtin_ia32_pause();
+#elif defined(STRESSAPPTEST_CPU_AARCH64)
+    asm volatile("yield");
+#endif
+  }
+}
+
+bool PowerWaveThread::Work() {
+  logprintf(9, "Log: Starting power wave thread %d\n", thread_num_);
+
+  int64 next_check = 0;
+  bool was_idle = false;
+  int64 edge = 0;
+  while (true) {
+    int64 now = sat_get_time_ns();
+    if (now >= next_check) {
+      if (!IsReadyToRun())
+        break;
+      now = sat_get_time_ns();
+      next_check = now + kCheckNs;
+    }
+    int64 until;
+    bool busy = wave_->Level(now, &until);
+    if (busy) {
+      if (was_idle && edge) {
+        int64 late = now - edge;
+        edges_++;
+        if (late > kLateNs)
+          late_edges_++;
+        if (late > max_late_ns_)
+          max_late_ns_ = late;
+      }
+      was_idle = false;
+      edge = 0;
+      Load(until < next_check ? until : next_check);
+    } else {
+      was_idle = true;
+      // Only a wait that runs into the edge can be late for it.
+      if (until <= next_check) {
+        edge = until;
+        Idle(until);
+      } else {
+        edge = 0;
+        Idle(next_check);
+      }
+    }
+  }
+
+  logprintf(9, "Log: Finished power wave thread %d: %lld edges, %lld late, "
+            "worst %lld ns\n", thread_num_, edges_, late_edges_,
+            max_late_ns_);
+  status_ = true;
+  return true;
+}
+
 CpuCacheCoherencyThread::CpuCacheCoherencyThread(cc_cacheline_data *data,
                                                  int cacheline_count,
                                                  int thread_num,
@@ -2513,6 +4617,9 @@ CpuCacheCoherencyThread::CpuCacheCoherencyThread(cc_cacheline_data *data,
   cc_thread_num_ = thread_num;
   cc_thread_count_ = thread_count;
   cc_inc_count_ = inc_count;
+  cc_pairs_ = NULL;
+  cc_threads_per_line_ = 0;
+  cc_line_stride_ = 0;
 }
 
 // A very simple psuedorandom generator.  Since the random number is based
@@ -2525,22 +4632,23 @@ uint64 CpuCacheCoherencyThread::SimpleRandom(uint64 seed) {
 // Worked thread to test the cache coherency of the CPUs
 // Return false on fatal sw error.
 bool CpuCacheCoherencyThread::Work() {
+  if (cc_pairs_)
+    return PairWork();
+
   logprintf(9, "Log: Starting the Cache Coherency thread %d\n",
             cc_thread_num_);
   int64 time_start, time_end;
 
-  // Use a slightly more robust random number for the initial
-  // value, so the random sequences from the simple generator will
-  // be more divergent.
-#ifdef HAVE_RAND_R
-  unsigned int seed = static_cast<unsigned int>(gettid());
-  uint64 r = static_cast<uint64>(rand_r(&seed));
-  r |= static_cast<uint64>(rand_r(&seed)) << 32;
-#else
-  srand(time(NULL));
-  uint64 r = static_cast<uint64>(rand());  // NOLINT
-  r |= static_cast<uint64>(rand()) << 32;  // NOLINT
-#endif
+  // Start from the thread's own random number, so the random sequences
+  // from the simple generator will be more divergent.
+  uint64 r = prng_.Next();
+
+  // Where this thread's counter sits in even and odd numbered lines.
+  const int index[2] = {
+    CounterIndex(cc_thread_num_),
+    CounterIndex(cc_thread_num_ & 1 ?
+                 (cc_thread_count_ & ~1) - cc_thread_num_ : cc_thread_num_),
+  };
 
   time_start = sat_get_time_us();
 
@@ -2552,17 +4660,12 @@ bool CpuCacheCoherencyThread::Work() {
       // thread number.
       r = SimpleRandom(r);
       int cline_num = r % cc_cacheline_count_;
-      int offset;
       // Reverse the order for odd numbered threads in odd numbered cache
       // lines.  This is designed for massively multi-core systems where the
       // number of cores exceeds the bytes in a cache line, so "distant" cores
       // get a chance to exercize cache coherency between them.
-      if (cline_num & cc_thread_num_ & 1)
-        offset = (cc_thread_count_ & ~1) - cc_thread_num_;
-      else
-        offset = cc_thread_num_;
       // Increment the member of the randomely selected structure.
-      (cc_cacheline_data_[cline_num].num[offset])++;
+      (cc_cacheline_data_[cline_num].num[index[cline_num & 1]])++;
     }
 
     total_inc += cc_inc_count_;
@@ -2571,12 +4674,8 @@ bool CpuCacheCoherencyThread::Work() {
     // in all the cache line structures for this particular thread.
     int cc_global_num = 0;
     for (int cline_num = 0; cline_num < cc_cacheline_count_; cline_num++) {
-      int offset;
       // Perform the same offset calculation from above.
-      if (cline_num & cc_thread_num_ & 1)
-        offset = (cc_thread_count_ & ~1) - cc_thread_num_;
-      else
-        offset = cc_thread_num_;
+      int offset = index[cline_num & 1];
       cc_global_num += cc_cacheline_data_[cline_num].num[offset];
       // Reset the cachline member's value for the next run.
       cc_cacheline_data_[cline_num].num[offset] = 0;
@@ -2591,7 +4690,7 @@ bool CpuCacheCoherencyThread::Work() {
     // of it being missed terribly minute.  It seems unlikely any failure
     // case would be off by more than a small number.
     if ((cc_global_num & 0xff) != (cc_inc_count_ & 0xff)) {
-      errorcount_++;
+      stats_->AddErrors(1);
       logprintf(0, "Hardware Error: global(%d) and local(%d) do not match\n",
                 cc_global_num, cc_inc_count_);
     }
@@ -2611,6 +4710,121 @@ bool CpuCacheCoherencyThread::Work() {
   return true;
 }
 
+bool CpuCacheCoherencyThread::PairWait(int64 turn, uint64 value,
+                                       bool *stall) {
+  // Polls between checks that the test and the turn are still on.
+  static const int kSpinCheck = 4096;
+  // Give up on a partner that doesn't answer for this long.
+  static const int64 kStallNs = 1000000000LL;
+  volatile uint64 *line = cc_pairs_->line;
+  int64 start = 0;
+  int spins = 0;
+
+  while (true) {
+    uint64 seen = __atomic_load_n(line, __ATOMIC_ACQUIRE);
+    if (seen == value)
+      return true;
+    // The line may already belong to the next turn if this one was given
+    // up on.
+    if ((seen >> 32) != (value >> 32))
+      return false;
+    // Only the partner writes the line meanwhile, and it writes the value
+    // we are waiting for next.
+    if (seen != value - 1) {
+      stats_->AddErrors(1);
+      logprintf(0, "Hardware Error: cacheline bounced between CPU %d and "
+                "CPU %d holds %lld, expected %lld or %lld\n",
+                cc_pairs_->first[turn % cc_pairs_->pairs],
+                cc_pairs_->second[turn % cc_pairs_->pairs],
+                seen, value - 1, value);
+      return false;
+    }
+    if (++spins < kSpinCheck)
+      continue;
+    spins = 0;
+    if (!IsReadyToRun() ||
+        __atomic_load_n(&cc_pairs_->turn, __ATOMIC_ACQUIRE) != turn)
+      return false;
+    if (stall) {
+      int64 now = sat_get_time_ns();
+      if (!start) {
+        start = now;
+      } else if (now - start > kStallNs) {
+        *stall = true;
+        return false;
+      }
+    }
+  }
+}
+
+bool CpuCacheCoherencyThread::PairTurn(int64 turn, bool first) {
+  volatile uint64 *line = cc_pairs_->line;
+  int pair = turn % cc_pairs_->pairs;
+  bool stall = false;
+  // The line holds the turn in its upper half and a count in the lower
+  // one. The first thread writes the odd counts and the second one the
+  // even ones, so each round trip is two transfers of the line.
+  uint64 base = static_cast<uint64>(turn) << 32;
+  uint64 value = base + (first ? 0 : 1);
+
+  int64 start = sat_get_time_ns();
+  int round;
+  for (round = 0; round < cc_inc_count_; round++) {
+    if (!PairWait(turn, value, first ? &stall : NULL))
+      break;
+    __atomic_store_n(line, value + 1, __ATOMIC_RELEASE);
+    value += 2;
+  }
+  if (!first)
+    return IsReadyToRun();
+
+  // Wait for the last answer.
+  if (round == cc_inc_count_ && PairWait(turn, value, &stall)) {
+    cc_pairs_->transfers[pair] += 2 * cc_inc_count_;
+    cc_pairs_->ns[pair] += sat_get_time_ns() - start;
+  } else if (stall) {
+    logprintf(0, "Log: CPU %d didn't answer CPU %d for a second, "
+              "skipping the pair\n", cc_pairs_->second[pair],
+              cc_pairs_->first[pair]);
+  }
+  if (!IsReadyToRun())
+    return false;
+
+  // Start the line of the next turn before handing it over.
+  __atomic_store_n(line, base + (1ULL << 32), __ATOMIC_RELAXED);
+  __atomic_store_n(&cc_pairs_->turn, turn + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Bounce a cacheline between this thread and each other thread in turn.
+bool CpuCacheCoherencyThread::PairWork() {
+  logprintf(9, "Log: Starting the Cache Coherency pair thread %d\n",
+            cc_thread_num_);
+  int64 done = -1;  // Last turn this thread took part in.
+  int64 turns = 0;
+
+  while (IsReadyToRun()) {
+    int64 turn = __atomic_load_n(&cc_pairs_->turn, __ATOMIC_ACQUIRE);
+    int pair = turn % cc_pairs_->pairs;
+    bool first = cc_pairs_->first[pair] == cc_thread_num_;
+    if (turn == done ||
+        (!first && cc_pairs_->second[pair] != cc_thread_num_)) {
+      // Not our turn, let others on this core run meanwhile.
+      sched_yield();
+      continue;
+    }
+    if (!PairTurn(turn, first))
+      break;
+    done = turn;
+    turns++;
+  }
+
+  logprintf(9, "Log: Finished CPU Cache Coherency pair thread %d, "
+            "%lld turns\n", cc_thread_num_, turns);
+  status_ = true;
+  return true;
+}
+
 DiskThread::DiskThread(DiskBlockTable *block_table) {
   read_block_size_ = kSectorSize;   // default 1 sector (512 bytes)
   write_block_size_ = kSectorSize;  // this assumes read and write block size
@@ -2635,6 +4849,13 @@ DiskThread::DiskThread(DiskBlockTable *block_table) {
 #ifdef HAVE_LIBAIO_H
   aio_ctx_ = 0;
 #endif
+  io_engine_ = kIoEngineAio;
+  queue_depth_ = 32;
+  active_depth_ = queue_depth_;
+  pipelined_ = false;
+  uring_ = NULL;
+  uring_inflight_ = 0;
+  uring_abandoned_ = false;
   block_table_ = block_table;
   update_block_table_ = 1;
 
@@ -2645,8 +4866,9 @@ DiskThread::DiskThread(DiskBlockTable *block_table) {
 }
 
 DiskThread::~DiskThread() {
+  TeardownUring();
   if (block_buffer_)
-    free(block_buffer_);
+    sat_->io_buffers()->Put(block_buffer_);
 }
 
 // Set filename for device file (in /dev).
@@ -2771,13 +4993,32 @@ bool DiskThread::SetParameters(int read_block_size,
   return true;
 }
 
+// Select the I/O engine and io_uring queue depth.
+bool DiskThread::SetIoEngine(int engine, int queue_depth, bool pipelined) {
+  if (engine != kIoEngineAio && engine != kIoEngineUring) {
+    logprintf(0, "Process Error: Unknown disk I/O engine %d (thread %d).\n",
+              engine, thread_num_);
+    return false;
+  }
+  if (queue_depth <= 0 || queue_depth > kMaxQueueDepth) {
+    logprintf(0, "Process Error: Disk queue depth must be between 1 and %d "
+              "(thread %d).\n", kMaxQueueDepth, thread_num_);
+    return false;
+  }
+  io_engine_ = engine;
+  queue_depth_ = queue_depth;
+  active_depth_ = queue_depth;
+  pipelined_ = pipelined;
+  return true;
+}
+
 // Open a device, return false on failure.
 bool DiskThread::OpenDevice(int *pfile) {
   int flags = O_RDWR | O_SYNC | O_LARGEFILE;
   int fd = open(device_name_.c_str(), flags | O_DIRECT, 0);
   if (O_DIRECT != 0 && fd < 0 && errno == EINVAL) {
     fd = open(device_name_.c_str(), flags, 0);  // Try without O_DIRECT
-    os_->ActivateFlushPageCache();
+    cached_io_ = true;
   }
   if (fd < 0) {
     logprintf(0, "Process Error: Failed to open device %s (thread %d)!!\n",
@@ -2813,7 +5054,7 @@ bool DiskThread::GetDiskSize(int fd) {
     // Zero size indicates nonworking device..
     if (block_size == 0) {
       os_->ErrorReport(device_name_.c_str(), "device-size-zero", 1);
-      ++errorcount_;
+      stats_->AddErrors(1);
       status_ = true;  // Avoid a procedural error.
       return false;
     }
@@ -2852,20 +5093,25 @@ int64 DiskThread::GetTime() {
   return sat_get_time_us();
 }
 
+// Return the number of segments the disk is split into.
+int64 DiskThread::NumSegments() {
+  if (segment_size_ == -1)
+    return 1;
+  int64 num_segments = device_sectors_ / segment_size_;
+  if (device_sectors_ % segment_size_ != 0)
+    num_segments++;
+  return num_segments;
+}
+
 // Do randomized reads and (possibly) writes on a device.
 // Return false on fatal SW error, true on SW success,
 // regardless of whether HW failed.
 bool DiskThread::DoWork(int fd) {
-  int64 block_num = 0;
-  int64 num_segments;
+  if (uring_ && pipelined_)
+    return DoPipelinedWork(fd);
 
-  if (segment_size_ == -1) {
-    num_segments = 1;
-  } else {
-    num_segments = device_sectors_ / segment_size_;
-    if (device_sectors_ % segment_size_ != 0)
-      num_segments++;
-  }
+  int64 block_num = 0;
+  int64 num_segments = NumSegments();
 
   // Disk size should be at least 3x cache size.  See comment later for
   // details.
@@ -2888,13 +5134,19 @@ bool DiskThread::DoWork(int fd) {
   //                unplugged is causing the application and kernel to
   //                become unresponsive.
 
+  // With io_uring, blocks are written and verified a queue depth at a time.
+  size_t batch_size = 1;
+  vector<BlockData*> batch;
+
   while (IsReadyToRun()) {
+    if (uring_)
+      batch_size = active_depth_;
     // Write blocks to disk.
     logprintf(16, "Log: Write phase %sfor disk %s (thread %d).\n",
               non_destructive_ ? "(disabled) " : "",
               device_name_.c_str(), thread_num_);
     while (IsReadyToRunNoPause() &&
-           in_flight_sectors_.size() <
+           in_flight_sectors_.size() + batch.size() <
                static_cast<size_t>(queue_size_ + 1)) {
       // Confine testing to a particular segment of the disk.
       int64 segment = (block_num / blocks_per_segment_) % num_segments;
@@ -2926,45 +5178,116 @@ bool DiskThread::DoWork(int fd) {
       //   4. Therefore, the one segment must have 2 * 3/2 * cache
       //      size worth of blocks = 3 * cache size worth of blocks
       //      to complete.
-      // In non-destructive mode, don't write anything to disk.
-      if (!non_destructive_) {
-        if (!WriteBlockToDisk(fd, block)) {
-          block_table_->RemoveBlock(block);
-          return true;
-        }
-        blocks_written_++;
-      }
-
-      // Block is either initialized by writing, or in nondestructive case,
-      // initialized by being added into the datastructure for later reading.
-      block->initialized();
-
-      in_flight_sectors_.push(block);
+      batch.push_back(block);
+      if (batch.size() >= batch_size && !FlushWriteBatch(fd, &batch))
+        return true;
     }
-    if (!os_->FlushPageCache())  // If O_DIRECT worked, this will be a NOP.
+    if (!FlushWriteBatch(fd, &batch))
+      return true;
+    // The blocks are spread over the whole device.
+    if (!BypassPageCache(fd, 0, 0))
       return false;
 
     // Verify blocks on disk.
     logprintf(20, "Log: Read phase for disk %s (thread %d).\n",
               device_name_.c_str(), thread_num_);
     while (IsReadyToRunNoPause() && !in_flight_sectors_.empty()) {
-      BlockData *block = in_flight_sectors_.front();
-      in_flight_sectors_.pop();
-      if (!ValidateBlockOnDisk(fd, block))
-        return true;
-      block_table_->RemoveBlock(block);
-      blocks_read_++;
+      while (batch.size() < batch_size && !in_flight_sectors_.empty()) {
+        batch.push_back(in_flight_sectors_.front());
+        in_flight_sectors_.pop();
+      }
+      if (uring_) {
+        if (!ValidateBlocksOnDisk(fd, &batch[0], batch.size()))
+          return true;
+      } else {
+        if (!ValidateBlockOnDisk(fd, batch[0]))
+          return true;
+      }
+      for (size_t i = 0; i < batch.size(); i++)
+        block_table_->RemoveBlock(batch[i]);
+      blocks_read_ += batch.size();
+      stats_->set_pages(blocks_written_ + blocks_read_);
+      batch.clear();
+    }
+  }
+
+  stats_->set_pages(blocks_written_ + blocks_read_);
+  return true;
+}
+
+// Write the blocks in 'batch' to disk, or in non-destructive mode only mark
+// them as initialized, and queue them for verification.
+// Return false if the blocks could not be written.
+bool DiskThread::FlushWriteBatch(int fd, vector<BlockData*> *batch) {
+  if (batch->empty())
+    return true;
+
+  // In non-destructive mode, don't write anything to disk.
+  if (!non_destructive_) {
+    bool written;
+    if (uring_)
+      written = WriteBlocksToDisk(fd, &(*batch)[0], batch->size());
+    else
+      written = WriteBlockToDisk(fd, (*batch)[0]);
+    if (!written) {
+      for (size_t i = 0; i < batch->size(); i++)
+        block_table_->RemoveBlock((*batch)[i]);
+      batch->clear();
+      return false;
     }
+    blocks_written_ += batch->size();
+    stats_->set_pages(blocks_written_ + blocks_read_);
   }
 
-  pages_copied_ = blocks_written_ + blocks_read_;
+  for (size_t i = 0; i < batch->size(); i++) {
+    // Block is either initialized by writing, or in nondestructive case,
+    // initialized by being added into the datastructure for later reading.
+    (*batch)[i]->set_initialized();
+    in_flight_sectors_.push((*batch)[i]);
+  }
+  batch->clear();
   return true;
 }
 
+// Log and count a failed or short transfer.
+void DiskThread::ReportIoError(IoOp op, int64 result, int64 offset) {
+  static const char *const op_str[2] = { "read", "write" };
+  static const char *const error_str[2] = {
+    "disk-read-error", "disk-write-error"
+  };
+
+  stats_->AddErrors(1);
+  os_->ErrorReport(device_name_.c_str(), error_str[op], 1);
+
+  if (result < 0) {
+    switch (result) {
+      case -EIO:
+        logprintf(0, "Hardware Error: Low-level I/O error while doing %s to "
+                     "sectors starting at %lld on disk %s (thread %d).\n",
+                  op_str[op], offset / kSectorSize,
+                  device_name_.c_str(), thread_num_);
+        break;
+      default:
+        logprintf(0, "Hardware Error: Unknown error while doing %s to "
+                     "sectors starting at %lld on disk %s (thread %d).\n",
+                  op_str[op], offset / kSectorSize,
+                  device_name_.c_str(), thread_num_);
+    }
+  } else {
+    logprintf(0, "Hardware Error: Unable to %s to sectors starting at "
+                 "%lld on disk %s (thread %d).\n",
+              op_str[op], offset / kSectorSize,
+              device_name_.c_str(), thread_num_);
+  }
+}
+
 // Do an asynchronous disk I/O operation.
 // Return false if the IO is not set up.
 bool DiskThread::AsyncDiskIO(IoOp op, int fd, void *buf, int64 size,
                             int64 offset, int64 timeout) {
+  if (uring_)
+    return UringDiskIO(op, fd, buf, size, offset);
+
 #ifdef HAVE_LIBAIO_H
   // Use the Linux native asynchronous I/O interface for reading/writing.
   // A read/write consists of three basic steps:
@@ -3018,7 +5341,7 @@ bool DiskThread::AsyncDiskIO(IoOp op, int fd, void *buf, int64 size,
                 thread_num_);
     } else {
       os_->ErrorReport(device_name_.c_str(), operations[op].error_str, 1);
-      errorcount_ += 1;
+      stats_->AddErrors(1);
       logprintf(0, "Hardware Error: Timeout doing async %s to sectors "
                    "starting at %lld on disk %s (thread %d).\n",
                 operations[op].op_str, offset / kSectorSize,
@@ -3044,33 +5367,10 @@ bool DiskThread::AsyncDiskIO(IoOp op, int fd, void *buf, int64 size,
     return false;
   }
 
-  // event.res contains the number of bytes written/read or
-  // error if < 0, I think.
-  if (event.res != static_cast<uint64>(size)) {
-    errorcount_++;
-    os_->ErrorReport(device_name_.c_str(), operations[op].error_str, 1);
-
-    int64 result = static_cast<int64>(event.res);
-    if (result < 0) {
-      switch (result) {
-        case -EIO:
-          logprintf(0, "Hardware Error: Low-level I/O error while doing %s to "
-                       "sectors starting at %lld on disk %s (thread %d).\n",
-                    operations[op].op_str, offset / kSectorSize,
-                    device_name_.c_str(), thread_num_);
-          break;
-        default:
-          logprintf(0, "Hardware Error: Unknown error while doing %s to "
-                       "sectors starting at %lld on disk %s (thread %d).\n",
-                    operations[op].op_str, offset / kSectorSize,
-                    device_name_.c_str(), thread_num_);
-      }
-    } else {
-      logprintf(0, "Hardware Error: Unable to %s to sectors starting at "
-                   "%lld on disk %s (thread %d).\n",
-                operations[op].op_str, offset / kSectorSize,
-                device_name_.c_str(), thread_num_);
-    }
+  // event.res contains the number of bytes written/read or
+  // error if < 0, I think.
+  if (event.res != static_cast<uint64>(size)) {
+    ReportIoError(op, static_cast<int64>(event.res), offset);
     return false;
   }
 
@@ -3080,31 +5380,43 @@ bool DiskThread::AsyncDiskIO(IoOp op, int fd, void *buf, int64 size,
 #endif
 }
 
-// Write a block to disk.
-// Return false if the block is not written.
-bool DiskThread::WriteBlockToDisk(int fd, BlockData *block) {
-  memset(block_buffer_, 0, block->size());
+// Returns the pattern 'block' was filled with.
+class Pattern *DiskThread::BlockPattern(const BlockData *block) {
+  int index = block->pattern_index();
+  return index < 0 ? NULL : patternlist_->GetPattern(index);
+}
+
+// Fill a block buffer with a pattern, preferably copied from a valid page.
+void DiskThread::FillBlockBuffer(BlockData *block, void *buffer) {
+  memset(buffer, 0, block->size());
 
   // Fill block buffer with a pattern
   struct page_entry pe;
   if (!sat_->GetValid(&pe)) {
     // Even though a valid page could not be obatined, it is not an error
     // since we can always fill in a pattern directly, albeit slower.
-    unsigned int *memblock = static_cast<unsigned int *>(block_buffer_);
-    block->set_pattern(patternlist_->GetRandomPattern());
+    unsigned int *memblock = static_cast<unsigned int *>(buffer);
+    class Pattern *pattern = patternlist_->GetRandomPattern();
+    block->set_pattern_index(patternlist_->IndexOf(pattern));
 
     logprintf(11, "Log: Warning, using pattern fill fallback in "
                   "DiskThread::WriteBlockToDisk on disk %s (thread %d).\n",
               device_name_.c_str(), thread_num_);
 
     for (unsigned int i = 0; i < block->size()/wordsize_; i++) {
-      memblock[i] = block->pattern()->pattern(i);
+      memblock[i] = pattern->pattern(i);
     }
   } else {
-    memcpy(block_buffer_, pe.addr, block->size());
-    block->set_pattern(pe.pattern);
+    memcpy(buffer, pe.addr, block->size());
+    block->set_pattern_index(patternlist_->IndexOf(pe.pattern));
     sat_->PutValid(&pe);
   }
+}
+
+// Write a block to disk.
+// Return false if the block is not written.
+bool DiskThread::WriteBlockToDisk(int fd, BlockData *block) {
+  FillBlockBuffer(block, block_buffer_);
 
   logprintf(12, "Log: Writing %lld sectors starting at %lld on disk %s"
             " (thread %d).\n",
@@ -3119,6 +5431,7 @@ bool DiskThread::WriteBlockToDisk(int fd, BlockData *block) {
   }
 
   int64 end_time = GetTime();
+  write_latency_.Record(end_time - start_time);
   logprintf(12, "Log: Writing time: %lld us (thread %d).\n",
             end_time - start_time, thread_num_);
   if (end_time - start_time > write_threshold_) {
@@ -3161,7 +5474,7 @@ bool DiskThread::ValidateBlockOnDisk(int fd, BlockData *block) {
   // will be tested using a random reading pattern.
   while (blocks != 0) {
     // Test all read blocks in a written block.
-    current_blocks = (random() % blocks) + 1;
+    current_blocks = prng_.Below(blocks) + 1;
     current_bytes = current_blocks * read_block_size_;
 
     memset(block_buffer_, 0, current_bytes);
@@ -3172,6 +5485,7 @@ bool DiskThread::ValidateBlockOnDisk(int fd, BlockData *block) {
               (address * kSectorSize + bytes_read) / kSectorSize,
               device_name_.c_str(), thread_num_);
 
+    int64 read_start = GetTime();
     if (!AsyncDiskIO(ASYNC_IO_READ, fd, block_buffer_, current_bytes,
                      address * kSectorSize + bytes_read,
                      write_timeout_)) {
@@ -3179,6 +5493,7 @@ bool DiskThread::ValidateBlockOnDisk(int fd, BlockData *block) {
     }
 
     int64 end_time = GetTime();
+    read_latency_.Record(end_time - read_start);
     logprintf(20, "Log: Reading time: %lld us (thread %d).\n",
               end_time - start_time, thread_num_);
     if (end_time - start_time > read_threshold_) {
@@ -3191,10 +5506,10 @@ bool DiskThread::ValidateBlockOnDisk(int fd, BlockData *block) {
     // In non-destructive mode, don't compare the block to the pattern since
     // the block was never written to disk in the first place.
     if (!non_destructive_) {
-      if (CheckRegion(block_buffer_, block->pattern(), 0, current_bytes,
+      if (CheckRegion(block_buffer_, BlockPattern(block), 0, current_bytes,
                       0, bytes_read)) {
         os_->ErrorReport(device_name_.c_str(), "disk-pattern-error", 1);
-        errorcount_ += 1;
+        stats_->AddErrors(1);
         logprintf(0, "Hardware Error: Pattern mismatch in block starting at "
                   "sector %lld in DiskThread::ValidateSectorsOnDisk on "
                   "disk %s (thread %d).\n",
@@ -3205,7 +5520,467 @@ bool DiskThread::ValidateBlockOnDisk(int fd, BlockData *block) {
     bytes_read += current_blocks * read_block_size_;
     blocks -= current_blocks;
   }
+  return true;
+}
+
+namespace {
+// io_uring completions identify their request by buffer slot, sector
+// offset of the request in the slot's block and length in sectors, packed
+// into the 64 bit user data.
+const int kSectorShift = 9;
+const int kUringFieldBits = 26;
+const uint64 kUringFieldMask = (1ULL << kUringFieldBits) - 1;
+
+uint64 PackUringRequest(int slot, int64 offset, int64 size) {
+  return (static_cast<uint64>(slot) << (2 * kUringFieldBits)) |
+         (static_cast<uint64>(offset >> kSectorShift) << kUringFieldBits) |
+         static_cast<uint64>(size >> kSectorShift);
+}
+
+void UnpackUringRequest(uint64 data, int *slot, int64 *offset,
+                        int64 *size) {
+  *slot = data >> (2 * kUringFieldBits);
+  *offset = ((data >> kUringFieldBits) & kUringFieldMask) << kSectorShift;
+  *size = (data & kUringFieldMask) << kSectorShift;
+}
+}  // namespace
+
+// Create the io_uring and a registered buffer per request slot.
+// Return false if buffers could not be allocated.
+bool DiskThread::SetupUring() {
+  if (io_engine_ != kIoEngineUring)
+    return true;
+
+  uring_ = new DiskUring();
+  int error = -uring_->Initialize(queue_depth_);
+  if (error) {
+    char buf[256];
+    sat_strerror(error, buf, sizeof(buf));
+    logprintf(0, "Log: Unable to create io_uring for disk %s (thread %d), "
+                 "Error %d, %s. Using libaio instead.\n",
+              device_name_.c_str(), thread_num_, error, buf);
+    delete uring_;
+    uring_ = NULL;
+    return true;
+  }
+
+  for (int i = 0; i < queue_depth_; i++) {
+    void *buffer = sat_->io_buffers()->Get();
+    if (!buffer) {
+      logprintf(0, "Process Error: Unable to get io_uring buffers "
+                   "for disk %s (thread %d).\n",
+                device_name_.c_str(), thread_num_);
+      TeardownUring();
+      return false;
+    }
+    slot_buffers_.push_back(buffer);
+  }
+
+  // Buffer 0 is block_buffer_, for single requests through AsyncDiskIO.
+  // The buffers live as long as the thread, so registering them once
+  // saves the kernel from mapping them on every request.
+  vector<void*> buffers;
+  buffers.push_back(block_buffer_);
+  buffers.insert(buffers.end(), slot_buffers_.begin(), slot_buffers_.end());
+  error = -uring_->RegisterBuffers(&buffers[0], buffers.size(),
+                                   sat_->page_length());
+  if (error) {
+    char buf[256];
+    sat_strerror(error, buf, sizeof(buf));
+    logprintf(5, "Log: Unable to register io_uring buffers for disk %s "
+                 "(thread %d), Error %d, %s.\n",
+              device_name_.c_str(), thread_num_, error, buf);
+  }
+
+  logprintf(9, "Log: Using io_uring with queue depth %d for disk %s "
+               "(thread %d).\n",
+            queue_depth_, device_name_.c_str(), thread_num_);
+  return true;
+}
+
+// Release the io_uring and its buffers.
+void DiskThread::TeardownUring() {
+  delete uring_;
+  uring_ = NULL;
+  uring_inflight_ = 0;
+  // The kernel may still write into buffers of abandoned requests,
+  // so leave them allocated.
+  if (uring_abandoned_) {
+    block_buffer_ = NULL;
+  } else {
+    for (size_t i = 0; i < slot_buffers_.size(); i++)
+      sat_->io_buffers()->Put(slot_buffers_[i]);
+  }
+  slot_buffers_.clear();
+}
+
+// Pass queued io_uring requests to the kernel.
+// Return false if the submission failed.
+bool DiskThread::UringSubmit() {
+  int error = -uring_->Submit();
+  if (error) {
+    char buf[256];
+    sat_strerror(error, buf, sizeof(buf));
+    logprintf(0, "Process Error: Unable to submit async I/O "
+                 "on disk %s (thread %d). Error %d, %s\n",
+              device_name_.c_str(), thread_num_, error, buf);
+    return false;
+  }
+  return true;
+}
+
+// Wait for one io_uring completion and record its result in its slot.
+// Slots whose last request completed are added to uring_done_.
+// Return false on timeout or if waiting failed.
+bool DiskThread::UringReap(UringSlot *slots, int64 timeout) {
+  uint64 data;
+  int64 result;
+  int error = -uring_->WaitCompletion(&data, &result, timeout);
+  if (error) {
+    // Requests are left in flight, their buffers can't be reused.
+    uring_abandoned_ = true;
+    if (error == EINTR) {
+      // A ctrl-c from the keyboard interrupts the wait, this is not an
+      // error, but still log it.
+      logprintf(5, "Log: I/O interrupted on disk %s (thread %d).\n",
+                device_name_.c_str(), thread_num_);
+    } else if (error == ETIME) {
+      os_->ErrorReport(device_name_.c_str(), "disk-timeout-error", 1);
+      stats_->AddErrors(1);
+      logprintf(0, "Hardware Error: Timeout doing async I/O with %d requests "
+                   "in flight on disk %s (thread %d).\n",
+                uring_inflight_, device_name_.c_str(), thread_num_);
+    } else {
+      char buf[256];
+      sat_strerror(error, buf, sizeof(buf));
+      logprintf(0, "Process Error: Unable to wait for async I/O "
+                   "on disk %s (thread %d). Error %d, %s\n",
+                device_name_.c_str(), thread_num_, error, buf);
+    }
+    return false;
+  }
+
+  uring_inflight_--;
+  int slot;
+  int64 offset;
+  int64 size;
+  UnpackUringRequest(data, &slot, &offset, &size);
+  UringSlot *s = &slots[slot];
+  if (result != size) {
+    ReportIoError(s->op, result, s->offset + offset);
+    s->failed = true;
+  }
+  if (--s->pending == 0) {
+    s->end_time = GetTime();
+    uring_done_.push_back(slot);
+  }
+  return true;
+}
+
+// Queue one request, keeping at most active_depth_ requests in flight.
+bool DiskThread::UringQueue(int fd, void *buf, int64 size, int64 offset,
+                            int buffer_index, int slot, UringSlot *slots) {
+  uint64 data = PackUringRequest(slot, offset - slots[slot].offset, size);
+  while (uring_inflight_ >= active_depth_ ||
+         !uring_->Queue(slots[slot].op == ASYNC_IO_WRITE, fd, buf, size,
+                        offset, buffer_index, data)) {
+    if (!UringSubmit() || !UringReap(slots, write_timeout_))
+      return false;
+  }
+  uring_inflight_++;
+  return true;
+}
+
+// Submit everything queued and wait for all of it to complete.
+bool DiskThread::UringFlush(UringSlot *slots) {
+  if (!UringSubmit())
+    return false;
+  while (uring_inflight_ > 0) {
+    if (!UringReap(slots, write_timeout_))
+      return false;
+  }
+  return true;
+}
+
+// A single io_uring request, with the same semantics as the libaio path.
+bool DiskThread::UringDiskIO(IoOp op, int fd, void *buf, int64 size,
+                             int64 offset) {
+  UringSlot slot;
+  slot.op = op;
+  slot.block = NULL;
+  slot.offset = offset;
+  slot.pending = 1;
+  slot.failed = false;
+  slot.start_time = GetTime();
+  slot.end_time = 0;
+  int buffer_index = (buf == block_buffer_) ? 0 : -1;
+  if (!UringQueue(fd, buf, size, offset, buffer_index, 0, &slot))
+    return false;
+  if (!UringFlush(&slot))
+    return false;
+  uring_done_.clear();
+  return !slot.failed;
+}
+
+// Fill buffer slot 'index' with data for 'block' and queue its write.
+bool DiskThread::UringQueueWrite(int fd, int index, BlockData *block,
+                                 UringSlot *slots) {
+  FillBlockBuffer(block, slot_buffers_[index]);
+
+  logprintf(12, "Log: Writing %lld sectors starting at %lld on disk %s"
+            " (thread %d).\n",
+            block->size()/kSectorSize, block->address(),
+            device_name_.c_str(), thread_num_);
+
+  UringSlot *s = &slots[index];
+  s->op = ASYNC_IO_WRITE;
+  s->block = block;
+  s->offset = block->address() * kSectorSize;
+  s->pending = 1;
+  s->failed = false;
+  s->start_time = GetTime();
+  s->end_time = 0;
+  return UringQueue(fd, slot_buffers_[index], block->size(), s->offset,
+                    index + 1, index, slots);
+}
+
+// Queue the reads verifying 'block' into buffer slot 'index'. The block is
+// read with the same random split into read-sized requests as
+// ValidateBlockOnDisk.
+bool DiskThread::UringQueueVerify(int fd, int index, BlockData *block,
+                                  UringSlot *slots) {
+  char *buffer = static_cast<char*>(slot_buffers_[index]);
+  memset(buffer, 0, block->size());
+
+  logprintf(20, "Log: Reading sectors starting at %lld on disk %s "
+            "(thread %d).\n",
+            block->address(), device_name_.c_str(), thread_num_);
+
+  // Pick the read sizes first, so the slot can't look complete
+  // before all of its requests are queued.
+  vector<int64> sizes;
+  int64 remaining = block->size() / read_block_size_;
+  while (remaining != 0) {
+    int64 current_blocks = prng_.Below(remaining) + 1;
+    sizes.push_back(current_blocks * read_block_size_);
+    remaining -= current_blocks;
+  }
+
+  UringSlot *s = &slots[index];
+  s->op = ASYNC_IO_READ;
+  s->block = block;
+  s->offset = block->address() * kSectorSize;
+  s->pending = sizes.size();
+  s->failed = false;
+  s->start_time = GetTime();
+  s->end_time = 0;
+  int64 bytes_read = 0;
+  for (size_t j = 0; j < sizes.size(); j++) {
+    logprintf(20, "Log: Reading %lld sectors starting at sector %lld on "
+              "disk %s (thread %d)\n",
+              sizes[j] / kSectorSize,
+              (s->offset + bytes_read) / kSectorSize,
+              device_name_.c_str(), thread_num_);
+    if (!UringQueue(fd, buffer + bytes_read, sizes[j], s->offset + bytes_read,
+                    index + 1, index, slots))
+      return false;
+    bytes_read += sizes[j];
+  }
+  return true;
+}
+
+// Finish buffer slot 'index' once all of its requests completed: warn
+// about slow transfers, and check the data of a verified block.
+// Return false if one of its requests failed.
+bool DiskThread::UringFinishSlot(UringSlot *slots, int index) {
+  UringSlot *s = &slots[index];
+  if (s->failed)
+    return false;
+
+  int64 elapsed = s->end_time - s->start_time;
+  if (s->op == ASYNC_IO_WRITE) {
+    write_latency_.Record(elapsed);
+    logprintf(12, "Log: Writing time: %lld us (thread %d).\n",
+              elapsed, thread_num_);
+    if (elapsed > write_threshold_) {
+      logprintf(5, "Log: Write took %lld us which is longer than threshold "
+                   "%lld us on disk %s (thread %d).\n",
+                elapsed, write_threshold_, device_name_.c_str(),
+                thread_num_);
+    }
+    return true;
+  }
+
+  read_latency_.Record(elapsed);
+  logprintf(20, "Log: Reading time: %lld us (thread %d).\n",
+            elapsed, thread_num_);
+  if (elapsed > read_threshold_) {
+    logprintf(5, "Log: Read took %lld us which is longer than threshold "
+              "%lld us on disk %s (thread %d).\n",
+              elapsed, read_threshold_,
+              device_name_.c_str(), thread_num_);
+  }
+
+  // In non-destructive mode, don't compare the block to the pattern since
+  // the block was never written to disk in the first place.
+  if (!non_destructive_) {
+    BlockData *block = s->block;
+    if (CheckRegion(slot_buffers_[index], BlockPattern(block), 0,
+                    block->size(), 0, 0)) {
+      os_->ErrorReport(device_name_.c_str(), "disk-pattern-error", 1);
+      stats_->AddErrors(1);
+      logprintf(0, "Hardware Error: Pattern mismatch in block starting at "
+                "sector %lld in DiskThread::ValidateBlocksOnDisk on "
+                "disk %s (thread %d).\n",
+                block->address(), device_name_.c_str(), thread_num_);
+    }
+  }
+  return true;
+}
+
+// Write a batch of blocks to disk with all writes in flight together.
+// Return false if any block is not written.
+bool DiskThread::WriteBlocksToDisk(int fd, BlockData **blocks, int count) {
+  vector<UringSlot> slots(count);
+  for (int i = 0; i < count; i++) {
+    if (!UringQueueWrite(fd, i, blocks[i], &slots[0]))
+      return false;
+  }
+  if (!UringFlush(&slots[0]))
+    return false;
+  uring_done_.clear();
+
+  bool result = true;
+  for (int i = 0; i < count; i++)
+    result = UringFinishSlot(&slots[0], i) && result;
+  return result;
+}
+
+// Verify a batch of blocks on disk with all reads in flight together.
+// Return true if the blocks were read, also increment errorcount
+// if they had data errors or performance problems.
+bool DiskThread::ValidateBlocksOnDisk(int fd, BlockData **blocks,
+                                      int count) {
+  vector<UringSlot> slots(count);
+  for (int i = 0; i < count; i++) {
+    if (!UringQueueVerify(fd, i, blocks[i], &slots[0]))
+      return false;
+  }
+  if (!UringFlush(&slots[0]))
+    return false;
+  uring_done_.clear();
+
+  bool result = true;
+  for (int i = 0; i < count; i++)
+    result = UringFinishSlot(&slots[0], i) && result;
+  return result;
+}
+
+// Hand the block of a finished pipeline slot on: written blocks wait for
+// verification and verified blocks are done with.
+// Return false if the slot's I/O failed.
+bool DiskThread::FinishPipelinedSlot(UringSlot *slots, int index) {
+  UringSlot *s = &slots[index];
+  block_table_->SetInFlight(s->block, false);
+  if (!UringFinishSlot(slots, index)) {
+    block_table_->RemoveBlock(s->block);
+    return false;
+  }
+  if (s->op == ASYNC_IO_WRITE) {
+    s->block->set_initialized();
+    in_flight_sectors_.push(s->block);
+    blocks_written_++;
+  } else {
+    block_table_->RemoveBlock(s->block);
+    blocks_read_++;
+  }
+  stats_->set_pages(blocks_written_ + blocks_read_);
+  return true;
+}
+
+// Pipelined workload: every buffer slot always has a block being written
+// or verified, so writes of new blocks overlap verification of the blocks
+// written queue_size_ blocks earlier. A block is verified once it is the
+// oldest of more than queue_size_ written blocks, as in DoWork, so that
+// it has been pushed out of the disk cache.
+// Return false on fatal SW error, true on SW success,
+// regardless of whether HW failed.
+bool DiskThread::DoPipelinedWork(int fd) {
+  int64 block_num = 0;
+  int64 num_segments = NumSegments();
+  sat_assert(device_sectors_ * kSectorSize > 3 * cache_size_);
+
+  logprintf(16, "Log: Pipelined %sphase with %d blocks in flight for disk %s "
+            "(thread %d).\n",
+            non_destructive_ ? "read " : "",
+            queue_depth_, device_name_.c_str(), thread_num_);
+
+  vector<UringSlot> slots(queue_depth_);
+  vector<int> free_slots;
+  for (int i = queue_depth_ - 1; i >= 0; i--)
+    free_slots.push_back(i);
+  uring_done_.clear();
+
+  while (IsReadyToRun()) {
+    // Put idle buffer slots to work, up to the active depth.
+    while (!free_slots.empty() && IsReadyToRunNoPause() &&
+           queue_depth_ - static_cast<int>(free_slots.size()) <
+               active_depth_) {
+      int index = free_slots.back();
+      bool queued;
+      if (in_flight_sectors_.size() > static_cast<size_t>(queue_size_)) {
+        BlockData *block = in_flight_sectors_.front();
+        in_flight_sectors_.pop();
+        block_table_->SetInFlight(block, true);
+        queued = UringQueueVerify(fd, index, block, &slots[0]);
+      } else {
+        // Confine testing to a particular segment of the disk.
+        int64 segment = (block_num / blocks_per_segment_) % num_segments;
+        block_num++;
+        BlockData *block = block_table_->GetUnusedBlock(segment);
+        if (block == NULL)
+          continue;
+        // In non-destructive mode, don't write anything to disk.
+        if (non_destructive_) {
+          block->set_initialized();
+          in_flight_sectors_.push(block);
+          continue;
+        }
+        block_table_->SetInFlight(block, true);
+        queued = UringQueueWrite(fd, index, block, &slots[0]);
+      }
+      if (!queued)
+        return true;
+      free_slots.pop_back();
+    }
+    if (!UringSubmit())
+      return true;
+
+    if (uring_done_.empty() && uring_inflight_ > 0) {
+      if (!UringReap(&slots[0], write_timeout_))
+        return true;
+    }
+    for (size_t i = 0; i < uring_done_.size(); i++) {
+      if (!FinishPipelinedSlot(&slots[0], uring_done_[i]))
+        return true;
+      free_slots.push_back(uring_done_[i]);
+    }
+    uring_done_.clear();
+  }
+
+  // Let the requests still in flight finish, without starting new ones.
+  logprintf(12, "Log: Draining %lld blocks in flight on disk %s "
+            "(thread %d).\n",
+            block_table_->InFlight(), device_name_.c_str(), thread_num_);
+  if (!UringFlush(&slots[0]))
+    return true;
+  for (size_t i = 0; i < uring_done_.size(); i++) {
+    if (!FinishPipelinedSlot(&slots[0], uring_done_[i]))
+      return true;
+  }
+  uring_done_.clear();
 
+  stats_->set_pages(blocks_written_ + blocks_read_);
   return true;
 }
 
@@ -3224,20 +5999,13 @@ bool DiskThread::Work() {
     return false;
   }
 
-  // Allocate a block buffer aligned to 512 bytes since the kernel requires it
-  // when using direct IO.
-#ifdef HAVE_POSIX_MEMALIGN
-  int memalign_result = posix_memalign(&block_buffer_, kBufferAlignment,
-                                       sat_->page_length());
-#else
-  block_buffer_ = memalign(kBufferAlignment, sat_->page_length());
-  int memalign_result = (block_buffer_ == 0);
-#endif
-  if (memalign_result) {
+  // Take a block buffer from the shared pool, which aligns them for direct
+  // IO and pins them.
+  block_buffer_ = sat_->io_buffers()->Get();
+  if (!block_buffer_) {
     CloseDevice(fd);
-    logprintf(0, "Process Error: Unable to allocate memory for buffers "
-                 "for disk %s (thread %d) posix memalign returned %d.\n",
-              device_name_.c_str(), thread_num_, memalign_result);
+    logprintf(0, "Process Error: Unable to get a buffer for disk %s "
+                 "(thread %d).\n", device_name_.c_str(), thread_num_);
     status_ = false;
     return false;
   }
@@ -3253,18 +6021,31 @@ bool DiskThread::Work() {
   }
 #endif
 
+  if (!SetupUring()) {
+#ifdef HAVE_LIBAIO_H
+    io_destroy(aio_ctx_);
+#endif
+    CloseDevice(fd);
+    status_ = false;
+    return false;
+  }
+
   bool result = DoWork(fd);
 
   status_ = result;
 
+  TeardownUring();
 #ifdef HAVE_LIBAIO_H
   io_destroy(aio_ctx_);
 #endif
   CloseDevice(fd);
 
+  if (update_block_table_)
+    logprintf(12, "Log: Disk block table for %s used %lldKB\n",
+              device_name_.c_str(), block_table_->MemoryUsage() >> 10);
   logprintf(9, "Log: Completed %d (disk %s): disk thread status %d, "
                "%d pages copied\n",
-            thread_num_, device_name_.c_str(), status_, pages_copied_);
+            thread_num_, device_name_.c_str(), status_, stats_->pages());
   return result;
 }
 
@@ -3289,15 +6070,17 @@ bool RandomDiskThread::DoWork(int fd) {
       ValidateBlockOnDisk(fd, block);
       block_table_->ReleaseBlock(block);
       blocks_read_++;
+      stats_->set_pages(blocks_read_);
     }
   }
-  pages_copied_ = blocks_read_;
+  stats_->set_pages(blocks_read_);
   return true;
 }
 
 MemoryRegionThread::MemoryRegionThread() {
   error_injection_ = false;
   pages_ = NULL;
+  access_width_ = 0;
 }
 
 MemoryRegionThread::~MemoryRegionThread() {
@@ -3332,6 +6115,113 @@ bool MemoryRegionThread::SetRegion(void *region, int64 size) {
   }
 }
 
+namespace {
+// Copy and compare with accesses of exactly sizeof(T) bytes.
+template <typename T>
+void CopyWords(volatile T *dst, const T *src, int64 count) {
+  for (int64 i = 0; i < count; i++)
+    dst[i] = src[i];
+}
+
+template <typename T>
+int64 FindWordMismatch(volatile T *region, const T *src, int64 count,
+                       int64 start, uint64 *actual, uint64 *reread) {
+  for (int64 i = start; i < count; i++) {
+    T value = region[i];
+    if (value != src[i]) {
+      *actual = value;
+      *reread = region[i];
+      return i;
+    }
+  }
+  return -1;
+}
+}  // namespace
+
+void MemoryRegionThread::WidthCopyPage(struct page_entry *dstpe,
+                                       struct page_entry *srcpe) {
+  int64 length = sat_->page_length();
+  void *dst = dstpe->addr;
+  void *src = srcpe->addr;
+  switch (access_width_) {
+    case 1:
+      CopyWords(static_cast<volatile uint8*>(dst),
+                static_cast<uint8*>(src), length);
+      break;
+    case 2:
+      CopyWords(static_cast<volatile uint16*>(dst),
+                static_cast<uint16*>(src), length / 2);
+      break;
+    case 4:
+      CopyWords(static_cast<volatile uint32*>(dst),
+                static_cast<uint32*>(src), length / 4);
+      break;
+    default:
+      CopyWords(static_cast<volatile uint64*>(dst),
+                static_cast<uint64*>(src), length / 8);
+      break;
+  }
+}
+
+int MemoryRegionThread::WidthCheckPage(struct page_entry *regionpe,
+                                       struct page_entry *srcpe) {
+  int width = access_width_;
+  int64 count = sat_->page_length() / width;
+  void *region = regionpe->addr;
+  void *src = srcpe->addr;
+  int errors = 0;
+  int64 index = 0;
+  while (index < count) {
+    uint64 actual = 0, reread = 0;
+    int64 bad;
+    switch (width) {
+      case 1:
+        bad = FindWordMismatch(static_cast<volatile uint8*>(region),
+                               static_cast<uint8*>(src), count, index,
+                               &actual, &reread);
+        break;
+      case 2:
+        bad = FindWordMismatch(static_cast<volatile uint16*>(region),
+                               static_cast<uint16*>(src), count, index,
+                               &actual, &reread);
+        break;
+      case 4:
+        bad = FindWordMismatch(static_cast<volatile uint32*>(region),
+                               static_cast<uint32*>(src), count, index,
+                               &actual, &reread);
+        break;
+      default:
+        bad = FindWordMismatch(static_cast<volatile uint64*>(region),
+                               static_cast<uint64*>(src), count, index,
+                               &actual, &reread);
+        break;
+    }
+    if (bad < 0)
+      break;
+
+    errors++;
+    char *vaddr = static_cast<char*>(region) + bad * width;
+    uint64 expected = 0;
+    memcpy(&expected, static_cast<char*>(src) + bad * width, width);
+    if (errors <= kErrorLimit) {
+      logprintf(0, "Hardware Error: miscompare on %s, %d byte access at "
+                "%p, offset %llx: read:0x%016llx, reread:0x%016llx "
+                "expected:0x%016llx\n",
+                identifier_.c_str(), width, vaddr,
+                static_cast<uint64>(vaddr - region_), actual, reread,
+                expected);
+    }
+    index = bad + 1;
+  }
+  if (errors > kErrorLimit) {
+    logprintf(0, "Log: %d more miscompares on %s not shown\n",
+              errors - kErrorLimit, identifier_.c_str());
+  }
+  if (errors)
+    stats_->AddErrors(errors);
+  return errors;
+}
+
 // More detailed error printout for hardware errors in memory or MMIO
 // regions.
 void MemoryRegionThread::ProcessError(struct ErrorRecord *error,
@@ -3420,28 +6310,37 @@ bool MemoryRegionThread::Work() {
     // Error injection for CRC copy.
     if ((sat_->error_injection() || error_injection_) && loops == 1) {
       addr = reinterpret_cast<int64*>(source_pe.addr);
-      offset = random() % (sat_->page_length() / wordsize_);
+      offset = prng_.Below(sat_->page_length() / wordsize_);
       data = addr[offset];
       addr[offset] = error_constant;
     }
 
     // Copying SAT page into memory region.
     phase_ = kPhaseCopy;
-    CrcCopyPage(&memregion_pe, &source_pe);
+    if (access_width_) {
+      // Check the source first, since the width copy doesn't.
+      CrcCheckPage(&source_pe);
+      WidthCopyPage(&memregion_pe, &source_pe);
+    } else {
+      CrcCopyPage(&memregion_pe, &source_pe);
+    }
     memregion_pe.pattern = source_pe.pattern;
     memregion_pe.lastcpu = sched_getcpu();
 
     // Error injection for CRC Check.
     if ((sat_->error_injection() || error_injection_) && loops == 2) {
       addr = reinterpret_cast<int64*>(memregion_pe.addr);
-      offset = random() % (sat_->page_length() / wordsize_);
+      offset = prng_.Below(sat_->page_length() / wordsize_);
       data = addr[offset];
       addr[offset] = error_constant;
     }
 
     // Checking page content in memory region.
     phase_ = kPhaseCheck;
-    CrcCheckPage(&memregion_pe);
+    if (access_width_)
+      WidthCheckPage(&memregion_pe, &source_pe);
+    else
+      CrcCheckPage(&memregion_pe);
 
     phase_ = kPhaseNoPhase;
     // Storing pages on their proper queues.
@@ -3467,10 +6366,10 @@ bool MemoryRegionThread::Work() {
     YieldSelf();
   }
 
-  pages_copied_ = loops;
+  stats_->set_pages(loops);
   status_ = result;
   logprintf(9, "Log: Completed %d: Memory Region thread. Status %d, %d "
-            "pages checked\n", thread_num_, status_, pages_copied_);
+            "pages checked\n", thread_num_, status_, stats_->pages());
   return result;
 }
 
@@ -3484,8 +6383,15 @@ const CpuFreqThread::CpuRegisterType CpuFreqThread::kCpuRegisters[] = {
 CpuFreqThread::CpuFreqThread(int num_cpus, int freq_threshold, int round)
   : num_cpus_(num_cpus),
     freq_threshold_(freq_threshold),
-    round_(round) {
+    round_(round),
+    package_energy_addr_(kMsrPkgEnergyAddr),
+    have_sample_(false),
+    total_package_joules_(0.),
+    total_dram_joules_(0.),
+    total_seconds_(0.) {
   sat_assert(round >= 0);
+  memset(&sample_, 0, sizeof(sample_));
+  pthread_mutex_init(&sample_lock_, NULL);
   if (round == 0) {
     // If rounding is off, force rounding to the nearest MHz.
     round_ = 1;
@@ -3496,6 +6402,7 @@ CpuFreqThread::CpuFreqThread(int num_cpus, int freq_threshold, int round)
 }
 
 CpuFreqThread::~CpuFreqThread() {
+  pthread_mutex_destroy(&sample_lock_);
 }
 
 // Compute the difference between the currently read MSR values and the
@@ -3567,6 +6474,15 @@ bool CpuFreqThread::Work() {
   vector<CpuDataType> data[2];
   data[0].resize(num_cpus_);
   data[1].resize(num_cpus_);
+  vector<int> mhz(num_cpus_, 0);
+  best_mhz_.assign(num_cpus_, 0);
+  throttled_.assign(num_cpus_, false);
+  FindPackages(cpuset);
+  int first_cpu = -1;
+  for (int cpu = 0; cpu < num_cpus_ && first_cpu < 0; cpu++)
+    if (CPU_ISSET(cpu, &cpuset))
+      first_cpu = cpu;
+
   while (IsReadyToRun(&paused)) {
     if (paused) {
       // Reset the intervals and restart logic after the pause.
@@ -3594,6 +6510,11 @@ bool CpuFreqThread::Work() {
       num_intervals = 0;
       continue;
     }
+    // Energy since the previous read, which also starts the count over
+    // after a reset.
+    double package_joules = 0.;
+    double dram_joules = 0.;
+    bool energy = has_energy() && ReadEnergy(&package_joules, &dram_joules);
 
     num_intervals++;
 
@@ -3611,14 +6532,25 @@ bool CpuFreqThread::Work() {
             break;
           }
           logprintf(15, "Cpu %d Freq %d\n", cpu, freq);
+          mhz[cpu] = freq;
           if (freq < freq_threshold_) {
-            errorcount_++;
+            stats_->AddErrors(1);
             pass = false;
             logprintf(0, "Log: Cpu %d frequency is too low, frequency %d MHz "
                       "threshold %d MHz.\n", cpu, freq, freq_threshold_);
           }
         }
       }
+      if (num_intervals && first_cpu >= 0) {
+        struct timeval tv;
+        timersub(&data[curr][first_cpu].tv, &data[prev][first_cpu].tv, &tv);
+        if (!energy) {
+          package_joules = 0.;
+          dram_joules = 0.;
+        }
+        AddSample(mhz, package_joules, dram_joules,
+                  tv.tv_sec + tv.tv_usec / 1000000.0);
+      }
     }
 
     sat_sleep(kIntervalPause);
@@ -3632,6 +6564,181 @@ bool CpuFreqThread::Work() {
 }
 
 
+namespace {
+// Intel server parts count DRAM energy in fixed 15.3uJ units instead of
+// the unit in MSR_RAPL_POWER_UNIT, see intel_rapl in Linux.
+bool FixedDramEnergyUnit() {
+#if defined(STRESSAPPTEST_CPU_X86_64) || defined(STRESSAPPTEST_CPU_I686)
+  static const int kServerModels[] = {
+    0x3F, 0x4F, 0x56, 0x55, 0x57, 0x85, 0x6A, 0x6C, 0x8F, 0xCF, 0xAD, 0xAE,
+  };
+  unsigned int eax = 1, ebx, ecx, edx;
+  cpuid(&eax, &ebx, &ecx, &edx);
+  int family = (eax >> 8) & 0xf;
+  int model = ((eax >> 4) & 0xf) | (((eax >> 16) & 0xf) << 4);
+  if (family != 6)
+    return false;
+  for (size_t i = 0; i < sizeof(kServerModels) / sizeof(*kServerModels);
+       i++) {
+    if (model == kServerModels[i])
+      return true;
+  }
+#endif
+  return false;
+}
+}  // namespace
+
+void CpuFreqThread::FindPackages(const cpu_set_t &cpuset) {
+  packages_.clear();
+  uint32 unit_addr = kMsrRaplUnitAddr;
+  package_energy_addr_ = kMsrPkgEnergyAddr;
+  bool fixed_dram_unit = FixedDramEnergyUnit();
+  set<int> seen;
+  for (int cpu = 0; cpu < num_cpus_; cpu++) {
+    if (!CPU_ISSET(cpu, &cpuset))
+      continue;
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    int package = -1;
+    FILE *file = fopen(path, "r");
+    if (file) {
+      if (fscanf(file, "%d", &package) != 1)
+        package = -1;
+      fclose(file);
+    }
+    if (seen.count(package))
+      continue;
+    seen.insert(package);
+
+    uint64 units;
+    if (packages_.empty() && !os_->ReadMSR(cpu, unit_addr, &units)) {
+      // Not Intel, try AMD.
+      unit_addr = kMsrAmdRaplUnitAddr;
+      package_energy_addr_ = kMsrAmdPkgEnergyAddr;
+      fixed_dram_unit = false;
+    }
+    uint64 value;
+    if (!os_->ReadMSR(cpu, unit_addr, &units) ||
+        !os_->ReadMSR(cpu, package_energy_addr_, &value))
+      continue;
+
+    RaplPackageType rapl;
+    rapl.cpu = cpu;
+    // Energy status units are bits 12:8, in 1/2^n joules.
+    rapl.unit = 1.0 / (1ULL << ((units >> 8) & 0x1f));
+    rapl.package_last = value;
+    rapl.dram_unit = 0.;
+    rapl.dram_last = 0;
+    if (package_energy_addr_ == kMsrPkgEnergyAddr &&
+        os_->ReadMSR(cpu, kMsrDramEnergyAddr, &value)) {
+      rapl.dram_unit = fixed_dram_unit ? 15.3e-6 : rapl.unit;
+      rapl.dram_last = value;
+    }
+    packages_.push_back(rapl);
+  }
+  if (packages_.empty())
+    logprintf(5, "Log: No RAPL energy counters, not measuring power.\n");
+  else
+    logprintf(5, "Log: Measuring power of %d packages%s.\n",
+              static_cast<int>(packages_.size()),
+              packages_[0].dram_unit > 0 ? " and their DRAM" : "");
+}
+
+bool CpuFreqThread::ReadEnergy(double *package_joules, double *dram_joules) {
+  *package_joules = 0.;
+  *dram_joules = 0.;
+  bool ok = true;
+  for (size_t i = 0; i < packages_.size(); i++) {
+    RaplPackageType *rapl = &packages_[i];
+    uint64 value;
+    if (!os_->ReadMSR(rapl->cpu, package_energy_addr_, &value)) {
+      ok = false;
+      continue;
+    }
+    // The counters are 32 bits and wrap every few minutes at full power.
+    uint32 now = value;
+    *package_joules += static_cast<uint32>(now - rapl->package_last) *
+                       rapl->unit;
+    rapl->package_last = now;
+    if (rapl->dram_unit > 0) {
+      if (!os_->ReadMSR(rapl->cpu, kMsrDramEnergyAddr, &value)) {
+        ok = false;
+        continue;
+      }
+      now = value;
+      *dram_joules += static_cast<uint32>(now - rapl->dram_last) *
+                      rapl->dram_unit;
+      rapl->dram_last = now;
+    }
+  }
+  return ok;
+}
+
+void CpuFreqThread::AddSample(const vector<int> &mhz, double package_joules,
+                              double dram_joules, double seconds) {
+  struct PowerSample sample;
+  memset(&sample, 0, sizeof(sample));
+  sample.seconds = seconds;
+  if (seconds > 0) {
+    sample.package_watts = package_joules / seconds;
+    sample.dram_watts = dram_joules / seconds;
+  }
+  int cpus = 0;
+  double sum = 0.;
+  for (int cpu = 0; cpu < num_cpus_; cpu++) {
+    if (!mhz[cpu])
+      continue;
+    if (!cpus || mhz[cpu] < sample.min_mhz)
+      sample.min_mhz = mhz[cpu];
+    if (mhz[cpu] > sample.max_mhz)
+      sample.max_mhz = mhz[cpu];
+    sum += mhz[cpu];
+    cpus++;
+
+    if (mhz[cpu] > best_mhz_[cpu])
+      best_mhz_[cpu] = mhz[cpu];
+    bool throttled = mhz[cpu] * 100 < best_mhz_[cpu] * kThrottlePercent;
+    if (throttled) {
+      sample.throttled_cpus++;
+      if (!throttled_[cpu])
+        logprintf(5, "Log: Cpu %d throttled to %d MHz from %d MHz.\n",
+                  cpu, mhz[cpu], best_mhz_[cpu]);
+    }
+    throttled_[cpu] = throttled;
+  }
+  if (cpus)
+    sample.avg_mhz = sum / cpus;
+  logprintf(12, "Log: Power %.1fW package, %.1fW DRAM, %.0f MHz average, "
+                "%d throttled cpus.\n", sample.package_watts,
+            sample.dram_watts, sample.avg_mhz, sample.throttled_cpus);
+
+  pthread_mutex_lock(&sample_lock_);
+  sample_ = sample;
+  have_sample_ = true;
+  total_package_joules_ += package_joules;
+  total_dram_joules_ += dram_joules;
+  total_seconds_ += seconds;
+  pthread_mutex_unlock(&sample_lock_);
+}
+
+bool CpuFreqThread::LastSample(struct PowerSample *sample) {
+  pthread_mutex_lock(&sample_lock_);
+  bool have = have_sample_;
+  *sample = sample_;
+  pthread_mutex_unlock(&sample_lock_);
+  return have;
+}
+
+void CpuFreqThread::TotalEnergy(double *package_joules, double *dram_joules,
+                                double *seconds) {
+  pthread_mutex_lock(&sample_lock_);
+  *package_joules = total_package_joules_;
+  *dram_joules = total_dram_joules_;
+  *seconds = total_seconds_;
+  pthread_mutex_unlock(&sample_lock_);
+}
+
 // Get the MSR values for this particular cpu and save them in data. If
 // any error is encountered, returns false. Otherwise, returns true.
 bool CpuFreqThread::GetMsrs(int cpu, CpuDataType *data) {
@@ -38,6 +38,12 @@
 // This file must work with autoconf on its public version,
 // so these includes are correct.
 #include "disk_blocks.h"
+#include "disk_uring.h"
+#include "latency_histogram.h"
+#include "march.h"
+#include "net_coordinator.h"
+#include "net_rdma.h"
+#include "prng.h"
 #include "queue.h"
 #include "sattypes.h"
 
@@ -47,6 +53,20 @@ struct cc_cacheline_data {
   char *num;
 };
 
+// Schedule shared by the Cache Coherency Worker Threads in pair mode.
+// Pairs of threads take turns bouncing a single cacheline between their
+// cores, the first thread of the pair records the result and passes the
+// turn on.
+struct cc_pair_schedule {
+  volatile int64 turn;     // Turn number, pair under test is turn % pairs.
+  int pairs;               // Number of thread pairs.
+  int *first;              // Thread that starts and times each pair.
+  int *second;             // Thread answering it.
+  uint64 *line;            // Bounced cacheline, on a line of its own.
+  int64 *transfers;        // Cacheline transfers timed for each pair.
+  int64 *ns;               // Time taken by those transfers.
+};
+
 // Typical usage:
 // (Other workflows may be possible, see function comments for details.)
 // - Control thread creates object.
@@ -64,6 +84,10 @@ struct cc_cacheline_data {
 // - Control thread calls Destroy().
 // - Control thread destroys object.
 //
+// The status and a generation count of status changes share one word, so the
+// workers' ContinueRunning() fast path is a single atomic load. Locks and
+// the pause barrier are only touched once a pause or stop has been requested.
+//
 // Threadsafety:
 // - ContinueRunning() may be called concurrently by different workers, but not
 //     by a single worker.
@@ -79,7 +103,7 @@ class WorkerStatus {
   // Methods for the control thread.
   //--------------------------------
 
-  WorkerStatus() : num_workers_(0), status_(RUN) {}
+  WorkerStatus() : num_workers_(0), state_(RUN) {}
 
   // Called by the control thread to increase the worker count.  Must be called
   // before Initialize().  The worker count is 0 upon object initialization.
@@ -134,8 +158,16 @@ class WorkerStatus {
   // PauseWorkers() should never be used!
   bool ContinueRunningNoPause();
 
+  // Number of status changes so far, which lets a caller tell whether a
+  // pause or resume happened in between two calls.
+  uint64 generation() {
+    return __atomic_load_n(&state_, __ATOMIC_ACQUIRE) >> kStatusBits;
+  }
+
  private:
   enum Status { RUN, PAUSE, STOP };
+  static const int kStatusBits = 2;
+  static const uint64 kStatusMask = (1ULL << kStatusBits) - 1;
 
   void WaitOnPauseBarrier() {
 #ifdef HAVE_PTHREAD_BARRIERS
@@ -167,27 +199,31 @@ class WorkerStatus {
     sat_assert(0 == pthread_rwlock_unlock(&status_rwlock_));
   }
 
+  // Lock free, pairs with the release in SetStatus().
   Status GetStatus() {
-    AcquireStatusReadLock();
-    Status status = status_;
-    ReleaseStatusLock();
-    return status;
+    return static_cast<Status>(__atomic_load_n(&state_, __ATOMIC_ACQUIRE) &
+                               kStatusMask);
   }
 
-  // Returns the previous status.
+  // Returns the previous status. Still takes the write lock so that it
+  // can't interleave with RemoveSelf() resizing the pause barrier.
   Status SetStatus(Status status) {
     AcquireStatusWriteLock();
-    Status prev_status = status_;
-    status_ = status;
+    uint64 prev_state = state_;
+    uint64 generation = (prev_state >> kStatusBits) + 1;
+    __atomic_store_n(&state_, (generation << kStatusBits) | status,
+                     __ATOMIC_RELEASE);
     ReleaseStatusLock();
-    return prev_status;
+    return static_cast<Status>(prev_state & kStatusMask);
   }
 
   pthread_mutex_t num_workers_mutex_;
   int num_workers_;
 
+  // Serializes status changes against RemoveSelf(), not taken by
+  // ContinueRunning().
   pthread_rwlock_t status_rwlock_;
-  Status status_;
+  uint64 state_;                   // Generation << kStatusBits | Status.
 
 #ifdef HAVE_PTHREAD_BARRIERS
   pthread_barrier_t pause_barrier_;
@@ -198,6 +234,65 @@ class WorkerStatus {
 };
 
 
+// Counters of one worker thread. Only the owning thread updates them, with
+// relaxed atomic stores, so the stats and telemetry paths can read them at
+// any time without locks. Each block gets cache lines of its own so that
+// readers and neighbouring threads don't false share with the updates.
+class WorkerStats {
+ public:
+  // Allocate a zeroed, cache line aligned block.
+  static WorkerStats *Create();
+  static void Destroy(WorkerStats *stats);
+
+  int64 pages() const {return Load(&pages_);}
+  int64 errors() const {return Load(&errors_);}
+
+  // Owning thread only.
+  void set_pages(int64 pages) {Store(&pages_, pages);}
+  void AddErrors(int64 errors) {Store(&errors_, errors_ + errors);}
+
+ private:
+  WorkerStats() : pages_(0), errors_(0) {}
+
+  static int64 Load(const int64 *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+  }
+  static void Store(int64 *counter, int64 value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+  }
+
+  int64 pages_;                     // Recorded for memory bandwidth calc.
+  int64 errors_;                    // Miscompares seen by this thread.
+  char padding_[kCacheLineSize - 2 * sizeof(int64)];
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerStats);
+};
+
+
+// Holds a group of threads to a shared bandwidth. Each thread accounts for
+// the data it has moved, and sleeps once the group has got ahead of the
+// rate. Idle time earns at most kBurstNs worth of credit, so a group that
+// falls behind doesn't race to catch up. Threadsafe without locks.
+class RateLimiter {
+ public:
+  explicit RateLimiter(double mb_per_sec);
+
+  // Account for 'mb' of data moved, sleeping while the group is ahead.
+  void Consume(double mb);
+
+  double mb_per_sec() const {return mb_per_sec_;}
+
+ private:
+  static const int64 kBurstNs = 10000000;
+
+  double mb_per_sec_;
+  double ns_per_mb_;
+  volatile int64 next_ns_;          // When the data so far is due at rate.
+
+  DISALLOW_COPY_AND_ASSIGN(RateLimiter);
+};
+
+
 // This is a base class for worker threads.
 // Each thread repeats a specific
 // task on various blocks of memory.
@@ -209,6 +304,9 @@ class WorkerThread {
     Normal,
     High,
   };
+  // How often parked threads look for being unparked.
+  static const int32 kParkedPollUs = 10000;
+
   WorkerThread();
   virtual ~WorkerThread();
 
@@ -252,8 +350,8 @@ class WorkerThread {
 
   // Acccess member variables.
   bool GetStatus() {return status_;}
-  int64 GetErrorCount() {return errorcount_;}
-  int64 GetPageCount() {return pages_copied_;}
+  int64 GetErrorCount() {return stats_->errors();}
+  int64 GetPageCount() {return stats_->pages();}
   int64 GetRunDurationUSec() {return runduration_usec_;}
 
   // Returns bandwidth defined as pages_copied / thread_run_durations.
@@ -279,6 +377,16 @@ class WorkerThread {
 
   void set_tag(int32 tag) {tag_ = tag;}
 
+  // Parked threads idle in IsReadyToRun() until unparked, but still take
+  // part in pauses and stop when told to.
+  void set_parked(bool parked) {
+    __atomic_store_n(&parked_, parked, __ATOMIC_RELEASE);
+  }
+
+  // Hold this thread's memory and device traffic to 'limiter', shared
+  // with the other threads of its type. NULL runs unthrottled.
+  void set_rate_limiter(RateLimiter *limiter) {rate_limiter_ = limiter;}
+
   // Returns CPU mask, where each bit represents a logical cpu.
   bool AvailableCpus(cpu_set_t *cpuset);
   // Returns CPU mask of CPUs this thread is bound to,
@@ -303,14 +411,28 @@ class WorkerThread {
   //     // work.
   //   } while (IsReadyToRun());
   virtual bool IsReadyToRun(bool *paused = NULL) {
-    return worker_status_->ContinueRunning(paused);
+    if (rate_limiter_)
+      Throttle();
+    bool run = worker_status_->ContinueRunning(paused);
+    while (run && __atomic_load_n(&parked_, __ATOMIC_ACQUIRE)) {
+      sat_usleep(kParkedPollUs);
+      run = worker_status_->ContinueRunning(paused);
+    }
+    return run;
   }
 
   // Like IsReadyToRun(), except it won't pause.
   virtual bool IsReadyToRunNoPause() {
-    return worker_status_->ContinueRunningNoPause();
+    bool run = worker_status_->ContinueRunningNoPause();
+    // Threads draining their pages at the end aren't held back.
+    if (run && rate_limiter_)
+      Throttle();
+    return run;
   }
 
+  // Pass the data moved since the last call to rate_limiter_.
+  void Throttle();
+
   // These are functions used by the various work loops.
   // Pretty print and log a data miscompare.
   virtual void ProcessError(struct ErrorRecord *er,
@@ -318,12 +440,15 @@ class WorkerThread {
                             const char *message);
 
   // Compare a region of memory with a known data patter, and report errors.
+  // If 'mismatch' is given, only the words flagged in that bitmap are
+  // examined on the first pass.
   virtual int CheckRegion(void *addr,
                           class Pattern *pat,
                           uint32 lastcpu,
                           int64 length,
                           int offset,
-                          int64 patternoffset);
+                          int64 patternoffset,
+                          const uint64 *mismatch = NULL);
 
   // Fast compare a block of memory.
   virtual int CrcCheckPage(struct page_entry *srcpe);
@@ -339,6 +464,12 @@ class WorkerThread {
   // Fill a page with its specified pattern.
   virtual bool FillPage(struct page_entry *pe);
 
+  // Make the next reads of 'length' bytes of 'fd' at 'offset' come from
+  // the disk, when it was opened without O_DIRECT. Drops only that range
+  // from the page cache, and falls back to OsLayer::FlushPageCache() if
+  // the kernel keeps it. Returns false on failure.
+  bool BypassPageCache(int fd, int64 offset, int64 length);
+
   // Copy with address tagging.
   virtual bool AdlerAddrMemcpyC(uint64 *dstmem64,
                                 uint64 *srcmem64,
@@ -368,6 +499,13 @@ class WorkerThread {
                        int priority,
                        const char *message);
 
+  // Queue the error to the binary error log, if there is one. Returns
+  // false if the error should be logged as text instead.
+  bool LogBinaryError(uint16 kind, const struct ErrorRecord *error,
+                      const char *message, int core_id,
+                      const char *dimm, const char *tag_dimm,
+                      const char *device);
+
   // A worker thread can yield itself to give up CPU until it's scheduled again
   bool YieldSelf();
 
@@ -375,13 +513,20 @@ class WorkerThread {
   // General state variables that all subclasses need.
   int thread_num_;                  // Thread ID.
   volatile bool status_;            // Error status.
-  volatile int64 pages_copied_;     // Recorded for memory bandwidth calc.
-  volatile int64 errorcount_;       // Miscompares seen by this thread.
+  WorkerStats *stats_;              // Pages copied and errors seen.
 
   cpu_set_t cpu_mask_;              // Cores this thread is allowed to run on.
   volatile uint32 tag_;             // Tag hint for memory this thread can use.
 
   bool tag_mode_;                   // Tag cachelines with vaddr.
+  bool crc32c_;                     // Checksum copies with CRC32C.
+  bool nontemporal_fill_;           // FillPage bypasses the cache.
+  volatile bool parked_;            // Idle until unparked, see set_parked().
+  RateLimiter *rate_limiter_;       // Shared by the type, or NULL.
+  float throttled_data_;            // MB already passed to rate_limiter_.
+
+  bool cached_io_;                  // Opened files without O_DIRECT.
+  bool cache_verified_;             // BypassPageCache() checked eviction.
 
   // Thread timing variables.
   int64 start_time_;                 // Worker thread start time.
@@ -394,6 +539,7 @@ class WorkerThread {
   class Sat *sat_;                  // Reference to parent stest object.
   class OsLayer *os_;               // Os abstraction: put hacks here.
   class PatternList *patternlist_;  // Reference to data patterns.
+  Prng prng_;                       // This thread's random numbers.
 
   // Work around style guide ban on sizeof(int).
   static const uint64 iamint_ = 0;
@@ -418,6 +564,12 @@ class FileThread : public WorkerThread {
     {return GetCopiedData()*2;}
   virtual float GetMemoryCopiedData();
 
+  // Device the file is on.
+  const string &device_name() const { return devicename_; }
+  // Latencies of every page read and write so far. Threadsafe.
+  const LatencyHistogram &read_latency() const { return read_latency_; }
+  const LatencyHistogram &write_latency() const { return write_latency_; }
+
  protected:
   // Record of where these pages were sourced from, and what
   // potentially broken components they passed through.
@@ -450,6 +602,12 @@ class FileThread : public WorkerThread {
   virtual bool SectorValidatePage(const struct PageRec &page,
                                   struct page_entry *dst,
                                   int block);
+  // Validate the sector tags and check the data against its pattern in a
+  // single pass over the page, leaving the tags reverted to the pattern.
+  // Returns the number of data miscompares, like CrcCheckPage().
+  virtual int SectorCheckPage(const struct PageRec &page,
+                              struct page_entry *dst,
+                              int block);
 
   // Get memory for an incoming data transfer..
   virtual bool PagePrepare();
@@ -475,18 +633,113 @@ class FileThread : public WorkerThread {
   void *local_page_;                   // malloc'd page fon non-pool IO.
   int pass_;                            // Number of writes to the file so far.
 
-  // Tag to detect file corruption.
+  int sector_size_;                     // Bytes per tagged sector.
+  LatencyHistogram read_latency_;       // Per page read.
+  LatencyHistogram write_latency_;      // Per page written.
+
+  // Tag at the start of each sector to detect file corruption.
   struct SectorTag {
-    volatile uint8 magic;
-    volatile uint8 block;
-    volatile uint8 sector;
-    volatile uint8 pass;
-    char pad[512-4];
+    uint8 magic;
+    uint8 block;
+    uint8 sector;
+    uint8 pass;
   };
 
+  // Open or create 'path' for I/O, with O_DIRECT if it is supported.
+  bool OpenPath(const string &path, int *pfile);
+  // Returns the logical block size of the device under 'fd', or 512.
+  int LogicalBlockSize(int fd);
+  // The tag that sector 'sec' of page 'block' carries this pass, as the
+  // 32 bit word it occupies in memory.
+  uint32 SectorTagWord(int block, int sec) const;
+  // Log and count a bad tag in sector 'sec' of page 'block'.
+  void SectorTagError(const struct PageRec &page, struct page_entry *dst,
+                      int block, int sec);
+  // Corrupt a tag and a data word of some pages, for error injection.
+  void SectorInjectErrors(struct page_entry *dst);
+  // Report the bad sector range and patch up the data.
+  void SectorRangeError(struct page_entry *dst, int firstsector,
+                        int lastsector);
+
   DISALLOW_COPY_AND_ASSIGN(FileThread);
 };
 
+// File thread that keeps up to a queue depth of reads and writes in flight
+// through io_uring, over several files at once, so that a couple of threads
+// keep a filesystem as busy as one synchronous thread per file would.
+//
+// Data passes through one registered buffer per request, CRC copied from
+// and back into the page pool. Falls back to synchronous I/O through the
+// same buffers if io_uring can't be set up.
+class AsyncFileThread : public FileThread {
+ public:
+  AsyncFileThread();
+  virtual ~AsyncFileThread();
+  // Add a file for this thread to test.
+  virtual void AddFile(const char *filename);
+  // Most requests in flight at a time.
+  void SetQueueDepth(int queue_depth) { queue_depth_ = queue_depth; }
+  virtual bool Work();
+
+  // All data is copied through the buffers.
+  virtual float GetMemoryCopiedData() { return GetCopiedData(); }
+
+ protected:
+  static const int kBufferAlignment = 4096;  // Alignment for O_DIRECT.
+  static const int64 kIoTimeoutUs = 60000000;  // Longest wait for a request.
+
+  // One file under test.
+  struct TestFile {
+    string name;
+    string device;
+    int fd;
+    struct PageRec *recs;          // Where each block came from, and went.
+  };
+
+  // The request using a buffer.
+  struct Slot {
+    int file;                      // Index into files_.
+    int block;
+    bool write;
+    int64 start_time;              // When it was queued, in microseconds.
+  };
+
+  // Create the ring and the buffers.
+  bool SetupBuffers();
+  void TeardownBuffers();
+  // Returns a free buffer, waiting for a request to finish if there are
+  // none.  -1 on failure.
+  int FreeSlot();
+  // Start a read or write of block 'block' of file 'file' with buffer
+  // 'slot'.
+  bool QueueIO(int slot, int file, int block, bool write);
+  // Wait for one request and finish it.  Returns false on an I/O error or
+  // timeout.
+  bool ReapOne();
+  // Wait for all requests in flight.  Returns false if any failed.
+  bool Drain();
+  // Handle a finished request.
+  bool FinishSlot(int slot, int64 result);
+  // Report errors against file 'file'.
+  void SelectFile(int file);
+
+  // Write, then read back and check, every block of every file.
+  bool WriteFiles();
+  bool ReadFiles();
+
+  vector<struct TestFile> files_;
+  int queue_depth_;
+  DiskUring *uring_;               // NULL for synchronous I/O.
+  vector<void*> buffers_;          // A page for each slot.
+  vector<struct Slot> slots_;
+  vector<int> free_slots_;
+  int inflight_;                   // Requests started and not finished.
+  vector<pair<int, int64> > sync_done_;  // Finished synchronous requests.
+  bool abandoned_;                 // Requests were left in flight.
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileThread);
+};
+
 
 // Worker thread to perform Network IO.
 class NetworkThread : public WorkerThread {
@@ -500,6 +753,10 @@ class NetworkThread : public WorkerThread {
   virtual float GetDeviceCopiedData()
     {return GetCopiedData()*2;}
 
+  // Peer address, and the time spent streaming to it once connected.
+  const char *ipaddr() const { return ipaddr_; }
+  int64 stream_usec() const { return stream_usec_; }
+
  protected:
   // IsReadyToRunNoPause() wrapper, for NetworkSlaveThread to override.
   virtual bool IsNetworkStopSet();
@@ -508,8 +765,24 @@ class NetworkThread : public WorkerThread {
   virtual bool Connect(int sock);
   virtual bool SendPage(int sock, struct page_entry *src);
   virtual bool ReceivePage(int sock, struct page_entry *dst);
+  // Turn on MSG_ZEROCOPY sends on the socket if requested and supported.
+  virtual void SetupZeroCopy(int sock);
+  // Wait until the kernel is done with the first 'sent' zero copy sends,
+  // so that their pages can be reused. Returns false if the socket failed.
+  virtual bool WaitZeroCopy(int sock, uint32 sent);
+  // Set up rdma_ over the connected socket, exposing 'length' bytes at
+  // 'exposed' to the peer if not NULL. Returns false on failure.
+  virtual bool ConnectRdma(int sock, void *exposed, uint64 length);
+  // Longest wait for the peer's reply to an RDMA written page.
+  static const int kRdmaReplyMs = 10000;
   char ipaddr_[256];
   int sock_;
+  bool zerocopy_;           // Sends use MSG_ZEROCOPY.
+  uint32 zerocopy_sent_;    // Zero copy sends issued.
+  uint32 zerocopy_done_;    // Zero copy sends the kernel has released.
+  int64 zerocopy_copied_;   // Sends the kernel ended up copying anyway.
+  int64 stream_usec_;       // Time from connecting to the last page.
+  RdmaConnection *rdma_;    // Pages move by RDMA, or NULL.
 
  private:
   DISALLOW_COPY_AND_ASSIGN(NetworkThread);
@@ -527,9 +800,62 @@ class NetworkSlaveThread : public NetworkThread {
   virtual bool IsNetworkStopSet();
 
  private:
+  // Check the pages the peer RDMA writes into a local buffer, until it
+  // closes the socket.
+  bool ReflectRdma(int sock);
+
   DISALLOW_COPY_AND_ASSIGN(NetworkSlaveThread);
 };
 
+// Worker thread to reflect Network IO on many connections at once.
+// Sockets are non-blocking and multiplexed with epoll, each connection
+// receives a whole page and then echoes it back, like NetworkSlaveThread.
+class NetworkEventThread : public NetworkThread {
+ public:
+  NetworkEventThread();
+  virtual ~NetworkEventThread();
+  // Hand a connected socket over to this thread. Threadsafe.
+  virtual void AddSock(int sock);
+  // Finish once all connections are closed. Threadsafe.
+  virtual void Stop();
+  virtual bool Work();
+
+ protected:
+  virtual bool IsNetworkStopSet();
+
+ private:
+  // Events fetched per epoll_wait() call.
+  static const int kMaxEvents = 64;
+  // Milliseconds per epoll_wait() call.
+  static const int kPollTimeout = 100;
+  // Polls without traffic after Stop() before remaining sockets are closed.
+  static const int kStopIdlePolls = 50;
+
+  struct Connection {
+    int sock;
+    char *page;        // Page being reflected.
+    int done;          // Bytes of the page received or sent so far.
+    bool sending;      // Echoing the page back.
+    uint32 events;     // Registered epoll events.
+    int index;         // Position in connections_.
+  };
+
+  // Register sockets handed over with AddSock().
+  bool AddPendingConnections();
+  // Move as much data as the socket allows. Returns false once the
+  // connection is closed or failed.
+  bool Service(Connection *conn);
+  void CloseConnection(Connection *conn);
+
+  int epoll_fd_;
+  pthread_mutex_t pending_lock_;    // Protects pending_socks_.
+  vector<int> pending_socks_;       // Sockets from AddSock().
+  vector<Connection*> connections_;
+  volatile bool stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetworkEventThread);
+};
+
 // Worker thread to detect incoming Network IO.
 class NetworkListenThread : public NetworkThread {
  public:
@@ -541,6 +867,7 @@ class NetworkListenThread : public NetworkThread {
   virtual bool Wait();
   virtual bool GetConnection(int *pnewsock);
   virtual bool SpawnSlave(int newsock, int threadid);
+  virtual bool SpawnEventThreads(int count);
   virtual bool ReapSlaves();
 
   // For serviced incoming connections.
@@ -551,48 +878,153 @@ class NetworkListenThread : public NetworkThread {
   typedef vector<ChildWorker*> ChildVector;
   ChildVector child_workers_;
 
+  // Pool serving all connections with --net_event_threads.
+  struct EventWorker {
+    WorkerStatus status;
+    NetworkEventThread thread;
+  };
+  typedef vector<EventWorker*> EventVector;
+  EventVector event_workers_;
+
   DISALLOW_COPY_AND_ASSIGN(NetworkListenThread);
 };
 
+// Worker thread that coordinates a network test across hosts started with
+// --net_register: it waits for them all to register, hands out their peers,
+// and collects the results of every link once the hosts are done.
+class NetCoordinatorThread : public WorkerThread {
+ public:
+  NetCoordinatorThread(NetCoordinator *coordinator, NetTopology topology,
+                       int hosts);
+  virtual bool Work();
+
+  // Time from the assignment to the hosts streaming, for their listen
+  // threads to come up.
+  static const int kStartDelayMs = 5000;
+  // Time hosts get to report after their run should have ended.
+  static const int kReportGraceSeconds = 120;
+
+ private:
+  static const int kPollMs = 1000;
+
+  NetCoordinator *coordinator_;
+  NetTopology topology_;
+  int hosts_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetCoordinatorThread);
+};
+
+// Memory copy implementations selectable per CopyThread.
+enum CopyEngine {
+  kCopyEngineDefault = 0,       // Checksumming copy, or memcpy with -F.
+  kCopyEngineNonTemporal = 1,   // Streaming stores bypassing the cache.
+  kCopyEnginePrefetch = 2,      // Software prefetch ahead of the loads.
+  kCopyEngineRepMovsb = 3,      // Single rep movsb string move (ERMS).
+  kCopyEngineCount = 4
+};
+
+// Name of a copy engine as used on the command line, and the reverse.
+// CopyEngineFromName returns -1 for unknown names.
+const char *CopyEngineName(int engine);
+int CopyEngineFromName(const char *name);
+
 // Worker thread to perform Memory Copy.
 class CopyThread : public WorkerThread {
  public:
-  CopyThread() {}
+  CopyThread() : engine_(kCopyEngineDefault), prefetch_distance_(512) {}
   virtual bool Work();
   // Calculate worker thread specific bandwidth.
   virtual float GetMemoryCopiedData()
     {return GetCopiedData()*2;}
 
+  // Select how this thread copies pages, see CopyEngine.
+  void set_copy_engine(int engine, int prefetch_distance) {
+    engine_ = engine;
+    prefetch_distance_ = prefetch_distance;
+  }
+  int copy_engine() const { return engine_; }
+
  private:
+  // Copy a page with a non default engine, verifying it in strict mode.
+  int EngineCopyPage(struct page_entry *dstpe, struct page_entry *srcpe);
+
+  int engine_;                    // CopyEngine used for memory copies.
+  int prefetch_distance_;         // Bytes to prefetch ahead of the copy.
   DISALLOW_COPY_AND_ASSIGN(CopyThread);
 };
 
+// How an InvertThread gets its writes out to memory.
+enum InvertFlush {
+  kInvertFlushLine = 0,         // Fenced clflush after every 128 bytes.
+  kInvertFlushBatch = 1,        // clflushopt each line, one fence per 4k.
+  kInvertFlushWriteback = 2,    // clwb each line, one fence per 4k.
+  kInvertFlushNonTemporal = 3,  // Streaming stores, no flush.
+  kInvertFlushCount = 4
+};
+
+// Name of an invert flush policy as used on the command line, and the
+// reverse. InvertFlushFromName returns -1 for unknown names.
+const char *InvertFlushName(int flush);
+int InvertFlushFromName(const char *name);
+
 // Worker thread to perform Memory Invert.
 class InvertThread : public WorkerThread {
  public:
-  InvertThread() {}
+  InvertThread() : flush_(kInvertFlushLine) {}
   virtual bool Work();
   // Calculate worker thread specific bandwidth.
   virtual float GetMemoryCopiedData()
     {return GetCopiedData()*4;}
 
+  // Select how this thread flushes inverted data, see InvertFlush.
+  void set_invert_flush(int flush) { flush_ = flush; }
+  int invert_flush() const { return flush_; }
+
  private:
   virtual int InvertPageUp(struct page_entry *srcpe);
   virtual int InvertPageDown(struct page_entry *srcpe);
+  // Invert one 4k block and flush it with this thread's policy.
+  void InvertBlock(char *block, bool down);
+
+  int flush_;                     // InvertFlush used after each block.
   DISALLOW_COPY_AND_ASSIGN(InvertThread);
 };
 
+// Worker thread that runs a March algorithm over each page it takes. The
+// page's pattern is the background data, so pages go back to the valid
+// queue as they came, and every word is one cell.
+class MarchThread : public WorkerThread {
+ public:
+  explicit MarchThread(const MarchTest *march) : march_(march) {}
+  virtual bool Work();
+  // Each operation touches the whole page once.
+  virtual float GetMemoryCopiedData() {return GetCopiedData();}
+
+ private:
+  // Miscompares reported per page, later ones are only fixed and counted.
+  static const int kErrorLimit = 128;
+
+  // Apply 'element' to every cell of 'pe', 'reported' miscompares in.
+  // Returns the number of miscompares found.
+  int RunElement(struct page_entry *pe, const struct MarchElement &element,
+                 int reported);
+
+  const MarchTest *march_;
+  DISALLOW_COPY_AND_ASSIGN(MarchThread);
+};
+
 // Worker thread to fill blank pages on startup.
 class FillThread : public WorkerThread {
  public:
   FillThread();
-  // Set how many pages this thread should fill before exiting.
-  virtual void SetFillPages(int64 num_pages_to_fill_init);
+  // Set the range of pages this thread should fill before exiting.
+  virtual void SetFillRange(int64 first_page, int64 num_pages);
   virtual bool Work();
 
  private:
   // Fill a page with the data pattern in pe->pattern.
   virtual bool FillPageRandom(struct page_entry *pe);
+  int64 first_page_;
   int64 num_pages_to_fill_;
   DISALLOW_COPY_AND_ASSIGN(FillThread);
 };
@@ -602,17 +1034,146 @@ class FillThread : public WorkerThread {
 // then it will check and discard pages until no more remain.
 class CheckThread : public WorkerThread {
  public:
-  CheckThread() {}
+  CheckThread() : first_page_(0), num_pages_to_check_(0) {}
+  // Set a range of pages to claim and check in order before taking pages
+  // from the queue. Only for queues that keep pages in place.
+  void SetCheckRange(int64 first_page, int64 num_pages);
   virtual bool Work();
   // Calculate worker thread specific bandwidth.
   virtual float GetMemoryCopiedData()
     {return GetCopiedData();}
 
  private:
+  int64 first_page_;
+  int64 num_pages_to_check_;
   DISALLOW_COPY_AND_ASSIGN(CheckThread);
 };
 
 
+// Worker thread to measure memory latency, loaded by whatever bandwidth
+// threads run alongside it. It links the cachelines of a valid page into a
+// random cycle, walks it with dependent loads and shares out the time per
+// load. Links are XORed into pattern words and XORed out again afterwards,
+// so the page keeps its pattern and any corruption for the check threads.
+class LatencyThread : public WorkerThread {
+ public:
+  // Regions tracked, one per region tag bit plus one for untagged pages.
+  static const int kRegions = 33;
+  // Histogram buckets of kBucketNs each, the last one collects the rest.
+  static const int kBuckets = 128;
+  static const int kBucketNs = 8;
+
+  LatencyThread();
+  virtual bool Work();
+
+  // Walks recorded for 'region' in each ns per access bucket.
+  const uint64 *histogram(int region) const { return histogram_[region]; }
+
+ private:
+  // Shuffle next_ into a new cycle through all lines of a page.
+  void ShuffleChain(int lines);
+  // XOR the link of every line of 'pe' into or out of its pattern word.
+  void ApplyChain(struct page_entry *pe, int lines);
+  // Walk the chain of 'pe'. Returns false if it's broken.
+  bool WalkChain(struct page_entry *pe, int lines, int64 *ns);
+
+  vector<uint32> next_;             // Line following each line in the chain.
+  uint64 seed_;                     // State of the shuffle.
+  uint64 histogram_[kRegions][kBuckets];
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyThread);
+};
+
+// Worker thread that hammers the rows on both sides of a DRAM row with
+// uncached reads, then checks the pages holding them. Adjacent rows come
+// from the physical addresses of the pages it holds and Sat's DramMap.
+class RowhammerThread : public WorkerThread {
+ public:
+  // Pages held and searched for adjacent rows at a time.
+  static const int kHammerPages = 4;
+
+  RowhammerThread() {}
+  virtual bool Work();
+
+ private:
+  // A cacheline of a held page.
+  struct Line {
+    uint32 bank;
+    uint64 row;
+    char *addr;
+  };
+  // Orders lines by bank, then row.
+  static bool LineBefore(const struct Line &a, const struct Line &b) {
+    if (a.bank != b.bank)
+      return a.bank < b.bank;
+    return a.row < b.row;
+  }
+  static bool SameRow(const struct Line &a, const struct Line &b) {
+    return a.bank == b.bank && a.row == b.row;
+  }
+
+  // Fill lines_ with one cacheline of each bank and row in 'pages'.
+  void MapLines(struct page_entry *pages, int count);
+  // Hammer both neighbours of every row in lines_ that has them. Returns
+  // the number of rows hammered.
+  int HammerRows();
+  // Read 'a' and 'b' 'count' times each, flushing them after every read
+  // so each read opens its row again.
+  void Hammer(char *a, char *b, int count);
+
+  vector<struct Line> lines_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowhammerThread);
+};
+
+// Worker thread that loads the page walkers. It maps 'size' bytes of its
+// own with small pages, touches one cacheline of each page in a random
+// order so that nearly every access misses the TLB, and checks what it
+// read against a pattern keyed by the page.
+class TlbThread : public WorkerThread {
+ public:
+  // Lines timed together, their average goes in the histogram buckets
+  // of LatencyThread.
+  static const int kBatchLines = 64;
+
+  explicit TlbThread(int64 size);
+  virtual ~TlbThread();
+  virtual bool Work();
+  // Data is the lines touched, not whole pages.
+  virtual float GetCopiedData() {
+    return lines_ * kCacheLineSize * 1.0 / kMegabyte;
+  }
+  virtual float GetMemoryCopiedData() { return GetCopiedData(); }
+
+  int64 size() const { return size_; }
+  // Batches in each ns per line bucket.
+  const uint64 *histogram() const { return histogram_; }
+
+ private:
+  // Shuffle order_ into a new permutation of the pages.
+  void ShufflePages();
+  // Expected word 'word' of the line touched in 'page' this pass.
+  uint64 Expected(uint64 page, int word) const;
+  char *Line(uint64 page) const;
+  // Write the touched line of every page, in order_.
+  void WriteLines();
+  // Check the touched line of every page, in order_. Returns the number
+  // of miscompares, or -1 if the pass was cut short.
+  int64 CheckLines();
+
+  int64 size_;                      // Bytes mapped.
+  int64 page_size_;                 // Bytes per small page.
+  char *mem_;                       // The mapping, or NULL.
+  vector<uint32> order_;            // Pages in the order touched.
+  class Pattern *pattern_;          // Data of this pass.
+  uint64 pass_;                     // Passes started.
+  int64 lines_;                     // Lines written and checked.
+  uint64 histogram_[LatencyThread::kBuckets];
+
+  DISALLOW_COPY_AND_ASSIGN(TlbThread);
+};
+
+
 // Worker thread to poll for system error messages.
 // Thread will check for messages until "done" flag is set.
 class ErrorPollThread : public WorkerThread {
@@ -627,13 +1188,61 @@ class ErrorPollThread : public WorkerThread {
 // Computation intensive worker thread to stress CPU.
 class CpuStressThread : public WorkerThread {
  public:
-  CpuStressThread() {}
+  CpuStressThread() : kernel_name_("float") {}
   virtual bool Work();
 
+  // Run the self-checking kernels named 'name' (see CpuKernel::Create)
+  // instead of OsLayer::CpuStressWorkload().
+  void set_kernel(const string &name) { kernel_name_ = name; }
+
  private:
+  // Time on one kernel before moving to the next, in us.
+  static const int64 kKernelSliceUs = 1000000;
+
+  // Run 'kernels' in turn until the test ends.
+  void RunKernels(const vector<class CpuKernel*> &kernels);
+
+  string kernel_name_;
+
   DISALLOW_COPY_AND_ASSIGN(CpuStressThread);
 };
 
+// Worker thread that loads its cpu when a PowerWave says so and idles
+// otherwise. All of them switch on the same clock edges, for load steps
+// sharp enough to test voltage regulator transient response.
+class PowerWaveThread : public WorkerThread {
+ public:
+  explicit PowerWaveThread(const class PowerWave *wave);
+  virtual bool Work();
+
+  // Edges and how late this thread started loading after them.
+  int64 edges() const { return edges_; }
+  int64 late_edges() const { return late_edges_; }
+  int64 max_late_ns() const { return max_late_ns_; }
+
+  // Edges started later than this count as late.
+  static const int64 kLateNs = 10000;
+
+ private:
+  // Sleep until this long before an edge, then spin to it.
+  static const int64 kSpinAheadNs = 200000;
+  // Check for the end of the test at least this often.
+  static const int64 kCheckNs = 10000000;
+
+  // Keep the cpu busy until 'until_ns'.
+  void Load(int64 until_ns);
+  // Idle until 'until_ns'.
+  void Idle(int64 until_ns);
+
+  const class PowerWave *wave_;
+  int64 edges_;
+  int64 late_edges_;
+  int64 max_late_ns_;
+  double sink_;                     // Keeps the load from being optimized out.
+
+  DISALLOW_COPY_AND_ASSIGN(PowerWaveThread);
+};
+
 // Worker thread that tests the correctness of the
 // CPU Cache Coherency Protocol.
 class CpuCacheCoherencyThread : public WorkerThread {
@@ -645,6 +1254,18 @@ class CpuCacheCoherencyThread : public WorkerThread {
                           int cc_inc_count_);
   virtual bool Work();
 
+  // Bounce a cacheline between thread pairs by 'schedule' instead of
+  // incrementing random lines.
+  void set_pair_schedule(struct cc_pair_schedule *schedule) {
+    cc_pairs_ = schedule;
+  }
+  // Lay each line's counters out 'threads_per_line' to a run of 'stride'
+  // bytes, instead of all of them side by side.
+  void set_line_layout(int threads_per_line, int stride) {
+    cc_threads_per_line_ = threads_per_line;
+    cc_line_stride_ = stride;
+  }
+
  protected:
   // Used by the simple random number generator as a shift feedback;
   // this polynomial (x^64 + x^63 + x^61 + x^60 + 1) will produce a
@@ -663,8 +1284,29 @@ class CpuCacheCoherencyThread : public WorkerThread {
   int cc_thread_count_;     // Total number of threads being run, for
                             // calculations mixing up cache line access.
   int cc_inc_count_;        // Number of times to increment the counter.
+                            // Round trips per turn in pair mode.
+  struct cc_pair_schedule *cc_pairs_;  // Pair mode schedule, or NULL.
+  int cc_threads_per_line_;  // Counters sharing each run of bytes, or 0.
+  int cc_line_stride_;       // Bytes from one run to the next.
 
  private:
+  // Byte of the counter of thread 'offset' in each line's num array.
+  int CounterIndex(int offset) const {
+    if (!cc_threads_per_line_)
+      return offset;
+    return offset / cc_threads_per_line_ * cc_line_stride_ +
+           offset % cc_threads_per_line_;
+  }
+  // Work() in pair mode.
+  bool PairWork();
+  // Take part in 'turn' of the pair schedule. Returns false if the test
+  // stopped meanwhile.
+  bool PairTurn(int64 turn, bool first);
+  // Spin until the bounced line holds 'value'. Returns false if the test
+  // stopped or 'turn' is over, and if 'stall' isn't NULL sets it when the
+  // partner didn't answer for too long.
+  bool PairWait(int64 turn, uint64 value, bool *stall);
+
   DISALLOW_COPY_AND_ASSIGN(CpuCacheCoherencyThread);
 };
 
@@ -690,10 +1332,37 @@ class DiskThread : public WorkerThread {
                              int64 write_threshold,
                              int non_destructive);
 
+  // Asynchronous I/O engines for disk threads.
+  enum IoEngine {
+    kIoEngineAio = 0,      // Linux native AIO, one request at a time.
+    kIoEngineUring = 1     // io_uring, up to the queue depth in flight.
+  };
+  static const int kMaxQueueDepth = 4096;   // Largest io_uring queue depth.
+
+  // Select the I/O engine, how many requests io_uring keeps in flight,
+  // and whether writes and verification overlap in a pipeline.
+  virtual bool SetIoEngine(int engine, int queue_depth, bool pipelined);
+
   virtual bool Work();
 
   virtual float GetMemoryCopiedData() {return 0;}
 
+  const string &device_name() const { return device_name_; }
+  int queue_depth() const { return queue_depth_; }
+  // Whether the thread asked for io_uring, which active_depth() applies to.
+  bool uses_uring() const { return io_engine_ == kIoEngineUring; }
+  // io_uring requests kept in flight, from 1 to queue_depth(). Threadsafe,
+  // the thread picks up a new depth with its next batch.
+  int active_depth() const { return active_depth_; }
+  void set_active_depth(int depth) {
+    active_depth_ = depth < 1 ? 1 : (depth > queue_depth_ ? queue_depth_ :
+                                     depth);
+  }
+
+  // Latencies of every block read and write so far. Threadsafe.
+  const LatencyHistogram &read_latency() const { return read_latency_; }
+  const LatencyHistogram &write_latency() const { return write_latency_; }
+
  protected:
   static const int kSectorSize = 512;       // Size of sector on disk.
   static const int kBufferAlignment = 512;  // Buffer alignment required by the
@@ -719,12 +1388,71 @@ class DiskThread : public WorkerThread {
   virtual bool AsyncDiskIO(IoOp op, int fd, void *buf, int64 size,
                            int64 offset, int64 timeout);
 
+  // Log and count a failed or short transfer at byte 'offset'.
+  virtual void ReportIoError(IoOp op, int64 result, int64 offset);
+
+  // Fill 'buffer' with data for 'block', and record the pattern used.
+  virtual void FillBlockBuffer(BlockData *block, void *buffer);
+  // Returns the pattern 'block' was filled with, or NULL.
+  class Pattern *BlockPattern(const BlockData *block);
+
   // Write a block to disk.
   virtual bool WriteBlockToDisk(int fd, BlockData *block);
 
   // Verify a block on disk.
   virtual bool ValidateBlockOnDisk(int fd, BlockData *block);
 
+  // Write or verify 'count' blocks at once, with all their requests in
+  // flight together. Only used with io_uring.
+  virtual bool WriteBlocksToDisk(int fd, BlockData **blocks, int count);
+  virtual bool ValidateBlocksOnDisk(int fd, BlockData **blocks, int count);
+
+  // Write the blocks collected in 'batch' and queue them for verification.
+  bool FlushWriteBatch(int fd, vector<BlockData*> *batch);
+
+  // Requests for one buffer slot, while they are in flight on io_uring.
+  struct UringSlot {
+    IoOp op;           // Whether the slot's block is written or verified.
+    BlockData *block;  // Block being transferred, NULL for AsyncDiskIO.
+    int64 offset;      // Byte offset on disk of the slot's first request.
+    int pending;       // Requests not completed yet.
+    bool failed;       // Some request failed.
+    int64 start_time;  // When the requests were queued.
+    int64 end_time;    // When the last request completed.
+  };
+
+  // Create the io_uring and its buffers, falling back to libaio if the
+  // kernel doesn't support it. Returns false on memory allocation failure.
+  bool SetupUring();
+  void TeardownUring();
+
+  // Pass queued requests to the kernel.
+  bool UringSubmit();
+  // Queue a request for 'slots[slot]', first reaping completions if the
+  // queue depth is reached.
+  bool UringQueue(int fd, void *buf, int64 size, int64 offset,
+                  int buffer_index, int slot, UringSlot *slots);
+  // Submit queued requests and wait until none are in flight.
+  bool UringFlush(UringSlot *slots);
+  // Wait for one completion and account it to its slot.
+  bool UringReap(UringSlot *slots, int64 timeout);
+  // One synchronous request through io_uring, for AsyncDiskIO.
+  bool UringDiskIO(IoOp op, int fd, void *buf, int64 size, int64 offset);
+  // Queue the write or the verifying reads of a block in a buffer slot.
+  bool UringQueueWrite(int fd, int index, BlockData *block,
+                       UringSlot *slots);
+  bool UringQueueVerify(int fd, int index, BlockData *block,
+                        UringSlot *slots);
+  // Check the outcome of a slot whose requests all completed.
+  bool UringFinishSlot(UringSlot *slots, int index);
+
+  // Pipelined main work loop, used with io_uring and --disk_pipeline.
+  virtual bool DoPipelinedWork(int fd);
+  bool FinishPipelinedSlot(UringSlot *slots, int index);
+
+  // Number of segments the disk is split into.
+  int64 NumSegments();
+
   // Main work loop.
   virtual bool DoWork(int fd);
 
@@ -770,6 +1498,19 @@ class DiskThread : public WorkerThread {
   io_context_t aio_ctx_;     // Asynchronous I/O context for Linux native AIO.
 #endif
 
+  int io_engine_;             // IoEngine requested for this thread.
+  int queue_depth_;           // Maximum io_uring requests in flight.
+  volatile int active_depth_;  // Requests to keep in flight, see
+                               // set_active_depth().
+  LatencyHistogram read_latency_;   // Per read request.
+  LatencyHistogram write_latency_;  // Per written block.
+  bool pipelined_;            // Overlap writes with verification.
+  DiskUring *uring_;          // io_uring in use, NULL when using libaio.
+  vector<void*> slot_buffers_;  // Per-request block buffers for io_uring.
+  int uring_inflight_;        // Requests queued or in flight on uring_.
+  bool uring_abandoned_;      // Requests were left in flight on a timeout.
+  vector<int> uring_done_;    // Slots whose requests all completed.
+
   DiskBlockTable *block_table_;  // Disk Block Table, shared by all disk
                                  // threads that read / write at the same
                                  // device
@@ -804,22 +1545,46 @@ class MemoryRegionThread : public WorkerThread {
   void SetIdentifier(string identifier) {
     identifier_ = identifier;
   }
+  const string &identifier() const { return identifier_; }
+  // Access the region only with loads and stores of 'width' bytes, 1, 2,
+  // 4 or 8, or 0 for the normal copy and check routines.
+  void set_access_width(int width) { access_width_ = width; }
 
  protected:
+  // Copy 'srcpe' into 'dstpe' in the region with access_width_ stores.
+  void WidthCopyPage(struct page_entry *dstpe, struct page_entry *srcpe);
+  // Compare 'regionpe' with 'srcpe' using access_width_ loads, reporting
+  // each difference. Returns the number of differences.
+  int WidthCheckPage(struct page_entry *regionpe, struct page_entry *srcpe);
+
   // Page queue for this particular memory region.
   char *region_;
   PageEntryQueue *pages_;
   bool error_injection_;
   int phase_;
   string identifier_;
+  int access_width_;
   static const int kPhaseNoPhase = 0;
   static const int kPhaseCopy = 1;
   static const int kPhaseCheck = 2;
+  // Miscompares WidthCheckPage() reports per page, the rest are counted.
+  static const int kErrorLimit = 128;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(MemoryRegionThread);
 };
 
+// Power and frequency of the cpus over one CpuFreqThread interval.
+struct PowerSample {
+  double seconds;             // Length of the interval.
+  double package_watts;       // All packages, 0 without RAPL.
+  double dram_watts;          // All DRAM domains, 0 if not counted.
+  int min_mhz;
+  int max_mhz;
+  double avg_mhz;
+  int throttled_cpus;         // Cpus well below their best frequency.
+};
+
 // Worker thread to check that the frequency of every cpu does not go below a
 // certain threshold.
 class CpuFreqThread : public WorkerThread {
@@ -834,6 +1599,16 @@ class CpuFreqThread : public WorkerThread {
   // returns false.
   static bool CanRun();
 
+  // Copy the last interval's sample. Returns false until there is one.
+  // Threadsafe.
+  bool LastSample(struct PowerSample *sample);
+  // Energy in joules of all intervals so far, and their total length.
+  // Threadsafe.
+  void TotalEnergy(double *package_joules, double *dram_joules,
+                   double *seconds);
+  // Returns true if the RAPL energy counters can be read.
+  bool has_energy() const { return !packages_.empty(); }
+
  private:
   static const int kIntervalPause = 10;   // The number of seconds to pause
                                           // between acquiring the MSR data.
@@ -842,6 +1617,14 @@ class CpuFreqThread : public WorkerThread {
   static const int kMsrTscAddr = 0x10;    // The address of the TSC MSR.
   static const int kMsrAperfAddr = 0xE8;  // The address of the APERF MSR.
   static const int kMsrMperfAddr = 0xE7;  // The address of the MPERF MSR.
+  // RAPL energy units and counters, Intel and AMD.
+  static const uint32 kMsrRaplUnitAddr = 0x606;
+  static const uint32 kMsrPkgEnergyAddr = 0x611;
+  static const uint32 kMsrDramEnergyAddr = 0x619;
+  static const uint32 kMsrAmdRaplUnitAddr = 0xC0010299;
+  static const uint32 kMsrAmdPkgEnergyAddr = 0xC001029B;
+  // A cpu below this percentage of its best frequency is throttled.
+  static const int kThrottlePercent = 90;
 
   // The index values into the CpuDataType.msr[] array.
   enum MsrValues {
@@ -864,6 +1647,15 @@ class CpuFreqThread : public WorkerThread {
   // The set of MSR addresses and register names.
   static const CpuRegisterType kCpuRegisters[kMsrLast];
 
+  // The energy counters of one package, read on one of its cpus.
+  typedef struct {
+    int cpu;
+    double unit;            // Joules per package count.
+    double dram_unit;       // Joules per DRAM count, 0 if not counted.
+    uint32 package_last;    // Previous counter values, they wrap.
+    uint32 dram_last;
+  } RaplPackageType;
+
   // Compute the change in values of the MSRs between current and previous,
   // set the frequency in MHz of the cpu. If there is an error computing
   // the delta, return false. Othewise, return true.
@@ -881,6 +1673,18 @@ class CpuFreqThread : public WorkerThread {
   bool ComputeDelta(CpuDataType *current, CpuDataType *previous,
                     CpuDataType *delta);
 
+  // Find one cpu per package in 'cpuset' whose energy counters can be
+  // read, and the units of those counters.
+  void FindPackages(const cpu_set_t &cpuset);
+
+  // Add up the energy in joules used by all packages since the last call.
+  // Returns false if a counter couldn't be read.
+  bool ReadEnergy(double *package_joules, double *dram_joules);
+
+  // Record the frequencies and energy of one interval of 'seconds'.
+  void AddSample(const vector<int> &mhz, double package_joules,
+                 double dram_joules, double seconds);
+
   // The total number of cpus on the system.
   int num_cpus_;
 
@@ -893,6 +1697,18 @@ class CpuFreqThread : public WorkerThread {
   // Precomputed value to add to the frequency to do the rounding.
   double round_value_;
 
+  vector<RaplPackageType> packages_;
+  uint32 package_energy_addr_;    // Intel or AMD package counter.
+  vector<int> best_mhz_;          // Highest frequency seen on each cpu.
+  vector<bool> throttled_;        // Cpu was throttled last interval.
+
+  pthread_mutex_t sample_lock_;   // Guards the fields below.
+  bool have_sample_;
+  struct PowerSample sample_;     // The last interval.
+  double total_package_joules_;
+  double total_dram_joules_;
+  double total_seconds_;
+
   DISALLOW_COPY_AND_ASSIGN(CpuFreqThread);
 };
 
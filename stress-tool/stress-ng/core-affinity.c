@@ -62,9 +62,373 @@ static int stress_parse_cpu(char *const str)
 	return val;
 }
 
+#define PLACE_SPREAD	(1)	/* one instance per core, then SMT siblings */
+#define PLACE_PACK	(2)	/* fill each last level cache in turn */
+#define PLACE_NUMA	(3)	/* one instance per NUMA node */
+#define PLACE_SMT	(4)	/* pairs of instances on SMT siblings */
+
+typedef struct {
+	const char *name;	/* --taskset strategy name */
+	const int strategy;	/* PLACE_* strategy */
+} stress_placement_t;
+
+static const stress_placement_t placements[] = {
+	{ "spread",	PLACE_SPREAD },
+	{ "pack",	PLACE_PACK },
+	{ "numa",	PLACE_NUMA },
+	{ "smt",	PLACE_SMT },
+};
+
+/* Topology of one CPU, read from /sys */
+typedef struct {
+	int32_t cpu;		/* CPU number */
+	int32_t package;	/* physical package id */
+	int32_t core;		/* core id within the package */
+	int32_t thread;		/* index of the CPU amongst its SMT siblings */
+	int32_t llc;		/* lowest CPU sharing the last level cache */
+	int32_t node;		/* NUMA node */
+} stress_cpu_topology_t;
+
+static cpu_set_t *place_masks;		/* affinity of each placement slot */
+static int32_t place_slots;		/* number of placement slots */
+static int place_strategy;
+
+/*
+ * stress_topology_read_int()
+ *	read an integer from a cpu sysfs topology file, default
+ *	to dflt if it can't be read
+ */
+static int32_t stress_topology_read_int(
+	const int32_t cpu,
+	const char *file,
+	const int32_t dflt)
+{
+	char path[PATH_MAX], buf[32];
+	int val;
+
+	(void)snprintf(path, sizeof(path),
+		"/sys/devices/system/cpu/cpu%" PRId32 "/%s", cpu, file);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return dflt;
+	buf[sizeof(buf) - 1] = '\0';
+	if (sscanf(buf, "%d", &val) != 1)
+		return dflt;
+	return (int32_t)val;
+}
+
+/*
+ * stress_topology_read_list()
+ *	read a sysfs CPU list such as 0-3,8-11 into set, returns
+ *	the number of CPUs in the set
+ */
+int stress_topology_read_list(const char *path, cpu_set_t *set)
+{
+	char buf[4096], *ptr = buf;
+	ssize_t ret;
+
+	CPU_ZERO(set);
+	ret = system_read(path, buf, sizeof(buf) - 1);
+	if (ret <= 0)
+		return 0;
+	buf[ret] = '\0';
+
+	while (*ptr) {
+		int lo, hi, i, n = 0;
+
+		if (sscanf(ptr, "%d%n", &lo, &n) != 1)
+			break;
+		ptr += n;
+		hi = lo;
+		if ((*ptr == '-') && (sscanf(ptr + 1, "%d%n", &hi, &n) == 1))
+			ptr += n + 1;
+		for (i = lo; (i <= hi) && (i < CPU_SETSIZE); i++)
+			CPU_SET(i, set);
+		if (*ptr != ',')
+			break;
+		ptr++;
+	}
+	return CPU_COUNT(set);
+}
+
+/*
+ * stress_topology_llc_list()
+ *	fill set with the CPUs that share the highest level cache
+ *	with cpu, returns the number of CPUs in the set
+ */
+int stress_topology_llc_list(const int32_t cpu, cpu_set_t *set)
+{
+	int32_t i, level_max = -1;
+	int n = 0;
+
+	CPU_ZERO(set);
+	for (i = 0; i < 16; i++) {
+		char file[64], path[PATH_MAX];
+		cpu_set_t shared;
+		int32_t level;
+		int count;
+
+		(void)snprintf(file, sizeof(file), "cache/index%" PRId32 "/level", i);
+		level = stress_topology_read_int(cpu, file, -1);
+		if (level < 0)
+			break;
+		if (level <= level_max)
+			continue;
+		(void)snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/cache/index%" PRId32 "/shared_cpu_list", cpu, i);
+		count = stress_topology_read_list(path, &shared);
+		if (!count)
+			continue;
+		level_max = level;
+		(void)memcpy(set, &shared, sizeof(*set));
+		n = count;
+	}
+	return n;
+}
+
+/*
+ * stress_topology_llc()
+ *	find the lowest CPU that shares the highest level cache
+ *	with cpu
+ */
+static int32_t stress_topology_llc(const int32_t cpu)
+{
+	cpu_set_t set;
+	int32_t j;
+
+	if (!stress_topology_llc_list(cpu, &set))
+		return cpu;
+	for (j = 0; j < CPU_SETSIZE; j++) {
+		if (CPU_ISSET(j, &set))
+			break;
+	}
+	return j;
+}
+
+/*
+ * stress_topology_package()
+ *	find the physical package (socket) of cpu, 0 if unknown
+ */
+int32_t stress_topology_package(const int32_t cpu)
+{
+	const int32_t package = stress_topology_read_int(cpu, "topology/physical_package_id", 0);
+
+	return (package < 0) ? 0 : package;
+}
+
+/*
+ * stress_topology_node()
+ *	find the NUMA node of cpu, 0 if there is no NUMA
+ */
+static int32_t stress_topology_node(const int32_t cpu)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *d;
+	int32_t node = 0;
+
+	(void)snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%" PRId32, cpu);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while ((d = readdir(dir)) != NULL) {
+		int val;
+
+		if (sscanf(d->d_name, "node%d", &val) == 1) {
+			node = (int32_t)val;
+			break;
+		}
+	}
+	(void)closedir(dir);
+	return node;
+}
+
+/*
+ * stress_topology_cmp()
+ *	order CPUs for the current placement strategy
+ */
+static int stress_topology_cmp(const void *p1, const void *p2)
+{
+	const stress_cpu_topology_t *t1 = (const stress_cpu_topology_t *)p1;
+	const stress_cpu_topology_t *t2 = (const stress_cpu_topology_t *)p2;
+	int32_t k1[4], k2[4];
+	size_t i;
+
+	switch (place_strategy) {
+	case PLACE_SPREAD:
+		/* First thread of every core, interleaving packages */
+		k1[0] = t1->thread;	k2[0] = t2->thread;
+		k1[1] = t1->core;	k2[1] = t2->core;
+		k1[2] = t1->package;	k2[2] = t2->package;
+		break;
+	case PLACE_PACK:
+		/* Fill an LLC, one thread per core, before the next */
+		k1[0] = t1->llc;	k2[0] = t2->llc;
+		k1[1] = t1->thread;	k2[1] = t2->thread;
+		k1[2] = t1->core;	k2[2] = t2->core;
+		break;
+	case PLACE_NUMA:
+		k1[0] = t1->node;	k2[0] = t2->node;
+		k1[1] = 0;		k2[1] = 0;
+		k1[2] = 0;		k2[2] = 0;
+		break;
+	default:
+		/* SMT siblings next to each other */
+		k1[0] = t1->package;	k2[0] = t2->package;
+		k1[1] = t1->core;	k2[1] = t2->core;
+		k1[2] = t1->thread;	k2[2] = t2->thread;
+		break;
+	}
+	k1[3] = t1->cpu;
+	k2[3] = t2->cpu;
+
+	for (i = 0; i < SIZEOF_ARRAY(k1); i++) {
+		if (k1[i] != k2[i])
+			return (k1[i] < k2[i]) ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * stress_set_cpu_placement()
+ *	build the placement slots for strategy from the topology
+ *	of the CPUs stress-ng is allowed to run on
+ */
+static int stress_set_cpu_placement(const int strategy)
+{
+	cpu_set_t allowed;
+	stress_cpu_topology_t *topo;
+	int32_t i, n = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_err("%s: cannot get CPU affinity, errno=%d (%s)\n",
+			option, errno, strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+	topo = calloc((size_t)CPU_COUNT(&allowed), sizeof(*topo));
+	place_masks = calloc((size_t)CPU_COUNT(&allowed), sizeof(*place_masks));
+	if (!topo || !place_masks) {
+		(void)fprintf(stderr, "%s: out of memory allocating CPU placement\n", option);
+		_exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		char path[PATH_MAX];
+		cpu_set_t siblings;
+		int32_t j;
+
+		if (!CPU_ISSET(i, &allowed))
+			continue;
+		topo[n].cpu = i;
+		topo[n].package = stress_topology_package(i);
+		topo[n].core = stress_topology_read_int(i, "topology/core_id", i);
+		topo[n].llc = stress_topology_llc(i);
+		topo[n].node = stress_topology_node(i);
+		topo[n].thread = 0;
+		(void)snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/topology/thread_siblings_list", i);
+		if (stress_topology_read_list(path, &siblings)) {
+			for (j = 0; j < i; j++) {
+				if (CPU_ISSET(j, &siblings))
+					topo[n].thread++;
+			}
+		}
+		n++;
+	}
+
+	place_strategy = strategy;
+	qsort(topo, (size_t)n, sizeof(*topo), stress_topology_cmp);
+
+	place_slots = 0;
+	for (i = 0; i < n; i++) {
+		if (strategy == PLACE_NUMA) {
+			/* One slot spanning all the allowed CPUs of a node */
+			if ((i > 0) && (topo[i].node == topo[i - 1].node)) {
+				CPU_SET(topo[i].cpu, &place_masks[place_slots - 1]);
+				continue;
+			}
+		}
+		CPU_ZERO(&place_masks[place_slots]);
+		CPU_SET(topo[i].cpu, &place_masks[place_slots]);
+		place_slots++;
+	}
+	pr_dbg("%s: %s placement over %" PRId32 " slots\n", option,
+		placements[strategy - 1].name, place_slots);
+	free(topo);
+
+	return 0;
+}
+
+/*
+ * stress_cpus_interleave_packages()
+ *	fill cpus with up to max of the CPUs in mask, interleaved
+ *	over the physical packages so that successive entries are on
+ *	different sockets, returns the number of CPUs filled in
+ */
+int32_t stress_cpus_interleave_packages(
+	const cpu_set_t *mask,
+	int32_t *cpus,
+	const int32_t max)
+{
+	int32_t *package, *order;
+	int32_t i, n = 0, m = 0, packages = 0;
+
+	package = calloc((size_t)max, sizeof(*package));
+	order = calloc((size_t)max, sizeof(*order));
+	if (!package || !order)
+		goto out;
+
+	for (i = 0; (i < CPU_SETSIZE) && (n < max); i++) {
+		if (!CPU_ISSET(i, mask))
+			continue;
+		package[n] = stress_topology_package(i);
+		if (package[n] >= packages)
+			packages = package[n] + 1;
+		cpus[n++] = i;
+	}
+
+	/* Take the next CPU from each package in turn */
+	while (m < n) {
+		int32_t p;
+
+		for (p = 0; p < packages; p++) {
+			for (i = 0; i < n; i++) {
+				if (package[i] == p) {
+					package[i] = -1;
+					order[m++] = cpus[i];
+					break;
+				}
+			}
+		}
+	}
+	(void)memcpy(cpus, order, (size_t)n * sizeof(*cpus));
+out:
+	free(order);
+	free(package);
+	return n;
+}
+
+/*
+ * stress_set_instance_affinity()
+ *	bind the calling process or thread, running the given
+ *	instance of a stressor, to its placement slot
+ */
+void stress_set_instance_affinity(const uint32_t instance)
+{
+	cpu_set_t *mask;
+
+	if (!place_slots)
+		return;
+	mask = &place_masks[instance % (uint32_t)place_slots];
+	if (sched_setaffinity(0, sizeof(*mask), mask) < 0)
+		pr_dbg("%s: cannot set CPU affinity of instance %" PRIu32
+			", errno=%d (%s)\n", option, instance,
+			errno, strerror(errno));
+}
+
 /*
  * stress_set_cpu_affinity()
- * @arg: list of CPUs to set affinity to, comma separated
+ * @arg: list of CPUs to set affinity to, comma separated,
+ *	 or a placement strategy
  *
  * Returns: 0 - OK
  */
@@ -73,6 +437,12 @@ int stress_set_cpu_affinity(const char *arg)
 	cpu_set_t set;
 	char *str, *ptr, *token;
 	const int32_t max_cpus = stress_get_processors_configured();
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(placements); i++) {
+		if (!strcmp(arg, placements[i].name))
+			return stress_set_cpu_placement(placements[i].strategy);
+	}
 
 	CPU_ZERO(&set);
 
@@ -123,6 +493,11 @@ int stress_set_cpu_affinity(const char *arg)
 }
 
 #else
+void stress_set_instance_affinity(const uint32_t instance)
+{
+	(void)instance;
+}
+
 int stress_set_cpu_affinity(const char *arg)
 {
 	(void)arg;
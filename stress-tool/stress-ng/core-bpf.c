@@ -0,0 +1,976 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_LINUX_BPF_H)
+#include <linux/bpf.h>
+#endif
+
+#define BPF_GROUPS		(256)	/* stressors that can be told apart */
+#define BPF_METRICS		(4)
+#define BPF_SLOTS		(128)	/* histogram buckets + sum per metric */
+#define BPF_BUCKETS		(126)	/* 2 buckets per power of 2 nanoseconds */
+#define BPF_SUM_SLOT		(127)	/* total nanoseconds of a metric */
+#define BPF_TASKS		(65536)	/* tracked threads and pending events */
+
+#define BPF_METRIC_SCHED	(0)	/* runnable to running delay */
+#define BPF_METRIC_FAULT	(1)	/* user page faults, count only */
+#define BPF_METRIC_BLOCK	(2)	/* block request issue to complete */
+#define BPF_METRIC_SYSCALL	(3)	/* system call enter to exit */
+
+static bool bpf_enabled = false;
+static int32_t bpf_period = 0;
+
+/*
+ *  stress_set_bpf()
+ *	collect per stressor latencies with in-kernel BPF programs
+ */
+int stress_set_bpf(const char *const opt)
+{
+	(void)opt;
+
+	bpf_enabled = true;
+	return 0;
+}
+
+/*
+ *  stress_set_bpf_period()
+ *	also report the latencies of the last period every N seconds
+ */
+int stress_set_bpf_period(const char *const opt)
+{
+	bpf_period = stress_get_int32(opt);
+	if ((bpf_period < 1) || (bpf_period > 3600)) {
+		(void)fprintf(stderr, "bpf-period must in the range 1 to 3600.\n");
+		_exit(EXIT_FAILURE);
+	}
+	bpf_enabled = true;
+	return 0;
+}
+
+#if defined(__linux__) &&			\
+    defined(HAVE_LINUX_BPF_H) &&		\
+    defined(__NR_bpf) &&			\
+    defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&		\
+    defined(BPF_PSEUDO_MAP_FD) &&		\
+    defined(BPF_XADD)
+
+#define BPF_INSNS		(256)
+#define BPF_LABELS		(4)
+#define BPF_FIXUPS		(16)
+
+#define BPF_LABEL_OUT		(0)
+#define BPF_LABEL_NEXT		(1)
+
+#define BPF_MAP_GROUPS		(0)	/* tid -> group of the thread */
+#define BPF_MAP_STARTS		(1)	/* pending event -> start time, group */
+#define BPF_MAP_HIST		(2)	/* group, metric, bucket -> count */
+#define BPF_MAPS		(3)
+
+/* A hand assembled BPF program, jumps to labels are patched at the end */
+typedef struct {
+	struct bpf_insn insn[BPF_INSNS];
+	int label[BPF_LABELS];
+	struct {
+		int pos;
+		int label;
+	} fixup[BPF_FIXUPS];
+	int n;
+	int n_fixups;
+} stress_bpf_prog_t;
+
+/* Stressor names of the groups, shared with the periodic reporter */
+typedef struct {
+	uint32_t n;
+	char names[BPF_GROUPS][32];
+} stress_bpf_groups_t;
+
+/* A tracepoint and the program attached to it on every CPU */
+typedef struct {
+	const char *event;
+	void (*gen)(stress_bpf_prog_t *p, const char *event);
+	const bool needed;	/* no backend without it */
+} stress_bpf_tp_t;
+
+static const char *bpf_metric_names[BPF_METRICS] = {
+	"sched delay",
+	"page faults",
+	"block I/O",
+	"syscalls",
+};
+
+static int bpf_map_fd[BPF_MAPS] = { -1, -1, -1 };
+static stress_bpf_groups_t *bpf_groups;
+static int *bpf_event_fds;
+static size_t bpf_n_event_fds;
+static pid_t bpf_reporter_pid;
+static volatile bool bpf_reporter_run;
+
+static int stress_bpf(const int cmd, union bpf_attr *attr)
+{
+	return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/*
+ *  stress_bpf_tracefs_read()
+ *	read a file of a tracepoint in tracefs or debugfs
+ */
+static ssize_t stress_bpf_tracefs_read(
+	const char *event,
+	const char *file,
+	char *buf,
+	const size_t len)
+{
+	static const char * const tracefs[] = {
+		"/sys/kernel/tracing",
+		"/sys/kernel/debug/tracing",
+	};
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(tracefs); i++) {
+		char path[PATH_MAX];
+		ssize_t ret;
+
+		(void)snprintf(path, sizeof(path), "%s/events/%s/%s",
+			tracefs[i], event, file);
+		(void)memset(buf, 0, len);
+		ret = system_read(path, buf, len - 1);
+		if (ret > 0)
+			return ret;
+	}
+	return -1;
+}
+
+/*
+ *  stress_bpf_field()
+ *	offset of a field in the record of a tracepoint, -1 if
+ *	the field does not exist
+ */
+static int stress_bpf_field(const char *event, const char *field)
+{
+	static char buf[8192];
+	const char *ptr;
+	char name[64];
+	int offset;
+
+	if (stress_bpf_tracefs_read(event, "format", buf, sizeof(buf)) < 0)
+		return -1;
+	(void)snprintf(name, sizeof(name), " %s;", field);
+	ptr = strstr(buf, name);
+	if (!ptr)
+		return -1;
+	ptr = strstr(ptr, "offset:");
+	if (!ptr || (sscanf(ptr, "offset:%d", &offset) != 1))
+		return -1;
+	return offset;
+}
+
+static void stress_bpf_emit(
+	stress_bpf_prog_t *p,
+	const uint8_t code,
+	const uint8_t dst,
+	const uint8_t src,
+	const int16_t off,
+	const int32_t imm)
+{
+	struct bpf_insn *insn;
+
+	if (p->n >= BPF_INSNS)
+		return;
+	insn = &p->insn[p->n++];
+	(void)memset(insn, 0, sizeof(*insn));
+	insn->code = code;
+	insn->dst_reg = dst & 0xf;
+	insn->src_reg = src & 0xf;
+	insn->off = off;
+	insn->imm = imm;
+}
+
+/*
+ *  stress_bpf_jmp()
+ *	conditional jump against an immediate to a label
+ */
+static void stress_bpf_jmp(
+	stress_bpf_prog_t *p,
+	const uint8_t op,
+	const uint8_t dst,
+	const int32_t imm,
+	const int label)
+{
+	if (p->n_fixups < BPF_FIXUPS) {
+		p->fixup[p->n_fixups].pos = p->n;
+		p->fixup[p->n_fixups].label = label;
+		p->n_fixups++;
+	}
+	stress_bpf_emit(p, BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+}
+
+static void stress_bpf_label(stress_bpf_prog_t *p, const int label)
+{
+	p->label[label] = p->n;
+}
+
+static void stress_bpf_ld_imm64(stress_bpf_prog_t *p, const uint8_t dst,
+	const uint8_t src, const uint64_t imm)
+{
+	stress_bpf_emit(p, BPF_LD | BPF_DW | BPF_IMM, dst, src, 0, (int32_t)(imm & 0xffffffff));
+	stress_bpf_emit(p, 0, 0, 0, 0, (int32_t)(imm >> 32));
+}
+
+static void stress_bpf_ld_map(stress_bpf_prog_t *p, const uint8_t dst, const int map)
+{
+	stress_bpf_ld_imm64(p, dst, BPF_PSEUDO_MAP_FD, (uint64_t)bpf_map_fd[map]);
+}
+
+static void stress_bpf_call(stress_bpf_prog_t *p, const int32_t func)
+{
+	stress_bpf_emit(p, BPF_JMP | BPF_CALL, 0, 0, 0, func);
+}
+
+/*
+ *  stress_bpf_prologue()
+ *	r6 = ctx, the tracepoint record
+ */
+static void stress_bpf_prologue(stress_bpf_prog_t *p)
+{
+	(void)memset(p, 0, sizeof(*p));
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0);
+}
+
+/*
+ *  stress_bpf_epilogue()
+ *	out: return 0, then resolve the jumps
+ */
+static void stress_bpf_epilogue(stress_bpf_prog_t *p)
+{
+	int i;
+
+	stress_bpf_label(p, BPF_LABEL_OUT);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, 0);
+	stress_bpf_emit(p, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+	for (i = 0; i < p->n_fixups; i++) {
+		const int pos = p->fixup[i].pos;
+
+		p->insn[pos].off = (int16_t)(p->label[p->fixup[i].label] - pos - 1);
+	}
+}
+
+/*
+ *  stress_bpf_tid_current()
+ *	r7 = tid of the current thread
+ */
+static void stress_bpf_tid_current(stress_bpf_prog_t *p)
+{
+	stress_bpf_call(p, BPF_FUNC_get_current_pid_tgid);
+	stress_bpf_emit(p, BPF_ALU | BPF_MOV | BPF_X, 7, 0, 0, 0);
+}
+
+/*
+ *  stress_bpf_tid_field()
+ *	r7 = tid in a field of the tracepoint record
+ */
+static void stress_bpf_tid_field(stress_bpf_prog_t *p, const int offset)
+{
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_W, 7, 6, (int16_t)offset, 0);
+}
+
+/*
+ *  stress_bpf_group()
+ *	r8 = group of thread r7, jump to label if it is not
+ *	a stressor thread
+ */
+static void stress_bpf_group(stress_bpf_prog_t *p, const int label)
+{
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_W, 10, 7, -16, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_GROUPS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -16);
+	stress_bpf_call(p, BPF_FUNC_map_lookup_elem);
+	stress_bpf_jmp(p, BPF_JEQ, 0, 0, label);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_W, 8, 0, 0, 0);
+}
+
+/*
+ *  stress_bpf_key_tid()
+ *	r9 = key of a pending event of thread r7, the metric
+ *	is in the top byte
+ */
+static void stress_bpf_key_tid(stress_bpf_prog_t *p, const int metric)
+{
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 9, 7, 0, 0);
+	stress_bpf_ld_imm64(p, 1, 0, (uint64_t)metric << 56);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_OR | BPF_X, 9, 1, 0, 0);
+}
+
+/*
+ *  stress_bpf_key_request()
+ *	r9 = key of a pending block request, from its device
+ *	and sector
+ */
+static void stress_bpf_key_request(stress_bpf_prog_t *p, const char *event)
+{
+	const int dev = stress_bpf_field(event, "dev");
+	const int sector = stress_bpf_field(event, "sector");
+
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_DW, 9, 6, (int16_t)sector, 0);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_W, 1, 6, (int16_t)dev, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_LSH | BPF_K, 1, 0, 0, 32);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_XOR | BPF_X, 9, 1, 0, 0);
+	stress_bpf_ld_imm64(p, 1, 0, 0x00ffffffffffffffULL);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_AND | BPF_X, 9, 1, 0, 0);
+	stress_bpf_ld_imm64(p, 1, 0, (uint64_t)BPF_METRIC_BLOCK << 56);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_OR | BPF_X, 9, 1, 0, 0);
+}
+
+/*
+ *  stress_bpf_event_start()
+ *	note the time and group r8 of pending event r9
+ */
+static void stress_bpf_event_start(stress_bpf_prog_t *p)
+{
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_DW, 10, 9, -8, 0);
+	stress_bpf_call(p, BPF_FUNC_ktime_get_ns);
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_DW, 10, 0, -32, 0);
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_DW, 10, 8, -24, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_STARTS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -8);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0, -32);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0, BPF_ANY);
+	stress_bpf_call(p, BPF_FUNC_map_update_elem);
+}
+
+/*
+ *  stress_bpf_add()
+ *	atomically add register src, or 1 if src is 0, to the
+ *	histogram slot in register idx
+ */
+static void stress_bpf_add(stress_bpf_prog_t *p, const uint8_t idx, const uint8_t src)
+{
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_W, 10, idx, -16, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_HIST);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -16);
+	stress_bpf_call(p, BPF_FUNC_map_lookup_elem);
+	stress_bpf_jmp(p, BPF_JEQ, 0, 0, BPF_LABEL_OUT);
+	if (src)
+		stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 1, src, 0, 0);
+	else
+		stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 1, 0, 0, 1);
+	stress_bpf_emit(p, BPF_STX | BPF_XADD | BPF_DW, 0, 1, 0, 0);
+}
+
+/*
+ *  stress_bpf_base()
+ *	r8 = first histogram slot of metric for group r8
+ */
+static void stress_bpf_base(stress_bpf_prog_t *p, const int metric)
+{
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MUL | BPF_K, 8, 0, 0, BPF_METRICS * BPF_SLOTS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 8, 0, 0, metric * BPF_SLOTS);
+}
+
+/*
+ *  stress_bpf_event_end()
+ *	complete pending event r9, its latency goes into the
+ *	histogram of the group and metric it was started with
+ */
+static void stress_bpf_event_end(stress_bpf_prog_t *p, const int metric)
+{
+	static const int32_t shifts[] = { 32, 16, 8, 4, 2, 1 };
+	size_t i;
+
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_DW, 10, 9, -8, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_STARTS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -8);
+	stress_bpf_call(p, BPF_FUNC_map_lookup_elem);
+	stress_bpf_jmp(p, BPF_JEQ, 0, 0, BPF_LABEL_OUT);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_DW, 7, 0, 0, 0);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_DW, 8, 0, 8, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_STARTS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -8);
+	stress_bpf_call(p, BPF_FUNC_map_delete_elem);
+	stress_bpf_call(p, BPF_FUNC_ktime_get_ns);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_SUB | BPF_X, 0, 7, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 7, 0, 0, 0);
+	stress_bpf_base(p, metric);
+
+	/* r9 = log2(r7) by binary search */
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 1, 7, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 9, 0, 0, 0);
+	for (i = 0; i < SIZEOF_ARRAY(shifts); i++) {
+		stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 1, 0, 0);
+		stress_bpf_emit(p, BPF_ALU64 | BPF_RSH | BPF_K, 2, 0, 0, shifts[i]);
+		stress_bpf_emit(p, BPF_JMP | BPF_JEQ | BPF_K, 2, 0, 2, 0);
+		stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 1, 2, 0, 0);
+		stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 9, 0, 0, shifts[i]);
+	}
+	/* the bit below the top one picks the half of the power of 2 */
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 2, 0, 0, 0);
+	stress_bpf_emit(p, BPF_JMP | BPF_JEQ | BPF_K, 9, 0, 5, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 3, 9, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_SUB | BPF_K, 3, 0, 0, 1);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 7, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_RSH | BPF_X, 2, 3, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_AND | BPF_K, 2, 0, 0, 1);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_LSH | BPF_K, 9, 0, 0, 1);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_X, 9, 2, 0, 0);
+	stress_bpf_emit(p, BPF_JMP | BPF_JLE | BPF_K, 9, 0, 1, BPF_BUCKETS - 1);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 9, 0, 0, BPF_BUCKETS - 1);
+
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_X, 9, 8, 0, 0);
+	stress_bpf_add(p, 9, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 9, 8, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 9, 0, 0, BPF_SUM_SLOT);
+	stress_bpf_add(p, 9, 7);
+}
+
+/*
+ *  raw_syscalls/sys_enter and sys_exit
+ */
+static void stress_bpf_gen_sys_enter(stress_bpf_prog_t *p, const char *event)
+{
+	(void)event;
+
+	stress_bpf_prologue(p);
+	stress_bpf_tid_current(p);
+	stress_bpf_group(p, BPF_LABEL_OUT);
+	stress_bpf_key_tid(p, BPF_METRIC_SYSCALL);
+	stress_bpf_event_start(p);
+	stress_bpf_epilogue(p);
+}
+
+static void stress_bpf_gen_sys_exit(stress_bpf_prog_t *p, const char *event)
+{
+	(void)event;
+
+	stress_bpf_prologue(p);
+	stress_bpf_tid_current(p);
+	stress_bpf_key_tid(p, BPF_METRIC_SYSCALL);
+	stress_bpf_event_end(p, BPF_METRIC_SYSCALL);
+	stress_bpf_epilogue(p);
+}
+
+/*
+ *  sched/sched_wakeup and sched_wakeup_new, the woken
+ *  thread is runnable
+ */
+static void stress_bpf_gen_wakeup(stress_bpf_prog_t *p, const char *event)
+{
+	stress_bpf_prologue(p);
+	stress_bpf_tid_field(p, stress_bpf_field(event, "pid"));
+	stress_bpf_group(p, BPF_LABEL_OUT);
+	stress_bpf_key_tid(p, BPF_METRIC_SCHED);
+	stress_bpf_event_start(p);
+	stress_bpf_epilogue(p);
+}
+
+/*
+ *  sched/sched_switch, a preempted thread is still runnable,
+ *  the delay of the next thread ends
+ */
+static void stress_bpf_gen_switch(stress_bpf_prog_t *p, const char *event)
+{
+	stress_bpf_prologue(p);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_DW, 1, 6,
+		(int16_t)stress_bpf_field(event, "prev_state"), 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_AND | BPF_K, 1, 0, 0, 0xff);
+	stress_bpf_jmp(p, BPF_JNE, 1, 0, BPF_LABEL_NEXT);
+	stress_bpf_tid_field(p, stress_bpf_field(event, "prev_pid"));
+	stress_bpf_group(p, BPF_LABEL_NEXT);
+	stress_bpf_key_tid(p, BPF_METRIC_SCHED);
+	stress_bpf_event_start(p);
+	stress_bpf_label(p, BPF_LABEL_NEXT);
+	stress_bpf_tid_field(p, stress_bpf_field(event, "next_pid"));
+	stress_bpf_key_tid(p, BPF_METRIC_SCHED);
+	stress_bpf_event_end(p, BPF_METRIC_SCHED);
+	stress_bpf_epilogue(p);
+}
+
+/*
+ *  exceptions/page_fault_user, the fault handling time is
+ *  not traced so only the faults are counted
+ */
+static void stress_bpf_gen_fault(stress_bpf_prog_t *p, const char *event)
+{
+	(void)event;
+
+	stress_bpf_prologue(p);
+	stress_bpf_tid_current(p);
+	stress_bpf_group(p, BPF_LABEL_OUT);
+	stress_bpf_base(p, BPF_METRIC_FAULT);
+	stress_bpf_add(p, 8, 0);
+	stress_bpf_epilogue(p);
+}
+
+/*
+ *  block/block_rq_issue and block_rq_complete, the request
+ *  is charged to the thread that issued it
+ */
+static void stress_bpf_gen_rq_issue(stress_bpf_prog_t *p, const char *event)
+{
+	stress_bpf_prologue(p);
+	stress_bpf_tid_current(p);
+	stress_bpf_group(p, BPF_LABEL_OUT);
+	stress_bpf_key_request(p, event);
+	stress_bpf_event_start(p);
+	stress_bpf_epilogue(p);
+}
+
+static void stress_bpf_gen_rq_complete(stress_bpf_prog_t *p, const char *event)
+{
+	stress_bpf_prologue(p);
+	stress_bpf_key_request(p, event);
+	stress_bpf_event_end(p, BPF_METRIC_BLOCK);
+	stress_bpf_epilogue(p);
+}
+
+/*
+ *  sched/sched_process_fork, children and threads of a
+ *  stressor join its group
+ */
+static void stress_bpf_gen_fork(stress_bpf_prog_t *p, const char *event)
+{
+	stress_bpf_prologue(p);
+	stress_bpf_tid_current(p);
+	stress_bpf_group(p, BPF_LABEL_OUT);
+	stress_bpf_emit(p, BPF_LDX | BPF_MEM | BPF_W, 1, 6,
+		(int16_t)stress_bpf_field(event, "child_pid"), 0);
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_W, 10, 1, -8, 0);
+	stress_bpf_emit(p, BPF_STX | BPF_MEM | BPF_W, 10, 8, -4, 0);
+	stress_bpf_ld_map(p, 1, BPF_MAP_GROUPS);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -8);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0, -4);
+	stress_bpf_emit(p, BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0, BPF_ANY);
+	stress_bpf_call(p, BPF_FUNC_map_update_elem);
+	stress_bpf_epilogue(p);
+}
+
+static const stress_bpf_tp_t bpf_tracepoints[] = {
+	{ "sched/sched_process_fork",	stress_bpf_gen_fork,		true },
+	{ "raw_syscalls/sys_enter",	stress_bpf_gen_sys_enter,	true },
+	{ "raw_syscalls/sys_exit",	stress_bpf_gen_sys_exit,	true },
+	{ "sched/sched_wakeup",		stress_bpf_gen_wakeup,		false },
+	{ "sched/sched_wakeup_new",	stress_bpf_gen_wakeup,		false },
+	{ "sched/sched_switch",		stress_bpf_gen_switch,		false },
+	{ "exceptions/page_fault_user",	stress_bpf_gen_fault,		false },
+	{ "block/block_rq_issue",	stress_bpf_gen_rq_issue,	false },
+	{ "block/block_rq_complete",	stress_bpf_gen_rq_complete,	false },
+};
+
+/*
+ *  stress_bpf_map_create()
+ *	create one of the maps shared by the programs
+ */
+static int stress_bpf_map_create(
+	const uint32_t type,
+	const uint32_t key_size,
+	const uint32_t value_size,
+	const uint32_t max_entries)
+{
+	union bpf_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.map_type = type;
+	attr.key_size = key_size;
+	attr.value_size = value_size;
+	attr.max_entries = max_entries;
+	return stress_bpf(BPF_MAP_CREATE, &attr);
+}
+
+/*
+ *  stress_bpf_attach()
+ *	load the program of a tracepoint and attach it on every
+ *	CPU, returns the number of CPUs attached to
+ */
+static int stress_bpf_attach(const stress_bpf_tp_t *tp, const int32_t cpus)
+{
+	static stress_bpf_prog_t prog;
+	static char log[65536];
+	union bpf_attr attr;
+	char buf[32];
+	int prog_fd, id, n = 0;
+	int32_t i;
+
+	if (stress_bpf_tracefs_read(tp->event, "id", buf, sizeof(buf)) < 0)
+		return 0;
+	id = atoi(buf);
+
+	tp->gen(&prog, tp->event);
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_TRACEPOINT;
+	attr.insns = (uint64_t)(uintptr_t)prog.insn;
+	attr.insn_cnt = (uint32_t)prog.n;
+	attr.license = (uint64_t)(uintptr_t)"GPL";
+	prog_fd = stress_bpf(BPF_PROG_LOAD, &attr);
+	if (prog_fd < 0) {
+		/* Load again to fetch the verifier's reasons */
+		attr.log_buf = (uint64_t)(uintptr_t)log;
+		attr.log_size = sizeof(log);
+		attr.log_level = 1;
+		*log = '\0';
+		(void)stress_bpf(BPF_PROG_LOAD, &attr);
+		pr_dbg("bpf: %s program verifier log: %s\n", tp->event, log);
+		return 0;
+	}
+
+	for (i = 0; i < cpus; i++) {
+		struct perf_event_attr pattr;
+		int fd;
+
+		(void)memset(&pattr, 0, sizeof(pattr));
+		pattr.type = PERF_TYPE_TRACEPOINT;
+		pattr.size = sizeof(pattr);
+		pattr.config = (uint64_t)id;
+		pattr.sample_period = 1;
+		pattr.sample_type = PERF_SAMPLE_RAW;
+		pattr.wakeup_events = 1;
+
+		fd = (int)syscall(__NR_perf_event_open, &pattr, -1, i, -1, 0);
+		if (fd < 0)
+			continue;	/* offline CPU */
+		if (ioctl(fd, PERF_EVENT_IOC_SET_BPF, prog_fd) < 0) {
+			(void)close(fd);
+			continue;
+		}
+		(void)ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		bpf_event_fds[bpf_n_event_fds++] = fd;
+		n++;
+	}
+	/* The perf events hold a reference to the program */
+	(void)close(prog_fd);
+	return n;
+}
+
+/*
+ *  stress_bpf_read()
+ *	read the histogram slots of a group
+ */
+static void stress_bpf_read(const uint32_t group, uint64_t *slots)
+{
+	uint32_t i;
+
+	for (i = 0; i < BPF_METRICS * BPF_SLOTS; i++) {
+		union bpf_attr attr;
+		uint32_t key = (group * BPF_METRICS * BPF_SLOTS) + i;
+
+		slots[i] = 0;
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.map_fd = (uint32_t)bpf_map_fd[BPF_MAP_HIST];
+		attr.key = (uint64_t)(uintptr_t)&key;
+		attr.value = (uint64_t)(uintptr_t)&slots[i];
+		(void)stress_bpf(BPF_MAP_LOOKUP_ELEM, &attr);
+	}
+}
+
+/*
+ *  stress_bpf_count()
+ *	events in the histogram of a metric
+ */
+static uint64_t stress_bpf_count(const uint64_t *slots)
+{
+	uint64_t count = 0;
+	int i;
+
+	for (i = 0; i < BPF_BUCKETS; i++)
+		count += slots[i];
+	return count;
+}
+
+/*
+ *  stress_bpf_percentile()
+ *	latency in microseconds below which fraction of the events
+ *	were, the middle of the histogram bucket it fell in
+ */
+static double stress_bpf_percentile(const uint64_t *slots, const double fraction)
+{
+	const uint64_t target = (uint64_t)(fraction * (double)stress_bpf_count(slots));
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < BPF_BUCKETS - 1; i++) {
+		sum += slots[i];
+		if (sum > target)
+			break;
+	}
+	/* bucket 2b + h covers 2^b * (1 + h/2) up to the next bucket */
+	return pow(2.0, (double)(i / 2)) * (1.25 + 0.5 * (double)(i & 1)) / 1000.0;
+}
+
+/*
+ *  stress_bpf_report()
+ *	report the latencies of each stressor, slots of the
+ *	previous report are subtracted when prev is not NULL
+ */
+static void stress_bpf_report(uint64_t *prev)
+{
+	uint64_t slots[BPF_METRICS * BPF_SLOTS];
+	const uint32_t n = __atomic_load_n(&bpf_groups->n, __ATOMIC_ACQUIRE);
+	bool lock = false;
+	uint32_t g;
+	int i;
+
+	pr_lock(&lock);
+	if (prev)
+		pr_inf_lock(&lock, "bpf: latencies of the last %" PRId32 " seconds\n", bpf_period);
+	pr_inf_lock(&lock, "bpf: %-13s %-11s %12s %10s %10s %10s %10s\n",
+		"Stressor", "Metric", "Count", "Mean us",
+		"p50 us", "p90 us", "p99 us");
+	for (g = 0; g < n; g++) {
+		stress_bpf_read(g, slots);
+		if (prev) {
+			uint64_t *p = prev + (g * BPF_METRICS * BPF_SLOTS);
+
+			for (i = 0; i < BPF_METRICS * BPF_SLOTS; i++) {
+				const uint64_t now = slots[i];
+
+				slots[i] -= p[i];
+				p[i] = now;
+			}
+		}
+		for (i = 0; i < BPF_METRICS; i++) {
+			const uint64_t *s = &slots[i * BPF_SLOTS];
+			const uint64_t count = stress_bpf_count(s);
+
+			if (!count)
+				continue;
+			if (i == BPF_METRIC_FAULT) {
+				pr_inf_lock(&lock, "bpf: %-13.13s %-11s %12" PRIu64 "\n",
+					bpf_groups->names[g], bpf_metric_names[i], count);
+				continue;
+			}
+			pr_inf_lock(&lock, "bpf: %-13.13s %-11s %12" PRIu64
+				" %10.2f %10.2f %10.2f %10.2f\n",
+				bpf_groups->names[g], bpf_metric_names[i], count,
+				(double)s[BPF_SUM_SLOT] / (double)count / 1000.0,
+				stress_bpf_percentile(s, 0.50),
+				stress_bpf_percentile(s, 0.90),
+				stress_bpf_percentile(s, 0.99));
+		}
+	}
+	pr_unlock(&lock);
+}
+
+static void MLOCKED_TEXT stress_bpf_handler(int signum)
+{
+	(void)signum;
+
+	bpf_reporter_run = false;
+}
+
+/*
+ *  stress_bpf_reporter()
+ *	report the latencies of the last period every period
+ */
+static void stress_bpf_reporter(void)
+{
+	uint64_t *prev;
+
+	prev = calloc(BPF_GROUPS * BPF_METRICS * BPF_SLOTS, sizeof(*prev));
+	if (!prev)
+		return;
+	while (bpf_reporter_run) {
+		(void)sleep((unsigned int)bpf_period);
+		if (!bpf_reporter_run)
+			break;
+		stress_bpf_report(prev);
+	}
+	free(prev);
+}
+
+static void stress_bpf_close(void)
+{
+	size_t i;
+
+	for (i = 0; i < bpf_n_event_fds; i++)
+		(void)close(bpf_event_fds[i]);
+	free(bpf_event_fds);
+	bpf_event_fds = NULL;
+	bpf_n_event_fds = 0;
+
+	for (i = 0; i < BPF_MAPS; i++) {
+		if (bpf_map_fd[i] >= 0)
+			(void)close(bpf_map_fd[i]);
+		bpf_map_fd[i] = -1;
+	}
+	if (bpf_groups) {
+		(void)munmap((void *)bpf_groups, sizeof(*bpf_groups));
+		bpf_groups = NULL;
+	}
+}
+
+/*
+ *  stress_bpf_start()
+ *	load the programs and attach them before any stressor is
+ *	started, all CPUs are traced with a few perf events per
+ *	CPU no matter how many stressor instances there are
+ */
+void stress_bpf_start(void)
+{
+	const int32_t cpus = stress_get_processors_configured();
+	size_t i;
+	bool missing = false;
+
+	if (!bpf_enabled)
+		return;
+	if (!stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
+		pr_inf("bpf: requires CAP_SYS_ADMIN capability, ignoring --bpf option\n");
+		return;
+	}
+
+	bpf_groups = (stress_bpf_groups_t *)mmap(NULL, sizeof(*bpf_groups),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (bpf_groups == MAP_FAILED) {
+		bpf_groups = NULL;
+		pr_inf("bpf: cannot mmap group table, ignoring --bpf option\n");
+		return;
+	}
+	bpf_event_fds = calloc(SIZEOF_ARRAY(bpf_tracepoints) * (size_t)cpus,
+		sizeof(*bpf_event_fds));
+	if (!bpf_event_fds)
+		goto fail;
+
+	bpf_map_fd[BPF_MAP_GROUPS] = stress_bpf_map_create(BPF_MAP_TYPE_LRU_HASH,
+		sizeof(uint32_t), sizeof(uint32_t), BPF_TASKS);
+	bpf_map_fd[BPF_MAP_STARTS] = stress_bpf_map_create(BPF_MAP_TYPE_LRU_HASH,
+		sizeof(uint64_t), 2 * sizeof(uint64_t), BPF_TASKS);
+	bpf_map_fd[BPF_MAP_HIST] = stress_bpf_map_create(BPF_MAP_TYPE_ARRAY,
+		sizeof(uint32_t), sizeof(uint64_t), BPF_GROUPS * BPF_METRICS * BPF_SLOTS);
+	if ((bpf_map_fd[BPF_MAP_GROUPS] < 0) ||
+	    (bpf_map_fd[BPF_MAP_STARTS] < 0) ||
+	    (bpf_map_fd[BPF_MAP_HIST] < 0)) {
+		pr_inf("bpf: cannot create maps, errno=%d (%s), ignoring --bpf option\n",
+			errno, strerror(errno));
+		goto fail;
+	}
+
+	for (i = 0; i < SIZEOF_ARRAY(bpf_tracepoints); i++) {
+		const stress_bpf_tp_t *tp = &bpf_tracepoints[i];
+
+		if (stress_bpf_attach(tp, cpus) > 0)
+			continue;
+		if (tp->needed) {
+			pr_inf("bpf: cannot attach a program to tracepoint %s, "
+				"ignoring --bpf option\n", tp->event);
+			goto fail;
+		}
+		pr_dbg("bpf: cannot attach a program to tracepoint %s\n", tp->event);
+		missing = true;
+	}
+	if (missing)
+		pr_inf("bpf: some tracepoints are not available, use -v to see "
+			"which metrics are not collected\n");
+
+	if (bpf_period > 0) {
+		bpf_reporter_run = true;
+		bpf_reporter_pid = fork();
+		if (bpf_reporter_pid < 0) {
+			pr_err("bpf reporter process failed to fork: %d (%s)\n",
+				errno, strerror(errno));
+		} else if (bpf_reporter_pid == 0) {
+			stress_set_proc_name("stress-ng-bpf");
+			if (stress_sighandler("bpf", SIGALRM, stress_bpf_handler, NULL) < 0)
+				_exit(0);
+			stress_bpf_reporter();
+			_exit(0);
+		}
+	}
+	return;
+fail:
+	stress_bpf_close();
+}
+
+/*
+ *  stress_bpf_add_pid()
+ *	add a stressor instance to the group of its stressor
+ */
+void stress_bpf_add_pid(const pid_t pid)
+{
+	union bpf_attr attr;
+	uint32_t key = (uint32_t)pid, group;
+	const char *name;
+
+	if (!bpf_groups || (pid <= 0) || !g_stressor_current)
+		return;
+
+	name = stress_munge_underscore(g_stressor_current->stressor->name);
+	for (group = 0; group < bpf_groups->n; group++) {
+		if (!strcmp(bpf_groups->names[group], name))
+			break;
+	}
+	if (group == bpf_groups->n) {
+		if (group >= BPF_GROUPS)
+			return;
+		(void)shim_strlcpy(bpf_groups->names[group], name,
+			sizeof(bpf_groups->names[group]));
+		__atomic_store_n(&bpf_groups->n, group + 1, __ATOMIC_RELEASE);
+	}
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.map_fd = (uint32_t)bpf_map_fd[BPF_MAP_GROUPS];
+	attr.key = (uint64_t)(uintptr_t)&key;
+	attr.value = (uint64_t)(uintptr_t)&group;
+	attr.flags = BPF_ANY;
+	(void)stress_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+/*
+ *  stress_bpf_stop()
+ *	detach the programs and report the totals
+ */
+void stress_bpf_stop(void)
+{
+	if (!bpf_groups)
+		return;
+
+	if (bpf_reporter_pid > 0) {
+		int status;
+
+		(void)kill(bpf_reporter_pid, SIGALRM);
+		(void)shim_waitpid(bpf_reporter_pid, &status, 0);
+		bpf_reporter_pid = 0;
+	}
+	if (bpf_groups->n)
+		stress_bpf_report(NULL);
+	stress_bpf_close();
+}
+#else
+void stress_bpf_start(void)
+{
+	if (bpf_enabled)
+		pr_inf("bpf: this option is not implemented on this system: %s %s\n",
+			stress_get_uname_info(), stress_get_compiler());
+}
+
+void stress_bpf_add_pid(const pid_t pid)
+{
+	(void)pid;
+}
+
+void stress_bpf_stop(void)
+{
+}
+#endif
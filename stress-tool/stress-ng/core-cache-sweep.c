@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define SWEEP_PATTERN_SEQ	(0)	/* each line in address order */
+#define SWEEP_PATTERN_STRIDE	(1)	/* a page apart, defeats line prefetch */
+#define SWEEP_PATTERN_RANDOM	(2)	/* random cyclic permutation of lines */
+#define SWEEP_PATTERN_CONFLICT	(3)	/* only lines that map to the same set */
+#define SWEEP_PATTERNS		(4)
+
+#define SWEEP_MAX_POINTS	(64)
+#define SWEEP_MIN_ACCESSES	(1U << 20)
+#define SWEEP_MAX_SIZE		(1ULL * GB)
+#define SWEEP_DEFAULT_MIN	(4 * KB)
+#define SWEEP_DEFAULT_MAX	(64 * MB)
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open) &&	\
+    defined(PERF_TYPE_HW_CACHE)
+#define STRESS_CACHE_SWEEP_PERF
+#endif
+
+static const char * const sweep_pattern_names[SWEEP_PATTERNS] = {
+	"sequential",
+	"strided",
+	"random",
+	"set-conflict",
+};
+
+typedef struct {
+	double latency;		/* best ns per dependent load */
+	double mb_per_sec;	/* best MB/sec of independent loads */
+	double l1d_miss;	/* L1D read misses per access */
+	double llc_miss;	/* last level read misses per access */
+	bool measured;		/* point has been measured */
+} stress_cache_sweep_point_t;
+
+#if defined(STRESS_CACHE_SWEEP_PERF)
+/*
+ *  stress_cache_sweep_perf_open()
+ *	open a read miss counter of a hardware cache for the
+ *	calling thread, returns -1 if there is none
+ */
+static int stress_cache_sweep_perf_open(const uint64_t cache)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = cache |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void stress_cache_sweep_perf_enable(const int fd)
+{
+	if (fd >= 0) {
+		(void)ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		(void)ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+static void stress_cache_sweep_perf_disable(const int fd)
+{
+	if (fd >= 0)
+		(void)ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+#endif
+
+/*
+ *  stress_cache_sweep_perf_read()
+ *	read a miss counter, -1.0 if there is none
+ */
+static double stress_cache_sweep_perf_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if ((fd < 0) || (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)))
+		return -1.0;
+	return (double)count;
+}
+
+/*
+ *  stress_cache_sweep_range()
+ *	find the L1 data cache geometry and the last level cache
+ *	size, the sweep runs from a quarter of L1 to 4 x LLC
+ */
+static void stress_cache_sweep_range(
+	const stress_args_t *args,
+	uint32_t *line_size,
+	uint64_t *conflict_stride,
+	uint64_t *min,
+	uint64_t *max)
+{
+	stress_cpus_t *cpu_caches;
+	uint16_t level, max_level;
+	size_t shmall, freemem, totalmem, freeswap;
+	char buf[128];
+	size_t len = 0;
+
+	*min = SWEEP_DEFAULT_MIN;
+	*max = SWEEP_DEFAULT_MAX;
+	*buf = '\0';
+
+	cpu_caches = stress_get_all_cpu_cache_details();
+	if (cpu_caches) {
+		max_level = stress_get_max_cache_level(cpu_caches);
+		for (level = 1; level <= max_level; level++) {
+			const stress_cpu_cache_t *cache =
+				stress_get_cpu_cache(cpu_caches, level);
+			char szstr[32];
+
+			if (!cache || !cache->size)
+				continue;
+			if (level == 1) {
+				*min = STRESS_MAXIMUM(cache->size / 4, SWEEP_DEFAULT_MIN);
+				if (!*line_size)
+					*line_size = cache->line_size;
+				if (!*conflict_stride && cache->ways)
+					*conflict_stride = cache->size / cache->ways;
+			}
+			*max = cache->size * 4;
+			stress_uint64_to_str(szstr, sizeof(szstr), cache->size);
+			(void)snprintf(buf + len, sizeof(buf) - len, "%sL%" PRIu16 " %s",
+				len ? ", " : "", level, szstr);
+			len = strlen(buf);
+		}
+		stress_free_cpu_caches(cpu_caches);
+	}
+	if (!*line_size)
+		*line_size = 64;
+	if (!*conflict_stride)
+		*conflict_stride = 4 * KB;
+
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	if (*max > SWEEP_MAX_SIZE)
+		*max = SWEEP_MAX_SIZE;
+	if (freemem && (*max > freemem / 4))
+		*max = freemem / 4;
+	if (*max < *min)
+		*max = *min;
+
+	if (args->instance == 0)
+		pr_inf("%s: cache sweep, %s, line size %" PRIu32
+			", set conflict stride %" PRIu64 "\n", args->name,
+			*buf ? buf : "cache sizes unknown", *line_size,
+			*conflict_stride);
+}
+
+/*
+ *  stress_cache_sweep_order()
+ *	fill order with the line indexes of a working set of
+ *	lines lines in the order of the access pattern, returns
+ *	the number of lines visited
+ */
+static size_t stress_cache_sweep_order(
+	uint32_t *order,
+	const size_t lines,
+	const int pattern,
+	const size_t page_lines,
+	const size_t conflict_lines)
+{
+	size_t i, j, n = 0;
+
+	switch (pattern) {
+	case SWEEP_PATTERN_STRIDE:
+		for (i = 0; i < page_lines; i++)
+			for (j = i; j < lines; j += page_lines)
+				order[n++] = (uint32_t)j;
+		break;
+	case SWEEP_PATTERN_RANDOM:
+		for (i = 0; i < lines; i++)
+			order[i] = (uint32_t)i;
+		/* Sattolo's shuffle gives a single cycle through all lines */
+		for (i = lines - 1; i > 0; i--) {
+			const uint32_t tmp = order[i];
+
+			j = (size_t)stress_mwc64() % i;
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+		n = lines;
+		break;
+	case SWEEP_PATTERN_CONFLICT:
+		for (i = 0; i < lines; i += conflict_lines)
+			order[n++] = (uint32_t)i;
+		break;
+	case SWEEP_PATTERN_SEQ:
+	default:
+		for (i = 0; i < lines; i++)
+			order[i] = (uint32_t)i;
+		n = lines;
+		break;
+	}
+	return n;
+}
+
+/*
+ *  stress_cache_sweep_chase()
+ *	follow the pointer chain for n dependent loads
+ */
+static void * OPTIMIZE3 stress_cache_sweep_chase(void *ptr, const uint64_t n)
+{
+	register void **p = (void **)ptr;
+	register uint64_t i;
+
+	for (i = 0; i < n; i += 8) {
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+		p = (void **)*p;
+	}
+	return (void *)p;
+}
+
+/*
+ *  stress_cache_sweep_read()
+ *	one independent load per line in pattern order
+ */
+static uint64_t OPTIMIZE3 stress_cache_sweep_read(
+	const uint8_t *buf,
+	const uint32_t *order,
+	const size_t n,
+	const uint32_t line_size,
+	const uint64_t passes)
+{
+	register uint64_t sum = 0, pass;
+
+	for (pass = 0; pass < passes; pass++) {
+		register size_t i;
+
+		for (i = 0; i < n; i++)
+			sum += *(const volatile uint64_t *)(buf + ((size_t)order[i] * line_size));
+	}
+	return sum;
+}
+
+/*
+ *  stress_cache_sweep_point()
+ *	measure the latency and bandwidth of one working set size
+ *	and access pattern
+ */
+static void stress_cache_sweep_point(
+	uint8_t *buf,
+	uint32_t *order,
+	const uint64_t size,
+	const int pattern,
+	const uint32_t line_size,
+	const size_t page_lines,
+	const size_t conflict_lines,
+	const int l1d_fd,
+	const int llc_fd,
+	stress_cache_sweep_point_t *point)
+{
+	const size_t lines = (size_t)(size / line_size);
+	const size_t n = stress_cache_sweep_order(order, lines, pattern,
+		page_lines, conflict_lines);
+	const uint64_t passes = (n >= SWEEP_MIN_ACCESSES) ? 1 :
+		(SWEEP_MIN_ACCESSES + n - 1) / n;
+	const uint64_t accesses = ((n * passes) + 7) & ~7ULL;
+	double t, latency, mb_per_sec, l1d_miss, llc_miss;
+	size_t i;
+	void *p;
+
+	for (i = 0; i < n; i++) {
+		void **line = (void **)(buf + ((size_t)order[i] * line_size));
+
+		*line = (void *)(buf + ((size_t)order[(i + 1) % n] * line_size));
+	}
+
+	/* Warm up, then time the dependent loads */
+	p = stress_cache_sweep_chase(buf + ((size_t)order[0] * line_size), (n + 7) & ~7ULL);
+#if defined(STRESS_CACHE_SWEEP_PERF)
+	stress_cache_sweep_perf_enable(l1d_fd);
+	stress_cache_sweep_perf_enable(llc_fd);
+#endif
+	t = stress_time_now();
+	p = stress_cache_sweep_chase(p, accesses);
+	t = stress_time_now() - t;
+#if defined(STRESS_CACHE_SWEEP_PERF)
+	stress_cache_sweep_perf_disable(l1d_fd);
+	stress_cache_sweep_perf_disable(llc_fd);
+#endif
+	stress_void_ptr_put(p);
+	latency = (t > 0.0) ? (t * 1.0E9) / (double)accesses : 0.0;
+	l1d_miss = stress_cache_sweep_perf_read(l1d_fd);
+	llc_miss = stress_cache_sweep_perf_read(llc_fd);
+
+	t = stress_time_now();
+	stress_uint64_put(stress_cache_sweep_read(buf, order, n, line_size, passes));
+	t = stress_time_now() - t;
+	mb_per_sec = (t > 0.0) ? ((double)(n * passes) * (double)line_size) / (t * (double)MB) : 0.0;
+
+	if (!point->measured || (latency < point->latency))
+		point->latency = latency;
+	if (mb_per_sec > point->mb_per_sec)
+		point->mb_per_sec = mb_per_sec;
+	point->l1d_miss = (l1d_miss < 0.0) ? -1.0 : l1d_miss / (double)accesses;
+	point->llc_miss = (llc_miss < 0.0) ? -1.0 : llc_miss / (double)accesses;
+	point->measured = true;
+}
+
+/*
+ *  stress_cache_sweep_miss_str()
+ *	misses per access as a string, n/a if not counted
+ */
+static void stress_cache_sweep_miss_str(char *str, const size_t len, const double miss)
+{
+	if (miss < 0.0)
+		(void)shim_strlcpy(str, "n/a", len);
+	else
+		(void)snprintf(str, len, "%.3f", miss);
+}
+
+/*
+ *  stress_cache_sweep()
+ *	sweep the working set size from within L1 to beyond the
+ *	last level cache for sequential, strided, random and set
+ *	conflicting access patterns and report the latency and
+ *	bandwidth curve with the L1D and LLC misses per access.
+ *	A zero line_size or conflict_stride uses the L1 geometry
+ *	reported by the kernel.
+ */
+int stress_cache_sweep(
+	const stress_args_t *args,
+	uint32_t line_size,
+	uint64_t conflict_stride)
+{
+	stress_cache_sweep_point_t (*points)[SWEEP_MAX_POINTS];
+	uint64_t sizes[SWEEP_MAX_POINTS], min, max, size;
+	size_t n_sizes = 0, i, page_lines, conflict_lines;
+	int pattern, l1d_fd = -1, llc_fd = -1;
+	uint8_t *buf;
+	uint32_t *order;
+	bool lock = false;
+
+	stress_cache_sweep_range(args, &line_size, &conflict_stride, &min, &max);
+	page_lines = STRESS_MAXIMUM(args->page_size / line_size, 1);
+	conflict_lines = STRESS_MAXIMUM(conflict_stride / line_size, 1);
+
+	/* Two points per octave, at 1 and 1.5 x each power of 2 */
+	for (size = (uint64_t)1 << (63 - __builtin_clzll(min));
+	     (size <= max) && (n_sizes < SWEEP_MAX_POINTS - 1); size <<= 1) {
+		if (size >= min)
+			sizes[n_sizes++] = size;
+		if ((size + (size >> 1) >= min) && (size + (size >> 1) <= max))
+			sizes[n_sizes++] = size + (size >> 1);
+	}
+	if (!n_sizes)
+		sizes[n_sizes++] = min;
+	max = sizes[n_sizes - 1];
+
+	points = calloc(SWEEP_PATTERNS, sizeof(*points));
+	if (!points) {
+		pr_inf_skip("%s: cannot allocate sweep results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	order = calloc((size_t)(max / line_size), sizeof(*order));
+	if (!order) {
+		pr_inf_skip("%s: cannot allocate %" PRIu64 " line sweep order, "
+			"skipping stressor\n", args->name, max / line_size);
+		free(points);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = (uint8_t *)mmap(NULL, (size_t)max, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %" PRIu64 " byte sweep buffer, "
+			"skipping stressor, errno=%d (%s)\n", args->name, max,
+			errno, strerror(errno));
+		free(order);
+		free(points);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(buf, 0, (size_t)max);
+
+#if defined(STRESS_CACHE_SWEEP_PERF)
+	l1d_fd = stress_cache_sweep_perf_open(PERF_COUNT_HW_CACHE_L1D);
+	llc_fd = stress_cache_sweep_perf_open(PERF_COUNT_HW_CACHE_LL);
+#endif
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < n_sizes; i++) {
+			for (pattern = 0; pattern < SWEEP_PATTERNS; pattern++) {
+				if (!keep_stressing(args))
+					goto report;
+				stress_cache_sweep_point(buf, order, sizes[i], pattern,
+					line_size, page_lines, conflict_lines,
+					l1d_fd, llc_fd, &points[pattern][i]);
+				inc_counter(args);
+			}
+		}
+	} while (keep_stressing(args));
+
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (l1d_fd >= 0)
+		(void)close(l1d_fd);
+	if (llc_fd >= 0)
+		(void)close(llc_fd);
+
+	if (args->instance == 0) {
+		pr_lock(&lock);
+		for (pattern = 0; pattern < SWEEP_PATTERNS; pattern++) {
+			if (!points[pattern][0].measured)
+				continue;
+			pr_inf_lock(&lock, "%s: %s access:\n", args->name,
+				sweep_pattern_names[pattern]);
+			pr_inf_lock(&lock, "%s: %10s %11s %11s %13s %13s\n", args->name,
+				"size", "latency ns", "MB/sec", "L1D miss/acc", "LLC miss/acc");
+			for (i = 0; i < n_sizes; i++) {
+				const stress_cache_sweep_point_t *point = &points[pattern][i];
+				char szstr[32], l1d[16], llc[16];
+
+				if (!point->measured)
+					break;
+				stress_uint64_to_str(szstr, sizeof(szstr), sizes[i]);
+				stress_cache_sweep_miss_str(l1d, sizeof(l1d), point->l1d_miss);
+				stress_cache_sweep_miss_str(llc, sizeof(llc), point->llc_miss);
+				pr_inf_lock(&lock, "%s: %10s %11.2f %11.1f %13s %13s\n",
+					args->name, szstr, point->latency,
+					point->mb_per_sec, l1d, llc);
+			}
+		}
+		pr_unlock(&lock);
+	}
+
+	(void)munmap((void *)buf, (size_t)max);
+	free(order);
+	free(points);
+
+	return EXIT_SUCCESS;
+}
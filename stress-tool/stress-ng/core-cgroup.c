@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define CGROUP_BASE_LEN		(PATH_MAX + 32)
+#define CGROUP_PATH_LEN		(CGROUP_BASE_LEN + 160)
+
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor the group belongs to */
+	char path[CGROUP_PATH_LEN];	/* cgroup v2 directory of the group */
+} stress_cgroup_t;
+
+static bool cgroup_enabled = false;
+static const char *cgroup_cpu_max = NULL;
+static const char *cgroup_memory_high = NULL;
+static const char *cgroup_io_max = NULL;
+
+/*
+ *  stress_cgroup_set_limit()
+ *	keep a limit verbatim in cgroup v2 syntax, the kernel
+ *	validates it when it is written to the group
+ */
+static int stress_cgroup_set_limit(const char *const name, const char *const opt, const char **limit)
+{
+	if (!opt || !*opt) {
+		(void)fprintf(stderr, "%s must not be empty\n", name);
+		_exit(EXIT_FAILURE);
+	}
+	*limit = opt;
+	cgroup_enabled = true;
+	return 0;
+}
+
+/*
+ *  stress_set_cgroup()
+ *	run each stressor in its own cgroup v2 group
+ */
+int stress_set_cgroup(const char *const opt)
+{
+	(void)opt;
+
+	cgroup_enabled = true;
+	return 0;
+}
+
+/*
+ *  stress_set_cgroup_cpu_max()
+ *	set the cpu.max of each stressor group, "quota period" or "max period"
+ */
+int stress_set_cgroup_cpu_max(const char *const opt)
+{
+	return stress_cgroup_set_limit("cgroup-cpu-max", opt, &cgroup_cpu_max);
+}
+
+/*
+ *  stress_set_cgroup_memory_high()
+ *	set the memory.high of each stressor group
+ */
+int stress_set_cgroup_memory_high(const char *const opt)
+{
+	return stress_cgroup_set_limit("cgroup-memory-high", opt, &cgroup_memory_high);
+}
+
+/*
+ *  stress_set_cgroup_io_max()
+ *	set the io.max of each stressor group, "MAJ:MIN rbps=N ..."
+ */
+int stress_set_cgroup_io_max(const char *const opt)
+{
+	return stress_cgroup_set_limit("cgroup-io-max", opt, &cgroup_io_max);
+}
+
+#if defined(__linux__)
+
+static char cgroup_base[CGROUP_BASE_LEN];
+static stress_cgroup_t *cgroups;
+static size_t cgroups_n;
+
+/*
+ *  stress_cgroup_write()
+ *	write a string to a control file in a cgroup directory
+ */
+static int stress_cgroup_write(const char *dir, const char *file, const char *str)
+{
+	char path[CGROUP_PATH_LEN + 64];
+	ssize_t ret;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	ret = system_write(path, str, strlen(str));
+	return (ret < 0) ? (int)ret : 0;
+}
+
+/*
+ *  stress_cgroup_read()
+ *	read a control file of a cgroup directory into buf
+ */
+static ssize_t stress_cgroup_read(const char *dir, const char *file, char *buf, const size_t len)
+{
+	char path[CGROUP_PATH_LEN + 64];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	return system_read(path, buf, len);
+}
+
+/*
+ *  stress_cgroup_field()
+ *	find "key value" in a flat keyed cgroup file, the
+ *	key must start a line; returns -1 if it is missing
+ */
+static int64_t stress_cgroup_field(const char *buf, const char *key)
+{
+	const size_t len = strlen(key);
+	const char *ptr = buf;
+
+	while (ptr && *ptr) {
+		if (!strncmp(ptr, key, len) && (ptr[len] == ' '))
+			return (int64_t)strtoull(ptr + len + 1, NULL, 10);
+		ptr = strchr(ptr, '\n');
+		if (ptr)
+			ptr++;
+	}
+	return -1;
+}
+
+/*
+ *  stress_cgroup_mount()
+ *	find the cgroup v2 hierarchy and our own group in it
+ */
+static bool stress_cgroup_mount(char *dir, const size_t len)
+{
+	static const char * const mounts[] = {
+		"/sys/fs/cgroup",
+		"/sys/fs/cgroup/unified",
+	};
+	char buf[4096], path[PATH_MAX], *line, *save = NULL;
+	const char *rel = NULL, *mount = NULL;
+	struct stat statbuf;
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(mounts); i++) {
+		(void)snprintf(path, sizeof(path), "%s/cgroup.procs", mounts[i]);
+		if ((stat(path, &statbuf) == 0) &&
+		    (snprintf(path, sizeof(path), "%s/cgroup.subtree_control", mounts[i]) > 0) &&
+		    (stat(path, &statbuf) == 0)) {
+			mount = mounts[i];
+			break;
+		}
+	}
+	if (!mount)
+		return false;
+	if (system_read("/proc/self/cgroup", buf, sizeof(buf)) <= 0)
+		return false;
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (!strncmp(line, "0::", 3)) {
+			rel = line + 3;
+			break;
+		}
+	}
+	if (!rel)
+		return false;
+	if (!strcmp(rel, "/"))
+		rel = "";
+	(void)snprintf(dir, len, "%s%s", mount, rel);
+	return true;
+}
+
+/*
+ *  stress_cgroup_controllers()
+ *	enable the controllers in the subtree of a group, one at a
+ *	time so a missing controller does not stop the others
+ */
+static void stress_cgroup_controllers(const char *dir)
+{
+	static const char * const controllers[] = {
+		"cpu", "memory", "io", "pids",
+	};
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(controllers); i++) {
+		char ctrl[16];
+		int ret;
+
+		(void)snprintf(ctrl, sizeof(ctrl), "+%s", controllers[i]);
+		ret = stress_cgroup_write(dir, "cgroup.subtree_control", ctrl);
+		if (ret < 0)
+			pr_dbg("cgroup: cannot enable %s controller in %s, errno=%d (%s)\n",
+				controllers[i], dir, -ret, strerror(-ret));
+	}
+}
+
+/*
+ *  stress_cgroup_limit()
+ *	write a limit to a stressor group
+ */
+static void stress_cgroup_limit(const char *dir, const char *file, const char *limit)
+{
+	int ret;
+
+	if (!limit)
+		return;
+	ret = stress_cgroup_write(dir, file, limit);
+	if (ret < 0)
+		pr_inf("cgroup: cannot set %s to '%s' in %s, errno=%d (%s)\n",
+			file, limit, dir, -ret, strerror(-ret));
+}
+
+/*
+ *  stress_cgroup_start()
+ *	make a stress-ng-PID group under our own cgroup with
+ *	one child group per stressor and apply the limits
+ */
+void stress_cgroup_start(stress_stressor_t *stressors_list)
+{
+	char own[PATH_MAX];
+	stress_stressor_t *ss;
+	size_t n = 0;
+
+	if (!cgroup_enabled)
+		return;
+	if (!stress_cgroup_mount(own, sizeof(own))) {
+		pr_inf("cgroup: cannot find a cgroup v2 hierarchy, disabling cgroup grouping\n");
+		return;
+	}
+	(void)snprintf(cgroup_base, sizeof(cgroup_base), "%s/stress-ng-%d", own, (int)getpid());
+	if (mkdir(cgroup_base, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) < 0) {
+		pr_inf("cgroup: cannot create %s, errno=%d (%s), disabling cgroup grouping\n",
+			cgroup_base, errno, strerror(errno));
+		*cgroup_base = '\0';
+		return;
+	}
+	stress_cgroup_controllers(own);
+	stress_cgroup_controllers(cgroup_base);
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		n++;
+	cgroups = calloc(n ? n : 1, sizeof(*cgroups));
+	if (!cgroups) {
+		pr_inf("cgroup: cannot allocate %zu cgroup entries, disabling cgroup grouping\n", n);
+		(void)rmdir(cgroup_base);
+		*cgroup_base = '\0';
+		return;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = &cgroups[cgroups_n];
+		const char *name = stress_munge_underscore(ss->stressor->name);
+		int i;
+
+		/* the same stressor may appear more than once in a job */
+		(void)snprintf(cg->path, sizeof(cg->path), "%s/%s", cgroup_base, name);
+		for (i = 1; (mkdir(cg->path, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) < 0); i++) {
+			if ((errno != EEXIST) || (i > 64)) {
+				pr_inf("cgroup: cannot create %s, errno=%d (%s)\n",
+					cg->path, errno, strerror(errno));
+				*cg->path = '\0';
+				break;
+			}
+			(void)snprintf(cg->path, sizeof(cg->path), "%s/%s-%d", cgroup_base, name, i);
+		}
+		if (!*cg->path)
+			continue;
+		cg->ss = ss;
+		cgroups_n++;
+
+		stress_cgroup_limit(cg->path, "cpu.max", cgroup_cpu_max);
+		stress_cgroup_limit(cg->path, "memory.high", cgroup_memory_high);
+		stress_cgroup_limit(cg->path, "io.max", cgroup_io_max);
+	}
+	pr_dbg("cgroup: %zu stressor groups in %s\n", cgroups_n, cgroup_base);
+}
+
+/*
+ *  stress_cgroup_join()
+ *	move the calling stressor instance into the group of
+ *	its stressor, its children inherit the group
+ */
+void stress_cgroup_join(const stress_stressor_t *ss)
+{
+	char pid[32];
+	size_t i;
+
+	for (i = 0; i < cgroups_n; i++) {
+		if (cgroups[i].ss == ss) {
+			int ret;
+
+			(void)snprintf(pid, sizeof(pid), "%d", (int)getpid());
+			ret = stress_cgroup_write(cgroups[i].path, "cgroup.procs", pid);
+			if (ret < 0)
+				pr_dbg("cgroup: cannot move pid %s into %s, errno=%d (%s)\n",
+					pid, cgroups[i].path, -ret, strerror(-ret));
+			return;
+		}
+	}
+}
+
+/*
+ *  stress_cgroup_pressure()
+ *	percentage of the run time at least one task of the
+ *	group stalled on a resource, -1 if it is not available
+ */
+static double stress_cgroup_pressure(const char *dir, const char *file, const double duration)
+{
+	char buf[512];
+	const char *ptr;
+
+	if ((duration <= 0.0) || (stress_cgroup_read(dir, file, buf, sizeof(buf)) <= 0))
+		return -1.0;
+	if (strncmp(buf, "some ", 5))
+		return -1.0;
+	ptr = strstr(buf, "total=");
+	if (!ptr)
+		return -1.0;
+	return 100.0 * ((double)strtoull(ptr + 6, NULL, 10) / 1000000.0) / duration;
+}
+
+/*
+ *  stress_cgroup_io()
+ *	sum the io.stat counters of all the devices
+ */
+static void stress_cgroup_io(const char *dir, uint64_t *rbytes, uint64_t *wbytes,
+	uint64_t *rios, uint64_t *wios)
+{
+	static const char * const keys[] = { "rbytes=", "wbytes=", "rios=", "wios=" };
+	uint64_t * const vals[] = { rbytes, wbytes, rios, wios };
+	char buf[8192], *line, *save = NULL;
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(vals); i++)
+		*vals[i] = 0;
+	if (stress_cgroup_read(dir, "io.stat", buf, sizeof(buf)) <= 0)
+		return;
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		for (i = 0; i < SIZEOF_ARRAY(keys); i++) {
+			const char *ptr = strstr(line, keys[i]);
+
+			if (ptr)
+				*vals[i] += (uint64_t)strtoull(ptr + strlen(keys[i]), NULL, 10);
+		}
+	}
+}
+
+/*
+ *  stress_cgroup_dump()
+ *	report the cpu, memory, pressure and io accounting of
+ *	each stressor group
+ */
+void stress_cgroup_dump(FILE *yaml, const double duration)
+{
+	size_t i;
+
+	if (!cgroups_n)
+		return;
+
+	pr_inf("cgroup accounting per stressor:\n");
+	pr_yaml(yaml, "cgroups:\n");
+	for (i = 0; i < cgroups_n; i++) {
+		const stress_cgroup_t *cg = &cgroups[i];
+		const char *name = stress_munge_underscore(cg->ss->stressor->name);
+		char buf[8192];
+		int64_t usage = -1, user = -1, sys = -1, nr_throttled = -1, throttled = -1;
+		int64_t anon = -1, file = -1, kernel = -1, pgfault = -1, pgmajfault = -1;
+		int64_t peak = -1, high = -1, oom_kill = -1;
+		uint64_t rbytes, wbytes, rios, wios;
+		double cpu_psi, mem_psi, io_psi;
+
+		if (stress_cgroup_read(cg->path, "cpu.stat", buf, sizeof(buf)) > 0) {
+			usage = stress_cgroup_field(buf, "usage_usec");
+			user = stress_cgroup_field(buf, "user_usec");
+			sys = stress_cgroup_field(buf, "system_usec");
+			nr_throttled = stress_cgroup_field(buf, "nr_throttled");
+			throttled = stress_cgroup_field(buf, "throttled_usec");
+		}
+		if (stress_cgroup_read(cg->path, "memory.stat", buf, sizeof(buf)) > 0) {
+			anon = stress_cgroup_field(buf, "anon");
+			file = stress_cgroup_field(buf, "file");
+			kernel = stress_cgroup_field(buf, "kernel");
+			pgfault = stress_cgroup_field(buf, "pgfault");
+			pgmajfault = stress_cgroup_field(buf, "pgmajfault");
+		}
+		if (stress_cgroup_read(cg->path, "memory.peak", buf, sizeof(buf)) > 0)
+			peak = (int64_t)strtoull(buf, NULL, 10);
+		if (stress_cgroup_read(cg->path, "memory.events", buf, sizeof(buf)) > 0) {
+			high = stress_cgroup_field(buf, "high");
+			oom_kill = stress_cgroup_field(buf, "oom_kill");
+		}
+		cpu_psi = stress_cgroup_pressure(cg->path, "cpu.pressure", duration);
+		mem_psi = stress_cgroup_pressure(cg->path, "memory.pressure", duration);
+		io_psi = stress_cgroup_pressure(cg->path, "io.pressure", duration);
+		stress_cgroup_io(cg->path, &rbytes, &wbytes, &rios, &wios);
+
+		pr_inf("  %s:\n", name);
+		if (usage >= 0) {
+			pr_inf("    cpu: %.2fs usage, %.2fs user, %.2fs system\n",
+				(double)usage / 1000000.0, (double)user / 1000000.0,
+				(double)sys / 1000000.0);
+		}
+		if (nr_throttled >= 0) {
+			pr_inf("    cpu throttled: %" PRId64 " times, %.2fs\n",
+				nr_throttled, (double)throttled / 1000000.0);
+		}
+		if (anon >= 0) {
+			pr_inf("    memory: %" PRId64 "K anon, %" PRId64 "K file, %" PRId64 "K kernel\n",
+				anon / 1024, file / 1024, kernel >= 0 ? kernel / 1024 : 0);
+			pr_inf("    faults: %" PRId64 " minor, %" PRId64 " major\n",
+				pgfault - pgmajfault, pgmajfault);
+		}
+		if (peak >= 0)
+			pr_inf("    memory peak: %" PRId64 "K\n", peak / 1024);
+		if (high >= 0) {
+			pr_inf("    memory events: %" PRId64 " high, %" PRId64 " oom kill\n",
+				high, oom_kill >= 0 ? oom_kill : 0);
+		}
+		if ((cpu_psi >= 0.0) || (mem_psi >= 0.0) || (io_psi >= 0.0)) {
+			pr_inf("    pressure: %.2f%% cpu, %.2f%% memory, %.2f%% io stalled\n",
+				cpu_psi >= 0.0 ? cpu_psi : 0.0,
+				mem_psi >= 0.0 ? mem_psi : 0.0,
+				io_psi >= 0.0 ? io_psi : 0.0);
+		}
+		pr_inf("    io: %" PRIu64 " bytes read, %" PRIu64 " bytes written, "
+			"%" PRIu64 " reads, %" PRIu64 " writes\n",
+			rbytes, wbytes, rios, wios);
+
+		pr_yaml(yaml, "    - stressor: %s\n", name);
+		if (usage >= 0) {
+			pr_yaml(yaml, "      cpu-usage: %f\n", (double)usage / 1000000.0);
+			pr_yaml(yaml, "      cpu-user: %f\n", (double)user / 1000000.0);
+			pr_yaml(yaml, "      cpu-system: %f\n", (double)sys / 1000000.0);
+		}
+		if (nr_throttled >= 0) {
+			pr_yaml(yaml, "      cpu-nr-throttled: %" PRId64 "\n", nr_throttled);
+			pr_yaml(yaml, "      cpu-throttled: %f\n", (double)throttled / 1000000.0);
+		}
+		if (anon >= 0) {
+			pr_yaml(yaml, "      memory-anon: %" PRId64 "\n", anon);
+			pr_yaml(yaml, "      memory-file: %" PRId64 "\n", file);
+			if (kernel >= 0)
+				pr_yaml(yaml, "      memory-kernel: %" PRId64 "\n", kernel);
+			pr_yaml(yaml, "      page-faults: %" PRId64 "\n", pgfault);
+			pr_yaml(yaml, "      major-page-faults: %" PRId64 "\n", pgmajfault);
+		}
+		if (peak >= 0)
+			pr_yaml(yaml, "      memory-peak: %" PRId64 "\n", peak);
+		if (high >= 0)
+			pr_yaml(yaml, "      memory-high-events: %" PRId64 "\n", high);
+		if (oom_kill >= 0)
+			pr_yaml(yaml, "      memory-oom-kills: %" PRId64 "\n", oom_kill);
+		if (cpu_psi >= 0.0)
+			pr_yaml(yaml, "      cpu-pressure-percent: %f\n", cpu_psi);
+		if (mem_psi >= 0.0)
+			pr_yaml(yaml, "      memory-pressure-percent: %f\n", mem_psi);
+		if (io_psi >= 0.0)
+			pr_yaml(yaml, "      io-pressure-percent: %f\n", io_psi);
+		pr_yaml(yaml, "      io-read-bytes: %" PRIu64 "\n", rbytes);
+		pr_yaml(yaml, "      io-write-bytes: %" PRIu64 "\n", wbytes);
+		pr_yaml(yaml, "      io-reads: %" PRIu64 "\n", rios);
+		pr_yaml(yaml, "      io-writes: %" PRIu64 "\n", wios);
+	}
+}
+
+/*
+ *  stress_cgroup_stop()
+ *	remove the stressor groups and the stress-ng-PID group,
+ *	the stressors have all been reaped so they are empty
+ */
+void stress_cgroup_stop(void)
+{
+	size_t i;
+
+	for (i = 0; i < cgroups_n; i++) {
+		if (rmdir(cgroups[i].path) < 0)
+			pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+				cgroups[i].path, errno, strerror(errno));
+	}
+	free(cgroups);
+	cgroups = NULL;
+	cgroups_n = 0;
+	if (*cgroup_base) {
+		if (rmdir(cgroup_base) < 0)
+			pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+				cgroup_base, errno, strerror(errno));
+		*cgroup_base = '\0';
+	}
+}
+
+#else
+
+void stress_cgroup_start(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	if (cgroup_enabled)
+		pr_inf("cgroup: cgroup grouping is only available on Linux\n");
+}
+
+void stress_cgroup_join(const stress_stressor_t *ss)
+{
+	(void)ss;
+}
+
+void stress_cgroup_dump(FILE *yaml, const double duration)
+{
+	(void)yaml;
+	(void)duration;
+}
+
+void stress_cgroup_stop(void)
+{
+}
+
+#endif
@@ -33,6 +33,9 @@
 #define CPUID_clflushopt	(1U << 23)	/* EAX=0x7, ECX=0x0, -> EBX */
 #define CPUID_clwb		(1U << 24)	/* EAX=0x7, ECX=0x0, -> EBX */
 #define CPUID_cldemote		(1U << 25)	/* EAX=0x7, ECX=00x, -> ECX */
+#define CPUID_amx_bf16		(1U << 22)	/* EAX=0x7, ECX=0x0, -> EDX */
+#define CPUID_amx_tile		(1U << 24)	/* EAX=0x7, ECX=0x0, -> EDX */
+#define CPUID_amx_int8		(1U << 25)	/* EAX=0x7, ECX=0x0, -> EDX */
 #define CPUID_syscall		(1U << 11)	/* EAX=0x80000001  -> EDX */
 
 /*
@@ -227,6 +230,40 @@ bool stress_cpu_x86_has_msr(void)
 #endif
 }
 
+bool stress_cpu_x86_has_amx_int8(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_cpu_x86_extended_features(&ebx, &ecx, &edx);
+
+	return (edx & (CPUID_amx_tile | CPUID_amx_int8)) ==
+		(CPUID_amx_tile | CPUID_amx_int8);
+#else
+	return false;
+#endif
+}
+
+bool stress_cpu_x86_has_amx_bf16(void)
+{
+#if defined(STRESS_ARCH_X86)
+	uint32_t ebx = 0, ecx = 0, edx = 0;
+
+	if (!stress_cpu_is_x86())
+		return false;
+
+	stress_cpu_x86_extended_features(&ebx, &ecx, &edx);
+
+	return (edx & (CPUID_amx_tile | CPUID_amx_bf16)) ==
+		(CPUID_amx_tile | CPUID_amx_bf16);
+#else
+	return false;
+#endif
+}
+
 bool stress_cpu_x86_has_clfsh(void)
 {
 #if defined(STRESS_ARCH_X86)
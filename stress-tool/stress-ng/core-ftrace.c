@@ -24,38 +24,13 @@
  */
 #include "stress-ng.h"
 
-#if defined(HAVE_LIB_BSD) &&	\
-    defined(__linux__)
+#if defined(__linux__)
 
 #define MAX_MOUNTS	(256)
 #if !defined(DEBUGFS_MAGIC)
 #define DEBUGFS_MAGIC	(0x64626720)
 #endif
 
-struct rb_node {
-	RB_ENTRY(rb_node) rb;	/* red/black node entry */
-	char *func_name;	/* ftrace'd kernel function name */
-	int64_t start_count;	/* start number of calls to func */
-	int64_t end_count;	/* end number of calls to func */
-	double	start_time_us;	/* start time used by func in microsecs */
-	double	end_time_us;	/* end time used by func microsecs */
-};
-
-static bool tracing_enabled;
-
-/*
- *  rb_node_cmp()
- *	used for sorting functions by name
- */
-static int rb_node_cmp(struct rb_node *n1, struct rb_node *n2)
-{
-	return strcmp(n1->func_name, n2->func_name);
-}
-
-static RB_HEAD(rb_tree, rb_node) rb_root;
-RB_PROTOTYPE(rb_tree, rb_node, rb, rb_node_cmp);
-RB_GENERATE(rb_tree, rb_node, rb, rb_node_cmp);
-
 /*
  *  stress_ftrace_get_debugfs_path()
  *	find debugfs mount path, returns NULL if not found
@@ -89,6 +64,695 @@ static char *stress_ftrace_get_debugfs_path(void)
 	return NULL;
 }
 
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open)
+#define STRESS_FTRACE_LATENCY
+
+#define FTRACE_LAT_PIDS		(4096)	/* stressor instance pids */
+#define FTRACE_LAT_TIDS		(65536)	/* threads with a system call pending, power of 2 */
+#define FTRACE_LAT_STATS	(8192)	/* instance and system call pairs, power of 2 */
+#define FTRACE_LAT_BUCKETS	(320)	/* 8 buckets per power of 2 nanoseconds */
+#define FTRACE_LAT_NR_MAX	(1024)	/* system call numbers reported */
+#define FTRACE_LAT_TOP		(10)	/* system calls reported per stressor */
+#define FTRACE_LAT_RING_PAGES	(64)	/* data pages per CPU, power of 2 */
+
+#define FTRACE_LAT_NONE		(0)
+#define FTRACE_LAT_ENTER	(1)
+#define FTRACE_LAT_EXIT		(2)
+
+typedef struct {
+	const long nr;
+	const char *name;
+} stress_syscall_name_t;
+
+static const stress_syscall_name_t syscall_names[] = {
+#include "syscall-names.h"
+};
+
+/* Pids of the stressor instances, shared with the collector */
+typedef struct {
+	uint32_t n;
+	struct {
+		pid_t pid;
+		char name[32];
+	} pids[FTRACE_LAT_PIDS];
+} stress_ftrace_pids_t;
+
+/* The pending system call and instance of a thread */
+typedef struct {
+	int32_t tid;
+	int32_t group;		/* instance pid, 0 if not a stressor */
+	int state;		/* FTRACE_LAT_ENTER or FTRACE_LAT_EXIT seen */
+	long nr;
+	uint64_t ts;
+} stress_ftrace_tid_t;
+
+/* Latency histogram of one system call of one instance */
+typedef struct {
+	int32_t group;
+	long nr;
+	uint64_t calls;
+	uint64_t max_ns;
+	double total_ns;
+	uint32_t buckets[FTRACE_LAT_BUCKETS];
+} stress_ftrace_stat_t;
+
+typedef struct {
+	int fd;
+	void *ring;
+} stress_ftrace_cpu_t;
+
+static stress_ftrace_pids_t *ftrace_pids;
+static pid_t ftrace_lat_pid;
+static volatile bool ftrace_lat_run;
+
+static stress_ftrace_tid_t *ftrace_tids;
+static uint32_t ftrace_tids_used;
+static stress_ftrace_stat_t **ftrace_stats;
+static uint32_t ftrace_stats_used;
+static pid_t ftrace_main_pid;
+
+static void MLOCKED_TEXT stress_ftrace_lat_handler(int signum)
+{
+	(void)signum;
+
+	ftrace_lat_run = false;
+}
+
+/*
+ *  stress_ftrace_lat_add_pid()
+ *	note the stressor of a new instance pid
+ */
+static void stress_ftrace_lat_add_pid(const pid_t pid)
+{
+	const uint32_t n = ftrace_pids ? ftrace_pids->n : FTRACE_LAT_PIDS;
+
+	if ((pid <= 0) || (n >= FTRACE_LAT_PIDS))
+		return;
+	ftrace_pids->pids[n].pid = pid;
+	(void)shim_strlcpy(ftrace_pids->pids[n].name, g_stressor_current ?
+		stress_munge_underscore(g_stressor_current->stressor->name) : "unknown",
+		sizeof(ftrace_pids->pids[n].name));
+	__atomic_store_n(&ftrace_pids->n, n + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  stress_ftrace_lat_ppid()
+ *	parent pid of pid, -1 if it has gone
+ */
+static pid_t stress_ftrace_lat_ppid(const pid_t pid)
+{
+	char path[64], buf[512];
+	const char *ptr;
+	int ppid;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return -1;
+	buf[sizeof(buf) - 1] = '\0';
+	/* The comm field can contain spaces, skip past it */
+	ptr = strrchr(buf, ')');
+	if (!ptr || (sscanf(ptr + 1, " %*c %d", &ppid) != 1))
+		return -1;
+	return (pid_t)ppid;
+}
+
+/*
+ *  stress_ftrace_lat_group()
+ *	the stressor instance a process belongs to, this is the
+ *	ancestor forked by the main stress-ng process, returns 0
+ *	if it is not a stress-ng process or it has already gone
+ */
+static int32_t stress_ftrace_lat_group(const pid_t pid)
+{
+	pid_t p = pid;
+	int depth;
+
+	if (pid == getpid())
+		return 0;
+	for (depth = 0; depth < 16; depth++) {
+		const pid_t ppid = stress_ftrace_lat_ppid(p);
+
+		if (p == ftrace_main_pid)
+			return (int32_t)p;
+		if (ppid == ftrace_main_pid)
+			return (int32_t)p;
+		if (ppid <= 1)
+			return 0;
+		p = ppid;
+	}
+	return 0;
+}
+
+/*
+ *  stress_ftrace_lat_tid()
+ *	find or add the pending system call entry of a thread
+ */
+static stress_ftrace_tid_t *stress_ftrace_lat_tid(const int32_t pid, const int32_t tid)
+{
+	uint32_t i, h = ((uint32_t)tid * 2654435761U) & (FTRACE_LAT_TIDS - 1);
+
+	for (i = 0; i < FTRACE_LAT_TIDS; i++, h = (h + 1) & (FTRACE_LAT_TIDS - 1)) {
+		stress_ftrace_tid_t *t = &ftrace_tids[h];
+
+		if (t->tid == tid)
+			return t;
+		if (t->tid == 0)
+			break;
+	}
+	/* Forget all the threads when three quarters full */
+	if (ftrace_tids_used >= (FTRACE_LAT_TIDS / 4) * 3) {
+		(void)memset(ftrace_tids, 0, sizeof(*ftrace_tids) * FTRACE_LAT_TIDS);
+		ftrace_tids_used = 0;
+		return stress_ftrace_lat_tid(pid, tid);
+	}
+	ftrace_tids_used++;
+	ftrace_tids[h].tid = tid;
+	ftrace_tids[h].group = stress_ftrace_lat_group((pid_t)pid);
+	ftrace_tids[h].state = FTRACE_LAT_NONE;
+	return &ftrace_tids[h];
+}
+
+/*
+ *  stress_ftrace_lat_record()
+ *	add a system call latency to the histogram of its instance
+ */
+static void stress_ftrace_lat_record(const int32_t group, const long nr, const uint64_t ns)
+{
+	uint32_t i, h = (((uint32_t)group * 2654435761U) ^ (uint32_t)nr) & (FTRACE_LAT_STATS - 1);
+	stress_ftrace_stat_t *st = NULL;
+	int b;
+
+	for (i = 0; i < FTRACE_LAT_STATS; i++, h = (h + 1) & (FTRACE_LAT_STATS - 1)) {
+		st = ftrace_stats[h];
+		if (!st)
+			break;
+		if ((st->group == group) && (st->nr == nr))
+			break;
+		st = NULL;
+	}
+	if (!st) {
+		if ((i == FTRACE_LAT_STATS) || (ftrace_stats_used >= (FTRACE_LAT_STATS / 4) * 3))
+			return;
+		st = calloc(1, sizeof(*st));
+		if (!st)
+			return;
+		st->group = group;
+		st->nr = nr;
+		ftrace_stats[h] = st;
+		ftrace_stats_used++;
+	}
+	b = (ns > 1) ? (int)(8.0 * log2((double)ns)) : 0;
+	if (b >= FTRACE_LAT_BUCKETS)
+		b = FTRACE_LAT_BUCKETS - 1;
+	st->buckets[b]++;
+	st->calls++;
+	st->total_ns += (double)ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+}
+
+/*
+ *  stress_ftrace_lat_sample()
+ *	pair up the enter and exit of a system call, the two can
+ *	arrive out of order when a thread migrates CPU in a call
+ */
+static void stress_ftrace_lat_sample(
+	const int32_t pid,
+	const int32_t tid,
+	const uint64_t ts,
+	const bool enter,
+	const long nr)
+{
+	stress_ftrace_tid_t *t = stress_ftrace_lat_tid(pid, tid);
+
+	if (!t->group)
+		return;
+	if (enter) {
+		if ((t->state == FTRACE_LAT_EXIT) && (t->nr == nr) && (t->ts >= ts)) {
+			stress_ftrace_lat_record(t->group, nr, t->ts - ts);
+			t->state = FTRACE_LAT_NONE;
+			return;
+		}
+		t->state = FTRACE_LAT_ENTER;
+	} else {
+		if ((t->state == FTRACE_LAT_ENTER) && (t->nr == nr) && (ts >= t->ts)) {
+			stress_ftrace_lat_record(t->group, nr, ts - t->ts);
+			t->state = FTRACE_LAT_NONE;
+			return;
+		}
+		t->state = FTRACE_LAT_EXIT;
+	}
+	t->nr = nr;
+	t->ts = ts;
+}
+
+/*
+ *  stress_ftrace_lat_drain()
+ *	consume the samples in the ring of one CPU
+ */
+static void stress_ftrace_lat_drain(
+	const stress_ftrace_cpu_t *cpu,
+	const size_t page_size,
+	const uint16_t enter_id,
+	uint64_t *lost)
+{
+	struct perf_event_mmap_page *mp = (struct perf_event_mmap_page *)cpu->ring;
+	const uint8_t *data = (const uint8_t *)cpu->ring + page_size;
+	const uint64_t size = FTRACE_LAT_RING_PAGES * page_size;
+	const uint64_t head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+	uint64_t tail = mp->data_tail;
+
+	while (tail < head) {
+		uint8_t buf[256];
+		const struct perf_event_header *hdr;
+		const uint64_t off = tail % size;
+		uint16_t rec_size;
+
+		hdr = (const struct perf_event_header *)(data + off);
+		rec_size = hdr->size;
+		if (rec_size < sizeof(*hdr))
+			break;
+		if (off + rec_size > size) {
+			/* Record wraps around the end of the ring */
+			const size_t len = STRESS_MINIMUM((size_t)rec_size, sizeof(buf));
+			const size_t first = (size_t)(size - off);
+
+			(void)memcpy(buf, data + off, STRESS_MINIMUM(first, len));
+			if (len > first)
+				(void)memcpy(buf + first, data, len - first);
+			hdr = (const struct perf_event_header *)buf;
+		}
+
+		if (hdr->type == PERF_RECORD_SAMPLE) {
+			/* pid, tid, time, raw size then the tracepoint data */
+			const uint8_t *ptr = (const uint8_t *)(hdr + 1);
+			uint32_t pid, tid, raw_size;
+			uint64_t ts;
+			uint16_t type;
+			long nr;
+
+			(void)memcpy(&pid, ptr, sizeof(pid));
+			(void)memcpy(&tid, ptr + 4, sizeof(tid));
+			(void)memcpy(&ts, ptr + 8, sizeof(ts));
+			(void)memcpy(&raw_size, ptr + 16, sizeof(raw_size));
+			if (raw_size >= 8 + sizeof(nr)) {
+				(void)memcpy(&type, ptr + 20, sizeof(type));
+				(void)memcpy(&nr, ptr + 28, sizeof(nr));
+				if (nr >= 0)
+					stress_ftrace_lat_sample((int32_t)pid, (int32_t)tid,
+						ts, type == enter_id, nr);
+			}
+		} else if (hdr->type == PERF_RECORD_LOST) {
+			uint64_t n;
+
+			(void)memcpy(&n, (const uint8_t *)(hdr + 1) + sizeof(uint64_t), sizeof(n));
+			*lost += n;
+		}
+		tail += rec_size;
+	}
+	__atomic_store_n(&mp->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+/*
+ *  stress_ftrace_lat_name()
+ *	name of system call nr
+ */
+static const char *stress_ftrace_lat_name(const long nr)
+{
+	static char buf[32];
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(syscall_names); i++) {
+		if (syscall_names[i].nr == nr)
+			return syscall_names[i].name;
+	}
+	(void)snprintf(buf, sizeof(buf), "syscall %ld", nr);
+	return buf;
+}
+
+/*
+ *  stress_ftrace_lat_percentile()
+ *	latency in microseconds below which fraction of the calls were
+ */
+static double stress_ftrace_lat_percentile(const stress_ftrace_stat_t *st, const double fraction)
+{
+	const uint64_t target = (uint64_t)(fraction * (double)st->calls);
+	uint64_t sum = 0;
+	int b;
+
+	for (b = 0; b < FTRACE_LAT_BUCKETS; b++) {
+		sum += st->buckets[b];
+		if (sum > target)
+			break;
+	}
+	if (b == FTRACE_LAT_BUCKETS)
+		return (double)st->max_ns / 1000.0;
+	/* Geometric middle of the bucket */
+	return STRESS_MINIMUM(pow(2.0, ((double)b + 0.5) / 8.0),
+		(double)st->max_ns) / 1000.0;
+}
+
+static int stress_ftrace_lat_cmp(const void *p1, const void *p2)
+{
+	const stress_ftrace_stat_t *s1 = *(const stress_ftrace_stat_t * const *)p1;
+	const stress_ftrace_stat_t *s2 = *(const stress_ftrace_stat_t * const *)p2;
+
+	if (s1->total_ns < s2->total_ns)
+		return 1;
+	return (s1->total_ns > s2->total_ns) ? -1 : 0;
+}
+
+/*
+ *  stress_ftrace_lat_stressor()
+ *	name of the stressor of an instance
+ */
+static const char *stress_ftrace_lat_stressor(const int32_t group)
+{
+	const uint32_t n = __atomic_load_n(&ftrace_pids->n, __ATOMIC_ACQUIRE);
+	uint32_t i;
+
+	if (group == (int32_t)ftrace_main_pid)
+		return "stress-ng";
+	for (i = 0; i < n; i++) {
+		if (ftrace_pids->pids[i].pid == (pid_t)group)
+			return ftrace_pids->pids[i].name;
+	}
+	return "other";
+}
+
+/*
+ *  stress_ftrace_lat_report()
+ *	report the system calls that took the most time in each
+ *	stressor, summed over its instances
+ */
+static void stress_ftrace_lat_report(const uint64_t lost)
+{
+	stress_ftrace_stat_t *merged, **top;
+	const char *names[FTRACE_LAT_PIDS];
+	uint32_t i, j, n_names = 0;
+
+	merged = calloc(FTRACE_LAT_NR_MAX, sizeof(*merged));
+	top = calloc(FTRACE_LAT_NR_MAX, sizeof(*top));
+	if (!merged || !top)
+		goto out;
+
+	for (i = 0; i < FTRACE_LAT_STATS; i++) {
+		const char *name;
+
+		if (!ftrace_stats[i])
+			continue;
+		name = stress_ftrace_lat_stressor(ftrace_stats[i]->group);
+		for (j = 0; j < n_names; j++) {
+			if (!strcmp(names[j], name))
+				break;
+		}
+		if ((j == n_names) && (n_names < FTRACE_LAT_PIDS))
+			names[n_names++] = name;
+	}
+
+	for (j = 0; j < n_names; j++) {
+		uint32_t n_top = 0;
+		bool lock = false;
+
+		(void)memset(merged, 0, FTRACE_LAT_NR_MAX * sizeof(*merged));
+		for (i = 0; i < FTRACE_LAT_STATS; i++) {
+			const stress_ftrace_stat_t *st = ftrace_stats[i];
+			stress_ftrace_stat_t *m;
+			int b;
+
+			if (!st || (st->nr >= FTRACE_LAT_NR_MAX) ||
+			    strcmp(stress_ftrace_lat_stressor(st->group), names[j]))
+				continue;
+			m = &merged[st->nr];
+			m->nr = st->nr;
+			m->calls += st->calls;
+			m->total_ns += st->total_ns;
+			m->max_ns = STRESS_MAXIMUM(m->max_ns, st->max_ns);
+			for (b = 0; b < FTRACE_LAT_BUCKETS; b++)
+				m->buckets[b] += st->buckets[b];
+		}
+		for (i = 0; i < FTRACE_LAT_NR_MAX; i++) {
+			if (merged[i].calls)
+				top[n_top++] = &merged[i];
+		}
+		qsort(top, n_top, sizeof(*top), stress_ftrace_lat_cmp);
+
+		pr_lock(&lock);
+		pr_inf_lock(&lock, "ftrace: %s: %-20.20s %12s %12s %10s %10s %10s %10s\n",
+			names[j], "System Call", "Calls", "Total ms", "p50 us",
+			"p90 us", "p99 us", "Max us");
+		for (i = 0; (i < n_top) && (i < FTRACE_LAT_TOP); i++) {
+			const stress_ftrace_stat_t *m = top[i];
+
+			pr_inf_lock(&lock, "ftrace: %s: %-20.20s %12" PRIu64 " %12.3f "
+				"%10.2f %10.2f %10.2f %10.2f\n", names[j],
+				stress_ftrace_lat_name(m->nr), m->calls,
+				m->total_ns / 1000000.0,
+				stress_ftrace_lat_percentile(m, 0.50),
+				stress_ftrace_lat_percentile(m, 0.90),
+				stress_ftrace_lat_percentile(m, 0.99),
+				(double)m->max_ns / 1000.0);
+		}
+		pr_unlock(&lock);
+	}
+	if (lost)
+		pr_inf("ftrace: %" PRIu64 " system call samples were lost, "
+			"latencies are from the remainder\n", lost);
+out:
+	free(top);
+	free(merged);
+}
+
+/*
+ *  stress_ftrace_lat_id()
+ *	read the id of a raw_syscalls tracepoint
+ */
+static int stress_ftrace_lat_id(const char *event)
+{
+	static const char *tracefs[] = {
+		"/sys/kernel/tracing",
+		NULL,		/* debugfs tracing directory */
+	};
+	char path[PATH_MAX], buf[32];
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(tracefs); i++) {
+		const char *debugfs = stress_ftrace_get_debugfs_path();
+
+		if (tracefs[i]) {
+			(void)snprintf(path, sizeof(path), "%s/events/raw_syscalls/%s/id",
+				tracefs[i], event);
+		} else if (debugfs) {
+			(void)snprintf(path, sizeof(path), "%s/tracing/events/raw_syscalls/%s/id",
+				debugfs, event);
+		} else {
+			continue;
+		}
+		(void)memset(buf, 0, sizeof(buf));
+		if (system_read(path, buf, sizeof(buf) - 1) > 0)
+			return atoi(buf);
+	}
+	return -1;
+}
+
+/*
+ *  stress_ftrace_lat_collect()
+ *	the collector, sample the raw_syscalls tracepoints on every
+ *	CPU until told to stop, then report
+ */
+static void stress_ftrace_lat_collect(const int enter_id, const int exit_id, const int ready_fd)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t ring_size = (FTRACE_LAT_RING_PAGES + 1) * page_size;
+	const int32_t cpus = stress_get_processors_configured();
+	stress_ftrace_cpu_t *cpu;
+	struct pollfd *pfds;
+	uint64_t lost = 0;
+	int32_t i, n = 0;
+	bool ok;
+
+	cpu = calloc((size_t)cpus, sizeof(*cpu));
+	pfds = calloc((size_t)cpus, sizeof(*pfds));
+	ftrace_tids = calloc(FTRACE_LAT_TIDS, sizeof(*ftrace_tids));
+	ftrace_stats = calloc(FTRACE_LAT_STATS, sizeof(*ftrace_stats));
+	if (!cpu || !pfds || !ftrace_tids || !ftrace_stats) {
+		pr_inf("ftrace: out of memory, cannot collect system call latencies\n");
+		goto done;
+	}
+
+	for (i = 0; i < cpus; i++) {
+		struct perf_event_attr attr;
+		int fd, exit_fd;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_TRACEPOINT;
+		attr.size = sizeof(attr);
+		attr.config = (uint64_t)enter_id;
+		attr.sample_period = 1;
+		attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_RAW;
+		attr.disabled = 1;
+		attr.watermark = 1;
+		attr.wakeup_watermark = (uint32_t)(FTRACE_LAT_RING_PAGES * page_size / 4);
+
+		fd = (int)syscall(__NR_perf_event_open, &attr, -1, i, -1, 0);
+		if (fd < 0)
+			continue;	/* offline CPU */
+		attr.config = (uint64_t)exit_id;
+		exit_fd = (int)syscall(__NR_perf_event_open, &attr, -1, i, fd, 0);
+		if (exit_fd < 0) {
+			(void)close(fd);
+			continue;
+		}
+		cpu[n].ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+		if (cpu[n].ring == MAP_FAILED) {
+			(void)close(exit_fd);
+			(void)close(fd);
+			continue;
+		}
+		/* Both tracepoints share the ring of the CPU */
+		(void)ioctl(exit_fd, PERF_EVENT_IOC_SET_OUTPUT, fd);
+		(void)ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		cpu[n].fd = fd;
+		pfds[n].fd = fd;
+		pfds[n].events = POLLIN;
+		n++;
+	}
+done:
+	ok = (n > 0);
+	if (!ok)
+		pr_inf("ftrace: cannot sample the raw_syscalls tracepoints, errno=%d (%s)\n",
+			errno, strerror(errno));
+	if (write(ready_fd, &ok, sizeof(ok)) < 0)
+		ok = false;
+	(void)close(ready_fd);
+
+	while (ok && ftrace_lat_run) {
+		(void)poll(pfds, (nfds_t)n, 100);
+		for (i = 0; i < n; i++)
+			stress_ftrace_lat_drain(&cpu[i], page_size, (uint16_t)enter_id, &lost);
+	}
+	if (ok) {
+		for (i = 0; i < n; i++) {
+			(void)ioctl(cpu[i].fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			stress_ftrace_lat_drain(&cpu[i], page_size, (uint16_t)enter_id, &lost);
+		}
+		stress_ftrace_lat_report(lost);
+	}
+	_exit(0);
+}
+
+/*
+ *  stress_ftrace_lat_start()
+ *	start the system call latency collector, the instance
+ *	pids are shared with it as they are forked
+ */
+static int stress_ftrace_lat_start(void)
+{
+	int enter_id, exit_id, fds[2];
+	bool ok = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_FTRACE_LATENCY))
+		return 0;
+	if (!stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
+		pr_inf("ftrace: requires CAP_SYS_ADMIN capability for system call latencies\n");
+		return -1;
+	}
+	enter_id = stress_ftrace_lat_id("sys_enter");
+	exit_id = stress_ftrace_lat_id("sys_exit");
+	if ((enter_id < 0) || (exit_id < 0)) {
+		pr_inf("ftrace: cannot find the raw_syscalls tracepoints, is tracefs mounted?\n");
+		return -1;
+	}
+
+	ftrace_pids = (stress_ftrace_pids_t *)mmap(NULL, sizeof(*ftrace_pids),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ftrace_pids == MAP_FAILED) {
+		ftrace_pids = NULL;
+		return -1;
+	}
+	if (pipe(fds) < 0)
+		goto unmap;
+
+	ftrace_main_pid = getpid();
+	ftrace_lat_run = true;
+	ftrace_lat_pid = fork();
+	if (ftrace_lat_pid < 0) {
+		pr_inf("ftrace: system call latency collector failed to fork, "
+			"errno=%d (%s)\n", errno, strerror(errno));
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		goto unmap;
+	} else if (ftrace_lat_pid == 0) {
+		(void)close(fds[0]);
+		stress_set_proc_name("stress-ng-ftrace");
+		if (stress_sighandler("ftrace", SIGALRM, stress_ftrace_lat_handler, NULL) < 0)
+			_exit(0);
+		stress_ftrace_lat_collect(enter_id, exit_id, fds[1]);
+	}
+	(void)close(fds[1]);
+	/* Wait for sampling to start so no stressor is missed */
+	if ((read(fds[0], &ok, sizeof(ok)) != sizeof(ok)) || !ok) {
+		(void)close(fds[0]);
+		(void)shim_waitpid(ftrace_lat_pid, NULL, 0);
+		ftrace_lat_pid = 0;
+		goto unmap;
+	}
+	(void)close(fds[0]);
+	return 0;
+unmap:
+	(void)munmap((void *)ftrace_pids, sizeof(*ftrace_pids));
+	ftrace_pids = NULL;
+	return -1;
+}
+
+/*
+ *  stress_ftrace_lat_stop()
+ *	stop the collector, it reports as it exits
+ */
+static void stress_ftrace_lat_stop(void)
+{
+	int status;
+
+	if (ftrace_lat_pid <= 0)
+		return;
+	(void)kill(ftrace_lat_pid, SIGALRM);
+	(void)shim_waitpid(ftrace_lat_pid, &status, 0);
+	ftrace_lat_pid = 0;
+	(void)munmap((void *)ftrace_pids, sizeof(*ftrace_pids));
+	ftrace_pids = NULL;
+}
+#endif
+#endif
+
+#if defined(HAVE_LIB_BSD) &&	\
+    defined(__linux__)
+
+struct rb_node {
+	RB_ENTRY(rb_node) rb;	/* red/black node entry */
+	char *func_name;	/* ftrace'd kernel function name */
+	int64_t start_count;	/* start number of calls to func */
+	int64_t end_count;	/* end number of calls to func */
+	double	start_time_us;	/* start time used by func in microsecs */
+	double	end_time_us;	/* end time used by func microsecs */
+};
+
+static bool tracing_enabled;
+
+/*
+ *  rb_node_cmp()
+ *	used for sorting functions by name
+ */
+static int rb_node_cmp(struct rb_node *n1, struct rb_node *n2)
+{
+	return strcmp(n1->func_name, n2->func_name);
+}
+
+static RB_HEAD(rb_tree, rb_node) rb_root;
+RB_PROTOTYPE(rb_tree, rb_node, rb, rb_node_cmp);
+RB_GENERATE(rb_tree, rb_node, rb, rb_node_cmp);
+
 /*
  *  stress_ftrace_free()
  *	free up rb tree
@@ -259,6 +923,9 @@ void stress_ftrace_add_pid(const pid_t pid)
 
 	if (!(g_opt_flags & OPT_FLAGS_FTRACE))
 		return;
+#if defined(STRESS_FTRACE_LATENCY)
+	stress_ftrace_lat_add_pid(pid);
+#endif
 
 	path = stress_ftrace_get_debugfs_path();
 	if (!path)
@@ -321,6 +988,10 @@ int stress_ftrace_start(void)
 
 	tracing_enabled = true;
 
+#if defined(STRESS_FTRACE_LATENCY)
+	if (stress_ftrace_lat_start() < 0)
+		return -1;
+#endif
 	return 0;
 }
 
@@ -383,6 +1054,9 @@ void stress_ftrace_stop(void)
 
 	if (!tracing_enabled)
 		return;
+#if defined(STRESS_FTRACE_LATENCY)
+	stress_ftrace_lat_stop();
+#endif
 
 	path = stress_ftrace_get_debugfs_path();
 	if (!path)
@@ -405,7 +1079,12 @@ void stress_ftrace_stop(void)
 #else
 void stress_ftrace_add_pid(const pid_t pid)
 {
+#if defined(STRESS_FTRACE_LATENCY)
+	if (g_opt_flags & OPT_FLAGS_FTRACE)
+		stress_ftrace_lat_add_pid(pid);
+#else
 	(void)pid;
+#endif
 }
 
 void stress_ftrace_free(void)
@@ -416,6 +1095,11 @@ int stress_ftrace_start(void)
 {
 	if (!(g_opt_flags & OPT_FLAGS_FTRACE))
 		return 0;
+#if defined(STRESS_FTRACE_LATENCY)
+	/* System call latencies do not need the function profiler */
+	if (g_opt_flags & OPT_FLAGS_FTRACE_LATENCY)
+		return stress_ftrace_lat_start();
+#endif
 	pr_inf("ftrace: this option is not implemented on this system: %s %s\n",
 		stress_get_uname_info(), stress_get_compiler());
 
@@ -424,5 +1108,8 @@ int stress_ftrace_start(void)
 
 void stress_ftrace_stop(void)
 {
+#if defined(STRESS_FTRACE_LATENCY)
+	stress_ftrace_lat_stop();
+#endif
 }
 #endif
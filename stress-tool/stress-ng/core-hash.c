@@ -193,6 +193,212 @@ uint32_t HOT OPTIMIZE3 stress_hash_murmur3_32(
 	return h;
 }
 
+#define XXH64_PRIME1	(0x9e3779b185ebca87ULL)
+#define XXH64_PRIME2	(0xc2b2ae3d27d4eb4fULL)
+#define XXH64_PRIME3	(0x165667b19e3779f9ULL)
+#define XXH64_PRIME4	(0x85ebca77c2b2ae63ULL)
+#define XXH64_PRIME5	(0x27d4eb2f165667c5ULL)
+
+static inline uint64_t HOT OPTIMIZE3 stress_hash_rotl64(const uint64_t v, const int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+static inline uint64_t HOT OPTIMIZE3 stress_hash_read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	(void)memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t HOT OPTIMIZE3 stress_hash_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	(void)memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t HOT OPTIMIZE3 stress_hash_xxh64_round(uint64_t acc, const uint64_t v)
+{
+	acc += v * XXH64_PRIME2;
+	acc = stress_hash_rotl64(acc, 31);
+	return acc * XXH64_PRIME1;
+}
+
+static inline uint64_t HOT OPTIMIZE3 stress_hash_xxh64_merge(uint64_t acc, const uint64_t v)
+{
+	acc ^= stress_hash_xxh64_round(0, v);
+	return acc * XXH64_PRIME1 + XXH64_PRIME4;
+}
+
+/*
+ *  stress_hash_xxh64()
+ *	64 bit xxHash by Yann Collet, four lane 32 bytes per
+ *	round variant, https://github.com/Cyan4973/xxHash,
+ *	matches the reference hash on little endian systems
+ */
+uint64_t HOT OPTIMIZE3 stress_hash_xxh64(
+	const uint8_t *data,
+	const size_t len,
+	const uint64_t seed)
+{
+	const uint8_t *end = data + len;
+	uint64_t h;
+
+	if (len >= 32) {
+		const uint8_t *limit = end - 32;
+		uint64_t v1 = seed + XXH64_PRIME1 + XXH64_PRIME2;
+		uint64_t v2 = seed + XXH64_PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH64_PRIME1;
+
+		do {
+			v1 = stress_hash_xxh64_round(v1, stress_hash_read64(data));
+			v2 = stress_hash_xxh64_round(v2, stress_hash_read64(data + 8));
+			v3 = stress_hash_xxh64_round(v3, stress_hash_read64(data + 16));
+			v4 = stress_hash_xxh64_round(v4, stress_hash_read64(data + 24));
+			data += 32;
+		} while (data <= limit);
+
+		h = stress_hash_rotl64(v1, 1) + stress_hash_rotl64(v2, 7) +
+		    stress_hash_rotl64(v3, 12) + stress_hash_rotl64(v4, 18);
+		h = stress_hash_xxh64_merge(h, v1);
+		h = stress_hash_xxh64_merge(h, v2);
+		h = stress_hash_xxh64_merge(h, v3);
+		h = stress_hash_xxh64_merge(h, v4);
+	} else {
+		h = seed + XXH64_PRIME5;
+	}
+	h += (uint64_t)len;
+
+	while (data + 8 <= end) {
+		h ^= stress_hash_xxh64_round(0, stress_hash_read64(data));
+		h = stress_hash_rotl64(h, 27) * XXH64_PRIME1 + XXH64_PRIME4;
+		data += 8;
+	}
+	if (data + 4 <= end) {
+		h ^= (uint64_t)stress_hash_read32(data) * XXH64_PRIME1;
+		h = stress_hash_rotl64(h, 23) * XXH64_PRIME2 + XXH64_PRIME3;
+		data += 4;
+	}
+	while (data < end) {
+		h ^= (uint64_t)*data++ * XXH64_PRIME5;
+		h = stress_hash_rotl64(h, 11) * XXH64_PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH64_PRIME2;
+	h ^= h >> 29;
+	h *= XXH64_PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/*
+ *  stress_hash_mum()
+ *	64 x 64 bit multiply, low 64 bits of the product
+ *	in a, high 64 bits in b
+ */
+static inline void HOT OPTIMIZE3 stress_hash_mum(uint64_t *a, uint64_t *b)
+{
+#if defined(HAVE_INT128_T)
+	const __uint128_t r = (__uint128_t)*a * *b;
+
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	const uint64_t ha = *a >> 32, hb = *b >> 32;
+	const uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	const uint64_t t = rl + (rm0 << 32);
+	uint64_t lo, c = t < rl;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t HOT OPTIMIZE3 stress_hash_mix(uint64_t a, uint64_t b)
+{
+	stress_hash_mum(&a, &b);
+	return a ^ b;
+}
+
+static const uint64_t wyhash_secret[4] = {
+	0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+	0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+};
+
+/*
+ *  stress_hash_wyhash()
+ *	64 bit wyhash (final version 4) by Wang Yi,
+ *	https://github.com/wangyi-fudan/wyhash, a multiply
+ *	and fold hash that reads 48 bytes per round
+ */
+uint64_t HOT OPTIMIZE3 stress_hash_wyhash(
+	const uint8_t *data,
+	const size_t len,
+	uint64_t seed)
+{
+	const uint64_t *s = wyhash_secret;
+	uint64_t a, b;
+
+	seed ^= stress_hash_mix(seed ^ s[0], s[1]);
+	if (LIKELY(len <= 16)) {
+		if (LIKELY(len >= 4)) {
+			const size_t off = (len >> 3) << 2;
+
+			a = ((uint64_t)stress_hash_read32(data) << 32) |
+			    stress_hash_read32(data + off);
+			b = ((uint64_t)stress_hash_read32(data + len - 4) << 32) |
+			    stress_hash_read32(data + len - 4 - off);
+		} else if (LIKELY(len > 0)) {
+			a = ((uint64_t)data[0] << 16) |
+			    ((uint64_t)data[len >> 1] << 8) | data[len - 1];
+			b = 0;
+		} else {
+			a = 0;
+			b = 0;
+		}
+	} else {
+		size_t i = len;
+
+		if (UNLIKELY(i > 48)) {
+			uint64_t see1 = seed, see2 = seed;
+
+			do {
+				seed = stress_hash_mix(stress_hash_read64(data) ^ s[1],
+					stress_hash_read64(data + 8) ^ seed);
+				see1 = stress_hash_mix(stress_hash_read64(data + 16) ^ s[2],
+					stress_hash_read64(data + 24) ^ see1);
+				see2 = stress_hash_mix(stress_hash_read64(data + 32) ^ s[3],
+					stress_hash_read64(data + 40) ^ see2);
+				data += 48;
+				i -= 48;
+			} while (LIKELY(i > 48));
+			seed ^= see1 ^ see2;
+		}
+		while (UNLIKELY(i > 16)) {
+			seed = stress_hash_mix(stress_hash_read64(data) ^ s[1],
+				stress_hash_read64(data + 8) ^ seed);
+			i -= 16;
+			data += 16;
+		}
+		a = stress_hash_read64(data + i - 16);
+		b = stress_hash_read64(data + i - 8);
+	}
+	a ^= s[1];
+	b ^= seed;
+	stress_hash_mum(&a, &b);
+
+	return stress_hash_mix(a ^ s[0] ^ (uint64_t)len, b ^ s[1]);
+}
+
 /*
  *  stress_hash_create()
  *	create a hash table with size of n base hash entries
@@ -307,3 +513,177 @@ void stress_hash_delete(stress_hash_table_t *hash_table)
 	free(hash_table->table);
 	free(hash_table);
 }
+
+#define HASH_OA_GROUP	(8)		/* slots per control word */
+#define HASH_OA_EMPTY	(0x80)		/* control byte of an empty slot */
+#define HASH_OA_LSB	(0x0101010101010101ULL)
+#define HASH_OA_MSB	(0x8080808080808080ULL)
+
+/*
+ *  stress_hash_oatable_create()
+ *	create an open addressing hash table of 64 bit keys and
+ *	values that can hold at least n entries, the slots are in
+ *	groups of 8 with a control byte per slot holding 7 bits of
+ *	the key hash so that a group is checked with a single
+ *	64 bit compare before any keys are touched
+ */
+stress_hash_oatable_t *stress_hash_oatable_create(const size_t n)
+{
+	stress_hash_oatable_t *table;
+	size_t groups = 1;
+
+	if (n == 0)
+		return NULL;
+
+	/* Keep the load at or below 7/8ths */
+	while ((groups * HASH_OA_GROUP * 7) / 8 < n) {
+		if (groups > (SIZE_MAX / (HASH_OA_GROUP * 16)))
+			return NULL;
+		groups <<= 1;
+	}
+
+	table = calloc(1, sizeof(*table));
+	if (!table)
+		return NULL;
+	table->ctrl = malloc(groups * HASH_OA_GROUP);
+	table->slots = calloc(groups * HASH_OA_GROUP, sizeof(*table->slots));
+	if (!table->ctrl || !table->slots) {
+		free(table->slots);
+		free(table->ctrl);
+		free(table);
+		return NULL;
+	}
+	(void)memset(table->ctrl, HASH_OA_EMPTY, groups * HASH_OA_GROUP);
+	table->groups = groups;
+	table->max = (groups * HASH_OA_GROUP * 7) / 8;
+
+	return table;
+}
+
+/*
+ *  stress_hash_oatable_hash()
+ *	scramble a key, the low 7 bits are the control byte
+ *	tag and the rest select the first group to probe
+ */
+static inline uint64_t HOT OPTIMIZE3 stress_hash_oatable_hash(const uint64_t key)
+{
+	return stress_hash_mix(key ^ wyhash_secret[0], wyhash_secret[1]);
+}
+
+/*
+ *  stress_hash_oatable_match()
+ *	non-zero if any of the 8 control bytes of a group match
+ *	the 7 bit tag, may give false positives which the caller
+ *	weeds out by checking each slot
+ */
+static inline uint64_t HOT OPTIMIZE3 stress_hash_oatable_match(
+	const uint8_t *ctrl,
+	const uint8_t tag)
+{
+	const uint64_t x = stress_hash_read64(ctrl) ^ (HASH_OA_LSB * tag);
+
+	return (x - HASH_OA_LSB) & ~x & HASH_OA_MSB;
+}
+
+/*
+ *  stress_hash_oatable_find()
+ *	find the slot of a key or the empty slot to put it in,
+ *	returns the slot index, found is set if the key exists
+ */
+static size_t HOT OPTIMIZE3 stress_hash_oatable_find(
+	const stress_hash_oatable_t *table,
+	const uint64_t key,
+	bool *found)
+{
+	const uint64_t h = stress_hash_oatable_hash(key);
+	const uint8_t tag = (uint8_t)(h & 0x7f);
+	const size_t mask = table->groups - 1;
+	size_t group = (size_t)(h >> 7) & mask, step = 0;
+
+	for (;;) {
+		const uint8_t *ctrl = table->ctrl + (group * HASH_OA_GROUP);
+		const size_t base = group * HASH_OA_GROUP;
+		size_t i;
+
+		if (stress_hash_oatable_match(ctrl, tag)) {
+			for (i = 0; i < HASH_OA_GROUP; i++) {
+				if ((ctrl[i] == tag) && (table->slots[base + i].key == key)) {
+					*found = true;
+					return base + i;
+				}
+			}
+		}
+		/* An empty slot ends the probe sequence */
+		if (stress_hash_read64(ctrl) & HASH_OA_MSB) {
+			for (i = 0; ctrl[i] != HASH_OA_EMPTY; i++)
+				;
+			*found = false;
+			return base + i;
+		}
+		/* Triangular probing visits every group of a power of 2 table */
+		step++;
+		group = (group + step) & mask;
+	}
+}
+
+/*
+ *  stress_hash_oatable_put()
+ *	add or update a key, returns -1 if the table is full
+ */
+int stress_hash_oatable_put(
+	stress_hash_oatable_t *table,
+	const uint64_t key,
+	const uint64_t value)
+{
+	size_t slot;
+	bool found;
+
+	if (UNLIKELY(!table))
+		return -1;
+
+	slot = stress_hash_oatable_find(table, key, &found);
+	if (!found) {
+		if (UNLIKELY(table->used >= table->max))
+			return -1;
+		table->ctrl[slot] = (uint8_t)(stress_hash_oatable_hash(key) & 0x7f);
+		table->slots[slot].key = key;
+		table->used++;
+	}
+	table->slots[slot].value = value;
+	return 0;
+}
+
+/*
+ *  stress_hash_oatable_get()
+ *	look up a key, returns false if it does not exist
+ */
+bool stress_hash_oatable_get(
+	const stress_hash_oatable_t *table,
+	const uint64_t key,
+	uint64_t *value)
+{
+	size_t slot;
+	bool found;
+
+	if (UNLIKELY(!table))
+		return false;
+
+	slot = stress_hash_oatable_find(table, key, &found);
+	if (found)
+		*value = table->slots[slot].value;
+	return found;
+}
+
+/*
+ *  stress_hash_oatable_delete()
+ *	delete an open addressing hash table
+ */
+void stress_hash_oatable_delete(stress_hash_oatable_t *table)
+{
+	if (!table)
+		return;
+
+	free(table->slots);
+	free(table->ctrl);
+	free(table);
+}
@@ -27,9 +27,23 @@
 #define MAX_ARGS	(64)
 #define RUN_SEQUENTIAL	(0x01)
 #define RUN_PARALLEL	(0x02)
+#define RUN_PHASED	(0x04)
+#define MAX_PHASES	(64)
 
 #define ISBLANK(ch)	isblank((int)(ch))
 
+/* A named phase of a job, times are in seconds from the start of the run */
+typedef struct {
+	char name[32];		/* phase name, for after dependencies */
+	double start;		/* start offset */
+	double timeout;		/* run time, 0 for until the end of the run */
+	double ramp;		/* time to spread the instance starts over */
+} stress_job_phase_t;
+
+static stress_job_phase_t phases[MAX_PHASES];
+static size_t phases_count;
+static stress_job_phase_t *phase_current;
+
 /*
  *  stress_chop()
  *	chop off end of line that matches char ch
@@ -62,7 +76,7 @@ static int stress_parse_run(
 	if (!strcmp(argv[2], "sequential") ||
 	    !strcmp(argv[2], "sequentially") ||
 	    !strcmp(argv[2], "seq")) {
-		if (*flag & RUN_PARALLEL)
+		if (*flag & (RUN_PARALLEL | RUN_PHASED))
 			goto err;
 		*flag |= RUN_SEQUENTIAL;
 		g_opt_flags |= OPT_FLAGS_SEQUENTIAL;
@@ -80,11 +94,122 @@ static int stress_parse_run(
 	}
 err:
 	(void)fprintf(stderr, "Cannot have both run sequential "
-		"and run parallel in jobfile %s\n",
+		"and run parallel or phases in jobfile %s\n",
 		jobfile);
 	return -1;
 }
 
+/*
+ *  stress_job_phase()
+ *	get the start offset, run time and ramp time of the
+ *	job file phase that a new stressor is added to, these
+ *	are all zero outside of a phase
+ */
+void stress_job_phase(double *start, double *timeout, double *ramp)
+{
+	if (phase_current) {
+		*start = phase_current->start;
+		*timeout = phase_current->timeout;
+		*ramp = phase_current->ramp;
+	} else {
+		*start = 0.0;
+		*timeout = 0.0;
+		*ramp = 0.0;
+	}
+}
+
+/*
+ *  stress_parse_phase()
+ *	parse the special job file "phase" command,
+ *	phase name [start T] [after name] [timeout T] [ramp T],
+ *	the stressors that follow are run in that phase
+ *	concurrently with those of any other active phases
+ */
+static int stress_parse_phase(
+	const char *jobfile,
+	int argc,
+	char **argv,
+	uint32_t *flag)
+{
+	stress_job_phase_t *phase;
+	double after = 0.0;
+	int i;
+
+	if (strcmp(argv[1], "phase"))
+		return 0;
+	if (argc < 3) {
+		(void)fprintf(stderr, "phase command requires a phase name\n");
+		return -1;
+	}
+	if (*flag & RUN_SEQUENTIAL) {
+		(void)fprintf(stderr, "Cannot have both run sequential "
+			"and phases in jobfile %s\n", jobfile);
+		return -1;
+	}
+	if (phases_count >= MAX_PHASES) {
+		(void)fprintf(stderr, "Too many phases, maximum is %d\n", MAX_PHASES);
+		return -1;
+	}
+
+	phase = &phases[phases_count];
+	(void)memset(phase, 0, sizeof(*phase));
+	(void)shim_strlcpy(phase->name, argv[2], sizeof(phase->name));
+
+	for (i = 3; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			(void)fprintf(stderr, "phase %s option %s requires "
+				"an argument\n", phase->name, argv[i]);
+			return -1;
+		}
+		if (!strcmp(argv[i], "start")) {
+			phase->start = (double)stress_get_uint64_time(argv[i + 1]);
+		} else if (!strcmp(argv[i], "timeout")) {
+			phase->timeout = (double)stress_get_uint64_time(argv[i + 1]);
+		} else if (!strcmp(argv[i], "ramp")) {
+			phase->ramp = (double)stress_get_uint64_time(argv[i + 1]);
+		} else if (!strcmp(argv[i], "after")) {
+			size_t j;
+
+			for (j = 0; j < phases_count; j++) {
+				if (!strcmp(phases[j].name, argv[i + 1]))
+					break;
+			}
+			if (j == phases_count) {
+				(void)fprintf(stderr, "phase %s cannot run after "
+					"undefined phase %s\n", phase->name, argv[i + 1]);
+				return -1;
+			}
+			if (phases[j].timeout <= 0.0) {
+				(void)fprintf(stderr, "phase %s cannot run after "
+					"phase %s as it has no timeout\n",
+					phase->name, argv[i + 1]);
+				return -1;
+			}
+			/* The latest ending dependency wins */
+			if (phases[j].start + phases[j].timeout > after)
+				after = phases[j].start + phases[j].timeout;
+		} else {
+			(void)fprintf(stderr, "phase %s has unknown option %s, "
+				"expecting start, after, timeout or ramp\n",
+				phase->name, argv[i]);
+			return -1;
+		}
+	}
+	/* start is relative to the end of the phases it depends on */
+	phase->start += after;
+	if ((phase->timeout > 0.0) && (phase->ramp > phase->timeout)) {
+		(void)fprintf(stderr, "phase %s ramp must not be longer "
+			"than its timeout\n", phase->name);
+		return -1;
+	}
+
+	phase_current = phase;
+	phases_count++;
+	*flag |= RUN_PHASED;
+	g_opt_flags &= ~OPT_FLAGS_SEQUENTIAL;
+	return 1;
+}
+
 /*
  *  stress_parse_error()
  *	generic job error message
@@ -201,6 +326,16 @@ int stress_parse_jobfile(
 				continue;
 			}
 
+			/* Check for job phase option */
+			rc = stress_parse_phase(jobfile, new_argc, new_argv, &flag);
+			if (rc < 0) {
+				ret = -1;
+				stress_parse_error(lineno, txt);
+				goto err;
+			} else if (rc == 1) {
+				continue;
+			}
+
 			/* prepend -- to command to make them into stress-ng options */
 			(void)snprintf(tmp, len, "--%s", new_argv[1]);
 			new_argv[1] = tmp;
@@ -0,0 +1,917 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_IMMINTRIN_H) &&	\
+    defined(STRESS_ARCH_X86) &&		\
+    (defined(__x86_64__) || defined(__x86_64)) && \
+    defined(__GNUC__) &&		\
+    !defined(__INTEL_COMPILER)
+#include <immintrin.h>
+#define STRESS_MEMFUNC_X86
+#endif
+
+#if defined(HAVE_ARM_NEON_H) &&		\
+    defined(STRESS_ARCH_ARM) &&		\
+    defined(__aarch64__) &&		\
+    defined(__GNUC__)
+#include <arm_neon.h>
+#define STRESS_MEMFUNC_NEON
+#endif
+
+#if defined(__GNUC__)
+
+#define MEMFUNC_MEMCPY		(0)
+#define MEMFUNC_MEMMOVE		(1)
+#define MEMFUNC_MEMSET		(2)
+#define MEMFUNC_STRLEN		(3)
+#define MEMFUNC_MEMCHR		(4)
+#define MEMFUNC_FUNCS		(5)
+
+#define MEMFUNC_ALIGNS		(3)
+#define MEMFUNC_MAX_SIZE	(1 * MB)
+#define MEMFUNC_PAD		(256)		/* room for offsets and memmove overlap */
+#define MEMFUNC_MOVE_GAP	(64)		/* memmove destination is this far above source */
+#define MEMFUNC_REP_TIME	(500000.0)	/* nanoseconds per timed repetition */
+#define MEMFUNC_REPS		(3)		/* best of this many repetitions */
+#define MEMFUNC_MAX_LOOPS	(1U << 24)
+#define MEMFUNC_CHAR		('Z')		/* memchr target, not in the fill pattern */
+#define MEMFUNC_SET		(0x5a)		/* memset value */
+
+static const char * const memfunc_names[MEMFUNC_FUNCS] = {
+	"memcpy",
+	"memmove",
+	"memset",
+	"strlen",
+	"memchr",
+};
+
+static const size_t memfunc_sizes[] = {
+	16, 64, 256, 1 * KB, 4 * KB, 64 * KB, MEMFUNC_MAX_SIZE
+};
+
+#define MEMFUNC_SIZES		SIZEOF_ARRAY(memfunc_sizes)
+#define MEMFUNC_REPORT_SIZE	(4)		/* 4K, for the misc stats */
+
+/*
+ *  offsets from 64 byte alignment, memcpy and memmove use the dst
+ *  and src pairs, the one pointer functions use the single offsets
+ */
+static const size_t memfunc_dst_off[MEMFUNC_ALIGNS] = { 0, 0, 7 };
+static const size_t memfunc_src_off[MEMFUNC_ALIGNS] = { 0, 1, 1 };
+static const size_t memfunc_one_off[MEMFUNC_ALIGNS] = { 0, 1, 7 };
+
+typedef struct {
+	const char *name;
+	bool (*supported)(void);	/* NULL if always supported */
+	void *(*memcpy_func)(void *dst, const void *src, size_t n);
+	void *(*memmove_func)(void *dst, const void *src, size_t n);
+	void *(*memset_func)(void *dst, int c, size_t n);
+	size_t (*strlen_func)(const char *str);
+	void *(*memchr_func)(const void *str, int c, size_t n);
+} stress_memfunc_impl_t;
+
+/*
+ *  libc, the wrappers stop the compiler replacing the calls
+ *  with its own inlined versions
+ */
+static NOINLINE void *stress_memfunc_libc_memcpy(void *dst, const void *src, size_t n)
+{
+	return memcpy(dst, src, n);
+}
+
+static NOINLINE void *stress_memfunc_libc_memmove(void *dst, const void *src, size_t n)
+{
+	return memmove(dst, src, n);
+}
+
+static NOINLINE void *stress_memfunc_libc_memset(void *dst, int c, size_t n)
+{
+	return memset(dst, c, n);
+}
+
+static NOINLINE size_t stress_memfunc_libc_strlen(const char *str)
+{
+	return strlen(str);
+}
+
+static NOINLINE void *stress_memfunc_libc_memchr(const void *str, int c, size_t n)
+{
+	return memchr(str, c, n);
+}
+
+/*
+ *  kernel style, the word at a time C of lib/string.c and the
+ *  word-at-a-time.h zero byte test, built without SIMD as a
+ *  kernel is. The empty asm hides the pointers from the loop
+ *  idiom recognition that would turn the loops into libc calls
+ */
+typedef unsigned long __attribute__((__may_alias__)) stress_memfunc_word_t;
+
+#define MEMFUNC_WORD_SIZE	sizeof(stress_memfunc_word_t)
+#define MEMFUNC_WORD_ONES	((stress_memfunc_word_t)~0UL / 0xff)
+#define MEMFUNC_WORD_HIGHS	(MEMFUNC_WORD_ONES * 0x80)
+#define MEMFUNC_HAS_ZERO(x)	(((x) - MEMFUNC_WORD_ONES) & ~(x) & MEMFUNC_WORD_HIGHS)
+#define MEMFUNC_OPAQUE(p)	__asm__ __volatile__("" : "+r" (p))
+#define MEMFUNC_ALIGNED(p)	((((uintptr_t)(p)) & (MEMFUNC_WORD_SIZE - 1)) == 0)
+
+static NOINLINE void *stress_memfunc_kernel_memcpy(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	if (MEMFUNC_ALIGNED(d) && MEMFUNC_ALIGNED(s)) {
+		stress_memfunc_word_t *dw = (stress_memfunc_word_t *)d;
+		const stress_memfunc_word_t *sw = (const stress_memfunc_word_t *)s;
+
+		for (; n >= MEMFUNC_WORD_SIZE; n -= MEMFUNC_WORD_SIZE) {
+			*dw++ = *sw++;
+			MEMFUNC_OPAQUE(dw);
+		}
+		d = (uint8_t *)dw;
+		s = (const uint8_t *)sw;
+	}
+	while (n--) {
+		*d++ = *s++;
+		MEMFUNC_OPAQUE(d);
+	}
+	return dst;
+}
+
+static NOINLINE void *stress_memfunc_kernel_memmove(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	if (d <= s) {
+		while (n--) {
+			*d++ = *s++;
+			MEMFUNC_OPAQUE(d);
+		}
+	} else {
+		d += n;
+		s += n;
+		while (n--) {
+			*--d = *--s;
+			MEMFUNC_OPAQUE(d);
+		}
+	}
+	return dst;
+}
+
+static NOINLINE void *stress_memfunc_kernel_memset(void *dst, int c, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const stress_memfunc_word_t pattern = MEMFUNC_WORD_ONES * (uint8_t)c;
+
+	for (; n && !MEMFUNC_ALIGNED(d); n--) {
+		*d++ = (uint8_t)c;
+		MEMFUNC_OPAQUE(d);
+	}
+	if (n >= MEMFUNC_WORD_SIZE) {
+		stress_memfunc_word_t *dw = (stress_memfunc_word_t *)d;
+
+		for (; n >= MEMFUNC_WORD_SIZE; n -= MEMFUNC_WORD_SIZE) {
+			*dw++ = pattern;
+			MEMFUNC_OPAQUE(dw);
+		}
+		d = (uint8_t *)dw;
+	}
+	while (n--) {
+		*d++ = (uint8_t)c;
+		MEMFUNC_OPAQUE(d);
+	}
+	return dst;
+}
+
+static NOINLINE size_t stress_memfunc_kernel_strlen(const char *str)
+{
+	const char *s = str;
+	const stress_memfunc_word_t *w;
+
+	for (; !MEMFUNC_ALIGNED(s); s++) {
+		if (!*s)
+			return (size_t)(s - str);
+	}
+	for (w = (const stress_memfunc_word_t *)s; !MEMFUNC_HAS_ZERO(*w); w++)
+		MEMFUNC_OPAQUE(w);
+	for (s = (const char *)w; *s; s++)
+		;
+	return (size_t)(s - str);
+}
+
+static NOINLINE void *stress_memfunc_kernel_memchr(const void *str, int c, size_t n)
+{
+	const uint8_t *s = (const uint8_t *)str;
+	const stress_memfunc_word_t pattern = MEMFUNC_WORD_ONES * (uint8_t)c;
+
+	for (; n && !MEMFUNC_ALIGNED(s); n--, s++) {
+		if (*s == (uint8_t)c)
+			return (void *)s;
+	}
+	if (n >= MEMFUNC_WORD_SIZE) {
+		const stress_memfunc_word_t *w = (const stress_memfunc_word_t *)s;
+
+		for (; n >= MEMFUNC_WORD_SIZE; n -= MEMFUNC_WORD_SIZE, w++) {
+			const stress_memfunc_word_t x = *w ^ pattern;
+
+			if (MEMFUNC_HAS_ZERO(x))
+				break;
+			MEMFUNC_OPAQUE(w);
+		}
+		s = (const uint8_t *)w;
+	}
+	for (; n; n--, s++) {
+		if (*s == (uint8_t)c)
+			return (void *)s;
+	}
+	return NULL;
+}
+
+#if defined(STRESS_MEMFUNC_X86) ||	\
+    defined(STRESS_MEMFUNC_NEON)
+/*
+ *  stress_memfunc_move_small()
+ *	copy or move n <= 32 bytes with overlapping head and tail
+ *	accesses, all the loads are done before the stores
+ */
+static inline void ALWAYS_INLINE stress_memfunc_move_small(
+	uint8_t *d,
+	const uint8_t *s,
+	const size_t n)
+{
+	if (n >= 16) {
+		uint64_t a, b, c, e;
+
+		(void)memcpy(&a, s, 8);
+		(void)memcpy(&b, s + 8, 8);
+		(void)memcpy(&c, s + n - 16, 8);
+		(void)memcpy(&e, s + n - 8, 8);
+		(void)memcpy(d, &a, 8);
+		(void)memcpy(d + 8, &b, 8);
+		(void)memcpy(d + n - 16, &c, 8);
+		(void)memcpy(d + n - 8, &e, 8);
+	} else if (n >= 8) {
+		uint64_t a, b;
+
+		(void)memcpy(&a, s, 8);
+		(void)memcpy(&b, s + n - 8, 8);
+		(void)memcpy(d, &a, 8);
+		(void)memcpy(d + n - 8, &b, 8);
+	} else if (n >= 4) {
+		uint32_t a, b;
+
+		(void)memcpy(&a, s, 4);
+		(void)memcpy(&b, s + n - 4, 4);
+		(void)memcpy(d, &a, 4);
+		(void)memcpy(d + n - 4, &b, 4);
+	} else if (n) {
+		const uint8_t a = s[0], b = s[n / 2], c = s[n - 1];
+
+		d[0] = a;
+		d[n / 2] = b;
+		d[n - 1] = c;
+	}
+}
+
+/*
+ *  stress_memfunc_set_small()
+ *	set n <= 32 bytes with overlapping head and tail stores
+ */
+static inline void ALWAYS_INLINE stress_memfunc_set_small(
+	uint8_t *d,
+	const int c,
+	const size_t n)
+{
+	const uint64_t v = 0x0101010101010101ULL * (uint8_t)c;
+
+	if (n >= 16) {
+		(void)memcpy(d, &v, 8);
+		(void)memcpy(d + 8, &v, 8);
+		(void)memcpy(d + n - 16, &v, 8);
+		(void)memcpy(d + n - 8, &v, 8);
+	} else if (n >= 8) {
+		(void)memcpy(d, &v, 8);
+		(void)memcpy(d + n - 8, &v, 8);
+	} else if (n >= 4) {
+		(void)memcpy(d, &v, 4);
+		(void)memcpy(d + n - 4, &v, 4);
+	} else if (n) {
+		d[0] = (uint8_t)c;
+		d[n / 2] = (uint8_t)c;
+		d[n - 1] = (uint8_t)c;
+	}
+}
+
+/*
+ *  hand written SIMD versions, W byte vectors with unaligned
+ *  loads and stores and an overlapping last vector for the tail.
+ *  MASK gives BPB bits per byte of a vector compare so that
+ *  the first match is at ctz / BPB
+ */
+#define STRESS_MEMFUNC_SIMD(prefix, attr, VT, W, BPB, LOADU, STOREU, LOADA, SET1, CMPEQ, MASK) \
+static NOINLINE attr void *prefix ## _memcpy(void *dst, const void *src, size_t n) \
+{									\
+	uint8_t *d = (uint8_t *)dst;					\
+	const uint8_t *s = (const uint8_t *)src;			\
+	VT tail;							\
+	size_t i;							\
+									\
+	if (n < W) {							\
+		stress_memfunc_move_small(d, s, n);			\
+		return dst;						\
+	}								\
+	tail = LOADU(s + n - W);					\
+	for (i = 0; i + (4 * W) <= n; i += 4 * W) {			\
+		const VT v0 = LOADU(s + i);				\
+		const VT v1 = LOADU(s + i + W);				\
+		const VT v2 = LOADU(s + i + (2 * W));			\
+		const VT v3 = LOADU(s + i + (3 * W));			\
+									\
+		STOREU(d + i, v0);					\
+		STOREU(d + i + W, v1);					\
+		STOREU(d + i + (2 * W), v2);				\
+		STOREU(d + i + (3 * W), v3);				\
+	}								\
+	for (; i + W <= n; i += W)					\
+		STOREU(d + i, LOADU(s + i));				\
+	STOREU(d + n - W, tail);					\
+	return dst;							\
+}									\
+									\
+static NOINLINE attr void *prefix ## _memmove(void *dst, const void *src, size_t n) \
+{									\
+	uint8_t *d = (uint8_t *)dst;					\
+	const uint8_t *s = (const uint8_t *)src;			\
+	VT edge;							\
+	size_t i;							\
+									\
+	if (n < W) {							\
+		stress_memfunc_move_small(d, s, n);			\
+		return dst;						\
+	}								\
+	if ((d <= s) || (d >= s + n)) {					\
+		/* forwards, stores never pass unread source */		\
+		edge = LOADU(s + n - W);				\
+		for (i = 0; i + W <= n; i += W)				\
+			STOREU(d + i, LOADU(s + i));			\
+		STOREU(d + n - W, edge);				\
+	} else {							\
+		/* backwards for an overlapping higher destination */	\
+		edge = LOADU(s);					\
+		for (i = n; i > W; i -= W)				\
+			STOREU(d + i - W, LOADU(s + i - W));		\
+		STOREU(d, edge);					\
+	}								\
+	return dst;							\
+}									\
+									\
+static NOINLINE attr void *prefix ## _memset(void *dst, int c, size_t n) \
+{									\
+	uint8_t *d = (uint8_t *)dst;					\
+	const VT v = SET1(c);						\
+	size_t i;							\
+									\
+	if (n < W) {							\
+		stress_memfunc_set_small(d, c, n);			\
+		return dst;						\
+	}								\
+	for (i = 0; i + (2 * W) <= n; i += 2 * W) {			\
+		STOREU(d + i, v);					\
+		STOREU(d + i + W, v);					\
+	}								\
+	for (; i + W <= n; i += W)					\
+		STOREU(d + i, v);					\
+	STOREU(d + n - W, v);						\
+	return dst;							\
+}									\
+									\
+static NOINLINE attr size_t prefix ## _strlen(const char *str)		\
+{									\
+	/* aligned loads never cross into the next page */		\
+	const uintptr_t addr = (uintptr_t)str;				\
+	const uint8_t *p = (const uint8_t *)(addr & ~(uintptr_t)(W - 1)); \
+	const VT zero = SET1(0);					\
+	uint64_t mask;							\
+									\
+	mask = (uint64_t)MASK(CMPEQ(LOADA(p), zero)) >> ((addr & (W - 1)) * BPB); \
+	if (mask)							\
+		return (size_t)__builtin_ctzll(mask) / BPB;		\
+	for (;;) {							\
+		p += W;							\
+		mask = (uint64_t)MASK(CMPEQ(LOADA(p), zero));		\
+		if (mask)						\
+			return (size_t)(p - (const uint8_t *)str) +	\
+				((size_t)__builtin_ctzll(mask) / BPB);	\
+	}								\
+}									\
+									\
+static NOINLINE attr void *prefix ## _memchr(const void *str, int c, size_t n) \
+{									\
+	const uint8_t *p = (const uint8_t *)str;			\
+	const VT vc = SET1(c);						\
+									\
+	for (; n >= W; n -= W, p += W) {				\
+		const uint64_t mask = (uint64_t)MASK(CMPEQ(LOADU(p), vc)); \
+									\
+		if (mask)						\
+			return (void *)(p + (__builtin_ctzll(mask) / BPB)); \
+	}								\
+	for (; n; n--, p++) {						\
+		if (*p == (uint8_t)c)					\
+			return (void *)p;				\
+	}								\
+	return NULL;							\
+}
+#endif
+
+#if defined(STRESS_MEMFUNC_X86)
+#define SSE2_LOADU(p)		_mm_loadu_si128((const __m128i *)(const void *)(p))
+#define SSE2_STOREU(p, v)	_mm_storeu_si128((__m128i *)(void *)(p), v)
+#define SSE2_LOADA(p)		_mm_load_si128((const __m128i *)(const void *)(p))
+#define SSE2_SET1(c)		_mm_set1_epi8((char)(c))
+#define SSE2_CMPEQ(a, b)	_mm_cmpeq_epi8(a, b)
+#define SSE2_MASK(v)		(uint32_t)_mm_movemask_epi8(v)
+
+#define AVX2_LOADU(p)		_mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define AVX2_STOREU(p, v)	_mm256_storeu_si256((__m256i *)(void *)(p), v)
+#define AVX2_LOADA(p)		_mm256_load_si256((const __m256i *)(const void *)(p))
+#define AVX2_SET1(c)		_mm256_set1_epi8((char)(c))
+#define AVX2_CMPEQ(a, b)	_mm256_cmpeq_epi8(a, b)
+#define AVX2_MASK(v)		(uint32_t)_mm256_movemask_epi8(v)
+
+STRESS_MEMFUNC_SIMD(stress_memfunc_sse2, __attribute__((target("sse2"))), __m128i, 16, 1,
+	SSE2_LOADU, SSE2_STOREU, SSE2_LOADA, SSE2_SET1, SSE2_CMPEQ, SSE2_MASK)
+STRESS_MEMFUNC_SIMD(stress_memfunc_avx2, __attribute__((target("avx2"))), __m256i, 32, 1,
+	AVX2_LOADU, AVX2_STOREU, AVX2_LOADA, AVX2_SET1, AVX2_CMPEQ, AVX2_MASK)
+
+static bool stress_memfunc_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+/*
+ *  x86 string instructions as the kernel uses them, rep movsb and
+ *  rep stosb for copies and sets (fast with ERMS/FSRM) and the
+ *  repne scasb of the 32 bit kernel strlen and memchr
+ */
+static NOINLINE void *stress_memfunc_erms_memcpy(void *dst, const void *src, size_t n)
+{
+	void *d = dst;
+
+	__asm__ __volatile__("rep movsb"
+		: "+D" (d), "+S" (src), "+c" (n)
+		:
+		: "memory");
+	return dst;
+}
+
+static NOINLINE void *stress_memfunc_erms_memmove(void *dst, const void *src, size_t n)
+{
+	uint8_t *d;
+	const uint8_t *s;
+
+	if (((uint8_t *)dst <= (const uint8_t *)src) ||
+	    ((uint8_t *)dst >= (const uint8_t *)src + n))
+		return stress_memfunc_erms_memcpy(dst, src, n);
+	if (!n)
+		return dst;
+	/* overlapping higher destination, copy backwards */
+	d = (uint8_t *)dst + n - 1;
+	s = (const uint8_t *)src + n - 1;
+	__asm__ __volatile__("std\n\trep movsb\n\tcld"
+		: "+D" (d), "+S" (s), "+c" (n)
+		:
+		: "memory", "cc");
+	return dst;
+}
+
+static NOINLINE void *stress_memfunc_erms_memset(void *dst, int c, size_t n)
+{
+	void *d = dst;
+
+	__asm__ __volatile__("rep stosb"
+		: "+D" (d), "+c" (n)
+		: "a" (c)
+		: "memory");
+	return dst;
+}
+
+static NOINLINE size_t stress_memfunc_erms_strlen(const char *str)
+{
+	const char *s = str;
+	size_t count = ~(size_t)0;
+
+	__asm__ __volatile__("repne scasb"
+		: "+D" (s), "+c" (count)
+		: "a" (0)
+		: "memory", "cc");
+	return ~count - 1;
+}
+
+static NOINLINE void *stress_memfunc_erms_memchr(const void *str, int c, size_t n)
+{
+	const uint8_t *s = (const uint8_t *)str;
+
+	if (!n)
+		return NULL;
+	__asm__ __volatile__("repne scasb"
+		: "+D" (s), "+c" (n)
+		: "a" (c)
+		: "memory", "cc");
+	/* s is one past the last byte compared, a match or the end */
+	return (s[-1] == (uint8_t)c) ? (void *)(s - 1) : NULL;
+}
+#endif
+
+#if defined(STRESS_MEMFUNC_NEON)
+#define NEON_LOADU(p)		vld1q_u8((const uint8_t *)(p))
+#define NEON_STOREU(p, v)	vst1q_u8((uint8_t *)(p), v)
+#define NEON_SET1(c)		vdupq_n_u8((uint8_t)(c))
+#define NEON_CMPEQ(a, b)	vceqq_u8(a, b)
+/* narrow each 0x00/0xff byte to a nibble, 4 bits per byte */
+#define NEON_MASK(v)		vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0)
+
+STRESS_MEMFUNC_SIMD(stress_memfunc_neon, OPTIMIZE3, uint8x16_t, 16, 4,
+	NEON_LOADU, NEON_STOREU, NEON_LOADU, NEON_SET1, NEON_CMPEQ, NEON_MASK)
+#endif
+
+static const stress_memfunc_impl_t memfunc_impls[] = {
+	{ "libc", NULL,
+	  stress_memfunc_libc_memcpy, stress_memfunc_libc_memmove,
+	  stress_memfunc_libc_memset, stress_memfunc_libc_strlen,
+	  stress_memfunc_libc_memchr },
+#if defined(STRESS_MEMFUNC_X86)
+	{ "sse2", NULL,
+	  stress_memfunc_sse2_memcpy, stress_memfunc_sse2_memmove,
+	  stress_memfunc_sse2_memset, stress_memfunc_sse2_strlen,
+	  stress_memfunc_sse2_memchr },
+	{ "avx2", stress_memfunc_avx2_supported,
+	  stress_memfunc_avx2_memcpy, stress_memfunc_avx2_memmove,
+	  stress_memfunc_avx2_memset, stress_memfunc_avx2_strlen,
+	  stress_memfunc_avx2_memchr },
+#endif
+#if defined(STRESS_MEMFUNC_NEON)
+	{ "neon", NULL,
+	  stress_memfunc_neon_memcpy, stress_memfunc_neon_memmove,
+	  stress_memfunc_neon_memset, stress_memfunc_neon_strlen,
+	  stress_memfunc_neon_memchr },
+#endif
+	{ "kernel", NULL,
+	  stress_memfunc_kernel_memcpy, stress_memfunc_kernel_memmove,
+	  stress_memfunc_kernel_memset, stress_memfunc_kernel_strlen,
+	  stress_memfunc_kernel_memchr },
+#if defined(STRESS_MEMFUNC_X86)
+	{ "rep-str", NULL,
+	  stress_memfunc_erms_memcpy, stress_memfunc_erms_memmove,
+	  stress_memfunc_erms_memset, stress_memfunc_erms_strlen,
+	  stress_memfunc_erms_memchr },
+#endif
+};
+
+#define MEMFUNC_IMPLS		SIZEOF_ARRAY(memfunc_impls)
+#define MEMFUNC_RESULT(r, i, f, s, a)	\
+	(r)[((((i) * MEMFUNC_FUNCS + (f)) * MEMFUNC_SIZES + (s)) * MEMFUNC_ALIGNS) + (a)]
+
+typedef struct {
+	uint8_t *src_base;	/* fill pattern, read only for the functions */
+	uint8_t *dst_base;	/* destinations, memmove works in here */
+	uint8_t *ref_base;	/* libc memmove reference */
+	size_t buf_size;
+} stress_memfunc_bufs_t;
+
+/*
+ *  stress_memfunc_time()
+ *	nanoseconds to call a function loops times
+ */
+static double stress_memfunc_time(
+	const stress_memfunc_impl_t *impl,
+	const int func,
+	uint8_t *dst,
+	const uint8_t *src,
+	const size_t n,
+	const uint32_t loops)
+{
+	double t;
+	uint32_t i;
+
+	t = stress_time_now_ns();
+	switch (func) {
+	case MEMFUNC_MEMCPY:
+		for (i = 0; i < loops; i++)
+			(void)impl->memcpy_func(dst, src, n);
+		break;
+	case MEMFUNC_MEMMOVE:
+		for (i = 0; i < loops; i++)
+			(void)impl->memmove_func(dst, src, n);
+		break;
+	case MEMFUNC_MEMSET:
+		for (i = 0; i < loops; i++)
+			(void)impl->memset_func(dst, MEMFUNC_SET, n);
+		break;
+	case MEMFUNC_STRLEN:
+		for (i = 0; i < loops; i++)
+			(void)impl->strlen_func((const char *)src);
+		break;
+	case MEMFUNC_MEMCHR:
+		for (i = 0; i < loops; i++)
+			(void)impl->memchr_func(src, MEMFUNC_CHAR, n);
+		break;
+	default:
+		break;
+	}
+	return stress_time_now_ns() - t;
+}
+
+/*
+ *  stress_memfunc_verify()
+ *	check one call of a function against what libc gives,
+ *	including that it does not write past the end
+ */
+static bool stress_memfunc_verify(
+	const stress_memfunc_impl_t *impl,
+	const int func,
+	const stress_memfunc_bufs_t *bufs,
+	uint8_t *dst,
+	const uint8_t *src,
+	const size_t n)
+{
+	size_t i;
+
+	switch (func) {
+	case MEMFUNC_MEMCPY:
+		(void)memset(dst, 0, n + 1);
+		(void)impl->memcpy_func(dst, src, n);
+		return !memcmp(dst, src, n) && (dst[n] == 0);
+	case MEMFUNC_MEMMOVE:
+		(void)memcpy(bufs->ref_base, bufs->dst_base, bufs->buf_size);
+		(void)memmove(bufs->ref_base + (dst - bufs->dst_base),
+			bufs->ref_base + (src - bufs->dst_base), n);
+		(void)impl->memmove_func(dst, src, n);
+		return !memcmp(bufs->ref_base, bufs->dst_base, bufs->buf_size);
+	case MEMFUNC_MEMSET:
+		(void)memset(dst, 0, n + 1);
+		(void)impl->memset_func(dst, MEMFUNC_SET, n);
+		for (i = 0; i < n; i++) {
+			if (dst[i] != MEMFUNC_SET)
+				return false;
+		}
+		return dst[n] == 0;
+	case MEMFUNC_STRLEN:
+		return impl->strlen_func((const char *)src) == n;
+	case MEMFUNC_MEMCHR:
+		return (impl->memchr_func(src, MEMFUNC_CHAR, n) == (const void *)(src + n - 1)) &&
+		       (impl->memchr_func(src, MEMFUNC_CHAR, n - 1) == NULL);
+	default:
+		break;
+	}
+	return false;
+}
+
+/*
+ *  stress_memfunc_point()
+ *	verify then time a function at a size and alignment, returns
+ *	the best bytes per second or -1.0 if the function is wrong
+ */
+static double stress_memfunc_point(
+	const stress_args_t *args,
+	const stress_memfunc_impl_t *impl,
+	const int func,
+	const stress_memfunc_bufs_t *bufs,
+	const size_t n,
+	const int align)
+{
+	const bool one = (func == MEMFUNC_MEMSET) || (func == MEMFUNC_STRLEN) ||
+			 (func == MEMFUNC_MEMCHR);
+	const uint8_t *src;
+	uint8_t *dst, saved;
+	uint32_t loops = 1;
+	double t, best;
+	int i;
+
+	if (func == MEMFUNC_MEMMOVE) {
+		src = bufs->dst_base + memfunc_src_off[align];
+		dst = bufs->dst_base + memfunc_dst_off[align] + MEMFUNC_MOVE_GAP;
+		(void)memcpy(bufs->dst_base, bufs->src_base, bufs->buf_size);
+	} else {
+		src = bufs->src_base + (one ? memfunc_one_off[align] : memfunc_src_off[align]);
+		dst = bufs->dst_base + (one ? memfunc_one_off[align] : memfunc_dst_off[align]);
+	}
+
+	/* the string end and the byte memchr looks for */
+	saved = (func == MEMFUNC_STRLEN) ? src[n] : src[n - 1];
+	if (func == MEMFUNC_STRLEN)
+		((uint8_t *)src)[n] = '\0';
+	else if (func == MEMFUNC_MEMCHR)
+		((uint8_t *)src)[n - 1] = MEMFUNC_CHAR;
+
+	if (!stress_memfunc_verify(impl, func, bufs, dst, src, n)) {
+		pr_fail("%s: %s %s of %zu bytes at dst %p src %p gave the wrong result\n",
+			args->name, impl->name, memfunc_names[func], n,
+			(void *)dst, (const void *)src);
+		best = -1.0;
+		goto restore;
+	}
+
+	/* size the repetitions, then take the best */
+	while (((t = stress_memfunc_time(impl, func, dst, src, n, loops)) < MEMFUNC_REP_TIME) &&
+	       (loops < MEMFUNC_MAX_LOOPS))
+		loops <<= 1;
+	best = t;
+	for (i = 1; keep_stressing_flag() && (i < MEMFUNC_REPS); i++) {
+		t = stress_memfunc_time(impl, func, dst, src, n, loops);
+		best = STRESS_MINIMUM(best, t);
+	}
+	best = (best > 0.0) ? ((double)n * (double)loops * 1000000000.0) / best : 0.0;
+
+restore:
+	if (func == MEMFUNC_STRLEN)
+		((uint8_t *)src)[n] = saved;
+	else if (func == MEMFUNC_MEMCHR)
+		((uint8_t *)src)[n - 1] = saved;
+	return best;
+}
+
+/*
+ *  stress_memfunc_report()
+ *	report bytes per cycle, or GB/sec if the core clock is not
+ *	known, for each function, implementation, size and alignment
+ */
+static void stress_memfunc_report(
+	const stress_args_t *args,
+	const double *results,
+	const bool *supported,
+	const double ghz)
+{
+	const double scale = (ghz > 0.0) ? 1.0 / (ghz * 1000000000.0) : 1.0 / (double)GB;
+	bool lock = false;
+	size_t i, s;
+	int f, a;
+
+	pr_lock(&lock);
+	if (ghz > 0.0)
+		pr_inf_lock(&lock, "%s: bytes per cycle at %.3f GHz\n", args->name, ghz);
+	else
+		pr_inf_lock(&lock, "%s: core clock unknown, GB per second\n", args->name);
+
+	for (f = 0; f < MEMFUNC_FUNCS; f++) {
+		const bool one = (f == MEMFUNC_MEMSET) || (f == MEMFUNC_STRLEN) || (f == MEMFUNC_MEMCHR);
+		char line[256];
+		int len;
+
+		pr_inf_lock(&lock, "%s: %s, alignments %s\n", args->name, memfunc_names[f],
+			one ? "+0 / +1 / +7" : "aligned / src+1 / src+1 dst+7");
+		len = snprintf(line, sizeof(line), "%8s", "size");
+		for (i = 0; i < MEMFUNC_IMPLS; i++) {
+			if (supported[i])
+				len += snprintf(line + len, sizeof(line) - (size_t)len,
+					" %-17s", memfunc_impls[i].name);
+		}
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+		for (s = 0; s < MEMFUNC_SIZES; s++) {
+			const size_t sz = memfunc_sizes[s];
+
+			if (sz >= MB)
+				len = snprintf(line, sizeof(line), "%7zuM", sz / (size_t)MB);
+			else if (sz >= KB)
+				len = snprintf(line, sizeof(line), "%7zuK", sz / (size_t)KB);
+			else
+				len = snprintf(line, sizeof(line), "%8zu", sz);
+			for (i = 0; i < MEMFUNC_IMPLS; i++) {
+				char cell[32];
+				int clen = 0;
+
+				if (!supported[i])
+					continue;
+				for (a = 0; a < MEMFUNC_ALIGNS; a++) {
+					const double r = MEMFUNC_RESULT(results, i, f, s, a);
+
+					if (r > 0.0)
+						clen += snprintf(cell + clen, sizeof(cell) - (size_t)clen,
+							"%s%5.2f", a ? "/" : "", r * scale);
+					else
+						clen += snprintf(cell + clen, sizeof(cell) - (size_t)clen,
+							"%s%5s", a ? "/" : "", r < 0.0 ? "FAIL" : "n/a");
+				}
+				len += snprintf(line + len, sizeof(line) - (size_t)len, " %-17s", cell);
+			}
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+	}
+	pr_unlock(&lock);
+
+	for (f = 0; f < MEMFUNC_FUNCS; f++) {
+		const double r = MEMFUNC_RESULT(results, 0, f, MEMFUNC_REPORT_SIZE, 0);
+		char desc[40];
+
+		if (r <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "libc %s 4K %s", memfunc_names[f],
+			(ghz > 0.0) ? "bytes/cycle" : "GB/sec");
+		stress_misc_stats_set(args->misc_stats, f, desc, r * scale);
+	}
+}
+
+/*
+ *  stress_memfunc_compare()
+ *	compare libc, hand written SIMD and kernel style memcpy,
+ *	memmove, memset, strlen and memchr over sizes and alignments
+ */
+int stress_memfunc_compare(const stress_args_t *args)
+{
+	const size_t n_results = MEMFUNC_IMPLS * MEMFUNC_FUNCS * MEMFUNC_SIZES * MEMFUNC_ALIGNS;
+	stress_memfunc_bufs_t bufs;
+	bool supported[MEMFUNC_IMPLS];
+	double *results, ghz;
+	size_t i, s;
+	int f, a, rc = EXIT_SUCCESS;
+
+	bufs.buf_size = MEMFUNC_MAX_SIZE + MEMFUNC_PAD;
+	bufs.src_base = (uint8_t *)mmap(NULL, bufs.buf_size * 3, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (bufs.src_base == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte buffers, skipping stressor, "
+			"errno=%d (%s)\n", args->name, bufs.buf_size * 3,
+			errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	bufs.dst_base = bufs.src_base + bufs.buf_size;
+	bufs.ref_base = bufs.dst_base + bufs.buf_size;
+	results = calloc(n_results, sizeof(*results));
+	if (!results) {
+		pr_inf_skip("%s: cannot allocate results, skipping stressor\n", args->name);
+		(void)munmap((void *)bufs.src_base, bufs.buf_size * 3);
+		return EXIT_NO_RESOURCE;
+	}
+
+	/* no zero bytes and no MEMFUNC_CHAR in the fill pattern */
+	for (i = 0; i < bufs.buf_size; i++)
+		bufs.src_base[i] = (uint8_t)('a' + (i % 26));
+	for (i = 0; i < MEMFUNC_IMPLS; i++)
+		supported[i] = !memfunc_impls[i].supported || memfunc_impls[i].supported();
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < MEMFUNC_IMPLS; i++) {
+			if (!supported[i])
+				continue;
+			for (f = 0; f < MEMFUNC_FUNCS; f++) {
+				for (s = 0; s < MEMFUNC_SIZES; s++) {
+					for (a = 0; a < MEMFUNC_ALIGNS; a++) {
+						double *r = &MEMFUNC_RESULT(results, i, f, s, a);
+						double rate;
+
+						if (!keep_stressing(args))
+							goto done;
+						if (*r < 0.0)
+							continue;
+						rate = stress_memfunc_point(args, &memfunc_impls[i],
+							f, &bufs, memfunc_sizes[s], a);
+						if (rate < 0.0)
+							rc = EXIT_FAILURE;
+						*r = (rate < 0.0) ? rate : STRESS_MAXIMUM(*r, rate);
+						inc_counter(args);
+					}
+				}
+			}
+		}
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	ghz = stress_vecfreq_ghz();
+	if (args->instance == 0)
+		stress_memfunc_report(args, results, supported, ghz);
+
+	free(results);
+	(void)munmap((void *)bufs.src_base, bufs.buf_size * 3);
+
+	return rc;
+}
+#else
+int stress_memfunc_compare(const stress_args_t *args)
+{
+	if (args->instance == 0)
+		pr_inf_skip("%s: memory function comparison needs a GNU C compatible "
+			"compiler, skipping stressor\n", args->name);
+	return EXIT_NOT_IMPLEMENTED;
+}
+#endif
@@ -212,3 +212,66 @@ HOT OPTIMIZE3 uint8_t stress_mwc1(void)
 	}
 	return mwc_saved & 0x1;
 }
+
+/* Number of interleaved generators used by stress_mwc_fill */
+#define MWC_FILL_LANES	(4)
+
+/*
+ *  stress_mwc_splitmix64()
+ *	splitmix64 step, used to expand a seed into
+ *	uncorrelated generator states
+ */
+static inline uint64_t stress_mwc_splitmix64(uint64_t *x)
+{
+	register uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ *  stress_mwc_fill()
+ *	fill buf with len bytes of pseudo random data. Rather than
+ *	a value at a time from the mwc generator, the data comes from
+ *	MWC_FILL_LANES interleaved xoshiro256+ generators that the
+ *	compiler can vectorize. These are seeded from the mwc state,
+ *	so each instance gets its own stream and re-seeding mwc with
+ *	the same seed fills a buffer with the same data again.
+ */
+void TARGET_CLONES OPTIMIZE3 stress_mwc_fill(void *buf, const size_t len)
+{
+	uint64_t s0[MWC_FILL_LANES], s1[MWC_FILL_LANES];
+	uint64_t s2[MWC_FILL_LANES], s3[MWC_FILL_LANES];
+	uint64_t r[MWC_FILL_LANES];
+	uint64_t seed = stress_mwc64();
+	uint8_t *ptr = (uint8_t *)buf;
+	const uint8_t *end = ptr + len;
+	size_t i;
+
+	for (i = 0; i < MWC_FILL_LANES; i++) {
+		s0[i] = stress_mwc_splitmix64(&seed);
+		s1[i] = stress_mwc_splitmix64(&seed);
+		s2[i] = stress_mwc_splitmix64(&seed);
+		s3[i] = stress_mwc_splitmix64(&seed);
+	}
+
+	for (;;) {
+		for (i = 0; i < MWC_FILL_LANES; i++) {
+			const uint64_t t = s1[i] << 17;
+
+			r[i] = s0[i] + s3[i];
+			s2[i] ^= s0[i];
+			s3[i] ^= s1[i];
+			s1[i] ^= s2[i];
+			s0[i] ^= s3[i];
+			s2[i] ^= t;
+			s3[i] = (s3[i] << 45) | (s3[i] >> 19);
+		}
+		if ((size_t)(end - ptr) < sizeof(r))
+			break;
+		(void)memcpy(ptr, r, sizeof(r));
+		ptr += sizeof(r);
+	}
+	(void)memcpy(ptr, r, (size_t)(end - ptr));
+}
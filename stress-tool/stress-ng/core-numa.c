@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define NUMA_POLICY_NONE	(0)	/* default first touch placement */
+#define NUMA_POLICY_LOCAL	(1)	/* bind to the node of the current CPU */
+#define NUMA_POLICY_INTERLEAVE	(2)	/* interleave over all allowed nodes */
+#define NUMA_POLICY_REMOTE	(3)	/* bind to the next node after the local one */
+#define NUMA_POLICY_BIND	(4)	/* bind to a given node */
+
+#define NUMA_MAX_BITS		(1024)
+#define NUMA_LONG_BITS		(sizeof(unsigned long) * 8)
+#define NUMA_SAMPLE_PAGES	(4096)
+
+#if !defined(MPOL_BIND)
+#define MPOL_BIND		(2)
+#endif
+#if !defined(MPOL_INTERLEAVE)
+#define MPOL_INTERLEAVE		(3)
+#endif
+#if !defined(MPOL_F_MEMS_ALLOWED)
+#define MPOL_F_MEMS_ALLOWED	(1 << 2)
+#endif
+#if !defined(MPOL_MF_MOVE)
+#define MPOL_MF_MOVE		(1 << 1)
+#endif
+
+/*
+ *  stress_set_numa_policy()
+ *	set the memory policy of the memory stressors buffers,
+ *	one of local, interleave, remote or bind=N
+ */
+int stress_set_numa_policy(const char *const opt)
+{
+	int32_t policy, node = 0;
+
+	if (!strcmp(opt, "local")) {
+		policy = NUMA_POLICY_LOCAL;
+	} else if (!strcmp(opt, "interleave")) {
+		policy = NUMA_POLICY_INTERLEAVE;
+	} else if (!strcmp(opt, "remote")) {
+		policy = NUMA_POLICY_REMOTE;
+	} else if (!strncmp(opt, "bind=", 5)) {
+		policy = NUMA_POLICY_BIND;
+		node = stress_get_int32(opt + 5);
+		if ((node < 0) || (node >= NUMA_MAX_BITS)) {
+			(void)fprintf(stderr, "numa-policy bind node must be in "
+				"the range 0 to %d\n", NUMA_MAX_BITS - 1);
+			_exit(EXIT_FAILURE);
+		}
+	} else {
+		(void)fprintf(stderr, "numa-policy must be one of local, "
+			"interleave, remote or bind=N\n");
+		_exit(EXIT_FAILURE);
+	}
+	stress_set_setting_global("numa-policy-node", TYPE_ID_INT32, &node);
+	return stress_set_setting_global("numa-policy", TYPE_ID_INT32, &policy);
+}
+
+#if defined(__NR_get_mempolicy) &&	\
+    defined(__NR_mbind) &&		\
+    defined(__NR_move_pages)
+
+/*
+ *  stress_numa_next_node()
+ *	find the first allowed node after node, wrapping around
+ */
+static int32_t stress_numa_next_node(const unsigned long *mask, const int32_t node)
+{
+	int32_t i;
+
+	for (i = 1; i <= NUMA_MAX_BITS; i++) {
+		const int32_t n = (node + i) % NUMA_MAX_BITS;
+
+		if (mask[n / NUMA_LONG_BITS] & (1UL << (n % NUMA_LONG_BITS)))
+			return n;
+	}
+	return node;
+}
+
+/*
+ *  stress_numa_mbind()
+ *	apply the --numa-policy memory policy to a buffer, pages
+ *	that are already populated are moved to match
+ */
+void stress_numa_mbind(const stress_args_t *args, void *addr, const size_t len)
+{
+	unsigned long allowed[NUMA_MAX_BITS / NUMA_LONG_BITS];
+	unsigned long mask[NUMA_MAX_BITS / NUMA_LONG_BITS];
+	int32_t policy = NUMA_POLICY_NONE, node = 0;
+	unsigned int cpu = 0, local = 0;
+	int mode = MPOL_BIND;
+
+	(void)stress_get_setting("numa-policy", &policy);
+	(void)stress_get_setting("numa-policy-node", &node);
+	if (policy == NUMA_POLICY_NONE)
+		return;
+
+	(void)memset(allowed, 0, sizeof(allowed));
+	if (shim_get_mempolicy(NULL, allowed, NUMA_MAX_BITS, NULL, MPOL_F_MEMS_ALLOWED) < 0) {
+		pr_dbg("%s: cannot get allowed NUMA nodes, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return;
+	}
+	if (shim_getcpu(&cpu, &local, NULL) < 0)
+		local = 0;
+
+	(void)memset(mask, 0, sizeof(mask));
+	switch (policy) {
+	case NUMA_POLICY_INTERLEAVE:
+		mode = MPOL_INTERLEAVE;
+		(void)memcpy(mask, allowed, sizeof(mask));
+		break;
+	case NUMA_POLICY_REMOTE:
+		node = stress_numa_next_node(allowed, (int32_t)local);
+		if (node == (int32_t)local)
+			pr_dbg("%s: only one NUMA node, remote policy is local\n",
+				args->name);
+		break;
+	case NUMA_POLICY_LOCAL:
+		node = (int32_t)local;
+		break;
+	default:
+		break;
+	}
+	if (mode == MPOL_BIND)
+		mask[node / NUMA_LONG_BITS] = 1UL << (node % NUMA_LONG_BITS);
+
+	if (shim_mbind(addr, (unsigned long)len, mode, mask,
+		       NUMA_MAX_BITS, MPOL_MF_MOVE) < 0) {
+		pr_dbg("%s: cannot set NUMA memory policy, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_numa_remote_node()
+ *	find the first allowed NUMA node after the node of the
+ *	current CPU, the local node is returned in local, returns
+ *	-1 if there is no other allowed node
+ */
+int32_t stress_numa_remote_node(int32_t *local)
+{
+	unsigned long allowed[NUMA_MAX_BITS / NUMA_LONG_BITS];
+	unsigned int cpu = 0, node = 0;
+	int32_t remote;
+
+	*local = 0;
+	(void)memset(allowed, 0, sizeof(allowed));
+	if (shim_get_mempolicy(NULL, allowed, NUMA_MAX_BITS, NULL, MPOL_F_MEMS_ALLOWED) < 0)
+		return -1;
+	if (shim_getcpu(&cpu, &node, NULL) < 0)
+		node = 0;
+	*local = (int32_t)node;
+	remote = stress_numa_next_node(allowed, (int32_t)node);
+	return (remote == (int32_t)node) ? -1 : remote;
+}
+
+/*
+ *  stress_numa_bind_node()
+ *	bind a buffer to a NUMA node, moving any pages that
+ *	are already populated, returns 0 or -1 with errno set
+ */
+int stress_numa_bind_node(void *addr, const size_t len, const int32_t node)
+{
+	unsigned long mask[NUMA_MAX_BITS / NUMA_LONG_BITS];
+
+	if ((node < 0) || (node >= NUMA_MAX_BITS)) {
+		errno = EINVAL;
+		return -1;
+	}
+	(void)memset(mask, 0, sizeof(mask));
+	mask[node / NUMA_LONG_BITS] = 1UL << (node % NUMA_LONG_BITS);
+	return (int)shim_mbind(addr, (unsigned long)len, MPOL_BIND, mask,
+		NUMA_MAX_BITS, MPOL_MF_MOVE);
+}
+
+/*
+ *  stress_numa_pages()
+ *	sample the NUMA nodes of up to NUMA_SAMPLE_PAGES pages of a
+ *	buffer, adding the count per node to pages[], returns the
+ *	highest node seen + 1
+ */
+int stress_numa_pages(
+	const stress_args_t *args,
+	const void *addr,
+	const size_t len,
+	uint64_t *pages,
+	const int max_nodes)
+{
+	void **page_addrs;
+	int *status;
+	size_t i, n = len / args->page_size;
+	const size_t stride = (n > NUMA_SAMPLE_PAGES) ? n / NUMA_SAMPLE_PAGES : 1;
+	int nodes = 0;
+
+	if (n > NUMA_SAMPLE_PAGES)
+		n = NUMA_SAMPLE_PAGES;
+	if (!n)
+		return 0;
+	page_addrs = calloc(n, sizeof(*page_addrs));
+	status = calloc(n, sizeof(*status));
+	if (!page_addrs || !status)
+		goto err;
+
+	for (i = 0; i < n; i++)
+		page_addrs[i] = (uint8_t *)addr + (i * stride * args->page_size);
+	if (shim_move_pages(0, (unsigned long)n, page_addrs, NULL, status, 0) < 0)
+		goto err;
+	for (i = 0; i < n; i++) {
+		if ((status[i] < 0) || (status[i] >= max_nodes))
+			continue;
+		pages[status[i]]++;
+		if (status[i] >= nodes)
+			nodes = status[i] + 1;
+	}
+err:
+	free(status);
+	free(page_addrs);
+	return nodes;
+}
+#else
+void stress_numa_mbind(const stress_args_t *args, void *addr, const size_t len)
+{
+	int32_t policy = NUMA_POLICY_NONE;
+
+	(void)addr;
+	(void)len;
+
+	(void)stress_get_setting("numa-policy", &policy);
+	if ((policy != NUMA_POLICY_NONE) && (args->instance == 0))
+		pr_inf("%s: NUMA memory policies not supported, ignoring "
+			"--numa-policy\n", args->name);
+}
+
+int32_t stress_numa_remote_node(int32_t *local)
+{
+	*local = 0;
+	return -1;
+}
+
+int stress_numa_bind_node(void *addr, const size_t len, const int32_t node)
+{
+	(void)addr;
+	(void)len;
+	(void)node;
+
+	errno = ENOSYS;
+	return -1;
+}
+
+int stress_numa_pages(
+	const stress_args_t *args,
+	const void *addr,
+	const size_t len,
+	uint64_t *pages,
+	const int max_nodes)
+{
+	(void)args;
+	(void)addr;
+	(void)len;
+	(void)pages;
+	(void)max_nodes;
+
+	return 0;
+}
+#endif
+
+/*
+ *  stress_numa_report()
+ *	report the share of a stressor's pages and bandwidth on
+ *	each NUMA node when a --numa-policy is in use, the
+ *	bandwidth is skipped if mb_per_sec is zero
+ */
+void stress_numa_report(
+	const stress_args_t *args,
+	const uint64_t *pages,
+	const int nodes,
+	const double mb_per_sec)
+{
+	int32_t policy = NUMA_POLICY_NONE;
+	uint64_t total = 0;
+	bool lock = false;
+	int i;
+
+	(void)stress_get_setting("numa-policy", &policy);
+	if (policy == NUMA_POLICY_NONE)
+		return;
+
+	for (i = 0; i < nodes; i++)
+		total += pages[i];
+	if (!total)
+		return;
+
+	pr_lock(&lock);
+	for (i = 0; i < nodes; i++) {
+		const double share = (double)pages[i] / (double)total;
+
+		if (!pages[i])
+			continue;
+		if (mb_per_sec > 0.0) {
+			pr_inf_lock(&lock, "%s: node %d: %5.1f%% of pages, %.2f MB/sec "
+				"(instance %" PRIu32 ")\n", args->name, i,
+				share * 100.0, share * mb_per_sec, args->instance);
+		} else {
+			pr_inf_lock(&lock, "%s: node %d: %5.1f%% of pages "
+				"(instance %" PRIu32 ")\n", args->name, i,
+				share * 100.0, args->instance);
+		}
+	}
+	pr_unlock(&lock);
+}
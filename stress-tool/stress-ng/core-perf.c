@@ -38,6 +38,8 @@
 #define SEXTILLION	(1.0E21)
 #define SEPTILLION	(1.0E24)
 
+#define MEGABYTE	(1024.0 * 1024.0)
+
 #define UNRESOLVED	(~0UL)
 
 /* used for table of perf events to gather */
@@ -300,6 +302,36 @@ static stress_perf_info_t perf_info[STRESS_PERF_MAX] = {
 	{ 0, 0, NULL, NULL }
 };
 
+/* Metrics derived from the ratio of two perf counters */
+typedef struct {
+	const char *label;		/* human readable name of metric */
+	const char *numerator;		/* perf_info label of the numerator */
+	const char *denominator;	/* perf_info label of the denominator */
+	const double scale;		/* 100.0 for percentages */
+} stress_perf_ratio_t;
+
+static const stress_perf_ratio_t perf_ratios[] = {
+	{ "Instructions Per Cycle",	"Instructions",		"CPU Cycles",		1.0 },
+	{ "Cache Miss Percent",		"Cache Misses",		"Cache References",	100.0 },
+	{ "Branch Miss Percent",	"Branch Misses",	"Branch Instructions",	100.0 },
+	{ "L1D Read Miss Percent",	"Cache L1D Read Miss",	"Cache L1D Read",	100.0 },
+	{ "LLC Read Miss Percent",	"Cache LL Read Miss",	"Cache LL Read",	100.0 },
+	{ "DTLB Read Miss Percent",	"Cache DTLB Read Miss",	"Cache DTLB Read",	100.0 },
+	{ "ITLB Read Miss Percent",	"Cache ITLB Read Miss",	"Cache ITLB Read",	100.0 },
+};
+
+/* Uncore memory controller DRAM event, counted system wide */
+typedef struct {
+	int type;			/* uncore PMU perf type */
+	int cpu;			/* cpu the PMU counts on */
+	unsigned long config;		/* event config */
+	double scale;			/* bytes per count */
+	bool write;			/* true = writes, false = reads */
+} stress_perf_imc_t;
+
+static stress_perf_imc_t perf_imc[STRESS_PERF_IMC_MAX];
+static size_t perf_imc_count;
+
 static inline void stress_perf_type_tracepoint_resolve_config(stress_perf_info_t *pi)
 {
 	char path[PATH_MAX];
@@ -322,6 +354,148 @@ static inline void stress_perf_type_tracepoint_resolve_config(stress_perf_info_t
 	pi->config = config;
 }
 
+/*
+ *  stress_perf_sysfs_read()
+ *	read sysfs perf attribute dev/dir/name into buf,
+ *	stripping the trailing newline
+ */
+static int stress_perf_sysfs_read(
+	const char *dev,
+	const char *dir,
+	const char *name,
+	char *buf,
+	const size_t len)
+{
+	char path[PATH_MAX];
+	ssize_t ret;
+	char *ptr;
+
+	ret = snprintf(path, sizeof(path), "%s/%s/%s", dev, dir, name);
+	if ((ret < 0) || ((size_t)ret >= sizeof(path)))
+		return -1;
+	ret = system_read(path, buf, len - 1);
+	if (ret <= 0)
+		return -1;
+	buf[ret] = '\0';
+	ptr = strchr(buf, '\n');
+	if (ptr)
+		*ptr = '\0';
+	return 0;
+}
+
+/*
+ *  stress_perf_imc_config()
+ *	turn a PMU event description such as "event=0x04,umask=0x03"
+ *	into a perf config using the PMU's format fields, and get the
+ *	number of bytes each count of the event represents
+ */
+static int stress_perf_imc_config(
+	const char *dev,
+	const char *event,
+	unsigned long *config,
+	double *scale)
+{
+	char name[128], buf[256], unit[32];
+	char *term, *saveptr = NULL;
+
+	*config = 0;
+	*scale = 1.0;
+
+	if (stress_perf_sysfs_read(dev, "events", event, buf, sizeof(buf)) < 0)
+		return -1;
+
+	for (term = strtok_r(buf, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+		char *eq = strchr(term, '=');
+		char format[64];
+		unsigned long val = 1;
+		unsigned int shift;
+
+		if (eq) {
+			*eq = '\0';
+			val = strtoul(eq + 1, NULL, 0);
+		}
+		if (stress_perf_sysfs_read(dev, "format", term, format, sizeof(format)) < 0)
+			return -1;
+		/* Only events that fit in config are supported */
+		if (sscanf(format, "config:%u", &shift) != 1)
+			return -1;
+		*config |= val << shift;
+	}
+
+	(void)snprintf(name, sizeof(name), "%s.scale", event);
+	if (stress_perf_sysfs_read(dev, "events", name, buf, sizeof(buf)) == 0)
+		*scale = atof(buf);
+	(void)snprintf(name, sizeof(name), "%s.unit", event);
+	if (stress_perf_sysfs_read(dev, "events", name, unit, sizeof(unit)) < 0)
+		return -1;
+	if (!strcmp(unit, "MiB"))
+		*scale *= 1024.0 * 1024.0;
+	else if (!strcmp(unit, "KiB"))
+		*scale *= 1024.0;
+	else if (strcmp(unit, "Bytes") && strcmp(unit, "B"))
+		return -1;
+
+	return 0;
+}
+
+/*
+ *  stress_perf_imc_init()
+ *	find the uncore memory controller PMUs and their DRAM
+ *	read and write events
+ */
+static void stress_perf_imc_init(void)
+{
+	static const char * const events[][2] = {
+		{ "cas_count_read",	"cas_count_write" },	/* server IMC */
+		{ "data_reads",		"data_writes" },	/* client IMC */
+	};
+	static const char *devices = "/sys/bus/event_source/devices";
+	DIR *dir;
+	struct dirent *d;
+
+	dir = opendir(devices);
+	if (!dir)
+		return;
+
+	while ((d = readdir(dir)) != NULL) {
+		char dev[PATH_MAX], buf[64];
+		int type, cpu = 0;
+		size_t i, w;
+
+		if (strncmp(d->d_name, "uncore_imc", 10))
+			continue;
+		if (perf_imc_count + 2 > STRESS_PERF_IMC_MAX)
+			break;
+
+		(void)snprintf(dev, sizeof(dev), "%s/%s", devices, d->d_name);
+		if ((stress_perf_sysfs_read(dev, ".", "type", buf, sizeof(buf)) < 0) ||
+		    (sscanf(buf, "%d", &type) != 1))
+			continue;
+		/* Uncore PMUs count on the first cpu of their cpumask */
+		if (stress_perf_sysfs_read(dev, ".", "cpumask", buf, sizeof(buf)) == 0)
+			(void)sscanf(buf, "%d", &cpu);
+
+		for (i = 0; i < SIZEOF_ARRAY(events); i++) {
+			stress_perf_imc_t imc[2];
+
+			for (w = 0; w < 2; w++) {
+				imc[w].type = type;
+				imc[w].cpu = cpu;
+				imc[w].write = (w == 1);
+				if (stress_perf_imc_config(dev, events[i][w],
+					&imc[w].config, &imc[w].scale) < 0)
+					break;
+			}
+			if (w == 2) {
+				perf_imc[perf_imc_count++] = imc[0];
+				perf_imc[perf_imc_count++] = imc[1];
+				break;
+			}
+		}
+	}
+	(void)closedir(dir);
+}
+
 void stress_perf_init(void)
 {
 	size_t i;
@@ -331,6 +505,7 @@ void stress_perf_init(void)
 			stress_perf_type_tracepoint_resolve_config(&perf_info[i]);
 		}
 	}
+	stress_perf_imc_init();
 }
 
 static inline int stress_sys_perf_event_open(
@@ -393,6 +568,11 @@ int stress_perf_open(stress_perf_t *sp)
 		sp->perf_stat[i].fd = -1;
 		sp->perf_stat[i].counter = 0;
 	}
+	for (i = 0; i < STRESS_PERF_IMC_MAX; i++) {
+		sp->imc_stat[i].fd = -1;
+		sp->imc_stat[i].counter = 0;
+	}
+	sp->imc_opened = 0;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		if (perf_info[i].config != UNRESOLVED) {
@@ -438,6 +618,58 @@ int stress_perf_open(stress_perf_t *sp)
 	return 0;
 }
 
+/*
+ *  stress_perf_imc_open()
+ *	open the system wide memory controller counters, this is
+ *	only done by one instance of a stressor as they count the
+ *	DRAM traffic of the whole system
+ */
+int stress_perf_imc_open(stress_perf_t *sp)
+{
+	size_t i;
+
+	if (!sp || !sp->perf_opened)
+		return -1;
+
+	for (i = 0; i < perf_imc_count; i++) {
+		struct perf_event_attr attr;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = (unsigned int)perf_imc[i].type;
+		attr.config = perf_imc[i].config;
+		attr.disabled = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+				   PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.size = sizeof(attr);
+		sp->imc_stat[i].fd =
+			stress_sys_perf_event_open(&attr, -1, perf_imc[i].cpu, -1, 0);
+		if (sp->imc_stat[i].fd > -1)
+			sp->imc_opened++;
+	}
+	return sp->imc_opened ? 0 : -1;
+}
+
+/*
+ *  stress_perf_imc_ioctl()
+ *	enable or disable the memory controller counters
+ */
+static void stress_perf_imc_ioctl(stress_perf_t *sp, const unsigned long request)
+{
+	size_t i;
+
+	if (!sp->imc_opened)
+		return;
+
+	for (i = 0; i < perf_imc_count; i++) {
+		const int fd = sp->imc_stat[i].fd;
+
+		if ((fd > -1) && (ioctl(fd, request, 0) < 0)) {
+			(void)close(fd);
+			sp->imc_stat[i].fd = -1;
+		}
+	}
+}
+
 /*
  *  stress_perf_enable()
  *	enable perf counters
@@ -451,6 +683,9 @@ int stress_perf_enable(stress_perf_t *sp)
 	if (!sp->perf_opened)
 		return 0;
 
+	stress_perf_imc_ioctl(sp, PERF_EVENT_IOC_RESET);
+	stress_perf_imc_ioctl(sp, PERF_EVENT_IOC_ENABLE);
+
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
@@ -484,6 +719,8 @@ int stress_perf_disable(stress_perf_t *sp)
 	if (!sp->perf_opened)
 		return 0;
 
+	stress_perf_imc_ioctl(sp, PERF_EVENT_IOC_DISABLE);
+
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
@@ -498,6 +735,53 @@ int stress_perf_disable(stress_perf_t *sp)
 	return 0;
 }
 
+/*
+ *  stress_perf_read_scaled()
+ *	read a counter, scaling it up for the time it was
+ *	multiplexed out, STRESS_PERF_INVALID on failure
+ */
+static uint64_t stress_perf_read_scaled(const int fd)
+{
+	stress_perf_data_t data;
+	double scale;
+
+	(void)memset(&data, 0, sizeof(data));
+	if (read(fd, &data, sizeof(data)) != sizeof(data))
+		return STRESS_PERF_INVALID;
+
+	/* Ensure we don't get division by zero */
+	if (data.time_running == 0) {
+		scale = (data.time_enabled == 0) ? 1.0 : 0.0;
+	} else {
+		scale = (double)data.time_enabled /
+			(double)data.time_running;
+	}
+	return (uint64_t)((double)data.counter * scale);
+}
+
+/*
+ *  stress_perf_imc_close()
+ *	read the memory controller counters in bytes and close them
+ */
+static void stress_perf_imc_close(stress_perf_t *sp)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_PERF_IMC_MAX; i++) {
+		const int fd = sp->imc_stat[i].fd;
+		uint64_t counter = STRESS_PERF_INVALID;
+
+		if ((i < perf_imc_count) && sp->imc_opened && (fd > -1)) {
+			counter = stress_perf_read_scaled(fd);
+			if (counter != STRESS_PERF_INVALID)
+				counter = (uint64_t)((double)counter * perf_imc[i].scale);
+			(void)close(fd);
+		}
+		sp->imc_stat[i].counter = counter;
+		sp->imc_stat[i].fd = -1;
+	}
+}
+
 /*
  *  stress_perf_close()
  *	read counters and close
@@ -505,15 +789,14 @@ int stress_perf_disable(stress_perf_t *sp)
 int stress_perf_close(stress_perf_t *sp)
 {
 	size_t i = 0;
-	stress_perf_data_t data;
-	ssize_t ret;
-	double scale;
 
 	if (!sp)
 		return -1;
 	if (!sp->perf_opened)
 		goto out_ok;
 
+	stress_perf_imc_close(sp);
+
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 		if (fd < 0 ) {
@@ -521,21 +804,7 @@ int stress_perf_close(stress_perf_t *sp)
 			continue;
 		}
 
-		(void)memset(&data, 0, sizeof(data));
-		ret = read(fd, &data, sizeof(data));
-		if (ret != sizeof(data))
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
-		else {
-			/* Ensure we don't get division by zero */
-			if (data.time_running == 0) {
-				scale = (data.time_enabled == 0) ? 1.0 : 0.0;
-			} else {
-				scale = (double)data.time_enabled /
-					(double)data.time_running;
-			}
-			sp->perf_stat[i].counter = (uint64_t)
-				((double)data.counter * scale);
-		}
+		sp->perf_stat[i].counter = stress_perf_read_scaled(fd);
 		(void)close(fd);
 		sp->perf_stat[i].fd = -1;
 	}
@@ -586,6 +855,140 @@ static const char *stress_perf_stat_scale(const uint64_t counter, const double d
 	return buffer;
 }
 
+/*
+ *  stress_perf_totals()
+ *	sum the perf counters across all the instances of stressor
+ *	ss into counter_totals, and the DRAM bytes read and written
+ *	into dram_totals, returns true if any perf data was gathered
+ */
+static bool stress_perf_totals(
+	const stress_stressor_t *ss,
+	uint64_t counter_totals[STRESS_PERF_MAX],
+	uint64_t dram_totals[2])
+{
+	bool got_data = false;
+	int32_t j;
+	int p;
+
+	(void)memset(counter_totals, 0, sizeof(uint64_t) * STRESS_PERF_MAX);
+	dram_totals[0] = STRESS_PERF_INVALID;
+	dram_totals[1] = STRESS_PERF_INVALID;
+
+	for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_perf_t *sp = &ss->stats[j]->sp;
+			uint64_t counter;
+
+			if (!stress_perf_stat_succeeded(sp))
+				continue;
+
+			counter = sp->perf_stat[p].counter;
+			if (counter == STRESS_PERF_INVALID) {
+				counter_totals[p] = STRESS_PERF_INVALID;
+				break;
+			}
+			counter_totals[p] += counter;
+			got_data |= (counter > 0);
+		}
+	}
+
+	/* The memory controllers are counted system wide by one instance */
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_perf_t *sp = &ss->stats[j]->sp;
+		size_t i;
+
+		if (!stress_perf_stat_succeeded(sp) || !sp->imc_opened)
+			continue;
+
+		for (i = 0; i < perf_imc_count; i++) {
+			const uint64_t counter = sp->imc_stat[i].counter;
+			const int w = perf_imc[i].write ? 1 : 0;
+
+			if (counter == STRESS_PERF_INVALID)
+				continue;
+			if (dram_totals[w] == STRESS_PERF_INVALID)
+				dram_totals[w] = 0;
+			dram_totals[w] += counter;
+		}
+		break;
+	}
+	return got_data;
+}
+
+/*
+ *  stress_perf_counter_total()
+ *	find the total of the perf counter with the given label
+ */
+static uint64_t stress_perf_counter_total(
+	const uint64_t counter_totals[STRESS_PERF_MAX],
+	const char *label)
+{
+	int p;
+
+	for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+		if (!strcmp(perf_info[p].label, label))
+			return counter_totals[p];
+	}
+	return STRESS_PERF_INVALID;
+}
+
+/*
+ *  stress_perf_ratio()
+ *	compute derived ratio metric r, returns false if the
+ *	counters it needs are not available
+ */
+static bool stress_perf_ratio(
+	const uint64_t counter_totals[STRESS_PERF_MAX],
+	const stress_perf_ratio_t *r,
+	double *value)
+{
+	const uint64_t num = stress_perf_counter_total(counter_totals, r->numerator);
+	const uint64_t den = stress_perf_counter_total(counter_totals, r->denominator);
+
+	if ((num == STRESS_PERF_INVALID) || (den == STRESS_PERF_INVALID) || (den == 0))
+		return false;
+	*value = r->scale * (double)num / (double)den;
+	return true;
+}
+
+/*
+ *  stress_perf_derived_yaml()
+ *	add the derived perf metrics of stressor ss to the
+ *	metrics in the YAML output
+ */
+void stress_perf_derived_yaml(FILE *yaml, const stress_stressor_t *ss, const double duration)
+{
+	uint64_t counter_totals[STRESS_PERF_MAX];
+	uint64_t dram_totals[2];
+	size_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_STATS))
+		return;
+	if (!stress_perf_totals(ss, counter_totals, dram_totals))
+		return;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_ratios); i++) {
+		char yaml_label[64];
+		double value;
+		char *ptr;
+
+		if (!stress_perf_ratio(counter_totals, &perf_ratios[i], &value))
+			continue;
+		(void)stress_perf_yaml_label(yaml_label, perf_ratios[i].label, sizeof(yaml_label));
+		for (ptr = yaml_label; *ptr; ptr++) {
+			if (*ptr == '_')
+				*ptr = '-';
+		}
+		pr_yaml(yaml, "      perf-%s: %f\n", yaml_label, value);
+	}
+	if ((duration > 0.0) && (dram_totals[0] != STRESS_PERF_INVALID))
+		pr_yaml(yaml, "      perf-dram-read-mb-per-second: %f\n",
+			(double)dram_totals[0] / duration / MEGABYTE);
+	if ((duration > 0.0) && (dram_totals[1] != STRESS_PERF_INVALID))
+		pr_yaml(yaml, "      perf-dram-write-mb-per-second: %f\n",
+			(double)dram_totals[1] / duration / MEGABYTE);
+}
+
 void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const double duration)
 {
 	bool no_perf_stats = true;
@@ -599,46 +1002,12 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 
 	for (ss = stressors_list; ss; ss = ss->next) {
 		int p;
+		size_t i;
 		uint64_t counter_totals[STRESS_PERF_MAX];
-		uint64_t total_cpu_cycles = 0;
-		uint64_t total_cache_refs = 0;
-		uint64_t total_branches = 0;
-		bool got_data = false;
+		uint64_t dram_totals[2];
 		char *munged;
 
-		(void)memset(counter_totals, 0, sizeof(counter_totals));
-
-		/* Sum totals across all instances of the stressor */
-		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
-			int32_t j;
-			stress_perf_t *sp = &ss->stats[0]->sp;
-
-			if (!stress_perf_stat_succeeded(sp))
-				continue;
-
-			for (j = 0; j < ss->started_instances; j++) {
-				const uint64_t counter = sp->perf_stat[p].counter;
-
-				if (counter == STRESS_PERF_INVALID) {
-					counter_totals[p] = STRESS_PERF_INVALID;
-					break;
-				}
-				counter_totals[p] += counter;
-				got_data |= (counter > 0);
-			}
-			if (perf_info[p].type == PERF_TYPE_HARDWARE) {
-				unsigned long config = perf_info[p].config;
-
-				if (config == PERF_COUNT_HW_CPU_CYCLES)
-					total_cpu_cycles = counter_totals[p];
-				else if (config == PERF_COUNT_HW_CACHE_REFERENCES)
-					total_cache_refs = counter_totals[p];
-				else if (config == PERF_COUNT_HW_BRANCH_INSTRUCTIONS)
-					total_branches = counter_totals[p];
-			}
-		}
-
-		if (!got_data)
+		if (!stress_perf_totals(ss, counter_totals, dram_totals))
 			continue;
 
 		munged = stress_munge_underscore(ss->stressor->name);
@@ -657,23 +1026,21 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 
 				no_perf_stats = false;
 
-				if (perf_info[p].type == PERF_TYPE_HARDWARE) {
-					unsigned long config = perf_info[p].config;
-					if ((config == PERF_COUNT_HW_INSTRUCTIONS) &&
-					    (total_cpu_cycles > 0))
-						(void)snprintf(extra, sizeof(extra),
-							" (%.3f instr. per cycle)",
-							(double)ct / (double)total_cpu_cycles);
-					else if ((config == PERF_COUNT_HW_CACHE_MISSES) &&
-					     (total_cache_refs > 0))
+				/* Show the ratio this counter is the numerator of */
+				for (i = 0; i < SIZEOF_ARRAY(perf_ratios); i++) {
+					const stress_perf_ratio_t *r = &perf_ratios[i];
+					double value;
+
+					if (strcmp(r->numerator, l) ||
+					    !stress_perf_ratio(counter_totals, r, &value))
+						continue;
+					if (r->scale == 1.0)
 						(void)snprintf(extra, sizeof(extra),
-							" (%5.2f%%)",
-							100.0 * (double)ct / (double)total_cache_refs);
-					else if ((config == PERF_COUNT_HW_BRANCH_MISSES) &&
-					    (total_branches > 0))
+							" (%.3f instr. per cycle)", value);
+					else
 						(void)snprintf(extra, sizeof(extra),
-							" (%5.2f%%)",
-							100.0 * (double)ct / (double)total_branches);
+							" (%5.2f%%)", value);
+					break;
 				}
 
 				pr_inf("%'26" PRIu64 " %-24s %s%s\n",
@@ -688,6 +1055,36 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 					yaml_label, (double)ct / duration);
 			}
 		}
+
+		for (i = 0; i < 2; i++) {
+			static const char * const labels[] = {
+				"DRAM Read Bytes",
+				"DRAM Write Bytes",
+			};
+			char yaml_label[64];
+			const double mb_per_sec = (duration > 0.0) ?
+				(double)dram_totals[i] / duration / MEGABYTE : 0.0;
+
+			if (dram_totals[i] == STRESS_PERF_INVALID)
+				continue;
+			pr_inf("%'26" PRIu64 " %-24s %11.2f MB/sec\n",
+				dram_totals[i], labels[i], mb_per_sec);
+			stress_perf_yaml_label(yaml_label, labels[i], sizeof(yaml_label));
+			pr_yaml(yaml, "      %s_total: %" PRIu64 "\n",
+				yaml_label, dram_totals[i]);
+			pr_yaml(yaml, "      %s_mb_per_second: %f\n",
+				yaml_label, mb_per_sec);
+		}
+
+		for (i = 0; i < SIZEOF_ARRAY(perf_ratios); i++) {
+			char yaml_label[64];
+			double value;
+
+			if (!stress_perf_ratio(counter_totals, &perf_ratios[i], &value))
+				continue;
+			stress_perf_yaml_label(yaml_label, perf_ratios[i].label, sizeof(yaml_label));
+			pr_yaml(yaml, "      %s: %f\n", yaml_label, value);
+		}
 		pr_yaml(yaml, "\n");
 	}
 	if (no_perf_stats) {
@@ -716,3 +1113,56 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 	}
 }
 #endif
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open)
+/*
+ *  stress_perf_llc_open()
+ *	open a last level cache read miss counter for the
+ *	calling process, user space only, returns the
+ *	counter fd or -1 if it is not available
+ */
+int stress_perf_llc_open(void)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_LL |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ *  stress_perf_llc_read()
+ *	read the last level cache read miss count, 0 if
+ *	the counter could not be opened or read
+ */
+uint64_t stress_perf_llc_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if (fd < 0)
+		return 0;
+	if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count))
+		return 0;
+	return count;
+}
+#else
+int stress_perf_llc_open(void)
+{
+	return -1;
+}
+
+uint64_t stress_perf_llc_read(const int fd)
+{
+	(void)fd;
+
+	return 0;
+}
+#endif
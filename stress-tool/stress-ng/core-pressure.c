@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define PRESSURE_PATH		"/proc/pressure/memory"
+#define PRESSURE_PERIOD		(1.0)	/* seconds between control steps */
+#define PRESSURE_MIN_STEP	(16 * MB)
+
+static pid_t pressure_pid;
+static double pressure_target = 0.0;
+static bool pressure_full = false;
+
+/*
+ *  stress_set_pressure()
+ *	set the memory pressure stall percentage to ramp up to and hold
+ */
+int stress_set_pressure(const char *const opt)
+{
+	pressure_target = atof(opt);
+	if ((pressure_target <= 0.0) || (pressure_target >= 100.0)) {
+		(void)fprintf(stderr, "pressure must be greater than 0 and "
+			"less than 100 percent\n");
+		_exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_pressure_full()
+ *	control on the share of time all tasks stall on memory
+ *	rather than the time at least one task stalls
+ */
+int stress_set_pressure_full(const char *const opt)
+{
+	(void)opt;
+
+	pressure_full = true;
+	return 0;
+}
+
+#if defined(__linux__)
+
+static volatile bool pressure_run;
+
+static void MLOCKED_TEXT stress_pressure_handler(int signum)
+{
+	(void)signum;
+
+	pressure_run = false;
+}
+
+/*
+ *  stress_pressure_read()
+ *	read the total memory stall time in microseconds of the
+ *	some or full line of the memory pressure stall information
+ */
+static int stress_pressure_read(const bool full, uint64_t *total)
+{
+	FILE *fp;
+	char buffer[256];
+	int rc = -1;
+
+	fp = fopen(PRESSURE_PATH, "r");
+	if (!fp)
+		return -1;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		const char *ptr;
+
+		if (strncmp(buffer, full ? "full " : "some ", 5))
+			continue;
+		ptr = strstr(buffer, "total=");
+		if (ptr && (sscanf(ptr + 6, "%" SCNu64, total) == 1))
+			rc = 0;
+		break;
+	}
+	(void)fclose(fp);
+	return rc;
+}
+
+/*
+ *  stress_pressure_grow()
+ *	touch more pages of the balloon, a quarter of each page is
+ *	random so that pages do not compress to nothing on zram/zswap
+ */
+static size_t stress_pressure_grow(
+	uint8_t *balloon,
+	const size_t resident,
+	const size_t step,
+	const size_t max,
+	const size_t page_size)
+{
+	size_t i, end = resident + step;
+
+	if (end > max)
+		end = max;
+	for (i = resident; pressure_run && (i < end); i += page_size) {
+		stress_mwc_fill(balloon + i, page_size / 4);
+		(void)memset(balloon + i + (page_size / 4), 0x5a, page_size - (page_size / 4));
+	}
+	return i;
+}
+
+/*
+ *  stress_pressure_shrink()
+ *	give back the top step bytes of the balloon
+ */
+static size_t stress_pressure_shrink(
+	uint8_t *balloon,
+	const size_t resident,
+	const size_t step)
+{
+	const size_t len = (step > resident) ? resident : step;
+
+	(void)shim_madvise(balloon + resident - len, len, MADV_DONTNEED);
+	return resident - len;
+}
+
+/*
+ *  stress_pressure_controller()
+ *	adjust the size of a resident balloon every period so that the
+ *	share of time tasks stall on memory converges on the target
+ */
+static void stress_pressure_controller(const bool full)
+{
+	const size_t page_size = stress_get_pagesize();
+	size_t shmall, freemem, totalmem, freeswap, max, step, ramp, resident = 0;
+	uint64_t total_prev, total_now, hold_periods = 0, periods = 0;
+	double t_prev, pressure = 0.0, hold_sum = 0.0;
+	uint8_t *balloon;
+	bool reached = false;
+
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	max = (totalmem + freeswap) & ~(page_size - 1);
+	step = (totalmem / 64) & ~(page_size - 1);
+	if (step < PRESSURE_MIN_STEP)
+		step = PRESSURE_MIN_STEP;
+	ramp = step;
+
+	balloon = (uint8_t *)mmap(NULL, max, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (balloon == MAP_FAILED) {
+		pr_err("pressure: cannot mmap %zu byte balloon, errno=%d (%s)\n",
+			max, errno, strerror(errno));
+		return;
+	}
+	(void)shim_madvise(balloon, max, MADV_NOHUGEPAGE);
+
+	if (stress_pressure_read(full, &total_prev) < 0)
+		goto unmap;
+	t_prev = stress_time_now();
+
+	while (pressure_run) {
+		double t_now, delta, error;
+
+		(void)shim_usleep((uint64_t)(PRESSURE_PERIOD * 1000000.0));
+		if (!pressure_run)
+			break;
+		if (stress_pressure_read(full, &total_now) < 0)
+			break;
+		t_now = stress_time_now();
+		delta = t_now - t_prev;
+		if (delta <= 0.0)
+			continue;
+
+		/* Stall share of the last period, smoothed a little */
+		pressure = (pressure + (100.0 * (double)(total_now - total_prev) /
+			(delta * 1000000.0))) / 2.0;
+		total_prev = total_now;
+		t_prev = t_now;
+		periods++;
+
+		/*
+		 *  Within a quarter of the target is holding, otherwise
+		 *  grow or shrink by a step scaled by how far off we are
+		 */
+		error = (pressure_target - pressure) / pressure_target;
+		if (error < 0.25)
+			reached = true;
+		if ((error > -0.25) && (error < 0.25)) {
+			hold_sum += pressure;
+			hold_periods++;
+			ramp = step;
+		} else if (error > 0.5) {
+			/*
+			 *  Far below target, ramp up geometrically until
+			 *  the target is first reached, then step linearly
+			 */
+			resident = stress_pressure_grow(balloon, resident,
+				ramp, max, page_size);
+			if (!reached && (ramp < max / 32))
+				ramp *= 2;
+		} else if (error > 0.0) {
+			resident = stress_pressure_grow(balloon, resident,
+				step / 4, max, page_size);
+			ramp = step;
+		} else {
+			resident = stress_pressure_shrink(balloon, resident,
+				error < -1.0 ? step : step / 4);
+			ramp = step;
+		}
+		pr_dbg("pressure: %s %.2f%% (target %.2f%%), balloon %.1f MB\n",
+			full ? "full" : "some", pressure, pressure_target,
+			(double)resident / (double)MB);
+	}
+
+	if (hold_periods) {
+		pr_inf("pressure: held %s memory pressure at %.2f%% (target %.2f%%) "
+			"for %.0f seconds with a %.1f MB balloon\n",
+			full ? "full" : "some", hold_sum / (double)hold_periods,
+			pressure_target, (double)hold_periods * PRESSURE_PERIOD,
+			(double)resident / (double)MB);
+	} else if (periods) {
+		pr_inf("pressure: did not reach %.2f%% %s memory pressure, "
+			"got to %.2f%% with a %.1f MB balloon\n", pressure_target,
+			full ? "full" : "some", pressure,
+			(double)resident / (double)MB);
+	}
+unmap:
+	(void)munmap((void *)balloon, max);
+}
+
+/*
+ *  stress_pressure_start()
+ *	start the memory pressure controller process
+ */
+void stress_pressure_start(void)
+{
+	uint64_t total;
+
+	if (pressure_target <= 0.0)
+		return;
+	if (stress_pressure_read(pressure_full, &total) < 0) {
+		pr_inf("cannot read %s, ignoring --pressure option\n", PRESSURE_PATH);
+		return;
+	}
+
+	pressure_run = true;
+	pressure_pid = fork();
+	if (pressure_pid < 0) {
+		pressure_run = false;
+		pr_err("pressure background process failed to fork: %d (%s)\n",
+			errno, strerror(errno));
+		return;
+	} else if (pressure_pid == 0) {
+		stress_set_proc_name("stress-ng-pressure");
+		/* The balloon should be the first to go if the OOM killer runs */
+		stress_set_oom_adjustment("pressure", true);
+		if (stress_sighandler("pressure", SIGALRM, stress_pressure_handler, NULL) < 0)
+			_exit(0);
+		stress_pressure_controller(pressure_full);
+		_exit(0);
+	}
+}
+
+/*
+ *  stress_pressure_stop()
+ *	stop the memory pressure controller process
+ */
+void stress_pressure_stop(void)
+{
+	int status;
+
+	if (pressure_pid <= 0)
+		return;
+
+	(void)kill(pressure_pid, SIGALRM);
+	(void)shim_waitpid(pressure_pid, &status, 0);
+	pressure_pid = 0;
+}
+#else
+void stress_pressure_start(void)
+{
+	if (pressure_target > 0.0)
+		pr_inf("memory pressure stall information not supported, "
+			"ignoring --pressure option\n");
+}
+
+void stress_pressure_stop(void)
+{
+}
+#endif
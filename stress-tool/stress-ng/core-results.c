@@ -0,0 +1,586 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+/*
+ *  The results store is an append-only tab separated file, one
+ *  record per stressor per run, keyed by the leading host, kernel,
+ *  version and config fields so it can also be filtered with the
+ *  usual text tools
+ */
+#define RESULTS_MAGIC		"# stress-ng results v1"
+#define RESULTS_FIELDS		(13)
+#define RESULTS_DEFAULT_THRESHOLD (3.0)	/* percent */
+
+#define RESULTS_F_RUN		(0)	/* unique run id */
+#define RESULTS_F_HOST		(1)
+#define RESULTS_F_KERNEL	(2)
+#define RESULTS_F_VERSION	(3)	/* stress-ng version */
+#define RESULTS_F_CONFIG	(4)	/* hash of the run options */
+#define RESULTS_F_STRESSOR	(5)
+#define RESULTS_F_INSTANCES	(6)
+#define RESULTS_F_DURATION	(7)
+#define RESULTS_F_BOGO_OPS	(8)
+#define RESULTS_F_RATE		(9)	/* bogo ops/s, real time */
+#define RESULTS_F_RATE_CPU	(10)	/* bogo ops/s, usr+sys time */
+#define RESULTS_F_INSTANCE_RATES (11)	/* comma separated per instance bogo ops/s */
+#define RESULTS_F_ARGS		(12)	/* the run options */
+
+/* growable array of samples */
+typedef struct {
+	double *val;
+	size_t n;
+	size_t max;
+} stress_results_samples_t;
+
+/* mean, variance and count of a sample set */
+typedef struct {
+	double mean;
+	double var;
+	size_t n;
+} stress_results_stats_t;
+
+static double results_threshold = RESULTS_DEFAULT_THRESHOLD;
+static char *results_db;
+static char *results_baseline;
+static char *results_key;
+
+/*
+ *  stress_set_results_threshold()
+ *	set the throughput change in percent that is flagged
+ */
+int stress_set_results_threshold(const char *const opt)
+{
+	results_threshold = atof(opt);
+	if ((results_threshold <= 0.0) || (results_threshold > 100.0)) {
+		(void)fprintf(stderr, "results-threshold must be in the range 0 to 100 percent.\n");
+		_exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+/*
+ *  stress_results_init()
+ *	fetch the results store settings, these are global so must be
+ *	read before the per stressor settings are in scope
+ */
+void stress_results_init(void)
+{
+	(void)stress_get_setting("results-db", &results_db);
+	(void)stress_get_setting("results-baseline", &results_baseline);
+	(void)stress_get_setting("results-key", &results_key);
+}
+
+/*
+ *  stress_results_ignore_opt()
+ *	options that do not change what is measured, so are left out
+ *	of the config key, returns the number of argv entries to skip
+ */
+static int stress_results_ignore_opt(const char *arg)
+{
+	static const struct {
+		const char *opt;
+		const bool has_arg;
+	} ignore[] = {
+		{ "--results-db",	true },
+		{ "--results-baseline",	true },
+		{ "--results-threshold", true },
+		{ "--results-key",	true },
+		{ "--yaml",		true },
+		{ "-Y",			true },
+		{ "--log-file",		true },
+		{ "--quiet",		false },
+		{ "-q",			false },
+		{ "--verbose",		false },
+		{ "-v",			false },
+		{ "--metrics",		false },
+		{ "--metrics-brief",	false },
+		{ "-M",			false },
+	};
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(ignore); i++) {
+		const size_t len = strlen(ignore[i].opt);
+
+		if (strncmp(arg, ignore[i].opt, len))
+			continue;
+		if (arg[len] == '\0')
+			return ignore[i].has_arg ? 2 : 1;
+		if (ignore[i].has_arg && (arg[len] == '='))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_results_args()
+ *	the run options as one string, tabs replaced by spaces
+ */
+static void stress_results_args(
+	char *buf,
+	const size_t len,
+	const int argc,
+	char * const *argv)
+{
+	size_t pos = 0;
+	char *ptr;
+	int i;
+
+	*buf = '\0';
+	for (i = 1; (i < argc) && (pos < len - 1); ) {
+		const int skip = stress_results_ignore_opt(argv[i]);
+
+		if (skip) {
+			i += skip;
+			continue;
+		}
+		pos += (size_t)snprintf(buf + pos, len - pos, "%s%s", pos ? " " : "", argv[i]);
+		i++;
+	}
+	for (ptr = buf; *ptr; ptr++)
+		if ((*ptr == '\t') || (*ptr == '\n'))
+			*ptr = ' ';
+}
+
+/*
+ *  stress_results_sanitize()
+ *	copy a field value with any tabs and newlines replaced
+ */
+static void stress_results_sanitize(char *dst, const size_t len, const char *src)
+{
+	char *ptr;
+
+	(void)shim_strlcpy(dst, src, len);
+	for (ptr = dst; *ptr; ptr++)
+		if ((*ptr == '\t') || (*ptr == '\n'))
+			*ptr = ' ';
+}
+
+static void stress_results_add(stress_results_samples_t *s, const double val)
+{
+	if (s->n >= s->max) {
+		const size_t max = s->max ? s->max * 2 : 64;
+		double *tmp;
+
+		tmp = realloc(s->val, max * sizeof(*s->val));
+		if (!tmp)
+			return;
+		s->val = tmp;
+		s->max = max;
+	}
+	s->val[s->n++] = val;
+}
+
+static void stress_results_stats(const stress_results_samples_t *s, stress_results_stats_t *st)
+{
+	size_t i;
+	double sum = 0.0, sq = 0.0;
+
+	st->n = s->n;
+	st->mean = 0.0;
+	st->var = 0.0;
+	if (!s->n)
+		return;
+	for (i = 0; i < s->n; i++)
+		sum += s->val[i];
+	st->mean = sum / (double)s->n;
+	if (s->n < 2)
+		return;
+	for (i = 0; i < s->n; i++) {
+		const double d = s->val[i] - st->mean;
+
+		sq += d * d;
+	}
+	st->var = sq / (double)(s->n - 1);
+}
+
+/*
+ *  stress_results_t975()
+ *	two sided 95% critical value of the t distribution with df
+ *	degrees of freedom, Cornish-Fisher expansion around the normal
+ */
+static double stress_results_t975(const double df)
+{
+	const double z = 1.959963985;
+	const double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+
+	if (df < 1.0)
+		return 12.706;
+	return z + (z3 + z) / (4.0 * df) +
+		(5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df) +
+		(3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * df * df * df);
+}
+
+/*
+ *  stress_results_split()
+ *	split a record into its tab separated fields, returns
+ *	false if it has the wrong number of fields
+ */
+static bool stress_results_split(char *line, char *fields[RESULTS_FIELDS])
+{
+	size_t n = 0;
+	char *ptr = line, *tab;
+
+	line[strcspn(line, "\n")] = '\0';
+	if ((*line == '#') || (*line == '\0'))
+		return false;
+	while (n < RESULTS_FIELDS) {
+		fields[n++] = ptr;
+		tab = strchr(ptr, '\t');
+		if (!tab)
+			break;
+		*tab = '\0';
+		ptr = tab + 1;
+	}
+	return n == RESULTS_FIELDS;
+}
+
+/*
+ *  stress_results_rate()
+ *	bogo ops per second of all the instances of a stressor
+ *	in real time, usr+sys time and per instance
+ */
+static void stress_results_rate(
+	const stress_stressor_t *ss,
+	const int32_t ticks_per_sec,
+	uint64_t *c_total,
+	double *r_total,
+	double *rate,
+	double *rate_cpu)
+{
+	uint64_t us_total = 0;
+	int32_t j;
+
+	*c_total = 0;
+	*r_total = 0.0;
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		*c_total += stats->ci.counter;
+		us_total += (uint64_t)(stats->tms.tms_utime + stats->tms.tms_cutime +
+				       stats->tms.tms_stime + stats->tms.tms_cstime);
+		*r_total += stats->finish - stats->start;
+	}
+	*r_total = ss->started_instances ? *r_total / (double)ss->started_instances : 0.0;
+	*rate = (*r_total > 0.0) ? (double)*c_total / *r_total : 0.0;
+	*rate_cpu = ((us_total > 0) && (ticks_per_sec > 0)) ?
+		(double)*c_total / ((double)us_total / (double)ticks_per_sec) : 0.0;
+}
+
+/*
+ *  stress_results_append()
+ *	append a record for each stressor of this run
+ */
+static int stress_results_append(
+	const char *filename,
+	stress_stressor_t *stressors_list,
+	const int32_t ticks_per_sec,
+	const char *run,
+	const char *host,
+	const char *kernel,
+	const char *config,
+	const char *args)
+{
+	stress_stressor_t *ss;
+	struct stat statbuf;
+	FILE *fp;
+	int n = 0;
+
+	fp = fopen(filename, "a");
+	if (!fp) {
+		pr_err("results: cannot append to %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return -1;
+	}
+	if ((fstat(fileno(fp), &statbuf) == 0) && (statbuf.st_size == 0)) {
+		(void)fprintf(fp, "%s: run host kernel version config stressor instances "
+			"duration bogo-ops bogo-ops-per-sec bogo-ops-per-sec-usr-sys "
+			"instance-bogo-ops-per-sec args\n", RESULTS_MAGIC);
+	}
+	for (ss = stressors_list; ss; ss = ss->next) {
+		uint64_t c_total;
+		double r_total, rate, rate_cpu;
+		int32_t j;
+
+		if (!ss->started_instances)
+			continue;
+		stress_results_rate(ss, ticks_per_sec, &c_total, &r_total, &rate, &rate_cpu);
+		if (!c_total)
+			continue;
+
+		(void)fprintf(fp, "%s\t%s\t%s\t%s\t%s\t%s\t%" PRId32 "\t%.3f\t%" PRIu64 "\t%.3f\t%.3f\t",
+			run, host, kernel, VERSION, config,
+			stress_munge_underscore(ss->stressor->name),
+			ss->started_instances, r_total, c_total, rate, rate_cpu);
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			const double t = stats->finish - stats->start;
+
+			(void)fprintf(fp, "%s%.3f", j ? "," : "",
+				(t > 0.0) ? (double)stats->ci.counter / t : 0.0);
+		}
+		(void)fprintf(fp, "\t%s\n", args);
+		n++;
+	}
+	(void)fclose(fp);
+	pr_inf("results: appended %d stressor result%s to %s\n", n, n == 1 ? "" : "s", filename);
+	return 0;
+}
+
+/*
+ *  stress_results_last_kernel()
+ *	the kernel of the most recent record of this host and config
+ *	run on a different kernel, NULL if there is none
+ */
+static char *stress_results_last_kernel(
+	const char *filename,
+	const char *host,
+	const char *kernel,
+	const char *config)
+{
+	FILE *fp;
+	char *line = NULL, *last = NULL;
+	size_t line_len = 0;
+
+	fp = fopen(filename, "r");
+	if (!fp)
+		return NULL;
+	while (getline(&line, &line_len, fp) > 0) {
+		char *f[RESULTS_FIELDS];
+
+		if (!stress_results_split(line, f))
+			continue;
+		if (strcmp(f[RESULTS_F_HOST], host) ||
+		    strcmp(f[RESULTS_F_VERSION], VERSION) ||
+		    strcmp(f[RESULTS_F_CONFIG], config) ||
+		    !strcmp(f[RESULTS_F_KERNEL], kernel))
+			continue;
+		free(last);
+		last = strdup(f[RESULTS_F_KERNEL]);
+	}
+	free(line);
+	(void)fclose(fp);
+	return last;
+}
+
+/*
+ *  stress_results_compare_stressor()
+ *	compare the throughput of one stressor with the baseline
+ *	kernel runs, returns true if it regressed significantly
+ */
+static bool stress_results_compare_stressor(
+	const char *filename,
+	const char *name,
+	const char *run,
+	const char *host,
+	const char *kernel,
+	const char *baseline,
+	const char *config)
+{
+	stress_results_samples_t runs[2], insts[2];
+	stress_results_stats_t b, c;
+	const bool same_kernel = !strcmp(baseline, kernel);
+	const stress_results_samples_t *bs, *cs;
+	FILE *fp;
+	char *line = NULL;
+	size_t line_len = 0;
+	double delta, lo = 0.0, hi = 0.0;
+	const char *verdict, *level;
+	bool regressed = false;
+	char ci[32];
+
+	(void)memset(runs, 0, sizeof(runs));
+	(void)memset(insts, 0, sizeof(insts));
+
+	fp = fopen(filename, "r");
+	if (!fp)
+		return false;
+	while (getline(&line, &line_len, fp) > 0) {
+		char *f[RESULTS_FIELDS], *ptr, *end;
+		int side;
+
+		if (!stress_results_split(line, f))
+			continue;
+		if (strcmp(f[RESULTS_F_STRESSOR], name) ||
+		    strcmp(f[RESULTS_F_HOST], host) ||
+		    strcmp(f[RESULTS_F_VERSION], VERSION) ||
+		    strcmp(f[RESULTS_F_CONFIG], config))
+			continue;
+
+		/*
+		 *  The current side is this run and, when the baseline is
+		 *  another kernel, earlier runs on this kernel too
+		 */
+		if (!strcmp(f[RESULTS_F_RUN], run))
+			side = 1;
+		else if (!strcmp(f[RESULTS_F_KERNEL], baseline))
+			side = 0;
+		else if (!same_kernel && !strcmp(f[RESULTS_F_KERNEL], kernel))
+			side = 1;
+		else
+			continue;
+
+		stress_results_add(&runs[side], atof(f[RESULTS_F_RATE]));
+		for (ptr = f[RESULTS_F_INSTANCE_RATES]; *ptr; ptr = end) {
+			const double val = strtod(ptr, &end);
+
+			if (end == ptr)
+				break;
+			stress_results_add(&insts[side], val);
+			if (*end == ',')
+				end++;
+		}
+	}
+	free(line);
+	(void)fclose(fp);
+
+	/*
+	 *  Run to run variation dominates, so compare per run rates when
+	 *  both sides have repeated runs, otherwise fall back to the rates
+	 *  of the instances
+	 */
+	if ((runs[0].n >= 2) && (runs[1].n >= 2)) {
+		bs = &runs[0];
+		cs = &runs[1];
+		level = "runs";
+	} else {
+		bs = &insts[0];
+		cs = &insts[1];
+		level = "instances";
+	}
+	stress_results_stats(bs, &b);
+	stress_results_stats(cs, &c);
+
+	if (!b.n || (b.mean <= 0.0)) {
+		pr_inf("%-13s %14s\n", name, "no baseline");
+		goto free_samples;
+	}
+	delta = 100.0 * (c.mean - b.mean) / b.mean;
+	if ((b.n >= 2) && (c.n >= 2)) {
+		const double vb = b.var / (double)b.n, vc = c.var / (double)c.n;
+		const double se = sqrt(vb + vc);
+		const double den = ((vb * vb) / (double)(b.n - 1)) + ((vc * vc) / (double)(c.n - 1));
+		const double df = (den > 0.0) ? ((vb + vc) * (vb + vc)) / den : (double)(b.n + c.n - 2);
+		const double half = stress_results_t975(df) * se;
+
+		lo = 100.0 * ((c.mean - b.mean) - half) / b.mean;
+		hi = 100.0 * ((c.mean - b.mean) + half) / b.mean;
+		(void)snprintf(ci, sizeof(ci), "%+.2f..%+.2f", lo, hi);
+
+		if ((delta <= -results_threshold) && (hi < 0.0)) {
+			verdict = "REGRESSION";
+			regressed = true;
+		} else if (delta <= -results_threshold) {
+			verdict = "possible regression, not significant";
+		} else if ((delta >= results_threshold) && (lo > 0.0)) {
+			verdict = "improvement";
+		} else if (hi - lo > 2.0 * results_threshold) {
+			verdict = "no change detected, interval too wide, add runs";
+		} else {
+			verdict = "no change";
+		}
+	} else {
+		(void)shim_strlcpy(ci, "n/a", sizeof(ci));
+		verdict = "too few samples to test";
+	}
+	pr_inf("%-13s %14.2f %4zu %14.2f %4zu %+8.2f %17s %-9s %s\n",
+		name, b.mean, b.n, c.mean, c.n, delta, ci, level, verdict);
+
+free_samples:
+	free(runs[0].val);
+	free(runs[1].val);
+	free(insts[0].val);
+	free(insts[1].val);
+	return regressed;
+}
+
+/*
+ *  stress_results_store()
+ *	append the results of this run to the --results-db store and
+ *	with --results-baseline compare the throughput of each stressor
+ *	with the runs of the baseline kernel, returns true if one or
+ *	more stressors regressed significantly
+ */
+bool stress_results_store(
+	stress_stressor_t *stressors_list,
+	const int32_t ticks_per_sec,
+	const int argc,
+	char * const *argv)
+{
+	const char *filename = results_db, *baseline = results_baseline;
+	char *last = NULL;
+	char run[64], host[256], kernel[256], config[256], args[4096];
+	stress_stressor_t *ss;
+	struct utsname uts;
+	bool regressed = false;
+
+	if (!filename) {
+		if (baseline)
+			pr_inf("results: --results-baseline needs a --results-db store\n");
+		return false;
+	}
+
+	(void)memset(&uts, 0, sizeof(uts));
+	if (uname(&uts) < 0) {
+		(void)shim_strlcpy(uts.nodename, "unknown", sizeof(uts.nodename));
+		(void)shim_strlcpy(uts.release, "unknown", sizeof(uts.release));
+	}
+	stress_results_sanitize(host, sizeof(host), uts.nodename);
+	stress_results_sanitize(kernel, sizeof(kernel), uts.release);
+	(void)snprintf(run, sizeof(run), "%.6f-%d", stress_time_now(), (int)getpid());
+	stress_results_args(args, sizeof(args), argc, argv);
+	if (results_key)
+		stress_results_sanitize(config, sizeof(config), results_key);
+	else
+		(void)snprintf(config, sizeof(config), "%08" PRIx32,
+			stress_hash_jenkin((const uint8_t *)args, strlen(args)));
+
+	if (stress_results_append(filename, stressors_list, ticks_per_sec,
+				  run, host, kernel, config, args) < 0)
+		return false;
+	if (!baseline)
+		return false;
+
+	if (!strcmp(baseline, "last")) {
+		last = stress_results_last_kernel(filename, host, kernel, config);
+		if (!last) {
+			pr_inf("results: no runs of config %s on a kernel other than %s to compare with\n",
+				config, kernel);
+			return false;
+		}
+		baseline = last;
+	}
+
+	pr_inf("results: throughput against kernel %s, host %s, config %s, %.1f%% threshold\n",
+		baseline, host, config, results_threshold);
+	pr_inf("%-13s %14s %4s %14s %4s %8s %17s %-9s %s\n",
+		"stressor", "baseline op/s", "n", "current op/s", "n",
+		"change %", "95% CI %", "samples", "verdict");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (!ss->started_instances)
+			continue;
+		if (stress_results_compare_stressor(filename,
+				stress_munge_underscore(ss->stressor->name),
+				run, host, kernel, baseline, config))
+			regressed = true;
+	}
+	free(last);
+
+	return regressed;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define SAMPLE_FORMAT_JSON	(0)
+#define SAMPLE_FORMAT_YAML	(1)
+
+/* Previous sample of one stressor instance */
+typedef struct {
+	uint64_t counter;	/* bogo ops at last sample */
+	double when;		/* time of last sample */
+} stress_sample_t;
+
+static pid_t sample_pid;
+static int32_t sample_delay = 0;
+
+/*
+ *  stress_set_sample()
+ *	set the bogo-ops sampling interval in seconds
+ */
+int stress_set_sample(const char *const opt)
+{
+	sample_delay = stress_get_int32(opt);
+	if ((sample_delay < 1) || (sample_delay > 3600)) {
+		(void)fprintf(stderr, "sample must in the range 1 to 3600.\n");
+		_exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_sample_format()
+ *	set the bogo-ops sample output format, json or yaml
+ */
+int stress_set_sample_format(const char *const opt)
+{
+	int32_t format;
+
+	if (!strcmp(opt, "json")) {
+		format = SAMPLE_FORMAT_JSON;
+	} else if (!strcmp(opt, "yaml")) {
+		format = SAMPLE_FORMAT_YAML;
+	} else {
+		(void)fprintf(stderr, "sample-format must be json or yaml\n");
+		_exit(EXIT_FAILURE);
+	}
+	return stress_set_setting_global("sample-format", TYPE_ID_INT32, &format);
+}
+
+/*
+ *  stress_sample_instance()
+ *	output the bogo-ops rate of one stressor instance since
+ *	its previous sample
+ */
+static void stress_sample_instance(
+	FILE *fp,
+	const int32_t format,
+	const double t_start,
+	const char *name,
+	const int32_t instance,
+	const stress_stats_t *stats,
+	stress_sample_t *prev)
+{
+	const double start = stats->start;
+	const double finish = stats->finish;
+	const uint64_t counter = stress_stats_counter(stats);
+	const double now = stress_time_now();
+	double from, rate;
+
+	/* Not started yet */
+	if (start <= 0.0)
+		return;
+	/* Finished before the previous sample */
+	if ((finish > start) && (finish < prev->when))
+		return;
+
+	/* Counters are reset when a stressor is run again */
+	if (counter < prev->counter) {
+		prev->counter = 0;
+		prev->when = 0.0;
+	}
+	from = (prev->when > start) ? prev->when : start;
+	if ((finish > start) && (finish < now)) {
+		rate = (finish > from) ?
+			(double)(counter - prev->counter) / (finish - from) : 0.0;
+	} else {
+		rate = (now > from) ?
+			(double)(counter - prev->counter) / (now - from) : 0.0;
+	}
+	prev->counter = counter;
+	prev->when = now;
+
+	if (format == SAMPLE_FORMAT_YAML) {
+		(void)fprintf(fp, "    - time: %.3f\n", now - t_start);
+		(void)fprintf(fp, "      stressor: %s\n", name);
+		(void)fprintf(fp, "      instance: %" PRId32 "\n", instance);
+		(void)fprintf(fp, "      bogo-ops: %" PRIu64 "\n", counter);
+		(void)fprintf(fp, "      bogo-ops-per-second: %.2f\n", rate);
+	} else {
+		(void)fprintf(fp, "{\"time\":%.3f,\"stressor\":\"%s\","
+			"\"instance\":%" PRId32 ",\"bogo-ops\":%" PRIu64 ","
+			"\"bogo-ops-per-second\":%.2f}\n",
+			now - t_start, name, instance, counter, rate);
+	}
+}
+
+/*
+ *  stress_sample_start()
+ *	start sampling the bogo-ops counters of all the stressors
+ *	every sample_delay seconds
+ */
+void stress_sample_start(stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	stress_sample_t *samples;
+	size_t n = 0;
+	char *sample_filename = NULL;
+	int32_t format = SAMPLE_FORMAT_JSON;
+	FILE *fp = stdout;
+	double t_start, t_next;
+
+	if (sample_delay == 0)
+		return;
+
+	(void)stress_get_setting("sample-file", &sample_filename);
+	(void)stress_get_setting("sample-format", &format);
+
+	if (sample_filename) {
+		fp = fopen(sample_filename, "w");
+		if (!fp) {
+			pr_err("Cannot output samples to %s, errno=%d (%s)\n",
+				sample_filename, errno, strerror(errno));
+			return;
+		}
+	}
+
+	(void)fflush(stdout);
+	sample_pid = fork();
+	if ((sample_pid < 0) || (sample_pid > 0)) {
+		if (fp != stdout)
+			(void)fclose(fp);
+		return;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		n += (size_t)ss->num_instances;
+	samples = calloc(n ? n : 1, sizeof(*samples));
+	if (!samples) {
+		pr_err("Cannot allocate bogo-ops sample buffer\n");
+		_exit(EXIT_FAILURE);
+	}
+
+	if (format == SAMPLE_FORMAT_YAML)
+		(void)fprintf(fp, "---\nsamples:\n");
+
+	t_start = stress_time_now();
+	t_next = t_start;
+	while (keep_stressing_flag()) {
+		stress_sample_t *prev = samples;
+		double delay;
+
+		/* Sample on a fixed period, however long the output took */
+		t_next += (double)sample_delay;
+		delay = t_next - stress_time_now();
+		if (delay > 0.0)
+			(void)shim_usleep((uint64_t)(delay * 1000000.0));
+
+		for (ss = stressors_list; ss; ss = ss->next) {
+			const char *name = stress_munge_underscore(ss->stressor->name);
+			int32_t j;
+
+			for (j = 0; j < ss->num_instances; j++, prev++)
+				stress_sample_instance(fp, format, t_start,
+					name, j, ss->stats[j], prev);
+		}
+		(void)fflush(fp);
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_sample_stop()
+ *	stop sampling the bogo-ops counters
+ */
+void stress_sample_stop(void)
+{
+	if (sample_pid > 0) {
+		int status;
+
+		(void)kill(sample_pid, SIGKILL);
+		(void)waitpid(sample_pid, &status, 0);
+	}
+}
@@ -0,0 +1,605 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#define SORT_BLOCK		(8)	/* elements sorted by the network */
+
+/* Per thread work for one step of a parallel sort */
+typedef struct {
+	void *src;		/* elements to read */
+	void *dst;		/* elements to write */
+	size_t lo;		/* start of chunk, or of merged output rank */
+	size_t hi;		/* end of chunk, or of merged output rank */
+	size_t a_lo, a_hi;	/* first run of a merge */
+	size_t b_lo, b_hi;	/* second run of a merge */
+	size_t elem_size;	/* 4 or 8 byte elements */
+	uint32_t shift;		/* radix digit shift */
+	int method;		/* STRESS_SORT_* */
+	size_t counts[256];	/* radix digit counts, then scatter offsets */
+} stress_sort_work_t;
+
+/*
+ *  Sorting primitives for 32 and 64 bit unsigned elements,
+ *  the 8 element network uses branch free compare and swaps
+ *  that compile to conditional moves or vector min/max
+ */
+#define STRESS_SORT_FUNCS(type, sfx)					\
+static inline void ALWAYS_INLINE stress_sort_cswap_ ## sfx(		\
+	type *x, const int i, const int j)				\
+{									\
+	const type a = x[i], b = x[j];					\
+									\
+	x[i] = (a < b) ? a : b;						\
+	x[j] = (a < b) ? b : a;						\
+}									\
+									\
+static void OPTIMIZE3 stress_sort_network_ ## sfx(type *x)		\
+{									\
+	stress_sort_cswap_ ## sfx(x, 0, 2);				\
+	stress_sort_cswap_ ## sfx(x, 1, 3);				\
+	stress_sort_cswap_ ## sfx(x, 4, 6);				\
+	stress_sort_cswap_ ## sfx(x, 5, 7);				\
+	stress_sort_cswap_ ## sfx(x, 0, 4);				\
+	stress_sort_cswap_ ## sfx(x, 1, 5);				\
+	stress_sort_cswap_ ## sfx(x, 2, 6);				\
+	stress_sort_cswap_ ## sfx(x, 3, 7);				\
+	stress_sort_cswap_ ## sfx(x, 0, 1);				\
+	stress_sort_cswap_ ## sfx(x, 2, 3);				\
+	stress_sort_cswap_ ## sfx(x, 4, 5);				\
+	stress_sort_cswap_ ## sfx(x, 6, 7);				\
+	stress_sort_cswap_ ## sfx(x, 2, 4);				\
+	stress_sort_cswap_ ## sfx(x, 3, 5);				\
+	stress_sort_cswap_ ## sfx(x, 1, 4);				\
+	stress_sort_cswap_ ## sfx(x, 3, 6);				\
+	stress_sort_cswap_ ## sfx(x, 1, 2);				\
+	stress_sort_cswap_ ## sfx(x, 3, 4);				\
+	stress_sort_cswap_ ## sfx(x, 5, 6);				\
+}									\
+									\
+static void OPTIMIZE3 stress_sort_merge_ ## sfx(			\
+	const type *a, const size_t na,					\
+	const type *b, const size_t nb,					\
+	type *out)							\
+{									\
+	const type *a_end = a + na, *b_end = b + nb;			\
+									\
+	while ((a < a_end) && (b < b_end))				\
+		*out++ = (*b < *a) ? *b++ : *a++;			\
+	while (a < a_end)						\
+		*out++ = *a++;						\
+	while (b < b_end)						\
+		*out++ = *b++;						\
+}									\
+									\
+static void OPTIMIZE3 stress_sort_block_ ## sfx(			\
+	type *data, type *tmp, const size_t n)				\
+{									\
+	type *src = data, *dst = tmp;					\
+	size_t i, width;						\
+									\
+	for (i = 0; i + SORT_BLOCK <= n; i += SORT_BLOCK)		\
+		stress_sort_network_ ## sfx(data + i);			\
+	for (; i < n; i++) {						\
+		const type v = data[i];					\
+		size_t j;						\
+									\
+		for (j = i; (j > (n & ~(size_t)(SORT_BLOCK - 1))) &&	\
+			    (data[j - 1] > v); j--)			\
+			data[j] = data[j - 1];				\
+		data[j] = v;						\
+	}								\
+	for (width = SORT_BLOCK; width < n; width *= 2) {		\
+		type *t;						\
+									\
+		for (i = 0; i < n; i += 2 * width) {			\
+			const size_t mid = STRESS_MINIMUM(i + width, n);	\
+			const size_t end = STRESS_MINIMUM(i + 2 * width, n);	\
+									\
+			stress_sort_merge_ ## sfx(src + i, mid - i,	\
+				src + mid, end - mid, dst + i);		\
+		}							\
+		t = src;						\
+		src = dst;						\
+		dst = t;						\
+	}								\
+	if (src != data)						\
+		(void)memcpy(data, src, n * sizeof(type));		\
+}									\
+									\
+static size_t stress_sort_corank_ ## sfx(				\
+	const size_t k,							\
+	const type *a, const size_t na,					\
+	const type *b, const size_t nb)					\
+{									\
+	size_t lo = (k > nb) ? k - nb : 0;				\
+	size_t hi = STRESS_MINIMUM(k, na);				\
+									\
+	while (lo < hi) {						\
+		const size_t i = lo + ((hi - lo) / 2);			\
+									\
+		if (a[i] <= b[k - i - 1])				\
+			lo = i + 1;					\
+		else							\
+			hi = i;						\
+	}								\
+	return lo;							\
+}									\
+									\
+static int stress_sort_cmp_ ## sfx(const void *p1, const void *p2)	\
+{									\
+	const type v1 = *(const type *)p1;				\
+	const type v2 = *(const type *)p2;				\
+									\
+	if (v1 == v2)							\
+		return 0;						\
+	return (v1 > v2) ? 1 : -1;					\
+}
+
+STRESS_SORT_FUNCS(uint32_t, 32)
+STRESS_SORT_FUNCS(uint64_t, 64)
+
+/*
+ *  stress_sort_chunk()
+ *	sort one chunk of the data, src is the data and dst
+ *	the scratch space
+ */
+static void *stress_sort_chunk(void *arg)
+{
+	static void *nowt = NULL;
+	stress_sort_work_t *w = (stress_sort_work_t *)arg;
+	const size_t n = w->hi - w->lo;
+
+	if (w->elem_size == sizeof(uint32_t)) {
+		uint32_t *data = (uint32_t *)w->src + w->lo;
+
+		if (w->method == STRESS_SORT_QSORT)
+			qsort(data, n, sizeof(*data), stress_sort_cmp_32);
+		else
+			stress_sort_block_32(data, (uint32_t *)w->dst + w->lo, n);
+	} else {
+		uint64_t *data = (uint64_t *)w->src + w->lo;
+
+		if (w->method == STRESS_SORT_QSORT)
+			qsort(data, n, sizeof(*data), stress_sort_cmp_64);
+		else
+			stress_sort_block_64(data, (uint64_t *)w->dst + w->lo, n);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sort_merge_part()
+ *	merge the output ranks lo..hi of two adjacent sorted runs,
+ *	the co-ranks split the runs so each thread merges an equal
+ *	share of the output without touching the other shares
+ */
+static void *stress_sort_merge_part(void *arg)
+{
+	static void *nowt = NULL;
+	const stress_sort_work_t *w = (stress_sort_work_t *)arg;
+	const size_t na = w->a_hi - w->a_lo, nb = w->b_hi - w->b_lo;
+
+	if (w->elem_size == sizeof(uint32_t)) {
+		const uint32_t *a = (const uint32_t *)w->src + w->a_lo;
+		const uint32_t *b = (const uint32_t *)w->src + w->b_lo;
+		const size_t i0 = stress_sort_corank_32(w->lo, a, na, b, nb);
+		const size_t i1 = stress_sort_corank_32(w->hi, a, na, b, nb);
+
+		stress_sort_merge_32(a + i0, i1 - i0, b + (w->lo - i0),
+			(w->hi - i1) - (w->lo - i0), (uint32_t *)w->dst + w->a_lo + w->lo);
+	} else {
+		const uint64_t *a = (const uint64_t *)w->src + w->a_lo;
+		const uint64_t *b = (const uint64_t *)w->src + w->b_lo;
+		const size_t i0 = stress_sort_corank_64(w->lo, a, na, b, nb);
+		const size_t i1 = stress_sort_corank_64(w->hi, a, na, b, nb);
+
+		stress_sort_merge_64(a + i0, i1 - i0, b + (w->lo - i0),
+			(w->hi - i1) - (w->lo - i0), (uint64_t *)w->dst + w->a_lo + w->lo);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sort_radix_count()
+ *	count the radix digits of one chunk
+ */
+static void *stress_sort_radix_count(void *arg)
+{
+	static void *nowt = NULL;
+	stress_sort_work_t *w = (stress_sort_work_t *)arg;
+	size_t i;
+
+	(void)memset(w->counts, 0, sizeof(w->counts));
+	if (w->elem_size == sizeof(uint32_t)) {
+		const uint32_t *src = (const uint32_t *)w->src;
+
+		for (i = w->lo; i < w->hi; i++)
+			w->counts[(src[i] >> w->shift) & 0xff]++;
+	} else {
+		const uint64_t *src = (const uint64_t *)w->src;
+
+		for (i = w->lo; i < w->hi; i++)
+			w->counts[(src[i] >> w->shift) & 0xff]++;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sort_radix_scatter()
+ *	scatter one chunk to the offsets of its radix digits
+ */
+static void *stress_sort_radix_scatter(void *arg)
+{
+	static void *nowt = NULL;
+	stress_sort_work_t *w = (stress_sort_work_t *)arg;
+	size_t i;
+
+	if (w->elem_size == sizeof(uint32_t)) {
+		const uint32_t *src = (const uint32_t *)w->src;
+		uint32_t *dst = (uint32_t *)w->dst;
+
+		for (i = w->lo; i < w->hi; i++)
+			dst[w->counts[(src[i] >> w->shift) & 0xff]++] = src[i];
+	} else {
+		const uint64_t *src = (const uint64_t *)w->src;
+		uint64_t *dst = (uint64_t *)w->dst;
+
+		for (i = w->lo; i < w->hi; i++)
+			dst[w->counts[(src[i] >> w->shift) & 0xff]++] = src[i];
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_sort_spawn()
+ *	run func on each of the count work items, one per
+ *	thread, with the first run by the calling thread; work
+ *	is run inline if a thread cannot be created
+ */
+static void stress_sort_spawn(
+	void *(*func)(void *),
+	stress_sort_work_t *work,
+	const uint32_t count)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthreads[STRESS_SORT_MAX_THREADS];
+	bool created[STRESS_SORT_MAX_THREADS];
+	uint32_t i;
+
+	for (i = 1; i < count; i++) {
+		created[i] = (pthread_create(&pthreads[i], NULL, func, &work[i]) == 0);
+		if (!created[i])
+			(void)func(&work[i]);
+	}
+	(void)func(&work[0]);
+	for (i = 1; i < count; i++) {
+		if (created[i])
+			(void)pthread_join(pthreads[i], NULL);
+	}
+#else
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		(void)func(&work[i]);
+#endif
+}
+
+/*
+ *  stress_sort_parallel_merge()
+ *	sort chunks in parallel then merge pairs of runs until
+ *	there is one run, every merge round keeps all the threads
+ *	busy by splitting each merge over several threads
+ */
+static void stress_sort_parallel_merge(
+	stress_sort_work_t *work,
+	void *data,
+	void *tmp,
+	const size_t n,
+	const size_t elem_size,
+	uint32_t threads,
+	const int method)
+{
+	size_t bounds[STRESS_SORT_MAX_THREADS + 1];
+	uint32_t i, runs;
+	void *src = data, *dst = tmp;
+
+	if (threads > n / SORT_BLOCK)
+		threads = (n / SORT_BLOCK) ? (uint32_t)(n / SORT_BLOCK) : 1;
+	for (i = 0; i <= threads; i++)
+		bounds[i] = (n * i) / threads;
+
+	for (i = 0; i < threads; i++) {
+		work[i].src = data;
+		work[i].dst = tmp;
+		work[i].lo = bounds[i];
+		work[i].hi = bounds[i + 1];
+		work[i].elem_size = elem_size;
+		work[i].method = method;
+	}
+	stress_sort_spawn(stress_sort_chunk, work, threads);
+
+	for (runs = threads; runs > 1; runs = (runs + 1) / 2) {
+		const uint32_t groups = (runs + 1) / 2;
+		const uint32_t per_group = (threads / groups) ? threads / groups : 1;
+		uint32_t g, count = 0;
+		void *t;
+
+		for (g = 0; g < groups; g++) {
+			const size_t a_lo = bounds[2 * g];
+			const size_t a_hi = bounds[2 * g + 1];
+			const size_t b_hi = (2 * g + 2 <= runs) ? bounds[2 * g + 2] : a_hi;
+			const size_t total = b_hi - a_lo;
+			uint32_t p;
+
+			for (p = 0; p < per_group; p++, count++) {
+				work[count].src = src;
+				work[count].dst = dst;
+				work[count].a_lo = a_lo;
+				work[count].a_hi = a_hi;
+				work[count].b_lo = a_hi;
+				work[count].b_hi = b_hi;
+				work[count].lo = (total * p) / per_group;
+				work[count].hi = (total * (p + 1)) / per_group;
+				work[count].elem_size = elem_size;
+			}
+		}
+		stress_sort_spawn(stress_sort_merge_part, work, count);
+
+		for (g = 0; g < groups; g++)
+			bounds[g] = bounds[2 * g];
+		bounds[groups] = n;
+		t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != data)
+		(void)memcpy(data, src, n * elem_size);
+}
+
+/*
+ *  stress_sort_parallel_radix()
+ *	least significant digit first radix sort on 8 bit digits,
+ *	each pass counts digits per chunk in parallel, turns the
+ *	counts into per chunk offsets and scatters in parallel,
+ *	passes where every element has the same digit are skipped
+ */
+static void stress_sort_parallel_radix(
+	stress_sort_work_t *work,
+	void *data,
+	void *tmp,
+	const size_t n,
+	const size_t elem_size,
+	uint32_t threads)
+{
+	uint32_t shift, i;
+	void *src = data, *dst = tmp;
+
+	if (threads > n)
+		threads = (uint32_t)n;
+
+	for (shift = 0; shift < elem_size * 8; shift += 8) {
+		size_t d, offset = 0;
+		bool skip = false;
+		void *t;
+
+		for (i = 0; i < threads; i++) {
+			work[i].src = src;
+			work[i].dst = dst;
+			work[i].lo = (n * i) / threads;
+			work[i].hi = (n * (i + 1)) / threads;
+			work[i].elem_size = elem_size;
+			work[i].shift = shift;
+		}
+		stress_sort_spawn(stress_sort_radix_count, work, threads);
+
+		for (d = 0; d < 256; d++) {
+			size_t total = 0;
+
+			for (i = 0; i < threads; i++) {
+				const size_t c = work[i].counts[d];
+
+				work[i].counts[d] = offset;
+				offset += c;
+				total += c;
+			}
+			if (total == n)
+				skip = true;
+		}
+		if (skip)
+			continue;
+
+		stress_sort_spawn(stress_sort_radix_scatter, work, threads);
+		t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != data)
+		(void)memcpy(data, src, n * elem_size);
+}
+
+/*
+ *  stress_sort_parallel()
+ *	sort n unsigned 4 or 8 byte elements into ascending order
+ *	with up to threads threads, tmp must be as large as data
+ */
+void stress_sort_parallel(
+	void *data,
+	void *tmp,
+	const size_t n,
+	const size_t elem_size,
+	uint32_t threads,
+	const int method)
+{
+	static stress_sort_work_t work[STRESS_SORT_MAX_THREADS];
+
+	if (n < 2)
+		return;
+	if (threads < 1)
+		threads = 1;
+	if (threads > STRESS_SORT_MAX_THREADS)
+		threads = STRESS_SORT_MAX_THREADS;
+
+	if (method == STRESS_SORT_RADIX)
+		stress_sort_parallel_radix(work, data, tmp, n, elem_size, threads);
+	else
+		stress_sort_parallel_merge(work, data, tmp, n, elem_size, threads, method);
+}
+
+/*
+ *  stress_sort_check()
+ *	check the elements are in ascending order
+ */
+static bool stress_sort_check(const void *data, const size_t n, const size_t elem_size)
+{
+	size_t i;
+
+	if (elem_size == sizeof(uint32_t)) {
+		const uint32_t *d = (const uint32_t *)data;
+
+		for (i = 1; i < n; i++)
+			if (d[i - 1] > d[i])
+				return false;
+	} else {
+		const uint64_t *d = (const uint64_t *)data;
+
+		for (i = 1; i < n; i++)
+			if (d[i - 1] > d[i])
+				return false;
+	}
+	return true;
+}
+
+/*
+ *  stress_sort_threads()
+ *	the parallel mode shared by the sort stressors, sort
+ *	n random elements with threads threads per bogo op and
+ *	report the elements sorted per second
+ */
+int stress_sort_threads(
+	const stress_args_t *args,
+	const size_t n,
+	const size_t elem_size,
+	const uint32_t threads,
+	const int method)
+{
+	uint8_t *data, *tmp;
+	double duration = 0.0, rate;
+	uint64_t sorted = 0;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	data = calloc(n, elem_size);
+	tmp = calloc(n, elem_size);
+	if (!data || !tmp) {
+		pr_inf_skip("%s: cannot allocate %zu byte sort buffers, "
+			"skipping stressor\n", args->name, 2 * n * elem_size);
+		free(tmp);
+		free(data);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < n * elem_size; i += sizeof(uint32_t)) {
+		const uint32_t v = stress_mwc32();
+
+		(void)memcpy(data + i, &v, sizeof(v));
+	}
+
+	if (args->instance == 0)
+		pr_dbg("%s: sorting %zu %zu byte elements with %" PRIu32
+			" threads\n", args->name, n, elem_size, threads);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		const uint64_t rnd = stress_mwc64();
+		double t;
+
+		/* Remix the sorted data cheaply for the next round */
+		if (elem_size == sizeof(uint32_t)) {
+			uint32_t *d = (uint32_t *)data;
+
+			for (i = 0; i < n; i++) {
+				const uint32_t v = d[i] ^ (uint32_t)rnd;
+
+				d[i] = ((v >> 7) | (v << 25)) * 0x9e3779b1;
+			}
+		} else {
+			uint64_t *d = (uint64_t *)data;
+
+			for (i = 0; i < n; i++) {
+				const uint64_t v = d[i] ^ rnd;
+
+				d[i] = ((v >> 7) | (v << 57)) * 0x9e3779b97f4a7c15ULL;
+			}
+		}
+
+		t = stress_time_now();
+		stress_sort_parallel(data, tmp, n, elem_size, threads, method);
+		duration += stress_time_now() - t;
+		sorted += n;
+
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+		    !stress_sort_check(data, n, elem_size)) {
+			pr_fail("%s: sort error detected, incorrect ordering found\n",
+				args->name);
+			rc = EXIT_FAILURE;
+			break;
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	rate = (duration > 0.0) ? (double)sorted / duration : 0.0;
+	stress_misc_stats_set(args->misc_stats, 0, "M elements sorted/sec", rate / 1000000.0);
+	stress_misc_stats_set(args->misc_stats, 1, "MB sorted/sec", (rate * (double)elem_size) / (double)MB);
+
+	free(tmp);
+	free(data);
+
+	return rc;
+}
+
+/*
+ *  stress_set_sort_threads()
+ *	set the number of parallel sort threads of a sort stressor
+ */
+int stress_set_sort_threads(const char *setting, const char *opt)
+{
+	uint32_t threads;
+
+	threads = stress_get_uint32(opt);
+	stress_check_range(setting, (uint64_t)threads, 1, STRESS_SORT_MAX_THREADS);
+	return stress_set_setting(setting, TYPE_ID_UINT32, &threads);
+}
+
+/*
+ *  stress_set_sort_elem_size()
+ *	set the parallel sort element size of a sort stressor
+ */
+int stress_set_sort_elem_size(const char *setting, const char *opt)
+{
+	size_t elem_size;
+
+	elem_size = (size_t)stress_get_uint32(opt);
+	if ((elem_size != sizeof(uint32_t)) && (elem_size != sizeof(uint64_t))) {
+		(void)fprintf(stderr, "%s must be 4 or 8\n", setting);
+		return -1;
+	}
+	return stress_set_setting(setting, TYPE_ID_SIZE_T, &elem_size);
+}
@@ -24,6 +24,58 @@
  */
 #include "stress-ng.h"
 
+#define TZ_CONTROL_WINDOW	(0.1)	/* seconds per duty cycle window */
+#define TZ_CONTROL_PERIOD	(10)	/* windows between control steps */
+#define TZ_CONTROL_DUTY_MIN	(0.05)
+#define TZ_CONTROL_TEMP_HOLD	(2.0)	/* degrees C either side of target */
+#define TZ_CONTROL_POWER_HOLD	(0.1)	/* fraction either side of target */
+#define TZ_CONTROL_RAPL_MAX	(16)
+
+static pid_t tz_control_pid;
+static double tz_target = 0.0;
+static double tz_power = 0.0;
+static const char *tz_zone = NULL;
+
+/*
+ *  stress_set_tz_target()
+ *	set the temperature in degrees C to hold by duty cycling the stressors
+ */
+int stress_set_tz_target(const char *const opt)
+{
+	tz_target = atof(opt);
+	if ((tz_target <= 0.0) || (tz_target > 150.0)) {
+		(void)fprintf(stderr, "tz-target must be greater than 0 and "
+			"no more than 150 degrees C\n");
+		_exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_tz_power()
+ *	set the package power in Watts to hold by duty cycling the stressors
+ */
+int stress_set_tz_power(const char *const opt)
+{
+	tz_power = atof(opt);
+	if ((tz_power <= 0.0) || (tz_power > 10000.0)) {
+		(void)fprintf(stderr, "tz-power must be greater than 0 and "
+			"no more than 10000 Watts\n");
+		_exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_tz_zone()
+ *	control on the named thermal zone type rather than the hottest zone
+ */
+int stress_set_tz_zone(const char *const opt)
+{
+	tz_zone = opt;
+	return 0;
+}
+
 #if defined(STRESS_THERMAL_ZONES)
 
 /*
@@ -287,3 +339,372 @@ void stress_tz_dump(FILE *yaml, stress_stressor_t *stressors_list)
 		pr_inf("thermal zone temperatures not available\n");
 }
 #endif
+
+#if defined(STRESS_THERMAL_ZONES) &&	\
+    defined(__linux__)
+
+typedef struct {
+	char path[PATH_MAX];		/* energy_uj of a top level powercap zone */
+	uint64_t max;			/* max_energy_range_uj, for wrap around */
+	uint64_t energy;		/* last energy read in uJ */
+} stress_tz_rapl_t;
+
+static volatile bool tz_control_run;
+
+static void MLOCKED_TEXT stress_tz_control_handler(int signum)
+{
+	(void)signum;
+
+	tz_control_run = false;
+}
+
+/*
+ *  stress_tz_control_temp()
+ *	temperature in degrees C of the named zone type, or of the
+ *	hottest zone if no type is given, -1.0 if none is readable
+ */
+static double stress_tz_control_temp(stress_tz_info_t *tz_info_list, const char *zone)
+{
+	stress_tz_info_t *tz_info;
+	double max = -1.0;
+
+	for (tz_info = tz_info_list; tz_info; tz_info = tz_info->next) {
+		char path[PATH_MAX], buf[32], name[160];
+		uint64_t temp;
+
+		(void)snprintf(name, sizeof(name), "%s%" PRIu32, tz_info->type, tz_info->type_instance);
+		if (zone && strcmp(zone, tz_info->type) && strcmp(zone, name))
+			continue;
+		(void)snprintf(path, sizeof(path), "/sys/class/thermal/%s/temp", tz_info->path);
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			continue;
+		temp = (uint64_t)strtoull(buf, NULL, 10);
+		/* Avoid crazy temperatures. e.g. > 250 C */
+		if ((temp > 250000) || (temp == 0))
+			continue;
+		if ((double)temp / 1000.0 > max)
+			max = (double)temp / 1000.0;
+	}
+	return max;
+}
+
+/*
+ *  stress_tz_control_rapl_init()
+ *	find the top level powercap zones, e.g. intel-rapl:0, the
+ *	sub-zones are already counted in their package zone
+ */
+static size_t stress_tz_control_rapl_init(stress_tz_rapl_t *rapl, const size_t max)
+{
+	DIR *dir;
+	struct dirent *entry;
+	size_t n = 0;
+
+	dir = opendir("/sys/class/powercap");
+	if (!dir)
+		return 0;
+	while ((n < max) && ((entry = readdir(dir)) != NULL)) {
+		const char *colon = strchr(entry->d_name, ':');
+		char path[PATH_MAX], buf[32];
+
+		if (!colon || strchr(colon + 1, ':'))
+			continue;
+		(void)snprintf(path, sizeof(path), "/sys/class/powercap/%s/max_energy_range_uj",
+			entry->d_name);
+		if (system_read(path, buf, sizeof(buf)) <= 0)
+			continue;
+		rapl[n].max = (uint64_t)strtoull(buf, NULL, 10);
+		(void)snprintf(rapl[n].path, sizeof(rapl[n].path), "/sys/class/powercap/%s/energy_uj",
+			entry->d_name);
+		if (system_read(rapl[n].path, buf, sizeof(buf)) <= 0)
+			continue;
+		rapl[n].energy = (uint64_t)strtoull(buf, NULL, 10);
+		n++;
+	}
+	(void)closedir(dir);
+	return n;
+}
+
+/*
+ *  stress_tz_control_energy()
+ *	Joules used by all the powercap zones since the last call
+ */
+static double stress_tz_control_energy(stress_tz_rapl_t *rapl, const size_t n)
+{
+	size_t i;
+	uint64_t total = 0;
+
+	for (i = 0; i < n; i++) {
+		char buf[32];
+		uint64_t energy;
+
+		if (system_read(rapl[i].path, buf, sizeof(buf)) <= 0)
+			continue;
+		energy = (uint64_t)strtoull(buf, NULL, 10);
+		if (energy >= rapl[i].energy)
+			total += energy - rapl[i].energy;
+		else
+			total += (rapl[i].max - rapl[i].energy) + energy;
+		rapl[i].energy = energy;
+	}
+	return (double)total / 1000000.0;
+}
+
+/*
+ *  stress_tz_control_signal()
+ *	stop or continue all the running stressor instances, an
+ *	instance runs while its finish time is still its start time
+ */
+static void stress_tz_control_signal(stress_stressor_t *stressors_list, const int sig)
+{
+	stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		for (j = 0; j < ss->num_instances; j++) {
+			const stress_stats_t *stats = ss->stats[j];
+
+			if (stats && (stats->pid > 0) && (stats->start == stats->finish))
+				(void)kill(stats->pid, sig);
+		}
+	}
+}
+
+/*
+ *  stress_tz_control_counters()
+ *	bogo-ops of each stressor, all instances summed
+ */
+static void stress_tz_control_counters(stress_stressor_t *stressors_list, uint64_t *counters)
+{
+	stress_stressor_t *ss;
+	size_t i;
+
+	for (i = 0, ss = stressors_list; ss; ss = ss->next, i++) {
+		int32_t j;
+
+		counters[i] = 0;
+		for (j = 0; j < ss->num_instances; j++) {
+			if (ss->stats[j])
+				counters[i] += stress_stats_counter(ss->stats[j]);
+		}
+	}
+}
+
+/*
+ *  stress_tz_control_sleep()
+ *	sleep for a while unless told to stop
+ */
+static void stress_tz_control_sleep(const double secs)
+{
+	if (tz_control_run && (secs > 0.0))
+		(void)shim_usleep((uint64_t)(secs * 1000000.0));
+}
+
+/*
+ *  stress_tz_control()
+ *	run the stressors for a duty share of each window and stop
+ *	them for the rest, adjusting the duty every period so that
+ *	the temperature or package power converges on the target
+ */
+static void stress_tz_control(
+	stress_stressor_t *stressors_list,
+	stress_tz_info_t *tz_info_list,
+	stress_tz_rapl_t *rapl,
+	const size_t rapl_n)
+{
+	const bool power = (tz_power > 0.0);
+	const double target = power ? tz_power : tz_target;
+	const char *unit = power ? "W" : "C";
+	stress_stressor_t *ss;
+	size_t i, n = 0;
+	uint64_t *prev, *now, *held, hold_periods = 0, periods = 0;
+	double duty = 1.0, value = 0.0, hold_sum = 0.0, hold_duty = 0.0, hold_time = 0.0;
+	double t_prev;
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		n++;
+	prev = calloc(n ? n : 1, sizeof(*prev));
+	now = calloc(n ? n : 1, sizeof(*now));
+	held = calloc(n ? n : 1, sizeof(*held));
+	if (!prev || !now || !held) {
+		pr_err("tz-control: cannot allocate bogo-ops counters\n");
+		goto free_counters;
+	}
+
+	stress_tz_control_counters(stressors_list, prev);
+	if (power)
+		(void)stress_tz_control_energy(rapl, rapl_n);
+	t_prev = stress_time_now();
+
+	while (tz_control_run) {
+		double t_now, delta, error;
+		bool holding;
+		int w;
+
+		for (w = 0; tz_control_run && (w < TZ_CONTROL_PERIOD); w++) {
+			stress_tz_control_sleep(duty * TZ_CONTROL_WINDOW);
+			if (duty < 1.0) {
+				stress_tz_control_signal(stressors_list, SIGSTOP);
+				stress_tz_control_sleep((1.0 - duty) * TZ_CONTROL_WINDOW);
+				stress_tz_control_signal(stressors_list, SIGCONT);
+			}
+		}
+		if (!tz_control_run)
+			break;
+
+		t_now = stress_time_now();
+		delta = t_now - t_prev;
+		if (delta <= 0.0)
+			continue;
+		if (power) {
+			value = stress_tz_control_energy(rapl, rapl_n) / delta;
+		} else {
+			value = stress_tz_control_temp(tz_info_list, tz_zone);
+			if (value < 0.0)
+				break;
+		}
+		periods++;
+
+		/*
+		 *  Holding is being near the target or flat out and still
+		 *  below it, the latter means the envelope is not binding
+		 */
+		if (power)
+			holding = (fabs(value - target) <= target * TZ_CONTROL_POWER_HOLD);
+		else
+			holding = (fabs(value - target) <= TZ_CONTROL_TEMP_HOLD);
+		if ((duty >= 1.0) && (value < target))
+			holding = true;
+
+		stress_tz_control_counters(stressors_list, now);
+		if (holding) {
+			for (i = 0; i < n; i++)
+				held[i] += now[i] - prev[i];
+			hold_sum += value;
+			hold_duty += duty;
+			hold_time += delta;
+			hold_periods++;
+		}
+		(void)memcpy(prev, now, n * sizeof(*prev));
+		t_prev = t_now;
+
+		/*
+		 *  Temperature lags the load, so take small proportional
+		 *  steps; power follows the duty closely so scale by it
+		 */
+		if (power) {
+			error = (target - value) / target;
+			duty *= 1.0 + (0.5 * error);
+		} else {
+			error = target - value;
+			duty += 0.02 * error;
+		}
+		if (duty > 1.0)
+			duty = 1.0;
+		else if (duty < TZ_CONTROL_DUTY_MIN)
+			duty = TZ_CONTROL_DUTY_MIN;
+
+		pr_dbg("tz-control: %.2f %s (target %.2f %s), duty %.1f%%\n",
+			value, unit, target, unit, duty * 100.0);
+	}
+	stress_tz_control_signal(stressors_list, SIGCONT);
+
+	if (hold_periods && (hold_time > 0.0)) {
+		pr_inf("tz-control: held %.2f %s (target %.2f %s) for %.0f seconds "
+			"at %.1f%% duty\n", hold_sum / (double)hold_periods, unit,
+			target, unit, hold_time, 100.0 * hold_duty / (double)hold_periods);
+		for (i = 0, ss = stressors_list; ss; ss = ss->next, i++) {
+			pr_inf("tz-control: %s sustained %.2f bogo-ops/s at the %s envelope\n",
+				stress_munge_underscore(ss->stressor->name),
+				(double)held[i] / hold_time, power ? "power" : "thermal");
+		}
+	} else if (periods) {
+		pr_inf("tz-control: did not hold %.2f %s, last at %.2f %s "
+			"with %.1f%% duty\n", target, unit, value, unit, duty * 100.0);
+	}
+
+free_counters:
+	free(held);
+	free(now);
+	free(prev);
+}
+
+/*
+ *  stress_tz_control_start()
+ *	start the thermal or power envelope controller process
+ */
+void stress_tz_control_start(stress_stressor_t *stressors_list)
+{
+	static stress_tz_rapl_t rapl[TZ_CONTROL_RAPL_MAX];
+	stress_tz_info_t *tz_info_list = NULL;
+	size_t rapl_n = 0;
+
+	if ((tz_target <= 0.0) && (tz_power <= 0.0))
+		return;
+	if ((tz_target > 0.0) && (tz_power > 0.0)) {
+		pr_inf("tz-control: both --tz-target and --tz-power given, "
+			"controlling on --tz-power\n");
+	}
+	if (tz_power > 0.0) {
+		rapl_n = stress_tz_control_rapl_init(rapl, SIZEOF_ARRAY(rapl));
+		if (!rapl_n) {
+			pr_inf("tz-control: no readable powercap energy counters, "
+				"ignoring --tz-power option\n");
+			return;
+		}
+	} else {
+		if ((stress_tz_init(&tz_info_list) < 0) ||
+		    (stress_tz_control_temp(tz_info_list, tz_zone) < 0.0)) {
+			pr_inf("tz-control: no readable thermal zone%s%s, "
+				"ignoring --tz-target option\n",
+				tz_zone ? " of type " : "", tz_zone ? tz_zone : "");
+			stress_tz_free(&tz_info_list);
+			return;
+		}
+	}
+
+	tz_control_run = true;
+	tz_control_pid = fork();
+	if (tz_control_pid < 0) {
+		tz_control_run = false;
+		pr_err("tz-control background process failed to fork: %d (%s)\n",
+			errno, strerror(errno));
+	} else if (tz_control_pid == 0) {
+		stress_set_proc_name("stress-ng-tz-control");
+		if (stress_sighandler("tz-control", SIGALRM, stress_tz_control_handler, NULL) < 0)
+			_exit(0);
+		stress_tz_control(stressors_list, tz_info_list, rapl, rapl_n);
+		stress_tz_free(&tz_info_list);
+		_exit(0);
+	}
+	stress_tz_free(&tz_info_list);
+}
+
+/*
+ *  stress_tz_control_stop()
+ *	stop the thermal or power envelope controller process
+ */
+void stress_tz_control_stop(void)
+{
+	int status;
+
+	if (tz_control_pid <= 0)
+		return;
+
+	(void)kill(tz_control_pid, SIGALRM);
+	(void)shim_waitpid(tz_control_pid, &status, 0);
+	tz_control_pid = 0;
+}
+#else
+void stress_tz_control_start(stress_stressor_t *stressors_list)
+{
+	(void)stressors_list;
+
+	if ((tz_target > 0.0) || (tz_power > 0.0))
+		pr_inf("thermal zones not supported, ignoring --tz-target and --tz-power options\n");
+}
+
+void stress_tz_control_stop(void)
+{
+}
+#endif
@@ -24,6 +24,21 @@
  */
 #include "stress-ng.h"
 
+/*
+ *  stress_compact_memory()
+ *	trigger memory compaction, Linux only, the write
+ *	returns once compaction of all zones has completed,
+ *	returns < 0 if compaction could not be triggered
+ */
+ssize_t stress_compact_memory(void)
+{
+#if defined(__linux__)
+	return system_write("/proc/sys/vm/compact_memory", "1", 1);
+#else
+	return -ENOSYS;
+#endif
+}
+
 #if defined(__linux__) &&	\
     defined(HAVE_PTRACE)
 
@@ -112,23 +127,6 @@ exit_fdmem:
 	return rc;
 }
 
-/*
- *  stress_compact_memory()
- *	trigger memory compaction, Linux only
- */
-static inline void stress_compact_memory(void)
-{
-#if defined(__linux__)
-	ssize_t ret;
-
-	if (!thrash_run)
-		return;
-
-	ret = system_write("/proc/sys/vm/compact_memory", "1", 1);
-	(void)ret;
-#endif
-}
-
 /*
  *  stress_zone_reclaim()
  *	trigger reclaim when zones run out of memory
@@ -301,7 +299,8 @@ int stress_thrash_start(void)
 			}
 			if ((stress_mwc8() & 0x7) == 0)
 				stress_drop_caches();
-			stress_compact_memory();
+			if (thrash_run)
+				(void)stress_compact_memory();
 			stress_merge_memory();
 			stress_zone_reclaim();
 			(void)sleep(1);
@@ -53,6 +53,23 @@ double stress_time_now(void)
 	return stress_timeval_to_double(&now);
 }
 
+/*
+ *  stress_time_now_ns()
+ *	monotonic time in nanoseconds as a double, for timing
+ *	operations too quick for stress_time_now
+ */
+double stress_time_now_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ((double)ts.tv_sec * 1000000000.0) + (double)ts.tv_nsec;
+#endif
+	return stress_time_now() * 1000000000.0;
+}
+
 /*
  *  stress_format_time()
  *	format a unit of time into human readable format
@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_IMMINTRIN_H) &&	\
+    defined(STRESS_ARCH_X86) &&		\
+    (defined(__x86_64__) || defined(__x86_64)) && \
+    defined(__GNUC__) &&		\
+    !defined(__INTEL_COMPILER)
+#include <immintrin.h>
+#define STRESS_VECFREQ_X86
+#endif
+
+#if defined(HAVE_ARM_NEON_H) &&		\
+    defined(STRESS_ARCH_ARM) &&		\
+    defined(__aarch64__) &&		\
+    defined(__GNUC__)
+#include <arm_neon.h>
+#define STRESS_VECFREQ_ARM
+#endif
+
+#if defined(STRESS_VECFREQ_ARM) &&	\
+    defined(HAVE_ARM_SVE_H) &&		\
+    defined(__ARM_FEATURE_SVE) &&	\
+    defined(HAVE_SYS_AUXV_H) &&		\
+    defined(HWCAP_SVE)
+#include <arm_sve.h>
+#define STRESS_VECFREQ_SVE
+#endif
+
+/*
+ *  AMX needs gcc 11 or clang 12 for the tile intrinsics and
+ *  the kernel has to grant the task the tile data state
+ */
+#if defined(STRESS_VECFREQ_X86) &&	\
+    defined(__linux__) &&		\
+    defined(__NR_arch_prctl) &&		\
+    ((defined(__clang__) && (__clang_major__ >= 12)) ||	\
+     (!defined(__clang__) && (__GNUC__ >= 11)))
+#define STRESS_VECFREQ_AMX
+#endif
+
+#if defined(STRESS_VECFREQ_X86) ||	\
+    defined(STRESS_VECFREQ_ARM)
+
+#define VECFREQ_SLICE		(0.5)		/* seconds per kernel per round */
+#define VECFREQ_CHUNK		(0.002)		/* seconds between frequency probes */
+#define VECFREQ_SYSFS_CHUNKS	(25)		/* chunks between sysfs samples */
+#define VECFREQ_PROBE_LOOPS	(4000)
+#define VECFREQ_PROBE_ADDS	(100)		/* dependent adds per probe loop */
+#define VECFREQ_MIN_LOOPS	(64)
+#define VECFREQ_MAX_LOOPS	(1U << 24)
+
+/*
+ *  a kernel runs loops iterations and returns the operations
+ *  done, a multiply-add counts as two operations
+ */
+typedef uint64_t (*stress_vecfreq_func_t)(const uint32_t loops);
+
+typedef struct {
+	const char *name;		/* kernel name */
+	uint32_t (*width)(const bool fp);	/* width in bits, 0 if unsupported */
+	stress_vecfreq_func_t int_func;	/* light integer adds */
+	stress_vecfreq_func_t fp_func;	/* heavy floating point multiply-adds */
+} stress_vecfreq_kernel_t;
+
+typedef struct {
+	uint64_t ops;			/* operations done */
+	double duration;		/* seconds in the kernel */
+	double probe_cycles;		/* cycles of the frequency probes */
+	double probe_duration;		/* seconds in the frequency probes */
+	double sysfs_ghz;		/* sum of scaling_cur_freq samples */
+	uint32_t sysfs_samples;
+	uint32_t width;			/* width in bits */
+} stress_vecfreq_stats_t;
+
+/*
+ *  keep eight independent accumulators in registers so each kernel
+ *  is throughput bound and the compiler cannot fold the loop away
+ */
+#define VECFREQ_BARRIER(c)						\
+	__asm__ __volatile__("" : "+" c (a0), "+" c (a1), "+" c (a2),	\
+		"+" c (a3), "+" c (a4), "+" c (a5), "+" c (a6), "+" c (a7))
+
+#define STRESS_VECFREQ_KERNEL(name, attr, type, k1_init, k2_init, op, c, ops_per_lane) \
+static uint64_t attr name(const uint32_t loops)				\
+{									\
+	const type k1 = k1_init;					\
+	const type k2 = k2_init;					\
+	type a0 = k1, a1 = k1, a2 = k1, a3 = k1;			\
+	type a4 = k1, a5 = k1, a6 = k1, a7 = k1;			\
+	uint32_t i;							\
+									\
+	for (i = 0; i < loops; i++) {					\
+		a0 = op(a0); a1 = op(a1); a2 = op(a2); a3 = op(a3);	\
+		a4 = op(a4); a5 = op(a5); a6 = op(a6); a7 = op(a7);	\
+		VECFREQ_BARRIER(c);					\
+	}								\
+	return (uint64_t)loops * 8 * (sizeof(type) / 4) * ops_per_lane;	\
+}
+
+#define VECFREQ_SCALAR_ADD(x)	((x) + k2)
+#define VECFREQ_SCALAR_MLA(x)	((x) * k1 + k2)
+
+#if defined(STRESS_VECFREQ_X86)
+#define VECFREQ_FREG		"x"
+#else
+#define VECFREQ_FREG		"w"
+#endif
+
+STRESS_VECFREQ_KERNEL(stress_vecfreq_scalar_int, OPTIMIZE3, uint32_t,
+	1, 3, VECFREQ_SCALAR_ADD, "r", 1)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_scalar_fp, OPTIMIZE3, float,
+	0.999999f, 0.000001f, VECFREQ_SCALAR_MLA, VECFREQ_FREG, 2)
+
+static uint32_t stress_vecfreq_scalar_width(const bool fp)
+{
+	(void)fp;
+
+	return 32;
+}
+
+#if defined(STRESS_VECFREQ_X86)
+#define VECFREQ_SSE_ADD(x)	_mm_add_epi32(x, k2)
+#define VECFREQ_SSE_MLA(x)	_mm_add_ps(_mm_mul_ps(x, k1), k2)
+#define VECFREQ_AVX2_ADD(x)	_mm256_add_epi32(x, k2)
+#define VECFREQ_AVX2_MLA(x)	_mm256_fmadd_ps(x, k1, k2)
+#define VECFREQ_AVX512_ADD(x)	_mm512_add_epi32(x, k2)
+#define VECFREQ_AVX512_MLA(x)	_mm512_fmadd_ps(x, k1, k2)
+
+STRESS_VECFREQ_KERNEL(stress_vecfreq_sse_int, __attribute__((target("sse2"))),
+	__m128i, _mm_set1_epi32(1), _mm_set1_epi32(3), VECFREQ_SSE_ADD, "x", 1)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_sse_fp, __attribute__((target("sse2"))),
+	__m128, _mm_set1_ps(0.999999f), _mm_set1_ps(0.000001f), VECFREQ_SSE_MLA, "x", 2)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_avx2_int, __attribute__((target("avx2"))),
+	__m256i, _mm256_set1_epi32(1), _mm256_set1_epi32(3), VECFREQ_AVX2_ADD, "x", 1)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_avx2_fp, __attribute__((target("avx2,fma"))),
+	__m256, _mm256_set1_ps(0.999999f), _mm256_set1_ps(0.000001f), VECFREQ_AVX2_MLA, "x", 2)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_avx512_int, __attribute__((target("avx512f"))),
+	__m512i, _mm512_set1_epi32(1), _mm512_set1_epi32(3), VECFREQ_AVX512_ADD, "v", 1)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_avx512_fp, __attribute__((target("avx512f"))),
+	__m512, _mm512_set1_ps(0.999999f), _mm512_set1_ps(0.000001f), VECFREQ_AVX512_MLA, "v", 2)
+
+static uint32_t stress_vecfreq_sse_width(const bool fp)
+{
+	(void)fp;
+
+	return __builtin_cpu_supports("sse2") ? 128 : 0;
+}
+
+static uint32_t stress_vecfreq_avx2_width(const bool fp)
+{
+	if (!__builtin_cpu_supports("avx2"))
+		return 0;
+	if (fp && !__builtin_cpu_supports("fma"))
+		return 0;
+	return 256;
+}
+
+static uint32_t stress_vecfreq_avx512_width(const bool fp)
+{
+	(void)fp;
+
+	return __builtin_cpu_supports("avx512f") ? 512 : 0;
+}
+#endif
+
+#if defined(STRESS_VECFREQ_AMX)
+
+#if !defined(ARCH_REQ_XCOMP_PERM)
+#define ARCH_REQ_XCOMP_PERM	(0x1023)
+#endif
+#if !defined(XFEATURE_XTILEDATA)
+#define XFEATURE_XTILEDATA	(18)
+#endif
+
+#define VECFREQ_AMX_ROWS	(16)
+#define VECFREQ_AMX_BYTES	(64)		/* bytes per tile row */
+
+/* palette 1 tile configuration, as loaded by ldtilecfg */
+typedef struct {
+	uint8_t palette_id;
+	uint8_t start_row;
+	uint8_t reserved[14];
+	uint16_t colsb[16];
+	uint8_t rows[16];
+} stress_vecfreq_tilecfg_t;
+
+static uint8_t vecfreq_amx_a[VECFREQ_AMX_ROWS * VECFREQ_AMX_BYTES] ALIGNED(64);
+static uint8_t vecfreq_amx_b[VECFREQ_AMX_ROWS * VECFREQ_AMX_BYTES] ALIGNED(64);
+static uint8_t vecfreq_amx_c[VECFREQ_AMX_ROWS * VECFREQ_AMX_BYTES] ALIGNED(64);
+
+/*
+ *  stress_vecfreq_amx_config()
+ *	configure tiles 0..3 as accumulators and 4..5 as sources,
+ *	all 16 rows of 64 bytes
+ */
+static void stress_vecfreq_amx_config(stress_vecfreq_tilecfg_t *cfg)
+{
+	int i;
+
+	(void)memset(cfg, 0, sizeof(*cfg));
+	cfg->palette_id = 1;
+	for (i = 0; i < 6; i++) {
+		cfg->colsb[i] = VECFREQ_AMX_BYTES;
+		cfg->rows[i] = VECFREQ_AMX_ROWS;
+	}
+}
+
+/*
+ *  stress_vecfreq_amx_int()
+ *	int8 dot products, each tdpbssd is 16 x 16 x 64 multiply-adds
+ */
+static uint64_t __attribute__((target("amx-tile,amx-int8"))) stress_vecfreq_amx_int(const uint32_t loops)
+{
+	stress_vecfreq_tilecfg_t cfg;
+	uint32_t i;
+
+	stress_vecfreq_amx_config(&cfg);
+	_tile_loadconfig(&cfg);
+	_tile_zero(0);
+	_tile_zero(1);
+	_tile_zero(2);
+	_tile_zero(3);
+	_tile_loadd(4, vecfreq_amx_a, VECFREQ_AMX_BYTES);
+	_tile_loadd(5, vecfreq_amx_b, VECFREQ_AMX_BYTES);
+	for (i = 0; i < loops; i++) {
+		_tile_dpbssd(0, 4, 5);
+		_tile_dpbssd(1, 4, 5);
+		_tile_dpbssd(2, 4, 5);
+		_tile_dpbssd(3, 4, 5);
+	}
+	_tile_stored(0, vecfreq_amx_c, VECFREQ_AMX_BYTES);
+	_tile_release();
+
+	return (uint64_t)loops * 4 * (16 * 16 * 64) * 2;
+}
+
+/*
+ *  stress_vecfreq_amx_fp()
+ *	bf16 dot products, each tdpbf16ps is 16 x 16 x 32 multiply-adds
+ */
+static uint64_t __attribute__((target("amx-tile,amx-bf16"))) stress_vecfreq_amx_fp(const uint32_t loops)
+{
+	stress_vecfreq_tilecfg_t cfg;
+	uint32_t i;
+
+	stress_vecfreq_amx_config(&cfg);
+	_tile_loadconfig(&cfg);
+	_tile_zero(0);
+	_tile_zero(1);
+	_tile_zero(2);
+	_tile_zero(3);
+	_tile_loadd(4, vecfreq_amx_a, VECFREQ_AMX_BYTES);
+	_tile_loadd(5, vecfreq_amx_b, VECFREQ_AMX_BYTES);
+	for (i = 0; i < loops; i++) {
+		_tile_dpbf16ps(0, 4, 5);
+		_tile_dpbf16ps(1, 4, 5);
+		_tile_dpbf16ps(2, 4, 5);
+		_tile_dpbf16ps(3, 4, 5);
+	}
+	_tile_stored(0, vecfreq_amx_c, VECFREQ_AMX_BYTES);
+	_tile_release();
+
+	return (uint64_t)loops * 4 * (16 * 16 * 32) * 2;
+}
+
+/*
+ *  stress_vecfreq_amx_width()
+ *	AMX is usable if the CPU has it and the kernel lets this
+ *	process use the tile data state, the width is a whole tile
+ */
+static uint32_t stress_vecfreq_amx_width(const bool fp)
+{
+	static int permitted = -1;
+	size_t i;
+
+	if (fp ? !stress_cpu_x86_has_amx_bf16() : !stress_cpu_x86_has_amx_int8())
+		return 0;
+	if (permitted < 0) {
+		permitted = (syscall(__NR_arch_prctl, ARCH_REQ_XCOMP_PERM,
+				XFEATURE_XTILEDATA) == 0);
+		/* small bf16 values so the fp sums stay finite */
+		for (i = 0; i < sizeof(vecfreq_amx_a); i += 2) {
+			vecfreq_amx_a[i] = 0x80;
+			vecfreq_amx_a[i + 1] = 0x3b;
+			vecfreq_amx_b[i] = 0x80;
+			vecfreq_amx_b[i + 1] = 0x3b;
+		}
+	}
+	return permitted ? VECFREQ_AMX_ROWS * VECFREQ_AMX_BYTES * 8 : 0;
+}
+#endif
+
+#if defined(STRESS_VECFREQ_ARM)
+#define VECFREQ_NEON_ADD(x)	vaddq_u32(x, k2)
+#define VECFREQ_NEON_MLA(x)	vfmaq_f32(k2, x, k1)
+
+STRESS_VECFREQ_KERNEL(stress_vecfreq_neon_int, OPTIMIZE3,
+	uint32x4_t, vdupq_n_u32(1), vdupq_n_u32(3), VECFREQ_NEON_ADD, "w", 1)
+STRESS_VECFREQ_KERNEL(stress_vecfreq_neon_fp, OPTIMIZE3,
+	float32x4_t, vdupq_n_f32(0.999999f), vdupq_n_f32(0.000001f), VECFREQ_NEON_MLA, "w", 2)
+
+static uint32_t stress_vecfreq_neon_width(const bool fp)
+{
+	(void)fp;
+
+	return 128;
+}
+#endif
+
+#if defined(STRESS_VECFREQ_SVE)
+/*
+ *  SVE types are sizeless so the lane count comes from svcntw()
+ *  rather than sizeof in the kernel macro
+ */
+#define STRESS_VECFREQ_SVE_KERNEL(name, type, k1_init, k2_init, op, ops_per_lane) \
+static uint64_t OPTIMIZE3 name(const uint32_t loops)			\
+{									\
+	const svbool_t pg = svptrue_b32();				\
+	const type k1 = k1_init;					\
+	const type k2 = k2_init;					\
+	type a0 = k1, a1 = k1, a2 = k1, a3 = k1;			\
+	type a4 = k1, a5 = k1, a6 = k1, a7 = k1;			\
+	uint32_t i;							\
+									\
+	for (i = 0; i < loops; i++) {					\
+		a0 = op(a0); a1 = op(a1); a2 = op(a2); a3 = op(a3);	\
+		a4 = op(a4); a5 = op(a5); a6 = op(a6); a7 = op(a7);	\
+		VECFREQ_BARRIER("w");					\
+	}								\
+	return (uint64_t)loops * 8 * svcntw() * ops_per_lane;		\
+}
+
+#define VECFREQ_SVE_ADD(x)	svadd_u32_x(pg, x, k2)
+#define VECFREQ_SVE_MLA(x)	svmla_f32_x(pg, k2, x, k1)
+
+STRESS_VECFREQ_SVE_KERNEL(stress_vecfreq_sve_int, svuint32_t,
+	svdup_n_u32(1), svdup_n_u32(3), VECFREQ_SVE_ADD, 1)
+STRESS_VECFREQ_SVE_KERNEL(stress_vecfreq_sve_fp, svfloat32_t,
+	svdup_n_f32(0.999999f), svdup_n_f32(0.000001f), VECFREQ_SVE_MLA, 2)
+
+static uint32_t stress_vecfreq_sve_width(const bool fp)
+{
+	(void)fp;
+
+	if (!(getauxval(AT_HWCAP) & HWCAP_SVE))
+		return 0;
+	return (uint32_t)svcntb() * 8;
+}
+#endif
+
+static const stress_vecfreq_kernel_t vecfreq_kernels[] = {
+	{ "scalar",	stress_vecfreq_scalar_width,	stress_vecfreq_scalar_int,	stress_vecfreq_scalar_fp },
+#if defined(STRESS_VECFREQ_X86)
+	{ "sse2",	stress_vecfreq_sse_width,	stress_vecfreq_sse_int,		stress_vecfreq_sse_fp },
+	{ "avx2",	stress_vecfreq_avx2_width,	stress_vecfreq_avx2_int,	stress_vecfreq_avx2_fp },
+	{ "avx512",	stress_vecfreq_avx512_width,	stress_vecfreq_avx512_int,	stress_vecfreq_avx512_fp },
+#endif
+#if defined(STRESS_VECFREQ_AMX)
+	{ "amx",	stress_vecfreq_amx_width,	stress_vecfreq_amx_int,		stress_vecfreq_amx_fp },
+#endif
+#if defined(STRESS_VECFREQ_ARM)
+	{ "neon",	stress_vecfreq_neon_width,	stress_vecfreq_neon_int,	stress_vecfreq_neon_fp },
+#endif
+#if defined(STRESS_VECFREQ_SVE)
+	{ "sve",	stress_vecfreq_sve_width,	stress_vecfreq_sve_int,		stress_vecfreq_sve_fp },
+#endif
+};
+
+/*
+ *  stress_vecfreq_probe()
+ *	run a chain of dependent adds, one per cycle, straight after
+ *	a kernel while the core is still at that kernel's frequency
+ *	licence, returns the seconds taken for the probe cycles
+ */
+static double stress_vecfreq_probe(double *cycles)
+{
+	uint64_t x = 0;
+	const uint64_t one = 1;
+	uint32_t i;
+	double t;
+
+	/* register operands, some cores fold chains of immediate adds */
+	t = stress_time_now();
+	for (i = 0; i < VECFREQ_PROBE_LOOPS; i++) {
+#if defined(STRESS_VECFREQ_X86)
+		__asm__ __volatile__(".rept 100\n\tadd %1, %0\n\t.endr\n" : "+r" (x) : "r" (one));
+#else
+		__asm__ __volatile__(".rept 100\n\tadd %0, %0, %1\n\t.endr\n" : "+r" (x) : "r" (one));
+#endif
+	}
+	*cycles += (double)VECFREQ_PROBE_LOOPS * VECFREQ_PROBE_ADDS;
+	return stress_time_now() - t;
+}
+
+/*
+ *  stress_vecfreq_ghz()
+ *	effective core clock in GHz from a few frequency probes,
+ *	the fastest probe is the least disturbed
+ */
+double stress_vecfreq_ghz(void)
+{
+	double ghz = 0.0;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		double cycles = 0.0;
+		const double t = stress_vecfreq_probe(&cycles);
+
+		if (t > 0.0)
+			ghz = STRESS_MAXIMUM(ghz, cycles / t / 1000000000.0);
+	}
+	return ghz;
+}
+
+/*
+ *  stress_vecfreq_run()
+ *	run a kernel for a slice in chunks of about VECFREQ_CHUNK
+ *	seconds, probing the core frequency after each chunk
+ */
+static void stress_vecfreq_run(
+	const stress_args_t *args,
+	const stress_vecfreq_func_t func,
+	stress_vecfreq_stats_t *st)
+{
+	uint32_t loops = VECFREQ_MIN_LOOPS, chunks = 0;
+	double t_end;
+
+	/* warm up and size the chunks, not counted */
+	for (;;) {
+		double t = stress_time_now();
+
+		(void)func(loops);
+		t = stress_time_now() - t;
+		if ((t >= VECFREQ_CHUNK) || (loops >= VECFREQ_MAX_LOOPS))
+			break;
+		loops <<= 1;
+	}
+
+	t_end = stress_time_now() + VECFREQ_SLICE;
+	while (keep_stressing(args) && (stress_time_now() < t_end)) {
+		double t = stress_time_now();
+
+		st->ops += func(loops);
+		st->duration += stress_time_now() - t;
+		st->probe_duration += stress_vecfreq_probe(&st->probe_cycles);
+
+		if ((++chunks % VECFREQ_SYSFS_CHUNKS) == 0) {
+			const double ghz = stress_get_cpu_ghz_average();
+
+			if (ghz > 0.0) {
+				st->sysfs_ghz += ghz;
+				st->sysfs_samples++;
+			}
+		}
+	}
+}
+
+/*
+ *  stress_vecfreq_report()
+ *	report per width throughput and core frequency relative
+ *	to the scalar kernel
+ */
+static void stress_vecfreq_report(
+	const stress_args_t *args,
+	const stress_vecfreq_stats_t *stats,
+	const bool fp)
+{
+	const double base_ghz = (stats[0].probe_duration > 0.0) ?
+		stats[0].probe_cycles / stats[0].probe_duration / 1000000000.0 : 0.0;
+	bool lock = false;
+	size_t i;
+	int idx = 0;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %s kernels, core frequency probed after each %.0f ms\n",
+		args->name, fp ? "floating point multiply-add" : "integer add",
+		VECFREQ_CHUNK * 1000.0);
+	pr_inf_lock(&lock, "%s: %-8s %5s %10s %10s %7s %9s %7s\n", args->name,
+		"kernel", "bits", "Gops/sec", "ops/cycle", "GHz", "sysfs GHz", "freq %");
+	for (i = 0; i < SIZEOF_ARRAY(vecfreq_kernels); i++) {
+		const stress_vecfreq_stats_t *st = &stats[i];
+		double gops, ghz;
+		char sysfs[16];
+
+		if (!st->width) {
+			pr_inf_lock(&lock, "%s: %-8s %5s %10s %10s %7s %9s %7s\n", args->name,
+				vecfreq_kernels[i].name, "n/a", "n/a", "n/a", "n/a", "n/a", "n/a");
+			continue;
+		}
+		if ((st->duration <= 0.0) || (st->probe_duration <= 0.0))
+			continue;
+		gops = (double)st->ops / st->duration / 1000000000.0;
+		ghz = st->probe_cycles / st->probe_duration / 1000000000.0;
+		if (st->sysfs_samples)
+			(void)snprintf(sysfs, sizeof(sysfs), "%9.3f",
+				st->sysfs_ghz / (double)st->sysfs_samples);
+		else
+			(void)shim_strlcpy(sysfs, "n/a", sizeof(sysfs));
+		pr_inf_lock(&lock, "%s: %-8s %5" PRIu32 " %10.3f %10.2f %7.3f %9s %6.1f%%\n",
+			args->name, vecfreq_kernels[i].name, st->width, gops,
+			gops / ghz, ghz, sysfs,
+			(base_ghz > 0.0) ? 100.0 * ghz / base_ghz : 0.0);
+		if (idx < 10) {
+			char desc[32];
+
+			(void)snprintf(desc, sizeof(desc), "%s GHz", vecfreq_kernels[i].name);
+			stress_misc_stats_set(args->misc_stats, idx++, desc, ghz);
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_vecfreq()
+ *	measure the throughput of each vector width along with the
+ *	core frequency it runs at, fp selects the heavy floating
+ *	point kernels rather than the light integer ones
+ */
+int stress_vecfreq(const stress_args_t *args, const bool fp)
+{
+	stress_vecfreq_stats_t stats[SIZEOF_ARRAY(vecfreq_kernels)];
+	size_t i;
+
+	(void)memset(stats, 0, sizeof(stats));
+	for (i = 0; i < SIZEOF_ARRAY(vecfreq_kernels); i++)
+		stats[i].width = vecfreq_kernels[i].width(fp);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(vecfreq_kernels); i++) {
+			if (!stats[i].width)
+				continue;
+			stress_vecfreq_run(args, fp ? vecfreq_kernels[i].fp_func :
+				vecfreq_kernels[i].int_func, &stats[i]);
+			inc_counter(args);
+			if (!keep_stressing(args))
+				break;
+		}
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_vecfreq_report(args, stats, fp);
+
+	return EXIT_SUCCESS;
+}
+#else
+double stress_vecfreq_ghz(void)
+{
+	return 0.0;
+}
+
+int stress_vecfreq(const stress_args_t *args, const bool fp)
+{
+	(void)fp;
+
+	if (args->instance == 0)
+		pr_inf_skip("%s: vector frequency measurement is not implemented "
+			"on this architecture, skipping stressor\n", args->name);
+	return EXIT_NOT_IMPLEMENTED;
+}
+#endif
@@ -29,6 +29,10 @@ static int32_t vmstat_delay = 0;
 static int32_t thermalstat_delay = 0;
 static int32_t iostat_delay = 0;
 
+#define IOSTAT_FORMAT_TEXT	(0)
+#define IOSTAT_FORMAT_JSON	(1)
+#define IOSTAT_FORMAT_YAML	(2)
+
 #if defined(__FreeBSD__)
 static int freebsd_getsysctl(const char *name, void *ptr, size_t size)
 {
@@ -89,6 +93,28 @@ int stress_set_iostat(const char *const opt)
 	return stress_set_generic_stat(opt, "iostat", &iostat_delay);
 }
 
+/*
+ *  stress_set_iostat_format()
+ *	set the iostat output format, text, json or yaml, json
+ *	and yaml go to stdout rather than the log
+ */
+int stress_set_iostat_format(const char *const opt)
+{
+	int32_t format;
+
+	if (!strcmp(opt, "text")) {
+		format = IOSTAT_FORMAT_TEXT;
+	} else if (!strcmp(opt, "json")) {
+		format = IOSTAT_FORMAT_JSON;
+	} else if (!strcmp(opt, "yaml")) {
+		format = IOSTAT_FORMAT_YAML;
+	} else {
+		(void)fprintf(stderr, "iostat-format must be text, json or yaml\n");
+		_exit(EXIT_FAILURE);
+	}
+	return stress_set_setting_global("iostat-format", TYPE_ID_INT32, &format);
+}
+
 #if defined(__linux__)
 /*
  *  stress_find_mount_dev()
@@ -149,6 +175,32 @@ static pid_t vmstat_pid;
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
 
+#define IOSTAT_DEVS_MAX		(16)	/* block devices reported */
+#define IOSTAT_PROCS_MAX	(32768)	/* processes scanned per sample */
+
+/* A block device and its stats at the previous sample */
+typedef struct {
+	dev_t dev;
+	char name[32];
+	char stat_path[PATH_MAX];
+	stress_iostat_t prev;
+} stress_iostat_dev_t;
+
+/* The I/O of one stressor and the device it last used */
+typedef struct {
+	char *name;
+	uint64_t read_bytes;	/* totals at the previous sample */
+	uint64_t write_bytes;
+	uint64_t read_delta;	/* since the previous sample */
+	uint64_t write_delta;
+	int dev;		/* index of device, -1 if not known yet */
+} stress_iostat_stressor_t;
+
+typedef struct {
+	pid_t pid;
+	pid_t ppid;
+} stress_iostat_proc_t;
+
 /*
  *  stress_iostat_iostat_name()
  *	from the stress-ng temp file path try to determine
@@ -167,6 +219,7 @@ static char *stress_iostat_iostat_name(
 
 	/* Find device */
 	dev = stress_find_mount_dev(temp_path);
+	free(temp_path);
 	if (!dev)
 		return NULL;
 
@@ -216,16 +269,20 @@ static void stress_read_iostat(const char *iostat_name, stress_iostat_t *iostat)
 }
 
 #define STRESS_IOSTAT_DELTA(field)					\
-	iostat->field = ((iostat_current.field > iostat_prev.field) ?	\
-	(iostat_current.field - iostat_prev.field) : 0)
+	iostat->field = ((iostat_current.field > iostat_prev->field) ?	\
+	(iostat_current.field - iostat_prev->field) : 0)
 
 /*
  *  stress_get_iostat()
- *	read and compute delta since last read of iostats
+ *	read and compute delta since last read of iostats, the
+ *	number of requests in flight is not a counter and is
+ *	the current value
  */
-static void stress_get_iostat(const char *iostat_name, stress_iostat_t *iostat)
+static void stress_get_iostat(
+	const char *iostat_name,
+	stress_iostat_t *iostat_prev,
+	stress_iostat_t *iostat)
 {
-	static stress_iostat_t iostat_prev;
 	stress_iostat_t iostat_current;
 
 	(void)memset(&iostat_current, 0, sizeof(iostat_current));
@@ -238,14 +295,439 @@ static void stress_get_iostat(const char *iostat_name, stress_iostat_t *iostat)
 	STRESS_IOSTAT_DELTA(write_merges);
 	STRESS_IOSTAT_DELTA(write_sectors);
 	STRESS_IOSTAT_DELTA(write_ticks);
-	STRESS_IOSTAT_DELTA(in_flight);
+	iostat->in_flight = iostat_current.in_flight;
 	STRESS_IOSTAT_DELTA(io_ticks);
 	STRESS_IOSTAT_DELTA(time_in_queue);
 	STRESS_IOSTAT_DELTA(discard_io);
 	STRESS_IOSTAT_DELTA(discard_merges);
 	STRESS_IOSTAT_DELTA(discard_sectors);
 	STRESS_IOSTAT_DELTA(discard_ticks);
-	(void)memcpy(&iostat_prev, &iostat_current, sizeof(iostat_prev));
+	(void)memcpy(iostat_prev, &iostat_current, sizeof(*iostat_prev));
+}
+
+/*
+ *  stress_iostat_dev_add()
+ *	find or add the block device dev, returns its index
+ *	or -1 if it is not a block device with stats
+ */
+static int stress_iostat_dev_add(
+	stress_iostat_dev_t *devs,
+	int *n_devs,
+	const dev_t dev)
+{
+	char path[PATH_MAX], *real_path;
+	stress_iostat_dev_t *d;
+	const char *ptr;
+	int i;
+
+	for (i = 0; i < *n_devs; i++) {
+		if (devs[i].dev == dev)
+			return i;
+	}
+	/* Anonymous devices of tmpfs, overlayfs, etc. */
+	if ((major(dev) == 0) || (*n_devs >= IOSTAT_DEVS_MAX))
+		return -1;
+
+	(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u",
+		major(dev), minor(dev));
+	real_path = realpath(path, NULL);
+	if (!real_path)
+		return -1;
+	d = &devs[*n_devs];
+	ptr = strrchr(real_path, '/');
+	(void)shim_strlcpy(d->name, ptr ? ptr + 1 : real_path, sizeof(d->name));
+	(void)snprintf(d->stat_path, sizeof(d->stat_path), "%s/stat", real_path);
+	free(real_path);
+	if (access(d->stat_path, R_OK) < 0)
+		return -1;
+	d->dev = dev;
+	stress_read_iostat(d->stat_path, &d->prev);
+	return (*n_devs)++;
+}
+
+/*
+ *  stress_iostat_init()
+ *	start with the device of the temporary files, each stressor's
+ *	device is found from the files it has open
+ */
+static int stress_iostat_init(
+	stress_stressor_t *stressors_list,
+	stress_iostat_dev_t *devs,
+	stress_iostat_stressor_t **iostat_stressors,
+	size_t *n_iostat_stressors)
+{
+	struct stat statbuf;
+	stress_stressor_t *ss;
+	int n_devs = 0;
+	size_t n = 0;
+
+	if ((stat(stress_get_temp_path(), &statbuf) == 0) &&
+	    (stress_iostat_dev_add(devs, &n_devs, statbuf.st_dev) < 0)) {
+		/* Not a plain block device, try the device it is mounted from */
+		stress_iostat_dev_t *d = &devs[0];
+
+		if (stress_iostat_iostat_name(d->stat_path, sizeof(d->stat_path)) &&
+		    (access(d->stat_path, R_OK) == 0)) {
+			const char *name = d->stat_path + strlen("/sys/block/");
+			const char *slash = strchr(name, '/');
+
+			(void)snprintf(d->name, sizeof(d->name), "%.*s",
+				slash ? (int)(slash - name) : (int)strlen(name), name);
+			d->dev = statbuf.st_dev;
+			stress_read_iostat(d->stat_path, &d->prev);
+			n_devs = 1;
+		}
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		n++;
+	*iostat_stressors = calloc(n ? n : 1, sizeof(**iostat_stressors));
+	*n_iostat_stressors = 0;
+	if (*iostat_stressors) {
+		for (n = 0, ss = stressors_list; ss; ss = ss->next, n++) {
+			(*iostat_stressors)[n].name =
+				strdup(stress_munge_underscore(ss->stressor->name));
+			(*iostat_stressors)[n].dev = -1;
+		}
+		*n_iostat_stressors = n;
+	}
+	return n_devs;
+}
+
+static int stress_iostat_proc_cmp(const void *p1, const void *p2)
+{
+	const stress_iostat_proc_t *proc1 = (const stress_iostat_proc_t *)p1;
+	const stress_iostat_proc_t *proc2 = (const stress_iostat_proc_t *)p2;
+
+	return (int)(proc1->pid - proc2->pid);
+}
+
+/*
+ *  stress_iostat_procs()
+ *	read the parent of every process, sorted by pid
+ */
+static size_t stress_iostat_procs(stress_iostat_proc_t *procs)
+{
+	DIR *dir;
+	const struct dirent *d;
+	size_t n = 0;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return 0;
+	while (((d = readdir(dir)) != NULL) && (n < IOSTAT_PROCS_MAX)) {
+		char path[PATH_MAX], buf[512];
+		const char *ptr;
+		int ppid;
+
+		if (!isdigit((int)d->d_name[0]))
+			continue;
+		(void)snprintf(path, sizeof(path), "/proc/%s/stat", d->d_name);
+		if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+			continue;
+		buf[sizeof(buf) - 1] = '\0';
+		/* The comm field can contain spaces, skip past it */
+		ptr = strrchr(buf, ')');
+		if (!ptr || (sscanf(ptr + 1, " %*c %d", &ppid) != 1))
+			continue;
+		procs[n].pid = (pid_t)atoi(d->d_name);
+		procs[n].ppid = (pid_t)ppid;
+		n++;
+	}
+	(void)closedir(dir);
+	qsort(procs, n, sizeof(*procs), stress_iostat_proc_cmp);
+	return n;
+}
+
+/*
+ *  stress_iostat_is_instance()
+ *	true if pid is the process of one of the running
+ *	instances of stressor ss
+ */
+static bool stress_iostat_is_instance(const stress_stressor_t *ss, const pid_t pid)
+{
+	int32_t j;
+
+	for (j = 0; j < ss->num_instances; j++) {
+		const stress_stats_t *stats = ss->stats[j];
+
+		if ((stats->pid == pid) && (stats->start > 0.0) &&
+		    (stats->finish <= stats->start))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  stress_iostat_of_stressor()
+ *	true if pid is an instance of stressor ss or one
+ *	of their descendants
+ */
+static bool stress_iostat_of_stressor(
+	const stress_stressor_t *ss,
+	const stress_iostat_proc_t *procs,
+	const size_t n_procs,
+	pid_t pid)
+{
+	int depth;
+
+	for (depth = 0; (depth < 32) && (pid > 1); depth++) {
+		stress_iostat_proc_t key, *proc;
+
+		if (stress_iostat_is_instance(ss, pid))
+			return true;
+		key.pid = pid;
+		proc = bsearch(&key, procs, n_procs, sizeof(*procs), stress_iostat_proc_cmp);
+		if (!proc)
+			return false;
+		pid = proc->ppid;
+	}
+	return false;
+}
+
+/*
+ *  stress_iostat_proc_io()
+ *	add the bytes a process has read from and written to storage,
+ *	this includes its children that have been reaped
+ */
+static void stress_iostat_proc_io(const pid_t pid, uint64_t *read_bytes, uint64_t *write_bytes)
+{
+	char path[64], buf[1024];
+	const char *ptr;
+	uint64_t val;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return;
+	buf[sizeof(buf) - 1] = '\0';
+	ptr = strstr(buf, "\nread_bytes:");
+	if (ptr && (sscanf(ptr + 12, "%" SCNu64, &val) == 1))
+		*read_bytes += val;
+	ptr = strstr(buf, "\nwrite_bytes:");
+	if (ptr && (sscanf(ptr + 13, "%" SCNu64, &val) == 1))
+		*write_bytes += val;
+}
+
+/*
+ *  stress_iostat_proc_devs()
+ *	count the regular files a process has open on each device
+ */
+static void stress_iostat_proc_devs(
+	const pid_t pid,
+	stress_iostat_dev_t *devs,
+	int *n_devs,
+	uint32_t *counts)
+{
+	char path[64];
+	DIR *dir;
+	const struct dirent *d;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+	dir = opendir(path);
+	if (!dir)
+		return;
+	while ((d = readdir(dir)) != NULL) {
+		char fd_path[PATH_MAX];
+		struct stat statbuf;
+		int idx;
+
+		if (!isdigit((int)d->d_name[0]))
+			continue;
+		(void)snprintf(fd_path, sizeof(fd_path), "%s/%s", path, d->d_name);
+		if ((stat(fd_path, &statbuf) < 0) || !S_ISREG(statbuf.st_mode))
+			continue;
+		idx = stress_iostat_dev_add(devs, n_devs, statbuf.st_dev);
+		if (idx >= 0)
+			counts[idx]++;
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  stress_iostat_stressors()
+ *	find the I/O of each stressor since the previous sample,
+ *	from its instances and their descendants, and the device
+ *	it has the most files open on
+ */
+static void stress_iostat_stressors(
+	stress_stressor_t *stressors_list,
+	stress_iostat_dev_t *devs,
+	int *n_devs,
+	stress_iostat_stressor_t *iostat_stressors,
+	const size_t n_iostat_stressors)
+{
+	stress_iostat_proc_t *procs;
+	stress_stressor_t *ss;
+	size_t i, n_procs;
+
+	procs = calloc(IOSTAT_PROCS_MAX, sizeof(*procs));
+	if (!procs)
+		return;
+	n_procs = stress_iostat_procs(procs);
+
+	for (i = 0, ss = stressors_list; ss && (i < n_iostat_stressors); ss = ss->next, i++) {
+		stress_iostat_stressor_t *is = &iostat_stressors[i];
+		uint64_t read_bytes = 0, write_bytes = 0;
+		uint32_t counts[IOSTAT_DEVS_MAX];
+		size_t k;
+		bool found = false;
+		int d;
+
+		is->read_delta = 0;
+		is->write_delta = 0;
+		(void)memset(counts, 0, sizeof(counts));
+		for (k = 0; k < n_procs; k++) {
+			if (!stress_iostat_of_stressor(ss, procs, n_procs, procs[k].pid))
+				continue;
+			found = true;
+			stress_iostat_proc_io(procs[k].pid, &read_bytes, &write_bytes);
+			stress_iostat_proc_devs(procs[k].pid, devs, n_devs, counts);
+		}
+		for (d = 0; d < *n_devs; d++) {
+			if ((counts[d] > 0) && ((is->dev < 0) || (counts[d] > counts[is->dev])))
+				is->dev = d;
+		}
+		if (!found)
+			continue;
+		/* No files open yet, stressors default to the temporary path */
+		if ((is->dev < 0) && (*n_devs > 0))
+			is->dev = 0;
+		/* Totals drop when an instance exits or a stressor is run again */
+		if (read_bytes >= is->read_bytes)
+			is->read_delta = read_bytes - is->read_bytes;
+		if (write_bytes >= is->write_bytes)
+			is->write_delta = write_bytes - is->write_bytes;
+		is->read_bytes = read_bytes;
+		is->write_bytes = write_bytes;
+	}
+	free(procs);
+}
+
+/*
+ *  stress_iostat_report()
+ *	report the I/O of each device and of the stressors using it,
+ *	as text or as json or yaml on stdout
+ */
+static void stress_iostat_report(
+	stress_stressor_t *stressors_list,
+	stress_iostat_dev_t *devs,
+	int *n_devs,
+	stress_iostat_stressor_t *iostat_stressors,
+	const size_t n_iostat_stressors,
+	const int32_t format,
+	const double t)
+{
+	static uint32_t iostat_count = 0;
+	const double clk_scale = (iostat_delay > 0) ? 1.0 / iostat_delay : 0.0;
+	const double interval_ms = (double)iostat_delay * 1000.0;
+	size_t i;
+	int d;
+
+	/* Find the stressors' devices first so new devices get a baseline */
+	stress_iostat_stressors(stressors_list, devs, n_devs,
+		iostat_stressors, n_iostat_stressors);
+
+	if ((format == IOSTAT_FORMAT_TEXT) && ((iostat_count++ % 25) == 0)) {
+		pr_inf("iostat: Device   Inflght  Rd K/s   Wr K/s Dscd K/s     Rd/s     Wr/s   Dscd/s "
+			"Await ms   AquSz  Util%%\n");
+		pr_inf("iostat: Device   Stressor     Rd K/s   Wr K/s  Dev%%\n");
+	}
+
+	for (d = 0; d < *n_devs; d++) {
+		stress_iostat_dev_t *dev = &devs[d];
+		stress_iostat_t iostat;
+		uint64_t ios, ticks, dev_bytes;
+		double await, aqu, util;
+
+		stress_get_iostat(dev->stat_path, &dev->prev, &iostat);
+		ios = iostat.read_io + iostat.write_io + iostat.discard_io;
+		ticks = iostat.read_ticks + iostat.write_ticks + iostat.discard_ticks;
+		await = ios ? (double)ticks / (double)ios : 0.0;
+		aqu = (double)iostat.time_in_queue / interval_ms;
+		util = STRESS_MINIMUM(100.0, 100.0 * (double)iostat.io_ticks / interval_ms);
+		dev_bytes = (iostat.read_sectors + iostat.write_sectors) * 512;
+
+		if (format == IOSTAT_FORMAT_YAML) {
+			(void)printf("    - time: %.3f\n", t);
+			(void)printf("      device: %s\n", dev->name);
+			(void)printf("      in-flight: %" PRIu64 "\n", iostat.in_flight);
+			(void)printf("      read-kb-per-second: %.2f\n",
+				(double)(iostat.read_sectors >> 1) * clk_scale);
+			(void)printf("      write-kb-per-second: %.2f\n",
+				(double)(iostat.write_sectors >> 1) * clk_scale);
+			(void)printf("      discard-kb-per-second: %.2f\n",
+				(double)(iostat.discard_sectors >> 1) * clk_scale);
+			(void)printf("      reads-per-second: %.2f\n", (double)iostat.read_io * clk_scale);
+			(void)printf("      writes-per-second: %.2f\n", (double)iostat.write_io * clk_scale);
+			(void)printf("      discards-per-second: %.2f\n", (double)iostat.discard_io * clk_scale);
+			(void)printf("      await-ms: %.3f\n", await);
+			(void)printf("      queue-depth: %.3f\n", aqu);
+			(void)printf("      utilization-percent: %.2f\n", util);
+		} else if (format == IOSTAT_FORMAT_JSON) {
+			(void)printf("{\"time\":%.3f,\"device\":\"%s\",\"in-flight\":%" PRIu64 ","
+				"\"read-kb-per-second\":%.2f,\"write-kb-per-second\":%.2f,"
+				"\"discard-kb-per-second\":%.2f,\"reads-per-second\":%.2f,"
+				"\"writes-per-second\":%.2f,\"discards-per-second\":%.2f,"
+				"\"await-ms\":%.3f,\"queue-depth\":%.3f,\"utilization-percent\":%.2f}\n",
+				t, dev->name, iostat.in_flight,
+				(double)(iostat.read_sectors >> 1) * clk_scale,
+				(double)(iostat.write_sectors >> 1) * clk_scale,
+				(double)(iostat.discard_sectors >> 1) * clk_scale,
+				(double)iostat.read_io * clk_scale,
+				(double)iostat.write_io * clk_scale,
+				(double)iostat.discard_io * clk_scale,
+				await, aqu, util);
+		} else {
+			/* sectors are 512 bytes, so >> 1 to get stats in 1024 bytes */
+			pr_inf("iostat %-8.8s %7" PRIu64 " %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f "
+				"%8.2f %7.2f %6.1f\n",
+				dev->name, iostat.in_flight,
+				(double)(iostat.read_sectors >> 1) * clk_scale,
+				(double)(iostat.write_sectors >> 1) * clk_scale,
+				(double)(iostat.discard_sectors >> 1) * clk_scale,
+				(double)iostat.read_io * clk_scale,
+				(double)iostat.write_io * clk_scale,
+				(double)iostat.discard_io * clk_scale,
+				await, aqu, util);
+		}
+
+		for (i = 0; i < n_iostat_stressors; i++) {
+			const stress_iostat_stressor_t *is = &iostat_stressors[i];
+			const uint64_t bytes = is->read_delta + is->write_delta;
+			double share;
+
+			if ((is->dev != d) || !bytes)
+				continue;
+			/* Write back can land in a later sample than the write */
+			share = dev_bytes ? STRESS_MINIMUM(100.0,
+				100.0 * (double)bytes / (double)dev_bytes) : 0.0;
+
+			if (format == IOSTAT_FORMAT_YAML) {
+				(void)printf("    - time: %.3f\n", t);
+				(void)printf("      device: %s\n", dev->name);
+				(void)printf("      stressor: %s\n", is->name);
+				(void)printf("      read-kb-per-second: %.2f\n",
+					(double)(is->read_delta >> 10) * clk_scale);
+				(void)printf("      write-kb-per-second: %.2f\n",
+					(double)(is->write_delta >> 10) * clk_scale);
+				(void)printf("      device-share-percent: %.2f\n", share);
+			} else if (format == IOSTAT_FORMAT_JSON) {
+				(void)printf("{\"time\":%.3f,\"device\":\"%s\",\"stressor\":\"%s\","
+					"\"read-kb-per-second\":%.2f,\"write-kb-per-second\":%.2f,"
+					"\"device-share-percent\":%.2f}\n",
+					t, dev->name, is->name,
+					(double)(is->read_delta >> 10) * clk_scale,
+					(double)(is->write_delta >> 10) * clk_scale, share);
+			} else {
+				pr_inf("iostat %-8.8s %-10.10s %8.0f %8.0f %5.1f\n",
+					dev->name, is->name,
+					(double)(is->read_delta >> 10) * clk_scale,
+					(double)(is->write_delta >> 10) * clk_scale, share);
+			}
+		}
+	}
+	if (format != IOSTAT_FORMAT_TEXT)
+		(void)fflush(stdout);
 }
 #endif
 
@@ -443,6 +925,41 @@ static void stress_read_vmstat(stress_vmstat_t *vmstat)
 					continue;
 				vmstat->swap_out = (uint64_t)atoll(ptr);
 			}
+			/* pre 5.9 kernels have no _file suffix and no anon refaults */
+			if (!strncmp(buffer, "workingset_refault_file ", 24) ||
+			    !strncmp(buffer, "workingset_refault ", 19)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->workingset_refault = (uint64_t)atoll(ptr);
+			}
+			if (!strncmp(buffer, "workingset_activate_file ", 25) ||
+			    !strncmp(buffer, "workingset_activate ", 20)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->workingset_activate = (uint64_t)atoll(ptr);
+			}
+			if (!strncmp(buffer, "workingset_restore_file ", 24) ||
+			    !strncmp(buffer, "workingset_restore ", 19)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->workingset_restore = (uint64_t)atoll(ptr);
+			}
+			if (!strncmp(buffer, "pgpromote_success ", 18)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->pgpromote = (uint64_t)atoll(ptr);
+			}
+			/* kswapd, direct, khugepaged and proactive demotions */
+			if (!strncmp(buffer, "pgdemote_", 9)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->pgdemote += (uint64_t)atoll(ptr);
+			}
+			if (!strncmp(buffer, "numa_hint_faults ", 17)) {
+				if (!stress_next_field(&ptr))
+					continue;
+				vmstat->numa_hint_faults = (uint64_t)atoll(ptr);
+			}
 		}
 		(void)fclose(fp);
 	}
@@ -479,6 +996,52 @@ static void stress_read_vmstat(stress_vmstat_t *vmstat)
 }
 #endif
 
+/*
+ *  stress_get_vmstat_swap()
+ *	get the system wide count of pages swapped in and out
+ */
+void stress_get_vmstat_swap(uint64_t *swap_in, uint64_t *swap_out)
+{
+	stress_vmstat_t vmstat;
+
+	(void)memset(&vmstat, 0, sizeof(vmstat));
+	stress_read_vmstat(&vmstat);
+	*swap_in = vmstat.swap_in;
+	*swap_out = vmstat.swap_out;
+}
+
+/*
+ *  stress_get_vmstat_workingset()
+ *	get the system wide count of file page cache refaults, how
+ *	many were activated and how many were of the workingset
+ */
+void stress_get_vmstat_workingset(uint64_t *refault, uint64_t *activate, uint64_t *restore)
+{
+	stress_vmstat_t vmstat;
+
+	(void)memset(&vmstat, 0, sizeof(vmstat));
+	stress_read_vmstat(&vmstat);
+	*refault = vmstat.workingset_refault;
+	*activate = vmstat.workingset_activate;
+	*restore = vmstat.workingset_restore;
+}
+
+/*
+ *  stress_get_vmstat_tiering()
+ *	get the system wide count of pages promoted to and demoted
+ *	from faster memory tiers and of NUMA hinting faults
+ */
+void stress_get_vmstat_tiering(uint64_t *promote, uint64_t *demote, uint64_t *hint_faults)
+{
+	stress_vmstat_t vmstat;
+
+	(void)memset(&vmstat, 0, sizeof(vmstat));
+	stress_read_vmstat(&vmstat);
+	*promote = vmstat.pgpromote;
+	*demote = vmstat.pgdemote;
+	*hint_faults = vmstat.numa_hint_faults;
+}
+
 #define STRESS_VMSTAT_COPY(field)	vmstat->field = (vmstat_current.field)
 #define STRESS_VMSTAT_DELTA(field)					\
 	vmstat->field = ((vmstat_current.field > vmstat_prev.field) ?	\
@@ -546,7 +1109,7 @@ static double stress_get_tz_info(stress_tz_info_t *tz_info)
  *  stress_get_cpu_ghz_average()
  *	compute average CPU frequencies in GHz
  */
-static double stress_get_cpu_ghz_average(void)
+double stress_get_cpu_ghz_average(void)
 {
 	struct dirent **cpu_list = NULL;
 	int i, n_cpus, n = 0;
@@ -580,7 +1143,7 @@ static double stress_get_cpu_ghz_average(void)
 	return (n == 0) ? 0.0 : (total_freq / n) * ONE_MILLIONTH;
 }
 #elif defined(__FreeBSD__)
-static double stress_get_cpu_ghz_average(void)
+double stress_get_cpu_ghz_average(void)
 {
 	const int32_t ncpus = stress_get_processors_configured();
 	int32_t i;
@@ -599,7 +1162,7 @@ static double stress_get_cpu_ghz_average(void)
 	return 0.0;
 }
 #else
-static double stress_get_cpu_ghz_average(void)
+double stress_get_cpu_ghz_average(void)
 {
 	return 0.0;
 }
@@ -609,7 +1172,7 @@ static double stress_get_cpu_ghz_average(void)
  *  stress_vmstat_start()
  *	start vmstat statistics (1 per second)
  */
-void stress_vmstat_start(void)
+void stress_vmstat_start(stress_stressor_t *stressors_list)
 {
 	stress_vmstat_t vmstat;
 	size_t tz_num = 0;
@@ -617,8 +1180,14 @@ void stress_vmstat_start(void)
 	int32_t vmstat_sleep, thermalstat_sleep, iostat_sleep;
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
-	char iostat_name[PATH_MAX];
-	stress_iostat_t iostat;
+	stress_iostat_dev_t iostat_devs[IOSTAT_DEVS_MAX];
+	stress_iostat_stressor_t *iostat_stressors = NULL;
+	size_t n_iostat_stressors = 0;
+	int n_iostat_devs = 0;
+	int32_t iostat_format = IOSTAT_FORMAT_TEXT;
+	double t_start;
+#else
+	(void)stressors_list;
 #endif
 
 	if ((vmstat_delay == 0) &&
@@ -647,10 +1216,15 @@ void stress_vmstat_start(void)
 
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
-	if (stress_iostat_iostat_name(iostat_name, sizeof(iostat_name)) == NULL)
-		iostat_sleep = 0;
-	if (iostat_delay)
-		stress_get_iostat(iostat_name, &iostat);
+	if (iostat_delay) {
+		(void)stress_get_setting("iostat-format", &iostat_format);
+		(void)memset(iostat_devs, 0, sizeof(iostat_devs));
+		n_iostat_devs = stress_iostat_init(stressors_list, iostat_devs,
+			&iostat_stressors, &n_iostat_stressors);
+		if (iostat_format == IOSTAT_FORMAT_YAML)
+			(void)printf("---\niostat:\n");
+	}
+	t_start = stress_time_now();
 #endif
 
 	while (keep_stressing_flag()) {
@@ -769,22 +1343,9 @@ void stress_vmstat_start(void)
 #if defined(HAVE_SYS_SYSMACROS_H) &&	\
     defined(__linux__)
 		if (iostat_delay == iostat_sleep) {
-			double clk_scale = (iostat_delay > 0) ? 1.0 / iostat_delay : 0.0;
-			static uint32_t iostat_count = 0;
-
-			if ((iostat_count++ % 25) == 0)
-				pr_inf("iostat: Inflght  Rd K/s   Wr K/s Dscd K/s     Rd/s     Wr/s   Dscd/s\n");
-
-			stress_get_iostat(iostat_name, &iostat);
-			/* sectors are 512 bytes, so >> 1 to get stats in 1024 bytes */
-			pr_inf("iostat %7.0f %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f\n",
-				(double)iostat.in_flight * clk_scale,
-				(double)(iostat.read_sectors >> 1) * clk_scale,
-				(double)(iostat.write_sectors >> 1) * clk_scale,
-				(double)(iostat.discard_sectors >> 1) * clk_scale,
-				(double)iostat.read_io * clk_scale,
-				(double)iostat.write_io * clk_scale,
-				(double)iostat.discard_io * clk_scale);
+			stress_iostat_report(stressors_list, iostat_devs, &n_iostat_devs,
+				iostat_stressors, n_iostat_stressors, iostat_format,
+				stress_time_now() - t_start);
 		}
 #endif
 	}
@@ -31,9 +31,22 @@ static const stress_help_t help[] = {
 	{ NULL,	"aiol N",	   "start N workers that exercise Linux async I/O" },
 	{ NULL,	"aiol-ops N",	   "stop after N bogo Linux aio async I/O requests" },
 	{ NULL,	"aiol-requests N", "number of Linux aio async I/O requests per worker" },
+	{ NULL,	"aiol-reap M",	   "benchmark random reads, reaping by ring or syscall" },
+	{ NULL,	"aiol-nr-events N", "io context size and queue depth for --aiol-reap" },
+	{ NULL,	"aiol-batch N",	   "iocbs submitted per io_submit call for --aiol-reap" },
 	{ NULL,	NULL,		   NULL }
 };
 
+#define AIOL_REAP_NONE		(0)
+#define AIOL_REAP_RING		(1)
+#define AIOL_REAP_SYSCALL	(2)
+
+#define MIN_AIOL_NR_EVENTS	(1)
+#define MAX_AIOL_NR_EVENTS	(1048576)
+#define MIN_AIOL_BATCH		(1)
+#define MAX_AIOL_BATCH		(4096)
+#define DEFAULT_AIOL_BATCH	(32)
+
 static int stress_set_aio_linux_requests(const char *opt)
 {
 	uint32_t aio_linux_requests;
@@ -44,8 +57,46 @@ static int stress_set_aio_linux_requests(const char *opt)
 	return stress_set_setting("aiol-requests", TYPE_ID_UINT32, &aio_linux_requests);
 }
 
+static int stress_set_aio_linux_reap(const char *opt)
+{
+	int aio_linux_reap;
+
+	if (!strcmp(opt, "ring")) {
+		aio_linux_reap = AIOL_REAP_RING;
+	} else if (!strcmp(opt, "syscall")) {
+		aio_linux_reap = AIOL_REAP_SYSCALL;
+	} else {
+		(void)fprintf(stderr, "aiol-reap must be one of: ring syscall\n");
+		return -1;
+	}
+	return stress_set_setting("aiol-reap", TYPE_ID_INT, &aio_linux_reap);
+}
+
+static int stress_set_aio_linux_nr_events(const char *opt)
+{
+	uint32_t aio_linux_nr_events;
+
+	aio_linux_nr_events = stress_get_uint32(opt);
+	stress_check_range("aiol-nr-events", aio_linux_nr_events,
+		MIN_AIOL_NR_EVENTS, MAX_AIOL_NR_EVENTS);
+	return stress_set_setting("aiol-nr-events", TYPE_ID_UINT32, &aio_linux_nr_events);
+}
+
+static int stress_set_aio_linux_batch(const char *opt)
+{
+	uint32_t aio_linux_batch;
+
+	aio_linux_batch = stress_get_uint32(opt);
+	stress_check_range("aiol-batch", aio_linux_batch,
+		MIN_AIOL_BATCH, MAX_AIOL_BATCH);
+	return stress_set_setting("aiol-batch", TYPE_ID_UINT32, &aio_linux_batch);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_aiol_requests,	stress_set_aio_linux_requests },
+	{ OPT_aiol_reap,	stress_set_aio_linux_reap },
+	{ OPT_aiol_nr_events,	stress_set_aio_linux_nr_events },
+	{ OPT_aiol_batch,	stress_set_aio_linux_batch },
 	{ 0,			NULL }
 };
 
@@ -328,6 +379,377 @@ static void stress_aiol_free(
 	free(fds);
 }
 
+#define AIO_RING_MAGIC		(0xa10a10a1)
+#define AIOL_BENCH_BLOCKS	(4096)	/* 16MB random read region */
+#define AIOL_BENCH_BUFFERS	(256)	/* buffers shared by in-flight reads */
+#define AIOL_SPIN_MAX		(1024)	/* empty polls before a blocking wait */
+
+/*
+ *  kernel aio completion ring, the io_context_t returned by io_setup
+ *  is the user address of this mapping
+ */
+typedef struct {
+	unsigned int id;
+	unsigned int nr;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int magic;
+	unsigned int compat_features;
+	unsigned int incompat_features;
+	unsigned int header_length;
+	struct io_event io_events[];
+} stress_aio_ring_t;
+
+typedef struct {
+	uint64_t completions;	/* completed reads */
+	uint64_t submit_calls;	/* io_submit calls */
+	uint64_t polled;	/* completions reaped by a non-blocking poll */
+	uint64_t empty_polls;	/* polls that found no completions */
+	uint64_t waits;		/* blocking io_getevents waits */
+	uint64_t errors;	/* short or failed reads */
+	double submit_time;	/* nanoseconds in io_submit */
+	double reap_time;	/* nanoseconds in polls that found completions */
+} stress_aiol_bench_t;
+
+/*
+ *  stress_aiol_ring_reap()
+ *	reap up to max completions from the mmap'd aio ring without
+ *	a system call, the kernel publishes tail and reads back head
+ */
+static size_t stress_aiol_ring_reap(
+	stress_aio_ring_t *ring,
+	struct io_event *events,
+	const size_t max)
+{
+	const unsigned int nr = ring->nr;
+	unsigned int head = ring->head;
+	const unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	size_t n = 0;
+
+	while ((head != tail) && (n < max)) {
+		events[n++] = ring->io_events[head];
+		head = (head + 1 >= nr) ? 0 : head + 1;
+	}
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/*
+ *  stress_aiol_bench_file()
+ *	create and fill the random read region, returns the fd or -1
+ */
+static int stress_aiol_bench_file(
+	const stress_args_t *args,
+	uint8_t *buffer,
+	bool *direct)
+{
+	char filename[PATH_MAX];
+	int fd, flags = O_DIRECT;
+	size_t i;
+
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), stress_mwc32());
+retry_open:
+	fd = open(filename, O_CREAT | O_RDWR | flags, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		if ((flags & O_DIRECT) && (errno == EINVAL)) {
+			flags &= ~O_DIRECT;
+			goto retry_open;
+		}
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		return -1;
+	}
+	(void)unlink(filename);
+	*direct = !!(flags & O_DIRECT);
+
+	aio_linux_fill_buffer(stress_mwc8(), buffer, AIOL_BENCH_BUFFERS * BUFFER_SZ);
+	for (i = 0; i < AIOL_BENCH_BLOCKS; i += AIOL_BENCH_BUFFERS) {
+		const size_t sz = AIOL_BENCH_BUFFERS * BUFFER_SZ;
+
+		if (pwrite(fd, buffer, sz, (off_t)(i * BUFFER_SZ)) != (ssize_t)sz) {
+			pr_inf("%s: cannot write %zd byte read region, errno=%d (%s)\n",
+				args->name, (size_t)AIOL_BENCH_BLOCKS * BUFFER_SZ,
+				errno, strerror(errno));
+			(void)close(fd);
+			return -1;
+		}
+	}
+	(void)fsync(fd);
+	return fd;
+}
+
+/*
+ *  stress_aiol_bench_setup()
+ *	set up an io context of up to nr_events, halving the size while
+ *	the system wide aio-nr limit is exceeded, returns the size or 0
+ */
+static uint32_t stress_aiol_bench_setup(
+	const stress_args_t *args,
+	uint32_t nr_events,
+	io_context_t *ctx)
+{
+	while (nr_events > 0) {
+		*ctx = 0;
+		if (shim_io_setup(nr_events, ctx) == 0)
+			return nr_events;
+		if (errno != EAGAIN) {
+			pr_inf("%s: io_setup failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			return 0;
+		}
+		nr_events >>= 1;
+	}
+	pr_inf("%s: io_setup failed, ran out of available events, "
+		"consider increasing /proc/sys/fs/aio-max-nr\n", args->name);
+	return 0;
+}
+
+/*
+ *  stress_aiol_bench_loop()
+ *	keep depth random 4K reads in flight, submitting batch iocbs per
+ *	io_submit call and reaping by polling the ring or io_getevents,
+ *	spinning up to AIOL_SPIN_MAX empty polls before blocking
+ */
+static int stress_aiol_bench_loop(
+	const stress_args_t *args,
+	const io_context_t ctx,
+	const int reap,
+	const int fd,
+	uint8_t *buffer,
+	const size_t depth,
+	const size_t batch,
+	stress_aiol_bench_t *bench)
+{
+	struct iocb *cb, **cbs;
+	struct io_event *events;
+	size_t *free_idx, n_free, i;
+	stress_aio_ring_t *ring = (stress_aio_ring_t *)ctx;
+	int rc = EXIT_SUCCESS;
+	uint32_t spins = 0;
+
+	cb = calloc(depth, sizeof(*cb));
+	events = calloc(depth, sizeof(*events));
+	cbs = calloc(batch, sizeof(*cbs));
+	free_idx = calloc(depth, sizeof(*free_idx));
+	if (!cb || !events || !cbs || !free_idx) {
+		pr_inf("%s: out of memory allocating %zd iocbs\n", args->name, depth);
+		rc = EXIT_NO_RESOURCE;
+		goto free_memory;
+	}
+	for (n_free = 0; n_free < depth; n_free++)
+		free_idx[n_free] = n_free;
+
+	do {
+		size_t n;
+		double t;
+
+		while (n_free > 0) {
+			const size_t k = STRESS_MINIMUM(n_free, batch);
+			int ret;
+
+			for (i = 0; i < k; i++) {
+				const size_t idx = free_idx[n_free - 1 - i];
+				struct iocb *obj = &cb[idx];
+
+				(void)memset(obj, 0, sizeof(*obj));
+				obj->aio_fildes = fd;
+				obj->aio_lio_opcode = IO_CMD_PREAD;
+				obj->u.c.buf = buffer + ((idx % AIOL_BENCH_BUFFERS) * BUFFER_SZ);
+				obj->u.c.offset = (long long)(stress_mwc32() % AIOL_BENCH_BLOCKS) * BUFFER_SZ;
+				obj->u.c.nbytes = BUFFER_SZ;
+				cbs[i] = obj;
+			}
+			t = stress_time_now_ns();
+			ret = shim_io_submit(ctx, (long)k, cbs);
+			bench->submit_time += stress_time_now_ns() - t;
+			if (ret < 0) {
+				if ((errno == EAGAIN) || (errno == EINTR))
+					break;
+				pr_fail("%s: io_submit failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+				goto free_memory;
+			}
+			bench->submit_calls++;
+			n_free -= (size_t)ret;
+			if ((size_t)ret < k)
+				break;
+		}
+
+		t = stress_time_now_ns();
+		if (reap == AIOL_REAP_RING) {
+			n = stress_aiol_ring_reap(ring, events, depth);
+		} else {
+			struct timespec zero = { 0, 0 };
+			const int ret = shim_io_getevents(ctx, 0, (long)depth, events, &zero);
+
+			n = (ret > 0) ? (size_t)ret : 0;
+		}
+		if (n > 0) {
+			bench->reap_time += stress_time_now_ns() - t;
+			bench->polled += n;
+			spins = 0;
+		} else {
+			bench->empty_polls++;
+			if (++spins >= AIOL_SPIN_MAX) {
+				struct timespec timeout = { 0, 10000000 };
+				const int ret = shim_io_getevents(ctx, 1, (long)depth, events, &timeout);
+
+				bench->waits++;
+				spins = 0;
+				if (ret < 0) {
+					if (errno == EINTR)
+						continue;
+					pr_fail("%s: io_getevents failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+					rc = EXIT_FAILURE;
+					break;
+				}
+				n = (size_t)ret;
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			const struct iocb *obj = events[i].obj;
+
+			if (events[i].res != BUFFER_SZ)
+				bench->errors++;
+			if (obj)
+				free_idx[n_free++] = (size_t)(obj - cb);
+		}
+		bench->completions += n;
+		add_counter(args, n);
+	} while (keep_stressing(args));
+
+free_memory:
+	free(free_idx);
+	free(cbs);
+	free(events);
+	free(cb);
+
+	return rc;
+}
+
+/*
+ *  stress_aiol_bench()
+ *	measure random read IOPS and the submission and completion cost
+ *	of reaping from the user mapped aio ring against io_getevents
+ */
+static int stress_aiol_bench(
+	const stress_args_t *args,
+	int reap,
+	const uint32_t aio_max_nr,
+	const uint32_t aio_linux_requests)
+{
+	stress_aiol_bench_t bench;
+	stress_aio_ring_t *ring;
+	io_context_t ctx = 0;
+	uint32_t nr_events = aio_linux_requests, aio_linux_batch = DEFAULT_AIOL_BATCH;
+	uint8_t *buffer;
+	struct rusage usage_start, usage_end;
+	double t_start, duration, cpu;
+	double per_io, rate;
+	bool direct = false;
+	int fd, ret, rc;
+
+	(void)stress_get_setting("aiol-nr-events", &nr_events);
+	(void)stress_get_setting("aiol-batch", &aio_linux_batch);
+	if (nr_events > aio_max_nr) {
+		nr_events = aio_max_nr;
+		if (args->instance == 0)
+			pr_inf("%s: limiting io context to %" PRIu32
+				" events to fit /proc/sys/fs/aio-max-nr\n",
+				args->name, nr_events);
+	}
+
+	ret = posix_memalign((void **)&buffer, 4096, AIOL_BENCH_BUFFERS * BUFFER_SZ);
+	if (ret) {
+		pr_inf("%s: out of memory allocating buffers\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		free(buffer);
+		return exit_status(-ret);
+	}
+	fd = stress_aiol_bench_file(args, buffer, &direct);
+	if (fd < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_dir;
+	}
+	nr_events = stress_aiol_bench_setup(args, nr_events, &ctx);
+	if (nr_events == 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_fd;
+	}
+
+	ring = (stress_aio_ring_t *)ctx;
+	if ((reap == AIOL_REAP_RING) &&
+	    ((ring->magic != AIO_RING_MAGIC) || (ring->incompat_features != 0))) {
+		if (args->instance == 0)
+			pr_inf("%s: unknown aio ring layout, reaping with io_getevents\n",
+				args->name);
+		reap = AIOL_REAP_SYSCALL;
+	}
+	if ((args->instance == 0) && !direct)
+		pr_inf("%s: O_DIRECT not supported, buffered reads complete "
+			"in io_submit\n", args->name);
+
+	(void)memset(&bench, 0, sizeof(bench));
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	(void)getrusage(RUSAGE_SELF, &usage_start);
+	t_start = stress_time_now();
+	rc = stress_aiol_bench_loop(args, ctx, reap, fd, buffer, (size_t)nr_events,
+		STRESS_MINIMUM((size_t)aio_linux_batch, (size_t)nr_events), &bench);
+	duration = stress_time_now() - t_start;
+	(void)getrusage(RUSAGE_SELF, &usage_end);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	cpu = (double)(usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+	      (double)(usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+	      ((double)(usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) +
+	       (double)(usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec)) / 1000000.0;
+	per_io = bench.completions ? 1.0 / (double)bench.completions : 0.0;
+	rate = (duration > 0.0) ? (double)bench.completions / duration : 0.0;
+
+	if (bench.errors)
+		pr_inf("%s: %" PRIu64 " reads failed or were short\n",
+			args->name, bench.errors);
+	if (args->instance == 0)
+		pr_inf("%s: %s reaping, io context of %" PRIu32 " events, "
+			"%zd iocbs per io_submit, %.0f IOPS\n", args->name,
+			(reap == AIOL_REAP_RING) ? "ring" : "io_getevents",
+			nr_events, STRESS_MINIMUM((size_t)aio_linux_batch, (size_t)nr_events),
+			rate);
+
+	stress_misc_stats_set(args->misc_stats, 0, "IOPS", rate);
+	stress_misc_stats_set(args->misc_stats, 1, "submit ns per io",
+		bench.submit_time * per_io);
+	stress_misc_stats_set(args->misc_stats, 2, "reap ns per polled io",
+		bench.polled ? bench.reap_time / (double)bench.polled : 0.0);
+	stress_misc_stats_set(args->misc_stats, 3, "CPU usr+sys ns per io",
+		1.0E9 * cpu * per_io);
+	stress_misc_stats_set(args->misc_stats, 4, "ios per io_submit call",
+		bench.submit_calls ? (double)bench.completions / (double)bench.submit_calls : 0.0);
+	stress_misc_stats_set(args->misc_stats, 5, "empty polls per io",
+		(double)bench.empty_polls * per_io);
+	stress_misc_stats_set(args->misc_stats, 6, "blocking waits per 1000 io",
+		1000.0 * (double)bench.waits * per_io);
+	stress_misc_stats_set(args->misc_stats, 7, "io context nr_events",
+		(double)nr_events);
+
+	(void)shim_io_destroy(ctx);
+tidy_fd:
+	(void)close(fd);
+tidy_dir:
+	(void)stress_temp_dir_rm_args(args);
+	free(buffer);
+
+	return rc;
+}
+
 /*
  *  stress_aiol
  *	stress asynchronous I/O using the linux specific aio ABI
@@ -337,7 +759,7 @@ static int stress_aiol(const stress_args_t *args)
 	int ret, rc = EXIT_FAILURE;
 	int flags = O_DIRECT;
 	char filename[PATH_MAX];
-	char buf[1];
+	char buf[64];
 	io_context_t ctx = 0;
 	uint32_t aio_linux_requests = DEFAULT_AIO_LINUX_REQUESTS;
 	uint8_t *buffer;
@@ -352,6 +774,7 @@ static int stress_aiol(const stress_args_t *args)
 #if defined(__NR_io_cancel)
 	int bad_fd;
 #endif
+	int aio_linux_reap = AIOL_REAP_NONE;
 
 	if (!stress_get_setting("aiol-requests", &aio_linux_requests)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -386,6 +809,10 @@ static int stress_aiol(const stress_args_t *args)
 				args->name, aio_linux_requests);
 	}
 
+	(void)stress_get_setting("aiol-reap", &aio_linux_reap);
+	if (aio_linux_reap != AIOL_REAP_NONE)
+		return stress_aiol_bench(args, aio_linux_reap, aio_max_nr, aio_linux_requests);
+
 	if (stress_aiol_alloc(args, aio_linux_requests, &buffer, &cb, &events, &cbs, &fds)) {
 		stress_aiol_free(buffer, cb, events, cbs, fds);
 		return EXIT_NO_RESOURCE;
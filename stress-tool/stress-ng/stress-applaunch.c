@@ -0,0 +1,699 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"applaunch N",		"start N workers replaying app launch memory patterns" },
+	{ NULL,	"applaunch-ops N",	"stop after N app launches" },
+	{ NULL,	"applaunch-trace file",	"replay the launch trace in file rather than the built-in one" },
+	{ NULL,	"applaunch-bg N",	"number of background app processes" },
+	{ NULL,	"applaunch-bg-bytes N",	"anonymous memory of all the background apps" },
+	{ NULL,	"applaunch-cold",	"drop the page cache of the app files before each launch" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define MIN_APPLAUNCH_BG		(0)
+#define MAX_APPLAUNCH_BG		(64)
+#define DEFAULT_APPLAUNCH_BG		(4)
+#define MIN_APPLAUNCH_BG_BYTES		(4 * KB)
+#define MAX_APPLAUNCH_BG_BYTES		(MAX_MEM_LIMIT)
+#define DEFAULT_APPLAUNCH_BG_BYTES	(256 * MB)
+
+#define APPLAUNCH_MAX_FILES		(32)
+#define APPLAUNCH_MAX_OPS		(256)
+#define APPLAUNCH_MAX_PHASES		(8)
+#define APPLAUNCH_MAX_NAME		(32)
+#define APPLAUNCH_MAX_TRACE		(64 * KB)
+#define APPLAUNCH_MAX_SAMPLES		(4096)
+#define APPLAUNCH_CHUNK			(64 * KB)
+#define APPLAUNCH_BG_PAGES		(64)	/* pages touched between background naps */
+
+/*
+ *  The built-in trace, loosely a cold start of a mid sized app: the
+ *  zygote fork maps the boot image and runtime, the app apk, odex and
+ *  native libraries are faulted in sparsely while resources are read
+ *  and the heap grows; cached apps are frozen for the launch
+ */
+static const char applaunch_default_trace[] =
+	"file base.apk 24M\n"
+	"file libart.so 8M\n"
+	"file boot.oat 32M\n"
+	"file app.odex 16M\n"
+	"file libapp.so 12M\n"
+	"phase fork\n"
+	"freeze\n"
+	"anon 4M\n"
+	"mmap boot.oat 30\n"
+	"mmap libart.so 60\n"
+	"phase bind\n"
+	"read base.apk 40\n"
+	"mmap app.odex 50\n"
+	"mmap libapp.so 40\n"
+	"anon 24M\n"
+	"phase activity\n"
+	"read base.apk 20\n"
+	"anon 16M\n"
+	"sleep 2000\n"
+	"phase draw\n"
+	"anon 8M\n"
+	"mmap libapp.so 20\n"
+	"thaw\n";
+
+typedef enum {
+	APPLAUNCH_OP_MMAP,		/* map a file and touch a share of its pages */
+	APPLAUNCH_OP_READ,		/* pread a share of a file */
+	APPLAUNCH_OP_ANON,		/* grow the anonymous heap */
+	APPLAUNCH_OP_FREEZE,		/* stop the background apps */
+	APPLAUNCH_OP_THAW,		/* continue the background apps */
+	APPLAUNCH_OP_SLEEP,		/* think time in microseconds */
+	APPLAUNCH_OP_PHASE,		/* start of a named launch phase */
+} stress_applaunch_op_type_t;
+
+typedef struct {
+	stress_applaunch_op_type_t type;
+	size_t index;			/* file or phase index */
+	uint64_t arg;			/* percent, bytes or microseconds */
+} stress_applaunch_op_t;
+
+typedef struct {
+	char name[APPLAUNCH_MAX_NAME];
+	uint64_t size;
+	int fd;
+} stress_applaunch_file_t;
+
+typedef struct {
+	stress_applaunch_file_t files[APPLAUNCH_MAX_FILES];
+	stress_applaunch_op_t ops[APPLAUNCH_MAX_OPS];
+	char phases[APPLAUNCH_MAX_PHASES][APPLAUNCH_MAX_NAME];
+	size_t n_files;
+	size_t n_ops;
+	size_t n_phases;
+} stress_applaunch_trace_t;
+
+typedef struct {
+	void *addr;
+	size_t len;
+} stress_applaunch_map_t;
+
+/*
+ *  stress_applaunch_file_index()
+ *	index of a declared file, or -1 if it was not declared
+ */
+static int stress_applaunch_file_index(const stress_applaunch_trace_t *trace, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < trace->n_files; i++) {
+		if (!strcmp(trace->files[i].name, name))
+			return (int)i;
+	}
+	return -1;
+}
+
+/*
+ *  stress_applaunch_parse()
+ *	parse a launch trace, one operation per line:
+ *	  file NAME SIZE, mmap NAME PERCENT, read NAME PERCENT,
+ *	  anon SIZE, freeze, thaw, sleep USECS, phase NAME
+ *	blank lines and lines starting with # are ignored
+ */
+static int stress_applaunch_parse(const char *text, const char *src, stress_applaunch_trace_t *trace)
+{
+	char *str, *line, *save = NULL;
+	int lineno = 0;
+
+	(void)memset(trace, 0, sizeof(*trace));
+	str = stress_const_optdup(text);
+	if (!str)
+		return -1;
+
+	for (line = strtok_r(str, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		char op[16], name[APPLAUNCH_MAX_NAME], arg[32];
+		stress_applaunch_op_t *o = &trace->ops[trace->n_ops];
+		const char *ptr;
+		int n, idx;
+
+		/* strtok_r skips blank lines, so count the newlines before here */
+		for (lineno = 1, ptr = str; ptr < line; ptr++)
+			lineno += ((*ptr == '\n') || (*ptr == '\0'));
+		line += strspn(line, " \t");
+		if ((*line == '#') || (*line == '\0'))
+			continue;
+		*name = '\0';
+		*arg = '\0';
+		n = sscanf(line, "%15s %31s %31s", op, name, arg);
+		if (n < 1)
+			continue;
+
+		if (!strcmp(op, "file")) {
+			stress_applaunch_file_t *f = &trace->files[trace->n_files];
+
+			if (n != 3)
+				goto bad_line;
+			if (trace->n_files >= APPLAUNCH_MAX_FILES) {
+				(void)fprintf(stderr, "%s: line %d: more than %d files\n",
+					src, lineno, APPLAUNCH_MAX_FILES);
+				goto err;
+			}
+			if (stress_applaunch_file_index(trace, name) >= 0) {
+				(void)fprintf(stderr, "%s: line %d: file %s declared twice\n",
+					src, lineno, name);
+				goto err;
+			}
+			(void)shim_strlcpy(f->name, name, sizeof(f->name));
+			f->size = stress_get_uint64_byte(arg);
+			if (f->size < APPLAUNCH_CHUNK) {
+				(void)fprintf(stderr, "%s: line %d: file %s must be at least 64K\n",
+					src, lineno, name);
+				goto err;
+			}
+			f->fd = -1;
+			trace->n_files++;
+			continue;
+		}
+
+		if (trace->n_ops >= APPLAUNCH_MAX_OPS) {
+			(void)fprintf(stderr, "%s: line %d: more than %d operations\n",
+				src, lineno, APPLAUNCH_MAX_OPS);
+			goto err;
+		}
+		if (!strcmp(op, "mmap") || !strcmp(op, "read")) {
+			if (n != 3)
+				goto bad_line;
+			idx = stress_applaunch_file_index(trace, name);
+			if (idx < 0) {
+				(void)fprintf(stderr, "%s: line %d: file %s is not declared\n",
+					src, lineno, name);
+				goto err;
+			}
+			o->type = (*op == 'm') ? APPLAUNCH_OP_MMAP : APPLAUNCH_OP_READ;
+			o->index = (size_t)idx;
+			o->arg = stress_get_uint64(arg);
+			stress_check_range("applaunch-trace percent", o->arg, 1, 100);
+		} else if (!strcmp(op, "anon")) {
+			if (n != 2)
+				goto bad_line;
+			o->type = APPLAUNCH_OP_ANON;
+			o->arg = stress_get_uint64_byte(name);
+			stress_check_range_bytes("applaunch-trace anon", o->arg, 4 * KB, MAX_MEM_LIMIT);
+		} else if (!strcmp(op, "sleep")) {
+			if (n != 2)
+				goto bad_line;
+			o->type = APPLAUNCH_OP_SLEEP;
+			o->arg = stress_get_uint64(name);
+			stress_check_range("applaunch-trace sleep", o->arg, 0, 10000000);
+		} else if (!strcmp(op, "phase")) {
+			if (n != 2)
+				goto bad_line;
+			if (trace->n_phases >= APPLAUNCH_MAX_PHASES) {
+				(void)fprintf(stderr, "%s: line %d: more than %d phases\n",
+					src, lineno, APPLAUNCH_MAX_PHASES);
+				goto err;
+			}
+			o->type = APPLAUNCH_OP_PHASE;
+			o->index = trace->n_phases;
+			(void)shim_strlcpy(trace->phases[trace->n_phases++], name, APPLAUNCH_MAX_NAME);
+		} else if (!strcmp(op, "freeze") && (n == 1)) {
+			o->type = APPLAUNCH_OP_FREEZE;
+		} else if (!strcmp(op, "thaw") && (n == 1)) {
+			o->type = APPLAUNCH_OP_THAW;
+		} else {
+			goto bad_line;
+		}
+		trace->n_ops++;
+	}
+	free(str);
+	if (!trace->n_ops) {
+		(void)fprintf(stderr, "%s: no launch operations\n", src);
+		return -1;
+	}
+	return 0;
+
+bad_line:
+	(void)fprintf(stderr, "%s: line %d: cannot parse '%s'\n", src, lineno, line);
+err:
+	free(str);
+	return -1;
+}
+
+/*
+ *  stress_applaunch_load()
+ *	read a trace file into buf
+ */
+static int stress_applaunch_load(const char *filename, char *buf, const size_t len)
+{
+	ssize_t ret;
+
+	ret = system_read(filename, buf, len - 1);
+	if (ret < 0) {
+		(void)fprintf(stderr, "applaunch-trace: cannot read %s, errno=%d (%s)\n",
+			filename, (int)-ret, strerror((int)-ret));
+		return -1;
+	}
+	buf[ret] = '\0';
+	return 0;
+}
+
+static int stress_set_applaunch_trace(const char *opt)
+{
+	static char buf[APPLAUNCH_MAX_TRACE];
+	static stress_applaunch_trace_t trace;
+
+	if (stress_applaunch_load(opt, buf, sizeof(buf)) < 0)
+		return -1;
+	if (stress_applaunch_parse(buf, opt, &trace) < 0)
+		return -1;
+	return stress_set_setting("applaunch-trace", TYPE_ID_STR, opt);
+}
+
+static int stress_set_applaunch_bg(const char *opt)
+{
+	uint32_t applaunch_bg;
+
+	applaunch_bg = stress_get_uint32(opt);
+	stress_check_range("applaunch-bg", (uint64_t)applaunch_bg,
+		MIN_APPLAUNCH_BG, MAX_APPLAUNCH_BG);
+	return stress_set_setting("applaunch-bg", TYPE_ID_UINT32, &applaunch_bg);
+}
+
+static int stress_set_applaunch_bg_bytes(const char *opt)
+{
+	size_t applaunch_bg_bytes;
+
+	applaunch_bg_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("applaunch-bg-bytes", applaunch_bg_bytes,
+		MIN_APPLAUNCH_BG_BYTES, MAX_APPLAUNCH_BG_BYTES);
+	return stress_set_setting("applaunch-bg-bytes", TYPE_ID_SIZE_T, &applaunch_bg_bytes);
+}
+
+static int stress_set_applaunch_cold(const char *opt)
+{
+	bool applaunch_cold = true;
+
+	(void)opt;
+	return stress_set_setting("applaunch-cold", TYPE_ID_BOOL, &applaunch_cold);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_applaunch_trace,		stress_set_applaunch_trace },
+	{ OPT_applaunch_bg,		stress_set_applaunch_bg },
+	{ OPT_applaunch_bg_bytes,	stress_set_applaunch_bg_bytes },
+	{ OPT_applaunch_cold,		stress_set_applaunch_cold },
+	{ 0,				NULL }
+};
+
+/*
+ *  stress_applaunch_bg()
+ *	a background app, it populates its heap and then keeps its
+ *	pages recently used so that the launches have to reclaim them
+ */
+static void NORETURN stress_applaunch_bg(const size_t size, const size_t page_size)
+{
+	uint8_t *buf;
+	size_t i, n = 0;
+
+	stress_parent_died_alarm();
+	buf = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		_exit(EXIT_NO_RESOURCE);
+	for (i = 0; i < size; i += page_size)
+		stress_mwc_fill(buf + i, 64);
+	for (;;) {
+		for (i = 0; i < size; i += page_size) {
+			buf[i]++;
+			if (++n >= APPLAUNCH_BG_PAGES) {
+				n = 0;
+				(void)shim_usleep(1000);
+			}
+		}
+	}
+}
+
+/*
+ *  stress_applaunch_signal_bg()
+ *	freeze or thaw the background apps
+ */
+static void stress_applaunch_signal_bg(const pid_t *pids, const uint32_t n, const int sig)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (pids[i] > 0)
+			(void)kill(pids[i], sig);
+	}
+}
+
+/*
+ *  stress_applaunch_files_init()
+ *	create the app files with incompressible contents
+ */
+static int stress_applaunch_files_init(
+	const stress_args_t *args,
+	stress_applaunch_trace_t *trace,
+	uint8_t *chunk)
+{
+	size_t i;
+
+	for (i = 0; i < trace->n_files; i++) {
+		stress_applaunch_file_t *f = &trace->files[i];
+		char filename[PATH_MAX];
+		uint64_t off;
+
+		(void)stress_temp_filename_args(args, filename, sizeof(filename), (uint64_t)i);
+		f->fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (f->fd < 0) {
+			pr_inf_skip("%s: cannot create %s, errno=%d (%s), skipping stressor\n",
+				args->name, filename, errno, strerror(errno));
+			return -1;
+		}
+		(void)unlink(filename);
+		for (off = 0; off < f->size; off += APPLAUNCH_CHUNK) {
+			const size_t len = (f->size - off < APPLAUNCH_CHUNK) ?
+				(size_t)(f->size - off) : APPLAUNCH_CHUNK;
+
+			stress_mwc_fill(chunk, len);
+			if (pwrite(f->fd, chunk, len, (off_t)off) != (ssize_t)len) {
+				pr_inf_skip("%s: cannot write %s, errno=%d (%s), skipping stressor\n",
+					args->name, f->name, errno, strerror(errno));
+				return -1;
+			}
+			if (!keep_stressing_flag())
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_applaunch_touch()
+ *	read a percentage of the pages of a mapping, mostly skipping
+ *	gaps so the faults spread sparsely over it like code does
+ */
+static void stress_applaunch_touch(const uint8_t *addr, const size_t len,
+	const uint64_t percent, const size_t page_size)
+{
+	const size_t pages = len / page_size;
+	const size_t n = (size_t)((pages * percent) / 100);
+	size_t i, page = stress_mwc32() % (pages ? pages : 1);
+	uint64_t sum = 0;
+
+	for (i = 0; i < n; i++) {
+		sum += addr[page * page_size];
+		page += 1 + ((stress_mwc8() & 7) < 5 ? (100 / percent) : 0);
+		if (page >= pages)
+			page -= pages;
+	}
+	stress_uint64_put(sum);
+}
+
+/*
+ *  stress_applaunch_read()
+ *	pread a percentage of a file in random chunks
+ */
+static void stress_applaunch_read(const stress_applaunch_file_t *f,
+	const uint64_t percent, uint8_t *chunk)
+{
+	const uint64_t chunks = f->size / APPLAUNCH_CHUNK;
+	const uint64_t n = (chunks * percent + 99) / 100;
+	uint64_t i;
+
+	for (i = 0; i < n; i++) {
+		const off_t off = (off_t)((stress_mwc64() % chunks) * APPLAUNCH_CHUNK);
+
+		if (pread(f->fd, chunk, APPLAUNCH_CHUNK, off) < 0)
+			break;
+	}
+}
+
+/*
+ *  stress_applaunch_cmp()
+ *	sort doubles in ascending order
+ */
+static int stress_applaunch_cmp(const void *p1, const void *p2)
+{
+	const double d1 = *(const double *)p1;
+	const double d2 = *(const double *)p2;
+
+	if (d1 < d2)
+		return -1;
+	return d1 > d2;
+}
+
+/*
+ *  stress_applaunch()
+ *	replay an app launch trace against background apps and
+ *	report the launch and launch phase latencies
+ */
+static int stress_applaunch(const stress_args_t *args)
+{
+	const size_t page_size = args->page_size;
+	static char buf[APPLAUNCH_MAX_TRACE];
+	static stress_applaunch_trace_t trace;
+	stress_applaunch_map_t maps[APPLAUNCH_MAX_OPS];
+	double phase_sum[APPLAUNCH_MAX_PHASES], *samples;
+	uint64_t majflt = 0, minflt = 0, launches = 0;
+	uint32_t applaunch_bg = DEFAULT_APPLAUNCH_BG, i;
+	size_t applaunch_bg_bytes = DEFAULT_APPLAUNCH_BG_BYTES, bg_size;
+	char *trace_file = NULL;
+	bool applaunch_cold = false, frozen = false;
+	pid_t *pids = NULL;
+	uint8_t *chunk;
+	int rc = EXIT_SUCCESS, ret, status;
+
+	(void)stress_get_setting("applaunch-trace", &trace_file);
+	(void)stress_get_setting("applaunch-bg", &applaunch_bg);
+	(void)stress_get_setting("applaunch-bg-bytes", &applaunch_bg_bytes);
+	(void)stress_get_setting("applaunch-cold", &applaunch_cold);
+
+	if (trace_file) {
+		if ((stress_applaunch_load(trace_file, buf, sizeof(buf)) < 0) ||
+		    (stress_applaunch_parse(buf, trace_file, &trace) < 0))
+			return EXIT_FAILURE;
+	} else if (stress_applaunch_parse(applaunch_default_trace, "built-in trace", &trace) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	bg_size = applaunch_bg ? (applaunch_bg_bytes / args->num_instances) / applaunch_bg : 0;
+	bg_size &= ~(page_size - 1);
+	if (applaunch_bg && !bg_size)
+		bg_size = page_size;
+
+	samples = calloc(APPLAUNCH_MAX_SAMPLES, sizeof(*samples));
+	if (!samples) {
+		pr_inf_skip("%s: cannot allocate latency samples, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	chunk = (uint8_t *)mmap(NULL, APPLAUNCH_CHUNK, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (chunk == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap read buffer, skipping stressor\n", args->name);
+		free(samples);
+		return EXIT_NO_RESOURCE;
+	}
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = exit_status(-ret);
+		goto err_chunk;
+	}
+	if (stress_applaunch_files_init(args, &trace, chunk) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto err_files;
+	}
+
+	if (applaunch_bg) {
+		pids = calloc(applaunch_bg, sizeof(*pids));
+		if (!pids) {
+			pr_inf_skip("%s: cannot allocate background pids, skipping stressor\n",
+				args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto err_files;
+		}
+	}
+	for (i = 0; i < applaunch_bg; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0)
+			stress_applaunch_bg(bg_size, page_size);
+		else if (pids[i] < 0)
+			pr_inf("%s: cannot fork background app %" PRIu32 ", errno=%d (%s)\n",
+				args->name, i, errno, strerror(errno));
+	}
+
+	(void)memset(phase_sum, 0, sizeof(phase_sum));
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		struct rusage ru_start, ru_end;
+		double t_start, t_phase, t_end;
+		size_t n_maps = 0, phase = 0, j, k;
+		bool in_phase = false;
+
+		if (applaunch_cold) {
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+			for (j = 0; j < trace.n_files; j++)
+				(void)posix_fadvise(trace.files[j].fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+		}
+
+		(void)getrusage(RUSAGE_SELF, &ru_start);
+		t_start = t_phase = stress_time_now();
+		for (j = 0; keep_stressing_flag() && (j < trace.n_ops); j++) {
+			const stress_applaunch_op_t *o = &trace.ops[j];
+			const stress_applaunch_file_t *f = &trace.files[o->index];
+			void *addr;
+			double t;
+
+			switch (o->type) {
+			case APPLAUNCH_OP_MMAP:
+				addr = mmap(NULL, (size_t)f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+				if (addr == MAP_FAILED)
+					break;
+				maps[n_maps].addr = addr;
+				maps[n_maps++].len = (size_t)f->size;
+				stress_applaunch_touch((uint8_t *)addr, (size_t)f->size, o->arg, page_size);
+				break;
+			case APPLAUNCH_OP_READ:
+				stress_applaunch_read(f, o->arg, chunk);
+				break;
+			case APPLAUNCH_OP_ANON:
+				addr = mmap(NULL, (size_t)o->arg, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (addr == MAP_FAILED)
+					break;
+				maps[n_maps].addr = addr;
+				maps[n_maps++].len = (size_t)o->arg;
+				(void)memset(addr, 0x5a, (size_t)o->arg);
+				break;
+			case APPLAUNCH_OP_FREEZE:
+				stress_applaunch_signal_bg(pids, applaunch_bg, SIGSTOP);
+				frozen = true;
+				break;
+			case APPLAUNCH_OP_THAW:
+				stress_applaunch_signal_bg(pids, applaunch_bg, SIGCONT);
+				frozen = false;
+				break;
+			case APPLAUNCH_OP_SLEEP:
+				(void)shim_usleep(o->arg);
+				break;
+			case APPLAUNCH_OP_PHASE:
+				t = stress_time_now();
+				if (in_phase)
+					phase_sum[phase] += t - t_phase;
+				phase = o->index;
+				in_phase = true;
+				t_phase = t;
+				break;
+			}
+		}
+		t_end = stress_time_now();
+		(void)getrusage(RUSAGE_SELF, &ru_end);
+		if (in_phase)
+			phase_sum[phase] += t_end - t_phase;
+
+		/* the app is killed, its mappings go and the cached apps thaw */
+		for (k = 0; k < n_maps; k++)
+			(void)munmap(maps[k].addr, maps[k].len);
+		if (frozen) {
+			stress_applaunch_signal_bg(pids, applaunch_bg, SIGCONT);
+			frozen = false;
+		}
+		if (j < trace.n_ops)
+			break;
+
+		samples[launches % APPLAUNCH_MAX_SAMPLES] = t_end - t_start;
+		majflt += (uint64_t)(ru_end.ru_majflt - ru_start.ru_majflt);
+		minflt += (uint64_t)(ru_end.ru_minflt - ru_start.ru_minflt);
+		launches++;
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (launches) {
+		const size_t n = (launches < APPLAUNCH_MAX_SAMPLES) ?
+			(size_t)launches : APPLAUNCH_MAX_SAMPLES;
+		double sum = 0.0;
+		size_t j, idx = 0;
+
+		for (j = 0; j < n; j++)
+			sum += samples[j];
+		qsort(samples, n, sizeof(*samples), stress_applaunch_cmp);
+
+		stress_misc_stats_set(args->misc_stats, idx++, "launch mean ms",
+			1000.0 * sum / (double)n);
+		stress_misc_stats_set(args->misc_stats, idx++, "launch p90 ms",
+			1000.0 * samples[(n * 90) / 100]);
+		stress_misc_stats_set(args->misc_stats, idx++, "major faults per launch",
+			(double)majflt / (double)launches);
+		for (j = 0; (j < trace.n_phases) && (idx < 10); j++) {
+			char desc[64];
+
+			(void)snprintf(desc, sizeof(desc), "%s phase mean ms", trace.phases[j]);
+			stress_misc_stats_set(args->misc_stats, idx++, desc,
+				1000.0 * phase_sum[j] / (double)launches);
+		}
+
+		if (args->instance == 0) {
+			bool lock = false;
+
+			pr_lock(&lock);
+			pr_inf_lock(&lock, "%s: %" PRIu64 " launches, %" PRIu32 " background apps of %zuK, %s page cache\n",
+				args->name, launches, applaunch_bg, (size_t)(bg_size / KB),
+				applaunch_cold ? "cold" : "warm");
+			pr_inf_lock(&lock, "%s: launch latency mean %.2f ms, p50 %.2f ms, p90 %.2f ms, "
+				"p99 %.2f ms, max %.2f ms\n", args->name,
+				1000.0 * sum / (double)n, 1000.0 * samples[n / 2],
+				1000.0 * samples[(n * 90) / 100], 1000.0 * samples[(n * 99) / 100],
+				1000.0 * samples[n - 1]);
+			pr_inf_lock(&lock, "%s: %.1f major and %.1f minor page faults per launch\n",
+				args->name, (double)majflt / (double)launches,
+				(double)minflt / (double)launches);
+			for (j = 0; j < trace.n_phases; j++) {
+				pr_inf_lock(&lock, "%s: %-12s phase mean %.2f ms\n", args->name,
+					trace.phases[j], 1000.0 * phase_sum[j] / (double)launches);
+			}
+			pr_unlock(&lock);
+		}
+	}
+
+	stress_applaunch_signal_bg(pids, applaunch_bg, SIGKILL);
+	for (i = 0; i < applaunch_bg; i++) {
+		if (pids[i] > 0)
+			(void)shim_waitpid(pids[i], &status, 0);
+	}
+	free(pids);
+err_files:
+	for (i = 0; i < trace.n_files; i++) {
+		if (trace.files[i].fd >= 0)
+			(void)close(trace.files[i].fd);
+	}
+	(void)stress_temp_dir_rm_args(args);
+err_chunk:
+	(void)munmap((void *)chunk, APPLAUNCH_CHUNK);
+	free(samples);
+	return rc;
+}
+
+stressor_info_t stress_applaunch_info = {
+	.stressor = stress_applaunch,
+	.class = CLASS_MEMORY | CLASS_VM | CLASS_IO,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
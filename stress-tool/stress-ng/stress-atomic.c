@@ -203,9 +203,116 @@ do {								\
 static const stress_help_t help[] = {
 	{ NULL,	"atomic",	"start N workers exercising GCC atomic operations" },
 	{ NULL, "atomic-ops",	"stop after N bogo atomic bogo operations" },
+	{ NULL, "atomic-bench",	"measure atomic op rates by thread count and placement" },
+	{ NULL, "atomic-layout L", "bench layout [shared|line|padded|all]" },
+	{ NULL, "atomic-placement P", "bench placement [same-core|llc|cross-socket|all]" },
+	{ NULL, "atomic-threads N", "bench up to N threads per op (default online CPUs)" },
 	{ NULL, NULL,		NULL }
 };
 
+#define ATOMIC_LAYOUT_SHARED	(0)	/* all threads on one word */
+#define ATOMIC_LAYOUT_LINE	(1)	/* own word, one cache line */
+#define ATOMIC_LAYOUT_PADDED	(2)	/* own word, own cache line */
+#define ATOMIC_LAYOUTS		(3)
+
+#define ATOMIC_PLACE_SAME_CORE	(0)
+#define ATOMIC_PLACE_LLC	(1)
+#define ATOMIC_PLACE_CROSS	(2)
+#define ATOMIC_PLACES		(3)
+
+#define ATOMIC_THREADS_MAX	(64)
+#define ATOMIC_STEPS		(7)	/* 1, 2, 4 .. 64 threads */
+#define ATOMIC_CELL_TIME	(0.05)	/* seconds per op, layout, placement, threads */
+#define ATOMIC_LOOPS		(256)	/* ops per stop flag check */
+#define ATOMIC_LINE		(64)	/* bytes of the line layout */
+#define ATOMIC_PAD		(128)	/* padding, two lines for adjacent line prefetch */
+
+typedef struct {
+	const char *name;
+	const int id;
+} stress_atomic_name_t;
+
+static const stress_atomic_name_t atomic_layouts[] = {
+	{ "shared",		ATOMIC_LAYOUT_SHARED },
+	{ "line",		ATOMIC_LAYOUT_LINE },
+	{ "padded",		ATOMIC_LAYOUT_PADDED },
+};
+
+static const stress_atomic_name_t atomic_places[] = {
+	{ "same-core",		ATOMIC_PLACE_SAME_CORE },
+	{ "llc",		ATOMIC_PLACE_LLC },
+	{ "cross-socket",	ATOMIC_PLACE_CROSS },
+};
+
+static int stress_set_atomic_bench(const char *opt)
+{
+	bool atomic_bench = true;
+
+	(void)opt;
+	return stress_set_setting("atomic-bench", TYPE_ID_BOOL, &atomic_bench);
+}
+
+/*
+ *  stress_set_atomic_mask()
+ *	set a mask of the bench layouts or placements from
+ *	a name or all
+ */
+static int stress_set_atomic_mask(
+	const char *opt,
+	const char *setting,
+	const stress_atomic_name_t *names,
+	const size_t n)
+{
+	uint32_t mask = 0;
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		mask = (1U << n) - 1;
+	} else {
+		for (i = 0; i < n; i++) {
+			if (!strcmp(opt, names[i].name))
+				mask = 1U << names[i].id;
+		}
+	}
+	if (mask)
+		return stress_set_setting(setting, TYPE_ID_UINT32, &mask);
+
+	(void)fprintf(stderr, "%s must be one of:", setting);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i].name);
+	(void)fprintf(stderr, " all\n");
+	return -1;
+}
+
+static int stress_set_atomic_layout(const char *opt)
+{
+	return stress_set_atomic_mask(opt, "atomic-layout",
+		atomic_layouts, SIZEOF_ARRAY(atomic_layouts));
+}
+
+static int stress_set_atomic_placement(const char *opt)
+{
+	return stress_set_atomic_mask(opt, "atomic-placement",
+		atomic_places, SIZEOF_ARRAY(atomic_places));
+}
+
+static int stress_set_atomic_threads(const char *opt)
+{
+	uint32_t atomic_threads;
+
+	atomic_threads = stress_get_uint32(opt);
+	stress_check_range("atomic-threads", atomic_threads, 1, ATOMIC_THREADS_MAX);
+	return stress_set_setting("atomic-threads", TYPE_ID_UINT32, &atomic_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_atomic_bench,	stress_set_atomic_bench },
+	{ OPT_atomic_layout,	stress_set_atomic_layout },
+	{ OPT_atomic_placement,	stress_set_atomic_placement },
+	{ OPT_atomic_threads,	stress_set_atomic_threads },
+	{ 0,			NULL }
+};
+
 #if defined(HAVE_ATOMIC_OPS)
 
 #if defined(__sh__)
@@ -252,6 +359,462 @@ static void stress_atomic_exercise(const stress_args_t *args)
 	} while (keep_stressing(args));
 }
 
+#if defined(__linux__) &&		\
+    defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_AFFINITY) &&		\
+    defined(HAVE_ATOMIC) &&		\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_ATOMIC_BENCH
+
+typedef uint64_t (*stress_atomic_op_func_t)(uint64_t *ptr);
+
+typedef struct {
+	const char *name;
+	const stress_atomic_op_func_t func;
+	const bool metric;	/* report as a misc metric */
+} stress_atomic_op_t;
+
+#define STRESS_ATOMIC_OP_LOAD(name, order)			\
+static uint64_t OPTIMIZE3 name(uint64_t *ptr)			\
+{								\
+	register uint64_t sum = 0;				\
+	register int i;						\
+								\
+	for (i = 0; i < ATOMIC_LOOPS; i++)			\
+		sum += __atomic_load_n(ptr, order);		\
+	return sum;						\
+}
+
+#define STRESS_ATOMIC_OP_STORE(name, order)			\
+static uint64_t OPTIMIZE3 name(uint64_t *ptr)			\
+{								\
+	register int i;						\
+								\
+	for (i = 0; i < ATOMIC_LOOPS; i++)			\
+		__atomic_store_n(ptr, (uint64_t)i, order);	\
+	return 0;						\
+}
+
+#define STRESS_ATOMIC_OP_FETCH_ADD(name, order)			\
+static uint64_t OPTIMIZE3 name(uint64_t *ptr)			\
+{								\
+	register uint64_t sum = 0;				\
+	register int i;						\
+								\
+	for (i = 0; i < ATOMIC_LOOPS; i++)			\
+		sum += __atomic_fetch_add(ptr, 1, order);	\
+	return sum;						\
+}
+
+#define STRESS_ATOMIC_OP_EXCHANGE(name, order)			\
+static uint64_t OPTIMIZE3 name(uint64_t *ptr)			\
+{								\
+	register uint64_t sum = 0;				\
+	register int i;						\
+								\
+	for (i = 0; i < ATOMIC_LOOPS; i++)			\
+		sum += __atomic_exchange_n(ptr, (uint64_t)i, order); \
+	return sum;						\
+}
+
+/* increment by compare and swap, a failed swap reloads expected */
+#define STRESS_ATOMIC_OP_CAS(name, order)			\
+static uint64_t OPTIMIZE3 name(uint64_t *ptr)			\
+{								\
+	uint64_t expected = __atomic_load_n(ptr, __ATOMIC_RELAXED); \
+	register uint64_t fails = 0;				\
+	register int i;						\
+								\
+	for (i = 0; i < ATOMIC_LOOPS; i++)			\
+		fails += !__atomic_compare_exchange_n(ptr, &expected, \
+			expected + 1, false, order, __ATOMIC_RELAXED); \
+	return fails;						\
+}
+
+STRESS_ATOMIC_OP_LOAD(stress_atomic_load_relaxed, __ATOMIC_RELAXED)
+STRESS_ATOMIC_OP_LOAD(stress_atomic_load_acquire, __ATOMIC_ACQUIRE)
+STRESS_ATOMIC_OP_LOAD(stress_atomic_load_seq_cst, __ATOMIC_SEQ_CST)
+STRESS_ATOMIC_OP_STORE(stress_atomic_store_relaxed, __ATOMIC_RELAXED)
+STRESS_ATOMIC_OP_STORE(stress_atomic_store_release, __ATOMIC_RELEASE)
+STRESS_ATOMIC_OP_STORE(stress_atomic_store_seq_cst, __ATOMIC_SEQ_CST)
+STRESS_ATOMIC_OP_FETCH_ADD(stress_atomic_fetch_add_relaxed, __ATOMIC_RELAXED)
+STRESS_ATOMIC_OP_FETCH_ADD(stress_atomic_fetch_add_acq_rel, __ATOMIC_ACQ_REL)
+STRESS_ATOMIC_OP_FETCH_ADD(stress_atomic_fetch_add_seq_cst, __ATOMIC_SEQ_CST)
+STRESS_ATOMIC_OP_EXCHANGE(stress_atomic_exchange_relaxed, __ATOMIC_RELAXED)
+STRESS_ATOMIC_OP_EXCHANGE(stress_atomic_exchange_seq_cst, __ATOMIC_SEQ_CST)
+STRESS_ATOMIC_OP_CAS(stress_atomic_cas_relaxed, __ATOMIC_RELAXED)
+STRESS_ATOMIC_OP_CAS(stress_atomic_cas_seq_cst, __ATOMIC_SEQ_CST)
+
+static const stress_atomic_op_t atomic_ops[] = {
+	{ "load-relaxed",	stress_atomic_load_relaxed,		false },
+	{ "load-acquire",	stress_atomic_load_acquire,		true },
+	{ "load-seq-cst",	stress_atomic_load_seq_cst,		false },
+	{ "store-relaxed",	stress_atomic_store_relaxed,		false },
+	{ "store-release",	stress_atomic_store_release,		true },
+	{ "store-seq-cst",	stress_atomic_store_seq_cst,		false },
+	{ "fetch-add-relaxed",	stress_atomic_fetch_add_relaxed,	false },
+	{ "fetch-add-acq-rel",	stress_atomic_fetch_add_acq_rel,	false },
+	{ "fetch-add-seq-cst",	stress_atomic_fetch_add_seq_cst,	true },
+	{ "exchange-relaxed",	stress_atomic_exchange_relaxed,		false },
+	{ "exchange-seq-cst",	stress_atomic_exchange_seq_cst,		true },
+	{ "cas-relaxed",	stress_atomic_cas_relaxed,		false },
+	{ "cas-seq-cst",	stress_atomic_cas_seq_cst,		true },
+};
+
+/* One op, layout, placement and thread count of the bench */
+typedef struct {
+	const stress_atomic_op_t *op;
+	volatile bool start;
+	volatile bool stop;
+	uint32_t ready;		/* threads waiting for start */
+} stress_atomic_cell_t;
+
+typedef struct {
+	stress_atomic_cell_t *cell;
+	const stress_args_t *args;
+	pthread_t pthread;
+	int ret;		/* pthread_create return */
+	int32_t cpu;		/* CPU to bind to */
+	uint64_t *ptr;		/* atomic variable */
+	uint64_t ops;
+} stress_atomic_thread_t;
+
+/*
+ *  stress_atomic_bench_thread()
+ *	bind to a CPU, wait for the start flag and then hammer the
+ *	atomic variable with the op until the stop flag is set
+ */
+static void *stress_atomic_bench_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_atomic_thread_t *t = (stress_atomic_thread_t *)arg;
+	stress_atomic_cell_t *cell = t->cell;
+	const stress_atomic_op_func_t func = cell->op->func;
+	uint64_t ops = 0, sum = 0;
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(t->cpu, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+		pr_dbg("%s: cannot set atomic thread affinity, errno=%d (%s)\n",
+			t->args->name, errno, strerror(errno));
+
+	(void)__atomic_fetch_add(&cell->ready, 1, __ATOMIC_RELEASE);
+	while (!cell->start && !cell->stop)
+		(void)shim_sched_yield();
+
+	while (!cell->stop) {
+		sum += func(t->ptr);
+		ops += ATOMIC_LOOPS;
+	}
+	t->ops = ops;
+	stress_uint64_put(sum);
+
+	return &nowt;
+}
+
+/*
+ *  stress_atomic_bench_cell()
+ *	run n threads of an op on the CPUs for ATOMIC_CELL_TIME
+ *	seconds, returns the total ops, 0 if no thread ran
+ */
+static uint64_t stress_atomic_bench_cell(
+	const stress_args_t *args,
+	const stress_atomic_op_t *op,
+	uint64_t *vars,
+	const int layout,
+	const int32_t *cpus,
+	const int32_t n_cpus,
+	const uint32_t n,
+	double *duration)
+{
+	stress_atomic_thread_t threads[ATOMIC_THREADS_MAX];
+	stress_atomic_cell_t cell;
+	uint64_t ops = 0;
+	uint32_t i, started = 0;
+	double t_start, t_end;
+
+	(void)memset(threads, 0, sizeof(threads));
+	(void)memset(vars, 0, ATOMIC_THREADS_MAX * ATOMIC_PAD);
+	cell.op = op;
+	cell.start = false;
+	cell.stop = false;
+	cell.ready = 0;
+
+	for (i = 0; i < n; i++) {
+		stress_atomic_thread_t *t = &threads[i];
+
+		t->cell = &cell;
+		t->args = args;
+		t->cpu = cpus[i % (uint32_t)n_cpus];
+		switch (layout) {
+		case ATOMIC_LAYOUT_LINE:
+			t->ptr = vars + (i % (ATOMIC_LINE / sizeof(*vars)));
+			break;
+		case ATOMIC_LAYOUT_PADDED:
+			t->ptr = vars + (i * (ATOMIC_PAD / sizeof(*vars)));
+			break;
+		default:
+			t->ptr = vars;
+			break;
+		}
+		t->ret = pthread_create(&t->pthread, NULL, stress_atomic_bench_thread, t);
+		if (t->ret == 0)
+			started++;
+	}
+
+	/* Start everyone together once they are bound to their CPUs */
+	while (keep_stressing_flag() &&
+	       (__atomic_load_n(&cell.ready, __ATOMIC_ACQUIRE) < started))
+		(void)shim_sched_yield();
+	t_start = stress_time_now();
+	cell.start = true;
+	while (keep_stressing_flag() &&
+	       (stress_time_now() - t_start < ATOMIC_CELL_TIME))
+		(void)shim_usleep(10000);
+	cell.stop = true;
+	t_end = stress_time_now();
+
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0) {
+			(void)pthread_join(threads[i].pthread, NULL);
+			ops += threads[i].ops;
+		}
+	}
+	*duration = t_end - t_start;
+
+	return (started == n) ? ops : 0;
+}
+
+/*
+ *  stress_atomic_bench_cpus()
+ *	fill cpus with the allowed CPUs for a placement starting with
+ *	cpu, returns the number of CPUs or 0 if the topology has no
+ *	such placement
+ */
+static int32_t stress_atomic_bench_cpus(
+	const int32_t cpu,
+	const int place,
+	const cpu_set_t *allowed,
+	int32_t *cpus)
+{
+	cpu_set_t llc;
+	int32_t i, n = 0;
+
+	switch (place) {
+	case ATOMIC_PLACE_SAME_CORE:
+		cpus[n++] = cpu;
+		return n;
+	case ATOMIC_PLACE_LLC:
+		if (!stress_topology_llc_list(cpu, &llc))
+			return 0;
+		cpus[n++] = cpu;
+		for (i = 0; (i < CPU_SETSIZE) && (n < ATOMIC_THREADS_MAX); i++) {
+			if ((i != cpu) && CPU_ISSET(i, &llc) && CPU_ISSET(i, allowed))
+				cpus[n++] = i;
+		}
+		return (n > 1) ? n : 0;
+	case ATOMIC_PLACE_CROSS:
+		n = stress_cpus_interleave_packages(allowed, cpus, ATOMIC_THREADS_MAX);
+		if ((n < 2) || (stress_topology_package(cpus[0]) ==
+				stress_topology_package(cpus[1])))
+			return 0;
+		return n;
+	default:
+		return 0;
+	}
+}
+
+/*
+ *  stress_atomic_bench()
+ *	measure the total rate of each atomic op and memory order with
+ *	doubling numbers of threads, all on one word, on words of one
+ *	cache line or on words of their own cache lines, with the
+ *	threads on one CPU, over the CPUs of a last level cache or
+ *	interleaved over the sockets
+ */
+static int stress_atomic_bench(const stress_args_t *args)
+{
+	static uint64_t ops[SIZEOF_ARRAY(atomic_ops)][ATOMIC_LAYOUTS][ATOMIC_PLACES][ATOMIC_STEPS];
+	static double durations[SIZEOF_ARRAY(atomic_ops)][ATOMIC_LAYOUTS][ATOMIC_PLACES][ATOMIC_STEPS];
+	static int32_t cpus[ATOMIC_PLACES][ATOMIC_THREADS_MAX];
+	int32_t n_cpus[ATOMIC_PLACES];
+	uint32_t layout_mask = (1U << ATOMIC_LAYOUTS) - 1;
+	uint32_t place_mask = (1U << ATOMIC_PLACES) - 1;
+	uint32_t atomic_threads, threads[ATOMIC_STEPS];
+	unsigned int cpu = 0, node = 0;
+	size_t o, n_steps = 0, s, idx = 0;
+	int l, p, l_first = -1, p_first = -1;
+	cpu_set_t allowed;
+	uint64_t *vars;
+	bool lock = false;
+
+	(void)stress_get_setting("atomic-layout", &layout_mask);
+	(void)stress_get_setting("atomic-placement", &place_mask);
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_fail("%s: cannot get CPU affinity, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	atomic_threads = (uint32_t)CPU_COUNT(&allowed);
+	if (atomic_threads < 2)
+		atomic_threads = 2;
+	if (atomic_threads > ATOMIC_THREADS_MAX)
+		atomic_threads = ATOMIC_THREADS_MAX;
+	(void)stress_get_setting("atomic-threads", &atomic_threads);
+
+	/* 1, 2, 4 .. threads, ending with atomic_threads */
+	for (s = 1; (s < atomic_threads) && (n_steps < ATOMIC_STEPS - 1); s <<= 1)
+		threads[n_steps++] = (uint32_t)s;
+	threads[n_steps++] = atomic_threads;
+
+	if ((shim_getcpu(&cpu, &node, NULL) < 0) || !CPU_ISSET((int)cpu, &allowed)) {
+		for (cpu = 0; !CPU_ISSET((int)cpu, &allowed); cpu++)
+			;
+	}
+	for (p = 0; p < ATOMIC_PLACES; p++) {
+		n_cpus[p] = 0;
+		if (!(place_mask & (1U << p)))
+			continue;
+		n_cpus[p] = stress_atomic_bench_cpus((int32_t)cpu, p, &allowed, cpus[p]);
+		if (!n_cpus[p]) {
+			place_mask &= ~(1U << p);
+			if (args->instance == 0)
+				pr_dbg("%s: no %s CPUs for CPU %u, skipping placement\n",
+					args->name, atomic_places[p].name, cpu);
+		}
+	}
+	if (!place_mask) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: no CPUs for the atomic bench placements, "
+				"skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	vars = (uint64_t *)mmap(NULL, ATOMIC_THREADS_MAX * ATOMIC_PAD,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (vars == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap atomic variables, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(ops, 0, sizeof(ops));
+	(void)memset(durations, 0, sizeof(durations));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	/* Sweep all the cells until the run ends */
+	do {
+		for (l = 0; l < ATOMIC_LAYOUTS; l++) {
+			if (!(layout_mask & (1U << l)))
+				continue;
+			for (p = 0; p < ATOMIC_PLACES; p++) {
+				if (!n_cpus[p])
+					continue;
+				for (s = 0; s < n_steps; s++) {
+					for (o = 0; keep_stressing(args) && (o < SIZEOF_ARRAY(atomic_ops)); o++) {
+						double duration = 0.0;
+						uint64_t n;
+
+						n = stress_atomic_bench_cell(args, &atomic_ops[o], vars,
+							l, cpus[p], n_cpus[p], threads[s], &duration);
+						if (!n)
+							continue;
+						ops[o][l][p][s] += n;
+						durations[o][l][p][s] += duration;
+						inc_counter(args);
+					}
+				}
+			}
+		}
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	(void)munmap((void *)vars, ATOMIC_THREADS_MAX * ATOMIC_PAD);
+
+	/* Total Mops/s of all threads, one table per layout and placement */
+	pr_lock(&lock);
+	for (l = 0; l < ATOMIC_LAYOUTS; l++) {
+		for (p = 0; p < ATOMIC_PLACES; p++) {
+			char line[256];
+			size_t pos;
+			bool measured = false;
+
+			for (o = 0; o < SIZEOF_ARRAY(atomic_ops); o++)
+				measured |= (durations[o][l][p][0] > 0.0);
+			if (!measured)
+				continue;
+			if (l_first < 0) {
+				l_first = l;
+				p_first = p;
+			}
+			if (args->instance != 0)
+				continue;
+			pr_inf_lock(&lock, "%s: atomic Mops/s by threads, %s layout, "
+				"%s placement over %" PRId32 " CPU(s)\n", args->name,
+				atomic_layouts[l].name, atomic_places[p].name, n_cpus[p]);
+			pos = (size_t)snprintf(line, sizeof(line), "%-17s", "op");
+			for (s = 0; s < n_steps; s++)
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos,
+					" %8" PRIu32, threads[s]);
+			(void)snprintf(line + pos, sizeof(line) - pos, " %8s", "scaling");
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+			for (o = 0; o < SIZEOF_ARRAY(atomic_ops); o++) {
+				double first = 0.0, last = 0.0;
+
+				pos = (size_t)snprintf(line, sizeof(line), "%-17s", atomic_ops[o].name);
+				for (s = 0; s < n_steps; s++) {
+					const double d = durations[o][l][p][s];
+					const double rate = (d > 0.0) ? (double)ops[o][l][p][s] / d / 1.0E6 : 0.0;
+
+					if (d > 0.0)
+						pos += (size_t)snprintf(line + pos, sizeof(line) - pos,
+							" %8.2f", rate);
+					else
+						pos += (size_t)snprintf(line + pos, sizeof(line) - pos,
+							" %8s", "n/a");
+					if (s == 0)
+						first = rate;
+					last = rate;
+				}
+				/* rate of the most threads over one thread */
+				if ((first > 0.0) && (last > 0.0))
+					(void)snprintf(line + pos, sizeof(line) - pos, " %7.2fx", last / first);
+				else
+					(void)snprintf(line + pos, sizeof(line) - pos, " %8s", "n/a");
+				pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+			}
+		}
+	}
+	pr_unlock(&lock);
+
+	/* Single and most threads rates of the first layout and placement */
+	for (o = 0; (l_first >= 0) && (o < SIZEOF_ARRAY(atomic_ops)); o++) {
+		const size_t steps[2] = { 0, n_steps - 1 };
+		size_t i;
+
+		if (!atomic_ops[o].metric)
+			continue;
+		for (i = 0; (i < SIZEOF_ARRAY(steps)) && (idx < STRESS_MISC_STATS_MAX); i++) {
+			const double d = durations[o][l_first][p_first][steps[i]];
+			char name[64];
+
+			if (d <= 0.0)
+				continue;
+			(void)snprintf(name, sizeof(name), "%s Mops/s x%" PRIu32,
+				atomic_ops[o].name, threads[steps[i]]);
+			stress_misc_stats_set(args->misc_stats, idx++, name,
+				(double)ops[o][l_first][p_first][steps[i]] / d / 1.0E6);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_atomic()
  *      stress gcc atomic memory ops
@@ -260,6 +823,19 @@ static int stress_atomic(const stress_args_t *args)
 {
 	pid_t pids[STRESS_ATOMIC_MAX_PROCS];
 	size_t i;
+	bool atomic_bench = false;
+
+	(void)stress_get_setting("atomic-bench", &atomic_bench);
+	if (atomic_bench) {
+#if defined(STRESS_ATOMIC_BENCH)
+		return stress_atomic_bench(args);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --atomic-bench needs pthreads and CPU "
+				"affinity, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
 
 	for (i = 0; i < STRESS_ATOMIC_MAX_PROCS; i++)
 		pids[i] = -1;
@@ -294,6 +870,7 @@ static int stress_atomic(const stress_args_t *args)
 stressor_info_t stress_atomic_info = {
 	.stressor = stress_atomic,
 	.class = CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 
@@ -301,6 +878,7 @@ stressor_info_t stress_atomic_info = {
 stressor_info_t stress_atomic_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
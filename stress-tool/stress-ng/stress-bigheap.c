@@ -28,9 +28,71 @@ static const stress_help_t help[] = {
 	{ "B N","bigheap N",		"start N workers that grow the heap using calloc()" },
 	{ NULL,	"bigheap-ops N",	"stop after N bogo bigheap operations" },
 	{ NULL,	"bigheap-growth N",	"grow heap by N bytes per iteration" },
+	{ NULL,	"bigheap-method M",	"grow with realloc, heap, mmap or thp" },
 	{ NULL,	NULL,			NULL }
 };
 
+#define BIGHEAP_METHOD_REALLOC	(0)	/* libc defaults */
+#define BIGHEAP_METHOD_HEAP	(1)	/* maximum mmap threshold, grow the brk heap */
+#define BIGHEAP_METHOD_MMAP	(2)	/* page sized mmap threshold, grow by mremap */
+#define BIGHEAP_METHOD_THP	(3)	/* libc defaults, MADV_HUGEPAGE the heap */
+
+static const char * const bigheap_methods[] = {
+	"realloc",
+	"heap",
+	"mmap",
+	"thp",
+};
+
+#define BIGHEAP_LAT_SUB		(4)	/* histogram buckets per power of 2 */
+#define BIGHEAP_LAT_BUCKETS	(64 * BIGHEAP_LAT_SUB)
+#define BIGHEAP_SAMPLE		(0.1)	/* seconds between RSS samples */
+#define BIGHEAP_HUGE_SAMPLE	(1.0)	/* seconds between THP samples */
+
+#define BIGHEAP_GROW_INPLACE	(0)	/* heap chunk extended in place */
+#define BIGHEAP_GROW_MREMAP	(1)	/* mmap'd chunk grown in place by mremap */
+#define BIGHEAP_GROW_MOVE	(2)	/* mmap'd chunk moved by mremap */
+#define BIGHEAP_GROW_COPY	(3)	/* moved by malloc, copy and free */
+#define BIGHEAP_GROW_MAX	(4)
+
+static const char * const bigheap_grow_names[] = {
+	"in place",
+	"mremap",
+	"mremap move",
+	"copy",
+};
+
+/* realloc latency of one kind of growth */
+typedef struct {
+	uint64_t lat[BIGHEAP_LAT_BUCKETS];	/* latency histogram, ns */
+	uint64_t count;
+	uint64_t max;
+	double total;			/* total latency, ns */
+} stress_bigheap_lat_t;
+
+/*
+ *  growth measurements of the heap, shared with the oomable child
+ *  so that they survive the child being killed by the OOM killer
+ */
+typedef struct {
+	stress_bigheap_lat_t grow[BIGHEAP_GROW_MAX];
+	stress_bigheap_lat_t all;
+	double rss_grown;		/* RSS growth over all samples, bytes */
+	double grown;			/* bytes of heap growth touched */
+	double faults;			/* minor and major page faults */
+	double huge;			/* last sampled THP backed fraction */
+	size_t rss_max;			/* peak sampled RSS, bytes */
+	uint64_t starts;		/* heaps started from empty */
+} stress_bigheap_stats_t;
+
+/* sampling state of the child */
+typedef struct {
+	double t_sample;		/* time of the last RSS sample */
+	double t_huge;			/* time of the last THP sample */
+	size_t rss_last;		/* last sampled RSS, bytes */
+	struct rusage usage;		/* usage at the last sample */
+} stress_bigheap_sampler_t;
+
 /*
  *  stress_set_bigheap_growth()
  *  	Set bigheap growth from given opt arg string
@@ -45,6 +107,306 @@ static int stress_set_bigheap_growth(const char *opt)
 	return stress_set_setting("bigheap-growth", TYPE_ID_UINT64, &bigheap_growth);
 }
 
+/*
+ *  stress_set_bigheap_method()
+ *	set the heap growth method
+ */
+static int stress_set_bigheap_method(const char *opt)
+{
+	int bigheap_method;
+
+	for (bigheap_method = 0; bigheap_method < (int)SIZEOF_ARRAY(bigheap_methods); bigheap_method++) {
+		if (!strcmp(opt, bigheap_methods[bigheap_method]))
+			return stress_set_setting("bigheap-method", TYPE_ID_INT, &bigheap_method);
+	}
+	(void)fprintf(stderr, "bigheap-method must be one of:");
+	for (bigheap_method = 0; bigheap_method < (int)SIZEOF_ARRAY(bigheap_methods); bigheap_method++)
+		(void)fprintf(stderr, " %s", bigheap_methods[bigheap_method]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_bigheap_lat_add()
+ *	add a latency in nanoseconds to a log2 histogram with
+ *	BIGHEAP_LAT_SUB buckets per power of 2
+ */
+static void stress_bigheap_lat_add(stress_bigheap_lat_t *lat, const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0, bucket;
+
+	if (ns < BIGHEAP_LAT_SUB) {
+		bucket = (size_t)ns;
+	} else {
+		for (v = ns; v > 1; v >>= 1)
+			msb++;
+		bucket = ((msb - 1) * BIGHEAP_LAT_SUB) +
+			(size_t)((ns >> (msb - 2)) & (BIGHEAP_LAT_SUB - 1));
+	}
+	lat->lat[bucket]++;
+	lat->count++;
+	lat->total += (double)ns;
+	if (ns > lat->max)
+		lat->max = ns;
+}
+
+/*
+ *  stress_bigheap_percentile()
+ *	latency in microseconds below which pct percent of the samples
+ *	are, the upper bound of the histogram bucket clamped to the maximum
+ */
+static double stress_bigheap_percentile(const stress_bigheap_lat_t *lat, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)lat->count * pct) / 100.0);
+	uint64_t sum = 0, ns;
+	size_t i;
+
+	for (i = 0; i < BIGHEAP_LAT_BUCKETS; i++) {
+		sum += lat->lat[i];
+		if (sum > target)
+			break;
+	}
+	if (i >= BIGHEAP_LAT_BUCKETS)
+		return 0.0;
+	if (i < BIGHEAP_LAT_SUB) {
+		ns = (uint64_t)i;
+	} else {
+		const size_t msb = (i / BIGHEAP_LAT_SUB) + 1;
+		const uint64_t sub = (uint64_t)(i % BIGHEAP_LAT_SUB);
+
+		ns = ((BIGHEAP_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+	}
+	return (double)STRESS_MINIMUM(ns, lat->max) / 1000.0;
+}
+
+static inline double stress_bigheap_mean(const stress_bigheap_lat_t *lat)
+{
+	return lat->count ? (lat->total / (double)lat->count) / 1000.0 : 0.0;
+}
+
+/*
+ *  stress_bigheap_rss()
+ *	get the resident set size of the process in bytes
+ */
+static size_t stress_bigheap_rss(const size_t page_size)
+{
+	char buf[64];
+	unsigned long size, resident;
+
+	if (system_read("/proc/self/statm", buf, sizeof(buf)) <= 0)
+		return 0;
+	if (sscanf(buf, "%lu %lu", &size, &resident) != 2)
+		return 0;
+	return (size_t)resident * page_size;
+}
+
+/*
+ *  stress_bigheap_huge_bytes()
+ *	bytes of the mapping containing addr that are backed by
+ *	transparent huge pages
+ */
+static double stress_bigheap_huge_bytes(const void *addr)
+{
+	FILE *fp;
+	char buf[256];
+	bool found = false;
+	uint64_t kb = 0;
+
+	fp = fopen("/proc/self/smaps", "r");
+	if (!fp)
+		return 0.0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		uintptr_t start, end;
+
+		if (sscanf(buf, "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2) {
+			found = ((uintptr_t)addr >= start) && ((uintptr_t)addr < end);
+			continue;
+		}
+		if (found && !strncmp(buf, "AnonHugePages:", 14)) {
+			(void)sscanf(buf + 14, "%" SCNu64, &kb);
+			break;
+		}
+	}
+	(void)fclose(fp);
+	return (double)kb * (double)KB;
+}
+
+/*
+ *  stress_bigheap_sample()
+ *	sample the RSS and page faults at most every BIGHEAP_SAMPLE
+ *	seconds and the THP backing of the heap every BIGHEAP_HUGE_SAMPLE
+ *	seconds, the RSS drops when the heap is freed so only growth is
+ *	accumulated
+ */
+static void stress_bigheap_sample(
+	stress_bigheap_stats_t *stats,
+	stress_bigheap_sampler_t *sampler,
+	const size_t page_size,
+	const void *ptr,
+	const size_t size,
+	const bool force)
+{
+	const double now = stress_time_now();
+	struct rusage usage;
+	size_t rss;
+
+	if (!force && (now - sampler->t_sample < BIGHEAP_SAMPLE))
+		return;
+	sampler->t_sample = now;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		stats->faults += (double)(usage.ru_minflt - sampler->usage.ru_minflt) +
+				 (double)(usage.ru_majflt - sampler->usage.ru_majflt);
+		sampler->usage = usage;
+	}
+	rss = stress_bigheap_rss(page_size);
+	if (rss > sampler->rss_last)
+		stats->rss_grown += (double)(rss - sampler->rss_last);
+	sampler->rss_last = rss;
+	if (rss > stats->rss_max)
+		stats->rss_max = rss;
+
+	if (ptr && size && (force || (now - sampler->t_huge >= BIGHEAP_HUGE_SAMPLE))) {
+		sampler->t_huge = now;
+		stats->huge = stress_bigheap_huge_bytes(ptr) / (double)size;
+	}
+}
+
+/*
+ *  stress_bigheap_mmapped()
+ *	true if the glibc chunk of ptr is mmap'd, glibc then grows it
+ *	with mremap rather than by malloc, copy and free. This peeks at
+ *	the IS_MMAPPED bit of the chunk size field just before ptr.
+ */
+static inline bool stress_bigheap_mmapped(const void *ptr)
+{
+#if defined(__GLIBC__)
+	const uintptr_t size_field = (uintptr_t)ptr - sizeof(size_t);
+
+	return ptr && (*(const volatile size_t *)size_field & 0x2);
+#else
+	(void)ptr;
+	return false;
+#endif
+}
+
+/*
+ *  stress_bigheap_method()
+ *	tune the allocator for the growth method
+ */
+static void stress_bigheap_method(const stress_args_t *args, const int bigheap_method)
+{
+#if defined(HAVE_MALLOPT) &&	\
+    defined(M_MMAP_THRESHOLD)
+	int threshold;
+
+	switch (bigheap_method) {
+	case BIGHEAP_METHOD_HEAP:
+		/* glibc caps the threshold at 32 MB, 512 KB on 32 bit systems */
+		threshold = (sizeof(long) == 8) ? (int)(32 * MB) : (int)(512 * KB);
+		break;
+	case BIGHEAP_METHOD_MMAP:
+		threshold = (int)args->page_size;
+		break;
+	default:
+		return;
+	}
+	if (!mallopt(M_MMAP_THRESHOLD, threshold) && (args->instance == 0))
+		pr_inf("%s: cannot set the mmap threshold to %d bytes\n",
+			args->name, threshold);
+#else
+	if ((bigheap_method == BIGHEAP_METHOD_HEAP) ||
+	    (bigheap_method == BIGHEAP_METHOD_MMAP)) {
+		if (args->instance == 0)
+			pr_inf("%s: mallopt is not available, using the "
+				"libc defaults\n", args->name);
+	}
+#endif
+}
+
+/*
+ *  stress_bigheap_thp()
+ *	ask for transparent huge pages on the heap
+ */
+static void stress_bigheap_thp(const void *ptr, const size_t size, const size_t page_size)
+{
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
+	/*
+	 *  Cover the pages holding the chunk header too, advising only
+	 *  part of a mmap'd chunk splits its vma and mremap can then no
+	 *  longer grow it in place
+	 */
+	const uintptr_t start = (uintptr_t)ptr & ~(page_size - 1);
+	const uintptr_t end = ((uintptr_t)ptr + size + page_size - 1) & ~(page_size - 1);
+
+	(void)madvise((void *)start, (size_t)(end - start), MADV_HUGEPAGE);
+#else
+	(void)ptr;
+	(void)size;
+	(void)page_size;
+#endif
+}
+
+/*
+ *  stress_bigheap_report()
+ *	report the realloc latency, fault rate and RSS growth
+ */
+static void stress_bigheap_report(
+	const stress_args_t *args,
+	const stress_bigheap_stats_t *stats,
+	const int bigheap_method,
+	const double duration)
+{
+	const double rate = stats->faults / duration;
+	const double per_mb = (stats->grown > 0.0) ?
+		stats->faults / (stats->grown / (double)MB) : 0.0;
+	const double growth = (stats->rss_grown / (double)MB) / duration;
+	bool lock = false;
+	size_t i;
+
+	if (args->instance == 0) {
+		pr_lock(&lock);
+		pr_inf_lock(&lock, "%s: %s method, %" PRIu64 " reallocs, %" PRIu64
+			" heaps, %.2f MB/sec RSS growth, peak RSS %.2f MB\n",
+			args->name, bigheap_methods[bigheap_method], stats->all.count,
+			stats->starts, growth, (double)stats->rss_max / (double)MB);
+		pr_inf_lock(&lock, "%s: %.0f page faults/sec, %.1f faults per MB grown, "
+			"%.1f%% of the heap THP backed\n", args->name, rate, per_mb,
+			100.0 * stats->huge);
+		pr_inf_lock(&lock, "%s: %-11s %9s %10s %10s %10s\n", args->name,
+			"realloc", "count", "mean usec", "p99 usec", "max usec");
+		for (i = 0; i < BIGHEAP_GROW_MAX; i++) {
+			const stress_bigheap_lat_t *lat = &stats->grow[i];
+
+			if (!lat->count)
+				continue;
+			pr_inf_lock(&lock, "%s: %-11s %9" PRIu64 " %10.2f %10.2f %10.2f\n",
+				args->name, bigheap_grow_names[i], lat->count,
+				stress_bigheap_mean(lat), stress_bigheap_percentile(lat, 99.0),
+				(double)lat->max / 1000.0);
+		}
+		pr_unlock(&lock);
+	}
+
+	stress_misc_stats_set(args->misc_stats, 0, "realloc in place mean usec",
+		stress_bigheap_mean(&stats->grow[BIGHEAP_GROW_INPLACE]));
+	stress_misc_stats_set(args->misc_stats, 1, "realloc mremap mean usec",
+		stress_bigheap_mean(&stats->grow[BIGHEAP_GROW_MREMAP]));
+	stress_misc_stats_set(args->misc_stats, 2, "realloc mremap move mean usec",
+		stress_bigheap_mean(&stats->grow[BIGHEAP_GROW_MOVE]));
+	stress_misc_stats_set(args->misc_stats, 3, "realloc copy mean usec",
+		stress_bigheap_mean(&stats->grow[BIGHEAP_GROW_COPY]));
+	stress_misc_stats_set(args->misc_stats, 4, "realloc p99 usec",
+		stress_bigheap_percentile(&stats->all, 99.0));
+	stress_misc_stats_set(args->misc_stats, 5, "page faults per sec", rate);
+	stress_misc_stats_set(args->misc_stats, 6, "page faults per MB grown", per_mb);
+	stress_misc_stats_set(args->misc_stats, 7, "RSS growth MB per sec", growth);
+	stress_misc_stats_set(args->misc_stats, 8, "peak RSS MB",
+		(double)stats->rss_max / (double)MB);
+	stress_misc_stats_set(args->misc_stats, 9, "heap THP backed %", 100.0 * stats->huge);
+}
+
 static int stress_bigheap_child(const stress_args_t *args, void *context)
 {
 	uint64_t bigheap_growth = DEFAULT_BIGHEAP_GROWTH;
@@ -53,8 +415,9 @@ static int stress_bigheap_child(const stress_args_t *args, void *context)
 	const size_t stride = page_size;
 	size_t size = 0;
 	uint8_t *last_ptr_end = NULL;
-
-	(void)context;
+	int bigheap_method = BIGHEAP_METHOD_REALLOC;
+	stress_bigheap_stats_t *stats = (stress_bigheap_stats_t *)context;
+	stress_bigheap_sampler_t sampler;
 
 	if (!stress_get_setting("bigheap-growth", &bigheap_growth)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -68,10 +431,23 @@ static int stress_bigheap_child(const stress_args_t *args, void *context)
 	/* Round growth size to nearest page size */
 	bigheap_growth &= ~(page_size - 1);
 
+	(void)stress_get_setting("bigheap-method", &bigheap_method);
+	stress_bigheap_method(args, bigheap_method);
+
+	(void)memset(&sampler, 0, sizeof(sampler));
+	(void)getrusage(RUSAGE_SELF, &sampler.usage);
+	sampler.rss_last = stress_bigheap_rss(page_size);
+	sampler.t_sample = stress_time_now();
+	sampler.t_huge = sampler.t_sample;
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
 		void *old_ptr = ptr;
+		const bool mmapped = stress_bigheap_mmapped(old_ptr);
+		double t;
+		uint64_t ns;
+
 		size += (size_t)bigheap_growth;
 
 		/*
@@ -84,7 +460,9 @@ static int stress_bigheap_child(const stress_args_t *args, void *context)
 		if (!keep_stressing(args))
 			goto abort;
 
+		t = stress_time_now();
 		ptr = realloc(old_ptr, size);
+		ns = (uint64_t)((stress_time_now() - t) * (double)STRESS_NANOSECOND);
 		if (ptr == NULL) {
 			pr_dbg("%s: out of memory at %" PRIu64
 				" MB (instance %d)\n",
@@ -96,6 +474,21 @@ static int stress_bigheap_child(const stress_args_t *args, void *context)
 			size_t i, n;
 			uint8_t *u8ptr, *tmp;
 
+			if (old_ptr) {
+				int grow;
+
+				if (mmapped)
+					grow = (ptr == old_ptr) ? BIGHEAP_GROW_MREMAP : BIGHEAP_GROW_MOVE;
+				else
+					grow = (ptr == old_ptr) ? BIGHEAP_GROW_INPLACE : BIGHEAP_GROW_COPY;
+				stress_bigheap_lat_add(&stats->grow[grow], ns);
+				stress_bigheap_lat_add(&stats->all, ns);
+			} else {
+				stats->starts++;
+			}
+			if (bigheap_method == BIGHEAP_METHOD_THP)
+				stress_bigheap_thp(ptr, size, page_size);
+
 			if (last_ptr == ptr) {
 				tmp = u8ptr = last_ptr_end;
 				n = (size_t)bigheap_growth;
@@ -132,12 +525,15 @@ static int stress_bigheap_child(const stress_args_t *args, void *context)
 			}
 			last_ptr = ptr;
 			last_ptr_end = u8ptr;
+			stats->grown += (double)n;
+			stress_bigheap_sample(stats, &sampler, page_size, ptr, size, false);
 		}
 		inc_counter(args);
 	} while (keep_stressing(args));
 abort:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+	stress_bigheap_sample(stats, &sampler, page_size, ptr, size, true);
 	free(ptr);
 
 	return EXIT_SUCCESS;
@@ -149,11 +545,33 @@ abort:
  */
 static int stress_bigheap(const stress_args_t *args)
 {
-	return stress_oomable_child(args, NULL, stress_bigheap_child, STRESS_OOMABLE_NORMAL);
+	stress_bigheap_stats_t *stats;
+	int bigheap_method = BIGHEAP_METHOD_REALLOC;
+	double t_start, duration;
+	int ret;
+
+	/* Keep the histograms off the heap that is being grown */
+	stats = (stress_bigheap_stats_t *)mmap(NULL, sizeof(*stats),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf("%s: cannot mmap measurement data, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)stress_get_setting("bigheap-method", &bigheap_method);
+
+	t_start = stress_time_now();
+	ret = stress_oomable_child(args, (void *)stats, stress_bigheap_child, STRESS_OOMABLE_NORMAL);
+	duration = stress_time_now() - t_start;
+	if ((duration > 0.0) && (stats->all.count > 0))
+		stress_bigheap_report(args, stats, bigheap_method, duration);
+
+	(void)munmap((void *)stats, sizeof(*stats));
+	return ret;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_bigheap_growth,	stress_set_bigheap_growth },
+	{ OPT_bigheap_method,	stress_set_bigheap_method },
 	{ 0,			NULL },
 };
 
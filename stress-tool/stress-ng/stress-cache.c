@@ -25,6 +25,7 @@
 #define FLAGS_CACHE_SFENCE	(0x08)
 #define FLAGS_CACHE_CLFLUSHOPT	(0x10)
 #define FLAGS_CACHE_CLDEMOTE	(0x20)
+#define FLAGS_CACHE_SWEEP	(0x40)
 #define FLAGS_CACHE_NOAFF	(0x80)
 
 typedef void (*cache_write_func_t)(uint64_t inc, const uint64_t r, uint64_t *pi, uint64_t *pk);
@@ -58,6 +59,7 @@ static const stress_help_t help[] = {
 #if defined(HAVE_BUILTIN_SFENCE)
 	{ NULL,	"cache-sfence",		"serialize stores with sfence" },
 #endif
+	{ NULL,	"cache-sweep",		"sweep working set sizes and report latency/bandwidth" },
 	{ NULL,	"cache-ways N",		"only fill specified number of cache ways" },
 	{ NULL,	NULL,		 NULL }
 };
@@ -127,6 +129,13 @@ static int stress_cache_set_cldemote(const char *opt)
 	return stress_cache_set_flag(FLAGS_CACHE_CLDEMOTE);
 }
 
+static int stress_cache_set_sweep(const char *opt)
+{
+	(void)opt;
+
+	return stress_cache_set_flag(FLAGS_CACHE_SWEEP);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cache_cldemote,		stress_cache_set_cldemote },
 	{ OPT_cache_clflushopt,		stress_cache_set_clflushopt },
@@ -135,6 +144,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cache_no_affinity,	stress_cache_set_noaff },
 	{ OPT_cache_prefetch,		stress_cache_set_prefetch },
 	{ OPT_cache_sfence,		stress_cache_set_sfence },
+	{ OPT_cache_sweep,		stress_cache_set_sweep },
 	{ 0,				NULL }
 };
 
@@ -424,6 +434,8 @@ static int stress_cache(const stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 
 	(void)stress_get_setting("cache-flags", &cache_flags);
+	if (cache_flags & FLAGS_CACHE_SWEEP)
+		return stress_cache_sweep(args, 0, 0);
 	if (args->instance == 0)
 		pr_dbg("%s: using cache buffer size of %" PRIu64 "K\n",
 			args->name, mem_cache_size / 1024);
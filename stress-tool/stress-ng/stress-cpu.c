@@ -302,11 +302,25 @@ static const stress_help_t help[] = {
 	{ "l P", "cpu-load P",		"load CPU by P %, 0=sleep, 100=full load (see -c)" },
 	{ NULL,	 "cpu-load-slice S",	"specify time slice during busy load" },
 	{ NULL,  "cpu-method M",	"specify stress cpu method M, default is all" },
+	{ NULL,	 "cpu-calibrate F",	"compare method rates with a per SKU baseline in file F" },
+	{ NULL,	 "cpu-calibrate-tolerance P", "flag methods more than P % off the baseline" },
 	{ NULL,	 NULL,			NULL }
 };
 
+#define CPU_CALIBRATE_MIN_OPS		(8)	/* calls before a method rate is trusted */
+#define CPU_CALIBRATE_MIN_TIME		(0.05)	/* seconds before a method rate is trusted */
+#define DEFAULT_CPU_CALIBRATE_TOLERANCE	(10)
+
+typedef struct {
+	uint64_t ops;		/* method calls */
+	double duration;	/* seconds in the method */
+} stress_cpu_method_stats_t;
+
 static const stress_cpu_method_info_t cpu_methods[];
 
+/* per method stats, indexed the same as cpu_methods */
+static stress_cpu_method_stats_t *cpu_method_stats;
+
 /* Don't make this static to ensure dithering does not get optimised out */
 uint8_t pixels[STRESS_CPU_DITHER_X][STRESS_CPU_DITHER_Y];
 
@@ -336,6 +350,20 @@ static int stress_set_cpu_load_slice(const char *opt)
 	return stress_set_setting("cpu-load-slice", TYPE_ID_INT32, &cpu_load_slice);
 }
 
+static int stress_set_cpu_calibrate(const char *opt)
+{
+	return stress_set_setting("cpu-calibrate", TYPE_ID_STR, opt);
+}
+
+static int stress_set_cpu_calibrate_tolerance(const char *opt)
+{
+	uint32_t cpu_calibrate_tolerance;
+
+	cpu_calibrate_tolerance = stress_get_uint32(opt);
+	stress_check_range("cpu-calibrate-tolerance", (uint64_t)cpu_calibrate_tolerance, 1, 100);
+	return stress_set_setting("cpu-calibrate-tolerance", TYPE_ID_UINT32, &cpu_calibrate_tolerance);
+}
+
 /*
  *  stress_cpu_sqrt()
  *	stress CPU on square roots
@@ -3043,6 +3071,23 @@ static void stress_cpu_stats(const char *name)
 			name, am, max);
 }
 
+/*
+ *  stress_cpu_method_timed()
+ *	run a cpu method and account the time it took, this uses
+ *	the cheap monotonic clock rather than the CPU time clock
+ *	as the latter is a system call
+ */
+static inline void stress_cpu_method_timed(const char *name, const size_t method)
+{
+	const double t = stress_time_now_ns();
+
+	cpu_methods[method].func(name);
+	if (cpu_method_stats) {
+		cpu_method_stats[method].duration += (stress_time_now_ns() - t) / 1000000000.0;
+		cpu_method_stats[method].ops++;
+	}
+}
+
 /*
  *  stress_cpu_all()
  *	iterate over all cpu stressors
@@ -3051,7 +3096,7 @@ static HOT OPTIMIZE3 void stress_cpu_all(const char *name)
 {
 	static int i = 1;	/* Skip over stress_cpu_all */
 
-	cpu_methods[i++].func(name);
+	stress_cpu_method_timed(name, (size_t)i++);
 	if (!cpu_methods[i].func)
 		i = 1;
 }
@@ -3261,23 +3306,257 @@ static double stress_per_cpu_time(void)
 	return stress_time_now();
 }
 
+/*
+ *  stress_cpu_sku()
+ *	get the CPU model name that identifies a baseline, tabs
+ *	are the calibration file separators so they are replaced
+ */
+static void stress_cpu_sku(char *sku, const size_t sku_len)
+{
+	static const char * const keys[] = {
+		"model name",	/* x86 */
+		"cpu model",	/* mips */
+		"cpu\t",	/* ppc64 */
+		"CPU part",	/* arm */
+	};
+	struct utsname uts;
+	char buffer[4096];
+	FILE *fp;
+	char *ptr;
+
+	*sku = '\0';
+	fp = fopen("/proc/cpuinfo", "r");
+	if (fp) {
+		while (!*sku && fgets(buffer, sizeof(buffer), fp)) {
+			size_t i;
+
+			for (i = 0; i < SIZEOF_ARRAY(keys); i++) {
+				if (strncmp(buffer, keys[i], strlen(keys[i])))
+					continue;
+				ptr = strchr(buffer, ':');
+				if (!ptr)
+					continue;
+				for (ptr++; *ptr == ' '; ptr++)
+					;
+				(void)shim_strlcpy(sku, ptr, sku_len);
+				break;
+			}
+		}
+		(void)fclose(fp);
+	}
+	if (!*sku)
+		(void)shim_strlcpy(sku, (uname(&uts) == 0) ? uts.machine : "unknown", sku_len);
+	for (ptr = sku; *ptr; ptr++) {
+		if (*ptr == '\n')
+			*ptr = '\0';
+		else if (*ptr == '\t')
+			*ptr = ' ';
+	}
+}
+
+/*
+ *  stress_cpu_method_rate()
+ *	calls per second of a method, 0.0 if it has not run for
+ *	long enough to be trusted
+ */
+static double stress_cpu_method_rate(const size_t method)
+{
+	const stress_cpu_method_stats_t *st = &cpu_method_stats[method];
+
+	if ((st->ops < CPU_CALIBRATE_MIN_OPS) || (st->duration < CPU_CALIBRATE_MIN_TIME))
+		return 0.0;
+	return (double)st->ops / st->duration;
+}
+
+/*
+ *  stress_cpu_method_report()
+ *	report the calls per second of each method that ran for the
+ *	first instance, returns the number of methods that ran
+ */
+static size_t stress_cpu_method_report(const stress_args_t *args)
+{
+	const bool metrics = !!(g_opt_flags & OPT_FLAGS_METRICS);
+	const bool report = (args->instance == 0);
+	bool lock = false;
+	size_t i, n = 0;
+
+	pr_lock(&lock);
+	for (i = 1; cpu_methods[i].func; i++) {
+		const stress_cpu_method_stats_t *st = &cpu_method_stats[i];
+
+		if (!st->ops || (st->duration <= 0.0))
+			continue;
+		n++;
+		if (!report)
+			continue;
+		if (metrics)
+			pr_inf_lock(&lock, "%s: method %-16s %12.2f ops/sec (%" PRIu64 " ops)\n",
+				args->name, cpu_methods[i].name,
+				(double)st->ops / st->duration, st->ops);
+		else
+			pr_dbg_lock(&lock, "%s: method %-16s %12.2f ops/sec (%" PRIu64 " ops)\n",
+				args->name, cpu_methods[i].name,
+				(double)st->ops / st->duration, st->ops);
+	}
+	pr_unlock(&lock);
+
+	return n;
+}
+
+/*
+ *  stress_cpu_calibrate()
+ *	compare the method rates against the baseline for this SKU in
+ *	the calibration file, the first instance records a baseline
+ *	if the file has none for this SKU. The file has lines of
+ *	SKU <tab> method <tab> ops per second. Returns the number of
+ *	methods that are more than tolerance % off the baseline.
+ */
+static size_t stress_cpu_calibrate(
+	const stress_args_t *args,
+	const char *filename,
+	const uint32_t tolerance)
+{
+	char sku[128], buffer[512];
+	FILE *fp;
+	size_t i, compared = 0, deviations = 0;
+	bool found = false;
+
+	stress_cpu_sku(sku, sizeof(sku));
+
+	fp = fopen(filename, "r");
+	if (fp) {
+		(void)flock(fileno(fp), LOCK_SH);
+		while (fgets(buffer, sizeof(buffer), fp)) {
+			char *method, *rate_str;
+			double base, rate, delta;
+
+			method = strchr(buffer, '\t');
+			if (!method)
+				continue;
+			*method++ = '\0';
+			rate_str = strchr(method, '\t');
+			if (!rate_str)
+				continue;
+			*rate_str++ = '\0';
+			if (strcmp(buffer, sku))
+				continue;
+			found = true;
+
+			for (i = 1; cpu_methods[i].func; i++) {
+				if (!strcmp(cpu_methods[i].name, method))
+					break;
+			}
+			if (!cpu_methods[i].func)
+				continue;
+			base = atof(rate_str);
+			rate = stress_cpu_method_rate(i);
+			if ((base <= 0.0) || (rate <= 0.0))
+				continue;
+			compared++;
+			delta = 100.0 * (rate - base) / base;
+			if (fabs(delta) > (double)tolerance) {
+				pr_inf("%s: instance %" PRIu32 " on CPU %u: method %s %.2f ops/sec is "
+					"%.1f%% %s than the baseline %.2f ops/sec\n",
+					args->name, args->instance, stress_get_cpu(),
+					cpu_methods[i].name, rate, fabs(delta),
+					(delta < 0.0) ? "slower" : "faster", base);
+				deviations++;
+			}
+		}
+		(void)flock(fileno(fp), LOCK_UN);
+		(void)fclose(fp);
+	}
+
+	if (found) {
+		pr_inf("%s: instance %" PRIu32 ": %zu of %zu methods are more than %" PRIu32
+			"%% off the '%s' baseline\n", args->name, args->instance,
+			deviations, compared, tolerance, sku);
+		return deviations;
+	}
+	if (args->instance != 0)
+		return 0;
+
+	fp = fopen(filename, "a");
+	if (!fp) {
+		pr_inf("%s: cannot open calibration file %s, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		return 0;
+	}
+	(void)flock(fileno(fp), LOCK_EX);
+	for (compared = 0, i = 1; cpu_methods[i].func; i++) {
+		const double rate = stress_cpu_method_rate(i);
+
+		if (rate > 0.0) {
+			(void)fprintf(fp, "%s\t%s\t%.3f\n", sku, cpu_methods[i].name, rate);
+			compared++;
+		}
+	}
+	(void)flock(fileno(fp), LOCK_UN);
+	(void)fclose(fp);
+	pr_inf("%s: recorded a '%s' baseline of %zu methods in %s\n",
+		args->name, sku, compared, filename);
+
+	return 0;
+}
+
+/*
+ *  stress_cpu_sleep_until()
+ *	sleep until an absolute monotonic time in nanoseconds so that
+ *	wake up latency is not added on to the next sleep
+ */
+static void stress_cpu_sleep_until(const double wake_ns)
+{
+#if defined(HAVE_CLOCK_NANOSLEEP) &&	\
+    defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_MONOTONIC) &&		\
+    defined(TIMER_ABSTIME)
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(wake_ns / 1000000000.0);
+	ts.tv_nsec = (long)(wake_ns - ((double)ts.tv_sec * 1000000000.0));
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+		if (!keep_stressing_flag())
+			break;
+	}
+#else
+	const double delay = (wake_ns - stress_time_now_ns()) / 1000000000.0;
+	struct timeval tv;
+
+	if (delay <= 0.0)
+		return;
+	tv.tv_sec = (time_t)delay;
+	tv.tv_usec = (long)((delay - (double)tv.tv_sec) * 1000000.0);
+	(void)select(0, NULL, NULL, NULL, &tv);
+#endif
+}
+
 /*
  *  stress_cpu()
  *	stress CPU by doing floating point math ops
  */
 static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 {
-	double bias;
 	const stress_cpu_method_info_t *cpu_method = &cpu_methods[0];
-	stress_cpu_func func;
 	int32_t cpu_load = 100;
 	int32_t cpu_load_slice = -64;
+	char *cpu_calibrate = NULL;
+	uint32_t cpu_calibrate_tolerance = DEFAULT_CPU_CALIBRATE_TOLERANCE;
+	double busy = 0.0, t_start, achieved = 0.0;
+	size_t method, n_methods, measured;
 
 	(void)stress_get_setting("cpu-load", &cpu_load);
 	(void)stress_get_setting("cpu-load-slice", &cpu_load_slice);
 	(void)stress_get_setting("cpu-method", &cpu_method);
+	(void)stress_get_setting("cpu-calibrate", &cpu_calibrate);
+	(void)stress_get_setting("cpu-calibrate-tolerance", &cpu_calibrate_tolerance);
 
-	func = cpu_method->func;
+	method = (size_t)(cpu_method - cpu_methods);
+	for (n_methods = 0; cpu_methods[n_methods].func; n_methods++)
+		;
 
 	pr_dbg("%s using method '%s'\n", args->name, cpu_method->name);
 
@@ -3290,6 +3569,10 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 		return EXIT_SUCCESS;
 	}
 
+	cpu_method_stats = calloc(n_methods, sizeof(*cpu_method_stats));
+	if (!cpu_method_stats)
+		pr_dbg("%s: cannot allocate per method statistics\n", args->name);
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	/*
@@ -3297,21 +3580,36 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 	 */
 	if (cpu_load == 100) {
 		do {
-			(void)func(args->name);
+			if (method == 0)
+				stress_cpu_all(args->name);
+			else
+				stress_cpu_method_timed(args->name, method);
 			inc_counter(args);
 		} while (keep_stressing(args));
-		return EXIT_SUCCESS;
+		goto report;
+	}
+
+#if defined(HAVE_PRCTL) && 		\
+    defined(HAVE_SYS_PRCTL_H) &&	\
+    defined(HAVE_PRCTL_TIMER_SLACK)
+	{
+		uint32_t timer_slack;
+
+		/* Tightest wake ups unless --timer-slack asked otherwise */
+		if (!stress_get_setting("timer-slack", &timer_slack))
+			(void)prctl(PR_SET_TIMERSLACK, 1UL);
 	}
+#endif
 
 	/*
-	 * More complex percentage CPU utilisation.  This is
-	 * not intended to be 100% accurate timing, it is good
-	 * enough for most purposes.
+	 * Percentage CPU utilisation, busy slices are followed by a
+	 * sleep to an absolute wake time on a timeline where busy CPU
+	 * time over elapsed time is cpu_load %, so an oversleep makes
+	 * the next sleep shorter rather than accumulating as error
 	 */
-	bias = 0.0;
+	t_start = stress_time_now_ns();
 	do {
-		double delay, t1, t2;
-		struct timeval tv;
+		double t1, t2, wake, now;
 
 		t1 = stress_per_cpu_time();
 		if (cpu_load_slice < 0) {
@@ -3319,7 +3617,10 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			int j;
 
 			for (j = 0; j < -cpu_load_slice; j++) {
-				(void)func(args->name);
+				if (method == 0)
+					stress_cpu_all(args->name);
+				else
+					stress_cpu_method_timed(args->name, method);
 				if (!keep_stressing_flag())
 					break;
 				inc_counter(args);
@@ -3330,7 +3631,10 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			const uint16_t r = stress_mwc16();
 			double slice_end = t1 + ((double)r / 131072.0);
 			do {
-				(void)func(args->name);
+				if (method == 0)
+					stress_cpu_all(args->name);
+				else
+					stress_cpu_method_timed(args->name, method);
 				t2 = stress_per_cpu_time();
 				if (!keep_stressing_flag())
 					break;
@@ -3341,7 +3645,10 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			const double slice_end = t1 + ((double)cpu_load_slice / 1000.0);
 
 			do {
-				(void)func(args->name);
+				if (method == 0)
+					stress_cpu_all(args->name);
+				else
+					stress_cpu_method_timed(args->name, method);
 				t2 = stress_per_cpu_time();
 				if (!keep_stressing_flag())
 					break;
@@ -3349,39 +3656,52 @@ static int HOT OPTIMIZE3 stress_cpu(const stress_args_t *args)
 			} while (t2 < slice_end);
 		}
 
-		/* Must not calculate this with zero % load */
-		delay = (((100 - cpu_load) * (t2 - t1)) / (double)cpu_load);
-		delay -= bias;
+		/* We may have clock warping so don't count -ve busy times */
+		if (t2 > t1)
+			busy += t2 - t1;
+		wake = t_start + (busy * 100.0 / (double)cpu_load) * 1000000000.0;
+		now = stress_time_now_ns();
 
-		/* We may have clock warping so don't sleep for -ve delays */
-		if (delay < 0.0) {
-			bias = 0.0;
-		} else {
-			/*
-			 *  We need to sleep for a small amount of
-			 *  time, measurements need to be based on
-			 *  wall clock time and NOT on cpu time used.
-			 */
-			double t3;
-
-			t2 = stress_time_now();
-
-			tv.tv_sec = (time_t)delay;
-			tv.tv_usec = (long)((delay - (double)tv.tv_sec) * 1000000.0);
-			(void)select(0, NULL, NULL, NULL, &tv);
-			t3 = stress_time_now();
-			/* Bias takes account of the time to do the delay */
-			bias = (t3 - t2) - delay;
-		}
+		/*
+		 *  Over a second behind, e.g. when stopped or starved of
+		 *  CPU, so forgive the debt rather than run flat out
+		 */
+		if (now - wake > 1000000000.0)
+			t_start += now - wake;
+		else if (wake > now)
+			stress_cpu_sleep_until(wake);
 	} while (keep_stressing(args));
 
+	t_start = (stress_time_now_ns() - t_start) / 1000000000.0;
+	if (t_start > 0.0)
+		achieved = 100.0 * busy / t_start;
+
 	if (stress_is_affinity_set() && (args->instance == 0)) {
 		pr_inf("%s: CPU affinity probably set, this can affect CPU loading\n",
 			args->name);
 	}
 
+report:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+	if (cpu_method_stats) {
+		measured = stress_cpu_method_report(args);
+		if (achieved > 0.0)
+			stress_misc_stats_set(args->misc_stats, 0, "achieved cpu-load %", achieved);
+		if (cpu_calibrate) {
+			const size_t deviations = stress_cpu_calibrate(args,
+				cpu_calibrate, cpu_calibrate_tolerance);
+
+			stress_misc_stats_set(args->misc_stats, 1,
+				"methods off the baseline", (double)deviations);
+		}
+		if (measured)
+			stress_misc_stats_set(args->misc_stats, 2,
+				"methods measured", (double)measured);
+		free(cpu_method_stats);
+		cpu_method_stats = NULL;
+	}
+
 	return EXIT_SUCCESS;
 }
 
@@ -3394,6 +3714,8 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cpu_load,		stress_set_cpu_load },
 	{ OPT_cpu_load_slice,	stress_set_cpu_load_slice },
 	{ OPT_cpu_method,	stress_set_cpu_method },
+	{ OPT_cpu_calibrate,	stress_set_cpu_calibrate },
+	{ OPT_cpu_calibrate_tolerance, stress_set_cpu_calibrate_tolerance },
 	{ 0,			NULL },
 };
 
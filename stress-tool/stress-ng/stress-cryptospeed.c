@@ -0,0 +1,837 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"cryptospeed N",	"start N workers comparing crypto backend throughput" },
+	{ NULL,	"cryptospeed-ops N",	"stop after N cryptospeed measurement points" },
+	{ NULL,	"cryptospeed-backend B", "af-alg, ipsec-mb, openssl or all" },
+	{ NULL,	"cryptospeed-alg A",	"aes-gcm, sha256, chacha20 or all" },
+	{ NULL,	"cryptospeed-sizes list", "comma separated list of buffer sizes" },
+	{ NULL,	"cryptospeed-batch N",	"requests in flight for af-alg and ipsec-mb" },
+	{ NULL,	"cryptospeed-splice",	"splice the data into af-alg rather than sendmsg" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define CRYPTOSPEED_ALL		(0)
+#define CRYPTOSPEED_MAX_SIZES	(8)		/* sizes in a --cryptospeed-sizes list */
+#define CRYPTOSPEED_MIN_SIZE	(16)
+#define CRYPTOSPEED_MAX_SIZE	(64 * KB)	/* fits an af-alg socket send buffer */
+#define CRYPTOSPEED_DEFAULT_SIZES "64,1K,16K,64K"
+#define MIN_CRYPTOSPEED_BATCH	(1)
+#define MAX_CRYPTOSPEED_BATCH	(64)
+#define DEFAULT_CRYPTOSPEED_BATCH (8)
+#define CRYPTOSPEED_SLICE	(0.25)		/* seconds per measurement point */
+#define CRYPTOSPEED_OVERHEAD	(64)		/* room for tags and digests */
+
+#define CRYPTOSPEED_AES_GCM	(0)
+#define CRYPTOSPEED_SHA256	(1)
+#define CRYPTOSPEED_CHACHA20	(2)
+
+#define CRYPTOSPEED_AF_ALG	(0)
+#define CRYPTOSPEED_IPSEC_MB	(1)
+#define CRYPTOSPEED_OPENSSL	(2)
+
+/* indexed by the CRYPTOSPEED_* algorithms */
+static const char * const cryptospeed_algs[] = {
+	"aes-gcm",
+	"sha256",
+	"chacha20",
+};
+
+/* indexed by the CRYPTOSPEED_* backends */
+static const char * const cryptospeed_backends[] = {
+	"af-alg",
+	"ipsec-mb",
+	"openssl",
+};
+
+#define CRYPTOSPEED_ALGS	SIZEOF_ARRAY(cryptospeed_algs)
+#define CRYPTOSPEED_BACKENDS	SIZEOF_ARRAY(cryptospeed_backends)
+
+/*
+ *  stress_cryptospeed_sizes_parse()
+ *	parse a comma separated list of buffer sizes, returns
+ *	the number of sizes or -1
+ */
+static int stress_cryptospeed_sizes_parse(const char *opt, size_t *sizes)
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		uint64_t size;
+
+		if (n >= CRYPTOSPEED_MAX_SIZES) {
+			(void)fprintf(stderr, "cryptospeed-sizes has more than %d "
+				"sizes\n", CRYPTOSPEED_MAX_SIZES);
+			free(str);
+			return -1;
+		}
+		size = stress_get_uint64_byte(token);
+		stress_check_range_bytes("cryptospeed-sizes", size,
+			CRYPTOSPEED_MIN_SIZE, CRYPTOSPEED_MAX_SIZE);
+		sizes[n++] = (size_t)size;
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "cryptospeed-sizes needs at least one size\n");
+		return -1;
+	}
+	return n;
+}
+
+/*
+ *  stress_cryptospeed_name()
+ *	find name in names, returns the index + 1, 0 for all
+ *	or -1 if it is not known
+ */
+static int stress_cryptospeed_name(
+	const char *opt,
+	const char *option,
+	const char * const *names,
+	const size_t n)
+{
+	size_t i;
+
+	if (!strcmp(opt, "all"))
+		return CRYPTOSPEED_ALL;
+	for (i = 0; i < n; i++) {
+		if (!strcmp(opt, names[i]))
+			return (int)i + 1;
+	}
+	(void)fprintf(stderr, "%s must be one of: all", option);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_cryptospeed_backend(const char *opt)
+{
+	const int backend = stress_cryptospeed_name(opt, "cryptospeed-backend",
+		cryptospeed_backends, CRYPTOSPEED_BACKENDS);
+
+	if (backend < 0)
+		return -1;
+	return stress_set_setting("cryptospeed-backend", TYPE_ID_INT, &backend);
+}
+
+static int stress_set_cryptospeed_alg(const char *opt)
+{
+	const int alg = stress_cryptospeed_name(opt, "cryptospeed-alg",
+		cryptospeed_algs, CRYPTOSPEED_ALGS);
+
+	if (alg < 0)
+		return -1;
+	return stress_set_setting("cryptospeed-alg", TYPE_ID_INT, &alg);
+}
+
+static int stress_set_cryptospeed_sizes(const char *opt)
+{
+	size_t sizes[CRYPTOSPEED_MAX_SIZES];
+
+	if (stress_cryptospeed_sizes_parse(opt, sizes) < 0)
+		return -1;
+	return stress_set_setting("cryptospeed-sizes", TYPE_ID_STR, opt);
+}
+
+static int stress_set_cryptospeed_batch(const char *opt)
+{
+	uint32_t cryptospeed_batch;
+
+	cryptospeed_batch = stress_get_uint32(opt);
+	stress_check_range("cryptospeed-batch", (uint64_t)cryptospeed_batch,
+		MIN_CRYPTOSPEED_BATCH, MAX_CRYPTOSPEED_BATCH);
+	return stress_set_setting("cryptospeed-batch", TYPE_ID_UINT32, &cryptospeed_batch);
+}
+
+static int stress_set_cryptospeed_splice(const char *opt)
+{
+	bool cryptospeed_splice = true;
+
+	(void)opt;
+
+	return stress_set_setting("cryptospeed-splice", TYPE_ID_BOOL, &cryptospeed_splice);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_cryptospeed_backend,	stress_set_cryptospeed_backend },
+	{ OPT_cryptospeed_alg,		stress_set_cryptospeed_alg },
+	{ OPT_cryptospeed_sizes,	stress_set_cryptospeed_sizes },
+	{ OPT_cryptospeed_batch,	stress_set_cryptospeed_batch },
+	{ OPT_cryptospeed_splice,	stress_set_cryptospeed_splice },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LINUX_IF_ALG_H) &&	\
+    defined(HAVE_LINUX_SOCKET_H) &&	\
+    defined(AF_ALG) &&			\
+    defined(ALG_SET_KEY) &&		\
+    defined(ALG_SET_IV) &&		\
+    defined(ALG_SET_OP) &&		\
+    defined(ALG_SET_AEAD_ASSOCLEN) &&	\
+    defined(ALG_SET_AEAD_AUTHSIZE)
+#define STRESS_CRYPTOSPEED_AF_ALG
+#endif
+
+#if defined(HAVE_INTEL_IPSEC_MB_H) &&	\
+    defined(HAVE_LIB_IPSEC_MB) &&	\
+    defined(STRESS_ARCH_X86) &&		\
+    (defined(__x86_64__) || defined(__x86_64)) && \
+    defined(IMB_FEATURE_SSE4_2) &&	\
+    defined(IMB_FEATURE_CMOV) &&	\
+    defined(IMB_FEATURE_AESNI) &&	\
+    defined(IMB_FEATURE_AVX) &&		\
+    defined(IMB_FEATURE_AVX2) &&	\
+    defined(IMB_FEATURE_AVX512_SKX)
+#define STRESS_CRYPTOSPEED_IPSEC_MB
+#endif
+
+#if defined(HAVE_OPENSSL_EVP_H) &&	\
+    defined(HAVE_LIB_CRYPTO)
+#define STRESS_CRYPTOSPEED_OPENSSL
+#endif
+
+/*
+ *  buffers and settings shared by the backends
+ */
+typedef struct {
+	const stress_args_t *args;
+	uint8_t *in;		/* batch x size bytes of input */
+	uint8_t *out;		/* batch x (size + overhead) bytes of output */
+	uint8_t key[32];	/* cipher key */
+	uint8_t iv[16];		/* cipher IV or nonce */
+	uint32_t batch;		/* requests in flight */
+	bool splice;		/* splice data into af-alg */
+} stress_cryptospeed_ctxt_t;
+
+/*
+ *  a backend processes size byte buffers with alg until the
+ *  deadline adding the bytes processed, it returns 0, or -1
+ *  if it does not support the algorithm
+ */
+typedef int (*stress_cryptospeed_func_t)(stress_cryptospeed_ctxt_t *ctxt,
+	const int alg, const size_t size, const double deadline, uint64_t *bytes);
+
+typedef struct {
+	uint64_t bytes;		/* bytes processed */
+	double duration;	/* wall clock seconds */
+	double cpu;		/* user + system CPU seconds */
+	bool measured;		/* point has been measured */
+	bool unsupported;	/* backend does not support the algorithm */
+} stress_cryptospeed_stats_t;
+
+#if defined(STRESS_CRYPTOSPEED_AF_ALG)
+
+#if !defined(SOL_ALG)
+#define SOL_ALG			(279)
+#endif
+
+typedef struct {
+	const char *type;	/* af-alg transform type */
+	const char *name;	/* kernel crypto algorithm */
+	size_t key_len;		/* key bytes, 0 for none */
+	size_t iv_len;		/* IV bytes, 0 for none */
+	size_t auth_size;	/* AEAD tag bytes */
+	size_t digest_size;	/* hash digest bytes */
+} stress_cryptospeed_af_alg_t;
+
+/* indexed by the CRYPTOSPEED_* algorithms */
+static const stress_cryptospeed_af_alg_t cryptospeed_af_algs[] = {
+	{ "aead",	"gcm(aes)",	16, 12, 16, 0 },
+	{ "hash",	"sha256",	0,  0,  0,  32 },
+	{ "skcipher",	"chacha20",	32, 16, 0,  0 },
+};
+
+/*
+ *  stress_cryptospeed_af_alg_send()
+ *	send a request, the operation and IV go in control messages
+ *	and the data either with them or spliced in through a pipe
+ */
+static ssize_t stress_cryptospeed_af_alg_send(
+	stress_cryptospeed_ctxt_t *ctxt,
+	const stress_cryptospeed_af_alg_t *info,
+	const int fd,
+	const int pipefds[2],
+	uint8_t *data,
+	const size_t size)
+{
+	char cbuf[CMSG_SPACE(sizeof(uint32_t)) * 2 +
+		  CMSG_SPACE(sizeof(struct af_alg_iv) + 16)];
+	struct msghdr msg;
+	struct iovec iov;
+	size_t done;
+
+	(void)memset(&msg, 0, sizeof(msg));
+	iov.iov_base = (void *)data;
+	iov.iov_len = size;
+
+	if (info->iv_len) {
+		struct cmsghdr *cmsg;
+		struct af_alg_iv *iv;
+
+		(void)memset(cbuf, 0, sizeof(cbuf));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_OP;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+		*(uint32_t *)CMSG_DATA(cmsg) = ALG_OP_ENCRYPT;
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_IV;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + info->iv_len);
+		iv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+		iv->ivlen = (uint32_t)info->iv_len;
+		(void)memcpy(iv->iv, ctxt->iv, info->iv_len);
+
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		if (info->auth_size) {
+			cmsg->cmsg_level = SOL_ALG;
+			cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+			*(uint32_t *)CMSG_DATA(cmsg) = 0;
+		} else {
+			msg.msg_controllen -= CMSG_SPACE(sizeof(uint32_t));
+		}
+	}
+
+	if (!ctxt->splice) {
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		return sendmsg(fd, &msg, 0);
+	}
+
+	/* Control messages only, the data follows by splice */
+	if (msg.msg_controllen && (sendmsg(fd, &msg, MSG_MORE) < 0))
+		return -1;
+	for (done = 0; done < size; ) {
+		ssize_t n;
+
+		iov.iov_base = (void *)(data + done);
+		iov.iov_len = size - done;
+		n = vmsplice(pipefds[1], &iov, 1, 0);
+		if (n <= 0)
+			return -1;
+		done += (size_t)n;
+		n = splice(pipefds[0], NULL, fd, NULL, (size_t)n,
+			(done < size) ? SPLICE_F_MORE : 0);
+		if (n < 0)
+			return -1;
+	}
+	return (ssize_t)size;
+}
+
+/*
+ *  stress_cryptospeed_af_alg()
+ *	kernel crypto through AF_ALG, batch requests are sent on
+ *	batch operation sockets before their results are read
+ *	so that asynchronous drivers can overlap them
+ */
+static int stress_cryptospeed_af_alg(
+	stress_cryptospeed_ctxt_t *ctxt,
+	const int alg,
+	const size_t size,
+	const double deadline,
+	uint64_t *bytes)
+{
+	const stress_cryptospeed_af_alg_t *info = &cryptospeed_af_algs[alg];
+	const size_t out_size = info->digest_size ? info->digest_size : size + info->auth_size;
+	int fds[MAX_CRYPTOSPEED_BATCH];
+	int sockfd, pipefds[2] = { -1, -1 }, rc = -1;
+	struct sockaddr_alg sa;
+	uint32_t i, opened = 0;
+
+	sockfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (sockfd < 0)
+		return -1;
+	(void)memset(&sa, 0, sizeof(sa));
+	sa.salg_family = AF_ALG;
+	(void)shim_strlcpy((char *)sa.salg_type, info->type, sizeof(sa.salg_type));
+	(void)shim_strlcpy((char *)sa.salg_name, info->name, sizeof(sa.salg_name));
+	if (bind(sockfd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+		goto close_sock;
+	if (info->key_len &&
+	    (setsockopt(sockfd, SOL_ALG, ALG_SET_KEY, ctxt->key, (socklen_t)info->key_len) < 0))
+		goto close_sock;
+	if (info->auth_size &&
+	    (setsockopt(sockfd, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL, (socklen_t)info->auth_size) < 0))
+		goto close_sock;
+	for (opened = 0; opened < ctxt->batch; opened++) {
+		fds[opened] = accept(sockfd, NULL, 0);
+		if (fds[opened] < 0)
+			goto close_fds;
+	}
+	if (ctxt->splice) {
+		if (pipe(pipefds) < 0)
+			goto close_fds;
+#if defined(F_SETPIPE_SZ)
+		(void)fcntl(pipefds[1], F_SETPIPE_SZ, (int)size);
+#endif
+	}
+
+	while (keep_stressing_flag() && (stress_time_now() < deadline)) {
+		for (i = 0; i < ctxt->batch; i++) {
+			if (stress_cryptospeed_af_alg_send(ctxt, info, fds[i], pipefds,
+					ctxt->in + (i * size), size) < 0)
+				goto close_pipe;
+		}
+		for (i = 0; i < ctxt->batch; i++) {
+			if (read(fds[i], ctxt->out + (i * (size + CRYPTOSPEED_OVERHEAD)),
+					out_size) != (ssize_t)out_size)
+				goto close_pipe;
+		}
+		*bytes += (uint64_t)ctxt->batch * size;
+	}
+	rc = 0;
+
+close_pipe:
+	if (rc < 0)
+		pr_dbg("%s: af-alg %s failed, errno=%d (%s)\n", ctxt->args->name,
+			info->name, errno, strerror(errno));
+	if (pipefds[0] >= 0) {
+		(void)close(pipefds[0]);
+		(void)close(pipefds[1]);
+	}
+close_fds:
+	for (i = 0; i < opened; i++)
+		(void)close(fds[i]);
+close_sock:
+	(void)close(sockfd);
+	return rc;
+}
+#endif
+
+#if defined(STRESS_CRYPTOSPEED_IPSEC_MB)
+/*
+ *  stress_cryptospeed_ipsec_mb_init()
+ *	get a job manager initialised for the best CPU features
+ */
+static MB_MGR *stress_cryptospeed_ipsec_mb_init(void)
+{
+	MB_MGR *p_mgr;
+	uint64_t features;
+
+	p_mgr = alloc_mb_mgr(0);
+	if (!p_mgr)
+		return NULL;
+	features = p_mgr->features;
+	if ((features & IMB_FEATURE_AVX512_SKX) && (features & IMB_FEATURE_AVX2))
+		init_mb_mgr_avx512(p_mgr);
+	else if (features & IMB_FEATURE_AVX2)
+		init_mb_mgr_avx2(p_mgr);
+	else if (features & IMB_FEATURE_AVX)
+		init_mb_mgr_avx(p_mgr);
+	else
+		init_mb_mgr_sse(p_mgr);
+	return p_mgr;
+}
+
+/*
+ *  stress_cryptospeed_ipsec_mb()
+ *	Intel multi-buffer crypto, batch jobs are submitted before
+ *	the manager is flushed so the lanes can be filled
+ */
+static int stress_cryptospeed_ipsec_mb(
+	stress_cryptospeed_ctxt_t *ctxt,
+	const int alg,
+	const size_t size,
+	const double deadline,
+	uint64_t *bytes)
+{
+	struct gcm_key_data gdata_key ALIGNED(64);
+	uint8_t aad[16] ALIGNED(16);
+	MB_MGR *p_mgr;
+	uint32_t i;
+
+#if !defined(IMB_VERSION_NUM) ||	\
+    !defined(IMB_VERSION) ||		\
+    (IMB_VERSION_NUM < IMB_VERSION(0, 55, 0))
+	if (alg == CRYPTOSPEED_CHACHA20)
+		return -1;
+#endif
+	p_mgr = stress_cryptospeed_ipsec_mb_init();
+	if (!p_mgr)
+		return -1;
+	(void)memset(aad, 0, sizeof(aad));
+	if (alg == CRYPTOSPEED_AES_GCM)
+		IMB_AES128_GCM_PRE(p_mgr, ctxt->key, &gdata_key);
+
+	while (keep_stressing_flag() && (stress_time_now() < deadline)) {
+		for (i = 0; i < ctxt->batch; i++) {
+			struct JOB_AES_HMAC *job = IMB_GET_NEXT_JOB(p_mgr);
+			uint8_t *out = ctxt->out + (i * (size + CRYPTOSPEED_OVERHEAD));
+
+			(void)memset(job, 0, sizeof(*job));
+			job->src = ctxt->in + (i * size);
+			job->dst = out;
+			job->cipher_direction = ENCRYPT;
+			switch (alg) {
+			case CRYPTOSPEED_AES_GCM:
+				job->chain_order = CIPHER_HASH;
+				job->cipher_mode = GCM;
+				job->hash_alg = AES_GMAC;
+				job->aes_enc_key_expanded = &gdata_key;
+				job->aes_dec_key_expanded = &gdata_key;
+				job->aes_key_len_in_bytes = 16;
+				job->iv = ctxt->iv;
+				job->iv_len_in_bytes = 12;
+				job->msg_len_to_cipher_in_bytes = size;
+				job->msg_len_to_hash_in_bytes = size;
+				job->u.GCM.aad = aad;
+				job->u.GCM.aad_len_in_bytes = 0;
+				job->auth_tag_output = out + size;
+				job->auth_tag_output_len_in_bytes = 16;
+				break;
+			case CRYPTOSPEED_SHA256:
+				job->chain_order = HASH_CIPHER;
+				job->cipher_mode = NULL_CIPHER;
+				job->hash_alg = PLAIN_SHA_256;
+				job->msg_len_to_hash_in_bytes = size;
+				job->auth_tag_output = out;
+				job->auth_tag_output_len_in_bytes = 32;
+				break;
+#if defined(IMB_VERSION_NUM) &&		\
+    defined(IMB_VERSION) &&		\
+    (IMB_VERSION_NUM >= IMB_VERSION(0, 55, 0))
+			case CRYPTOSPEED_CHACHA20:
+				job->chain_order = CIPHER_HASH;
+				job->cipher_mode = IMB_CIPHER_CHACHA20;
+				job->hash_alg = NULL_HASH;
+				job->enc_keys = ctxt->key;
+				job->key_len_in_bytes = 32;
+				job->iv = ctxt->iv;
+				job->iv_len_in_bytes = 12;
+				job->msg_len_to_cipher_in_bytes = size;
+				break;
+#endif
+			default:
+				break;
+			}
+			(void)IMB_SUBMIT_JOB(p_mgr);
+		}
+		while (IMB_FLUSH_JOB(p_mgr))
+			;
+		*bytes += (uint64_t)ctxt->batch * size;
+	}
+	free_mb_mgr(p_mgr);
+	return 0;
+}
+#endif
+
+#if defined(STRESS_CRYPTOSPEED_OPENSSL)
+/*
+ *  stress_cryptospeed_openssl()
+ *	user space crypto through the OpenSSL EVP interface, this
+ *	uses the CPU's SIMD and crypto extensions where it can
+ */
+static int stress_cryptospeed_openssl(
+	stress_cryptospeed_ctxt_t *ctxt,
+	const int alg,
+	const size_t size,
+	const double deadline,
+	uint64_t *bytes)
+{
+	EVP_CIPHER_CTX *cctx = NULL;
+	EVP_MD_CTX *mctx = NULL;
+	const EVP_CIPHER *cipher = NULL;
+	int rc = -1;
+
+	switch (alg) {
+	case CRYPTOSPEED_AES_GCM:
+		cipher = EVP_aes_128_gcm();
+		break;
+	case CRYPTOSPEED_CHACHA20:
+		cipher = EVP_chacha20();
+		break;
+	default:
+		break;
+	}
+	if (cipher) {
+		cctx = EVP_CIPHER_CTX_new();
+		if (!cctx)
+			return -1;
+		if (!EVP_EncryptInit_ex(cctx, cipher, NULL, ctxt->key, ctxt->iv))
+			goto free_ctx;
+	} else {
+		mctx = EVP_MD_CTX_new();
+		if (!mctx)
+			return -1;
+	}
+
+	while (keep_stressing_flag() && (stress_time_now() < deadline)) {
+		uint8_t *out = ctxt->out;
+		int len, tail;
+
+		if (cctx) {
+			if (!EVP_EncryptInit_ex(cctx, NULL, NULL, NULL, ctxt->iv) ||
+			    !EVP_EncryptUpdate(cctx, out, &len, ctxt->in, (int)size) ||
+			    !EVP_EncryptFinal_ex(cctx, out + len, &tail))
+				goto free_ctx;
+			if ((alg == CRYPTOSPEED_AES_GCM) &&
+			    !EVP_CIPHER_CTX_ctrl(cctx, EVP_CTRL_GCM_GET_TAG, 16, out + size))
+				goto free_ctx;
+		} else {
+			unsigned int md_len;
+
+			if (!EVP_DigestInit_ex(mctx, EVP_sha256(), NULL) ||
+			    !EVP_DigestUpdate(mctx, ctxt->in, size) ||
+			    !EVP_DigestFinal_ex(mctx, out, &md_len))
+				goto free_ctx;
+		}
+		*bytes += size;
+	}
+	rc = 0;
+free_ctx:
+	if (cctx)
+		EVP_CIPHER_CTX_free(cctx);
+	if (mctx)
+		EVP_MD_CTX_free(mctx);
+	return rc;
+}
+#endif
+
+/* indexed by the CRYPTOSPEED_* backends, NULL if not built in */
+static const stress_cryptospeed_func_t cryptospeed_funcs[] = {
+#if defined(STRESS_CRYPTOSPEED_AF_ALG)
+	stress_cryptospeed_af_alg,
+#else
+	NULL,
+#endif
+#if defined(STRESS_CRYPTOSPEED_IPSEC_MB)
+	stress_cryptospeed_ipsec_mb,
+#else
+	NULL,
+#endif
+#if defined(STRESS_CRYPTOSPEED_OPENSSL)
+	stress_cryptospeed_openssl,
+#else
+	NULL,
+#endif
+};
+
+/*
+ *  stress_cryptospeed_cpu()
+ *	user and system CPU time of this process in seconds
+ */
+static double stress_cryptospeed_cpu(void)
+{
+	struct rusage usage;
+
+	if (shim_getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_cryptospeed_report()
+ *	report GB/sec and GB/sec per CPU second of each backend,
+ *	algorithm and buffer size
+ */
+static void stress_cryptospeed_report(
+	const stress_args_t *args,
+	const stress_cryptospeed_stats_t *stats,
+	const size_t *sizes,
+	const int n_sizes,
+	const uint32_t batch)
+{
+	bool lock = false;
+	size_t b, a;
+	int s, idx = 0;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %" PRIu32 " requests in flight for af-alg and ipsec-mb\n",
+		args->name, batch);
+	pr_inf_lock(&lock, "%s: %-9s %-9s %8s %9s %13s\n", args->name,
+		"backend", "algorithm", "size", "GB/sec", "GB/sec/core");
+	for (b = 0; b < CRYPTOSPEED_BACKENDS; b++) {
+		for (a = 0; a < CRYPTOSPEED_ALGS; a++) {
+			double best = 0.0;
+
+			for (s = 0; s < n_sizes; s++) {
+				const stress_cryptospeed_stats_t *st =
+					&stats[((b * CRYPTOSPEED_ALGS) + a) * CRYPTOSPEED_MAX_SIZES + (size_t)s];
+				char szstr[32];
+				double gb_per_sec, gb_per_core;
+
+				if (!st->measured)
+					continue;
+				stress_uint64_to_str(szstr, sizeof(szstr), (uint64_t)sizes[s]);
+				if (st->unsupported || (st->duration <= 0.0)) {
+					pr_inf_lock(&lock, "%s: %-9s %-9s %8s %9s %13s\n", args->name,
+						cryptospeed_backends[b], cryptospeed_algs[a],
+						szstr, "n/a", "n/a");
+					continue;
+				}
+				gb_per_sec = ((double)st->bytes / (double)GB) / st->duration;
+				gb_per_core = (st->cpu > 0.0) ?
+					((double)st->bytes / (double)GB) / st->cpu : 0.0;
+				pr_inf_lock(&lock, "%s: %-9s %-9s %8s %9.3f %13.3f\n", args->name,
+					cryptospeed_backends[b], cryptospeed_algs[a],
+					szstr, gb_per_sec, gb_per_core);
+				if (gb_per_core > best)
+					best = gb_per_core;
+			}
+			if ((best > 0.0) && (idx < 10)) {
+				char desc[32];
+
+				(void)snprintf(desc, sizeof(desc), "%s %s GB/s/core",
+					cryptospeed_backends[b], cryptospeed_algs[a]);
+				stress_misc_stats_set(args->misc_stats, idx++, desc, best);
+			}
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_cryptospeed()
+ *	run the same algorithms and buffer sizes across the kernel,
+ *	ipsec-mb and OpenSSL crypto backends
+ */
+static int stress_cryptospeed(const stress_args_t *args)
+{
+	stress_cryptospeed_ctxt_t ctxt;
+	stress_cryptospeed_stats_t *stats;
+	size_t sizes[CRYPTOSPEED_MAX_SIZES], max_size = 0;
+	int backend = CRYPTOSPEED_ALL, alg = CRYPTOSPEED_ALL, n_sizes, s;
+	char *sizes_opt = CRYPTOSPEED_DEFAULT_SIZES;
+	size_t b, a;
+
+	(void)memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.args = args;
+	ctxt.batch = DEFAULT_CRYPTOSPEED_BATCH;
+	(void)stress_get_setting("cryptospeed-backend", &backend);
+	(void)stress_get_setting("cryptospeed-alg", &alg);
+	(void)stress_get_setting("cryptospeed-sizes", &sizes_opt);
+	(void)stress_get_setting("cryptospeed-batch", &ctxt.batch);
+	(void)stress_get_setting("cryptospeed-splice", &ctxt.splice);
+
+	n_sizes = stress_cryptospeed_sizes_parse(sizes_opt, sizes);
+	if (n_sizes < 0)
+		return EXIT_FAILURE;
+	for (s = 0; s < n_sizes; s++)
+		max_size = STRESS_MAXIMUM(max_size, sizes[s]);
+
+	if (args->instance == 0) {
+		for (b = 0; b < CRYPTOSPEED_BACKENDS; b++) {
+			if ((backend == CRYPTOSPEED_ALL) || ((size_t)backend == b + 1)) {
+				if (!cryptospeed_funcs[b])
+					pr_inf("%s: %s backend is not supported, "
+						"not measuring it\n", args->name,
+						cryptospeed_backends[b]);
+			}
+		}
+	}
+
+	ctxt.in = (uint8_t *)mmap(NULL, ctxt.batch * max_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ctxt.in == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap input buffers, skipping stressor, "
+			"errno=%d (%s)\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	ctxt.out = (uint8_t *)mmap(NULL, ctxt.batch * (max_size + CRYPTOSPEED_OVERHEAD),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ctxt.out == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap output buffers, skipping stressor, "
+			"errno=%d (%s)\n", args->name, errno, strerror(errno));
+		(void)munmap((void *)ctxt.in, ctxt.batch * max_size);
+		return EXIT_NO_RESOURCE;
+	}
+	stats = calloc(CRYPTOSPEED_BACKENDS * CRYPTOSPEED_ALGS * CRYPTOSPEED_MAX_SIZES,
+		sizeof(*stats));
+	if (!stats) {
+		pr_inf_skip("%s: cannot allocate statistics, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)ctxt.out, ctxt.batch * (max_size + CRYPTOSPEED_OVERHEAD));
+		(void)munmap((void *)ctxt.in, ctxt.batch * max_size);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_mwc_fill(ctxt.in, ctxt.batch * max_size);
+	stress_mwc_fill(ctxt.key, sizeof(ctxt.key));
+	stress_mwc_fill(ctxt.iv, sizeof(ctxt.iv));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (b = 0; b < CRYPTOSPEED_BACKENDS; b++) {
+			if ((backend != CRYPTOSPEED_ALL) && ((size_t)backend != b + 1))
+				continue;
+			if (!cryptospeed_funcs[b])
+				continue;
+			for (a = 0; a < CRYPTOSPEED_ALGS; a++) {
+				if ((alg != CRYPTOSPEED_ALL) && ((size_t)alg != a + 1))
+					continue;
+				for (s = 0; s < n_sizes; s++) {
+					stress_cryptospeed_stats_t *st =
+						&stats[((b * CRYPTOSPEED_ALGS) + a) * CRYPTOSPEED_MAX_SIZES + (size_t)s];
+					uint64_t bytes = 0;
+					double t, cpu;
+
+					if (!keep_stressing(args))
+						goto report;
+					if (st->unsupported)
+						continue;
+					cpu = stress_cryptospeed_cpu();
+					t = stress_time_now();
+					if (cryptospeed_funcs[b](&ctxt, (int)a, sizes[s],
+								 t + CRYPTOSPEED_SLICE, &bytes) < 0) {
+						st->unsupported = true;
+						st->measured = true;
+						continue;
+					}
+					st->duration += stress_time_now() - t;
+					st->cpu += stress_cryptospeed_cpu() - cpu;
+					st->bytes += bytes;
+					st->measured = true;
+					inc_counter(args);
+				}
+			}
+		}
+	} while (keep_stressing(args));
+
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_cryptospeed_report(args, stats, sizes, n_sizes, ctxt.batch);
+
+	free(stats);
+	(void)munmap((void *)ctxt.out, ctxt.batch * (max_size + CRYPTOSPEED_OVERHEAD));
+	(void)munmap((void *)ctxt.in, ctxt.batch * max_size);
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_cryptospeed_info = {
+	.stressor = stress_cryptospeed,
+	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
@@ -28,12 +28,38 @@
 #define MAX_SAMPLES		(10000)
 #define MAX_BUCKETS		(250)
 
+/*
+ *  HDR histogram of all the latencies, values below 64 ns are exact
+ *  and above that each power of 2 is split into 32 buckets, so the
+ *  values are within 3% over the whole int64 range
+ */
+#define HDR_SUB_BITS		(5)
+#define HDR_SUB_BUCKETS		(1 << HDR_SUB_BITS)
+#define HDR_EXACT		(HDR_SUB_BUCKETS * 2)
+#define HDR_BUCKETS		(HDR_EXACT + ((63 - (HDR_SUB_BITS + 1)) * HDR_SUB_BUCKETS))
+
+#define CYCLIC_MAX_CPUS		(256)
+
+#define CYCLIC_LOAD_NONE	(0)	/* no adversarial load */
+#define CYCLIC_LOAD_MEM		(1)	/* memory bandwidth load */
+#define CYCLIC_LOAD_IO		(2)	/* write and sync file load */
+#define CYCLIC_LOAD_MIX		(3)	/* memory and I/O load */
+
+#define CYCLIC_LOAD_MEM_SIZE	(64 * MB)
+#define CYCLIC_LOAD_IO_SIZE	(1 * MB)
+
 typedef struct {
 	const int	policy;		/* scheduler policy */
 	const char	*name;		/* name of scheduler policy */
 	const char	*opt_name;	/* option name */
 } stress_policy_t;
 
+typedef struct {
+	uint64_t	count;		/* samples on this CPU */
+	double		ns;		/* total latency on this CPU */
+	int64_t		max_ns;		/* max latency on this CPU */
+} stress_cyclic_cpu_t;
+
 typedef struct {
 	int64_t		min_ns;		/* min latency */
 	int64_t		max_ns;		/* max latency */
@@ -45,6 +71,10 @@ typedef struct {
 	double		latency_mean;	/* average latency */
 	int64_t		latency_mode;	/* first mode */
 	double		std_dev;	/* standard deviation */
+	uint64_t	hdr_count;	/* samples in the HDR histogram */
+	int64_t		hdr_max;	/* max latency of all samples */
+	uint64_t	hdr[HDR_BUCKETS]; /* HDR histogram of all samples */
+	stress_cyclic_cpu_t cpus[CYCLIC_MAX_CPUS]; /* per CPU latencies */
 } stress_rt_stats_t;
 
 typedef int (*stress_cyclic_func)(const stress_args_t *args, stress_rt_stats_t *rt_stats, uint64_t cyclic_sleep);
@@ -59,6 +89,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"cyclic-ops N",		"stop after N cyclic timing cycles" },
 	{ NULL,	"cyclic-method M",	"specify cyclic method M, default is clock_ns" },
 	{ NULL,	"cyclic-dist N",	"calculate distribution of interval N nanosecs" },
+	{ NULL,	"cyclic-load L",	"co-schedule mem, io or mix adversarial load" },
 	{ NULL,	"cyclic-policy P",	"used rr or fifo scheduling policy" },
 	{ NULL,	"cyclic-prio N",	"real time scheduling priority 1..100" },
 	{ NULL,	"cyclic-sleep N",	"sleep time of real time timer in nanosecs" },
@@ -116,6 +147,19 @@ static int stress_set_cyclic_prio(const char *opt)
 	return stress_set_setting("cyclic-prio", TYPE_ID_INT32, &cyclic_prio);
 }
 
+static int stress_set_cyclic_load(const char *opt)
+{
+	static const char * const loads[] = { "none", "mem", "io", "mix" };
+	int cyclic_load;
+
+	for (cyclic_load = 0; cyclic_load < (int)SIZEOF_ARRAY(loads); cyclic_load++) {
+		if (!strcmp(opt, loads[cyclic_load]))
+			return stress_set_setting("cyclic-load", TYPE_ID_INT, &cyclic_load);
+	}
+	(void)fprintf(stderr, "cyclic-load must be one of: none mem io mix\n");
+	return -1;
+}
+
 static int stress_set_cyclic_dist(const char *opt)
 {
 	uint64_t cyclic_dist;
@@ -125,10 +169,67 @@ static int stress_set_cyclic_dist(const char *opt)
 	return stress_set_setting("cyclic-dist", TYPE_ID_UINT64, &cyclic_dist);
 }
 
+/*
+ *  stress_cyclic_hdr_index()
+ *	map a latency to its HDR histogram bucket
+ */
+static inline size_t stress_cyclic_hdr_index(const int64_t ns)
+{
+	uint64_t v = (ns > 0) ? (uint64_t)ns : 0;
+	int msb = 63;
+
+	if (v < HDR_EXACT)
+		return (size_t)v;
+	while (!(v & (1ULL << msb)))
+		msb--;
+	return HDR_EXACT + ((size_t)(msb - (HDR_SUB_BITS + 1)) * HDR_SUB_BUCKETS) +
+		(size_t)((v >> (msb - HDR_SUB_BITS)) & (HDR_SUB_BUCKETS - 1));
+}
+
+/*
+ *  stress_cyclic_hdr_value()
+ *	highest latency that maps to an HDR histogram bucket
+ */
+static int64_t stress_cyclic_hdr_value(const size_t idx)
+{
+	size_t msb, sub;
+
+	if (idx < HDR_EXACT)
+		return (int64_t)idx;
+	msb = ((idx - HDR_EXACT) / HDR_SUB_BUCKETS) + (HDR_SUB_BITS + 1);
+	sub = (idx - HDR_EXACT) % HDR_SUB_BUCKETS;
+	return (int64_t)((((uint64_t)(HDR_SUB_BUCKETS + sub) + 1) <<
+		(msb - HDR_SUB_BITS)) - 1);
+}
+
 #if (defined(HAVE_CLOCK_GETTIME) && defined(HAVE_CLOCK_NANOSLEEP)) ||	\
     (defined(HAVE_CLOCK_GETTIME) && defined(HAVE_NANOSLEEP)) ||		\
     (defined(HAVE_CLOCK_GETTIME) && defined(HAVE_PSELECT)) ||		\
     (defined(HAVE_CLOCK_GETTIME))
+/*
+ *  stress_cyclic_hdr_add()
+ *	account a latency in the HDR histogram and the per CPU stats,
+ *	unlike the latencies array this covers every sample
+ */
+static void stress_cyclic_hdr_add(stress_rt_stats_t *rt_stats, const int64_t ns)
+{
+	unsigned int cpu = 0, node = 0;
+
+	rt_stats->hdr[stress_cyclic_hdr_index(ns)]++;
+	rt_stats->hdr_count++;
+	if (ns > rt_stats->hdr_max)
+		rt_stats->hdr_max = ns;
+
+	if ((shim_getcpu(&cpu, &node, NULL) == 0) && (cpu < CYCLIC_MAX_CPUS)) {
+		stress_cyclic_cpu_t *c = &rt_stats->cpus[cpu];
+
+		c->count++;
+		c->ns += (double)ns;
+		if (ns > c->max_ns)
+			c->max_ns = ns;
+	}
+}
+
 static void stress_cyclic_stats(
 	stress_rt_stats_t *rt_stats,
 	const uint64_t cyclic_sleep,
@@ -145,6 +246,8 @@ static void stress_cyclic_stats(
 		rt_stats->latencies[rt_stats->index++] = delta_ns;
 
 	rt_stats->ns += (double)delta_ns;
+
+	stress_cyclic_hdr_add(rt_stats, delta_ns);
 }
 #endif
 
@@ -239,6 +342,7 @@ static int stress_cyclic_poll(
 				rt_stats->latencies[rt_stats->index++] = delta_ns;
 
 			rt_stats->ns += (double)delta_ns;
+			stress_cyclic_hdr_add(rt_stats, delta_ns);
 			break;
 		}
 	}
@@ -334,6 +438,7 @@ static int stress_cyclic_itimer(
 		rt_stats->latencies[rt_stats->index++] = delta_ns;
 
 	rt_stats->ns += (double)delta_ns;
+	stress_cyclic_hdr_add(rt_stats, delta_ns);
 
 	(void)timer_delete(timerid);
 
@@ -578,6 +683,154 @@ static void stress_rt_dist(
 	}
 }
 
+/*
+ *  stress_cyclic_hdr_report()
+ *	show the latency percentiles of all the samples from the
+ *	HDR histogram, out to the tail that the first MAX_SAMPLES
+ *	latencies cannot resolve
+ */
+static void stress_cyclic_hdr_report(
+	const char *name,
+	bool *lock,
+	const stress_rt_stats_t *rt_stats)
+{
+	static const double percentiles[] = {
+		50.0, 90.0, 99.0, 99.9, 99.99, 99.999,
+	};
+	size_t i, idx = 0;
+	uint64_t sum = 0;
+
+	if (!rt_stats->hdr_count)
+		return;
+
+	pr_inf_lock(lock, "%s: latency percentiles of all %" PRIu64
+		" samples (HDR histogram, 3%% precision):\n",
+		name, rt_stats->hdr_count);
+	for (i = 0; i < SIZEOF_ARRAY(percentiles); i++) {
+		const uint64_t target = (uint64_t)ceil(((double)rt_stats->hdr_count *
+			percentiles[i]) / 100.0);
+
+		while ((idx < HDR_BUCKETS) && (sum + rt_stats->hdr[idx] < target))
+			sum += rt_stats->hdr[idx++];
+		if (idx >= HDR_BUCKETS)
+			break;
+		pr_inf_lock(lock, "%s:   %7.3f%%: %10" PRId64 " ns\n", name,
+			percentiles[i], STRESS_MINIMUM(stress_cyclic_hdr_value(idx),
+			rt_stats->hdr_max));
+	}
+	pr_inf_lock(lock, "%s:       max: %10" PRId64 " ns\n", name, rt_stats->hdr_max);
+}
+
+/*
+ *  stress_cyclic_cpu_report()
+ *	show the latencies per CPU when samples were taken on more
+ *	than one CPU or on isolated or nohz_full CPUs, as these are
+ *	usually set aside for real time work
+ */
+static void stress_cyclic_cpu_report(
+	const char *name,
+	bool *lock,
+	const stress_rt_stats_t *rt_stats)
+{
+	unsigned int cpu, cpus = 0;
+	bool special = false;
+#if defined(HAVE_AFFINITY)
+	cpu_set_t isolated, nohz_full;
+
+	(void)stress_topology_read_list("/sys/devices/system/cpu/isolated", &isolated);
+	(void)stress_topology_read_list("/sys/devices/system/cpu/nohz_full", &nohz_full);
+#endif
+
+	for (cpu = 0; cpu < CYCLIC_MAX_CPUS; cpu++) {
+		if (!rt_stats->cpus[cpu].count)
+			continue;
+		cpus++;
+#if defined(HAVE_AFFINITY)
+		if (CPU_ISSET((int)cpu, &isolated) || CPU_ISSET((int)cpu, &nohz_full))
+			special = true;
+#endif
+	}
+	if ((cpus < 2) && !special)
+		return;
+
+	pr_inf_lock(lock, "%s: latencies per CPU:\n", name);
+	for (cpu = 0; cpu < CYCLIC_MAX_CPUS; cpu++) {
+		const stress_cyclic_cpu_t *c = &rt_stats->cpus[cpu];
+		const char *tag = "";
+
+		if (!c->count)
+			continue;
+#if defined(HAVE_AFFINITY)
+		if (CPU_ISSET((int)cpu, &isolated) && CPU_ISSET((int)cpu, &nohz_full))
+			tag = " (isolated, nohz_full)";
+		else if (CPU_ISSET((int)cpu, &isolated))
+			tag = " (isolated)";
+		else if (CPU_ISSET((int)cpu, &nohz_full))
+			tag = " (nohz_full)";
+#endif
+		pr_inf_lock(lock, "%s:   cpu %3u: %10" PRIu64 " samples, mean %.2f ns, "
+			"max %" PRId64 " ns%s\n", name, cpu, c->count,
+			c->ns / (double)c->count, c->max_ns, tag);
+	}
+}
+
+/*
+ *  stress_cyclic_load()
+ *	adversarial load run alongside the real time child at normal
+ *	priority, it streams over a buffer larger than the caches to
+ *	contend for memory bandwidth and/or writes and syncs a file to
+ *	cause I/O completion interrupts
+ */
+static void NORETURN stress_cyclic_load(
+	const stress_args_t *args,
+	const int cyclic_load,
+	const char *filename)
+{
+	uint8_t *buf = MAP_FAILED;
+	int fd = -1;
+	off_t offset = 0;
+
+	if (cyclic_load & CYCLIC_LOAD_MEM) {
+		buf = (uint8_t *)mmap(NULL, CYCLIC_LOAD_MEM_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			pr_inf("%s: cannot mmap memory load buffer, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+	}
+	if (cyclic_load & CYCLIC_LOAD_IO) {
+		fd = open(filename, O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR);
+		if (fd < 0)
+			pr_inf("%s: cannot open I/O load file %s, errno=%d (%s)\n",
+				args->name, filename, errno, strerror(errno));
+		else
+			(void)unlink(filename);
+	}
+
+	while (keep_stressing_flag()) {
+		if (buf != MAP_FAILED) {
+			register volatile uint64_t *ptr;
+			register uint64_t sum = 0;
+			const uint64_t *end = (uint64_t *)(buf + CYCLIC_LOAD_MEM_SIZE);
+
+			(void)memset(buf, stress_mwc8(), CYCLIC_LOAD_MEM_SIZE);
+			for (ptr = (volatile uint64_t *)buf; ptr < end; ptr += 8)
+				sum += *ptr;
+			stress_uint64_put(sum);
+		}
+		if (fd >= 0) {
+			static uint8_t data[CYCLIC_LOAD_IO_SIZE];
+
+			if (pwrite(fd, data, sizeof(data), offset) < 0)
+				break;
+			(void)shim_fdatasync(fd);
+			offset = (offset + (off_t)sizeof(data)) % (64 * MB);
+		}
+		if ((buf == MAP_FAILED) && (fd < 0))
+			break;
+	}
+	_exit(0);
+}
+
 /*
  *  stress_cyclic_supported()
  *      check if we can run this as root
@@ -611,6 +864,9 @@ static int stress_cyclic(const stress_args_t *args)
 	const size_t page_size = args->page_size;
 	const size_t size = (sizeof(*rt_stats) + page_size - 1) & (~(page_size - 1));
 	stress_cyclic_func func;
+	int cyclic_load = CYCLIC_LOAD_NONE;
+	pid_t load_pid = -1;
+	char filename[PATH_MAX];
 
 	timeout  = g_opt_timeout;
 	(void)stress_get_setting("cyclic-sleep", &cyclic_sleep);
@@ -618,6 +874,7 @@ static int stress_cyclic(const stress_args_t *args)
 	(void)stress_get_setting("cyclic-policy", &cyclic_policy);
 	(void)stress_get_setting("cyclic-dist", &cyclic_dist);
 	(void)stress_get_setting("cyclic-method", &cyclic_method);
+	(void)stress_get_setting("cyclic-load", &cyclic_load);
 
 	func = cyclic_method->func;
 	policy = policies[cyclic_policy].policy;
@@ -651,6 +908,7 @@ static int stress_cyclic(const stress_args_t *args)
 	}
 	rt_stats->min_ns = INT64_MAX;
 	rt_stats->max_ns = INT64_MIN;
+	rt_stats->hdr_max = INT64_MIN;
 	rt_stats->ns = 0.0;
 #if defined(HAVE_SCHED_GET_PRIORITY_MIN)
 	rt_stats->min_prio = sched_get_priority_min(policy);
@@ -673,6 +931,16 @@ static int stress_cyclic(const stress_args_t *args)
 	if (args->instance == 0)
 		pr_dbg("%s: using method '%s'\n", args->name, cyclic_method->name);
 
+	if (cyclic_load & CYCLIC_LOAD_IO) {
+		int ret = stress_temp_dir_mk_args(args);
+
+		if (ret < 0) {
+			(void)munmap((void *)rt_stats, size);
+			return exit_status(-ret);
+		}
+		(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 again:
@@ -796,8 +1064,29 @@ tidy:
 		ret = stress_set_sched(args->pid, policy, rt_stats->max_prio, true);
 		(void)ret;
 
+		if (cyclic_load != CYCLIC_LOAD_NONE) {
+			load_pid = fork();
+			if (load_pid == 0) {
+				(void)setpgid(0, g_pgrp);
+				stress_parent_died_alarm();
+#if defined(SCHED_OTHER)
+				/* The load runs at normal priority, not real time */
+				ret = stress_set_sched(getpid(), SCHED_OTHER, 0, true);
+				(void)ret;
+#endif
+				stress_cyclic_load(args, cyclic_load, filename);
+			} else if (load_pid < 0) {
+				pr_inf("%s: cannot fork adversarial load, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+			}
+		}
+
 		(void)pause();
 		(void)kill(pid, SIGKILL);
+		if (load_pid > 0) {
+			(void)kill(load_pid, SIGKILL);
+			(void)shim_waitpid(load_pid, &status, 0);
+		}
 #if defined(HAVE_ATOMIC)
 		__sync_fetch_and_sub(&g_shared->softlockup_count, 1);
 #endif
@@ -848,6 +1137,8 @@ tidy:
 					percentiles[i],
 					rt_stats->latencies[j]);
 			}
+			stress_cyclic_hdr_report(args->name, &lock, rt_stats);
+			stress_cyclic_cpu_report(args->name, &lock, rt_stats);
 			stress_rt_dist(args->name, &lock, rt_stats, (int64_t)cyclic_dist);
 			pr_unlock(&lock);
 		} else {
@@ -860,6 +1151,11 @@ tidy:
 finish:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+	if (cyclic_load & CYCLIC_LOAD_IO) {
+		(void)unlink(filename);
+		(void)stress_temp_dir_rm_args(args);
+	}
+
 	(void)munmap((void *)rt_stats, size);
 
 	return EXIT_SUCCESS;
@@ -867,6 +1163,7 @@ finish:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_cyclic_dist,	stress_set_cyclic_dist },
+	{ OPT_cyclic_load,	stress_set_cyclic_load },
 	{ OPT_cyclic_method,	stress_set_cyclic_method },
 	{ OPT_cyclic_policy,	stress_set_cyclic_policy },
 	{ OPT_cyclic_prio, 	stress_set_cyclic_prio },
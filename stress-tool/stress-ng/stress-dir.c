@@ -28,6 +28,9 @@ static const stress_help_t help[] = {
 	{ NULL,	"dir N",	"start N directory thrashing stressors" },
 	{ NULL,	"dir-ops N",	"stop after N directory bogo operations" },
 	{ NULL,	"dir-dirs N",	"select number of directories to exercise dir on" },
+	{ NULL,	"dir-scale",	"measure metadata ops/s and latency by number of workers" },
+	{ NULL,	"dir-scale-mode M", "scale directories [shared|private|all]" },
+	{ NULL,	"dir-scale-workers N", "scale up to N worker processes (default online CPUs)" },
 	{ NULL,	NULL,		NULL }
 };
 
@@ -45,6 +48,57 @@ static int stress_set_dir_dirs(const char *opt)
 	return stress_set_setting("dir-dirs", TYPE_ID_UINT64, &dir_dirs);
 }
 
+#define DIR_SCALE_MODE_SHARED	(0)	/* all workers in one directory */
+#define DIR_SCALE_MODE_PRIVATE	(1)	/* a directory per worker */
+#define DIR_SCALE_MODES		(2)
+
+static const char * const dir_scale_modes[] = { "shared", "private" };
+
+static int stress_set_dir_scale(const char *opt)
+{
+	bool dir_scale = true;
+
+	(void)opt;
+	return stress_set_setting("dir-scale", TYPE_ID_BOOL, &dir_scale);
+}
+
+/*
+ *  stress_set_dir_scale_mode()
+ *	set a mask of the scale directory modes from a name or all
+ */
+static int stress_set_dir_scale_mode(const char *opt)
+{
+	uint32_t mask = 0;
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		mask = (1U << DIR_SCALE_MODES) - 1;
+	} else {
+		for (i = 0; i < SIZEOF_ARRAY(dir_scale_modes); i++) {
+			if (!strcmp(opt, dir_scale_modes[i]))
+				mask = 1U << i;
+		}
+	}
+	if (mask)
+		return stress_set_setting("dir-scale-mode", TYPE_ID_UINT32, &mask);
+
+	(void)fprintf(stderr, "dir-scale-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(dir_scale_modes); i++)
+		(void)fprintf(stderr, " %s", dir_scale_modes[i]);
+	(void)fprintf(stderr, " all\n");
+	return -1;
+}
+
+static int stress_set_dir_scale_workers(const char *opt)
+{
+	uint32_t dir_scale_workers;
+
+	dir_scale_workers = stress_get_uint32(opt);
+	stress_check_range("dir-scale-workers", dir_scale_workers,
+		1, DIR_SCALE_WORKERS_MAX);
+	return stress_set_setting("dir-scale-workers", TYPE_ID_UINT32, &dir_scale_workers);
+}
+
 #if defined(__DragonFly__)
 #define d_reclen d_namlen
 #endif
@@ -273,6 +327,511 @@ static void stress_invalid_rmdir(const char *path)
 	(void)ret;
 }
 
+#define DIR_SCALE_OP_CREATE	(0)
+#define DIR_SCALE_OP_STAT	(1)
+#define DIR_SCALE_OP_RENAME	(2)
+#define DIR_SCALE_OP_UNLINK	(3)
+#define DIR_SCALE_OPS		(4)
+
+#define DIR_SCALE_STEPS		(7)	/* 1, 2, 4 .. 64 workers */
+#define DIR_SCALE_CELL_TIME	(0.5)	/* seconds per mode and workers */
+#define DIR_SCALE_BATCH		(32)	/* files per worker per round */
+#define DIR_SCALE_LAT_SUB	(4)	/* latency buckets per power of 2 */
+#define DIR_SCALE_LAT_BUCKETS	(64 * DIR_SCALE_LAT_SUB)
+
+static const char * const dir_scale_ops[] = { "create", "stat", "rename", "unlink" };
+
+typedef struct {
+	uint64_t ops[DIR_SCALE_OPS];
+	uint64_t lat[DIR_SCALE_OPS][DIR_SCALE_LAT_BUCKETS];
+	uint64_t lat_max[DIR_SCALE_OPS];
+} stress_dir_scale_stats_t;
+
+/* Shared with the worker processes */
+typedef struct {
+	volatile bool start;
+	volatile bool stop;
+	uint32_t ready;		/* workers waiting for start */
+	stress_dir_scale_stats_t stats[DIR_SCALE_WORKERS_MAX];
+} stress_dir_scale_t;
+
+#if defined(HAVE_SYS_VFS_H) &&	\
+    defined(HAVE_STATFS)
+typedef struct {
+	const unsigned long int magic;
+	const char *name;
+} stress_dir_fs_t;
+
+static const stress_dir_fs_t dir_fs_types[] = {
+	{ 0x9123683e,	"btrfs" },
+	{ 0x0000ef53,	"ext2/3/4" },
+	{ 0xf2f52010,	"f2fs" },
+	{ 0x00006969,	"nfs" },
+	{ 0x794c7630,	"overlayfs" },
+	{ 0x01021994,	"tmpfs" },
+	{ 0x58465342,	"xfs" },
+	{ 0x2fc12fc1,	"zfs" },
+};
+#endif
+
+/*
+ *  stress_dir_scale_fs()
+ *	name the filesystem type of path
+ */
+static void stress_dir_scale_fs(const char *path, char *name, const size_t len)
+{
+#if defined(HAVE_SYS_VFS_H) &&	\
+    defined(HAVE_STATFS)
+	struct statfs buf;
+	size_t i;
+
+	if (statfs(path, &buf) < 0) {
+		(void)shim_strlcpy(name, "unknown", len);
+		return;
+	}
+	for (i = 0; i < SIZEOF_ARRAY(dir_fs_types); i++) {
+		if ((unsigned long int)buf.f_type == dir_fs_types[i].magic) {
+			(void)shim_strlcpy(name, dir_fs_types[i].name, len);
+			return;
+		}
+	}
+	(void)snprintf(name, len, "0x%lx", (unsigned long int)buf.f_type);
+#else
+	(void)path;
+	(void)shim_strlcpy(name, "unknown", len);
+#endif
+}
+
+/*
+ *  stress_dir_scale_lat_bucket()
+ *	map a latency in nanoseconds to a histogram bucket,
+ *	DIR_SCALE_LAT_SUB buckets per power of 2
+ */
+static inline size_t stress_dir_scale_lat_bucket(const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0;
+
+	if (ns < DIR_SCALE_LAT_SUB)
+		return (size_t)ns;
+	for (v = ns; v > 1; v >>= 1)
+		msb++;
+	return ((msb - 1) * DIR_SCALE_LAT_SUB) +
+		(size_t)((ns >> (msb - 2)) & (DIR_SCALE_LAT_SUB - 1));
+}
+
+/*
+ *  stress_dir_scale_lat_value()
+ *	upper bound in nanoseconds of a latency histogram bucket
+ */
+static inline uint64_t stress_dir_scale_lat_value(const size_t bucket)
+{
+	const size_t msb = (bucket / DIR_SCALE_LAT_SUB) + 1;
+	const uint64_t sub = (uint64_t)(bucket % DIR_SCALE_LAT_SUB);
+
+	if (bucket < DIR_SCALE_LAT_SUB)
+		return (uint64_t)bucket;
+	return ((DIR_SCALE_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  stress_dir_scale_lat_add()
+ *	account an operation that started at t_start ns
+ */
+static inline void stress_dir_scale_lat_add(
+	stress_dir_scale_stats_t *stats,
+	const int op,
+	const double t_start)
+{
+	const uint64_t ns = (uint64_t)(stress_time_now_ns() - t_start);
+
+	stats->ops[op]++;
+	stats->lat[op][stress_dir_scale_lat_bucket(ns)]++;
+	if (ns > stats->lat_max[op])
+		stats->lat_max[op] = ns;
+}
+
+/*
+ *  stress_dir_scale_lat_percentile()
+ *	latency in nanoseconds of a percentile of an operation
+ */
+static uint64_t stress_dir_scale_lat_percentile(
+	const stress_dir_scale_stats_t *stats,
+	const int op,
+	const double percentile)
+{
+	const uint64_t target = (uint64_t)ceil(((double)stats->ops[op] * percentile) / 100.0);
+	uint64_t sum = 0;
+	size_t b = 0;
+
+	while ((b < DIR_SCALE_LAT_BUCKETS - 1) && (sum + stats->lat[op][b] < target))
+		sum += stats->lat[op][b++];
+	return STRESS_MINIMUM(stress_dir_scale_lat_value(b), stats->lat_max[op]);
+}
+
+/*
+ *  stress_dir_scale_worker()
+ *	create, stat, rename and unlink a batch of files per round in
+ *	dir until told to stop, accounting the latency of each call
+ */
+static void stress_dir_scale_worker(
+	const stress_args_t *args,
+	stress_dir_scale_t *scale,
+	const char *dir,
+	const uint32_t id)
+{
+	stress_dir_scale_stats_t *stats = &scale->stats[id];
+	static char names[DIR_SCALE_BATCH][PATH_MAX];
+	static char renames[DIR_SCALE_BATCH][PATH_MAX];
+	bool created[DIR_SCALE_BATCH];
+	uint32_t round = 0;
+
+	(void)__atomic_fetch_add(&scale->ready, 1, __ATOMIC_RELEASE);
+	while (!scale->start && !scale->stop && keep_stressing_flag())
+		(void)shim_usleep(1000);
+
+	while (!scale->stop && keep_stressing_flag()) {
+		struct stat statbuf;
+		double t;
+		int i, fd;
+
+		for (i = 0; i < DIR_SCALE_BATCH; i++) {
+			(void)snprintf(names[i], sizeof(names[i]), "%s/c%" PRIu32 "-%" PRIu32 "-%d",
+				dir, id, round, i);
+			(void)snprintf(renames[i], sizeof(renames[i]), "%s/r%" PRIu32 "-%" PRIu32 "-%d",
+				dir, id, round, i);
+			t = stress_time_now_ns();
+			fd = open(names[i], O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+			created[i] = (fd >= 0);
+			if (fd < 0) {
+				if ((errno != ENOSPC) && (errno != ENOMEM))
+					pr_fail("%s: create %s failed, errno=%d (%s)\n",
+						args->name, names[i], errno, strerror(errno));
+				continue;
+			}
+			(void)close(fd);
+			stress_dir_scale_lat_add(stats, DIR_SCALE_OP_CREATE, t);
+		}
+		for (i = 0; i < DIR_SCALE_BATCH; i++) {
+			if (!created[i])
+				continue;
+			t = stress_time_now_ns();
+			if (stat(names[i], &statbuf) == 0)
+				stress_dir_scale_lat_add(stats, DIR_SCALE_OP_STAT, t);
+		}
+		for (i = 0; i < DIR_SCALE_BATCH; i++) {
+			if (!created[i])
+				continue;
+			t = stress_time_now_ns();
+			if (rename(names[i], renames[i]) == 0)
+				stress_dir_scale_lat_add(stats, DIR_SCALE_OP_RENAME, t);
+			else
+				(void)shim_strlcpy(renames[i], names[i], sizeof(renames[i]));
+		}
+		for (i = 0; i < DIR_SCALE_BATCH; i++) {
+			if (!created[i])
+				continue;
+			t = stress_time_now_ns();
+			if (unlink(renames[i]) == 0)
+				stress_dir_scale_lat_add(stats, DIR_SCALE_OP_UNLINK, t);
+		}
+		round++;
+	}
+}
+
+/*
+ *  stress_dir_scale_tidy()
+ *	remove any files left in dir and then dir
+ */
+static void stress_dir_scale_tidy(const char *dir)
+{
+	DIR *dp;
+	struct dirent *de;
+
+	dp = opendir(dir);
+	if (dp) {
+		while ((de = readdir(dp)) != NULL) {
+			char filename[PATH_MAX];
+
+			if (stress_is_dot_filename(de->d_name))
+				continue;
+			stress_mk_filename(filename, sizeof(filename), dir, de->d_name);
+			(void)unlink(filename);
+		}
+		(void)closedir(dp);
+	}
+	(void)rmdir(dir);
+}
+
+/*
+ *  stress_dir_scale_cell()
+ *	run n worker processes in the shared directory or in a
+ *	directory each for DIR_SCALE_CELL_TIME seconds and add
+ *	their stats to total, returns the number of ops, 0 if
+ *	not all of the workers ran
+ */
+static uint64_t stress_dir_scale_cell(
+	const stress_args_t *args,
+	stress_dir_scale_t *scale,
+	const char *pathname,
+	const int mode,
+	uint32_t n,
+	stress_dir_scale_stats_t *total,
+	double *duration)
+{
+	static char dirs[DIR_SCALE_WORKERS_MAX][PATH_MAX + 32];
+	pid_t pids[DIR_SCALE_WORKERS_MAX];
+	uint32_t i, started = 0, wanted = n;
+	uint64_t ops = 0;
+	double t_start, t_end;
+	int op;
+	size_t b;
+
+	(void)memset(scale, 0, sizeof(*scale));
+	for (i = 0; i < n; i++) {
+		if ((mode == DIR_SCALE_MODE_SHARED) && (i > 0)) {
+			(void)shim_strlcpy(dirs[i], dirs[0], sizeof(dirs[i]));
+			continue;
+		}
+		(void)snprintf(dirs[i], sizeof(dirs[i]), "%s/%s%" PRIu32, pathname,
+			dir_scale_modes[mode], i);
+		if ((mkdir(dirs[i], S_IRWXU) < 0) && (errno != EEXIST)) {
+			pr_fail("%s: mkdir %s failed, errno=%d (%s)\n",
+				args->name, dirs[i], errno, strerror(errno));
+			n = i;
+			break;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0) {
+			stress_parent_died_alarm();
+			(void)sched_settings_apply(true);
+			stress_dir_scale_worker(args, scale, dirs[i], i);
+			_exit(0);
+		}
+		if (pids[i] > 0)
+			started++;
+	}
+
+	/* Start everyone together once they are ready */
+	while (keep_stressing_flag() &&
+	       (__atomic_load_n(&scale->ready, __ATOMIC_ACQUIRE) < started))
+		(void)shim_usleep(1000);
+	t_start = stress_time_now();
+	scale->start = true;
+	while (keep_stressing_flag() &&
+	       (stress_time_now() - t_start < DIR_SCALE_CELL_TIME))
+		(void)shim_usleep(10000);
+	scale->stop = true;
+	t_end = stress_time_now();
+
+	for (i = 0; i < n; i++) {
+		if (pids[i] > 0) {
+			int status;
+
+			(void)shim_waitpid(pids[i], &status, 0);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if ((mode == DIR_SCALE_MODE_PRIVATE) || (i == 0))
+			stress_dir_scale_tidy(dirs[i]);
+	}
+
+	if (!started || (started != wanted))
+		return 0;
+	for (i = 0; i < n; i++) {
+		const stress_dir_scale_stats_t *s = &scale->stats[i];
+
+		for (op = 0; op < DIR_SCALE_OPS; op++) {
+			ops += s->ops[op];
+			total->ops[op] += s->ops[op];
+			for (b = 0; b < DIR_SCALE_LAT_BUCKETS; b++)
+				total->lat[op][b] += s->lat[op][b];
+			if (s->lat_max[op] > total->lat_max[op])
+				total->lat_max[op] = s->lat_max[op];
+		}
+	}
+	*duration += t_end - t_start;
+
+	return ops;
+}
+
+/*
+ *  stress_dir_scale_report()
+ *	report the metadata ops/s by number of workers and the
+ *	latency percentiles of each operation for each mode
+ */
+static void stress_dir_scale_report(
+	const stress_args_t *args,
+	const char *pathname,
+	const uint32_t *workers,
+	const size_t n_steps,
+	stress_dir_scale_stats_t stats[][DIR_SCALE_STEPS],
+	double durations[][DIR_SCALE_STEPS])
+{
+	const size_t last = n_steps - 1;
+	char fs[32], line[256], desc[32];
+	bool lock = false;
+	size_t s, pos;
+	int mode, op, idx = 0;
+
+	stress_dir_scale_fs(pathname, fs, sizeof(fs));
+
+	pr_lock(&lock);
+	for (mode = 0; mode < DIR_SCALE_MODES; mode++) {
+		if (durations[mode][0] <= 0.0)
+			continue;
+
+		/* Rates and tail latencies of the most workers */
+		if (durations[mode][last] > 0.0) {
+			const stress_dir_scale_stats_t *st = &stats[mode][last];
+			uint64_t ops = 0;
+
+			for (op = 0; op < DIR_SCALE_OPS; op++)
+				ops += st->ops[op];
+			(void)snprintf(desc, sizeof(desc), "%s ops/s x%" PRIu32,
+				dir_scale_modes[mode], workers[last]);
+			stress_misc_stats_set(args->misc_stats, idx++, desc,
+				(double)ops / durations[mode][last]);
+			for (op = 0; op < DIR_SCALE_OPS; op++) {
+				if (!st->ops[op])
+					continue;
+				(void)snprintf(desc, sizeof(desc), "%s %s p99 usec",
+					dir_scale_modes[mode], dir_scale_ops[op]);
+				stress_misc_stats_set(args->misc_stats, idx++, desc,
+					(double)stress_dir_scale_lat_percentile(st, op, 99.0) / 1000.0);
+			}
+		}
+
+		if (args->instance != 0)
+			continue;
+
+		pr_inf_lock(&lock, "%s: %s directory metadata ops/s by workers, "
+			"%s filesystem\n", args->name, dir_scale_modes[mode], fs);
+		pos = (size_t)snprintf(line, sizeof(line), "%-7s", "op");
+		for (s = 0; s < n_steps; s++)
+			pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %10" PRIu32, workers[s]);
+		(void)snprintf(line + pos, sizeof(line) - pos, " %8s", "scaling");
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		for (op = 0; op < DIR_SCALE_OPS; op++) {
+			double first = 0.0, rate = 0.0;
+
+			pos = (size_t)snprintf(line, sizeof(line), "%-7s", dir_scale_ops[op]);
+			for (s = 0; s < n_steps; s++) {
+				const double d = durations[mode][s];
+
+				rate = (d > 0.0) ? (double)stats[mode][s].ops[op] / d : 0.0;
+				if (s == 0)
+					first = rate;
+				if (d > 0.0)
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %10.0f", rate);
+				else
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %10s", "n/a");
+			}
+			if ((first > 0.0) && (rate > 0.0))
+				(void)snprintf(line + pos, sizeof(line) - pos, " %7.2fx", rate / first);
+			else
+				(void)snprintf(line + pos, sizeof(line) - pos, " %8s", "n/a");
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+
+		pr_inf_lock(&lock, "%s: %s directory latency usec, %s filesystem\n",
+			args->name, dir_scale_modes[mode], fs);
+		pr_inf_lock(&lock, "%s: %-7s %7s %9s %9s %9s %9s %9s\n", args->name,
+			"op", "workers", "p50", "p90", "p99", "p99.9", "max");
+		for (op = 0; op < DIR_SCALE_OPS; op++) {
+			for (s = 0; s < n_steps; s++) {
+				const stress_dir_scale_stats_t *st = &stats[mode][s];
+
+				if (!st->ops[op])
+					continue;
+				pr_inf_lock(&lock, "%s: %-7s %7" PRIu32 " %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+					args->name, dir_scale_ops[op], workers[s],
+					(double)stress_dir_scale_lat_percentile(st, op, 50.0) / 1000.0,
+					(double)stress_dir_scale_lat_percentile(st, op, 90.0) / 1000.0,
+					(double)stress_dir_scale_lat_percentile(st, op, 99.0) / 1000.0,
+					(double)stress_dir_scale_lat_percentile(st, op, 99.9) / 1000.0,
+					(double)st->lat_max[op] / 1000.0);
+			}
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_dir_scale()
+ *	measure create, stat, rename and unlink rates and latencies
+ *	with doubling numbers of worker processes all in one shared
+ *	directory or each in their own directory
+ */
+static int stress_dir_scale(const stress_args_t *args)
+{
+	static stress_dir_scale_stats_t stats[DIR_SCALE_MODES][DIR_SCALE_STEPS];
+	static double durations[DIR_SCALE_MODES][DIR_SCALE_STEPS];
+	uint32_t mode_mask = (1U << DIR_SCALE_MODES) - 1;
+	uint32_t dir_scale_workers, workers[DIR_SCALE_STEPS];
+	const int32_t cpus = stress_get_processors_online();
+	stress_dir_scale_t *scale;
+	char pathname[PATH_MAX];
+	size_t n_steps = 0, s;
+	int ret, mode;
+
+	(void)stress_get_setting("dir-scale-mode", &mode_mask);
+	dir_scale_workers = (cpus < 2) ? 2 : (uint32_t)cpus;
+	if (dir_scale_workers > DIR_SCALE_WORKERS_MAX)
+		dir_scale_workers = DIR_SCALE_WORKERS_MAX;
+	(void)stress_get_setting("dir-scale-workers", &dir_scale_workers);
+
+	/* 1, 2, 4 .. workers, ending with dir_scale_workers */
+	for (s = 1; (s < dir_scale_workers) && (n_steps < DIR_SCALE_STEPS - 1); s <<= 1)
+		workers[n_steps++] = (uint32_t)s;
+	workers[n_steps++] = dir_scale_workers;
+
+	scale = (stress_dir_scale_t *)mmap(NULL, sizeof(*scale),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (scale == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap scale stats, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_temp_dir(pathname, sizeof(pathname), args->name, args->pid, args->instance);
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		(void)munmap((void *)scale, sizeof(*scale));
+		return exit_status(-ret);
+	}
+
+	(void)memset(stats, 0, sizeof(stats));
+	(void)memset(durations, 0, sizeof(durations));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	/* Sweep the modes and workers until the run ends */
+	do {
+		for (mode = 0; mode < DIR_SCALE_MODES; mode++) {
+			if (!(mode_mask & (1U << mode)))
+				continue;
+			for (s = 0; keep_stressing(args) && (s < n_steps); s++) {
+				const uint64_t ops = stress_dir_scale_cell(args, scale,
+					pathname, mode, workers[s], &stats[mode][s],
+					&durations[mode][s]);
+
+				add_counter(args, ops);
+			}
+		}
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_dir_scale_report(args, pathname, workers, n_steps, stats, durations);
+
+	(void)stress_temp_dir_rm_args(args);
+	(void)munmap((void *)scale, sizeof(*scale));
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_dir
  *	stress directory mkdir and rmdir
@@ -284,6 +843,11 @@ static int stress_dir(const stress_args_t *args)
 	char pathname[PATH_MAX];
 	int dir_fd = -1;
 	const int bad_fd = stress_get_bad_fd();
+	bool dir_scale = false;
+
+	(void)stress_get_setting("dir-scale", &dir_scale);
+	if (dir_scale)
+		return stress_dir_scale(args);
 
 	stress_temp_dir(pathname, sizeof(pathname), args->name, args->pid, args->instance);
 	(void)stress_get_setting("dir-dirs", &dir_dirs);
@@ -360,8 +924,11 @@ static int stress_dir(const stress_args_t *args)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
-	{ OPT_dir_dirs,	stress_set_dir_dirs },
-	{ 0,		NULL }
+	{ OPT_dir_dirs,		stress_set_dir_dirs },
+	{ OPT_dir_scale,	stress_set_dir_scale },
+	{ OPT_dir_scale_mode,	stress_set_dir_scale_mode },
+	{ OPT_dir_scale_workers, stress_set_dir_scale_workers },
+	{ 0,			NULL }
 };
 
 stressor_info_t stress_dir_info = {
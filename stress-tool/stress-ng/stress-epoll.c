@@ -23,18 +23,54 @@
  *
  */
 #include "stress-ng.h"
+#include "io-uring.h"
 
 static const stress_help_t help[] = {
 	{ NULL,	"epoll N",	  "start N workers doing epoll handled socket activity" },
+	{ NULL,	"epoll-conns N",  "keep N concurrent connections in scale mode" },
+	{ NULL,	"epoll-domain D", "specify socket domain, default is unix" },
+	{ NULL,	"epoll-method M", "scale mode event method: exclusive, reuseport, uring or all" },
 	{ NULL,	"epoll-ops N",	  "stop after N epoll bogo operations" },
 	{ NULL,	"epoll-port P",	  "use socket ports P upwards" },
-	{ NULL,	"epoll-domain D", "specify socket domain, default is unix" },
+	{ NULL,	"epoll-scale",	  "measure connection and request throughput of threaded servers" },
+	{ NULL,	"epoll-threads N", "use N server threads in scale mode" },
 	{ NULL,	NULL,		  NULL }
 };
 
 #define MAX_EPOLL_EVENTS 	(1024)
 #define MAX_SERVERS		(4)
 
+#define MIN_EPOLL_THREADS	(1)
+#define MAX_EPOLL_THREADS	(256)
+#define DEFAULT_EPOLL_THREADS	(4)
+
+#define MIN_EPOLL_CONNS		(1)
+#define MAX_EPOLL_CONNS		(100000)
+#define DEFAULT_EPOLL_CONNS	(1024)
+
+#define EPOLL_METHOD_ALL	(0)
+#define EPOLL_METHOD_EXCLUSIVE	(1)	/* one listener, EPOLLEXCLUSIVE wakeups */
+#define EPOLL_METHOD_REUSEPORT	(2)	/* a SO_REUSEPORT listener per thread */
+#define EPOLL_METHOD_URING	(3)	/* as reuseport, io-uring multishot poll */
+
+/* indexed by EPOLL_METHOD_* - 1 */
+static const char * const epoll_methods[] = {
+	"exclusive",
+	"reuseport",
+	"uring",
+};
+
+#define EPOLL_METHODS		SIZEOF_ARRAY(epoll_methods)
+
+#define EPOLL_SCALE_SLICE	(2.0)	/* seconds per method per measurement */
+#define EPOLL_SCALE_MSG		(64)	/* request and response size */
+#define EPOLL_SCALE_REQS	(32)	/* requests per connection before reconnecting */
+#define EPOLL_SCALE_CONNECTING	(64)	/* connects in flight per client thread */
+#define EPOLL_SCALE_SRC_ADDRS	(16)	/* ipv4 loopback source addresses */
+#define EPOLL_SCALE_FD_SLACK	(64)	/* fds kept for everything else */
+#define EPOLL_LAT_SUB		(4)	/* latency buckets per power of 2 */
+#define EPOLL_LAT_BUCKETS	(64 * EPOLL_LAT_SUB)
+
 #if defined(HAVE_SYS_EPOLL_H) &&	\
     defined(HAVE_EPOLL_CREATE) &&	\
     defined(HAVE_LIB_RT) &&		\
@@ -96,9 +132,63 @@ static int stress_set_epoll_domain(const char *name)
 	return ret;
 }
 
+static int stress_set_epoll_conns(const char *opt)
+{
+	size_t epoll_conns;
+
+	epoll_conns = (size_t)stress_get_uint64(opt);
+	stress_check_range("epoll-conns", (uint64_t)epoll_conns,
+		MIN_EPOLL_CONNS, MAX_EPOLL_CONNS);
+	return stress_set_setting("epoll-conns", TYPE_ID_SIZE_T, &epoll_conns);
+}
+
+static int stress_set_epoll_method(const char *opt)
+{
+	size_t i;
+	int epoll_method;
+
+	if (!strcmp(opt, "all")) {
+		epoll_method = EPOLL_METHOD_ALL;
+		return stress_set_setting("epoll-method", TYPE_ID_INT, &epoll_method);
+	}
+	for (i = 0; i < EPOLL_METHODS; i++) {
+		if (!strcmp(opt, epoll_methods[i])) {
+			epoll_method = (int)i + 1;
+			return stress_set_setting("epoll-method", TYPE_ID_INT, &epoll_method);
+		}
+	}
+	(void)fprintf(stderr, "epoll-method must be one of: all");
+	for (i = 0; i < EPOLL_METHODS; i++)
+		(void)fprintf(stderr, " %s", epoll_methods[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_epoll_scale(const char *opt)
+{
+	bool epoll_scale = true;
+
+	(void)opt;
+	return stress_set_setting("epoll-scale", TYPE_ID_BOOL, &epoll_scale);
+}
+
+static int stress_set_epoll_threads(const char *opt)
+{
+	size_t epoll_threads;
+
+	epoll_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("epoll-threads", (uint64_t)epoll_threads,
+		MIN_EPOLL_THREADS, MAX_EPOLL_THREADS);
+	return stress_set_setting("epoll-threads", TYPE_ID_SIZE_T, &epoll_threads);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_epoll_conns,	stress_set_epoll_conns },
 	{ OPT_epoll_domain,	stress_set_epoll_domain },
+	{ OPT_epoll_method,	stress_set_epoll_method },
 	{ OPT_epoll_port,	stress_set_epoll_port },
+	{ OPT_epoll_scale,	stress_set_epoll_scale },
+	{ OPT_epoll_threads,	stress_set_epoll_threads },
 	{ 0,			NULL }
 };
 
@@ -947,6 +1037,1227 @@ die:
 	_exit(rc);
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+#define STRESS_EPOLL_SCALE
+#endif
+
+#if defined(STRESS_EPOLL_SCALE) &&		\
+    defined(HAVE_LINUX_IO_URING_H) &&		\
+    defined(__NR_io_uring_setup) &&		\
+    defined(__NR_io_uring_enter) &&		\
+    defined(IORING_OFF_SQ_RING) &&		\
+    defined(IORING_OFF_CQ_RING) &&		\
+    defined(IORING_OFF_SQES) &&			\
+    defined(IORING_ENTER_GETEVENTS) &&		\
+    defined(IORING_SETUP_CQSIZE) &&		\
+    defined(IORING_POLL_ADD_MULTI) &&		\
+    defined(IORING_CQE_F_MORE) &&		\
+    defined(HAVE_IORING_OP_POLL_ADD) &&		\
+    defined(HAVE_IORING_OP_POLL_REMOVE)
+#define STRESS_EPOLL_IO_URING
+#endif
+
+#if defined(STRESS_EPOLL_SCALE)
+
+/* io-uring user_data tags, connections are tagged (generation << 32) | fd */
+#define EPOLL_URING_IGNORE	(1ULL << 63)
+#define EPOLL_URING_LISTEN	(1ULL << 62)
+#define EPOLL_URING_STOP	(1ULL << 61)
+
+/* server side state of a connection, indexed by fd */
+typedef struct {
+	uint64_t ts;		/* client send time of the current request */
+	uint32_t gen;		/* io-uring generation of the fd */
+	uint8_t got;		/* bytes of the current request read so far */
+	bool open;		/* fd is a connection owned by a server thread */
+} stress_epoll_conn_t;
+
+typedef struct {
+	bool measured;		/* method ran at least once */
+	uint64_t accepts;
+	uint64_t requests;
+	double duration;	/* seconds measured */
+	uint64_t lat[EPOLL_LAT_BUCKETS];
+} stress_epoll_scale_stats_t;
+
+typedef struct {
+	const stress_args_t *args;
+	int method;		/* EPOLL_METHOD_* */
+	int efd;		/* epoll fd of this thread, or -1 */
+	int lfd;		/* listening socket this thread accepts on */
+	int stop_fd;		/* read end of the stop pipe */
+	size_t conns;		/* connections it may have to poll */
+	int err;		/* errno of a failure, 0 if none */
+	stress_epoll_scale_stats_t stats;
+} stress_epoll_server_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	stress_epoll_server_t info;
+} stress_epoll_server_pthread_t;
+
+/* client side state of a connection */
+typedef struct {
+	int fd;			/* socket, -1 when idle */
+	uint8_t got;		/* bytes of the current response read so far */
+	uint8_t reqs;		/* requests made on this connection */
+	bool connecting;	/* waiting for the connect to complete */
+} stress_epoll_slot_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	int domain;
+	struct sockaddr_storage addr;	/* server address */
+	socklen_t addr_len;
+	stress_epoll_slot_t *slots;
+	uint32_t n_slots;
+} stress_epoll_client_t;
+
+static stress_epoll_conn_t *epoll_conn_table;
+static size_t epoll_conn_max;		/* fds that epoll_conns can index */
+
+/*
+ *  stress_epoll_now_ns()
+ *	monotonic time in nanoseconds, comparable between processes
+ */
+static inline uint64_t stress_epoll_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_epoll_lat_bucket()
+ *	map a latency in nanoseconds to a log2 histogram bucket with
+ *	EPOLL_LAT_SUB buckets per power of 2
+ */
+static inline size_t stress_epoll_lat_bucket(const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0;
+
+	if (ns < EPOLL_LAT_SUB)
+		return (size_t)ns;
+	for (v = ns; v > 1; v >>= 1)
+		msb++;
+	return ((msb - 1) * EPOLL_LAT_SUB) +
+		(size_t)((ns >> (msb - 2)) & (EPOLL_LAT_SUB - 1));
+}
+
+/*
+ *  stress_epoll_lat_value()
+ *	upper bound in nanoseconds of a latency histogram bucket
+ */
+static inline uint64_t stress_epoll_lat_value(const size_t bucket)
+{
+	const size_t msb = (bucket / EPOLL_LAT_SUB) + 1;
+	const uint64_t sub = (uint64_t)(bucket % EPOLL_LAT_SUB);
+
+	if (bucket < EPOLL_LAT_SUB)
+		return (uint64_t)bucket;
+	return ((EPOLL_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  stress_epoll_percentile()
+ *	event latency in microseconds below which pct percent of requests are
+ */
+static double stress_epoll_percentile(const stress_epoll_scale_stats_t *stats, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)stats->requests * pct) / 100.0);
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < EPOLL_LAT_BUCKETS; i++) {
+		sum += stats->lat[i];
+		if (sum > target)
+			return (double)stress_epoll_lat_value(i) / 1000.0;
+	}
+	return 0.0;
+}
+
+/*
+ *  stress_epoll_raise_nofile()
+ *	raise the open file limit to its hard limit, returns the limit
+ */
+static size_t stress_epoll_raise_nofile(void)
+{
+	struct rlimit rlim;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0)
+		return 1024;
+	if (rlim.rlim_cur < rlim.rlim_max) {
+		rlim.rlim_cur = rlim.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &rlim) < 0)
+			(void)getrlimit(RLIMIT_NOFILE, &rlim);
+	}
+	/* Keep the connection table to a sane size */
+	if (rlim.rlim_cur > 4 * MAX_EPOLL_CONNS)
+		return 4 * MAX_EPOLL_CONNS;
+	return (size_t)rlim.rlim_cur;
+}
+
+/*
+ *  stress_epoll_scale_accept()
+ *	accept all pending connections on ctx->lfd, returns the new
+ *	fds through accepted, up to max of them
+ */
+static int stress_epoll_scale_accept(stress_epoll_server_t *ctx, int *accepted, const int max)
+{
+	int n = 0;
+
+	while (n < max) {
+		const int fd = accept(ctx->lfd, NULL, NULL);
+
+		if (fd < 0)
+			break;
+		if (((size_t)fd >= epoll_conn_max) ||
+		    (epoll_set_fd_nonblock(fd) < 0)) {
+			(void)close(fd);
+			continue;
+		}
+		epoll_conn_table[fd].got = 0;
+		epoll_conn_table[fd].open = true;
+		ctx->stats.accepts++;
+		accepted[n++] = fd;
+	}
+	return n;
+}
+
+/*
+ *  stress_epoll_scale_request()
+ *	read what has arrived of a request on fd, answer it once it is
+ *	complete, returns -1 if the connection should be closed
+ */
+static int stress_epoll_scale_request(stress_epoll_scale_stats_t *stats, const int fd)
+{
+	static const char response[EPOLL_SCALE_MSG];
+	stress_epoll_conn_t *conn = &epoll_conn_table[fd];
+	char buf[EPOLL_SCALE_MSG];
+	ssize_t n;
+
+	n = recv(fd, buf, EPOLL_SCALE_MSG - conn->got, 0);
+	if (n < 0)
+		return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+	if (n == 0)
+		return -1;
+
+	/* The send time is the first 8 bytes of the request */
+	if (conn->got < sizeof(conn->ts)) {
+		const size_t len = STRESS_MINIMUM((size_t)n, sizeof(conn->ts) - conn->got);
+
+		(void)memcpy((uint8_t *)&conn->ts + conn->got, buf, len);
+	}
+	conn->got += (uint8_t)n;
+	if (conn->got < EPOLL_SCALE_MSG)
+		return 0;
+
+	conn->got = 0;
+	stats->requests++;
+	stats->lat[stress_epoll_lat_bucket(stress_epoll_now_ns() - conn->ts)]++;
+#if defined(MSG_NOSIGNAL)
+	n = send(fd, response, sizeof(response), MSG_NOSIGNAL);
+#else
+	n = send(fd, response, sizeof(response), 0);
+#endif
+	return (n == (ssize_t)sizeof(response)) ? 0 : -1;
+}
+
+/*
+ *  stress_epoll_scale_close()
+ *	close a connection of a server thread
+ */
+static void stress_epoll_scale_close(const int fd)
+{
+	epoll_conn_table[fd].open = false;
+	(void)close(fd);
+}
+
+/*
+ *  stress_epoll_scale_server()
+ *	epoll event loop of a server thread, for the exclusive and
+ *	reuseport methods, until the stop pipe becomes readable
+ */
+static void *stress_epoll_scale_server(void *arg)
+{
+	static void *nowt = NULL;
+	stress_epoll_server_pthread_t *pthread = (stress_epoll_server_pthread_t *)arg;
+	stress_epoll_server_t *ctx = &pthread->info;
+	struct epoll_event *events;
+	int *accepted;
+
+	events = calloc(MAX_EPOLL_EVENTS, sizeof(*events));
+	accepted = calloc(MAX_EPOLL_EVENTS, sizeof(*accepted));
+	if (!events || !accepted) {
+		ctx->err = ENOMEM;
+		goto done;
+	}
+
+	for (;;) {
+		int i, n;
+
+		n = epoll_wait(ctx->efd, events, MAX_EPOLL_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			ctx->err = errno;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			const int fd = events[i].data.fd;
+
+			if (fd == ctx->stop_fd)
+				goto done;
+			if (fd == ctx->lfd) {
+				int j, got;
+
+				do {
+					got = stress_epoll_scale_accept(ctx, accepted, MAX_EPOLL_EVENTS);
+					for (j = 0; j < got; j++) {
+						if (epoll_ctl_add(ctx->efd, accepted[j], EPOLLIN) < 0)
+							stress_epoll_scale_close(accepted[j]);
+					}
+				} while (got == MAX_EPOLL_EVENTS);
+				continue;
+			}
+			if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+			    (stress_epoll_scale_request(&ctx->stats, fd) < 0))
+				stress_epoll_scale_close(fd);
+		}
+	}
+done:
+	free(accepted);
+	free(events);
+	return &nowt;
+}
+
+#if defined(STRESS_EPOLL_IO_URING)
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+/*
+ *  minimal io-uring for multishot polls
+ */
+typedef struct {
+	int fd;			/* io-uring fd */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	unsigned sq_entries;
+	unsigned tail;		/* local tail of queued SQEs */
+	unsigned submitted;	/* SQEs consumed by the kernel */
+} stress_epoll_uring_t;
+
+/*
+ *  stress_epoll_uring_close()
+ *	tear down an io-uring, which also drops its polls
+ */
+static void stress_epoll_uring_close(stress_epoll_uring_t *ring)
+{
+	if (ring->sqes)
+		(void)munmap((void *)ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_epoll_uring_setup()
+ *	set up an io-uring of entries SQEs and cq_entries CQEs,
+ *	returns 0 or -1 with errno set
+ */
+static int stress_epoll_uring_setup(
+	stress_epoll_uring_t *ring,
+	const unsigned entries,
+	const unsigned cq_entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = cq_entries;
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_entries = p.sq_entries;
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sq_mmap = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto err;
+		ring->cq_mmap = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sqes = (struct io_uring_sqe *)ptr;
+
+	ring->sq_tail = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+	ring->submitted = ring->tail;
+
+	return 0;
+err:
+	err = errno;
+	stress_epoll_uring_close(ring);
+	errno = err;
+	return -1;
+}
+
+/*
+ *  stress_epoll_uring_enter()
+ *	submit the queued SQEs and wait for min_complete completions
+ */
+static int stress_epoll_uring_enter(stress_epoll_uring_t *ring, const unsigned min_complete)
+{
+	const unsigned to_submit = ring->tail - ring->submitted;
+	int ret;
+
+	*ring->sq_tail = ring->tail;
+	shim_mb();
+	ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit,
+		min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+	if (ret > 0)
+		ring->submitted += (unsigned)ret;
+	return ret;
+}
+
+/*
+ *  stress_epoll_uring_sqe()
+ *	get the next free SQE, submitting the queued ones if the
+ *	submission queue is full
+ */
+static struct io_uring_sqe *stress_epoll_uring_sqe(stress_epoll_uring_t *ring)
+{
+	unsigned idx;
+	struct io_uring_sqe *sqe;
+
+	while (ring->tail - ring->submitted >= ring->sq_entries) {
+		if ((stress_epoll_uring_enter(ring, 0) < 0) && (errno != EINTR))
+			return NULL;
+	}
+	idx = ring->tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	ring->sq_array[idx] = idx;
+	ring->tail++;
+	(void)memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+/*
+ *  stress_epoll_uring_poll()
+ *	arm a multishot poll for input on fd
+ */
+static int stress_epoll_uring_poll(stress_epoll_uring_t *ring, const int fd, const uint64_t tag)
+{
+	struct io_uring_sqe *sqe = stress_epoll_uring_sqe(ring);
+
+	if (!sqe)
+		return -1;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = tag;
+	return 0;
+}
+
+/*
+ *  stress_epoll_uring_unpoll()
+ *	cancel the poll tagged tag, its last completion is ignored
+ */
+static void stress_epoll_uring_unpoll(stress_epoll_uring_t *ring, const uint64_t tag)
+{
+	struct io_uring_sqe *sqe = stress_epoll_uring_sqe(ring);
+
+	if (!sqe)
+		return;
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = tag;
+	sqe->user_data = EPOLL_URING_IGNORE;
+}
+
+/*
+ *  stress_epoll_uring_tag()
+ *	user_data of the poll of connection fd
+ */
+static inline uint64_t stress_epoll_uring_tag(const int fd)
+{
+	return ((uint64_t)epoll_conn_table[fd].gen << 32) | (uint32_t)fd;
+}
+
+/*
+ *  stress_epoll_uring_server()
+ *	io-uring event loop of a server thread, every fd has a multishot
+ *	poll armed on the thread's ring
+ */
+static void *stress_epoll_uring_server(void *arg)
+{
+	static void *nowt = NULL;
+	stress_epoll_server_pthread_t *pthread = (stress_epoll_server_pthread_t *)arg;
+	stress_epoll_server_t *ctx = &pthread->info;
+	stress_epoll_uring_t ring;
+	unsigned cq_entries = 4096;
+	int *accepted;
+
+	while ((cq_entries < 65536) && (cq_entries < 2 * ctx->conns))
+		cq_entries <<= 1;
+	accepted = calloc(MAX_EPOLL_EVENTS, sizeof(*accepted));
+	if (!accepted) {
+		ctx->err = ENOMEM;
+		return &nowt;
+	}
+	if (stress_epoll_uring_setup(&ring, 1024, cq_entries) < 0) {
+		ctx->err = errno;
+		free(accepted);
+		return &nowt;
+	}
+	if ((stress_epoll_uring_poll(&ring, ctx->stop_fd, EPOLL_URING_STOP) < 0) ||
+	    (stress_epoll_uring_poll(&ring, ctx->lfd, EPOLL_URING_LISTEN) < 0)) {
+		ctx->err = errno;
+		goto done;
+	}
+
+	for (;;) {
+		unsigned head;
+
+		if (stress_epoll_uring_enter(&ring, 1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ctx->err = errno;
+			break;
+		}
+		shim_mb();
+		for (head = *ring.cq_head; head != *ring.cq_tail; head++) {
+			const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+			const uint64_t tag = cqe->user_data;
+			const int res = cqe->res;
+			const bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+			int fd;
+
+			if (tag & EPOLL_URING_IGNORE)
+				continue;
+			if (tag == EPOLL_URING_STOP)
+				goto done;
+			if (tag == EPOLL_URING_LISTEN) {
+				int j, got;
+
+				if (res < 0) {
+					/* EINVAL if multishot poll is not supported */
+					ctx->err = -res;
+					goto done;
+				}
+				do {
+					got = stress_epoll_scale_accept(ctx, accepted, MAX_EPOLL_EVENTS);
+					for (j = 0; j < got; j++) {
+						epoll_conn_table[accepted[j]].gen++;
+						if (stress_epoll_uring_poll(&ring, accepted[j],
+							stress_epoll_uring_tag(accepted[j])) < 0)
+							stress_epoll_scale_close(accepted[j]);
+					}
+				} while (got == MAX_EPOLL_EVENTS);
+				if (!more)
+					(void)stress_epoll_uring_poll(&ring, ctx->lfd, EPOLL_URING_LISTEN);
+				continue;
+			}
+
+			/* A completion of an earlier connection on a reused fd */
+			fd = (int)(tag & 0xffffffff);
+			if (((size_t)fd >= epoll_conn_max) ||
+			    !epoll_conn_table[fd].open ||
+			    (epoll_conn_table[fd].gen != (uint32_t)(tag >> 32)))
+				continue;
+			if ((res < 0) || (res & (POLLERR | POLLHUP)) ||
+			    (stress_epoll_scale_request(&ctx->stats, fd) < 0)) {
+				if (more)
+					stress_epoll_uring_unpoll(&ring, tag);
+				epoll_conn_table[fd].gen++;
+				stress_epoll_scale_close(fd);
+			} else if (!more) {
+				(void)stress_epoll_uring_poll(&ring, fd, tag);
+			}
+		}
+		*ring.cq_head = head;
+		shim_mb();
+	}
+done:
+	stress_epoll_uring_close(&ring);
+	free(accepted);
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_epoll_scale_connect()
+ *	start a non-blocking connect of a client slot, spreading
+ *	ipv4 connections over loopback source addresses so that
+ *	large connection counts don't run out of ephemeral ports
+ */
+static int stress_epoll_scale_connect(
+	stress_epoll_client_t *ctx,
+	const int efd,
+	const uint32_t idx)
+{
+	stress_epoll_slot_t *slot = &ctx->slots[idx];
+	struct epoll_event event;
+	struct linger linger;
+	int fd;
+
+	fd = socket(ctx->domain, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (epoll_set_fd_nonblock(fd) < 0)
+		goto err;
+	/* Reset rather than linger in TIME_WAIT when closed */
+	linger.l_onoff = 1;
+	linger.l_linger = 0;
+	(void)setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+#if defined(IP_BIND_ADDRESS_NO_PORT)
+	if (ctx->domain == AF_INET) {
+		struct sockaddr_in src;
+		int one = 1;
+
+		(void)memset(&src, 0, sizeof(src));
+		src.sin_family = AF_INET;
+		src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + (idx % EPOLL_SCALE_SRC_ADDRS));
+		(void)setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+		if (bind(fd, (struct sockaddr *)&src, sizeof(src)) < 0)
+			goto err;
+	}
+#endif
+	if ((connect(fd, (struct sockaddr *)&ctx->addr, ctx->addr_len) < 0) &&
+	    (errno != EINPROGRESS))
+		goto err;
+
+	(void)memset(&event, 0, sizeof(event));
+	event.events = EPOLLOUT | EPOLLIN;
+	event.data.u32 = idx;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) < 0)
+		goto err;
+	slot->fd = fd;
+	slot->got = 0;
+	slot->reqs = 0;
+	slot->connecting = true;
+	return 0;
+err:
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ *  stress_epoll_scale_send()
+ *	send the next request of a slot, stamped with the send time
+ */
+static int stress_epoll_scale_send(const stress_epoll_slot_t *slot)
+{
+	char buf[EPOLL_SCALE_MSG];
+	const uint64_t now = stress_epoll_now_ns();
+
+	(void)memset(buf, 0, sizeof(buf));
+	(void)memcpy(buf, &now, sizeof(now));
+#if defined(MSG_NOSIGNAL)
+	return (send(slot->fd, buf, sizeof(buf), MSG_NOSIGNAL) == (ssize_t)sizeof(buf)) ? 0 : -1;
+#else
+	return (send(slot->fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf)) ? 0 : -1;
+#endif
+}
+
+/*
+ *  stress_epoll_scale_client_thread()
+ *	keep the thread's connections busy with one request at a time
+ *	each, reconnecting after EPOLL_SCALE_REQS requests so that the
+ *	servers keep accepting
+ */
+static void *stress_epoll_scale_client_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_epoll_client_t *ctx = (stress_epoll_client_t *)arg;
+	struct epoll_event *events;
+	uint32_t *idle, n_idle = 0, i, connecting = 0;
+	int efd;
+
+	efd = epoll_create1(0);
+	if (efd < 0)
+		return &nowt;
+	events = calloc(MAX_EPOLL_EVENTS, sizeof(*events));
+	idle = calloc(ctx->n_slots, sizeof(*idle));
+	if (!events || !idle)
+		goto done;
+	for (i = 0; i < ctx->n_slots; i++) {
+		ctx->slots[i].fd = -1;
+		idle[n_idle++] = ctx->n_slots - 1 - i;
+	}
+
+	while (keep_stressing_flag()) {
+		int n, j;
+
+		while (n_idle && (connecting < EPOLL_SCALE_CONNECTING)) {
+			if (stress_epoll_scale_connect(ctx, efd, idle[n_idle - 1]) < 0)
+				break;
+			n_idle--;
+			connecting++;
+		}
+
+		n = epoll_wait(efd, events, MAX_EPOLL_EVENTS, n_idle ? 10 : 100);
+		for (j = 0; j < n; j++) {
+			const uint32_t idx = events[j].data.u32;
+			stress_epoll_slot_t *slot = &ctx->slots[idx];
+			bool reset = false;
+
+			if (slot->fd < 0)
+				continue;
+			if (slot->connecting) {
+				int err = 0;
+				socklen_t len = sizeof(err);
+
+				if (!(events[j].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+					continue;
+				slot->connecting = false;
+				connecting--;
+				if ((getsockopt(slot->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) ||
+				    err || (events[j].events & (EPOLLERR | EPOLLHUP))) {
+					reset = true;
+				} else {
+					struct epoll_event event;
+
+					(void)memset(&event, 0, sizeof(event));
+					event.events = EPOLLIN;
+					event.data.u32 = idx;
+					reset = (epoll_ctl(efd, EPOLL_CTL_MOD, slot->fd, &event) < 0) ||
+						(stress_epoll_scale_send(slot) < 0);
+				}
+			} else if (events[j].events & (EPOLLERR | EPOLLHUP)) {
+				reset = true;
+			} else if (events[j].events & EPOLLIN) {
+				char buf[EPOLL_SCALE_MSG];
+				const ssize_t got = recv(slot->fd, buf, EPOLL_SCALE_MSG - slot->got, 0);
+
+				if (got <= 0) {
+					reset = (got == 0) ||
+						((errno != EAGAIN) && (errno != EWOULDBLOCK));
+				} else {
+					slot->got += (uint8_t)got;
+					if (slot->got == EPOLL_SCALE_MSG) {
+						slot->got = 0;
+						reset = (++slot->reqs >= EPOLL_SCALE_REQS) ||
+							(stress_epoll_scale_send(slot) < 0);
+					}
+				}
+			}
+			if (reset) {
+				(void)close(slot->fd);
+				slot->fd = -1;
+				idle[n_idle++] = idx;
+			}
+		}
+	}
+done:
+	for (i = 0; i < ctx->n_slots; i++) {
+		if (ctx->slots[i].fd >= 0)
+			(void)close(ctx->slots[i].fd);
+	}
+	free(idle);
+	free(events);
+	(void)close(efd);
+	return &nowt;
+}
+
+/*
+ *  stress_epoll_scale_client()
+ *	client process, epoll-threads threads sharing epoll-conns
+ *	connections to the servers until it is killed
+ */
+static void stress_epoll_scale_client(
+	const stress_args_t *args,
+	const int child,
+	const pid_t ppid,
+	const int epoll_port,
+	const int epoll_domain)
+{
+	size_t epoll_threads = DEFAULT_EPOLL_THREADS;
+	size_t epoll_conns = DEFAULT_EPOLL_CONNS;
+	stress_epoll_client_t *clients;
+	stress_epoll_slot_t *slots;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	size_t i;
+
+	(void)child;
+	(void)stress_get_setting("epoll-threads", &epoll_threads);
+	(void)stress_get_setting("epoll-conns", &epoll_conns);
+	(void)stress_epoll_raise_nofile();
+	if (epoll_threads > epoll_conns)
+		epoll_threads = epoll_conns;
+
+	stress_set_sockaddr(args->name, args->instance, ppid, epoll_domain,
+		epoll_port, &addr, &addr_len, NET_ADDR_LOOPBACK);
+	clients = calloc(epoll_threads, sizeof(*clients));
+	slots = calloc(epoll_conns, sizeof(*slots));
+	if (!clients || !slots)
+		_exit(EXIT_NO_RESOURCE);
+
+	for (i = 0; i < epoll_threads; i++) {
+		const size_t first = (epoll_conns * i) / epoll_threads;
+
+		clients[i].domain = epoll_domain;
+		(void)memcpy(&clients[i].addr, addr, addr_len);
+		clients[i].addr_len = addr_len;
+		clients[i].slots = &slots[first];
+		clients[i].n_slots = (uint32_t)(((epoll_conns * (i + 1)) / epoll_threads) - first);
+		clients[i].ret = pthread_create(&clients[i].pthread, NULL,
+			stress_epoll_scale_client_thread, &clients[i]);
+	}
+	for (i = 0; i < epoll_threads; i++) {
+		if (clients[i].ret == 0)
+			(void)pthread_join(clients[i].pthread, NULL);
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_epoll_scale_listen()
+ *	create a non-blocking listening socket on port, shared between
+ *	sockets of the same process with reuseport
+ */
+static int stress_epoll_scale_listen(
+	const stress_args_t *args,
+	const int port,
+	const int domain,
+	const bool reuseport)
+{
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	int fd, one = 1;
+
+	fd = socket(domain, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0)
+		goto err;
+	if (reuseport) {
+#if defined(SO_REUSEPORT)
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+			goto err;
+#else
+		errno = ENOSYS;
+		goto err;
+#endif
+	}
+	stress_set_sockaddr(args->name, args->instance, getppid(), domain,
+		port, &addr, &addr_len, NET_ADDR_ANY);
+	if ((bind(fd, addr, addr_len) < 0) ||
+	    (epoll_set_fd_nonblock(fd) < 0) ||
+	    (listen(fd, SOMAXCONN) < 0))
+		goto err;
+	return fd;
+err:
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ *  stress_epoll_scale_method()
+ *	run the servers of one method against a client process for
+ *	EPOLL_SCALE_SLICE seconds and add what they did to stats,
+ *	returns EXIT_NOT_IMPLEMENTED if the method can't be used
+ */
+static int stress_epoll_scale_method(
+	const stress_args_t *args,
+	const int method,
+	const size_t threads,
+	const size_t conns,
+	const pid_t ppid,
+	const int port,
+	const int domain,
+	stress_epoll_scale_stats_t *stats)
+{
+	stress_epoll_server_pthread_t *servers;
+	int stop[2] = { -1, -1 }, shared_lfd = -1;
+	int rc = EXIT_SUCCESS, err = 0;
+	pid_t pid;
+	size_t i, fd;
+	double t_start, t_end;
+
+#if !defined(EPOLLEXCLUSIVE)
+	if (method == EPOLL_METHOD_EXCLUSIVE)
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+#if !defined(SO_REUSEPORT)
+	if (method != EPOLL_METHOD_EXCLUSIVE)
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+#if !defined(STRESS_EPOLL_IO_URING)
+	if (method == EPOLL_METHOD_URING)
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+
+	servers = calloc(threads, sizeof(*servers));
+	if (!servers)
+		return EXIT_NO_RESOURCE;
+	if (pipe(stop) < 0) {
+		free(servers);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < threads; i++) {
+		servers[i].ret = -1;
+		servers[i].info.efd = -1;
+		servers[i].info.lfd = -1;
+	}
+
+	if (method == EPOLL_METHOD_EXCLUSIVE) {
+		shared_lfd = stress_epoll_scale_listen(args, port, domain, false);
+		if (shared_lfd < 0) {
+			err = errno;
+			goto close_servers;
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		stress_epoll_server_t *ctx = &servers[i].info;
+
+		ctx->args = args;
+		ctx->method = method;
+		ctx->stop_fd = stop[0];
+		ctx->conns = (conns / threads) + 1;
+		ctx->lfd = (shared_lfd >= 0) ? shared_lfd :
+			stress_epoll_scale_listen(args, port, domain, true);
+		if (ctx->lfd < 0) {
+			err = errno;
+			goto close_servers;
+		}
+		if (method == EPOLL_METHOD_URING)
+			continue;
+		ctx->efd = epoll_create1(0);
+		if ((ctx->efd < 0) ||
+		    (epoll_ctl_add(ctx->efd, stop[0], EPOLLIN) < 0)) {
+			err = errno;
+			goto close_servers;
+		}
+#if defined(EPOLLEXCLUSIVE)
+		if (method == EPOLL_METHOD_EXCLUSIVE) {
+			if (epoll_ctl_add(ctx->efd, ctx->lfd, EPOLLIN | EPOLLEXCLUSIVE) < 0) {
+				err = errno;
+				goto close_servers;
+			}
+			continue;
+		}
+#endif
+		if (epoll_ctl_add(ctx->efd, ctx->lfd, EPOLLIN) < 0) {
+			err = errno;
+			goto close_servers;
+		}
+	}
+
+	t_start = stress_time_now();
+	for (i = 0; i < threads; i++) {
+		servers[i].ret = pthread_create(&servers[i].pthread, NULL,
+#if defined(STRESS_EPOLL_IO_URING)
+			(method == EPOLL_METHOD_URING) ? stress_epoll_uring_server :
+#endif
+			stress_epoll_scale_server, &servers[i]);
+		if (servers[i].ret) {
+			err = servers[i].ret;
+			break;
+		}
+	}
+
+	pid = (err == 0) ?
+		epoll_spawn(args, stress_epoll_scale_client, 0, ppid, port, domain) : -1;
+	if (pid > 0) {
+		t_end = t_start + EPOLL_SCALE_SLICE;
+		while (keep_stressing(args) && (stress_time_now() < t_end))
+			(void)shim_usleep(20000);
+	} else if (!err) {
+		err = errno;
+	}
+
+	/* The stop pipe stays readable, so every server sees it */
+	if (write(stop[1], "", 1) < 0)
+		err = errno;
+	for (i = 0; i < threads; i++) {
+		if (servers[i].ret == 0) {
+			(void)pthread_join(servers[i].pthread, NULL);
+			if (servers[i].info.err && !err)
+				err = servers[i].info.err;
+		}
+	}
+	t_end = stress_time_now();
+	if (pid > 0) {
+		int status;
+
+		(void)kill(pid, SIGKILL);
+		(void)shim_waitpid(pid, &status, 0);
+	}
+
+	if (!err) {
+		stats->measured = true;
+		stats->duration += t_end - t_start;
+		for (i = 0; i < threads; i++) {
+			const stress_epoll_scale_stats_t *s = &servers[i].info.stats;
+			size_t j;
+
+			stats->accepts += s->accepts;
+			stats->requests += s->requests;
+			for (j = 0; j < EPOLL_LAT_BUCKETS; j++)
+				stats->lat[j] += s->lat[j];
+		}
+	}
+
+close_servers:
+	for (fd = 0; fd < epoll_conn_max; fd++) {
+		if (epoll_conn_table[fd].open)
+			stress_epoll_scale_close((int)fd);
+	}
+	for (i = 0; i < threads; i++) {
+		if (servers[i].info.efd >= 0)
+			(void)close(servers[i].info.efd);
+		if ((servers[i].info.lfd >= 0) && (servers[i].info.lfd != shared_lfd))
+			(void)close(servers[i].info.lfd);
+	}
+	if (shared_lfd >= 0)
+		(void)close(shared_lfd);
+	(void)close(stop[0]);
+	(void)close(stop[1]);
+	free(servers);
+
+	if (err) {
+		/* io-uring may be disabled or lack multishot poll */
+		if ((method == EPOLL_METHOD_URING) &&
+		    ((err == EINVAL) || (err == ENOSYS) || (err == EPERM)))
+			return EXIT_NOT_IMPLEMENTED;
+		if ((err == EMFILE) || (err == ENFILE) || (err == ENOMEM))
+			return EXIT_NO_RESOURCE;
+		pr_fail("%s: %s servers failed, errno=%d (%s)\n",
+			args->name, epoll_methods[method - 1], err, strerror(err));
+		rc = EXIT_FAILURE;
+	}
+	return rc;
+}
+
+/*
+ *  stress_epoll_scale_report()
+ *	report accepts and requests per second and event latency
+ *	percentiles of each method, the table by the first instance only
+ */
+static void stress_epoll_scale_report(
+	const stress_args_t *args,
+	const stress_epoll_scale_stats_t *results,
+	const size_t threads,
+	const size_t conns)
+{
+	struct utsname uts;
+	bool lock = false;
+	size_t m;
+	int idx = 0;
+
+	if (args->instance != 0)
+		goto stats;
+	if (uname(&uts) < 0)
+		(void)shim_strlcpy(uts.release, "unknown", sizeof(uts.release));
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: kernel %s, %zu server threads, %zu connections\n",
+		args->name, uts.release, threads, conns);
+	pr_inf_lock(&lock, "%s: %-10s %12s %13s %10s %10s\n", args->name,
+		"method", "accepts/sec", "requests/sec", "p50 usec", "p99 usec");
+	for (m = 0; m < EPOLL_METHODS; m++) {
+		const stress_epoll_scale_stats_t *s = &results[m];
+
+		if (!s->measured)
+			continue;
+		if (s->duration <= 0.0) {
+			pr_inf_lock(&lock, "%s: %-10s %12s %13s %10s %10s\n", args->name,
+				epoll_methods[m], "n/a", "n/a", "n/a", "n/a");
+			continue;
+		}
+		pr_inf_lock(&lock, "%s: %-10s %12.1f %13.1f %10.1f %10.1f\n", args->name,
+			epoll_methods[m],
+			(double)s->accepts / s->duration,
+			(double)s->requests / s->duration,
+			stress_epoll_percentile(s, 50.0),
+			stress_epoll_percentile(s, 99.0));
+	}
+	pr_unlock(&lock);
+
+stats:
+	for (m = 0; m < EPOLL_METHODS; m++) {
+		const stress_epoll_scale_stats_t *s = &results[m];
+		char desc[40];
+
+		if (!s->measured || (s->duration <= 0.0))
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s accepts per sec", epoll_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			(double)s->accepts / s->duration);
+		(void)snprintf(desc, sizeof(desc), "%s requests per sec", epoll_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			(double)s->requests / s->duration);
+		(void)snprintf(desc, sizeof(desc), "%s p99 usec", epoll_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_epoll_percentile(s, 99.0));
+	}
+}
+
+/*
+ *  stress_epoll_scale()
+ *	connection scaling mode, each bogo op is one EPOLL_SCALE_SLICE
+ *	measurement of one method
+ */
+static int stress_epoll_scale(
+	const stress_args_t *args,
+	const pid_t ppid,
+	const int epoll_port,
+	int epoll_domain)
+{
+	stress_epoll_scale_stats_t *results;
+	size_t epoll_threads = DEFAULT_EPOLL_THREADS;
+	size_t epoll_conns = DEFAULT_EPOLL_CONNS;
+	size_t conns_size, m;
+	int epoll_method = EPOLL_METHOD_ALL;
+	int rc = EXIT_SUCCESS;
+	bool unsupported[EPOLL_METHODS];
+	const int port = epoll_port + (MAX_SERVERS * (int)args->instance);
+
+	(void)stress_get_setting("epoll-threads", &epoll_threads);
+	(void)stress_get_setting("epoll-conns", &epoll_conns);
+	(void)stress_get_setting("epoll-method", &epoll_method);
+
+	/* Reuseport sharding only exists for ip sockets */
+	if ((epoll_domain != AF_INET) && (epoll_domain != AF_INET6)) {
+		if (args->instance == 0)
+			pr_inf("%s: scale mode uses the ipv4 domain\n", args->name);
+		epoll_domain = AF_INET;
+	}
+
+	/* The client process needs a fd per connection too */
+	epoll_conn_max = stress_epoll_raise_nofile();
+	if (epoll_conns + EPOLL_SCALE_FD_SLACK > epoll_conn_max) {
+		const size_t max = (epoll_conn_max > 2 * EPOLL_SCALE_FD_SLACK) ?
+			epoll_conn_max - EPOLL_SCALE_FD_SLACK : EPOLL_SCALE_FD_SLACK;
+
+		if (args->instance == 0)
+			pr_inf("%s: open file limit allows %zu of %zu connections\n",
+				args->name, max, epoll_conns);
+		epoll_conns = max;
+	}
+	if (epoll_threads > epoll_conns)
+		epoll_threads = epoll_conns;
+
+	conns_size = epoll_conn_max * sizeof(*epoll_conn_table);
+	epoll_conn_table = (stress_epoll_conn_t *)mmap(NULL, conns_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (epoll_conn_table == MAP_FAILED) {
+		pr_inf("%s: cannot mmap connection table, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	results = calloc(EPOLL_METHODS, sizeof(*results));
+	if (!results) {
+		(void)munmap((void *)epoll_conn_table, conns_size);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(unsupported, 0, sizeof(unsupported));
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		bool ran = false;
+
+		for (m = 0; keep_stressing(args) && (m < EPOLL_METHODS); m++) {
+			int ret;
+
+			if (unsupported[m] ||
+			    ((epoll_method != EPOLL_METHOD_ALL) && (epoll_method != (int)m + 1)))
+				continue;
+			ret = stress_epoll_scale_method(args, (int)m + 1, epoll_threads,
+				epoll_conns, ppid, port, epoll_domain, &results[m]);
+			switch (ret) {
+			case EXIT_SUCCESS:
+				inc_counter(args);
+				ran = true;
+				break;
+			case EXIT_NOT_IMPLEMENTED:
+				if (args->instance == 0)
+					pr_inf("%s: method %s is not available, skipping it\n",
+						args->name, epoll_methods[m]);
+				unsupported[m] = true;
+				break;
+			case EXIT_NO_RESOURCE:
+				/* Try again next time around */
+				(void)shim_usleep(100000);
+				break;
+			default:
+				rc = ret;
+				goto report;
+			}
+		}
+		if (!ran && keep_stressing(args)) {
+			for (m = 0; m < EPOLL_METHODS; m++)
+				if (!unsupported[m] && ((epoll_method == EPOLL_METHOD_ALL) ||
+				    (epoll_method == (int)m + 1)))
+					break;
+			if (m == EPOLL_METHODS) {
+				if (args->instance == 0)
+					pr_inf("%s: no scale mode method is available, "
+						"skipping stressor\n", args->name);
+				rc = EXIT_NOT_IMPLEMENTED;
+				break;
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_epoll_scale_report(args, results, epoll_threads, epoll_conns);
+
+	free(results);
+	(void)munmap((void *)epoll_conn_table, conns_size);
+	return rc;
+}
+#endif
+
 /*
  *  stress_epoll
  *	stress by heavy socket I/O
@@ -957,9 +2268,22 @@ static int stress_epoll(const stress_args_t *args)
 	int i, rc = EXIT_SUCCESS;
 	int epoll_port = DEFAULT_EPOLL_PORT;
 	int epoll_domain = AF_UNIX;
+	bool epoll_scale = false;
 
 	(void)stress_get_setting("epoll-port", &epoll_port);
 	(void)stress_get_setting("epoll-domain", &epoll_domain);
+	(void)stress_get_setting("epoll-scale", &epoll_scale);
+
+	if (epoll_scale) {
+#if defined(STRESS_EPOLL_SCALE)
+		return stress_epoll_scale(args, ppid, epoll_port, epoll_domain);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: scale mode needs pthread support, "
+				"skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
 
 	if (max_servers == 1) {
 		pr_dbg("%s: process [%" PRIdMAX "] using socket port %d\n",
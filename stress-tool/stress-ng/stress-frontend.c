@@ -0,0 +1,511 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"frontend N",		"start N workers running generated code of a large footprint" },
+	{ NULL,	"frontend-ops N",	"stop after N passes over the generated code" },
+	{ NULL,	"frontend-size N",	"size of the generated code in bytes" },
+	{ NULL,	"frontend-branch P",	"percentage of code blocks with a conditional branch" },
+	{ NULL,	"frontend-targets N",	"number of indirect branch targets" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define MIN_FRONTEND_SIZE		(4 * KB)
+#define MAX_FRONTEND_SIZE		(256 * MB)
+#define DEFAULT_FRONTEND_SIZE		(1 * MB)
+
+#define MIN_FRONTEND_BRANCH		(0)
+#define MAX_FRONTEND_BRANCH		(100)
+#define DEFAULT_FRONTEND_BRANCH		(25)
+
+#define MIN_FRONTEND_TARGETS		(1)
+#define MAX_FRONTEND_TARGETS		(65536)
+#define DEFAULT_FRONTEND_TARGETS	(256)
+
+static int stress_set_frontend_size(const char *opt)
+{
+	uint64_t frontend_size;
+
+	frontend_size = stress_get_uint64_byte(opt);
+	stress_check_range_bytes("frontend-size", frontend_size,
+		MIN_FRONTEND_SIZE, MAX_FRONTEND_SIZE);
+	return stress_set_setting("frontend-size", TYPE_ID_UINT64, &frontend_size);
+}
+
+static int stress_set_frontend_branch(const char *opt)
+{
+	uint32_t frontend_branch;
+
+	frontend_branch = stress_get_uint32(opt);
+	stress_check_range("frontend-branch", (uint64_t)frontend_branch,
+		MIN_FRONTEND_BRANCH, MAX_FRONTEND_BRANCH);
+	return stress_set_setting("frontend-branch", TYPE_ID_UINT32, &frontend_branch);
+}
+
+static int stress_set_frontend_targets(const char *opt)
+{
+	uint32_t frontend_targets;
+
+	frontend_targets = stress_get_uint32(opt);
+	stress_check_range("frontend-targets", (uint64_t)frontend_targets,
+		MIN_FRONTEND_TARGETS, MAX_FRONTEND_TARGETS);
+	return stress_set_setting("frontend-targets", TYPE_ID_UINT32, &frontend_targets);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_frontend_size,	stress_set_frontend_size },
+	{ OPT_frontend_branch,	stress_set_frontend_branch },
+	{ OPT_frontend_targets,	stress_set_frontend_targets },
+	{ 0,			NULL }
+};
+
+#if defined(STRESS_ARCH_X86) &&		\
+    defined(__x86_64__) &&		\
+    defined(HAVE_MPROTECT)
+
+#define FRONTEND_BLOCK_SIZE	(16)	/* bytes per generated code block */
+#define FRONTEND_SEQ_PASSES	(16)	/* passes the chunk sequence covers */
+
+/* perf counters, user space only */
+#define FRONTEND_PERF_INSTR	(0)
+#define FRONTEND_PERF_CYCLES	(1)
+#define FRONTEND_PERF_ITLB	(2)
+#define FRONTEND_PERF_L1I	(3)
+#define FRONTEND_PERF_BPU	(4)
+#define FRONTEND_PERF_BRMISS	(5)
+#define FRONTEND_PERF_MAX	(6)
+
+static const char * const frontend_perf_names[FRONTEND_PERF_MAX] = {
+	"instructions",
+	"cycles",
+	"iTLB misses/Kinstr",
+	"L1I misses/Kinstr",
+	"BTB (BPU) misses/Kinstr",
+	"branch misses/Kinstr",
+};
+
+/*
+ *  the generated code, called as
+ *	fn(state, seq, seq_len, table)
+ *  state[1] is the pass number that sets the conditional branch
+ *  directions, state[2] gets the accumulated result
+ */
+typedef void (*stress_frontend_func_t)(uint64_t *state, const uint32_t *seq,
+	uint64_t seq_len, void * const *table);
+
+typedef struct {
+	uint8_t *code;			/* the generated code mapping */
+	size_t code_size;		/* mapping size */
+	size_t blocks;			/* code blocks */
+	size_t branches;		/* blocks with a conditional branch */
+	size_t targets;			/* chunks reached by indirect jumps */
+	void **table;			/* chunk entry points */
+	uint32_t *seq;			/* chunk visiting order */
+	size_t seq_len;
+} stress_frontend_code_t;
+
+/*
+ *  stress_frontend_emit()
+ *	append bytes to the generated code
+ */
+static inline uint8_t *stress_frontend_emit(uint8_t *ptr, const uint8_t *bytes, const size_t len)
+{
+	(void)memcpy(ptr, bytes, len);
+	return ptr + len;
+}
+
+/*
+ *  stress_frontend_rel32()
+ *	append a jmp or jcc with a 32 bit displacement to target
+ */
+static uint8_t *stress_frontend_rel32(
+	uint8_t *ptr,
+	const uint8_t *op,
+	const size_t op_len,
+	const uint8_t *target)
+{
+	int32_t rel;
+
+	ptr = stress_frontend_emit(ptr, op, op_len);
+	rel = (int32_t)(target - (ptr + sizeof(rel)));
+	(void)memcpy(ptr, &rel, sizeof(rel));
+	return ptr + sizeof(rel);
+}
+
+/*
+ *  stress_frontend_block()
+ *	emit a 16 byte block of independent ALU instructions, with
+ *	a conditional branch on a bit of the pass number if branch is set
+ */
+static uint8_t *stress_frontend_block(uint8_t *ptr, const size_t n, const bool branch)
+{
+	const uint8_t imm = (uint8_t)((n * 7) | 1);
+
+	if (branch) {
+		const uint8_t block[FRONTEND_BLOCK_SIZE] = {
+			0x48, 0x83, 0xc0, imm,			/* add $imm, %rax */
+			0x41, 0xf6, 0xc0, (uint8_t)(1U << (n & 7)),	/* test $bit, %r8b */
+			0x75, 0x04,				/* jnz 1f */
+			0x48, 0x83, 0xc1, imm,			/* add $imm, %rcx */
+			0x66, 0x90,				/* 1: 2 byte nop */
+		};
+
+		return stress_frontend_emit(ptr, block, sizeof(block));
+	} else {
+		const uint8_t block[FRONTEND_BLOCK_SIZE] = {
+			0x48, 0x83, 0xc0, imm,			/* add $imm, %rax */
+			0x48, 0x83, 0xc1, imm,			/* add $imm, %rcx */
+			0x48, 0x83, 0xc2, imm,			/* add $imm, %rdx */
+			0x48, 0x31, 0xc8,			/* xor %rcx, %rax */
+			0x90,					/* nop */
+		};
+
+		return stress_frontend_emit(ptr, block, sizeof(block));
+	}
+}
+
+/*
+ *  stress_frontend_generate()
+ *	generate code of about size bytes split into chunks, one
+ *	per indirect target, each of 16 byte blocks of which branch
+ *	percent have a conditional branch. With more than one target
+ *	a dispatcher jumps through the chunk table in the order of the
+ *	chunk sequence, otherwise the blocks run straight through.
+ */
+static int stress_frontend_generate(
+	const stress_args_t *args,
+	stress_frontend_code_t *code,
+	const size_t size,
+	const uint32_t branch,
+	const size_t targets)
+{
+	static const uint8_t prologue[] = {
+		0x4c, 0x8b, 0x47, 0x08,		/* mov 8(%rdi), %r8 */
+		0x49, 0x89, 0xd2,		/* mov %rdx, %r10 */
+		0x49, 0x89, 0xcb,		/* mov %rcx, %r11 */
+		0x45, 0x31, 0xc9,		/* xor %r9d, %r9d */
+		0x31, 0xc0,			/* xor %eax, %eax */
+		0x31, 0xc9,			/* xor %ecx, %ecx */
+		0x31, 0xd2,			/* xor %edx, %edx */
+	};
+	static const uint8_t dispatch[] = {
+		0x42, 0x8b, 0x0c, 0x8e,		/* mov (%rsi,%r9,4), %ecx */
+		0x49, 0xff, 0xc1,		/* inc %r9 */
+		0x41, 0xff, 0x24, 0xcb,		/* jmp *(%r11,%rcx,8) */
+	};
+	static const uint8_t cmp_len[] = {
+		0x4d, 0x39, 0xd1,		/* cmp %r10, %r9 */
+	};
+	static const uint8_t epilogue[] = {
+		0x48, 0x89, 0x47, 0x10,		/* mov %rax, 16(%rdi) */
+		0xc3,				/* ret */
+	};
+	static const uint8_t op_jae[] = { 0x0f, 0x83 };
+	static const uint8_t op_jmp[] = { 0xe9 };
+	const size_t blocks_per_chunk = STRESS_MAXIMUM(1, (size / FRONTEND_BLOCK_SIZE) / targets);
+	size_t i, j, n = 0, chunk_bytes, length;
+	uint8_t *ptr, *dispatcher, *done, *chunks;
+	double acc = 0.0;
+
+	code->targets = targets;
+	code->blocks = blocks_per_chunk * targets;
+	code->branches = 0;
+	chunk_bytes = (blocks_per_chunk * FRONTEND_BLOCK_SIZE) + 5;
+	length = 64 + (chunk_bytes * targets);
+	code->code_size = (length + args->page_size - 1) & ~(args->page_size - 1);
+
+	code->code = (uint8_t *)mmap(NULL, code->code_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code->code == MAP_FAILED) {
+		code->code = NULL;
+		pr_inf("%s: cannot mmap %zu bytes for the generated code, skipping stressor\n",
+			args->name, code->code_size);
+		return EXIT_NO_RESOURCE;
+	}
+	code->seq_len = (targets > 1) ? targets * FRONTEND_SEQ_PASSES : 0;
+	code->table = calloc(targets, sizeof(*code->table));
+	code->seq = calloc(STRESS_MAXIMUM(1, code->seq_len), sizeof(*code->seq));
+	if (!code->table || !code->seq) {
+		pr_inf("%s: cannot allocate the indirect target table, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	/* fill unused space with int3 */
+	(void)memset(code->code, 0xcc, code->code_size);
+
+	/* prologue, then dispatcher and epilogue, then the chunks */
+	ptr = stress_frontend_emit(code->code, prologue, sizeof(prologue));
+	dispatcher = ptr + 5;
+	done = dispatcher + sizeof(cmp_len) + 6 + sizeof(dispatch);
+	chunks = done + sizeof(epilogue);
+	chunks = (uint8_t *)(((uintptr_t)chunks + 15) & ~(uintptr_t)15);
+	ptr = stress_frontend_rel32(ptr, op_jmp, sizeof(op_jmp),
+		(targets > 1) ? dispatcher : chunks);
+	ptr = stress_frontend_emit(ptr, cmp_len, sizeof(cmp_len));
+	ptr = stress_frontend_rel32(ptr, op_jae, sizeof(op_jae), done);
+	ptr = stress_frontend_emit(ptr, dispatch, sizeof(dispatch));
+	(void)stress_frontend_emit(ptr, epilogue, sizeof(epilogue));
+
+	ptr = chunks;
+	for (i = 0; i < targets; i++) {
+		code->table[i] = (void *)ptr;
+		for (j = 0; j < blocks_per_chunk; j++, n++) {
+			bool br = false;
+
+			/* spread the branches evenly over the blocks */
+			acc += (double)branch / 100.0;
+			if (acc >= 1.0) {
+				acc -= 1.0;
+				br = true;
+				code->branches++;
+			}
+			ptr = stress_frontend_block(ptr, n, br);
+		}
+		ptr = stress_frontend_rel32(ptr, op_jmp, sizeof(op_jmp),
+			(targets > 1) ? dispatcher : done);
+	}
+
+	/* a random visiting order, so the dispatcher target is unpredictable */
+	for (i = 0; i < code->seq_len; i++)
+		code->seq[i] = (uint32_t)(i % targets);
+	for (i = code->seq_len; i > 1; i--) {
+		const size_t k = (size_t)stress_mwc32() % i;
+		const uint32_t tmp = code->seq[i - 1];
+
+		code->seq[i - 1] = code->seq[k];
+		code->seq[k] = tmp;
+	}
+
+	if (mprotect(code->code, code->code_size, PROT_READ | PROT_EXEC) < 0) {
+		pr_inf("%s: cannot make the generated code executable, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	return EXIT_SUCCESS;
+}
+
+static void stress_frontend_free(stress_frontend_code_t *code)
+{
+	if (code->code)
+		(void)munmap((void *)code->code, code->code_size);
+	free(code->seq);
+	free(code->table);
+}
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open)
+/*
+ *  stress_frontend_perf_open()
+ *	open a user space counter of the calling process,
+ *	returns -1 if it is not available
+ */
+static int stress_frontend_perf_open(const int counter)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	switch (counter) {
+	case FRONTEND_PERF_INSTR:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case FRONTEND_PERF_CYCLES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case FRONTEND_PERF_ITLB:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_ITLB |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case FRONTEND_PERF_L1I:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1I |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case FRONTEND_PERF_BPU:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_BPU |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case FRONTEND_PERF_BRMISS:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	default:
+		return -1;
+	}
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#else
+static int stress_frontend_perf_open(const int counter)
+{
+	(void)counter;
+
+	return -1;
+}
+#endif
+
+/*
+ *  stress_frontend_perf_read()
+ *	read a counter, 0 if it could not be opened or read
+ */
+static uint64_t stress_frontend_perf_read(const int fd)
+{
+	uint64_t count = 0;
+
+	if (fd < 0)
+		return 0;
+	if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count))
+		return 0;
+	return count;
+}
+
+/*
+ *  stress_frontend()
+ *	run generated code with a large instruction footprint, many
+ *	taken branches and an indirect jump with many targets to
+ *	stress the instruction fetch front end
+ */
+static int stress_frontend(const stress_args_t *args)
+{
+	uint64_t frontend_size = DEFAULT_FRONTEND_SIZE;
+	uint32_t frontend_branch = DEFAULT_FRONTEND_BRANCH;
+	uint32_t frontend_targets = DEFAULT_FRONTEND_TARGETS;
+	stress_frontend_code_t code;
+	stress_frontend_func_t func;
+	uint64_t state[3] = { 0, 0, 0 };
+	uint64_t start[FRONTEND_PERF_MAX], count[FRONTEND_PERF_MAX];
+	int fds[FRONTEND_PERF_MAX];
+	uint64_t calls = 0;
+	double t_start, duration;
+	size_t i, targets;
+	int rc;
+
+	(void)stress_get_setting("frontend-size", &frontend_size);
+	(void)stress_get_setting("frontend-branch", &frontend_branch);
+	(void)stress_get_setting("frontend-targets", &frontend_targets);
+
+	targets = STRESS_MINIMUM((size_t)frontend_targets,
+		(size_t)(frontend_size / FRONTEND_BLOCK_SIZE));
+	(void)memset(&code, 0, sizeof(code));
+	rc = stress_frontend_generate(args, &code, (size_t)frontend_size,
+		frontend_branch, STRESS_MAXIMUM(1, targets));
+	if (rc != EXIT_SUCCESS) {
+		stress_frontend_free(&code);
+		return rc;
+	}
+	func = (stress_frontend_func_t)(uintptr_t)code.code;
+
+	for (i = 0; i < FRONTEND_PERF_MAX; i++)
+		fds[i] = stress_frontend_perf_open((int)i);
+	if ((fds[FRONTEND_PERF_INSTR] < 0) && (args->instance == 0))
+		pr_inf("%s: perf counters not available, only reporting time per pass\n",
+			args->name);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	for (i = 0; i < FRONTEND_PERF_MAX; i++)
+		start[i] = stress_frontend_perf_read(fds[i]);
+	t_start = stress_time_now();
+	do {
+		const size_t pass = (size_t)(calls % FRONTEND_SEQ_PASSES);
+
+		state[1] = calls;
+		func(state, code.seq + (pass * code.targets),
+			code.seq_len ? code.targets : 0, code.table);
+		calls++;
+		inc_counter(args);
+	} while (keep_stressing(args));
+	duration = stress_time_now() - t_start;
+	for (i = 0; i < FRONTEND_PERF_MAX; i++)
+		count[i] = stress_frontend_perf_read(fds[i]) - start[i];
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_uint64_put(state[2]);
+
+	if (duration > 0.0 && calls) {
+		const double ns = (duration * (double)STRESS_NANOSECOND) / (double)calls;
+		const double kinstr = (double)count[FRONTEND_PERF_INSTR] / 1000.0;
+		const double code_bytes = (double)(code.blocks * FRONTEND_BLOCK_SIZE);
+		double ipc = 0.0, rates[FRONTEND_PERF_MAX];
+		int idx = 0;
+
+		(void)memset(rates, 0, sizeof(rates));
+		if (count[FRONTEND_PERF_CYCLES])
+			ipc = (double)count[FRONTEND_PERF_INSTR] / (double)count[FRONTEND_PERF_CYCLES];
+		for (i = FRONTEND_PERF_ITLB; i < FRONTEND_PERF_MAX; i++)
+			rates[i] = ((fds[i] >= 0) && (kinstr > 0.0)) ? (double)count[i] / kinstr : 0.0;
+
+		if (args->instance == 0) {
+			pr_inf("%s: %zuK of generated code in %zu blocks, %zu conditional branches, "
+				"%zu indirect targets\n", args->name, (size_t)(code_bytes / 1024.0),
+				code.blocks, code.branches, code.targets);
+			pr_inf("%s: %.1f ns per pass, %.2f code bytes per ns\n",
+				args->name, ns, code_bytes / ns);
+			if (fds[FRONTEND_PERF_INSTR] >= 0) {
+				pr_inf("%s: IPC %.2f\n", args->name, ipc);
+				for (i = FRONTEND_PERF_ITLB; i < FRONTEND_PERF_MAX; i++) {
+					if (fds[i] >= 0)
+						pr_inf("%s: %.3f %s\n", args->name, rates[i], frontend_perf_names[i]);
+					else
+						pr_inf("%s: %s counter not available\n",
+							args->name, frontend_perf_names[i]);
+				}
+			}
+		}
+		stress_misc_stats_set(args->misc_stats, idx++, "ns per pass", ns);
+		stress_misc_stats_set(args->misc_stats, idx++, "code bytes per ns", code_bytes / ns);
+		if (fds[FRONTEND_PERF_INSTR] >= 0) {
+			stress_misc_stats_set(args->misc_stats, idx++, "IPC", ipc);
+			for (i = FRONTEND_PERF_ITLB; i < FRONTEND_PERF_MAX; i++) {
+				if (fds[i] >= 0)
+					stress_misc_stats_set(args->misc_stats, idx++,
+						frontend_perf_names[i], rates[i]);
+			}
+		}
+	}
+
+	for (i = 0; i < FRONTEND_PERF_MAX; i++)
+		if (fds[i] >= 0)
+			(void)close(fds[i]);
+	stress_frontend_free(&code);
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_frontend_info = {
+	.stressor = stress_frontend,
+	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_frontend_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
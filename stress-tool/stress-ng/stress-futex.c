@@ -179,7 +179,8 @@ finish:
 stressor_info_t stress_futex_info = {
 	.stressor = stress_futex,
 	.class = CLASS_SCHEDULER | CLASS_OS,
-	.help = help
+	.help = help,
+	.threaded = true
 };
 #else
 stressor_info_t stress_futex_info = {
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2013-2021 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define HASH_KEYS		(4096)	/* keys hashed per bogo op */
+#define HASH_KEY_MAX		(128)	/* longest key in bytes */
+#define HASH_BUCKETS		(256)	/* buckets for the chi-squared test */
+
+typedef uint64_t (*stress_hash_func)(const char *str, const size_t len, const uint32_t seed);
+
+typedef struct {
+	const char *name;		/* hash method name */
+	const stress_hash_func func;	/* hash function */
+} stress_hash_method_info_t;
+
+/* Per method throughput and quality statistics */
+typedef struct {
+	double duration;		/* time spent hashing */
+	uint64_t bytes;			/* bytes hashed */
+	uint64_t keys;			/* keys hashed */
+	uint64_t collisions;		/* different keys with the same hash */
+	uint64_t rounds;		/* rounds run */
+	double chi_squared;		/* sum of per round chi-squared ratios */
+} stress_hash_stats_t;
+
+static const stress_help_t help[] = {
+	{ NULL,	"hash N",	 "start N workers that exercise various hash functions" },
+	{ NULL,	"hash-ops N",	 "stop after N hash bogo operations" },
+	{ NULL,	"hash-method M", "specify the hash method to use" },
+	{ NULL,	NULL,		 NULL }
+};
+
+static uint64_t stress_hash_method_jenkin(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)seed;
+
+	return stress_hash_jenkin((const uint8_t *)str, len);
+}
+
+static uint64_t stress_hash_method_murmur3_32(const char *str, const size_t len, const uint32_t seed)
+{
+	return stress_hash_murmur3_32((const uint8_t *)str, len, seed);
+}
+
+static uint64_t stress_hash_method_pjw(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)len;
+	(void)seed;
+
+	return stress_hash_pjw(str);
+}
+
+static uint64_t stress_hash_method_djb2a(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)len;
+	(void)seed;
+
+	return stress_hash_djb2a(str);
+}
+
+static uint64_t stress_hash_method_fnv1a(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)len;
+	(void)seed;
+
+	return stress_hash_fnv1a(str);
+}
+
+static uint64_t stress_hash_method_sdbm(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)len;
+	(void)seed;
+
+	return stress_hash_sdbm(str);
+}
+
+static uint64_t stress_hash_method_nhash(const char *str, const size_t len, const uint32_t seed)
+{
+	(void)len;
+	(void)seed;
+
+	return stress_hash_nhash(str);
+}
+
+static uint64_t stress_hash_method_xxh64(const char *str, const size_t len, const uint32_t seed)
+{
+	return stress_hash_xxh64((const uint8_t *)str, len, seed);
+}
+
+static uint64_t stress_hash_method_wyhash(const char *str, const size_t len, const uint32_t seed)
+{
+	return stress_hash_wyhash((const uint8_t *)str, len, seed);
+}
+
+/*
+ *  "all" cycles through the other methods and so has no function
+ */
+static const stress_hash_method_info_t hash_methods[] = {
+	{ "all",	NULL },
+	{ "djb2a",	stress_hash_method_djb2a },
+	{ "fnv1a",	stress_hash_method_fnv1a },
+	{ "jenkin",	stress_hash_method_jenkin },
+	{ "murmur3_32",	stress_hash_method_murmur3_32 },
+	{ "nhash",	stress_hash_method_nhash },
+	{ "pjw",	stress_hash_method_pjw },
+	{ "sdbm",	stress_hash_method_sdbm },
+	{ "wyhash",	stress_hash_method_wyhash },
+	{ "xxh64",	stress_hash_method_xxh64 },
+	{ NULL,		NULL }
+};
+
+/*
+ *  stress_set_hash_method()
+ *	set the default hash method
+ */
+static int stress_set_hash_method(const char *name)
+{
+	stress_hash_method_info_t const *info;
+
+	for (info = hash_methods; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			stress_set_setting("hash-method", TYPE_ID_UINTPTR_T, &info);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "hash-method must be one of:");
+	for (info = hash_methods; info->name; info++) {
+		(void)fprintf(stderr, " %s", info->name);
+	}
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_hash_keys_fill()
+ *	put fresh random alphanumeric text into the first 8
+ *	bytes of each key, the string hashes cannot take
+ *	embedded NUL bytes
+ */
+static void stress_hash_keys_fill(char *keys, const size_t *lens)
+{
+	static const char alnum[] =
+		"abcdefghijklmnopqrstuvwxyz"
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"0123456789+/";
+	size_t i;
+
+	for (i = 0; i < HASH_KEYS; i++) {
+		char *key = keys + (i * (HASH_KEY_MAX + 1));
+		uint64_t r = stress_mwc64();
+		size_t j;
+
+		for (j = 0; (j < lens[i]) && (j < 8); j++, r >>= 6)
+			key[j] = alnum[r & 63];
+	}
+}
+
+/*
+ *  stress_hash_round()
+ *	hash all the keys with one method, check how evenly
+ *	the hashes spread over buckets and count the keys that
+ *	collide with a different key in an open addressing table
+ */
+static int stress_hash_round(
+	const stress_args_t *args,
+	const stress_hash_method_info_t *info,
+	const char *keys,
+	const size_t *lens,
+	const size_t bytes,
+	const uint32_t seed,
+	uint64_t *hashes,
+	stress_hash_stats_t *stats)
+{
+	const stress_hash_func func = info->func;
+	uint32_t buckets[HASH_BUCKETS];
+	stress_hash_oatable_t *table;
+	const double expected = (double)HASH_KEYS / (double)HASH_BUCKETS;
+	double t, chi = 0.0;
+	size_t i;
+	int rc = 0;
+
+	t = stress_time_now();
+	for (i = 0; i < HASH_KEYS; i++)
+		hashes[i] = func(keys + (i * (HASH_KEY_MAX + 1)), lens[i], seed);
+	stats->duration += stress_time_now() - t;
+	stats->bytes += bytes;
+	stats->keys += HASH_KEYS;
+	stats->rounds++;
+
+	/* How well do the low bits, as used to index tables, spread? */
+	(void)memset(buckets, 0, sizeof(buckets));
+	for (i = 0; i < HASH_KEYS; i++)
+		buckets[hashes[i] % HASH_BUCKETS]++;
+	for (i = 0; i < HASH_BUCKETS; i++) {
+		const double d = (double)buckets[i] - expected;
+
+		chi += (d * d) / expected;
+	}
+	stats->chi_squared += chi / (double)(HASH_BUCKETS - 1);
+
+	table = stress_hash_oatable_create(HASH_KEYS);
+	if (!table) {
+		pr_inf("%s: cannot allocate hash table, skipping collision check\n",
+			args->name);
+		return 0;
+	}
+	for (i = 0; i < HASH_KEYS; i++) {
+		uint64_t j;
+
+		if (stress_hash_oatable_get(table, hashes[i], &j)) {
+			if (strcmp(keys + (i * (HASH_KEY_MAX + 1)),
+				   keys + (j * (HASH_KEY_MAX + 1))))
+				stats->collisions++;
+		} else {
+			(void)stress_hash_oatable_put(table, hashes[i], (uint64_t)i);
+		}
+	}
+	if (g_opt_flags & OPT_FLAGS_VERIFY) {
+		for (i = 0; i < HASH_KEYS; i++) {
+			uint64_t j;
+
+			if (!stress_hash_oatable_get(table, hashes[i], &j) ||
+			    (hashes[j] != hashes[i])) {
+				pr_fail("%s: %s hash table lookup of key %zu failed\n",
+					args->name, info->name, i);
+				rc = -1;
+				break;
+			}
+		}
+	}
+	stress_hash_oatable_delete(table);
+
+	return rc;
+}
+
+/*
+ *  stress_hash()
+ *	stress various hash functions
+ */
+static int stress_hash(const stress_args_t *args)
+{
+	const stress_hash_method_info_t *hash_method = &hash_methods[0];
+	const size_t n_methods = SIZEOF_ARRAY(hash_methods) - 1;
+	stress_hash_stats_t stats[SIZEOF_ARRAY(hash_methods)];
+	const uint32_t seed = stress_mwc32();
+	size_t i, idx = 1, bytes = 0, misc = 0;
+	size_t lens[HASH_KEYS];
+	uint64_t *hashes;
+	char *keys;
+	int rc = EXIT_SUCCESS;
+	bool lock = false;
+
+	(void)stress_get_setting("hash-method", &hash_method);
+
+	keys = malloc(HASH_KEYS * (HASH_KEY_MAX + 1));
+	if (!keys) {
+		pr_inf_skip("%s: cannot allocate keys, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	hashes = calloc(HASH_KEYS, sizeof(*hashes));
+	if (!hashes) {
+		pr_inf_skip("%s: cannot allocate hashes, skipping stressor\n", args->name);
+		free(keys);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(stats, 0, sizeof(stats));
+
+	/* Key lengths from 1 to HASH_KEY_MAX, the text is refreshed each round */
+	for (i = 0; i < HASH_KEYS; i++) {
+		char *key = keys + (i * (HASH_KEY_MAX + 1));
+
+		lens[i] = 1 + (stress_mwc32() % HASH_KEY_MAX);
+		(void)memset(key, 'x', lens[i]);
+		key[lens[i]] = '\0';
+		bytes += lens[i];
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		const stress_hash_method_info_t *info = hash_method;
+
+		if (!info->func) {
+			info = &hash_methods[idx];
+			idx = (idx >= n_methods - 1) ? 1 : idx + 1;
+		}
+		stress_hash_keys_fill(keys, lens);
+		if (stress_hash_round(args, info, keys, lens, bytes, seed,
+				      hashes, &stats[info - hash_methods]) < 0) {
+			rc = EXIT_FAILURE;
+			break;
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	for (i = 1; i < n_methods; i++) {
+		const stress_hash_stats_t *s = &stats[i];
+		const double rate = (s->duration > 0.0) ?
+			(double)s->bytes / (s->duration * (double)MB) : 0.0;
+		char desc[40];
+
+		if (!s->rounds)
+			continue;
+		if (args->instance == 0) {
+			pr_inf_lock(&lock, "%s: %-10s %10.2f MB/sec, %8.2f M keys/sec, "
+				"chi-squared %.3f, %" PRIu64 " collisions\n",
+				args->name, hash_methods[i].name, rate,
+				(s->duration > 0.0) ? (double)s->keys / (s->duration * 1000000.0) : 0.0,
+				s->chi_squared / (double)s->rounds, s->collisions);
+		}
+		(void)snprintf(desc, sizeof(desc), "MB/sec (%s)", hash_methods[i].name);
+		stress_misc_stats_set(args->misc_stats, misc++, desc, rate);
+	}
+	pr_unlock(&lock);
+
+	free(hashes);
+	free(keys);
+
+	return rc;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_hash_method,	stress_set_hash_method },
+	{ 0,			NULL }
+};
+
+stressor_info_t stress_hash_info = {
+	.stressor = stress_hash,
+	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
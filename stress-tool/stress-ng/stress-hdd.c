@@ -23,10 +23,56 @@
  *
  */
 #include "stress-ng.h"
+#include "io-uring.h"
+
+/* libaio.h and linux/aio_abi.h both define struct iocb and io_event */
+#if !defined(HAVE_LIBAIO_H) &&	\
+    defined(HAVE_LINUX_AIO_ABI_H)
+#include <linux/aio_abi.h>
+#endif
 
 #define BUF_ALIGNMENT		(4096)
 #define HDD_IO_VEC_MAX		(16)		/* Must be power of 2 */
 
+/* I/O engines */
+#define HDD_ENGINE_SYNC		(0)	/* read/write system calls */
+#define HDD_ENGINE_AIO		(1)	/* native Linux asynchronous I/O */
+#define HDD_ENGINE_IO_URING	(2)	/* io-uring read/write requests */
+
+#define HDD_BS_MIX_MAX		(8)		/* block sizes in a --hdd-bs-mix */
+#define HDD_BS_MIN		(512)		/* smallest async block size */
+#define HDD_ASYNC_BUF_MAX	(256 * MB)	/* limit of in-flight buffers */
+#define HDD_LAT_SUB		(4)		/* latency buckets per power of 2 */
+#define HDD_LAT_BUCKETS		(64 * HDD_LAT_SUB)
+
+#if defined(__linux__) &&		\
+    (defined(HAVE_LIBAIO_H) ||		\
+     defined(HAVE_LINUX_AIO_ABI_H)) &&	\
+    defined(__NR_io_setup) &&		\
+    defined(__NR_io_destroy) &&		\
+    defined(__NR_io_submit) &&		\
+    defined(__NR_io_getevents)
+#define STRESS_HDD_AIO
+#endif
+
+#if defined(__linux__) &&		\
+    defined(HAVE_LINUX_IO_URING_H) &&	\
+    defined(__NR_io_uring_setup) &&	\
+    defined(__NR_io_uring_enter) &&	\
+    defined(IORING_OFF_SQ_RING) &&	\
+    defined(IORING_OFF_CQ_RING) &&	\
+    defined(IORING_OFF_SQES) &&		\
+    defined(IORING_ENTER_GETEVENTS) &&	\
+    defined(HAVE_IORING_OP_READ) &&	\
+    defined(HAVE_IORING_OP_WRITE)
+#define STRESS_HDD_IO_URING
+#endif
+
+#if defined(STRESS_HDD_AIO) ||	\
+    defined(STRESS_HDD_IO_URING)
+#define STRESS_HDD_ASYNC
+#endif
+
 /* Write and read stress modes */
 #define HDD_OPT_WR_SEQ		(0x00000001)
 #define HDD_OPT_WR_RND		(0x00000002)
@@ -65,11 +111,24 @@ typedef struct {
 	const int oflag;	/* open O_* flags */
 } stress_hdd_opts_t;
 
+typedef struct {
+	const char *name;	/* --hdd-engine name */
+	const int engine;	/* HDD_ENGINE_ value */
+} stress_hdd_engine_t;
+
+typedef struct {
+	uint64_t size;		/* block size in bytes */
+	uint32_t weight;	/* relative share of the I/Os of this size */
+} stress_hdd_bs_t;
+
 static const stress_help_t help[] = {
 	{ "d N","hdd N",		"start N workers spinning on write()/unlink()" },
 	{ NULL,	"hdd-ops N",		"stop after N hdd bogo operations" },
 	{ NULL,	"hdd-bytes N",		"write N bytes per hdd worker (default is 1GB)" },
+	{ NULL,	"hdd-bs-mix list",	"mix of size[:weight] block sizes for async engines" },
+	{ NULL,	"hdd-engine E",		"select I/O engine: sync, aio or io-uring" },
 	{ NULL,	"hdd-opts list",	"specify list of various stressor options" },
+	{ NULL,	"hdd-qdepth N",		"keep N I/Os in flight with async engines" },
 	{ NULL,	"hdd-write-size N",	"set the default write size to N bytes" },
 	{ NULL, NULL,			NULL }
 };
@@ -164,6 +223,119 @@ static int stress_set_hdd_write_size(const char *opt)
 	return stress_set_setting("hdd-write-size", TYPE_ID_UINT64, &hdd_write_size);
 }
 
+static const stress_hdd_engine_t hdd_engines[] = {
+	{ "sync",	HDD_ENGINE_SYNC },
+#if defined(STRESS_HDD_AIO)
+	{ "aio",	HDD_ENGINE_AIO },
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	{ "io-uring",	HDD_ENGINE_IO_URING },
+#endif
+};
+
+/*
+ *  stress_set_hdd_engine()
+ *	select the sync, aio or io-uring I/O engine
+ */
+static int stress_set_hdd_engine(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(hdd_engines); i++) {
+		if (!strcmp(opt, hdd_engines[i].name))
+			return stress_set_setting("hdd-engine", TYPE_ID_INT,
+				&hdd_engines[i].engine);
+	}
+	(void)fprintf(stderr, "hdd-engine option '%s' not known, engines are:", opt);
+	for (i = 0; i < SIZEOF_ARRAY(hdd_engines); i++)
+		(void)fprintf(stderr, " %s", hdd_engines[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_hdd_qdepth()
+ *	set the number of I/Os kept in flight by the async engines
+ */
+static int stress_set_hdd_qdepth(const char *opt)
+{
+	uint32_t hdd_qdepth;
+
+	hdd_qdepth = stress_get_uint32(opt);
+	stress_check_range("hdd-qdepth", (uint64_t)hdd_qdepth,
+		MIN_HDD_QDEPTH, MAX_HDD_QDEPTH);
+	return stress_set_setting("hdd-qdepth", TYPE_ID_UINT32, &hdd_qdepth);
+}
+
+/*
+ *  stress_hdd_bs_mix_parse()
+ *	parse a size[:weight],... list of block sizes, the weight
+ *	defaults to 1, returns the number of sizes or -1 on error
+ */
+static int stress_hdd_bs_mix_parse(const char *opt, stress_hdd_bs_t *mix)
+{
+	char *str, *ptr, *token;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (ptr = str; (token = strtok(ptr, ",")) != NULL; ptr = NULL) {
+		char *colon = strchr(token, ':');
+		uint32_t weight = 1;
+		uint64_t size;
+
+		if (n >= HDD_BS_MIX_MAX) {
+			(void)fprintf(stderr, "hdd-bs-mix has more than %d "
+				"block sizes\n", HDD_BS_MIX_MAX);
+			goto err;
+		}
+		if (colon) {
+			*colon = '\0';
+			weight = stress_get_uint32(colon + 1);
+			if (!weight) {
+				(void)fprintf(stderr, "hdd-bs-mix weight of block "
+					"size '%s' must be at least 1\n", token);
+				goto err;
+			}
+		}
+		size = stress_get_uint64_byte(token);
+		if ((size < HDD_BS_MIN) || (size > MAX_HDD_WRITE_SIZE) ||
+		    (size % HDD_BS_MIN)) {
+			(void)fprintf(stderr, "hdd-bs-mix block size '%s' must be "
+				"a multiple of %d bytes from %d to %d bytes\n",
+				token, HDD_BS_MIN, HDD_BS_MIN, (int)MAX_HDD_WRITE_SIZE);
+			goto err;
+		}
+		mix[n].size = size;
+		mix[n].weight = weight;
+		n++;
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "hdd-bs-mix needs at least one block size\n");
+		return -1;
+	}
+	return n;
+err:
+	free(str);
+	return -1;
+}
+
+/*
+ *  stress_set_hdd_bs_mix()
+ *	set the mix of block sizes used by the async engines
+ */
+static int stress_set_hdd_bs_mix(const char *opt)
+{
+	stress_hdd_bs_t mix[HDD_BS_MIX_MAX];
+
+	if (stress_hdd_bs_mix_parse(opt, mix) < 0)
+		return -1;
+	return stress_set_setting("hdd-bs-mix", TYPE_ID_STR, opt);
+}
+
 #if defined(HAVE_FUTIMES)
 static void stress_hdd_utimes(const int fd)
 {
@@ -550,6 +722,715 @@ static inline uint8_t data_value(const uint64_t i, uint64_t j, const stress_args
 	return v;
 }
 
+#if defined(STRESS_HDD_ASYNC)
+/*
+ *  stress_hdd_lat_bucket()
+ *	map a latency in nanoseconds to a histogram bucket,
+ *	HDD_LAT_SUB buckets per power of 2
+ */
+static inline size_t stress_hdd_lat_bucket(const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0;
+
+	if (ns < HDD_LAT_SUB)
+		return (size_t)ns;
+	for (v = ns; v > 1; v >>= 1)
+		msb++;
+	return ((msb - 1) * HDD_LAT_SUB) + (size_t)((ns >> (msb - 2)) & (HDD_LAT_SUB - 1));
+}
+
+/*
+ *  stress_hdd_lat_value()
+ *	upper bound in nanoseconds of a latency histogram bucket
+ */
+static inline uint64_t stress_hdd_lat_value(const size_t bucket)
+{
+	const size_t msb = (bucket / HDD_LAT_SUB) + 1;
+	const uint64_t sub = (uint64_t)(bucket % HDD_LAT_SUB);
+
+	if (bucket < HDD_LAT_SUB)
+		return (uint64_t)bucket;
+	return ((HDD_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  per direction throughput and latency of the async engines
+ */
+typedef struct {
+	uint64_t ios;			/* completed I/Os */
+	uint64_t bytes;			/* bytes transferred */
+	double duration;		/* time spent with I/Os in flight */
+	uint64_t lat_max;		/* longest latency in ns */
+	uint64_t lat[HDD_LAT_BUCKETS];	/* latency histogram */
+} stress_hdd_lat_t;
+
+typedef struct {
+	uint64_t offset;	/* file offset of the block */
+	uint32_t len;		/* block size in bytes */
+} stress_hdd_block_t;
+
+typedef struct {
+	uint8_t *buf;		/* aligned I/O buffer */
+	uint64_t offset;	/* file offset of the I/O */
+	size_t len;		/* I/O size in bytes */
+	double t_start;		/* time the I/O was queued */
+} stress_hdd_slot_t;
+
+#if defined(STRESS_HDD_IO_URING)
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+/*
+ *  minimal io-uring, the SQ is sized to the queue depth
+ */
+typedef struct {
+	int fd;			/* io-uring fd */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	unsigned tail;		/* local tail of queued SQEs */
+	unsigned submitted;	/* SQEs consumed by the kernel */
+} stress_hdd_uring_t;
+#endif
+
+#if defined(STRESS_HDD_AIO)
+#if defined(HAVE_LIBAIO_H)
+typedef io_context_t stress_hdd_aio_ctx_t;
+#else
+typedef aio_context_t stress_hdd_aio_ctx_t;
+#endif
+#endif
+
+typedef struct {
+	int engine;			/* HDD_ENGINE_AIO or HDD_ENGINE_IO_URING */
+	int fd;				/* file being exercised */
+	uint32_t qdepth;		/* I/Os kept in flight */
+	uint32_t n_free;		/* number of free slots */
+	uint32_t queued;		/* I/Os queued but not yet submitted */
+	stress_hdd_slot_t *slots;	/* one slot per in-flight I/O */
+	uint32_t *free_slots;		/* stack of free slot indices */
+	uint32_t *done;			/* slots of the reaped I/Os */
+	int64_t *res;			/* results of the reaped I/Os */
+	void *bufs;			/* slot buffers */
+#if defined(STRESS_HDD_AIO)
+	stress_hdd_aio_ctx_t aio_ctx;
+	struct iocb *iocbs;
+	struct iocb **iocbps;
+	struct io_event *events;
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	stress_hdd_uring_t ring;
+#endif
+} stress_hdd_async_t;
+
+#if defined(STRESS_HDD_IO_URING)
+/*
+ *  stress_hdd_uring_close()
+ *	tear down an io-uring
+ */
+static void stress_hdd_uring_close(stress_hdd_uring_t *ring)
+{
+	if (ring->sqes)
+		(void)munmap((void *)ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_hdd_uring_setup()
+ *	set up an io-uring of at least entries SQEs,
+ *	returns 0 or -1 with errno set
+ */
+static int stress_hdd_uring_setup(stress_hdd_uring_t *ring, const unsigned entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sq_mmap = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto err;
+		ring->cq_mmap = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sqes = (struct io_uring_sqe *)ptr;
+
+	ring->sq_tail = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+	ring->submitted = ring->tail;
+
+	return 0;
+err:
+	err = errno;
+	stress_hdd_uring_close(ring);
+	errno = err;
+	return -1;
+}
+#endif
+
+/*
+ *  stress_hdd_async_deinit()
+ *	free the async engine context, any I/O still
+ *	in flight is cancelled or waited for by the kernel
+ */
+static void stress_hdd_async_deinit(stress_hdd_async_t *ctx)
+{
+#if defined(STRESS_HDD_AIO)
+	if (ctx->aio_ctx)
+		(void)syscall(__NR_io_destroy, ctx->aio_ctx);
+	free(ctx->events);
+	free(ctx->iocbps);
+	free(ctx->iocbs);
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	if (ctx->engine == HDD_ENGINE_IO_URING)
+		stress_hdd_uring_close(&ctx->ring);
+#endif
+	free(ctx->bufs);
+	free(ctx->res);
+	free(ctx->done);
+	free(ctx->free_slots);
+	free(ctx->slots);
+	(void)memset(ctx, 0, sizeof(*ctx));
+}
+
+/*
+ *  stress_hdd_async_init()
+ *	set up the engine and qdepth slots of buf_size bytes,
+ *	returns 0 or -1 with errno set
+ */
+static int stress_hdd_async_init(
+	stress_hdd_async_t *ctx,
+	const int engine,
+	const uint32_t qdepth,
+	const size_t buf_size)
+{
+	uint32_t i;
+	int err;
+
+	(void)memset(ctx, 0, sizeof(*ctx));
+	ctx->engine = engine;
+	ctx->fd = -1;
+	ctx->qdepth = qdepth;
+#if defined(STRESS_HDD_IO_URING)
+	ctx->ring.fd = -1;
+#endif
+	ctx->slots = calloc(qdepth, sizeof(*ctx->slots));
+	ctx->free_slots = calloc(qdepth, sizeof(*ctx->free_slots));
+	ctx->done = calloc(qdepth, sizeof(*ctx->done));
+	ctx->res = calloc(qdepth, sizeof(*ctx->res));
+	if (!ctx->slots || !ctx->free_slots || !ctx->done || !ctx->res) {
+		errno = ENOMEM;
+		goto err;
+	}
+#if defined(HAVE_POSIX_MEMALIGN)
+	if (posix_memalign(&ctx->bufs, BUF_ALIGNMENT, (size_t)qdepth * buf_size) || !ctx->bufs) {
+		ctx->bufs = NULL;
+		errno = ENOMEM;
+		goto err;
+	}
+#else
+	errno = ENOSYS;
+	goto err;
+#endif
+	for (i = 0; i < qdepth; i++) {
+		ctx->slots[i].buf = (uint8_t *)ctx->bufs + ((size_t)i * buf_size);
+		ctx->free_slots[i] = i;
+	}
+	ctx->n_free = qdepth;
+
+	switch (engine) {
+#if defined(STRESS_HDD_AIO)
+	case HDD_ENGINE_AIO:
+		ctx->iocbs = calloc(qdepth, sizeof(*ctx->iocbs));
+		ctx->iocbps = calloc(qdepth, sizeof(*ctx->iocbps));
+		ctx->events = calloc(qdepth, sizeof(*ctx->events));
+		if (!ctx->iocbs || !ctx->iocbps || !ctx->events) {
+			errno = ENOMEM;
+			goto err;
+		}
+		if (syscall(__NR_io_setup, qdepth, &ctx->aio_ctx) < 0) {
+			ctx->aio_ctx = 0;
+			goto err;
+		}
+		break;
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	case HDD_ENGINE_IO_URING:
+		if (stress_hdd_uring_setup(&ctx->ring, qdepth) < 0)
+			goto err;
+		break;
+#endif
+	default:
+		errno = EINVAL;
+		goto err;
+	}
+	return 0;
+err:
+	err = errno;
+	stress_hdd_async_deinit(ctx);
+	errno = err;
+	return -1;
+}
+
+/*
+ *  stress_hdd_async_queue()
+ *	queue a read or write of a slot, it is submitted
+ *	by the next stress_hdd_async_wait()
+ */
+static void stress_hdd_async_queue(
+	stress_hdd_async_t *ctx,
+	const uint32_t idx,
+	const bool write)
+{
+	const stress_hdd_slot_t *slot = &ctx->slots[idx];
+
+	switch (ctx->engine) {
+#if defined(STRESS_HDD_AIO)
+	case HDD_ENGINE_AIO: {
+			struct iocb *cb = &ctx->iocbs[idx];
+
+			(void)memset(cb, 0, sizeof(*cb));
+#if defined(HAVE_LIBAIO_H)
+			cb->aio_fildes = ctx->fd;
+			cb->aio_lio_opcode = write ? IO_CMD_PWRITE : IO_CMD_PREAD;
+			cb->u.c.buf = (void *)slot->buf;
+			cb->u.c.nbytes = slot->len;
+			cb->u.c.offset = (long long)slot->offset;
+#else
+			cb->aio_fildes = (uint32_t)ctx->fd;
+			cb->aio_lio_opcode = write ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+			cb->aio_buf = (uint64_t)(uintptr_t)slot->buf;
+			cb->aio_nbytes = (uint64_t)slot->len;
+			cb->aio_offset = (int64_t)slot->offset;
+#endif
+			ctx->iocbps[ctx->queued] = cb;
+		}
+		break;
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	case HDD_ENGINE_IO_URING: {
+			stress_hdd_uring_t *ring = &ctx->ring;
+			const unsigned sq_idx = ring->tail & *ring->sq_mask;
+			struct io_uring_sqe *sqe = &ring->sqes[sq_idx];
+
+			ring->sq_array[sq_idx] = sq_idx;
+			ring->tail++;
+			(void)memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+			sqe->fd = ctx->fd;
+			sqe->addr = (uintptr_t)slot->buf;
+			sqe->len = (uint32_t)slot->len;
+			sqe->off = slot->offset;
+			sqe->user_data = (uint64_t)idx;
+		}
+		break;
+#endif
+	default:
+		(void)slot;
+		(void)write;
+		break;
+	}
+	ctx->queued++;
+}
+
+/*
+ *  stress_hdd_async_wait()
+ *	submit the queued I/Os and wait for at least one to complete,
+ *	returns the number of completions in ctx->done and ctx->res
+ *	or -1 with errno set
+ */
+static int stress_hdd_async_wait(stress_hdd_async_t *ctx)
+{
+	int n = 0;
+
+	switch (ctx->engine) {
+#if defined(STRESS_HDD_AIO)
+	case HDD_ENGINE_AIO: {
+			int i;
+
+			while (ctx->queued) {
+				const long ret = syscall(__NR_io_submit, ctx->aio_ctx,
+					(long)ctx->queued, ctx->iocbps);
+
+				if (ret <= 0)
+					return -1;
+				/* Keep any unsubmitted iocbs at the front */
+				ctx->queued -= (uint32_t)ret;
+				(void)memmove(ctx->iocbps, ctx->iocbps + ret,
+					ctx->queued * sizeof(*ctx->iocbps));
+			}
+			n = (int)syscall(__NR_io_getevents, ctx->aio_ctx, 1L,
+				(long)ctx->qdepth, ctx->events, NULL);
+			if (n < 0)
+				return -1;
+			for (i = 0; i < n; i++) {
+#if defined(HAVE_LIBAIO_H)
+				const struct iocb *cb = ctx->events[i].obj;
+
+				ctx->res[i] = (int64_t)(long)ctx->events[i].res;
+#else
+				const struct iocb *cb = (const struct iocb *)(uintptr_t)ctx->events[i].obj;
+
+				ctx->res[i] = (int64_t)ctx->events[i].res;
+#endif
+				ctx->done[i] = (uint32_t)(cb - ctx->iocbs);
+			}
+		}
+		break;
+#endif
+#if defined(STRESS_HDD_IO_URING)
+	case HDD_ENGINE_IO_URING: {
+			stress_hdd_uring_t *ring = &ctx->ring;
+			unsigned head;
+			int ret;
+
+			*ring->sq_tail = ring->tail;
+			shim_mb();
+			ret = (int)syscall(__NR_io_uring_enter, ring->fd,
+				ring->tail - ring->submitted, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+			if (ret < 0)
+				return -1;
+			ring->submitted += (unsigned)ret;
+			ctx->queued = ring->tail - ring->submitted;
+
+			shim_mb();
+			for (head = *ring->cq_head; (head != *ring->cq_tail) &&
+			     (n < (int)ctx->qdepth); head++, n++) {
+				const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+				ctx->done[n] = (uint32_t)cqe->user_data;
+				ctx->res[n] = (int64_t)cqe->res;
+			}
+			*ring->cq_head = head;
+			shim_mb();
+		}
+		break;
+#endif
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+	return n;
+}
+
+/*
+ *  stress_hdd_async_pass()
+ *	write or read the blocks in the given order keeping up to
+ *	qdepth I/Os in flight, read data is checked with --verify,
+ *	returns 0, or -1 on a failed I/O
+ */
+static int stress_hdd_async_pass(
+	const stress_args_t *args,
+	stress_hdd_async_t *ctx,
+	const stress_hdd_block_t *blocks,
+	const uint32_t *order,
+	const size_t n_blocks,
+	const bool write,
+	const bool verify,
+	stress_hdd_lat_t *lat,
+	uint64_t *baddata,
+	bool *incomplete)
+{
+	const double t_begin = stress_time_now();
+	uint32_t inflight = 0;
+	size_t next = 0;
+	int rc = 0;
+
+	for (;;) {
+		double t_now;
+		int i, n;
+
+		while ((next < n_blocks) && (inflight < ctx->qdepth)) {
+			const stress_hdd_block_t *blk = &blocks[order[next++]];
+			const uint32_t idx = ctx->free_slots[--ctx->n_free];
+			stress_hdd_slot_t *slot = &ctx->slots[idx];
+
+			slot->offset = blk->offset;
+			slot->len = (size_t)blk->len;
+			if (write) {
+				size_t j;
+
+				for (j = 0; j < slot->len; j++)
+					slot->buf[j] = data_value(slot->offset, j, args);
+			}
+			slot->t_start = stress_time_now();
+			stress_hdd_async_queue(ctx, idx, write);
+			inflight++;
+		}
+		/* Stop queueing on a failure, let the in-flight I/Os drain */
+		if ((rc < 0) || *incomplete || !keep_stressing(args))
+			next = n_blocks;
+		if (!inflight)
+			break;
+
+		n = stress_hdd_async_wait(ctx);
+		if (n < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			pr_fail("%s: %s submit failed, errno=%d (%s)\n",
+				args->name, write ? "write" : "read",
+				errno, strerror(errno));
+			return -1;
+		}
+		t_now = stress_time_now();
+		for (i = 0; i < n; i++) {
+			const uint32_t idx = ctx->done[i];
+			const int64_t res = ctx->res[i];
+			const stress_hdd_slot_t *slot = &ctx->slots[idx];
+			const uint64_t ns = (uint64_t)((t_now - slot->t_start) * 1.0E9);
+
+			ctx->free_slots[ctx->n_free++] = idx;
+			inflight--;
+
+			if (res < 0) {
+				if (res == -ENOSPC) {
+					*incomplete = true;
+					continue;
+				}
+				pr_fail("%s: asynchronous %s failed, errno=%d (%s)\n",
+					args->name, write ? "write" : "read",
+					(int)-res, strerror((int)-res));
+				rc = -1;
+				continue;
+			}
+			if ((size_t)res != slot->len) {
+				if (write)
+					*incomplete = true;
+			}
+
+			lat->lat[stress_hdd_lat_bucket(ns)]++;
+			if (ns > lat->lat_max)
+				lat->lat_max = ns;
+			lat->ios++;
+			lat->bytes += (uint64_t)res;
+
+			if (!write && verify && !*incomplete) {
+				size_t j;
+
+				for (j = 0; j < (size_t)res; j++) {
+					if (slot->buf[j] != data_value(slot->offset, j, args))
+						(*baddata)++;
+				}
+			}
+			inc_counter(args);
+		}
+	}
+	lat->duration += stress_time_now() - t_begin;
+	return rc;
+}
+
+/*
+ *  stress_hdd_shuffle()
+ *	set order to 0..n - 1, shuffled if random is true
+ */
+static void stress_hdd_shuffle(uint32_t *order, const size_t n, const bool random)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		order[i] = (uint32_t)i;
+	if (!random)
+		return;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)(stress_mwc64() % (i + 1));
+		const uint32_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+}
+
+/*
+ *  stress_hdd_async()
+ *	write the whole file with the wr-seq or wr-rnd ordering of the
+ *	blocks, then read it all back with the rd-seq or rd-rnd ordering
+ *	and check every byte against data_value() with --verify
+ */
+static int stress_hdd_async(
+	const stress_args_t *args,
+	stress_hdd_async_t *ctx,
+	const int fd,
+	const stress_hdd_block_t *blocks,
+	uint32_t *order,
+	const size_t n_blocks,
+	const int hdd_flags,
+	stress_hdd_lat_t *lat_wr,
+	stress_hdd_lat_t *lat_rd,
+	uint64_t *baddata)
+{
+	const bool verify = !!(g_opt_flags & OPT_FLAGS_VERIFY);
+	bool incomplete = false;
+
+	ctx->fd = fd;
+	stress_hdd_shuffle(order, n_blocks, !!(hdd_flags & HDD_OPT_WR_RND));
+	if (stress_hdd_async_pass(args, ctx, blocks, order, n_blocks, true,
+				  verify, lat_wr, baddata, &incomplete) < 0)
+		return -1;
+	if (!keep_stressing(args))
+		return 0;
+#if defined(HAVE_FSYNC)
+	if (hdd_flags & HDD_OPT_FSYNC)
+		(void)shim_fsync(fd);
+#endif
+#if defined(HAVE_FDATASYNC)
+	if (hdd_flags & HDD_OPT_FDATASYNC)
+		(void)shim_fdatasync(fd);
+#endif
+#if defined(HAVE_SYNCFS)
+	if (hdd_flags & HDD_OPT_SYNCFS)
+		(void)syncfs(fd);
+#endif
+	if (incomplete)
+		pr_dbg("%s: file not completely written, skipping verification\n",
+			args->name);
+
+	stress_hdd_shuffle(order, n_blocks, !!(hdd_flags & HDD_OPT_RD_RND));
+	return stress_hdd_async_pass(args, ctx, blocks, order, n_blocks, false,
+				     verify, lat_rd, baddata, &incomplete);
+}
+
+/*
+ *  stress_hdd_blocks()
+ *	carve the file into blocks with sizes picked at random by
+ *	weight from the block size mix, returns the number of blocks
+ */
+static size_t stress_hdd_blocks(
+	stress_hdd_block_t *blocks,
+	const uint64_t file_size,
+	const stress_hdd_bs_t *mix,
+	const int n_mix)
+{
+	uint64_t offset, total = 0;
+	size_t n = 0;
+	int i;
+
+	for (i = 0; i < n_mix; i++)
+		total += mix[i].weight;
+
+	for (offset = 0; offset < file_size; n++) {
+		uint64_t r = stress_mwc64() % total, size = mix[n_mix - 1].size;
+
+		for (i = 0; i < n_mix; i++) {
+			if (r < mix[i].weight) {
+				size = mix[i].size;
+				break;
+			}
+			r -= mix[i].weight;
+		}
+		if (size > file_size - offset)
+			size = file_size - offset;
+		blocks[n].offset = offset;
+		blocks[n].len = (uint32_t)size;
+		offset += size;
+	}
+	return n;
+}
+
+/*
+ *  stress_hdd_lat_report()
+ *	report the IOPS, throughput and latency percentiles of
+ *	one direction of the async engine I/O
+ */
+static void stress_hdd_lat_report(
+	const stress_args_t *args,
+	bool *lock,
+	const char *dir,
+	const stress_hdd_lat_t *lat,
+	const int idx)
+{
+	static const double percentiles[] = { 50.0, 99.0, 99.9 };
+	uint64_t values[SIZEOF_ARRAY(percentiles)];
+	const double iops = (lat->duration > 0.0) ? (double)lat->ios / lat->duration : 0.0;
+	const double mb_per_sec = (lat->duration > 0.0) ?
+		((double)lat->bytes / (double)MB) / lat->duration : 0.0;
+	uint64_t sum = 0;
+	size_t i, b = 0;
+	char desc[32];
+
+	if (!lat->ios)
+		return;
+
+	for (i = 0; i < SIZEOF_ARRAY(percentiles); i++) {
+		const uint64_t target = (uint64_t)ceil(((double)lat->ios *
+			percentiles[i]) / 100.0);
+
+		while ((b < HDD_LAT_BUCKETS - 1) && (sum + lat->lat[b] < target))
+			sum += lat->lat[b++];
+		values[i] = STRESS_MINIMUM(stress_hdd_lat_value(b), lat->lat_max);
+	}
+
+	(void)snprintf(desc, sizeof(desc), "%s IOPS", dir);
+	stress_misc_stats_set(args->misc_stats, idx, desc, iops);
+	(void)snprintf(desc, sizeof(desc), "%s MB per sec", dir);
+	stress_misc_stats_set(args->misc_stats, idx + 1, desc, mb_per_sec);
+	(void)snprintf(desc, sizeof(desc), "%s p50 latency usec", dir);
+	stress_misc_stats_set(args->misc_stats, idx + 2, desc, (double)values[0] / 1000.0);
+	(void)snprintf(desc, sizeof(desc), "%s p99 latency usec", dir);
+	stress_misc_stats_set(args->misc_stats, idx + 3, desc, (double)values[1] / 1000.0);
+	(void)snprintf(desc, sizeof(desc), "%s p99.9 latency usec", dir);
+	stress_misc_stats_set(args->misc_stats, idx + 4, desc, (double)values[2] / 1000.0);
+
+	if (args->instance == 0) {
+		pr_inf_lock(lock, "%s: %-5s %10.1f IOPS %9.2f MB/sec, latency p50 %.1f "
+			"p99 %.1f p99.9 %.1f max %.1f usec\n", args->name, dir,
+			iops, mb_per_sec, (double)values[0] / 1000.0,
+			(double)values[1] / 1000.0, (double)values[2] / 1000.0,
+			(double)lat->lat_max / 1000.0);
+	}
+}
+#endif
+
 /*
  *  stress_hdd
  *	stress I/O via writes
@@ -567,11 +1448,28 @@ static int stress_hdd(const stress_args_t *args)
 	uint64_t hdd_write_size = DEFAULT_HDD_WRITE_SIZE;
 	int hdd_flags = 0, hdd_oflags = 0;
 	int flags, fadvise_flags;
+	int hdd_engine = HDD_ENGINE_SYNC;
 	bool opts_set = false;
+#if defined(STRESS_HDD_ASYNC)
+	uint32_t hdd_qdepth = DEFAULT_HDD_QDEPTH;
+	char *hdd_bs_mix = NULL;
+	stress_hdd_bs_t mix[HDD_BS_MIX_MAX];
+	stress_hdd_async_t async;
+	stress_hdd_block_t *blocks = NULL;
+	uint32_t *order = NULL;
+	size_t n_blocks = 0;
+	stress_hdd_lat_t lat_wr, lat_rd;
+	uint64_t async_baddata = 0;
+
+	(void)memset(&async, 0, sizeof(async));
+	(void)memset(&lat_wr, 0, sizeof(lat_wr));
+	(void)memset(&lat_rd, 0, sizeof(lat_rd));
+#endif
 
 	(void)stress_get_setting("hdd-flags", &hdd_flags);
 	(void)stress_get_setting("hdd-oflags", &hdd_oflags);
 	(void)stress_get_setting("hdd-opts-set", &opts_set);
+	(void)stress_get_setting("hdd-engine", &hdd_engine);
 
 	flags = O_CREAT | O_RDWR | O_TRUNC | hdd_oflags;
 	fadvise_flags = hdd_flags & HDD_OPT_FADV_MASK;
@@ -660,6 +1558,63 @@ static int stress_hdd(const stress_args_t *args)
 	(void)stress_temp_filename_args(args,
 		filename, sizeof(filename), stress_mwc32());
 
+#if defined(STRESS_HDD_ASYNC)
+	if (hdd_engine != HDD_ENGINE_SYNC) {
+		uint64_t bs_min = MAX_HDD_WRITE_SIZE, bs_max = 0, file_size;
+		size_t max_blocks;
+		int k, n_mix = 1;
+
+		(void)stress_get_setting("hdd-qdepth", &hdd_qdepth);
+		(void)stress_get_setting("hdd-bs-mix", &hdd_bs_mix);
+		if (hdd_bs_mix) {
+			n_mix = stress_hdd_bs_mix_parse(hdd_bs_mix, mix);
+			if (n_mix < 0)
+				goto finish;
+		} else {
+			mix[0].size = (hdd_write_size + HDD_BS_MIN - 1) &
+				~(uint64_t)(HDD_BS_MIN - 1);
+			mix[0].weight = 1;
+		}
+		for (k = 0; k < n_mix; k++) {
+			/* O_DIRECT I/O has to be in whole aligned blocks */
+			if (hdd_flags & HDD_OPT_O_DIRECT)
+				mix[k].size = (mix[k].size + BUF_ALIGNMENT - 1) &
+					~(uint64_t)(BUF_ALIGNMENT - 1);
+			if (mix[k].size < bs_min)
+				bs_min = mix[k].size;
+			if (mix[k].size > bs_max)
+				bs_max = mix[k].size;
+		}
+		if ((uint64_t)hdd_qdepth * bs_max > HDD_ASYNC_BUF_MAX) {
+			hdd_qdepth = (uint32_t)(HDD_ASYNC_BUF_MAX / bs_max);
+			if (args->instance == 0)
+				pr_inf("%s: limiting queue depth to %" PRIu32
+					" to fit the in-flight buffers in %d MB\n",
+					args->name, hdd_qdepth, (int)(HDD_ASYNC_BUF_MAX / MB));
+		}
+		file_size = hdd_bytes & ~(uint64_t)(BUF_ALIGNMENT - 1);
+		if (!file_size)
+			file_size = BUF_ALIGNMENT;
+		max_blocks = (size_t)((file_size + bs_min - 1) / bs_min);
+		blocks = calloc(max_blocks, sizeof(*blocks));
+		order = calloc(max_blocks, sizeof(*order));
+		if (!blocks || !order) {
+			pr_inf_skip("%s: cannot allocate %zu block descriptors, "
+				"skipping stressor\n", args->name, max_blocks);
+			rc = EXIT_NO_RESOURCE;
+			goto finish;
+		}
+		n_blocks = stress_hdd_blocks(blocks, file_size, mix, n_mix);
+		if (stress_hdd_async_init(&async, hdd_engine, hdd_qdepth, (size_t)bs_max) < 0) {
+			pr_inf_skip("%s: cannot set up the asynchronous I/O engine, "
+				"errno=%d (%s), skipping stressor\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			goto finish;
+		}
+	}
+#endif
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -752,6 +1707,17 @@ static int stress_hdd(const stress_args_t *args)
 		stress_hdd_invalid_write(fd, buf);
 		stress_hdd_invalid_read(fd, buf);
 
+#if defined(STRESS_HDD_ASYNC)
+		if (hdd_engine != HDD_ENGINE_SYNC) {
+			ret = stress_hdd_async(args, &async, fd, blocks, order,
+				n_blocks, hdd_flags, &lat_wr, &lat_rd, &async_baddata);
+			(void)close(fd);
+			if (ret < 0)
+				goto finish;
+			continue;
+		}
+#endif
+
 		/* Random Write */
 		if (hdd_flags & HDD_OPT_WR_RND) {
 			uint32_t w, z;
@@ -967,17 +1933,45 @@ rnd_rd_retry:
 
 yielded:
 	rc = EXIT_SUCCESS;
+#if defined(STRESS_HDD_ASYNC)
+	if (hdd_engine != HDD_ENGINE_SYNC) {
+		bool lock = false;
+
+		pr_lock(&lock);
+		if (args->instance == 0)
+			pr_inf_lock(&lock, "%s: %s engine, queue depth %" PRIu32
+				", %zu blocks per file:\n", args->name,
+				(hdd_engine == HDD_ENGINE_AIO) ? "aio" : "io-uring",
+				async.qdepth, n_blocks);
+		stress_hdd_lat_report(args, &lock, "write", &lat_wr, 0);
+		stress_hdd_lat_report(args, &lock, "read", &lat_rd, 5);
+		pr_unlock(&lock);
+		if (async_baddata) {
+			pr_fail("%s: incorrect data found %" PRIu64 " times\n",
+				args->name, async_baddata);
+			rc = EXIT_FAILURE;
+		}
+	}
+#endif
 finish:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
+#if defined(STRESS_HDD_ASYNC)
+	stress_hdd_async_deinit(&async);
+	free(order);
+	free(blocks);
+#endif
 	free(alloc_buf);
 	(void)stress_temp_dir_rm_args(args);
 	return rc;
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_hdd_bs_mix,	stress_set_hdd_bs_mix },
 	{ OPT_hdd_bytes,	stress_set_hdd_bytes },
+	{ OPT_hdd_engine,	stress_set_hdd_engine },
 	{ OPT_hdd_opts,		stress_set_hdd_opts },
+	{ OPT_hdd_qdepth,	stress_set_hdd_qdepth },
 	{ OPT_hdd_write_size,	stress_set_hdd_write_size },
 	{ 0,			NULL },
 };
@@ -29,9 +29,39 @@ static const char bitmap_file[] = "/sys/kernel/mm/page_idle/bitmap";
 static const stress_help_t help[] = {
 	{ NULL,	"idle-page N",	   "start N idle page scanning workers" },
 	{ NULL,	"idle-page-ops N", "stop after N idle page scan bogo operations" },
+	{ NULL,	"idle-page-bench", "benchmark working set estimation scan costs" },
+	{ NULL,	"idle-page-bytes N", "largest working set size to benchmark" },
 	{ NULL, NULL,		   NULL }
 };
 
+#define MIN_IDLE_PAGE_BYTES	(16 * MB)
+#define MAX_IDLE_PAGE_BYTES	(MAX_MEM_LIMIT)
+#define DEFAULT_IDLE_PAGE_BYTES	(256 * MB)
+
+static int stress_set_idle_page_bench(const char *opt)
+{
+	bool idle_page_bench = true;
+
+	(void)opt;
+	return stress_set_setting("idle-page-bench", TYPE_ID_BOOL, &idle_page_bench);
+}
+
+static int stress_set_idle_page_bytes(const char *opt)
+{
+	size_t idle_page_bytes;
+
+	idle_page_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("idle-page-bytes", idle_page_bytes,
+		MIN_IDLE_PAGE_BYTES, MAX_IDLE_PAGE_BYTES);
+	return stress_set_setting("idle-page-bytes", TYPE_ID_SIZE_T, &idle_page_bytes);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_idle_page_bench,	stress_set_idle_page_bench },
+	{ OPT_idle_page_bytes,	stress_set_idle_page_bytes },
+	{ 0,			NULL }
+};
+
 /*
  *  stress_idle_page_supported()
  *      check if we can run this as root
@@ -51,9 +81,11 @@ static int stress_idle_page_supported(const char *name)
 		return -1;
 	}
 
-	if (access(bitmap_file, R_OK) != 0) {
+	/* the benchmark mode can use MGLRU aging without idle page tracking */
+	if ((access(bitmap_file, R_OK) != 0) &&
+	    (access("/sys/kernel/debug/lru_gen", R_OK) != 0)) {
 		pr_inf_skip("%s stressor will be skipped, "
-			"cannot access file %s\n", bitmap_file, name);
+			"cannot access file %s\n", name, bitmap_file);
 		return -1;
 	}
 	return 0;
@@ -64,6 +96,499 @@ static int stress_idle_page_supported(const char *name)
 #define BITMAP_BYTES	(8)
 #define PAGES_TO_SCAN	(64)
 
+#define PAGE_PRESENT		(1ULL << 63)
+#define PFN_MASK		((1ULL << 55) - 1)
+#define IDLE_PAGE_MIN_BENCH	(16 * MB)
+#define IDLE_PAGE_MAX_SIZES	(24)
+#define IDLE_PAGE_CHUNK		(4096)	/* pagemap entries or bitmap words per I/O */
+#define IDLE_PAGE_ACCESS_STRIDE	(4)	/* touch 1 in 4 pages between scans */
+
+static const char lru_gen_file[] = "/sys/kernel/debug/lru_gen";
+
+typedef struct {
+	size_t size;		/* process working set size in bytes */
+	uint64_t rounds;	/* measurements summed */
+	double pagemap;		/* CPU seconds translating with pagemap */
+	double mark;		/* CPU seconds marking pages idle */
+	double check;		/* CPU seconds reading back the idle bits */
+	double idle_wss;	/* % of the pages found accessed */
+	uint64_t idle_rounds;	/* rounds with an idle page tracking scan */
+	double age;		/* CPU seconds in MGLRU aging */
+	double lru_wss;		/* % of the pages in the youngest generation */
+	uint64_t lru_rounds;	/* rounds with an MGLRU aging scan */
+} stress_idle_page_result_t;
+
+/*
+ *  stress_idle_page_cpu_time()
+ *	CPU time of this thread in seconds, the scans are all
+ *	kernel work done in system calls
+ */
+static double stress_idle_page_cpu_time(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+#endif
+	return stress_time_now();
+}
+
+/*
+ *  stress_idle_page_pagemap()
+ *	translate the pages of a buffer to PFNs with /proc/self/pagemap,
+ *	returns the number of present pages with a PFN
+ */
+static size_t stress_idle_page_pagemap(
+	const int fd,
+	const uint8_t *buf,
+	const size_t pages,
+	const size_t page_size,
+	uint64_t *pfns)
+{
+	static uint64_t entries[IDLE_PAGE_CHUNK];
+	const off_t base = (off_t)(((uintptr_t)buf / page_size) * sizeof(uint64_t));
+	size_t i, n = 0;
+
+	for (i = 0; i < pages; i += IDLE_PAGE_CHUNK) {
+		const size_t count = STRESS_MINIMUM(pages - i, (size_t)IDLE_PAGE_CHUNK);
+		const ssize_t len = (ssize_t)(count * sizeof(uint64_t));
+		size_t j;
+
+		if (pread(fd, entries, (size_t)len, base + (off_t)(i * sizeof(uint64_t))) != len)
+			break;
+		for (j = 0; j < count; j++) {
+			const uint64_t pfn = entries[j] & PFN_MASK;
+
+			if ((entries[j] & PAGE_PRESENT) && pfn)
+				pfns[n++] = pfn;
+		}
+	}
+	return n;
+}
+
+static int stress_idle_page_pfn_cmp(const void *p1, const void *p2)
+{
+	const uint64_t pfn1 = *(const uint64_t *)p1;
+	const uint64_t pfn2 = *(const uint64_t *)p2;
+
+	if (pfn1 < pfn2)
+		return -1;
+	return (pfn1 > pfn2) ? 1 : 0;
+}
+
+/*
+ *  stress_idle_page_mark()
+ *	mark the PFNs idle, writing runs of consecutive bitmap words,
+ *	and keep the word offsets and masks to read back, returns the
+ *	number of words
+ */
+static size_t stress_idle_page_mark(
+	const int fd,
+	uint64_t *pfns,
+	const size_t n_pfns,
+	uint64_t *words,
+	uint64_t *masks)
+{
+	size_t i, n = 0, run = 0;
+
+	qsort(pfns, n_pfns, sizeof(*pfns), stress_idle_page_pfn_cmp);
+	for (i = 0; i < n_pfns; i++) {
+		const uint64_t word = pfns[i] / 64;
+
+		if (n && (words[n - 1] == word)) {
+			masks[n - 1] |= 1ULL << (pfns[i] % 64);
+			continue;
+		}
+		words[n] = word;
+		masks[n] = 1ULL << (pfns[i] % 64);
+		n++;
+	}
+	for (i = 0; i < n; i = run) {
+		for (run = i + 1; (run < n) && (run - i < IDLE_PAGE_CHUNK) &&
+		     (words[run] == words[run - 1] + 1); run++)
+			;
+		(void)pwrite(fd, &masks[i], (run - i) * sizeof(uint64_t),
+			(off_t)(words[i] * sizeof(uint64_t)));
+	}
+	return n;
+}
+
+/*
+ *  stress_idle_page_check()
+ *	read back the bitmap words of the marked PFNs, returns the
+ *	number of PFNs that are still idle
+ */
+static size_t stress_idle_page_check(
+	const int fd,
+	const uint64_t *words,
+	const uint64_t *masks,
+	const size_t n)
+{
+	static uint64_t bits[IDLE_PAGE_CHUNK];
+	size_t i, j, run = 0, idle = 0;
+
+	for (i = 0; i < n; i = run) {
+		ssize_t len;
+
+		for (run = i + 1; (run < n) && (run - i < IDLE_PAGE_CHUNK) &&
+		     (words[run] == words[run - 1] + 1); run++)
+			;
+		len = (ssize_t)((run - i) * sizeof(uint64_t));
+		if (pread(fd, bits, (size_t)len, (off_t)(words[i] * sizeof(uint64_t))) != len)
+			continue;
+		for (j = i; j < run; j++) {
+			uint64_t v = bits[j - i] & masks[j];
+
+			while (v) {
+				v &= v - 1;
+				idle++;
+			}
+		}
+	}
+	return idle;
+}
+
+/*
+ *  stress_idle_page_memcg()
+ *	get the memory cgroup path of this process
+ */
+static bool stress_idle_page_memcg(char *path, const size_t len)
+{
+	char buffer[4096];
+	FILE *fp;
+	bool found = false;
+
+	fp = fopen("/proc/self/cgroup", "r");
+	if (!fp)
+		return false;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char *ptr;
+
+		/* a v1 memory controller takes precedence over the v2 hierarchy */
+		if ((ptr = strstr(buffer, ":memory:")) != NULL)
+			ptr += 8;
+		else if (!strncmp(buffer, "0::", 3))
+			ptr = buffer + 3;
+		else
+			continue;
+		ptr[strcspn(ptr, "\n")] = '\0';
+		(void)shim_strlcpy(path, ptr, len);
+		found = true;
+		if (strncmp(buffer, "0::", 3))
+			break;
+	}
+	(void)fclose(fp);
+	return found;
+}
+
+/*
+ *  stress_idle_page_lru_gen()
+ *	find the memcg id, the youngest generation and its anon page
+ *	count of the memcg and node in the MGLRU debugfs listing
+ */
+static bool stress_idle_page_lru_gen(
+	const char *memcg,
+	const int node,
+	unsigned int *memcg_id,
+	unsigned long *max_seq,
+	unsigned long *young_anon)
+{
+	char buffer[4096], path[PATH_MAX];
+	FILE *fp;
+	bool in_memcg = false, in_node = false, found = false;
+
+	fp = fopen(lru_gen_file, "r");
+	if (!fp)
+		return false;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		unsigned long seq, anon, file;
+		unsigned int id, age;
+		int n;
+
+		if (sscanf(buffer, "memcg %u %4095s", &id, path) == 2) {
+			in_memcg = !strcmp(path, memcg);
+			if (in_memcg)
+				*memcg_id = id;
+			in_node = false;
+		} else if (sscanf(buffer, " node %d", &n) == 1) {
+			in_node = in_memcg && (n == node);
+		} else if (in_node &&
+			   (sscanf(buffer, "%lu %u %lu %lu", &seq, &age, &anon, &file) == 4)) {
+			if (!found || (seq >= *max_seq)) {
+				*max_seq = seq;
+				*young_anon = anon;
+			}
+			found = true;
+		}
+	}
+	(void)fclose(fp);
+	return found;
+}
+
+/*
+ *  stress_idle_page_lru_gen_age()
+ *	age the memcg and node, forcing a page table scan, so pages
+ *	accessed since the last aging move to a new youngest generation
+ */
+static bool stress_idle_page_lru_gen_age(
+	const unsigned int memcg_id,
+	const int node,
+	const unsigned long max_seq)
+{
+	char cmd[128];
+	int len;
+
+	len = snprintf(cmd, sizeof(cmd), "+ %u %d %lu 1 1\n", memcg_id, node, max_seq);
+	return system_write(lru_gen_file, cmd, (size_t)len) > 0;
+}
+
+/*
+ *  stress_idle_page_touch()
+ *	access one in IDLE_PAGE_ACCESS_STRIDE pages of the buffer
+ */
+static void stress_idle_page_touch(uint8_t *buf, const size_t pages, const size_t page_size)
+{
+	size_t i;
+
+	for (i = 0; i < pages; i += IDLE_PAGE_ACCESS_STRIDE)
+		buf[i * page_size]++;
+}
+
+/*
+ *  stress_idle_page_bench_size()
+ *	measure a full scan of a size byte working set with idle page
+ *	tracking and with MGLRU aging
+ */
+static int stress_idle_page_bench_size(
+	const stress_args_t *args,
+	const int fd_bitmap,
+	const int fd_pagemap,
+	const char *memcg,
+	const int node,
+	stress_idle_page_result_t *result)
+{
+	const size_t page_size = args->page_size;
+	const size_t pages = result->size / page_size;
+	uint64_t *pfns, *words, *masks;
+	uint8_t *buf;
+	size_t n_pfns;
+	double t;
+
+	buf = (uint8_t *)mmap(NULL, result->size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return -1;
+	pfns = calloc(pages, sizeof(*pfns));
+	words = calloc(pages, sizeof(*words));
+	masks = calloc(pages, sizeof(*masks));
+	if (!pfns || !words || !masks)
+		goto tidy;
+	(void)memset(buf, 0x5a, result->size);
+
+	t = stress_idle_page_cpu_time();
+	n_pfns = stress_idle_page_pagemap(fd_pagemap, buf, pages, page_size, pfns);
+	result->pagemap += stress_idle_page_cpu_time() - t;
+	result->rounds++;
+
+	if ((fd_bitmap >= 0) && (n_pfns > 0)) {
+		size_t n_words, idle;
+
+		t = stress_idle_page_cpu_time();
+		n_words = stress_idle_page_mark(fd_bitmap, pfns, n_pfns, words, masks);
+		result->mark += stress_idle_page_cpu_time() - t;
+
+		stress_idle_page_touch(buf, pages, page_size);
+
+		t = stress_idle_page_cpu_time();
+		idle = stress_idle_page_check(fd_bitmap, words, masks, n_words);
+		result->check += stress_idle_page_cpu_time() - t;
+		result->idle_wss += 100.0 * (double)(n_pfns - STRESS_MINIMUM(idle, n_pfns)) / (double)n_pfns;
+		result->idle_rounds++;
+	}
+
+	if (*memcg) {
+		unsigned int memcg_id = 0;
+		unsigned long max_seq = 0, young_anon = 0;
+
+		/* age once to start a generation, touch, age again to isolate it */
+		if (stress_idle_page_lru_gen(memcg, node, &memcg_id, &max_seq, &young_anon)) {
+			double age = 0.0;
+			bool ok;
+
+			t = stress_idle_page_cpu_time();
+			ok = stress_idle_page_lru_gen_age(memcg_id, node, max_seq);
+			age += stress_idle_page_cpu_time() - t;
+			stress_idle_page_touch(buf, pages, page_size);
+			if (ok && stress_idle_page_lru_gen(memcg, node, &memcg_id, &max_seq, &young_anon)) {
+				t = stress_idle_page_cpu_time();
+				ok = stress_idle_page_lru_gen_age(memcg_id, node, max_seq);
+				age += stress_idle_page_cpu_time() - t;
+				if (ok && stress_idle_page_lru_gen(memcg, node, &memcg_id, &max_seq, &young_anon)) {
+					result->age += age / 2.0;
+					result->lru_wss += 100.0 * (double)young_anon / (double)pages;
+					result->lru_rounds++;
+				}
+			}
+		}
+	}
+tidy:
+	free(masks);
+	free(words);
+	free(pfns);
+	(void)munmap((void *)buf, result->size);
+	return 0;
+}
+
+/*
+ *  stress_idle_page_per_gb()
+ *	CPU milliseconds per GB of working set, or -1 if not measured
+ */
+static inline double stress_idle_page_per_gb(const double secs, const uint64_t rounds, const size_t size)
+{
+	if (!rounds || !size)
+		return -1.0;
+	return (1000.0 * secs / (double)rounds) * ((double)GB / (double)size);
+}
+
+/*
+ *  stress_idle_page_report()
+ *	report the scan costs by working set size
+ */
+static void stress_idle_page_report(
+	const stress_args_t *args,
+	const stress_idle_page_result_t *results,
+	const size_t n)
+{
+	static const char * const heads[] = {
+		"pagemap", "mark", "check", "idle scan", "idle wss%", "lru age", "lru wss%"
+	};
+	char line[256];
+	bool lock = false;
+	size_t i, c, pos;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: full working set scan CPU ms per GB and accessed %% "
+		"(1 in %d pages accessed)\n", args->name, IDLE_PAGE_ACCESS_STRIDE);
+	pos = (size_t)snprintf(line, sizeof(line), "%8s", "size MB");
+	for (c = 0; c < SIZEOF_ARRAY(heads); c++)
+		pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %9s", heads[c]);
+	pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+	for (i = 0; i < n; i++) {
+		const stress_idle_page_result_t *r = &results[i];
+		double vals[SIZEOF_ARRAY(heads)];
+
+		vals[0] = stress_idle_page_per_gb(r->pagemap, r->rounds, r->size);
+		vals[1] = stress_idle_page_per_gb(r->mark, r->idle_rounds, r->size);
+		vals[2] = stress_idle_page_per_gb(r->check, r->idle_rounds, r->size);
+		vals[3] = r->idle_rounds ? vals[0] + vals[1] + vals[2] : -1.0;
+		vals[4] = r->idle_rounds ? r->idle_wss / (double)r->idle_rounds : -1.0;
+		vals[5] = stress_idle_page_per_gb(r->age, r->lru_rounds, r->size);
+		vals[6] = r->lru_rounds ? r->lru_wss / (double)r->lru_rounds : -1.0;
+
+		pos = (size_t)snprintf(line, sizeof(line), "%8zu", r->size / (size_t)MB);
+		for (c = 0; c < SIZEOF_ARRAY(vals); c++) {
+			if (vals[c] >= 0.0)
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %9.2f", vals[c]);
+			else
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %9s", "n/a");
+		}
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_idle_page_bench()
+ *	measure the CPU cost of estimating the working set of processes
+ *	of doubling sizes up to idle-page-bytes, with idle page tracking
+ *	(pagemap translation, marking idle, reading back) and with MGLRU
+ *	aging, one bogo op per sweep of the sizes
+ */
+static int stress_idle_page_bench(const stress_args_t *args)
+{
+	static stress_idle_page_result_t results[IDLE_PAGE_MAX_SIZES];
+	size_t idle_page_bytes = DEFAULT_IDLE_PAGE_BYTES, size, n = 0, i;
+	char memcg[PATH_MAX];
+	unsigned int cpu = 0, node = 0;
+	int fd_bitmap, fd_pagemap;
+
+	(void)stress_get_setting("idle-page-bytes", &idle_page_bytes);
+
+	fd_pagemap = open("/proc/self/pagemap", O_RDONLY);
+	if (fd_pagemap < 0) {
+		pr_inf("%s: cannot open /proc/self/pagemap, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	fd_bitmap = open(bitmap_file, O_RDWR);
+	if ((fd_bitmap < 0) && (args->instance == 0))
+		pr_inf("%s: cannot open %s, no idle page tracking scans\n",
+			args->name, bitmap_file);
+
+	*memcg = '\0';
+	if (shim_getcpu(&cpu, &node, NULL) < 0)
+		node = 0;
+	if (access(lru_gen_file, W_OK) || !stress_idle_page_memcg(memcg, sizeof(memcg))) {
+		*memcg = '\0';
+		if (args->instance == 0)
+			pr_inf("%s: cannot use %s, no MGLRU aging scans\n",
+				args->name, lru_gen_file);
+	}
+
+	(void)memset(results, 0, sizeof(results));
+	for (size = IDLE_PAGE_MIN_BENCH; (size <= idle_page_bytes) && (n < IDLE_PAGE_MAX_SIZES); size <<= 1)
+		results[n++].size = size;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (i = 0; (i < n) && keep_stressing_flag(); i++) {
+			if (stress_idle_page_bench_size(args, fd_bitmap, fd_pagemap,
+							memcg, (int)node, &results[i]) < 0) {
+				/* drop sizes that cannot be allocated */
+				n = i;
+				break;
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args) && (n > 0));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (fd_bitmap >= 0)
+		(void)close(fd_bitmap);
+	(void)close(fd_pagemap);
+
+	/* drop sizes that the run ended before measuring */
+	while ((n > 0) && !results[n - 1].rounds)
+		n--;
+	if (n == 0) {
+		pr_inf("%s: no working set sizes could be measured\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (args->instance == 0)
+		stress_idle_page_report(args, results, n);
+
+	i = n - 1;
+	stress_misc_stats_set(args->misc_stats, 0, "working set MB",
+		(double)results[i].size / (double)MB);
+	stress_misc_stats_set(args->misc_stats, 1, "pagemap CPU ms per GB",
+		STRESS_MAXIMUM(0.0, stress_idle_page_per_gb(results[i].pagemap, results[i].rounds, results[i].size)));
+	stress_misc_stats_set(args->misc_stats, 2, "idle mark CPU ms per GB",
+		STRESS_MAXIMUM(0.0, stress_idle_page_per_gb(results[i].mark, results[i].idle_rounds, results[i].size)));
+	stress_misc_stats_set(args->misc_stats, 3, "idle check CPU ms per GB",
+		STRESS_MAXIMUM(0.0, stress_idle_page_per_gb(results[i].check, results[i].idle_rounds, results[i].size)));
+	stress_misc_stats_set(args->misc_stats, 4, "idle accessed pages %",
+		results[i].idle_rounds ? results[i].idle_wss / (double)results[i].idle_rounds : 0.0);
+	stress_misc_stats_set(args->misc_stats, 5, "lru_gen age CPU ms per GB",
+		STRESS_MAXIMUM(0.0, stress_idle_page_per_gb(results[i].age, results[i].lru_rounds, results[i].size)));
+	stress_misc_stats_set(args->misc_stats, 6, "lru_gen young pages %",
+		results[i].lru_rounds ? results[i].lru_wss / (double)results[i].lru_rounds : 0.0);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_idle_page
  *	stress kernel logging interface
@@ -73,6 +598,11 @@ static int stress_idle_page(const stress_args_t *args)
 	int fd;
 	off_t posn = 0, last_posn = ~(off_t)7;
 	uint64_t bitmap_set[PAGES_TO_SCAN] ALIGNED(8);
+	bool idle_page_bench = false;
+
+	(void)stress_get_setting("idle-page-bench", &idle_page_bench);
+	if (idle_page_bench)
+		return stress_idle_page_bench(args);
 
 	fd = open(bitmap_file, O_RDWR);
 	if (fd < 0) {
@@ -133,6 +663,7 @@ stressor_info_t stress_idle_page_info = {
 	.stressor = stress_idle_page,
 	.supported = stress_idle_page_supported,
 	.class = CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
@@ -140,6 +671,7 @@ stressor_info_t stress_idle_page_info = {
 	.stressor = stress_not_implemented,
 	.supported = stress_idle_page_supported,
 	.class = CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -0,0 +1,787 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"interfere N",		 "start N workers measuring memory bandwidth interference" },
+	{ NULL,	"interfere-ops N",	 "stop after N interfere measurement points" },
+	{ NULL,	"interfere-hogs N",	 "number of memory bandwidth hog processes" },
+	{ NULL,	"interfere-mba list",	 "comma separated hog memory bandwidth percentages" },
+	{ NULL,	"interfere-l3 list",	 "comma separated hog L3 cache way masks in hex" },
+	{ NULL,	"interfere-probe-size N", "latency probe pointer chase working set size" },
+	{ NULL,	NULL,			 NULL }
+};
+
+#define MIN_INTERFERE_HOGS		(1)
+#define MAX_INTERFERE_HOGS		(64)
+#define MIN_INTERFERE_PROBE_SIZE	(4 * KB)
+#define MAX_INTERFERE_PROBE_SIZE	(1 * GB)
+#define DEFAULT_INTERFERE_PROBE_SIZE	(4 * MB)
+#define INTERFERE_MAX_LIST		(8)		/* entries in a --interfere-mba or -l3 list */
+#define INTERFERE_MAX_CONFIGS		(1 + (2 * INTERFERE_MAX_LIST))
+#define INTERFERE_MAX_DOMAINS		(64)
+#define INTERFERE_HOG_BYTES		(128 * MB)	/* per hog, well beyond the LLC */
+#define INTERFERE_PHASE			(0.2)		/* seconds probing alone and loaded */
+#define INTERFERE_SETTLE		(20000)		/* microseconds for the hogs to ramp up */
+#define INTERFERE_LINE			(64)
+#define INTERFERE_COUNTER_STRIDE	(8)		/* uint64_t, one hog counter per cache line */
+#define INTERFERE_RESCTRL		"/sys/fs/resctrl"
+
+/* one allocation setting for the hogs resctrl group */
+typedef struct {
+	uint32_t mba;		/* memory bandwidth percent, 0 for unconstrained */
+	uint64_t l3;		/* cache bit mask, 0 for all of the L3 */
+	double base_ns;		/* probe ns per load alone, total */
+	double loaded_ns;	/* probe ns per load with the hogs, total */
+	uint32_t samples;
+	double hog_bytes;	/* bytes moved by the hogs while loaded */
+	double hog_time;	/* seconds the hogs were running */
+	double hog_cpu;		/* CPU seconds the hogs used, -1 if unknown */
+	bool unsupported;
+} stress_interfere_config_t;
+
+typedef struct {
+	bool available;
+	bool mbm;			/* memory bandwidth monitoring */
+	int mb_ids[INTERFERE_MAX_DOMAINS];
+	int n_mb;
+	int l3_ids[INTERFERE_MAX_DOMAINS];
+	int n_l3;
+	uint64_t l3_full;		/* info/L3/cbm_mask */
+	char probe_dir[PATH_MAX];
+	char hog_dir[PATH_MAX];
+} stress_interfere_resctrl_t;
+
+/*
+ *  stress_interfere_list_parse()
+ *	parse a comma separated list of decimal or hex (base 16)
+ *	values, returns the number of values or -1
+ */
+static int stress_interfere_list_parse(
+	const char *option,
+	const char *opt,
+	const int base,
+	const uint64_t lo,
+	const uint64_t hi,
+	uint64_t *values)
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		char *end;
+		uint64_t val;
+
+		if (n >= INTERFERE_MAX_LIST) {
+			(void)fprintf(stderr, "%s has more than %d values\n",
+				option, INTERFERE_MAX_LIST);
+			free(str);
+			return -1;
+		}
+		errno = 0;
+		val = (uint64_t)strtoull(token, &end, base);
+		if (errno || (end == token) || *end) {
+			(void)fprintf(stderr, "%s: invalid value '%s'\n", option, token);
+			free(str);
+			return -1;
+		}
+		stress_check_range(option, val, lo, hi);
+		values[n++] = val;
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "%s needs at least one value\n", option);
+		return -1;
+	}
+	return n;
+}
+
+static int stress_set_interfere_hogs(const char *opt)
+{
+	uint32_t interfere_hogs;
+
+	interfere_hogs = stress_get_uint32(opt);
+	stress_check_range("interfere-hogs", (uint64_t)interfere_hogs,
+		MIN_INTERFERE_HOGS, MAX_INTERFERE_HOGS);
+	return stress_set_setting("interfere-hogs", TYPE_ID_UINT32, &interfere_hogs);
+}
+
+static int stress_set_interfere_mba(const char *opt)
+{
+	uint64_t values[INTERFERE_MAX_LIST];
+
+	if (stress_interfere_list_parse("interfere-mba", opt, 10, 1, 100, values) < 0)
+		return -1;
+	return stress_set_setting("interfere-mba", TYPE_ID_STR, opt);
+}
+
+static int stress_set_interfere_l3(const char *opt)
+{
+	uint64_t values[INTERFERE_MAX_LIST];
+
+	if (stress_interfere_list_parse("interfere-l3", opt, 16, 1, ~(uint64_t)0, values) < 0)
+		return -1;
+	return stress_set_setting("interfere-l3", TYPE_ID_STR, opt);
+}
+
+static int stress_set_interfere_probe_size(const char *opt)
+{
+	size_t interfere_probe_size;
+
+	interfere_probe_size = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("interfere-probe-size", interfere_probe_size,
+		MIN_INTERFERE_PROBE_SIZE, MAX_INTERFERE_PROBE_SIZE);
+	return stress_set_setting("interfere-probe-size", TYPE_ID_SIZE_T, &interfere_probe_size);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_interfere_hogs,		stress_set_interfere_hogs },
+	{ OPT_interfere_mba,		stress_set_interfere_mba },
+	{ OPT_interfere_l3,		stress_set_interfere_l3 },
+	{ OPT_interfere_probe_size,	stress_set_interfere_probe_size },
+	{ 0,				NULL }
+};
+
+#if defined(__linux__)
+/*
+ *  stress_interfere_write_pid()
+ *	move a process into a resctrl group or cgroup
+ */
+static int stress_interfere_write_pid(const char *dir, const char *file, const pid_t pid)
+{
+	char path[PATH_MAX + 32], buf[32];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	(void)snprintf(buf, sizeof(buf), "%d\n", (int)pid);
+	return (system_write(path, buf, strlen(buf)) < 0) ? -1 : 0;
+}
+
+/*
+ *  stress_interfere_parse_ids()
+ *	parse the domain ids of a root schemata line such as
+ *	"0=7ff;1=7ff"
+ */
+static int stress_interfere_parse_ids(const char *str, int *ids)
+{
+	int n = 0;
+
+	while (*str && (n < INTERFERE_MAX_DOMAINS)) {
+		char *end;
+		const long id = strtol(str, &end, 10);
+
+		if ((end == str) || (*end != '='))
+			break;
+		ids[n++] = (int)id;
+		str = strchr(end, ';');
+		if (!str)
+			break;
+		str++;
+	}
+	return n;
+}
+
+/*
+ *  stress_interfere_resctrl_init()
+ *	find the MB and L3 domains and make the probe and hog groups
+ */
+static void stress_interfere_resctrl_init(const stress_args_t *args, stress_interfere_resctrl_t *rc)
+{
+	char buf[4096], path[PATH_MAX + 16], *line, *save = NULL;
+	struct stat statbuf;
+
+	(void)memset(rc, 0, sizeof(*rc));
+	if (system_read(INTERFERE_RESCTRL "/schemata", buf, sizeof(buf)) <= 0)
+		return;
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		while (*line == ' ')
+			line++;
+		if (!strncmp(line, "MB:", 3))
+			rc->n_mb = stress_interfere_parse_ids(line + 3, rc->mb_ids);
+		else if (!strncmp(line, "L3:", 3))
+			rc->n_l3 = stress_interfere_parse_ids(line + 3, rc->l3_ids);
+	}
+	if (system_read(INTERFERE_RESCTRL "/info/L3/cbm_mask", buf, sizeof(buf)) > 0)
+		rc->l3_full = (uint64_t)strtoull(buf, NULL, 16);
+	if (!rc->l3_full)
+		rc->n_l3 = 0;
+	if (!rc->n_mb && !rc->n_l3)
+		return;
+
+	(void)snprintf(rc->probe_dir, sizeof(rc->probe_dir), "%s/stress-ng-probe-%d",
+		INTERFERE_RESCTRL, (int)args->pid);
+	(void)snprintf(rc->hog_dir, sizeof(rc->hog_dir), "%s/stress-ng-hogs-%d",
+		INTERFERE_RESCTRL, (int)args->pid);
+	if (mkdir(rc->probe_dir, S_IRWXU) < 0) {
+		pr_inf("%s: cannot create resctrl group %s, errno=%d (%s), "
+			"not partitioning\n", args->name, rc->probe_dir, errno, strerror(errno));
+		return;
+	}
+	if (mkdir(rc->hog_dir, S_IRWXU) < 0) {
+		pr_inf("%s: cannot create resctrl group %s, errno=%d (%s), "
+			"not partitioning\n", args->name, rc->hog_dir, errno, strerror(errno));
+		(void)rmdir(rc->probe_dir);
+		return;
+	}
+	if (stress_interfere_write_pid(rc->probe_dir, "tasks", args->pid) < 0) {
+		pr_inf("%s: cannot move the probe into resctrl group %s, not partitioning\n",
+			args->name, rc->probe_dir);
+		(void)rmdir(rc->hog_dir);
+		(void)rmdir(rc->probe_dir);
+		return;
+	}
+	(void)snprintf(path, sizeof(path), "%s/mon_data", rc->hog_dir);
+	rc->mbm = (stat(path, &statbuf) == 0);
+	rc->available = true;
+}
+
+static void stress_interfere_resctrl_deinit(const stress_args_t *args, stress_interfere_resctrl_t *rc)
+{
+	if (!rc->available)
+		return;
+	(void)stress_interfere_write_pid(INTERFERE_RESCTRL, "tasks", args->pid);
+	(void)rmdir(rc->hog_dir);
+	(void)rmdir(rc->probe_dir);
+}
+
+/*
+ *  stress_interfere_resctrl_apply()
+ *	set the hog group MB and L3 schemata on every domain
+ */
+static int stress_interfere_resctrl_apply(stress_interfere_resctrl_t *rc, const stress_interfere_config_t *cfg)
+{
+	char path[PATH_MAX + 16], buf[4096];
+	int i, len;
+
+	(void)snprintf(path, sizeof(path), "%s/schemata", rc->hog_dir);
+	if (rc->n_mb) {
+		len = snprintf(buf, sizeof(buf), "MB:");
+		for (i = 0; i < rc->n_mb; i++)
+			len += snprintf(buf + len, sizeof(buf) - (size_t)len, "%s%d=%" PRIu32,
+				i ? ";" : "", rc->mb_ids[i], cfg->mba ? cfg->mba : 100);
+		(void)snprintf(buf + len, sizeof(buf) - (size_t)len, "\n");
+		if (system_write(path, buf, strlen(buf)) < 0)
+			return -1;
+	} else if (cfg->mba) {
+		return -1;
+	}
+	if (rc->n_l3) {
+		len = snprintf(buf, sizeof(buf), "L3:");
+		for (i = 0; i < rc->n_l3; i++)
+			len += snprintf(buf + len, sizeof(buf) - (size_t)len, "%s%d=%" PRIx64,
+				i ? ";" : "", rc->l3_ids[i], cfg->l3 ? cfg->l3 : rc->l3_full);
+		(void)snprintf(buf + len, sizeof(buf) - (size_t)len, "\n");
+		if (system_write(path, buf, strlen(buf)) < 0)
+			return -1;
+	} else if (cfg->l3) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_interfere_mbm_bytes()
+ *	total bytes of memory traffic of the hog group over all
+ *	domains, from memory bandwidth monitoring
+ */
+static uint64_t stress_interfere_mbm_bytes(const stress_interfere_resctrl_t *rc)
+{
+	char path[PATH_MAX + 320], buf[64];
+	struct dirent *d;
+	uint64_t total = 0;
+	DIR *dir;
+
+	(void)snprintf(path, sizeof(path), "%s/mon_data", rc->hog_dir);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while ((d = readdir(dir)) != NULL) {
+		if (strncmp(d->d_name, "mon_L3_", 7))
+			continue;
+		(void)snprintf(path, sizeof(path), "%s/mon_data/%s/mbm_total_bytes",
+			rc->hog_dir, d->d_name);
+		if (system_read(path, buf, sizeof(buf)) > 0)
+			total += (uint64_t)strtoull(buf, NULL, 10);
+	}
+	(void)closedir(dir);
+	return total;
+}
+
+/*
+ *  stress_interfere_cgroup_init()
+ *	make a cgroup v2 group for the hogs under our own cgroup,
+ *	it needs no controllers as only cpu.stat is read
+ */
+static bool stress_interfere_cgroup_init(const stress_args_t *args, char *dir, const size_t len)
+{
+	static const char * const mounts[] = {
+		"/sys/fs/cgroup",
+		"/sys/fs/cgroup/unified",
+	};
+	char buf[4096], path[PATH_MAX], *line, *save = NULL;
+	const char *rel = NULL, *mount = NULL;
+	struct stat statbuf;
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(mounts); i++) {
+		(void)snprintf(path, sizeof(path), "%s/cgroup.procs", mounts[i]);
+		if ((stat(path, &statbuf) == 0) &&
+		    (snprintf(path, sizeof(path), "%s/cgroup.subtree_control", mounts[i]) > 0) &&
+		    (stat(path, &statbuf) == 0)) {
+			mount = mounts[i];
+			break;
+		}
+	}
+	if (!mount)
+		return false;
+	if (system_read("/proc/self/cgroup", buf, sizeof(buf)) <= 0)
+		return false;
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (!strncmp(line, "0::", 3)) {
+			rel = line + 3;
+			break;
+		}
+	}
+	if (!rel)
+		return false;
+	if (!strcmp(rel, "/"))
+		rel = "";
+	(void)snprintf(dir, len, "%s%s/stress-ng-hogs-%d", mount, rel, (int)args->pid);
+	if (mkdir(dir, S_IRWXU) < 0) {
+		pr_dbg("%s: cannot create cgroup %s, errno=%d (%s)\n",
+			args->name, dir, errno, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  stress_interfere_cgroup_cpu()
+ *	CPU seconds used by the tasks of a cgroup v2 group
+ */
+static double stress_interfere_cgroup_cpu(const char *dir)
+{
+	char path[PATH_MAX + 16], buf[1024];
+	const char *ptr;
+
+	(void)snprintf(path, sizeof(path), "%s/cpu.stat", dir);
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return -1.0;
+	ptr = strstr(buf, "usage_usec ");
+	if (!ptr)
+		return -1.0;
+	return (double)strtoull(ptr + 11, NULL, 10) / 1000000.0;
+}
+#endif
+
+/*
+ *  stress_interfere_chase_init()
+ *	link the cache lines of the probe buffer into one random
+ *	cycle (Sattolo's algorithm) so each load depends on the last
+ */
+static int stress_interfere_chase_init(uint8_t *buf, const size_t size)
+{
+	const size_t n = size / INTERFERE_LINE;
+	size_t *idx, i;
+
+	idx = calloc(n, sizeof(*idx));
+	if (!idx)
+		return -1;
+	for (i = 0; i < n; i++)
+		idx[i] = i;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)(stress_mwc64() % i);
+		const size_t tmp = idx[i];
+
+		idx[i] = idx[j];
+		idx[j] = tmp;
+	}
+	for (i = 0; i < n; i++)
+		*(void **)(buf + (idx[i] * INTERFERE_LINE)) =
+			(void *)(buf + (idx[(i + 1) % n] * INTERFERE_LINE));
+	free(idx);
+	return 0;
+}
+
+/*
+ *  stress_interfere_probe()
+ *	pointer chase for a while, returns nanoseconds per load
+ */
+static double OPTIMIZE3 stress_interfere_probe(void *start, const double duration)
+{
+	void **ptr = (void **)start;
+	uint64_t loads = 0;
+	double t, t_end;
+
+	t = stress_time_now();
+	t_end = t + duration;
+	do {
+		int i;
+
+		for (i = 0; i < 1024; i++) {
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+		}
+		loads += 4096;
+	} while (stress_time_now() < t_end);
+	stress_void_ptr_put((volatile void *)ptr);
+
+	return ((stress_time_now() - t) * 1000000000.0) / (double)loads;
+}
+
+/*
+ *  stress_interfere_hog()
+ *	write then read a buffer well beyond the LLC, counting the
+ *	bytes moved, until killed
+ */
+static void NORETURN stress_interfere_hog(volatile uint64_t *counter)
+{
+	uint8_t *buf;
+	uint8_t val = 0;
+
+	stress_parent_died_alarm();
+	buf = (uint8_t *)mmap(NULL, INTERFERE_HOG_BYTES, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		_exit(EXIT_NO_RESOURCE);
+	while (keep_stressing_flag()) {
+		const uint64_t *ptr, *end = (const uint64_t *)(buf + INTERFERE_HOG_BYTES);
+		uint64_t sum = 0;
+
+		(void)memset(buf, val++, INTERFERE_HOG_BYTES);
+		for (ptr = (const uint64_t *)buf; ptr < end; ptr += 8)
+			sum += *ptr;
+		stress_uint64_put(sum);
+		*counter += 2 * INTERFERE_HOG_BYTES;
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+static void stress_interfere_signal_hogs(const pid_t *pids, const uint32_t n, const int sig)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (pids[i] > 0)
+			(void)kill(pids[i], sig);
+	}
+}
+
+static uint64_t stress_interfere_hog_bytes(const uint64_t *counters, const uint32_t n)
+{
+	uint64_t total = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++)
+		total += counters[i * INTERFERE_COUNTER_STRIDE];
+	return total;
+}
+
+/*
+ *  stress_interfere_config_name()
+ *	describe an allocation setting
+ */
+static void stress_interfere_config_name(const stress_interfere_config_t *cfg, char *buf, const size_t len)
+{
+	if (cfg->mba)
+		(void)snprintf(buf, len, "mba %" PRIu32 "%%", cfg->mba);
+	else if (cfg->l3)
+		(void)snprintf(buf, len, "l3 0x%" PRIx64, cfg->l3);
+	else
+		(void)snprintf(buf, len, "none");
+}
+
+/*
+ *  stress_interfere_report()
+ *	report probe degradation per hog allocation setting
+ */
+static void stress_interfere_report(
+	const stress_args_t *args,
+	const stress_interfere_config_t *cfgs,
+	const int n_cfgs,
+	const uint32_t n_hogs,
+	const size_t probe_size,
+	const bool resctrl,
+	const bool mbm)
+{
+	bool lock = false;
+	int i, idx = 0;
+	char szstr[32];
+
+	stress_uint64_to_str(szstr, sizeof(szstr), (uint64_t)probe_size);
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %s probe against %" PRIu32 " hogs, %s, hog bandwidth from %s\n",
+		args->name, szstr, n_hogs,
+		resctrl ? "hogs in their own resctrl group" : "no resctrl partitioning",
+		mbm ? "memory bandwidth monitoring" : "the hog byte counts");
+	pr_inf_lock(&lock, "%s: %-12s %10s %10s %9s %9s %8s\n", args->name,
+		"hog setting", "alone ns", "loaded ns", "slowdown", "hog GB/s", "hog CPU%");
+	for (i = 0; i < n_cfgs; i++) {
+		const stress_interfere_config_t *cfg = &cfgs[i];
+		char name[32], cpu[16];
+		double base, loaded, slowdown;
+
+		stress_interfere_config_name(cfg, name, sizeof(name));
+		if (cfg->unsupported || !cfg->samples) {
+			pr_inf_lock(&lock, "%s: %-12s %10s %10s %9s %9s %8s\n", args->name,
+				name, "n/a", "n/a", "n/a", "n/a", "n/a");
+			continue;
+		}
+		base = cfg->base_ns / (double)cfg->samples;
+		loaded = cfg->loaded_ns / (double)cfg->samples;
+		slowdown = (base > 0.0) ? loaded / base : 0.0;
+		if (cfg->hog_cpu >= 0.0)
+			(void)snprintf(cpu, sizeof(cpu), "%8.1f", (cfg->hog_time > 0.0) ?
+				100.0 * cfg->hog_cpu / cfg->hog_time : 0.0);
+		else
+			(void)snprintf(cpu, sizeof(cpu), "%8s", "n/a");
+		pr_inf_lock(&lock, "%s: %-12s %10.2f %10.2f %8.2fx %9.2f %s\n", args->name,
+			name, base, loaded, slowdown,
+			(cfg->hog_time > 0.0) ? (cfg->hog_bytes / (double)GB) / cfg->hog_time : 0.0,
+			cpu);
+		if (idx < 10) {
+			char desc[48];
+
+			(void)snprintf(desc, sizeof(desc), "%s probe slowdown", name);
+			stress_misc_stats_set(args->misc_stats, idx++, desc, slowdown);
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_interfere()
+ *	run a pointer chasing latency probe alone and against memory
+ *	bandwidth hogs for each hog cache and bandwidth allocation
+ */
+static int stress_interfere(const stress_args_t *args)
+{
+	stress_interfere_config_t cfgs[INTERFERE_MAX_CONFIGS];
+	stress_interfere_resctrl_t rc;
+	uint64_t values[INTERFERE_MAX_LIST], *counters;
+	size_t probe_size = DEFAULT_INTERFERE_PROBE_SIZE, counters_size;
+	int32_t cpus = stress_get_processors_online();
+	uint32_t n_hogs, i;
+	char *mba_opt = NULL, *l3_opt = NULL;
+	char cgroup_dir[PATH_MAX];
+	bool cgroup = false;
+	pid_t *pids;
+	uint8_t *probe;
+	int n_cfgs = 0, n, j, status;
+
+	n_hogs = (cpus > 1) ? (uint32_t)(cpus - 1) : 1;
+	if (n_hogs > MAX_INTERFERE_HOGS)
+		n_hogs = MAX_INTERFERE_HOGS;
+	(void)stress_get_setting("interfere-hogs", &n_hogs);
+	(void)stress_get_setting("interfere-mba", &mba_opt);
+	(void)stress_get_setting("interfere-l3", &l3_opt);
+	(void)stress_get_setting("interfere-probe-size", &probe_size);
+
+	(void)memset(cfgs, 0, sizeof(cfgs));
+	n_cfgs = 1;	/* unconstrained */
+	if (mba_opt) {
+		n = stress_interfere_list_parse("interfere-mba", mba_opt, 10, 1, 100, values);
+		for (j = 0; j < n; j++)
+			cfgs[n_cfgs++].mba = (uint32_t)values[j];
+	}
+	if (l3_opt) {
+		n = stress_interfere_list_parse("interfere-l3", l3_opt, 16, 1, ~(uint64_t)0, values);
+		for (j = 0; j < n; j++)
+			cfgs[n_cfgs++].l3 = values[j];
+	}
+
+#if defined(__linux__)
+	stress_interfere_resctrl_init(args, &rc);
+#else
+	(void)memset(&rc, 0, sizeof(rc));
+#endif
+	if (!rc.available && (n_cfgs > 1) && (args->instance == 0))
+		pr_inf("%s: resctrl is not available, the --interfere-mba and "
+			"--interfere-l3 settings cannot be measured\n", args->name);
+
+	probe = (uint8_t *)mmap(NULL, probe_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (probe == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte probe buffer, skipping stressor, "
+			"errno=%d (%s)\n", args->name, probe_size, errno, strerror(errno));
+		goto err_resctrl;
+	}
+	if (stress_interfere_chase_init(probe, probe_size) < 0) {
+		pr_inf_skip("%s: cannot allocate the probe index, skipping stressor\n",
+			args->name);
+		goto err_probe;
+	}
+	counters_size = n_hogs * INTERFERE_COUNTER_STRIDE * sizeof(*counters);
+	counters = (uint64_t *)mmap(NULL, counters_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (counters == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap hog counters, skipping stressor\n", args->name);
+		goto err_probe;
+	}
+	pids = calloc(n_hogs, sizeof(*pids));
+	if (!pids) {
+		pr_inf_skip("%s: cannot allocate hog pids, skipping stressor\n", args->name);
+		goto err_counters;
+	}
+
+#if defined(__linux__)
+	cgroup = stress_interfere_cgroup_init(args, cgroup_dir, sizeof(cgroup_dir));
+#endif
+	for (i = 0; i < n_hogs; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0) {
+			stress_interfere_hog(&counters[i * INTERFERE_COUNTER_STRIDE]);
+		} else if (pids[i] < 0) {
+			pr_inf("%s: cannot fork hog %" PRIu32 ", errno=%d (%s)\n",
+				args->name, i, errno, strerror(errno));
+			continue;
+		}
+		(void)kill(pids[i], SIGSTOP);
+#if defined(__linux__)
+		if (rc.available)
+			(void)stress_interfere_write_pid(rc.hog_dir, "tasks", pids[i]);
+		if (cgroup)
+			(void)stress_interfere_write_pid(cgroup_dir, "cgroup.procs", pids[i]);
+#endif
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (j = 0; j < n_cfgs; j++) {
+			stress_interfere_config_t *cfg = &cfgs[j];
+			uint64_t bytes, mbm = 0;
+			double base, loaded, t, cpu = -1.0;
+
+			if (!keep_stressing(args))
+				goto done;
+			if (cfg->unsupported)
+				continue;
+#if defined(__linux__)
+			if (rc.available) {
+				if (stress_interfere_resctrl_apply(&rc, cfg) < 0) {
+					char name[32];
+
+					stress_interfere_config_name(cfg, name, sizeof(name));
+					pr_inf("%s: cannot set the hog resctrl schemata for %s, "
+						"errno=%d (%s)\n", args->name, name, errno, strerror(errno));
+					cfg->unsupported = true;
+					continue;
+				}
+			} else if (cfg->mba || cfg->l3) {
+				cfg->unsupported = true;
+				continue;
+			}
+#else
+			if (cfg->mba || cfg->l3) {
+				cfg->unsupported = true;
+				continue;
+			}
+#endif
+			base = stress_interfere_probe(probe, INTERFERE_PHASE);
+
+			bytes = stress_interfere_hog_bytes(counters, n_hogs);
+#if defined(__linux__)
+			if (rc.mbm)
+				mbm = stress_interfere_mbm_bytes(&rc);
+			if (cgroup)
+				cpu = stress_interfere_cgroup_cpu(cgroup_dir);
+#endif
+			t = stress_time_now();
+			stress_interfere_signal_hogs(pids, n_hogs, SIGCONT);
+			(void)shim_usleep(INTERFERE_SETTLE);
+			loaded = stress_interfere_probe(probe, INTERFERE_PHASE);
+			stress_interfere_signal_hogs(pids, n_hogs, SIGSTOP);
+			t = stress_time_now() - t;
+
+#if defined(__linux__)
+			if (rc.mbm) {
+				const uint64_t mbm_end = stress_interfere_mbm_bytes(&rc);
+
+				cfg->hog_bytes += (double)(mbm_end - mbm);
+			} else
+#endif
+			{
+				cfg->hog_bytes += (double)(stress_interfere_hog_bytes(counters, n_hogs) - bytes);
+			}
+#if defined(__linux__)
+			if ((cpu >= 0.0) && (cfg->hog_cpu >= 0.0)) {
+				const double cpu_end = stress_interfere_cgroup_cpu(cgroup_dir);
+
+				cfg->hog_cpu = (cpu_end >= 0.0) ? cfg->hog_cpu + (cpu_end - cpu) : -1.0;
+			} else {
+				cfg->hog_cpu = -1.0;
+			}
+#else
+			(void)cpu;
+			cfg->hog_cpu = -1.0;
+#endif
+			cfg->hog_time += t;
+			cfg->base_ns += base;
+			cfg->loaded_ns += loaded;
+			cfg->samples++;
+			inc_counter(args);
+		}
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_interfere_signal_hogs(pids, n_hogs, SIGKILL);
+	for (i = 0; i < n_hogs; i++) {
+		if (pids[i] > 0)
+			(void)shim_waitpid(pids[i], &status, 0);
+	}
+#if defined(__linux__)
+	if (cgroup)
+		(void)rmdir(cgroup_dir);
+#endif
+	if (args->instance == 0)
+		stress_interfere_report(args, cfgs, n_cfgs, n_hogs, probe_size,
+			rc.available, rc.mbm);
+
+	free(pids);
+	(void)munmap((void *)counters, counters_size);
+	(void)munmap((void *)probe, probe_size);
+#if defined(__linux__)
+	stress_interfere_resctrl_deinit(args, &rc);
+#endif
+	return EXIT_SUCCESS;
+
+err_counters:
+	(void)munmap((void *)counters, counters_size);
+err_probe:
+	(void)munmap((void *)probe, probe_size);
+err_resctrl:
+#if defined(__linux__)
+	stress_interfere_resctrl_deinit(args, &rc);
+#endif
+	return EXIT_NO_RESOURCE;
+}
+
+stressor_info_t stress_interfere_info = {
+	.stressor = stress_interfere,
+	.class = CLASS_MEMORY | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
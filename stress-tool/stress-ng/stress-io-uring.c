@@ -28,9 +28,59 @@
 static const stress_help_t help[] = {
 	{ NULL,	"io-uring N",		"start N workers that issue io-uring I/O requests" },
 	{ NULL,	"io-uring-ops N",	"stop after N bogo io-uring I/O requests" },
+	{ NULL,	"io-uring-depth N",	"queue depth of the throughput mode" },
+	{ NULL,	"io-uring-fixed",	"use registered buffers and files in the throughput mode" },
+	{ NULL,	"io-uring-sqpoll",	"use a kernel submission queue polling thread" },
+	{ NULL,	"io-uring-throughput",	"keep the queue full of reads and writes, report IOPS" },
 	{ NULL,	NULL,		NULL }
 };
 
+#define MIN_IO_URING_DEPTH	(1)
+#define MAX_IO_URING_DEPTH	(4096)
+#define DEFAULT_IO_URING_DEPTH	(32)
+
+static int stress_set_io_uring_depth(const char *opt)
+{
+	uint32_t io_uring_depth;
+
+	io_uring_depth = stress_get_uint32(opt);
+	stress_check_range("io-uring-depth", io_uring_depth,
+		MIN_IO_URING_DEPTH, MAX_IO_URING_DEPTH);
+	return stress_set_setting("io-uring-depth", TYPE_ID_UINT32, &io_uring_depth);
+}
+
+static int stress_set_io_uring_fixed(const char *opt)
+{
+	bool io_uring_fixed = true;
+
+	(void)opt;
+	return stress_set_setting("io-uring-fixed", TYPE_ID_BOOL, &io_uring_fixed);
+}
+
+static int stress_set_io_uring_sqpoll(const char *opt)
+{
+	bool io_uring_sqpoll = true;
+
+	(void)opt;
+	return stress_set_setting("io-uring-sqpoll", TYPE_ID_BOOL, &io_uring_sqpoll);
+}
+
+static int stress_set_io_uring_throughput(const char *opt)
+{
+	bool io_uring_throughput = true;
+
+	(void)opt;
+	return stress_set_setting("io-uring-throughput", TYPE_ID_BOOL, &io_uring_throughput);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_io_uring_depth,		stress_set_io_uring_depth },
+	{ OPT_io_uring_fixed,		stress_set_io_uring_fixed },
+	{ OPT_io_uring_sqpoll,		stress_set_io_uring_sqpoll },
+	{ OPT_io_uring_throughput,	stress_set_io_uring_throughput },
+	{ 0,				NULL }
+};
+
 #if defined(HAVE_LINUX_IO_URING_H) &&	\
     defined(__NR_io_uring_enter) &&	\
     defined(__NR_io_uring_setup) &&	\
@@ -101,6 +151,7 @@ typedef struct {
 	size_t sq_size;
 	size_t cq_size;
 	size_t sqes_size;
+	bool sqpoll;		/* kernel thread polls the submission queue */
 } stress_io_uring_submit_t;
 
 typedef void (*stress_io_uring_setup)(stress_io_uring_file_t *io_uring_file, struct io_uring_sqe *sqe);
@@ -139,6 +190,21 @@ static int shim_io_uring_enter(
 		min_complete, flags, NULL, 0);
 }
 
+#if defined(__NR_io_uring_register)
+/*
+ *  shim_io_uring_register
+ *	wrapper for io_uring_register()
+ */
+static int shim_io_uring_register(
+	int fd,
+	unsigned int opcode,
+	void *arg,
+	unsigned int nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
 /*
  *  stress_io_uring_unmap_iovecs()
  *	free uring file iovecs
@@ -172,14 +238,35 @@ static void stress_io_uring_unmap_iovecs(stress_io_uring_file_t *io_uring_file)
  */
 static int stress_setup_io_uring(
 	const stress_args_t *args,
-	stress_io_uring_submit_t *submit)
+	stress_io_uring_submit_t *submit,
+	const unsigned entries,
+	const unsigned flags)
 {
 	stress_uring_io_sq_ring_t *sring = &submit->sq_ring;
 	stress_uring_io_cq_ring_t *cring = &submit->cq_ring;
 	struct io_uring_params p;
 
 	(void)memset(&p, 0, sizeof(p));
-	submit->io_uring_fd = shim_io_uring_setup(1, &p);
+	p.flags = flags;
+#if defined(IORING_SETUP_SQPOLL)
+	/* Let the poll thread sleep after 100ms without submissions */
+	if (flags & IORING_SETUP_SQPOLL)
+		p.sq_thread_idle = 100;
+#endif
+	submit->io_uring_fd = shim_io_uring_setup(entries, &p);
+#if defined(IORING_SETUP_SQPOLL)
+	/* Polling threads need CAP_SYS_ADMIN before Linux 5.11 */
+	if ((submit->io_uring_fd < 0) && (errno == EPERM) &&
+	    (p.flags & IORING_SETUP_SQPOLL)) {
+		if (args->instance == 0)
+			pr_inf("%s: no permission to use a submission queue "
+				"polling thread, using io_uring_enter\n", args->name);
+		(void)memset(&p, 0, sizeof(p));
+		p.flags = flags & ~IORING_SETUP_SQPOLL;
+		submit->io_uring_fd = shim_io_uring_setup(entries, &p);
+	}
+	submit->sqpoll = !!(p.flags & IORING_SETUP_SQPOLL);
+#endif
 	if (submit->io_uring_fd < 0) {
 		if (errno == ENOSYS) {
 			pr_inf_skip("%s: io-uring not supported by the kernel, skipping stressor\n",
@@ -589,7 +676,8 @@ static void stress_io_uring_statx_setup(
 	struct io_uring_sqe *sqe)
 {
 	static const char *pathname = "";
-	struct shim_statx statxbuf;
+	/* Written on completion, after this function has returned */
+	static struct shim_statx statxbuf;
 
 	sqe->opcode = IORING_OP_STATX;
 	sqe->fd = io_uring_file->fd;
@@ -676,6 +764,223 @@ static const char *stress_io_uring_opcode_name(const uint8_t opcode)
 	return "unknown";
 }
 
+#define IO_URING_BLOCK_SIZE	(4096)
+#define IO_URING_FILE_BLOCKS	(4096)
+
+/* io_uring_register opcodes, enums in newer kernel headers */
+#define STRESS_IORING_REGISTER_BUFFERS	(0)
+#define STRESS_IORING_REGISTER_FILES	(2)
+
+#if defined(HAVE_IORING_OP_READ_FIXED) &&	\
+    defined(HAVE_IORING_OP_WRITE_FIXED) &&	\
+    defined(IOSQE_FIXED_FILE) &&		\
+    defined(__NR_io_uring_register)
+#define HAVE_IO_URING_FIXED
+#endif
+
+/*
+ *  stress_io_uring_throughput()
+ *	keep the queue full of random block reads and writes on a
+ *	file, reporting the IOPS and completion latency
+ */
+static int stress_io_uring_throughput(const stress_args_t *args, const char *filename)
+{
+	stress_io_uring_submit_t submit;
+	stress_uring_io_sq_ring_t *sring = &submit.sq_ring;
+	stress_uring_io_cq_ring_t *cring = &submit.cq_ring;
+	uint32_t depth = DEFAULT_IO_URING_DEPTH, n_free, i;
+	bool fixed = false, sqpoll = false;
+	unsigned flags = 0;
+	struct iovec *iovecs = NULL;
+	double *submitted = NULL;
+	uint32_t *free_slots = NULL;
+	void *buffers = NULL;
+	int fd = -1, rc;
+	double t_start, duration, lat_total = 0.0, lat_max = 0.0;
+	uint64_t completions = 0;
+
+	(void)memset(&submit, 0, sizeof(submit));
+	submit.io_uring_fd = -1;
+	(void)stress_get_setting("io-uring-depth", &depth);
+	(void)stress_get_setting("io-uring-fixed", &fixed);
+	(void)stress_get_setting("io-uring-sqpoll", &sqpoll);
+
+#if !defined(HAVE_IO_URING_FIXED)
+	if (fixed && (args->instance == 0))
+		pr_inf("%s: registered buffers and files not supported, "
+			"ignoring --io-uring-fixed\n", args->name);
+	fixed = false;
+#endif
+#if defined(IORING_SETUP_SQPOLL)
+	if (sqpoll)
+		flags |= IORING_SETUP_SQPOLL;
+#else
+	if (sqpoll && (args->instance == 0))
+		pr_inf("%s: submission queue polling not supported, "
+			"ignoring --io-uring-sqpoll\n", args->name);
+#endif
+
+	iovecs = calloc(depth, sizeof(*iovecs));
+	submitted = calloc(depth, sizeof(*submitted));
+	free_slots = calloc(depth, sizeof(*free_slots));
+	if (!iovecs || !submitted || !free_slots ||
+	    posix_memalign(&buffers, IO_URING_BLOCK_SIZE, (size_t)depth * IO_URING_BLOCK_SIZE)) {
+		buffers = NULL;
+		pr_inf("%s: cannot allocate %" PRIu32 " I/O buffers, skipping stressor\n",
+			args->name, depth);
+		rc = EXIT_NO_RESOURCE;
+		goto clean;
+	}
+	stress_mwc_fill(buffers, (size_t)depth * IO_URING_BLOCK_SIZE);
+	for (i = 0; i < depth; i++) {
+		iovecs[i].iov_base = (uint8_t *)buffers + ((size_t)i * IO_URING_BLOCK_SIZE);
+		iovecs[i].iov_len = IO_URING_BLOCK_SIZE;
+		free_slots[i] = i;
+	}
+	n_free = depth;
+
+	if ((fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR)) < 0) {
+		rc = exit_status(errno);
+		pr_fail("%s: open on %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto clean;
+	}
+	(void)unlink(filename);
+	if (ftruncate(fd, (off_t)IO_URING_FILE_BLOCKS * IO_URING_BLOCK_SIZE) < 0) {
+		rc = exit_status(errno);
+		pr_fail("%s: ftruncate on %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto clean;
+	}
+
+	rc = stress_setup_io_uring(args, &submit, depth, flags);
+	if (rc != EXIT_SUCCESS)
+		goto clean;
+
+#if defined(HAVE_IO_URING_FIXED)
+	if (fixed &&
+	    ((shim_io_uring_register(submit.io_uring_fd, STRESS_IORING_REGISTER_BUFFERS, iovecs, depth) < 0) ||
+	     (shim_io_uring_register(submit.io_uring_fd, STRESS_IORING_REGISTER_FILES, &fd, 1) < 0))) {
+		if (args->instance == 0)
+			pr_inf("%s: cannot register buffers and files, errno=%d (%s), "
+				"ignoring --io-uring-fixed\n", args->name, errno, strerror(errno));
+		fixed = false;
+	}
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t_start = stress_time_now();
+	do {
+		unsigned tail = *sring->tail, head, enter_flags = IORING_ENTER_GETEVENTS;
+		uint32_t to_submit = 0;
+		double now = stress_time_now();
+		int ret;
+
+		/* Refill the queue */
+		while (n_free) {
+			const uint32_t slot = free_slots[--n_free];
+			const unsigned index = tail & *sring->ring_mask;
+			struct io_uring_sqe *sqe = &submit.sqes_mmap[index];
+			const bool write = stress_mwc1();
+
+			(void)memset(sqe, 0, sizeof(*sqe));
+#if defined(HAVE_IO_URING_FIXED)
+			if (fixed) {
+				sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+				sqe->fd = 0;
+				sqe->flags = IOSQE_FIXED_FILE;
+				sqe->addr = (uintptr_t)iovecs[slot].iov_base;
+				sqe->len = IO_URING_BLOCK_SIZE;
+				sqe->buf_index = (uint16_t)slot;
+			} else
+#endif
+			{
+				sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+				sqe->fd = fd;
+				sqe->addr = (uintptr_t)&iovecs[slot];
+				sqe->len = 1;
+			}
+			sqe->off = (uint64_t)(stress_mwc32() % IO_URING_FILE_BLOCKS) * IO_URING_BLOCK_SIZE;
+			sqe->user_data = slot;
+			sring->array[index] = index;
+			submitted[slot] = now;
+			tail++;
+			to_submit++;
+		}
+		shim_mb();
+		*sring->tail = tail;
+		shim_mb();
+
+#if defined(IORING_SQ_NEED_WAKEUP) &&	\
+    defined(IORING_ENTER_SQ_WAKEUP)
+		/* The poll thread submits, it only needs waking if idle */
+		if (submit.sqpoll && (*sring->flags & IORING_SQ_NEED_WAKEUP))
+			enter_flags |= IORING_ENTER_SQ_WAKEUP;
+#endif
+		ret = shim_io_uring_enter(submit.io_uring_fd, to_submit, 1, enter_flags);
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+				continue;
+			pr_fail("%s: io_uring_enter failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_FAILURE;
+			break;
+		}
+
+		/* Reap the completions */
+		head = *cring->head;
+		shim_mb();
+		now = stress_time_now();
+		while (head != *cring->tail) {
+			const struct io_uring_cqe *cqe = &cring->cqes[head & *cring->ring_mask];
+			const uint32_t slot = (uint32_t)cqe->user_data;
+			const double latency = now - submitted[slot];
+
+			if (cqe->res < 0) {
+				const int err = -cqe->res;
+
+				pr_fail("%s: completion error=%d (%s)\n",
+					args->name, err, strerror(err));
+				rc = EXIT_FAILURE;
+			}
+			lat_total += latency;
+			if (lat_max < latency)
+				lat_max = latency;
+			free_slots[n_free++] = slot;
+			completions++;
+			inc_counter(args);
+			head++;
+		}
+		*cring->head = head;
+		shim_mb();
+	} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+	duration = stress_time_now() - t_start;
+
+	if ((duration > 0.0) && completions) {
+		const double iops = (double)completions / duration;
+		const double lat_mean = (lat_total / (double)completions) * 1000000.0;
+
+		pr_inf("%s: %.2f IOPS, completion latency %.2f usecs mean, "
+			"%.2f usecs max (queue depth %" PRIu32 "%s%s)\n",
+			args->name, iops, lat_mean, lat_max * 1000000.0, depth,
+			submit.sqpoll ? ", sqpoll" : "", fixed ? ", fixed" : "");
+		stress_misc_stats_set(args->misc_stats, 0, "IOPS", iops);
+		stress_misc_stats_set(args->misc_stats, 1, "completion latency (usecs)", lat_mean);
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+clean:
+	stress_close_io_uring(&submit);
+	if (fd >= 0)
+		(void)close(fd);
+	free(buffers);
+	free(free_slots);
+	free(submitted);
+	free(iovecs);
+
+	return rc;
+}
 
 /*
  *  stress_io_uring
@@ -693,6 +998,7 @@ static int stress_io_uring(const stress_args_t *args)
 	stress_io_uring_submit_t submit;
 	const pid_t self = getpid();
 	bool supported[SIZEOF_ARRAY(stress_io_uring_setups)];
+	bool io_uring_throughput = false;
 
 	(void)memset(&submit, 0, sizeof(submit));
 	(void)memset(&io_uring_file, 0, sizeof(io_uring_file));
@@ -736,7 +1042,13 @@ static int stress_io_uring(const stress_args_t *args)
 	(void)stress_temp_filename_args(args,
 		filename, sizeof(filename), stress_mwc32());
 
-	rc = stress_setup_io_uring(args, &submit);
+	(void)stress_get_setting("io-uring-throughput", &io_uring_throughput);
+	if (io_uring_throughput) {
+		rc = stress_io_uring_throughput(args, filename);
+		goto clean;
+	}
+
+	rc = stress_setup_io_uring(args, &submit, 1, 0);
 	if (rc != EXIT_SUCCESS)
 		goto clean;
 
@@ -754,7 +1066,7 @@ static int stress_io_uring(const stress_args_t *args)
 	 *  Assume all opcodes are supported
 	 */
 	for (j = 0; j < SIZEOF_ARRAY(stress_io_uring_setups); j++) {
-		supported[i] = true;
+		supported[j] = true;
 	}
 
 	rc = EXIT_SUCCESS;
@@ -789,12 +1101,14 @@ clean:
 stressor_info_t stress_io_uring_info = {
 	.stressor = stress_io_uring,
 	.class = CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_io_uring_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_IO | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
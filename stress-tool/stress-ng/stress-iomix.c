@@ -27,13 +27,221 @@
 
 typedef void (*stress_iomix_func)(const stress_args_t *args, const int fd, const off_t iomix_bytes);
 
+#define IOMIX_PROFILES_MAX	(8)	/* profiles in a --iomix-profile list */
+#define IOMIX_BS_MAX		(4)	/* block sizes per profile */
+#define IOMIX_BS_LIMIT		(4 * MB)	/* largest block size */
+#define IOMIX_LAT_SUB		(4)	/* latency buckets per power of 2 */
+#define IOMIX_LAT_BUCKETS	(64 * IOMIX_LAT_SUB)
+
+#define IOMIX_OP_READ		(0)
+#define IOMIX_OP_WRITE		(1)
+#define IOMIX_OP_SYNC		(2)
+#define IOMIX_OP_MAX		(3)
+
+typedef struct {
+	uint32_t size;		/* block size in bytes */
+	uint32_t weight;	/* relative share of the I/Os of this size */
+} stress_iomix_bs_t;
+
+/*
+ *  an I/O signature, the mix of reads and writes, sequential
+ *  and random offsets and block sizes, how often written data
+ *  is synced and the rate the I/Os are issued at
+ */
+typedef struct {
+	const char *name;	/* profile name */
+	uint32_t read_pct;	/* share of the I/Os that are reads */
+	uint32_t seq_pct;	/* share of the I/Os that are sequential */
+	uint32_t sync_writes;	/* sync after every N writes, 0 never */
+	bool fsync;		/* fsync rather than fdatasync */
+	uint32_t iops;		/* target I/O rate, 0 is unthrottled */
+	int n_bs;		/* number of block sizes */
+	stress_iomix_bs_t bs[IOMIX_BS_MAX];
+} stress_iomix_profile_t;
+
+/*
+ *  per profile I/O and latency statistics, shared with the parent
+ */
+typedef struct {
+	uint64_t ops[IOMIX_OP_MAX];
+	uint64_t bytes[IOMIX_OP_MAX];
+	uint64_t lat_max[IOMIX_OP_MAX];
+	uint64_t lat[IOMIX_OP_MAX][IOMIX_LAT_BUCKETS];
+	double duration;
+} stress_iomix_stats_t;
+
 static const stress_help_t help[] = {
 	{ NULL,	"iomix N",	 "start N workers that have a mix of I/O operations" },
 	{ NULL,	"iomix-bytes N", "write N bytes per iomix worker (default is 1GB)" },
 	{ NULL,	"iomix-ops N",	 "stop iomix workers after N iomix bogo operations" },
+	{ NULL,	"iomix-profile list", "run I/O profiles database, log, media, vm or backup" },
 	{ NULL, NULL,		 NULL }
 };
 
+static const stress_iomix_profile_t iomix_profiles[] = {
+	/* OLTP database: small random mostly reads, frequent log syncs */
+	{ "database",	70, 10, 32,  false, 2000, 3,
+		{ { 8 * KB, 80 }, { 16 * KB, 15 }, { 64 * KB, 5 } } },
+	/* Append only log: small sequential writes synced each time */
+	{ "log",	5,  100, 1,  false, 500,  3,
+		{ { 4 * KB, 60 }, { 16 * KB, 30 }, { 64 * KB, 10 } } },
+	/* Media streaming: large sequential reads, rare writes */
+	{ "media",	90, 95, 0,   false, 200,  2,
+		{ { 256 * KB, 20 }, { 1 * MB, 80 } } },
+	/* Virtual machine image: mixed sizes and offsets */
+	{ "vm",		60, 30, 256, true,  1000, 3,
+		{ { 4 * KB, 50 }, { 64 * KB, 30 }, { 1 * MB, 20 } } },
+	/* Backup: large sequential writes, fsync at the end of chunks */
+	{ "backup",	10, 90, 64,  true,  0,    2,
+		{ { 1 * MB, 90 }, { 4 * MB, 10 } } },
+};
+
+/*
+ *  stress_iomix_bs_parse()
+ *	parse a size[:weight]+size[:weight]... list of block sizes
+ */
+static int stress_iomix_bs_parse(char *str, stress_iomix_profile_t *profile)
+{
+	char *token, *save = NULL;
+	int n = 0;
+
+	for (token = strtok_r(str, "+", &save); token; token = strtok_r(NULL, "+", &save)) {
+		char *colon = strchr(token, ':');
+		uint64_t size;
+		uint32_t weight = 1;
+
+		if (n >= IOMIX_BS_MAX) {
+			(void)fprintf(stderr, "iomix-profile %s has more than %d "
+				"block sizes\n", profile->name, IOMIX_BS_MAX);
+			return -1;
+		}
+		if (colon) {
+			*colon = '\0';
+			weight = stress_get_uint32(colon + 1);
+		}
+		size = stress_get_uint64_byte(token);
+		if ((size < 1) || (size > IOMIX_BS_LIMIT) || !weight) {
+			(void)fprintf(stderr, "iomix-profile %s block size '%s' must be "
+				"1 to %d bytes with a weight of at least 1\n",
+				profile->name, token, (int)IOMIX_BS_LIMIT);
+			return -1;
+		}
+		profile->bs[n].size = (uint32_t)size;
+		profile->bs[n].weight = weight;
+		n++;
+	}
+	if (!n) {
+		(void)fprintf(stderr, "iomix-profile %s needs at least one "
+			"block size\n", profile->name);
+		return -1;
+	}
+	profile->n_bs = n;
+	return 0;
+}
+
+/*
+ *  stress_iomix_profile_key()
+ *	apply a key=value override to a profile
+ */
+static int stress_iomix_profile_key(char *kv, stress_iomix_profile_t *profile)
+{
+	char *value = strchr(kv, '=');
+	uint32_t val;
+
+	if (!value) {
+		(void)fprintf(stderr, "iomix-profile %s option '%s' is not "
+			"of the form key=value\n", profile->name, kv);
+		return -1;
+	}
+	*value++ = '\0';
+	if (!strcmp(kv, "bs"))
+		return stress_iomix_bs_parse(value, profile);
+
+	val = stress_get_uint32(value);
+	if (!strcmp(kv, "read") || !strcmp(kv, "seq")) {
+		if (val > 100) {
+			(void)fprintf(stderr, "iomix-profile %s %s must be "
+				"0 to 100 percent\n", profile->name, kv);
+			return -1;
+		}
+		if (*kv == 'r')
+			profile->read_pct = val;
+		else
+			profile->seq_pct = val;
+	} else if (!strcmp(kv, "fsync") || !strcmp(kv, "fdatasync")) {
+		profile->sync_writes = val;
+		profile->fsync = (kv[1] == 's');
+	} else if (!strcmp(kv, "iops")) {
+		profile->iops = val;
+	} else {
+		(void)fprintf(stderr, "iomix-profile %s option '%s' not known, "
+			"options are: read, seq, bs, fsync, fdatasync, iops\n",
+			profile->name, kv);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_iomix_profiles_parse()
+ *	parse a comma separated list of profile names, each can be
+ *	followed by /key=value overrides, returns the number of
+ *	profiles or -1 on error
+ */
+static int stress_iomix_profiles_parse(const char *opt, stress_iomix_profile_t *profiles)
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		char *kv, *save_kv = NULL;
+		const char *name = strtok_r(token, "/", &save_kv);
+		size_t i;
+
+		if (n >= IOMIX_PROFILES_MAX) {
+			(void)fprintf(stderr, "iomix-profile has more than %d "
+				"profiles\n", IOMIX_PROFILES_MAX);
+			goto err;
+		}
+		for (i = 0; name && (i < SIZEOF_ARRAY(iomix_profiles)); i++) {
+			if (!strcmp(name, iomix_profiles[i].name))
+				break;
+		}
+		if (!name || (i >= SIZEOF_ARRAY(iomix_profiles))) {
+			(void)fprintf(stderr, "iomix-profile '%s' not known, profiles are:",
+				name ? name : "");
+			for (i = 0; i < SIZEOF_ARRAY(iomix_profiles); i++)
+				(void)fprintf(stderr, " %s", iomix_profiles[i].name);
+			(void)fprintf(stderr, "\n");
+			goto err;
+		}
+		profiles[n] = iomix_profiles[i];
+		while ((kv = strtok_r(NULL, "/", &save_kv)) != NULL) {
+			if (stress_iomix_profile_key(kv, &profiles[n]) < 0)
+				goto err;
+		}
+		n++;
+	}
+	free(str);
+	return n;
+err:
+	free(str);
+	return -1;
+}
+
+static int stress_set_iomix_profile(const char *opt)
+{
+	stress_iomix_profile_t profiles[IOMIX_PROFILES_MAX];
+
+	if (stress_iomix_profiles_parse(opt, profiles) < 1)
+		return -1;
+	return stress_set_setting("iomix-profile", TYPE_ID_STR, opt);
+}
+
 static int stress_set_iomix_bytes(const char *opt)
 {
 	off_t iomix_bytes;
@@ -809,6 +1017,248 @@ static void stress_iomix_drop_caches(
 }
 #endif
 
+/*
+ *  stress_iomix_lat_bucket()
+ *	map a latency in nanoseconds to a histogram bucket,
+ *	IOMIX_LAT_SUB buckets per power of 2
+ */
+static inline size_t stress_iomix_lat_bucket(const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0;
+
+	if (ns < IOMIX_LAT_SUB)
+		return (size_t)ns;
+	for (v = ns; v > 1; v >>= 1)
+		msb++;
+	return ((msb - 1) * IOMIX_LAT_SUB) + (size_t)((ns >> (msb - 2)) & (IOMIX_LAT_SUB - 1));
+}
+
+/*
+ *  stress_iomix_lat_value()
+ *	upper bound in nanoseconds of a latency histogram bucket
+ */
+static inline uint64_t stress_iomix_lat_value(const size_t bucket)
+{
+	const size_t msb = (bucket / IOMIX_LAT_SUB) + 1;
+	const uint64_t sub = (uint64_t)(bucket % IOMIX_LAT_SUB);
+
+	if (bucket < IOMIX_LAT_SUB)
+		return (uint64_t)bucket;
+	return ((IOMIX_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  stress_iomix_lat_add()
+ *	account an operation of len bytes that took t seconds
+ */
+static inline void stress_iomix_lat_add(
+	stress_iomix_stats_t *stats,
+	const int op,
+	const size_t len,
+	const double t)
+{
+	const uint64_t ns = (uint64_t)(t * 1.0E9);
+
+	stats->ops[op]++;
+	stats->bytes[op] += (uint64_t)len;
+	stats->lat[op][stress_iomix_lat_bucket(ns)]++;
+	if (ns > stats->lat_max[op])
+		stats->lat_max[op] = ns;
+}
+
+/*
+ *  stress_iomix_profile_run()
+ *	issue I/Os matching a profile at its target rate
+ */
+static void stress_iomix_profile_run(
+	const stress_args_t *args,
+	const int fd,
+	const off_t iomix_bytes,
+	const stress_iomix_profile_t *profile,
+	stress_iomix_stats_t *stats)
+{
+	const double period = profile->iops ? 1.0 / (double)profile->iops : 0.0;
+	uint64_t total = 0, writes = 0;
+	off_t cursor[2] = { 0, 0 };
+	size_t bs_max = 0;
+	uint8_t *buf;
+	double t_begin, t_next;
+	int i;
+
+	for (i = 0; i < profile->n_bs; i++) {
+		total += profile->bs[i].weight;
+		if (profile->bs[i].size > bs_max)
+			bs_max = profile->bs[i].size;
+	}
+	if (bs_max > (size_t)iomix_bytes)
+		bs_max = (size_t)iomix_bytes;
+	buf = (uint8_t *)mmap(NULL, bs_max, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot mmap %zu byte %s profile buffer, errno=%d (%s)\n",
+			args->name, bs_max, profile->name, errno, strerror(errno));
+		return;
+	}
+	stress_mwc_fill(buf, bs_max);
+
+	t_begin = stress_time_now();
+	t_next = t_begin;
+	do {
+		const int op = ((stress_mwc32() % 100) < profile->read_pct) ?
+			IOMIX_OP_READ : IOMIX_OP_WRITE;
+		const bool seq = (stress_mwc32() % 100) < profile->seq_pct;
+		uint64_t r = stress_mwc64() % total;
+		size_t len = profile->bs[profile->n_bs - 1].size;
+		off_t offset;
+		ssize_t ret;
+		double t;
+
+		/* Pace to the target rate, do not burst to catch up */
+		if (period > 0.0) {
+			const double now = stress_time_now();
+
+			if (t_next > now)
+				(void)shim_nanosleep_uint64((uint64_t)((t_next - now) * 1.0E9));
+			else if (now - t_next > 1.0)
+				t_next = now;
+			t_next += period;
+			if (!keep_stressing(args))
+				break;
+		}
+
+		for (i = 0; i < profile->n_bs; i++) {
+			if (r < profile->bs[i].weight) {
+				len = profile->bs[i].size;
+				break;
+			}
+			r -= profile->bs[i].weight;
+		}
+		if (len > bs_max)
+			len = bs_max;
+
+		if (seq) {
+			offset = cursor[op];
+			if (offset + (off_t)len > iomix_bytes)
+				offset = 0;
+		} else {
+			offset = stress_iomix_rnd_offset(iomix_bytes - (off_t)len + 1);
+			offset &= ~(off_t)(args->page_size - 1);
+		}
+
+		t = stress_time_now();
+		if (op == IOMIX_OP_READ)
+			ret = pread(fd, buf, len, offset);
+		else
+			ret = pwrite(fd, buf, len, offset);
+		t = stress_time_now() - t;
+		if (ret < 0) {
+			if ((errno == EINTR) || (errno == ENOSPC))
+				continue;
+			pr_fail("%s: %s profile %s failed, errno=%d (%s)\n",
+				args->name, profile->name,
+				(op == IOMIX_OP_READ) ? "pread" : "pwrite",
+				errno, strerror(errno));
+			break;
+		}
+		cursor[op] = offset + ret;
+		stress_iomix_lat_add(stats, op, (size_t)ret, t);
+		inc_counter(args);
+
+		if ((op == IOMIX_OP_WRITE) && profile->sync_writes &&
+		    ((++writes % profile->sync_writes) == 0)) {
+			t = stress_time_now();
+			if (profile->fsync)
+				(void)shim_fsync(fd);
+			else
+				(void)shim_fdatasync(fd);
+			stress_iomix_lat_add(stats, IOMIX_OP_SYNC, 0, stress_time_now() - t);
+		}
+		stats->duration = stress_time_now() - t_begin;
+	} while (keep_stressing(args));
+
+	(void)munmap((void *)buf, bs_max);
+}
+
+/*
+ *  stress_iomix_lat_percentile()
+ *	latency in nanoseconds of a percentile of an operation
+ */
+static uint64_t stress_iomix_lat_percentile(
+	const stress_iomix_stats_t *stats,
+	const int op,
+	const double percentile)
+{
+	const uint64_t target = (uint64_t)ceil(((double)stats->ops[op] * percentile) / 100.0);
+	uint64_t sum = 0;
+	size_t b = 0;
+
+	while ((b < IOMIX_LAT_BUCKETS - 1) && (sum + stats->lat[op][b] < target))
+		sum += stats->lat[op][b++];
+	return STRESS_MINIMUM(stress_iomix_lat_value(b), stats->lat_max[op]);
+}
+
+/*
+ *  stress_iomix_profile_report()
+ *	report the achieved rate and the latencies of each profile
+ */
+static void stress_iomix_profile_report(
+	const stress_args_t *args,
+	const stress_iomix_profile_t *profiles,
+	const stress_iomix_stats_t *stats,
+	const int n_profiles)
+{
+	static const char * const op_names[] = { "read", "write", "sync" };
+	bool lock = false;
+	int i, op, idx = 0;
+
+	pr_lock(&lock);
+	for (i = 0; i < n_profiles; i++) {
+		const stress_iomix_stats_t *s = &stats[i];
+		const double iops = (s->duration > 0.0) ?
+			(double)(s->ops[IOMIX_OP_READ] + s->ops[IOMIX_OP_WRITE]) / s->duration : 0.0;
+		char desc[32];
+
+		(void)snprintf(desc, sizeof(desc), "%s IOPS", profiles[i].name);
+		stress_misc_stats_set(args->misc_stats, idx++, desc, iops);
+
+		if (args->instance == 0) {
+			char target[32];
+
+			if (profiles[i].iops)
+				(void)snprintf(target, sizeof(target), "%" PRIu32, profiles[i].iops);
+			else
+				(void)shim_strlcpy(target, "unthrottled", sizeof(target));
+			pr_inf_lock(&lock, "%s: profile %s: %.1f IOPS (target %s), "
+				"%.2f MB/sec read, %.2f MB/sec written\n",
+				args->name, profiles[i].name, iops, target,
+				(s->duration > 0.0) ? ((double)s->bytes[IOMIX_OP_READ] / (double)MB) / s->duration : 0.0,
+				(s->duration > 0.0) ? ((double)s->bytes[IOMIX_OP_WRITE] / (double)MB) / s->duration : 0.0);
+		}
+		for (op = 0; op < IOMIX_OP_MAX; op++) {
+			if (!s->ops[op])
+				continue;
+			if ((op != IOMIX_OP_SYNC) && (idx < STRESS_MISC_STATS_MAX)) {
+				(void)snprintf(desc, sizeof(desc), "%s %s p99 usec",
+					profiles[i].name, op_names[op]);
+				stress_misc_stats_set(args->misc_stats, idx++, desc,
+					(double)stress_iomix_lat_percentile(s, op, 99.0) / 1000.0);
+			}
+			if (args->instance != 0)
+				continue;
+			pr_inf_lock(&lock, "%s:   %-5s %10" PRIu64 " ops, latency p50 %.1f "
+				"p90 %.1f p99 %.1f p99.9 %.1f max %.1f usec\n",
+				args->name, op_names[op], s->ops[op],
+				(double)stress_iomix_lat_percentile(s, op, 50.0) / 1000.0,
+				(double)stress_iomix_lat_percentile(s, op, 90.0) / 1000.0,
+				(double)stress_iomix_lat_percentile(s, op, 99.0) / 1000.0,
+				(double)stress_iomix_lat_percentile(s, op, 99.9) / 1000.0,
+				(double)s->lat_max[op] / 1000.0);
+		}
+	}
+	pr_unlock(&lock);
+}
+
 static stress_iomix_func iomix_funcs[] = {
 	stress_iomix_wr_seq_bursts,
 	stress_iomix_wr_rnd_bursts,
@@ -845,10 +1295,16 @@ static int stress_iomix(const stress_args_t *args)
 	uint64_t *counters;
 	off_t iomix_bytes = DEFAULT_IOMIX_BYTES;
 	const size_t page_size = args->page_size;
-	const size_t counters_sz = sizeof(uint64_t) * SIZEOF_ARRAY(iomix_funcs);
-	const size_t sz = (counters_sz + page_size) & ~(page_size - 1);
-	size_t i;
-	int pids[SIZEOF_ARRAY(iomix_funcs)];
+	const size_t counters_sz = sizeof(uint64_t) *
+		STRESS_MAXIMUM(SIZEOF_ARRAY(iomix_funcs), IOMIX_PROFILES_MAX);
+	const size_t sz = (counters_sz + (sizeof(stress_iomix_stats_t) *
+		IOMIX_PROFILES_MAX) + page_size) & ~(page_size - 1);
+	size_t i, n_children = SIZEOF_ARRAY(iomix_funcs);
+	int pids[STRESS_MAXIMUM(SIZEOF_ARRAY(iomix_funcs), IOMIX_PROFILES_MAX)];
+	char *iomix_profile = NULL;
+	stress_iomix_profile_t profiles[IOMIX_PROFILES_MAX];
+	stress_iomix_stats_t *stats;
+	int n_profiles = 0, flags = O_CREAT | O_RDWR | O_SYNC;
 
 	counters = (void *)mmap(NULL, sz, PROT_READ | PROT_WRITE,
 			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
@@ -857,6 +1313,19 @@ static int stress_iomix(const stress_args_t *args)
 			args->name, errno, strerror(errno));
 		return EXIT_NO_RESOURCE;
 	}
+	stats = (stress_iomix_stats_t *)((uint8_t *)counters + counters_sz);
+
+	/* Profiles sync at their own rate, so no O_SYNC */
+	(void)stress_get_setting("iomix-profile", &iomix_profile);
+	if (iomix_profile) {
+		n_profiles = stress_iomix_profiles_parse(iomix_profile, profiles);
+		if (n_profiles < 1) {
+			ret = EXIT_FAILURE;
+			goto unmap;
+		}
+		n_children = (size_t)n_profiles;
+		flags = O_CREAT | O_RDWR;
+	}
 
 	if (!stress_get_setting("iomix-bytes", &iomix_bytes)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -878,7 +1347,7 @@ static int stress_iomix(const stress_args_t *args)
 
 	(void)stress_temp_filename_args(args,
 		filename, sizeof(filename), stress_mwc32());
-	if ((fd = open(filename, O_CREAT | O_RDWR | O_SYNC, S_IRUSR | S_IWUSR)) < 0) {
+	if ((fd = open(filename, flags, S_IRUSR | S_IWUSR)) < 0) {
 		ret = exit_status(errno);
 		pr_fail("%s: open %s failed, errno=%d (%s)\n",
 			args->name, filename, errno, strerror(errno));
@@ -907,7 +1376,7 @@ static int stress_iomix(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	for (i = 0; i < SIZEOF_ARRAY(iomix_funcs); i++) {
+	for (i = 0; i < n_children; i++) {
 		stress_args_t tmp_args = *args;
 
 		tmp_args.counter = &counters[i];
@@ -918,7 +1387,11 @@ static int stress_iomix(const stress_args_t *args)
 		} else if (pids[i] == 0) {
 			/* Child */
 			(void)sched_settings_apply(true);
-			iomix_funcs[i](&tmp_args, fd, iomix_bytes);
+			if (n_profiles)
+				stress_iomix_profile_run(&tmp_args, fd, iomix_bytes,
+					&profiles[i], &stats[i]);
+			else
+				iomix_funcs[i](&tmp_args, fd, iomix_bytes);
 			_exit(EXIT_SUCCESS);
 		}
 	}
@@ -926,7 +1399,7 @@ static int stress_iomix(const stress_args_t *args)
 	do {
 		uint64_t c = 0;
 		(void)shim_usleep(5000);
-		for (i = 0; i < SIZEOF_ARRAY(iomix_funcs); i++) {
+		for (i = 0; i < n_children; i++) {
 			c += counters[i];
 			if (UNLIKELY(args->max_ops && c >= args->max_ops)) {
 				set_counter(args, c);
@@ -938,7 +1411,7 @@ static int stress_iomix(const stress_args_t *args)
 	ret = EXIT_SUCCESS;
 reap:
 	set_counter(args, 0);
-	for (i = 0; i < SIZEOF_ARRAY(iomix_funcs); i++) {
+	for (i = 0; i < n_children; i++) {
 		add_counter(args, counters[i]);
 
 		if (pids[i]) {
@@ -946,13 +1419,15 @@ reap:
 			(void)kill(pids[i], SIGKILL);
 		}
 	}
-	for (i = 0; i < SIZEOF_ARRAY(iomix_funcs); i++) {
+	for (i = 0; i < n_children; i++) {
 		if (pids[i]) {
 			int status;
 
 			(void)shim_waitpid(pids[i], &status, 0);
 		}
 	}
+	if (n_profiles)
+		stress_iomix_profile_report(args, profiles, stats, n_profiles);
 
 tidy:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
@@ -967,6 +1442,7 @@ unmap:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_iomix_bytes,	stress_set_iomix_bytes },
+	{ OPT_iomix_profile,	stress_set_iomix_profile },
 	{ 0,			NULL }
 };
 
@@ -0,0 +1,738 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"ipcspeed N",		"start N workers comparing IPC message throughput" },
+	{ NULL,	"ipcspeed-ops N",	"stop after N ipcspeed measurement points" },
+	{ NULL,	"ipcspeed-mech M",	"mq, msg, pipe, unix, ring or all" },
+	{ NULL,	"ipcspeed-sizes list",	"comma separated list of message sizes" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define IPCSPEED_ALL		(0)
+#define IPCSPEED_MAX_SIZES	(8)		/* sizes in a --ipcspeed-sizes list */
+#define IPCSPEED_MIN_SIZE	(32)		/* room for the message header */
+#define IPCSPEED_MAX_SIZE	(64 * KB)
+#define IPCSPEED_DEFAULT_SIZES	"64,1K,8K"	/* 8K fits the default mq and msg limits */
+#define IPCSPEED_SLICE		(0.25)		/* seconds per phase of a measurement point */
+#define IPCSPEED_RING_SLOTS	(64)
+#define IPCSPEED_MQ_MAXMSG	(10)		/* the default fs.mqueue.msg_max */
+#define IPCSPEED_SPINS		(256)		/* ring spins before yielding */
+
+#define IPCSPEED_DATA		(0)
+#define IPCSPEED_STOP		(1)
+#define IPCSPEED_ECHO		(2)
+
+#define IPCSPEED_MQ		(0)
+#define IPCSPEED_MSG		(1)
+#define IPCSPEED_PIPE		(2)
+#define IPCSPEED_UNIX		(3)
+#define IPCSPEED_RING		(4)
+
+/* indexed by the IPCSPEED_* mechanisms */
+static const char * const ipcspeed_mechs[] = {
+	"mq",
+	"msg",
+	"pipe",
+	"unix",
+	"ring",
+};
+
+#define IPCSPEED_MECHS		SIZEOF_ARRAY(ipcspeed_mechs)
+
+/*
+ *  stress_ipcspeed_sizes_parse()
+ *	parse a comma separated list of message sizes, returns
+ *	the number of sizes or -1
+ */
+static int stress_ipcspeed_sizes_parse(const char *opt, size_t *sizes)
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		uint64_t size;
+
+		if (n >= IPCSPEED_MAX_SIZES) {
+			(void)fprintf(stderr, "ipcspeed-sizes has more than %d "
+				"sizes\n", IPCSPEED_MAX_SIZES);
+			free(str);
+			return -1;
+		}
+		size = stress_get_uint64_byte(token);
+		stress_check_range_bytes("ipcspeed-sizes", size,
+			IPCSPEED_MIN_SIZE, IPCSPEED_MAX_SIZE);
+		sizes[n++] = (size_t)size;
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "ipcspeed-sizes needs at least one size\n");
+		return -1;
+	}
+	return n;
+}
+
+static int stress_set_ipcspeed_mech(const char *opt)
+{
+	size_t i;
+	int mech;
+
+	if (!strcmp(opt, "all")) {
+		mech = IPCSPEED_ALL;
+		return stress_set_setting("ipcspeed-mech", TYPE_ID_INT, &mech);
+	}
+	for (i = 0; i < IPCSPEED_MECHS; i++) {
+		if (!strcmp(opt, ipcspeed_mechs[i])) {
+			mech = (int)i + 1;
+			return stress_set_setting("ipcspeed-mech", TYPE_ID_INT, &mech);
+		}
+	}
+	(void)fprintf(stderr, "ipcspeed-mech must be one of: all");
+	for (i = 0; i < IPCSPEED_MECHS; i++)
+		(void)fprintf(stderr, " %s", ipcspeed_mechs[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_ipcspeed_sizes(const char *opt)
+{
+	size_t sizes[IPCSPEED_MAX_SIZES];
+
+	if (stress_ipcspeed_sizes_parse(opt, sizes) < 0)
+		return -1;
+	return stress_set_setting("ipcspeed-sizes", TYPE_ID_STR, opt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_ipcspeed_mech,	stress_set_ipcspeed_mech },
+	{ OPT_ipcspeed_sizes,	stress_set_ipcspeed_sizes },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_MQUEUE_H) &&	\
+    defined(HAVE_LIB_RT) &&	\
+    defined(HAVE_MQ_POSIX)
+#define STRESS_IPCSPEED_MQ
+#endif
+
+#if defined(HAVE_SYS_IPC_H) &&	\
+    defined(HAVE_SYS_MSG_H) &&	\
+    defined(HAVE_MQ_SYSV)
+#define STRESS_IPCSPEED_MSG
+#endif
+
+#if defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_IPCSPEED_RING
+#endif
+
+/* the start of every message */
+typedef struct {
+	uint32_t type;		/* IPCSPEED_DATA, STOP or ECHO */
+	uint32_t size;
+	uint64_t seq;
+} stress_ipcspeed_hdr_t;
+
+/*
+ *  single producer single consumer ring in shared memory, head and
+ *  tail are free running counts on their own cache lines
+ */
+typedef struct {
+	uint64_t head ALIGN64;	/* written by the producer */
+	uint64_t tail ALIGN64;	/* written by the consumer */
+	uint8_t slots[] ALIGN64;
+} stress_ipcspeed_ring_t;
+
+/* one direction of message passing */
+typedef struct {
+	size_t size;
+	int fds[2];			/* pipe or socketpair, [0] to read */
+#if defined(STRESS_IPCSPEED_MQ)
+	mqd_t mq;
+#endif
+#if defined(STRESS_IPCSPEED_MSG)
+	int msgq_id;
+	long *msg_buf;			/* mtype then the message */
+#endif
+	stress_ipcspeed_ring_t *ring;
+	size_t ring_size;
+} stress_ipcspeed_chan_t;
+
+typedef struct {
+	int (*open)(stress_ipcspeed_chan_t *chan);
+	int (*send)(stress_ipcspeed_chan_t *chan, const void *buf);
+	int (*recv)(stress_ipcspeed_chan_t *chan, void *buf);
+	void (*close)(stress_ipcspeed_chan_t *chan);
+} stress_ipcspeed_funcs_t;
+
+typedef struct {
+	uint64_t msgs;		/* messages streamed */
+	double duration;	/* seconds streaming */
+	uint64_t trips;		/* ping pong round trips */
+	double latency;		/* one way latency total, seconds */
+	double latency_max;	/* one way latency max, seconds */
+	bool measured;
+	bool unsupported;
+} stress_ipcspeed_stats_t;
+
+/*
+ *  stress_ipcspeed_read_full()
+ *	read exactly len bytes from a stream
+ */
+static int stress_ipcspeed_read_full(const int fd, void *buf, const size_t len)
+{
+	uint8_t *ptr = (uint8_t *)buf;
+	size_t n = 0;
+
+	while (n < len) {
+		const ssize_t ret = read(fd, ptr + n, len - n);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			return -1;
+		n += (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_ipcspeed_write_full()
+ *	write exactly len bytes to a stream
+ */
+static int stress_ipcspeed_write_full(const int fd, const void *buf, const size_t len)
+{
+	const uint8_t *ptr = (const uint8_t *)buf;
+	size_t n = 0;
+
+	while (n < len) {
+		const ssize_t ret = write(fd, ptr + n, len - n);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		n += (size_t)ret;
+	}
+	return 0;
+}
+
+static int stress_ipcspeed_fd_send(stress_ipcspeed_chan_t *chan, const void *buf)
+{
+	return stress_ipcspeed_write_full(chan->fds[1], buf, chan->size);
+}
+
+static int stress_ipcspeed_fd_recv(stress_ipcspeed_chan_t *chan, void *buf)
+{
+	return stress_ipcspeed_read_full(chan->fds[0], buf, chan->size);
+}
+
+static void stress_ipcspeed_fd_close(stress_ipcspeed_chan_t *chan)
+{
+	(void)close(chan->fds[0]);
+	(void)close(chan->fds[1]);
+}
+
+static int stress_ipcspeed_pipe_open(stress_ipcspeed_chan_t *chan)
+{
+	if (pipe(chan->fds) < 0)
+		return -1;
+#if defined(F_SETPIPE_SZ)
+	/* room for a few of the largest messages */
+	(void)fcntl(chan->fds[1], F_SETPIPE_SZ, 4 * IPCSPEED_MAX_SIZE);
+#endif
+	return 0;
+}
+
+static int stress_ipcspeed_unix_open(stress_ipcspeed_chan_t *chan)
+{
+	return socketpair(AF_UNIX, SOCK_STREAM, 0, chan->fds);
+}
+
+#if defined(STRESS_IPCSPEED_MQ)
+static int stress_ipcspeed_mq_open(stress_ipcspeed_chan_t *chan)
+{
+	static uint32_t instance;
+	struct mq_attr attr;
+	char name[64];
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.mq_maxmsg = IPCSPEED_MQ_MAXMSG;
+	attr.mq_msgsize = (long)chan->size;
+	(void)snprintf(name, sizeof(name), "/stress-ng-ipcspeed-%d-%" PRIu32,
+		(int)getpid(), instance++);
+	chan->mq = mq_open(name, O_CREAT | O_RDWR | O_EXCL, S_IRUSR | S_IWUSR, &attr);
+	if (chan->mq == (mqd_t)-1)
+		return -1;
+	/* the descriptor is inherited over fork, the name is not needed */
+	(void)mq_unlink(name);
+	return 0;
+}
+
+static int stress_ipcspeed_mq_send(stress_ipcspeed_chan_t *chan, const void *buf)
+{
+	while (mq_send(chan->mq, (const char *)buf, chan->size, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+static int stress_ipcspeed_mq_recv(stress_ipcspeed_chan_t *chan, void *buf)
+{
+	while (mq_receive(chan->mq, (char *)buf, chan->size, NULL) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+static void stress_ipcspeed_mq_close(stress_ipcspeed_chan_t *chan)
+{
+	(void)mq_close(chan->mq);
+}
+#endif
+
+#if defined(STRESS_IPCSPEED_MSG)
+static int stress_ipcspeed_msg_open(stress_ipcspeed_chan_t *chan)
+{
+	chan->msg_buf = (long *)calloc(1, sizeof(long) + chan->size);
+	if (!chan->msg_buf)
+		return -1;
+	chan->msgq_id = msgget(IPC_PRIVATE, S_IRUSR | S_IWUSR | IPC_CREAT | IPC_EXCL);
+	if (chan->msgq_id < 0) {
+		free(chan->msg_buf);
+		return -1;
+	}
+	return 0;
+}
+
+static int stress_ipcspeed_msg_send(stress_ipcspeed_chan_t *chan, const void *buf)
+{
+	chan->msg_buf[0] = 1;
+	(void)memcpy(chan->msg_buf + 1, buf, chan->size);
+	while (msgsnd(chan->msgq_id, chan->msg_buf, chan->size, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+static int stress_ipcspeed_msg_recv(stress_ipcspeed_chan_t *chan, void *buf)
+{
+	while (msgrcv(chan->msgq_id, chan->msg_buf, chan->size, 0, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	(void)memcpy(buf, chan->msg_buf + 1, chan->size);
+	return 0;
+}
+
+static void stress_ipcspeed_msg_close(stress_ipcspeed_chan_t *chan)
+{
+	(void)msgctl(chan->msgq_id, IPC_RMID, NULL);
+	free(chan->msg_buf);
+}
+#endif
+
+#if defined(STRESS_IPCSPEED_RING)
+static int stress_ipcspeed_ring_open(stress_ipcspeed_chan_t *chan)
+{
+	chan->ring_size = sizeof(*chan->ring) + (IPCSPEED_RING_SLOTS * chan->size);
+	chan->ring = (stress_ipcspeed_ring_t *)mmap(NULL, chan->ring_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (chan->ring == MAP_FAILED)
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_ipcspeed_ring_wait()
+ *	spin a while then yield, so that a lone CPU can run the peer
+ */
+static inline void stress_ipcspeed_ring_wait(uint32_t *spins)
+{
+	if (++*spins < IPCSPEED_SPINS) {
+#if defined(STRESS_ARCH_X86)
+		__builtin_ia32_pause();
+#endif
+		return;
+	}
+	*spins = 0;
+	(void)shim_sched_yield();
+}
+
+static int stress_ipcspeed_ring_send(stress_ipcspeed_chan_t *chan, const void *buf)
+{
+	stress_ipcspeed_ring_t *ring = chan->ring;
+	const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	uint32_t spins = 0;
+
+	while ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= IPCSPEED_RING_SLOTS) {
+		if (!keep_stressing_flag())
+			return -1;
+		stress_ipcspeed_ring_wait(&spins);
+	}
+	(void)memcpy(ring->slots + ((head % IPCSPEED_RING_SLOTS) * chan->size), buf, chan->size);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int stress_ipcspeed_ring_recv(stress_ipcspeed_chan_t *chan, void *buf)
+{
+	stress_ipcspeed_ring_t *ring = chan->ring;
+	const uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	uint32_t spins = 0;
+
+	while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+		if (!keep_stressing_flag())
+			return -1;
+		stress_ipcspeed_ring_wait(&spins);
+	}
+	(void)memcpy(buf, ring->slots + ((tail % IPCSPEED_RING_SLOTS) * chan->size), chan->size);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void stress_ipcspeed_ring_close(stress_ipcspeed_chan_t *chan)
+{
+	(void)munmap((void *)chan->ring, chan->ring_size);
+}
+#endif
+
+/* indexed by the IPCSPEED_* mechanisms, open is NULL if not built in */
+static const stress_ipcspeed_funcs_t ipcspeed_funcs[] = {
+#if defined(STRESS_IPCSPEED_MQ)
+	{ stress_ipcspeed_mq_open,	stress_ipcspeed_mq_send,
+	  stress_ipcspeed_mq_recv,	stress_ipcspeed_mq_close },
+#else
+	{ NULL,	NULL,	NULL,	NULL },
+#endif
+#if defined(STRESS_IPCSPEED_MSG)
+	{ stress_ipcspeed_msg_open,	stress_ipcspeed_msg_send,
+	  stress_ipcspeed_msg_recv,	stress_ipcspeed_msg_close },
+#else
+	{ NULL,	NULL,	NULL,	NULL },
+#endif
+	{ stress_ipcspeed_pipe_open,	stress_ipcspeed_fd_send,
+	  stress_ipcspeed_fd_recv,	stress_ipcspeed_fd_close },
+	{ stress_ipcspeed_unix_open,	stress_ipcspeed_fd_send,
+	  stress_ipcspeed_fd_recv,	stress_ipcspeed_fd_close },
+#if defined(STRESS_IPCSPEED_RING)
+	{ stress_ipcspeed_ring_open,	stress_ipcspeed_ring_send,
+	  stress_ipcspeed_ring_recv,	stress_ipcspeed_ring_close },
+#else
+	{ NULL,	NULL,	NULL,	NULL },
+#endif
+};
+
+/*
+ *  stress_ipcspeed_consumer()
+ *	child side, drain the streamed messages up to a stop, ack
+ *	it, then echo messages back until the next stop
+ */
+static void NORETURN stress_ipcspeed_consumer(
+	const stress_ipcspeed_funcs_t *funcs,
+	stress_ipcspeed_chan_t *to_child,
+	stress_ipcspeed_chan_t *to_parent,
+	uint8_t *buf)
+{
+	const stress_ipcspeed_hdr_t *hdr = (const stress_ipcspeed_hdr_t *)buf;
+	int phase;
+
+	stress_parent_died_alarm();
+
+	for (phase = 0; phase < 2; phase++) {
+		for (;;) {
+			if (funcs->recv(to_child, buf) < 0)
+				_exit(EXIT_FAILURE);
+			if (hdr->type == IPCSPEED_STOP)
+				break;
+			if ((phase == 1) && (funcs->send(to_parent, buf) < 0))
+				_exit(EXIT_FAILURE);
+		}
+		/* ack the stop so the producer knows everything arrived */
+		if (funcs->send(to_parent, buf) < 0)
+			_exit(EXIT_FAILURE);
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_ipcspeed_point()
+ *	stream messages of one size through one mechanism for a
+ *	slice, then ping pong them for a slice to time one way
+ *	latency. Returns -1 if the mechanism cannot do this size
+ */
+static int stress_ipcspeed_point(
+	const stress_args_t *args,
+	const stress_ipcspeed_funcs_t *funcs,
+	const size_t size,
+	uint8_t *buf,
+	stress_ipcspeed_stats_t *st)
+{
+	stress_ipcspeed_hdr_t *hdr = (stress_ipcspeed_hdr_t *)buf;
+	stress_ipcspeed_chan_t to_child, to_parent;
+	double t, t_end, t_start;
+	uint64_t msgs = 0, trips = 0;
+	double latency = 0.0, latency_max = 0.0;
+	pid_t pid;
+	int status, rc = -1;
+
+	(void)memset(&to_child, 0, sizeof(to_child));
+	(void)memset(&to_parent, 0, sizeof(to_parent));
+	to_child.size = size;
+	to_parent.size = size;
+	if (funcs->open(&to_child) < 0)
+		return -1;
+	if (funcs->open(&to_parent) < 0) {
+		funcs->close(&to_child);
+		return -1;
+	}
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(errno))
+			goto again;
+		funcs->close(&to_parent);
+		funcs->close(&to_child);
+		return -1;
+	} else if (pid == 0) {
+		stress_ipcspeed_consumer(funcs, &to_child, &to_parent, buf);
+	}
+
+	hdr->size = (uint32_t)size;
+
+	/* stream */
+	t_start = stress_time_now();
+	t_end = t_start + IPCSPEED_SLICE;
+	do {
+		hdr->type = IPCSPEED_DATA;
+		hdr->seq = msgs;
+		if (funcs->send(&to_child, buf) < 0)
+			goto kill;
+		msgs++;
+	} while (((msgs & 63) || (stress_time_now() < t_end)) && keep_stressing_flag());
+	hdr->type = IPCSPEED_STOP;
+	if ((funcs->send(&to_child, buf) < 0) ||
+	    (funcs->recv(&to_parent, buf) < 0))
+		goto kill;
+	t = stress_time_now() - t_start;
+
+	/* ping pong */
+	t_end = stress_time_now() + IPCSPEED_SLICE;
+	while (keep_stressing_flag()) {
+		double t0, lat;
+
+		hdr->type = IPCSPEED_ECHO;
+		hdr->seq = trips;
+		t0 = stress_time_now();
+		if ((funcs->send(&to_child, buf) < 0) ||
+		    (funcs->recv(&to_parent, buf) < 0))
+			goto kill;
+		lat = (stress_time_now() - t0) / 2.0;
+		if ((hdr->type != IPCSPEED_ECHO) || (hdr->seq != trips)) {
+			pr_fail("%s: message %" PRIu64 " echoed back corrupted\n",
+				args->name, trips);
+			goto kill;
+		}
+		latency += lat;
+		latency_max = STRESS_MAXIMUM(latency_max, lat);
+		trips++;
+		if (t0 > t_end)
+			break;
+	}
+	hdr->type = IPCSPEED_STOP;
+	if ((funcs->send(&to_child, buf) < 0) ||
+	    (funcs->recv(&to_parent, buf) < 0))
+		goto kill;
+
+	st->msgs += msgs;
+	st->duration += t;
+	st->trips += trips;
+	st->latency += latency;
+	st->latency_max = STRESS_MAXIMUM(st->latency_max, latency_max);
+	rc = 0;
+	goto reap;
+kill:
+	(void)kill(pid, SIGKILL);
+reap:
+	(void)shim_waitpid(pid, &status, 0);
+	funcs->close(&to_parent);
+	funcs->close(&to_child);
+
+	return rc;
+}
+
+/*
+ *  stress_ipcspeed_report()
+ *	report messages, MB and latency per mechanism and size
+ */
+static void stress_ipcspeed_report(
+	const stress_args_t *args,
+	const stress_ipcspeed_stats_t *stats,
+	const size_t *sizes,
+	const int n_sizes)
+{
+	bool lock = false;
+	size_t m;
+	int s, idx = 0;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %-5s %8s %12s %10s %12s %12s\n", args->name,
+		"mech", "size", "msgs/sec", "MB/sec", "latency us", "max lat us");
+	for (m = 0; m < IPCSPEED_MECHS; m++) {
+		for (s = 0; s < n_sizes; s++) {
+			const stress_ipcspeed_stats_t *st = &stats[(m * IPCSPEED_MAX_SIZES) + (size_t)s];
+			char szstr[32];
+			double rate, lat;
+
+			if (!st->measured)
+				continue;
+			stress_uint64_to_str(szstr, sizeof(szstr), (uint64_t)sizes[s]);
+			if (st->unsupported || (st->duration <= 0.0) || !st->trips) {
+				pr_inf_lock(&lock, "%s: %-5s %8s %12s %10s %12s %12s\n", args->name,
+					ipcspeed_mechs[m], szstr, "n/a", "n/a", "n/a", "n/a");
+				continue;
+			}
+			rate = (double)st->msgs / st->duration;
+			lat = (st->latency / (double)st->trips) * 1000000.0;
+			pr_inf_lock(&lock, "%s: %-5s %8s %12.0f %10.2f %12.2f %12.2f\n", args->name,
+				ipcspeed_mechs[m], szstr, rate, (rate * (double)sizes[s]) / (double)MB,
+				lat, st->latency_max * 1000000.0);
+			/* the smallest size, message rate and latency bound */
+			if ((s == 0) && (idx < 9)) {
+				char desc[64];
+
+				(void)snprintf(desc, sizeof(desc), "%s %s msgs/sec",
+					ipcspeed_mechs[m], szstr);
+				stress_misc_stats_set(args->misc_stats, idx++, desc, rate);
+				(void)snprintf(desc, sizeof(desc), "%s %s latency us",
+					ipcspeed_mechs[m], szstr);
+				stress_misc_stats_set(args->misc_stats, idx++, desc, lat);
+			}
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_ipcspeed()
+ *	move the same messages producer to consumer through each
+ *	IPC mechanism
+ */
+static int stress_ipcspeed(const stress_args_t *args)
+{
+	stress_ipcspeed_stats_t *stats;
+	size_t sizes[IPCSPEED_MAX_SIZES], m;
+	char *sizes_opt = IPCSPEED_DEFAULT_SIZES;
+	int mech = IPCSPEED_ALL, n_sizes, s;
+	uint8_t *buf;
+
+	(void)stress_get_setting("ipcspeed-mech", &mech);
+	(void)stress_get_setting("ipcspeed-sizes", &sizes_opt);
+
+	n_sizes = stress_ipcspeed_sizes_parse(sizes_opt, sizes);
+	if (n_sizes < 0)
+		return EXIT_FAILURE;
+
+	if (args->instance == 0) {
+		for (m = 0; m < IPCSPEED_MECHS; m++) {
+			if ((mech == IPCSPEED_ALL) || ((size_t)mech == m + 1)) {
+				if (!ipcspeed_funcs[m].open)
+					pr_inf("%s: %s is not supported, not measuring it\n",
+						args->name, ipcspeed_mechs[m]);
+			}
+		}
+	}
+
+	buf = (uint8_t *)mmap(NULL, IPCSPEED_MAX_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap message buffer, skipping stressor, "
+			"errno=%d (%s)\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	stats = calloc(IPCSPEED_MECHS * IPCSPEED_MAX_SIZES, sizeof(*stats));
+	if (!stats) {
+		pr_inf_skip("%s: cannot allocate statistics, skipping stressor\n",
+			args->name);
+		(void)munmap((void *)buf, IPCSPEED_MAX_SIZE);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_mwc_fill(buf, IPCSPEED_MAX_SIZE);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (m = 0; m < IPCSPEED_MECHS; m++) {
+			if ((mech != IPCSPEED_ALL) && ((size_t)mech != m + 1))
+				continue;
+			if (!ipcspeed_funcs[m].open)
+				continue;
+			for (s = 0; s < n_sizes; s++) {
+				stress_ipcspeed_stats_t *st = &stats[(m * IPCSPEED_MAX_SIZES) + (size_t)s];
+
+				if (!keep_stressing(args))
+					goto report;
+				if (st->unsupported)
+					continue;
+				if (stress_ipcspeed_point(args, &ipcspeed_funcs[m],
+							  sizes[s], buf, st) < 0) {
+					/* an interrupted point is not unsupported */
+					if (keep_stressing_flag()) {
+						st->unsupported = true;
+						st->measured = true;
+					}
+					continue;
+				}
+				st->measured = true;
+				inc_counter(args);
+			}
+		}
+	} while (keep_stressing(args));
+
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_ipcspeed_report(args, stats, sizes, n_sizes);
+
+	free(stats);
+	(void)munmap((void *)buf, IPCSPEED_MAX_SIZE);
+
+	return EXIT_SUCCESS;
+}
+
+stressor_info_t stress_ipcspeed_info = {
+	.stressor = stress_ipcspeed,
+	.class = CLASS_PIPE_IO | CLASS_OS | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
@@ -31,6 +31,7 @@ static const stress_help_t help[] = {
 	{ NULL, "l1cache-line-size N",	"specify level 1 cache line size" },
 	{ NULL, "l1cache-sets N",	"specify level 1 cache sets" },
 	{ NULL, "l1cache-size N",	"specify level 1 cache size" },
+	{ NULL, "l1cache-sweep",	"sweep working set sizes and report latency/bandwidth" },
 	{ NULL,	"l1cache-ways N",	"only fill specified number of cache ways" },
 	{ NULL,	NULL,			NULL }
 };
@@ -66,11 +67,21 @@ static int stress_l1cache_set_sets(const char *opt)
 	return stress_l1cache_set(opt, "l1cache-sets", 65536);
 }
 
+static int stress_l1cache_set_sweep(const char *opt)
+{
+	bool l1cache_sweep = true;
+
+	(void)opt;
+
+	return stress_set_setting("l1cache-sweep", TYPE_ID_BOOL, &l1cache_sweep);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_l1cache_ways,	 stress_l1cache_set_ways },
 	{ OPT_l1cache_size,	 stress_l1cache_set_size },
 	{ OPT_l1cache_line_size, stress_l1cache_set_line_size },
 	{ OPT_l1cache_sets,	 stress_l1cache_set_sets },
+	{ OPT_l1cache_sweep,	 stress_l1cache_set_sweep },
 	{ 0,			NULL }
 };
 
@@ -237,17 +248,27 @@ static int stress_l1cache(const stress_args_t *args)
 	uint8_t *cache, *cache_aligned;
 	uintptr_t addr;
 	uint32_t padding;
+	bool l1cache_sweep = false;
 
 	(void)stress_get_setting("l1cache-ways", &l1cache_ways);
 	(void)stress_get_setting("l1cache-size", &l1cache_size);
 	(void)stress_get_setting("l1cache-sets", &l1cache_sets);
 	(void)stress_get_setting("l1cache-line-size", &l1cache_line_size);
+	(void)stress_get_setting("l1cache-sweep", &l1cache_sweep);
 
 	ret = stress_l1cache_info_ok(args, &l1cache_ways, &l1cache_size,
 				     &l1cache_sets, &l1cache_line_size);
 	if (ret != EXIT_SUCCESS)
 		return ret;
 
+	/*
+	 *  Lines a sets x line size apart all land in the same set,
+	 *  use this L1 geometry for the set conflicting accesses
+	 */
+	if (l1cache_sweep)
+		return stress_cache_sweep(args, l1cache_line_size,
+			(uint64_t)l1cache_sets * l1cache_line_size);
+
 	cache = (uint8_t *)mmap(NULL, l1cache_size << 2,
 				PROT_READ | PROT_WRITE,
 				MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -315,5 +336,6 @@ stressor_info_t stress_l1cache_info = {
 	.stressor = stress_l1cache,
 	.class = CLASS_CPU_CACHE,
 	.opt_set_funcs = opt_set_funcs,
-	.help = help
+	.help = help,
+	.threaded = true
 };
@@ -0,0 +1,831 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"lock N",		"start N workers comparing user space lock algorithms" },
+	{ NULL,	"lock-ops N",		"stop after N lock bogo acquisitions" },
+	{ NULL,	"lock-method M",	"lock algorithm, default is all" },
+	{ NULL,	"lock-threads N",	"number of contending threads (default 4)" },
+	{ NULL,	"lock-cs N",		"critical section of N passes over a cache line" },
+	{ NULL,	"lock-readers P",	"percentage of read acquisitions for rwlock, seqlock and rcu" },
+	{ NULL,	"lock-placement P",	"thread placement: none, compact or spread" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define LOCK_METHOD_ALL		(0)
+#define LOCK_METHOD_TICKET	(1)
+#define LOCK_METHOD_MCS		(2)
+#define LOCK_METHOD_CLH		(3)
+#define LOCK_METHOD_QSPINLOCK	(4)
+#define LOCK_METHOD_MUTEX	(5)
+#define LOCK_METHOD_RWLOCK	(6)
+#define LOCK_METHOD_SEQLOCK	(7)
+#define LOCK_METHOD_RCU		(8)
+#define LOCK_METHODS		(9)
+
+#define LOCK_PLACE_NONE		(0)	/* leave it to the scheduler */
+#define LOCK_PLACE_COMPACT	(1)	/* consecutive CPUs, SMT siblings first */
+#define LOCK_PLACE_SPREAD	(2)	/* interleave the CPUs of each socket */
+
+#define LOCK_THREADS_MAX	(256)
+#define DEFAULT_LOCK_THREADS	(4)
+#define DEFAULT_LOCK_CS		(4)
+#define DEFAULT_LOCK_READERS	(90)
+#define LOCK_SLICE_TIME		(0.5)	/* seconds per method when cycling */
+#define LOCK_SPINS		(1024)	/* spins before yielding the CPU */
+#define LOCK_WORDS		(8)	/* 64 bit words of protected data */
+
+typedef struct {
+	const char *name;
+	const int id;
+} stress_lock_name_t;
+
+static const stress_lock_name_t lock_methods[] = {
+	{ "all",	LOCK_METHOD_ALL },
+	{ "ticket",	LOCK_METHOD_TICKET },
+	{ "mcs",	LOCK_METHOD_MCS },
+	{ "clh",	LOCK_METHOD_CLH },
+	{ "qspinlock",	LOCK_METHOD_QSPINLOCK },
+	{ "mutex",	LOCK_METHOD_MUTEX },
+	{ "rwlock",	LOCK_METHOD_RWLOCK },
+	{ "seqlock",	LOCK_METHOD_SEQLOCK },
+	{ "rcu",	LOCK_METHOD_RCU },
+};
+
+static const stress_lock_name_t lock_places[] = {
+	{ "none",	LOCK_PLACE_NONE },
+	{ "compact",	LOCK_PLACE_COMPACT },
+	{ "spread",	LOCK_PLACE_SPREAD },
+};
+
+/*
+ *  stress_set_lock_name()
+ *	set a named lock option setting
+ */
+static int stress_set_lock_name(
+	const char *opt,
+	const char *setting,
+	const stress_lock_name_t *names,
+	const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(opt, names[i].name)) {
+			const int id = names[i].id;
+
+			return stress_set_setting(setting, TYPE_ID_INT, &id);
+		}
+	}
+	(void)fprintf(stderr, "%s must be one of:", setting);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_lock_method(const char *opt)
+{
+	return stress_set_lock_name(opt, "lock-method",
+		lock_methods, SIZEOF_ARRAY(lock_methods));
+}
+
+static int stress_set_lock_placement(const char *opt)
+{
+	return stress_set_lock_name(opt, "lock-placement",
+		lock_places, SIZEOF_ARRAY(lock_places));
+}
+
+static int stress_set_lock_threads(const char *opt)
+{
+	uint32_t lock_threads;
+
+	lock_threads = stress_get_uint32(opt);
+	stress_check_range("lock-threads", lock_threads, 1, LOCK_THREADS_MAX);
+	return stress_set_setting("lock-threads", TYPE_ID_UINT32, &lock_threads);
+}
+
+static int stress_set_lock_cs(const char *opt)
+{
+	uint32_t lock_cs;
+
+	lock_cs = stress_get_uint32(opt);
+	stress_check_range("lock-cs", lock_cs, 1, 1000000);
+	return stress_set_setting("lock-cs", TYPE_ID_UINT32, &lock_cs);
+}
+
+static int stress_set_lock_readers(const char *opt)
+{
+	uint32_t lock_readers;
+
+	lock_readers = stress_get_uint32(opt);
+	stress_check_range("lock-readers", lock_readers, 0, 100);
+	return stress_set_setting("lock-readers", TYPE_ID_UINT32, &lock_readers);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_lock_method,	stress_set_lock_method },
+	{ OPT_lock_threads,	stress_set_lock_threads },
+	{ OPT_lock_cs,		stress_set_lock_cs },
+	{ OPT_lock_readers,	stress_set_lock_readers },
+	{ OPT_lock_placement,	stress_set_lock_placement },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC)
+
+/* The shared structure the locks protect */
+typedef struct {
+	volatile uint64_t words[LOCK_WORDS];
+	uint64_t count;		/* write acquisitions */
+} ALIGN64 stress_lock_data_t;
+
+/* MCS, CLH and qspinlock queue node */
+typedef struct stress_lock_node {
+	struct stress_lock_node *next;
+	int locked;
+} ALIGN64 stress_lock_node_t;
+
+typedef struct {
+	uint32_t ticket_next ALIGN64;
+	uint32_t ticket_owner;
+	stress_lock_node_t *mcs_tail ALIGN64;
+	stress_lock_node_t *clh_tail ALIGN64;
+	int qspin_locked ALIGN64;
+	stress_lock_node_t *qspin_tail ALIGN64;
+	uint32_t seq ALIGN64;
+	stress_lock_data_t *rcu_current ALIGN64;
+	pthread_mutex_t mutex ALIGN64;
+	pthread_rwlock_t rwlock ALIGN64;
+	stress_lock_data_t data;
+	stress_lock_data_t rcu_data[2];
+	stress_lock_node_t clh_dummy;
+	volatile bool stop;
+	uint32_t threads;
+	uint32_t cs;		/* critical section passes */
+	uint32_t readers;	/* percentage of read acquisitions */
+	int method;
+	const stress_args_t *args;
+	struct stress_lock_thread *thread;
+} stress_lock_shared_t;
+
+typedef struct stress_lock_thread {
+	stress_lock_node_t mcs_node;
+	stress_lock_node_t clh_nodes;
+	uint64_t rcu_nest ALIGN64;	/* odd inside an rcu read section */
+	stress_lock_node_t *clh_node;
+	stress_lock_node_t *clh_pred;
+	stress_lock_shared_t *shared;
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	int32_t cpu;			/* CPU to bind to or -1 */
+	uint64_t acquisitions;
+	uint64_t writes;
+	uint64_t retries;		/* seqlock read retries */
+	uint64_t torn;			/* inconsistent reads */
+} ALIGN64 stress_lock_thread_t;
+
+typedef struct {
+	uint64_t acquisitions;
+	uint64_t writes;
+	uint64_t retries;
+	double duration;
+	double sum_sq;		/* sum of squared per thread rates */
+	double sum;		/* sum of per thread rates */
+	double min;		/* lowest per thread rate */
+	double max;		/* highest per thread rate */
+	uint64_t slices;
+} stress_lock_result_t;
+
+static inline void stress_lock_relax(uint32_t *spins)
+{
+	if (++(*spins) < LOCK_SPINS) {
+#if defined(STRESS_ARCH_X86)
+		__asm__ __volatile__("pause;\n" ::: "memory");
+#elif defined(STRESS_ARCH_ARM) && defined(__aarch64__)
+		__asm__ __volatile__("yield;\n" ::: "memory");
+#else
+		__asm__ __volatile__("" ::: "memory");
+#endif
+	} else {
+		/* Give a preempted lock holder or waiter the CPU */
+		*spins = 0;
+		(void)shim_sched_yield();
+	}
+}
+
+/*
+ *  Ticket lock, FIFO over a pair of counters
+ */
+static inline void stress_lock_ticket_acquire(stress_lock_shared_t *s)
+{
+	const uint32_t ticket = __atomic_fetch_add(&s->ticket_next, 1, __ATOMIC_RELAXED);
+	uint32_t spins = 0;
+
+	while (__atomic_load_n(&s->ticket_owner, __ATOMIC_ACQUIRE) != ticket)
+		stress_lock_relax(&spins);
+}
+
+static inline void stress_lock_ticket_release(stress_lock_shared_t *s)
+{
+	__atomic_store_n(&s->ticket_owner, s->ticket_owner + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  MCS lock, each waiter spins on its own queue node
+ */
+static inline void stress_lock_mcs_acquire(stress_lock_node_t **tail, stress_lock_node_t *node)
+{
+	stress_lock_node_t *prev;
+	uint32_t spins = 0;
+
+	node->next = NULL;
+	__atomic_store_n(&node->locked, 1, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(tail, node, __ATOMIC_ACQ_REL);
+	if (!prev)
+		return;
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+	while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+		stress_lock_relax(&spins);
+}
+
+static inline void stress_lock_mcs_release(stress_lock_node_t **tail, stress_lock_node_t *node)
+{
+	stress_lock_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	uint32_t spins = 0;
+
+	if (!next) {
+		stress_lock_node_t *expected = node;
+
+		if (__atomic_compare_exchange_n(tail, &expected, NULL, false,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+		/* A waiter is linking itself in */
+		while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+			stress_lock_relax(&spins);
+	}
+	__atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  CLH lock, each waiter spins on its predecessor's node and
+ *  takes it over as its own node on release
+ */
+static inline void stress_lock_clh_acquire(stress_lock_shared_t *s, stress_lock_thread_t *t)
+{
+	stress_lock_node_t *pred;
+	uint32_t spins = 0;
+
+	__atomic_store_n(&t->clh_node->locked, 1, __ATOMIC_RELAXED);
+	pred = __atomic_exchange_n(&s->clh_tail, t->clh_node, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE))
+		stress_lock_relax(&spins);
+	t->clh_pred = pred;
+}
+
+static inline void stress_lock_clh_release(stress_lock_thread_t *t)
+{
+	stress_lock_node_t *node = t->clh_node;
+
+	t->clh_node = t->clh_pred;
+	__atomic_store_n(&node->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  A simplified qspinlock, an uncontended compare and swap on the
+ *  lock word, contended waiters queue on an MCS lock and only its
+ *  head spins on the lock word
+ */
+static inline bool stress_lock_qspin_try(stress_lock_shared_t *s)
+{
+	int expected = 0;
+
+	return __atomic_compare_exchange_n(&s->qspin_locked, &expected, 1,
+		false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void stress_lock_qspin_acquire(stress_lock_shared_t *s, stress_lock_thread_t *t)
+{
+	uint32_t spins = 0;
+
+	if (stress_lock_qspin_try(s))
+		return;
+	stress_lock_mcs_acquire(&s->qspin_tail, &t->mcs_node);
+	while (!stress_lock_qspin_try(s))
+		stress_lock_relax(&spins);
+	stress_lock_mcs_release(&s->qspin_tail, &t->mcs_node);
+}
+
+static inline void stress_lock_qspin_release(stress_lock_shared_t *s)
+{
+	__atomic_store_n(&s->qspin_locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  stress_lock_write()
+ *	the write critical section, every word of the data is given
+ *	the same new value on each pass
+ */
+static inline void stress_lock_write(stress_lock_data_t *data, const uint32_t cs)
+{
+	const uint64_t val = data->words[0] + 1;
+	uint32_t i;
+
+	for (i = 0; i < cs; i++) {
+		size_t j;
+
+		for (j = 0; j < LOCK_WORDS; j++)
+			data->words[j] = val;
+	}
+	data->count++;
+}
+
+/*
+ *  stress_lock_read()
+ *	the read critical section, returns false if the data
+ *	was modified under the reader
+ */
+static inline bool stress_lock_read(const stress_lock_data_t *data, const uint32_t cs)
+{
+	const uint64_t val = data->words[0];
+	bool consistent = true;
+	uint32_t i;
+
+	for (i = 0; i < cs; i++) {
+		size_t j;
+
+		for (j = 0; j < LOCK_WORDS; j++)
+			consistent &= (data->words[j] == val);
+	}
+	return consistent;
+}
+
+/*
+ *  stress_lock_rcu_read()
+ *	an rcu like reader, it marks its read section in its nest
+ *	count and reads whichever copy is currently published
+ */
+static inline bool stress_lock_rcu_read(stress_lock_shared_t *s, stress_lock_thread_t *t)
+{
+	const stress_lock_data_t *data;
+	bool consistent;
+
+	(void)__atomic_fetch_add(&t->rcu_nest, 1, __ATOMIC_SEQ_CST);
+	data = __atomic_load_n(&s->rcu_current, __ATOMIC_ACQUIRE);
+	consistent = stress_lock_read(data, s->cs);
+	(void)__atomic_fetch_add(&t->rcu_nest, 1, __ATOMIC_RELEASE);
+	return consistent;
+}
+
+/*
+ *  stress_lock_rcu_write()
+ *	update a copy of the published data, publish it and wait for
+ *	a grace period so the old copy is free for the next writer
+ */
+static inline void stress_lock_rcu_write(stress_lock_shared_t *s, stress_lock_thread_t *t)
+{
+	stress_lock_data_t *prev, *next;
+	uint32_t i;
+
+	stress_lock_ticket_acquire(s);
+	prev = s->rcu_current;
+	next = (prev == &s->rcu_data[0]) ? &s->rcu_data[1] : &s->rcu_data[0];
+	for (i = 0; i < LOCK_WORDS; i++)
+		next->words[i] = prev->words[i];
+	next->count = prev->count;
+	stress_lock_write(next, s->cs);
+	__atomic_store_n(&s->rcu_current, next, __ATOMIC_SEQ_CST);
+
+	for (i = 0; i < s->threads; i++) {
+		stress_lock_thread_t *r = &s->thread[i];
+		const uint64_t nest = __atomic_load_n(&r->rcu_nest, __ATOMIC_ACQUIRE);
+		uint32_t spins = 0;
+
+		if ((r == t) || !(nest & 1))
+			continue;
+		while (__atomic_load_n(&r->rcu_nest, __ATOMIC_ACQUIRE) == nest)
+			stress_lock_relax(&spins);
+	}
+	stress_lock_ticket_release(s);
+}
+
+/*
+ *  stress_lock_seqlock_read()
+ *	read until a pass completes without a writer in between
+ */
+static inline void stress_lock_seqlock_read(stress_lock_shared_t *s, stress_lock_thread_t *t)
+{
+	uint32_t spins = 0;
+
+	for (;;) {
+		const uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+
+		if (seq & 1) {
+			stress_lock_relax(&spins);
+			continue;
+		}
+		(void)stress_lock_read(&s->data, s->cs);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+			return;
+		t->retries++;
+	}
+}
+
+static inline void stress_lock_seqlock_write(stress_lock_shared_t *s)
+{
+	stress_lock_ticket_acquire(s);
+	(void)__atomic_fetch_add(&s->seq, 1, __ATOMIC_SEQ_CST);
+	stress_lock_write(&s->data, s->cs);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	(void)__atomic_fetch_add(&s->seq, 1, __ATOMIC_SEQ_CST);
+	stress_lock_ticket_release(s);
+}
+
+/*
+ *  stress_lock_thread()
+ *	acquire the lock of the current method until told to stop
+ */
+static void *stress_lock_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_lock_thread_t *t = (stress_lock_thread_t *)arg;
+	stress_lock_shared_t *s = t->shared;
+	const uint32_t cs = s->cs;
+	const uint32_t readers = s->readers;
+	uint64_t acquisitions = 0, writes = 0, torn = 0;
+	uint32_t op = (uint32_t)(t - s->thread);
+
+#if defined(HAVE_AFFINITY)
+	if (t->cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(t->cpu, &mask);
+		(void)sched_setaffinity(0, sizeof(mask), &mask);
+	}
+#endif
+	while (!s->stop) {
+		/* Readers take an even share of each 100 operations */
+		const bool write = (op++ % 100) >= readers;
+
+		switch (s->method) {
+		case LOCK_METHOD_TICKET:
+			stress_lock_ticket_acquire(s);
+			stress_lock_write(&s->data, cs);
+			stress_lock_ticket_release(s);
+			writes++;
+			break;
+		case LOCK_METHOD_MCS:
+			stress_lock_mcs_acquire(&s->mcs_tail, &t->mcs_node);
+			stress_lock_write(&s->data, cs);
+			stress_lock_mcs_release(&s->mcs_tail, &t->mcs_node);
+			writes++;
+			break;
+		case LOCK_METHOD_CLH:
+			stress_lock_clh_acquire(s, t);
+			stress_lock_write(&s->data, cs);
+			stress_lock_clh_release(t);
+			writes++;
+			break;
+		case LOCK_METHOD_QSPINLOCK:
+			stress_lock_qspin_acquire(s, t);
+			stress_lock_write(&s->data, cs);
+			stress_lock_qspin_release(s);
+			writes++;
+			break;
+		case LOCK_METHOD_MUTEX:
+			(void)pthread_mutex_lock(&s->mutex);
+			stress_lock_write(&s->data, cs);
+			(void)pthread_mutex_unlock(&s->mutex);
+			writes++;
+			break;
+		case LOCK_METHOD_RWLOCK:
+			if (write) {
+				(void)pthread_rwlock_wrlock(&s->rwlock);
+				stress_lock_write(&s->data, cs);
+				writes++;
+			} else {
+				(void)pthread_rwlock_rdlock(&s->rwlock);
+				torn += !stress_lock_read(&s->data, cs);
+			}
+			(void)pthread_rwlock_unlock(&s->rwlock);
+			break;
+		case LOCK_METHOD_SEQLOCK:
+			if (write) {
+				stress_lock_seqlock_write(s);
+				writes++;
+			} else {
+				stress_lock_seqlock_read(s, t);
+			}
+			break;
+		case LOCK_METHOD_RCU:
+			if (write) {
+				stress_lock_rcu_write(s, t);
+				writes++;
+			} else {
+				torn += !stress_lock_rcu_read(s, t);
+			}
+			break;
+		default:
+			s->stop = true;
+			break;
+		}
+		t->acquisitions = ++acquisitions;
+	}
+	t->writes = writes;
+	t->torn = torn;
+	return &nowt;
+}
+
+/*
+ *  stress_lock_slice()
+ *	run the threads on the current method for duration seconds,
+ *	or until the stressor stops if duration is zero, returns
+ *	false if the locks failed to keep the data consistent
+ */
+static bool stress_lock_slice(
+	stress_lock_shared_t *s,
+	const double duration,
+	stress_lock_result_t *result)
+{
+	const stress_args_t *args = s->args;
+	const char *name = lock_methods[s->method].name;
+	uint64_t writes = 0, count_before, count_after, torn = 0;
+	double t_start, t_end;
+	uint32_t i;
+	bool ok = true;
+
+	s->stop = false;
+	s->clh_dummy.locked = 0;
+	s->clh_tail = &s->clh_dummy;
+	s->rcu_current = &s->rcu_data[0];
+	count_before = (s->method == LOCK_METHOD_RCU) ?
+		s->rcu_current->count : s->data.count;
+
+	t_start = stress_time_now();
+	for (i = 0; i < s->threads; i++) {
+		stress_lock_thread_t *t = &s->thread[i];
+
+		t->shared = s;
+		t->clh_node = &t->clh_nodes;
+		t->acquisitions = 0;
+		t->writes = 0;
+		t->retries = 0;
+		t->torn = 0;
+		t->ret = pthread_create(&t->pthread, NULL, stress_lock_thread, t);
+	}
+	while (keep_stressing(args)) {
+		uint64_t acquisitions = get_counter(args);
+
+		(void)shim_usleep(10000);
+		if ((duration > 0.0) && (stress_time_now() - t_start >= duration))
+			break;
+		/* Stop near --lock-ops from the running per thread counts */
+		for (i = 0; i < s->threads; i++)
+			acquisitions += s->thread[i].acquisitions;
+		if (args->max_ops && (acquisitions >= args->max_ops))
+			break;
+	}
+	s->stop = true;
+	for (i = 0; i < s->threads; i++) {
+		if (s->thread[i].ret == 0)
+			(void)pthread_join(s->thread[i].pthread, NULL);
+	}
+	t_end = stress_time_now();
+	result->duration += t_end - t_start;
+	result->slices++;
+
+	for (i = 0; i < s->threads; i++) {
+		const stress_lock_thread_t *t = &s->thread[i];
+		const double rate = (double)t->acquisitions / (t_end - t_start);
+
+		if (t->ret != 0)
+			continue;
+		result->acquisitions += t->acquisitions;
+		result->writes += t->writes;
+		result->retries += t->retries;
+		result->sum += rate;
+		result->sum_sq += rate * rate;
+		if ((result->min < 0.0) || (rate < result->min))
+			result->min = rate;
+		if (rate > result->max)
+			result->max = rate;
+		writes += t->writes;
+		torn += t->torn;
+		add_counter(args, t->acquisitions);
+	}
+
+	count_after = (s->method == LOCK_METHOD_RCU) ?
+		s->rcu_current->count : s->data.count;
+	if (count_after - count_before != writes) {
+		pr_fail("%s: %s lost updates, %" PRIu64 " writes but the "
+			"data was updated %" PRIu64 " times\n", args->name,
+			name, writes, count_after - count_before);
+		ok = false;
+	}
+	if (torn) {
+		pr_fail("%s: %s readers saw %" PRIu64 " inconsistent "
+			"reads\n", args->name, name, torn);
+		ok = false;
+	}
+	/* The second rcu copy carries on from the first next time */
+	if (s->method == LOCK_METHOD_RCU)
+		s->rcu_data[0] = *s->rcu_current;
+	return ok;
+}
+
+/*
+ *  stress_lock_placement()
+ *	work out the CPU each thread is bound to
+ */
+static void stress_lock_placement(
+	const stress_args_t *args,
+	stress_lock_thread_t *threads,
+	const uint32_t n,
+	const int place)
+{
+	uint32_t i;
+#if defined(HAVE_AFFINITY)
+	int32_t cpus[CPU_SETSIZE];
+	int32_t ncpus = 0;
+	cpu_set_t allowed;
+
+	if ((place != LOCK_PLACE_NONE) &&
+	    (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)) {
+		if (place == LOCK_PLACE_SPREAD) {
+			ncpus = stress_cpus_interleave_packages(&allowed, cpus, CPU_SETSIZE);
+		} else {
+			int32_t cpu;
+
+			for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+				if (CPU_ISSET(cpu, &allowed))
+					cpus[ncpus++] = cpu;
+			}
+		}
+	}
+	for (i = 0; i < n; i++)
+		threads[i].cpu = ncpus ? cpus[i % (uint32_t)ncpus] : -1;
+	if (ncpus && (n > (uint32_t)ncpus) && (args->instance == 0))
+		pr_dbg("%s: %" PRIu32 " threads share %" PRId32 " CPUs\n",
+			args->name, n, ncpus);
+#else
+	if ((place != LOCK_PLACE_NONE) && (args->instance == 0))
+		pr_inf("%s: CPU affinity not supported, ignoring "
+			"--lock-placement\n", args->name);
+	for (i = 0; i < n; i++)
+		threads[i].cpu = -1;
+#endif
+}
+
+/*
+ *  stress_lock()
+ *	stress user space lock algorithms under contention
+ */
+static int stress_lock(const stress_args_t *args)
+{
+	stress_lock_result_t results[LOCK_METHODS];
+	stress_lock_shared_t *s;
+	stress_lock_thread_t *threads;
+	uint32_t lock_threads = DEFAULT_LOCK_THREADS;
+	uint32_t lock_cs = DEFAULT_LOCK_CS;
+	uint32_t lock_readers = DEFAULT_LOCK_READERS;
+	int lock_method = LOCK_METHOD_ALL;
+	int lock_placement = LOCK_PLACE_NONE;
+	size_t threads_size;
+	bool lock = false;
+	int m, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("lock-method", &lock_method);
+	(void)stress_get_setting("lock-threads", &lock_threads);
+	(void)stress_get_setting("lock-cs", &lock_cs);
+	(void)stress_get_setting("lock-readers", &lock_readers);
+	(void)stress_get_setting("lock-placement", &lock_placement);
+
+	threads_size = sizeof(*threads) * lock_threads;
+	threads = (stress_lock_thread_t *)mmap(NULL, threads_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (threads == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes for %" PRIu32 " threads, "
+			"skipping stressor\n", args->name, threads_size, lock_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	s = (stress_lock_shared_t *)mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (s == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes for the locks, "
+			"skipping stressor\n", args->name, sizeof(*s));
+		(void)munmap((void *)threads, threads_size);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)pthread_mutex_init(&s->mutex, NULL);
+	(void)pthread_rwlock_init(&s->rwlock, NULL);
+	s->args = args;
+	s->thread = threads;
+	s->threads = lock_threads;
+	s->cs = lock_cs;
+	s->readers = lock_readers;
+	stress_lock_placement(args, threads, lock_threads, lock_placement);
+
+	(void)memset(results, 0, sizeof(results));
+	for (m = 0; m < LOCK_METHODS; m++)
+		results[m].min = -1.0;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	if (lock_method == LOCK_METHOD_ALL) {
+		/* Cycle over the methods a slice at a time */
+		do {
+			for (m = LOCK_METHOD_ALL + 1; keep_stressing(args) && (m < LOCK_METHODS); m++) {
+				s->method = m;
+				if (!stress_lock_slice(s, LOCK_SLICE_TIME, &results[m]))
+					rc = EXIT_FAILURE;
+			}
+		} while ((rc == EXIT_SUCCESS) && keep_stressing(args));
+	} else {
+		s->method = lock_method;
+		if (!stress_lock_slice(s, 0.0, &results[lock_method]))
+			rc = EXIT_FAILURE;
+	}
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	/*
+	 *  Fairness is Jain's index over the per thread acquisition
+	 *  rates, 1.0 when all threads get an equal share
+	 */
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %" PRIu32 " threads, %" PRIu32 " pass critical "
+		"section, %" PRIu32 "%% readers (instance %" PRIu32 ")\n",
+		args->name, lock_threads, lock_cs, lock_readers, args->instance);
+	pr_inf_lock(&lock, "%s: %-10s %14s %9s %14s %14s\n", args->name, "method",
+		"acquires/sec", "fairness", "min/thread/sec", "max/thread/sec");
+	for (m = LOCK_METHOD_ALL + 1; m < LOCK_METHODS; m++) {
+		const stress_lock_result_t *r = &results[m];
+		const double n = (double)r->slices * (double)lock_threads;
+		double fairness;
+
+		if ((r->duration <= 0.0) || (r->sum_sq <= 0.0))
+			continue;
+		fairness = (r->sum * r->sum) / (n * r->sum_sq);
+		pr_inf_lock(&lock, "%s: %-10s %14.2f %9.3f %14.2f %14.2f\n", args->name,
+			lock_methods[m].name, (double)r->acquisitions / r->duration,
+			fairness, r->min, r->max);
+		if (m == LOCK_METHOD_SEQLOCK && r->acquisitions > r->writes) {
+			pr_inf_lock(&lock, "%s: seqlock readers retried %.2f%% of reads\n",
+				args->name, 100.0 * (double)r->retries /
+				(double)(r->acquisitions - r->writes));
+		}
+	}
+	pr_unlock(&lock);
+
+	for (m = LOCK_METHOD_ALL + 1; m < LOCK_METHODS; m++) {
+		const stress_lock_result_t *r = &results[m];
+		char desc[32];
+
+		if (r->duration <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s acquires per sec",
+			lock_methods[m].name);
+		stress_misc_stats_set(args->misc_stats, m - 1, desc,
+			(double)r->acquisitions / r->duration);
+	}
+
+	(void)pthread_rwlock_destroy(&s->rwlock);
+	(void)pthread_mutex_destroy(&s->mutex);
+	(void)munmap((void *)s, sizeof(*s));
+	(void)munmap((void *)threads, threads_size);
+
+	return rc;
+}
+
+stressor_info_t stress_lock_info = {
+	.stressor = stress_lock,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_lock_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_CPU | CLASS_SCHEDULER,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
@@ -38,6 +38,18 @@ static size_t malloc_pthreads;		/* Number of pthreads */
 static size_t malloc_threshold;		/* When to use mmap and not sbrk */
 #endif
 static bool malloc_touch;		/* True will touch allocate pages */
+static bool malloc_trace;		/* True replays a synthetic allocation trace */
+
+/* Allocator in use, libc unless --malloc-allocator is given */
+static void *(*malloc_func)(size_t size) = malloc;
+static void *(*calloc_func)(size_t nmemb, size_t size) = calloc;
+static void *(*realloc_func)(void *ptr, size_t size) = realloc;
+static void (*free_func)(void *ptr) = free;
+
+#define MALLOC_TRACE_SHORT	(16)	/* short lived objects ring size */
+#define MALLOC_TRACE_MEDIUM	(1024)	/* medium lived objects ring size */
+#define MALLOC_TRACE_MAILBOX	(256)	/* cross-thread frees per thread */
+#define MALLOC_TRACE_SAMPLE	(16384)	/* ops between RSS samples */
 
 #if defined(HAVE_LIB_PTHREAD)
 /* per pthread data */
@@ -47,10 +59,60 @@ typedef struct {
 } stress_pthread_info_t;
 #endif
 
+/* A traced allocation */
+typedef struct {
+	void *ptr;		/* allocation */
+	size_t size;		/* requested size */
+} stress_malloc_obj_t;
+
+/* Objects freed by another thread than the one that allocated them */
+typedef struct {
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_mutex_t lock;
+#endif
+	size_t n;
+	stress_malloc_obj_t objs[MALLOC_TRACE_MAILBOX];
+} stress_malloc_mailbox_t;
+
+/* State shared by all the trace threads */
+typedef struct {
+	stress_malloc_mailbox_t mailboxes[MAX_MALLOC_PTHREADS + 1];
+	int64_t live[MAX_MALLOC_PTHREADS + 1];	/* requested bytes in use, racy */
+	size_t rss_base;			/* RSS before the trace started */
+	size_t rss;				/* RSS at the last sample */
+	int64_t live_sampled;			/* live bytes at the last sample */
+} stress_malloc_trace_t;
+
+/* Size class upper bounds and their share of allocations in 1/1000ths */
+typedef struct {
+	size_t size;
+	uint16_t weight;
+} stress_malloc_class_t;
+
+/*
+ *  Most allocations in long running services are small objects,
+ *  with a long tail of buffers, roughly as in published heap
+ *  profiles of server workloads
+ */
+static const stress_malloc_class_t malloc_classes[] = {
+	{ 16,		250 },
+	{ 32,		200 },
+	{ 64,		150 },
+	{ 128,		100 },
+	{ 256,		80 },
+	{ 512,		60 },
+	{ 1 * KB,	50 },
+	{ 4 * KB,	50 },
+	{ 16 * KB,	30 },
+	{ 64 * KB,	20 },
+	{ 256 * KB,	10 },
+};
+
 typedef struct {
 	const stress_args_t *args;			/* args info */
 	uint64_t *counters;				/* bogo op counters */
 	size_t instance;				/* per thread instance number */
+	stress_malloc_trace_t *trace;			/* trace mode shared state */
 } stress_malloc_args_t;
 
 static const stress_help_t help[] = {
@@ -61,6 +123,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"malloc-thresh N",	"threshold where malloc uses mmap instead of sbrk" },
 	{ NULL, "malloc-pthreads N",	"number of pthreads to run concurrently" },
 	{ NULL, "malloc-touch",		"touch pages force pages to be populated" },
+	{ NULL, "malloc-trace",		"replay a synthetic trace of skewed sizes and lifetimes" },
+	{ NULL, "malloc-allocator F",	"use the malloc family of functions from library F" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -112,6 +176,19 @@ static int stress_set_malloc_touch(const char *opt)
 	return stress_set_setting("malloc-touch", TYPE_ID_BOOL, &malloc_touch_tmp);
 }
 
+static int stress_set_malloc_trace(const char *opt)
+{
+	bool malloc_trace_tmp = true;
+
+	(void)opt;
+	return stress_set_setting("malloc-trace", TYPE_ID_BOOL, &malloc_trace_tmp);
+}
+
+static int stress_set_malloc_allocator(const char *opt)
+{
+	return stress_set_setting("malloc-allocator", TYPE_ID_STR, opt);
+}
+
 /*
  *  stress_alloc_size()
  *	get a new allocation size, ensuring
@@ -213,14 +290,14 @@ static void *stress_malloc_loop(void *ptr)
 		if (addr[i]) {
 			/* 50% free, 50% realloc */
 			if (action) {
-				free(addr[i]);
+				free_func(addr[i]);
 				addr[i] = NULL;
 				(*counter)++;
 			} else {
 				void *tmp;
 				const size_t len = stress_alloc_size(malloc_bytes);
 
-				tmp = realloc(addr[i], len);
+				tmp = realloc_func(addr[i], len);
 				if (tmp) {
 					addr[i] = tmp;
 					stress_malloc_page_touch(addr[i], len, page_size);
@@ -234,10 +311,10 @@ static void *stress_malloc_loop(void *ptr)
 
 				if (do_calloc == 0) {
 					size_t n = ((rnd >> 15) % 17) + 1;
-					addr[i] = calloc(n, len / n);
+					addr[i] = calloc_func(n, len / n);
 					len = n * (len / n);
 				} else {
-					addr[i] = malloc(len);
+					addr[i] = malloc_func(len);
 				}
 				if (addr[i]) {
 					stress_malloc_page_touch(addr[i], len, page_size);
@@ -248,36 +325,284 @@ static void *stress_malloc_loop(void *ptr)
 	}
 
 	for (j = 0; j < malloc_max; j++) {
-		free(addr[j]);
+		free_func(addr[j]);
 	}
 	free(addr);
 
 	return &nowt;
 }
 
+/*
+ *  stress_malloc_rss()
+ *	get the resident set size of the process in bytes
+ */
+static size_t stress_malloc_rss(const size_t page_size)
+{
+	char buf[64];
+	unsigned long size, resident;
+
+	if (system_read("/proc/self/statm", buf, sizeof(buf)) <= 0)
+		return 0;
+	if (sscanf(buf, "%lu %lu", &size, &resident) != 2)
+		return 0;
+	return (size_t)resident * page_size;
+}
+
+/*
+ *  stress_malloc_trace_free()
+ *	free a traced object, one in ten is handed to the next thread
+ *	to free when there are pthreads
+ */
+static void stress_malloc_trace_free(
+	const stress_malloc_args_t *malloc_args,
+	stress_malloc_obj_t *obj,
+	const bool cross)
+{
+	stress_malloc_trace_t *trace = malloc_args->trace;
+
+	if (!obj->ptr)
+		return;
+#if defined(HAVE_LIB_PTHREAD)
+	if (cross && (malloc_pthreads > 0) && ((stress_mwc8() % 10) == 0)) {
+		const size_t to = (malloc_args->instance + 1) % (malloc_pthreads + 1);
+		stress_malloc_mailbox_t *mailbox = &trace->mailboxes[to];
+		bool handed = false;
+
+		(void)pthread_mutex_lock(&mailbox->lock);
+		if (mailbox->n < MALLOC_TRACE_MAILBOX) {
+			mailbox->objs[mailbox->n++] = *obj;
+			handed = true;
+		}
+		(void)pthread_mutex_unlock(&mailbox->lock);
+		if (handed) {
+			obj->ptr = NULL;
+			return;
+		}
+	}
+#else
+	(void)cross;
+#endif
+	free_func(obj->ptr);
+	trace->live[malloc_args->instance] -= (int64_t)obj->size;
+	obj->ptr = NULL;
+}
+
+/*
+ *  stress_malloc_trace_drain()
+ *	free the objects other threads have handed to this thread,
+ *	the live bytes move to this thread's account
+ */
+static void stress_malloc_trace_drain(const stress_malloc_args_t *malloc_args)
+{
+	stress_malloc_trace_t *trace = malloc_args->trace;
+	stress_malloc_mailbox_t *mailbox = &trace->mailboxes[malloc_args->instance];
+	stress_malloc_obj_t objs[MALLOC_TRACE_MAILBOX];
+	size_t i, n;
+
+#if defined(HAVE_LIB_PTHREAD)
+	(void)pthread_mutex_lock(&mailbox->lock);
+#endif
+	n = mailbox->n;
+	(void)memcpy(objs, mailbox->objs, n * sizeof(*objs));
+	mailbox->n = 0;
+#if defined(HAVE_LIB_PTHREAD)
+	(void)pthread_mutex_unlock(&mailbox->lock);
+#endif
+	for (i = 0; i < n; i++) {
+		free_func(objs[i].ptr);
+		trace->live[malloc_args->instance] -= (int64_t)objs[i].size;
+	}
+}
+
+/*
+ *  stress_malloc_trace_loop()
+ *	replay a synthetic allocation trace, sizes are drawn from
+ *	size classes skewed to small objects and most objects die
+ *	young: 80% live for 16 allocations, 15% for 1024 allocations
+ *	and the rest replace a random long lived object
+ */
+static void *stress_malloc_trace_loop(void *ptr)
+{
+	const stress_malloc_args_t *malloc_args = (stress_malloc_args_t *)ptr;
+	const stress_args_t *args = malloc_args->args;
+	const size_t page_size = args->page_size;
+	stress_malloc_trace_t *trace = malloc_args->trace;
+	uint64_t *counters = malloc_args->counters;
+	uint64_t *counter = &counters[malloc_args->instance];
+	stress_malloc_obj_t *pool;
+	stress_malloc_obj_t *short_ring, *medium_ring, *long_lived;
+	size_t short_idx = 0, medium_idx = 0, i;
+	uint64_t ops = 0;
+	static void *nowt = NULL;
+
+	pool = (stress_malloc_obj_t *)calloc(MALLOC_TRACE_SHORT +
+		MALLOC_TRACE_MEDIUM + malloc_max, sizeof(*pool));
+	if (!pool) {
+		pr_dbg("%s: cannot allocate trace object pool: %d (%s)\n",
+			args->name, errno, strerror(errno));
+		return &nowt;
+	}
+	short_ring = pool;
+	medium_ring = short_ring + MALLOC_TRACE_SHORT;
+	long_lived = medium_ring + MALLOC_TRACE_MEDIUM;
+
+	for (;;) {
+		const uint32_t rnd = stress_mwc32();
+		const uint32_t weight = rnd % 1000;
+		const uint32_t lifetime = (rnd >> 10) % 100;
+		stress_malloc_obj_t obj, *slot;
+		size_t lo = 0, hi = malloc_classes[0].size;
+		uint32_t sum = 0;
+
+#if defined(HAVE_LIB_PTHREAD)
+		if (!keep_thread_running_flag)
+			break;
+#endif
+		if (!stress_malloc_keep_stressing(args, counters))
+			break;
+
+		for (i = 0; i < SIZEOF_ARRAY(malloc_classes); i++) {
+			sum += malloc_classes[i].weight;
+			hi = malloc_classes[i].size;
+			if (weight < sum)
+				break;
+			lo = hi;
+		}
+		if (hi > malloc_bytes)
+			hi = malloc_bytes;
+		if (lo >= hi)
+			lo = 0;
+		obj.size = lo + 1 + (stress_mwc32() % (hi - lo));
+		obj.ptr = ((rnd >> 17) & 0x1f) ?
+			malloc_func(obj.size) : calloc_func(1, obj.size);
+		if (!obj.ptr)
+			continue;
+		stress_malloc_page_touch(obj.ptr, obj.size, page_size);
+		trace->live[malloc_args->instance] += (int64_t)obj.size;
+
+		if (lifetime < 80) {
+			slot = &short_ring[short_idx];
+			short_idx = (short_idx + 1) % MALLOC_TRACE_SHORT;
+		} else if (lifetime < 95) {
+			slot = &medium_ring[medium_idx];
+			medium_idx = (medium_idx + 1) % MALLOC_TRACE_MEDIUM;
+		} else {
+			slot = &long_lived[stress_mwc32() % malloc_max];
+		}
+		stress_malloc_trace_free(malloc_args, slot, true);
+		*slot = obj;
+
+		/* Objects grow now and then, such as string and vector buffers */
+		if (((rnd >> 22) & 0x1f) == 0) {
+			slot = &medium_ring[stress_mwc16() % MALLOC_TRACE_MEDIUM];
+			if (slot->ptr) {
+				const size_t len = slot->size * 2;
+				void *tmp = realloc_func(slot->ptr, len);
+
+				if (tmp) {
+					trace->live[malloc_args->instance] += (int64_t)(len - slot->size);
+					slot->ptr = tmp;
+					slot->size = len;
+				}
+			}
+		}
+		(*counter)++;
+		ops++;
+
+		if ((ops & 63) == 0)
+			stress_malloc_trace_drain(malloc_args);
+		if ((malloc_args->instance == 0) && ((ops % MALLOC_TRACE_SAMPLE) == 0)) {
+			int64_t live = 0;
+
+			for (i = 0; i < malloc_pthreads + 1; i++)
+				live += trace->live[i];
+			trace->rss = stress_malloc_rss(page_size);
+			trace->live_sampled = live;
+		}
+	}
+
+	for (i = 0; i < MALLOC_TRACE_SHORT + MALLOC_TRACE_MEDIUM + malloc_max; i++)
+		stress_malloc_trace_free(malloc_args, &pool[i], false);
+	stress_malloc_trace_drain(malloc_args);
+	free(pool);
+
+	return &nowt;
+}
+
+/*
+ *  stress_malloc_trace_report()
+ *	report the allocation rate, RSS and fragmentation of the trace,
+ *	fragmentation is the share of resident memory gained during the
+ *	trace that is not holding requested bytes
+ */
+static void stress_malloc_trace_report(
+	const stress_args_t *args,
+	const stress_malloc_trace_t *trace,
+	const uint64_t ops,
+	const double duration)
+{
+	const char *allocator = "libc";
+	const double rss = (trace->rss > trace->rss_base) ?
+		(double)(trace->rss - trace->rss_base) : 0.0;
+	const double live = (trace->live_sampled > 0) ?
+		(double)trace->live_sampled : 0.0;
+	const double frag = ((rss > 0.0) && (live < rss)) ?
+		100.0 * (1.0 - (live / rss)) : 0.0;
+	const double rate = (duration > 0.0) ? (double)ops / duration : 0.0;
+
+	if (!trace->rss)
+		return;
+	(void)stress_get_setting("malloc-allocator", &allocator);
+	pr_inf("%s: %s allocator: %.0f ops/sec, RSS %.2f MB, live %.2f MB, "
+		"fragmentation %.1f%%\n", args->name, allocator, rate,
+		(double)trace->rss / (double)MB, live / (double)MB, frag);
+	stress_misc_stats_set(args->misc_stats, 0, "RSS MB", (double)trace->rss / (double)MB);
+	stress_misc_stats_set(args->misc_stats, 1, "fragmentation %", frag);
+}
+
 static int stress_malloc_child(const stress_args_t *args, void *context)
 {
 #if defined(HAVE_LIB_PTHREAD)
 	stress_pthread_info_t pthreads[MAX_MALLOC_PTHREADS];
-	size_t j;
 #endif
+	size_t j;
 	/*
 	 *  pthread instance 0 is actually the main child process,
 	 *  insances 1..N are pthreads 0..N-1
 	 */
 	uint64_t counters[MAX_MALLOC_PTHREADS + 1];
 	stress_malloc_args_t malloc_args[MAX_MALLOC_PTHREADS + 1];
+	stress_malloc_trace_t *trace = NULL;
+	void *(*loop)(void *ptr) = stress_malloc_loop;
+	double t_start;
 
 	(void)memset(counters, 0, sizeof(counters));
 	(void)memset(malloc_args, 0, sizeof(malloc_args));
 
+	(void)context;
+
+	if (malloc_trace) {
+		trace = (stress_malloc_trace_t *)calloc(1, sizeof(*trace));
+		if (!trace) {
+			pr_inf("%s: cannot allocate trace state, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+#if defined(HAVE_LIB_PTHREAD)
+		for (j = 0; j < MAX_MALLOC_PTHREADS + 1; j++)
+			(void)pthread_mutex_init(&trace->mailboxes[j].lock, NULL);
+#endif
+		trace->rss_base = stress_malloc_rss(args->page_size);
+		loop = stress_malloc_trace_loop;
+	}
+
 	malloc_args[0].args = args;
 	malloc_args[0].counters = counters;
 	malloc_args[0].instance = 0;
-
-	(void)context;
+	malloc_args[0].trace = trace;
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	t_start = stress_time_now();
 
 #if defined(HAVE_LIB_PTHREAD)
 	keep_thread_running_flag = true;
@@ -286,15 +611,16 @@ static int stress_malloc_child(const stress_args_t *args, void *context)
 		malloc_args[j + 1].args = args;
 		malloc_args[j + 1].counters = counters;
 		malloc_args[j + 1].instance = j + 1;
+		malloc_args[j + 1].trace = trace;
 		pthreads[j].ret = pthread_create(&pthreads[j].pthread, NULL,
-			stress_malloc_loop, (void *)&malloc_args);
+			loop, (void *)&malloc_args[j + 1]);
 	}
 #else
 	if ((args->instance == 0) && (malloc_pthreads > 0))
 		pr_inf("%s: pthreads not supported, ignoring the "
 			"--malloc-pthreads option\n", args->name);
 #endif
-	stress_malloc_loop(&malloc_args);
+	loop(&malloc_args[0]);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 #if defined(HAVE_LIB_PTHREAD)
@@ -315,9 +641,79 @@ static int stress_malloc_child(const stress_args_t *args, void *context)
 
 	set_counter(args, stress_malloc_racy_count(counters));
 
+	if (trace) {
+		/* Objects handed to threads that had already exited */
+		for (j = 0; j < malloc_pthreads + 1; j++) {
+			malloc_args[j].trace = trace;
+			malloc_args[j].instance = j;
+			stress_malloc_trace_drain(&malloc_args[j]);
+		}
+		stress_malloc_trace_report(args, trace,
+			stress_malloc_racy_count(counters),
+			stress_time_now() - t_start);
+#if defined(HAVE_LIB_PTHREAD)
+		for (j = 0; j < MAX_MALLOC_PTHREADS + 1; j++)
+			(void)pthread_mutex_destroy(&trace->mailboxes[j].lock);
+#endif
+		free(trace);
+	}
+
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_malloc_allocator()
+ *	use the malloc family of functions of the --malloc-allocator
+ *	library, such as jemalloc, tcmalloc or mimalloc, rather than
+ *	the libc ones, returns -1 if the library cannot be used
+ */
+static int stress_malloc_allocator(const stress_args_t *args)
+{
+	const char *allocator = NULL;
+#if defined(HAVE_LIB_DL) &&	\
+    !defined(BUILD_STATIC)
+	void *handle;
+	void *funcs[4];
+	static const char * const names[] = {
+		"malloc", "calloc", "realloc", "free"
+	};
+	size_t i;
+#endif
+
+	if (!stress_get_setting("malloc-allocator", &allocator))
+		return 0;
+#if defined(HAVE_LIB_DL) &&	\
+    !defined(BUILD_STATIC)
+	handle = dlopen(allocator, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		pr_inf_skip("%s: cannot load allocator %s: %s, skipping stressor\n",
+			args->name, allocator, dlerror());
+		return -1;
+	}
+	for (i = 0; i < SIZEOF_ARRAY(names); i++) {
+		funcs[i] = dlsym(handle, names[i]);
+		if (!funcs[i]) {
+			pr_inf_skip("%s: allocator %s has no %s function, "
+				"skipping stressor\n", args->name, allocator, names[i]);
+			(void)dlclose(handle);
+			return -1;
+		}
+	}
+	/* The library stays loaded for the life of the stressor */
+	malloc_func = (void *(*)(size_t))funcs[0];
+	calloc_func = (void *(*)(size_t, size_t))funcs[1];
+	realloc_func = (void *(*)(void *, size_t))funcs[2];
+	free_func = (void (*)(void *))funcs[3];
+	if (args->instance == 0)
+		pr_dbg("%s: using the malloc functions of %s\n", args->name, allocator);
+	return 0;
+#else
+	pr_inf_skip("%s: dynamic loading not supported, cannot use allocator %s, "
+		"skipping stressor\n", args->name, allocator);
+	return -1;
+#endif
+}
+
 /*
  *  stress_malloc()
  *	stress malloc by performing a mix of
@@ -356,6 +752,11 @@ static int stress_malloc(const stress_args_t *args)
 
 	malloc_touch = false;
 	(void)stress_get_setting("malloc-touch", &malloc_touch);
+	malloc_trace = false;
+	(void)stress_get_setting("malloc-trace", &malloc_trace);
+
+	if (stress_malloc_allocator(args) < 0)
+		return EXIT_NO_RESOURCE;
 
 	return stress_oomable_child(args, NULL, stress_malloc_child, STRESS_OOMABLE_NORMAL);
 }
@@ -366,6 +767,8 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_malloc_pthreads,	stress_set_malloc_pthreads },
 	{ OPT_malloc_threshold,	stress_set_malloc_threshold },
 	{ OPT_malloc_touch,	stress_set_malloc_touch },
+	{ OPT_malloc_trace,	stress_set_malloc_trace },
+	{ OPT_malloc_allocator,	stress_set_malloc_allocator },
 	{ 0,		NULL }
 };
 
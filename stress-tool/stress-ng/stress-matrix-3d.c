@@ -50,6 +50,7 @@ typedef void (*stress_matrix_3d_func)(
 typedef struct {
 	const char			*name;		/* human readable form of stressor */
 	const stress_matrix_3d_func	func[2];	/* method functions, x by y by z, z by y by x */
+	const int			flops_mult;	/* flops per call are flops_mult * n^3 */
 } stress_matrix_3d_method_info_t;
 
 static const stress_matrix_3d_method_info_t matrix_3d_methods[];
@@ -771,60 +772,25 @@ static void OPTIMIZE3 TARGET_CLONES stress_matrix_3d_zyx_identity(
 	}
 }
 
-/*
- *  stress_matrix_3d_all()
- *	iterate over all cpu stressors
- */
-static void OPTIMIZE3 stress_matrix_3d_xyz_all(
-	const size_t n,
-	stress_matrix_3d_type_t a[RESTRICT n][n][n],
-	stress_matrix_3d_type_t b[RESTRICT n][n][n],
-	stress_matrix_3d_type_t r[RESTRICT n][n][n])
-{
-	static int i = 1;	/* Skip over stress_matrix_3d_all */
-
-	matrix_3d_methods[i++].func[0](n, a, b, r);
-	if (!matrix_3d_methods[i].name)
-		i = 1;
-}
-
-/*
- *  stress_matrix_3d_all()
- *	iterate over all cpu stressors
- */
-static void OPTIMIZE3 stress_matrix_3d_zyx_all(
-	const size_t n,
-	stress_matrix_3d_type_t a[RESTRICT n][n][n],
-	stress_matrix_3d_type_t b[RESTRICT n][n][n],
-	stress_matrix_3d_type_t r[RESTRICT n][n][n])
-{
-	static int i = 1;	/* Skip over stress_matrix_3d_all */
-
-	matrix_3d_methods[i++].func[1](n, a, b, r);
-	if (!matrix_3d_methods[i].name)
-		i = 1;
-}
-
-
 /*
  * Table of cpu stress methods, ordered x by y by z and z by y by x
  */
 static const stress_matrix_3d_method_info_t matrix_3d_methods[] = {
-	{ "all",		{ stress_matrix_3d_xyz_all,	stress_matrix_3d_zyx_all } },/* Special "all" test */
-
-	{ "add",		{ stress_matrix_3d_xyz_add,	stress_matrix_3d_zyx_add } },
-	{ "copy",		{ stress_matrix_3d_xyz_copy,	stress_matrix_3d_zyx_copy } },
-	{ "div",		{ stress_matrix_3d_xyz_div,	stress_matrix_3d_zyx_div } },
-	{ "frobenius",		{ stress_matrix_3d_xyz_frobenius,stress_matrix_3d_zyx_frobenius } },
-	{ "hadamard",		{ stress_matrix_3d_xyz_hadamard,	stress_matrix_3d_zyx_hadamard } },
-	{ "identity",		{ stress_matrix_3d_xyz_identity,	stress_matrix_3d_zyx_identity } },
-	{ "mean",		{ stress_matrix_3d_xyz_mean,	stress_matrix_3d_zyx_mean } },
-	{ "mult",		{ stress_matrix_3d_xyz_mult,	stress_matrix_3d_zyx_mult } },
-	{ "negate",		{ stress_matrix_3d_xyz_negate,	stress_matrix_3d_zyx_negate } },
-	{ "sub",		{ stress_matrix_3d_xyz_sub,	stress_matrix_3d_zyx_sub } },
-	{ "trans",		{ stress_matrix_3d_xyz_trans,	stress_matrix_3d_zyx_trans } },
-	{ "zero",		{ stress_matrix_3d_xyz_zero,	stress_matrix_3d_zyx_zero } },
-	{ NULL,			{ NULL, NULL } }
+	{ "all",		{ NULL,				NULL },				0 },/* Special "all" test */
+
+	{ "add",		{ stress_matrix_3d_xyz_add,	stress_matrix_3d_zyx_add },	1 },
+	{ "copy",		{ stress_matrix_3d_xyz_copy,	stress_matrix_3d_zyx_copy },	0 },
+	{ "div",		{ stress_matrix_3d_xyz_div,	stress_matrix_3d_zyx_div },	1 },
+	{ "frobenius",		{ stress_matrix_3d_xyz_frobenius,stress_matrix_3d_zyx_frobenius },	2 },
+	{ "hadamard",		{ stress_matrix_3d_xyz_hadamard,	stress_matrix_3d_zyx_hadamard },	1 },
+	{ "identity",		{ stress_matrix_3d_xyz_identity,	stress_matrix_3d_zyx_identity },	0 },
+	{ "mean",		{ stress_matrix_3d_xyz_mean,	stress_matrix_3d_zyx_mean },	2 },
+	{ "mult",		{ stress_matrix_3d_xyz_mult,	stress_matrix_3d_zyx_mult },	1 },
+	{ "negate",		{ stress_matrix_3d_xyz_negate,	stress_matrix_3d_zyx_negate },	1 },
+	{ "sub",		{ stress_matrix_3d_xyz_sub,	stress_matrix_3d_zyx_sub },	1 },
+	{ "trans",		{ stress_matrix_3d_xyz_trans,	stress_matrix_3d_zyx_trans },	0 },
+	{ "zero",		{ stress_matrix_3d_xyz_zero,	stress_matrix_3d_zyx_zero },	0 },
+	{ NULL,			{ NULL, NULL },			0 }
 };
 
 static const stress_matrix_3d_method_info_t *stress_get_matrix_3d_method(
@@ -889,8 +855,9 @@ static inline stress_matrix_3d_type_t stress_matrix_data(const stress_matrix_3d_
 
 static inline int stress_matrix_3d_exercise(
 	const stress_args_t *args,
-	const stress_matrix_3d_func func,
-	const size_t n)
+	const stress_matrix_3d_method_info_t *info,
+	const size_t n,
+	const size_t zyx)
 {
 	int ret = EXIT_NO_RESOURCE;
 	typedef stress_matrix_3d_type_t (*matrix_3d_ptr_t)[n][n];
@@ -899,6 +866,10 @@ static inline int stress_matrix_3d_exercise(
 	matrix_3d_ptr_t a, b = NULL, r = NULL;
 	register size_t i;
 	const stress_matrix_3d_type_t v = 65535 / (stress_matrix_3d_type_t)((uint64_t)~0);
+	const bool all = (info == &matrix_3d_methods[0]);
+	const stress_matrix_3d_method_info_t *method = all ? &matrix_3d_methods[1] : info;
+	const double n3 = (double)n * (double)n * (double)n;
+	double t_start, duration, flops = 0.0;
 	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 #if defined(MAP_POPULATE)
 	flags |= MAP_POPULATE;
@@ -943,10 +914,29 @@ static inline int stress_matrix_3d_exercise(
 	/*
 	 * Normal use case, 100% load, simple spinning on CPU
 	 */
+	t_start = stress_time_now();
 	do {
-		(void)func(n, a, b, r);
+		(void)method->func[zyx](n, a, b, r);
+		/* Methods bail out early when the run ends, don't count those */
+		if (LIKELY(keep_stressing_flag()))
+			flops += n3 * (double)method->flops_mult;
 		inc_counter(args);
+		if (all) {
+			method++;
+			if (!method->name)
+				method = &matrix_3d_methods[1];
+		}
 	} while (keep_stressing(args));
+	duration = stress_time_now() - t_start;
+
+	if (duration > 0.0) {
+		const double gflops = flops / (duration * 1000000000.0);
+
+		stress_misc_stats_set(args->misc_stats, 0, "GFLOPS", gflops);
+		if (args->instance == 0)
+			pr_inf("%s: %.3f GFLOPS using method '%s' (instance 0)\n",
+				args->name, gflops, info->name);
+	}
 
 	ret = EXIT_SUCCESS;
 
@@ -967,7 +957,6 @@ static int stress_matrix(const stress_args_t *args)
 {
 	char *matrix_3d_method_name = NULL;
 	const stress_matrix_3d_method_info_t *matrix_3d_method;
-	stress_matrix_3d_func func;
 	size_t matrix_3d_size = 128;
 	size_t matrix_3d_yx = 0;
 	int rc;
@@ -982,7 +971,6 @@ static int stress_matrix(const stress_args_t *args)
 		return EXIT_FAILURE;
 	}
 
-	func = matrix_3d_method->func[matrix_3d_yx];
 	if (args->instance == 0)
 		pr_dbg("%s using method '%s' (%s)\n", args->name, matrix_3d_method->name,
 			matrix_3d_yx ? "z by y by x" : "x by y by z");
@@ -996,7 +984,7 @@ static int stress_matrix(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	rc = stress_matrix_3d_exercise(args, func, matrix_3d_size);
+	rc = stress_matrix_3d_exercise(args, matrix_3d_method, matrix_3d_size, matrix_3d_yx);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
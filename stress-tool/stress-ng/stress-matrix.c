@@ -24,11 +24,14 @@
  */
 #include "stress-ng.h"
 
+#define MAX_MATRIX_THREADS	(64)
+
 static const stress_help_t help[] = {
 	{ NULL,	"matrix N",		"start N workers exercising matrix operations" },
 	{ NULL,	"matrix-ops N",		"stop after N maxtrix bogo operations" },
 	{ NULL,	"matrix-method M",	"specify matrix stress method M, default is all" },
 	{ NULL,	"matrix-size N",	"specify the size of the N x N matrix" },
+	{ NULL,	"matrix-threads N",	"number of extra pthreads sharing the source matrices" },
 	{ NULL,	"matrix-yx",		"matrix operation is y by x instead of x by y" },
 	{ NULL,	NULL,			NULL }
 };
@@ -49,6 +52,8 @@ typedef void (*stress_matrix_func)(
 typedef struct {
 	const char			*name;		/* human readable form of stressor */
 	const stress_matrix_func	func[2];	/* method functions, x by y, y by x */
+	const int			flops_order;	/* flops per call are flops_mult * n^flops_order */
+	const int			flops_mult;
 } stress_matrix_method_info_t;
 
 static const stress_matrix_method_info_t matrix_methods[];
@@ -63,6 +68,16 @@ static int stress_set_matrix_size(const char *opt)
 	return stress_set_setting("matrix-size", TYPE_ID_SIZE_T, &matrix_size);
 }
 
+static int stress_set_matrix_threads(const char *opt)
+{
+	size_t matrix_threads;
+
+	matrix_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("matrix-threads", matrix_threads,
+		0, MAX_MATRIX_THREADS);
+	return stress_set_setting("matrix-threads", TYPE_ID_SIZE_T, &matrix_threads);
+}
+
 static int stress_set_matrix_yx(const char *opt)
 {
 	size_t matrix_yx = 1;
@@ -788,61 +803,255 @@ static void OPTIMIZE3 TARGET_CLONES stress_matrix_yx_square(
 
 
 /*
- *  stress_matrix_all()
- *	iterate over all cpu stressors
+ *  Cache blocked matrix product, the matrices are worked on in
+ *  MATRIX_BLOCK x MATRIX_BLOCK tiles that fit in the L1 cache so
+ *  each element loaded is reused MATRIX_BLOCK times, and the
+ *  innermost loop runs along rows so it vectorizes
  */
-static void OPTIMIZE3 stress_matrix_xy_all(
+#define MATRIX_BLOCK	(32)
+
+/*
+ *  stress_matrix_prod_tile()
+ *	r += a x b for one tile of r and one tile of the k dimension
+ */
+static inline void OPTIMIZE3 stress_matrix_prod_tile(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n],
+	const size_t i0,
+	const size_t j0,
+	const size_t k0)
+{
+	const size_t i_end = STRESS_MINIMUM(i0 + MATRIX_BLOCK, n);
+	const size_t j_end = STRESS_MINIMUM(j0 + MATRIX_BLOCK, n);
+	const size_t k_end = STRESS_MINIMUM(k0 + MATRIX_BLOCK, n);
+	register size_t i;
+
+	for (i = i0; i < i_end; i++) {
+		register size_t k;
+
+		for (k = k0; k < k_end; k++) {
+			const stress_matrix_type_t aik = a[i][k];
+			register size_t j;
+
+			for (j = j0; j < j_end; j++)
+				r[i][j] += aik * b[k][j];
+		}
+	}
+}
+
+/*
+ *  stress_matrix_xy_prod_blocked()
+ *	cache blocked matrix product
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_xy_prod_blocked(
 	const size_t n,
 	stress_matrix_type_t a[RESTRICT n][n],
 	stress_matrix_type_t b[RESTRICT n][n],
 	stress_matrix_type_t r[RESTRICT n][n])
 {
-	static int i = 1;	/* Skip over stress_matrix_all */
+	size_t i0;
+
+	for (i0 = 0; i0 < n; i0 += MATRIX_BLOCK) {
+		size_t k0;
+
+		for (k0 = 0; k0 < n; k0 += MATRIX_BLOCK) {
+			size_t j0;
 
-	matrix_methods[i++].func[0](n, a, b, r);
-	if (!matrix_methods[i].name)
-		i = 1;
+			for (j0 = 0; j0 < n; j0 += MATRIX_BLOCK)
+				stress_matrix_prod_tile(n, a, b, r, i0, j0, k0);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
 }
 
 /*
- *  stress_matrix_all()
- *	iterate over all cpu stressors
+ *  stress_matrix_yx_prod_blocked()
+ *	cache blocked matrix product, column tiles outermost
  */
-static void OPTIMIZE3 stress_matrix_yx_all(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_yx_prod_blocked(
 	const size_t n,
 	stress_matrix_type_t a[RESTRICT n][n],
 	stress_matrix_type_t b[RESTRICT n][n],
 	stress_matrix_type_t r[RESTRICT n][n])
 {
-	static int i = 1;	/* Skip over stress_matrix_all */
+	size_t j0;
+
+	for (j0 = 0; j0 < n; j0 += MATRIX_BLOCK) {
+		size_t k0;
 
-	matrix_methods[i++].func[1](n, a, b, r);
-	if (!matrix_methods[i].name)
-		i = 1;
+		for (k0 = 0; k0 < n; k0 += MATRIX_BLOCK) {
+			size_t i0;
+
+			for (i0 = 0; i0 < n; i0 += MATRIX_BLOCK)
+				stress_matrix_prod_tile(n, a, b, r, i0, j0, k0);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
 }
 
+#if defined(HAVE_VECMATH)
+/*
+ *  Explicitly vectorized blocked matrix product, each TARGET_CLONES
+ *  ISA build uses its widest vector unit for the 8 float vectors
+ *  and 4 rows of r are updated per load of b to keep the FP units
+ *  busy rather than waiting on loads
+ */
+typedef float stress_matrix_vfloat_t __attribute__ ((vector_size (32)));
+
+#define MATRIX_VFLOATS	(sizeof(stress_matrix_vfloat_t) / sizeof(float))
+
+/*
+ *  stress_matrix_prod_vec_tile()
+ *	r += a x b for one tile using vectors along the rows
+ */
+static inline void OPTIMIZE3 stress_matrix_prod_vec_tile(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n],
+	const size_t i0,
+	const size_t j0,
+	const size_t k0)
+{
+	const size_t i_end = STRESS_MINIMUM(i0 + MATRIX_BLOCK, n);
+	const size_t j_end = STRESS_MINIMUM(j0 + MATRIX_BLOCK, n);
+	const size_t k_end = STRESS_MINIMUM(k0 + MATRIX_BLOCK, n);
+	const size_t j_vend = j0 + (((j_end - j0) / MATRIX_VFLOATS) * MATRIX_VFLOATS);
+	size_t i;
+
+	for (i = i0; i + 4 <= i_end; i += 4) {
+		register size_t j;
+
+		for (j = j0; j < j_vend; j += MATRIX_VFLOATS) {
+			stress_matrix_vfloat_t r0, r1, r2, r3;
+			register size_t k;
+
+			(void)memcpy(&r0, &r[i + 0][j], sizeof(r0));
+			(void)memcpy(&r1, &r[i + 1][j], sizeof(r1));
+			(void)memcpy(&r2, &r[i + 2][j], sizeof(r2));
+			(void)memcpy(&r3, &r[i + 3][j], sizeof(r3));
+			for (k = k0; k < k_end; k++) {
+				stress_matrix_vfloat_t bk;
+
+				(void)memcpy(&bk, &b[k][j], sizeof(bk));
+				r0 += a[i + 0][k] * bk;
+				r1 += a[i + 1][k] * bk;
+				r2 += a[i + 2][k] * bk;
+				r3 += a[i + 3][k] * bk;
+			}
+			(void)memcpy(&r[i + 0][j], &r0, sizeof(r0));
+			(void)memcpy(&r[i + 1][j], &r1, sizeof(r1));
+			(void)memcpy(&r[i + 2][j], &r2, sizeof(r2));
+			(void)memcpy(&r[i + 3][j], &r3, sizeof(r3));
+		}
+		/* Columns left over from the vectors */
+		for (; j < j_end; j++) {
+			register size_t k;
+
+			for (k = k0; k < k_end; k++) {
+				r[i + 0][j] += a[i + 0][k] * b[k][j];
+				r[i + 1][j] += a[i + 1][k] * b[k][j];
+				r[i + 2][j] += a[i + 2][k] * b[k][j];
+				r[i + 3][j] += a[i + 3][k] * b[k][j];
+			}
+		}
+	}
+	/* Rows left over from the groups of 4 */
+	for (; i < i_end; i++) {
+		register size_t k;
+
+		for (k = k0; k < k_end; k++) {
+			const stress_matrix_type_t aik = a[i][k];
+			register size_t j;
+
+			for (j = j0; j < j_end; j++)
+				r[i][j] += aik * b[k][j];
+		}
+	}
+}
+
+/*
+ *  stress_matrix_xy_prod_vec()
+ *	vectorized cache blocked matrix product
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_xy_prod_vec(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n])
+{
+	size_t i0;
+
+	for (i0 = 0; i0 < n; i0 += MATRIX_BLOCK) {
+		size_t k0;
+
+		for (k0 = 0; k0 < n; k0 += MATRIX_BLOCK) {
+			size_t j0;
+
+			for (j0 = 0; j0 < n; j0 += MATRIX_BLOCK)
+				stress_matrix_prod_vec_tile(n, a, b, r, i0, j0, k0);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
+}
+
+/*
+ *  stress_matrix_yx_prod_vec()
+ *	vectorized cache blocked matrix product, column tiles outermost
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_yx_prod_vec(
+	const size_t n,
+	stress_matrix_type_t a[RESTRICT n][n],
+	stress_matrix_type_t b[RESTRICT n][n],
+	stress_matrix_type_t r[RESTRICT n][n])
+{
+	size_t j0;
+
+	for (j0 = 0; j0 < n; j0 += MATRIX_BLOCK) {
+		size_t k0;
+
+		for (k0 = 0; k0 < n; k0 += MATRIX_BLOCK) {
+			size_t i0;
+
+			for (i0 = 0; i0 < n; i0 += MATRIX_BLOCK)
+				stress_matrix_prod_vec_tile(n, a, b, r, i0, j0, k0);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			return;
+	}
+}
+#endif
 
 /*
  * Table of cpu stress methods, ordered x by y and y by x
  */
 static const stress_matrix_method_info_t matrix_methods[] = {
-	{ "all",		{ stress_matrix_xy_all,		stress_matrix_yx_all } },/* Special "all" test */
-
-	{ "add",		{ stress_matrix_xy_add,		stress_matrix_yx_add } },
-	{ "copy",		{ stress_matrix_xy_copy,	stress_matrix_yx_copy } },
-	{ "div",		{ stress_matrix_xy_div,		stress_matrix_yx_div } },
-	{ "frobenius",		{ stress_matrix_xy_frobenius,	stress_matrix_yx_frobenius } },
-	{ "hadamard",		{ stress_matrix_xy_hadamard,	stress_matrix_yx_hadamard } },
-	{ "identity",		{ stress_matrix_xy_identity,	stress_matrix_yx_identity } },
-	{ "mean",		{ stress_matrix_xy_mean,	stress_matrix_yx_mean } },
-	{ "mult",		{ stress_matrix_xy_mult,	stress_matrix_yx_mult } },
-	{ "negate",		{ stress_matrix_xy_negate,	stress_matrix_yx_negate } },
-	{ "prod",		{ stress_matrix_xy_prod,	stress_matrix_yx_prod } },
-	{ "sub",		{ stress_matrix_xy_sub,		stress_matrix_yx_sub } },
-	{ "square",		{ stress_matrix_xy_square,	stress_matrix_yx_square } },
-	{ "trans",		{ stress_matrix_xy_trans,	stress_matrix_yx_trans } },
-	{ "zero",		{ stress_matrix_xy_zero,	stress_matrix_yx_zero } },
-	{ NULL,			{ NULL, NULL } }
+	{ "all",		{ NULL,				NULL },				0, 0 },/* Special "all" test */
+
+	{ "add",		{ stress_matrix_xy_add,		stress_matrix_yx_add },		2, 1 },
+	{ "copy",		{ stress_matrix_xy_copy,	stress_matrix_yx_copy },	2, 0 },
+	{ "div",		{ stress_matrix_xy_div,		stress_matrix_yx_div },		2, 1 },
+	{ "frobenius",		{ stress_matrix_xy_frobenius,	stress_matrix_yx_frobenius },	2, 2 },
+	{ "hadamard",		{ stress_matrix_xy_hadamard,	stress_matrix_yx_hadamard },	2, 1 },
+	{ "identity",		{ stress_matrix_xy_identity,	stress_matrix_yx_identity },	2, 0 },
+	{ "mean",		{ stress_matrix_xy_mean,	stress_matrix_yx_mean },	2, 2 },
+	{ "mult",		{ stress_matrix_xy_mult,	stress_matrix_yx_mult },	2, 1 },
+	{ "negate",		{ stress_matrix_xy_negate,	stress_matrix_yx_negate },	2, 1 },
+	{ "prod",		{ stress_matrix_xy_prod,	stress_matrix_yx_prod },	3, 2 },
+	{ "prod-blocked",	{ stress_matrix_xy_prod_blocked, stress_matrix_yx_prod_blocked }, 3, 2 },
+#if defined(HAVE_VECMATH)
+	{ "prod-vec",		{ stress_matrix_xy_prod_vec,	stress_matrix_yx_prod_vec },	3, 2 },
+#endif
+	{ "sub",		{ stress_matrix_xy_sub,		stress_matrix_yx_sub },		2, 1 },
+	{ "square",		{ stress_matrix_xy_square,	stress_matrix_yx_square },	3, 2 },
+	{ "trans",		{ stress_matrix_xy_trans,	stress_matrix_yx_trans },	2, 0 },
+	{ "zero",		{ stress_matrix_xy_zero,	stress_matrix_yx_zero },	2, 0 },
+	{ NULL,			{ NULL, NULL },			0, 0 }
 };
 
 static const stress_matrix_method_info_t *stress_get_matrix_method(
@@ -905,19 +1114,134 @@ static inline stress_matrix_type_t stress_matrix_data(const stress_matrix_type_t
 	return v * (stress_matrix_type_t)r;
 }
 
+/*
+ *  per pthread state, instance 0 is the stressor process itself
+ *  and instances 1..N are the --matrix-threads pthreads, all
+ *  share the a and b source matrices, each has its own result
+ */
+typedef struct {
+	const stress_args_t *args;
+	const stress_matrix_method_info_t *info;
+	void *a;			/* shared source matrix a */
+	void *b;			/* shared source matrix b */
+	size_t n;			/* matrix is n x n */
+	size_t yx;			/* 0 x by y, 1 y by x */
+	uint64_t *counters;		/* racy bogo op counters */
+	double flops;			/* floating point ops done */
+	size_t instance;
+	int ret;
+} stress_matrix_thread_t;
+
+static size_t matrix_threads;		/* Number of extra pthreads */
+
+/*
+ *  stress_matrix_racy_count()
+ *	racy sum of the per pthread bogo op counters
+ */
+static uint64_t stress_matrix_racy_count(const uint64_t *counters)
+{
+	register uint64_t count = 0;
+	register size_t i;
+
+	for (i = 0; i < matrix_threads + 1; i++)
+		count += counters[i];
+
+	return count;
+}
+
+/*
+ *  stress_matrix_flops()
+ *	floating point operations in one call of a method
+ */
+static inline double stress_matrix_flops(
+	const stress_matrix_method_info_t *info,
+	const size_t n)
+{
+	double flops = (double)info->flops_mult;
+	int i;
+
+	for (i = 0; i < info->flops_order; i++)
+		flops *= (double)n;
+	return flops;
+}
+
+/*
+ *  stress_matrix_loop()
+ *	exercise a matrix method on a private result matrix until
+ *	the run time or bogo op count is reached
+ */
+static void *stress_matrix_loop(void *ptr)
+{
+	stress_matrix_thread_t *mt = (stress_matrix_thread_t *)ptr;
+	const stress_args_t *args = mt->args;
+	const size_t n = mt->n;
+	typedef stress_matrix_type_t (*matrix_ptr_t)[n];
+	const matrix_ptr_t a = (matrix_ptr_t)mt->a;
+	const matrix_ptr_t b = (matrix_ptr_t)mt->b;
+	const size_t matrix_size = round_up(args->page_size, (sizeof(stress_matrix_type_t) * n * n));
+	const bool all = (mt->info == &matrix_methods[0]);
+	const stress_matrix_method_info_t *info = all ? &matrix_methods[1] : mt->info;
+	uint64_t *counter = &mt->counters[mt->instance];
+	matrix_ptr_t r;
+	static void *nowt = NULL;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+	flags |= MAP_POPULATE;
+#endif
+
+	r = (matrix_ptr_t)mmap(NULL, matrix_size,
+		PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (r == MAP_FAILED) {
+		pr_fail("%s: matrix allocation failed, out of memory\n", args->name);
+		mt->ret = EXIT_NO_RESOURCE;
+		return &nowt;
+	}
+	(void)memset((void *)r, 0, matrix_size);
+
+	/*
+	 * Normal use case, 100% load, simple spinning on CPU
+	 */
+	while (LIKELY(keep_stressing_flag()) &&
+	       LIKELY(!args->max_ops ||
+		      (stress_matrix_racy_count(mt->counters) < args->max_ops))) {
+		(void)info->func[mt->yx](n, a, b, r);
+		/* Methods bail out early when the run ends, don't count those */
+		if (LIKELY(keep_stressing_flag()))
+			mt->flops += stress_matrix_flops(info, n);
+		(*counter)++;
+		if (all) {
+			info++;
+			if (!info->name)
+				info = &matrix_methods[1];
+		}
+	}
+	(void)munmap((void *)r, matrix_size);
+	mt->ret = EXIT_SUCCESS;
+
+	return &nowt;
+}
+
 static inline int stress_matrix_exercise(
 	const stress_args_t *args,
-	const stress_matrix_func func,
-	const size_t n)
+	const stress_matrix_method_info_t *info,
+	const size_t n,
+	const size_t yx)
 {
 	int ret = EXIT_NO_RESOURCE;
 	typedef stress_matrix_type_t (*matrix_ptr_t)[n];
 	size_t matrix_size = round_up(args->page_size, (sizeof(stress_matrix_type_t) * n * n));
 
-	matrix_ptr_t a, b = NULL, r = NULL;
+	matrix_ptr_t a, b = NULL;
 	register size_t i;
 	const stress_matrix_type_t v = 65535 / (stress_matrix_type_t)((uint64_t)~0);
 	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	uint64_t counters[MAX_MATRIX_THREADS + 1];
+	stress_matrix_thread_t mt[MAX_MATRIX_THREADS + 1];
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthreads[MAX_MATRIX_THREADS];
+	int pthread_ret[MAX_MATRIX_THREADS];
+#endif
+	double t_start, duration, flops = 0.0;
 #if defined(MAP_POPULATE)
 	flags |= MAP_POPULATE;
 #endif
@@ -934,12 +1258,6 @@ static inline int stress_matrix_exercise(
 		pr_fail("%s: matrix allocation failed, out of memory\n", args->name);
 		goto tidy_a;
 	}
-	r = (matrix_ptr_t)mmap(NULL, matrix_size,
-		PROT_READ | PROT_WRITE, flags, -1, 0);
-	if (r == MAP_FAILED) {
-		pr_fail("%s: matrix allocation failed, out of memory\n", args->name);
-		goto tidy_b;
-	}
 
 	/*
 	 *  Initialise matrices
@@ -950,22 +1268,63 @@ static inline int stress_matrix_exercise(
 		for (j = 0; j < n; j++) {
 			a[i][j] = stress_matrix_data(v);
 			b[i][j] = stress_matrix_data(v);
-			r[i][j] = 0.0;
 		}
 	}
 
-	/*
-	 * Normal use case, 100% load, simple spinning on CPU
-	 */
-	do {
-		(void)func(n, a, b, r);
-		inc_counter(args);
-	} while (keep_stressing(args));
+	(void)memset(counters, 0, sizeof(counters));
+	(void)memset(mt, 0, sizeof(mt));
+	for (i = 0; i < matrix_threads + 1; i++) {
+		mt[i].args = args;
+		mt[i].info = info;
+		mt[i].a = (void *)a;
+		mt[i].b = (void *)b;
+		mt[i].n = n;
+		mt[i].yx = yx;
+		mt[i].counters = counters;
+		mt[i].instance = i;
+	}
+
+	t_start = stress_time_now();
+#if defined(HAVE_LIB_PTHREAD)
+	for (i = 0; i < matrix_threads; i++)
+		pthread_ret[i] = pthread_create(&pthreads[i], NULL,
+			stress_matrix_loop, (void *)&mt[i + 1]);
+#else
+	if ((args->instance == 0) && (matrix_threads > 0))
+		pr_inf("%s: pthreads not supported, ignoring the "
+			"--matrix-threads option\n", args->name);
+#endif
+	(void)stress_matrix_loop((void *)&mt[0]);
+	ret = mt[0].ret;
+	flops = mt[0].flops;
+
+#if defined(HAVE_LIB_PTHREAD)
+	for (i = 0; i < matrix_threads; i++) {
+		int jret;
+
+		if (pthread_ret[i])
+			continue;
+		jret = pthread_join(pthreads[i], NULL);
+		if ((jret) && (jret != ESRCH)) {
+			pr_fail("%s: pthread_join failed, errno=%d (%s)\n",
+				args->name, jret, strerror(jret));
+		}
+		flops += mt[i + 1].flops;
+	}
+#endif
+	duration = stress_time_now() - t_start;
+	set_counter(args, stress_matrix_racy_count(counters));
 
-	ret = EXIT_SUCCESS;
+	if ((ret == EXIT_SUCCESS) && (duration > 0.0)) {
+		const double gflops = flops / (duration * 1000000000.0);
+
+		stress_misc_stats_set(args->misc_stats, 0, "GFLOPS", gflops);
+		if (args->instance == 0)
+			pr_inf("%s: %.3f GFLOPS using method '%s' with %zu thread%s "
+				"(instance 0)\n", args->name, gflops, info->name,
+				matrix_threads + 1, matrix_threads ? "s" : "");
+	}
 
-	(void)munmap((void *)r, matrix_size);
-tidy_b:
 	(void)munmap((void *)b, matrix_size);
 tidy_a:
 	(void)munmap((void *)a, matrix_size);
@@ -981,13 +1340,14 @@ static int stress_matrix(const stress_args_t *args)
 {
 	char *matrix_method_name = NULL;
 	const stress_matrix_method_info_t *matrix_method;
-	stress_matrix_func func;
 	size_t matrix_size = 128;
 	size_t matrix_yx = 0;
 	int rc;
 
 	(void)stress_get_setting("matrix-method", &matrix_method_name);
 	(void)stress_get_setting("matrix-yx", &matrix_yx);
+	matrix_threads = 0;
+	(void)stress_get_setting("matrix-threads", &matrix_threads);
 
 	matrix_method = stress_get_matrix_method(matrix_method_name);
 	if (!matrix_method) {
@@ -996,7 +1356,6 @@ static int stress_matrix(const stress_args_t *args)
 		return EXIT_FAILURE;
 	}
 
-	func = matrix_method->func[matrix_yx];
 	if (args->instance == 0)
 		pr_dbg("%s using method '%s' (%s)\n", args->name, matrix_method->name,
 			matrix_yx ? "y by x" : "x by y");
@@ -1010,7 +1369,7 @@ static int stress_matrix(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
-	rc = stress_matrix_exercise(args, func, matrix_size);
+	rc = stress_matrix_exercise(args, matrix_method, matrix_size, matrix_yx);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 
@@ -1025,6 +1384,7 @@ static void stress_matrix_set_default(void)
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_matrix_method,	stress_set_matrix_method },
 	{ OPT_matrix_size,	stress_set_matrix_size },
+	{ OPT_matrix_threads,	stress_set_matrix_threads },
 	{ OPT_matrix_yx,	stress_set_matrix_yx },
 	{ 0,			NULL },
 };
@@ -27,9 +27,38 @@
 static const stress_help_t help[] = {
 	{ NULL,	"membarrier N",		"start N workers performing membarrier system calls" },
 	{ NULL,	"membarrier-ops N",	"stop after N membarrier bogo operations" },
+	{ NULL,	"membarrier-bench",	"measure membarrier costs against fencing RCU readers" },
+	{ NULL,	"membarrier-threads N",	"maximum number of benchmark reader threads" },
 	{ NULL,	NULL,			NULL }
 };
 
+#define MIN_MEMBARRIER_BENCH_THREADS	(1)
+#define MAX_MEMBARRIER_BENCH_THREADS	(256)
+
+static int stress_set_membarrier_bench(const char *opt)
+{
+	bool membarrier_bench = true;
+
+	(void)opt;
+	return stress_set_setting("membarrier-bench", TYPE_ID_BOOL, &membarrier_bench);
+}
+
+static int stress_set_membarrier_threads(const char *opt)
+{
+	size_t membarrier_threads;
+
+	membarrier_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("membarrier-threads", membarrier_threads,
+		MIN_MEMBARRIER_BENCH_THREADS, MAX_MEMBARRIER_BENCH_THREADS);
+	return stress_set_setting("membarrier-threads", TYPE_ID_SIZE_T, &membarrier_threads);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_membarrier_bench,		stress_set_membarrier_bench },
+	{ OPT_membarrier_threads,	stress_set_membarrier_threads },
+	{ 0,				NULL }
+};
+
 #if defined(HAVE_LIB_PTHREAD) && \
     defined(HAVE_MEMBARRIER)
 
@@ -58,6 +87,640 @@ enum membarrier_cmd_flag {
 };
 #endif
 
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_THREAD_CPUTIME_ID)
+#define STRESS_MEMBARRIER_BENCH
+
+#define MEMBARRIER_BENCH_SLICE		(0.2)	/* seconds per measurement */
+#define MEMBARRIER_BENCH_BATCH		(256)	/* reads between stop checks */
+#define MEMBARRIER_BENCH_COLS		(16)	/* reader thread counts measured */
+#define MEMBARRIER_LAT_SUB		(4)	/* histogram buckets per power of 2 */
+#define MEMBARRIER_LAT_BUCKETS		(64 * MEMBARRIER_LAT_SUB)
+
+/*
+ *  Writer side membarrier commands with readers that only use compiler
+ *  barriers, then readers that pay for a full fence themselves with
+ *  an idle writer
+ */
+#define MEMBARRIER_BENCH_PRIVATE	(0)
+#define MEMBARRIER_BENCH_GLOBAL_EXP	(1)
+#define MEMBARRIER_BENCH_GLOBAL		(2)
+#define MEMBARRIER_BENCH_BARRIER	(3)
+#define MEMBARRIER_BENCH_MFENCE		(4)
+#define MEMBARRIER_BENCH_LOCK		(5)
+#define MEMBARRIER_BENCH_METHODS	(6)
+#define MEMBARRIER_BENCH_WRITERS	(3)	/* methods that call membarrier */
+
+static const char * const membarrier_bench_methods[MEMBARRIER_BENCH_METHODS] = {
+	"private expedited",
+	"global expedited",
+	"global",
+	"compiler barrier",
+	"mfence",
+	"lock add",
+};
+
+typedef struct {
+	volatile bool go;
+	volatile bool stop;
+	int method;
+	uint64_t gp_ctr __attribute__((aligned(64)));	/* grace period counter */
+	volatile uint64_t *data;			/* rcu protected data */
+} stress_membarrier_bench_t;
+
+/* per reader state */
+typedef struct {
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	stress_membarrier_bench_t *bench;
+	int cpu;			/* cpu pinned to, -1 if not pinned */
+	uint64_t reads;
+	double cpu_time;		/* thread cpu seconds while reading */
+	volatile uint64_t ctr;		/* urcu style reader nesting counter */
+} __attribute__((aligned(64))) stress_membarrier_reader_t;
+
+/* totals of a method and reader thread count */
+typedef struct {
+	uint64_t lat[MEMBARRIER_LAT_BUCKETS];	/* membarrier latency histogram */
+	uint64_t calls;
+	uint64_t max;			/* slowest membarrier call, ns */
+	uint64_t ipis;			/* function call interrupts during calls */
+	uint64_t reads;
+	double cpu_time;		/* reader cpu seconds */
+	size_t cpus;			/* distinct cpus the readers ran on */
+	bool unsupported;
+} stress_membarrier_result_t;
+
+static const int membarrier_bench_cmds[MEMBARRIER_BENCH_WRITERS] = {
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED,
+	MEMBARRIER_CMD_GLOBAL_EXPEDITED,
+	MEMBARRIER_CMD_GLOBAL,
+};
+
+/*
+ *  stress_membarrier_now_ns()
+ *	monotonic time in nanoseconds
+ */
+static inline uint64_t stress_membarrier_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_membarrier_thread_cpu()
+ *	cpu time of the calling thread in seconds
+ */
+static inline double stress_membarrier_thread_cpu(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / (double)STRESS_NANOSECOND);
+}
+
+/*
+ *  stress_membarrier_lat_add()
+ *	add a latency in nanoseconds to a log2 histogram with
+ *	MEMBARRIER_LAT_SUB buckets per power of 2
+ */
+static void stress_membarrier_lat_add(stress_membarrier_result_t *result, const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0, bucket;
+
+	if (ns < MEMBARRIER_LAT_SUB) {
+		bucket = (size_t)ns;
+	} else {
+		for (v = ns; v > 1; v >>= 1)
+			msb++;
+		bucket = ((msb - 1) * MEMBARRIER_LAT_SUB) +
+			(size_t)((ns >> (msb - 2)) & (MEMBARRIER_LAT_SUB - 1));
+	}
+	result->lat[bucket]++;
+	result->calls++;
+	if (ns > result->max)
+		result->max = ns;
+}
+
+/*
+ *  stress_membarrier_percentile()
+ *	membarrier latency in nanoseconds below which pct percent of the
+ *	calls are, the upper bound of the histogram bucket clamped to
+ *	the maximum
+ */
+static double stress_membarrier_percentile(const stress_membarrier_result_t *result, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)result->calls * pct) / 100.0);
+	uint64_t sum = 0, ns;
+	size_t i;
+
+	for (i = 0; i < MEMBARRIER_LAT_BUCKETS; i++) {
+		sum += result->lat[i];
+		if (sum > target)
+			break;
+	}
+	if (i >= MEMBARRIER_LAT_BUCKETS)
+		return 0.0;
+	if (i < MEMBARRIER_LAT_SUB) {
+		ns = (uint64_t)i;
+	} else {
+		const size_t msb = (i / MEMBARRIER_LAT_SUB) + 1;
+		const uint64_t sub = (uint64_t)(i % MEMBARRIER_LAT_SUB);
+
+		ns = ((MEMBARRIER_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+	}
+	return (double)STRESS_MINIMUM(ns, result->max);
+}
+
+/*
+ *  stress_membarrier_ipis()
+ *	total function call interrupts of all cpus, the IPIs membarrier
+ *	expedited commands send, false if /proc/interrupts has no such line
+ */
+static bool stress_membarrier_ipis(uint64_t *total)
+{
+	FILE *fp;
+	char line[4096];
+	bool found = false;
+
+	*total = 0;
+	fp = fopen("/proc/interrupts", "r");
+	if (!fp)
+		return false;
+	while (fgets(line, sizeof(line), fp)) {
+		char *ptr, *end;
+
+		if (!strstr(line, "Function call interrupts"))
+			continue;
+		ptr = strchr(line, ':');
+		if (!ptr)
+			break;
+		for (ptr++; ; ptr = end) {
+			const unsigned long long n = strtoull(ptr, &end, 10);
+
+			if (end == ptr)
+				break;
+			*total += (uint64_t)n;
+		}
+		found = true;
+		break;
+	}
+	(void)fclose(fp);
+	return found;
+}
+
+/*
+ *  stress_membarrier_read()
+ *	one userspace RCU read side critical section, a urcu style reader
+ *	counter snapshot of the grace period counter around a read of the
+ *	protected data, ordered by the barrier of the method
+ */
+static inline uint64_t stress_membarrier_read(
+	stress_membarrier_bench_t *bench,
+	stress_membarrier_reader_t *reader,
+	const int method)
+{
+	uint64_t val;
+
+	reader->ctr = __atomic_load_n(&bench->gp_ctr, __ATOMIC_RELAXED);
+	switch (method) {
+	case MEMBARRIER_BENCH_MFENCE:
+#if defined(STRESS_ARCH_X86)
+		__asm__ __volatile__("mfence" ::: "memory");
+#else
+		shim_mfence();
+#endif
+		val = *bench->data;
+#if defined(STRESS_ARCH_X86)
+		__asm__ __volatile__("mfence" ::: "memory");
+#else
+		shim_mfence();
+#endif
+		break;
+	case MEMBARRIER_BENCH_LOCK:
+#if defined(STRESS_ARCH_X86)
+		__asm__ __volatile__("lock; addl $0,0(%%rsp)" ::: "memory", "cc");
+#else
+		(void)__atomic_fetch_add(&reader->reads, 0, __ATOMIC_SEQ_CST);
+#endif
+		val = *bench->data;
+#if defined(STRESS_ARCH_X86)
+		__asm__ __volatile__("lock; addl $0,0(%%rsp)" ::: "memory", "cc");
+#else
+		(void)__atomic_fetch_add(&reader->reads, 0, __ATOMIC_SEQ_CST);
+#endif
+		break;
+	default:
+		/* membarrier on the writer side orders these */
+		shim_mb();
+		val = *bench->data;
+		shim_mb();
+		break;
+	}
+	reader->ctr = 0;
+	return val;
+}
+
+/*
+ *  stress_membarrier_reader()
+ *	run read side critical sections until told to stop
+ */
+static void *stress_membarrier_reader(void *arg)
+{
+	stress_membarrier_reader_t *reader = (stress_membarrier_reader_t *)arg;
+	stress_membarrier_bench_t *bench = reader->bench;
+	const int method = bench->method;
+	uint64_t sum = 0;
+	double t_start;
+
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+#if defined(HAVE_AFFINITY)
+	if (reader->cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(reader->cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask) < 0)
+			reader->cpu = -1;
+	}
+#endif
+	while (!bench->go && !bench->stop)
+		(void)shim_sched_yield();
+
+	t_start = stress_membarrier_thread_cpu();
+	while (!bench->stop) {
+		register int i;
+
+		for (i = 0; i < MEMBARRIER_BENCH_BATCH; i++)
+			sum += stress_membarrier_read(bench, reader, method);
+		reader->reads += MEMBARRIER_BENCH_BATCH;
+	}
+	reader->cpu_time = stress_membarrier_thread_cpu() - t_start;
+	stress_uint64_put(sum);
+	return NULL;
+}
+
+/*
+ *  stress_membarrier_measure()
+ *	run the method with n_readers reader threads for
+ *	MEMBARRIER_BENCH_SLICE seconds, timing each membarrier call of
+ *	the writer methods
+ */
+static int stress_membarrier_measure(
+	const stress_args_t *args,
+	stress_membarrier_bench_t *bench,
+	stress_membarrier_reader_t *readers,
+	const size_t n_readers,
+	const int *cpus,
+	const size_t n_cpus,
+	stress_membarrier_result_t *result)
+{
+	size_t i, started = 0;
+	uint64_t ipis = 0, ipis_end;
+	double t_end;
+	bool *used;
+
+	(void)memset(readers, 0, n_readers * sizeof(*readers));
+	bench->go = false;
+	bench->stop = false;
+
+	for (i = 0; i < n_readers; i++) {
+		readers[i].bench = bench;
+		readers[i].cpu = n_cpus ? cpus[i % n_cpus] : -1;
+		readers[i].ret = pthread_create(&readers[i].pthread, NULL,
+			stress_membarrier_reader, (void *)&readers[i]);
+		if (readers[i].ret)
+			break;
+		started++;
+	}
+	if (started < n_readers) {
+		pr_inf("%s: cannot create %zu reader threads, only created %zu\n",
+			args->name, n_readers, started);
+		bench->stop = true;
+		for (i = 0; i < started; i++)
+			(void)pthread_join(readers[i].pthread, NULL);
+		return EXIT_NO_RESOURCE;
+	}
+
+	bench->go = true;
+	if (bench->method < MEMBARRIER_BENCH_WRITERS) {
+		const int cmd = membarrier_bench_cmds[bench->method];
+
+		(void)stress_membarrier_ipis(&ipis);
+		t_end = stress_time_now() + MEMBARRIER_BENCH_SLICE;
+		while (keep_stressing_flag() && (stress_time_now() < t_end)) {
+			uint64_t t;
+
+			(void)__atomic_fetch_add(&bench->gp_ctr, 1, __ATOMIC_RELAXED);
+			t = stress_membarrier_now_ns();
+			if (shim_membarrier(cmd, 0, 0) < 0) {
+				result->unsupported = true;
+				break;
+			}
+			stress_membarrier_lat_add(result, stress_membarrier_now_ns() - t);
+		}
+		(void)stress_membarrier_ipis(&ipis_end);
+		ipis = ipis_end - ipis;
+	} else {
+		(void)shim_usleep((uint64_t)(MEMBARRIER_BENCH_SLICE * 1000000.0));
+	}
+	bench->stop = true;
+
+	for (i = 0; i < started; i++)
+		(void)pthread_join(readers[i].pthread, NULL);
+	if (!keep_stressing_flag())
+		return EXIT_SUCCESS;
+
+	result->ipis += ipis;
+	for (i = 0; i < n_readers; i++) {
+		result->reads += readers[i].reads;
+		result->cpu_time += readers[i].cpu_time;
+	}
+	used = calloc(n_cpus ? n_cpus : 1, sizeof(*used));
+	if (used) {
+		size_t n = 0;
+
+		for (i = 0; i < n_readers; i++) {
+			size_t j;
+
+			if (readers[i].cpu < 0)
+				continue;
+			j = i % n_cpus;
+			if (!used[j]) {
+				used[j] = true;
+				n++;
+			}
+		}
+		result->cpus = n;
+		free(used);
+	}
+	inc_counter(args);
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_membarrier_read_ns()
+ *	reader cpu nanoseconds per read side critical section
+ */
+static double stress_membarrier_read_ns(const stress_membarrier_result_t *result)
+{
+	return result->reads ? (result->cpu_time * (double)STRESS_NANOSECOND) / (double)result->reads : 0.0;
+}
+
+/*
+ *  stress_membarrier_breakeven()
+ *	reads per grace period above which the membarrier command is
+ *	cheaper than readers that fence, the median membarrier cost over
+ *	the per read fence cost
+ */
+static double stress_membarrier_breakeven(
+	const stress_membarrier_result_t *writer,
+	const stress_membarrier_result_t *fence,
+	const stress_membarrier_result_t *barrier)
+{
+	const double saved = stress_membarrier_read_ns(fence) - stress_membarrier_read_ns(barrier);
+
+	if (!writer->calls || writer->unsupported || !fence->reads || !barrier->reads || (saved <= 0.0))
+		return 0.0;
+	return stress_membarrier_percentile(writer, 50.0) / saved;
+}
+
+/*
+ *  stress_membarrier_line()
+ *	append one column per reader thread count to a report line,
+ *	negative values are not available
+ */
+static void stress_membarrier_line(
+	char *line,
+	const size_t len,
+	const size_t n_cols,
+	const double *vals,
+	const int prec)
+{
+	size_t c, pos = strlen(line);
+
+	for (c = 0; (c < n_cols) && (pos < len); c++) {
+		if (vals[c] >= 0.0)
+			pos += (size_t)snprintf(line + pos, len - pos, " %9.*f", prec, vals[c]);
+		else
+			pos += (size_t)snprintf(line + pos, len - pos, " %9s", "n/a");
+	}
+}
+
+/*
+ *  stress_membarrier_report()
+ *	report membarrier latency and IPIs, reader costs and the break
+ *	even reads per grace period against fencing readers
+ */
+static void stress_membarrier_report(
+	const stress_args_t *args,
+	stress_membarrier_result_t results[MEMBARRIER_BENCH_METHODS][MEMBARRIER_BENCH_COLS],
+	const size_t *cols,
+	const size_t n_cols,
+	const bool have_ipis)
+{
+	char line[256], desc[64];
+	double vals[MEMBARRIER_BENCH_COLS];
+	bool lock = false;
+	size_t m, c;
+	int idx = 0;
+
+	if (args->instance != 0)
+		goto stats;
+
+	pr_lock(&lock);
+	(void)snprintf(line, sizeof(line), "%-40s", "reader threads");
+	for (c = 0; c < n_cols; c++)
+		vals[c] = (double)cols[c];
+	stress_membarrier_line(line, sizeof(line), n_cols, vals, 0);
+	pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	(void)snprintf(line, sizeof(line), "%-40s", "cpus in use");
+	for (c = 0; c < n_cols; c++)
+		vals[c] = results[MEMBARRIER_BENCH_BARRIER][c].cpus ?
+			(double)results[MEMBARRIER_BENCH_BARRIER][c].cpus : -1.0;
+	stress_membarrier_line(line, sizeof(line), n_cols, vals, 0);
+	pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+	for (m = 0; m < MEMBARRIER_BENCH_WRITERS; m++) {
+		(void)snprintf(desc, sizeof(desc), "%s p50 ns", membarrier_bench_methods[m]);
+		(void)snprintf(line, sizeof(line), "%-40s", desc);
+		for (c = 0; c < n_cols; c++)
+			vals[c] = (results[m][c].unsupported || !results[m][c].calls) ?
+				-1.0 : stress_membarrier_percentile(&results[m][c], 50.0);
+		stress_membarrier_line(line, sizeof(line), n_cols, vals, 0);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+		(void)snprintf(desc, sizeof(desc), "%s p99 ns", membarrier_bench_methods[m]);
+		(void)snprintf(line, sizeof(line), "%-40s", desc);
+		for (c = 0; c < n_cols; c++)
+			vals[c] = (results[m][c].unsupported || !results[m][c].calls) ?
+				-1.0 : stress_membarrier_percentile(&results[m][c], 99.0);
+		stress_membarrier_line(line, sizeof(line), n_cols, vals, 0);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+		(void)snprintf(desc, sizeof(desc), "%s IPIs/call", membarrier_bench_methods[m]);
+		(void)snprintf(line, sizeof(line), "%-40s", desc);
+		for (c = 0; c < n_cols; c++)
+			vals[c] = (have_ipis && results[m][c].calls && !results[m][c].unsupported) ?
+				(double)results[m][c].ipis / (double)results[m][c].calls : -1.0;
+		stress_membarrier_line(line, sizeof(line), n_cols, vals, 2);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	}
+	for (m = 0; m < MEMBARRIER_BENCH_METHODS; m++) {
+		(void)snprintf(desc, sizeof(desc), "%s%s read ns", m < MEMBARRIER_BENCH_WRITERS ?
+			"barrier, " : "", membarrier_bench_methods[m]);
+		(void)snprintf(line, sizeof(line), "%-40s", desc);
+		for (c = 0; c < n_cols; c++)
+			vals[c] = results[m][c].reads ? stress_membarrier_read_ns(&results[m][c]) : -1.0;
+		stress_membarrier_line(line, sizeof(line), n_cols, vals, 1);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	}
+	for (m = 0; m < MEMBARRIER_BENCH_GLOBAL; m++) {
+		size_t f;
+
+		for (f = MEMBARRIER_BENCH_MFENCE; f <= MEMBARRIER_BENCH_LOCK; f++) {
+			(void)snprintf(desc, sizeof(desc), "%s vs %s reads/gp", membarrier_bench_methods[m],
+				membarrier_bench_methods[f]);
+			(void)snprintf(line, sizeof(line), "%-40s", desc);
+			for (c = 0; c < n_cols; c++) {
+				vals[c] = stress_membarrier_breakeven(&results[m][c], &results[f][c],
+					&results[MEMBARRIER_BENCH_BARRIER][c]);
+				if (vals[c] <= 0.0)
+					vals[c] = -1.0;
+			}
+			stress_membarrier_line(line, sizeof(line), n_cols, vals, 1);
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+	}
+	pr_unlock(&lock);
+
+stats:
+	/* costs at the most reader threads */
+	c = n_cols - 1;
+	for (m = 0; m < MEMBARRIER_BENCH_WRITERS; m++) {
+		const stress_membarrier_result_t *r = &results[m][c];
+
+		(void)snprintf(desc, sizeof(desc), "%s p50 ns", membarrier_bench_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			r->unsupported ? 0.0 : stress_membarrier_percentile(r, 50.0));
+		if (m == MEMBARRIER_BENCH_GLOBAL)
+			break;
+		(void)snprintf(desc, sizeof(desc), "%s p99 ns", membarrier_bench_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			r->unsupported ? 0.0 : stress_membarrier_percentile(r, 99.0));
+	}
+	stress_misc_stats_set(args->misc_stats, idx++, "private expedited IPIs/call",
+		results[MEMBARRIER_BENCH_PRIVATE][c].calls ?
+		(double)results[MEMBARRIER_BENCH_PRIVATE][c].ipis /
+		(double)results[MEMBARRIER_BENCH_PRIVATE][c].calls : 0.0);
+	for (m = MEMBARRIER_BENCH_BARRIER; m < MEMBARRIER_BENCH_METHODS; m++) {
+		(void)snprintf(desc, sizeof(desc), "%s read ns", membarrier_bench_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_membarrier_read_ns(&results[m][c]));
+	}
+	stress_misc_stats_set(args->misc_stats, idx++, "private vs mfence reads/gp",
+		stress_membarrier_breakeven(&results[MEMBARRIER_BENCH_PRIVATE][c],
+			&results[MEMBARRIER_BENCH_MFENCE][c],
+			&results[MEMBARRIER_BENCH_BARRIER][c]));
+}
+
+/*
+ *  stress_membarrier_bench()
+ *	measure the cost of the membarrier commands a userspace RCU
+ *	writer would use against readers that fence, over a range of
+ *	reader thread counts, one bogo op per measurement
+ */
+static int stress_membarrier_bench(const stress_args_t *args, const int mask)
+{
+	static stress_membarrier_result_t results[MEMBARRIER_BENCH_METHODS][MEMBARRIER_BENCH_COLS];
+	const int32_t cpus_online = stress_get_processors_online();
+	stress_membarrier_bench_t bench;
+	stress_membarrier_reader_t *readers;
+	volatile uint64_t data = 0;
+	size_t membarrier_threads = (size_t)STRESS_MAXIMUM(2, 2 * cpus_online);
+	size_t cols[MEMBARRIER_BENCH_COLS], n_cols = 0, n, m, c, n_cpus = 0;
+	int cpus[MAX_MEMBARRIER_BENCH_THREADS];
+	bool registered[MEMBARRIER_BENCH_WRITERS], have_ipis;
+	uint64_t ipis;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("membarrier-threads", &membarrier_threads);
+	for (n = 1; (n < membarrier_threads) && (n_cols < MEMBARRIER_BENCH_COLS - 1); n <<= 1)
+		cols[n_cols++] = n;
+	cols[n_cols++] = membarrier_threads;
+
+#if defined(HAVE_AFFINITY)
+	{
+		cpu_set_t mask_cpus;
+
+		/* Spread the readers out over the cpus we may run on */
+		if (sched_getaffinity(0, sizeof(mask_cpus), &mask_cpus) == 0) {
+			int cpu;
+
+			for (cpu = 0; (cpu < CPU_SETSIZE) && (n_cpus < MAX_MEMBARRIER_BENCH_THREADS); cpu++)
+				if (CPU_ISSET(cpu, &mask_cpus))
+					cpus[n_cpus++] = cpu;
+		}
+	}
+#endif
+
+	registered[MEMBARRIER_BENCH_PRIVATE] = (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+		(shim_membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0);
+	registered[MEMBARRIER_BENCH_GLOBAL_EXP] = (mask & MEMBARRIER_CMD_GLOBAL_EXPEDITED) &&
+		(shim_membarrier(MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED, 0, 0) == 0);
+	registered[MEMBARRIER_BENCH_GLOBAL] = (mask & MEMBARRIER_CMD_GLOBAL) != 0;
+	if ((args->instance == 0) && !(registered[MEMBARRIER_BENCH_PRIVATE] &&
+	    registered[MEMBARRIER_BENCH_GLOBAL_EXP] && registered[MEMBARRIER_BENCH_GLOBAL]))
+		pr_inf("%s: some membarrier commands are not supported, their costs are not measured\n",
+			args->name);
+	have_ipis = stress_membarrier_ipis(&ipis);
+	if (!have_ipis && (args->instance == 0))
+		pr_inf("%s: no function call interrupt counts in /proc/interrupts, IPIs are not measured\n",
+			args->name);
+
+	readers = calloc(membarrier_threads, sizeof(*readers));
+	if (!readers) {
+		pr_inf("%s: cannot allocate %zu reader threads, skipping stressor\n",
+			args->name, membarrier_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(results, 0, sizeof(results));
+	(void)memset(&bench, 0, sizeof(bench));
+	bench.data = &data;
+	(void)sigfillset(&set);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (c = 0; c < n_cols; c++) {
+			for (m = 0; m < MEMBARRIER_BENCH_METHODS; m++) {
+				if (!keep_stressing(args))
+					goto report;
+				if ((m < MEMBARRIER_BENCH_WRITERS) && !registered[m]) {
+					results[m][c].unsupported = true;
+					continue;
+				}
+				bench.method = (int)m;
+				rc = stress_membarrier_measure(args, &bench, readers, cols[c],
+					cpus, n_cpus, &results[m][c]);
+				if (results[m][c].unsupported)
+					registered[m] = false;
+				if (rc != EXIT_SUCCESS)
+					goto report;
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_membarrier_report(args, results, cols, n_cols, have_ipis);
+	free(readers);
+
+	return rc;
+}
+#endif
+
 static int stress_membarrier_exercise(const stress_args_t *args)
 {
 	int ret;
@@ -132,6 +795,9 @@ static int stress_membarrier(const stress_args_t *args)
 	size_t i;
 	int pthread_ret[MAX_MEMBARRIER_THREADS];
 	stress_pthread_args_t pargs = { args, NULL, 0 };
+#if defined(STRESS_MEMBARRIER_BENCH)
+	bool membarrier_bench = false;
+#endif
 
 	ret = shim_membarrier(MEMBARRIER_CMD_QUERY, 0, 0);
 	if (ret < 0) {
@@ -151,6 +817,11 @@ static int stress_membarrier(const stress_args_t *args)
 			"not supported\n", args->name);
 		return EXIT_NOT_IMPLEMENTED;
 	}
+#if defined(STRESS_MEMBARRIER_BENCH)
+	(void)stress_get_setting("membarrier-bench", &membarrier_bench);
+	if (membarrier_bench)
+		return stress_membarrier_bench(args, ret);
+#endif
 
 	(void)sigfillset(&set);
 	(void)memset(pthread_ret, 0, sizeof(pthread_ret));
@@ -186,12 +857,14 @@ static int stress_membarrier(const stress_args_t *args)
 stressor_info_t stress_membarrier_info = {
 	.stressor = stress_membarrier,
 	.class = CLASS_CPU_CACHE | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_membarrier_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU_CACHE | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -30,6 +30,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"memcpy N",	   "start N workers performing memory copies" },
 	{ NULL,	"memcpy-ops N",	   "stop after N memcpy bogo operations" },
 	{ NULL,	"memcpy-method M", "set memcpy method (M = all, libc, builtin, naive)" },
+	{ NULL,	"memcpy-compare",  "compare libc, SIMD and kernel style memory and string functions" },
 	{ NULL,	NULL,		   NULL }
 };
 
@@ -222,6 +223,15 @@ static int stress_set_memcpy_method(const char *name)
 	return -1;
 }
 
+static int stress_set_memcpy_compare(const char *opt)
+{
+	bool memcpy_compare = true;
+
+	(void)opt;
+
+	return stress_set_setting("memcpy-compare", TYPE_ID_BOOL, &memcpy_compare);
+}
+
 static void stress_memcpy_set_default(void)
 {
 	stress_set_memcpy_method("all");
@@ -238,6 +248,11 @@ static int stress_memcpy(const stress_args_t *args)
 	uint8_t *str_shared = g_shared->str_shared;
 	uint8_t *aligned_buf = stress_align_address(b.buffer, ALIGN_SIZE);
 	const stress_memcpy_method_info_t *memcpy_method = &stress_memcpy_methods[0];
+	bool memcpy_compare = false;
+
+	(void)stress_get_setting("memcpy-compare", &memcpy_compare);
+	if (memcpy_compare)
+		return stress_memfunc_compare(args);
 
 	(void)stress_get_setting("memcpy-method", &memcpy_method);
 
@@ -257,6 +272,7 @@ static int stress_memcpy(const stress_args_t *args)
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_memcpy_method,	stress_set_memcpy_method },
+	{ OPT_memcpy_compare,	stress_set_memcpy_compare },
 	{ 0,			NULL }
 };
 
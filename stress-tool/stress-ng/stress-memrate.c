@@ -23,6 +23,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"memrate N",		"start N workers exercised memory read/writes" },
 	{ NULL,	"memrate-ops N",	"stop after N memrate bogo operations" },
 	{ NULL,	"memrate-bytes N",	"size of memory buffer being exercised" },
+	{ NULL,	"memrate-latency",	"measure loaded latency over a sweep of read rates" },
 	{ NULL,	"memrate-rd-mbs N",	"read rate from buffer in megabytes per second" },
 	{ NULL,	"memrate-wr-mbs N",	"write rate to buffer in megabytes per second" },
 	{ NULL,	NULL,			NULL }
@@ -41,8 +42,18 @@ typedef struct {
 	bool		valid;
 } stress_memrate_stats_t;
 
+/* One read rate step of the loaded latency sweep */
+typedef struct {
+	double		duration;	/* time the step has run */
+	double		kbytes;		/* KB read by the bandwidth load */
+	double		loads;		/* pointer chase loads */
+	double		load_time;	/* time taken by the pointer chase loads */
+} stress_memrate_latency_t;
+
 typedef struct {
 	stress_memrate_stats_t *stats;
+	stress_memrate_latency_t *latency;	/* loaded latency sweep steps */
+	uint64_t *numa_pages;		/* pages of the buffer per NUMA node */
 	uint64_t memrate_bytes;
 	uint64_t memrate_rd_mbs;
 	uint64_t memrate_wr_mbs;
@@ -68,6 +79,14 @@ static int stress_set_memrate_rd_mbs(const char *opt)
 	return stress_set_setting("memrate-rd-mbs", TYPE_ID_UINT64, &memrate_rd_mbs);
 }
 
+static int stress_set_memrate_latency(const char *opt)
+{
+	bool memrate_latency = true;
+
+	(void)opt;
+	return stress_set_setting("memrate-latency", TYPE_ID_BOOL, &memrate_latency);
+}
+
 static int stress_set_memrate_wr_mbs(const char *opt)
 {
 	uint64_t memrate_wr_mbs;
@@ -347,10 +366,7 @@ static void OPTIMIZE3 stress_memrate_init_data(
 	void *start,
 	void *end)
 {
-	register volatile uint32_t *ptr;
-
-	for (ptr = start; ptr < (uint32_t *)end; ptr++)
-		*ptr = stress_mwc32();
+	stress_mwc_fill(start, (size_t)((uint8_t *)end - (uint8_t *)start));
 }
 
 static inline void *stress_memrate_mmap(const stress_args_t *args, uint64_t sz)
@@ -376,7 +392,11 @@ static inline void *stress_memrate_mmap(const stress_args_t *args, uint64_t sz)
 #if defined(HAVE_MADVISE) &&	\
     defined(MADV_HUGEPAGE)
 		int ret, advice = MADV_NORMAL;
+#endif
 
+		stress_numa_mbind(args, ptr, (size_t)sz);
+#if defined(HAVE_MADVISE) &&	\
+    defined(MADV_HUGEPAGE)
 		ret = madvise(ptr, sz, advice);
 		(void)ret;
 #endif
@@ -384,10 +404,197 @@ static inline void *stress_memrate_mmap(const stress_args_t *args, uint64_t sz)
 	return ptr;
 }
 
+#define MEMRATE_LATENCY_STEPS	(11)	/* idle, 10% .. 90% and peak read rate */
+#define MEMRATE_LATENCY_STEP	(0.5)	/* seconds per sweep step */
+#define MEMRATE_PROBE_LOADS	(65536)	/* pointer chase loads per probe sample */
+
+#if defined(HAVE_LIB_PTHREAD)
+/* Pointer chase latency probe run alongside the bandwidth load */
+typedef struct {
+	void **chase;			/* current position in the chase */
+	pthread_mutex_t lock;		/* protects loads and load_time */
+	double loads;			/* total chase loads */
+	double load_time;		/* total time of the chase loads */
+	volatile bool stop;		/* set to stop the probe */
+} stress_memrate_probe_t;
+
+/*
+ *  stress_memrate_chase_init()
+ *	link the cache lines of a buffer into a single randomly
+ *	ordered cycle so each load depends on the previous one
+ *	and defeats the hardware prefetchers
+ */
+static int stress_memrate_chase_init(void *buffer, const uint64_t bytes)
+{
+	const size_t lines = (size_t)(bytes / 64);
+	uint32_t *order;
+	size_t i;
+
+	order = calloc(lines, sizeof(*order));
+	if (!order)
+		return -1;
+	for (i = 0; i < lines; i++)
+		order[i] = (uint32_t)i;
+	/* Sattolo's algorithm, a random permutation with one cycle */
+	for (i = lines - 1; i > 0; i--) {
+		const size_t j = (size_t)(stress_mwc64() % i);
+		const uint32_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	for (i = 0; i < lines; i++) {
+		void **line = (void **)((uint8_t *)buffer + ((size_t)order[i] * 64));
+
+		*line = (uint8_t *)buffer + ((size_t)order[(i + 1) % lines] * 64);
+	}
+	free(order);
+	return 0;
+}
+
+/*
+ *  stress_memrate_probe()
+ *	chase pointers until stopped, accumulating the number of
+ *	loads and the time they took
+ */
+static void *stress_memrate_probe(void *arg)
+{
+	stress_memrate_probe_t *probe = (stress_memrate_probe_t *)arg;
+	register void **ptr = probe->chase;
+
+	while (!probe->stop && keep_stressing_flag()) {
+		const double t1 = stress_time_now();
+		double t2;
+		register int i;
+
+		for (i = 0; i < MEMRATE_PROBE_LOADS; i += 8) {
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+			ptr = (void **)*ptr;
+		}
+		t2 = stress_time_now();
+
+		(void)pthread_mutex_lock(&probe->lock);
+		probe->loads += (double)MEMRATE_PROBE_LOADS;
+		probe->load_time += t2 - t1;
+		(void)pthread_mutex_unlock(&probe->lock);
+	}
+	/* Keep the chase live so it is not optimized away */
+	probe->chase = ptr;
+	return NULL;
+}
+
+/*
+ *  stress_memrate_probe_sample()
+ *	get the probe's total loads and load time so far
+ */
+static void stress_memrate_probe_sample(
+	stress_memrate_probe_t *probe,
+	double *loads,
+	double *load_time)
+{
+	(void)pthread_mutex_lock(&probe->lock);
+	*loads = probe->loads;
+	*load_time = probe->load_time;
+	(void)pthread_mutex_unlock(&probe->lock);
+}
+
+/*
+ *  stress_memrate_latency()
+ *	sweep the read rate of a bandwidth load on buffer from
+ *	idle up to its peak while a pointer chase on a second
+ *	buffer measures the memory latency at each rate
+ */
+static int stress_memrate_latency(
+	const stress_args_t *args,
+	const stress_memrate_context_t *context,
+	void *buffer,
+	void *buffer_end)
+{
+	stress_memrate_probe_t probe;
+	pthread_t pthread;
+	void *chase;
+	double peak_mbs = 0.0;
+	int ret;
+
+	chase = stress_memrate_mmap(args, context->memrate_bytes);
+	if (chase == MAP_FAILED)
+		return EXIT_NO_RESOURCE;
+	if (stress_memrate_chase_init(chase, context->memrate_bytes) < 0) {
+		pr_inf("%s: cannot allocate pointer chase order, skipping stressor\n",
+			args->name);
+		(void)munmap(chase, context->memrate_bytes);
+		return EXIT_NO_RESOURCE;
+	}
+
+	probe.chase = (void **)chase;
+	probe.loads = 0.0;
+	probe.load_time = 0.0;
+	probe.stop = false;
+	(void)pthread_mutex_init(&probe.lock, NULL);
+	ret = pthread_create(&pthread, NULL, stress_memrate_probe, &probe);
+	if (ret) {
+		pr_inf("%s: cannot create latency probe thread, errno=%d (%s), "
+			"skipping stressor\n", args->name, ret, strerror(ret));
+		(void)pthread_mutex_destroy(&probe.lock);
+		(void)munmap(chase, context->memrate_bytes);
+		return EXIT_NO_RESOURCE;
+	}
+
+	do {
+		int step;
+
+		/* Peak first, it sets the read rates of the other steps */
+		for (step = MEMRATE_LATENCY_STEPS - 1; keep_stressing(args) && (step >= 0); step--) {
+			stress_memrate_latency_t *latency = &context->latency[step];
+			const uint64_t rd_mbs = (step == MEMRATE_LATENCY_STEPS - 1) ? ~0ULL :
+				(uint64_t)(peak_mbs * step / (MEMRATE_LATENCY_STEPS - 1));
+			double t1, t2, loads1, load_time1, loads2, load_time2;
+			double kbytes = 0.0;
+
+			stress_memrate_probe_sample(&probe, &loads1, &load_time1);
+			t1 = stress_time_now();
+			do {
+				bool valid;
+
+				if (rd_mbs)
+					kbytes += (double)stress_memrate_read64(buffer,
+						buffer_end, rd_mbs, ~0ULL, &valid);
+				else
+					(void)shim_usleep((uint64_t)(MEMRATE_LATENCY_STEP * 1000000.0));
+				t2 = stress_time_now();
+			} while (keep_stressing(args) && (t2 - t1 < MEMRATE_LATENCY_STEP));
+			stress_memrate_probe_sample(&probe, &loads2, &load_time2);
+
+			latency->duration += t2 - t1;
+			latency->kbytes += kbytes;
+			latency->loads += loads2 - loads1;
+			latency->load_time += load_time2 - load_time1;
+			if ((step == MEMRATE_LATENCY_STEPS - 1) && (t2 > t1))
+				peak_mbs = kbytes / ((t2 - t1) * KB);
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	probe.stop = true;
+	(void)pthread_join(pthread, NULL);
+	(void)pthread_mutex_destroy(&probe.lock);
+	(void)munmap(chase, context->memrate_bytes);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 {
 	const stress_memrate_context_t *context = (stress_memrate_context_t *)ctxt;
 	void *buffer, *buffer_end;
+	bool memrate_latency = false;
 
 	buffer = stress_memrate_mmap(args, context->memrate_bytes);
 	if (buffer == MAP_FAILED)
@@ -395,6 +602,22 @@ static int stress_memrate_child(const stress_args_t *args, void *ctxt)
 
 	buffer_end = (uint8_t *)buffer + context->memrate_bytes;
 	stress_memrate_init_data(buffer, buffer_end);
+	(void)stress_numa_pages(args, buffer, (size_t)context->memrate_bytes,
+		context->numa_pages, STRESS_NUMA_MAX_NODES);
+
+	(void)stress_get_setting("memrate-latency", &memrate_latency);
+	if (memrate_latency) {
+#if defined(HAVE_LIB_PTHREAD)
+		const int rc = stress_memrate_latency(args, context, buffer, buffer_end);
+
+		(void)munmap(buffer, context->memrate_bytes);
+		return rc;
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --memrate-latency needs pthread support, "
+				"measuring bandwidth only\n", args->name);
+#endif
+	}
 
 	do {
 		size_t i;
@@ -435,6 +658,7 @@ static int stress_memrate(const stress_args_t *args)
 	size_t i, stats_size;
 	bool lock = false;
 	stress_memrate_context_t context;
+	double kbytes = 0.0, duration = 0.0;
 
 	context.memrate_bytes = DEFAULT_MEMRATE_BYTES;
 	context.memrate_rd_mbs = ~0ULL;
@@ -444,7 +668,9 @@ static int stress_memrate(const stress_args_t *args)
 	(void)stress_get_setting("memrate-rd-mbs", &context.memrate_rd_mbs);
 	(void)stress_get_setting("memrate-wr-mbs", &context.memrate_wr_mbs);
 
-	stats_size = memrate_items * sizeof(*context.stats);
+	stats_size = memrate_items * sizeof(*context.stats) +
+		MEMRATE_LATENCY_STEPS * sizeof(*context.latency) +
+		STRESS_NUMA_MAX_NODES * sizeof(*context.numa_pages);
 	stats_size = (stats_size + args->page_size - 1) & ~(args->page_size - 1);
 
 	context.stats = (stress_memrate_stats_t *)mmap(NULL, stats_size,
@@ -456,6 +682,10 @@ static int stress_memrate(const stress_args_t *args)
 		context.stats[i].kbytes = 0.0;
 		context.stats[i].valid = false;
 	}
+	context.latency = (stress_memrate_latency_t *)(context.stats + memrate_items);
+	(void)memset(context.latency, 0, MEMRATE_LATENCY_STEPS * sizeof(*context.latency));
+	context.numa_pages = (uint64_t *)(context.latency + MEMRATE_LATENCY_STEPS);
+	(void)memset(context.numa_pages, 0, STRESS_NUMA_MAX_NODES * sizeof(*context.numa_pages));
 
 	context.memrate_bytes = (context.memrate_bytes + 63) & ~(63ULL);
 
@@ -478,12 +708,28 @@ static int stress_memrate(const stress_args_t *args)
 
 			(void)snprintf(tmp, sizeof(tmp), "%s MB/sec", memrate_info[i].name);
 			stress_misc_stats_set(args->misc_stats, i, tmp, rate);
+			kbytes += context.stats[i].kbytes;
+			duration += context.stats[i].duration;
 		} else {
 			pr_inf_lock(&lock, "%s: %10.10s: interrupted early\n",
 				args->name, memrate_info[i].name);
 		}
 	}
+	for (i = 0; i < MEMRATE_LATENCY_STEPS; i++) {
+		const stress_memrate_latency_t *latency = &context.latency[i];
+
+		if ((latency->duration <= 0.0) || (latency->loads <= 0.0))
+			continue;
+		pr_inf_lock(&lock, "%s: loaded latency: %12.2f MB/sec %10.2f ns\n",
+			args->name, latency->kbytes / (latency->duration * KB),
+			(latency->load_time * (double)STRESS_NANOSECOND) / latency->loads);
+		kbytes += latency->kbytes;
+		duration += latency->duration;
+	}
 	pr_unlock(&lock);
+	/* Per node share of the average rate over all the methods */
+	stress_numa_report(args, context.numa_pages, STRESS_NUMA_MAX_NODES,
+		(duration > 0.0) ? kbytes / (duration * KB) : 0.0);
 
 	(void)munmap((void *)context.stats, stats_size);
 
@@ -492,6 +738,7 @@ static int stress_memrate(const stress_args_t *args)
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_memrate_bytes,	stress_set_memrate_bytes },
+	{ OPT_memrate_latency,	stress_set_memrate_latency },
 	{ OPT_memrate_rd_mbs,	stress_set_memrate_rd_mbs },
 	{ OPT_memrate_wr_mbs,	stress_set_memrate_wr_mbs },
 	{ 0,			NULL }
@@ -38,13 +38,33 @@ static const stress_help_t help[] = {
 #define MATRIX_SIZE		(1 << MATRIX_SIZE_MAX_SHIFT)
 #define MEM_SIZE		(MATRIX_SIZE * MATRIX_SIZE)
 
+#define MODEL_NODE_UNSET	(-2)
+
+typedef struct stress_memthrash_thread stress_memthrash_thread_t;
+
 typedef void (*stress_memthrash_func_t)(const stress_args_t *args, size_t mem_size);
+typedef void (*stress_memthrash_model_func_t)(stress_memthrash_thread_t *thread, const size_t mem_size);
 
 typedef struct {
 	const char		*name;	/* human readable form of stressor */
 	stress_memthrash_func_t	func;	/* the method function */
+	stress_memthrash_model_func_t model; /* or the contention model function */
 } stress_memthrash_method_info_t;
 
+/* Per pthread state */
+struct stress_memthrash_thread {
+	const stress_args_t *args;
+	const stress_memthrash_method_info_t *info;
+	uint32_t index;		/* pthread number, 0..threads-1 */
+	uint32_t threads;	/* pthreads in this stressor */
+	int32_t cpu;		/* CPU pinned to, -1 if not pinned */
+	int32_t local;		/* NUMA node of the CPU */
+	int32_t node;		/* NUMA node of the thread's memory */
+	uint64_t ops;		/* model operations done */
+	uint64_t bytes;		/* model bytes streamed */
+	double duration;	/* nanoseconds spent in the model */
+};
+
 typedef struct {
 	uint32_t total_cpus;
 	uint32_t max_threads;
@@ -365,40 +385,152 @@ static void HOT OPTIMIZE3 stress_memthrash_spinwrite(
 }
 
 
+/*
+ *  Contention models, all the threads of a stressor run the same
+ *  model at the same time, each pinned to a CPU with successive
+ *  threads on different physical packages, so the cost of moving
+ *  cache lines between CPUs and sockets can be measured
+ */
+#define MODEL_OPS		(65536)
+#define MODEL_SHARED_OFFSET	(4096)	/* truly shared word, away from the false sharing line */
+
+/*
+ *  stress_memthrash_falseshare()
+ *	each thread increments its own 8 byte counter, but 8 threads
+ *	share each 64 byte cache line so the line ping-pongs
+ */
+static void HOT OPTIMIZE3 stress_memthrash_falseshare(
+	stress_memthrash_thread_t *thread,
+	const size_t mem_size)
+{
+	volatile uint64_t *counter = ((uint64_t *)mem) + thread->index;
+	const double t = stress_time_now_ns();
+	uint32_t i;
+
+	(void)mem_size;
+
+	for (i = 0; !thread_terminate && (i < MODEL_OPS); i++)
+		(*counter)++;
+	thread->duration += stress_time_now_ns() - t;
+	thread->ops += i;
+}
+
+#if defined(MEM_LOCK)
+/*
+ *  stress_memthrash_trueshare()
+ *	all threads atomically increment the same 8 byte
+ *	counter, so every increment moves the cache line
+ */
+static void HOT OPTIMIZE3 stress_memthrash_trueshare(
+	stress_memthrash_thread_t *thread,
+	const size_t mem_size)
+{
+	volatile uint64_t *counter = (uint64_t *)((uint8_t *)mem + MODEL_SHARED_OFFSET);
+	const double t = stress_time_now_ns();
+	uint32_t i;
+
+	(void)mem_size;
+
+	for (i = 0; !thread_terminate && (i < MODEL_OPS); i++)
+		MEM_LOCK(counter, 1);
+	thread->duration += stress_time_now_ns() - t;
+	thread->ops += i;
+}
+#endif
+
+/*
+ *  stress_memthrash_remotestream()
+ *	each thread streams through its own slice of the buffer,
+ *	with the slice bound to the next NUMA node after the node
+ *	of the CPU the thread runs on
+ */
+static void HOT OPTIMIZE3 stress_memthrash_remotestream(
+	stress_memthrash_thread_t *thread,
+	const size_t mem_size)
+{
+	const stress_args_t *args = thread->args;
+	const size_t slice = (MEM_SIZE / thread->threads) & ~(args->page_size - 1);
+	const uint64_t *ptr = (uint64_t *)((uint8_t *)mem + (slice * thread->index));
+	const uint64_t *end = (const uint64_t *)((const uint8_t *)ptr + slice);
+	register uint64_t sum = 0;
+	double t;
+
+	(void)mem_size;
+
+	if (thread->node == MODEL_NODE_UNSET) {
+		int32_t local, remote;
+
+		remote = stress_numa_remote_node(&local);
+		if ((remote >= 0) &&
+		    (stress_numa_bind_node((void *)ptr, slice, remote) == 0))
+			thread->node = remote;
+		else
+			thread->node = local;
+		thread->local = local;
+	}
+
+	t = stress_time_now_ns();
+	while (!thread_terminate && (ptr < end)) {
+		sum += ptr[0] + ptr[1] + ptr[2] + ptr[3] +
+		       ptr[4] + ptr[5] + ptr[6] + ptr[7];
+		ptr += 8;
+	}
+	thread->duration += stress_time_now_ns() - t;
+	thread->bytes += (uint64_t)((const uint8_t *)ptr -
+		((const uint8_t *)end - slice));
+	thread->ops++;
+	stress_uint64_put(sum);
+}
+
 static void stress_memthrash_all(const stress_args_t *args, size_t mem_size);
 static void stress_memthrash_random(const stress_args_t *args, size_t mem_size);
 
 static const stress_memthrash_method_info_t memthrash_methods[] = {
-	{ "all",	stress_memthrash_all },		/* MUST always be first! */
-
-	{ "chunk1",	stress_memthrash_random_chunk1 },
-	{ "chunk8",	stress_memthrash_random_chunk8 },
-	{ "chunk64",	stress_memthrash_random_chunk64 },
-	{ "chunk256",	stress_memthrash_random_chunk256 },
-	{ "chunkpage",	stress_memthrash_random_chunkpage },
-	{ "flip",	stress_memthrash_flip_mem },
+	{ "all",	stress_memthrash_all,			NULL },		/* MUST always be first! */
+
+	{ "chunk1",	stress_memthrash_random_chunk1,		NULL },
+	{ "chunk8",	stress_memthrash_random_chunk8,		NULL },
+	{ "chunk64",	stress_memthrash_random_chunk64,	NULL },
+	{ "chunk256",	stress_memthrash_random_chunk256,	NULL },
+	{ "chunkpage",	stress_memthrash_random_chunkpage,	NULL },
+	{ "falseshare",	NULL,					stress_memthrash_falseshare },
+	{ "flip",	stress_memthrash_flip_mem,		NULL },
 #if defined(HAVE_ASM_X86_CLFLUSH)
-	{ "flush",	stress_memthrash_flush },
+	{ "flush",	stress_memthrash_flush,			NULL },
+#endif
+#if defined(MEM_LOCK)
+	{ "lock",	stress_memthrash_lock,			NULL },
 #endif
+	{ "matrix",	stress_memthrash_matrix,		NULL },
+	{ "memmove",	stress_memthrash_memmove,		NULL },
+	{ "memset",	stress_memthrash_memset,		NULL },
+	{ "mfence",	stress_memthrash_mfence,		NULL },
+	{ "prefetch",	stress_memthrash_prefetch,		NULL },
+	{ "random",	stress_memthrash_random,		NULL },
+	{ "remotestream", NULL,					stress_memthrash_remotestream },
+	{ "spinread",	stress_memthrash_spinread,		NULL },
+	{ "spinwrite",	stress_memthrash_spinwrite,		NULL },
+	{ "swap",	stress_memthrash_swap,			NULL },
 #if defined(MEM_LOCK)
-	{ "lock",	stress_memthrash_lock },
+	{ "trueshare",	NULL,					stress_memthrash_trueshare },
 #endif
-	{ "matrix",	stress_memthrash_matrix },
-	{ "memmove",	stress_memthrash_memmove },
-	{ "memset",	stress_memthrash_memset },
-	{ "mfence",	stress_memthrash_mfence },
-	{ "prefetch",	stress_memthrash_prefetch },
-	{ "random",	stress_memthrash_random },
-	{ "spinread",	stress_memthrash_spinread },
-	{ "spinwrite",	stress_memthrash_spinwrite },
-	{ "swap",	stress_memthrash_swap }
 };
 
+/*
+ *  stress_memthrash_all()
+ *	run each method in turn, the contention models are skipped
+ *	as they only make sense when all the threads run them at once
+ */
 static void stress_memthrash_all(const stress_args_t *args, size_t mem_size)
 {
 	static size_t i = 1;
 	const double t = stress_time_now();
 
+	while (!memthrash_methods[i].func) {
+		i++;
+		if (UNLIKELY(i >= SIZEOF_ARRAY(memthrash_methods)))
+			i = 1;
+	}
 	do {
 		memthrash_methods[i].func(args, mem_size);
 	} while (!thread_terminate && (stress_time_now() - t < 0.01));
@@ -415,8 +547,12 @@ static void stress_memthrash_random(const stress_args_t *args, size_t mem_size)
 		size_t i = stress_mwc8() % SIZEOF_ARRAY(memthrash_methods);
 		const stress_memthrash_func_t func = (stress_memthrash_func_t)memthrash_methods[i].func;
 
-		/* Don't run stress_memthrash_random/all to avoid recursion */
-		if ((func != stress_memthrash_random) &&
+		/*
+		 *  Don't run stress_memthrash_random/all to avoid recursion,
+		 *  or the contention models that have no func
+		 */
+		if (func &&
+		    (func != stress_memthrash_random) &&
 		    (func != stress_memthrash_all)) {
 			func(args, mem_size);
 			return;
@@ -449,16 +585,21 @@ static int stress_set_memthrash_method(const char *name)
 	return -1;
 }
 
+static inline char *plural(uint32_t n)
+{
+	return n > 1 ? "s" : "";
+}
+
 /*
  *  stress_memthrash_func()
- *	pthread that exits immediately
+ *	pthread that runs the memthrash method
  */
 static void *stress_memthrash_func(void *arg)
 {
 	static void *nowt = NULL;
-	const stress_pthread_args_t *parg = (stress_pthread_args_t *)arg;
-	const stress_args_t *args = parg->args;
-	const stress_memthrash_func_t func = (stress_memthrash_func_t)parg->data;
+	stress_memthrash_thread_t *thread = (stress_memthrash_thread_t *)arg;
+	const stress_args_t *args = thread->args;
+	const stress_memthrash_method_info_t *info = thread->info;
 
 	/*
 	 *  Block all signals, let controlling thread
@@ -466,6 +607,16 @@ static void *stress_memthrash_func(void *arg)
 	 */
 	(void)sigprocmask(SIG_BLOCK, &set, NULL);
 
+#if defined(HAVE_AFFINITY)
+	if (thread->cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(thread->cpu, &mask);
+		(void)sched_setaffinity(0, sizeof(mask), &mask);
+	}
+#endif
+
 	while (!thread_terminate && keep_stressing(args)) {
 		size_t j;
 
@@ -473,11 +624,10 @@ static void *stress_memthrash_func(void *arg)
 		     !thread_terminate && keep_stressing(args); j++) {
 			size_t mem_size = 1 << (2 * j);
 
-			size_t i;
-			for (i = 0; i < SIZEOF_ARRAY(memthrash_methods); i++)
-				if (func == memthrash_methods[i].func)
-					break;
-			func(args, mem_size);
+			if (info->model)
+				info->model(thread, mem_size);
+			else
+				info->func(args, mem_size);
 			inc_counter(args);
 			shim_sched_yield();
 		}
@@ -488,6 +638,75 @@ static void *stress_memthrash_func(void *arg)
 	return &nowt;
 }
 
+/*
+ *  stress_memthrash_report()
+ *	report the contention model latency or bandwidth
+ */
+static void stress_memthrash_report(
+	const stress_args_t *args,
+	const stress_memthrash_thread_t *threads,
+	const uint32_t max_threads)
+{
+	const stress_memthrash_method_info_t *info = threads[0].info;
+	uint64_t ops = 0;
+	double duration = 0.0, rate = 0.0;
+	uint32_t i;
+	bool lock = false;
+
+	for (i = 0; i < max_threads; i++) {
+		const stress_memthrash_thread_t *t = &threads[i];
+
+		if (t->duration <= 0.0)
+			continue;
+		ops += t->ops;
+		duration += t->duration;
+		/* Summed over the threads as they run at the same time */
+		if (info->model == stress_memthrash_remotestream)
+			rate += ((double)t->bytes * 1000000000.0) / (t->duration * (double)MB);
+		else
+			rate += ((double)t->ops * 1000.0) / t->duration;
+	}
+	if (!ops)
+		return;
+
+	if (info->model == stress_memthrash_remotestream) {
+		stress_misc_stats_set(args->misc_stats, 0, "MB per sec", rate);
+	} else {
+		stress_misc_stats_set(args->misc_stats, 0, "nanosecs per op", duration / (double)ops);
+		stress_misc_stats_set(args->misc_stats, 1, "M ops per sec", rate);
+	}
+	if (args->instance != 0)
+		return;
+
+	pr_lock(&lock);
+	for (i = 0; i < max_threads; i++) {
+		const stress_memthrash_thread_t *t = &threads[i];
+
+		if (t->duration <= 0.0)
+			continue;
+		if (info->model == stress_memthrash_remotestream) {
+			pr_inf_lock(&lock, "%s: %s thread %" PRIu32 " on CPU %" PRId32
+				" (node %" PRId32 ") streaming from node %" PRId32
+				": %.2f MB/sec\n", args->name, info->name, i, t->cpu,
+				t->local, t->node, ((double)t->bytes * 1000000000.0) /
+				(t->duration * (double)MB));
+		} else {
+			pr_dbg_lock(&lock, "%s: %s thread %" PRIu32 " on CPU %" PRId32
+				": %.2f nanosecs per op\n", args->name, info->name,
+				i, t->cpu, t->duration / (double)t->ops);
+		}
+	}
+	if (info->model == stress_memthrash_remotestream) {
+		pr_inf_lock(&lock, "%s: %s %.2f MB/sec over %" PRIu32 " thread%s\n",
+			args->name, info->name, rate, max_threads, plural(max_threads));
+	} else {
+		pr_inf_lock(&lock, "%s: %s %.2f nanosecs per op, %.2f M ops/sec "
+			"over %" PRIu32 " thread%s\n", args->name, info->name,
+			duration / (double)ops, rate, max_threads, plural(max_threads));
+	}
+	pr_unlock(&lock);
+}
+
 static inline uint32_t stress_memthrash_max(
 	const uint32_t instances,
 	const uint32_t total_cpus)
@@ -515,11 +734,6 @@ static inline uint32_t stress_memthash_optimal(
 	return 1;
 }
 
-static inline char *plural(uint32_t n)
-{
-	return n > 1 ? "s" : "";
-}
-
 static void stress_memthrash_sigalrm_handler(int signum)
 {
 	(void)signum;
@@ -534,7 +748,8 @@ static int stress_memthrash_child(const stress_args_t *args, void *ctxt)
 	uint32_t i;
 	pthread_t pthreads[max_threads];
 	int pthreads_ret[max_threads], ret;
-	stress_pthread_args_t pargs;
+	stress_memthrash_thread_t threads[max_threads];
+	int32_t cpus[max_threads], ncpus = 0;
 
 	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 #if defined(MAP_POPULATE)
@@ -544,8 +759,25 @@ static int stress_memthrash_child(const stress_args_t *args, void *ctxt)
 	ret = stress_sighandler(args->name, SIGALRM, stress_memthrash_sigalrm_handler, NULL);
 	(void)ret;
 
-	pargs.args = args;
-	pargs.data = (void *)context->memthrash_method->func;
+#if defined(HAVE_AFFINITY)
+	/* The contention models pin each thread, spread over the sockets */
+	if (context->memthrash_method->model) {
+		cpu_set_t mask;
+
+		if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+			ncpus = stress_cpus_interleave_packages(&mask, cpus,
+				(int32_t)max_threads);
+	}
+#endif
+	(void)memset(threads, 0, sizeof(threads));
+	for (i = 0; i < max_threads; i++) {
+		threads[i].args = args;
+		threads[i].info = context->memthrash_method;
+		threads[i].index = i;
+		threads[i].threads = max_threads;
+		threads[i].cpu = ncpus ? cpus[i % (uint32_t)ncpus] : -1;
+		threads[i].node = MODEL_NODE_UNSET;
+	}
 
 	(void)memset(pthreads, 0, sizeof(pthreads));
 	(void)memset(pthreads_ret, 0, sizeof(pthreads_ret));
@@ -569,7 +801,7 @@ mmap_retry:
 
 	for (i = 0; i < max_threads; i++) {
 		pthreads_ret[i] = pthread_create(&pthreads[i], NULL,
-				stress_memthrash_func, (void *)&pargs);
+				stress_memthrash_func, (void *)&threads[i]);
 		if (pthreads_ret[i]) {
 			/* Just give up and go to next thread */
 			if (pthreads_ret[i] == EAGAIN)
@@ -596,6 +828,8 @@ reap:
 			}
 		}
 	}
+	if (context->memthrash_method->model)
+		stress_memthrash_report(args, threads, max_threads);
 reap_mem:
 	(void)munmap(mem, MEM_SIZE);
 
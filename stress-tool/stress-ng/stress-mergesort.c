@@ -28,6 +28,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"mergesort N",		"start N workers merge sorting 32 bit random integers" },
 	{ NULL,	"mergesort-ops N",	"stop after N merge sort bogo operations" },
 	{ NULL,	"mergesort-size N",	"number of 32 bit integers to sort" },
+	{ NULL,	"mergesort-threads N",	"merge sort on N threads with sorting network blocks" },
+	{ NULL,	"mergesort-elem-size N","parallel sort 4 or 8 byte integers" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -50,8 +52,20 @@ static int stress_set_mergesort_size(const char *opt)
 	return stress_set_setting("mergesort-size", TYPE_ID_UINT64, &mergesort_size);
 }
 
+static int stress_set_mergesort_threads(const char *opt)
+{
+	return stress_set_sort_threads("mergesort-threads", opt);
+}
+
+static int stress_set_mergesort_elem_size(const char *opt)
+{
+	return stress_set_sort_elem_size("mergesort-elem-size", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_mergesort_integers,	stress_set_mergesort_size },
+	{ OPT_mergesort_threads,	stress_set_mergesort_threads },
+	{ OPT_mergesort_elem_size,	stress_set_mergesort_elem_size },
 	{ 0,				NULL }
 };
 
@@ -115,25 +129,16 @@ static int stress_mergesort_cmp_3(const void *p1, const void *p2)
 }
 
 /*
- *  stress_mergesort()
- *	stress mergesort
+ *  stress_mergesort_libbsd()
+ *	stress the libbsd mergesort
  */
-static int stress_mergesort(const stress_args_t *args)
+static int stress_mergesort_libbsd(const stress_args_t *args, const size_t n)
 {
-	uint64_t mergesort_size = DEFAULT_MERGESORT_SIZE;
 	int32_t *data, *ptr;
-	size_t n, i;
+	size_t i;
 	struct sigaction old_action;
 	int ret;
 
-	if (!stress_get_setting("mergesort-size", &mergesort_size)) {
-		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
-			mergesort_size = MAX_MERGESORT_SIZE;
-		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
-			mergesort_size = MIN_MERGESORT_SIZE;
-	}
-	n = (size_t)mergesort_size;
-
 	if ((data = calloc(n, sizeof(*data))) == NULL) {
 		pr_fail("%s: malloc failed, out of memory\n", args->name);
 		return EXIT_NO_RESOURCE;
@@ -237,17 +242,40 @@ tidy:
 	return EXIT_SUCCESS;
 }
 
-stressor_info_t stress_mergesort_info = {
-	.stressor = stress_mergesort,
-	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
-	.opt_set_funcs = opt_set_funcs,
-	.help = help
-};
+#endif
+
+/*
+ *  stress_mergesort()
+ *	stress mergesort, the parallel mode does not need libbsd
+ */
+static int stress_mergesort(const stress_args_t *args)
+{
+	uint64_t mergesort_size = DEFAULT_MERGESORT_SIZE;
+	size_t n, elem_size = sizeof(uint32_t);
+	uint32_t threads = 0;
+
+	if (!stress_get_setting("mergesort-size", &mergesort_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			mergesort_size = MAX_MERGESORT_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			mergesort_size = MIN_MERGESORT_SIZE;
+	}
+	n = (size_t)mergesort_size;
+
+	(void)stress_get_setting("mergesort-threads", &threads);
+	(void)stress_get_setting("mergesort-elem-size", &elem_size);
+	if (threads)
+		return stress_sort_threads(args, n, elem_size, threads, STRESS_SORT_MERGE);
+#if defined(HAVE_LIB_BSD)
+	return stress_mergesort_libbsd(args, n);
 #else
+	return stress_not_implemented(args);
+#endif
+}
+
 stressor_info_t stress_mergesort_info = {
-	.stressor = stress_not_implemented,
+	.stressor = stress_mergesort,
 	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
 	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
-#endif
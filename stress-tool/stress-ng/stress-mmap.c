@@ -33,6 +33,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"mmap-mprotect", "enable mmap mprotect stressing" },
 	{ NULL, "mmap-osync",	 "enable O_SYNC on file" },
 	{ NULL, "mmap-odirect",	 "enable O_DIRECT on file" },
+	{ NULL,	"mmap-threads N", "fault, mmap, munmap and mprotect from N threads in one mm" },
 	{ NULL,	NULL,		 NULL }
 };
 
@@ -46,11 +47,55 @@ typedef struct {
 	bool mmap_mprotect;
 	bool mmap_file;
 	bool mmap_async;
+	size_t mmap_threads;
 	mmap_func_t mmap;
 } stress_mmap_context_t;
 
 #define NO_MEM_RETRIES_MAX	(65536)
 
+#define MMAP_THREADS_MAX	(64)
+#define MMAP_THREAD_FAULT_PAGES	(16)		/* pages zapped and re-faulted per op */
+#define MMAP_THREAD_MAP_PAGES	(16)		/* pages in each transient mapping */
+#define MMAP_THREAD_BASELINE	(100000000.0)	/* uncontended baseline, nanoseconds */
+
+#define MMAP_LAT_FAULT		(0)
+#define MMAP_LAT_MMAP		(1)
+#define MMAP_LAT_MUNMAP		(2)
+#define MMAP_LAT_MPROTECT	(3)
+#define MMAP_LAT_MAX		(4)
+
+#define MMAP_VMA_LOCK_SUCCESS	(0)
+#define MMAP_VMA_LOCK_ABORT	(1)
+#define MMAP_VMA_LOCK_RETRY	(2)
+#define MMAP_VMA_LOCK_MISS	(3)
+#define MMAP_VMA_LOCK_MAX	(4)
+
+typedef struct {
+	uint64_t count;
+	double total;		/* nanoseconds */
+	double max;		/* nanoseconds */
+} stress_mmap_lat_t;
+
+typedef struct {
+	const stress_args_t *args;
+	uint8_t *slice;		/* pages this thread faults and mprotects */
+	size_t slice_pages;
+	volatile bool *run;
+	uint64_t ops;
+	stress_mmap_lat_t lat[MMAP_LAT_MAX];
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthread;
+	int ret;
+#endif
+} stress_mmap_thread_t;
+
+static const char * const mmap_lat_names[MMAP_LAT_MAX] = {
+	"fault",
+	"mmap",
+	"munmap",
+	"mprotect",
+};
+
 /* Misc randomly chosen mmap flags */
 static const int mmap_flags[] = {
 #if defined(MAP_HUGE_2MB) &&	\
@@ -216,6 +261,16 @@ static int stress_set_mmap_odirect(const char *opt)
 	return stress_set_setting("mmap-odirect", TYPE_ID_BOOL, &mmap_odirect);
 }
 
+static int stress_set_mmap_threads(const char *opt)
+{
+	size_t mmap_threads;
+
+	mmap_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("mmap-threads", (uint64_t)mmap_threads,
+		1, MMAP_THREADS_MAX);
+	return stress_set_setting("mmap-threads", TYPE_ID_SIZE_T, &mmap_threads);
+}
+
 static int stress_set_mmap_mmap2(const char *opt)
 {
 	bool mmap_mmap2 = true;
@@ -322,6 +377,332 @@ static void stress_mmap_invalid(
 		(void)munmap(ptr, length);
 }
 
+static inline void stress_mmap_lat_add(stress_mmap_lat_t *lat, const double t)
+{
+	lat->count++;
+	lat->total += t;
+	if (t > lat->max)
+		lat->max = t;
+}
+
+static inline double stress_mmap_lat_avg(const stress_mmap_lat_t *lat)
+{
+	return lat->count ? lat->total / (double)lat->count : 0.0;
+}
+
+/*
+ *  stress_mmap_thread_ops()
+ *	one round of re-faulting pages, a transient mmap and munmap
+ *	and an mprotect round trip, each timed. The faults take
+ *	mmap_lock (or the per-VMA lock) for read, the others for write
+ */
+static void stress_mmap_thread_ops(stress_mmap_thread_t *t, const size_t page_size)
+{
+	const size_t len = MMAP_THREAD_FAULT_PAGES * page_size;
+	uint8_t *addr, *map;
+	double t0, t1;
+	size_t i;
+
+	addr = t->slice + (stress_mwc32() % (t->slice_pages - MMAP_THREAD_FAULT_PAGES + 1)) * page_size;
+#if defined(MADV_DONTNEED)
+	/* zap the pages so that each first touch is a page fault */
+	if (shim_madvise((void *)addr, len, MADV_DONTNEED) == 0) {
+		for (i = 0; i < len; i += page_size) {
+			t0 = stress_time_now_ns();
+			*(volatile uint8_t *)(addr + i) = (uint8_t)i;
+			t1 = stress_time_now_ns();
+			stress_mmap_lat_add(&t->lat[MMAP_LAT_FAULT], t1 - t0);
+		}
+	}
+#else
+	(void)len;
+	(void)i;
+#endif
+
+	t0 = stress_time_now_ns();
+	map = (uint8_t *)mmap(NULL, MMAP_THREAD_MAP_PAGES * page_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	t1 = stress_time_now_ns();
+	if (map != MAP_FAILED) {
+		stress_mmap_lat_add(&t->lat[MMAP_LAT_MMAP], t1 - t0);
+		*(volatile uint8_t *)map = 1;
+		t0 = stress_time_now_ns();
+		(void)munmap((void *)map, MMAP_THREAD_MAP_PAGES * page_size);
+		t1 = stress_time_now_ns();
+		stress_mmap_lat_add(&t->lat[MMAP_LAT_MUNMAP], t1 - t0);
+	}
+
+#if defined(HAVE_MPROTECT)
+	/* splits then re-merges the VMA the other threads fault in */
+	addr = t->slice + (stress_mwc32() % t->slice_pages) * page_size;
+	t0 = stress_time_now_ns();
+	if (mprotect((void *)addr, page_size, PROT_READ) == 0) {
+		t1 = stress_time_now_ns();
+		stress_mmap_lat_add(&t->lat[MMAP_LAT_MPROTECT], t1 - t0);
+		t0 = stress_time_now_ns();
+		if (mprotect((void *)addr, page_size, PROT_READ | PROT_WRITE) == 0) {
+			t1 = stress_time_now_ns();
+			stress_mmap_lat_add(&t->lat[MMAP_LAT_MPROTECT], t1 - t0);
+		}
+	}
+#endif
+	t->ops++;
+}
+
+/*
+ *  stress_mmap_vma_lock_stats()
+ *	read the per-VMA lock fault counters (CONFIG_PER_VMA_LOCK_STATS),
+ *	returns false if the kernel does not provide them
+ */
+static bool stress_mmap_vma_lock_stats(uint64_t stats[MMAP_VMA_LOCK_MAX])
+{
+	static const char * const names[MMAP_VMA_LOCK_MAX] = {
+		"vma_lock_success",
+		"vma_lock_abort",
+		"vma_lock_retry",
+		"vma_lock_miss",
+	};
+	char buffer[128];
+	FILE *fp;
+	size_t i;
+	int found = 0;
+
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return false;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		for (i = 0; i < MMAP_VMA_LOCK_MAX; i++) {
+			const size_t len = strlen(names[i]);
+
+			if (!strncmp(buffer, names[i], len) && (buffer[len] == ' ')) {
+				stats[i] = (uint64_t)strtoull(buffer + len + 1, NULL, 10);
+				found |= 1 << i;
+			}
+		}
+	}
+	(void)fclose(fp);
+
+	return found == (1 << MMAP_VMA_LOCK_MAX) - 1;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  stress_mmap_thread()
+ *	run the ops until the controlling thread stops us
+ */
+static void *stress_mmap_thread(void *ptr)
+{
+	static void *nowt = NULL;
+	stress_mmap_thread_t *t = (stress_mmap_thread_t *)ptr;
+	const size_t page_size = t->args->page_size;
+	sigset_t set;
+
+	/*
+	 *  Block all signals, let controlling thread
+	 *  handle these
+	 */
+	(void)sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	while (*t->run && keep_stressing_flag())
+		stress_mmap_thread_ops(t, page_size);
+
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_mmap_threads_report()
+ *	report contended latencies against the uncontended baseline,
+ *	the excess for the write lock ops estimates the mmap_lock wait
+ */
+static void stress_mmap_threads_report(
+	const stress_args_t *args,
+	const size_t n_threads,
+	const stress_mmap_lat_t *base,
+	const stress_mmap_lat_t *lat,
+	const double duration,
+	const bool vma_stats,
+	const uint64_t *vma_begin,
+	const uint64_t *vma_end)
+{
+	bool lock = false;
+	double wait_total = 0.0, vma_pct = -1.0;
+	uint64_t wait_count = 0;
+	int i;
+
+	for (i = MMAP_LAT_MMAP; i < MMAP_LAT_MAX; i++) {
+		const double excess = stress_mmap_lat_avg(&lat[i]) - stress_mmap_lat_avg(&base[i]);
+
+		if (!lat[i].count || !base[i].count)
+			continue;
+		wait_total += STRESS_MAXIMUM(excess, 0.0) * (double)lat[i].count;
+		wait_count += lat[i].count;
+	}
+	if (vma_stats) {
+		const uint64_t success = vma_end[MMAP_VMA_LOCK_SUCCESS] - vma_begin[MMAP_VMA_LOCK_SUCCESS];
+		const uint64_t total = success +
+			(vma_end[MMAP_VMA_LOCK_ABORT] - vma_begin[MMAP_VMA_LOCK_ABORT]) +
+			(vma_end[MMAP_VMA_LOCK_MISS] - vma_begin[MMAP_VMA_LOCK_MISS]);
+
+		if (total)
+			vma_pct = 100.0 * (double)success / (double)total;
+	}
+
+	if (args->instance == 0) {
+		pr_lock(&lock);
+		pr_inf_lock(&lock, "%s: %zu threads in one mm, latencies in microseconds, "
+			"uncontended baseline in brackets\n", args->name, n_threads);
+		for (i = 0; i < MMAP_LAT_MAX; i++) {
+			pr_inf_lock(&lock, "%s: %-8s avg %9.2f (%9.2f) max %10.2f, %12.2f ops/sec\n",
+				args->name, mmap_lat_names[i],
+				stress_mmap_lat_avg(&lat[i]) / 1000.0,
+				stress_mmap_lat_avg(&base[i]) / 1000.0,
+				lat[i].max / 1000.0,
+				(duration > 0.0) ? (double)lat[i].count / duration : 0.0);
+		}
+		pr_inf_lock(&lock, "%s: estimated mmap_lock wait %.2f us per mmap, munmap "
+			"and mprotect\n", args->name,
+			wait_count ? (wait_total / (double)wait_count) / 1000.0 : 0.0);
+		if (!vma_stats) {
+			pr_inf_lock(&lock, "%s: per-VMA lock fault counters not available "
+				"(needs CONFIG_PER_VMA_LOCK_STATS)\n", args->name);
+		} else if (vma_pct >= 0.0) {
+			pr_inf_lock(&lock, "%s: %.1f%% of faults system wide handled under "
+				"the per-VMA lock, %" PRIu64 " retries\n", args->name, vma_pct,
+				vma_end[MMAP_VMA_LOCK_RETRY] - vma_begin[MMAP_VMA_LOCK_RETRY]);
+		}
+		pr_unlock(&lock);
+	}
+
+	stress_misc_stats_set(args->misc_stats, 0, "fault avg latency (us)",
+		stress_mmap_lat_avg(&lat[MMAP_LAT_FAULT]) / 1000.0);
+	stress_misc_stats_set(args->misc_stats, 1, "fault max latency (us)",
+		lat[MMAP_LAT_FAULT].max / 1000.0);
+	stress_misc_stats_set(args->misc_stats, 2, "mmap avg latency (us)",
+		stress_mmap_lat_avg(&lat[MMAP_LAT_MMAP]) / 1000.0);
+	stress_misc_stats_set(args->misc_stats, 3, "munmap avg latency (us)",
+		stress_mmap_lat_avg(&lat[MMAP_LAT_MUNMAP]) / 1000.0);
+	stress_misc_stats_set(args->misc_stats, 4, "mprotect avg latency (us)",
+		stress_mmap_lat_avg(&lat[MMAP_LAT_MPROTECT]) / 1000.0);
+	stress_misc_stats_set(args->misc_stats, 5, "est. mmap_lock wait (us)",
+		wait_count ? (wait_total / (double)wait_count) / 1000.0 : 0.0);
+	if (vma_pct >= 0.0)
+		stress_misc_stats_set(args->misc_stats, 6, "per-VMA lock faults %", vma_pct);
+}
+
+/*
+ *  stress_mmap_threads()
+ *	threads concurrently fault, mmap, munmap and mprotect in the
+ *	same address space to contend on mmap_lock
+ */
+static int stress_mmap_threads(const stress_args_t *args, stress_mmap_context_t *context)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	const size_t page_size = args->page_size;
+	const size_t n_threads = context->mmap_threads;
+	size_t slice_pages = (context->sz / page_size) / n_threads;
+	size_t i, region_sz, created = 0;
+	stress_mmap_thread_t *threads, base;
+	stress_mmap_lat_t lat[MMAP_LAT_MAX];
+	uint64_t vma_begin[MMAP_VMA_LOCK_MAX], vma_end[MMAP_VMA_LOCK_MAX];
+	volatile bool run = true;
+	bool vma_stats;
+	uint8_t *region;
+	double t_start, t_end;
+	int j;
+
+	if (slice_pages < MMAP_THREAD_FAULT_PAGES)
+		slice_pages = MMAP_THREAD_FAULT_PAGES;
+	region_sz = slice_pages * n_threads * page_size;
+	region = (uint8_t *)mmap(NULL, region_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu bytes, skipping stressor, errno=%d (%s)\n",
+			args->name, region_sz, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	threads = calloc(n_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf_skip("%s: cannot allocate %zu thread contexts, skipping stressor\n",
+			args->name, n_threads);
+		(void)munmap((void *)region, region_sz);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(region, 0, region_sz);
+
+	/* uncontended baseline, this thread on its own */
+	(void)memset(&base, 0, sizeof(base));
+	base.args = args;
+	base.slice = region;
+	base.slice_pages = slice_pages;
+	t_end = stress_time_now_ns() + MMAP_THREAD_BASELINE;
+	while (keep_stressing_flag() && (stress_time_now_ns() < t_end))
+		stress_mmap_thread_ops(&base, page_size);
+
+	vma_stats = stress_mmap_vma_lock_stats(vma_begin);
+	t_start = stress_time_now_ns();
+	for (i = 0; i < n_threads; i++) {
+		threads[i].args = args;
+		threads[i].slice = region + (i * slice_pages * page_size);
+		threads[i].slice_pages = slice_pages;
+		threads[i].run = &run;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_mmap_thread, (void *)&threads[i]);
+		if (threads[i].ret == 0)
+			created++;
+	}
+	if (!created) {
+		pr_inf_skip("%s: cannot create any threads, skipping stressor\n", args->name);
+		free(threads);
+		(void)munmap((void *)region, region_sz);
+		return EXIT_NO_RESOURCE;
+	}
+
+	while (keep_stressing(args)) {
+		uint64_t ops = 0;
+
+		(void)shim_usleep(100000);
+		for (i = 0; i < n_threads; i++)
+			ops += threads[i].ops;
+		set_counter(args, ops);
+	}
+	run = false;
+	for (i = 0; i < n_threads; i++) {
+		if (threads[i].ret == 0)
+			(void)pthread_join(threads[i].pthread, NULL);
+	}
+	t_end = stress_time_now_ns();
+	if (vma_stats)
+		vma_stats = stress_mmap_vma_lock_stats(vma_end);
+
+	(void)memset(lat, 0, sizeof(lat));
+	for (i = 0; i < n_threads; i++) {
+		for (j = 0; j < MMAP_LAT_MAX; j++) {
+			const stress_mmap_lat_t *l = &threads[i].lat[j];
+
+			lat[j].count += l->count;
+			lat[j].total += l->total;
+			lat[j].max = STRESS_MAXIMUM(lat[j].max, l->max);
+		}
+	}
+	stress_mmap_threads_report(args, created, base.lat, lat,
+		(t_end - t_start) / 1000000000.0, vma_stats, vma_begin, vma_end);
+
+	free(threads);
+	(void)munmap((void *)region, region_sz);
+
+	return EXIT_SUCCESS;
+#else
+	(void)context;
+
+	if (args->instance == 0)
+		pr_inf_skip("%s: --mmap-threads needs pthread support, skipping stressor\n",
+			args->name);
+	return EXIT_NOT_IMPLEMENTED;
+#endif
+}
+
 static int stress_mmap_child(const stress_args_t *args, void *ctxt)
 {
 	stress_mmap_context_t *context = (stress_mmap_context_t *)ctxt;
@@ -336,6 +717,9 @@ static int stress_mmap_child(const stress_args_t *args, void *ctxt)
 	uint8_t *mapped, **mappings;
 	void *hint;
 
+	if (context->mmap_threads)
+		return stress_mmap_threads(args, context);
+
 	mapped = calloc(pages4k, sizeof(*mapped));
 	if (!mapped) {
 		pr_dbg("%s: cannot allocate mapped buffer: %d (%s)\n",
@@ -629,6 +1013,7 @@ static int stress_mmap(const stress_args_t *args)
 	context.mmap_async = false;
 	context.mmap_file = false;
 	context.mmap_mprotect = false;
+	context.mmap_threads = 0;
 	context.flags = MAP_PRIVATE | MAP_ANONYMOUS;
 #if defined(MAP_POPULATE)
 	context.flags |= MAP_POPULATE;
@@ -640,6 +1025,7 @@ static int stress_mmap(const stress_args_t *args)
 	(void)stress_get_setting("mmap-osync", &mmap_osync);
 	(void)stress_get_setting("mmap-odirect", &mmap_odirect);
 	(void)stress_get_setting("mmap-mmap2", &mmap_mmap2);
+	(void)stress_get_setting("mmap-threads", &context.mmap_threads);
 
 	if (mmap_osync || mmap_odirect)
 		context.mmap_file = true;
@@ -757,6 +1143,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_mmap_osync,	stress_set_mmap_osync },
 	{ OPT_mmap_odirect,	stress_set_mmap_odirect },
 	{ OPT_mmap_mmap2,	stress_set_mmap_mmap2 },
+	{ OPT_mmap_threads,	stress_set_mmap_threads },
 	{ 0,			NULL }
 };
 
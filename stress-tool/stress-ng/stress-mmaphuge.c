@@ -28,6 +28,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"mmaphuge N",		"start N workers stressing mmap with huge mappings" },
 	{ NULL,	"mmaphuge-ops N",	"stop after N mmaphuge bogo operations" },
 	{ NULL, "mmaphuge-mmaps N",	"select number of memory mappings per iteration" },
+	{ NULL, "mmaphuge-measure",	"measure THP fault, collapse, 1GB page and compaction rates" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -45,8 +46,22 @@ static int stress_set_mmaphuge_mmaps(const char *opt)
 	return stress_set_setting("mmaphuge-mmaps", TYPE_ID_SIZE_T, &mmaphuge_mmaps);
 }
 
+/*
+ *  stress_set_mmaphuge_measure()
+ *      measure huge page performance rather than thrash mappings
+ */
+static int stress_set_mmaphuge_measure(const char *opt)
+{
+	bool mmaphuge_measure = true;
+
+	(void)opt;
+
+	return stress_set_setting("mmaphuge-measure", TYPE_ID_BOOL, &mmaphuge_measure);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_mmaphuge_mmaps,  stress_set_mmaphuge_mmaps },
+	{ OPT_mmaphuge_measure, stress_set_mmaphuge_measure },
 	{ 0,                    NULL }
 };
 
@@ -196,6 +211,380 @@ static int stress_mmaphuge_child(const stress_args_t *args, void *v_ctxt)
 	return EXIT_SUCCESS;
 }
 
+#define THP_SIZE_PATH		"/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"
+#define KHUGEPAGED_PATH		"/sys/kernel/mm/transparent_hugepage/khugepaged/"
+#define MEASURE_REGION_SIZE	(64 * MB)
+#define MEASURE_FRAG_SIZE	(256 * MB)
+
+#if !defined(MADV_COLLAPSE)
+#define MADV_COLLAPSE		(25)
+#endif
+
+typedef struct {
+	double thp_time;	/* seconds faulting in THP regions */
+	double thp_bytes;	/* bytes faulted in */
+	double thp_huge;	/* bytes of which are huge page backed */
+	uint64_t thp_faults;	/* page faults taken */
+	double collapse_time;	/* seconds in MADV_COLLAPSE */
+	uint64_t collapsed;	/* huge pages collapsed */
+	double gb_time;		/* seconds mapping and faulting 1GB pages */
+	uint64_t gb_maps;	/* 1GB hugetlb pages mapped */
+	uint64_t gb_fails;	/* 1GB hugetlb mappings that failed */
+	double compact_time;	/* seconds compacting memory */
+	uint64_t compacts;	/* compactions */
+	double frag_bytes;	/* bytes faulted in when fragmented */
+	double frag_huge;	/* bytes of which are huge page backed */
+	bool collapse_ok;	/* MADV_COLLAPSE is supported */
+	bool compact_ok;	/* compaction can be triggered */
+} stress_mmaphuge_measure_t;
+
+/*
+ *  stress_mmaphuge_read_uint64()
+ *	read a numeric value from a /sys file, 0 if it cannot be read
+ */
+static uint64_t stress_mmaphuge_read_uint64(const char *path)
+{
+	char buf[64];
+	uint64_t val = 0;
+
+	if (system_read(path, buf, sizeof(buf)) > 0)
+		(void)sscanf(buf, "%" SCNu64, &val);
+	return val;
+}
+
+/*
+ *  stress_mmaphuge_huge_bytes()
+ *	bytes of the mapping containing addr that are backed by
+ *	transparent huge pages
+ */
+static double stress_mmaphuge_huge_bytes(const void *addr)
+{
+	FILE *fp;
+	char buf[256];
+	bool found = false;
+	uint64_t kb = 0;
+
+	fp = fopen("/proc/self/smaps", "r");
+	if (!fp)
+		return 0.0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		uintptr_t start, end;
+
+		if (sscanf(buf, "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2) {
+			found = ((uintptr_t)addr >= start) && ((uintptr_t)addr < end);
+			continue;
+		}
+		if (found && !strncmp(buf, "AnonHugePages:", 14)) {
+			(void)sscanf(buf + 14, "%" SCNu64, &kb);
+			break;
+		}
+	}
+	(void)fclose(fp);
+	return (double)kb * (double)KB;
+}
+
+/*
+ *  stress_mmaphuge_aligned()
+ *	mmap sz bytes aligned to the huge page size so that the
+ *	whole mapping can be backed by transparent huge pages
+ */
+static uint8_t *stress_mmaphuge_aligned(const size_t sz, const size_t hpsz)
+{
+	uint8_t *buf, *aligned;
+	size_t head;
+
+	buf = (uint8_t *)mmap(NULL, sz + hpsz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return NULL;
+	head = (hpsz - ((uintptr_t)buf & (hpsz - 1))) & (hpsz - 1);
+	aligned = buf + head;
+	if (head)
+		(void)munmap((void *)buf, head);
+	if (hpsz - head)
+		(void)munmap((void *)(aligned + sz), hpsz - head);
+	return aligned;
+}
+
+/*
+ *  stress_mmaphuge_thp_fault()
+ *	fault in a MADV_HUGEPAGE region a small page at a time,
+ *	accounting the time, faults and how much of it ended
+ *	up huge page backed
+ */
+static void stress_mmaphuge_thp_fault(
+	const stress_args_t *args,
+	const size_t sz,
+	const size_t hpsz,
+	double *bytes,
+	double *huge,
+	double *duration,
+	uint64_t *faults)
+{
+	struct rusage before, after;
+	uint8_t *buf;
+	size_t i;
+	double t;
+
+	buf = stress_mmaphuge_aligned(sz, hpsz);
+	if (!buf)
+		return;
+#if defined(MADV_HUGEPAGE)
+	(void)shim_madvise((void *)buf, sz, MADV_HUGEPAGE);
+#endif
+	(void)shim_getrusage(RUSAGE_SELF, &before);
+	t = stress_time_now();
+	for (i = 0; i < sz; i += args->page_size)
+		buf[i] = (uint8_t)i;
+	t = stress_time_now() - t;
+	(void)shim_getrusage(RUSAGE_SELF, &after);
+
+	*bytes += (double)sz;
+	*huge += stress_mmaphuge_huge_bytes(buf);
+	if (duration)
+		*duration += t;
+	if (faults && (after.ru_minflt > before.ru_minflt))
+		*faults += (uint64_t)(after.ru_minflt - before.ru_minflt);
+	(void)munmap((void *)buf, sz);
+}
+
+/*
+ *  stress_mmaphuge_collapse()
+ *	fault in a region with small pages and then time the
+ *	synchronous collapse of it into huge pages
+ */
+static void stress_mmaphuge_collapse(
+	const stress_args_t *args,
+	const size_t sz,
+	const size_t hpsz,
+	stress_mmaphuge_measure_t *m)
+{
+	uint8_t *buf;
+	size_t i;
+	double t, huge;
+	int ret;
+
+	buf = stress_mmaphuge_aligned(sz, hpsz);
+	if (!buf)
+		return;
+#if defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise((void *)buf, sz, MADV_NOHUGEPAGE);
+#endif
+	for (i = 0; i < sz; i += args->page_size)
+		buf[i] = (uint8_t)i;
+#if defined(MADV_HUGEPAGE)
+	(void)shim_madvise((void *)buf, sz, MADV_HUGEPAGE);
+#endif
+	huge = stress_mmaphuge_huge_bytes(buf);
+	t = stress_time_now();
+	ret = shim_madvise((void *)buf, sz, MADV_COLLAPSE);
+	t = stress_time_now() - t;
+	if ((ret < 0) && ((errno == EINVAL) || (errno == ENOSYS))) {
+		m->collapse_ok = false;
+	} else {
+		huge = stress_mmaphuge_huge_bytes(buf) - huge;
+		m->collapse_time += t;
+		if (huge > 0.0)
+			m->collapsed += (uint64_t)(huge / (double)hpsz);
+	}
+	(void)munmap((void *)buf, sz);
+}
+
+/*
+ *  stress_mmaphuge_1gb()
+ *	time mapping and faulting in a 1GB hugetlb page
+ */
+static void stress_mmaphuge_1gb(stress_mmaphuge_measure_t *m)
+{
+#if defined(MAP_HUGE_1GB)
+	uint8_t *buf;
+	double t;
+
+	t = stress_time_now();
+	buf = (uint8_t *)mmap(NULL, 1 * GB, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+	if (buf == MAP_FAILED) {
+		m->gb_fails++;
+		return;
+	}
+	*buf = stress_mwc8();
+	t = stress_time_now() - t;
+	m->gb_time += t;
+	m->gb_maps++;
+	(void)munmap((void *)buf, 1 * GB);
+#else
+	m->gb_fails++;
+#endif
+}
+
+/*
+ *  stress_mmaphuge_fragment()
+ *	fragment memory by faulting in small pages and freeing
+ *	every other one, then measure how much of a THP region
+ *	can be huge page backed and how long compaction takes
+ */
+static void stress_mmaphuge_fragment(
+	const stress_args_t *args,
+	const size_t frag_sz,
+	const size_t sz,
+	const size_t hpsz,
+	stress_mmaphuge_measure_t *m)
+{
+	const size_t page_size = args->page_size;
+	uint8_t *buf;
+	size_t i;
+	double t;
+	ssize_t ret;
+
+	buf = (uint8_t *)mmap(NULL, frag_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return;
+#if defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise((void *)buf, frag_sz, MADV_NOHUGEPAGE);
+#endif
+	for (i = 0; i < frag_sz; i += page_size)
+		buf[i] = (uint8_t)i;
+#if defined(MADV_DONTNEED)
+	for (i = page_size; keep_stressing(args) && (i < frag_sz); i += page_size * 2)
+		(void)shim_madvise((void *)(buf + i), page_size, MADV_DONTNEED);
+#endif
+	stress_mmaphuge_thp_fault(args, sz, hpsz, &m->frag_bytes,
+		&m->frag_huge, NULL, NULL);
+
+	t = stress_time_now();
+	ret = stress_compact_memory();
+	t = stress_time_now() - t;
+	if (ret < 0) {
+		m->compact_ok = false;
+	} else {
+		m->compact_time += t;
+		m->compacts++;
+	}
+	(void)munmap((void *)buf, frag_sz);
+}
+
+/*
+ *  stress_mmaphuge_measure_child()
+ *	measure THP fault throughput, MADV_COLLAPSE and khugepaged
+ *	collapse rates, 1GB hugetlb mapping latency and compaction
+ *	latency with memory fragmented
+ */
+static int stress_mmaphuge_measure_child(const stress_args_t *args, void *v_ctxt)
+{
+	stress_mmaphuge_measure_t m;
+	size_t shmall, freemem, totalmem, freeswap;
+	size_t hpsz, sz, frag_sz;
+	uint64_t collapsed, scans;
+	double t_start, duration, rate;
+	bool lock = false;
+
+	(void)v_ctxt;
+
+	hpsz = (size_t)stress_mmaphuge_read_uint64(THP_SIZE_PATH);
+	if (!hpsz || (hpsz & (hpsz - 1)))
+		hpsz = 2 * MB;
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	sz = MEASURE_REGION_SIZE;
+	if (freemem && (sz > freemem / 8))
+		sz = (freemem / 8) & ~(hpsz - 1);
+	frag_sz = MEASURE_FRAG_SIZE;
+	if (freemem && (frag_sz > freemem / 4))
+		frag_sz = (freemem / 4) & ~(hpsz - 1);
+	if ((sz < hpsz) || (frag_sz < hpsz)) {
+		pr_inf_skip("%s: not enough free memory for huge page "
+			"measurements, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(&m, 0, sizeof(m));
+	m.collapse_ok = true;
+	m.compact_ok = true;
+	collapsed = stress_mmaphuge_read_uint64(KHUGEPAGED_PATH "pages_collapsed");
+	scans = stress_mmaphuge_read_uint64(KHUGEPAGED_PATH "full_scans");
+	t_start = stress_time_now();
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		stress_mmaphuge_thp_fault(args, sz, hpsz, &m.thp_bytes,
+			&m.thp_huge, &m.thp_time, &m.thp_faults);
+		if (!keep_stressing(args))
+			break;
+		if (m.collapse_ok)
+			stress_mmaphuge_collapse(args, sz, hpsz, &m);
+		if (!keep_stressing(args))
+			break;
+		stress_mmaphuge_1gb(&m);
+		if (!keep_stressing(args))
+			break;
+		stress_mmaphuge_fragment(args, frag_sz, sz, hpsz, &m);
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	duration = stress_time_now() - t_start;
+	collapsed = stress_mmaphuge_read_uint64(KHUGEPAGED_PATH "pages_collapsed") - collapsed;
+	scans = stress_mmaphuge_read_uint64(KHUGEPAGED_PATH "full_scans") - scans;
+
+	pr_lock(&lock);
+	if (m.thp_time > 0.0) {
+		pr_inf_lock(&lock, "%s: THP faults: %.1f MB/sec, %.0f faults/sec, "
+			"%.1f%% huge page backed\n", args->name,
+			m.thp_bytes / (m.thp_time * (double)MB),
+			(double)m.thp_faults / m.thp_time,
+			100.0 * m.thp_huge / m.thp_bytes);
+		stress_misc_stats_set(args->misc_stats, 0, "THP fault MB/sec",
+			m.thp_bytes / (m.thp_time * (double)MB));
+		stress_misc_stats_set(args->misc_stats, 1, "THP huge backed %",
+			100.0 * m.thp_huge / m.thp_bytes);
+	}
+	if (!m.collapse_ok) {
+		pr_inf_lock(&lock, "%s: MADV_COLLAPSE: not supported\n", args->name);
+	} else if (m.collapse_time > 0.0) {
+		rate = (double)m.collapsed / m.collapse_time;
+		pr_inf_lock(&lock, "%s: MADV_COLLAPSE: %.1f huge pages/sec\n",
+			args->name, rate);
+		stress_misc_stats_set(args->misc_stats, 2, "collapse pages/sec", rate);
+	}
+	if (duration > 0.0) {
+		rate = (double)collapsed / duration;
+		pr_inf_lock(&lock, "%s: khugepaged: %.2f pages collapsed/sec, "
+			"%" PRIu64 " full scans\n", args->name, rate, scans);
+		stress_misc_stats_set(args->misc_stats, 3, "khugepaged pages/sec", rate);
+	}
+	if (m.gb_maps) {
+		pr_inf_lock(&lock, "%s: 1GB hugetlb: %.3f ms per map and fault, "
+			"%" PRIu64 " of %" PRIu64 " mappings failed\n", args->name,
+			1000.0 * m.gb_time / (double)m.gb_maps, m.gb_fails,
+			m.gb_maps + m.gb_fails);
+		stress_misc_stats_set(args->misc_stats, 4, "1GB map+fault ms",
+			1000.0 * m.gb_time / (double)m.gb_maps);
+	} else if (m.gb_fails) {
+		pr_inf_lock(&lock, "%s: 1GB hugetlb: no 1GB pages could be mapped\n",
+			args->name);
+	}
+	if (m.frag_bytes > 0.0) {
+		pr_inf_lock(&lock, "%s: fragmented: %.1f%% THP huge page backed\n",
+			args->name, 100.0 * m.frag_huge / m.frag_bytes);
+		stress_misc_stats_set(args->misc_stats, 5, "fragmented huge %",
+			100.0 * m.frag_huge / m.frag_bytes);
+	}
+	if (!m.compact_ok) {
+		pr_inf_lock(&lock, "%s: compaction: cannot be triggered\n", args->name);
+	} else if (m.compacts) {
+		pr_inf_lock(&lock, "%s: compaction: %.3f ms per compaction when "
+			"fragmented\n", args->name,
+			1000.0 * m.compact_time / (double)m.compacts);
+		stress_misc_stats_set(args->misc_stats, 6, "compaction ms",
+			1000.0 * m.compact_time / (double)m.compacts);
+	}
+	pr_unlock(&lock);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_mmaphuge()
  *	stress huge page mmappings and unmappings
@@ -205,6 +594,11 @@ static int stress_mmaphuge(const stress_args_t *args)
 	stress_mmaphuge_context_t ctxt;
 
 	int ret;
+	bool mmaphuge_measure = false;
+
+	(void)stress_get_setting("mmaphuge-measure", &mmaphuge_measure);
+	if (mmaphuge_measure)
+		return stress_oomable_child(args, NULL, stress_mmaphuge_measure_child, STRESS_OOMABLE_QUIET);
 
 	ctxt.mmaphuge_mmaps = MAX_MMAP_BUFS;
 	(void)stress_get_setting("mmaphuge-mmaps", &ctxt.mmaphuge_mmaps);
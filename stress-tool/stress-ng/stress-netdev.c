@@ -27,9 +27,51 @@
 static const stress_help_t help[] = {
 	{ NULL,	"netdev N",	"start N workers exercising netdevice ioctls" },
 	{ NULL,	"netdev-ops N",	"stop netdev workers after N bogo operations" },
+	{ NULL,	"netdev-if I",	"sample only the interface I in the stats mode" },
+	{ NULL,	"netdev-interval N", "sample the counters every N milliseconds" },
+	{ NULL,	"netdev-stats",	"sample interface, queue and irq counters" },
 	{ NULL,	NULL,		NULL }
 };
 
+#define MIN_NETDEV_INTERVAL	(10)
+#define MAX_NETDEV_INTERVAL	(60000)
+#define DEFAULT_NETDEV_INTERVAL	(250)
+
+static int stress_set_netdev_stats(const char *opt)
+{
+	bool netdev_stats = true;
+
+	(void)opt;
+	return stress_set_setting("netdev-stats", TYPE_ID_BOOL, &netdev_stats);
+}
+
+static int stress_set_netdev_if(const char *opt)
+{
+	if (strlen(opt) >= IFNAMSIZ) {
+		(void)fprintf(stderr, "netdev-if name '%s' is longer than %d characters\n",
+			opt, IFNAMSIZ - 1);
+		return -1;
+	}
+	return stress_set_setting("netdev-if", TYPE_ID_STR, opt);
+}
+
+static int stress_set_netdev_interval(const char *opt)
+{
+	uint64_t netdev_interval;
+
+	netdev_interval = stress_get_uint64(opt);
+	stress_check_range("netdev-interval", netdev_interval,
+		MIN_NETDEV_INTERVAL, MAX_NETDEV_INTERVAL);
+	return stress_set_setting("netdev-interval", TYPE_ID_UINT64, &netdev_interval);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_netdev_if,	stress_set_netdev_if },
+	{ OPT_netdev_interval,	stress_set_netdev_interval },
+	{ OPT_netdev_stats,	stress_set_netdev_stats },
+	{ 0,			NULL }
+};
+
 #if defined(__linux__) &&	\
     defined(SIOCGIFCONF) &&	\
     defined(HAVE_IFCONF)
@@ -69,6 +111,1107 @@ static void stress_netdev_check(
 #define STRESS_NETDEV_CHECK(args, ifr, fd, cmd)	\
 	stress_netdev_check(args, ifr, fd, cmd, #cmd)
 
+#define NETDEV_IFS_MAX		(32)	/* interfaces sampled */
+#define NETDEV_QUEUES_MAX	(64)	/* queues per direction */
+#define NETDEV_IRQS_MAX		(64)	/* irqs per interface */
+#define NETDEV_CPUS_MAX		(4096)	/* /proc/interrupts columns */
+
+#define NETDEV_RX		(0)
+#define NETDEV_TX		(1)
+
+#define NETDEV_PACKETS		(0)
+#define NETDEV_BYTES		(1)
+#define NETDEV_DROPS		(2)
+#define NETDEV_METRICS		(3)
+
+/* /sys/class/net/<if>/statistics counters, rx then tx */
+static const char * const netdev_stat_names[2][NETDEV_METRICS] = {
+	{ "rx_packets", "rx_bytes", "rx_dropped" },
+	{ "tx_packets", "tx_bytes", "tx_dropped" },
+};
+
+static const char * const netdev_dir_names[2] = { "rx", "tx" };
+
+/* an ethtool statistic that is a per queue counter */
+typedef struct {
+	uint32_t index;			/* index in the ethtool stats */
+	uint8_t dir;			/* NETDEV_RX or NETDEV_TX */
+	uint8_t metric;			/* NETDEV_PACKETS, BYTES or DROPS */
+	uint16_t queue;
+} stress_netdev_qstat_t;
+
+/* sampling state and totals of an interface */
+typedef struct {
+	char name[IFNAMSIZ];
+	char dev[64];			/* device name, irq descriptions use it */
+	int ifindex;
+	uint64_t prev[2][NETDEV_METRICS];
+	uint64_t total[2][NETDEV_METRICS];
+	double peak_pps[2];
+	/* netdev netlink per queue counters */
+	bool qs;			/* has netlink per queue stats */
+	bool qs_drops;			/* use drops of the netlink stats */
+	uint64_t qs_prev[2][NETDEV_QUEUES_MAX][NETDEV_METRICS];
+	/* ethtool per queue counters */
+	uint32_t n_stats;		/* ethtool stats of the driver */
+	uint64_t *eth_prev;
+	stress_netdev_qstat_t *qstats;
+	size_t n_qstats;
+	uint64_t qtotal[2][NETDEV_QUEUES_MAX][NETDEV_METRICS];
+	size_t queues[2];		/* queues per direction */
+	/* irqs of the interface */
+	int irqs[NETDEV_IRQS_MAX];
+	size_t n_irqs;
+	uint64_t *irq_prev;		/* n_irqs x cpus counts */
+	uint64_t *irq_cpu;		/* irq count per cpu column */
+} stress_netdev_if_t;
+
+/* state of the sampler */
+typedef struct {
+	stress_netdev_if_t ifs[NETDEV_IFS_MAX];
+	size_t n_ifs;
+	size_t cpus;			/* cpu columns of /proc/interrupts */
+	int cpu_ids[NETDEV_CPUS_MAX];	/* cpu number of each column */
+	uint64_t softirq_prev[2][NETDEV_CPUS_MAX];
+	uint64_t softirq[2][NETDEV_CPUS_MAX];	/* NET_RX and NET_TX per cpu */
+	char *buf;			/* /proc line buffer */
+	size_t buf_len;
+	int qs_sock;			/* generic netlink socket, -1 if none */
+	uint16_t qs_family;		/* netdev generic netlink family */
+	uint32_t nl_buf[8192];		/* netlink receive buffer */
+	double t_first, t_last;
+	uint64_t samples;
+} stress_netdev_sampler_t;
+
+/*
+ *  stress_netdev_name_match()
+ *	true if name occurs in text and is not followed by more of a
+ *	name, so eth1 does not match eth10 and virtio3 not virtio31
+ */
+static bool stress_netdev_name_match(const char *text, const char *name)
+{
+	const size_t len = strlen(name);
+	const char *ptr = text;
+
+	if (!len)
+		return false;
+	while ((ptr = strstr(ptr, name)) != NULL) {
+		const char ch = ptr[len];
+
+		if (!isalnum((unsigned char)ch) && (ch != ':'))
+			return true;
+		ptr++;
+	}
+	return false;
+}
+
+/*
+ *  stress_netdev_cpu_header()
+ *	parse the CPUn column header of /proc/interrupts or /proc/softirqs
+ */
+static size_t stress_netdev_cpu_header(const char *line, int *cpu_ids)
+{
+	size_t n = 0;
+	const char *ptr = line;
+
+	while ((n < NETDEV_CPUS_MAX) && ((ptr = strstr(ptr, "CPU")) != NULL)) {
+		ptr += 3;
+		cpu_ids[n++] = atoi(ptr);
+	}
+	return n;
+}
+
+/*
+ *  stress_netdev_columns()
+ *	parse up to n per cpu counts after the row label of a /proc line,
+ *	returns the text after the counts
+ */
+static const char *stress_netdev_columns(const char *ptr, uint64_t *counts, const size_t n)
+{
+	size_t i;
+
+	ptr = strchr(ptr, ':');
+	if (!ptr)
+		return NULL;
+	ptr++;
+	for (i = 0; i < n; i++) {
+		char *end;
+
+		counts[i] = (uint64_t)strtoull(ptr, &end, 10);
+		if (end == ptr)
+			break;
+		ptr = end;
+	}
+	for (; i < n; i++)
+		counts[i] = 0;
+	return ptr;
+}
+
+/*
+ *  stress_netdev_read_lines()
+ *	call func on each line of a /proc file
+ */
+static void stress_netdev_read_lines(
+	stress_netdev_sampler_t *sampler,
+	const char *path,
+	void (*func)(stress_netdev_sampler_t *sampler, const char *line, const bool header))
+{
+	FILE *fp;
+	bool header = true;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	while (fgets(sampler->buf, (int)sampler->buf_len, fp)) {
+		func(sampler, sampler->buf, header);
+		header = false;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_netdev_irq_find()
+ *	add the irqs whose description names the interface, its device
+ *	or its pci device to the interfaces
+ */
+static void stress_netdev_irq_find(stress_netdev_sampler_t *sampler, const char *line, const bool header)
+{
+	size_t i;
+	const char *desc;
+	char *end;
+	int irq;
+
+	if (header) {
+		sampler->cpus = stress_netdev_cpu_header(line, sampler->cpu_ids);
+		return;
+	}
+	irq = (int)strtol(line, &end, 10);
+	if ((end == line) || (*end != ':'))
+		return;
+	desc = end + 1;
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+
+		if (nif->n_irqs >= NETDEV_IRQS_MAX)
+			continue;
+		if (stress_netdev_name_match(desc, nif->name) ||
+		    stress_netdev_name_match(desc, nif->dev))
+			nif->irqs[nif->n_irqs++] = irq;
+	}
+}
+
+/*
+ *  stress_netdev_irq_sample()
+ *	add the per cpu irq counts since the last sample to the interfaces
+ */
+static void stress_netdev_irq_sample(stress_netdev_sampler_t *sampler, const char *line, const bool header)
+{
+	uint64_t counts[NETDEV_CPUS_MAX];
+	size_t i, j, k;
+	char *end;
+	int irq;
+
+	if (header)
+		return;
+	irq = (int)strtol(line, &end, 10);
+	if ((end == line) || (*end != ':'))
+		return;
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+
+		for (j = 0; j < nif->n_irqs; j++) {
+			uint64_t *prev;
+
+			if (nif->irqs[j] != irq)
+				continue;
+			prev = &nif->irq_prev[j * sampler->cpus];
+			(void)stress_netdev_columns(line, counts, sampler->cpus);
+			for (k = 0; k < sampler->cpus; k++) {
+				if (sampler->samples && (counts[k] >= prev[k]))
+					nif->irq_cpu[k] += counts[k] - prev[k];
+				prev[k] = counts[k];
+			}
+		}
+	}
+}
+
+/*
+ *  stress_netdev_softirq_sample()
+ *	add the per cpu NET_RX and NET_TX softirqs since the last sample
+ */
+static void stress_netdev_softirq_sample(stress_netdev_sampler_t *sampler, const char *line, const bool header)
+{
+	uint64_t counts[NETDEV_CPUS_MAX];
+	const char *ptr;
+	size_t i;
+	int dir;
+
+	if (header)
+		return;
+	for (ptr = line; *ptr == ' '; ptr++)
+		;
+	if (!strncmp(ptr, "NET_RX:", 7))
+		dir = NETDEV_RX;
+	else if (!strncmp(ptr, "NET_TX:", 7))
+		dir = NETDEV_TX;
+	else
+		return;
+	(void)stress_netdev_columns(ptr, counts, sampler->cpus);
+	for (i = 0; i < sampler->cpus; i++) {
+		if (sampler->samples && (counts[i] >= sampler->softirq_prev[dir][i]))
+			sampler->softirq[dir][i] += counts[i] - sampler->softirq_prev[dir][i];
+		sampler->softirq_prev[dir][i] = counts[i];
+	}
+}
+
+#if defined(HAVE_LINUX_ETHTOOL_H) &&	\
+    defined(SIOCETHTOOL) &&		\
+    defined(ETHTOOL_GSTATS)
+/*
+ *  stress_netdev_qstat_parse()
+ *	map a driver ethtool statistic name such as rx_queue_0_packets,
+ *	rx-0.packets or tx0_bytes to a per queue counter
+ */
+static bool stress_netdev_qstat_parse(const char *name, stress_netdev_qstat_t *qstat)
+{
+	char lname[ETH_GSTRING_LEN + 1];
+	const char *rx, *tx, *ptr;
+	size_t i;
+	long queue;
+
+	for (i = 0; (i < ETH_GSTRING_LEN) && name[i]; i++)
+		lname[i] = (char)tolower((unsigned char)name[i]);
+	lname[i] = '\0';
+
+	/* Histograms of packet sizes and xdp counters are not queue traffic */
+	if (strstr(lname, "_to_") || strstr(lname, "size") || strstr(lname, "xdp"))
+		return false;
+
+	rx = strstr(lname, "rx");
+	tx = strstr(lname, "tx");
+	if (rx && (!tx || (rx < tx)))
+		qstat->dir = NETDEV_RX;
+	else if (tx)
+		qstat->dir = NETDEV_TX;
+	else
+		return false;
+
+	if (strstr(lname, "packets") || strstr(lname, "pkts"))
+		qstat->metric = NETDEV_PACKETS;
+	else if (strstr(lname, "bytes"))
+		qstat->metric = NETDEV_BYTES;
+	else if (strstr(lname, "drop"))
+		qstat->metric = NETDEV_DROPS;
+	else
+		return false;
+
+	for (ptr = lname; *ptr && !isdigit((unsigned char)*ptr); ptr++)
+		;
+	if (!*ptr)
+		return false;
+	queue = strtol(ptr, NULL, 10);
+	if ((queue < 0) || (queue >= NETDEV_QUEUES_MAX))
+		return false;
+	qstat->queue = (uint16_t)queue;
+	return true;
+}
+
+/*
+ *  stress_netdev_ethtool_stats()
+ *	fetch the ethtool stats of an interface, NULL if not available
+ */
+static struct ethtool_stats *stress_netdev_ethtool_stats(const int fd, stress_netdev_if_t *nif)
+{
+	struct ethtool_stats *stats;
+	struct ifreq ifr;
+
+	stats = calloc(1, sizeof(*stats) + (nif->n_stats * sizeof(uint64_t)));
+	if (!stats)
+		return NULL;
+	stats->cmd = ETHTOOL_GSTATS;
+	stats->n_stats = nif->n_stats;
+	(void)memset(&ifr, 0, sizeof(ifr));
+	(void)shim_strlcpy(ifr.ifr_name, nif->name, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (void *)stats;
+	if ((ioctl(fd, SIOCETHTOOL, &ifr) < 0) || (stats->n_stats != nif->n_stats)) {
+		free(stats);
+		return NULL;
+	}
+	return stats;
+}
+
+/*
+ *  stress_netdev_ethtool_init()
+ *	find the per queue counters of the driver of an interface
+ */
+static void stress_netdev_ethtool_init(const int fd, stress_netdev_if_t *nif)
+{
+	struct ethtool_drvinfo drvinfo;
+	struct ethtool_gstrings *strings;
+	struct ifreq ifr;
+	size_t i;
+
+	(void)memset(&drvinfo, 0, sizeof(drvinfo));
+	drvinfo.cmd = ETHTOOL_GDRVINFO;
+	(void)memset(&ifr, 0, sizeof(ifr));
+	(void)shim_strlcpy(ifr.ifr_name, nif->name, sizeof(ifr.ifr_name));
+	ifr.ifr_data = (void *)&drvinfo;
+	if ((ioctl(fd, SIOCETHTOOL, &ifr) < 0) || !drvinfo.n_stats)
+		return;
+
+	strings = calloc(1, sizeof(*strings) + ((size_t)drvinfo.n_stats * ETH_GSTRING_LEN));
+	if (!strings)
+		return;
+	strings->cmd = ETHTOOL_GSTRINGS;
+	strings->string_set = ETH_SS_STATS;
+	strings->len = drvinfo.n_stats;
+	ifr.ifr_data = (void *)strings;
+	if ((ioctl(fd, SIOCETHTOOL, &ifr) < 0) || (strings->len != drvinfo.n_stats))
+		goto free_strings;
+
+	nif->qstats = calloc(strings->len, sizeof(*nif->qstats));
+	nif->eth_prev = calloc(strings->len, sizeof(*nif->eth_prev));
+	if (!nif->qstats || !nif->eth_prev)
+		goto free_qstats;
+	for (i = 0; i < strings->len; i++) {
+		stress_netdev_qstat_t *qstat = &nif->qstats[nif->n_qstats];
+
+		if (stress_netdev_qstat_parse((const char *)&strings->data[i * ETH_GSTRING_LEN], qstat)) {
+			qstat->index = (uint32_t)i;
+			if ((size_t)qstat->queue >= nif->queues[qstat->dir])
+				nif->queues[qstat->dir] = (size_t)qstat->queue + 1;
+			nif->n_qstats++;
+		}
+	}
+	if (!nif->n_qstats)
+		goto free_qstats;
+	nif->n_stats = strings->len;
+	free(strings);
+	return;
+
+free_qstats:
+	free(nif->qstats);
+	free(nif->eth_prev);
+	nif->qstats = NULL;
+	nif->eth_prev = NULL;
+	nif->n_qstats = 0;
+free_strings:
+	free(strings);
+}
+
+/*
+ *  stress_netdev_ethtool_sample()
+ *	add the per queue counts since the last sample
+ */
+static void stress_netdev_ethtool_sample(const int fd, stress_netdev_if_t *nif, const bool first)
+{
+	struct ethtool_stats *stats;
+	size_t i;
+
+	if (!nif->n_qstats)
+		return;
+	stats = stress_netdev_ethtool_stats(fd, nif);
+	if (!stats)
+		return;
+	for (i = 0; i < nif->n_qstats; i++) {
+		const stress_netdev_qstat_t *qstat = &nif->qstats[i];
+		const uint64_t val = stats->data[qstat->index];
+
+		if (!first && (val >= nif->eth_prev[qstat->index]))
+			nif->qtotal[qstat->dir][qstat->queue][qstat->metric] +=
+				val - nif->eth_prev[qstat->index];
+		nif->eth_prev[qstat->index] = val;
+	}
+	free(stats);
+}
+#else
+static void stress_netdev_ethtool_init(const int fd, stress_netdev_if_t *nif)
+{
+	(void)fd;
+	(void)nif;
+}
+
+static void stress_netdev_ethtool_sample(const int fd, stress_netdev_if_t *nif, const bool first)
+{
+	(void)fd;
+	(void)nif;
+	(void)first;
+}
+#endif
+
+#if defined(HAVE_LINUX_NETLINK_H) &&	\
+    defined(HAVE_LINUX_GENETLINK_H)
+#define STRESS_NETDEV_QSTATS
+
+/*
+ *  netdev generic netlink family per queue statistics, these are
+ *  from linux/netdev.h that older uapi headers do not have
+ */
+#define NETDEV_GENL_NAME		"netdev"
+#define NETDEV_GENL_VERSION		(1)
+#define NETDEV_CMD_QSTATS_GET		(12)
+#define NETDEV_A_QSTATS_IFINDEX		(1)
+#define NETDEV_A_QSTATS_QUEUE_TYPE	(2)
+#define NETDEV_A_QSTATS_QUEUE_ID	(3)
+#define NETDEV_A_QSTATS_SCOPE		(4)
+#define NETDEV_A_QSTATS_RX_PACKETS	(8)
+#define NETDEV_A_QSTATS_RX_BYTES	(9)
+#define NETDEV_A_QSTATS_TX_PACKETS	(10)
+#define NETDEV_A_QSTATS_TX_BYTES	(11)
+#define NETDEV_A_QSTATS_RX_HW_DROPS	(13)
+#define NETDEV_QSTATS_SCOPE_QUEUE	(1)
+
+#define NETDEV_NLA_DATA(na)		((void *)((char *)(na) + NLA_HDRLEN))
+#define NETDEV_GENL_DATA(nlh)		((void *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+
+/*
+ *  stress_netdev_genl_send()
+ *	send a generic netlink request with one attribute
+ */
+static int stress_netdev_genl_send(
+	const int sock,
+	const uint16_t type,
+	const uint16_t flags,
+	const uint8_t cmd,
+	const uint8_t version,
+	const uint16_t nla_type,
+	const void *nla_data,
+	const size_t nla_len)
+{
+	struct {
+		struct nlmsghdr n;
+		struct genlmsghdr g;
+		char data[64];
+	} msg;
+	struct nlattr *na;
+	struct sockaddr_nl addr;
+
+	if (nla_len > sizeof(msg.data) - NLA_HDRLEN)
+		return -1;
+	(void)memset(&msg, 0, sizeof(msg));
+	msg.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	msg.n.nlmsg_type = type;
+	msg.n.nlmsg_flags = flags;
+	msg.g.cmd = cmd;
+	msg.g.version = version;
+
+	na = (struct nlattr *)NETDEV_GENL_DATA(&msg.n);
+	na->nla_type = nla_type;
+	na->nla_len = (uint16_t)(nla_len + NLA_HDRLEN);
+	(void)memcpy(NETDEV_NLA_DATA(na), nla_data, nla_len);
+	msg.n.nlmsg_len += NLA_ALIGN(na->nla_len);
+
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (sendto(sock, &msg, msg.n.nlmsg_len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_netdev_nla_uint()
+ *	netlink uint attributes are 32 or 64 bits wide
+ */
+static uint64_t stress_netdev_nla_uint(const struct nlattr *na)
+{
+	const size_t len = (size_t)na->nla_len - NLA_HDRLEN;
+	uint64_t v64;
+	uint32_t v32;
+
+	if (len >= sizeof(v64)) {
+		(void)memcpy(&v64, NETDEV_NLA_DATA(na), sizeof(v64));
+		return v64;
+	}
+	if (len >= sizeof(v32)) {
+		(void)memcpy(&v32, NETDEV_NLA_DATA(na), sizeof(v32));
+		return (uint64_t)v32;
+	}
+	return 0;
+}
+
+/*
+ *  stress_netdev_qstats_open()
+ *	open a generic netlink socket and find the netdev family, if
+ *	the kernel has no per queue stats sampler->qs_sock stays -1
+ */
+static void stress_netdev_qstats_open(stress_netdev_sampler_t *sampler)
+{
+	struct sockaddr_nl addr;
+	struct nlmsghdr *nlh;
+	ssize_t len;
+	int sock;
+
+	sampler->qs_sock = -1;
+	sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+	if (sock < 0)
+		return;
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto close_sock;
+	if (stress_netdev_genl_send(sock, GENL_ID_CTRL, NLM_F_REQUEST, CTRL_CMD_GETFAMILY, 1,
+			CTRL_ATTR_FAMILY_NAME, NETDEV_GENL_NAME, sizeof(NETDEV_GENL_NAME)) < 0)
+		goto close_sock;
+	len = recv(sock, sampler->nl_buf, sizeof(sampler->nl_buf), 0);
+	if (len < 0)
+		goto close_sock;
+
+	nlh = (struct nlmsghdr *)sampler->nl_buf;
+	if (NLMSG_OK(nlh, (unsigned int)len) && (nlh->nlmsg_type == GENL_ID_CTRL)) {
+		struct nlattr *na = (struct nlattr *)NETDEV_GENL_DATA(nlh);
+		int remain = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(GENL_HDRLEN);
+
+		while ((remain >= (int)NLA_HDRLEN) && (na->nla_len >= NLA_HDRLEN) &&
+		       ((int)na->nla_len <= remain)) {
+			if (na->nla_type == CTRL_ATTR_FAMILY_ID) {
+				sampler->qs_family = *(uint16_t *)NETDEV_NLA_DATA(na);
+				sampler->qs_sock = sock;
+				return;
+			}
+			remain -= NLA_ALIGN(na->nla_len);
+			na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+		}
+	}
+close_sock:
+	(void)close(sock);
+}
+
+/*
+ *  stress_netdev_qstats_add()
+ *	add the counts since the last sample of one queue
+ */
+static void stress_netdev_qstats_add(
+	stress_netdev_sampler_t *sampler,
+	struct nlmsghdr *nlh,
+	const bool first)
+{
+	struct nlattr *na = (struct nlattr *)NETDEV_GENL_DATA(nlh);
+	int remain = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(GENL_HDRLEN);
+	uint64_t vals[NETDEV_METRICS * 2];
+	bool have[NETDEV_METRICS * 2];
+	stress_netdev_if_t *nif = NULL;
+	int ifindex = -1, dir = -1, queue = -1;
+	size_t i;
+
+	(void)memset(have, 0, sizeof(have));
+	while ((remain >= (int)NLA_HDRLEN) && (na->nla_len >= NLA_HDRLEN) &&
+	       ((int)na->nla_len <= remain)) {
+		const uint64_t v = stress_netdev_nla_uint(na);
+
+		switch (na->nla_type) {
+		case NETDEV_A_QSTATS_IFINDEX:
+			ifindex = (int)v;
+			break;
+		case NETDEV_A_QSTATS_QUEUE_TYPE:
+			dir = (v == 0) ? NETDEV_RX : NETDEV_TX;
+			break;
+		case NETDEV_A_QSTATS_QUEUE_ID:
+			queue = (int)v;
+			break;
+		case NETDEV_A_QSTATS_RX_PACKETS:
+			vals[NETDEV_PACKETS] = v;
+			have[NETDEV_PACKETS] = true;
+			break;
+		case NETDEV_A_QSTATS_RX_BYTES:
+			vals[NETDEV_BYTES] = v;
+			have[NETDEV_BYTES] = true;
+			break;
+		case NETDEV_A_QSTATS_RX_HW_DROPS:
+			vals[NETDEV_DROPS] = v;
+			have[NETDEV_DROPS] = true;
+			break;
+		case NETDEV_A_QSTATS_TX_PACKETS:
+			vals[NETDEV_METRICS + NETDEV_PACKETS] = v;
+			have[NETDEV_METRICS + NETDEV_PACKETS] = true;
+			break;
+		case NETDEV_A_QSTATS_TX_BYTES:
+			vals[NETDEV_METRICS + NETDEV_BYTES] = v;
+			have[NETDEV_METRICS + NETDEV_BYTES] = true;
+			break;
+		default:
+			break;
+		}
+		remain -= NLA_ALIGN(na->nla_len);
+		na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+	}
+	if ((dir < 0) || (queue < 0) || (queue >= NETDEV_QUEUES_MAX))
+		return;
+	for (i = 0; i < sampler->n_ifs; i++) {
+		if (sampler->ifs[i].ifindex == ifindex) {
+			nif = &sampler->ifs[i];
+			break;
+		}
+	}
+	if (!nif)
+		return;
+
+	nif->qs = true;
+	if ((size_t)queue >= nif->queues[dir])
+		nif->queues[dir] = (size_t)queue + 1;
+	for (i = 0; i < NETDEV_METRICS; i++) {
+		const size_t idx = (size_t)(dir * NETDEV_METRICS) + i;
+		uint64_t *prev = &nif->qs_prev[dir][queue][i];
+
+		if (!have[idx] || ((i == NETDEV_DROPS) && !nif->qs_drops))
+			continue;
+		if (!first && (vals[idx] >= *prev))
+			nif->qtotal[dir][queue][i] += vals[idx] - *prev;
+		*prev = vals[idx];
+	}
+}
+
+/*
+ *  stress_netdev_qstats_sample()
+ *	dump the per queue stats of all the interfaces
+ */
+static void stress_netdev_qstats_sample(stress_netdev_sampler_t *sampler, const bool first)
+{
+	const uint32_t scope = NETDEV_QSTATS_SCOPE_QUEUE;
+
+	if (sampler->qs_sock < 0)
+		return;
+	if (stress_netdev_genl_send(sampler->qs_sock, sampler->qs_family,
+			NLM_F_REQUEST | NLM_F_DUMP, NETDEV_CMD_QSTATS_GET, NETDEV_GENL_VERSION,
+			NETDEV_A_QSTATS_SCOPE, &scope, sizeof(scope)) < 0)
+		return;
+	for (;;) {
+		struct nlmsghdr *nlh;
+		ssize_t len;
+
+		len = recv(sampler->qs_sock, sampler->nl_buf, sizeof(sampler->nl_buf), 0);
+		if (len <= 0)
+			return;
+		for (nlh = (struct nlmsghdr *)sampler->nl_buf; NLMSG_OK(nlh, (unsigned int)len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			if ((nlh->nlmsg_type == NLMSG_DONE) || (nlh->nlmsg_type == NLMSG_ERROR))
+				return;
+			stress_netdev_qstats_add(sampler, nlh, first);
+		}
+	}
+}
+#else
+static void stress_netdev_qstats_open(stress_netdev_sampler_t *sampler)
+{
+	sampler->qs_sock = -1;
+}
+
+static void stress_netdev_qstats_sample(stress_netdev_sampler_t *sampler, const bool first)
+{
+	(void)sampler;
+	(void)first;
+}
+#endif
+
+/*
+ *  stress_netdev_queues()
+ *	count the rx-N or tx-N queues of an interface in sysfs
+ */
+static size_t stress_netdev_queues(const char *name, const char *prefix)
+{
+	char path[PATH_MAX];
+	struct dirent *d;
+	DIR *dir;
+	size_t n = 0;
+
+	(void)snprintf(path, sizeof(path), "/sys/class/net/%s/queues", name);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while ((d = readdir(dir)) != NULL) {
+		if (!strncmp(d->d_name, prefix, strlen(prefix)))
+			n++;
+	}
+	(void)closedir(dir);
+	return n;
+}
+
+/*
+ *  stress_netdev_sampler_init()
+ *	find the interfaces, their queue counters and irqs
+ */
+static int stress_netdev_sampler_init(
+	const int fd,
+	stress_netdev_sampler_t *sampler,
+	const char *netdev_if)
+{
+	struct dirent *d;
+	DIR *dir;
+	size_t i;
+
+	sampler->qs_sock = -1;
+	sampler->buf_len = 64 * KB;
+	sampler->buf = malloc(sampler->buf_len);
+	if (!sampler->buf)
+		return -1;
+
+	dir = opendir("/sys/class/net");
+	if (!dir)
+		return -1;
+	while ((sampler->n_ifs < NETDEV_IFS_MAX) && ((d = readdir(dir)) != NULL)) {
+		stress_netdev_if_t *nif = &sampler->ifs[sampler->n_ifs];
+		char path[PATH_MAX], link[PATH_MAX];
+		ssize_t len;
+		int dirn;
+
+		if ((d->d_name[0] == '.') || (strlen(d->d_name) >= IFNAMSIZ))
+			continue;
+		if (netdev_if && strcmp(d->d_name, netdev_if))
+			continue;
+		(void)shim_strlcpy(nif->name, d->d_name, sizeof(nif->name));
+		nif->ifindex = -1;
+		(void)snprintf(path, sizeof(path), "/sys/class/net/%s/ifindex", nif->name);
+		if (system_read(path, link, sizeof(link)) > 0)
+			nif->ifindex = atoi(link);
+
+		/* The device of the interface, eg. virtio3 or 0000:03:00.0 */
+		(void)snprintf(path, sizeof(path), "/sys/class/net/%s/device", nif->name);
+		len = readlink(path, link, sizeof(link) - 1);
+		if (len > 0) {
+			const char *base;
+
+			link[len] = '\0';
+			base = strrchr(link, '/');
+			(void)shim_strlcpy(nif->dev, base ? base + 1 : link, sizeof(nif->dev));
+		}
+		stress_netdev_ethtool_init(fd, nif);
+		for (dirn = NETDEV_RX; dirn <= NETDEV_TX; dirn++) {
+			const size_t n = stress_netdev_queues(nif->name, dirn == NETDEV_RX ? "rx-" : "tx-");
+
+			if (n > nif->queues[dirn])
+				nif->queues[dirn] = STRESS_MINIMUM(n, NETDEV_QUEUES_MAX);
+		}
+		sampler->n_ifs++;
+	}
+	(void)closedir(dir);
+
+	/*
+	 *  Prefer the netlink per queue stats, the ethtool names are driver
+	 *  specific and drivers such as virtio_net only have drops there now
+	 */
+	stress_netdev_qstats_open(sampler);
+	stress_netdev_qstats_sample(sampler, true);
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+		size_t j, n = 0;
+
+		if (!nif->qs)
+			continue;
+		for (j = 0; j < nif->n_qstats; j++) {
+			if (nif->qstats[j].metric == NETDEV_DROPS)
+				nif->qstats[n++] = nif->qstats[j];
+		}
+		nif->n_qstats = n;
+		nif->qs_drops = (n == 0);
+	}
+
+	stress_netdev_read_lines(sampler, "/proc/interrupts", stress_netdev_irq_find);
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+
+		if (!nif->n_irqs || !sampler->cpus)
+			continue;
+		nif->irq_prev = calloc(nif->n_irqs * sampler->cpus, sizeof(*nif->irq_prev));
+		nif->irq_cpu = calloc(sampler->cpus, sizeof(*nif->irq_cpu));
+		if (!nif->irq_prev || !nif->irq_cpu) {
+			free(nif->irq_prev);
+			free(nif->irq_cpu);
+			nif->irq_prev = NULL;
+			nif->irq_cpu = NULL;
+			nif->n_irqs = 0;
+		}
+	}
+	return sampler->n_ifs ? 0 : -1;
+}
+
+static void stress_netdev_sampler_free(stress_netdev_sampler_t *sampler)
+{
+	size_t i;
+
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+
+		free(nif->eth_prev);
+		free(nif->qstats);
+		free(nif->irq_prev);
+		free(nif->irq_cpu);
+	}
+	if (sampler->qs_sock >= 0)
+		(void)close(sampler->qs_sock);
+	free(sampler->buf);
+}
+
+/*
+ *  stress_netdev_sample()
+ *	sample all the counters, the first sample is the baseline
+ */
+static void stress_netdev_sample(const int fd, stress_netdev_sampler_t *sampler)
+{
+	const double now = stress_time_now();
+	const double dt = now - sampler->t_last;
+	const bool first = (sampler->samples == 0);
+	size_t i;
+
+	for (i = 0; i < sampler->n_ifs; i++) {
+		stress_netdev_if_t *nif = &sampler->ifs[i];
+		int dir, metric;
+
+		for (dir = NETDEV_RX; dir <= NETDEV_TX; dir++) {
+			for (metric = 0; metric < NETDEV_METRICS; metric++) {
+				char path[PATH_MAX], buf[32];
+				uint64_t val = 0;
+
+				(void)snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s",
+					nif->name, netdev_stat_names[dir][metric]);
+				if (system_read(path, buf, sizeof(buf)) <= 0)
+					continue;
+				if (sscanf(buf, "%" SCNu64, &val) != 1)
+					continue;
+				if (!first && (val >= nif->prev[dir][metric])) {
+					const uint64_t delta = val - nif->prev[dir][metric];
+
+					nif->total[dir][metric] += delta;
+					if ((metric == NETDEV_PACKETS) && (dt > 0.0) &&
+					    ((double)delta / dt > nif->peak_pps[dir]))
+						nif->peak_pps[dir] = (double)delta / dt;
+				}
+				nif->prev[dir][metric] = val;
+			}
+		}
+		stress_netdev_ethtool_sample(fd, nif, first);
+	}
+	stress_netdev_qstats_sample(sampler, first);
+	stress_netdev_read_lines(sampler, "/proc/interrupts", stress_netdev_irq_sample);
+	stress_netdev_read_lines(sampler, "/proc/softirqs", stress_netdev_softirq_sample);
+
+	if (first)
+		sampler->t_first = now;
+	sampler->t_last = now;
+	sampler->samples++;
+}
+
+/*
+ *  stress_netdev_imbalance()
+ *	busiest over mean of n counts, 1.0 is perfectly balanced and n
+ *	is all on one, 0.0 if there are no counts
+ */
+static double stress_netdev_imbalance(const uint64_t *counts, const size_t n, const size_t stride)
+{
+	uint64_t sum = 0, max = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		const uint64_t c = counts[i * stride];
+
+		sum += c;
+		if (c > max)
+			max = c;
+	}
+	return sum ? ((double)max * (double)n) / (double)sum : 0.0;
+}
+
+/*
+ *  stress_netdev_cpu_list()
+ *	format the cpus handling counts as cpuN share% pairs
+ */
+static void stress_netdev_cpu_list(
+	const stress_netdev_sampler_t *sampler,
+	const uint64_t *counts,
+	char *buf,
+	const size_t len)
+{
+	uint64_t sum = 0;
+	size_t i, pos = 0;
+
+	buf[0] = '\0';
+	for (i = 0; i < sampler->cpus; i++)
+		sum += counts[i];
+	if (!sum)
+		return;
+	for (i = 0; (i < sampler->cpus) && (pos < len); i++) {
+		const double pct = 100.0 * (double)counts[i] / (double)sum;
+		int n;
+
+		if (pct < 0.5)
+			continue;
+		n = snprintf(buf + pos, len - pos, "%scpu%d %.0f%%",
+			pos ? ", " : "", sampler->cpu_ids[i], pct);
+		if (n < 0)
+			break;
+		pos += (size_t)n;
+	}
+}
+
+/*
+ *  stress_netdev_report()
+ *	report the throughput, drops and their attribution to queues and
+ *	cpus of the interfaces that had traffic
+ */
+static void stress_netdev_report(const stress_args_t *args, const stress_netdev_sampler_t *sampler)
+{
+	const double duration = sampler->t_last - sampler->t_first;
+	const stress_netdev_if_t *busiest = NULL;
+	uint64_t busiest_bytes = 0;
+	double q_imbalance[2] = { 0.0, 0.0 }, irq_imbalance = 0.0;
+	char cpus[256];
+	bool lock = false;
+	size_t i, q;
+	int dir;
+
+	if (duration <= 0.0)
+		return;
+
+	if (args->instance == 0)
+		pr_lock(&lock);
+	for (i = 0; i < sampler->n_ifs; i++) {
+		const stress_netdev_if_t *nif = &sampler->ifs[i];
+		const uint64_t bytes = nif->total[NETDEV_RX][NETDEV_BYTES] + nif->total[NETDEV_TX][NETDEV_BYTES];
+
+		if (!nif->total[NETDEV_RX][NETDEV_PACKETS] && !nif->total[NETDEV_TX][NETDEV_PACKETS])
+			continue;
+		if (bytes > busiest_bytes) {
+			busiest_bytes = bytes;
+			busiest = nif;
+		}
+		if (args->instance != 0)
+			continue;
+
+		for (dir = NETDEV_RX; dir <= NETDEV_TX; dir++) {
+			pr_inf_lock(&lock, "%s: %s %s %.2f MB/sec, %.0f packets/sec (peak %.0f), "
+				"%.0f drops/sec\n", args->name, nif->name, netdev_dir_names[dir],
+				(double)nif->total[dir][NETDEV_BYTES] / (double)MB / duration,
+				(double)nif->total[dir][NETDEV_PACKETS] / duration,
+				nif->peak_pps[dir],
+				(double)nif->total[dir][NETDEV_DROPS] / duration);
+		}
+		for (dir = NETDEV_RX; dir <= NETDEV_TX; dir++) {
+			uint64_t sum = 0;
+
+			for (q = 0; q < nif->queues[dir]; q++)
+				sum += nif->qtotal[dir][q][NETDEV_PACKETS];
+			if (!sum)
+				continue;
+			for (q = 0; q < nif->queues[dir]; q++) {
+				const uint64_t *qt = nif->qtotal[dir][q];
+
+				pr_inf_lock(&lock, "%s: %s %s-%zu %9.0f packets/sec %6.1f%% "
+					"%8.2f MB/sec %6.0f drops/sec\n", args->name, nif->name,
+					netdev_dir_names[dir], q,
+					(double)qt[NETDEV_PACKETS] / duration,
+					100.0 * (double)qt[NETDEV_PACKETS] / (double)sum,
+					(double)qt[NETDEV_BYTES] / (double)MB / duration,
+					(double)qt[NETDEV_DROPS] / duration);
+			}
+			pr_inf_lock(&lock, "%s: %s %s queue imbalance %.2f (busiest/mean of %zu queues)\n",
+				args->name, nif->name, netdev_dir_names[dir],
+				stress_netdev_imbalance(&nif->qtotal[dir][0][NETDEV_PACKETS],
+					nif->queues[dir], NETDEV_METRICS), nif->queues[dir]);
+		}
+		if (nif->irq_cpu) {
+			stress_netdev_cpu_list(sampler, nif->irq_cpu, cpus, sizeof(cpus));
+			if (*cpus) {
+				pr_inf_lock(&lock, "%s: %s irqs on %s, imbalance %.2f (busiest/mean of %zu cpus)\n",
+					args->name, nif->name, cpus,
+					stress_netdev_imbalance(nif->irq_cpu, sampler->cpus, 1),
+					sampler->cpus);
+			}
+		}
+	}
+	if (args->instance == 0) {
+		if (!busiest)
+			pr_inf_lock(&lock, "%s: no traffic on the sampled interfaces\n", args->name);
+		for (dir = NETDEV_RX; dir <= NETDEV_TX; dir++) {
+			stress_netdev_cpu_list(sampler, sampler->softirq[dir], cpus, sizeof(cpus));
+			if (!*cpus)
+				continue;
+			pr_inf_lock(&lock, "%s: NET_%s softirqs on %s, imbalance %.2f (busiest/mean of %zu cpus)\n",
+				args->name, dir == NETDEV_RX ? "RX" : "TX", cpus,
+				stress_netdev_imbalance(sampler->softirq[dir], sampler->cpus, 1),
+				sampler->cpus);
+		}
+		pr_unlock(&lock);
+	}
+
+	if (!busiest)
+		return;
+	for (dir = NETDEV_RX; dir <= NETDEV_TX; dir++) {
+		q_imbalance[dir] = stress_netdev_imbalance(&busiest->qtotal[dir][0][NETDEV_PACKETS],
+			busiest->queues[dir], NETDEV_METRICS);
+	}
+	if (busiest->irq_cpu)
+		irq_imbalance = stress_netdev_imbalance(busiest->irq_cpu, sampler->cpus, 1);
+
+	stress_misc_stats_set(args->misc_stats, 0, "busiest if rx MB per sec",
+		(double)busiest->total[NETDEV_RX][NETDEV_BYTES] / (double)MB / duration);
+	stress_misc_stats_set(args->misc_stats, 1, "busiest if tx MB per sec",
+		(double)busiest->total[NETDEV_TX][NETDEV_BYTES] / (double)MB / duration);
+	stress_misc_stats_set(args->misc_stats, 2, "busiest if rx drops per sec",
+		(double)busiest->total[NETDEV_RX][NETDEV_DROPS] / duration);
+	stress_misc_stats_set(args->misc_stats, 3, "busiest if tx drops per sec",
+		(double)busiest->total[NETDEV_TX][NETDEV_DROPS] / duration);
+	stress_misc_stats_set(args->misc_stats, 4, "rx queue imbalance", q_imbalance[NETDEV_RX]);
+	stress_misc_stats_set(args->misc_stats, 5, "tx queue imbalance", q_imbalance[NETDEV_TX]);
+	stress_misc_stats_set(args->misc_stats, 6, "irq cpu imbalance", irq_imbalance);
+	stress_misc_stats_set(args->misc_stats, 7, "NET_RX softirq cpu imbalance",
+		stress_netdev_imbalance(sampler->softirq[NETDEV_RX], sampler->cpus, 1));
+}
+
+/*
+ *  stress_netdev_stats()
+ *	sample the interface, queue, irq and softirq counters while
+ *	other network stressors run, one bogo op per sample
+ */
+static int stress_netdev_stats(const stress_args_t *args, const int fd)
+{
+	stress_netdev_sampler_t *sampler;
+	uint64_t netdev_interval = DEFAULT_NETDEV_INTERVAL;
+	char *netdev_if = NULL;
+
+	(void)stress_get_setting("netdev-interval", &netdev_interval);
+	(void)stress_get_setting("netdev-if", &netdev_if);
+
+	sampler = calloc(1, sizeof(*sampler));
+	if (!sampler) {
+		pr_inf("%s: cannot allocate sampler, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (stress_netdev_sampler_init(fd, sampler, netdev_if) < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: no network interface%s%s found in /sys/class/net, "
+				"skipping stressor\n", args->name,
+				netdev_if ? " " : "s", netdev_if ? netdev_if : "");
+		stress_netdev_sampler_free(sampler);
+		free(sampler);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+	if (args->instance == 0) {
+		size_t i;
+
+		for (i = 0; i < sampler->n_ifs; i++) {
+			const stress_netdev_if_t *nif = &sampler->ifs[i];
+
+			pr_dbg("%s: %s: %zu rx and %zu tx queues, %s netlink queue stats, "
+				"%zu ethtool queue counters, %zu irqs\n", args->name, nif->name,
+				nif->queues[NETDEV_RX], nif->queues[NETDEV_TX],
+				nif->qs ? "with" : "no", nif->n_qstats, nif->n_irqs);
+		}
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	stress_netdev_sample(fd, sampler);
+	do {
+		(void)shim_usleep(netdev_interval * 1000);
+		stress_netdev_sample(fd, sampler);
+		inc_counter(args);
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_netdev_report(args, sampler);
+	stress_netdev_sampler_free(sampler);
+	free(sampler);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_netdev
  *	stress netdev
@@ -76,6 +1219,7 @@ static void stress_netdev_check(
 static int stress_netdev(const stress_args_t *args)
 {
 	int fd, rc = EXIT_SUCCESS;
+	bool netdev_stats = false;
 
 	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
 		pr_fail("%s: socket failed, errno=%d (%s)\n",
@@ -84,6 +1228,13 @@ static int stress_netdev(const stress_args_t *args)
 		return EXIT_NO_RESOURCE;
 	}
 
+	(void)stress_get_setting("netdev-stats", &netdev_stats);
+	if (netdev_stats) {
+		rc = stress_netdev_stats(args, fd);
+		(void)close(fd);
+		return rc;
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -242,12 +1393,14 @@ static int stress_netdev(const stress_args_t *args)
 stressor_info_t stress_netdev_info = {
 	.stressor = stress_netdev,
 	.class = CLASS_NETWORK,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_netdev_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_NETWORK,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -61,6 +61,7 @@ static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_cpu_online_all,	OPT_FLAGS_CPU_ONLINE_ALL },
 	{ OPT_dry_run,		OPT_FLAGS_DRY_RUN },
 	{ OPT_ftrace,		OPT_FLAGS_FTRACE },
+	{ OPT_ftrace_latency,	OPT_FLAGS_FTRACE_LATENCY | OPT_FLAGS_FTRACE },
 	{ OPT_ignite_cpu,	OPT_FLAGS_IGNITE_CPU },
 	{ OPT_keep_name, 	OPT_FLAGS_KEEP_NAME },
 	{ OPT_log_brief,	OPT_FLAGS_LOG_BRIEF },
@@ -84,6 +85,7 @@ static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_syslog,		OPT_FLAGS_SYSLOG },
 #endif
 	{ OPT_thrash, 		OPT_FLAGS_THRASH },
+	{ OPT_threads,		OPT_FLAGS_THREADS },
 	{ OPT_times,		OPT_FLAGS_TIMES },
 	{ OPT_timestamp,	OPT_FLAGS_TIMESTAMP },
 	{ OPT_thermal_zones,	OPT_FLAGS_THERMAL_ZONES },
@@ -225,13 +227,26 @@ static const struct option long_options[] = {
 	{ "aiol",		1,	0,	OPT_aiol},
 	{ "aiol-ops",		1,	0,	OPT_aiol_ops },
 	{ "aiol-requests",	1,	0,	OPT_aiol_requests },
+	{ "aiol-reap",		1,	0,	OPT_aiol_reap },
+	{ "aiol-nr-events",	1,	0,	OPT_aiol_nr_events },
+	{ "aiol-batch",		1,	0,	OPT_aiol_batch },
 	{ "alarm",		1,	0,	OPT_alarm },
 	{ "alarm-ops",		1,	0,	OPT_alarm_ops },
 	{ "all",		1,	0,	OPT_all },
 	{ "apparmor",		1,	0,	OPT_apparmor },
 	{ "apparmor-ops",	1,	0,	OPT_apparmor_ops },
+	{ "applaunch",		1,	0,	OPT_applaunch },
+	{ "applaunch-ops",	1,	0,	OPT_applaunch_ops },
+	{ "applaunch-trace",	1,	0,	OPT_applaunch_trace },
+	{ "applaunch-bg",	1,	0,	OPT_applaunch_bg },
+	{ "applaunch-bg-bytes",	1,	0,	OPT_applaunch_bg_bytes },
+	{ "applaunch-cold",	0,	0,	OPT_applaunch_cold },
 	{ "atomic",		1,	0,	OPT_atomic },
+	{ "atomic-bench",	0,	0,	OPT_atomic_bench },
+	{ "atomic-layout",	1,	0,	OPT_atomic_layout },
 	{ "atomic-ops",		1,	0,	OPT_atomic_ops },
+	{ "atomic-placement",	1,	0,	OPT_atomic_placement },
+	{ "atomic-threads",	1,	0,	OPT_atomic_threads },
 	{ "bad-altstack",	1,	0,	OPT_bad_altstack },
 	{ "bad-altstack-ops",	1,	0,	OPT_bad_altstack_ops },
 	{ "bad-ioctl",		1,	0,	OPT_bad_ioctl },
@@ -240,10 +255,13 @@ static const struct option long_options[] = {
 	{ "bigheap",		1,	0,	OPT_bigheap },
 	{ "bigheap-ops",	1,	0,	OPT_bigheap_ops },
 	{ "bigheap-growth",	1,	0,	OPT_bigheap_growth },
+	{ "bigheap-method",	1,	0,	OPT_bigheap_method },
 	{ "bind-mount",		1,	0,	OPT_bind_mount },
 	{ "bind-mount-ops",	1,	0,	OPT_bind_mount_ops },
 	{ "binderfs",		1,	0,	OPT_binderfs },
 	{ "binderfs-opts",	1,	0,	OPT_binderfs_ops },
+	{ "bpf",		0,	0,	OPT_bpf },
+	{ "bpf-period",		1,	0,	OPT_bpf_period },
 	{ "branch",		1,	0,	OPT_branch },
 	{ "branch-ops",		1,	0,	OPT_branch_ops },
 	{ "brk",		1,	0,	OPT_brk },
@@ -264,8 +282,13 @@ static const struct option long_options[] = {
 	{ "cache-sfence",	0,	0,	OPT_cache_sfence },
 	{ "cache-ways",		1,	0,	OPT_cache_ways},
 	{ "cache-no-affinity",	0,	0,	OPT_cache_no_affinity },
+	{ "cache-sweep",	0,	0,	OPT_cache_sweep },
 	{ "cap",		1,	0, 	OPT_cap },
 	{ "cap-ops",		1,	0, 	OPT_cap_ops },
+	{ "cgroup",		0,	0,	OPT_cgroup },
+	{ "cgroup-cpu-max",	1,	0,	OPT_cgroup_cpu_max },
+	{ "cgroup-io-max",	1,	0,	OPT_cgroup_io_max },
+	{ "cgroup-memory-high",	1,	0,	OPT_cgroup_memory_high },
 	{ "chattr",		1,	0, 	OPT_chattr },
 	{ "chattr-ops",		1,	0,	OPT_chattr_ops },
 	{ "chdir",		1,	0, 	OPT_chdir },
@@ -294,14 +317,24 @@ static const struct option long_options[] = {
 	{ "cpu-ops",		1,	0,	OPT_cpu_ops },
 	{ "cpu-load",		1,	0,	OPT_cpu_load },
 	{ "cpu-load-slice",	1,	0,	OPT_cpu_load_slice },
+	{ "cpu-calibrate",	1,	0,	OPT_cpu_calibrate },
+	{ "cpu-calibrate-tolerance",1,	0,	OPT_cpu_calibrate_tolerance },
 	{ "cpu-method",		1,	0,	OPT_cpu_method },
 	{ "cpu-online",		1,	0,	OPT_cpu_online },
 	{ "cpu-online-ops",	1,	0,	OPT_cpu_online_ops },
 	{ "cpu-online-all",	0,	0,	OPT_cpu_online_all },
 	{ "crypt",		1,	0,	OPT_crypt },
 	{ "crypt-ops",		1,	0,	OPT_crypt_ops },
+	{ "cryptospeed",	1,	0,	OPT_cryptospeed },
+	{ "cryptospeed-ops",	1,	0,	OPT_cryptospeed_ops },
+	{ "cryptospeed-backend",1,	0,	OPT_cryptospeed_backend },
+	{ "cryptospeed-alg",	1,	0,	OPT_cryptospeed_alg },
+	{ "cryptospeed-sizes",	1,	0,	OPT_cryptospeed_sizes },
+	{ "cryptospeed-batch",	1,	0,	OPT_cryptospeed_batch },
+	{ "cryptospeed-splice",	0,	0,	OPT_cryptospeed_splice },
 	{ "cyclic",		1,	0,	OPT_cyclic },
 	{ "cyclic-dist",	1,	0,	OPT_cyclic_dist },
+	{ "cyclic-load",	1,	0,	OPT_cyclic_load },
 	{ "cyclic-method",	1,	0,	OPT_cyclic_method },
 	{ "cyclic-ops",		1,	0,	OPT_cyclic_ops },
 	{ "cyclic-policy",	1,	0,	OPT_cyclic_policy },
@@ -326,6 +359,9 @@ static const struct option long_options[] = {
 	{ "dir",		1,	0,	OPT_dir },
 	{ "dir-ops",		1,	0,	OPT_dir_ops },
 	{ "dir-dirs",		1,	0,	OPT_dir_dirs },
+	{ "dir-scale",		0,	0,	OPT_dir_scale },
+	{ "dir-scale-mode",	1,	0,	OPT_dir_scale_mode },
+	{ "dir-scale-workers",	1,	0,	OPT_dir_scale_workers },
 	{ "dirdeep",		1,	0,	OPT_dirdeep },
 	{ "dirdeep-ops",	1,	0,	OPT_dirdeep_ops },
 	{ "dirdeep-dirs",	1,	0,	OPT_dirdeep_dirs },
@@ -349,6 +385,10 @@ static const struct option long_options[] = {
 	{ "epoll-ops",		1,	0,	OPT_epoll_ops },
 	{ "epoll-port",		1,	0,	OPT_epoll_port },
 	{ "epoll-domain",	1,	0,	OPT_epoll_domain },
+	{ "epoll-conns",	1,	0,	OPT_epoll_conns },
+	{ "epoll-method",	1,	0,	OPT_epoll_method },
+	{ "epoll-scale",	0,	0,	OPT_epoll_scale },
+	{ "epoll-threads",	1,	0,	OPT_epoll_threads },
 	{ "eventfd",		1,	0,	OPT_eventfd },
 	{ "eventfd-ops",	1,	0,	OPT_eventfd_ops },
 	{ "eventfd-nonblock",	0,	0,	OPT_eventfd_nonblock },
@@ -388,10 +428,16 @@ static const struct option long_options[] = {
 	{ "fp-error-ops",	1,	0,	OPT_fp_error_ops },
 	{ "fpunch",		1,	0,	OPT_fpunch },
 	{ "fpunch-ops",		1,	0,	OPT_fpunch_ops },
+	{ "frontend",		1,	0,	OPT_frontend },
+	{ "frontend-ops",	1,	0,	OPT_frontend_ops },
+	{ "frontend-size",	1,	0,	OPT_frontend_size },
+	{ "frontend-branch",	1,	0,	OPT_frontend_branch },
+	{ "frontend-targets",	1,	0,	OPT_frontend_targets },
 	{ "fstat",		1,	0,	OPT_fstat },
 	{ "fstat-ops",		1,	0,	OPT_fstat_ops },
 	{ "fstat-dir",		1,	0,	OPT_fstat_dir },
 	{ "ftrace",		0,	0,	OPT_ftrace },
+	{ "ftrace-latency",	0,	0,	OPT_ftrace_latency },
 	{ "full",		1,	0,	OPT_full },
 	{ "full-ops",		1,	0,	OPT_full_ops },
 	{ "funccall",		1,	0,	OPT_funccall },
@@ -413,11 +459,17 @@ static const struct option long_options[] = {
 	{ "goto-direction", 	1,	0,	OPT_goto_direction },
 	{ "handle",		1,	0,	OPT_handle },
 	{ "handle-ops",		1,	0,	OPT_handle_ops },
+	{ "hash",		1,	0,	OPT_hash },
+	{ "hash-ops",		1,	0,	OPT_hash_ops },
+	{ "hash-method",	1,	0,	OPT_hash_method },
 	{ "hdd",		1,	0,	OPT_hdd },
 	{ "hdd-ops",		1,	0,	OPT_hdd_ops },
 	{ "hdd-bytes",		1,	0,	OPT_hdd_bytes },
 	{ "hdd-write-size", 	1,	0,	OPT_hdd_write_size },
 	{ "hdd-opts",		1,	0,	OPT_hdd_opts },
+	{ "hdd-engine",		1,	0,	OPT_hdd_engine },
+	{ "hdd-qdepth",		1,	0,	OPT_hdd_qdepth },
+	{ "hdd-bs-mix",		1,	0,	OPT_hdd_bs_mix },
 	{ "heapsort",		1,	0,	OPT_heapsort },
 	{ "heapsort-ops",	1,	0,	OPT_heapsort_ops },
 	{ "heapsort-size",	1,	0,	OPT_heapsort_integers },
@@ -434,16 +486,25 @@ static const struct option long_options[] = {
 	{ "icmp-flood-ops",	1,	0,	OPT_icmp_flood_ops },
 	{ "idle-page",		1,	0,	OPT_idle_page },
 	{ "idle-page-ops",	1,	0,	OPT_idle_page_ops },
+	{ "idle-page-bench",	0,	0,	OPT_idle_page_bench },
+	{ "idle-page-bytes",	1,	0,	OPT_idle_page_bytes },
 	{ "ignite-cpu",		0,	0, 	OPT_ignite_cpu },
 	{ "inode-flags",	1,	0,	OPT_inode_flags },
 	{ "inode-flags-ops",	1,	0,	OPT_inode_flags_ops },
 	{ "inotify",		1,	0,	OPT_inotify },
 	{ "inotify-ops",	1,	0,	OPT_inotify_ops },
+	{ "interfere",		1,	0,	OPT_interfere },
+	{ "interfere-ops",	1,	0,	OPT_interfere_ops },
+	{ "interfere-hogs",	1,	0,	OPT_interfere_hogs },
+	{ "interfere-mba",	1,	0,	OPT_interfere_mba },
+	{ "interfere-l3",	1,	0,	OPT_interfere_l3 },
+	{ "interfere-probe-size",1,	0,	OPT_interfere_probe_size },
 	{ "io",			1,	0,	OPT_io },
 	{ "io-ops",		1,	0,	OPT_io_ops },
 	{ "iomix",		1,	0,	OPT_iomix },
 	{ "iomix-bytes",	1,	0,	OPT_iomix_bytes },
 	{ "iomix-ops",		1,	0,	OPT_iomix_ops },
+	{ "iomix-profile",	1,	0,	OPT_iomix_profile },
 	{ "ionice-class",	1,	0,	OPT_ionice_class },
 	{ "ionice-level",	1,	0,	OPT_ionice_level },
 	{ "ioport",		1,	0,	OPT_ioport },
@@ -452,8 +513,17 @@ static const struct option long_options[] = {
 	{ "ioprio",		1,	0,	OPT_ioprio },
 	{ "ioprio-ops",		1,	0,	OPT_ioprio_ops },
 	{ "iostat",		1,	0,	OPT_iostat },
+	{ "iostat-format",	1,	0,	OPT_iostat_format },
 	{ "io-uring",		1,	0,	OPT_io_uring },
 	{ "io-uring-ops",	1,	0,	OPT_io_uring_ops },
+	{ "io-uring-depth",	1,	0,	OPT_io_uring_depth },
+	{ "io-uring-fixed",	0,	0,	OPT_io_uring_fixed },
+	{ "io-uring-sqpoll",	0,	0,	OPT_io_uring_sqpoll },
+	{ "io-uring-throughput",	0,	0,	OPT_io_uring_throughput },
+	{ "ipcspeed",		1,	0,	OPT_ipcspeed },
+	{ "ipcspeed-ops",	1,	0,	OPT_ipcspeed_ops },
+	{ "ipcspeed-mech",	1,	0,	OPT_ipcspeed_mech },
+	{ "ipcspeed-sizes",	1,	0,	OPT_ipcspeed_sizes },
 	{ "ipsec-mb",		1,	0,	OPT_ipsec_mb },
 	{ "ipsec-mb-ops",	1,	0,	OPT_ipsec_mb_ops },
 	{ "ipsec-mb-feature",	1,	0,	OPT_ipsec_mb_feature },
@@ -480,6 +550,7 @@ static const struct option long_options[] = {
 	{ "l1cache-sets",	1,	0,	OPT_l1cache_sets},
 	{ "l1cache-size",	1,	0,	OPT_l1cache_size },
 	{ "l1cache-ways",	1,	0,	OPT_l1cache_ways},
+	{ "l1cache-sweep",	0,	0,	OPT_l1cache_sweep },
 	{ "landlock",		1,	0,	OPT_landlock },
 	{ "landlock-ops",	1,	0,	OPT_landlock_ops },
 	{ "lease",		1,	0,	OPT_lease },
@@ -493,6 +564,13 @@ static const struct option long_options[] = {
 	{ "list-size",		1,	0,	OPT_list_size },
 	{ "loadavg",		1,	0,	OPT_loadavg },
 	{ "loadavg-ops",	1,	0,	OPT_loadavg_ops },
+	{ "lock",		1,	0,	OPT_lock },
+	{ "lock-ops",		1,	0,	OPT_lock_ops },
+	{ "lock-method",	1,	0,	OPT_lock_method },
+	{ "lock-threads",	1,	0,	OPT_lock_threads },
+	{ "lock-cs",		1,	0,	OPT_lock_cs },
+	{ "lock-readers",	1,	0,	OPT_lock_readers },
+	{ "lock-placement",	1,	0,	OPT_lock_placement },
 	{ "locka",		1,	0,	OPT_locka },
 	{ "locka-ops",		1,	0,	OPT_locka_ops },
 	{ "lockbus",		1,	0,	OPT_lockbus },
@@ -514,16 +592,19 @@ static const struct option long_options[] = {
 	{ "madvise",		1,	0,	OPT_madvise },
 	{ "madvise-ops",	1,	0,	OPT_madvise_ops },
 	{ "malloc",		1,	0,	OPT_malloc },
+	{ "malloc-allocator",1,	0,	OPT_malloc_allocator },
 	{ "malloc-bytes",	1,	0,	OPT_malloc_bytes },
 	{ "malloc-max",		1,	0,	OPT_malloc_max },
 	{ "malloc-ops",		1,	0,	OPT_malloc_ops },
 	{ "malloc-pthreads",	1,	0,	OPT_malloc_pthreads },
 	{ "malloc-thresh",	1,	0,	OPT_malloc_threshold },
 	{ "malloc-touch",	0,	0,	OPT_malloc_touch },
+	{ "malloc-trace",	0,	0,	OPT_malloc_trace },
 	{ "matrix",		1,	0,	OPT_matrix },
 	{ "matrix-ops",		1,	0,	OPT_matrix_ops },
 	{ "matrix-method",	1,	0,	OPT_matrix_method },
 	{ "matrix-size",	1,	0,	OPT_matrix_size },
+	{ "matrix-threads",	1,	0,	OPT_matrix_threads },
 	{ "matrix-yx",		0,	0,	OPT_matrix_yx },
 	{ "matrix-3d",		1,	0,	OPT_matrix_3d },
 	{ "matrix-3d-ops",	1,	0,	OPT_matrix_3d_ops },
@@ -536,9 +617,12 @@ static const struct option long_options[] = {
 	{ "mcontend-ops",	1,	0,	OPT_mcontend_ops },
 	{ "membarrier",		1,	0,	OPT_membarrier },
 	{ "membarrier-ops",	1,	0,	OPT_membarrier_ops },
+	{ "membarrier-bench",	0,	0,	OPT_membarrier_bench },
+	{ "membarrier-threads",1,	0,	OPT_membarrier_threads },
 	{ "memcpy",		1,	0,	OPT_memcpy },
 	{ "memcpy-ops",		1,	0,	OPT_memcpy_ops },
 	{ "memcpy-method",	1,	0,	OPT_memcpy_method },
+	{ "memcpy-compare",	0,	0,	OPT_memcpy_compare },
 	{ "memfd",		1,	0,	OPT_memfd },
 	{ "memfd-ops",		1,	0,	OPT_memfd_ops },
 	{ "memfd-bytes",	1,	0,	OPT_memfd_bytes },
@@ -550,12 +634,15 @@ static const struct option long_options[] = {
 	{ "memrate-rd-mbs",	1,	0,	OPT_memrate_rd_mbs },
 	{ "memrate-wr-mbs",	1,	0,	OPT_memrate_wr_mbs },
 	{ "memrate-bytes",	1,	0,	OPT_memrate_bytes },
+	{ "memrate-latency",	0,	0,	OPT_memrate_latency },
 	{ "memthrash",		1,	0,	OPT_memthrash },
 	{ "memthrash-ops",	1,	0,	OPT_memthrash_ops },
 	{ "memthrash-method",	1,	0,	OPT_memthrash_method },
 	{ "mergesort",		1,	0,	OPT_mergesort },
 	{ "mergesort-ops",	1,	0,	OPT_mergesort_ops },
 	{ "mergesort-size",	1,	0,	OPT_mergesort_integers },
+	{ "mergesort-threads",	1,	0,	OPT_mergesort_threads },
+	{ "mergesort-elem-size",1,	0,	OPT_mergesort_elem_size },
 	{ "metrics",		0,	0,	OPT_metrics },
 	{ "metrics-brief",	0,	0,	OPT_metrics_brief },
 	{ "mincore",		1,	0,	OPT_mincore },
@@ -581,6 +668,7 @@ static const struct option long_options[] = {
 	{ "mmap-osync",		0,	0,	OPT_mmap_osync },
 	{ "mmap-odirect",	0,	0,	OPT_mmap_odirect },
 	{ "mmap-mmap2",		0,	0,	OPT_mmap_mmap2 },
+	{ "mmap-threads",	1,	0,	OPT_mmap_threads },
 	{ "mmapaddr",		1,	0,	OPT_mmapaddr },
 	{ "mmapaddr-ops",	1,	0,	OPT_mmapaddr_ops },
 	{ "mmapfixed",		1,	0,	OPT_mmapfixed},
@@ -590,6 +678,7 @@ static const struct option long_options[] = {
 	{ "mmaphuge",		1,	0,	OPT_mmaphuge },
 	{ "mmaphuge-ops",	1,	0,	OPT_mmaphuge_ops },
 	{ "mmaphuge-mmaps",	1,	0,	OPT_mmaphuge_mmaps },
+	{ "mmaphuge-measure",	0,	0,	OPT_mmaphuge_measure },
 	{ "mmapmany",		1,	0,	OPT_mmapmany },
 	{ "mmapmany-ops",	1,	0,	OPT_mmapmany_ops },
 	{ "mq",			1,	0,	OPT_mq },
@@ -611,6 +700,9 @@ static const struct option long_options[] = {
 	{ "nanosleep-ops",	1,	0,	OPT_nanosleep_ops },
 	{ "netdev",		1,	0,	OPT_netdev },
 	{ "netdev-ops",		1,	0,	OPT_netdev_ops },
+	{ "netdev-if",		1,	0,	OPT_netdev_if },
+	{ "netdev-interval",1,	0,	OPT_netdev_interval },
+	{ "netdev-stats",	0,	0,	OPT_netdev_stats },
 	{ "netlink-proc",	1,	0,	OPT_netlink_proc },
 	{ "netlink-proc-ops",	1,	0,	OPT_netlink_proc_ops },
 	{ "netlink-task",	1,	0,	OPT_netlink_task },
@@ -627,6 +719,7 @@ static const struct option long_options[] = {
 	{ "null-ops",		1,	0,	OPT_null_ops },
 	{ "numa",		1,	0,	OPT_numa },
 	{ "numa-ops",		1,	0,	OPT_numa_ops },
+	{ "numa-policy",	1,	0,	OPT_numa_policy },
 	{ "oomable",		0,	0,	OPT_oomable },
 	{ "oom-pipe",		1,	0,	OPT_oom_pipe },
 	{ "oom-pipe-ops",	1,	0,	OPT_oom_pipe_ops },
@@ -637,6 +730,13 @@ static const struct option long_options[] = {
 	{ "open-fd",		0,	0,	OPT_open_fd },
 	{ "open-ops",		1,	0,	OPT_open_ops },
 	{ "page-in",		0,	0,	OPT_page_in },
+	{ "pagecache",		1,	0,	OPT_pagecache },
+	{ "pagecache-ops",	1,	0,	OPT_pagecache_ops },
+	{ "pagecache-bytes",	1,	0,	OPT_pagecache_bytes },
+	{ "pagecache-skew",	1,	0,	OPT_pagecache_skew },
+	{ "pagecache-run",	1,	0,	OPT_pagecache_run },
+	{ "pagecache-read-size",	1,	0,	OPT_pagecache_read_size },
+	{ "pagecache-advice",	1,	0,	OPT_pagecache_advice },
 	{ "parallel",		1,	0,	OPT_all },
 	{ "pathological",	0,	0,	OPT_pathological },
 	{ "pci",		1,	0,	OPT_pci},
@@ -644,6 +744,8 @@ static const struct option long_options[] = {
 #if defined(STRESS_PERF_STATS) && 	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	{ "perf",		0,	0,	OPT_perf_stats },
+	{ "pressure",		1,	0,	OPT_pressure },
+	{ "pressure-full",	0,	0,	OPT_pressure_full },
 #endif
 	{ "personality",	1,	0,	OPT_personality },
 	{ "personality-ops",	1,	0,	OPT_personality_ops },
@@ -672,11 +774,21 @@ static const struct option long_options[] = {
 	{ "prefetch",		1,	0,	OPT_prefetch },
 	{ "prefetch-ops",	1,	0,	OPT_prefetch_ops },
 	{ "prefetch-l3-size",	1,	0,	OPT_prefetch_l3_size },
+	{ "prefetch-sweep",	0,	0,	OPT_prefetch_sweep },
+	{ "prefetch-hwpf",	0,	0,	OPT_prefetch_hwpf },
 	{ "procfs",		1,	0,	OPT_procfs },
 	{ "procfs-ops",		1,	0,	OPT_procfs_ops },
+	{ "procread",		1,	0,	OPT_procread },
+	{ "procread-ops",	1,	0,	OPT_procread_ops },
+	{ "procread-paths",	1,	0,	OPT_procread_paths },
+	{ "procread-hot",	1,	0,	OPT_procread_hot },
+	{ "procread-threads",	1,	0,	OPT_procread_threads },
+	{ "procread-top",	1,	0,	OPT_procread_top },
 	{ "pthread",		1,	0,	OPT_pthread },
 	{ "pthread-ops",	1,	0,	OPT_pthread_ops },
 	{ "pthread-max",	1,	0,	OPT_pthread_max },
+	{ "pthread-method",	1,	0,	OPT_pthread_method },
+	{ "pthread-pool",	1,	0,	OPT_pthread_pool },
 	{ "ptrace",		1,	0,	OPT_ptrace },
 	{ "ptrace-ops",		1,	0,	OPT_ptrace_ops },
 	{ "pty",		1,	0,	OPT_pty },
@@ -685,12 +797,16 @@ static const struct option long_options[] = {
 	{ "qsort",		1,	0,	OPT_qsort },
 	{ "qsort-ops",		1,	0,	OPT_qsort_ops },
 	{ "qsort-size",		1,	0,	OPT_qsort_integers },
+	{ "qsort-threads",	1,	0,	OPT_qsort_threads },
+	{ "qsort-elem-size",	1,	0,	OPT_qsort_elem_size },
 	{ "quiet",		0,	0,	OPT_quiet },
 	{ "quota",		1,	0,	OPT_quota },
 	{ "quota-ops",		1,	0,	OPT_quota_ops },
 	{ "radixsort",		1,	0,	OPT_radixsort },
 	{ "radixsort-ops",	1,	0,	OPT_radixsort_ops },
 	{ "radixsort-size",	1,	0,	OPT_radixsort_size },
+	{ "radixsort-threads",	1,	0,	OPT_radixsort_threads },
+	{ "radixsort-elem-size",1,	0,	OPT_radixsort_elem_size },
 	{ "ramfs",		1,	0,	OPT_ramfs },
 	{ "ramfs-ops",		1,	0,	OPT_ramfs_ops },
 	{ "ramfs-size",		1,	0,	OPT_ramfs_size },
@@ -706,6 +822,9 @@ static const struct option long_options[] = {
 	{ "rawpkt",		1,	0,	OPT_rawpkt },
 	{ "rawpkt-ops",		1,	0,	OPT_rawpkt_ops },
 	{ "rawpkt-port",	1,	0,	OPT_rawpkt_port },
+	{ "rawpkt-xdp",		0,	0,	OPT_rawpkt_xdp },
+	{ "rawpkt-xdp-if",	1,	0,	OPT_rawpkt_xdp_if },
+	{ "rawpkt-xdp-zerocopy",0,	0,	OPT_rawpkt_xdp_zerocopy },
 	{ "rawsock",		1,	0,	OPT_rawsock },
 	{ "rawsock-ops",	1,	0,	OPT_rawsock_ops },
 	{ "rawudp",		1,	0,	OPT_rawudp },
@@ -725,6 +844,10 @@ static const struct option long_options[] = {
 	{ "rename-ops",		1,	0,	OPT_rename_ops },
 	{ "resched",		1,	0,	OPT_resched },
 	{ "resched-ops",	1,	0,	OPT_resched_ops },
+	{ "results-db",		1,	0,	OPT_results_db },
+	{ "results-baseline",	1,	0,	OPT_results_baseline },
+	{ "results-threshold",	1,	0,	OPT_results_threshold },
+	{ "results-key",	1,	0,	OPT_results_key },
 	{ "resources",		1,	0,	OPT_resources },
 	{ "resources-ops",	1,	0,	OPT_resources_ops },
 	{ "revio",		1,	0,	OPT_revio },
@@ -737,12 +860,23 @@ static const struct option long_options[] = {
 	{ "rmap-ops",		1,	0,	OPT_rmap_ops },
 	{ "rseq",		1,	0,	OPT_rseq },
 	{ "rseq-ops",		1,	0,	OPT_rseq_ops },
+	{ "rseq-bench",		0,	0,	OPT_rseq_bench },
+	{ "rseq-threads",	1,	0,	OPT_rseq_threads },
+	{ "rseq-preempt",	1,	0,	OPT_rseq_preempt },
 	{ "rtc",		1,	0,	OPT_rtc },
 	{ "rtc-ops",		1,	0,	OPT_rtc_ops },
+	{ "sample",		1,	0,	OPT_sample },
+	{ "sample-file",	1,	0,	OPT_sample_file },
+	{ "sample-format",	1,	0,	OPT_sample_format },
 	{ "sched",		1,	0,	OPT_sched },
 	{ "sched-prio",		1,	0,	OPT_sched_prio },
 	{ "schedpolicy",	1,	0,	OPT_schedpolicy },
 	{ "schedpolicy-ops",	1,	0,	OPT_schedpolicy_ops },
+	{ "schedpolicy-bench",0,	0,	OPT_schedpolicy_bench },
+	{ "schedpolicy-hogs",1,	0,	OPT_schedpolicy_hogs },
+	{ "schedpolicy-period",1,	0,	OPT_schedpolicy_period },
+	{ "schedpolicy-uclamp",1,	0,	OPT_schedpolicy_uclamp },
+	{ "schedpolicy-work",1,	0,	OPT_schedpolicy_work },
 	{ "sched-period",	1,	0,	OPT_sched_period },
 	{ "sched-runtime",	1,	0,	OPT_sched_runtime },
 	{ "sched-deadline",	1,	0,	OPT_sched_deadline },
@@ -817,8 +951,12 @@ static const struct option long_options[] = {
 	{ "sigtrap",		1,	0,	OPT_sigtrap },
 	{ "sigtrap-ops",	1,	0,	OPT_sigtrap_ops},
 	{ "skiplist",		1,	0,	OPT_skiplist },
+	{ "skiplist-method",1,	0,	OPT_skiplist_method },
 	{ "skiplist-ops",	1,	0,	OPT_skiplist_ops },
+	{ "skiplist-read",	1,	0,	OPT_skiplist_read },
 	{ "skiplist-size",	1,	0,	OPT_skiplist_size },
+	{ "skiplist-skew",	1,	0,	OPT_skiplist_skew },
+	{ "skiplist-threads",1,	0,	OPT_skiplist_threads },
 	{ "skip-silent",	0,	0,	OPT_skip_silent },
 	{ "sleep",		1,	0,	OPT_sleep },
 	{ "sleep-ops",		1,	0,	OPT_sleep_ops },
@@ -827,7 +965,10 @@ static const struct option long_options[] = {
 	{ "smi",		1,	0,	OPT_smi },
 	{ "smi-ops",		1,	0,	OPT_smi_ops },
 	{ "sock",		1,	0,	OPT_sock },
+	{ "sock-busy-poll",	1,	0,	OPT_sock_busy_poll },
 	{ "sock-domain",	1,	0,	OPT_sock_domain },
+	{ "sock-msgs",		1,	0,	OPT_sock_msgs },
+	{ "sock-msg-size",	1,	0,	OPT_sock_msg_size },
 	{ "sock-nodelay",	0,	0,	OPT_sock_nodelay },
 	{ "sock-ops",		1,	0,	OPT_sock_ops },
 	{ "sock-opts",		1,	0,	OPT_sock_opts },
@@ -850,6 +991,12 @@ static const struct option long_options[] = {
 	{ "softlockup-ops",	1,	0,	OPT_softlockup_ops },
 	{ "spawn",		1,	0,	OPT_spawn },
 	{ "spawn-ops",		1,	0,	OPT_spawn_ops },
+	{ "spawnscale",		1,	0,	OPT_spawnscale },
+	{ "spawnscale-ops",	1,	0,	OPT_spawnscale_ops },
+	{ "spawnscale-method",	1,	0,	OPT_spawnscale_method },
+	{ "spawnscale-rss",	1,	0,	OPT_spawnscale_rss },
+	{ "spawnscale-threads",	1,	0,	OPT_spawnscale_threads },
+	{ "spawnscale-thp",	0,	0,	OPT_spawnscale_thp },
 	{ "splice",		1,	0,	OPT_splice },
 	{ "splice-bytes",	1,	0,	OPT_splice_bytes },
 	{ "splice-ops",		1,	0,	OPT_splice_ops },
@@ -868,11 +1015,23 @@ static const struct option long_options[] = {
 	{ "stream-index",	1,	0,	OPT_stream_index },
 	{ "stream-l3-size",	1,	0,	OPT_stream_l3_size },
 	{ "stream-madvise",	1,	0,	OPT_stream_madvise },
+	{ "stream-nt",		0,	0,	OPT_stream_nt },
 	{ "swap",		1,	0,	OPT_swap },
 	{ "swap-ops",		1,	0,	OPT_swap_ops },
+	{ "swaprate",		1,	0,	OPT_swaprate },
+	{ "swaprate-ops",	1,	0,	OPT_swaprate_ops },
+	{ "swaprate-bytes",	1,	0,	OPT_swaprate_bytes },
+	{ "swaprate-hot",	1,	0,	OPT_swaprate_hot },
+	{ "swaprate-hot-size",1,	0,	OPT_swaprate_hot_size },
+	{ "swaprate-target",	1,	0,	OPT_swaprate_target },
 	{ "switch",		1,	0,	OPT_switch },
 	{ "switch-ops",		1,	0,	OPT_switch_ops },
 	{ "switch-freq",	1,	0,	OPT_switch_freq },
+	{ "switch-matrix",	0,	0,	OPT_switch_matrix },
+	{ "switch-method",	1,	0,	OPT_switch_method },
+	{ "switch-placement",	1,	0,	OPT_switch_placement },
+	{ "switch-producers",	1,	0,	OPT_switch_producers },
+	{ "switch-consumers",	1,	0,	OPT_switch_consumers },
 	{ "symlink",		1,	0,	OPT_symlink },
 	{ "symlink-ops",	1,	0,	OPT_symlink_ops },
 	{ "sync-file",		1,	0,	OPT_sync_file },
@@ -897,6 +1056,12 @@ static const struct option long_options[] = {
 	{ "tee",		1,	0,	OPT_tee },
 	{ "tee-ops",		1,	0,	OPT_tee_ops },
 	{ "temp-path",		1,	0,	OPT_temp_path },
+	{ "tiering",		1,	0,	OPT_tiering },
+	{ "tiering-ops",	1,	0,	OPT_tiering_ops },
+	{ "tiering-bytes",	1,	0,	OPT_tiering_bytes },
+	{ "tiering-hot",	1,	0,	OPT_tiering_hot },
+	{ "tiering-fast",	1,	0,	OPT_tiering_fast },
+	{ "tiering-slow",	1,	0,	OPT_tiering_slow },
 	{ "timeout",		1,	0,	OPT_timeout },
 	{ "timer",		1,	0,	OPT_timer },
 	{ "timer-ops",		1,	0,	OPT_timer_ops },
@@ -910,6 +1075,7 @@ static const struct option long_options[] = {
 	{ "timer-slack"	,	1,	0,	OPT_timer_slack },
 	{ "tlb-shootdown",	1,	0,	OPT_tlb_shootdown },
 	{ "tlb-shootdown-ops",	1,	0,	OPT_tlb_shootdown_ops },
+	{ "tlb-shootdown-threads",1,	0,	OPT_tlb_shootdown_threads },
 	{ "tmpfs",		1,	0,	OPT_tmpfs },
 	{ "tmpfs-ops",		1,	0,	OPT_tmpfs_ops },
 	{ "tmpfs-mmap-async",	0,	0,	OPT_tmpfs_mmap_async },
@@ -918,6 +1084,7 @@ static const struct option long_options[] = {
 	{ "tree-ops",		1,	0,	OPT_tree_ops },
 	{ "tree-method",	1,	0,	OPT_tree_method },
 	{ "tree-size",		1,	0,	OPT_tree_size },
+	{ "tree-alloc",		1,	0,	OPT_tree_alloc },
 	{ "tsc",		1,	0,	OPT_tsc },
 	{ "tsc-ops",		1,	0,	OPT_tsc_ops },
 	{ "tsearch",		1,	0,	OPT_tsearch },
@@ -925,9 +1092,13 @@ static const struct option long_options[] = {
 	{ "tsearch-size",	1,	0,	OPT_tsearch_size },
 	{ "thermalstat",	1,	0,	OPT_thermalstat },
 	{ "thrash",		0,	0,	OPT_thrash },
+	{ "threads",		0,	0,	OPT_threads },
 	{ "times",		0,	0,	OPT_times },
 	{ "timestamp",		0,	0,	OPT_timestamp },
 	{ "tz",			0,	0,	OPT_thermal_zones },
+	{ "tz-power",		1,	0,	OPT_tz_power },
+	{ "tz-target",		1,	0,	OPT_tz_target },
+	{ "tz-zone",		1,	0,	OPT_tz_zone },
 	{ "tun",		1,	0,	OPT_tun},
 	{ "tun-ops",		1,	0,	OPT_tun_ops },
 	{ "tun-tap",		0,	0,	OPT_tun_tap },
@@ -947,7 +1118,10 @@ static const struct option long_options[] = {
 	{ "urandom-ops",	1,	0,	OPT_urandom_ops },
 	{ "userfaultfd",	1,	0,	OPT_userfaultfd },
 	{ "userfaultfd-ops",	1,	0,	OPT_userfaultfd_ops },
+	{ "userfaultfd-batch",	1,	0,	OPT_userfaultfd_batch },
 	{ "userfaultfd-bytes",	1,	0,	OPT_userfaultfd_bytes },
+	{ "userfaultfd-mode",	1,	0,	OPT_userfaultfd_mode },
+	{ "userfaultfd-threads",1,	0,	OPT_userfaultfd_threads },
 	{ "utime",		1,	0,	OPT_utime },
 	{ "utime-ops",		1,	0,	OPT_utime_ops },
 	{ "utime-fsync",	0,	0,	OPT_utime_fsync },
@@ -956,8 +1130,10 @@ static const struct option long_options[] = {
 	{ "vdso-func",		1,	0,	OPT_vdso_func },
 	{ "vecmath",		1,	0,	OPT_vecmath },
 	{ "vecmath-ops",	1,	0,	OPT_vecmath_ops },
+	{ "vecmath-freq",	0,	0,	OPT_vecmath_freq },
 	{ "vecwide",		1,	0,	OPT_vecwide},
 	{ "vecwide-ops",	1,	0,	OPT_vecwide_ops },
+	{ "vecwide-freq",	0,	0,	OPT_vecwide_freq },
 	{ "verbose",		0,	0,	OPT_verbose },
 	{ "verify",		0,	0,	OPT_verify },
 	{ "verity",		1,	0,	OPT_verity },
@@ -983,12 +1159,18 @@ static const struct option long_options[] = {
 	{ "vm-ops",		1,	0,	OPT_vm_ops },
 	{ "vm-madvise",		1,	0,	OPT_vm_madvise },
 	{ "vm-method",		1,	0,	OPT_vm_method },
+	{ "vm-threads",		1,	0,	OPT_vm_threads },
 	{ "vm-addr",		1,	0,	OPT_vm_addr },
 	{ "vm-addr-ops",	1,	0,	OPT_vm_addr_ops },
 	{ "vm-addr-method",	1,	0,	OPT_vm_addr_method },
 	{ "vm-rw",		1,	0,	OPT_vm_rw },
+	{ "vm-rw-bench",	0,	0,	OPT_vm_rw_bench },
 	{ "vm-rw-bytes",	1,	0,	OPT_vm_rw_bytes },
+	{ "vm-rw-hugepages",	0,	0,	OPT_vm_rw_hugepages },
+	{ "vm-rw-iov",		1,	0,	OPT_vm_rw_iov },
 	{ "vm-rw-ops",		1,	0,	OPT_vm_rw_ops },
+	{ "vm-rw-peers",	1,	0,	OPT_vm_rw_peers },
+	{ "vm-rw-seg",		1,	0,	OPT_vm_rw_seg },
 	{ "vm-segv",		1,	0,	OPT_vm_segv },
 	{ "vm-segv-ops",	1,	0,	OPT_vm_segv_ops },
 	{ "vm-splice",		1,	0,	OPT_vm_splice },
@@ -1012,6 +1194,11 @@ static const struct option long_options[] = {
 	{ "yield-ops",		1,	0,	OPT_yield_ops },
 	{ "zero",		1,	0,	OPT_zero },
 	{ "zero-ops",		1,	0,	OPT_zero_ops },
+	{ "zerocopy",		1,	0,	OPT_zerocopy },
+	{ "zerocopy-ops",	1,	0,	OPT_zerocopy_ops },
+	{ "zerocopy-method",	1,	0,	OPT_zerocopy_method },
+	{ "zerocopy-bytes",	1,	0,	OPT_zerocopy_bytes },
+	{ "zerocopy-chunk",	1,	0,	OPT_zerocopy_chunk },
 	{ "zlib",		1,	0,	OPT_zlib },
 	{ "zlib-ops",		1,	0,	OPT_zlib_ops },
 	{ "zlib-method",	1,	0,	OPT_zlib_method },
@@ -1020,9 +1207,15 @@ static const struct option long_options[] = {
 	{ "zlib-window-bits",	1,	0,	OPT_zlib_window_bits },
 	{ "zlib-stream-bytes",	1,	0,	OPT_zlib_stream_bytes, },
 	{ "zlib-strategy",	1,	0,	OPT_zlib_strategy, },
+	{ "zlib-threads",	1,	0,	OPT_zlib_threads },
 	{ "zombie",		1,	0,	OPT_zombie },
 	{ "zombie-ops",		1,	0,	OPT_zombie_ops },
 	{ "zombie-max",		1,	0,	OPT_zombie_max },
+	{ "zram",		1,	0,	OPT_zram },
+	{ "zram-ops",		1,	0,	OPT_zram_ops },
+	{ "zram-algos",		1,	0,	OPT_zram_algos },
+	{ "zram-data",		1,	0,	OPT_zram_data },
+	{ "zram-size",		1,	0,	OPT_zram_size },
 	{ NULL,			0,	0,	0 }
 };
 
@@ -1034,13 +1227,22 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"aggressive",		"enable all aggressive options" },
 	{ "a N",	"all N",		"start N workers of each stress test" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
+	{ NULL,		"bpf",			"per stressor latencies from in-kernel BPF programs" },
+	{ NULL,		"bpf-period N",		"also report the BPF latencies every N seconds" },
+	{ NULL,		"cgroup",		"run each stressor in its own cgroup v2 group and report its accounting" },
+	{ NULL,		"cgroup-cpu-max Q",	"set cpu.max of each stressor group, e.g. \"50000 100000\"" },
+	{ NULL,		"cgroup-io-max L",	"set io.max of each stressor group, e.g. \"8:0 wbps=1048576\"" },
+	{ NULL,		"cgroup-memory-high N",	"set memory.high of each stressor group" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
 	{ "n",		"dry-run",		"do not run" },
 	{ NULL,		"ftrace",		"enable kernel function call tracing" },
+	{ NULL,		"ftrace-latency",	"per stressor system call latency percentiles" },
 	{ "h",		"help",			"show help" },
 	{ NULL,		"ignite-cpu",		"alter kernel controls to make CPU run hot" },
 	{ NULL,		"ionice-class C",	"specify ionice class (idle, besteffort, realtime)" },
 	{ NULL,		"ionice-level L",	"specify ionice level (0 max, 7 min)" },
+	{ NULL,		"iostat S",		"show I/O statistics every S seconds" },
+	{ NULL,		"iostat-format fmt",	"output I/O statistics as text, json lines or yaml" },
 	{ "j",		"job jobfile",		"run the named jobfile" },
 	{ "k",		"keep-name",		"keep stress worker names to be 'stress-ng'" },
 	{ NULL,		"log-brief",		"less verbose log messages" },
@@ -1052,6 +1254,7 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"minimize",		"enable minimal stress options" },
 	{ NULL,		"no-madvise",		"don't use random madvise options for each mmap" },
 	{ NULL,		"no-rand-seed",		"seed random numbers with the same constant" },
+	{ NULL,		"numa-policy P",	"place memory stressor buffers: local, interleave, remote, bind=N" },
 	{ NULL,		"oomable",		"Do not respawn a stressor if it gets OOM'd" },
 	{ NULL,		"page-in",		"touch allocated pages that are not in core" },
 	{ NULL,		"parallel N",		"synonym for 'all N'" },
@@ -1059,9 +1262,18 @@ static const stress_help_t help_generic[] = {
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	{ NULL,		"perf",			"display perf statistics" },
+	{ NULL,		"pressure P",		"ramp up to and hold P% memory pressure stall time" },
+	{ NULL,		"pressure-full",	"use the full rather than some memory pressure" },
 #endif
 	{ "q",		"quiet",		"quiet output" },
 	{ "r",		"random N",		"start N random workers" },
+	{ NULL,		"results-db file",	"append the results of each run to a results store" },
+	{ NULL,		"results-baseline K",	"compare throughput with the stored runs of kernel K or last" },
+	{ NULL,		"results-threshold P",	"flag throughput changes of P% or more, default 3" },
+	{ NULL,		"results-key key",	"results store config key instead of the options hash" },
+	{ NULL,		"sample N",		"sample bogo-ops rates of each stressor instance every N seconds" },
+	{ NULL,		"sample-file file",	"output bogo-ops samples to file rather than stdout" },
+	{ NULL,		"sample-format fmt",	"output bogo-ops samples as json lines or yaml" },
 	{ NULL,		"sched type",		"set scheduler type" },
 	{ NULL,		"sched-prio N",		"set scheduler priority level N" },
 	{ NULL,		"sched-period N",	"set period for SCHED_DEADLINE to N nanosecs (Linux only)" },
@@ -1077,14 +1289,19 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"syslog",		"log messages to the syslog" },
 #endif
 	{ NULL,		"taskset",		"use specific CPUs (set CPU affinity)" },
+	{ NULL,		"taskset S",		"place instances by strategy S: spread, pack, numa or smt" },
 	{ NULL,		"temp-path path",	"specify path for temporary directories and files" },
 	{ NULL,		"thrash",		"force all pages in causing swap thrashing" },
+	{ NULL,		"threads",		"run instances of supported stressors as pthreads" },
 	{ "t N",	"timeout T",		"timeout after T seconds" },
 	{ NULL,		"timer-slack",		"enable timer slack mode" },
 	{ NULL,		"times",		"show run time summary at end of the run" },
 	{ NULL,		"timestamp",		"timestamp log output " },
 #if defined(STRESS_THERMAL_ZONES)
 	{ NULL,		"tz",			"collect temperatures from thermal zones (Linux only)" },
+	{ NULL,		"tz-power W",		"duty cycle the stressors to hold W Watts of package power" },
+	{ NULL,		"tz-target C",		"duty cycle the stressors to hold a C degrees thermal zone" },
+	{ NULL,		"tz-zone type",		"hold the named thermal zone type rather than the hottest" },
 #endif
 	{ "v",		"verbose",		"verbose output" },
 	{ NULL,		"verify",		"verify results (not available on all tests)" },
@@ -1154,6 +1371,39 @@ static void stress_remove_stressor(stress_stressor_t *ss)
 	free(ss);
 }
 
+/*
+ *  stress_sort_stressors_by_phase()
+ *	stable sort the stressor list by job phase start
+ *	time so that the stressors can be started in order
+ */
+static void stress_sort_stressors_by_phase(void)
+{
+	stress_stressor_t *ss = stressors_head, *head = NULL, *tail = NULL;
+
+	while (ss) {
+		stress_stressor_t *next = ss->next, *pos;
+
+		/* Find the last entry that starts no later than ss */
+		for (pos = tail; pos && (pos->phase_start > ss->phase_start); pos = pos->prev)
+			;
+		ss->prev = pos;
+		if (pos) {
+			ss->next = pos->next;
+			pos->next = ss;
+		} else {
+			ss->next = head;
+			head = ss;
+		}
+		if (ss->next)
+			ss->next->prev = ss;
+		else
+			tail = ss;
+		ss = next;
+	}
+	stressors_head = head;
+	stressors_tail = tail;
+}
+
 /*
  *  stress_get_class_id()
  *	find the class id of a given class name
@@ -1973,6 +2223,336 @@ void stress_misc_stats_set(
 	misc_stats[idx].value = value;
 }
 
+/*
+ *  stress_thread_times()
+ *	get the run time stats of the calling thread, falling
+ *	back to the whole process if per thread times are not
+ *	available
+ */
+static void stress_thread_times(struct tms *tms)
+{
+#if defined(RUSAGE_THREAD)
+	struct rusage usage;
+	const long int ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+	if ((ticks_per_sec > 0) && (getrusage(RUSAGE_THREAD, &usage) == 0)) {
+		(void)memset(tms, 0, sizeof(*tms));
+		tms->tms_utime = (clock_t)((usage.ru_utime.tv_sec * ticks_per_sec) +
+			((usage.ru_utime.tv_usec * ticks_per_sec) / 1000000));
+		tms->tms_stime = (clock_t)((usage.ru_stime.tv_sec * ticks_per_sec) +
+			((usage.ru_stime.tv_usec * ticks_per_sec) / 1000000));
+		return;
+	}
+#endif
+	if (times(tms) == (clock_t)-1) {
+		pr_dbg("times failed: errno=%d (%s)\n",
+			errno, strerror(errno));
+	}
+}
+
+/*
+ *  stress_run_instance()
+ *	run instance j of the current stressor and return its
+ *	exit status, the process or thread setup has already
+ *	been done by the caller
+ */
+static int MLOCKED_TEXT stress_run_instance(
+	const char *name,
+	const int32_t j,
+	const int32_t started_instances,
+	const int64_t backoff,
+	stress_checksum_t *checksum,
+	const bool threaded)
+{
+	int rc = EXIT_SUCCESS;
+	stress_stats_t *stats = g_stressor_current->stats[j];
+
+	pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
+		name, (int)getpid(), j);
+	stress_set_instance_affinity((uint32_t)j);
+
+	stats->pid = getpid();
+	stats->start = stats->finish = stress_time_now();
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+		(void)stress_perf_open(&stats->sp);
+		/* DRAM traffic is system wide, one instance counts it */
+		if (j == 0)
+			(void)stress_perf_imc_open(&stats->sp);
+	}
+#endif
+	(void)shim_usleep((useconds_t)(backoff * started_instances));
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)stress_perf_enable(&stats->sp);
+#endif
+	if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
+		const stress_args_t args = {
+			.counter = &stats->ci.counter,
+			.counter_ready = &stats->ci.counter_ready,
+			.name = name,
+			.max_ops = g_stressor_current->bogo_ops,
+			.instance = (uint32_t)j,
+			.num_instances = (uint32_t)g_stressor_current->num_instances,
+			.pid = getpid(),
+			.ppid = getppid(),
+			.page_size = stress_get_pagesize(),
+			.mapped = &g_shared->mapped,
+			.misc_stats = stats->misc_stats
+		};
+
+		(void)memset(checksum, 0, sizeof(*checksum));
+		rc = g_stressor_current->stressor->info->stressor(&args);
+		pr_fail_check(&rc);
+		if (rc == EXIT_SUCCESS) {
+			stats->run_ok = true;
+			checksum->data.run_ok = true;
+		}
+
+		/*
+		 *  We're done, cancel SIGALRM, threads leave
+		 *  this to the process once all have finished
+		 */
+		if (!threaded) {
+			(void)alarm(0);
+			stress_set_proc_state(name, STRESS_STATE_STOP);
+		}
+		/*
+		 *  Bogo ops counter should be OK for reading,
+		 *  if not then flag up that the counter may
+		 *  be untrustyworthy
+		 */
+		if (!stats->ci.counter_ready) {
+			pr_inf("%s: NOTE: bogo-ops counter in non-ready state, metrics are untrustworthy (process may have been terminated prematurely)\n",
+				name);
+			rc = EXIT_METRICS_UNTRUSTWORTHY;
+		}
+		checksum->data.counter = *args.counter;
+		stress_hash_checksum(checksum);
+	}
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+		(void)stress_perf_disable(&stats->sp);
+		(void)stress_perf_close(&stats->sp);
+	}
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
+		(void)stress_tz_get_temperatures(&g_shared->tz_info, &stats->tz);
+#endif
+	stats->finish = stress_time_now();
+	if (threaded) {
+		stress_thread_times(&stats->tms);
+	} else if (times(&stats->tms) == (clock_t)-1) {
+		pr_dbg("times failed: errno=%d (%s)\n",
+			errno, strerror(errno));
+	}
+	pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
+		name, (int)getpid(), j);
+
+	return rc;
+}
+
+/*
+ *  stress_start_gate_wait()
+ *	wait for the parent to finish forking all the stressor
+ *	instances so that the early ones don't compete with it
+ *	for CPU and delay the rest from starting
+ */
+static void stress_start_gate_wait(void)
+{
+	while (!g_shared->start_gate && keep_stressing_flag()) {
+		const struct timespec t = { 0, 100000000 };
+
+		if ((shim_futex_wait((const void *)&g_shared->start_gate, 0, &t) < 0) &&
+		    (errno == ENOSYS))
+			(void)shim_usleep(10000);
+	}
+}
+
+/*
+ *  stress_start_gate_open()
+ *	let all the forked stressor instances start
+ */
+static void stress_start_gate_open(void)
+{
+	g_shared->start_gate = 1;
+	(void)shim_futex_wake((const void *)&g_shared->start_gate, INT_MAX);
+}
+
+/*
+ *  stress_run_threaded()
+ *	return true if the instances of stressor ss should
+ *	be run as pthreads in one process
+ */
+static inline bool stress_run_threaded(const stress_stressor_t *ss)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	return (g_opt_flags & OPT_FLAGS_THREADS) &&
+	       ss->stressor->info->threaded &&
+	       (ss->num_instances > 1);
+#else
+	(void)ss;
+
+	return false;
+#endif
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/* A stressor instance run as a pthread with --threads */
+typedef struct {
+	pthread_t pthread;		/* instance thread */
+	const char *name;		/* stressor name */
+	int32_t instance;		/* instance number */
+	int32_t started_instances;	/* instances started before it */
+	int64_t backoff;		/* start up backoff delay */
+	stress_checksum_t *checksum;	/* instance checksum */
+	int rc;				/* instance exit status */
+	bool started;			/* pthread was created */
+} stress_instance_thread_t;
+
+/*
+ *  stress_instance_thread()
+ *	pthread that runs a single stressor instance
+ */
+static void *stress_instance_thread(void *arg)
+{
+	stress_instance_thread_t *it = (stress_instance_thread_t *)arg;
+
+	it->rc = stress_run_instance(it->name, it->instance,
+		it->started_instances, it->backoff, it->checksum, true);
+	return NULL;
+}
+
+/*
+ *  stress_run_instance_threads()
+ *	run all the instances of the current stressor as pthreads in
+ *	the calling process, returns the first failed exit status
+ */
+static int MLOCKED_TEXT stress_run_instance_threads(
+	const char *name,
+	const int32_t started_instances,
+	const int64_t backoff,
+	stress_checksum_t *checksum)
+{
+	const int32_t n = g_stressor_current->num_instances;
+	stress_instance_thread_t *its;
+	struct tms tms;
+	int32_t j;
+	int rc = EXIT_SUCCESS;
+
+	its = calloc((size_t)n, sizeof(*its));
+	if (!its) {
+		pr_inf("%s: cannot allocate %" PRId32 " instance threads, "
+			"skipping stressor\n", name, n);
+		return EXIT_NO_RESOURCE;
+	}
+
+	for (j = 0; j < n; j++) {
+		int ret;
+
+		its[j].name = name;
+		its[j].instance = j;
+		its[j].started_instances = started_instances + j;
+		its[j].backoff = backoff;
+		its[j].checksum = checksum + j;
+		its[j].rc = EXIT_SUCCESS;
+
+		if (!keep_stressing_flag())
+			break;
+		ret = pthread_create(&its[j].pthread, NULL,
+			stress_instance_thread, &its[j]);
+		if (ret) {
+			pr_inf("%s: cannot create instance %" PRId32 " thread, "
+				"errno=%d (%s)\n", name, j, ret, strerror(ret));
+			its[j].rc = EXIT_NO_RESOURCE;
+			continue;
+		}
+		its[j].started = true;
+	}
+
+	for (j = 0; j < n; j++) {
+		if (its[j].started)
+			(void)pthread_join(its[j].pthread, NULL);
+		if ((rc == EXIT_SUCCESS) && (its[j].rc != EXIT_SUCCESS))
+			rc = its[j].rc;
+	}
+	free(its);
+
+	/*
+	 *  Child processes can't be attributed to the thread
+	 *  that reaped them, so share their times out evenly
+	 */
+	if (times(&tms) != (clock_t)-1) {
+		for (j = 0; j < n; j++) {
+			stress_stats_t *stats = g_stressor_current->stats[j];
+
+			stats->tms.tms_cutime = tms.tms_cutime / n;
+			stats->tms.tms_cstime = tms.tms_cstime / n;
+		}
+	}
+
+	return rc;
+}
+#endif
+
+/*
+ *  stress_phase_phased()
+ *	true if a stressor belongs to a job file phase that is
+ *	delayed, ramped or has its own run time
+ */
+static inline bool stress_phase_phased(const stress_stressor_t *ss)
+{
+	return (ss->phase_start > 0.0) ||
+	       (ss->phase_ramp > 0.0) ||
+	       (ss->phase_timeout > 0.0);
+}
+
+/*
+ *  stress_phase_alarm()
+ *	the number of seconds a stressor instance started at time
+ *	now has left to run in its phase and within the timeout,
+ *	0 means run until told to stop
+ */
+static uint64_t stress_phase_alarm(
+	const stress_stressor_t *ss,
+	const double time_start)
+{
+	double left = (double)g_opt_timeout - (stress_time_now() - time_start);
+
+	if (!g_opt_timeout)
+		left = ss->phase_timeout;
+	else if ((ss->phase_timeout > 0.0) && (ss->phase_timeout < left))
+		left = ss->phase_timeout;
+	if (!g_opt_timeout && (left <= 0.0))
+		return 0;
+	return (left < 1.0) ? 1 : (uint64_t)(left + 0.5);
+}
+
+/*
+ *  stress_phase_wait()
+ *	wait until it is time to start the next instance of a
+ *	job file phase, the start gate is opened so that the
+ *	instances already started can get going
+ */
+static void stress_phase_wait(const double when)
+{
+	double now = stress_time_now();
+
+	if (now >= when)
+		return;
+	stress_start_gate_open();
+	while (keep_stressing_flag() && (now < when)) {
+		const double delay = STRESS_MINIMUM(when - now, 0.25);
+
+		(void)shim_usleep((uint64_t)(delay * 1000000.0));
+		now = stress_time_now();
+	}
+}
+
 /*
  *  stress_run ()
  *	kick off and run stressors
@@ -1987,8 +2567,10 @@ static void MLOCKED_TEXT stress_run(
 {
 	double time_start, time_finish;
 	int32_t started_instances = 0;
+	bool phased = false;
 
 	wait_flag = true;
+	g_shared->start_gate = 0;
 	time_start = stress_time_now();
 	pr_dbg("starting stressors\n");
 
@@ -1997,9 +2579,16 @@ static void MLOCKED_TEXT stress_run(
 	 */
 	for (g_stressor_current = stressors_list; g_stressor_current; g_stressor_current = g_stressor_current->next) {
 		int32_t j;
+		const bool threaded = stress_run_threaded(g_stressor_current);
+
+		if (threaded)
+			pr_dbg("%s: running %" PRId32 " instances as pthreads\n",
+				stress_munge_underscore(g_stressor_current->stressor->name),
+				g_stressor_current->num_instances);
 
 		/*
-		 *  Each stressor has 1 or more instances to run
+		 *  Each stressor has 1 or more instances to run, with
+		 *  --threads these are all run by the first process
 		 */
 		for (j = 0; j < g_stressor_current->num_instances; j++, (*checksum)++) {
 			int rc = EXIT_SUCCESS;
@@ -2009,8 +2598,20 @@ static void MLOCKED_TEXT stress_run(
 			int64_t backoff = DEFAULT_BACKOFF;
 			int32_t ionice_class = UNDEFINED;
 			int32_t ionice_level = UNDEFINED;
-			stress_stats_t *stats = g_stressor_current->stats[j];
+			const int32_t instances = threaded ?
+				g_stressor_current->num_instances : 1;
+			int32_t k;
 
+			/*
+			 *  Job file phases start at an offset from the start
+			 *  of the run and may spread the instance starts out
+			 */
+			if (stress_phase_phased(g_stressor_current)) {
+				phased = true;
+				stress_phase_wait(time_start + g_stressor_current->phase_start +
+					(g_stressor_current->phase_ramp * (double)j /
+					 (double)g_stressor_current->num_instances));
+			}
 			if (g_opt_timeout && (stress_time_now() - time_start > (double)g_opt_timeout))
 				goto abort;
 
@@ -2018,11 +2619,15 @@ static void MLOCKED_TEXT stress_run(
 			(void)stress_get_setting("ionice-class", &ionice_class);
 			(void)stress_get_setting("ionice-level", &ionice_level);
 
-			stats->counter_ready = true;
-			stats->counter = 0;
-			stats->checksum = *checksum;
-			for (i = 0; i < SIZEOF_ARRAY(stats->misc_stats); i++) {
-				stress_misc_stats_set(stats->misc_stats, i, "", -1);
+			for (k = j; k < j + instances; k++) {
+				stress_stats_t *stats = g_stressor_current->stats[k];
+
+				stats->ci.counter_ready = true;
+				stats->ci.counter = 0;
+				stats->checksum = *checksum + (k - j);
+				for (i = 0; i < SIZEOF_ARRAY(stats->misc_stats); i++) {
+					stress_misc_stats_set(stats->misc_stats, i, "", -1);
+				}
 			}
 again:
 			if (!keep_stressing_flag())
@@ -2047,6 +2652,7 @@ again:
 				(void)sched_settings_apply(true);
 				(void)atexit(stress_child_atexit);
 				(void)setpgid(0, g_pgrp);
+				stress_cgroup_join(g_stressor_current);
 				if (stress_set_handler(name, true) < 0) {
 					rc = EXIT_FAILURE;
 					goto child_exit;
@@ -2055,6 +2661,8 @@ again:
 				stress_process_dumpable(false);
 				stress_set_timer_slack();
 
+				if (stress_phase_phased(g_stressor_current))
+					g_opt_timeout = stress_phase_alarm(g_stressor_current, time_start);
 				if (g_opt_timeout)
 					(void)alarm((unsigned int)g_opt_timeout);
 
@@ -2065,81 +2673,19 @@ again:
 				stress_set_iopriority(ionice_class, ionice_level);
 				(void)umask(0077);
 
-				pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
-					name, (int)getpid(), j);
-
-				stats->start = stats->finish = stress_time_now();
-#if defined(STRESS_PERF_STATS) &&	\
-    defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_open(&stats->sp);
-#endif
-				(void)shim_usleep((useconds_t)(backoff * started_instances));
-#if defined(STRESS_PERF_STATS) &&	\
-    defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_enable(&stats->sp);
-#endif
-				if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
-					const stress_args_t args = {
-						.counter = &stats->counter,
-						.counter_ready = &stats->counter_ready,
-						.name = name,
-						.max_ops = g_stressor_current->bogo_ops,
-						.instance = (uint32_t)j,
-						.num_instances = (uint32_t)g_stressor_current->num_instances,
-						.pid = getpid(),
-						.ppid = getppid(),
-						.page_size = stress_get_pagesize(),
-						.mapped = &g_shared->mapped,
-						.misc_stats = stats->misc_stats
-					};
-
-					(void)memset(*checksum, 0, sizeof(**checksum));
-					rc = g_stressor_current->stressor->info->stressor(&args);
-					pr_fail_check(&rc);
-					if (rc == EXIT_SUCCESS) {
-						stats->run_ok = true;
-						(*checksum)->data.run_ok = true;
-					}
-
-					/*
-					 *  We're done, cancel SIGALRM
-					 */
+				stress_start_gate_wait();
+#if defined(HAVE_LIB_PTHREAD)
+				if (threaded) {
+					rc = stress_run_instance_threads(name,
+						started_instances, backoff, *checksum);
 					(void)alarm(0);
-
 					stress_set_proc_state(name, STRESS_STATE_STOP);
-					/*
-					 *  Bogo ops counter should be OK for reading,
-					 *  if not then flag up that the counter may
-					 *  be untrustyworthy
-					 */
-					if (!stats->counter_ready) {
-						pr_inf("%s: NOTE: bogo-ops counter in non-ready state, metrics are untrustworthy (process may have been terminated prematurely)\n",
-							name);
-						rc = EXIT_METRICS_UNTRUSTWORTHY;
-					}
-					(*checksum)->data.counter = *args.counter;
-					stress_hash_checksum(*checksum);
-				}
-#if defined(STRESS_PERF_STATS) &&	\
-    defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
-					(void)stress_perf_disable(&stats->sp);
-					(void)stress_perf_close(&stats->sp);
-				}
+				} else
 #endif
-#if defined(STRESS_THERMAL_ZONES)
-				if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
-					(void)stress_tz_get_temperatures(&g_shared->tz_info, &stats->tz);
-#endif
-				stats->finish = stress_time_now();
-				if (times(&stats->tms) == (clock_t)-1) {
-					pr_dbg("times failed: errno=%d (%s)\n",
-						errno, strerror(errno));
+				{
+					rc = stress_run_instance(name, j,
+						started_instances, backoff, *checksum, false);
 				}
-				pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
-					name, (int)getpid(), j);
 
 child_exit:
 				stress_stressors_free();
@@ -2160,11 +2706,21 @@ child_exit:
 			default:
 				if (pid > -1) {
 					(void)setpgid(pid, g_pgrp);
-					g_stressor_current->pids[j] = pid;
-					g_stressor_current->started_instances++;
-					started_instances++;
+					/*
+					 *  Only the first of a threaded stressor's
+					 *  instances has a process to wait for
+					 */
+					for (k = j; k < j + instances; k++) {
+						g_stressor_current->pids[k] = (k == j) ? pid : 0;
+						g_stressor_current->started_instances++;
+						started_instances++;
+					}
 					stress_ftrace_add_pid(pid);
+					stress_bpf_add_pid(pid);
 				}
+				/* All the threaded instances have been run */
+				j += instances - 1;
+				(*checksum) += instances - 1;
 
 				/* Forced early abort during startup? */
 				if (!keep_stressing_flag()) {
@@ -2177,14 +2733,25 @@ child_exit:
 		}
 	}
 	(void)stress_set_handler("stress-ng", false);
-	if (g_opt_timeout)
-		(void)alarm((unsigned int)g_opt_timeout);
+	if (g_opt_timeout) {
+		uint64_t timeout = g_opt_timeout;
+
+		/* Later phases have used up some of the run time */
+		if (phased) {
+			const double left = (double)g_opt_timeout -
+				(stress_time_now() - time_start);
+
+			timeout = (left < 1.0) ? 1 : (uint64_t)(left + 0.5);
+		}
+		(void)alarm((unsigned int)timeout);
+	}
 
 abort:
 	pr_dbg("%d stressor%s started\n", started_instances,
 		 started_instances == 1 ? "" : "s");
 
 wait_for_stressors:
+	stress_start_gate_open();
 	stress_wait_stressors(stressors_list, success, resource_success, metrics_success);
 	time_finish = stress_time_now();
 
@@ -2260,14 +2827,14 @@ static void stress_metrics_check(bool *success)
 			}
 
 			(void)memset(&stats_checksum, 0, sizeof(stats_checksum));
-			stats_checksum.data.counter = stats->counter;
+			stats_checksum.data.counter = stats->ci.counter;
 			stats_checksum.data.run_ok = stats->run_ok;
 			stress_hash_checksum(&stats_checksum);
 
-			if (stats->counter != checksum->data.counter) {
+			if (stats->ci.counter != checksum->data.counter) {
 				pr_fail("%s instance %d corrupted bogo-ops counter, %" PRIu64 " vs %" PRIu64 "\n",
 					ss->stressor->name, j,
-					stats->counter, checksum->data.counter);
+					stats->ci.counter, checksum->data.counter);
 				ok = false;
 			}
 			if (stats->run_ok != checksum->data.run_ok) {
@@ -2357,7 +2924,7 @@ static void stress_metrics_dump(
 			const stress_stats_t *const stats = ss->stats[j];
 
 			run_ok  |= stats->run_ok;
-			c_total += stats->counter;
+			c_total += stats->ci.counter;
 			u_total += (uint64_t)(stats->tms.tms_utime +
 					      stats->tms.tms_cutime);
 			s_total += (uint64_t)(stats->tms.tms_stime +
@@ -2450,6 +3017,10 @@ static void stress_metrics_dump(
 				pr_yaml(yaml, "      %s: %f\n", stess_description_yamlify(description), metric);
 			};
 		}
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+		stress_perf_derived_yaml(yaml, ss, r_total);
+#endif
 
 		pr_yaml(yaml, "\n");
 	}
@@ -2638,8 +3209,12 @@ static inline void stress_shared_map(const int32_t num_procs)
 		exit(EXIT_FAILURE);
 	}
 
-	/* Paraniod */
-	(void)memset(g_shared, 0, sz);
+	/*
+	 *  Anonymous mappings are zero filled, so leave the
+	 *  per instance stats pages to be faulted in by the
+	 *  instances that use them rather than touching them
+	 *  all before the first fork
+	 */
 	g_shared->length = sz;
 	g_shared->vfork = vfork;
 
@@ -2682,7 +3257,6 @@ static inline void stress_shared_map(const int32_t num_procs)
 			errno, strerror(errno));
 		goto err_unmap_shared;
 	}
-	(void)memset(g_shared->checksums, 0, sz);
 	g_shared->checksums_length = sz;
 
 	/*
@@ -2813,6 +3387,7 @@ static stress_stressor_t *stress_find_proc_info(const stress_t *stressor)
 	}
 
 	ss->stressor = stressor;
+	stress_job_phase(&ss->phase_start, &ss->phase_timeout, &ss->phase_ramp);
 
 	/* Add to end of procs list */
 	if (stressors_tail)
@@ -3171,6 +3746,78 @@ next_opt:
 			stress_check_max_stressors("random", i32);
 			stress_set_setting("random", TYPE_ID_INT32, &i32);
 			break;
+		case OPT_numa_policy:
+			if (stress_set_numa_policy(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_bpf:
+			if (stress_set_bpf(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_bpf_period:
+			if (stress_set_bpf_period(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_cgroup:
+			if (stress_set_cgroup(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_cgroup_cpu_max:
+			if (stress_set_cgroup_cpu_max(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_cgroup_io_max:
+			if (stress_set_cgroup_io_max(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_cgroup_memory_high:
+			if (stress_set_cgroup_memory_high(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_tz_power:
+			if (stress_set_tz_power(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_tz_target:
+			if (stress_set_tz_target(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_tz_zone:
+			if (stress_set_tz_zone(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_pressure:
+			if (stress_set_pressure(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_pressure_full:
+			if (stress_set_pressure_full(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_results_db:
+			stress_set_setting_global("results-db", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_results_baseline:
+			stress_set_setting_global("results-baseline", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_results_threshold:
+			if (stress_set_results_threshold(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_results_key:
+			stress_set_setting_global("results-key", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_sample:
+			if (stress_set_sample(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_sample_file:
+			stress_set_setting_global("sample-file", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_sample_format:
+			if (stress_set_sample_format(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_sched:
 			i32 = stress_get_opt_sched(optarg);
 			stress_set_setting_global("sched", TYPE_ID_INT32, &i32);
@@ -3238,6 +3885,10 @@ next_opt:
 			if (stress_set_iostat(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_iostat_format:
+			if (stress_set_iostat_format(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_yaml:
 			stress_set_setting_global("yaml", TYPE_ID_STR, (void *)optarg);
 			break;
@@ -3422,6 +4073,7 @@ int main(int argc, char **argv, char **envp)
 	bool success = true;
 	bool resource_success = true;
 	bool metrics_success = true;
+	bool regressed;				/* results store regression */
 	FILE *yaml;				/* YAML output file */
 	char *yaml_filename = NULL;		/* YAML file name */
 	char *log_filename;			/* log filename */
@@ -3486,6 +4138,7 @@ int main(int argc, char **argv, char **envp)
 	(void)stress_get_setting("job", &job_filename);
 	if (stress_parse_jobfile(argc, argv, job_filename) < 0)
 		exit(EXIT_FAILURE);
+	stress_sort_stressors_by_phase();
 
 	/*
 	 *  Sanity check minimize/maximize options
@@ -3505,6 +4158,11 @@ int main(int argc, char **argv, char **envp)
 			"options together\n");
 		exit(EXIT_FAILURE);
 	}
+#if !defined(HAVE_LIB_PTHREAD)
+	if (g_opt_flags & OPT_FLAGS_THREADS)
+		(void)fprintf(stderr, "threads option is not supported, "
+			"stressor instances will be run as processes\n");
+#endif
 	(void)stress_get_setting("class", &class);
 
 	if (class &&
@@ -3592,6 +4250,7 @@ int main(int argc, char **argv, char **envp)
 	(void)stress_get_setting("ionice-level", &ionice_level);
 	stress_set_iopriority(ionice_class, ionice_level);
 	(void)stress_get_setting("yaml", &yaml_filename);
+	stress_results_init();
 
 	stress_mlock_executable();
 
@@ -3697,7 +4356,12 @@ int main(int argc, char **argv, char **envp)
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_start();
 
-	stress_vmstat_start();
+	stress_vmstat_start(stressors_head);
+	stress_bpf_start();
+	stress_sample_start(stressors_head);
+	stress_pressure_start();
+	stress_cgroup_start(stressors_head);
+	stress_tz_control_start(stressors_head);
 	stress_smart_start();
 
 	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
@@ -3736,6 +4400,11 @@ int main(int argc, char **argv, char **envp)
 
 	stress_metrics_check(&success);
 
+	/*
+	 *  Append to the results store, compare with the baseline
+	 */
+	regressed = stress_results_store(stressors_head, ticks_per_sec, argc, argv);
+
 #if defined(STRESS_PERF_STATS) &&	\
     defined(HAVE_LINUX_PERF_EVENT_H)
 	/*
@@ -3759,8 +4428,18 @@ int main(int argc, char **argv, char **envp)
 	 */
 	stress_times_dump(yaml, ticks_per_sec, duration);
 
+	/*
+	 *  Dump per stressor cgroup accounting
+	 */
+	stress_cgroup_dump(yaml, duration);
+
 	stress_smart_stop();
+	stress_sample_stop();
+	stress_pressure_stop();
+	stress_cgroup_stop();
+	stress_tz_control_stop();
 	stress_vmstat_stop();
+	stress_bpf_stop();
 	stress_ftrace_stop();
 	stress_ftrace_free();
 
@@ -3793,5 +4472,7 @@ int main(int argc, char **argv, char **envp)
 		exit(EXIT_NO_RESOURCE);
 	if (!metrics_success)
 		exit(EXIT_METRICS_UNTRUSTWORTHY);
+	if (regressed)
+		exit(EXIT_REGRESSION);
 	exit(EXIT_SUCCESS);
 }
@@ -148,6 +148,10 @@
 #include <libaio.h>
 #endif
 
+#if defined(HAVE_OPENSSL_EVP_H)
+#include <openssl/evp.h>
+#endif
+
 #if defined(HAVE_LIBGEN_H)
 #include <libgen.h>
 #endif
@@ -371,6 +375,10 @@
 #include <sys/random.h>
 #endif
 
+#if defined(HAVE_SYS_RSEQ_H)
+#include <sys/rseq.h>
+#endif
+
 #if defined(HAVE_SYS_SELECT_H)
 #include <sys/select.h>
 #endif
@@ -491,6 +499,10 @@
 #include <linux/audit.h>
 #endif
 
+#if defined(HAVE_LINUX_BPF_H)
+#include <linux/bpf.h>
+#endif
+
 #if defined(HAVE_LINUX_CDROM_H)
 #include <linux/cdrom.h>
 #endif
@@ -507,6 +519,10 @@
 #include <linux/dm-ioctl.h>
 #endif
 
+#if defined(HAVE_LINUX_ETHTOOL_H)
+#include <linux/ethtool.h>
+#endif
+
 #if defined(HAVE_LINUX_FD_H)
 #include <linux/fd.h>
 #endif
@@ -531,6 +547,10 @@
 #include <linux/if_tun.h>
 #endif
 
+#if defined(HAVE_LINUX_IF_XDP_H)
+#include <linux/if_xdp.h>
+#endif
+
 #if defined(HAVE_LINUX_IO_URING_H)
 #include <linux/io_uring.h>
 #endif
@@ -646,7 +666,6 @@
 #if defined(HAVE_LINUX_SOCKIOS_H)
 #include <linux/sockios.h>
 #endif
-
 #if defined(HAVE_LINUX_SYSCTL_H)
 #include <linux/sysctl.h>
 #endif
@@ -846,6 +865,7 @@ typedef unsigned long int __kernel_ulong_t;
 #define EXIT_SIGNALED			(5)
 #define EXIT_BY_SYS_EXIT		(6)
 #define EXIT_METRICS_UNTRUSTWORTHY	(7)
+#define EXIT_REGRESSION			(8)
 
 /*
  *  Stressor run states
@@ -961,6 +981,8 @@ typedef unsigned long int __kernel_ulong_t;
 #define OPT_FLAGS_SKIP_SILENT	 STRESS_BIT_ULL(39)	/* --skip-silent */
 #define OPT_FLAGS_SMART		 STRESS_BIT_ULL(40)	/* --smart */
 #define OPT_FLAGS_NO_OOM_ADJUST	 STRESS_BIT_ULL(41)	/* --no-oom-adjust */
+#define OPT_FLAGS_THREADS	 STRESS_BIT_ULL(42)	/* --threads */
+#define OPT_FLAGS_FTRACE_LATENCY STRESS_BIT_ULL(43)	/* --ftrace-latency */
 
 #define OPT_FLAGS_MINMAX_MASK		\
 	(OPT_FLAGS_MINIMIZE | OPT_FLAGS_MAXIMIZE)
@@ -1101,6 +1123,7 @@ typedef struct {
 } stress_mapped_t;
 
 #define STRESS_MISC_STATS_MAX	(10)
+#define STRESS_NUMA_MAX_NODES	(64)
 
 typedef struct {
 	char description[32];
@@ -1138,6 +1161,7 @@ typedef struct {
 	const stress_class_t class;	/* stressor class */
 	const stress_opt_set_func_t *opt_set_funcs;	/* option functions */
 	const stress_help_t *help;	/* stressor help options */
+	const bool threaded;		/* instances can run as pthreads */
 } stressor_info_t;
 
 /* pthread wrapped stress_args_t */
@@ -1158,6 +1182,21 @@ typedef struct {
 	size_t		n;		/* number of hash items in table */
 } stress_hash_table_t;
 
+/* open addressing hash table slot */
+typedef struct {
+	uint64_t	key;		/* hash key */
+	uint64_t	value;		/* value for key */
+} stress_hash_slot_t;
+
+/* open addressing hash table, 8 slots per group */
+typedef struct {
+	uint8_t		*ctrl;		/* per slot 7 bit hash tag or empty */
+	stress_hash_slot_t *slots;	/* key and value slots */
+	size_t		groups;		/* number of groups, power of 2 */
+	size_t		used;		/* slots in use */
+	size_t		max;		/* maximum slots in use */
+} stress_hash_oatable_t;
+
 /* vmstat information */
 typedef struct {			/* vmstat column */
 	uint64_t	procs_running;	/* r */
@@ -1179,6 +1218,12 @@ typedef struct {			/* vmstat column */
 	uint64_t	idle_time;	/* id */
 	uint64_t	wait_time;	/* wa */
 	uint64_t	stolen_time;	/* st */
+	uint64_t	workingset_refault;	/* file pages refaulted after eviction */
+	uint64_t	workingset_activate;	/* refaults activated straight away */
+	uint64_t	workingset_restore;	/* refaults that were part of the workingset */
+	uint64_t	pgpromote;	/* pages promoted to a faster memory tier */
+	uint64_t	pgdemote;	/* pages demoted to a slower memory tier */
+	uint64_t	numa_hint_faults;	/* NUMA balancing hinting faults */
 } stress_vmstat_t;
 
 /* iostat information, from /sys/block/$dev/stat */
@@ -1542,6 +1587,7 @@ extern void pr_dbg_lock(bool *locked, const char *fmt, ...)  FORMAT(printf, 2, 3
 #define MIN_DIR_DIRS		(64)
 #define MAX_DIR_DIRS		(65536)
 #define DEFAULT_DIR_DIRS	(8192)
+#define DIR_SCALE_WORKERS_MAX	(64)
 
 #define MIN_EPOLL_PORT		(1024)
 #define MAX_EPOLL_PORT		(65535)
@@ -1555,6 +1601,10 @@ extern void pr_dbg_lock(bool *locked, const char *fmt, ...)  FORMAT(printf, 2, 3
 #define MAX_HDD_WRITE_SIZE	(4 * MB)
 #define DEFAULT_HDD_WRITE_SIZE	(64 * 1024)
 
+#define MIN_HDD_QDEPTH		(1)
+#define MAX_HDD_QDEPTH		(1024)
+#define DEFAULT_HDD_QDEPTH	(32)
+
 #define MIN_FALLOCATE_BYTES	(1 * MB)
 #define MAX_FALLOCATE_BYTES	(MAX_FILE_LIMIT)
 #define DEFAULT_FALLOCATE_BYTES	(1 * GB)
@@ -1766,6 +1816,8 @@ extern void pr_dbg_lock(bool *locked, const char *fmt, ...)  FORMAT(printf, 2, 3
 #define MAX_STREAM_L3_SIZE	(MAX_MEM_LIMIT)
 #define DEFAULT_STREAM_L3_SIZE	(4 * MB)
 
+#define MIN_SWAPRATE_BYTES	(1 * MB)
+
 #define MIN_SYNC_FILE_BYTES	(1 * MB)
 #define MAX_SYNC_FILE_BYTES	(MAX_FILE_LIMIT)
 #define DEFAULT_SYNC_FILE_BYTES	(1 * GB)
@@ -1805,11 +1857,18 @@ extern void pr_dbg_lock(bool *locked, const char *fmt, ...)  FORMAT(printf, 2, 3
 #define MIN_VM_RW_BYTES		(4 * KB)
 #define MAX_VM_RW_BYTES		(MAX_MEM_LIMIT)
 #define DEFAULT_VM_RW_BYTES	(16 * MB)
+#define VM_RW_MAX_IOV		(1024)
+#define VM_RW_DEFAULT_IOV	(16)
+#define VM_RW_DEFAULT_SEG	(64 * KB)
+#define VM_RW_MAX_PEERS		(64)
+#define VM_RW_DEFAULT_PEERS	(4)
 
 #define MIN_VM_SPLICE_BYTES	(4 * KB)
 #define MAX_VM_SPLICE_BYTES	(64 * MB)
 #define DEFAULT_VM_SPLICE_BYTES	(64 * KB)
 
+#define MAX_ZLIB_THREADS	(64)
+
 #define MIN_ZOMBIES		(1)
 #define MAX_ZOMBIES		(1000000)
 #define DEFAULT_ZOMBIES		(8192)
@@ -2398,6 +2457,7 @@ typedef struct {
 #define STRESS_PERF_STATS	(1)
 #define STRESS_PERF_INVALID	(~0ULL)
 #define STRESS_PERF_MAX		(128)
+#define STRESS_PERF_IMC_MAX	(64)	/* memory controller read + write events */
 
 /* per perf counter info */
 typedef struct {
@@ -2409,6 +2469,8 @@ typedef struct {
 typedef struct {
 	stress_perf_stat_t	perf_stat[STRESS_PERF_MAX]; /* perf counters */
 	int			perf_opened;	/* count of opened counters */
+	stress_perf_stat_t	imc_stat[STRESS_PERF_IMC_MAX]; /* memory controller bytes */
+	int			imc_opened;	/* count of opened imc counters */
 } stress_perf_t;
 #endif
 
@@ -2435,10 +2497,19 @@ typedef struct {
 } stress_tz_t;
 #endif
 
-/* Per stressor statistics and accounting info */
+/*
+ *  Per instance bogo ops counter, it is bumped on every bogo op so it
+ *  has a cache line to itself to stop instances false sharing with
+ *  each other or with the cold stats that follow it
+ */
 typedef struct {
 	uint64_t counter;		/* number of bogo ops */
 	bool counter_ready;		/* counter can be read */
+} ALIGN_CACHELINE stress_counter_info_t;
+
+/* Per stressor statistics and accounting info */
+typedef struct {
+	stress_counter_info_t ci;	/* hot bogo ops counter */
 	struct tms tms;			/* run time stats of process */
 	double start;			/* wall clock start time */
 	double finish;			/* wall clock stop time */
@@ -2449,10 +2520,35 @@ typedef struct {
 	stress_tz_t tz;			/* thermal zones */
 #endif
 	bool run_ok;			/* true if stressor exited OK */
+	pid_t pid;			/* process running the instance */
 	stress_checksum_t *checksum;	/* pointer to checksum data */
 	stress_misc_stats_t misc_stats[STRESS_MISC_STATS_MAX];
 } stress_stats_t;
 
+/*
+ *  stress_stats_counter()
+ *	lock free read of an instance bogo ops counter while it is
+ *	running; the writer clears counter_ready around each update, so
+ *	retry until the counter is the same either side of a ready flag
+ */
+static inline uint64_t stress_stats_counter(const stress_stats_t *stats)
+{
+	const volatile stress_counter_info_t *ci = &stats->ci;
+	uint64_t counter;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		counter = ci->counter;
+		shim_mb();
+		if (ci->counter_ready) {
+			shim_mb();
+			if (ci->counter == counter)
+				return counter;
+		}
+	}
+	return ci->counter;
+}
+
 #define	STRESS_WARN_HASH_MAX		(128)
 
 /* The stress-ng global shared memory segment */
@@ -2510,6 +2606,7 @@ typedef struct {
 #endif
 		volatile double start_time;		/* Time to complete operation */
 	} syncload;
+	volatile uint32_t start_gate;			/* non-zero once all instances are forked */
 	uint8_t  str_shared[STR_SHARED_SIZE];		/* str copying buffer */
 	stress_checksum_t *checksums;			/* per stressor counter checksum */
 	size_t	checksums_length;			/* size of checksums mapping */
@@ -2529,6 +2626,7 @@ typedef struct {
 	MACRO(aio) 		\
 	MACRO(aiol) 		\
 	MACRO(apparmor) 	\
+	MACRO(applaunch)	\
 	MACRO(alarm)		\
 	MACRO(atomic)		\
 	MACRO(bad_altstack) 	\
@@ -2554,6 +2652,7 @@ typedef struct {
 	MACRO(cpu)		\
 	MACRO(cpu_online)	\
 	MACRO(crypt)		\
+	MACRO(cryptospeed)	\
 	MACRO(cyclic)		\
 	MACRO(daemon)		\
 	MACRO(dccp)		\
@@ -2585,6 +2684,7 @@ typedef struct {
 	MACRO(fork)		\
 	MACRO(fp_error)		\
 	MACRO(fpunch)		\
+	MACRO(frontend)		\
 	MACRO(fstat)		\
 	MACRO(full)		\
 	MACRO(funccall)		\
@@ -2595,6 +2695,7 @@ typedef struct {
 	MACRO(getrandom)	\
 	MACRO(goto)		\
 	MACRO(handle)		\
+	MACRO(hash)		\
 	MACRO(hdd)		\
 	MACRO(heapsort)		\
 	MACRO(hrtimers)		\
@@ -2604,11 +2705,13 @@ typedef struct {
 	MACRO(idle_page)	\
 	MACRO(inode_flags)	\
 	MACRO(inotify)		\
+	MACRO(interfere)	\
 	MACRO(io)		\
 	MACRO(iomix)		\
 	MACRO(ioport)		\
 	MACRO(ioprio)		\
 	MACRO(io_uring)		\
+	MACRO(ipcspeed)		\
 	MACRO(ipsec_mb)		\
 	MACRO(itimer)		\
 	MACRO(judy)		\
@@ -2622,6 +2725,7 @@ typedef struct {
 	MACRO(link)		\
 	MACRO(list)		\
 	MACRO(loadavg)		\
+	MACRO(lock)		\
 	MACRO(locka)		\
 	MACRO(lockbus)		\
 	MACRO(lockf)		\
@@ -2668,6 +2772,7 @@ typedef struct {
 	MACRO(oom_pipe)		\
 	MACRO(opcode)		\
 	MACRO(open)		\
+	MACRO(pagecache)	\
 	MACRO(pci)		\
 	MACRO(personality)	\
 	MACRO(physpage)		\
@@ -2680,6 +2785,7 @@ typedef struct {
 	MACRO(prctl)		\
 	MACRO(prefetch)		\
 	MACRO(procfs)		\
+	MACRO(procread)		\
 	MACRO(pthread)		\
 	MACRO(ptrace)		\
 	MACRO(pty)		\
@@ -2743,12 +2849,14 @@ typedef struct {
 	MACRO(sockmany)		\
 	MACRO(softlockup)	\
 	MACRO(spawn)		\
+	MACRO(spawnscale)	\
 	MACRO(splice)		\
 	MACRO(stack)		\
 	MACRO(stackmmap)	\
 	MACRO(str)		\
 	MACRO(stream)		\
 	MACRO(swap)		\
+	MACRO(swaprate)		\
 	MACRO(switch)		\
 	MACRO(symlink)		\
 	MACRO(sync_file)	\
@@ -2758,6 +2866,7 @@ typedef struct {
 	MACRO(sysinval)		\
 	MACRO(sysfs)		\
 	MACRO(tee)		\
+	MACRO(tiering)		\
 	MACRO(timer)		\
 	MACRO(timerfd)		\
 	MACRO(tlb_shootdown)	\
@@ -2791,8 +2900,10 @@ typedef struct {
 	MACRO(xattr)		\
 	MACRO(yield)		\
 	MACRO(zero)		\
+	MACRO(zerocopy)		\
 	MACRO(zlib)		\
-	MACRO(zombie)
+	MACRO(zombie)		\
+	MACRO(zram)
 
 /*
  *  Declaration of stress_*_info object
@@ -2884,6 +2995,9 @@ typedef enum {
 	OPT_aiol,
 	OPT_aiol_ops,
 	OPT_aiol_requests,
+	OPT_aiol_reap,
+	OPT_aiol_nr_events,
+	OPT_aiol_batch,
 
 	OPT_alarm,
 	OPT_alarm_ops,
@@ -2891,8 +3005,19 @@ typedef enum {
 	OPT_apparmor,
 	OPT_apparmor_ops,
 
+	OPT_applaunch,
+	OPT_applaunch_ops,
+	OPT_applaunch_trace,
+	OPT_applaunch_bg,
+	OPT_applaunch_bg_bytes,
+	OPT_applaunch_cold,
+
 	OPT_atomic,
 	OPT_atomic_ops,
+	OPT_atomic_bench,
+	OPT_atomic_layout,
+	OPT_atomic_placement,
+	OPT_atomic_threads,
 
 	OPT_bad_altstack,
 	OPT_bad_altstack_ops,
@@ -2914,6 +3039,7 @@ typedef enum {
 
 	OPT_bigheap_ops,
 	OPT_bigheap_growth,
+	OPT_bigheap_method,
 
 	OPT_bind_mount,
 	OPT_bind_mount_ops,
@@ -2921,6 +3047,9 @@ typedef enum {
 	OPT_binderfs,
 	OPT_binderfs_ops,
 
+	OPT_bpf,
+	OPT_bpf_period,
+
 	OPT_class,
 	OPT_cache_ops,
 	OPT_cache_clflushopt,
@@ -2932,6 +3061,7 @@ typedef enum {
 	OPT_cache_level,
 	OPT_cache_ways,
 	OPT_cache_no_affinity,
+	OPT_cache_sweep,
 
 	OPT_cap,
 	OPT_cap_ops,
@@ -2972,6 +3102,8 @@ typedef enum {
 	OPT_cpu_ops,
 	OPT_cpu_method,
 	OPT_cpu_load_slice,
+	OPT_cpu_calibrate,
+	OPT_cpu_calibrate_tolerance,
 
 	OPT_cpu_online,
 	OPT_cpu_online_ops,
@@ -2980,6 +3112,14 @@ typedef enum {
 	OPT_crypt,
 	OPT_crypt_ops,
 
+	OPT_cryptospeed,
+	OPT_cryptospeed_ops,
+	OPT_cryptospeed_backend,
+	OPT_cryptospeed_alg,
+	OPT_cryptospeed_sizes,
+	OPT_cryptospeed_batch,
+	OPT_cryptospeed_splice,
+
 	OPT_cyclic,
 	OPT_cyclic_ops,
 	OPT_cyclic_method,
@@ -2987,6 +3127,7 @@ typedef enum {
 	OPT_cyclic_prio,
 	OPT_cyclic_sleep,
 	OPT_cyclic_dist,
+	OPT_cyclic_load,
 
 	OPT_daemon,
 	OPT_daemon_ops,
@@ -3011,6 +3152,9 @@ typedef enum {
 	OPT_dir,
 	OPT_dir_ops,
 	OPT_dir_dirs,
+	OPT_dir_scale,
+	OPT_dir_scale_mode,
+	OPT_dir_scale_workers,
 
 	OPT_dirdeep,
 	OPT_dirdeep_ops,
@@ -3042,6 +3186,10 @@ typedef enum {
 	OPT_epoll_ops,
 	OPT_epoll_port,
 	OPT_epoll_domain,
+	OPT_epoll_conns,
+	OPT_epoll_method,
+	OPT_epoll_scale,
+	OPT_epoll_threads,
 
 	OPT_eventfd,
 	OPT_eventfd_ops,
@@ -3094,11 +3242,18 @@ typedef enum {
 	OPT_fpunch,
 	OPT_fpunch_ops,
 
+	OPT_frontend,
+	OPT_frontend_ops,
+	OPT_frontend_size,
+	OPT_frontend_branch,
+	OPT_frontend_targets,
+
 	OPT_fstat,
 	OPT_fstat_ops,
 	OPT_fstat_dir,
 
 	OPT_ftrace,
+	OPT_ftrace_latency,
 
 	OPT_full,
 	OPT_full_ops,
@@ -3130,10 +3285,17 @@ typedef enum {
 	OPT_handle,
 	OPT_handle_ops,
 
+	OPT_hash,
+	OPT_hash_ops,
+	OPT_hash_method,
+
 	OPT_hdd_bytes,
 	OPT_hdd_write_size,
 	OPT_hdd_ops,
 	OPT_hdd_opts,
+	OPT_hdd_engine,
+	OPT_hdd_qdepth,
+	OPT_hdd_bs_mix,
 
 	OPT_heapsort,
 	OPT_heapsort_ops,
@@ -3155,6 +3317,8 @@ typedef enum {
 
 	OPT_idle_page,
 	OPT_idle_page_ops,
+	OPT_idle_page_bench,
+	OPT_idle_page_bytes,
 
 	OPT_ignite_cpu,
 
@@ -3164,9 +3328,17 @@ typedef enum {
 	OPT_inotify,
 	OPT_inotify_ops,
 
+	OPT_interfere,
+	OPT_interfere_ops,
+	OPT_interfere_hogs,
+	OPT_interfere_mba,
+	OPT_interfere_l3,
+	OPT_interfere_probe_size,
+
 	OPT_iomix,
 	OPT_iomix_bytes,
 	OPT_iomix_ops,
+	OPT_iomix_profile,
 
 	OPT_ioport,
 	OPT_ioport_ops,
@@ -3179,11 +3351,21 @@ typedef enum {
 	OPT_ioprio_ops,
 
 	OPT_iostat,
+	OPT_iostat_format,
 
 	OPT_io_ops,
 
 	OPT_io_uring,
 	OPT_io_uring_ops,
+	OPT_io_uring_depth,
+	OPT_io_uring_fixed,
+	OPT_io_uring_sqpoll,
+	OPT_io_uring_throughput,
+
+	OPT_ipcspeed,
+	OPT_ipcspeed_ops,
+	OPT_ipcspeed_mech,
+	OPT_ipcspeed_sizes,
 
 	OPT_ipsec_mb,
 	OPT_ipsec_mb_ops,
@@ -3216,6 +3398,7 @@ typedef enum {
 	OPT_l1cache_size,
 	OPT_l1cache_sets,
 	OPT_l1cache_ways,
+	OPT_l1cache_sweep,
 
 	OPT_landlock,
 	OPT_landlock_ops,
@@ -3235,6 +3418,14 @@ typedef enum {
 	OPT_loadavg,
 	OPT_loadavg_ops,
 
+	OPT_lock,
+	OPT_lock_ops,
+	OPT_lock_method,
+	OPT_lock_threads,
+	OPT_lock_cs,
+	OPT_lock_readers,
+	OPT_lock_placement,
+
 	OPT_lockbus,
 	OPT_lockbus_ops,
 
@@ -3271,11 +3462,14 @@ typedef enum {
 	OPT_malloc_pthreads,
 	OPT_malloc_threshold,
 	OPT_malloc_touch,
+	OPT_malloc_trace,
+	OPT_malloc_allocator,
 
 	OPT_matrix,
 	OPT_matrix_ops,
 	OPT_matrix_size,
 	OPT_matrix_method,
+	OPT_matrix_threads,
 	OPT_matrix_yx,
 
 	OPT_matrix_3d,
@@ -3292,10 +3486,13 @@ typedef enum {
 
 	OPT_membarrier,
 	OPT_membarrier_ops,
+	OPT_membarrier_bench,
+	OPT_membarrier_threads,
 
 	OPT_memcpy,
 	OPT_memcpy_ops,
 	OPT_memcpy_method,
+	OPT_memcpy_compare,
 
 	OPT_memfd,
 	OPT_memfd_ops,
@@ -3310,6 +3507,7 @@ typedef enum {
 	OPT_memrate_rd_mbs,
 	OPT_memrate_wr_mbs,
 	OPT_memrate_bytes,
+	OPT_memrate_latency,
 
 	OPT_memthrash,
 	OPT_memthrash_ops,
@@ -3318,6 +3516,8 @@ typedef enum {
 	OPT_mergesort,
 	OPT_mergesort_ops,
 	OPT_mergesort_integers,
+	OPT_mergesort_threads,
+	OPT_mergesort_elem_size,
 
 	OPT_metrics_brief,
 
@@ -3350,6 +3550,7 @@ typedef enum {
 	OPT_mmap_osync,
 	OPT_mmap_odirect,
 	OPT_mmap_mmap2,
+	OPT_mmap_threads,
 
 	OPT_mmapaddr,
 	OPT_mmapaddr_ops,
@@ -3363,6 +3564,7 @@ typedef enum {
 	OPT_mmaphuge,
 	OPT_mmaphuge_ops,
 	OPT_mmaphuge_mmaps,
+	OPT_mmaphuge_measure,
 
 	OPT_mmapmany,
 	OPT_mmapmany_ops,
@@ -3392,6 +3594,9 @@ typedef enum {
 
 	OPT_netdev,
 	OPT_netdev_ops,
+	OPT_netdev_if,
+	OPT_netdev_interval,
+	OPT_netdev_stats,
 
 	OPT_netlink_proc,
 	OPT_netlink_proc_ops,
@@ -3415,6 +3620,7 @@ typedef enum {
 
 	OPT_numa,
 	OPT_numa_ops,
+	OPT_numa_policy,
 
 	OPT_oomable,
 
@@ -3429,6 +3635,15 @@ typedef enum {
 	OPT_open_fd,
 
 	OPT_page_in,
+
+	OPT_pagecache,
+	OPT_pagecache_ops,
+	OPT_pagecache_bytes,
+	OPT_pagecache_skew,
+	OPT_pagecache_run,
+	OPT_pagecache_read_size,
+	OPT_pagecache_advice,
+
 	OPT_pathological,
 
 	OPT_pci,
@@ -3436,6 +3651,16 @@ typedef enum {
 
 	OPT_perf_stats,
 
+	OPT_pressure,
+	OPT_pressure_full,
+	OPT_cgroup,
+	OPT_cgroup_cpu_max,
+	OPT_cgroup_memory_high,
+	OPT_cgroup_io_max,
+	OPT_tz_target,
+	OPT_tz_power,
+	OPT_tz_zone,
+
 	OPT_personality,
 	OPT_personality_ops,
 
@@ -3465,6 +3690,8 @@ typedef enum {
 	OPT_prefetch,
 	OPT_prefetch_ops,
 	OPT_prefetch_l3_size,
+	OPT_prefetch_sweep,
+	OPT_prefetch_hwpf,
 
 	OPT_prctl,
 	OPT_prctl_ops,
@@ -3472,9 +3699,18 @@ typedef enum {
 	OPT_procfs,
 	OPT_procfs_ops,
 
+	OPT_procread,
+	OPT_procread_ops,
+	OPT_procread_paths,
+	OPT_procread_hot,
+	OPT_procread_threads,
+	OPT_procread_top,
+
 	OPT_pthread,
 	OPT_pthread_ops,
 	OPT_pthread_max,
+	OPT_pthread_method,
+	OPT_pthread_pool,
 
 	OPT_ptrace,
 	OPT_ptrace_ops,
@@ -3486,6 +3722,8 @@ typedef enum {
 	OPT_qsort,
 	OPT_qsort_ops,
 	OPT_qsort_integers,
+	OPT_qsort_threads,
+	OPT_qsort_elem_size,
 
 	OPT_quota,
 	OPT_quota_ops,
@@ -3493,6 +3731,8 @@ typedef enum {
 	OPT_radixsort,
 	OPT_radixsort_ops,
 	OPT_radixsort_size,
+	OPT_radixsort_threads,
+	OPT_radixsort_elem_size,
 
 	OPT_randlist,
 	OPT_randlist_ops,
@@ -3511,6 +3751,9 @@ typedef enum {
 	OPT_rawpkt,
 	OPT_rawpkt_ops,
 	OPT_rawpkt_port,
+	OPT_rawpkt_xdp,
+	OPT_rawpkt_xdp_if,
+	OPT_rawpkt_xdp_zerocopy,
 
 	OPT_rawsock,
 	OPT_rawsock_ops,
@@ -3538,6 +3781,11 @@ typedef enum {
 	OPT_resched,
 	OPT_resched_ops,
 
+	OPT_results_db,
+	OPT_results_baseline,
+	OPT_results_threshold,
+	OPT_results_key,
+
 	OPT_resources,
 	OPT_resources_ops,
 
@@ -3554,15 +3802,27 @@ typedef enum {
 
 	OPT_rseq,
 	OPT_rseq_ops,
+	OPT_rseq_bench,
+	OPT_rseq_threads,
+	OPT_rseq_preempt,
 
 	OPT_rtc,
 	OPT_rtc_ops,
 
+	OPT_sample,
+	OPT_sample_file,
+	OPT_sample_format,
+
 	OPT_sched,
 	OPT_sched_prio,
 
 	OPT_schedpolicy,
 	OPT_schedpolicy_ops,
+	OPT_schedpolicy_bench,
+	OPT_schedpolicy_hogs,
+	OPT_schedpolicy_period,
+	OPT_schedpolicy_uclamp,
+	OPT_schedpolicy_work,
 
 	OPT_sched_period,
 	OPT_sched_runtime,
@@ -3668,7 +3928,11 @@ typedef enum {
 
 	OPT_skiplist,
 	OPT_skiplist_ops,
+	OPT_skiplist_method,
+	OPT_skiplist_read,
 	OPT_skiplist_size,
+	OPT_skiplist_skew,
+	OPT_skiplist_threads,
 
 	OPT_skip_silent,
 
@@ -3682,7 +3946,10 @@ typedef enum {
 	OPT_smi_ops,
 
 	OPT_sock_ops,
+	OPT_sock_busy_poll,
 	OPT_sock_domain,
+	OPT_sock_msgs,
+	OPT_sock_msg_size,
 	OPT_sock_nodelay,
 	OPT_sock_opts,
 	OPT_sock_port,
@@ -3712,12 +3979,31 @@ typedef enum {
 	OPT_swap,
 	OPT_swap_ops,
 
+	OPT_swaprate,
+	OPT_swaprate_ops,
+	OPT_swaprate_bytes,
+	OPT_swaprate_hot,
+	OPT_swaprate_hot_size,
+	OPT_swaprate_target,
+
 	OPT_switch_ops,
 	OPT_switch_freq,
+	OPT_switch_matrix,
+	OPT_switch_method,
+	OPT_switch_placement,
+	OPT_switch_producers,
+	OPT_switch_consumers,
 
 	OPT_spawn,
 	OPT_spawn_ops,
 
+	OPT_spawnscale,
+	OPT_spawnscale_ops,
+	OPT_spawnscale_method,
+	OPT_spawnscale_rss,
+	OPT_spawnscale_threads,
+	OPT_spawnscale_thp,
+
 	OPT_splice,
 	OPT_splice_ops,
 	OPT_splice_bytes,
@@ -3739,6 +4025,7 @@ typedef enum {
 	OPT_stream_index,
 	OPT_stream_l3_size,
 	OPT_stream_madvise,
+	OPT_stream_nt,
 
 	OPT_stressors,
 
@@ -3771,6 +4058,13 @@ typedef enum {
 	OPT_tee,
 	OPT_tee_ops,
 
+	OPT_tiering,
+	OPT_tiering_ops,
+	OPT_tiering_bytes,
+	OPT_tiering_hot,
+	OPT_tiering_fast,
+	OPT_tiering_slow,
+
 	OPT_taskset,
 
 	OPT_temp_path,
@@ -3780,6 +4074,8 @@ typedef enum {
 
 	OPT_thrash,
 
+	OPT_threads,
+
 	OPT_timer_slack,
 
 	OPT_timer_ops,
@@ -3798,6 +4094,7 @@ typedef enum {
 
 	OPT_tlb_shootdown,
 	OPT_tlb_shootdown_ops,
+	OPT_tlb_shootdown_threads,
 
 	OPT_tmpfs,
 	OPT_tmpfs_ops,
@@ -3808,6 +4105,7 @@ typedef enum {
 	OPT_tree_ops,
 	OPT_tree_method,
 	OPT_tree_size,
+	OPT_tree_alloc,
 
 	OPT_tsc,
 	OPT_tsc_ops,
@@ -3840,7 +4138,10 @@ typedef enum {
 
 	OPT_userfaultfd,
 	OPT_userfaultfd_ops,
+	OPT_userfaultfd_batch,
 	OPT_userfaultfd_bytes,
+	OPT_userfaultfd_mode,
+	OPT_userfaultfd_threads,
 
 	OPT_utime,
 	OPT_utime_ops,
@@ -3852,9 +4153,11 @@ typedef enum {
 
 	OPT_vecmath,
 	OPT_vecmath_ops,
+	OPT_vecmath_freq,
 
 	OPT_vecwide,
 	OPT_vecwide_ops,
+	OPT_vecwide_freq,
 
 	OPT_verify,
 
@@ -3878,6 +4181,7 @@ typedef enum {
 	OPT_vm_ops,
 	OPT_vm_madvise,
 	OPT_vm_method,
+	OPT_vm_threads,
 
 	OPT_vm_addr,
 	OPT_vm_addr_method,
@@ -3886,6 +4190,11 @@ typedef enum {
 	OPT_vm_rw,
 	OPT_vm_rw_ops,
 	OPT_vm_rw_bytes,
+	OPT_vm_rw_bench,
+	OPT_vm_rw_iov,
+	OPT_vm_rw_seg,
+	OPT_vm_rw_peers,
+	OPT_vm_rw_hugepages,
 
 	OPT_vm_segv,
 	OPT_vm_segv_ops,
@@ -3918,6 +4227,12 @@ typedef enum {
 	OPT_zero,
 	OPT_zero_ops,
 
+	OPT_zerocopy,
+	OPT_zerocopy_ops,
+	OPT_zerocopy_method,
+	OPT_zerocopy_bytes,
+	OPT_zerocopy_chunk,
+
 	OPT_zlib,
 	OPT_zlib_ops,
 	OPT_zlib_level,
@@ -3926,10 +4241,17 @@ typedef enum {
 	OPT_zlib_window_bits,
 	OPT_zlib_stream_bytes,
 	OPT_zlib_strategy,
+	OPT_zlib_threads,
 
 	OPT_zombie,
 	OPT_zombie_ops,
 	OPT_zombie_max,
+
+	OPT_zram,
+	OPT_zram_ops,
+	OPT_zram_algos,
+	OPT_zram_data,
+	OPT_zram_size,
 } stress_op_t;
 
 /* stress test metadata */
@@ -3951,6 +4273,9 @@ typedef struct stress_stressor_info {
 	int32_t started_instances;	/* count of started instances */
 	int32_t num_instances;		/* number of instances per stressor */
 	uint64_t bogo_ops;		/* number of bogo ops */
+	double phase_start;		/* job phase start offset in seconds */
+	double phase_timeout;		/* job phase run time, 0 for whole run */
+	double phase_ramp;		/* job phase instance start spread */
 } stress_stressor_t;
 
 /* Pointer to current running stressor proc info */
@@ -4157,6 +4482,8 @@ extern WARN_UNUSED bool stress_cpu_x86_has_rdrand(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_rdseed(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_syscall(void);
 extern WARN_UNUSED bool stress_cpu_x86_has_tsc(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_amx_int8(void);
+extern WARN_UNUSED bool stress_cpu_x86_has_amx_bf16(void);
 
 #if defined(STRESS_ARCH_X86) &&	\
     defined(HAVE_ASM_X86_CLFLUSH)
@@ -4228,15 +4555,18 @@ extern uint8_t stress_mwc8(void);
 extern uint8_t stress_mwc1(void);
 extern void stress_mwc_seed(const uint32_t w, const uint32_t z);
 extern void stress_mwc_reseed(void);
+extern void stress_mwc_fill(void *buf, const size_t len);
 
 /* Time handling */
 extern WARN_UNUSED double stress_timeval_to_double(const struct timeval *tv);
 extern WARN_UNUSED double stress_time_now(void);
+extern WARN_UNUSED double stress_time_now_ns(void);
 extern const char *stress_duration_to_str(const double duration);
 
 /* Perf statistics */
 #if defined(STRESS_PERF_STATS)
 extern int stress_perf_open(stress_perf_t *sp);
+extern int stress_perf_imc_open(stress_perf_t *sp);
 extern int stress_perf_enable(stress_perf_t *sp);
 extern int stress_perf_disable(stress_perf_t *sp);
 extern int stress_perf_close(stress_perf_t *sp);
@@ -4244,7 +4574,11 @@ extern bool stress_perf_stat_succeeded(const stress_perf_t *sp);
 extern void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *procs_head,
 	const double duration);
 extern void stress_perf_init(void);
+extern void stress_perf_derived_yaml(FILE *yaml, const stress_stressor_t *ss,
+	const double duration);
 #endif
+extern WARN_UNUSED int stress_perf_llc_open(void);
+extern WARN_UNUSED uint64_t stress_perf_llc_read(const int fd);
 
 typedef int stress_oomable_child_func_t(const stress_args_t *args, void *context);
 
@@ -4293,6 +4627,46 @@ extern void stress_check_range(const char *const opt, const uint64_t val,
 extern void stress_check_range_bytes(const char *const opt,
 	const uint64_t val, const uint64_t lo, const uint64_t hi);
 extern WARN_UNUSED int stress_set_cpu_affinity(const char *arg);
+extern void stress_set_instance_affinity(const uint32_t instance);
+#if defined(HAVE_AFFINITY)
+extern int stress_topology_read_list(const char *path, cpu_set_t *set);
+extern int stress_topology_llc_list(const int32_t cpu, cpu_set_t *set);
+extern int32_t stress_topology_package(const int32_t cpu);
+extern int32_t stress_cpus_interleave_packages(const cpu_set_t *mask,
+	int32_t *cpus, const int32_t max);
+#endif
+extern WARN_UNUSED int stress_set_numa_policy(const char *const opt);
+extern WARN_UNUSED int stress_set_pressure(const char *const opt);
+extern WARN_UNUSED int stress_set_pressure_full(const char *const opt);
+extern void stress_pressure_start(void);
+extern void stress_pressure_stop(void);
+extern WARN_UNUSED int stress_set_cgroup(const char *const opt);
+extern WARN_UNUSED int stress_set_cgroup_cpu_max(const char *const opt);
+extern WARN_UNUSED int stress_set_cgroup_memory_high(const char *const opt);
+extern WARN_UNUSED int stress_set_cgroup_io_max(const char *const opt);
+extern void stress_cgroup_start(stress_stressor_t *stressors_list);
+extern void stress_cgroup_join(const stress_stressor_t *ss);
+extern void stress_cgroup_dump(FILE *yaml, const double duration);
+extern void stress_cgroup_stop(void);
+extern WARN_UNUSED int stress_set_tz_target(const char *const opt);
+extern WARN_UNUSED int stress_set_tz_power(const char *const opt);
+extern WARN_UNUSED int stress_set_tz_zone(const char *const opt);
+extern void stress_tz_control_start(stress_stressor_t *stressors_list);
+extern void stress_tz_control_stop(void);
+extern WARN_UNUSED int stress_set_bpf(const char *const opt);
+extern WARN_UNUSED int stress_set_bpf_period(const char *const opt);
+extern void stress_bpf_start(void);
+extern void stress_bpf_stop(void);
+extern void stress_bpf_add_pid(const pid_t pid);
+extern void stress_numa_mbind(const stress_args_t *args, void *addr,
+	const size_t len);
+extern int stress_numa_pages(const stress_args_t *args, const void *addr,
+	const size_t len, uint64_t *pages, const int max_nodes);
+extern void stress_numa_report(const stress_args_t *args,
+	const uint64_t *pages, const int nodes, const double mb_per_sec);
+extern int32_t stress_numa_remote_node(int32_t *local);
+extern int stress_numa_bind_node(void *addr, const size_t len,
+	const int32_t node);
 extern WARN_UNUSED uint32_t stress_get_uint32(const char *const str);
 extern WARN_UNUSED int32_t  stress_get_int32(const char *const str);
 extern WARN_UNUSED int32_t  stress_get_opt_sched(const char *const str);
@@ -4329,12 +4703,21 @@ extern WARN_UNUSED const char *stress_get_temp_path(void);
 extern WARN_UNUSED int stress_check_temp_path(void);
 extern void stress_temp_path_free(void);
 extern void stress_strnrnd(char *str, const size_t len);
+extern WARN_UNUSED int stress_zlib_rand_data_index(const char *name);
+extern WARN_UNUSED const char *stress_zlib_rand_data_name(const size_t index);
+extern void stress_zlib_rand_data(const stress_args_t *args, const size_t index,
+	uint8_t *data, const size_t size);
 extern void stress_get_cache_size(uint64_t *l2, uint64_t *l3);
 extern WARN_UNUSED unsigned int stress_get_cpu(void);
 extern WARN_UNUSED const char *stress_get_compiler(void);
 extern WARN_UNUSED const char *stress_get_uname_info(void);
 extern WARN_UNUSED int stress_cache_alloc(const char *name);
 extern void stress_cache_free(void);
+extern int stress_cache_sweep(const stress_args_t *args,
+	uint32_t line_size, uint64_t conflict_stride);
+extern int stress_vecfreq(const stress_args_t *args, const bool fp);
+extern double stress_vecfreq_ghz(void);
+extern int stress_memfunc_compare(const stress_args_t *args);
 extern void stress_ignite_cpu_start(void);
 extern void stress_ignite_cpu_stop(void);
 extern ssize_t system_write(const char *path, const char *buf, const size_t buf_len);
@@ -4346,7 +4729,13 @@ extern WARN_UNUSED uint64_t stress_get_prime64(const uint64_t n);
 extern WARN_UNUSED size_t stress_get_file_limit(void);
 extern WARN_UNUSED size_t stress_get_max_file_limit(void);
 extern WARN_UNUSED int stress_get_bad_fd(void);
-extern void stress_vmstat_start(void);
+extern void stress_vmstat_start(stress_stressor_t *stressors_list);
+extern double stress_get_cpu_ghz_average(void);
+extern void stress_get_vmstat_swap(uint64_t *swap_in, uint64_t *swap_out);
+extern void stress_get_vmstat_workingset(uint64_t *refault, uint64_t *activate,
+	uint64_t *restore);
+extern void stress_get_vmstat_tiering(uint64_t *promote, uint64_t *demote,
+	uint64_t *hint_faults);
 extern void stress_vmstat_stop(void);
 extern WARN_UNUSED int stress_sigaltstack_no_check(void *stack, const size_t size);
 extern WARN_UNUSED int stress_sigaltstack(void *stack, const size_t size);
@@ -4388,6 +4777,12 @@ extern stress_hash_t *stress_hash_add(stress_hash_table_t *hash_table,
 extern WARN_UNUSED stress_hash_t *stress_hash_get(
 	stress_hash_table_t *hash_table, const char *str);
 extern void stress_hash_delete(stress_hash_table_t *hash_table);
+extern WARN_UNUSED stress_hash_oatable_t *stress_hash_oatable_create(const size_t n);
+extern int stress_hash_oatable_put(stress_hash_oatable_t *table,
+	const uint64_t key, const uint64_t value);
+extern WARN_UNUSED bool stress_hash_oatable_get(
+	const stress_hash_oatable_t *table, const uint64_t key, uint64_t *value);
+extern void stress_hash_oatable_delete(stress_hash_oatable_t *table);
 extern WARN_UNUSED int stress_try_open(const stress_args_t *args,
 	const char *path, const int flags, const unsigned long timeout_ns);
 extern WARN_UNUSED int stress_open_timeout(const char *name,
@@ -4400,6 +4795,10 @@ extern WARN_UNUSED uint32_t stress_hash_fnv1a(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_sdbm(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_nhash(const char *str);
 extern WARN_UNUSED uint32_t stress_hash_murmur3_32(const uint8_t* key, size_t len, uint32_t seed);
+extern WARN_UNUSED uint64_t stress_hash_xxh64(const uint8_t *data,
+	const size_t len, const uint64_t seed);
+extern WARN_UNUSED uint64_t stress_hash_wyhash(const uint8_t *data,
+	const size_t len, uint64_t seed);
 extern void stress_dirent_list_free(struct dirent **dlist, const int n);
 extern WARN_UNUSED int stress_dirent_list_prune(struct dirent **dlist, const int n);
 extern WARN_UNUSED uint16_t stress_ipv4_checksum(uint16_t *ptr, const size_t n);
@@ -4409,6 +4808,7 @@ extern WARN_UNUSED size_t stress_hostname_length(void);
 extern WARN_UNUSED int32_t stress_set_vmstat(const char *const str);
 extern WARN_UNUSED int32_t stress_set_thermalstat(const char *const str);
 extern WARN_UNUSED int32_t stress_set_iostat(const char *const str);
+extern WARN_UNUSED int stress_set_iostat_format(const char *const opt);
 extern void stress_misc_stats_set(stress_misc_stats_t *misc_stats,
 	const int idx, const char *description, const double value);
 extern WARN_UNUSED int stress_tty_width(void);
@@ -4416,6 +4816,16 @@ extern WARN_UNUSED size_t stress_get_extents(const int fd);
 extern WARN_UNUSED bool stress_redo_fork(const int err);
 extern int stress_killpid(const pid_t pid);
 
+extern WARN_UNUSED int stress_set_results_threshold(const char *const opt);
+extern void stress_results_init(void);
+extern bool stress_results_store(stress_stressor_t *stressors_list,
+	const int32_t ticks_per_sec, const int argc, char * const *argv);
+
+extern WARN_UNUSED int stress_set_sample(const char *const opt);
+extern WARN_UNUSED int stress_set_sample_format(const char *const opt);
+extern void stress_sample_start(stress_stressor_t *stressors_list);
+extern void stress_sample_stop(void);
+
 extern void stress_smart_start(void);
 extern void stress_smart_stop(void);
 
@@ -4464,9 +4874,23 @@ static inline WARN_UNUSED ALWAYS_INLINE void *stress_align_stack(void *stack_top
 extern WARN_UNUSED bool stress_warn_once_hash(const char *filename, const int line);
 #define stress_warn_once()	stress_warn_once_hash(__FILE__, __LINE__)
 
+/* Parallel sorting shared by the sort stressors */
+#define STRESS_SORT_MAX_THREADS	(64)
+#define STRESS_SORT_MERGE	(0)	/* sorting network blocks then merges */
+#define STRESS_SORT_QSORT	(1)	/* qsort chunks then merges */
+#define STRESS_SORT_RADIX	(2)	/* least significant digit radix */
+
+extern void stress_sort_parallel(void *data, void *tmp, const size_t n,
+	const size_t elem_size, uint32_t threads, const int method);
+extern int stress_sort_threads(const stress_args_t *args, const size_t n,
+	const size_t elem_size, const uint32_t threads, const int method);
+extern int stress_set_sort_threads(const char *setting, const char *opt);
+extern int stress_set_sort_elem_size(const char *setting, const char *opt);
+
 /* Jobfile parsing */
 extern WARN_UNUSED int stress_parse_jobfile(int argc, char **argv,
 	const char *jobfile);
+extern void stress_job_phase(double *start, double *timeout, double *ramp);
 extern WARN_UNUSED int stress_parse_opts(int argc, char **argv,
 	const bool jobmode);
 
@@ -4515,6 +4939,7 @@ extern void stress_free_cpu_caches(stress_cpus_t *cpus);
 /* CPU thrashing start/stop helpers */
 extern int  stress_thrash_start(void);
 extern void stress_thrash_stop(void);
+extern ssize_t stress_compact_memory(void);
 
 /* Used to set options for specific stressors */
 extern void stress_adjust_pthread_max(const uint64_t max);
@@ -144,11 +144,9 @@ static void stress_opcode_random(
 	const uint8_t *ops_end,
 	uint32_t *op)
 {
-	register uint8_t *ops = (uint8_t *)ops_begin;
 	(void)op;
 
-	while (ops < ops_end)
-		*(ops++) = stress_mwc8();
+	stress_mwc_fill(ops_begin, (size_t)(ops_end - ops_begin));
 }
 
 static void stress_opcode_inc(
@@ -0,0 +1,635 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"pagecache N",		 "start N workers reading a file working set larger than the page cache" },
+	{ NULL,	"pagecache-ops N",	 "stop after N page cache reads" },
+	{ NULL,	"pagecache-bytes N",	 "size of the file working set of all the workers" },
+	{ NULL,	"pagecache-skew S",	 "zipfian access skew, 0 for uniform up to 0.99" },
+	{ NULL,	"pagecache-run N",	 "number of sequential reads after each random seek" },
+	{ NULL,	"pagecache-read-size N", "size of each read" },
+	{ NULL,	"pagecache-advice A",	 "file advice, one of normal, random or sequential" },
+	{ NULL,	NULL,			 NULL }
+};
+
+#define MIN_PAGECACHE_BYTES		(1 * MB)
+#define MAX_PAGECACHE_BYTES		(MAX_FILE_LIMIT)
+#define DEFAULT_PAGECACHE_SKEW		(900)	/* thousandths */
+#define MAX_PAGECACHE_SKEW		(990)
+#define MIN_PAGECACHE_RUN		(1)
+#define MAX_PAGECACHE_RUN		(4096)
+#define DEFAULT_PAGECACHE_RUN		(8)
+#define MIN_PAGECACHE_READ_SIZE		(4 * KB)
+#define MAX_PAGECACHE_READ_SIZE		(1 * MB)
+#define DEFAULT_PAGECACHE_READ_SIZE	(16 * KB)
+
+#define PAGECACHE_WRITE_SIZE		(1 * MB)
+#define PAGECACHE_RA_WINDOW		(512)	/* pages checked for readahead after a miss */
+#define PAGECACHE_SWEEP			(0.25)	/* seconds between eviction sweeps */
+#define PAGECACHE_SWEEP_PAGES		(65536)
+#define PAGECACHE_SAMPLES		(65536)
+
+typedef struct {
+	const char *name;
+	const int advice;
+} stress_pagecache_advice_t;
+
+static const stress_pagecache_advice_t pagecache_advices[] = {
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_NORMAL)
+	{ "normal",	POSIX_FADV_NORMAL },
+#else
+	{ "normal",	0 },
+#endif
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_RANDOM)
+	{ "random",	POSIX_FADV_RANDOM },
+#endif
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_SEQUENTIAL)
+	{ "sequential",	POSIX_FADV_SEQUENTIAL },
+#endif
+};
+
+/* zipfian rank generator, Gray et al, "Quickly Generating Billion-Record Synthetic Databases" */
+typedef struct {
+	uint64_t n;
+	double theta;
+	double alpha;
+	double zetan;
+	double eta;
+	double half_pow_theta;
+} stress_pagecache_zipf_t;
+
+typedef struct {
+	uint64_t hits;			/* reads entirely in the page cache */
+	uint64_t misses;		/* reads that had to wait for storage */
+	uint64_t ra_pages;		/* pages read ahead after misses */
+	uint64_t ra_used;		/* read ahead pages later read */
+	uint64_t ra_wasted;		/* read ahead pages evicted unread */
+	double hit_time;
+	double miss_time;
+	double max_time;
+} stress_pagecache_stats_t;
+
+static int stress_set_pagecache_bytes(const char *opt)
+{
+	uint64_t pagecache_bytes;
+
+	pagecache_bytes = stress_get_uint64_byte_filesystem(opt, 1);
+	stress_check_range_bytes("pagecache-bytes", pagecache_bytes,
+		MIN_PAGECACHE_BYTES, MAX_PAGECACHE_BYTES);
+	return stress_set_setting("pagecache-bytes", TYPE_ID_UINT64, &pagecache_bytes);
+}
+
+static int stress_set_pagecache_skew(const char *opt)
+{
+	const double skew = atof(opt);
+	uint32_t pagecache_skew;
+
+	if ((skew < 0.0) || (skew > (double)MAX_PAGECACHE_SKEW / 1000.0)) {
+		(void)fprintf(stderr, "pagecache-skew must be 0 to %.2f\n",
+			(double)MAX_PAGECACHE_SKEW / 1000.0);
+		_exit(EXIT_FAILURE);
+	}
+	pagecache_skew = (uint32_t)((skew * 1000.0) + 0.5);
+	return stress_set_setting("pagecache-skew", TYPE_ID_UINT32, &pagecache_skew);
+}
+
+static int stress_set_pagecache_run(const char *opt)
+{
+	uint32_t pagecache_run;
+
+	pagecache_run = stress_get_uint32(opt);
+	stress_check_range("pagecache-run", (uint64_t)pagecache_run,
+		MIN_PAGECACHE_RUN, MAX_PAGECACHE_RUN);
+	return stress_set_setting("pagecache-run", TYPE_ID_UINT32, &pagecache_run);
+}
+
+static int stress_set_pagecache_read_size(const char *opt)
+{
+	size_t pagecache_read_size;
+
+	pagecache_read_size = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("pagecache-read-size", pagecache_read_size,
+		MIN_PAGECACHE_READ_SIZE, MAX_PAGECACHE_READ_SIZE);
+	return stress_set_setting("pagecache-read-size", TYPE_ID_SIZE_T, &pagecache_read_size);
+}
+
+static int stress_set_pagecache_advice(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(pagecache_advices); i++) {
+		if (!strcmp(opt, pagecache_advices[i].name))
+			return stress_set_setting("pagecache-advice", TYPE_ID_SIZE_T, &i);
+	}
+	(void)fprintf(stderr, "pagecache-advice must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(pagecache_advices); i++)
+		(void)fprintf(stderr, " %s", pagecache_advices[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_pagecache_bytes,		stress_set_pagecache_bytes },
+	{ OPT_pagecache_skew,		stress_set_pagecache_skew },
+	{ OPT_pagecache_run,		stress_set_pagecache_run },
+	{ OPT_pagecache_read_size,	stress_set_pagecache_read_size },
+	{ OPT_pagecache_advice,		stress_set_pagecache_advice },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_MINCORE)
+
+/*
+ *  stress_pagecache_zipf_init()
+ *	precompute the zeta constants for n ranks
+ */
+static void stress_pagecache_zipf_init(stress_pagecache_zipf_t *z, const uint64_t n, const double theta)
+{
+	uint64_t i;
+	double zeta2;
+
+	(void)memset(z, 0, sizeof(*z));
+	z->n = n;
+	z->theta = theta;
+	if (theta <= 0.0)
+		return;
+	z->zetan = 0.0;
+	for (i = 1; i <= n; i++)
+		z->zetan += 1.0 / pow((double)i, theta);
+	zeta2 = 1.0 + (1.0 / pow(2.0, theta));
+	z->alpha = 1.0 / (1.0 - theta);
+	z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - (zeta2 / z->zetan));
+	z->half_pow_theta = 1.0 + pow(0.5, theta);
+}
+
+/*
+ *  stress_pagecache_zipf()
+ *	rank 0 is the most popular, uniform if theta is 0
+ */
+static uint64_t stress_pagecache_zipf(const stress_pagecache_zipf_t *z)
+{
+	const double u = (double)stress_mwc32() / 4294967296.0;
+	const double uz = u * z->zetan;
+	uint64_t rank;
+
+	if (z->theta <= 0.0)
+		return stress_mwc64() % z->n;
+	if (uz < 1.0)
+		return 0;
+	if (uz < z->half_pow_theta)
+		return 1;
+	rank = (uint64_t)((double)z->n * pow((z->eta * u) - z->eta + 1.0, z->alpha));
+	return (rank >= z->n) ? z->n - 1 : rank;
+}
+
+/*
+ *  stress_pagecache_coprime()
+ *	a multiplier coprime to n so ranks spread over the whole file
+ */
+static uint64_t stress_pagecache_coprime(const uint64_t n)
+{
+	uint64_t p = 2654435761ULL % n;
+
+	for (;;) {
+		uint64_t a = p, b = n;
+
+		while (b) {
+			const uint64_t t = a % b;
+
+			a = b;
+			b = t;
+		}
+		if ((a == 1) || (n == 1))
+			return p ? p : 1;
+		p = (p + 1) % n;
+	}
+}
+
+/*
+ *  stress_pagecache_read_bytes()
+ *	bytes this process has caused to be read from storage
+ */
+static uint64_t stress_pagecache_read_bytes(void)
+{
+	char buf[512];
+	const char *ptr;
+
+	if (system_read("/proc/self/io", buf, sizeof(buf)) <= 0)
+		return 0;
+	ptr = strstr(buf, "\nread_bytes: ");
+	if (!ptr)
+		return 0;
+	return (uint64_t)strtoull(ptr + 13, NULL, 10);
+}
+
+/*
+ *  stress_pagecache_resident()
+ *	count the resident pages of a range, vec gets the page states
+ */
+static size_t stress_pagecache_resident(uint8_t *map, const size_t page,
+	const size_t pages, const size_t page_size, unsigned char *vec)
+{
+	size_t i, n = 0;
+
+	if (shim_mincore((void *)(map + (page * page_size)), pages * page_size, vec) < 0)
+		return 0;
+	for (i = 0; i < pages; i++)
+		n += (vec[i] & 1);
+	return n;
+}
+
+/*
+ *  stress_pagecache_sweep()
+ *	read ahead pages that are no longer resident were evicted
+ *	before they were ever read
+ */
+static void stress_pagecache_sweep(uint8_t *map, const size_t npages,
+	const size_t page_size, uint64_t *spec, unsigned char *vec,
+	stress_pagecache_stats_t *stats)
+{
+	size_t page;
+
+	for (page = 0; page < npages; page += PAGECACHE_SWEEP_PAGES) {
+		const size_t n = (npages - page < PAGECACHE_SWEEP_PAGES) ?
+			npages - page : PAGECACHE_SWEEP_PAGES;
+		size_t i;
+
+		if (shim_mincore((void *)(map + (page * page_size)), n * page_size, vec) < 0)
+			return;
+		for (i = 0; i < n; i++) {
+			const size_t p = page + i;
+
+			if ((spec[p / 64] & (1ULL << (p & 63))) && !(vec[i] & 1)) {
+				spec[p / 64] &= ~(1ULL << (p & 63));
+				stats->ra_wasted++;
+			}
+		}
+	}
+}
+
+/*
+ *  stress_pagecache_file_init()
+ *	fill the file with incompressible data and drop it from the
+ *	page cache so the run starts cold
+ */
+static int stress_pagecache_file_init(const stress_args_t *args, const int fd, const uint64_t size)
+{
+	uint8_t *buf;
+	uint64_t off;
+	const double t = stress_time_now();
+
+	buf = (uint8_t *)mmap(NULL, PAGECACHE_WRITE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return -1;
+	stress_mwc_fill(buf, PAGECACHE_WRITE_SIZE);
+	for (off = 0; off < size; off += PAGECACHE_WRITE_SIZE) {
+		const size_t len = (size - off < PAGECACHE_WRITE_SIZE) ?
+			(size_t)(size - off) : PAGECACHE_WRITE_SIZE;
+
+		/* vary each write a little so no two blocks are the same */
+		*(uint64_t *)buf = off;
+		if (pwrite(fd, buf, len, (off_t)off) != (ssize_t)len) {
+			pr_inf_skip("%s: cannot write the working set file, errno=%d (%s), "
+				"skipping stressor\n", args->name, errno, strerror(errno));
+			(void)munmap((void *)buf, PAGECACHE_WRITE_SIZE);
+			return -1;
+		}
+		if (!keep_stressing_flag()) {
+			(void)munmap((void *)buf, PAGECACHE_WRITE_SIZE);
+			return -1;
+		}
+	}
+	(void)munmap((void *)buf, PAGECACHE_WRITE_SIZE);
+	(void)shim_fdatasync(fd);
+#if defined(HAVE_POSIX_FADVISE) &&	\
+    defined(POSIX_FADV_DONTNEED)
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	pr_dbg("%s: wrote %" PRIu64 " MB working set file in %.2f seconds\n",
+		args->name, (uint64_t)(size / MB), stress_time_now() - t);
+	return 0;
+}
+
+/*
+ *  stress_pagecache_cmp()
+ *	sort doubles in ascending order
+ */
+static int stress_pagecache_cmp(const void *p1, const void *p2)
+{
+	const double d1 = *(const double *)p1;
+	const double d2 = *(const double *)p2;
+
+	if (d1 < d2)
+		return -1;
+	return d1 > d2;
+}
+
+/*
+ *  stress_pagecache_report()
+ *	report hit rate, read latency, readahead use and refaults
+ */
+static void stress_pagecache_report(
+	const stress_args_t *args,
+	const stress_pagecache_stats_t *stats,
+	double *samples,
+	const size_t n_samples,
+	const double duration,
+	const uint64_t storage_bytes,
+	const size_t read_size,
+	const uint64_t refault,
+	const uint64_t activate,
+	const uint64_t restore)
+{
+	const uint64_t reads = stats->hits + stats->misses;
+	const double hit_pc = 100.0 * (double)stats->hits / (double)reads;
+	const uint64_t ra_done = stats->ra_used + stats->ra_wasted;
+	const double ra_pc = ra_done ? 100.0 * (double)stats->ra_used / (double)ra_done : 0.0;
+	const double amp = stats->misses ?
+		(double)storage_bytes / ((double)stats->misses * (double)read_size) : 0.0;
+	double p99;
+	bool lock = false;
+
+	qsort(samples, n_samples, sizeof(*samples), stress_pagecache_cmp);
+	p99 = samples[(n_samples * 99) / 100];
+
+	stress_misc_stats_set(args->misc_stats, 0, "page cache hit %", hit_pc);
+	stress_misc_stats_set(args->misc_stats, 1, "read latency p99 usec", p99 * 1000000.0);
+	if (ra_done)
+		stress_misc_stats_set(args->misc_stats, 2, "readahead used %", ra_pc);
+	if (duration > 0.0)
+		stress_misc_stats_set(args->misc_stats, 3, "file refaults per sec",
+			(double)refault / duration);
+
+	if (args->instance != 0)
+		return;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %" PRIu64 " reads, %.1f%% page cache hits\n",
+		args->name, reads, hit_pc);
+	pr_inf_lock(&lock, "%s: read latency mean %.2f, p50 %.2f, p99 %.2f, max %.2f usec, "
+		"hit mean %.2f, miss mean %.2f usec\n", args->name,
+		((stats->hit_time + stats->miss_time) / (double)reads) * 1000000.0,
+		samples[n_samples / 2] * 1000000.0,
+		p99 * 1000000.0, stats->max_time * 1000000.0,
+		stats->hits ? (stats->hit_time / (double)stats->hits) * 1000000.0 : 0.0,
+		stats->misses ? (stats->miss_time / (double)stats->misses) * 1000000.0 : 0.0);
+	pr_inf_lock(&lock, "%s: readahead brought in %" PRIu64 " pages after misses, "
+		"%" PRIu64 " read, %" PRIu64 " evicted unread (%.1f%% used), "
+		"storage read amplification %.2fx\n", args->name,
+		stats->ra_pages, stats->ra_used, stats->ra_wasted, ra_pc, amp);
+	if (duration > 0.0) {
+		pr_inf_lock(&lock, "%s: system wide file refaults %.1f/s, activations %.1f/s, "
+			"workingset restores %.1f/s\n", args->name,
+			(double)refault / duration, (double)activate / duration,
+			(double)restore / duration);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_pagecache()
+ *	read a file working set larger than the page cache with a
+ *	skewed access pattern and track what the page cache does
+ */
+static int stress_pagecache(const stress_args_t *args)
+{
+	const size_t page_size = args->page_size;
+	size_t shmall, freemem, totalmem, freeswap;
+	uint64_t pagecache_bytes, size, nreads, nruns, mult, *spec;
+	uint64_t storage_start, refault_start, activate_start, restore_start;
+	uint64_t refault, activate, restore;
+	uint32_t pagecache_skew = DEFAULT_PAGECACHE_SKEW;
+	uint32_t pagecache_run = DEFAULT_PAGECACHE_RUN;
+	size_t pagecache_read_size = DEFAULT_PAGECACHE_READ_SIZE;
+	size_t pagecache_advice = 0, npages, read_pages, n_samples = 0, spec_size;
+	stress_pagecache_zipf_t zipf;
+	stress_pagecache_stats_t stats;
+	char filename[PATH_MAX];
+	double *samples, t_start, t_sweep;
+	unsigned char *vec;
+	uint8_t *buf, *map;
+	int fd, ret, rc = EXIT_SUCCESS;
+
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	if (!stress_get_setting("pagecache-bytes", &pagecache_bytes)) {
+		const uint64_t fs_size = stress_get_filesystem_size();
+
+		/* one and a half times memory, but no more than half the free space */
+		pagecache_bytes = (uint64_t)totalmem + ((uint64_t)totalmem / 2);
+		if (fs_size && (pagecache_bytes > fs_size / 2))
+			pagecache_bytes = fs_size / 2;
+	}
+	(void)stress_get_setting("pagecache-skew", &pagecache_skew);
+	(void)stress_get_setting("pagecache-run", &pagecache_run);
+	(void)stress_get_setting("pagecache-read-size", &pagecache_read_size);
+	(void)stress_get_setting("pagecache-advice", &pagecache_advice);
+
+	pagecache_read_size = (pagecache_read_size + page_size - 1) & ~(page_size - 1);
+	size = pagecache_bytes / args->num_instances;
+	size -= size % pagecache_read_size;
+	if (size < (uint64_t)pagecache_read_size * pagecache_run)
+		size = (uint64_t)pagecache_read_size * pagecache_run;
+	if (args->instance == 0) {
+		char str[32];
+
+		stress_uint64_to_str(str, sizeof(str), size);
+		pr_inf("%s: %sB working set file per instance, %zu MB of memory, "
+			"%.2f skew, %" PRIu32 " reads of %zuK per run, %s advice\n",
+			args->name, str, totalmem / (size_t)MB, (double)pagecache_skew / 1000.0,
+			pagecache_run, pagecache_read_size / (size_t)KB,
+			pagecache_advices[pagecache_advice].name);
+	}
+
+	npages = (size_t)(size / page_size);
+	read_pages = pagecache_read_size / page_size;
+	nreads = size / pagecache_read_size;
+	nruns = (nreads + pagecache_run - 1) / pagecache_run;
+	mult = stress_pagecache_coprime(nruns);
+	stress_pagecache_zipf_init(&zipf, nruns, (double)pagecache_skew / 1000.0);
+
+	buf = (uint8_t *)mmap(NULL, pagecache_read_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap read buffer, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	samples = calloc(PAGECACHE_SAMPLES, sizeof(*samples));
+	vec = calloc(PAGECACHE_SWEEP_PAGES, sizeof(*vec));
+	spec_size = ((npages + 63) / 64) * sizeof(*spec);
+	spec = (uint64_t *)mmap(NULL, spec_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (!samples || !vec || (spec == MAP_FAILED)) {
+		pr_inf_skip("%s: cannot allocate page tracking buffers, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto err_free;
+	}
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = exit_status(-ret);
+		goto err_free;
+	}
+	(void)stress_temp_filename_args(args, filename, sizeof(filename), stress_mwc32());
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = exit_status(errno);
+		pr_fail("%s: open %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto err_rmdir;
+	}
+	(void)unlink(filename);
+	if (stress_pagecache_file_init(args, fd, size) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto err_close;
+	}
+#if defined(HAVE_POSIX_FADVISE)
+	if (pagecache_advice)
+		(void)posix_fadvise(fd, 0, 0, pagecache_advices[pagecache_advice].advice);
+#endif
+	/* only mapped to ask mincore what is resident, it is never touched */
+	map = (uint8_t *)mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap the %" PRIu64 " byte working set file, "
+			"skipping stressor\n", args->name, size);
+		rc = EXIT_NO_RESOURCE;
+		goto err_close;
+	}
+
+	(void)memset(&stats, 0, sizeof(stats));
+	storage_start = stress_pagecache_read_bytes();
+	stress_get_vmstat_workingset(&refault_start, &activate_start, &restore_start);
+	t_start = t_sweep = stress_time_now();
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		const uint64_t run = (stress_pagecache_zipf(&zipf) * mult) % nruns;
+		uint64_t r;
+
+		for (r = 0; r < pagecache_run; r++) {
+			const uint64_t idx = ((run * pagecache_run) + r) % nreads;
+			const size_t page = (size_t)(idx * read_pages);
+			size_t resident, i, ra_start, ra_pages, before = 0;
+			double t, delta;
+
+			resident = stress_pagecache_resident(map, page, read_pages, page_size, vec);
+			for (i = 0; i < read_pages; i++) {
+				const size_t p = page + i;
+
+				if ((spec[p / 64] & (1ULL << (p & 63)))) {
+					spec[p / 64] &= ~(1ULL << (p & 63));
+					if (vec[i] & 1)
+						stats.ra_used++;
+					else
+						stats.ra_wasted++;
+				}
+			}
+
+			/* pages after the read that are not yet resident */
+			ra_start = page + read_pages;
+			ra_pages = (npages - ra_start < PAGECACHE_RA_WINDOW) ?
+				npages - ra_start : PAGECACHE_RA_WINDOW;
+			if ((resident < read_pages) && ra_pages)
+				before = stress_pagecache_resident(map, ra_start, ra_pages, page_size, vec);
+
+			t = stress_time_now();
+			if (pread(fd, buf, pagecache_read_size, (off_t)(idx * pagecache_read_size)) < 0) {
+				pr_fail("%s: pread failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			delta = stress_time_now() - t;
+
+			if (resident == read_pages) {
+				stats.hits++;
+				stats.hit_time += delta;
+			} else {
+				stats.misses++;
+				stats.miss_time += delta;
+				/* pages that are now resident but were not came in by readahead */
+				if (ra_pages && (stress_pagecache_resident(map, ra_start, ra_pages,
+						page_size, vec) > before)) {
+					for (i = 0; i < ra_pages; i++) {
+						const size_t p = ra_start + i;
+
+						if ((vec[i] & 1) && !(spec[p / 64] & (1ULL << (p & 63)))) {
+							spec[p / 64] |= (1ULL << (p & 63));
+							stats.ra_pages++;
+						}
+					}
+				}
+			}
+			if (delta > stats.max_time)
+				stats.max_time = delta;
+			samples[n_samples++ % PAGECACHE_SAMPLES] = delta;
+			inc_counter(args);
+		}
+
+		if (stress_time_now() - t_sweep >= PAGECACHE_SWEEP) {
+			stress_pagecache_sweep(map, npages, page_size, spec, vec, &stats);
+			t_sweep = stress_time_now();
+		}
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_get_vmstat_workingset(&refault, &activate, &restore);
+	if (n_samples) {
+		stress_pagecache_report(args, &stats, samples,
+			(n_samples < PAGECACHE_SAMPLES) ? n_samples : PAGECACHE_SAMPLES,
+			stress_time_now() - t_start,
+			stress_pagecache_read_bytes() - storage_start,
+			pagecache_read_size, refault - refault_start,
+			activate - activate_start, restore - restore_start);
+	}
+
+	(void)munmap((void *)map, (size_t)size);
+err_close:
+	(void)close(fd);
+err_rmdir:
+	(void)stress_temp_dir_rm_args(args);
+err_free:
+	if (spec != MAP_FAILED)
+		(void)munmap((void *)spec, spec_size);
+	free(vec);
+	free(samples);
+	(void)munmap((void *)buf, pagecache_read_size);
+	return rc;
+}
+
+stressor_info_t stress_pagecache_info = {
+	.stressor = stress_pagecache,
+	.class = CLASS_IO | CLASS_MEMORY | CLASS_FILESYSTEM,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_pagecache_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_IO | CLASS_MEMORY | CLASS_FILESYSTEM,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
@@ -39,6 +39,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"stream N",		"start N workers exercising memory bandwidth" },
 	{ NULL,	"stream-ops N",		"stop after N bogo stream operations" },
 	{ NULL,	"stream-l3-size N",	"specify the L3 cache size of the CPU" },
+	{ NULL,	"prefetch-sweep",	"sweep prefetch distance, locality hint and stride" },
+	{ NULL,	"prefetch-hwpf",	"repeat the sweep with hardware prefetchers off" },
 	{ NULL,	NULL,                   NULL }
 };
 
@@ -193,6 +195,393 @@ static inline void OPTIMIZE3 stress_prefetch_benchmark(
 	(*total_count)++;
 }
 
+#define PREFETCH_SWEEP_STRIDES	(5)
+#define PREFETCH_SWEEP_HINTS	(4)
+#define PREFETCH_SWEEP_DISTS	(7)
+#define PREFETCH_SWEEP_COLS	(1 + PREFETCH_SWEEP_DISTS)
+#define PREFETCH_SWEEP_WINDOW	(8 * MB)
+#define PREFETCH_SWEEP_MIN_SIZE	(4 * PREFETCH_SWEEP_WINDOW)
+#define PREFETCH_SWEEP_PAD	(64 * 4096)
+#define PREFETCH_HWPF_ON	(0)
+#define PREFETCH_HWPF_OFF	(1)
+#define MSR_MISC_FEATURE_CONTROL (0x000001a4)
+#define MSR_HWPF_DISABLE_MASK	(0x0000000f)	/* L2, L2 adjacent, DCU, DCU IP */
+
+typedef uint64_t (*stress_prefetch_sweep_func_t)(const uint8_t *buf,
+	const uint8_t *buf_end, const size_t stride, const size_t ahead);
+
+typedef struct {
+	double bytes;		/* bytes read */
+	double duration;	/* seconds reading */
+} stress_prefetch_sweep_t;
+
+static const size_t prefetch_sweep_strides[PREFETCH_SWEEP_STRIDES] = {
+	64, 128, 256, 1024, 4096
+};
+
+/* prefetch distance, in loop iterations ahead of the read */
+static const size_t prefetch_sweep_dists[PREFETCH_SWEEP_DISTS] = {
+	1, 2, 4, 8, 16, 32, 64
+};
+
+/*
+ *  read the first word of each stride sized step of the buffer, in
+ *  stride / cache line passes so every cache line is read once,
+ *  prefetching ahead steps ahead with the given locality hint
+ */
+#define STRESS_PREFETCH_SWEEP(name, locality)			\
+static uint64_t OPTIMIZE3 name(					\
+	const uint8_t *buf,					\
+	const uint8_t *buf_end,					\
+	const size_t stride,					\
+	const size_t ahead)					\
+{								\
+	register uint64_t sum = 0;				\
+	size_t pass;						\
+								\
+	for (pass = 0; pass < stride; pass += STRESS_CACHE_LINE_SIZE) {	\
+		register const uint8_t *ptr = buf + pass;	\
+		register const uint8_t *pre_ptr = ptr + (ahead * stride); \
+								\
+		while (ptr < buf_end) {				\
+			sum += *(const volatile uint64_t *)ptr;	\
+			shim_builtin_prefetch(pre_ptr, 0, locality); \
+			ptr += stride;				\
+			pre_ptr += stride;			\
+		}						\
+	}							\
+	return sum;						\
+}
+
+STRESS_PREFETCH_SWEEP(stress_prefetch_sweep_t0, 3)
+STRESS_PREFETCH_SWEEP(stress_prefetch_sweep_t1, 2)
+STRESS_PREFETCH_SWEEP(stress_prefetch_sweep_t2, 1)
+STRESS_PREFETCH_SWEEP(stress_prefetch_sweep_nta, 0)
+
+/*
+ *  stress_prefetch_sweep_none()
+ *	the stride read loop without software prefetch
+ */
+static uint64_t OPTIMIZE3 stress_prefetch_sweep_none(
+	const uint8_t *buf,
+	const uint8_t *buf_end,
+	const size_t stride,
+	const size_t ahead)
+{
+	register uint64_t sum = 0;
+	size_t pass;
+
+	(void)ahead;
+
+	for (pass = 0; pass < stride; pass += STRESS_CACHE_LINE_SIZE) {
+		register const uint8_t *ptr = buf + pass;
+
+		while (ptr < buf_end) {
+			sum += *(const volatile uint64_t *)ptr;
+			ptr += stride;
+		}
+	}
+	return sum;
+}
+
+static const struct {
+	const char *name;
+	const stress_prefetch_sweep_func_t func;
+} prefetch_sweep_hints[PREFETCH_SWEEP_HINTS] = {
+	{ "T0",		stress_prefetch_sweep_t0 },
+	{ "T1",		stress_prefetch_sweep_t1 },
+	{ "T2",		stress_prefetch_sweep_t2 },
+	{ "NTA",	stress_prefetch_sweep_nta },
+};
+
+/*
+ *  stress_prefetch_msr()
+ *	64 bit read or write of an MSR on a specified CPU
+ */
+static int stress_prefetch_msr(
+	const int cpu,
+	const uint32_t reg,
+	uint64_t *val,
+	const bool write_msr)
+{
+	char buffer[PATH_MAX];
+	ssize_t ret;
+	int fd;
+
+	(void)snprintf(buffer, sizeof(buffer), "/dev/cpu/%d/msr", cpu);
+	fd = open(buffer, write_msr ? O_WRONLY : O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ret = write_msr ? pwrite(fd, val, sizeof(*val), (off_t)reg) :
+			  pread(fd, val, sizeof(*val), (off_t)reg);
+	(void)close(fd);
+
+	return (ret == (ssize_t)sizeof(*val)) ? 0 : -1;
+}
+
+/*
+ *  stress_prefetch_hwpf_cpu()
+ *	pin to the current CPU and check its hardware prefetcher control
+ *	MSR can be read and written back, returns the CPU or -1
+ */
+static int stress_prefetch_hwpf_cpu(const stress_args_t *args, uint64_t *msr_orig)
+{
+#if defined(HAVE_AFFINITY)
+	const int cpu = (int)stress_get_cpu();
+	cpu_set_t mask;
+
+	if (!stress_cpu_is_x86() || !stress_cpu_x86_has_msr()) {
+		pr_inf("%s: hardware prefetcher control needs an Intel CPU "
+			"with MSRs, skipping the prefetchers off sweep\n", args->name);
+		return -1;
+	}
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_inf("%s: cannot pin to CPU %d, skipping the prefetchers "
+			"off sweep\n", args->name, cpu);
+		return -1;
+	}
+	if ((stress_prefetch_msr(cpu, MSR_MISC_FEATURE_CONTROL, msr_orig, false) < 0) ||
+	    (stress_prefetch_msr(cpu, MSR_MISC_FEATURE_CONTROL, msr_orig, true) < 0)) {
+		pr_inf("%s: cannot access MSR 0x%x on CPU %d (needs root and "
+			"the msr module), skipping the prefetchers off sweep\n",
+			args->name, MSR_MISC_FEATURE_CONTROL, cpu);
+		return -1;
+	}
+	return cpu;
+#else
+	(void)msr_orig;
+
+	pr_inf("%s: cannot pin to a CPU, skipping the prefetchers off sweep\n",
+		args->name);
+	return -1;
+#endif
+}
+
+/*
+ *  stress_prefetch_sweep_window()
+ *	time one setting reading the next window of the buffer, the
+ *	windows rotate through a buffer larger than the L3 cache so
+ *	each read starts cold
+ */
+static inline void stress_prefetch_sweep_window(
+	uint8_t *buf,
+	const size_t buf_size,
+	size_t *offset,
+	const stress_prefetch_sweep_func_t func,
+	const size_t stride,
+	const size_t ahead,
+	stress_prefetch_sweep_t *result)
+{
+	const uint8_t *window = buf + *offset;
+	double t;
+
+	t = stress_time_now();
+	stress_uint64_put(func(window, window + PREFETCH_SWEEP_WINDOW, stride, ahead));
+	result->duration += stress_time_now() - t;
+	result->bytes += (double)PREFETCH_SWEEP_WINDOW;
+
+	*offset += PREFETCH_SWEEP_WINDOW;
+	if (*offset + PREFETCH_SWEEP_WINDOW > buf_size)
+		*offset = 0;
+}
+
+/*
+ *  stress_prefetch_sweep_round()
+ *	one timed window read for every stride, locality hint and
+ *	distance, column 0 is the non-prefetch read shared by all hints
+ */
+static void stress_prefetch_sweep_round(
+	uint8_t *buf,
+	const size_t buf_size,
+	size_t *offset,
+	stress_prefetch_sweep_t results[PREFETCH_SWEEP_STRIDES][PREFETCH_SWEEP_HINTS][PREFETCH_SWEEP_COLS])
+{
+	size_t s, h, d;
+
+	for (s = 0; s < PREFETCH_SWEEP_STRIDES; s++) {
+		const size_t stride = prefetch_sweep_strides[s];
+		stress_prefetch_sweep_t none = { 0.0, 0.0 };
+
+		stress_prefetch_sweep_window(buf, buf_size, offset,
+			stress_prefetch_sweep_none, stride, 0, &none);
+		for (h = 0; h < PREFETCH_SWEEP_HINTS; h++) {
+			results[s][h][0].bytes += none.bytes;
+			results[s][h][0].duration += none.duration;
+			for (d = 0; d < PREFETCH_SWEEP_DISTS; d++) {
+				stress_prefetch_sweep_window(buf, buf_size, offset,
+					prefetch_sweep_hints[h].func, stride,
+					prefetch_sweep_dists[d], &results[s][h][d + 1]);
+			}
+		}
+	}
+}
+
+static inline double stress_prefetch_sweep_rate(const stress_prefetch_sweep_t *r)
+{
+	return (r->duration > 0.0) ? r->bytes / r->duration : 0.0;
+}
+
+/*
+ *  stress_prefetch_sweep_report()
+ *	report GB/s for each setting and the best hint and distance for
+ *	each stride, returning the best rate and distance (0 for no
+ *	prefetch) per stride
+ */
+static void stress_prefetch_sweep_report(
+	const stress_args_t *args,
+	const char *title,
+	stress_prefetch_sweep_t results[PREFETCH_SWEEP_STRIDES][PREFETCH_SWEEP_HINTS][PREFETCH_SWEEP_COLS],
+	double best_rates[PREFETCH_SWEEP_STRIDES],
+	size_t best_dists[PREFETCH_SWEEP_STRIDES])
+{
+	char line[256];
+	bool lock = false;
+	size_t s, h, d, pos;
+
+	if (args->instance == 0) {
+		pr_lock(&lock);
+		pr_inf_lock(&lock, "%s: %s, read GB/s by prefetch distance in iterations ahead\n",
+			args->name, title);
+		pos = (size_t)snprintf(line, sizeof(line), "%-14s %7s", "stride hint", "none");
+		for (d = 0; d < PREFETCH_SWEEP_DISTS; d++)
+			pos += (size_t)snprintf(line + pos, sizeof(line) - pos,
+				" %7zd", prefetch_sweep_dists[d]);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	}
+
+	for (s = 0; s < PREFETCH_SWEEP_STRIDES; s++) {
+		const size_t stride = prefetch_sweep_strides[s];
+		const double none = stress_prefetch_sweep_rate(&results[s][0][0]);
+		double best = 0.0, ns;
+		size_t best_h = 0, best_d = 0;
+
+		for (h = 0; h < PREFETCH_SWEEP_HINTS; h++) {
+			pos = (size_t)snprintf(line, sizeof(line), "%-6zd %-7s %7.2f",
+				stride, prefetch_sweep_hints[h].name, none / (double)GB);
+			for (d = 0; d < PREFETCH_SWEEP_DISTS; d++) {
+				const double rate = stress_prefetch_sweep_rate(&results[s][h][d + 1]);
+
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos,
+					" %7.2f", rate / (double)GB);
+				if (rate > best) {
+					best = rate;
+					best_h = h;
+					best_d = d;
+				}
+			}
+			if (args->instance == 0)
+				pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+		best_rates[s] = best;
+		best_dists[s] = prefetch_sweep_dists[best_d];
+		if (args->instance != 0)
+			continue;
+
+		/* time from prefetch issue to the read, at the best setting */
+		ns = (best > 0.0) ? 1000000000.0 * (double)(best_dists[s] * STRESS_CACHE_LINE_SIZE) / best : 0.0;
+		if (best > none) {
+			pr_inf_lock(&lock, "%s: stride %zd best: %s, %zd iterations ahead "
+				"(%zd bytes, ~%.1f ns), %.2f GB/s, %+.1f%% vs no prefetch\n",
+				args->name, stride, prefetch_sweep_hints[best_h].name,
+				best_dists[s], best_dists[s] * stride, ns, best / (double)GB,
+				none > 0.0 ? 100.0 * (best - none) / none : 0.0);
+		} else {
+			pr_inf_lock(&lock, "%s: stride %zd best: no prefetch, %.2f GB/s, "
+				"software prefetch does not help\n",
+				args->name, stride, none / (double)GB);
+			best_rates[s] = none;
+			best_dists[s] = 0;
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_prefetch_sweep()
+ *	sweep software prefetch distance, locality hint and read stride
+ *	over a buffer larger than the L3 cache, optionally repeating the
+ *	sweep with the hardware prefetchers disabled, one bogo op per sweep
+ */
+static int stress_prefetch_sweep(const stress_args_t *args, const size_t l3_data_size)
+{
+	static stress_prefetch_sweep_t results[2][PREFETCH_SWEEP_STRIDES][PREFETCH_SWEEP_HINTS][PREFETCH_SWEEP_COLS];
+	const size_t buf_size = STRESS_MAXIMUM(2 * l3_data_size, (size_t)PREFETCH_SWEEP_MIN_SIZE);
+	const size_t mmap_size = buf_size + PREFETCH_SWEEP_PAD;
+	double best_rates[PREFETCH_SWEEP_STRIDES];
+	size_t best_dists[PREFETCH_SWEEP_STRIDES], s;
+	bool prefetch_hwpf = false;
+	uint64_t msr_orig = 0;
+	uint8_t *buf;
+	size_t offset = 0;
+	int cpu = -1;
+
+	(void)stress_get_setting("prefetch-hwpf", &prefetch_hwpf);
+
+	buf = (uint8_t *)mmap(NULL, mmap_size, PROT_READ | PROT_WRITE,
+#if defined(MAP_POPULATE)
+		MAP_POPULATE |
+#endif
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot allocate %zu bytes, skipping stressor\n",
+			args->name, mmap_size);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(buf, 0xa5, mmap_size);
+	(void)memset(results, 0, sizeof(results));
+
+	/* only one instance changes the hardware prefetchers */
+	if (prefetch_hwpf && (args->instance == 0))
+		cpu = stress_prefetch_hwpf_cpu(args, &msr_orig);
+	if (args->instance == 0)
+		pr_inf("%s: sweeping a %zd MB buffer, %zd KB L3 cache\n",
+			args->name, buf_size / (size_t)MB, l3_data_size >> 10);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		stress_prefetch_sweep_round(buf, buf_size, &offset, results[PREFETCH_HWPF_ON]);
+		if (cpu >= 0) {
+			uint64_t msr_off = msr_orig | MSR_HWPF_DISABLE_MASK;
+
+			if (stress_prefetch_msr(cpu, MSR_MISC_FEATURE_CONTROL, &msr_off, true) == 0) {
+				stress_prefetch_sweep_round(buf, buf_size, &offset, results[PREFETCH_HWPF_OFF]);
+				(void)stress_prefetch_msr(cpu, MSR_MISC_FEATURE_CONTROL, &msr_orig, true);
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_prefetch_sweep_report(args, (cpu >= 0) ? "hardware prefetchers on" :
+		"software prefetch sweep", results[PREFETCH_HWPF_ON], best_rates, best_dists);
+	if (cpu >= 0) {
+		double best_rates_off[PREFETCH_SWEEP_STRIDES];
+		size_t best_dists_off[PREFETCH_SWEEP_STRIDES];
+
+		stress_prefetch_sweep_report(args, "hardware prefetchers off",
+			results[PREFETCH_HWPF_OFF], best_rates_off, best_dists_off);
+	}
+
+	for (s = 0; s < PREFETCH_SWEEP_STRIDES; s++) {
+		char desc[64];
+
+		(void)snprintf(desc, sizeof(desc), "stride %zd best GB/s",
+			prefetch_sweep_strides[s]);
+		stress_misc_stats_set(args->misc_stats, (int)s, desc,
+			best_rates[s] / (double)GB);
+		(void)snprintf(desc, sizeof(desc), "stride %zd best distance",
+			prefetch_sweep_strides[s]);
+		stress_misc_stats_set(args->misc_stats, (int)(s + PREFETCH_SWEEP_STRIDES),
+			desc, (double)best_dists[s]);
+	}
+
+	(void)munmap((void *)buf, mmap_size);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_prefetch()
  *	stress cache/memory/CPU with stream stressors
@@ -204,11 +593,16 @@ static int stress_prefetch(const stress_args_t *args)
 	stress_prefetch_info_t prefetch_info[STRESS_PREFETCH_OFFSETS];
 	size_t i, best;
 	double best_rate, ns;
+	bool prefetch_sweep = false;
 
 	(void)stress_get_setting("stream-L3-size", &l3_data_size);
 	if (l3_data_size == 0)
 		l3_data_size = get_prefetch_L3_size(args);
 
+	(void)stress_get_setting("prefetch-sweep", &prefetch_sweep);
+	if (prefetch_sweep)
+		return stress_prefetch_sweep(args, l3_data_size);
+
 	l3_data_mmap_size = l3_data_size + (STRESS_PREFETCH_OFFSETS * STRESS_CACHE_LINE_SIZE);
 
 	l3_data = (uint64_t *)mmap(NULL, l3_data_mmap_size,
@@ -280,8 +674,26 @@ static int stress_prefetch(const stress_args_t *args)
 	return EXIT_SUCCESS;
 }
 
+static int stress_set_prefetch_sweep(const char *opt)
+{
+	bool prefetch_sweep = true;
+
+	(void)opt;
+	return stress_set_setting("prefetch-sweep", TYPE_ID_BOOL, &prefetch_sweep);
+}
+
+static int stress_set_prefetch_hwpf(const char *opt)
+{
+	bool prefetch_hwpf = true;
+
+	(void)opt;
+	return stress_set_setting("prefetch-hwpf", TYPE_ID_BOOL, &prefetch_hwpf);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_prefetch_l3_size,	stress_set_prefetch_L3_size },
+	{ OPT_prefetch_sweep,	stress_set_prefetch_sweep },
+	{ OPT_prefetch_hwpf,	stress_set_prefetch_hwpf },
 	{ 0,			NULL }
 };
 
@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"procread N",		"start N workers measuring /proc and /sys read latency" },
+	{ NULL,	"procread-ops N",	"stop after N scans of the trees" },
+	{ NULL,	"procread-paths list",	"comma separated trees to scan, default /proc,/sys" },
+	{ NULL,	"procread-hot list",	"comma separated hot files read by concurrent readers" },
+	{ NULL,	"procread-threads N",	"maximum number of concurrent readers of a hot file" },
+	{ NULL,	"procread-top N",	"number of slowest files in the heat list" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define MIN_PROCREAD_THREADS		(1)
+#define MAX_PROCREAD_THREADS		(64)
+#define DEFAULT_PROCREAD_THREADS	(8)
+
+#define MIN_PROCREAD_TOP		(1)
+#define MAX_PROCREAD_TOP		(64)
+#define DEFAULT_PROCREAD_TOP		(10)
+
+#define DEFAULT_PROCREAD_PATHS		"/proc,/sys"
+#define DEFAULT_PROCREAD_HOT		"/proc/meminfo,/proc/self/smaps,/proc/stat"
+
+static int stress_set_procread_paths(const char *opt)
+{
+	return stress_set_setting("procread-paths", TYPE_ID_STR, opt);
+}
+
+static int stress_set_procread_hot(const char *opt)
+{
+	return stress_set_setting("procread-hot", TYPE_ID_STR, opt);
+}
+
+static int stress_set_procread_threads(const char *opt)
+{
+	uint32_t procread_threads;
+
+	procread_threads = stress_get_uint32(opt);
+	stress_check_range("procread-threads", (uint64_t)procread_threads,
+		MIN_PROCREAD_THREADS, MAX_PROCREAD_THREADS);
+	return stress_set_setting("procread-threads", TYPE_ID_UINT32, &procread_threads);
+}
+
+static int stress_set_procread_top(const char *opt)
+{
+	uint32_t procread_top;
+
+	procread_top = stress_get_uint32(opt);
+	stress_check_range("procread-top", (uint64_t)procread_top,
+		MIN_PROCREAD_TOP, MAX_PROCREAD_TOP);
+	return stress_set_setting("procread-top", TYPE_ID_UINT32, &procread_top);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_procread_paths,	stress_set_procread_paths },
+	{ OPT_procread_hot,	stress_set_procread_hot },
+	{ OPT_procread_threads,	stress_set_procread_threads },
+	{ OPT_procread_top,	stress_set_procread_top },
+	{ 0,			NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(__linux__)
+
+#define PROCREAD_BUF_SZ		(4096)
+#define PROCREAD_MAX_READ	(1 * MB)	/* cap on bytes read from one file */
+#define PROCREAD_MAX_DEPTH	(10)
+#define PROCREAD_MAX_HOT	(8)
+#define PROCREAD_WINDOW		(0.25)		/* seconds per concurrency level */
+#define PROCREAD_MAX_LEVELS	(8)		/* 1, 2, 4 .. 64 readers */
+
+typedef struct {
+	char path[PATH_MAX];
+	double max;			/* slowest read, seconds */
+	double total;			/* sum of read times, seconds */
+	uint64_t count;			/* reads */
+} stress_procread_heat_t;
+
+typedef struct {
+	stress_procread_heat_t *heat;	/* slowest files seen */
+	uint32_t top;			/* heat list length */
+	uint64_t files;			/* files read in the scans */
+	uint64_t bytes;			/* bytes read in the scans */
+	double time;			/* seconds spent reading files */
+} stress_procread_scan_t;
+
+typedef struct {
+	uint64_t reads;			/* reads at this concurrency level */
+	double time;			/* sum of read latencies, seconds */
+	double wall;			/* measurement window, seconds */
+} stress_procread_level_t;
+
+typedef struct {
+	pthread_t pthread;
+	const char *path;
+	uint64_t reads;
+	double time;
+	int ret;
+} stress_procread_reader_t;
+
+static sigset_t set;
+static volatile bool readers_run;
+
+/*
+ *  stress_procread_file()
+ *	time open, read to the end and close of a file, returns
+ *	the latency in seconds or a negative value if it cannot
+ *	be opened
+ */
+static double stress_procread_file(const char *path, uint64_t *bytes)
+{
+	char buf[PROCREAD_BUF_SZ];
+	double t;
+	size_t total = 0;
+	int fd;
+
+	t = stress_time_now();
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0)
+		return -1.0;
+	while (total < PROCREAD_MAX_READ) {
+		const ssize_t ret = read(fd, buf, sizeof(buf));
+
+		if (ret <= 0)
+			break;
+		total += (size_t)ret;
+	}
+	(void)close(fd);
+	t = stress_time_now() - t;
+	if (bytes)
+		*bytes += (uint64_t)total;
+	return t;
+}
+
+/*
+ *  stress_procread_heat()
+ *	account a read latency in the heat list, the list keeps the
+ *	files with the slowest single read
+ */
+static void stress_procread_heat(stress_procread_scan_t *scan, const char *path, const double t)
+{
+	stress_procread_heat_t *min = &scan->heat[0];
+	uint32_t i;
+
+	for (i = 0; i < scan->top; i++) {
+		stress_procread_heat_t *h = &scan->heat[i];
+
+		if (!strcmp(h->path, path)) {
+			if (t > h->max)
+				h->max = t;
+			h->total += t;
+			h->count++;
+			return;
+		}
+		/* an unused slot has a zero max, so it is the minimum */
+		if (h->max < min->max)
+			min = h;
+	}
+	if ((min->count == 0) || (t > min->max)) {
+		(void)shim_strlcpy(min->path, path, sizeof(min->path));
+		min->max = t;
+		min->total = t;
+		min->count = 1;
+	}
+}
+
+/*
+ *  stress_procread_prune()
+ *	skip the per process directories in /proc, descending each of
+ *	them is a scan of the process table, and /proc/kmsg as reading
+ *	it consumes the kernel log
+ */
+static bool stress_procread_prune(const char *path, const char *name)
+{
+	if (strcmp(path, "/proc"))
+		return false;
+	return isdigit((int)name[0]) || !strcmp(name, "kmsg");
+}
+
+/*
+ *  stress_procread_dir()
+ *	read all the files in a tree, symlinks are not followed
+ *	so the /sys class and bus views are not walked twice
+ */
+static void stress_procread_dir(
+	const stress_args_t *args,
+	stress_procread_scan_t *scan,
+	const char *path,
+	const int depth)
+{
+	struct dirent **dlist = NULL;
+	char tmp[PATH_MAX];
+	int i, n;
+
+	if (!keep_stressing(args) || (depth > PROCREAD_MAX_DEPTH))
+		return;
+
+	n = scandir(path, &dlist, NULL, alphasort);
+	if (n <= 0) {
+		stress_dirent_list_free(dlist, n);
+		return;
+	}
+	for (i = 0; (i < n) && keep_stressing(args); i++) {
+		const struct dirent *d = dlist[i];
+
+		if (stress_is_dot_filename(d->d_name) ||
+		    stress_procread_prune(path, d->d_name))
+			continue;
+		(void)stress_mk_filename(tmp, sizeof(tmp), path, d->d_name);
+		if (d->d_type == DT_REG) {
+			const double t = stress_procread_file(tmp, &scan->bytes);
+
+			if (t >= 0.0) {
+				scan->files++;
+				scan->time += t;
+				stress_procread_heat(scan, tmp, t);
+			}
+		} else if (d->d_type == DT_DIR) {
+			stress_procread_dir(args, scan, tmp, depth + 1);
+		}
+	}
+	stress_dirent_list_free(dlist, n);
+}
+
+/*
+ *  stress_procread_reader()
+ *	read a hot file over and over until told to stop
+ */
+static void *stress_procread_reader(void *ptr)
+{
+	static void *nowt = NULL;
+	stress_procread_reader_t *reader = (stress_procread_reader_t *)ptr;
+
+	/* Let the controlling thread handle the signals */
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (readers_run) {
+		const double t = stress_procread_file(reader->path, NULL);
+
+		if (t < 0.0)
+			break;
+		reader->reads++;
+		reader->time += t;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_procread_level()
+ *	run n concurrent readers of a hot file for a fixed window
+ */
+static int stress_procread_level(
+	const stress_args_t *args,
+	stress_procread_reader_t *readers,
+	const uint32_t n,
+	const char *path,
+	stress_procread_level_t *level)
+{
+	double t;
+	uint32_t i;
+
+	readers_run = true;
+	for (i = 0; i < n; i++) {
+		readers[i].path = path;
+		readers[i].reads = 0;
+		readers[i].time = 0.0;
+		readers[i].ret = pthread_create(&readers[i].pthread, NULL,
+			stress_procread_reader, &readers[i]);
+		if (readers[i].ret) {
+			pr_inf("%s: pthread_create failed, errno=%d (%s)\n",
+				args->name, readers[i].ret, strerror(readers[i].ret));
+			break;
+		}
+	}
+	t = stress_time_now();
+	if (i == n)
+		(void)shim_usleep((uint64_t)(PROCREAD_WINDOW * 1000000.0));
+	readers_run = false;
+
+	for (i = 0; i < n; i++) {
+		if (readers[i].ret)
+			break;
+		(void)pthread_join(readers[i].pthread, NULL);
+		level->reads += readers[i].reads;
+		level->time += readers[i].time;
+	}
+	level->wall += stress_time_now() - t;
+	return (i == n) ? 0 : -1;
+}
+
+/*
+ *  stress_procread_report()
+ *	dump the scan summary, heat list and hot file scalability
+ */
+static void stress_procread_report(
+	const stress_args_t *args,
+	const stress_procread_scan_t *scan,
+	const uint64_t scans,
+	char hot[PROCREAD_MAX_HOT][PATH_MAX],
+	const int n_hot,
+	stress_procread_level_t levels[PROCREAD_MAX_HOT][PROCREAD_MAX_LEVELS],
+	const int n_levels)
+{
+	bool lock = false;
+	uint32_t i;
+	int h, l;
+	double slowest = 0.0;
+
+	pr_lock(&lock);
+	if (scan->files) {
+		pr_inf_lock(&lock, "%s: %" PRIu64 " scans, %" PRIu64 " files read, "
+			"%.2f files per scan, mean read latency %.2f usecs\n",
+			args->name, scans, scan->files,
+			scans ? (double)scan->files / (double)scans : 0.0,
+			(scan->time * 1000000.0) / (double)scan->files);
+		pr_inf_lock(&lock, "%s: slowest files, by slowest single open, read and close:\n",
+			args->name);
+		pr_inf_lock(&lock, "%s: %10s %10s %8s  %s\n", args->name,
+			"max usecs", "mean usecs", "reads", "file");
+	}
+	/* heat list is unordered, print it slowest first */
+	for (i = 0; i < scan->top; i++) {
+		const stress_procread_heat_t *max = NULL;
+		uint32_t j;
+
+		for (j = 0; j < scan->top; j++) {
+			const stress_procread_heat_t *hp = &scan->heat[j];
+
+			if (!*hp->path || (hp->count == 0))
+				continue;
+			if (!max || (hp->max > max->max))
+				max = hp;
+		}
+		if (!max)
+			break;
+		if (i == 0)
+			slowest = max->max;
+		pr_inf_lock(&lock, "%s: %10.2f %10.2f %8" PRIu64 "  %s\n", args->name,
+			max->max * 1000000.0, (max->total * 1000000.0) / (double)max->count,
+			max->count, max->path);
+		/* mark it as printed */
+		((stress_procread_heat_t *)max)->count = 0;
+	}
+
+	for (h = 0; h < n_hot; h++) {
+		double rate1 = 0.0;
+
+		if (!levels[h][0].reads)
+			continue;
+		pr_inf_lock(&lock, "%s: concurrent readers of %s:\n", args->name, hot[h]);
+		pr_inf_lock(&lock, "%s: %8s %12s %10s %10s\n", args->name,
+			"readers", "reads/sec", "mean usecs", "efficiency");
+		for (l = 0; l < n_levels; l++) {
+			const stress_procread_level_t *lp = &levels[h][l];
+			const double rate = (lp->wall > 0.0) ? (double)lp->reads / lp->wall : 0.0;
+			const uint32_t readers = 1U << l;
+
+			if (!lp->reads)
+				continue;
+			if (l == 0)
+				rate1 = rate;
+			pr_inf_lock(&lock, "%s: %8" PRIu32 " %12.0f %10.2f %9.1f%%\n", args->name,
+				readers, rate, (lp->time * 1000000.0) / (double)lp->reads,
+				(rate1 > 0.0) ? 100.0 * rate / (rate1 * (double)readers) : 0.0);
+		}
+	}
+	pr_unlock(&lock);
+
+	stress_misc_stats_set(args->misc_stats, 0, "files read per scan",
+		scans ? (double)scan->files / (double)scans : 0.0);
+	stress_misc_stats_set(args->misc_stats, 1, "mean read latency usecs",
+		scan->files ? (scan->time * 1000000.0) / (double)scan->files : 0.0);
+	stress_misc_stats_set(args->misc_stats, 2, "slowest read latency usecs",
+		slowest * 1000000.0);
+}
+
+/*
+ *  stress_procread_list()
+ *	split a comma separated list of paths, returns the count
+ */
+static int stress_procread_list(const char *opt, char paths[PROCREAD_MAX_HOT][PATH_MAX])
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return 0;
+	for (token = strtok_r(str, ",", &save); token && (n < PROCREAD_MAX_HOT);
+	     token = strtok_r(NULL, ",", &save)) {
+		/* /proc/self in a reader thread is this process */
+		if (!strncmp(token, "/proc/self/", 11))
+			(void)snprintf(paths[n++], PATH_MAX, "/proc/%d/%s", (int)getpid(), token + 11);
+		else
+			(void)shim_strlcpy(paths[n++], token, PATH_MAX);
+	}
+	free(str);
+	return n;
+}
+
+/*
+ *  stress_procread
+ *	measure read latency of every file in /proc and /sys and
+ *	the scalability of concurrent readers of hot files
+ */
+static int stress_procread(const stress_args_t *args)
+{
+	static char roots[PROCREAD_MAX_HOT][PATH_MAX], hot[PROCREAD_MAX_HOT][PATH_MAX];
+	static stress_procread_level_t levels[PROCREAD_MAX_HOT][PROCREAD_MAX_LEVELS];
+	char *paths_opt = DEFAULT_PROCREAD_PATHS, *hot_opt = DEFAULT_PROCREAD_HOT;
+	uint32_t procread_threads = DEFAULT_PROCREAD_THREADS;
+	uint32_t procread_top = DEFAULT_PROCREAD_TOP;
+	stress_procread_reader_t *readers;
+	stress_procread_scan_t scan;
+	uint64_t scans = 0;
+	int i, n_roots, n_hot, n_levels = 0, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("procread-paths", &paths_opt);
+	(void)stress_get_setting("procread-hot", &hot_opt);
+	(void)stress_get_setting("procread-threads", &procread_threads);
+	(void)stress_get_setting("procread-top", &procread_top);
+
+	while ((n_levels < PROCREAD_MAX_LEVELS) && ((1U << n_levels) <= procread_threads))
+		n_levels++;
+
+	n_roots = stress_procread_list(paths_opt, roots);
+	n_hot = stress_procread_list(hot_opt, hot);
+	if ((n_roots == 0) && (n_hot == 0)) {
+		pr_inf_skip("%s: no trees or hot files to read, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(&scan, 0, sizeof(scan));
+	(void)memset(levels, 0, sizeof(levels));
+	scan.top = procread_top;
+	scan.heat = calloc((size_t)procread_top, sizeof(*scan.heat));
+	if (!scan.heat) {
+		pr_inf_skip("%s: cannot allocate heat list, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	readers = calloc((size_t)(1U << (n_levels - 1)), sizeof(*readers));
+	if (!readers) {
+		pr_inf_skip("%s: cannot allocate reader threads, skipping stressor\n",
+			args->name);
+		free(scan.heat);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)sigfillset(&set);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		int h, l;
+
+		for (i = 0; (i < n_roots) && keep_stressing(args); i++)
+			stress_procread_dir(args, &scan, roots[i], 0);
+		if (!keep_stressing(args))
+			break;
+		scans++;
+
+		for (h = 0; (h < n_hot) && keep_stressing(args); h++) {
+			for (l = 0; (l < n_levels) && keep_stressing(args); l++) {
+				if (stress_procread_level(args, readers, 1U << l, hot[h], &levels[h][l]) < 0) {
+					rc = EXIT_NO_RESOURCE;
+					goto done;
+				}
+			}
+		}
+		inc_counter(args);
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_procread_report(args, &scan, scans, hot, n_hot, levels, n_levels);
+
+	free(readers);
+	free(scan.heat);
+
+	return rc;
+}
+
+stressor_info_t stress_procread_info = {
+	.stressor = stress_procread,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_procread_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_FILESYSTEM | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
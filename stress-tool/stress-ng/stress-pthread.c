@@ -28,6 +28,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"pthread N",	 "start N workers that create multiple threads" },
 	{ NULL,	"pthread-ops N", "stop pthread workers after N bogo threads created" },
 	{ NULL,	"pthread-max P", "create P threads at a time by each worker" },
+	{ NULL,	"pthread-method M", "churn, or measure create, futex, eventfd, spin or bench latency" },
+	{ NULL,	"pthread-pool N", "use N thread pool workers in the dispatch methods" },
 	{ NULL,	NULL,		 NULL }
 };
 
@@ -62,8 +64,56 @@ static int stress_set_pthread_max(const char *opt)
 	return stress_set_setting("pthread-max", TYPE_ID_UINT64, &pthread_max);
 }
 
+#define PTHREAD_METHOD_CHURN	(0)	/* create and churn pthread-max threads */
+#define PTHREAD_METHOD_CREATE	(1)	/* create/join latency vs stack size */
+#define PTHREAD_METHOD_FUTEX	(2)	/* dispatch latency of a futex pool */
+#define PTHREAD_METHOD_EVENTFD	(3)	/* dispatch latency of an eventfd pool */
+#define PTHREAD_METHOD_SPIN	(4)	/* dispatch latency, spin then futex park */
+#define PTHREAD_METHOD_BENCH	(5)	/* create, futex, eventfd and spin */
+
+/* indexed by PTHREAD_METHOD_* */
+static const char * const pthread_methods[] = {
+	"churn",
+	"create",
+	"futex",
+	"eventfd",
+	"spin",
+	"bench",
+};
+
+#define MIN_PTHREAD_POOL	(1)
+#define MAX_PTHREAD_POOL	(1024)
+#define DEFAULT_PTHREAD_POOL	(4)
+
+static int stress_set_pthread_method(const char *opt)
+{
+	int pthread_method;
+
+	for (pthread_method = 0; pthread_method < (int)SIZEOF_ARRAY(pthread_methods); pthread_method++) {
+		if (!strcmp(opt, pthread_methods[pthread_method]))
+			return stress_set_setting("pthread-method", TYPE_ID_INT, &pthread_method);
+	}
+	(void)fprintf(stderr, "pthread-method must be one of:");
+	for (pthread_method = 0; pthread_method < (int)SIZEOF_ARRAY(pthread_methods); pthread_method++)
+		(void)fprintf(stderr, " %s", pthread_methods[pthread_method]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_pthread_pool(const char *opt)
+{
+	size_t pthread_pool;
+
+	pthread_pool = (size_t)stress_get_uint64(opt);
+	stress_check_range("pthread-pool", (uint64_t)pthread_pool,
+		MIN_PTHREAD_POOL, MAX_PTHREAD_POOL);
+	return stress_set_setting("pthread-pool", TYPE_ID_SIZE_T, &pthread_pool);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_pthread_max,	stress_set_pthread_max },
+	{ OPT_pthread_method,	stress_set_pthread_method },
+	{ OPT_pthread_pool,	stress_set_pthread_pool },
 	{ 0,			NULL }
 };
 
@@ -386,6 +436,569 @@ die:
 	return &nowt;
 }
 
+#if defined(HAVE_LINUX_FUTEX_H) &&	\
+    defined(__NR_futex) &&		\
+    defined(FUTEX_WAIT) &&		\
+    defined(FUTEX_WAKE)
+#define STRESS_PTHREAD_FUTEX
+#endif
+
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD)
+#define STRESS_PTHREAD_EVENTFD
+#endif
+
+#define PTHREAD_SLICE		(0.5)	/* seconds per measurement */
+#define PTHREAD_SPIN_NS		(20000)	/* spin before parking */
+#define PTHREAD_LAT_SUB		(4)	/* histogram buckets per power of 2 */
+#define PTHREAD_LAT_BUCKETS	(64 * PTHREAD_LAT_SUB)
+
+/* stack sizes of the create method, 0 is the minimum stack */
+static const size_t pthread_stack_sizes[] = {
+	0,
+	64 * KB,
+	256 * KB,
+	1 * MB,
+	8 * MB,
+};
+
+typedef struct {
+	uint64_t count;
+	uint64_t max;
+	uint64_t lat[PTHREAD_LAT_BUCKETS];
+} stress_pthread_lat_t;
+
+/* a pool worker and its one task mailbox */
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	int method;		/* PTHREAD_METHOD_* */
+	int efd;		/* eventfd method */
+	uint32_t seq;		/* tasks posted, the futex word */
+	uint32_t parked;	/* worker is about to wait on seq */
+	uint32_t done;		/* tasks completed */
+	uint64_t ts;		/* post time of the current task */
+	volatile bool *stop;
+	stress_pthread_lat_t lat;
+} ALIGN64 stress_pthread_worker_t;
+
+/* thread of the create method */
+typedef struct {
+	uint64_t ts;		/* time the thread started running */
+} stress_pthread_create_t;
+
+/*
+ *  stress_pthread_now_ns()
+ *	monotonic time in nanoseconds
+ */
+static inline uint64_t stress_pthread_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_pthread_lat_add()
+ *	add a latency in nanoseconds to a log2 histogram with
+ *	PTHREAD_LAT_SUB buckets per power of 2
+ */
+static void stress_pthread_lat_add(stress_pthread_lat_t *lat, const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0, bucket;
+
+	if (ns < PTHREAD_LAT_SUB) {
+		bucket = (size_t)ns;
+	} else {
+		for (v = ns; v > 1; v >>= 1)
+			msb++;
+		bucket = ((msb - 1) * PTHREAD_LAT_SUB) +
+			(size_t)((ns >> (msb - 2)) & (PTHREAD_LAT_SUB - 1));
+	}
+	lat->lat[bucket]++;
+	lat->count++;
+	if (ns > lat->max)
+		lat->max = ns;
+}
+
+/*
+ *  stress_pthread_lat_merge()
+ *	add histogram from to histogram to
+ */
+static void stress_pthread_lat_merge(stress_pthread_lat_t *to, const stress_pthread_lat_t *from)
+{
+	size_t i;
+
+	for (i = 0; i < PTHREAD_LAT_BUCKETS; i++)
+		to->lat[i] += from->lat[i];
+	to->count += from->count;
+	if (from->max > to->max)
+		to->max = from->max;
+}
+
+/*
+ *  stress_pthread_percentile()
+ *	latency in microseconds below which pct percent of the samples are,
+ *	the upper bound of the histogram bucket
+ */
+static double stress_pthread_percentile(const stress_pthread_lat_t *lat, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)lat->count * pct) / 100.0);
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < PTHREAD_LAT_BUCKETS; i++) {
+		sum += lat->lat[i];
+		if (sum > target) {
+			const size_t msb = (i / PTHREAD_LAT_SUB) + 1;
+			const uint64_t sub = (uint64_t)(i % PTHREAD_LAT_SUB);
+
+			if (i < PTHREAD_LAT_SUB)
+				return (double)i / 1000.0;
+			return (double)(((PTHREAD_LAT_SUB + sub + 1) << (msb - 2)) - 1) / 1000.0;
+		}
+	}
+	return 0.0;
+}
+
+/*
+ *  stress_pthread_create_func()
+ *	create method thread, just note when it started
+ */
+static void *stress_pthread_create_func(void *arg)
+{
+	static void *nowt = NULL;
+	stress_pthread_create_t *info = (stress_pthread_create_t *)arg;
+
+	info->ts = stress_pthread_now_ns();
+	return &nowt;
+}
+
+/*
+ *  stress_pthread_create_bench()
+ *	create and join one thread at a time with the given stack size for
+ *	PTHREAD_SLICE seconds, sampling the start latency, from the create
+ *	call to the thread running, and the create to join latency
+ */
+static int stress_pthread_create_bench(
+	const stress_args_t *args,
+	const size_t stack_size,
+	stress_pthread_lat_t *start,
+	stress_pthread_lat_t *total)
+{
+	pthread_attr_t attr;
+	double t_end;
+	int ret;
+
+	ret = pthread_attr_init(&attr);
+	if (ret) {
+		pr_fail("%s: pthread_attr_init failed, errno=%d (%s)\n",
+			args->name, ret, strerror(ret));
+		return EXIT_FAILURE;
+	}
+	ret = pthread_attr_setstacksize(&attr, stack_size);
+	if (ret) {
+		pr_fail("%s: pthread_attr_setstacksize %zu failed, errno=%d (%s)\n",
+			args->name, stack_size, ret, strerror(ret));
+		(void)pthread_attr_destroy(&attr);
+		return EXIT_FAILURE;
+	}
+
+	t_end = stress_time_now() + PTHREAD_SLICE;
+	while (keep_running() && keep_stressing(args) && (stress_time_now() < t_end)) {
+		stress_pthread_create_t info;
+		pthread_t pthread;
+		uint64_t t0;
+
+		info.ts = 0;
+		t0 = stress_pthread_now_ns();
+		ret = pthread_create(&pthread, &attr, stress_pthread_create_func, &info);
+		if (ret) {
+			if (ret == EAGAIN) {
+				(void)shim_usleep(1000);
+				continue;
+			}
+			pr_fail("%s: pthread_create failed, errno=%d (%s)\n",
+				args->name, ret, strerror(ret));
+			(void)pthread_attr_destroy(&attr);
+			return EXIT_FAILURE;
+		}
+		ret = pthread_join(pthread, NULL);
+		if (ret) {
+			pr_fail("%s: pthread_join failed, errno=%d (%s)\n",
+				args->name, ret, strerror(ret));
+			(void)pthread_attr_destroy(&attr);
+			return EXIT_FAILURE;
+		}
+		stress_pthread_lat_add(total, stress_pthread_now_ns() - t0);
+		stress_pthread_lat_add(start, info.ts - t0);
+		inc_counter(args);
+	}
+	(void)pthread_attr_destroy(&attr);
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_pthread_task()
+ *	a small task run by a pool worker
+ */
+static inline void stress_pthread_task(void)
+{
+	register int i;
+
+	for (i = 0; i < 64; i++)
+		shim_mb();
+}
+
+/*
+ *  stress_pthread_park()
+ *	wait for a task past seen to be posted
+ */
+static void stress_pthread_park(stress_pthread_worker_t *worker, const uint32_t seen)
+{
+	if (worker->method == PTHREAD_METHOD_SPIN) {
+		const uint64_t t_end = stress_pthread_now_ns() + PTHREAD_SPIN_NS;
+
+		do {
+			if (__atomic_load_n(&worker->seq, __ATOMIC_ACQUIRE) != seen)
+				return;
+			shim_mb();
+		} while (stress_pthread_now_ns() < t_end);
+	}
+#if defined(STRESS_PTHREAD_EVENTFD)
+	if (worker->method == PTHREAD_METHOD_EVENTFD) {
+		uint64_t val;
+
+		while ((__atomic_load_n(&worker->seq, __ATOMIC_ACQUIRE) == seen) &&
+		       !*worker->stop) {
+			if ((read(worker->efd, &val, sizeof(val)) < 0) && (errno != EINTR))
+				return;
+		}
+		return;
+	}
+#endif
+#if defined(STRESS_PTHREAD_FUTEX)
+	/* Announce the wait before the final check so a post can't be missed */
+	__atomic_store_n(&worker->parked, 1, __ATOMIC_SEQ_CST);
+	while ((__atomic_load_n(&worker->seq, __ATOMIC_SEQ_CST) == seen) && !*worker->stop)
+		(void)shim_futex_wait(&worker->seq, (int)seen, NULL);
+	__atomic_store_n(&worker->parked, 0, __ATOMIC_RELAXED);
+#endif
+}
+
+/*
+ *  stress_pthread_wake()
+ *	wake worker for a posted task
+ */
+static void stress_pthread_wake(stress_pthread_worker_t *worker)
+{
+#if defined(STRESS_PTHREAD_EVENTFD)
+	if (worker->method == PTHREAD_METHOD_EVENTFD) {
+		const uint64_t val = 1;
+
+		(void)write(worker->efd, &val, sizeof(val));
+		return;
+	}
+#endif
+#if defined(STRESS_PTHREAD_FUTEX)
+	if (__atomic_load_n(&worker->parked, __ATOMIC_SEQ_CST))
+		(void)shim_futex_wake(&worker->seq, 1);
+#endif
+}
+
+/*
+ *  stress_pthread_worker()
+ *	pool worker, run the posted tasks until told to stop, sampling the
+ *	latency from the post to the task starting
+ */
+static void *stress_pthread_worker(void *arg)
+{
+	static void *nowt = NULL;
+	stress_pthread_worker_t *worker = (stress_pthread_worker_t *)arg;
+	uint32_t seen = 0;
+
+	while (!*worker->stop) {
+		const uint32_t seq = __atomic_load_n(&worker->seq, __ATOMIC_ACQUIRE);
+
+		if (seq == seen) {
+			stress_pthread_park(worker, seen);
+			continue;
+		}
+		if (*worker->stop)
+			break;
+		stress_pthread_lat_add(&worker->lat, stress_pthread_now_ns() - worker->ts);
+		stress_pthread_task();
+		seen = seq;
+		__atomic_store_n(&worker->done, seq, __ATOMIC_RELEASE);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_pthread_pool_bench()
+ *	post tasks round robin to the idle workers of a pool of
+ *	pthread_pool threads for PTHREAD_SLICE seconds, a worker
+ *	normally waits with the method's mechanism for each task
+ */
+static int stress_pthread_pool_bench(
+	const stress_args_t *args,
+	const int method,
+	const size_t pthread_pool,
+	stress_pthread_lat_t *lat)
+{
+	stress_pthread_worker_t *workers;
+	volatile bool stop = false;
+	int rc = EXIT_SUCCESS;
+	size_t i, n = 0;
+	double t_end;
+
+	workers = (stress_pthread_worker_t *)calloc(pthread_pool, sizeof(*workers));
+	if (!workers) {
+		pr_inf("%s: out of memory allocating %zu pool workers\n",
+			args->name, pthread_pool);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < pthread_pool; i++) {
+		workers[i].ret = -1;
+		workers[i].efd = -1;
+	}
+
+	for (i = 0; i < pthread_pool; i++) {
+		stress_pthread_worker_t *worker = &workers[i];
+
+		worker->method = method;
+		worker->stop = &stop;
+#if defined(STRESS_PTHREAD_EVENTFD)
+		if (method == PTHREAD_METHOD_EVENTFD) {
+			worker->efd = eventfd(0, 0);
+			if (worker->efd < 0) {
+				pr_inf("%s: eventfd failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_NO_RESOURCE;
+				goto stop;
+			}
+		}
+#endif
+		worker->ret = pthread_create(&worker->pthread, NULL,
+			stress_pthread_worker, worker);
+		if (worker->ret) {
+			if (worker->ret == EAGAIN) {
+				rc = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail("%s: pthread_create failed, errno=%d (%s)\n",
+					args->name, worker->ret, strerror(worker->ret));
+				rc = EXIT_FAILURE;
+			}
+			goto stop;
+		}
+	}
+
+	t_end = stress_time_now() + PTHREAD_SLICE;
+	while (keep_running() && keep_stressing(args)) {
+		stress_pthread_worker_t *worker = &workers[n % pthread_pool];
+		const uint32_t seq = worker->seq;
+
+		/* Wait for the worker to finish its previous task */
+		while (__atomic_load_n(&worker->done, __ATOMIC_ACQUIRE) != seq) {
+			if (!keep_running())
+				goto stop;
+			(void)shim_sched_yield();
+		}
+		if ((n % pthread_pool == 0) && (stress_time_now() >= t_end))
+			break;
+
+		worker->ts = stress_pthread_now_ns();
+		__atomic_store_n(&worker->seq, seq + 1, __ATOMIC_SEQ_CST);
+		stress_pthread_wake(worker);
+		n++;
+		inc_counter(args);
+	}
+
+stop:
+	stop = true;
+	for (i = 0; i < pthread_pool; i++) {
+		stress_pthread_worker_t *worker = &workers[i];
+
+		if (worker->ret == 0) {
+			/* Bump seq so parked workers see a change and notice stop */
+			__atomic_add_fetch(&worker->seq, 0x80000000, __ATOMIC_SEQ_CST);
+			stress_pthread_wake(worker);
+#if defined(STRESS_PTHREAD_FUTEX)
+			(void)shim_futex_wake(&worker->seq, 1);
+#endif
+			(void)pthread_join(worker->pthread, NULL);
+			stress_pthread_lat_merge(lat, &worker->lat);
+		}
+		if (worker->efd >= 0)
+			(void)close(worker->efd);
+	}
+	free(workers);
+	return rc;
+}
+
+/*
+ *  stress_pthread_lat_row()
+ *	report the latency percentiles of one histogram
+ */
+static void stress_pthread_lat_row(
+	const stress_args_t *args,
+	bool *lock,
+	const char *desc,
+	const stress_pthread_lat_t *lat)
+{
+	pr_inf_lock(lock, "%s: %-26s %10" PRIu64 " %10.1f %10.1f %10.1f\n",
+		args->name, desc, lat->count,
+		stress_pthread_percentile(lat, 50.0),
+		stress_pthread_percentile(lat, 99.0),
+		(double)lat->max / 1000.0);
+}
+
+/*
+ *  stress_pthread_bench_report()
+ *	report the latency percentiles of each method and stack size
+ */
+static void stress_pthread_bench_report(
+	const stress_args_t *args,
+	const stress_pthread_lat_t *start,
+	const stress_pthread_lat_t *total,
+	const stress_pthread_lat_t *dispatch,
+	const size_t stack_min,
+	const size_t pthread_pool)
+{
+	bool lock = false;
+	size_t i;
+	int m, idx = 0;
+	char desc[64];
+
+	if (args->instance != 0)
+		goto stats;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %-26s %10s %10s %10s %10s\n", args->name,
+		"latency (usec)", "samples", "p50", "p99", "max");
+	for (i = 0; i < SIZEOF_ARRAY(pthread_stack_sizes); i++) {
+		const size_t size = pthread_stack_sizes[i] ? pthread_stack_sizes[i] : stack_min;
+
+		if (!total[i].count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "start, %zuK stack", (size_t)(size / KB));
+		stress_pthread_lat_row(args, &lock, desc, &start[i]);
+		(void)snprintf(desc, sizeof(desc), "create+join, %zuK stack", (size_t)(size / KB));
+		stress_pthread_lat_row(args, &lock, desc, &total[i]);
+	}
+	for (m = PTHREAD_METHOD_FUTEX; m <= PTHREAD_METHOD_SPIN; m++) {
+		const stress_pthread_lat_t *lat = &dispatch[m - PTHREAD_METHOD_FUTEX];
+
+		if (!lat->count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s dispatch, %zu threads",
+			pthread_methods[m], pthread_pool);
+		stress_pthread_lat_row(args, &lock, desc, lat);
+	}
+	pr_unlock(&lock);
+
+stats:
+	for (i = 0; i < SIZEOF_ARRAY(pthread_stack_sizes); i += SIZEOF_ARRAY(pthread_stack_sizes) - 1) {
+		const size_t size = pthread_stack_sizes[i] ? pthread_stack_sizes[i] : stack_min;
+
+		if (!total[i].count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "create+join p50 usec, %zuK stk", (size_t)(size / KB));
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_pthread_percentile(&total[i], 50.0));
+	}
+	for (m = PTHREAD_METHOD_FUTEX; m <= PTHREAD_METHOD_SPIN; m++) {
+		const stress_pthread_lat_t *lat = &dispatch[m - PTHREAD_METHOD_FUTEX];
+
+		if (!lat->count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s dispatch p50 usec", pthread_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_pthread_percentile(lat, 50.0));
+		(void)snprintf(desc, sizeof(desc), "%s dispatch p99 usec", pthread_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_pthread_percentile(lat, 99.0));
+	}
+}
+
+/*
+ *  stress_pthread_bench()
+ *	latency measurement methods, rotating through the selected ones
+ *	one PTHREAD_SLICE at a time
+ */
+static int stress_pthread_bench(const stress_args_t *args, const int pthread_method)
+{
+	stress_pthread_lat_t *start, *total, *dispatch;
+	const size_t n_sizes = SIZEOF_ARRAY(pthread_stack_sizes);
+	const size_t stack_min = STRESS_MAXIMUM(DEFAULT_STACK_MIN, stress_min_pthread_stack_size());
+	size_t pthread_pool = DEFAULT_PTHREAD_POOL;
+	bool unsupported[PTHREAD_METHOD_SPIN + 1];
+	int rc = EXIT_SUCCESS, m;
+
+	(void)stress_get_setting("pthread-pool", &pthread_pool);
+
+	(void)memset(unsupported, 0, sizeof(unsupported));
+#if !defined(STRESS_PTHREAD_FUTEX)
+	unsupported[PTHREAD_METHOD_FUTEX] = true;
+	unsupported[PTHREAD_METHOD_SPIN] = true;
+#endif
+#if !defined(STRESS_PTHREAD_EVENTFD)
+	unsupported[PTHREAD_METHOD_EVENTFD] = true;
+#endif
+	if ((pthread_method != PTHREAD_METHOD_BENCH) && unsupported[pthread_method]) {
+		if (args->instance == 0)
+			pr_inf("%s: method %s is not supported, skipping stressor\n",
+				args->name, pthread_methods[pthread_method]);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	start = (stress_pthread_lat_t *)calloc(n_sizes, sizeof(*start));
+	total = (stress_pthread_lat_t *)calloc(n_sizes, sizeof(*total));
+	dispatch = (stress_pthread_lat_t *)calloc(3, sizeof(*dispatch));
+	if (!start || !total || !dispatch) {
+		pr_inf("%s: out of memory allocating histograms, skipping stressor\n",
+			args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_lat;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (m = PTHREAD_METHOD_CREATE; m <= PTHREAD_METHOD_SPIN; m++) {
+			if (((pthread_method != PTHREAD_METHOD_BENCH) && (pthread_method != m)) ||
+			    unsupported[m])
+				continue;
+			if (m == PTHREAD_METHOD_CREATE) {
+				size_t i;
+
+				for (i = 0; (rc == EXIT_SUCCESS) && (i < n_sizes); i++) {
+					rc = stress_pthread_create_bench(args,
+						pthread_stack_sizes[i] ? pthread_stack_sizes[i] : stack_min,
+						&start[i], &total[i]);
+				}
+			} else {
+				rc = stress_pthread_pool_bench(args, m, pthread_pool,
+					&dispatch[m - PTHREAD_METHOD_FUTEX]);
+			}
+			if (rc != EXIT_SUCCESS)
+				goto report;
+			if (!(keep_running() && keep_stressing(args)))
+				break;
+		}
+	} while (keep_running() && keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_pthread_bench_report(args, start, total, dispatch, stack_min, pthread_pool);
+free_lat:
+	free(dispatch);
+	free(total);
+	free(start);
+	return rc;
+}
+
 /*
  *  stress_pthread()
  *	stress by creating pthreads
@@ -395,7 +1008,7 @@ static int stress_pthread(const stress_args_t *args)
 	bool locked = false;
 	uint64_t limited = 0, attempted = 0, maximum = 0;
 	uint64_t pthread_max = DEFAULT_PTHREAD;
-	int ret;
+	int ret, pthread_method = PTHREAD_METHOD_CHURN;
 	stress_pthread_args_t pargs = { args, NULL, 0 };
 	sigset_t set;
 #if defined(HAVE_PTHREAD_ATTR_SETSTACK)
@@ -421,6 +1034,10 @@ static int stress_pthread(const stress_args_t *args)
 	sigaddset(&set, SIGALRM);
 	sigprocmask(SIG_BLOCK, &set, NULL);
 
+	(void)stress_get_setting("pthread-method", &pthread_method);
+	if (pthread_method != PTHREAD_METHOD_CHURN)
+		return stress_pthread_bench(args, pthread_method);
+
 	if (!stress_get_setting("pthread-max", &pthread_max)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
 			pthread_max = MAX_PTHREAD;
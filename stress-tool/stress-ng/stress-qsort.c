@@ -31,6 +31,8 @@ static const stress_help_t help[] = {
 	{ "Q N", "qsort N",	"start N workers qsorting 32 bit random integers" },
 	{ NULL,	"qsort-ops N",	"stop after N qsort bogo operations" },
 	{ NULL,	"qsort-size N",	"number of 32 bit integers to sort" },
+	{ NULL,	"qsort-threads N",	"qsort chunks on N threads and merge them in parallel" },
+	{ NULL,	"qsort-elem-size N",	"parallel sort 4 or 8 byte integers" },
 	{ NULL,	NULL,		NULL }
 };
 
@@ -62,6 +64,16 @@ static int stress_set_qsort_size(const char *opt)
 	return stress_set_setting("qsort-size", TYPE_ID_UINT64, &qsort_size);
 }
 
+static int stress_set_qsort_threads(const char *opt)
+{
+	return stress_set_sort_threads("qsort-threads", opt);
+}
+
+static int stress_set_qsort_elem_size(const char *opt)
+{
+	return stress_set_sort_elem_size("qsort-elem-size", opt);
+}
+
 /*
  *  stress_qsort_cmp_1()
  *	qsort comparison - sort on int32 values
@@ -109,7 +121,8 @@ static int stress_qsort(const stress_args_t *args)
 {
 	uint64_t qsort_size = DEFAULT_QSORT_SIZE;
 	int32_t *data, *ptr;
-	size_t n, i;
+	size_t n, i, elem_size = sizeof(uint32_t);
+	uint32_t threads = 0;
 	struct sigaction old_action;
 	int ret;
 
@@ -121,6 +134,11 @@ static int stress_qsort(const stress_args_t *args)
 	}
 	n = (size_t)qsort_size;
 
+	(void)stress_get_setting("qsort-threads", &threads);
+	(void)stress_get_setting("qsort-elem-size", &elem_size);
+	if (threads)
+		return stress_sort_threads(args, n, elem_size, threads, STRESS_SORT_QSORT);
+
 	if ((data = calloc(n, sizeof(*data))) == NULL) {
 		pr_fail("%s: calloc failed, out of memory\n", args->name);
 		return EXIT_NO_RESOURCE;
@@ -209,6 +227,8 @@ tidy:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_qsort_integers,	stress_set_qsort_size },
+	{ OPT_qsort_threads,	stress_set_qsort_threads },
+	{ OPT_qsort_elem_size,	stress_set_qsort_elem_size },
 	{ 0,			NULL }
 };
 
@@ -28,6 +28,8 @@ static const stress_help_t help[] = {
 	{ NULL,	"radixsort N",	    "start N workers radix sorting random strings" },
 	{ NULL,	"radixsort-ops N",  "stop after N radixsort bogo operations" },
 	{ NULL,	"radixsort-size N", "number of strings to sort" },
+	{ NULL,	"radixsort-threads N", "LSD radix sort integers on N threads" },
+	{ NULL,	"radixsort-elem-size N", "parallel sort 4 or 8 byte integers" },
 	{ NULL,	NULL,		    NULL }
 };
 
@@ -67,34 +69,37 @@ static int stress_set_radixsort_size(const char *opt)
 	return stress_set_setting("radixsort-size", TYPE_ID_UINT64, &radixsort_size);
 }
 
+static int stress_set_radixsort_threads(const char *opt)
+{
+	return stress_set_sort_threads("radixsort-threads", opt);
+}
+
+static int stress_set_radixsort_elem_size(const char *opt)
+{
+	return stress_set_sort_elem_size("radixsort-elem-size", opt);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_radixsort_size,	stress_set_radixsort_size },
+	{ OPT_radixsort_threads, stress_set_radixsort_threads },
+	{ OPT_radixsort_elem_size, stress_set_radixsort_elem_size },
 	{ 0,			NULL }
 };
 
 #if defined(HAVE_LIB_BSD)
 /*
- *  stress_radixsort()
- *	stress radixsort
+ *  stress_radixsort_libbsd()
+ *	stress the libbsd radixsort of strings
  */
-static int stress_radixsort(const stress_args_t *args)
+static int stress_radixsort_libbsd(const stress_args_t *args, const int n)
 {
-	uint64_t radixsort_size = DEFAULT_RADIXSORT_SIZE;
 	const unsigned char **data;
 	unsigned char *text, *ptr;
-	int n, i;
+	int i;
 	struct sigaction old_action;
 	int ret;
 	unsigned char revtable[256];
 
-	if (!stress_get_setting("radixsort-size", &radixsort_size)) {
-		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
-			radixsort_size = MAX_RADIXSORT_SIZE;
-		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
-			radixsort_size = MIN_RADIXSORT_SIZE;
-	}
-	n = (int)radixsort_size;
-
 	text = calloc((size_t)n, STR_SIZE);
 	if (!text) {
 		pr_fail("%s: calloc failed, out of memory\n", args->name);
@@ -160,17 +165,41 @@ tidy:
 	return EXIT_SUCCESS;
 }
 
-stressor_info_t stress_radixsort_info = {
-	.stressor = stress_radixsort,
-	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
-	.opt_set_funcs = opt_set_funcs,
-	.help = help
-};
+#endif
+
+/*
+ *  stress_radixsort()
+ *	stress radixsort, the parallel mode sorts integers
+ *	and does not need libbsd
+ */
+static int stress_radixsort(const stress_args_t *args)
+{
+	uint64_t radixsort_size = DEFAULT_RADIXSORT_SIZE;
+	size_t elem_size = sizeof(uint32_t);
+	uint32_t threads = 0;
+
+	if (!stress_get_setting("radixsort-size", &radixsort_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			radixsort_size = MAX_RADIXSORT_SIZE;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			radixsort_size = MIN_RADIXSORT_SIZE;
+	}
+
+	(void)stress_get_setting("radixsort-threads", &threads);
+	(void)stress_get_setting("radixsort-elem-size", &elem_size);
+	if (threads)
+		return stress_sort_threads(args, (size_t)radixsort_size,
+			elem_size, threads, STRESS_SORT_RADIX);
+#if defined(HAVE_LIB_BSD)
+	return stress_radixsort_libbsd(args, (int)radixsort_size);
 #else
+	return stress_not_implemented(args);
+#endif
+}
+
 stressor_info_t stress_radixsort_info = {
-	.stressor = stress_not_implemented,
+	.stressor = stress_radixsort,
 	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
 	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
-#endif
@@ -29,10 +29,69 @@
 #endif
 #define PACKET_SIZE	(2048)
 
+#if !defined(AF_XDP)
+#define AF_XDP		(44)
+#endif
+#if !defined(SOL_XDP)
+#define SOL_XDP		(283)
+#endif
+#if !defined(XDP_FLAGS_SKB_MODE)
+#define XDP_FLAGS_SKB_MODE	(1U << 1)
+#endif
+
+#define XDP_NUM_FRAMES	(4096)	/* UMEM frames, half RX and half TX */
+#define XDP_FRAME_SIZE	(2048)
+#define XDP_RING_SIZE	(2048)	/* entries in each ring, power of 2 */
+#define XDP_BATCH	(64)	/* packets queued per TX kick */
+#define XDP_MAX_QUEUES	(64)
+#define XDP_PKT_SIZE	(60)	/* minimum ethernet frame without FCS */
+#define XDP_HDR_SIZE	(42)	/* ethernet, IPv4 and UDP headers */
+
+#define XDP_INSN(c, d, s, o, i)	\
+	{ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) }
+
+/*
+ *  Avoid GCCism of void * pointer arithmetic by casting to
+ *  uint8_t *, doing the offset and then casting back to void *
+ */
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+/* AF_XDP with bpf link attached XDP programs, Linux 5.10 headers */
+#if defined(HAVE_LINUX_IF_XDP_H) &&	\
+    defined(HAVE_LINUX_BPF_H) &&	\
+    defined(__NR_bpf) &&		\
+    defined(XDP_USE_NEED_WAKEUP) &&	\
+    defined(XDP_STATISTICS) &&		\
+    defined(BPF_PSEUDO_MAP_FD) &&	\
+    defined(BPF_F_SLEEPABLE)
+#define STRESS_RAWPKT_XDP
+#endif
+
+#if defined(STRESS_RAWPKT_XDP)
+/* One of the four AF_XDP rings */
+typedef struct {
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *desc;
+	void *map;
+	size_t map_size;
+} stress_xdp_ring_t;
+#endif
+
+static int rawpkt_port = DEFAULT_RAWPKT_PORT;
+static bool rawpkt_xdp = false;
+static bool rawpkt_xdp_zerocopy = false;
+static char rawpkt_xdp_if[IFNAMSIZ] = "lo";
+
 static const stress_help_t help[] = {
 	{ NULL, "rawpkt N",		"start N workers exercising raw packets" },
 	{ NULL,	"rawpkt-ops N",		"stop after N raw packet bogo operations" },
 	{ NULL,	"rawpkt-port P",	"use raw packet ports P to P + number of workers - 1" },
+	{ NULL,	"rawpkt-xdp",		"send and receive through AF_XDP UMEM rings" },
+	{ NULL,	"rawpkt-xdp-if I",	"use interface I for the AF_XDP mode, default is lo" },
+	{ NULL,	"rawpkt-xdp-zerocopy",	"request zero copy AF_XDP rings" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -62,11 +121,54 @@ static int stress_set_port(const char *opt)
 	stress_set_net_port("rawpkt-port", opt,
 		MIN_RAWPKT_PORT, MAX_RAWPKT_PORT - STRESS_PROCS_MAX,
 		&port);
+	/* The XDP program is loaded before the stressors start */
+	rawpkt_port = port;
 	return stress_set_setting("rawpkt-port", TYPE_ID_INT, &port);
 }
 
+/*
+ *  stress_set_rawpkt_xdp()
+ *	use the AF_XDP mode
+ */
+static int stress_set_rawpkt_xdp(const char *opt)
+{
+	(void)opt;
+
+	rawpkt_xdp = true;
+	return 0;
+}
+
+/*
+ *  stress_set_rawpkt_xdp_if()
+ *	set the interface of the AF_XDP mode
+ */
+static int stress_set_rawpkt_xdp_if(const char *opt)
+{
+	if (strlen(opt) >= sizeof(rawpkt_xdp_if)) {
+		(void)fprintf(stderr, "rawpkt-xdp-if interface name '%s' is too long\n", opt);
+		return -1;
+	}
+	(void)shim_strlcpy(rawpkt_xdp_if, opt, sizeof(rawpkt_xdp_if));
+	return 0;
+}
+
+/*
+ *  stress_set_rawpkt_xdp_zerocopy()
+ *	request zero copy AF_XDP rings
+ */
+static int stress_set_rawpkt_xdp_zerocopy(const char *opt)
+{
+	(void)opt;
+
+	rawpkt_xdp_zerocopy = true;
+	return 0;
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_rawpkt_port,	stress_set_port },
+	{ OPT_rawpkt_xdp,	stress_set_rawpkt_xdp },
+	{ OPT_rawpkt_xdp_if,	stress_set_rawpkt_xdp_if },
+	{ OPT_rawpkt_xdp_zerocopy, stress_set_rawpkt_xdp_zerocopy },
 	{ 0,			NULL }
 };
 
@@ -343,6 +445,517 @@ die:
 	return rc;
 }
 
+#if defined(STRESS_RAWPKT_XDP)
+static unsigned int rawpkt_xdp_ifindex;
+static uint32_t rawpkt_xdp_nqueues = 1;
+static int rawpkt_xdp_map_fd = -1;
+static int rawpkt_xdp_prog_fd = -1;
+static int rawpkt_xdp_link_fd = -1;
+static int rawpkt_xdp_errno = ENOSYS;
+static const char *rawpkt_xdp_fail = "cannot set up XDP on";
+#endif
+
+#if defined(STRESS_RAWPKT_XDP)
+/*
+ *  stress_rawpkt_bpf()
+ *	bpf system call
+ */
+static int stress_rawpkt_bpf(const int cmd, union bpf_attr *attr)
+{
+	return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/*
+ *  stress_rawpkt_xdp_queues()
+ *	count the receive queues of an interface, 1 if unknown
+ */
+static uint32_t stress_rawpkt_xdp_queues(const char *ifname)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	const struct dirent *d;
+	uint32_t n = 0;
+
+	(void)snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifname);
+	dir = opendir(path);
+	if (!dir)
+		return 1;
+	while ((d = readdir(dir)) != NULL) {
+		if (!strncmp(d->d_name, "rx-", 3))
+			n++;
+	}
+	(void)closedir(dir);
+
+	if (n > XDP_MAX_QUEUES)
+		n = XDP_MAX_QUEUES;
+	return n ? n : 1;
+}
+
+/*
+ *  stress_rawpkt_xdp_init()
+ *	load and attach an XDP program that redirects the UDP packets
+ *	to the stressor ports into the AF_XDP sockets of each receive
+ *	queue, other traffic is passed up the stack as normal. This is
+ *	done once before the stressors are forked so all the instances
+ *	share the socket map.
+ */
+static void stress_rawpkt_xdp_init(void)
+{
+	union bpf_attr attr;
+	static char log[65536];
+	struct bpf_insn prog[] = {
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 2, 1, 0, 0),	/* r2 = data */
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 3, 1, 4, 0),	/* r3 = data_end */
+		XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+		XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, XDP_HDR_SIZE),
+		XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, 4, 3, 16, 0),	/* short packet */
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, 4, 2, 12, 0),	/* h_proto */
+		XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, 4, 0, 14, htons(ETH_P_IP)),
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_B, 4, 2, 14, 0),	/* version, ihl */
+		XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, 4, 0, 12, 0x45),
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_B, 4, 2, 23, 0),	/* protocol */
+		XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, 4, 0, 10, SOL_UDP),
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, 4, 2, 36, 0),	/* dest port */
+		XDP_INSN(BPF_ALU | BPF_END | BPF_TO_BE, 4, 0, 0, 16),
+		XDP_INSN(BPF_JMP | BPF_JLT | BPF_K, 4, 0, 7, rawpkt_port),
+		XDP_INSN(BPF_JMP | BPF_JGE | BPF_K, 4, 0, 6, rawpkt_port + STRESS_PROCS_MAX),
+		XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 2, 1, 16, 0),	/* rx_queue_index */
+		XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, 0),
+		XDP_INSN(0, 0, 0, 0, 0),
+		XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS),
+		XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+		XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+		XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),
+		XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+	};
+
+	if (!rawpkt_xdp)
+		return;
+
+	rawpkt_xdp_ifindex = if_nametoindex(rawpkt_xdp_if);
+	if (!rawpkt_xdp_ifindex) {
+		rawpkt_xdp_errno = errno;
+		rawpkt_xdp_fail = "cannot find interface";
+		return;
+	}
+	rawpkt_xdp_nqueues = stress_rawpkt_xdp_queues(rawpkt_xdp_if);
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	attr.key_size = sizeof(uint32_t);
+	attr.value_size = sizeof(int);
+	attr.max_entries = rawpkt_xdp_nqueues;
+	rawpkt_xdp_map_fd = stress_rawpkt_bpf(BPF_MAP_CREATE, &attr);
+	if (rawpkt_xdp_map_fd < 0) {
+		rawpkt_xdp_errno = errno;
+		rawpkt_xdp_fail = "cannot create XSK map for";
+		return;
+	}
+	prog[16].imm = rawpkt_xdp_map_fd;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.insns = (uint64_t)(uintptr_t)prog;
+	attr.insn_cnt = (uint32_t)SIZEOF_ARRAY(prog);
+	attr.license = (uint64_t)(uintptr_t)"GPL";
+	rawpkt_xdp_prog_fd = stress_rawpkt_bpf(BPF_PROG_LOAD, &attr);
+	if (rawpkt_xdp_prog_fd < 0) {
+		rawpkt_xdp_errno = errno;
+		rawpkt_xdp_fail = "cannot load XDP program for";
+
+		/* Load again to fetch the verifier's reasons */
+		attr.log_buf = (uint64_t)(uintptr_t)log;
+		attr.log_size = sizeof(log);
+		attr.log_level = 1;
+		*log = '\0';
+		(void)stress_rawpkt_bpf(BPF_PROG_LOAD, &attr);
+		pr_dbg("rawpkt: XDP program verifier log: %s\n", log);
+		goto close_map;
+	}
+
+	/*
+	 *  Native XDP if the driver has it, drivers that cannot
+	 *  run this program natively fall back to generic XDP
+	 */
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = (uint32_t)rawpkt_xdp_prog_fd;
+	attr.link_create.target_ifindex = rawpkt_xdp_ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	rawpkt_xdp_link_fd = stress_rawpkt_bpf(BPF_LINK_CREATE, &attr);
+	if (rawpkt_xdp_link_fd < 0) {
+		attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+		rawpkt_xdp_link_fd = stress_rawpkt_bpf(BPF_LINK_CREATE, &attr);
+	}
+	if (rawpkt_xdp_link_fd < 0) {
+		rawpkt_xdp_errno = errno;
+		rawpkt_xdp_fail = "cannot attach XDP program to";
+		goto close_prog;
+	}
+	return;
+
+close_prog:
+	(void)close(rawpkt_xdp_prog_fd);
+	rawpkt_xdp_prog_fd = -1;
+close_map:
+	(void)close(rawpkt_xdp_map_fd);
+	rawpkt_xdp_map_fd = -1;
+}
+
+/*
+ *  stress_rawpkt_xdp_deinit()
+ *	detach the XDP program, it goes when the last link fd closes
+ */
+static void stress_rawpkt_xdp_deinit(void)
+{
+	if (rawpkt_xdp_link_fd >= 0)
+		(void)close(rawpkt_xdp_link_fd);
+	if (rawpkt_xdp_prog_fd >= 0)
+		(void)close(rawpkt_xdp_prog_fd);
+	if (rawpkt_xdp_map_fd >= 0)
+		(void)close(rawpkt_xdp_map_fd);
+	rawpkt_xdp_link_fd = -1;
+	rawpkt_xdp_prog_fd = -1;
+	rawpkt_xdp_map_fd = -1;
+}
+
+/*
+ *  stress_rawpkt_xdp_ring()
+ *	mmap one of the AF_XDP rings
+ */
+static int stress_rawpkt_xdp_ring(
+	const int fd,
+	const struct xdp_ring_offset *off,
+	const size_t desc_size,
+	const off_t pgoff,
+	stress_xdp_ring_t *ring)
+{
+	void *ptr;
+
+	ring->map_size = off->desc + (XDP_RING_SIZE * desc_size);
+	ring->map = NULL;
+	ptr = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, pgoff);
+	if (ptr == MAP_FAILED)
+		return -1;
+	ring->map = ptr;
+	ring->producer = VOID_ADDR_OFFSET(ptr, off->producer);
+	ring->consumer = VOID_ADDR_OFFSET(ptr, off->consumer);
+	ring->flags = VOID_ADDR_OFFSET(ptr, off->flags);
+	ring->desc = VOID_ADDR_OFFSET(ptr, off->desc);
+	return 0;
+}
+
+/*
+ *  stress_rawpkt_xdp_packet()
+ *	build a minimum size UDP packet from the interface to itself
+ */
+static size_t stress_rawpkt_xdp_packet(
+	uint8_t *buf,
+	const struct ifreq *hwaddr,
+	const uint32_t saddr,
+	const int port)
+{
+	struct ethhdr *eth = (struct ethhdr *)buf;
+	struct iphdr *ip = (struct iphdr *)(buf + sizeof(struct ethhdr));
+	struct udphdr *udp = (struct udphdr *)(buf + sizeof(struct ethhdr) + sizeof(struct iphdr));
+
+	(void)memset(buf, 0, XDP_PKT_SIZE);
+	(void)memcpy(eth->h_dest, hwaddr->ifr_addr.sa_data, sizeof(eth->h_dest));
+	(void)memcpy(eth->h_source, hwaddr->ifr_addr.sa_data, sizeof(eth->h_source));
+	eth->h_proto = htons(ETH_P_IP);
+
+	ip->ihl = 5;
+	ip->version = 4;
+	ip->tot_len = htons(XDP_PKT_SIZE - sizeof(struct ethhdr));
+	ip->ttl = 16;
+	ip->protocol = SOL_UDP;
+	ip->saddr = saddr;
+	ip->daddr = saddr;
+	ip->check = stress_ipv4_checksum((uint16_t *)ip, sizeof(struct iphdr));
+
+	udp->source = htons(port);
+	udp->dest = htons(port);
+	udp->len = htons(XDP_PKT_SIZE - sizeof(struct ethhdr) - sizeof(struct iphdr));
+
+	return XDP_PKT_SIZE;
+}
+
+/*
+ *  stress_rawpkt_xdp()
+ *	send and receive minimum size UDP packets through the UMEM
+ *	rings of an AF_XDP socket bound to one interface queue, each
+ *	bogo op is a packet whose transmission completed
+ */
+static int stress_rawpkt_xdp(const stress_args_t *args, const int port)
+{
+	const uint32_t queue = args->instance;
+	const size_t umem_size = XDP_NUM_FRAMES * XDP_FRAME_SIZE;
+	struct xdp_mmap_offsets off;
+	struct xdp_umem_reg reg;
+	struct sockaddr_xdp sxdp;
+	struct xdp_statistics stats;
+	struct ifreq hwaddr, ifaddr;
+	stress_xdp_ring_t fill, comp, rx, tx;
+	uint64_t *tx_free = NULL;
+	uint8_t *umem;
+	uint32_t i, n_free = 0, rx_cons = 0, fill_prod = 0, tx_prod = 0, comp_cons = 0;
+	uint64_t sent = 0, received = 0, kicks = 0;
+	double t_start, duration;
+	socklen_t optlen;
+	size_t pkt_len = 0;
+	uint32_t saddr = 0;
+	bool zerocopy = false;
+	int fd, rc = EXIT_NO_RESOURCE;
+
+	if (rawpkt_xdp_map_fd < 0) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: %s %s, errno=%d (%s), skipping stressor\n",
+				args->name, rawpkt_xdp_fail, rawpkt_xdp_if,
+				rawpkt_xdp_errno, strerror(rawpkt_xdp_errno));
+		return EXIT_NO_RESOURCE;
+	}
+	if (queue >= rawpkt_xdp_nqueues) {
+		pr_inf_skip("%s: %s has %" PRIu32 " receive queues, skipping "
+			"instance %" PRIu32 "\n", args->name, rawpkt_xdp_if,
+			rawpkt_xdp_nqueues, args->instance);
+		return EXIT_NO_RESOURCE;
+	}
+
+	fd = socket(AF_XDP, SOCK_RAW, 0);
+	if (fd < 0) {
+		pr_inf_skip("%s: cannot create AF_XDP socket, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(&hwaddr, 0, sizeof(hwaddr));
+	(void)shim_strlcpy(hwaddr.ifr_name, rawpkt_xdp_if, sizeof(hwaddr.ifr_name));
+	(void)memset(&ifaddr, 0, sizeof(ifaddr));
+	(void)shim_strlcpy(ifaddr.ifr_name, rawpkt_xdp_if, sizeof(ifaddr.ifr_name));
+	if (ioctl(fd, SIOCGIFHWADDR, &hwaddr) < 0)
+		(void)memset(&hwaddr.ifr_addr, 0, sizeof(hwaddr.ifr_addr));
+	if (ioctl(fd, SIOCGIFADDR, &ifaddr) == 0)
+		saddr = ((struct sockaddr_in *)&ifaddr.ifr_addr)->sin_addr.s_addr;
+
+	umem = (uint8_t *)mmap(NULL, umem_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (umem == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte UMEM, errno=%d (%s), "
+			"skipping stressor\n", args->name, umem_size,
+			errno, strerror(errno));
+		(void)close(fd);
+		return EXIT_NO_RESOURCE;
+	}
+	tx_free = calloc(XDP_NUM_FRAMES / 2, sizeof(*tx_free));
+	if (!tx_free) {
+		pr_inf_skip("%s: cannot allocate TX frame list, skipping stressor\n",
+			args->name);
+		goto unmap;
+	}
+	(void)memset(&fill, 0, sizeof(fill));
+	(void)memset(&comp, 0, sizeof(comp));
+	(void)memset(&rx, 0, sizeof(rx));
+	(void)memset(&tx, 0, sizeof(tx));
+
+	(void)memset(&reg, 0, sizeof(reg));
+	reg.addr = (uint64_t)(uintptr_t)umem;
+	reg.len = umem_size;
+	reg.chunk_size = XDP_FRAME_SIZE;
+	if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+		pr_inf_skip("%s: cannot register UMEM, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		goto unmap;
+	}
+	/* All the rings are sized first, the mmap offsets are known after */
+	{
+		const int entries = XDP_RING_SIZE;
+
+		if ((setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries)) < 0) ||
+		    (setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries, sizeof(entries)) < 0) ||
+		    (setsockopt(fd, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries)) < 0) ||
+		    (setsockopt(fd, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries)) < 0)) {
+			pr_inf_skip("%s: cannot size AF_XDP rings, errno=%d (%s), "
+				"skipping stressor\n", args->name, errno, strerror(errno));
+			goto unmap;
+		}
+	}
+	optlen = sizeof(off);
+	if ((getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) ||
+	    (stress_rawpkt_xdp_ring(fd, &off.fr, sizeof(uint64_t),
+		(off_t)XDP_UMEM_PGOFF_FILL_RING, &fill) < 0) ||
+	    (stress_rawpkt_xdp_ring(fd, &off.cr, sizeof(uint64_t),
+		(off_t)XDP_UMEM_PGOFF_COMPLETION_RING, &comp) < 0) ||
+	    (stress_rawpkt_xdp_ring(fd, &off.rx, sizeof(struct xdp_desc),
+		(off_t)XDP_PGOFF_RX_RING, &rx) < 0) ||
+	    (stress_rawpkt_xdp_ring(fd, &off.tx, sizeof(struct xdp_desc),
+		(off_t)XDP_PGOFF_TX_RING, &tx) < 0)) {
+		pr_inf_skip("%s: cannot mmap AF_XDP rings, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		goto unmap_rings;
+	}
+
+	/* First half of the frames receive, the second half are prebuilt packets */
+	for (i = 0; i < XDP_NUM_FRAMES / 2; i++)
+		((uint64_t *)fill.desc)[i & (XDP_RING_SIZE - 1)] = (uint64_t)i * XDP_FRAME_SIZE;
+	fill_prod = XDP_NUM_FRAMES / 2;
+	shim_mb();
+	*fill.producer = fill_prod;
+	for (i = XDP_NUM_FRAMES / 2; i < XDP_NUM_FRAMES; i++) {
+		const uint64_t addr = (uint64_t)i * XDP_FRAME_SIZE;
+
+		pkt_len = stress_rawpkt_xdp_packet(umem + addr, &hwaddr, saddr, port);
+		tx_free[n_free++] = addr;
+	}
+
+	(void)memset(&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = rawpkt_xdp_ifindex;
+	sxdp.sxdp_queue_id = queue;
+	sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (rawpkt_xdp_zerocopy ? XDP_ZEROCOPY : 0);
+	if (bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+		if (rawpkt_xdp_zerocopy) {
+			if (args->instance == 0)
+				pr_inf("%s: zero copy AF_XDP not supported by %s, "
+					"using copy mode\n", args->name, rawpkt_xdp_if);
+			sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP;
+			if (bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0)
+				goto bound;
+		}
+		pr_inf_skip("%s: cannot bind AF_XDP socket to %s queue %" PRIu32
+			", errno=%d (%s), skipping stressor\n", args->name,
+			rawpkt_xdp_if, queue, errno, strerror(errno));
+		goto unmap_rings;
+	}
+bound:
+#if defined(XDP_OPTIONS) &&	\
+    defined(XDP_OPTIONS_ZEROCOPY)
+	{
+		struct xdp_options opts;
+
+		optlen = sizeof(opts);
+		if (getsockopt(fd, SOL_XDP, XDP_OPTIONS, &opts, &optlen) == 0)
+			zerocopy = !!(opts.flags & XDP_OPTIONS_ZEROCOPY);
+	}
+#endif
+	{
+		union bpf_attr attr;
+		const int value = fd;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.map_fd = (uint32_t)rawpkt_xdp_map_fd;
+		attr.key = (uint64_t)(uintptr_t)&queue;
+		attr.value = (uint64_t)(uintptr_t)&value;
+		attr.flags = BPF_ANY;
+		if (stress_rawpkt_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+			pr_inf_skip("%s: cannot add AF_XDP socket to XSK map, "
+				"errno=%d (%s), skipping stressor\n", args->name,
+				errno, strerror(errno));
+			goto unmap_rings;
+		}
+	}
+
+	rc = EXIT_SUCCESS;
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	t_start = stress_time_now();
+	do {
+		uint32_t n, avail;
+
+		/* Reclaim the frames of completed transmissions */
+		n = *comp.producer - comp_cons;
+		shim_mb();
+		for (i = 0; i < n; i++, comp_cons++)
+			tx_free[n_free++] = ((uint64_t *)comp.desc)[comp_cons & (XDP_RING_SIZE - 1)];
+		*comp.consumer = comp_cons;
+		sent += n;
+		add_counter(args, n);
+
+		/* Queue a batch of the prebuilt packets */
+		avail = XDP_RING_SIZE - (tx_prod - *tx.consumer);
+		if (avail > n_free)
+			avail = n_free;
+		if (avail > XDP_BATCH)
+			avail = XDP_BATCH;
+		for (i = 0; i < avail; i++, tx_prod++) {
+			struct xdp_desc *desc = &((struct xdp_desc *)tx.desc)[tx_prod & (XDP_RING_SIZE - 1)];
+
+			desc->addr = tx_free[--n_free];
+			desc->len = (uint32_t)pkt_len;
+			desc->options = 0;
+		}
+		shim_mb();
+		*tx.producer = tx_prod;
+		if (avail && (!zerocopy || (*tx.flags & XDP_RING_NEED_WAKEUP))) {
+			kicks++;
+			if ((sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0) &&
+			    (errno != EAGAIN) && (errno != EBUSY) &&
+			    (errno != ENOBUFS) && (errno != ENETDOWN) &&
+			    (errno != EINTR)) {
+				pr_fail("%s: AF_XDP sendto failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				rc = EXIT_FAILURE;
+				break;
+			}
+		}
+
+		/* Count received packets and hand their frames back */
+		n = *rx.producer - rx_cons;
+		shim_mb();
+		for (i = 0; i < n; i++, rx_cons++, fill_prod++) {
+			const struct xdp_desc *desc = &((struct xdp_desc *)rx.desc)[rx_cons & (XDP_RING_SIZE - 1)];
+
+			((uint64_t *)fill.desc)[fill_prod & (XDP_RING_SIZE - 1)] =
+				desc->addr & ~(uint64_t)(XDP_FRAME_SIZE - 1);
+		}
+		received += n;
+		shim_mb();
+		*rx.consumer = rx_cons;
+		*fill.producer = fill_prod;
+		if (*fill.flags & XDP_RING_NEED_WAKEUP)
+			(void)recvfrom(fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+	} while (keep_stressing(args));
+	duration = stress_time_now() - t_start;
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	(void)memset(&stats, 0, sizeof(stats));
+	optlen = sizeof(stats);
+	(void)getsockopt(fd, SOL_XDP, XDP_STATISTICS, &stats, &optlen);
+	if (duration > 0.0) {
+		const double tx_mpps = (double)sent / duration / 1000000.0;
+		const double rx_mpps = (double)received / duration / 1000000.0;
+
+		stress_misc_stats_set(args->misc_stats, 0, "Mpps sent", tx_mpps);
+		stress_misc_stats_set(args->misc_stats, 1, "Mpps received", rx_mpps);
+		stress_misc_stats_set(args->misc_stats, 2, "rx drops per sec",
+			(double)(stats.rx_dropped + stats.rx_ring_full) / duration);
+		pr_inf("%s: %s queue %" PRIu32 " (%s): %.3f Mpps sent, %.3f Mpps received, "
+			"%" PRIu64 " rx dropped, %" PRIu64 " rx ring full, %" PRIu64
+			" fill ring empty, %" PRIu64 " tx invalid\n", args->name,
+			rawpkt_xdp_if, queue, zerocopy ? "zero copy" : "copy",
+			tx_mpps, rx_mpps, (uint64_t)stats.rx_dropped,
+			(uint64_t)stats.rx_ring_full,
+			(uint64_t)stats.rx_fill_ring_empty_descs,
+			(uint64_t)stats.tx_invalid_descs);
+	}
+	pr_dbg("%s: %" PRIu64 " packets sent, %" PRIu64 " packets received, "
+		"%" PRIu64 " TX kicks\n", args->name, sent, received, kicks);
+
+unmap_rings:
+	if (tx.map)
+		(void)munmap(tx.map, tx.map_size);
+	if (rx.map)
+		(void)munmap(rx.map, rx.map_size);
+	if (comp.map)
+		(void)munmap(comp.map, comp.map_size);
+	if (fill.map)
+		(void)munmap(fill.map, fill.map_size);
+unmap:
+	(void)close(fd);
+	free(tx_free);
+	(void)munmap((void *)umem, umem_size);
+
+	return rc;
+}
+#endif
+
 static void stress_sock_sigpipe_handler(int signum)
 {
 	(void)signum;
@@ -369,6 +982,17 @@ static int stress_rawpkt(const stress_args_t *args)
 	if (stress_sighandler(args->name, SIGPIPE, stress_sock_sigpipe_handler, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
+	if (rawpkt_xdp) {
+#if defined(STRESS_RAWPKT_XDP)
+		return stress_rawpkt_xdp(args, port + (int)args->instance);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: AF_XDP is not supported, skipping stressor\n",
+				args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+
 	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
 		pr_fail("%s: socket failed, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
@@ -435,6 +1059,10 @@ stressor_info_t stress_rawpkt_info = {
 	.class = CLASS_NETWORK | CLASS_OS,
 	.opt_set_funcs = opt_set_funcs,
 	.supported = stress_rawpkt_supported,
+#if defined(STRESS_RAWPKT_XDP)
+	.init = stress_rawpkt_xdp_init,
+	.deinit = stress_rawpkt_xdp_deinit,
+#endif
 	.help = help
 };
 #else
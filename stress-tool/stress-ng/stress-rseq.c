@@ -27,9 +27,53 @@
 static const stress_help_t help[] = {
 	{ NULL,	"rseq N",	"start N workers that exercise restartable sequences" },
 	{ NULL,	"rseq-ops N",	"stop after N bogo restartable sequence operations" },
+	{ NULL,	"rseq-bench",	"benchmark rseq per cpu counters and freelists" },
+	{ NULL,	"rseq-threads N", "maximum number of benchmark threads" },
+	{ NULL,	"rseq-preempt N", "preempt benchmark threads every N microseconds" },
 	{ NULL,	NULL,		NULL }
 };
 
+#define MIN_RSEQ_THREADS	(2)
+#define MAX_RSEQ_THREADS	(256)
+
+#define MIN_RSEQ_PREEMPT	(10)
+#define MAX_RSEQ_PREEMPT	(1000000)
+#define DEFAULT_RSEQ_PREEMPT	(100)
+
+static int stress_set_rseq_bench(const char *opt)
+{
+	bool rseq_bench = true;
+
+	(void)opt;
+	return stress_set_setting("rseq-bench", TYPE_ID_BOOL, &rseq_bench);
+}
+
+static int stress_set_rseq_threads(const char *opt)
+{
+	size_t rseq_threads;
+
+	rseq_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("rseq-threads", rseq_threads,
+		MIN_RSEQ_THREADS, MAX_RSEQ_THREADS);
+	return stress_set_setting("rseq-threads", TYPE_ID_SIZE_T, &rseq_threads);
+}
+
+static int stress_set_rseq_preempt(const char *opt)
+{
+	uint64_t rseq_preempt;
+
+	rseq_preempt = stress_get_uint64(opt);
+	stress_check_range("rseq-preempt", rseq_preempt,
+		MIN_RSEQ_PREEMPT, MAX_RSEQ_PREEMPT);
+	return stress_set_setting("rseq-preempt", TYPE_ID_UINT64, &rseq_preempt);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_rseq_bench,	stress_set_rseq_bench },
+	{ OPT_rseq_threads,	stress_set_rseq_threads },
+	{ OPT_rseq_preempt,	stress_set_rseq_preempt },
+	{ 0,			NULL }
+};
 
 #if defined(HAVE_LINUX_RSEQ_H) &&	\
     defined(HAVE_ASM_NOP) &&		\
@@ -194,6 +238,708 @@ static void sigsegv_handler(int sig)
 	rseq_info->segv_count++;
 }
 
+#if defined(__x86_64__) &&		\
+    defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&	\
+    defined(HAVE_SCHED_GETCPU) &&	\
+    defined(HAVE_CLOCK_NANOSLEEP)
+#define STRESS_RSEQ_BENCH
+
+#define RSEQ_BENCH_SIG		(0x53053053)	/* x86 signature, as used by glibc */
+#define RSEQ_BENCH_SLICE	(0.2)		/* seconds per measurement */
+#define RSEQ_BENCH_NODES	(64)		/* freelist nodes per cpu or thread */
+#define RSEQ_BENCH_BATCH	(256)		/* ops between stop checks */
+#define RSEQ_BENCH_SPIN		(20000)		/* ns a preempting thread runs */
+#define RSEQ_BENCH_PREEMPTS	(3)		/* off, 10 x rseq-preempt and rseq-preempt */
+#define RSEQ_BENCH_COLS		(16)		/* thread counts measured */
+
+#define RSEQ_BENCH_COUNTER_RSEQ		(0)
+#define RSEQ_BENCH_COUNTER_PERCPU	(1)
+#define RSEQ_BENCH_COUNTER_ATOMIC	(2)
+#define RSEQ_BENCH_COUNTER_TLS		(3)
+#define RSEQ_BENCH_LIST_RSEQ		(4)
+#define RSEQ_BENCH_LIST_MUTEX		(5)
+#define RSEQ_BENCH_LIST_TLS		(6)
+#define RSEQ_BENCH_METHODS		(7)
+
+static const char * const rseq_bench_methods[RSEQ_BENCH_METHODS] = {
+	"rseq counter",
+	"percpu atomic counter",
+	"atomic counter",
+	"thread local counter",
+	"rseq freelist",
+	"mutex freelist",
+	"thread local freelist",
+};
+
+typedef struct stress_rseq_node {
+	struct stress_rseq_node *next;	/* must be at offset 0, the asm uses it */
+} stress_rseq_node_t;
+
+/*
+ *  per cpu slot, exactly one cache line as the asm indexes
+ *  the slots by cpu_id << 6, count at offset 0, head at offset 8
+ */
+typedef struct {
+	uint64_t count;
+	stress_rseq_node_t *head;
+	uint8_t pad[48];
+} __attribute__((aligned(64))) stress_rseq_slot_t;
+
+typedef struct stress_rseq_bench stress_rseq_bench_t;
+
+/* per benchmark thread state */
+typedef struct {
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	stress_rseq_bench_t *bench;
+	uint64_t ops;
+	uint64_t aborts;		/* rseq critical section aborts */
+	uint64_t empty;			/* pops of an empty freelist */
+	uint64_t local;			/* thread local counter */
+	stress_rseq_node_t *head;	/* thread local freelist */
+	int rseq_err;			/* errno of a failed rseq registration */
+} __attribute__((aligned(64))) stress_rseq_thread_t;
+
+struct stress_rseq_bench {
+	stress_rseq_slot_t *slots;	/* one per configured cpu */
+	size_t cpus;
+	stress_rseq_node_t *nodes;
+	size_t n_nodes;
+	stress_rseq_node_t *global_head;	/* the mutex freelist */
+	pthread_mutex_t lock;
+	uint64_t atomic_count __attribute__((aligned(64)));
+	volatile bool go __attribute__((aligned(64)));
+	volatile bool stop;
+	int method;
+	uint64_t preempt_ns;		/* preempting thread period, 0 for none */
+	uint64_t preempts;		/* wakeups of the preempting threads */
+};
+
+/* throughput and aborts of one method, thread count and preemption rate */
+typedef struct {
+	double ops;
+	double aborts;
+	double duration;
+} stress_rseq_bench_result_t;
+
+static __thread struct rseq rseq_bench_tls __attribute__((aligned(32)));
+
+/*
+ *  The critical section descriptor, a struct rseq_cs in the __rseq_cs
+ *  section, and the abort handler preceded by the signature in the
+ *  __rseq_failure section, as done by librseq
+ */
+#define RSEQ_BENCH_CS(label, start, end, abort)			\
+	".pushsection __rseq_cs, \"aw\"\n\t"				\
+	".balign 32\n\t"						\
+	#label ":\n\t"							\
+	".long 0x0, 0x0\n\t"						\
+	".quad " #start ", (" #end " - " #start "), " #abort "\n\t"	\
+	".popsection\n\t"						\
+	"leaq " #label "b(%%rip), %%rax\n\t"				\
+	"movq %%rax, %[rseq_cs]\n\t"
+
+#define RSEQ_BENCH_ABORT(label)					\
+	".pushsection __rseq_failure, \"ax\"\n\t"			\
+	".byte 0x0f, 0xb9, 0x3d\n\t"					\
+	".long 0x53053053\n\t"						\
+	#label ":\n\t"							\
+	"jmp %l[abort]\n\t"						\
+	".popsection\n\t"
+
+/*
+ *  stress_rseq_bench_add()
+ *	increment the counter of the current cpu, the add is the commit
+ */
+static inline int stress_rseq_bench_add(volatile struct rseq *rs, stress_rseq_slot_t *slots)
+{
+	__asm__ __volatile__ goto (
+		RSEQ_BENCH_CS(3, 1f, 2f, 4f)
+		"1:\n\t"
+		"movl %[cpu_id], %%eax\n\t"
+		"shlq $6, %%rax\n\t"
+		"addq %[slots], %%rax\n\t"
+		"addq $1, (%%rax)\n\t"
+		"2:\n\t"
+		RSEQ_BENCH_ABORT(4)
+		:
+		: [cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [slots] "r" (slots)
+		: "memory", "cc", "rax"
+		: abort);
+	return 0;
+abort:
+	return -1;
+}
+
+/*
+ *  stress_rseq_bench_pop()
+ *	pop the head of the freelist of the current cpu into *node,
+ *	NULL if it is empty, the store of the new head is the commit
+ */
+static inline int stress_rseq_bench_pop(
+	volatile struct rseq *rs,
+	stress_rseq_slot_t *slots,
+	stress_rseq_node_t **node)
+{
+	__asm__ __volatile__ goto (
+		RSEQ_BENCH_CS(3, 1f, 2f, 4f)
+		"1:\n\t"
+		"movl %[cpu_id], %%eax\n\t"
+		"shlq $6, %%rax\n\t"
+		"addq %[slots], %%rax\n\t"
+		"movq 8(%%rax), %%rbx\n\t"
+		"movq %%rbx, (%[node])\n\t"
+		"testq %%rbx, %%rbx\n\t"
+		"jz 2f\n\t"
+		"movq (%%rbx), %%rcx\n\t"
+		"movq %%rcx, 8(%%rax)\n\t"
+		"2:\n\t"
+		RSEQ_BENCH_ABORT(4)
+		:
+		: [cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [slots] "r" (slots),
+		  [node] "r" (node)
+		: "memory", "cc", "rax", "rbx", "rcx"
+		: abort);
+	return 0;
+abort:
+	return -1;
+}
+
+/*
+ *  stress_rseq_bench_push()
+ *	push node on the freelist of the current cpu, the store of the
+ *	new head is the commit
+ */
+static inline int stress_rseq_bench_push(
+	volatile struct rseq *rs,
+	stress_rseq_slot_t *slots,
+	stress_rseq_node_t *node)
+{
+	__asm__ __volatile__ goto (
+		RSEQ_BENCH_CS(3, 1f, 2f, 4f)
+		"1:\n\t"
+		"movl %[cpu_id], %%eax\n\t"
+		"shlq $6, %%rax\n\t"
+		"addq %[slots], %%rax\n\t"
+		"movq 8(%%rax), %%rbx\n\t"
+		"movq %%rbx, (%[node])\n\t"
+		"movq %[node], 8(%%rax)\n\t"
+		"2:\n\t"
+		RSEQ_BENCH_ABORT(4)
+		:
+		: [cpu_id] "m" (rs->cpu_id),
+		  [rseq_cs] "m" (rs->rseq_cs),
+		  [slots] "r" (slots),
+		  [node] "r" (node)
+		: "memory", "cc", "rax", "rbx"
+		: abort);
+	return 0;
+abort:
+	return -1;
+}
+
+/*
+ *  stress_rseq_bench_area()
+ *	the rseq area of the calling thread, glibc 2.35 onwards registers
+ *	one for every thread, otherwise register a thread local one and
+ *	set *registered
+ */
+static volatile struct rseq *stress_rseq_bench_area(bool *registered)
+{
+	*registered = false;
+#if defined(HAVE_SYS_RSEQ_H)
+	if (__rseq_size > 0) {
+		uintptr_t tp;
+
+		__asm__ __volatile__("movq %%fs:0, %0" : "=r" (tp));
+		return (volatile struct rseq *)(tp + (uintptr_t)__rseq_offset);
+	}
+#endif
+	if (shim_rseq(&rseq_bench_tls, sizeof(rseq_bench_tls), 0, RSEQ_BENCH_SIG) < 0)
+		return NULL;
+	*registered = true;
+	return &rseq_bench_tls;
+}
+
+static void stress_rseq_bench_area_free(const bool registered)
+{
+	if (registered)
+		(void)shim_rseq(&rseq_bench_tls, sizeof(rseq_bench_tls),
+			RSEQ_FLAG_UNREGISTER, RSEQ_BENCH_SIG);
+}
+
+/*
+ *  stress_rseq_bench_cpu()
+ *	the cpu slot index of the calling thread
+ */
+static inline size_t stress_rseq_bench_cpu(const stress_rseq_bench_t *bench)
+{
+	const int cpu = sched_getcpu();
+
+	return ((cpu < 0) || ((size_t)cpu >= bench->cpus)) ? 0 : (size_t)cpu;
+}
+
+/*
+ *  stress_rseq_bench_op()
+ *	one operation of the method, a counter increment or a freelist
+ *	pop and push
+ */
+static inline void stress_rseq_bench_op(
+	stress_rseq_bench_t *bench,
+	stress_rseq_thread_t *thread,
+	volatile struct rseq *rs)
+{
+	stress_rseq_node_t *node;
+
+	switch (bench->method) {
+	case RSEQ_BENCH_COUNTER_RSEQ:
+		while (stress_rseq_bench_add(rs, bench->slots) < 0)
+			thread->aborts++;
+		break;
+	case RSEQ_BENCH_COUNTER_PERCPU:
+		(void)__atomic_fetch_add(&bench->slots[stress_rseq_bench_cpu(bench)].count,
+			1, __ATOMIC_RELAXED);
+		break;
+	case RSEQ_BENCH_COUNTER_ATOMIC:
+		(void)__atomic_fetch_add(&bench->atomic_count, 1, __ATOMIC_RELAXED);
+		break;
+	case RSEQ_BENCH_COUNTER_TLS:
+		*(volatile uint64_t *)&thread->local += 1;
+		break;
+	case RSEQ_BENCH_LIST_RSEQ:
+		while (stress_rseq_bench_pop(rs, bench->slots, &node) < 0)
+			thread->aborts++;
+		if (!node) {
+			thread->empty++;
+			break;
+		}
+		while (stress_rseq_bench_push(rs, bench->slots, node) < 0)
+			thread->aborts++;
+		break;
+	case RSEQ_BENCH_LIST_MUTEX:
+		(void)pthread_mutex_lock(&bench->lock);
+		node = bench->global_head;
+		if (node)
+			bench->global_head = node->next;
+		(void)pthread_mutex_unlock(&bench->lock);
+		if (!node) {
+			thread->empty++;
+			break;
+		}
+		(void)pthread_mutex_lock(&bench->lock);
+		node->next = bench->global_head;
+		bench->global_head = node;
+		(void)pthread_mutex_unlock(&bench->lock);
+		break;
+	case RSEQ_BENCH_LIST_TLS:
+		node = *(stress_rseq_node_t * volatile *)&thread->head;
+		if (!node) {
+			thread->empty++;
+			break;
+		}
+		thread->head = node->next;
+		node->next = *(stress_rseq_node_t * volatile *)&thread->head;
+		*(stress_rseq_node_t * volatile *)&thread->head = node;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ *  stress_rseq_bench_thread()
+ *	run the method until told to stop
+ */
+static void *stress_rseq_bench_thread(void *arg)
+{
+	stress_rseq_thread_t *thread = (stress_rseq_thread_t *)arg;
+	stress_rseq_bench_t *bench = thread->bench;
+	volatile struct rseq *rs;
+	bool registered;
+
+	rs = stress_rseq_bench_area(&registered);
+	if (!rs)
+		thread->rseq_err = errno;
+
+	while (!bench->go && !bench->stop)
+		(void)shim_sched_yield();
+	if (!rs && ((bench->method == RSEQ_BENCH_COUNTER_RSEQ) ||
+		    (bench->method == RSEQ_BENCH_LIST_RSEQ)))
+		return NULL;
+
+	while (!bench->stop) {
+		register int i;
+
+		for (i = 0; i < RSEQ_BENCH_BATCH; i++)
+			stress_rseq_bench_op(bench, thread, rs);
+		thread->ops += RSEQ_BENCH_BATCH;
+	}
+	stress_rseq_bench_area_free(registered);
+	return NULL;
+}
+
+/*
+ *  stress_rseq_bench_preempt()
+ *	wake every preempt_ns and run for RSEQ_BENCH_SPIN ns to preempt
+ *	the benchmark threads
+ */
+static void *stress_rseq_bench_preempt(void *arg)
+{
+	stress_rseq_bench_t *bench = (stress_rseq_bench_t *)arg;
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(bench->preempt_ns / STRESS_NANOSECOND);
+	ts.tv_nsec = (long)(bench->preempt_ns % STRESS_NANOSECOND);
+	while (!bench->stop) {
+		double t_end;
+
+		(void)clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+		t_end = stress_time_now() + (RSEQ_BENCH_SPIN / (double)STRESS_NANOSECOND);
+		while (!bench->stop && (stress_time_now() < t_end))
+			shim_mb();
+		(void)__atomic_fetch_add(&bench->preempts, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+/*
+ *  stress_rseq_bench_nodes()
+ *	count the nodes on the freelists of the method
+ */
+static size_t stress_rseq_bench_nodes(
+	const stress_rseq_bench_t *bench,
+	const stress_rseq_thread_t *threads,
+	const size_t n_threads)
+{
+	const stress_rseq_node_t *node;
+	size_t i, n = 0;
+
+	switch (bench->method) {
+	case RSEQ_BENCH_LIST_RSEQ:
+		for (i = 0; i < bench->cpus; i++)
+			for (node = bench->slots[i].head; node && (n <= bench->n_nodes); node = node->next)
+				n++;
+		break;
+	case RSEQ_BENCH_LIST_MUTEX:
+		for (node = bench->global_head; node && (n <= bench->n_nodes); node = node->next)
+			n++;
+		break;
+	case RSEQ_BENCH_LIST_TLS:
+		for (i = 0; i < n_threads; i++)
+			for (node = threads[i].head; node && (n <= bench->n_nodes); node = node->next)
+				n++;
+		break;
+	default:
+		break;
+	}
+	return n;
+}
+
+/*
+ *  stress_rseq_bench_measure()
+ *	run the method on n_threads threads for RSEQ_BENCH_SLICE seconds
+ *	and check that no count or freelist node was lost
+ */
+static int stress_rseq_bench_measure(
+	const stress_args_t *args,
+	stress_rseq_bench_t *bench,
+	stress_rseq_thread_t *threads,
+	const size_t n_threads,
+	pthread_t *preempters,
+	const size_t n_preempters,
+	stress_rseq_bench_result_t *result,
+	int *rseq_err)
+{
+	size_t i, j, started = 0, preempting = 0, n_lists;
+	uint64_t ops = 0, aborts = 0, count = 0;
+	double t_start, duration;
+	int rc = EXIT_SUCCESS;
+
+	(void)memset(bench->slots, 0, bench->cpus * sizeof(*bench->slots));
+	(void)memset(threads, 0, n_threads * sizeof(*threads));
+	bench->atomic_count = 0;
+	bench->global_head = NULL;
+	bench->go = false;
+	bench->stop = false;
+
+	/* Spread the freelist nodes over the cpus, the threads or one list */
+	n_lists = (bench->method == RSEQ_BENCH_LIST_RSEQ) ? bench->cpus :
+		  ((bench->method == RSEQ_BENCH_LIST_TLS) ? n_threads : 1);
+	for (i = 0; i < bench->n_nodes; i++) {
+		stress_rseq_node_t *node = &bench->nodes[i];
+		stress_rseq_node_t **head;
+
+		j = i % n_lists;
+		if (bench->method == RSEQ_BENCH_LIST_RSEQ)
+			head = &bench->slots[j].head;
+		else if (bench->method == RSEQ_BENCH_LIST_TLS)
+			head = &threads[j].head;
+		else
+			head = &bench->global_head;
+		node->next = *head;
+		*head = node;
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		threads[i].bench = bench;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_rseq_bench_thread, (void *)&threads[i]);
+		if (threads[i].ret)
+			break;
+		started++;
+	}
+	if (started < n_threads) {
+		pr_inf("%s: cannot create %zu threads, only created %zu\n",
+			args->name, n_threads, started);
+		rc = EXIT_NO_RESOURCE;
+	}
+	for (i = 0; (rc == EXIT_SUCCESS) && bench->preempt_ns && (i < n_preempters); i++) {
+		if (pthread_create(&preempters[i], NULL, stress_rseq_bench_preempt, (void *)bench))
+			break;
+		preempting++;
+	}
+
+	t_start = stress_time_now();
+	bench->go = true;
+	if (rc == EXIT_SUCCESS)
+		(void)shim_usleep((uint64_t)(RSEQ_BENCH_SLICE * 1000000.0));
+	bench->stop = true;
+	duration = stress_time_now() - t_start;
+
+	for (i = 0; i < started; i++)
+		(void)pthread_join(threads[i].pthread, NULL);
+	for (i = 0; i < preempting; i++)
+		(void)pthread_join(preempters[i], NULL);
+	if ((rc != EXIT_SUCCESS) || !keep_stressing_flag())
+		return rc;
+
+	for (i = 0; i < n_threads; i++) {
+		if (threads[i].rseq_err)
+			*rseq_err = threads[i].rseq_err;
+		ops += threads[i].ops;
+		aborts += threads[i].aborts;
+		count += threads[i].local;
+	}
+	if (!ops) {
+		/* rseq methods do nothing when registration failed */
+		return EXIT_SUCCESS;
+	}
+
+	switch (bench->method) {
+	case RSEQ_BENCH_COUNTER_RSEQ:
+	case RSEQ_BENCH_COUNTER_PERCPU:
+		count = 0;
+		for (i = 0; i < bench->cpus; i++)
+			count += bench->slots[i].count;
+		break;
+	case RSEQ_BENCH_COUNTER_ATOMIC:
+		count = bench->atomic_count;
+		break;
+	case RSEQ_BENCH_COUNTER_TLS:
+		break;
+	default:
+		count = ops;
+		j = stress_rseq_bench_nodes(bench, threads, n_threads);
+		if (j != bench->n_nodes) {
+			pr_fail("%s: %s with %zu threads has %zu freelist nodes, expected %zu\n",
+				args->name, rseq_bench_methods[bench->method], n_threads,
+				j, bench->n_nodes);
+			rc = EXIT_FAILURE;
+		}
+		break;
+	}
+	if (count != ops) {
+		pr_fail("%s: %s with %zu threads counted %" PRIu64 ", expected %" PRIu64 "\n",
+			args->name, rseq_bench_methods[bench->method], n_threads, count, ops);
+		rc = EXIT_FAILURE;
+	}
+
+	result->ops += (double)ops;
+	result->aborts += (double)aborts;
+	result->duration += duration;
+	inc_counter(args);
+	return rc;
+}
+
+/*
+ *  stress_rseq_bench_report()
+ *	report the throughput of each method, and the abort rate of the
+ *	rseq methods, per thread count and preemption rate
+ */
+static void stress_rseq_bench_report(
+	const stress_args_t *args,
+	const stress_rseq_bench_result_t results[RSEQ_BENCH_PREEMPTS][RSEQ_BENCH_METHODS][RSEQ_BENCH_COLS],
+	const size_t *cols,
+	const size_t n_cols,
+	const uint64_t *preempt_us)
+{
+	char line[256], desc[64];
+	bool lock = false;
+	size_t p, m, c, pos;
+	int idx = 0;
+
+	if (args->instance != 0)
+		goto stats;
+
+	pr_lock(&lock);
+	for (p = 0; p < RSEQ_BENCH_PREEMPTS; p++) {
+		if (preempt_us[p])
+			pr_inf_lock(&lock, "%s: Mops/sec with a preempting thread per cpu every %" PRIu64 "us\n",
+				args->name, preempt_us[p]);
+		else
+			pr_inf_lock(&lock, "%s: Mops/sec without preempting threads\n", args->name);
+		pos = (size_t)snprintf(line, sizeof(line), "%-26s", "threads");
+		for (c = 0; (c < n_cols) && (pos < sizeof(line)); c++)
+			pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %8zu", cols[c]);
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+		for (m = 0; m < RSEQ_BENCH_METHODS; m++) {
+			pos = (size_t)snprintf(line, sizeof(line), "%-26s", rseq_bench_methods[m]);
+			for (c = 0; (c < n_cols) && (pos < sizeof(line)); c++) {
+				const stress_rseq_bench_result_t *r = &results[p][m][c];
+
+				if (r->duration > 0.0)
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %8.2f",
+						r->ops / r->duration / 1000000.0);
+				else
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %8s", "n/a");
+			}
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+		for (m = 0; m < RSEQ_BENCH_METHODS; m++) {
+			if ((m != RSEQ_BENCH_COUNTER_RSEQ) && (m != RSEQ_BENCH_LIST_RSEQ))
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s aborts/Mop", rseq_bench_methods[m]);
+			pos = (size_t)snprintf(line, sizeof(line), "%-26s", desc);
+			for (c = 0; (c < n_cols) && (pos < sizeof(line)); c++) {
+				const stress_rseq_bench_result_t *r = &results[p][m][c];
+
+				if (r->ops > 0.0)
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %8.1f",
+						r->aborts * 1000000.0 / r->ops);
+				else
+					pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %8s", "n/a");
+			}
+			pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+		}
+	}
+	pr_unlock(&lock);
+
+stats:
+	/* throughput at the most threads without preemption, rseq aborts per rate */
+	c = n_cols - 1;
+	for (m = 0; m < RSEQ_BENCH_METHODS; m++) {
+		const stress_rseq_bench_result_t *r = &results[0][m][c];
+
+		(void)snprintf(desc, sizeof(desc), "%s Mops/sec", rseq_bench_methods[m]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			(r->duration > 0.0) ? r->ops / r->duration / 1000000.0 : 0.0);
+	}
+	for (p = 0; p < RSEQ_BENCH_PREEMPTS; p++) {
+		const stress_rseq_bench_result_t *r = &results[p][RSEQ_BENCH_COUNTER_RSEQ][c];
+
+		if (preempt_us[p])
+			(void)snprintf(desc, sizeof(desc), "rseq aborts/Mop @%" PRIu64 "us", preempt_us[p]);
+		else
+			(void)snprintf(desc, sizeof(desc), "rseq aborts/Mop, no preempt");
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			(r->ops > 0.0) ? r->aborts * 1000000.0 / r->ops : 0.0);
+	}
+}
+
+/*
+ *  stress_rseq_bench()
+ *	compare rseq per cpu counters and freelists with atomic and thread
+ *	local alternatives over thread counts and preemption rates, one
+ *	bogo op per measurement
+ */
+static int stress_rseq_bench(const stress_args_t *args)
+{
+	static stress_rseq_bench_result_t results[RSEQ_BENCH_PREEMPTS][RSEQ_BENCH_METHODS][RSEQ_BENCH_COLS];
+	const int32_t cpus_online = stress_get_processors_online();
+	const int32_t cpus_configured = stress_get_processors_configured();
+	stress_rseq_bench_t *bench;
+	stress_rseq_thread_t *threads;
+	pthread_t *preempters;
+	size_t rseq_threads = (size_t)STRESS_MAXIMUM(2, 2 * cpus_online);
+	uint64_t rseq_preempt = DEFAULT_RSEQ_PREEMPT;
+	uint64_t preempt_us[RSEQ_BENCH_PREEMPTS];
+	size_t cols[RSEQ_BENCH_COLS], n_cols = 0, n, p, m, c, n_preempters;
+	int rc = EXIT_SUCCESS, rseq_err = 0;
+
+	(void)stress_get_setting("rseq-threads", &rseq_threads);
+	(void)stress_get_setting("rseq-preempt", &rseq_preempt);
+	preempt_us[0] = 0;
+	preempt_us[1] = rseq_preempt * 10;
+	preempt_us[2] = rseq_preempt;
+
+	for (n = 1; (n < rseq_threads) && (n_cols < RSEQ_BENCH_COLS - 1); n <<= 1)
+		cols[n_cols++] = n;
+	cols[n_cols++] = rseq_threads;
+	n_preempters = (size_t)STRESS_MAXIMUM(1, cpus_online);
+
+	(void)memset(results, 0, sizeof(results));
+	bench = calloc(1, sizeof(*bench));
+	threads = calloc(rseq_threads, sizeof(*threads));
+	preempters = calloc(n_preempters, sizeof(*preempters));
+	if (!bench || !threads || !preempters) {
+		pr_inf("%s: cannot allocate benchmark data, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_bench;
+	}
+	bench->cpus = (size_t)STRESS_MAXIMUM(1, cpus_configured);
+	bench->n_nodes = STRESS_MAXIMUM(bench->cpus, rseq_threads) * RSEQ_BENCH_NODES;
+	bench->slots = calloc(bench->cpus, sizeof(*bench->slots));
+	bench->nodes = calloc(bench->n_nodes, sizeof(*bench->nodes));
+	if (!bench->slots || !bench->nodes) {
+		pr_inf("%s: cannot allocate benchmark data, skipping stressor\n", args->name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_slots;
+	}
+	(void)pthread_mutex_init(&bench->lock, NULL);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (p = 0; p < RSEQ_BENCH_PREEMPTS; p++) {
+			bench->preempt_ns = preempt_us[p] * 1000;
+			for (c = 0; c < n_cols; c++) {
+				for (m = 0; m < RSEQ_BENCH_METHODS; m++) {
+					if (!keep_stressing(args))
+						goto report;
+					bench->method = (int)m;
+					rc = stress_rseq_bench_measure(args, bench, threads, cols[c],
+						preempters, n_preempters, &results[p][m][c], &rseq_err);
+					if (rc != EXIT_SUCCESS)
+						goto report;
+				}
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (rseq_err && (args->instance == 0))
+		pr_inf("%s: cannot register rseq, errno=%d (%s), rseq methods not measured\n",
+			args->name, rseq_err, strerror(rseq_err));
+	stress_rseq_bench_report(args, results, cols, n_cols, preempt_us);
+	(void)pthread_mutex_destroy(&bench->lock);
+free_slots:
+	free(bench->nodes);
+	free(bench->slots);
+free_bench:
+	free(preempters);
+	free(threads);
+	free(bench);
+
+	return rc;
+}
+#endif
+
 /*
  *  Sanity check of the rseq system call is available
  */
@@ -201,6 +947,22 @@ static int stress_rseq_supported(const char *name)
 {
 	uint32_t signature;
 
+#if defined(STRESS_RSEQ_BENCH)
+	bool rseq_bench = false;
+
+	(void)stress_get_setting("rseq-bench", &rseq_bench);
+	if (rseq_bench) {
+		bool registered;
+
+		if (!stress_rseq_bench_area(&registered)) {
+			pr_inf_skip("%s stressor will be skipped, cannot obtain an rseq area, errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			return -1;
+		}
+		stress_rseq_bench_area_free(registered);
+		return 0;
+	}
+#endif
 	rseq_test(-1, &signature);
 	if (rseq_register(&restartable_seq, signature) < 0) {
 		if (errno == ENOSYS) {
@@ -310,6 +1072,13 @@ unreg:
 static int stress_rseq(const stress_args_t *args)
 {
 	int ret;
+#if defined(STRESS_RSEQ_BENCH)
+	bool rseq_bench = false;
+
+	(void)stress_get_setting("rseq-bench", &rseq_bench);
+	if (rseq_bench)
+		return stress_rseq_bench(args);
+#endif
 
 	/*
 	 *  rseq_info is in a shared page to avoid losing the
@@ -346,12 +1115,14 @@ stressor_info_t stress_rseq_info = {
 	.stressor = stress_rseq,
 	.supported = stress_rseq_supported,
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_rseq_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -27,9 +27,82 @@
 static const stress_help_t help[] = {
 	{ NULL,	"schedpolicy N",	"start N workers that exercise scheduling policy" },
 	{ NULL,	"schedpolicy-ops N",	"stop after N scheduling policy bogo operations" },
+	{ NULL,	"schedpolicy-bench",	"measure wakeup latency of a periodic task per policy" },
+	{ NULL,	"schedpolicy-hogs N",	"run N cpu hogs against the periodic task" },
+	{ NULL,	"schedpolicy-period N",	"wake the periodic task every N microseconds" },
+	{ NULL,	"schedpolicy-uclamp N",	"set the periodic task minimum utilization clamp" },
+	{ NULL,	"schedpolicy-work N",	"busy the periodic task N microseconds per period" },
 	{ NULL,	NULL,			NULL }
 };
 
+#define MIN_SCHEDPOLICY_HOGS		(0)
+#define MAX_SCHEDPOLICY_HOGS		(4096)
+#define MIN_SCHEDPOLICY_PERIOD		(1)
+#define MAX_SCHEDPOLICY_PERIOD		(1000000)
+#define DEFAULT_SCHEDPOLICY_PERIOD	(1000)
+#define MIN_SCHEDPOLICY_WORK		(0)
+#define MAX_SCHEDPOLICY_WORK		(1000000)
+#define DEFAULT_SCHEDPOLICY_WORK	(100)
+#define MIN_SCHEDPOLICY_UCLAMP		(0)
+#define MAX_SCHEDPOLICY_UCLAMP		(1024)
+
+static int stress_set_schedpolicy_bench(const char *opt)
+{
+	bool schedpolicy_bench = true;
+
+	(void)opt;
+	return stress_set_setting("schedpolicy-bench", TYPE_ID_BOOL, &schedpolicy_bench);
+}
+
+static int stress_set_schedpolicy_hogs(const char *opt)
+{
+	size_t schedpolicy_hogs;
+
+	schedpolicy_hogs = (size_t)stress_get_uint64(opt);
+	stress_check_range("schedpolicy-hogs", (uint64_t)schedpolicy_hogs,
+		MIN_SCHEDPOLICY_HOGS, MAX_SCHEDPOLICY_HOGS);
+	return stress_set_setting("schedpolicy-hogs", TYPE_ID_SIZE_T, &schedpolicy_hogs);
+}
+
+static int stress_set_schedpolicy_period(const char *opt)
+{
+	uint64_t schedpolicy_period;
+
+	schedpolicy_period = stress_get_uint64(opt);
+	stress_check_range("schedpolicy-period", schedpolicy_period,
+		MIN_SCHEDPOLICY_PERIOD, MAX_SCHEDPOLICY_PERIOD);
+	return stress_set_setting("schedpolicy-period", TYPE_ID_UINT64, &schedpolicy_period);
+}
+
+static int stress_set_schedpolicy_uclamp(const char *opt)
+{
+	int32_t schedpolicy_uclamp;
+
+	schedpolicy_uclamp = (int32_t)stress_get_uint64(opt);
+	stress_check_range("schedpolicy-uclamp", (uint64_t)schedpolicy_uclamp,
+		MIN_SCHEDPOLICY_UCLAMP, MAX_SCHEDPOLICY_UCLAMP);
+	return stress_set_setting("schedpolicy-uclamp", TYPE_ID_INT32, &schedpolicy_uclamp);
+}
+
+static int stress_set_schedpolicy_work(const char *opt)
+{
+	uint64_t schedpolicy_work;
+
+	schedpolicy_work = stress_get_uint64(opt);
+	stress_check_range("schedpolicy-work", schedpolicy_work,
+		MIN_SCHEDPOLICY_WORK, MAX_SCHEDPOLICY_WORK);
+	return stress_set_setting("schedpolicy-work", TYPE_ID_UINT64, &schedpolicy_work);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_schedpolicy_bench,	stress_set_schedpolicy_bench },
+	{ OPT_schedpolicy_hogs,		stress_set_schedpolicy_hogs },
+	{ OPT_schedpolicy_period,	stress_set_schedpolicy_period },
+	{ OPT_schedpolicy_uclamp,	stress_set_schedpolicy_uclamp },
+	{ OPT_schedpolicy_work,		stress_set_schedpolicy_work },
+	{ 0,				NULL }
+};
+
 #if (defined(_POSIX_PRIORITY_SCHEDULING) || defined(__linux__)) &&	\
      !defined(__OpenBSD__) &&						\
      !defined(__minix__) &&						\
@@ -56,9 +129,532 @@ static const int policies[] = {
 #endif
 };
 
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(HAVE_CLOCK_NANOSLEEP) &&	\
+    defined(HAVE_WAIT4) &&		\
+    defined(CLOCK_MONOTONIC) &&		\
+    defined(TIMER_ABSTIME)
+#define STRESS_SCHEDPOLICY_BENCH
+#endif
+
+#if defined(STRESS_SCHEDPOLICY_BENCH)
+
+#define SCHEDPOLICY_SLICE	(1.0)	/* seconds per policy measurement */
+#define SCHEDPOLICY_LAT_SUB	(4)	/* histogram buckets per power of 2 */
+#define SCHEDPOLICY_LAT_BUCKETS	(64 * SCHEDPOLICY_LAT_SUB)
+
+/* sched_setattr flags, SCHED_FLAG_KEEP_POLICY | KEEP_PARAMS | UTIL_CLAMP_MIN */
+#define SCHEDPOLICY_UCLAMP_FLAGS (0x08 | 0x10 | 0x20)
+
+/* measurements of the periodic task, shared with the task process */
+typedef struct {
+	uint64_t lat[SCHEDPOLICY_LAT_BUCKETS];	/* wakeup latency histogram */
+	uint64_t wakeups;
+	uint64_t max;			/* maximum wakeup latency, ns */
+	uint64_t jobs;			/* periods that were due */
+	uint64_t misses;		/* jobs not done by the end of their period */
+	int err;			/* errno of a failed policy change */
+	int uclamp_err;			/* errno of a failed uclamp change */
+} stress_schedpolicy_task_t;
+
+/* totals of a policy */
+typedef struct {
+	stress_schedpolicy_task_t task;
+	double duration;
+	double task_cpu;		/* cpu seconds of the periodic task */
+	double hog_cpu;			/* cpu seconds of the hogs */
+	bool unsupported;
+} stress_schedpolicy_stats_t;
+
+/*
+ *  stress_schedpolicy_now_ns()
+ *	monotonic time in nanoseconds
+ */
+static inline uint64_t stress_schedpolicy_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * STRESS_NANOSECOND) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  stress_schedpolicy_lat_add()
+ *	add a latency in nanoseconds to a log2 histogram with
+ *	SCHEDPOLICY_LAT_SUB buckets per power of 2
+ */
+static void stress_schedpolicy_lat_add(stress_schedpolicy_task_t *task, const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0, bucket;
+
+	if (ns < SCHEDPOLICY_LAT_SUB) {
+		bucket = (size_t)ns;
+	} else {
+		for (v = ns; v > 1; v >>= 1)
+			msb++;
+		bucket = ((msb - 1) * SCHEDPOLICY_LAT_SUB) +
+			(size_t)((ns >> (msb - 2)) & (SCHEDPOLICY_LAT_SUB - 1));
+	}
+	task->lat[bucket]++;
+	task->wakeups++;
+	if (ns > task->max)
+		task->max = ns;
+}
+
+/*
+ *  stress_schedpolicy_percentile()
+ *	wakeup latency in microseconds below which pct percent of the
+ *	wakeups are, the upper bound of the histogram bucket
+ *	clamped to the maximum
+ */
+static double stress_schedpolicy_percentile(const stress_schedpolicy_task_t *task, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)task->wakeups * pct) / 100.0);
+	uint64_t sum = 0, ns;
+	size_t i;
+
+	for (i = 0; i < SCHEDPOLICY_LAT_BUCKETS; i++) {
+		sum += task->lat[i];
+		if (sum > target)
+			break;
+	}
+	if (i >= SCHEDPOLICY_LAT_BUCKETS)
+		return 0.0;
+	if (i < SCHEDPOLICY_LAT_SUB) {
+		ns = (uint64_t)i;
+	} else {
+		const size_t msb = (i / SCHEDPOLICY_LAT_SUB) + 1;
+		const uint64_t sub = (uint64_t)(i % SCHEDPOLICY_LAT_SUB);
+
+		ns = ((SCHEDPOLICY_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+	}
+	/* The bucket bound can exceed the slowest wakeup itself */
+	return (double)STRESS_MINIMUM(ns, task->max) / 1000.0;
+}
+
+/*
+ *  stress_schedpolicy_set()
+ *	switch the calling process to policy, SCHED_DEADLINE gets a
+ *	reservation of twice the work each period
+ */
+static int stress_schedpolicy_set(
+	const int policy,
+	const uint64_t period_ns,
+	const uint64_t work_ns)
+{
+	struct sched_param param;
+	int min_prio, max_prio;
+
+	(void)period_ns;
+	(void)work_ns;
+
+	(void)memset(&param, 0, sizeof(param));
+	switch (policy) {
+#if defined(SCHED_DEADLINE) &&	\
+    defined(__NR_sched_setattr)
+	case SCHED_DEADLINE:
+		{
+			struct shim_sched_attr attr;
+
+			(void)memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.sched_policy = SCHED_DEADLINE;
+			attr.sched_runtime = STRESS_MINIMUM(period_ns, 2 * work_ns);
+			attr.sched_deadline = period_ns;
+			attr.sched_period = period_ns;
+			return shim_sched_setattr(0, &attr, 0);
+		}
+#endif
+#if defined(SCHED_FIFO)
+	case SCHED_FIFO:
+#endif
+#if defined(SCHED_RR)
+	case SCHED_RR:
+#endif
+#if defined(SCHED_FIFO) || defined(SCHED_RR)
+		min_prio = sched_get_priority_min(policy);
+		max_prio = sched_get_priority_max(policy);
+		if ((min_prio < 0) || (max_prio < 0)) {
+			errno = EINVAL;
+			return -1;
+		}
+		param.sched_priority = min_prio + ((max_prio - min_prio) / 2);
+		return sched_setscheduler(0, policy, &param);
+#endif
+	default:
+		break;
+	}
+	(void)min_prio;
+	(void)max_prio;
+#if defined(SCHED_DEADLINE) &&	\
+    !defined(__NR_sched_setattr)
+	if (policy == SCHED_DEADLINE) {
+		errno = ENOSYS;
+		return -1;
+	}
+#endif
+	return sched_setscheduler(0, policy, &param);
+}
+
+/*
+ *  stress_schedpolicy_hog()
+ *	cpu hog competing with the periodic task
+ */
+static void NORETURN stress_schedpolicy_hog(void)
+{
+	for (;;) {
+		register int i;
+
+		for (i = 0; i < 1000000; i++)
+			shim_mb();
+		if (!keep_stressing_flag())
+			_exit(EXIT_SUCCESS);
+	}
+}
+
+/*
+ *  stress_schedpolicy_periodic()
+ *	the latency sensitive task: wake every period, busy for work and
+ *	sleep until the next period, until t_end
+ */
+static void NORETURN stress_schedpolicy_periodic(
+	const int policy,
+	const uint64_t period_ns,
+	const uint64_t work_ns,
+	const int32_t uclamp,
+	const uint64_t t_end,
+	stress_schedpolicy_task_t *task)
+{
+	uint64_t next;
+
+	if (stress_schedpolicy_set(policy, period_ns, work_ns) < 0) {
+		task->err = errno;
+		_exit(EXIT_NOT_IMPLEMENTED);
+	}
+	if (uclamp >= 0) {
+#if defined(__NR_sched_setattr)
+		struct shim_sched_attr attr;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.sched_policy = (uint32_t)policy;
+		attr.sched_flags = SCHEDPOLICY_UCLAMP_FLAGS;
+		attr.sched_util_min = (uint32_t)uclamp;
+		if (shim_sched_setattr(0, &attr, 0) < 0)
+			task->uclamp_err = errno;
+#else
+		task->uclamp_err = ENOSYS;
+#endif
+	}
+
+	next = stress_schedpolicy_now_ns() + period_ns;
+	while (next < t_end) {
+		struct timespec ts;
+		uint64_t woke, done;
+
+		ts.tv_sec = (time_t)(next / STRESS_NANOSECOND);
+		ts.tv_nsec = (long)(next % STRESS_NANOSECOND);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+			if (!keep_stressing_flag())
+				_exit(EXIT_SUCCESS);
+		}
+		woke = stress_schedpolicy_now_ns();
+		stress_schedpolicy_lat_add(task, woke - next);
+
+		do {
+			shim_mb();
+			done = stress_schedpolicy_now_ns();
+		} while (done < woke + work_ns);
+
+		/* A job is due every period, late ones and skipped ones are misses */
+		task->jobs++;
+		if (done > next + period_ns)
+			task->misses++;
+		next += period_ns;
+		while (next + period_ns <= done) {
+			task->jobs++;
+			task->misses++;
+			next += period_ns;
+		}
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_schedpolicy_spawn()
+ *	fork a hog, or the periodic task if task is non-NULL
+ */
+static pid_t stress_schedpolicy_spawn(
+	const int policy,
+	const uint64_t period_ns,
+	const uint64_t work_ns,
+	const int32_t uclamp,
+	const uint64_t t_end,
+	stress_schedpolicy_task_t *task)
+{
+	pid_t pid;
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (stress_redo_fork(errno))
+			goto again;
+		return -1;
+	}
+	if (pid == 0) {
+		(void)setpgid(0, g_pgrp);
+		stress_parent_died_alarm();
+		if (task)
+			stress_schedpolicy_periodic(policy, period_ns, work_ns, uclamp, t_end, task);
+		stress_schedpolicy_hog();
+	}
+	(void)setpgid(pid, g_pgrp);
+	return pid;
+}
+
+/*
+ *  stress_schedpolicy_cpu()
+ *	cpu seconds of a reaped child
+ */
+static inline double stress_schedpolicy_cpu(const struct rusage *usage)
+{
+	return (double)usage->ru_utime.tv_sec + ((double)usage->ru_utime.tv_usec / 1000000.0) +
+	       (double)usage->ru_stime.tv_sec + ((double)usage->ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_schedpolicy_measure()
+ *	run the periodic task under policy alongside the hogs for
+ *	SCHEDPOLICY_SLICE seconds and add the results to stats
+ */
+static int stress_schedpolicy_measure(
+	const stress_args_t *args,
+	const int policy,
+	const size_t hogs,
+	const uint64_t period_ns,
+	const uint64_t work_ns,
+	const int32_t uclamp,
+	stress_schedpolicy_task_t *task,
+	stress_schedpolicy_stats_t *stats)
+{
+	pid_t *pids, pid;
+	struct rusage usage;
+	int status = 0, rc = EXIT_SUCCESS;
+	double t_start, hog_cpu = 0.0;
+	bool measured = false;
+	uint64_t t_end;
+	size_t i, j;
+
+	pids = (pid_t *)calloc(hogs + 1, sizeof(*pids));
+	if (!pids)
+		return EXIT_NO_RESOURCE;
+	(void)memset(task, 0, sizeof(*task));
+
+	for (i = 0; i < hogs; i++) {
+		pids[i] = stress_schedpolicy_spawn(policy, period_ns, work_ns, uclamp, 0, NULL);
+		if (pids[i] < 0) {
+			rc = EXIT_NO_RESOURCE;
+			goto reap;
+		}
+	}
+	t_start = stress_time_now();
+	t_end = stress_schedpolicy_now_ns() + (uint64_t)(SCHEDPOLICY_SLICE * STRESS_NANOSECOND);
+	pid = stress_schedpolicy_spawn(policy, period_ns, work_ns, uclamp, t_end, task);
+	if (pid < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto reap;
+	}
+
+	(void)memset(&usage, 0, sizeof(usage));
+	while (shim_wait4(pid, &status, 0, &usage) < 0) {
+		if (errno != EINTR) {
+			status = 0;
+			break;
+		}
+		/* Interrupted by the end of the run, stop the task too */
+		if (!keep_stressing(args))
+			(void)kill(pid, SIGKILL);
+	}
+	if (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_NOT_IMPLEMENTED)) {
+		if (args->instance == 0)
+			pr_inf("%s: cannot use policy %s, errno=%d (%s), skipping it\n",
+				args->name, stress_get_sched_name(policy),
+				task->err, strerror(task->err));
+		stats->unsupported = true;
+		goto reap;
+	}
+	if (WIFSIGNALED(status) || !keep_stressing(args))
+		goto reap;
+
+	stats->duration += stress_time_now() - t_start;
+	stats->task_cpu += stress_schedpolicy_cpu(&usage);
+	stats->task.wakeups += task->wakeups;
+	stats->task.jobs += task->jobs;
+	stats->task.misses += task->misses;
+	if (task->max > stats->task.max)
+		stats->task.max = task->max;
+	for (j = 0; j < SCHEDPOLICY_LAT_BUCKETS; j++)
+		stats->task.lat[j] += task->lat[j];
+	if (task->uclamp_err && !stats->task.uclamp_err) {
+		stats->task.uclamp_err = task->uclamp_err;
+		if (args->instance == 0)
+			pr_inf("%s: cannot set uclamp of policy %s, errno=%d (%s)\n",
+				args->name, stress_get_sched_name(policy),
+				task->uclamp_err, strerror(task->uclamp_err));
+	}
+	measured = true;
+	inc_counter(args);
+
+reap:
+	for (j = 0; j < i; j++)
+		(void)kill(pids[j], SIGKILL);
+	for (j = 0; j < i; j++) {
+		(void)memset(&usage, 0, sizeof(usage));
+		if (shim_wait4(pids[j], &status, 0, &usage) >= 0)
+			hog_cpu += stress_schedpolicy_cpu(&usage);
+	}
+	if (measured)
+		stats->hog_cpu += hog_cpu;
+	free(pids);
+	return rc;
+}
+
+/*
+ *  stress_schedpolicy_report()
+ *	report the wakeup latency, misses and cpu share under each policy
+ */
+static void stress_schedpolicy_report(
+	const stress_args_t *args,
+	const stress_schedpolicy_stats_t *stats,
+	const size_t hogs,
+	const uint64_t period_ns,
+	const uint64_t work_ns)
+{
+	bool lock = false;
+	size_t i;
+	int idx = 0;
+	char desc[64];
+
+	if (args->instance != 0)
+		goto stats;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %" PRIu64 "us work every %" PRIu64 "us, %zu cpu hogs\n",
+		args->name, work_ns / 1000, period_ns / 1000, hogs);
+	pr_inf_lock(&lock, "%s: %-14s %9s %9s %9s %9s %9s %7s %7s\n", args->name,
+		"policy", "wakeups", "p50 usec", "p99 usec", "max usec",
+		"missed%", "share%", "hogcpus");
+	for (i = 0; i < SIZEOF_ARRAY(policies); i++) {
+		const stress_schedpolicy_stats_t *s = &stats[i];
+		const double cpu = s->task_cpu + s->hog_cpu;
+
+		if (s->duration <= 0.0)
+			continue;
+		pr_inf_lock(&lock, "%s: %-14s %9" PRIu64 " %9.1f %9.1f %9.1f %9.2f %7.2f %7.2f\n",
+			args->name, stress_get_sched_name(policies[i]), s->task.wakeups,
+			stress_schedpolicy_percentile(&s->task, 50.0),
+			stress_schedpolicy_percentile(&s->task, 99.0),
+			(double)s->task.max / 1000.0,
+			s->task.jobs ? 100.0 * (double)s->task.misses / (double)s->task.jobs : 0.0,
+			(cpu > 0.0) ? 100.0 * s->task_cpu / cpu : 0.0,
+			s->hog_cpu / s->duration);
+	}
+	pr_unlock(&lock);
+
+stats:
+	/* p99 of every policy, then the misses from SCHED_DEADLINE down */
+	for (i = 0; i < SIZEOF_ARRAY(policies); i++) {
+		const stress_schedpolicy_stats_t *s = &stats[i];
+
+		if (s->duration <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s p99 usec", stress_get_sched_name(policies[i]));
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			stress_schedpolicy_percentile(&s->task, 99.0));
+	}
+	for (i = SIZEOF_ARRAY(policies); (i > 0) && (idx < 10); i--) {
+		const stress_schedpolicy_stats_t *s = &stats[i - 1];
+
+		if (s->duration <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s missed %%", stress_get_sched_name(policies[i - 1]));
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			s->task.jobs ? 100.0 * (double)s->task.misses / (double)s->task.jobs : 0.0);
+	}
+}
+
+/*
+ *  stress_schedpolicy_bench()
+ *	measure what each policy delivers to a periodic task competing
+ *	with cpu hogs, one bogo op per policy measurement
+ */
+static int stress_schedpolicy_bench(const stress_args_t *args)
+{
+	stress_schedpolicy_stats_t *stats;
+	stress_schedpolicy_task_t *task;
+	size_t hogs = (size_t)stress_get_processors_online();
+	uint64_t period = DEFAULT_SCHEDPOLICY_PERIOD;
+	uint64_t work = DEFAULT_SCHEDPOLICY_WORK;
+	int32_t uclamp = -1;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("schedpolicy-hogs", &hogs);
+	(void)stress_get_setting("schedpolicy-period", &period);
+	(void)stress_get_setting("schedpolicy-work", &work);
+	(void)stress_get_setting("schedpolicy-uclamp", &uclamp);
+	if (work > period) {
+		if (args->instance == 0)
+			pr_inf("%s: work of %" PRIu64 "us exceeds the period of %" PRIu64
+				"us, using the period\n", args->name, work, period);
+		work = period;
+	}
+
+	task = (stress_schedpolicy_task_t *)mmap(NULL, sizeof(*task),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (task == MAP_FAILED) {
+		pr_inf("%s: cannot mmap results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	stats = (stress_schedpolicy_stats_t *)calloc(SIZEOF_ARRAY(policies), sizeof(*stats));
+	if (!stats) {
+		(void)munmap((void *)task, sizeof(*task));
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		bool measured = false;
+
+		for (i = 0; keep_stressing(args) && (i < SIZEOF_ARRAY(policies)); i++) {
+			if (stats[i].unsupported)
+				continue;
+			rc = stress_schedpolicy_measure(args, policies[i], hogs,
+				period * 1000, work * 1000, uclamp, task, &stats[i]);
+			if (rc != EXIT_SUCCESS)
+				goto report;
+			measured |= !stats[i].unsupported;
+		}
+		if (!measured) {
+			rc = EXIT_NOT_IMPLEMENTED;
+			break;
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_schedpolicy_report(args, stats, hogs, period * 1000, work * 1000);
+	free(stats);
+	(void)munmap((void *)task, sizeof(*task));
+	return rc;
+}
+#endif
+
 static int stress_schedpolicy(const stress_args_t *args)
 {
 	int policy = 0;
+	bool schedpolicy_bench = false;
 #if defined(_POSIX_PRIORITY_SCHEDULING)
 	const bool root_or_nice_capability = stress_check_capability(SHIM_CAP_SYS_NICE);
 #endif
@@ -82,6 +678,18 @@ static int stress_schedpolicy(const stress_args_t *args)
 		return EXIT_NOT_IMPLEMENTED;
 	}
 
+	(void)stress_get_setting("schedpolicy-bench", &schedpolicy_bench);
+	if (schedpolicy_bench) {
+#if defined(STRESS_SCHEDPOLICY_BENCH)
+		return stress_schedpolicy_bench(args);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --schedpolicy-bench is not supported "
+				"on this system, skipping test\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -378,12 +986,14 @@ static int stress_schedpolicy(const stress_args_t *args)
 stressor_info_t stress_schedpolicy_info = {
 	.stressor = stress_schedpolicy,
 	.class = CLASS_INTERRUPT | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_schedpolicy_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_INTERRUPT | CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -37,8 +37,12 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ NULL,	"skiplist N",	  "start N workers that exercise a skiplist search" },
+	{ NULL,	"skiplist-method M", "concurrent structure: skiplist, hash or all" },
 	{ NULL,	"skiplist-ops N", "stop after N skiplist search bogo operations" },
+	{ NULL,	"skiplist-read P", "percentage of concurrent lookups, the rest insert or delete" },
 	{ NULL,	"skiplist-size N", "number of 32 bit integers to add to skiplist" },
+	{ NULL,	"skiplist-skew P", "percentage of concurrent operations on the 1% hot keys" },
+	{ NULL,	"skiplist-threads N", "share lock-free structures between N threads" },
 	{ NULL,	NULL,		  NULL }
 };
 
@@ -56,6 +60,87 @@ static int stress_set_skiplist_size(const char *opt)
 	return stress_set_setting("skiplist-size", TYPE_ID_UINT64, &skiplist_size);
 }
 
+#define MIN_SKIPLIST_THREADS	(1)
+#define MAX_SKIPLIST_THREADS	(256)
+
+#define SKIPLIST_METHOD_ALL	(0)
+#define SKIPLIST_METHOD_SKIPLIST (1)	/* lock-free skiplist */
+#define SKIPLIST_METHOD_HASH	(2)	/* lock-free chained hash map */
+
+/* indexed by SKIPLIST_METHOD_* - 1 */
+static const char * const skiplist_methods[] = {
+	"skiplist",
+	"hash",
+};
+
+#define SKIPLIST_METHODS	(SIZEOF_ARRAY(skiplist_methods))
+
+/*
+ *  stress_set_skiplist_threads()
+ *	set number of threads of the concurrent mode
+ */
+static int stress_set_skiplist_threads(const char *opt)
+{
+	size_t skiplist_threads;
+
+	skiplist_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("skiplist-threads", (uint64_t)skiplist_threads,
+		MIN_SKIPLIST_THREADS, MAX_SKIPLIST_THREADS);
+	return stress_set_setting("skiplist-threads", TYPE_ID_SIZE_T, &skiplist_threads);
+}
+
+/*
+ *  stress_set_skiplist_method()
+ *	set the concurrent data structure(s) to exercise
+ */
+static int stress_set_skiplist_method(const char *opt)
+{
+	size_t i;
+	int skiplist_method;
+
+	if (!strcmp(opt, "all")) {
+		skiplist_method = SKIPLIST_METHOD_ALL;
+		return stress_set_setting("skiplist-method", TYPE_ID_INT, &skiplist_method);
+	}
+	for (i = 0; i < SKIPLIST_METHODS; i++) {
+		if (!strcmp(opt, skiplist_methods[i])) {
+			skiplist_method = (int)i + 1;
+			return stress_set_setting("skiplist-method", TYPE_ID_INT, &skiplist_method);
+		}
+	}
+	(void)fprintf(stderr, "skiplist-method must be one of: all");
+	for (i = 0; i < SKIPLIST_METHODS; i++)
+		(void)fprintf(stderr, " %s", skiplist_methods[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_skiplist_read()
+ *	set percentage of lookups of the concurrent mode
+ */
+static int stress_set_skiplist_read(const char *opt)
+{
+	uint32_t skiplist_read;
+
+	skiplist_read = stress_get_uint32(opt);
+	stress_check_range("skiplist-read", (uint64_t)skiplist_read, 0, 100);
+	return stress_set_setting("skiplist-read", TYPE_ID_UINT32, &skiplist_read);
+}
+
+/*
+ *  stress_set_skiplist_skew()
+ *	set percentage of concurrent mode operations on the hot keys
+ */
+static int stress_set_skiplist_skew(const char *opt)
+{
+	uint32_t skiplist_skew;
+
+	skiplist_skew = stress_get_uint32(opt);
+	stress_check_range("skiplist-skew", (uint64_t)skiplist_skew, 0, 100);
+	return stress_set_setting("skiplist-skew", TYPE_ID_UINT32, &skiplist_skew);
+}
+
 /*
  *  skip_list_random_level()
  *	generate a quasi-random skip list level
@@ -199,6 +284,848 @@ static void skip_list_free(skip_list_t *list)
 		free(skip_node);
 }
 
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_ATOMIC_FETCH_ADD) &&	\
+    defined(HAVE_ATOMIC_FETCH_OR) &&	\
+    defined(HAVE_ATOMIC_LOAD) &&	\
+    defined(HAVE_ATOMIC_STORE)
+#define STRESS_SKIPLIST_CONCURRENT
+#endif
+
+#if defined(STRESS_SKIPLIST_CONCURRENT)
+
+#define CC_MAX_LEVEL		(32)
+#define CC_SLICE		(0.5)	/* seconds per measurement */
+#define CC_QUIESCE_OPS		(64)	/* ops between quiescent states */
+
+/* the low bit of a next pointer marks its node as deleted at that level */
+#define CC_MARKED(p)		((p) & (uintptr_t)1)
+#define CC_PTR(p)		((cc_node_t *)((p) & ~(uintptr_t)1))
+
+typedef struct cc_node {
+	unsigned long key;
+	struct cc_node *retired;	/* limbo list of the retiring thread */
+	uint64_t epoch;			/* reclamation epoch it was retired in */
+	uint32_t done;			/* skiplist insert and delete completions */
+	uint32_t levels;
+	uintptr_t next[1];		/* one per level, hash map nodes have one */
+} cc_node_t;
+
+typedef struct {
+	uint64_t epoch;			/* last epoch the thread was quiescent in */
+} ALIGN64 cc_epoch_t;
+
+/* state shared by the concurrent mode threads */
+typedef struct {
+	int method;			/* SKIPLIST_METHOD_* */
+	size_t threads;
+	unsigned long keys;		/* keys are 1..keys */
+	unsigned long hot_keys;		/* keys 1..hot_keys are the hot keys */
+	uint32_t read_pct;
+	uint32_t skew_pct;
+	size_t max_level;		/* skiplist only */
+	cc_node_t *head;		/* skiplist sentinels */
+	cc_node_t *tail;
+	uintptr_t *buckets;		/* hash map only */
+	unsigned int hash_shift;
+	unsigned long n_buckets;
+	cc_epoch_t *epochs;		/* per thread */
+	uint64_t epoch ALIGN64;		/* global reclamation epoch */
+	bool go ALIGN64;
+	bool stop;
+} cc_map_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	cc_map_t *map;
+	size_t id;
+	uint64_t seed;
+	uint64_t ops;
+	uint64_t inserted;		/* successful inserts */
+	uint64_t deleted;		/* successful deletes */
+	cc_node_t *limbo;		/* retired nodes, newest first */
+	int err;
+} ALIGN64 cc_thread_t;
+
+typedef struct {
+	uint64_t ops;
+	double duration;
+} cc_result_t;
+
+static inline uintptr_t cc_load(uintptr_t *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline bool cc_cas(uintptr_t *ptr, uintptr_t old, const uintptr_t new)
+{
+	return __atomic_compare_exchange_n(ptr, &old, new, false,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/*
+ *  cc_rand()
+ *	per thread xorshift64* random number
+ */
+static inline uint64_t cc_rand(uint64_t *seed)
+{
+	register uint64_t x = *seed;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*seed = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/*
+ *  cc_node_alloc()
+ *	allocate a node with levels next pointers
+ */
+static cc_node_t *cc_node_alloc(const unsigned long key, const size_t levels)
+{
+	const size_t sz = sizeof(cc_node_t) + ((levels - 1) * sizeof(uintptr_t));
+	cc_node_t *node;
+
+	node = (cc_node_t *)calloc(1, sz);
+	if (node) {
+		node->key = key;
+		node->levels = (uint32_t)levels;
+	}
+	return node;
+}
+
+/*
+ *  cc_retire()
+ *	queue an unlinked node to be freed once no thread can be accessing it
+ */
+static void cc_retire(cc_thread_t *thread, cc_node_t *node)
+{
+	node->epoch = __atomic_load_n(&thread->map->epoch, __ATOMIC_SEQ_CST);
+	node->retired = thread->limbo;
+	thread->limbo = node;
+}
+
+/*
+ *  cc_free_list()
+ *	free a list of retired nodes
+ */
+static void cc_free_list(cc_node_t *node)
+{
+	while (node) {
+		cc_node_t *next = node->retired;
+
+		free(node);
+		node = next;
+	}
+}
+
+/*
+ *  cc_quiescent()
+ *	the thread holds no node references between operations, so announce
+ *	the current epoch, advance it once all threads have seen it and free
+ *	the nodes retired two or more epochs ago: every thread has finished
+ *	the operations that may have reached them since
+ */
+static void cc_quiescent(cc_thread_t *thread)
+{
+	cc_map_t *map = thread->map;
+	uint64_t epoch = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+	cc_node_t **prev, *node;
+	size_t i;
+
+	__atomic_store_n(&map->epochs[thread->id].epoch, epoch, __ATOMIC_SEQ_CST);
+	for (i = 0; i < map->threads; i++) {
+		if (__atomic_load_n(&map->epochs[i].epoch, __ATOMIC_SEQ_CST) != epoch)
+			break;
+	}
+	if (i == map->threads) {
+		uint64_t expected = epoch;
+
+		if (__atomic_compare_exchange_n(&map->epoch, &expected, epoch + 1,
+			false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			epoch++;
+		else
+			epoch = expected;
+	}
+
+	for (prev = &thread->limbo; *prev; prev = &(*prev)->retired) {
+		if ((*prev)->epoch + 2 <= epoch)
+			break;
+	}
+	node = *prev;
+	*prev = NULL;
+	cc_free_list(node);
+}
+
+/*
+ *  cc_skiplist_find()
+ *	find the predecessors and successors of key on each level, unlinking
+ *	deleted nodes on the way, returns true if the level 0 successor holds
+ *	key. With through set the search runs past nodes holding key too, to
+ *	unlink every deleted node of key from all levels.
+ */
+static bool cc_skiplist_find(
+	cc_map_t *map,
+	const unsigned long key,
+	cc_node_t **preds,
+	cc_node_t **succs,
+	const bool through)
+{
+	cc_node_t *pred, *curr = NULL;
+	int level;
+
+retry:
+	pred = map->head;
+	for (level = (int)map->max_level - 1; level >= 0; level--) {
+		curr = CC_PTR(cc_load(&pred->next[level]));
+		for (;;) {
+			uintptr_t next = cc_load(&curr->next[level]);
+
+			while (CC_MARKED(next)) {
+				if (!cc_cas(&pred->next[level], (uintptr_t)curr, (uintptr_t)CC_PTR(next)))
+					goto retry;
+				curr = CC_PTR(next);
+				next = cc_load(&curr->next[level]);
+			}
+			if ((curr->key < key) || (through && (curr->key == key))) {
+				pred = curr;
+				curr = CC_PTR(next);
+			} else {
+				break;
+			}
+		}
+		if (preds) {
+			preds[level] = pred;
+			succs[level] = curr;
+		}
+	}
+	return curr->key == key;
+}
+
+/*
+ *  cc_skiplist_finish()
+ *	called once by the inserter when it stops linking the node and
+ *	once by the deleter when it has marked it. The second caller knows
+ *	nothing links the deleted node any more, so it unlinks the node
+ *	from every level and retires it.
+ */
+static void cc_skiplist_finish(cc_thread_t *thread, cc_node_t *node)
+{
+	if (__atomic_fetch_add(&node->done, 1, __ATOMIC_SEQ_CST) == 1) {
+		(void)cc_skiplist_find(thread->map, node->key, NULL, NULL, true);
+		cc_retire(thread, node);
+	}
+}
+
+/*
+ *  cc_skiplist_lookup()
+ *	wait-free search for key
+ */
+static bool cc_skiplist_lookup(cc_map_t *map, const unsigned long key)
+{
+	cc_node_t *pred = map->head, *curr = NULL;
+	int level;
+
+	for (level = (int)map->max_level - 1; level >= 0; level--) {
+		curr = CC_PTR(cc_load(&pred->next[level]));
+		for (;;) {
+			uintptr_t next = cc_load(&curr->next[level]);
+
+			while (CC_MARKED(next)) {
+				curr = CC_PTR(next);
+				next = cc_load(&curr->next[level]);
+			}
+			if (curr->key >= key)
+				break;
+			pred = curr;
+			curr = CC_PTR(next);
+		}
+	}
+	return (curr->key == key) && !CC_MARKED(cc_load(&curr->next[0]));
+}
+
+/*
+ *  cc_skiplist_insert()
+ *	insert key, linking the node bottom up, returns false if key
+ *	is already present
+ */
+static bool cc_skiplist_insert(cc_thread_t *thread, const unsigned long key)
+{
+	cc_map_t *map = thread->map;
+	cc_node_t *preds[CC_MAX_LEVEL], *succs[CC_MAX_LEVEL], *node;
+	size_t level, levels = 1;
+	uint64_t r = cc_rand(&thread->seed);
+
+	while ((r & 1) && (levels < map->max_level)) {
+		r >>= 1;
+		levels++;
+	}
+
+	for (;;) {
+		if (cc_skiplist_find(map, key, preds, succs, false))
+			return false;
+		node = cc_node_alloc(key, levels);
+		if (!node) {
+			thread->err = ENOMEM;
+			return false;
+		}
+		for (level = 0; level < levels; level++)
+			node->next[level] = (uintptr_t)succs[level];
+		if (cc_cas(&preds[0]->next[0], (uintptr_t)succs[0], (uintptr_t)node))
+			break;
+		free(node);
+	}
+
+	for (level = 1; level < levels; level++) {
+		for (;;) {
+			const uintptr_t next = cc_load(&node->next[level]);
+
+			/* Stop linking once a deleter has marked the node */
+			if (CC_MARKED(next))
+				goto done;
+			if ((next != (uintptr_t)succs[level]) &&
+			    !cc_cas(&node->next[level], next, (uintptr_t)succs[level]))
+				goto done;
+			if (cc_cas(&preds[level]->next[level], (uintptr_t)succs[level], (uintptr_t)node))
+				break;
+			(void)cc_skiplist_find(map, key, preds, succs, false);
+		}
+	}
+done:
+	cc_skiplist_finish(thread, node);
+	return true;
+}
+
+/*
+ *  cc_skiplist_delete()
+ *	delete key by marking its node top down, the thread that marks
+ *	level 0 owns the delete. Returns false if key is not present.
+ */
+static bool cc_skiplist_delete(cc_thread_t *thread, const unsigned long key)
+{
+	cc_node_t *preds[CC_MAX_LEVEL], *succs[CC_MAX_LEVEL], *node;
+	size_t level;
+
+	if (!cc_skiplist_find(thread->map, key, preds, succs, false))
+		return false;
+	node = succs[0];
+	for (level = node->levels - 1; level > 0; level--)
+		(void)__atomic_fetch_or(&node->next[level], (uintptr_t)1, __ATOMIC_SEQ_CST);
+	if (CC_MARKED(__atomic_fetch_or(&node->next[0], (uintptr_t)1, __ATOMIC_SEQ_CST)))
+		return false;
+	cc_skiplist_finish(thread, node);
+	return true;
+}
+
+/*
+ *  cc_hash_bucket()
+ *	bucket of key, by Fibonacci hashing
+ */
+static inline uintptr_t *cc_hash_bucket(const cc_map_t *map, const unsigned long key)
+{
+	return &map->buckets[((uint64_t)key * 0x9e3779b97f4a7c15ULL) >> map->hash_shift];
+}
+
+/*
+ *  cc_hash_find()
+ *	find the first node of a bucket holding key or more, unlinking and
+ *	retiring deleted nodes on the way, returns true if it holds key
+ */
+static bool cc_hash_find(
+	cc_thread_t *thread,
+	const unsigned long key,
+	uintptr_t **prevp,
+	cc_node_t **currp)
+{
+	uintptr_t *const head = cc_hash_bucket(thread->map, key);
+	uintptr_t *prev;
+	cc_node_t *curr;
+
+retry:
+	prev = head;
+	curr = CC_PTR(cc_load(prev));
+	while (curr) {
+		const uintptr_t next = cc_load(&curr->next[0]);
+
+		if (CC_MARKED(next)) {
+			if (!cc_cas(prev, (uintptr_t)curr, (uintptr_t)CC_PTR(next)))
+				goto retry;
+			cc_retire(thread, curr);
+			curr = CC_PTR(next);
+			continue;
+		}
+		if (curr->key >= key)
+			break;
+		prev = &curr->next[0];
+		curr = CC_PTR(next);
+	}
+	*prevp = prev;
+	*currp = curr;
+	return curr && (curr->key == key);
+}
+
+/*
+ *  cc_hash_lookup()
+ *	wait-free search for key
+ */
+static bool cc_hash_lookup(cc_map_t *map, const unsigned long key)
+{
+	cc_node_t *curr = CC_PTR(cc_load(cc_hash_bucket(map, key)));
+
+	while (curr && (curr->key < key))
+		curr = CC_PTR(cc_load(&curr->next[0]));
+	return curr && (curr->key == key) && !CC_MARKED(cc_load(&curr->next[0]));
+}
+
+/*
+ *  cc_hash_insert()
+ *	insert key, returns false if it is already present
+ */
+static bool cc_hash_insert(cc_thread_t *thread, const unsigned long key)
+{
+	cc_node_t *node = NULL, *curr;
+	uintptr_t *prev;
+
+	for (;;) {
+		if (cc_hash_find(thread, key, &prev, &curr)) {
+			free(node);
+			return false;
+		}
+		if (!node) {
+			node = cc_node_alloc(key, 1);
+			if (!node) {
+				thread->err = ENOMEM;
+				return false;
+			}
+		}
+		node->next[0] = (uintptr_t)curr;
+		if (cc_cas(prev, (uintptr_t)curr, (uintptr_t)node))
+			return true;
+	}
+}
+
+/*
+ *  cc_hash_delete()
+ *	delete key, returns false if it is not present
+ */
+static bool cc_hash_delete(cc_thread_t *thread, const unsigned long key)
+{
+	cc_node_t *curr;
+	uintptr_t *prev;
+
+	for (;;) {
+		uintptr_t next;
+
+		if (!cc_hash_find(thread, key, &prev, &curr))
+			return false;
+		next = cc_load(&curr->next[0]);
+		if (CC_MARKED(next) || !cc_cas(&curr->next[0], next, next | 1))
+			continue;
+		/* If the unlink fails a find unlinks it, retiring it too */
+		if (cc_cas(prev, (uintptr_t)curr, next))
+			cc_retire(thread, curr);
+		else
+			(void)cc_hash_find(thread, key, &prev, &curr);
+		return true;
+	}
+}
+
+/*
+ *  cc_thread()
+ *	run a random mix of lookups, inserts and deletes
+ */
+static void *cc_thread(void *arg)
+{
+	static void *nowt = NULL;
+	cc_thread_t *thread = (cc_thread_t *)arg;
+	cc_map_t *map = thread->map;
+	const bool skiplist = (map->method == SKIPLIST_METHOD_SKIPLIST);
+
+	while (!__atomic_load_n(&map->go, __ATOMIC_ACQUIRE))
+		shim_sched_yield();
+
+	while (!__atomic_load_n(&map->stop, __ATOMIC_RELAXED) && !thread->err) {
+		int i;
+
+		for (i = 0; i < CC_QUIESCE_OPS; i++) {
+			const uint64_t r = cc_rand(&thread->seed);
+			const uint64_t k = cc_rand(&thread->seed);
+			const bool hot = (uint32_t)((r >> 8) % 100) < map->skew_pct;
+			const unsigned long key = 1 +
+				(unsigned long)(k % (hot ? map->hot_keys : map->keys));
+
+			if ((uint32_t)((r >> 32) % 100) < map->read_pct) {
+				(void)(skiplist ? cc_skiplist_lookup(map, key) :
+						  cc_hash_lookup(map, key));
+			} else if (r & 1) {
+				if (skiplist ? cc_skiplist_insert(thread, key) :
+					       cc_hash_insert(thread, key))
+					thread->inserted++;
+			} else {
+				if (skiplist ? cc_skiplist_delete(thread, key) :
+					       cc_hash_delete(thread, key))
+					thread->deleted++;
+			}
+		}
+		thread->ops += CC_QUIESCE_OPS;
+		cc_quiescent(thread);
+	}
+	return &nowt;
+}
+
+/*
+ *  cc_map_init()
+ *	create the skiplist or hash map holding the odd keys
+ */
+static int cc_map_init(cc_map_t *map, uint64_t *count)
+{
+	unsigned long key;
+
+	*count = 0;
+	if (map->method == SKIPLIST_METHOD_SKIPLIST) {
+		size_t level;
+
+		map->max_level = STRESS_MINIMUM((size_t)skip_list_ln2(map->keys), (size_t)CC_MAX_LEVEL);
+		map->head = cc_node_alloc(0, map->max_level);
+		map->tail = cc_node_alloc(ULONG_MAX, map->max_level);
+		if (!map->head || !map->tail)
+			return -1;
+		for (level = 0; level < map->max_level; level++)
+			map->head->next[level] = (uintptr_t)map->tail;
+	} else {
+		map->hash_shift = 64;
+		for (map->n_buckets = 1; map->n_buckets < map->keys; map->n_buckets <<= 1)
+			map->hash_shift--;
+		map->buckets = (uintptr_t *)calloc(map->n_buckets, sizeof(*map->buckets));
+		if (!map->buckets)
+			return -1;
+	}
+
+	/* Single threaded, the one thread only retires nodes it deletes */
+	for (key = 1; key <= map->keys; key += 2) {
+		cc_thread_t thread;
+
+		(void)memset(&thread, 0, sizeof(thread));
+		thread.map = map;
+		thread.seed = key * 0x9e3779b97f4a7c15ULL;
+		if (!((map->method == SKIPLIST_METHOD_SKIPLIST) ?
+			cc_skiplist_insert(&thread, key) : cc_hash_insert(&thread, key)))
+			return -1;
+		(*count)++;
+	}
+	return 0;
+}
+
+/*
+ *  cc_map_check()
+ *	check the structure is intact once the threads have stopped: every
+ *	level and bucket in order with no deleted nodes left, and holding the
+ *	initial keys plus the inserted minus the deleted ones
+ */
+static bool cc_map_check(const stress_args_t *args, cc_map_t *map, const uint64_t expected)
+{
+	uint64_t count = 0;
+
+	if (map->method == SKIPLIST_METHOD_SKIPLIST) {
+		size_t level;
+
+		for (level = 0; level < map->max_level; level++) {
+			cc_node_t *node = CC_PTR(map->head->next[level]);
+			unsigned long prev = 0;
+
+			for (; node != map->tail; node = CC_PTR(node->next[level])) {
+				if (CC_MARKED(node->next[level]) || (node->key <= prev) ||
+				    (node->levels <= level)) {
+					pr_fail("%s: skiplist corrupt at level %zu, key %lu\n",
+						args->name, level, node->key);
+					return false;
+				}
+				prev = node->key;
+				if (level == 0)
+					count++;
+			}
+		}
+	} else {
+		unsigned long i;
+
+		for (i = 0; i < map->n_buckets; i++) {
+			cc_node_t *node = CC_PTR(map->buckets[i]);
+			unsigned long prev = 0;
+
+			for (; node; node = CC_PTR(node->next[0])) {
+				if (CC_MARKED(node->next[0]) || (node->key <= prev) ||
+				    (cc_hash_bucket(map, node->key) != &map->buckets[i])) {
+					pr_fail("%s: hash map corrupt in bucket %lu, key %lu\n",
+						args->name, i, node->key);
+					return false;
+				}
+				prev = node->key;
+				count++;
+			}
+		}
+	}
+	if (count != expected) {
+		pr_fail("%s: %s holds %" PRIu64 " keys, expected %" PRIu64 "\n",
+			args->name, skiplist_methods[map->method - 1], count, expected);
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  cc_map_free()
+ *	free the skiplist or hash map
+ */
+static void cc_map_free(cc_map_t *map)
+{
+	cc_node_t *node;
+
+	if (map->method == SKIPLIST_METHOD_SKIPLIST) {
+		if (map->head) {
+			for (node = CC_PTR(map->head->next[0]); node && (node != map->tail); ) {
+				cc_node_t *next = CC_PTR(node->next[0]);
+
+				free(node);
+				node = next;
+			}
+		}
+		free(map->head);
+		free(map->tail);
+	} else if (map->buckets) {
+		unsigned long i;
+
+		for (i = 0; i < map->n_buckets; i++) {
+			for (node = CC_PTR(map->buckets[i]); node; ) {
+				cc_node_t *next = CC_PTR(node->next[0]);
+
+				free(node);
+				node = next;
+			}
+		}
+		free(map->buckets);
+	}
+}
+
+/*
+ *  cc_measure()
+ *	run threads threads on a fresh structure for CC_SLICE seconds,
+ *	check it and add the operations done to result
+ */
+static int cc_measure(
+	const stress_args_t *args,
+	const int method,
+	const size_t threads,
+	const unsigned long keys,
+	const uint32_t read_pct,
+	const uint32_t skew_pct,
+	cc_result_t *result)
+{
+	cc_map_t *map;
+	cc_thread_t *pthreads;
+	uint64_t count, ops = 0;
+	size_t i;
+	double t_start, t_end;
+	int rc = EXIT_SUCCESS, err = 0;
+
+	map = (cc_map_t *)calloc(1, sizeof(*map));
+	pthreads = (cc_thread_t *)calloc(threads, sizeof(*pthreads));
+	if (map)
+		map->epochs = (cc_epoch_t *)calloc(threads, sizeof(*map->epochs));
+	if (!map || !pthreads || !map->epochs) {
+		rc = EXIT_NO_RESOURCE;
+		goto free_map;
+	}
+	map->method = method;
+	map->threads = threads;
+	map->keys = keys;
+	map->hot_keys = STRESS_MAXIMUM(keys / 100, 1UL);
+	map->read_pct = read_pct;
+	map->skew_pct = skew_pct;
+	if (cc_map_init(map, &count) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto free_map;
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthreads[i].map = map;
+		pthreads[i].id = i;
+		pthreads[i].seed = stress_mwc64() | 1;
+		pthreads[i].ret = pthread_create(&pthreads[i].pthread, NULL,
+			cc_thread, &pthreads[i]);
+		if (pthreads[i].ret) {
+			err = pthreads[i].ret;
+			break;
+		}
+	}
+	t_start = stress_time_now();
+	__atomic_store_n(&map->go, true, __ATOMIC_RELEASE);
+	if (!err) {
+		t_end = t_start + CC_SLICE;
+		while (keep_stressing(args) && (stress_time_now() < t_end))
+			(void)shim_usleep(10000);
+	}
+	__atomic_store_n(&map->stop, true, __ATOMIC_RELAXED);
+	for (i = 0; i < threads; i++) {
+		if (pthreads[i].ret == 0)
+			(void)pthread_join(pthreads[i].pthread, NULL);
+	}
+	t_end = stress_time_now();
+
+	for (i = 0; i < threads; i++) {
+		if (pthreads[i].err && !err)
+			err = pthreads[i].err;
+		ops += pthreads[i].ops;
+		count += pthreads[i].inserted;
+		count -= pthreads[i].deleted;
+		cc_free_list(pthreads[i].limbo);
+	}
+	if (err) {
+		rc = (err == ENOMEM) || (err == EAGAIN) ? EXIT_NO_RESOURCE : EXIT_FAILURE;
+		if (rc == EXIT_FAILURE)
+			pr_fail("%s: pthread_create failed, errno=%d (%s)\n",
+				args->name, err, strerror(err));
+	} else if (!cc_map_check(args, map, count)) {
+		rc = EXIT_FAILURE;
+	} else {
+		result->ops += ops;
+		result->duration += t_end - t_start;
+	}
+
+free_map:
+	if (map) {
+		cc_map_free(map);
+		free(map->epochs);
+	}
+	free(pthreads);
+	free(map);
+	return rc;
+}
+
+/*
+ *  cc_report()
+ *	report ops per second and scaling over one thread of each method,
+ *	the table by the first instance only
+ */
+static void cc_report(
+	const stress_args_t *args,
+	cc_result_t results[][MAX_SKIPLIST_THREADS + 1],
+	const size_t *counts,
+	const size_t n_counts)
+{
+	bool lock = false;
+	size_t m, i;
+	int idx = 0;
+
+	if (args->instance != 0)
+		goto stats;
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %-8s %7s %12s %8s\n", args->name,
+		"method", "threads", "Mops/sec", "scaling");
+	for (m = 0; m < SKIPLIST_METHODS; m++) {
+		const cc_result_t *r1 = &results[m][counts[0]];
+		const double rate1 = (r1->duration > 0.0) ?
+			(double)r1->ops / r1->duration : 0.0;
+
+		for (i = 0; i < n_counts; i++) {
+			const cc_result_t *r = &results[m][counts[i]];
+			double rate;
+
+			if (r->duration <= 0.0)
+				continue;
+			rate = (double)r->ops / r->duration;
+			pr_inf_lock(&lock, "%s: %-8s %7zu %12.3f %7.2fx\n", args->name,
+				skiplist_methods[m], counts[i], rate / 1000000.0,
+				(rate1 > 0.0) ? rate / rate1 : 0.0);
+		}
+	}
+	pr_unlock(&lock);
+
+stats:
+	for (m = 0; m < SKIPLIST_METHODS; m++) {
+		const size_t n = counts[n_counts - 1];
+		const cc_result_t *r1 = &results[m][counts[0]];
+		const cc_result_t *r = &results[m][n];
+		char desc[40];
+		double rate;
+
+		if (r->duration <= 0.0)
+			continue;
+		rate = (double)r->ops / r->duration;
+		(void)snprintf(desc, sizeof(desc), "%s ops/sec, %zu threads",
+			skiplist_methods[m], n);
+		stress_misc_stats_set(args->misc_stats, idx++, desc, rate);
+		if ((n > 1) && (r1->duration > 0.0) && (r1->ops > 0)) {
+			(void)snprintf(desc, sizeof(desc), "%s scaling, %zu threads",
+				skiplist_methods[m], n);
+			stress_misc_stats_set(args->misc_stats, idx++, desc,
+				rate / ((double)r1->ops / r1->duration));
+		}
+	}
+}
+
+/*
+ *  stress_skiplist_concurrent()
+ *	measure the lock-free structures with 1, 2, 4.. up to
+ *	skiplist-threads threads sharing them, one bogo op per
+ *	measurement
+ */
+static int stress_skiplist_concurrent(
+	const stress_args_t *args,
+	const unsigned long n,
+	const size_t threads)
+{
+	size_t counts[MAX_SKIPLIST_THREADS], n_counts = 0, i, m;
+	cc_result_t (*results)[MAX_SKIPLIST_THREADS + 1];
+	int skiplist_method = SKIPLIST_METHOD_ALL;
+	uint32_t skiplist_read = 90, skiplist_skew = 0;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("skiplist-method", &skiplist_method);
+	(void)stress_get_setting("skiplist-read", &skiplist_read);
+	(void)stress_get_setting("skiplist-skew", &skiplist_skew);
+
+	for (i = 1; i < threads; i <<= 1)
+		counts[n_counts++] = i;
+	counts[n_counts++] = threads;
+
+	results = calloc(SKIPLIST_METHODS, sizeof(*results));
+	if (!results) {
+		pr_inf("%s: out of memory allocating results, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		for (m = 0; m < SKIPLIST_METHODS; m++) {
+			if ((skiplist_method != SKIPLIST_METHOD_ALL) &&
+			    (skiplist_method != (int)m + 1))
+				continue;
+			for (i = 0; keep_stressing(args) && (i < n_counts); i++) {
+				rc = cc_measure(args, (int)m + 1, counts[i], n,
+					skiplist_read, skiplist_skew, &results[m][counts[i]]);
+				if (rc == EXIT_NO_RESOURCE) {
+					pr_inf("%s: out of memory running %zu threads, "
+						"skipping stressor\n", args->name, counts[i]);
+					goto report;
+				}
+				if (rc != EXIT_SUCCESS)
+					goto report;
+				inc_counter(args);
+			}
+		}
+	} while (keep_stressing(args));
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	cc_report(args, results, counts, n_counts);
+	free(results);
+	return rc;
+}
+#endif
+
 /*
  *  stress_skiplist()
  *	stress skiplist
@@ -207,6 +1134,7 @@ static int stress_skiplist(const stress_args_t *args)
 {
 	unsigned long n, i, ln2n;
 	uint64_t skiplist_size = 1024;
+	size_t skiplist_threads = 0;
 
 	if (!stress_get_setting("skiplist-size", &skiplist_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -217,6 +1145,18 @@ static int stress_skiplist(const stress_args_t *args)
 	n = (unsigned long)skiplist_size;
 	ln2n = skip_list_ln2(n);
 
+	(void)stress_get_setting("skiplist-threads", &skiplist_threads);
+	if (skiplist_threads) {
+#if defined(STRESS_SKIPLIST_CONCURRENT)
+		return stress_skiplist_concurrent(args, n, skiplist_threads);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: concurrent mode needs pthread and atomic "
+				"support, skipping stressor\n", args->name);
+		return EXIT_NOT_IMPLEMENTED;
+#endif
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -257,7 +1197,11 @@ static int stress_skiplist(const stress_args_t *args)
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_skiplist_method,	stress_set_skiplist_method },
+	{ OPT_skiplist_read,	stress_set_skiplist_read },
 	{ OPT_skiplist_size,	stress_set_skiplist_size },
+	{ OPT_skiplist_skew,	stress_set_skiplist_skew },
+	{ OPT_skiplist_threads,	stress_set_skiplist_threads },
 	{ 0,			NULL },
 };
 
@@ -23,6 +23,7 @@
  *
  */
 #include "stress-ng.h"
+#include "io-uring.h"
 
 #define MMAP_BUF_SIZE		(65536)
 #define MMAP_IO_SIZE		(8192)	/* Must be less or equal to 8192 */
@@ -31,6 +32,7 @@
 #define SOCKET_OPT_SENDMSG	(0x01)
 #define SOCKET_OPT_SENDMMSG	(0x02)
 #define SOCKET_OPT_RANDOM	(0x03)
+#define SOCKET_OPT_IO_URING	(0x04)
 
 #define SOCKET_OPT_RECV		(SOCKET_OPT_SEND)
 #define SOCKET_OPT_RECVMSG	(SOCKET_OPT_SENDMSG)
@@ -42,6 +44,40 @@
 
 #define MSGVEC_SIZE		(4)
 
+#define MIN_SOCKET_MSGS		(1)
+#define MAX_SOCKET_MSGS		(256)
+#define DEFAULT_SOCKET_MSGS	(MSGVEC_SIZE)
+
+#define MIN_SOCKET_MSG_SIZE	(16)
+#define MAX_SOCKET_MSG_SIZE	(1 * MB)
+
+#define MAX_SOCKET_BUSY_POLL	(1000000)
+
+#define SOCKET_URING_BUFS	(32)	/* provided receive buffers, power of 2 */
+
+#if defined(__linux__) &&		\
+    defined(HAVE_LINUX_IO_URING_H) &&	\
+    defined(__NR_io_uring_setup) &&	\
+    defined(__NR_io_uring_enter) &&	\
+    defined(IORING_OFF_SQ_RING) &&	\
+    defined(IORING_OFF_CQ_RING) &&	\
+    defined(IORING_OFF_SQES) &&		\
+    defined(IORING_ENTER_GETEVENTS) &&	\
+    defined(HAVE_IORING_OP_SEND) &&	\
+    defined(HAVE_IORING_OP_RECV)
+#define STRESS_SOCK_IO_URING
+#endif
+
+/* Multishot receive needs provided buffer rings, Linux 6.0 */
+#if defined(STRESS_SOCK_IO_URING) &&	\
+    defined(__NR_io_uring_register) &&	\
+    defined(IORING_RECV_MULTISHOT) &&	\
+    defined(IORING_CQE_F_BUFFER) &&	\
+    defined(IORING_CQE_F_MORE) &&	\
+    defined(IOSQE_BUFFER_SELECT)
+#define STRESS_SOCK_MULTISHOT
+#endif
+
 #define PROC_CONG_CTRLS		"/proc/sys/net/ipv4/tcp_allowed_congestion_control"
 
 typedef struct {
@@ -51,10 +87,13 @@ typedef struct {
 
 static const stress_help_t help[] = {
 	{ "S N", "sock N",		"start N workers exercising socket I/O" },
+	{ NULL,	"sock-busy-poll N",	"busy poll for up to N usecs on blocking receives" },
 	{ NULL,	"sock-domain D",	"specify socket domain, default is ipv4" },
+	{ NULL,	"sock-msg-size N",	"send and receive messages of N bytes" },
+	{ NULL,	"sock-msgs N",		"batch N messages per sendmmsg, recvmmsg or io-uring submit" },
 	{ NULL,	"sock-nodelay",		"disable Nagle algorithm, send data immediately" },
 	{ NULL,	"sock-ops N",		"stop after N socket bogo operations" },
-	{ NULL,	"sock-opts option", 	"socket options [send|sendmsg|sendmmsg]" },
+	{ NULL,	"sock-opts option", 	"socket options [send|sendmsg|sendmmsg|io-uring]" },
 	{ NULL,	"sock-port P",		"use socket ports P to P + number of workers - 1" },
 	{ NULL, "sock-protocol",	"use socket protocol P, default is tcp, can be mptcp" },
 	{ NULL,	"sock-type T",		"socket type (stream, seqpacket)" },
@@ -102,6 +141,9 @@ static int stress_set_socket_opts(const char *opt)
 		{ "sendmsg",	SOCKET_OPT_SENDMSG },
 #if defined(HAVE_SENDMMSG)
 		{ "sendmmsg",	SOCKET_OPT_SENDMMSG },
+#endif
+#if defined(STRESS_SOCK_IO_URING)
+		{ "io-uring",	SOCKET_OPT_IO_URING },
 #endif
 		{ NULL,		0 }
 	};
@@ -109,6 +151,55 @@ static int stress_set_socket_opts(const char *opt)
 	return stress_set_socket_option("sock-opts", socket_opts, opt);
 }
 
+/*
+ *  stress_set_socket_msgs()
+ *	set the number of messages per batched send or receive
+ */
+static int stress_set_socket_msgs(const char *opt)
+{
+	uint32_t socket_msgs;
+
+	socket_msgs = stress_get_uint32(opt);
+	stress_check_range("sock-msgs", (uint64_t)socket_msgs,
+		MIN_SOCKET_MSGS, MAX_SOCKET_MSGS);
+	return stress_set_setting("sock-msgs", TYPE_ID_UINT32, &socket_msgs);
+}
+
+/*
+ *  stress_set_socket_msg_size()
+ *	set a fixed message size, large messages with matching
+ *	socket buffers let GRO coalesced segments arrive in one read
+ */
+static int stress_set_socket_msg_size(const char *opt)
+{
+	size_t socket_msg_size;
+
+	socket_msg_size = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("sock-msg-size", (uint64_t)socket_msg_size,
+		MIN_SOCKET_MSG_SIZE, MAX_SOCKET_MSG_SIZE);
+	return stress_set_setting("sock-msg-size", TYPE_ID_SIZE_T, &socket_msg_size);
+}
+
+/*
+ *  stress_set_socket_busy_poll()
+ *	set the SO_BUSY_POLL time in microseconds
+ */
+static int stress_set_socket_busy_poll(const char *opt)
+{
+#if defined(SO_BUSY_POLL)
+	uint32_t socket_busy_poll;
+
+	socket_busy_poll = stress_get_uint32(opt);
+	stress_check_range("sock-busy-poll", (uint64_t)socket_busy_poll,
+		0, MAX_SOCKET_BUSY_POLL);
+	return stress_set_setting("sock-busy-poll", TYPE_ID_UINT32, &socket_busy_poll);
+#else
+	(void)opt;
+	pr_inf("sock: cannot enable sock-busy-poll, SO_BUSY_POLL is not available\n");
+	return 0;
+#endif
+}
+
 /*
  *  stress_set_socket_type()
  *	parse --sock-type
@@ -425,6 +516,495 @@ static void stress_sock_invalid_recv(const int fd, const int opt)
 	}
 }
 
+/*
+ *  stress_sock_busy_poll()
+ *	busy poll the device queue for up to usec microseconds on
+ *	blocking receives rather than sleeping until an interrupt
+ */
+static void stress_sock_busy_poll(
+	const stress_args_t *args,
+	const int fd,
+	const uint32_t usec)
+{
+#if defined(SO_BUSY_POLL)
+	static bool warned = false;
+	int val = (int)usec;
+
+	if (!usec)
+		return;
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0) {
+		/* Raising it above net.core.busy_read needs CAP_NET_ADMIN */
+		if (!warned && (args->instance == 0))
+			pr_inf("%s: cannot set SO_BUSY_POLL, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+		warned = true;
+		return;
+	}
+#if defined(SO_PREFER_BUSY_POLL)
+	val = 1;
+	(void)setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &val, sizeof(val));
+#endif
+#else
+	(void)args;
+	(void)fd;
+	(void)usec;
+#endif
+}
+
+/*
+ *  stress_sock_bufsize()
+ *	grow the socket send or receive buffer to hold a few
+ *	messages of the --sock-msg-size large buffer mode, it
+ *	is never shrunk as a small buffer stalls TCP
+ */
+static void stress_sock_bufsize(const int fd, const int optname, const size_t msg_size)
+{
+	int val = 0, want = (int)(msg_size * 4);
+	socklen_t len = sizeof(val);
+
+	if (!msg_size)
+		return;
+	if (getsockopt(fd, SOL_SOCKET, optname, &val, &len) < 0)
+		return;
+	/* The kernel reports double the size that was set */
+	if (val / 2 < want)
+		(void)setsockopt(fd, SOL_SOCKET, optname, &want, sizeof(want));
+}
+
+/*
+ *  stress_sock_vec()
+ *	fill in the iovecs of a message, a single msg_size iovec in
+ *	the large buffer mode, otherwise iovecs of 16 to MMAP_IO_SIZE
+ *	- 16 bytes, returns the number of iovecs
+ */
+static size_t stress_sock_vec(struct iovec *vec, char *buf, const size_t msg_size)
+{
+	size_t i, j;
+
+	if (msg_size) {
+		vec[0].iov_base = buf;
+		vec[0].iov_len = msg_size;
+		return 1;
+	}
+	for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
+		vec[j].iov_base = buf;
+		vec[j].iov_len = i;
+	}
+	return j;
+}
+
+#if defined(STRESS_SOCK_IO_URING)
+/*
+ *  Avoid GCCism of void * pointer arithmetic by casting to
+ *  uint8_t *, doing the offset and then casting back to void *
+ */
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+/*
+ *  minimal io-uring, one batch of requests in flight at a time
+ */
+typedef struct {
+	int fd;			/* io-uring fd */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	unsigned tail;		/* local tail of queued SQEs */
+	unsigned submitted;	/* SQEs consumed by the kernel */
+	uint64_t conn;		/* user_data tag of the current connection */
+	bool armed;		/* a receive request is pending */
+	bool multishot;		/* multishot receive into provided buffers */
+	void *br;		/* provided buffer ring */
+	size_t br_size;
+	uint16_t br_tail;
+	char *bufs;		/* provided buffers */
+	size_t buf_size;	/* size of each provided buffer */
+} stress_sock_uring_t;
+
+/*
+ *  stress_sock_uring_close()
+ *	tear down an io-uring and its provided buffers
+ */
+static void stress_sock_uring_close(stress_sock_uring_t *ring)
+{
+	if (ring->bufs)
+		(void)munmap((void *)ring->bufs, ring->buf_size * SOCKET_URING_BUFS);
+	if (ring->br)
+		(void)munmap(ring->br, ring->br_size);
+	if (ring->sqes)
+		(void)munmap((void *)ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_sock_uring_setup()
+ *	set up an io-uring of at least entries SQEs,
+ *	returns 0 or -1 with errno set
+ */
+static int stress_sock_uring_setup(stress_sock_uring_t *ring, const unsigned entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sq_mmap = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto err;
+		ring->cq_mmap = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sqes = (struct io_uring_sqe *)ptr;
+
+	ring->sq_tail = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+	ring->submitted = ring->tail;
+
+	return 0;
+err:
+	err = errno;
+	stress_sock_uring_close(ring);
+	errno = err;
+	return -1;
+}
+
+/*
+ *  stress_sock_uring_sqe()
+ *	get the next free SQE
+ */
+static struct io_uring_sqe *stress_sock_uring_sqe(stress_sock_uring_t *ring)
+{
+	const unsigned idx = ring->tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	ring->sq_array[idx] = idx;
+	ring->tail++;
+	(void)memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+/*
+ *  stress_sock_uring_enter()
+ *	submit the queued SQEs and wait for min_complete completions
+ */
+static int stress_sock_uring_enter(stress_sock_uring_t *ring, const unsigned min_complete)
+{
+	const unsigned to_submit = ring->tail - ring->submitted;
+	int ret;
+
+	*ring->sq_tail = ring->tail;
+	shim_mb();
+	ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit,
+		min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+	if (ret > 0)
+		ring->submitted += (unsigned)ret;
+	return ret;
+}
+
+#if defined(STRESS_SOCK_MULTISHOT)
+/*
+ *  stress_sock_uring_buf_put()
+ *	give a provided buffer back to the kernel, the tail is
+ *	published by stress_sock_uring_buf_sync()
+ */
+static void stress_sock_uring_buf_put(stress_sock_uring_t *ring, const uint16_t bid)
+{
+	struct io_uring_buf_ring *br = (struct io_uring_buf_ring *)ring->br;
+	struct io_uring_buf *buf = &br->bufs[ring->br_tail & (SOCKET_URING_BUFS - 1)];
+
+	buf->addr = (uint64_t)(uintptr_t)(ring->bufs + ((size_t)bid * ring->buf_size));
+	buf->len = (uint32_t)ring->buf_size;
+	buf->bid = bid;
+	ring->br_tail++;
+}
+
+static void stress_sock_uring_buf_sync(stress_sock_uring_t *ring)
+{
+	struct io_uring_buf_ring *br = (struct io_uring_buf_ring *)ring->br;
+
+	shim_mb();
+	br->tail = ring->br_tail;
+}
+#endif
+
+/*
+ *  stress_sock_uring_bufs()
+ *	register a ring of provided buffers for multishot receives,
+ *	leaves the single shot receive mode if this is not supported
+ */
+static void stress_sock_uring_bufs(stress_sock_uring_t *ring, const size_t buf_size)
+{
+#if defined(STRESS_SOCK_MULTISHOT)
+	struct io_uring_buf_reg reg;
+	const size_t page_size = stress_get_pagesize();
+	void *ptr;
+	uint16_t i;
+
+	ring->br_size = (SOCKET_URING_BUFS * sizeof(struct io_uring_buf) +
+		page_size - 1) & ~(page_size - 1);
+	ptr = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->br = ptr;
+	ptr = mmap(NULL, buf_size * SOCKET_URING_BUFS, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->bufs = (char *)ptr;
+	ring->buf_size = buf_size;
+
+	(void)memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)ring->br;
+	reg.ring_entries = SOCKET_URING_BUFS;
+	reg.bgid = 0;
+	if (syscall(__NR_io_uring_register, ring->fd,
+		    IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		goto err;
+
+	for (i = 0; i < SOCKET_URING_BUFS; i++)
+		stress_sock_uring_buf_put(ring, i);
+	stress_sock_uring_buf_sync(ring);
+	ring->multishot = true;
+	return;
+err:
+	if (ring->bufs)
+		(void)munmap((void *)ring->bufs, buf_size * SOCKET_URING_BUFS);
+	if (ring->br)
+		(void)munmap(ring->br, ring->br_size);
+	ring->bufs = NULL;
+	ring->br = NULL;
+#else
+	(void)ring;
+	(void)buf_size;
+#endif
+}
+
+/*
+ *  stress_sock_uring_send()
+ *	send the messages of one connection as batches of msgs
+ *	io-uring send requests, returns messages sent or -1 with
+ *	errno set
+ */
+static ssize_t stress_sock_uring_send(
+	stress_sock_uring_t *ring,
+	const int fd,
+	char *buf,
+	const size_t msg_size,
+	const uint32_t msgs,
+	const int flags)
+{
+	ssize_t sent = 0;
+	size_t i = 16;
+
+	while (i < MMAP_IO_SIZE) {
+		unsigned n, reaped = 0, head;
+		int err = 0;
+
+		for (n = 0; (n < msgs) && (i < MMAP_IO_SIZE); n++, i += 16) {
+			struct io_uring_sqe *sqe = stress_sock_uring_sqe(ring);
+
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = fd;
+			sqe->addr = (uint64_t)(uintptr_t)buf;
+			sqe->len = (uint32_t)(msg_size ? msg_size : i);
+			sqe->msg_flags = (uint32_t)flags;
+		}
+		while (reaped < n) {
+			if (stress_sock_uring_enter(ring, n - reaped) < 0) {
+				if ((errno == EINTR) && keep_stressing_flag())
+					continue;
+				return -1;
+			}
+			shim_mb();
+			for (head = *ring->cq_head; head != *ring->cq_tail; head++, reaped++) {
+				const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+				if (cqe->res < 0)
+					err = -cqe->res;
+				else
+					sent++;
+			}
+			*ring->cq_head = head;
+			shim_mb();
+		}
+		if (err) {
+			errno = err;
+			return -1;
+		}
+	}
+	return sent;
+}
+
+/*
+ *  stress_sock_uring_recv()
+ *	receive with a multishot io-uring recv into provided
+ *	buffers if available, otherwise a single shot recv into
+ *	buf, returns bytes received, 0 at the end of the stream
+ *	or -1 with errno set
+ */
+static ssize_t stress_sock_uring_recv(
+	stress_sock_uring_t *ring,
+	const int fd,
+	char *buf,
+	const size_t len,
+	uint64_t *msgs,
+	uint64_t *calls)
+{
+	ssize_t bytes = 0;
+	bool eof = false;
+	int err = 0;
+
+	while (!bytes && !eof && !err) {
+		unsigned head;
+
+		if (!keep_stressing_flag()) {
+			errno = EINTR;
+			return -1;
+		}
+		if (!ring->armed) {
+			struct io_uring_sqe *sqe = stress_sock_uring_sqe(ring);
+
+			sqe->opcode = IORING_OP_RECV;
+			sqe->fd = fd;
+			sqe->user_data = ring->conn;
+#if defined(STRESS_SOCK_MULTISHOT)
+			if (ring->multishot) {
+				sqe->flags = IOSQE_BUFFER_SELECT;
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+				sqe->buf_group = 0;
+			} else
+#endif
+			{
+				sqe->addr = (uint64_t)(uintptr_t)buf;
+				sqe->len = (uint32_t)len;
+			}
+			ring->armed = true;
+		}
+		(*calls)++;
+		if (stress_sock_uring_enter(ring, 1) < 0)
+			return -1;
+
+		shim_mb();
+		for (head = *ring->cq_head; head != *ring->cq_tail; head++) {
+			const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+#if defined(STRESS_SOCK_MULTISHOT)
+			if (cqe->flags & IORING_CQE_F_BUFFER)
+				stress_sock_uring_buf_put(ring,
+					(uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+			/* Requests of a closed connection still complete */
+			if (cqe->user_data != ring->conn)
+				continue;
+			if (!(cqe->flags & IORING_CQE_F_MORE))
+				ring->armed = false;
+#else
+			if (cqe->user_data != ring->conn)
+				continue;
+			ring->armed = false;
+#endif
+			if (cqe->res > 0) {
+				bytes += cqe->res;
+				(*msgs)++;
+			} else if (cqe->res == 0) {
+				eof = true;
+			} else if (cqe->res == -ENOBUFS) {
+				/* All buffers in use, re-armed once recycled */
+				continue;
+			} else if ((cqe->res == -EINVAL) && ring->multishot) {
+				/* Kernel without multishot recv */
+				pr_dbg("sock: multishot recv not supported, using single shot recv\n");
+				ring->multishot = false;
+			} else {
+				err = -cqe->res;
+			}
+		}
+		*ring->cq_head = head;
+#if defined(STRESS_SOCK_MULTISHOT)
+		if (ring->multishot)
+			stress_sock_uring_buf_sync(ring);
+#endif
+		shim_mb();
+	}
+	if (bytes)
+		return bytes;
+	if (eof)
+		return 0;
+	errno = err;
+	return -1;
+}
+#endif
+
+/*
+ *  stress_sock_client_metrics()
+ *	report the receive throughput, the time blocked in the
+ *	receive calls per message and the messages per call
+ */
+static void stress_sock_client_metrics(
+	const stress_args_t *args,
+	const double duration,
+	const uint64_t bytes,
+	const uint64_t msgs,
+	const uint64_t calls,
+	const double recv_ns)
+{
+	const double rate = (duration > 0.0) ? (double)bytes / duration : 0.0;
+
+	stress_misc_stats_set(args->misc_stats, 0, "MB recv per sec", rate / (double)MB);
+	stress_misc_stats_set(args->misc_stats, 1, "recv ns per message",
+		msgs ? recv_ns / (double)msgs : 0.0);
+	stress_misc_stats_set(args->misc_stats, 2, "messages per recv call",
+		calls ? (double)msgs / (double)calls : 0.0);
+}
+
 /*
  *  stress_sock_client()
  *	client reader
@@ -439,12 +1019,37 @@ static void stress_sock_client(
 	const int socket_protocol,
 	const int socket_port,
 	const bool rt,
-	const bool socket_zerocopy)
+	const bool socket_zerocopy,
+	const uint32_t socket_msgs,
+	const size_t socket_msg_size,
+	const uint32_t socket_busy_poll)
 {
 	struct sockaddr *addr;
 	size_t n_ctrls;
 	char **ctrls;
 	int recvflag = 0;
+	const size_t recv_len = socket_msg_size ? socket_msg_size : MMAP_IO_SIZE;
+	uint64_t recv_bytes = 0, recv_msgs = 0, recv_calls = 0;
+	double recv_ns = 0.0;
+	const double t_start = stress_time_now();
+#if defined(STRESS_SOCK_IO_URING)
+	stress_sock_uring_t ring;
+
+	(void)memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+	if (socket_opts == SOCKET_OPT_IO_URING) {
+		if (stress_sock_uring_setup(&ring, 8) < 0) {
+			pr_fail("%s: io_uring_setup failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			(void)kill(getppid(), SIGALRM);
+			_exit(EXIT_FAILURE);
+		}
+		stress_sock_uring_bufs(&ring, recv_len);
+		if (args->instance == 0)
+			pr_dbg("%s: receiving with %s io-uring recv\n", args->name,
+				ring.multishot ? "multishot" : "single shot");
+	}
+#endif
 
 	(void)setpgid(0, g_pgrp);
 	stress_parent_died_alarm();
@@ -512,6 +1117,12 @@ retry:
 			}
 			goto retry;
 		}
+		stress_sock_busy_poll(args, fd, socket_busy_poll);
+		stress_sock_bufsize(fd, SO_RCVBUF, socket_msg_size);
+#if defined(STRESS_SOCK_IO_URING)
+		ring.conn++;
+		ring.armed = false;
+#endif
 
 #if defined(TCP_CONGESTION)
 		/*
@@ -719,13 +1330,14 @@ retry:
 			struct msghdr msg;
 			struct iovec vec[MMAP_IO_SIZE / 16];
 #if defined(HAVE_RECVMMSG)
-			struct mmsghdr msgvec[MSGVEC_SIZE];
+			struct mmsghdr msgvec[MAX_SOCKET_MSGS];
 			const int max_opt = 3;
 #else
 			const int max_opt = 2;
 #endif
 			const int opt = (socket_opts == SOCKET_OPT_RANDOM) ?
 					stress_mwc8() % max_opt: socket_opts;
+			double t;
 
 #if defined(FIONREAD)
 			/*
@@ -764,42 +1376,53 @@ retry:
 			 *  Receive using equivalent receive method
 			 *  as the send
 			 */
+			t = stress_time_now_ns();
 			switch (opt) {
 			case SOCKET_OPT_RECV:
 				recvfunc = "recv";
-				n = recv(fd, buf, MMAP_IO_SIZE, recvflag);
+				n = recv(fd, buf, recv_len, recvflag);
+				recv_calls++;
+				if (n > 0)
+					recv_msgs++;
 				break;
 			case SOCKET_OPT_RECVMSG:
 				recvfunc = "recvmsg";
-				for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
-					vec[j].iov_base = buf;
-					vec[j].iov_len = i;
-				}
+				j = stress_sock_vec(vec, buf, socket_msg_size);
 				(void)memset(&msg, 0, sizeof(msg));
 				msg.msg_iov = vec;
 				msg.msg_iovlen = j;
 				n = recvmsg(fd, &msg, 0);
+				recv_calls++;
+				if (n > 0)
+					recv_msgs++;
 				break;
 #if defined(HAVE_RECVMMSG)
 			case SOCKET_OPT_RECVMMSG:
 				recvfunc = "recvmmsg";
-				(void)memset(msgvec, 0, sizeof(msgvec));
-				for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
-					vec[j].iov_base = buf;
-					vec[j].iov_len = i;
-				}
-				for (i = 0; i < MSGVEC_SIZE; i++) {
+				(void)memset(msgvec, 0, sizeof(*msgvec) * socket_msgs);
+				j = stress_sock_vec(vec, buf, socket_msg_size);
+				for (i = 0; i < socket_msgs; i++) {
 					msgvec[i].msg_hdr.msg_iov = vec;
 					msgvec[i].msg_hdr.msg_iovlen = j;
 				}
-				n = recvmmsg(fd, msgvec, MSGVEC_SIZE, 0, NULL);
+				n = recvmmsg(fd, msgvec, socket_msgs, 0, NULL);
+				recv_calls++;
 				if (n > 0) {
-					for (n = 0, i = 0; i < MSGVEC_SIZE; i++)
+					recv_msgs += (uint64_t)n;
+					for (n = 0, i = 0; i < socket_msgs; i++)
 						n += msgvec[i].msg_len;
 				}
 				break;
+#endif
+#if defined(STRESS_SOCK_IO_URING)
+			case SOCKET_OPT_IO_URING:
+				recvfunc = "io-uring recv";
+				n = stress_sock_uring_recv(&ring, fd, buf, recv_len,
+					&recv_msgs, &recv_calls);
+				break;
 #endif
 			}
+			recv_ns += stress_time_now_ns() - t;
 			if (n == 0)
 				break;
 			if (n < 0) {
@@ -809,9 +1432,14 @@ retry:
 						errno, strerror(errno));
 				break;
 			}
+			recv_bytes += (uint64_t)n;
 			count++;
 		} while (keep_stressing(args));
 
+		/* Update after each connection, the server may kill us at any time */
+		stress_sock_client_metrics(args, stress_time_now() - t_start,
+			recv_bytes, recv_msgs, recv_calls, recv_ns);
+
 		stress_sock_ioctl(fd, socket_domain, rt);
 #if defined(AF_INET) && 	\
     defined(IPPROTO_IP)	&&	\
@@ -840,6 +1468,10 @@ retry:
 #endif
 	/* Inform parent we're all done */
 	stress_free_congestion_controls(ctrls, n_ctrls);
+#if defined(STRESS_SOCK_IO_URING)
+	if (ring.fd >= 0)
+		stress_sock_uring_close(&ring);
+#endif
 
 	(void)kill(getppid(), SIGALRM);
 }
@@ -859,7 +1491,10 @@ static int stress_sock_server(
 	const int socket_protocol,
 	const int socket_port,
 	const bool rt,
-	const bool socket_zerocopy)
+	const bool socket_zerocopy,
+	const uint32_t socket_msgs,
+	const size_t socket_msg_size,
+	const uint32_t socket_busy_poll)
 {
 	int fd, status;
 	int so_reuseaddr = 1;
@@ -871,6 +1506,12 @@ static int stress_sock_server(
 	void *ptr = MAP_FAILED;
 	const pid_t self = getpid();
 	int sendflag = 0;
+#if defined(STRESS_SOCK_IO_URING)
+	stress_sock_uring_t ring;
+
+	(void)memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+#endif
 
 #if defined(MSG_ZEROCOPY)
 	if (socket_zerocopy)
@@ -927,6 +1568,15 @@ static int stress_sock_server(
 		rc = EXIT_FAILURE;
 		goto die_close;
 	}
+#if defined(STRESS_SOCK_IO_URING)
+	if ((socket_opts == SOCKET_OPT_IO_URING) &&
+	    (stress_sock_uring_setup(&ring, socket_msgs) < 0)) {
+		pr_fail("%s: io_uring_setup failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_FAILURE;
+		goto die_close;
+	}
+#endif
 
 	/*
 	 * Some systems allow us to mmap onto the fd
@@ -958,7 +1608,10 @@ static int stress_sock_server(
 			struct msghdr msg;
 			struct iovec vec[MMAP_IO_SIZE / 16];
 #if defined(HAVE_SENDMMSG)
-			struct mmsghdr msgvec[MSGVEC_SIZE];
+			struct mmsghdr msgvec[MAX_SOCKET_MSGS];
+#endif
+#if defined(STRESS_SOCK_IO_URING)
+			ssize_t sent;
 #endif
 
 			len = sizeof(saddr);
@@ -1016,6 +1669,8 @@ static int stress_sock_server(
 				}
 			}
 #endif
+			stress_sock_busy_poll(args, sfd, socket_busy_poll);
+			stress_sock_bufsize(sfd, SO_SNDBUF, socket_msg_size);
 			(void)memset(buf, 'A' + (get_counter(args) % 26), MMAP_IO_SIZE);
 
 			if (socket_opts == SOCKET_OPT_RANDOM)
@@ -1026,7 +1681,8 @@ static int stress_sock_server(
 			switch (opt) {
 			case SOCKET_OPT_SEND:
 				for (i = 16; i < MMAP_IO_SIZE; i += 16) {
-					ssize_t ret = send(sfd, buf, i, sendflag);
+					ssize_t ret = send(sfd, buf,
+						socket_msg_size ? socket_msg_size : i, sendflag);
 					if (ret < 0) {
 						if ((errno != EINTR) && (errno != EPIPE))
 							pr_fail("%s: send failed, errno=%d (%s)\n",
@@ -1037,10 +1693,7 @@ static int stress_sock_server(
 				}
 				break;
 			case SOCKET_OPT_SENDMSG:
-				for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
-					vec[j].iov_base = buf;
-					vec[j].iov_len = i;
-				}
+				j = stress_sock_vec(vec, buf, socket_msg_size);
 				(void)memset(&msg, 0, sizeof(msg));
 				msg.msg_iov = vec;
 				msg.msg_iovlen = j;
@@ -1053,21 +1706,31 @@ static int stress_sock_server(
 				break;
 #if defined(HAVE_SENDMMSG)
 			case SOCKET_OPT_SENDMMSG:
-				(void)memset(msgvec, 0, sizeof(msgvec));
-				for (j = 0, i = 16; i < MMAP_IO_SIZE; i += 16, j++) {
-					vec[j].iov_base = buf;
-					vec[j].iov_len = i;
-				}
-				for (i = 0; i < MSGVEC_SIZE; i++) {
+				(void)memset(msgvec, 0, sizeof(*msgvec) * socket_msgs);
+				j = stress_sock_vec(vec, buf, socket_msg_size);
+				for (i = 0; i < socket_msgs; i++) {
 					msgvec[i].msg_hdr.msg_iov = vec;
 					msgvec[i].msg_hdr.msg_iovlen = j;
 				}
-				if (sendmmsg(sfd, msgvec, MSGVEC_SIZE, 0) < 0) {
+				if (sendmmsg(sfd, msgvec, socket_msgs, 0) < 0) {
 					if ((errno != EINTR) && (errno != EPIPE))
 						pr_fail("%s: sendmmsg failed, errno=%d (%s)\n",
 							args->name, errno, strerror(errno));
 				} else
-					msgs += (MSGVEC_SIZE * j);
+					msgs += (socket_msgs * j);
+				break;
+#endif
+#if defined(STRESS_SOCK_IO_URING)
+			case SOCKET_OPT_IO_URING:
+				sent = stress_sock_uring_send(&ring, sfd, buf,
+					socket_msg_size, socket_msgs, sendflag);
+				if (sent < 0) {
+					if ((errno != EINTR) && (errno != EPIPE) &&
+					    (errno != ECONNRESET))
+						pr_fail("%s: io-uring send failed, errno=%d (%s)\n",
+							args->name, errno, strerror(errno));
+				} else
+					msgs += (uint64_t)sent;
 				break;
 #endif
 			default:
@@ -1106,6 +1769,10 @@ static int stress_sock_server(
 	} while (keep_stressing(args));
 
 die_close:
+#if defined(STRESS_SOCK_IO_URING)
+	if (ring.fd >= 0)
+		stress_sock_uring_close(&ring);
+#endif
 	(void)close(fd);
 die:
 	if (ptr != MAP_FAILED)
@@ -1175,6 +1842,9 @@ static int stress_sock(const stress_args_t *args)
 	int socket_protocol = 0;
 #endif
 	int socket_zerocopy = false;
+	uint32_t socket_msgs = DEFAULT_SOCKET_MSGS;
+	size_t socket_msg_size = 0, buf_size;
+	uint32_t socket_busy_poll = 0;
 	int rc = EXIT_SUCCESS;
 	const bool rt = stress_sock_kernel_rt();
 	char *mmap_buffer;
@@ -1185,6 +1855,9 @@ static int stress_sock(const stress_args_t *args)
 	(void)stress_get_setting("sock-port", &socket_port);
 	(void)stress_get_setting("sock-opts", &socket_opts);
 	(void)stress_get_setting("sock-zerocopy", &socket_zerocopy);
+	(void)stress_get_setting("sock-msgs", &socket_msgs);
+	(void)stress_get_setting("sock-msg-size", &socket_msg_size);
+	(void)stress_get_setting("sock-busy-poll", &socket_busy_poll);
 
 	pr_dbg("%s: process [%d] using socket port %d\n",
 		args->name, (int)args->pid, socket_port + (int)args->instance);
@@ -1192,7 +1865,24 @@ static int stress_sock(const stress_args_t *args)
 	if (stress_sighandler(args->name, SIGPIPE, stress_sock_sigpipe_handler, NULL) < 0)
 		return EXIT_NO_RESOURCE;
 
-	mmap_buffer = (char *)mmap(NULL, MMAP_BUF_SIZE, PROT_READ | PROT_WRITE,
+#if defined(STRESS_SOCK_IO_URING)
+	if (socket_opts == SOCKET_OPT_IO_URING) {
+		stress_sock_uring_t ring;
+
+		/* io_uring_disabled or seccomp give EPERM */
+		if (stress_sock_uring_setup(&ring, socket_msgs) < 0) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: io-uring not available, errno=%d (%s), "
+					"skipping stressor\n", args->name,
+					errno, strerror(errno));
+			return EXIT_NO_RESOURCE;
+		}
+		stress_sock_uring_close(&ring);
+	}
+#endif
+
+	buf_size = STRESS_MAXIMUM(MMAP_BUF_SIZE, socket_msg_size);
+	mmap_buffer = (char *)mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
 				MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
 	if (mmap_buffer == MAP_FAILED) {
 		pr_inf("%s: cannot mmap I/O buffer, errno=%d (%s)\n",
@@ -1216,14 +1906,16 @@ again:
 	} else if (pid == 0) {
 		stress_sock_client(args, mmap_buffer, ppid, socket_opts,
 			socket_domain, socket_type, socket_protocol,
-			socket_port, rt, socket_zerocopy);
-		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+			socket_port, rt, socket_zerocopy, socket_msgs,
+			socket_msg_size, socket_busy_poll);
+		(void)munmap((void *)mmap_buffer, buf_size);
 		_exit(rc);
 	} else {
 		rc = stress_sock_server(args, mmap_buffer, pid, ppid, socket_opts,
 			socket_domain, socket_type, socket_protocol,
-			socket_port, rt, socket_zerocopy);
-		(void)munmap((void *)mmap_buffer, MMAP_BUF_SIZE);
+			socket_port, rt, socket_zerocopy, socket_msgs,
+			socket_msg_size, socket_busy_poll);
+		(void)munmap((void *)mmap_buffer, buf_size);
 
 	}
 finish:
@@ -1233,7 +1925,10 @@ finish:
 }
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_sock_busy_poll,	stress_set_socket_busy_poll },
 	{ OPT_sock_domain,	stress_set_socket_domain },
+	{ OPT_sock_msgs,	stress_set_socket_msgs },
+	{ OPT_sock_msg_size,	stress_set_socket_msg_size },
 	{ OPT_sock_opts,	stress_set_socket_opts },
 	{ OPT_sock_type,	stress_set_socket_type },
 	{ OPT_sock_port,	stress_set_socket_port },
@@ -0,0 +1,661 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"spawnscale N",		"start N workers measuring process creation scalability" },
+	{ NULL,	"spawnscale-ops N",	"stop after N spawnscale measurement points" },
+	{ NULL,	"spawnscale-method M",	"fork, vfork, clone3, posix_spawn, exec or all" },
+	{ NULL,	"spawnscale-rss list",	"comma separated list of parent resident sizes" },
+	{ NULL,	"spawnscale-threads list", "comma separated list of concurrent spawners" },
+	{ NULL,	"spawnscale-thp",	"also measure with the parent backed by huge pages" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define SPAWNSCALE_METHOD_ALL	(0)
+#define SPAWNSCALE_MAX_RSS	(8)		/* sizes in a --spawnscale-rss list */
+#define SPAWNSCALE_MAX_THREADS	(8)		/* entries in a --spawnscale-threads list */
+#define SPAWNSCALE_THREADS_LIMIT (64)		/* most concurrent spawners */
+#define SPAWNSCALE_RSS_LIMIT	(64 * GB)
+#define SPAWNSCALE_SLICE	(0.25)		/* seconds per measurement point */
+#define SPAWNSCALE_MAX_FAILS	(16)		/* give up on a point after this */
+#define SPAWNSCALE_LAT_SUB	(4)		/* latency buckets per power of 2 */
+#define SPAWNSCALE_LAT_BUCKETS	(64 * SPAWNSCALE_LAT_SUB)
+
+#define SPAWNSCALE_DEFAULT_RSS	"1M,16M,256M,1G"
+
+#define SPAWNSCALE_FORK		(0)
+#define SPAWNSCALE_VFORK	(1)
+#define SPAWNSCALE_CLONE3	(2)
+#define SPAWNSCALE_POSIX_SPAWN	(3)
+#define SPAWNSCALE_EXEC		(4)
+
+/* indexed by the SPAWNSCALE_* mechanisms */
+static const char * const spawnscale_methods[] = {
+	"fork",
+	"vfork",
+	"clone3",
+	"posix_spawn",
+	"exec",
+};
+
+#define SPAWNSCALE_METHODS	SIZEOF_ARRAY(spawnscale_methods)
+
+/* results index of a parent size, THP setting, thread count and mechanism */
+#define SPAWNSCALE_RESULT(r, thp, t, m)	\
+	(((((size_t)(r) * 2) + (size_t)(thp)) * SPAWNSCALE_MAX_THREADS + (size_t)(t)) * \
+	 SPAWNSCALE_METHODS + (size_t)(m))
+
+/*
+ *  stress_spawnscale_list_parse()
+ *	parse a comma separated list of sizes or counts in the
+ *	range min..max, returns the number of entries or -1
+ */
+static int stress_spawnscale_list_parse(
+	const char *name,
+	const char *opt,
+	const bool bytes,
+	const uint64_t min,
+	const uint64_t max,
+	uint64_t *values,
+	const int n_max)
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		if (n >= n_max) {
+			(void)fprintf(stderr, "%s has more than %d entries\n", name, n_max);
+			free(str);
+			return -1;
+		}
+		values[n] = bytes ? stress_get_uint64_byte(token) : stress_get_uint64(token);
+		if (bytes)
+			stress_check_range_bytes(name, values[n], min, max);
+		else
+			stress_check_range(name, values[n], min, max);
+		n++;
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "%s needs at least one entry\n", name);
+		return -1;
+	}
+	return n;
+}
+
+static int stress_set_spawnscale_method(const char *opt)
+{
+	size_t i;
+	int method;
+
+	if (!strcmp(opt, "all")) {
+		method = SPAWNSCALE_METHOD_ALL;
+		return stress_set_setting("spawnscale-method", TYPE_ID_INT, &method);
+	}
+	for (i = 0; i < SPAWNSCALE_METHODS; i++) {
+		if (!strcmp(opt, spawnscale_methods[i])) {
+			method = (int)i + 1;
+			return stress_set_setting("spawnscale-method", TYPE_ID_INT, &method);
+		}
+	}
+	(void)fprintf(stderr, "spawnscale-method must be one of: all");
+	for (i = 0; i < SPAWNSCALE_METHODS; i++)
+		(void)fprintf(stderr, " %s", spawnscale_methods[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_spawnscale_rss(const char *opt)
+{
+	uint64_t values[SPAWNSCALE_MAX_RSS];
+
+	if (stress_spawnscale_list_parse("spawnscale-rss", opt, true,
+			1 * MB, SPAWNSCALE_RSS_LIMIT, values, SPAWNSCALE_MAX_RSS) < 0)
+		return -1;
+	return stress_set_setting("spawnscale-rss", TYPE_ID_STR, opt);
+}
+
+static int stress_set_spawnscale_threads(const char *opt)
+{
+	uint64_t values[SPAWNSCALE_MAX_THREADS];
+
+	if (stress_spawnscale_list_parse("spawnscale-threads", opt, false,
+			1, SPAWNSCALE_THREADS_LIMIT, values, SPAWNSCALE_MAX_THREADS) < 0)
+		return -1;
+	return stress_set_setting("spawnscale-threads", TYPE_ID_STR, opt);
+}
+
+static int stress_set_spawnscale_thp(const char *opt)
+{
+	bool spawnscale_thp = true;
+
+	(void)opt;
+
+	return stress_set_setting("spawnscale-thp", TYPE_ID_BOOL, &spawnscale_thp);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_spawnscale_method,	stress_set_spawnscale_method },
+	{ OPT_spawnscale_rss,		stress_set_spawnscale_rss },
+	{ OPT_spawnscale_threads,	stress_set_spawnscale_threads },
+	{ OPT_spawnscale_thp,		stress_set_spawnscale_thp },
+	{ 0,				NULL }
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+
+/*
+ *  spawn counts and latency histogram of one measurement point
+ */
+typedef struct {
+	uint64_t spawns;			/* children spawned and reaped */
+	uint64_t fails;				/* failed spawns */
+	double duration;			/* seconds spawning */
+	uint64_t lat[SPAWNSCALE_LAT_BUCKETS];	/* spawn to reap latency */
+	bool measured;				/* point has been measured */
+} stress_spawnscale_stats_t;
+
+typedef struct {
+	int method;		/* spawn mechanism */
+	double deadline;	/* time to stop spawning */
+	char *path;		/* stress-ng executable for exec methods */
+	stress_spawnscale_stats_t stats;
+} stress_spawnscale_thread_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;
+	stress_spawnscale_thread_t info;
+} stress_spawnscale_pthread_t;
+
+/*
+ *  stress_spawnscale_lat_bucket()
+ *	map a latency in nanoseconds to a log2 histogram bucket with
+ *	SPAWNSCALE_LAT_SUB buckets per power of 2
+ */
+static inline size_t stress_spawnscale_lat_bucket(const uint64_t ns)
+{
+	uint64_t v;
+	size_t msb = 0;
+
+	if (ns < SPAWNSCALE_LAT_SUB)
+		return (size_t)ns;
+	for (v = ns; v > 1; v >>= 1)
+		msb++;
+	return ((msb - 1) * SPAWNSCALE_LAT_SUB) +
+		(size_t)((ns >> (msb - 2)) & (SPAWNSCALE_LAT_SUB - 1));
+}
+
+/*
+ *  stress_spawnscale_lat_value()
+ *	upper bound in nanoseconds of a latency histogram bucket
+ */
+static inline uint64_t stress_spawnscale_lat_value(const size_t bucket)
+{
+	const size_t msb = (bucket / SPAWNSCALE_LAT_SUB) + 1;
+	const uint64_t sub = (uint64_t)(bucket % SPAWNSCALE_LAT_SUB);
+
+	if (bucket < SPAWNSCALE_LAT_SUB)
+		return (uint64_t)bucket;
+	return ((SPAWNSCALE_LAT_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ *  stress_spawnscale_percentile()
+ *	latency in microseconds below which pct percent of spawns are
+ */
+static double stress_spawnscale_percentile(const stress_spawnscale_stats_t *stats, const double pct)
+{
+	const uint64_t target = (uint64_t)(((double)stats->spawns * pct) / 100.0);
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < SPAWNSCALE_LAT_BUCKETS; i++) {
+		sum += stats->lat[i];
+		if (sum > target)
+			return (double)stress_spawnscale_lat_value(i) / 1000.0;
+	}
+	return 0.0;
+}
+
+/*
+ *  stress_spawnscale_spawn()
+ *	create a child that exits straight away with the given
+ *	mechanism, returns the child pid or -1
+ */
+static pid_t stress_spawnscale_spawn(const int method, char *path)
+{
+	static char *env_new[] = { NULL };
+	char *argv_new[] = { path, "--exec-exit", NULL };
+	pid_t pid;
+
+	switch (method) {
+	case SPAWNSCALE_CLONE3: {
+		struct shim_clone_args cl_args;
+
+		(void)memset(&cl_args, 0, sizeof(cl_args));
+		cl_args.exit_signal = SIGCHLD;
+		pid = (pid_t)sys_clone3(&cl_args, sizeof(cl_args));
+		if (pid == 0)
+			_exit(0);
+		return pid;
+	}
+#if defined(HAVE_SPAWN_H) &&	\
+    defined(HAVE_POSIX_SPAWN)
+	case SPAWNSCALE_POSIX_SPAWN: {
+		int ret;
+
+		ret = posix_spawn(&pid, path, NULL, NULL, argv_new, env_new);
+		if (ret) {
+			errno = ret;
+			return -1;
+		}
+		return pid;
+	}
+#endif
+	case SPAWNSCALE_EXEC:
+		pid = fork();
+		if (pid == 0) {
+			(void)execve(path, argv_new, env_new);
+			_exit(EXIT_FAILURE);
+		}
+		return pid;
+	case SPAWNSCALE_FORK:
+	default:
+		pid = fork();
+		if (pid == 0)
+			_exit(0);
+		return pid;
+	}
+}
+
+/*
+ *  stress_spawnscale_vfork()
+ *	vfork a child that exits straight away, kept apart so
+ *	the child shares as little of the caller's frame as possible
+ */
+static pid_t NOINLINE stress_spawnscale_vfork(void)
+{
+	pid_t pid;
+
+	pid = shim_vfork();
+	if (pid == 0)
+		_exit(0);
+	return pid;
+}
+
+/*
+ *  stress_spawnscale_pthread()
+ *	spawn and reap children until the deadline
+ */
+static void *stress_spawnscale_pthread(void *arg)
+{
+	stress_spawnscale_pthread_t *pthread = (stress_spawnscale_pthread_t *)arg;
+	stress_spawnscale_thread_t *info = &pthread->info;
+	stress_spawnscale_stats_t *stats = &info->stats;
+	double t_start = stress_time_now(), t_now = t_start;
+
+	while ((t_now < info->deadline) && keep_stressing_flag()) {
+		const double t = t_now;
+		int status;
+		pid_t pid;
+
+		if (info->method == SPAWNSCALE_VFORK)
+			pid = stress_spawnscale_vfork();
+		else
+			pid = stress_spawnscale_spawn(info->method, info->path);
+		if (pid < 0) {
+			if (++stats->fails >= SPAWNSCALE_MAX_FAILS)
+				break;
+			t_now = stress_time_now();
+			continue;
+		}
+		(void)shim_waitpid(pid, &status, 0);
+		t_now = stress_time_now();
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			stats->fails++;
+			continue;
+		}
+		stats->lat[stress_spawnscale_lat_bucket((uint64_t)((t_now - t) * 1.0E9))]++;
+		stats->spawns++;
+	}
+	stats->duration = t_now - t_start;
+	return &pthread->ret;
+}
+
+/*
+ *  stress_spawnscale_point()
+ *	measure one mechanism with the given number of concurrent
+ *	spawning threads, merging the per thread stats into stats
+ */
+static void stress_spawnscale_point(
+	const int method,
+	const size_t threads,
+	char *path,
+	stress_spawnscale_stats_t *stats)
+{
+	stress_spawnscale_pthread_t pthreads[SPAWNSCALE_THREADS_LIMIT];
+	const double deadline = stress_time_now() + SPAWNSCALE_SLICE;
+	double duration = 0.0;
+	size_t i, j, started = 0;
+
+	for (i = 0; i < threads; i++) {
+		(void)memset(&pthreads[i], 0, sizeof(pthreads[i]));
+		pthreads[i].info.method = method;
+		pthreads[i].info.deadline = deadline;
+		pthreads[i].info.path = path;
+		pthreads[i].ret = pthread_create(&pthreads[i].pthread, NULL,
+			stress_spawnscale_pthread, (void *)&pthreads[i]);
+		if (pthreads[i].ret)
+			break;
+		started++;
+	}
+	for (i = 0; i < started; i++) {
+		const stress_spawnscale_stats_t *s = &pthreads[i].info.stats;
+
+		(void)pthread_join(pthreads[i].pthread, NULL);
+		stats->spawns += s->spawns;
+		stats->fails += s->fails;
+		for (j = 0; j < SPAWNSCALE_LAT_BUCKETS; j++)
+			stats->lat[j] += s->lat[j];
+		if (s->duration > duration)
+			duration = s->duration;
+	}
+	stats->duration += duration;
+	stats->measured = true;
+}
+
+/*
+ *  stress_spawnscale_rss()
+ *	map and fault in a rss byte parent resident set, backed
+ *	by huge pages if thp is set
+ */
+static uint8_t *stress_spawnscale_rss(
+	const stress_args_t *args,
+	const size_t rss,
+	const bool thp)
+{
+	uint8_t *buf;
+	size_t i;
+
+	buf = (uint8_t *)mmap(NULL, rss, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		return NULL;
+#if defined(MADV_HUGEPAGE) &&	\
+    defined(MADV_NOHUGEPAGE)
+	(void)shim_madvise((void *)buf, rss, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+	(void)thp;
+#endif
+	for (i = 0; keep_stressing_flag() && (i < rss); i += args->page_size)
+		buf[i] = (uint8_t)i;
+	return buf;
+}
+
+/*
+ *  stress_spawnscale_report()
+ *	report spawns per second and latency percentiles for each
+ *	parent size, THP setting, thread count and mechanism
+ */
+static void stress_spawnscale_report(
+	const stress_args_t *args,
+	const stress_spawnscale_stats_t *results,
+	const uint64_t *rss,
+	const int n_rss,
+	const uint64_t *threads,
+	const int n_threads,
+	const int n_thp)
+{
+	struct utsname uts;
+	bool lock = false;
+	int r, thp, t, idx = 0;
+	size_t m;
+
+	if (uname(&uts) < 0)
+		(void)shim_strlcpy(uts.release, "unknown", sizeof(uts.release));
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: kernel %s\n", args->name, uts.release);
+	for (r = 0; r < n_rss; r++) {
+		for (thp = 0; thp < n_thp; thp++) {
+			char szstr[32];
+			bool measured = false;
+
+			for (t = 0; t < n_threads; t++)
+				for (m = 0; m < SPAWNSCALE_METHODS; m++)
+					measured |= results[SPAWNSCALE_RESULT(r, thp, t, m)].measured;
+			if (!measured)
+				continue;
+			stress_uint64_to_str(szstr, sizeof(szstr), rss[r]);
+			pr_inf_lock(&lock, "%s: parent RSS %s, THP %s:\n", args->name,
+				szstr, thp ? "on" : "off");
+			pr_inf_lock(&lock, "%s: %-12s %7s %11s %10s %10s\n", args->name,
+				"method", "threads", "spawns/sec", "p50 usec", "p99 usec");
+			for (t = 0; t < n_threads; t++) {
+				for (m = 0; m < SPAWNSCALE_METHODS; m++) {
+					const stress_spawnscale_stats_t *s =
+						&results[SPAWNSCALE_RESULT(r, thp, t, m)];
+
+					if (!s->measured)
+						continue;
+					if (!s->spawns || (s->duration <= 0.0)) {
+						pr_inf_lock(&lock, "%s: %-12s %7" PRIu64 " %11s %10s %10s\n",
+							args->name, spawnscale_methods[m], threads[t],
+							"n/a", "n/a", "n/a");
+						continue;
+					}
+					pr_inf_lock(&lock, "%s: %-12s %7" PRIu64 " %11.1f %10.1f %10.1f\n",
+						args->name, spawnscale_methods[m], threads[t],
+						(double)s->spawns / s->duration,
+						stress_spawnscale_percentile(s, 50.0),
+						stress_spawnscale_percentile(s, 99.0));
+				}
+			}
+		}
+	}
+	pr_unlock(&lock);
+
+	/* Single spawner rate of each mechanism from the largest parent measured */
+	for (m = 0; m < SPAWNSCALE_METHODS; m++) {
+		for (r = n_rss - 1; r >= 0; r--) {
+			const stress_spawnscale_stats_t *s = &results[SPAWNSCALE_RESULT(r, 0, 0, m)];
+			char desc[32];
+
+			if (!s->measured || !s->spawns || (s->duration <= 0.0))
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s spawns/sec", spawnscale_methods[m]);
+			stress_misc_stats_set(args->misc_stats, idx++, desc,
+				(double)s->spawns / s->duration);
+			break;
+		}
+	}
+}
+
+/*
+ *  stress_spawnscale_child()
+ *	for each parent resident size, with and without THP, time
+ *	each spawn mechanism with each number of concurrent spawners
+ */
+static int stress_spawnscale_child(const stress_args_t *args, void *context)
+{
+	stress_spawnscale_stats_t *results;
+	uint64_t rss[SPAWNSCALE_MAX_RSS], threads[SPAWNSCALE_MAX_THREADS];
+	int n_rss, n_threads, n_thp, method = SPAWNSCALE_METHOD_ALL;
+	char *rss_opt = SPAWNSCALE_DEFAULT_RSS, *threads_opt = NULL;
+	char path[PATH_MAX + 1];
+	size_t shmall, freemem, totalmem, freeswap;
+	bool spawnscale_thp = false, can_exec = true;
+	ssize_t len;
+	int r;
+
+	(void)context;
+
+	(void)stress_get_setting("spawnscale-method", &method);
+	(void)stress_get_setting("spawnscale-rss", &rss_opt);
+	(void)stress_get_setting("spawnscale-threads", &threads_opt);
+	(void)stress_get_setting("spawnscale-thp", &spawnscale_thp);
+	n_thp = spawnscale_thp ? 2 : 1;
+
+	n_rss = stress_spawnscale_list_parse("spawnscale-rss", rss_opt, true,
+		1 * MB, SPAWNSCALE_RSS_LIMIT, rss, SPAWNSCALE_MAX_RSS);
+	if (threads_opt) {
+		n_threads = stress_spawnscale_list_parse("spawnscale-threads", threads_opt,
+			false, 1, SPAWNSCALE_THREADS_LIMIT, threads, SPAWNSCALE_MAX_THREADS);
+	} else {
+		const int32_t cpus = stress_get_processors_online();
+
+		threads[0] = 1;
+		n_threads = 1;
+		if (cpus > 1)
+			threads[n_threads++] = STRESS_MINIMUM((uint64_t)cpus, SPAWNSCALE_THREADS_LIMIT);
+	}
+	if ((n_rss < 0) || (n_threads < 0))
+		return EXIT_FAILURE;
+
+	/* Leave room for the children and the rest of the system */
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	for (r = 0; r < n_rss; r++) {
+		if (freemem && (rss[r] > freemem / 2)) {
+			if (args->instance == 0) {
+				char szstr[32];
+
+				stress_uint64_to_str(szstr, sizeof(szstr), rss[r]);
+				pr_inf("%s: parent RSS of %s and larger exceed half of "
+					"free memory, skipping them\n", args->name, szstr);
+			}
+			n_rss = r;
+			break;
+		}
+	}
+	if (!n_rss) {
+		pr_inf_skip("%s: not enough free memory for the smallest parent "
+			"RSS, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	/*
+	 *  As with the exec and spawn stressors, don't run another
+	 *  executable as root
+	 */
+	len = shim_readlink("/proc/self/exe", path, sizeof(path));
+	if ((len < 0) || (len > PATH_MAX) || (geteuid() == 0)) {
+		can_exec = false;
+		path[0] = '\0';
+		if ((args->instance == 0) && ((method == SPAWNSCALE_METHOD_ALL) ||
+		    (method > SPAWNSCALE_POSIX_SPAWN)))
+			pr_inf("%s: %s, not measuring posix_spawn and exec\n", args->name,
+				geteuid() == 0 ? "running as root" :
+				"cannot determine stress-ng executable name");
+	} else {
+		path[len] = '\0';
+	}
+#if !defined(HAVE_SPAWN_H) ||	\
+    !defined(HAVE_POSIX_SPAWN)
+	if ((args->instance == 0) && ((method == SPAWNSCALE_METHOD_ALL) ||
+	    (method == SPAWNSCALE_POSIX_SPAWN + 1)))
+		pr_inf("%s: posix_spawn is not available\n", args->name);
+#endif
+
+	results = calloc(SPAWNSCALE_RESULT(n_rss, 0, 0, 0), sizeof(*results));
+	if (!results) {
+		pr_inf_skip("%s: cannot allocate results, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		for (r = 0; r < n_rss; r++) {
+			int thp;
+
+			for (thp = 0; thp < n_thp; thp++) {
+				uint8_t *buf;
+				int t;
+
+				if (!keep_stressing(args))
+					goto report;
+				buf = stress_spawnscale_rss(args, (size_t)rss[r], thp);
+				if (!buf)
+					continue;
+				for (t = 0; t < n_threads; t++) {
+					size_t m;
+
+					for (m = 0; m < SPAWNSCALE_METHODS; m++) {
+						if (method && ((size_t)method != m + 1))
+							continue;
+						if ((m >= SPAWNSCALE_POSIX_SPAWN) && !can_exec)
+							continue;
+#if !defined(HAVE_SPAWN_H) ||	\
+    !defined(HAVE_POSIX_SPAWN)
+						if (m == SPAWNSCALE_POSIX_SPAWN)
+							continue;
+#endif
+						if (!keep_stressing(args))
+							break;
+						stress_spawnscale_point((int)m, (size_t)threads[t], path,
+							&results[SPAWNSCALE_RESULT(r, thp, t, m)]);
+						inc_counter(args);
+					}
+				}
+				(void)munmap((void *)buf, (size_t)rss[r]);
+			}
+		}
+	} while (keep_stressing(args));
+
+report:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0)
+		stress_spawnscale_report(args, results, rss, n_rss, threads,
+			n_threads, n_thp);
+	free(results);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_spawnscale()
+ *	measure process creation latency and rate vs. the size of
+ *	the parent and the number of concurrent spawners
+ */
+static int stress_spawnscale(const stress_args_t *args)
+{
+	return stress_oomable_child(args, NULL, stress_spawnscale_child, STRESS_OOMABLE_QUIET);
+}
+
+stressor_info_t stress_spawnscale_info = {
+	.stressor = stress_spawnscale,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_spawnscale_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_SCHEDULER | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
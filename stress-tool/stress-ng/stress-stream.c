@@ -46,6 +46,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"stream-index",		"specify number of indices into the data (0..3)" },
 	{ NULL,	"stream-l3-size N",	"specify the L3 cache size of the CPU" },
 	{ NULL,	"stream-madvise M",	"specify mmap'd stream buffer madvise advice" },
+	{ NULL,	"stream-nt",		"use non-temporal stores, with --stream-index 0" },
 	{ NULL,	NULL,                   NULL }
 };
 
@@ -104,6 +105,184 @@ static int stress_set_stream_index(const char *opt)
 	return stress_set_setting("stream-index", TYPE_ID_UINT32, &stream_index);
 }
 
+static int stress_set_stream_nt(const char *opt)
+{
+	bool stream_nt = true;
+
+	(void)opt;
+	return stress_set_setting("stream-nt", TYPE_ID_BOOL, &stream_nt);
+}
+
+#if defined(HAVE_VECMATH)
+/*
+ *  Explicitly vectorized kernels for --stream-index 0, these
+ *  are built for each TARGET_CLONES ISA so the widest vector
+ *  unit available is used rather than whatever the compiler
+ *  autovectorizes the scalar loops to
+ */
+typedef double stress_stream_vdouble_t __attribute__ ((vector_size (32)));
+
+#define STREAM_VDOUBLES	(sizeof(stress_stream_vdouble_t) / sizeof(double))
+
+static void TARGET_CLONES OPTIMIZE3 stress_stream_copy_vector(
+	double *RESTRICT c,
+	const double *RESTRICT a,
+	const uint64_t n)
+{
+	stress_stream_vdouble_t *RESTRICT vc = (stress_stream_vdouble_t *)c;
+	const stress_stream_vdouble_t *RESTRICT va = (const stress_stream_vdouble_t *)a;
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES; i++)
+		vc[i] = va[i];
+}
+
+static void TARGET_CLONES OPTIMIZE3 stress_stream_scale_vector(
+	double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n)
+{
+	stress_stream_vdouble_t *RESTRICT vb = (stress_stream_vdouble_t *)b;
+	const stress_stream_vdouble_t *RESTRICT vc = (const stress_stream_vdouble_t *)c;
+	const stress_stream_vdouble_t vq = { q, q, q, q };
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES; i++)
+		vb[i] = vq * vc[i];
+}
+
+static void TARGET_CLONES OPTIMIZE3 stress_stream_add_vector(
+	const double *RESTRICT a,
+	const double *RESTRICT b,
+	double *RESTRICT c,
+	const uint64_t n)
+{
+	const stress_stream_vdouble_t *RESTRICT va = (const stress_stream_vdouble_t *)a;
+	const stress_stream_vdouble_t *RESTRICT vb = (const stress_stream_vdouble_t *)b;
+	stress_stream_vdouble_t *RESTRICT vc = (stress_stream_vdouble_t *)c;
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES; i++)
+		vc[i] = va[i] + vb[i];
+}
+
+static void TARGET_CLONES OPTIMIZE3 stress_stream_triad_vector(
+	double *RESTRICT a,
+	const double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n)
+{
+	stress_stream_vdouble_t *RESTRICT va = (stress_stream_vdouble_t *)a;
+	const stress_stream_vdouble_t *RESTRICT vb = (const stress_stream_vdouble_t *)b;
+	const stress_stream_vdouble_t *RESTRICT vc = (const stress_stream_vdouble_t *)c;
+	const stress_stream_vdouble_t vq = { q, q, q, q };
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES; i++)
+		va[i] = vb[i] + (vc[i] * vq);
+}
+#define HAVE_STREAM_VECTOR
+#endif
+
+/*
+ *  Non-temporal store variants, the results are not read back
+ *  before they are evicted so writing around the cache saves
+ *  the read for ownership of each destination cache line, see
+ *  https://akkadia.org/drepper/cpumemory.pdf - section 6.1
+ */
+#if defined(HAVE_VECMATH) &&			\
+    defined(HAVE_BUILTIN_NONTEMPORAL_STORE)
+/* Clang non-temporal stores */
+#define STREAM_NT_STORE(ptr, v)	__builtin_nontemporal_store(v, ptr)
+#define HAVE_STREAM_NT
+#elif defined(HAVE_VECMATH) &&			\
+    defined(HAVE_XMMINTRIN_H) &&		\
+    defined(HAVE_V2DI) &&			\
+    defined(HAVE_BUILTIN_IA32_MOVNTDQ) &&	\
+    defined(HAVE_BUILTIN_SFENCE)
+/* gcc x86 non-temporal stores */
+#define STREAM_NT_STORE(ptr, v)	__builtin_ia32_movntdq((__v2di *)(ptr), (__v2di)(v))
+#define HAVE_STREAM_NT
+#endif
+
+#if defined(HAVE_STREAM_NT)
+typedef double stress_stream_vdouble2_t __attribute__ ((vector_size (16)));
+
+#define STREAM_VDOUBLES2	(sizeof(stress_stream_vdouble2_t) / sizeof(double))
+
+#if defined(HAVE_BUILTIN_SFENCE)
+#define STREAM_NT_FENCE()	__builtin_ia32_sfence()
+#else
+#define STREAM_NT_FENCE()
+#endif
+
+static void OPTIMIZE3 stress_stream_copy_nt(
+	double *RESTRICT c,
+	const double *RESTRICT a,
+	const uint64_t n)
+{
+	stress_stream_vdouble2_t *RESTRICT vc = (stress_stream_vdouble2_t *)c;
+	const stress_stream_vdouble2_t *RESTRICT va = (const stress_stream_vdouble2_t *)a;
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES2; i++)
+		STREAM_NT_STORE(&vc[i], va[i]);
+	STREAM_NT_FENCE();
+}
+
+static void OPTIMIZE3 stress_stream_scale_nt(
+	double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n)
+{
+	stress_stream_vdouble2_t *RESTRICT vb = (stress_stream_vdouble2_t *)b;
+	const stress_stream_vdouble2_t *RESTRICT vc = (const stress_stream_vdouble2_t *)c;
+	const stress_stream_vdouble2_t vq = { q, q };
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES2; i++)
+		STREAM_NT_STORE(&vb[i], vq * vc[i]);
+	STREAM_NT_FENCE();
+}
+
+static void OPTIMIZE3 stress_stream_add_nt(
+	const double *RESTRICT a,
+	const double *RESTRICT b,
+	double *RESTRICT c,
+	const uint64_t n)
+{
+	const stress_stream_vdouble2_t *RESTRICT va = (const stress_stream_vdouble2_t *)a;
+	const stress_stream_vdouble2_t *RESTRICT vb = (const stress_stream_vdouble2_t *)b;
+	stress_stream_vdouble2_t *RESTRICT vc = (stress_stream_vdouble2_t *)c;
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES2; i++)
+		STREAM_NT_STORE(&vc[i], va[i] + vb[i]);
+	STREAM_NT_FENCE();
+}
+
+static void OPTIMIZE3 stress_stream_triad_nt(
+	double *RESTRICT a,
+	const double *RESTRICT b,
+	const double *RESTRICT c,
+	const double q,
+	const uint64_t n)
+{
+	stress_stream_vdouble2_t *RESTRICT va = (stress_stream_vdouble2_t *)a;
+	const stress_stream_vdouble2_t *RESTRICT vb = (const stress_stream_vdouble2_t *)b;
+	const stress_stream_vdouble2_t *RESTRICT vc = (const stress_stream_vdouble2_t *)c;
+	const stress_stream_vdouble2_t vq = { q, q };
+	register uint64_t i;
+
+	for (i = 0; i < n / STREAM_VDOUBLES2; i++)
+		STREAM_NT_STORE(&va[i], vb[i] + (vc[i] * vq));
+	STREAM_NT_FENCE();
+}
+#endif
+
 static inline void OPTIMIZE3 stress_stream_copy_index0(
 	double *RESTRICT c,
 	const double *RESTRICT a,
@@ -356,7 +535,10 @@ static inline void *stress_stream_mmap(const stress_args_t *args, uint64_t sz)
 	} else {
 #if defined(HAVE_MADVISE)
 		int ret, advice = MADV_NORMAL;
+#endif
 
+		stress_numa_mbind(args, ptr, (size_t)sz);
+#if defined(HAVE_MADVISE)
 		(void)stress_get_setting("stream-madvise", &advice);
 
 		ret = madvise(ptr, sz, advice);
@@ -441,11 +623,12 @@ static int stress_stream(const stress_args_t *args)
 	double *a, *b, *c;
 	size_t *idx1 = NULL, *idx2 = NULL, *idx3 = NULL;
 	const double q = 3.0;
-	double mb_rate, mb, fp_rate, fp, t1, t2, dt;
+	double mb_rate = 0.0, mb, fp_rate, fp, t1, t2, dt;
+	uint64_t numa_pages[STRESS_NUMA_MAX_NODES];
 	uint32_t stream_index = 0;
 	uint64_t L3, sz, n, sz_idx;
 	uint64_t stream_L3_size = DEFAULT_STREAM_L3_SIZE;
-	bool guess = false;
+	bool guess = false, stream_nt = false;
 
 	if (stress_get_setting("stream-L3-size", &stream_L3_size))
 		L3 = stream_L3_size;
@@ -453,6 +636,20 @@ static int stress_stream(const stress_args_t *args)
 		L3 = get_stream_L3_size(args);
 
 	(void)stress_get_setting("stream-index", &stream_index);
+	(void)stress_get_setting("stream-nt", &stream_nt);
+#if defined(HAVE_STREAM_NT)
+	if (stream_nt && (stream_index != 0)) {
+		if (args->instance == 0)
+			pr_inf("%s: --stream-nt only applies to --stream-index 0, "
+				"using cached stores\n", args->name);
+		stream_nt = false;
+	}
+#else
+	if (stream_nt && (args->instance == 0))
+		pr_inf("%s: non-temporal stores not supported, "
+			"using cached stores\n", args->name);
+	stream_nt = false;
+#endif
 
 	/* Have to take a hunch and badly guess size */
 	if (!L3) {
@@ -551,10 +748,26 @@ static int stress_stream(const stress_args_t *args)
 			break;
 		case 0:
 		default:
+#if defined(HAVE_STREAM_NT)
+			if (stream_nt) {
+				stress_stream_copy_nt(c, a, n);
+				stress_stream_scale_nt(b, c, q, n);
+				stress_stream_add_nt(c, b, a, n);
+				stress_stream_triad_nt(a, b, c, q, n);
+				break;
+			}
+#endif
+#if defined(HAVE_STREAM_VECTOR)
+			stress_stream_copy_vector(c, a, n);
+			stress_stream_scale_vector(b, c, q, n);
+			stress_stream_add_vector(c, b, a, n);
+			stress_stream_triad_vector(a, b, c, q, n);
+#else
 			stress_stream_copy_index0(c, a, n);
 			stress_stream_scale_index0(b, c, q, n);
 			stress_stream_add_index0(c, b, a, n);
 			stress_stream_triad_index0(a, b, c, q, n);
+#endif
 			break;
 		}
 		inc_counter(args);
@@ -567,15 +780,21 @@ static int stress_stream(const stress_args_t *args)
 	if (dt >= 4.5) {
 		mb_rate = mb / (dt);
 		fp_rate = fp / (dt);
-		pr_inf("%s: memory rate: %.2f MB/sec, %.2f Mflop/sec"
+		pr_inf("%s: memory rate: %.2f MB/sec (%.2f GB/sec), %.2f Mflop/sec"
 			" (instance %" PRIu32 ")\n",
-			args->name, mb_rate, fp_rate, args->instance);
+			args->name, mb_rate, mb_rate / KB, fp_rate, args->instance);
 		stress_misc_stats_set(args->misc_stats, 0, "memory rate (MB per sec)", mb_rate);
 		stress_misc_stats_set(args->misc_stats, 1, "memory rate (Mflop per sec)", fp_rate);
+		stress_misc_stats_set(args->misc_stats, 2, "memory rate (GB per sec)", mb_rate / KB);
 	} else {
 		if (args->instance == 0)
 			pr_inf("%s: run duration too short to determine memory rate\n", args->name);
 	}
+	(void)memset(numa_pages, 0, sizeof(numa_pages));
+	(void)stress_numa_pages(args, a, (size_t)sz, numa_pages, STRESS_NUMA_MAX_NODES);
+	(void)stress_numa_pages(args, b, (size_t)sz, numa_pages, STRESS_NUMA_MAX_NODES);
+	(void)stress_numa_pages(args, c, (size_t)sz, numa_pages, STRESS_NUMA_MAX_NODES);
+	stress_numa_report(args, numa_pages, STRESS_NUMA_MAX_NODES, mb_rate);
 
 	rc = EXIT_SUCCESS;
 
@@ -610,6 +829,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_stream_index,	stress_set_stream_index },
 	{ OPT_stream_l3_size,	stress_set_stream_L3_size },
 	{ OPT_stream_madvise,	stress_set_stream_madvise },
+	{ OPT_stream_nt,	stress_set_stream_nt },
 	{ 0,			NULL }
 };
 
@@ -617,5 +837,6 @@ stressor_info_t stress_stream_info = {
 	.stressor = stress_stream,
 	.class = CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY,
 	.opt_set_funcs = opt_set_funcs,
-	.help = help
+	.help = help,
+	.threaded = true
 };
@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"swaprate N",		"start N workers paging a working set through swap" },
+	{ NULL,	"swaprate-ops N",	"stop after N swaprate bogo operations" },
+	{ NULL,	"swaprate-bytes N",	"size of the working set, default larger than RAM" },
+	{ NULL,	"swaprate-hot P",	"percentage of accesses to the hot set" },
+	{ NULL,	"swaprate-hot-size P",	"hot set size as a percentage of the working set" },
+	{ NULL,	"swaprate-target T",	"swap to use: any, file, zram or zswap" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define SWAPRATE_TARGET_ANY	(0)	/* whatever swap is configured */
+#define SWAPRATE_TARGET_FILE	(1)	/* a swap file on the temp path */
+#define SWAPRATE_TARGET_ZRAM	(2)	/* a zram swap device */
+#define SWAPRATE_TARGET_ZSWAP	(3)	/* the zswap compressed cache */
+
+#define DEFAULT_SWAPRATE_HOT		(90)
+#define DEFAULT_SWAPRATE_HOT_SIZE	(10)
+
+#define SWAPRATE_ACCESSES	(4096)	/* page accesses per bogo op */
+#define SWAPRATE_BUCKETS	(16)	/* log2 usec fault latency buckets */
+
+typedef struct {
+	const char *name;
+	const int target;
+} stress_swaprate_target_t;
+
+static const stress_swaprate_target_t swaprate_targets[] = {
+	{ "any",	SWAPRATE_TARGET_ANY },
+	{ "file",	SWAPRATE_TARGET_FILE },
+	{ "zram",	SWAPRATE_TARGET_ZRAM },
+	{ "zswap",	SWAPRATE_TARGET_ZSWAP },
+};
+
+static int stress_set_swaprate_bytes(const char *opt)
+{
+	uint64_t swaprate_bytes;
+
+	swaprate_bytes = stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("swaprate-bytes", swaprate_bytes,
+		MIN_SWAPRATE_BYTES, MAX_MEM_LIMIT);
+	return stress_set_setting("swaprate-bytes", TYPE_ID_UINT64, &swaprate_bytes);
+}
+
+static int stress_set_swaprate_hot(const char *opt)
+{
+	uint32_t swaprate_hot;
+
+	swaprate_hot = stress_get_uint32(opt);
+	stress_check_range("swaprate-hot", swaprate_hot, 0, 100);
+	return stress_set_setting("swaprate-hot", TYPE_ID_UINT32, &swaprate_hot);
+}
+
+static int stress_set_swaprate_hot_size(const char *opt)
+{
+	uint32_t swaprate_hot_size;
+
+	swaprate_hot_size = stress_get_uint32(opt);
+	stress_check_range("swaprate-hot-size", swaprate_hot_size, 1, 100);
+	return stress_set_setting("swaprate-hot-size", TYPE_ID_UINT32, &swaprate_hot_size);
+}
+
+static int stress_set_swaprate_target(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(swaprate_targets); i++) {
+		if (!strcmp(opt, swaprate_targets[i].name))
+			return stress_set_setting("swaprate-target", TYPE_ID_INT,
+				&swaprate_targets[i].target);
+	}
+	(void)fprintf(stderr, "swaprate-target must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(swaprate_targets); i++)
+		(void)fprintf(stderr, " %s", swaprate_targets[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_swaprate_bytes,		stress_set_swaprate_bytes },
+	{ OPT_swaprate_hot,		stress_set_swaprate_hot },
+	{ OPT_swaprate_hot_size,	stress_set_swaprate_hot_size },
+	{ OPT_swaprate_target,		stress_set_swaprate_target },
+	{ 0,				NULL }
+};
+
+#if defined(__linux__) &&	\
+    defined(HAVE_SYS_SWAP_H) &&	\
+    defined(HAVE_SWAP)
+
+#define SWAP_VERSION		(1)
+#define SWAP_SIGNATURE		"SWAPSPACE2"
+#define SWAP_SIGNATURE_SZ	(sizeof(SWAP_SIGNATURE) - 1)
+
+#if !defined(SWAP_FLAG_PRIO_MASK)
+#define SWAP_FLAG_PRIO_MASK	(0x7fff)
+#endif
+
+/* The version 1 swap header after the 1K of boot bits */
+typedef struct {
+	uint32_t	version;
+	uint32_t	last_page;
+	uint32_t	nr_badpages;
+	uint8_t		sws_uuid[16];
+	uint8_t		sws_volume[16];
+} stress_swaprate_header_t;
+
+typedef struct {
+	uint64_t	swaprate_bytes;		/* working set size */
+	uint32_t	swaprate_hot;		/* % of accesses to the hot set */
+	uint32_t	swaprate_hot_size;	/* hot set % of the working set */
+	int		swaprate_target;	/* SWAPRATE_TARGET_* */
+	char		swapfile[PATH_MAX];	/* swap file, file target only */
+} stress_swaprate_context_t;
+
+/*
+ *  stress_swaprate_supported()
+ *	the file target needs CAP_SYS_ADMIN for swapon
+ */
+static int stress_swaprate_supported(const char *name)
+{
+	int swaprate_target = SWAPRATE_TARGET_ANY;
+
+	(void)stress_get_setting("swaprate-target", &swaprate_target);
+	if ((swaprate_target == SWAPRATE_TARGET_FILE) &&
+	    !stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
+		pr_inf_skip("%s stressor will be skipped, "
+			"need to be running with CAP_SYS_ADMIN "
+			"rights to add a swap file\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_swaprate_on_zram()
+ *	returns true if any swap is on a zram device
+ */
+static bool stress_swaprate_on_zram(void)
+{
+	FILE *fp;
+	char buffer[1024];
+	bool zram = false;
+
+	fp = fopen("/proc/swaps", "r");
+	if (!fp)
+		return false;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		if (!strncmp(buffer, "/dev/zram", 9)) {
+			zram = true;
+			break;
+		}
+	}
+	(void)fclose(fp);
+	return zram;
+}
+
+/*
+ *  stress_swaprate_zswap()
+ *	get the zswap enabled state, and set it if enable is
+ *	not NULL, returns -1 if zswap is not available
+ */
+static int stress_swaprate_zswap(const char *enable)
+{
+	static const char path[] = "/sys/module/zswap/parameters/enabled";
+	char buf[8];
+
+	if (enable)
+		return (system_write(path, enable, strlen(enable)) < 0) ? -1 : 1;
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return -1;
+	return (buf[0] == 'Y') ? 1 : 0;
+}
+
+/*
+ *  stress_swaprate_mkswap()
+ *	create and enable a swap file of bytes, the file is
+ *	preferred over any existing swap
+ */
+static int stress_swaprate_mkswap(
+	const stress_args_t *args,
+	const char *filename,
+	const uint64_t bytes)
+{
+	const uint32_t npages = (uint32_t)(bytes / args->page_size);
+	stress_swaprate_header_t hdr;
+	uint8_t *page;
+	uint32_t i;
+	int fd, rc = EXIT_FAILURE;
+
+	page = calloc(1, args->page_size);
+	if (!page) {
+		pr_inf("%s: cannot allocate swap header page, skipping stressor\n",
+			args->name);
+		return EXIT_NO_RESOURCE;
+	}
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = exit_status(errno);
+		pr_fail("%s: open swap file %s failed, errno=%d (%s)\n",
+			args->name, filename, errno, strerror(errno));
+		goto err_free;
+	}
+	/* Swap files can't have holes, allocate or zero every page */
+	if (shim_fallocate(fd, 0, 0, (off_t)npages * args->page_size) < 0) {
+		for (i = 0; i < npages; i++) {
+			if (write(fd, page, args->page_size) < 0) {
+				rc = exit_status(errno);
+				pr_inf("%s: cannot write swap file %s, errno=%d (%s), "
+					"skipping stressor\n", args->name, filename,
+					errno, strerror(errno));
+				goto err_close;
+			}
+		}
+	}
+
+	(void)memset(&hdr, 0, sizeof(hdr));
+	hdr.version = SWAP_VERSION;
+	hdr.last_page = npages - 1;
+	for (i = 0; i < sizeof(hdr.sws_uuid); i++)
+		hdr.sws_uuid[i] = stress_mwc8();
+	(void)snprintf((char *)hdr.sws_volume, sizeof(hdr.sws_volume),
+		"SNG-SWR-%" PRIx32, args->instance);
+	(void)memcpy(page + 1024, &hdr, sizeof(hdr));
+	(void)memcpy(page + args->page_size - SWAP_SIGNATURE_SZ,
+		SWAP_SIGNATURE, SWAP_SIGNATURE_SZ);
+	if (pwrite(fd, page, args->page_size, 0) < 0) {
+		rc = exit_status(errno);
+		pr_fail("%s: write of swap header failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto err_close;
+	}
+	(void)fsync(fd);
+
+	if (swapon(filename, SWAP_FLAG_PREFER | SWAP_FLAG_PRIO_MASK) < 0) {
+		pr_inf_skip("%s: cannot enable swap file on the filesystem, "
+			"errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto err_close;
+	}
+	rc = EXIT_SUCCESS;
+err_close:
+	(void)close(fd);
+err_free:
+	free(page);
+	return rc;
+}
+
+/*
+ *  stress_swaprate_child()
+ *	page a working set through swap with a hot/cold access skew,
+ *	timing every access
+ */
+static int stress_swaprate_child(const stress_args_t *args, void *ctxt)
+{
+	const stress_swaprate_context_t *context = (stress_swaprate_context_t *)ctxt;
+	const size_t page_size = args->page_size;
+	const size_t pages = (size_t)(context->swaprate_bytes / page_size);
+	size_t hot_pages = (size_t)(((uint64_t)pages * context->swaprate_hot_size) / 100);
+	size_t cold_pages, i;
+	uint64_t buckets[SWAPRATE_BUCKETS];
+	uint64_t swap_in1, swap_out1, swap_in2, swap_out2, accesses = 0, faults = 0;
+	double t_start, duration;
+	uint8_t *buf;
+
+	if (!hot_pages)
+		hot_pages = 1;
+	cold_pages = pages - hot_pages;
+
+	buf = (uint8_t *)mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot mmap %zu byte working set, skipping stressor\n",
+			args->name, pages * page_size);
+		return EXIT_NO_RESOURCE;
+	}
+	(void)shim_madvise(buf, pages * page_size, MADV_NOHUGEPAGE);
+
+	/*
+	 *  Fill the working set, a quarter of each page is random and
+	 *  the rest a pattern so the pages compress roughly like an
+	 *  application heap on zram and zswap
+	 */
+	for (i = 0; keep_stressing(args) && (i < pages); i++) {
+		uint8_t *page = buf + (i * page_size);
+
+		stress_mwc_fill(page, page_size / 4);
+		(void)memset(page + (page_size / 4), (int)(i & 0xff), page_size - (page_size / 4));
+	}
+
+	(void)memset(buckets, 0, sizeof(buckets));
+	stress_get_vmstat_swap(&swap_in1, &swap_out1);
+	t_start = stress_time_now();
+	while (keep_stressing(args)) {
+		for (i = 0; i < SWAPRATE_ACCESSES; i++) {
+			size_t page;
+			volatile uint64_t *ptr;
+			double t1, t2;
+			uint64_t usec;
+			int bucket = 0;
+
+			if (!cold_pages || ((stress_mwc32() % 100) < context->swaprate_hot))
+				page = stress_mwc32() % hot_pages;
+			else
+				page = hot_pages + (stress_mwc32() % cold_pages);
+
+			/* Dirty the page so it is written out again */
+			ptr = (volatile uint64_t *)(buf + (page * page_size));
+			t1 = stress_time_now();
+			(*ptr)++;
+			t2 = stress_time_now();
+
+			usec = (uint64_t)((t2 - t1) * 1000000.0);
+			while (usec && (bucket < SWAPRATE_BUCKETS - 1)) {
+				usec >>= 1;
+				bucket++;
+			}
+			buckets[bucket]++;
+			/* Anything slower than 16 usecs has been to swap */
+			if (bucket > 4)
+				faults++;
+		}
+		accesses += SWAPRATE_ACCESSES;
+		inc_counter(args);
+	}
+	duration = stress_time_now() - t_start;
+	stress_get_vmstat_swap(&swap_in2, &swap_out2);
+
+	if ((duration > 0.0) && accesses) {
+		const double page_mb = (double)page_size / (double)MB;
+		const double in_rate = (double)(swap_in2 - swap_in1) * page_mb / duration;
+		const double out_rate = (double)(swap_out2 - swap_out1) * page_mb / duration;
+		bool lock = false;
+		int j;
+
+		pr_lock(&lock);
+		pr_inf_lock(&lock, "%s: swap-in %.2f MB/sec, swap-out %.2f MB/sec (system wide), "
+			"%.2f faults/sec (instance %" PRIu32 ")\n", args->name,
+			in_rate, out_rate, (double)faults / duration, args->instance);
+		for (j = 0; j < SWAPRATE_BUCKETS; j++) {
+			char range[32];
+
+			if (!buckets[j])
+				continue;
+			if (j == 0)
+				(void)snprintf(range, sizeof(range), "< 1");
+			else if (j == 1)
+				(void)snprintf(range, sizeof(range), "1");
+			else if (j == SWAPRATE_BUCKETS - 1)
+				(void)snprintf(range, sizeof(range), ">= %" PRIu64,
+					(uint64_t)1 << (j - 1));
+			else
+				(void)snprintf(range, sizeof(range), "%" PRIu64 "..%" PRIu64,
+					(uint64_t)1 << (j - 1), ((uint64_t)1 << j) - 1);
+			pr_inf_lock(&lock, "%s: access latency %13s usecs: %12" PRIu64
+				" (%6.2f%%)\n", args->name, range, buckets[j],
+				100.0 * (double)buckets[j] / (double)accesses);
+		}
+		pr_unlock(&lock);
+
+		stress_misc_stats_set(args->misc_stats, 0, "swap-in MB per sec", in_rate);
+		stress_misc_stats_set(args->misc_stats, 1, "swap-out MB per sec", out_rate);
+		stress_misc_stats_set(args->misc_stats, 2, "faults per sec",
+			(double)faults / duration);
+	}
+
+	(void)munmap((void *)buf, pages * page_size);
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_swaprate()
+ *	stress the swap path with a working set larger than memory
+ */
+static int stress_swaprate(const stress_args_t *args)
+{
+	stress_swaprate_context_t context;
+	size_t shmall, freemem, totalmem, freeswap;
+	int rc, zswap = -1;
+
+	(void)memset(&context, 0, sizeof(context));
+	context.swaprate_hot = DEFAULT_SWAPRATE_HOT;
+	context.swaprate_hot_size = DEFAULT_SWAPRATE_HOT_SIZE;
+	context.swaprate_target = SWAPRATE_TARGET_ANY;
+	(void)stress_get_setting("swaprate-hot", &context.swaprate_hot);
+	(void)stress_get_setting("swaprate-hot-size", &context.swaprate_hot_size);
+	(void)stress_get_setting("swaprate-target", &context.swaprate_target);
+
+	stress_get_memlimits(&shmall, &freemem, &totalmem, &freeswap);
+	if (!stress_get_setting("swaprate-bytes", &context.swaprate_bytes)) {
+		/*
+		 *  A quarter more than RAM, but no more than free memory
+		 *  and free swap can hold so the OOM killer stays away
+		 */
+		context.swaprate_bytes = (uint64_t)totalmem + (uint64_t)totalmem / 4;
+		if ((context.swaprate_target != SWAPRATE_TARGET_FILE) &&
+		    (context.swaprate_bytes > (uint64_t)freemem + ((uint64_t)freeswap * 9) / 10))
+			context.swaprate_bytes = (uint64_t)freemem + ((uint64_t)freeswap * 9) / 10;
+		context.swaprate_bytes /= args->num_instances;
+	}
+	context.swaprate_bytes &= ~((uint64_t)args->page_size - 1);
+	if (context.swaprate_bytes < MIN_SWAPRATE_BYTES)
+		context.swaprate_bytes = MIN_SWAPRATE_BYTES;
+
+	switch (context.swaprate_target) {
+	case SWAPRATE_TARGET_FILE:
+		rc = stress_temp_dir_mk_args(args);
+		if (rc < 0)
+			return exit_status(-rc);
+		(void)stress_temp_filename_args(args, context.swapfile,
+			sizeof(context.swapfile), stress_mwc32());
+		rc = stress_swaprate_mkswap(args, context.swapfile, context.swaprate_bytes);
+		if (rc != EXIT_SUCCESS) {
+			(void)unlink(context.swapfile);
+			(void)stress_temp_dir_rm_args(args);
+			return rc;
+		}
+		break;
+	case SWAPRATE_TARGET_ZRAM:
+		if (!stress_swaprate_on_zram()) {
+			pr_inf_skip("%s: no zram swap device is enabled, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+		break;
+	case SWAPRATE_TARGET_ZSWAP:
+		zswap = stress_swaprate_zswap(NULL);
+		if (zswap < 0) {
+			pr_inf_skip("%s: zswap is not available, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+		/* Only the first instance turns zswap on, and back off */
+		if ((zswap == 0) && (args->instance == 0) &&
+		    (stress_swaprate_zswap("Y") < 0)) {
+			pr_inf_skip("%s: cannot enable zswap, skipping stressor\n",
+				args->name);
+			return EXIT_NO_RESOURCE;
+		}
+		break;
+	default:
+		break;
+	}
+	if ((args->instance == 0) && (freeswap == 0) &&
+	    (context.swaprate_target != SWAPRATE_TARGET_FILE))
+		pr_inf("%s: no free swap, the working set will only be reclaimed "
+			"from the page cache\n", args->name);
+	pr_dbg("%s: %" PRIu64 " byte working set, %" PRIu32 "%% of accesses to "
+		"the hottest %" PRIu32 "%%\n", args->name, context.swaprate_bytes,
+		context.swaprate_hot, context.swaprate_hot_size);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	rc = stress_oomable_child(args, &context, stress_swaprate_child, STRESS_OOMABLE_NORMAL);
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (context.swaprate_target == SWAPRATE_TARGET_FILE) {
+		if (swapoff(context.swapfile) < 0)
+			pr_fail("%s: swapoff failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+		(void)unlink(context.swapfile);
+		(void)stress_temp_dir_rm_args(args);
+	}
+	if ((zswap == 0) && (args->instance == 0))
+		(void)stress_swaprate_zswap("N");
+
+	return rc;
+}
+
+stressor_info_t stress_swaprate_info = {
+	.stressor = stress_swaprate,
+	.supported = stress_swaprate_supported,
+	.class = CLASS_VM | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_swaprate_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_VM | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
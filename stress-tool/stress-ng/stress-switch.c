@@ -23,17 +23,58 @@
  *
  */
 #include "stress-ng.h"
+#include "io-uring.h"
 
 static const stress_help_t help[] = {
 	{ "s N","switch N",	 "start N workers doing rapid context switches" },
 	{ NULL,	"switch-ops N",	 "stop after N context switch bogo operations" },
 	{ NULL, "switch-freq N", "set frequency of context switches" },
+	{ NULL, "switch-matrix", "measure wakeup cost by wake method and CPU placement" },
+	{ NULL, "switch-method M", "matrix wake method [pipe|eventfd|futex|io-uring|all]" },
+	{ NULL, "switch-placement P", "matrix placement [same-core|smt|llc|cross-socket|all]" },
+	{ NULL, "switch-producers N", "matrix producer threads (default 1)" },
+	{ NULL, "switch-consumers N", "matrix consumer threads (default 1)" },
 	{ NULL, NULL, 		 NULL }
 };
 
 #define SWITCH_STOP	'X'
 #define THRESH_FREQ	(100)		/* Delay adjustment rate in HZ */
 
+#define SWITCH_METHOD_PIPE	(0)
+#define SWITCH_METHOD_EVENTFD	(1)
+#define SWITCH_METHOD_FUTEX	(2)
+#define SWITCH_METHOD_IO_URING	(3)
+#define SWITCH_METHODS		(4)
+
+#define SWITCH_PLACE_SAME_CORE	(0)
+#define SWITCH_PLACE_SMT	(1)
+#define SWITCH_PLACE_LLC	(2)
+#define SWITCH_PLACE_CROSS	(3)
+#define SWITCH_PLACES		(4)
+
+#define SWITCH_THREADS_MAX	(64)	/* producers or consumers */
+#define SWITCH_CELL_TIME	(0.25)	/* seconds per matrix cell */
+#define SWITCH_URING_STOP	(~0ULL)	/* io-uring stop message */
+
+typedef struct {
+	const char *name;
+	const int id;
+} stress_switch_name_t;
+
+static const stress_switch_name_t switch_methods[] = {
+	{ "pipe",	SWITCH_METHOD_PIPE },
+	{ "eventfd",	SWITCH_METHOD_EVENTFD },
+	{ "futex",	SWITCH_METHOD_FUTEX },
+	{ "io-uring",	SWITCH_METHOD_IO_URING },
+};
+
+static const stress_switch_name_t switch_places[] = {
+	{ "same-core",		SWITCH_PLACE_SAME_CORE },
+	{ "smt",		SWITCH_PLACE_SMT },
+	{ "llc",		SWITCH_PLACE_LLC },
+	{ "cross-socket",	SWITCH_PLACE_CROSS },
+};
+
 /*
  *  stress_set_switch_freq()
  *	set context switch freq in Hz from given option
@@ -47,6 +88,753 @@ static int stress_set_switch_freq(const char *opt)
 	return stress_set_setting("switch-freq", TYPE_ID_UINT64, &switch_freq);
 }
 
+static int stress_set_switch_matrix(const char *opt)
+{
+	bool switch_matrix = true;
+
+	(void)opt;
+	return stress_set_setting("switch-matrix", TYPE_ID_BOOL, &switch_matrix);
+}
+
+/*
+ *  stress_set_switch_mask()
+ *	set a mask of the matrix methods or placements from
+ *	a name or all
+ */
+static int stress_set_switch_mask(
+	const char *opt,
+	const char *setting,
+	const stress_switch_name_t *names,
+	const size_t n)
+{
+	uint32_t mask = 0;
+	size_t i;
+
+	if (!strcmp(opt, "all")) {
+		mask = (1U << n) - 1;
+	} else {
+		for (i = 0; i < n; i++) {
+			if (!strcmp(opt, names[i].name))
+				mask = 1U << names[i].id;
+		}
+	}
+	if (mask)
+		return stress_set_setting(setting, TYPE_ID_UINT32, &mask);
+
+	(void)fprintf(stderr, "%s must be one of:", setting);
+	for (i = 0; i < n; i++)
+		(void)fprintf(stderr, " %s", names[i].name);
+	(void)fprintf(stderr, " all\n");
+	return -1;
+}
+
+static int stress_set_switch_method(const char *opt)
+{
+	return stress_set_switch_mask(opt, "switch-method",
+		switch_methods, SIZEOF_ARRAY(switch_methods));
+}
+
+static int stress_set_switch_placement(const char *opt)
+{
+	return stress_set_switch_mask(opt, "switch-placement",
+		switch_places, SIZEOF_ARRAY(switch_places));
+}
+
+static int stress_set_switch_producers(const char *opt)
+{
+	uint32_t switch_producers;
+
+	switch_producers = stress_get_uint32(opt);
+	stress_check_range("switch-producers", switch_producers, 1, SWITCH_THREADS_MAX);
+	return stress_set_setting("switch-producers", TYPE_ID_UINT32, &switch_producers);
+}
+
+static int stress_set_switch_consumers(const char *opt)
+{
+	uint32_t switch_consumers;
+
+	switch_consumers = stress_get_uint32(opt);
+	stress_check_range("switch-consumers", switch_consumers, 1, SWITCH_THREADS_MAX);
+	return stress_set_setting("switch-consumers", TYPE_ID_UINT32, &switch_consumers);
+}
+
+#if defined(__linux__) &&		\
+    defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_AFFINITY)
+#define STRESS_SWITCH_MATRIX
+
+#if defined(HAVE_SYS_EVENTFD_H) &&	\
+    defined(HAVE_EVENTFD) &&		\
+    defined(EFD_SEMAPHORE)
+#define STRESS_SWITCH_EVENTFD
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) &&	\
+    defined(__NR_io_uring_setup) &&	\
+    defined(__NR_io_uring_enter) &&	\
+    defined(IORING_OFF_SQ_RING) &&	\
+    defined(IORING_OFF_CQ_RING) &&	\
+    defined(IORING_OFF_SQES) &&		\
+    defined(IORING_ENTER_GETEVENTS) &&	\
+    defined(HAVE_IORING_OP_MSG_RING)
+#define STRESS_SWITCH_IO_URING
+#endif
+
+/*
+ *  A wake queue, tokens posted by one side are taken by
+ *  any of the threads waiting on the other side
+ */
+typedef struct {
+	int fds[2];		/* pipe, or eventfd in fds[0] */
+	int futex;		/* futex semaphore count */
+} stress_switch_queue_t;
+
+/*
+ *  minimal io-uring, threads wake each other by posting
+ *  completions to each other's rings with IORING_OP_MSG_RING
+ */
+typedef struct {
+	int fd;			/* io-uring fd */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	void *sqes;
+	void *cqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	unsigned tail;		/* local tail of queued SQEs */
+} stress_switch_uring_t;
+
+struct stress_switch_cell;
+
+typedef struct {
+	struct stress_switch_cell *cell;
+	pthread_t pthread;
+	uint32_t id;		/* producer or consumer number */
+	bool producer;
+	int ret;		/* pthread_create return */
+	uint64_t round_trips;	/* producer wake and reply pairs */
+	stress_switch_uring_t ring;
+} stress_switch_thread_t;
+
+/* One method and placement of the matrix */
+typedef struct stress_switch_cell {
+	const stress_args_t *args;
+	int method;
+	volatile bool stop;
+	uint32_t producers;
+	uint32_t consumers;
+	cpu_set_t producer_cpus;
+	cpu_set_t consumer_cpus;
+	stress_switch_queue_t request;	/* producers to consumers */
+	stress_switch_queue_t reply;	/* consumers to producers */
+	stress_switch_thread_t *threads;	/* producers then consumers */
+} stress_switch_cell_t;
+
+/*
+ *  stress_switch_queue_open()
+ *	create a wake queue for method, returns 0 or -1
+ */
+static int stress_switch_queue_open(const int method, stress_switch_queue_t *q)
+{
+	q->fds[0] = -1;
+	q->fds[1] = -1;
+	q->futex = 0;
+
+	switch (method) {
+	case SWITCH_METHOD_PIPE:
+		return pipe(q->fds);
+#if defined(STRESS_SWITCH_EVENTFD)
+	case SWITCH_METHOD_EVENTFD:
+		q->fds[0] = eventfd(0, EFD_SEMAPHORE);
+		return (q->fds[0] < 0) ? -1 : 0;
+#endif
+	default:
+		return 0;
+	}
+}
+
+static void stress_switch_queue_close(stress_switch_queue_t *q)
+{
+	if (q->fds[0] >= 0)
+		(void)close(q->fds[0]);
+	if (q->fds[1] >= 0)
+		(void)close(q->fds[1]);
+}
+
+/*
+ *  stress_switch_queue_post()
+ *	post a token, waking a waiter on the queue
+ */
+static void stress_switch_queue_post(const int method, stress_switch_queue_t *q)
+{
+	switch (method) {
+	case SWITCH_METHOD_PIPE: {
+			const char token = 'W';
+
+			while (write(q->fds[1], &token, sizeof(token)) < 0) {
+				if (errno != EINTR)
+					break;
+			}
+		}
+		break;
+	case SWITCH_METHOD_EVENTFD: {
+			const uint64_t token = 1;
+
+			while (write(q->fds[0], &token, sizeof(token)) < 0) {
+				if (errno != EINTR)
+					break;
+			}
+		}
+		break;
+	case SWITCH_METHOD_FUTEX:
+		(void)__atomic_fetch_add(&q->futex, 1, __ATOMIC_SEQ_CST);
+		(void)shim_futex_wake(&q->futex, 1);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ *  stress_switch_queue_wait()
+ *	sleep until a token is posted and take it, returns
+ *	0 or -1 on an unexpected error
+ */
+static int stress_switch_queue_wait(const int method, stress_switch_queue_t *q)
+{
+	switch (method) {
+	case SWITCH_METHOD_PIPE: {
+			char token;
+
+			while (read(q->fds[0], &token, sizeof(token)) < 0) {
+				if (errno != EINTR)
+					return -1;
+			}
+		}
+		return 0;
+	case SWITCH_METHOD_EVENTFD: {
+			uint64_t token;
+
+			while (read(q->fds[0], &token, sizeof(token)) < 0) {
+				if (errno != EINTR)
+					return -1;
+			}
+		}
+		return 0;
+	case SWITCH_METHOD_FUTEX:
+		for (;;) {
+			int val = __atomic_load_n(&q->futex, __ATOMIC_SEQ_CST);
+
+			if ((val > 0) &&
+			    __atomic_compare_exchange_n(&q->futex, &val, val - 1,
+				false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+				return 0;
+			if (val <= 0)
+				(void)shim_futex_wait(&q->futex, val, NULL);
+		}
+	default:
+		return -1;
+	}
+}
+
+#if defined(STRESS_SWITCH_IO_URING)
+/*
+ *  Avoid GCCism of void * pointer arithmetic by casting to
+ *  uint8_t *, doing the offset and then casting back to void *
+ */
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+static void stress_switch_uring_close(stress_switch_uring_t *ring)
+{
+	if (ring->sqes)
+		(void)munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_switch_uring_setup()
+ *	set up an io-uring with a completion queue big enough for
+ *	all the wakeups that can be in flight, returns 0 or -1
+ */
+static int stress_switch_uring_setup(stress_switch_uring_t *ring, const unsigned entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sq_mmap = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto err;
+		ring->cq_mmap = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sqes = ptr;
+
+	ring->sq_tail = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+	return 0;
+err:
+	stress_switch_uring_close(ring);
+	return -1;
+}
+
+/*
+ *  stress_switch_uring_msg()
+ *	queue a message to the ring target_fd, it completes there
+ *	with user_data msg, the completion on this ring is an ack
+ *	with user_data 0
+ */
+static void stress_switch_uring_msg(
+	stress_switch_uring_t *ring,
+	const int target_fd,
+	const uint64_t msg)
+{
+	const unsigned idx = ring->tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ring->sqes)[idx];
+
+	(void)memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_MSG_RING;
+	sqe->fd = target_fd;
+	sqe->off = msg;
+	sqe->user_data = 0;
+	ring->sq_array[idx] = idx;
+	ring->tail++;
+}
+
+/*
+ *  stress_switch_uring_wait()
+ *	submit any queued messages and sleep until a message
+ *	arrives, skipping acks, returns the message or 0 on error
+ */
+static uint64_t stress_switch_uring_wait(stress_switch_uring_t *ring)
+{
+	const struct io_uring_cqe *cqes = (const struct io_uring_cqe *)ring->cqes;
+
+	for (;;) {
+		unsigned head = *ring->cq_head;
+		const unsigned to_submit = ring->tail - *ring->sq_tail;
+
+		while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			const uint64_t msg = cqes[head & *ring->cq_mask].user_data;
+
+			head++;
+			if (msg) {
+				__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+				if (to_submit) {
+					*ring->sq_tail = ring->tail;
+					(void)syscall(__NR_io_uring_enter, ring->fd,
+						to_submit, 0, 0, NULL, 0);
+				}
+				return msg;
+			}
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+		__atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+		if ((syscall(__NR_io_uring_enter, ring->fd, to_submit,
+			     1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) &&
+		    (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+			return 0;
+	}
+}
+#endif
+
+/*
+ *  stress_switch_thread()
+ *	producers wake a consumer and sleep until a consumer wakes
+ *	them back, consumers sleep until woken and wake a producer
+ */
+static void *stress_switch_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_switch_thread_t *t = (stress_switch_thread_t *)arg;
+	stress_switch_cell_t *cell = t->cell;
+	stress_switch_queue_t *wake = t->producer ? &cell->request : &cell->reply;
+	stress_switch_queue_t *sleep = t->producer ? &cell->reply : &cell->request;
+	const cpu_set_t *cpus = t->producer ? &cell->producer_cpus : &cell->consumer_cpus;
+	uint64_t round_trips = 0;
+
+	if (sched_setaffinity(0, sizeof(*cpus), cpus) < 0)
+		pr_dbg("%s: cannot set wakeup thread affinity, errno=%d (%s)\n",
+			cell->args->name, errno, strerror(errno));
+
+#if defined(STRESS_SWITCH_IO_URING)
+	if (cell->method == SWITCH_METHOD_IO_URING) {
+		stress_switch_thread_t *consumers = cell->threads + cell->producers;
+		uint32_t next = t->id;
+
+		/*
+		 *  Producers send their id to each consumer in turn,
+		 *  consumers reply to the ring of the sending producer
+		 */
+		if (t->producer)
+			stress_switch_uring_msg(&t->ring,
+				consumers[next++ % cell->consumers].ring.fd, t->id + 1);
+		while (!cell->stop) {
+			const uint64_t msg = stress_switch_uring_wait(&t->ring);
+
+			if ((msg == 0) || (msg == SWITCH_URING_STOP) || cell->stop)
+				break;
+			if (t->producer) {
+				round_trips++;
+				stress_switch_uring_msg(&t->ring,
+					consumers[next++ % cell->consumers].ring.fd, t->id + 1);
+			} else {
+				stress_switch_uring_msg(&t->ring,
+					cell->threads[msg - 1].ring.fd, msg);
+			}
+		}
+		t->round_trips = round_trips;
+		return &nowt;
+	}
+#endif
+	if (t->producer)
+		stress_switch_queue_post(cell->method, wake);
+	while (!cell->stop) {
+		if (stress_switch_queue_wait(cell->method, sleep) < 0) {
+			pr_fail("%s: wakeup wait failed, errno=%d (%s)\n",
+				cell->args->name, errno, strerror(errno));
+			break;
+		}
+		if (cell->stop)
+			break;
+		if (t->producer)
+			round_trips++;
+		stress_switch_queue_post(cell->method, wake);
+	}
+	t->round_trips = round_trips;
+	return &nowt;
+}
+
+/*
+ *  stress_switch_cell()
+ *	run one method and placement for SWITCH_CELL_TIME seconds,
+ *	returns the producer round trips or 0 if it could not run
+ */
+static uint64_t stress_switch_cell(stress_switch_cell_t *cell, double *duration)
+{
+	const stress_args_t *args = cell->args;
+	const uint32_t n = cell->producers + cell->consumers;
+	stress_switch_thread_t threads[SWITCH_THREADS_MAX * 2];
+	uint64_t round_trips = 0;
+	double t_start, t_end;
+	uint32_t i;
+#if defined(STRESS_SWITCH_IO_URING)
+	stress_switch_uring_t ring;
+
+	ring.fd = -1;
+#endif
+
+	(void)memset(threads, 0, sizeof(threads));
+	cell->threads = threads;
+	cell->stop = false;
+	if (stress_switch_queue_open(cell->method, &cell->request) < 0)
+		return 0;
+	if (stress_switch_queue_open(cell->method, &cell->reply) < 0) {
+		stress_switch_queue_close(&cell->request);
+		return 0;
+	}
+#if defined(STRESS_SWITCH_IO_URING)
+	if (cell->method == SWITCH_METHOD_IO_URING) {
+		bool ok = stress_switch_uring_setup(&ring, n) == 0;
+
+		for (i = 0; ok && (i < n); i++)
+			ok = stress_switch_uring_setup(&threads[i].ring, 4 * n) == 0;
+		if (!ok) {
+			pr_dbg("%s: io-uring setup failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			goto close;
+		}
+	}
+#endif
+
+	t_start = stress_time_now();
+	for (i = 0; i < n; i++) {
+		threads[i].cell = cell;
+		threads[i].producer = i < cell->producers;
+		threads[i].id = i;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			stress_switch_thread, &threads[i]);
+	}
+	while (keep_stressing_flag() &&
+	       (stress_time_now() - t_start < SWITCH_CELL_TIME))
+		(void)shim_usleep(10000);
+	cell->stop = true;
+	t_end = stress_time_now();
+
+	/* Wake everyone so that they see the stop flag */
+#if defined(STRESS_SWITCH_IO_URING)
+	if (cell->method == SWITCH_METHOD_IO_URING) {
+		for (i = 0; i < n; i++)
+			stress_switch_uring_msg(&ring, threads[i].ring.fd, SWITCH_URING_STOP);
+		*ring.sq_tail = ring.tail;
+		(void)syscall(__NR_io_uring_enter, ring.fd, n, 0, 0, NULL, 0);
+	} else
+#endif
+	{
+		for (i = 0; i < cell->consumers; i++)
+			stress_switch_queue_post(cell->method, &cell->request);
+		for (i = 0; i < cell->producers; i++)
+			stress_switch_queue_post(cell->method, &cell->reply);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret == 0) {
+			(void)pthread_join(threads[i].pthread, NULL);
+			round_trips += threads[i].round_trips;
+		}
+	}
+	*duration = t_end - t_start;
+#if defined(STRESS_SWITCH_IO_URING)
+close:
+	if (cell->method == SWITCH_METHOD_IO_URING) {
+		for (i = 0; i < n; i++) {
+			if (threads[i].ring.sq_mmap)
+				stress_switch_uring_close(&threads[i].ring);
+		}
+		if (ring.fd >= 0)
+			stress_switch_uring_close(&ring);
+	}
+#endif
+	stress_switch_queue_close(&cell->request);
+	stress_switch_queue_close(&cell->reply);
+	(void)args;
+
+	return round_trips;
+}
+
+/*
+ *  stress_switch_partner()
+ *	find an allowed CPU with the given placement relative to
+ *	cpu, returns -1 if the topology has no such CPU
+ */
+static int32_t stress_switch_partner(
+	const int32_t cpu,
+	const int place,
+	const cpu_set_t *allowed)
+{
+	char path[PATH_MAX];
+	cpu_set_t siblings, llc;
+	int32_t i;
+
+	if (place == SWITCH_PLACE_SAME_CORE)
+		return cpu;
+
+	(void)snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+		PRId32 "/topology/thread_siblings_list", cpu);
+	if (!stress_topology_read_list(path, &siblings))
+		CPU_SET(cpu, &siblings);
+	if (!stress_topology_llc_list(cpu, &llc))
+		CPU_SET(cpu, &llc);
+
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if ((i == cpu) || !CPU_ISSET(i, allowed))
+			continue;
+		switch (place) {
+		case SWITCH_PLACE_SMT:
+			if (CPU_ISSET(i, &siblings))
+				return i;
+			break;
+		case SWITCH_PLACE_LLC:
+			if (CPU_ISSET(i, &llc) && !CPU_ISSET(i, &siblings))
+				return i;
+			break;
+		case SWITCH_PLACE_CROSS:
+			if (stress_topology_package(i) != stress_topology_package(cpu))
+				return i;
+			break;
+		default:
+			break;
+		}
+	}
+	return -1;
+}
+
+/*
+ *  stress_switch_matrix()
+ *	measure the wakeup latency and switch rate of each wake
+ *	method with the consumers on the same CPU, an SMT sibling,
+ *	another core of the same LLC or another socket from the
+ *	producers
+ */
+static int stress_switch_matrix(const stress_args_t *args)
+{
+	uint32_t method_mask = (1U << SWITCH_METHODS) - 1;
+	uint32_t place_mask = (1U << SWITCH_PLACES) - 1;
+	uint32_t producers = 1, consumers = 1;
+	uint64_t round_trips[SWITCH_METHODS][SWITCH_PLACES];
+	double durations[SWITCH_METHODS][SWITCH_PLACES];
+	int32_t partners[SWITCH_PLACES];
+	cpu_set_t allowed;
+	unsigned int cpu = 0, node = 0;
+	stress_switch_cell_t cell;
+	bool lock = false;
+	int m, p, idx = 0;
+
+	(void)stress_get_setting("switch-method", &method_mask);
+	(void)stress_get_setting("switch-placement", &place_mask);
+	(void)stress_get_setting("switch-producers", &producers);
+	(void)stress_get_setting("switch-consumers", &consumers);
+
+#if !defined(STRESS_SWITCH_EVENTFD)
+	method_mask &= ~(1U << SWITCH_METHOD_EVENTFD);
+#endif
+#if !defined(STRESS_SWITCH_IO_URING)
+	method_mask &= ~(1U << SWITCH_METHOD_IO_URING);
+#endif
+	if (!method_mask) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: wake methods not supported on this system, "
+				"skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_fail("%s: cannot get CPU affinity, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if ((shim_getcpu(&cpu, &node, NULL) < 0) || !CPU_ISSET((int)cpu, &allowed)) {
+		for (cpu = 0; !CPU_ISSET((int)cpu, &allowed); cpu++)
+			;
+	}
+	for (p = 0; p < SWITCH_PLACES; p++) {
+		partners[p] = -1;
+		if (!(place_mask & (1U << p)))
+			continue;
+		partners[p] = stress_switch_partner((int32_t)cpu, p, &allowed);
+		if (partners[p] < 0) {
+			place_mask &= ~(1U << p);
+			if (args->instance == 0)
+				pr_dbg("%s: no %s CPU for CPU %u, skipping placement\n",
+					args->name, switch_places[p].name, cpu);
+		}
+	}
+	if (!place_mask) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: no CPUs for the wakeup placements, "
+				"skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(round_trips, 0, sizeof(round_trips));
+	(void)memset(durations, 0, sizeof(durations));
+	(void)memset(&cell, 0, sizeof(cell));
+	cell.args = args;
+	cell.producers = producers;
+	cell.consumers = consumers;
+	CPU_ZERO(&cell.producer_cpus);
+	CPU_SET((int)cpu, &cell.producer_cpus);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	/* Sweep the matrix of cells until the run ends */
+	do {
+		for (m = 0; m < SWITCH_METHODS; m++) {
+			if (!(method_mask & (1U << m)))
+				continue;
+			for (p = 0; keep_stressing(args) && (p < SWITCH_PLACES); p++) {
+				uint64_t n;
+				double duration = 0.0;
+
+				if (partners[p] < 0)
+					continue;
+				cell.method = m;
+				CPU_ZERO(&cell.consumer_cpus);
+				CPU_SET(partners[p], &cell.consumer_cpus);
+				n = stress_switch_cell(&cell, &duration);
+				if (!n) {
+					pr_dbg("%s: %s %s wakeups did not run\n", args->name,
+						switch_methods[m].name, switch_places[p].name);
+					method_mask &= ~(1U << m);
+					break;
+				}
+				round_trips[m][p] += n;
+				durations[m][p] += duration;
+				add_counter(args, n);
+			}
+		}
+	} while (method_mask && keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	/* Two wakeups and switches per producer round trip */
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: wakeup matrix, %" PRIu32 " producer(s) on CPU %u, "
+		"%" PRIu32 " consumer(s) (instance %" PRIu32 ")\n", args->name,
+		producers, cpu, consumers, args->instance);
+	pr_inf_lock(&lock, "%s: %-9s %-13s %4s %12s %14s\n", args->name, "method",
+		"placement", "CPU", "ns/wakeup", "switches/sec");
+	for (m = 0; m < SWITCH_METHODS; m++) {
+		for (p = 0; p < SWITCH_PLACES; p++) {
+			const double wakeups = 2.0 * (double)round_trips[m][p];
+			double ns, rate;
+			char name[64];
+
+			if ((wakeups <= 0.0) || (durations[m][p] <= 0.0))
+				continue;
+			ns = (durations[m][p] * (double)STRESS_NANOSECOND * (double)producers) / wakeups;
+			rate = wakeups / durations[m][p];
+			pr_inf_lock(&lock, "%s: %-9s %-13s %4" PRId32 " %12.2f %14.2f\n",
+				args->name, switch_methods[m].name, switch_places[p].name,
+				partners[p], ns, rate);
+			if (idx < STRESS_MISC_STATS_MAX) {
+				(void)snprintf(name, sizeof(name), "ns/wakeup %s %s",
+					switch_methods[m].name, switch_places[p].name);
+				stress_misc_stats_set(args->misc_stats, idx++, name, ns);
+			}
+		}
+	}
+	pr_unlock(&lock);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_switch
  *	stress by heavy context switching
@@ -57,8 +845,21 @@ static int stress_switch(const stress_args_t *args)
 	int pipefds[2];
 	size_t buf_size;
 	uint64_t switch_freq = 0;
+	bool switch_matrix = false;
 
 	(void)stress_get_setting("switch-freq", &switch_freq);
+	(void)stress_get_setting("switch-matrix", &switch_matrix);
+
+	if (switch_matrix) {
+#if defined(STRESS_SWITCH_MATRIX)
+		return stress_switch_matrix(args);
+#else
+		if (args->instance == 0)
+			pr_inf_skip("%s: --switch-matrix needs pthreads and CPU "
+				"affinity, skipping stressor\n", args->name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
 
 	(void)memset(pipefds, 0, sizeof(pipefds));
 #if defined(HAVE_PIPE2) &&	\
@@ -227,6 +1028,11 @@ finish:
 
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_switch_freq,	stress_set_switch_freq },
+	{ OPT_switch_matrix,	stress_set_switch_matrix },
+	{ OPT_switch_method,	stress_set_switch_method },
+	{ OPT_switch_placement,	stress_set_switch_placement },
+	{ OPT_switch_producers,	stress_set_switch_producers },
+	{ OPT_switch_consumers,	stress_set_switch_consumers },
 	{ 0,			NULL }
 };
 
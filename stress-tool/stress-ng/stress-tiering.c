@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"tiering N",		"start N workers exercising memory tier promotion and demotion" },
+	{ NULL,	"tiering-ops N",	"stop after N passes over the hot working set" },
+	{ NULL,	"tiering-bytes N",	"size of the working set per worker" },
+	{ NULL,	"tiering-hot P",	"percentage of the working set that is hot" },
+	{ NULL,	"tiering-fast N",	"NUMA node of the fast memory tier" },
+	{ NULL,	"tiering-slow N",	"NUMA node of the slow memory tier" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define MIN_TIERING_BYTES	(4 * MB)
+#define MAX_TIERING_BYTES	(MAX_MEM_LIMIT)
+#define DEFAULT_TIERING_BYTES	(256 * MB)
+
+#define MIN_TIERING_HOT		(1)
+#define MAX_TIERING_HOT		(99)
+#define DEFAULT_TIERING_HOT	(10)
+
+#define TIERING_MAX_NODES	(1024)
+
+static int stress_set_tiering_bytes(const char *opt)
+{
+	size_t tiering_bytes;
+
+	tiering_bytes = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("tiering-bytes", tiering_bytes,
+		MIN_TIERING_BYTES, MAX_TIERING_BYTES);
+	return stress_set_setting("tiering-bytes", TYPE_ID_SIZE_T, &tiering_bytes);
+}
+
+static int stress_set_tiering_hot(const char *opt)
+{
+	uint32_t tiering_hot;
+
+	tiering_hot = stress_get_uint32(opt);
+	stress_check_range("tiering-hot", tiering_hot,
+		MIN_TIERING_HOT, MAX_TIERING_HOT);
+	return stress_set_setting("tiering-hot", TYPE_ID_UINT32, &tiering_hot);
+}
+
+static int stress_set_tiering_node(const char *opt, const char *name)
+{
+	int32_t node;
+
+	node = stress_get_int32(opt);
+	stress_check_range(name, (uint64_t)node, 0, TIERING_MAX_NODES - 1);
+	return stress_set_setting(name, TYPE_ID_INT32, &node);
+}
+
+static int stress_set_tiering_fast(const char *opt)
+{
+	return stress_set_tiering_node(opt, "tiering-fast");
+}
+
+static int stress_set_tiering_slow(const char *opt)
+{
+	return stress_set_tiering_node(opt, "tiering-slow");
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_tiering_bytes,	stress_set_tiering_bytes },
+	{ OPT_tiering_hot,	stress_set_tiering_hot },
+	{ OPT_tiering_fast,	stress_set_tiering_fast },
+	{ OPT_tiering_slow,	stress_set_tiering_slow },
+	{ 0,			NULL }
+};
+
+#if defined(__linux__) &&		\
+    defined(HAVE_AFFINITY) &&		\
+    defined(__NR_get_mempolicy) &&	\
+    defined(__NR_mbind) &&		\
+    defined(__NR_move_pages)
+
+#if !defined(MPOL_DEFAULT)
+#define MPOL_DEFAULT		(0)
+#endif
+
+#define TIERING_MAX_SAMPLES	(1024)	/* one per second */
+#define TIERING_REPORT_ROWS	(20)
+#define TIERING_CONVERGED	(90.0)	/* % of hot pages on the fast node */
+#define TIERING_ACCESSES	(65536)	/* hot accesses per bogo op */
+#define NUMA_BALANCING_TIERING	(2)
+
+#define NUMA_BALANCING_PATH	"/proc/sys/kernel/numa_balancing"
+#define DEMOTION_ENABLED_PATH	"/sys/kernel/mm/numa/demotion_enabled"
+
+typedef struct {
+	double time;		/* seconds since the start */
+	double promote_rate;	/* system wide promotions per second */
+	double demote_rate;	/* system wide demotions per second */
+	double hint_rate;	/* system wide NUMA hint faults per second */
+	double hot_fast;	/* % of sampled hot pages on the fast node */
+	double cold_slow;	/* % of sampled cold pages on the slow node */
+	double hot_ns;		/* ns per dependent hot access */
+} stress_tiering_sample_t;
+
+typedef struct {
+	char numa_balancing[32];	/* original sysctl values */
+	char demotion_enabled[32];
+	bool numa_balancing_set;
+	bool demotion_enabled_set;
+} stress_tiering_sysctl_t;
+
+/*
+ *  stress_tiering_nodes()
+ *	pick the fast node, the node of the current CPU if it has memory,
+ *	and the slow node, the first memory node with no CPUs (a CXL or
+ *	PMEM expander), unless they are given with options
+ */
+static bool stress_tiering_nodes(const stress_args_t *args, int32_t *fast, int32_t *slow)
+{
+	cpu_set_t mem_nodes, cpu_nodes;
+	unsigned int cpu = 0, node = 0;
+	int32_t i;
+
+	if (!stress_topology_read_list("/sys/devices/system/node/has_memory", &mem_nodes)) {
+		if (args->instance == 0)
+			pr_inf("%s: cannot read the NUMA memory nodes, skipping stressor\n",
+				args->name);
+		return false;
+	}
+	(void)stress_topology_read_list("/sys/devices/system/node/has_cpu", &cpu_nodes);
+
+	if (!stress_get_setting("tiering-fast", fast)) {
+		if ((shim_getcpu(&cpu, &node, NULL) < 0) || !CPU_ISSET((int)node, &mem_nodes))
+			node = 0;
+		*fast = (int32_t)node;
+		for (i = 0; (i < CPU_SETSIZE) && !CPU_ISSET(*fast, &mem_nodes); i++) {
+			if (CPU_ISSET(i, &mem_nodes) && CPU_ISSET(i, &cpu_nodes))
+				*fast = i;
+		}
+	}
+	if (!stress_get_setting("tiering-slow", slow)) {
+		*slow = -1;
+		for (i = 0; i < CPU_SETSIZE; i++) {
+			if (CPU_ISSET(i, &mem_nodes) && !CPU_ISSET(i, &cpu_nodes) && (i != *fast)) {
+				*slow = i;
+				break;
+			}
+		}
+	}
+	if ((*slow < 0) || !CPU_ISSET(*slow, &mem_nodes) || !CPU_ISSET(*fast, &mem_nodes)) {
+		if (args->instance == 0)
+			pr_inf("%s: no slow tier memory node found (a memory node "
+				"without CPUs), use --tiering-slow, skipping stressor\n",
+				args->name);
+		return false;
+	}
+	if (*slow == *fast) {
+		if (args->instance == 0)
+			pr_inf("%s: the fast and slow tier nodes are both node %" PRId32
+				", skipping stressor\n", args->name, *fast);
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  stress_tiering_sysctl_set()
+ *	save a sysctl and write a new value, returns true if written
+ */
+static bool stress_tiering_sysctl_set(const char *path, char *orig, const size_t len, const char *val)
+{
+	char *ptr;
+
+	if (system_read(path, orig, len) <= 0)
+		return false;
+	ptr = strchr(orig, '\n');
+	if (ptr)
+		*ptr = '\0';
+	if (!strcmp(orig, val))
+		return false;
+	return system_write(path, val, strlen(val)) > 0;
+}
+
+/*
+ *  stress_tiering_enable()
+ *	turn on the NUMA balancing memory tiering mode and demotion,
+ *	keeping the original settings to restore
+ */
+static void stress_tiering_enable(const stress_args_t *args, stress_tiering_sysctl_t *sysctl)
+{
+	char val[32];
+	int mode;
+
+	(void)memset(sysctl, 0, sizeof(*sysctl));
+	if ((system_read(NUMA_BALANCING_PATH, val, sizeof(val)) <= 0) ||
+	    (sscanf(val, "%d", &mode) != 1)) {
+		pr_inf("%s: cannot read %s, NUMA balancing is not available\n",
+			args->name, NUMA_BALANCING_PATH);
+		return;
+	}
+	if (!(mode & NUMA_BALANCING_TIERING)) {
+		(void)snprintf(val, sizeof(val), "%d", mode | NUMA_BALANCING_TIERING);
+		sysctl->numa_balancing_set = stress_tiering_sysctl_set(NUMA_BALANCING_PATH,
+			sysctl->numa_balancing, sizeof(sysctl->numa_balancing), val);
+		if (!sysctl->numa_balancing_set)
+			pr_inf("%s: cannot enable the NUMA balancing memory tiering "
+				"mode (needs root), promotion will not happen\n", args->name);
+	}
+	if (system_read(DEMOTION_ENABLED_PATH, val, sizeof(val)) <= 0) {
+		pr_inf("%s: cannot read %s, demotion is not available\n",
+			args->name, DEMOTION_ENABLED_PATH);
+		return;
+	}
+	if (strncmp(val, "true", 4)) {
+		sysctl->demotion_enabled_set = stress_tiering_sysctl_set(DEMOTION_ENABLED_PATH,
+			sysctl->demotion_enabled, sizeof(sysctl->demotion_enabled), "1");
+		if (!sysctl->demotion_enabled_set)
+			pr_inf("%s: cannot enable %s (needs root), demotion will not happen\n",
+				args->name, DEMOTION_ENABLED_PATH);
+	}
+}
+
+/*
+ *  stress_tiering_restore()
+ *	restore the original NUMA balancing and demotion settings
+ */
+static void stress_tiering_restore(const stress_tiering_sysctl_t *sysctl)
+{
+	if (sysctl->numa_balancing_set)
+		(void)system_write(NUMA_BALANCING_PATH, sysctl->numa_balancing,
+			strlen(sysctl->numa_balancing));
+	if (sysctl->demotion_enabled_set)
+		(void)system_write(DEMOTION_ENABLED_PATH,
+			strcmp(sysctl->demotion_enabled, "true") ? "0" : "1", 1);
+}
+
+/*
+ *  stress_tiering_share()
+ *	percentage of the sampled pages of a range that are on node
+ */
+static double stress_tiering_share(
+	const stress_args_t *args,
+	const uint8_t *addr,
+	const size_t len,
+	const int32_t node)
+{
+	static uint64_t pages[TIERING_MAX_NODES];
+	uint64_t total = 0;
+	int i, nodes;
+
+	(void)memset(pages, 0, sizeof(pages));
+	nodes = stress_numa_pages(args, addr, len, pages, TIERING_MAX_NODES);
+	for (i = 0; i < nodes; i++)
+		total += pages[i];
+	return total ? 100.0 * (double)pages[node] / (double)total : 0.0;
+}
+
+/*
+ *  stress_tiering_access()
+ *	a chain of dependent reads of random hot pages, each next page
+ *	depends on the value loaded so the time per access is the load
+ *	latency of wherever the hot page lives, returns the ns per access
+ */
+static double OPTIMIZE3 stress_tiering_access(
+	uint8_t *hot,
+	const size_t hot_pages,
+	const size_t page_size)
+{
+	register uint64_t idx = stress_mwc64();
+	register size_t i;
+	double t;
+
+	t = stress_time_now();
+	for (i = 0; i < TIERING_ACCESSES; i++) {
+		volatile uint64_t *ptr = (volatile uint64_t *)(hot +
+			((idx % hot_pages) * page_size) + ((idx >> 32) & (page_size - 64)));
+		const uint64_t val = *ptr;
+
+		*ptr = val + 1;
+		idx = (idx * 6364136223846793005ULL) + 1442695040888963407ULL + (val & 1);
+	}
+	t = stress_time_now() - t;
+
+	return (t * STRESS_NANOSECOND) / (double)TIERING_ACCESSES;
+}
+
+/*
+ *  stress_tiering_report()
+ *	print the convergence of hot set placement and latency over time
+ */
+static void stress_tiering_report(
+	const stress_args_t *args,
+	const stress_tiering_sample_t *samples,
+	const size_t n)
+{
+	const size_t step = (n > TIERING_REPORT_ROWS) ? (n + TIERING_REPORT_ROWS - 1) / TIERING_REPORT_ROWS : 1;
+	bool lock = false;
+	size_t i;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %7s %10s %10s %10s %8s %8s %9s\n", args->name,
+		"secs", "promote/s", "demote/s", "hints/s", "hot@fast", "cold@slow", "hot ns");
+	for (i = 0; i < n; i++) {
+		const stress_tiering_sample_t *s = &samples[i];
+
+		if ((i % step) && (i != n - 1))
+			continue;
+		pr_inf_lock(&lock, "%s: %7.1f %10.0f %10.0f %10.0f %7.1f%% %8.1f%% %9.1f\n",
+			args->name, s->time, s->promote_rate, s->demote_rate,
+			s->hint_rate, s->hot_fast, s->cold_slow, s->hot_ns);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_tiering()
+ *	start a hot working set on the slow memory node and a cold set on
+ *	the fast node, then leave placement to the kernel and measure how
+ *	quickly the hot set is promoted and the cold set demoted
+ */
+static int stress_tiering(const stress_args_t *args)
+{
+	static stress_tiering_sample_t samples[TIERING_MAX_SAMPLES];
+	stress_tiering_sysctl_t sysctl;
+	const size_t page_size = args->page_size;
+	size_t tiering_bytes = DEFAULT_TIERING_BYTES, hot_len, cold_len, n = 0, i;
+	uint32_t tiering_hot = DEFAULT_TIERING_HOT;
+	uint64_t promote, demote, hints, promote_start, demote_start;
+	double t_start, t_last, hot_ns = 0.0, hot_ns_start = 0.0, converged = 0.0;
+	double hot_ns_sum = 0.0;
+	uint64_t hot_ns_count = 0;
+	int32_t fast = 0, slow = -1;
+	uint8_t *buf, *hot, *cold;
+	int rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("tiering-bytes", &tiering_bytes);
+	(void)stress_get_setting("tiering-hot", &tiering_hot);
+	if (!stress_tiering_nodes(args, &fast, &slow))
+		return EXIT_NOT_IMPLEMENTED;
+
+	tiering_bytes /= args->num_instances ? args->num_instances : 1;
+	tiering_bytes &= ~(page_size - 1);
+	if (tiering_bytes < MIN_TIERING_BYTES)
+		tiering_bytes = MIN_TIERING_BYTES;
+	hot_len = ((tiering_bytes / 100) * tiering_hot) & ~(page_size - 1);
+	if (hot_len < page_size)
+		hot_len = page_size;
+	cold_len = tiering_bytes - hot_len;
+
+	buf = (uint8_t *)mmap(NULL, tiering_bytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot mmap %zu bytes, skipping stressor\n",
+			args->name, tiering_bytes);
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(MADV_NOHUGEPAGE)
+	/* base pages so each page can be placed on its own */
+	(void)shim_madvise(buf, tiering_bytes, MADV_NOHUGEPAGE);
+#endif
+	hot = buf;
+	cold = buf + hot_len;
+
+	/* hot set starts on the slow node, cold set on the fast node */
+	if ((stress_numa_bind_node(hot, hot_len, slow) < 0) ||
+	    (stress_numa_bind_node(cold, cold_len, fast) < 0)) {
+		pr_inf("%s: cannot bind memory to nodes %" PRId32 " and %" PRId32
+			", errno=%d (%s), skipping stressor\n", args->name,
+			slow, fast, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_buf;
+	}
+	(void)memset(buf, 0, tiering_bytes);
+	(void)memset(&sysctl, 0, sizeof(sysctl));
+	/* a default policy leaves the pages in place but lets them migrate */
+	(void)shim_mbind(buf, (unsigned long)tiering_bytes, MPOL_DEFAULT, NULL, 0, 0);
+
+	if (args->instance == 0) {
+		stress_tiering_enable(args, &sysctl);
+		pr_inf("%s: fast node %" PRId32 ", slow node %" PRId32 ", %zu MB hot "
+			"and %zu MB cold per worker\n", args->name, fast, slow,
+			hot_len / (size_t)MB, cold_len / (size_t)MB);
+	}
+
+	stress_get_vmstat_tiering(&promote_start, &demote_start, &hints);
+	promote = promote_start;
+	demote = demote_start;
+	t_start = stress_time_now();
+	t_last = t_start;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		double now;
+
+		hot_ns = stress_tiering_access(hot, hot_len / page_size, page_size);
+		hot_ns_sum += hot_ns;
+		hot_ns_count++;
+		inc_counter(args);
+
+		now = stress_time_now();
+		if ((now - t_last >= 1.0) && (n < TIERING_MAX_SAMPLES)) {
+			stress_tiering_sample_t *s = &samples[n++];
+			const double dt = now - t_last;
+			uint64_t p, d, h;
+
+			stress_get_vmstat_tiering(&p, &d, &h);
+			s->time = now - t_start;
+			s->promote_rate = (double)(p - promote) / dt;
+			s->demote_rate = (double)(d - demote) / dt;
+			s->hint_rate = (double)(h - hints) / dt;
+			s->hot_fast = stress_tiering_share(args, hot, hot_len, fast);
+			s->cold_slow = stress_tiering_share(args, cold, cold_len, slow);
+			s->hot_ns = hot_ns_sum / (double)hot_ns_count;
+			if (n == 1)
+				hot_ns_start = s->hot_ns;
+			if ((converged <= 0.0) && (s->hot_fast >= TIERING_CONVERGED))
+				converged = s->time;
+			promote = p;
+			demote = d;
+			hints = h;
+			hot_ns_sum = 0.0;
+			hot_ns_count = 0;
+			t_last = now;
+		}
+	} while (keep_stressing(args));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (args->instance == 0) {
+		stress_tiering_restore(&sysctl);
+		if (n)
+			stress_tiering_report(args, samples, n);
+		if (converged > 0.0)
+			pr_inf("%s: %.0f%% of the hot set reached the fast node after %.1f seconds\n",
+				args->name, TIERING_CONVERGED, converged);
+		else
+			pr_inf("%s: the hot set did not reach %.0f%% on the fast node\n",
+				args->name, TIERING_CONVERGED);
+	}
+
+	t_last = stress_time_now() - t_start;
+	stress_get_vmstat_tiering(&promote, &demote, &hints);
+	i = n ? n - 1 : 0;
+	stress_misc_stats_set(args->misc_stats, 0, "system pages promoted/sec",
+		(t_last > 0.0) ? (double)(promote - promote_start) / t_last : 0.0);
+	stress_misc_stats_set(args->misc_stats, 1, "system pages demoted/sec",
+		(t_last > 0.0) ? (double)(demote - demote_start) / t_last : 0.0);
+	stress_misc_stats_set(args->misc_stats, 2, "hot pages on fast node %",
+		n ? samples[i].hot_fast : 0.0);
+	stress_misc_stats_set(args->misc_stats, 3, "cold pages on slow node %",
+		n ? samples[i].cold_slow : 0.0);
+	stress_misc_stats_set(args->misc_stats, 4, "first second hot access ns",
+		n ? hot_ns_start : hot_ns);
+	stress_misc_stats_set(args->misc_stats, 5, "last second hot access ns",
+		n ? samples[i].hot_ns : hot_ns);
+	stress_misc_stats_set(args->misc_stats, 6, "secs to 90% hot on fast node",
+		converged);
+
+tidy_buf:
+	(void)munmap((void *)buf, tiering_bytes);
+
+	return rc;
+}
+
+stressor_info_t stress_tiering_info = {
+	.stressor = stress_tiering,
+	.class = CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_tiering_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
@@ -27,6 +27,7 @@
 static const stress_help_t help[] = {
 	{ NULL,	"tlb-shootdown N",	"start N workers that force TLB shootdowns" },
 	{ NULL,	"tlb-shootdown-ops N",	"stop after N TLB shootdown bogo ops" },
+	{ NULL,	"tlb-shootdown-threads N", "scale 1 to N threads sharing an mm, report unmap latency" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -37,6 +38,301 @@ static const stress_help_t help[] = {
 #define MIN_TLB_PROCS	(2)
 #define MMAP_PAGES	(512)
 
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_AFFINITY)
+
+#define MAX_TLB_THREADS		(64)
+#define MAX_TLB_SCALE_STEPS	(8)	/* 1, 2, 4 .. 64 threads */
+#define TLB_SCALE_ROUNDS	(4)	/* mappings unmapped per scaling step */
+
+/* Unmap latency and IPIs at one thread count */
+typedef struct {
+	uint32_t threads;		/* threads sharing the mm */
+	uint64_t unmaps;		/* pages unmapped */
+	uint64_t ipis;			/* TLB shootdown IPIs */
+	double total_ns;		/* sum of unmap latencies */
+	double max_ns;			/* worst unmap latency */
+} stress_tlb_scale_t;
+
+/* State shared between the unmapping thread and the touching threads */
+typedef struct {
+	uint8_t *volatile mem;		/* mapping of the current round */
+	volatile uint32_t generation;	/* bumped at the start of each round */
+	volatile uint32_t touched;	/* threads that touched all of mem this round */
+	volatile bool stop;		/* true to stop the touching threads */
+	size_t mmap_size;
+	size_t page_size;
+} stress_tlb_shared_t;
+
+typedef struct {
+	pthread_t pthread;
+	int ret;			/* pthread_create return */
+	int32_t cpu;			/* CPU the thread is bound to */
+	stress_tlb_shared_t *shared;
+} stress_tlb_thread_t;
+
+static int stress_set_tlb_shootdown_threads(const char *opt)
+{
+	uint32_t tlb_shootdown_threads;
+
+	tlb_shootdown_threads = stress_get_uint32(opt);
+	stress_check_range("tlb-shootdown-threads", tlb_shootdown_threads,
+		1, MAX_TLB_THREADS);
+	return stress_set_setting("tlb-shootdown-threads", TYPE_ID_UINT32, &tlb_shootdown_threads);
+}
+
+/*
+ *  stress_tlb_ipis()
+ *	total TLB shootdown IPIs over all CPUs from the TLB
+ *	line of /proc/interrupts, 0 if there is no such line
+ */
+static uint64_t stress_tlb_ipis(void)
+{
+	FILE *fp;
+	char buffer[4096];
+	uint64_t total = 0;
+
+	fp = fopen("/proc/interrupts", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char *ptr = buffer;
+
+		while (*ptr == ' ')
+			ptr++;
+		if (strncmp(ptr, "TLB:", 4))
+			continue;
+		for (ptr += 4; *ptr; ) {
+			char *end;
+			const unsigned long long val = strtoull(ptr, &end, 10);
+
+			if (end == ptr)
+				break;
+			total += (uint64_t)val;
+			ptr = end;
+		}
+		break;
+	}
+	(void)fclose(fp);
+	return total;
+}
+
+static void stress_tlb_bind(const int32_t cpu)
+{
+	cpu_set_t mask;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_tlb_toucher()
+ *	load the TLB of this CPU with the pages of each new mapping and
+ *	then stay running in the mm so the unmaps have to shoot it down
+ */
+static void *stress_tlb_toucher(void *ptr)
+{
+	const stress_tlb_thread_t *thread = (stress_tlb_thread_t *)ptr;
+	stress_tlb_shared_t *shared = thread->shared;
+	uint32_t generation = 0;
+	static void *nowt = NULL;
+
+	stress_tlb_bind(thread->cpu);
+
+	while (!shared->stop) {
+		const uint8_t *mem;
+		size_t i;
+		uint8_t sum = 0;
+
+		if (shared->generation == generation) {
+			(void)shim_sched_yield();
+			continue;
+		}
+		generation = shared->generation;
+		mem = shared->mem;
+		for (i = 0; i < shared->mmap_size; i += shared->page_size)
+			sum += *(const volatile uint8_t *)(mem + i);
+		stress_uint8_put(sum);
+		__sync_fetch_and_add(&shared->touched, 1);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_tlb_shootdown_round()
+ *	map, have the other threads touch, then unmap page by page
+ *	timing each unmap, returns false if the run should end
+ */
+static bool stress_tlb_shootdown_round(
+	stress_tlb_shared_t *shared,
+	const uint32_t touchers,
+	stress_tlb_scale_t *scale)
+{
+	uint8_t *mem, *ptr;
+	uint64_t ipis;
+
+	mem = mmap(NULL, shared->mmap_size, PROT_WRITE | PROT_READ,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if ((void *)mem == MAP_FAILED)
+		return keep_stressing_flag();
+	(void)memset(mem, 0, shared->mmap_size);
+
+	shared->mem = mem;
+	shared->touched = 0;
+	__sync_synchronize();
+	shared->generation++;
+
+	while (shared->touched < touchers) {
+		if (!keep_stressing_flag()) {
+			/* Touchers may still be reading, leave it mapped */
+			return false;
+		}
+		(void)shim_sched_yield();
+	}
+
+	ipis = stress_tlb_ipis();
+	for (ptr = mem; ptr < mem + shared->mmap_size; ptr += shared->page_size) {
+		const double t = stress_time_now_ns();
+		double delta;
+
+		(void)munmap(ptr, shared->page_size);
+		delta = stress_time_now_ns() - t;
+		scale->total_ns += delta;
+		if (delta > scale->max_ns)
+			scale->max_ns = delta;
+		scale->unmaps++;
+	}
+	scale->ipis += stress_tlb_ipis() - ipis;
+	shared->mem = NULL;
+	return keep_stressing_flag();
+}
+
+/*
+ *  stress_tlb_shootdown_report()
+ *	output the unmap latency and IPIs against thread count
+ */
+static void stress_tlb_shootdown_report(
+	const stress_args_t *args,
+	const stress_tlb_scale_t *scales,
+	const int steps)
+{
+	bool lock = false;
+	int i;
+
+	for (i = 0; i < steps; i++) {
+		char desc[40];
+
+		if (!scales[i].unmaps)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "unmap nsec (%" PRIu32 " threads)",
+			scales[i].threads);
+		stress_misc_stats_set(args->misc_stats, i, desc,
+			scales[i].total_ns / (double)scales[i].unmaps);
+	}
+	if (args->instance != 0)
+		return;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: threads    unmaps  mean usec   max usec  IPIs/unmap\n",
+		args->name);
+	for (i = 0; i < steps; i++) {
+		const stress_tlb_scale_t *s = &scales[i];
+
+		if (!s->unmaps)
+			continue;
+		pr_inf_lock(&lock, "%s: %7" PRIu32 " %9" PRIu64 " %10.3f %10.3f %11.3f\n",
+			args->name, s->threads, s->unmaps,
+			s->total_ns / ((double)s->unmaps * 1000.0),
+			s->max_ns / 1000.0,
+			(double)s->ipis / (double)s->unmaps);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_tlb_shootdown_scale()
+ *	step through 1, 2, 4 .. N threads sharing one mm, the extra
+ *	threads keep the pages in their TLBs while the stressor
+ *	unmaps them, so each unmap has to shoot down every CPU
+ */
+static int stress_tlb_shootdown_scale(
+	const stress_args_t *args,
+	const cpu_set_t *proc_mask,
+	const uint32_t max_threads)
+{
+	stress_tlb_scale_t scales[MAX_TLB_SCALE_STEPS];
+	stress_tlb_thread_t threads[MAX_TLB_THREADS];
+	stress_tlb_shared_t shared;
+	int32_t cpus[MAX_TLB_THREADS];
+	int32_t ncpus;
+	uint32_t t;
+	int steps = 0, step = 0;
+	bool run = true;
+
+	ncpus = stress_cpus_interleave_packages(proc_mask, cpus, MAX_TLB_THREADS);
+	if ((args->instance == 0) && ((uint32_t)ncpus < max_threads))
+		pr_inf("%s: only %" PRId32 " CPUs available, threads beyond "
+			"that will share CPUs\n", args->name, ncpus);
+
+	(void)memset(scales, 0, sizeof(scales));
+	for (t = 1; t < max_threads; t <<= 1)
+		scales[steps++].threads = t;
+	scales[steps++].threads = max_threads;
+
+	(void)memset(&shared, 0, sizeof(shared));
+	shared.page_size = args->page_size;
+	shared.mmap_size = args->page_size * MMAP_PAGES;
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		stress_tlb_scale_t *scale = &scales[step];
+		const uint32_t touchers = scale->threads - 1;
+		uint32_t started = 0;
+		int round;
+
+		shared.stop = false;
+		shared.generation = 0;
+		stress_tlb_bind(ncpus ? cpus[0] : -1);
+		for (t = 0; t < touchers; t++) {
+			threads[t].shared = &shared;
+			threads[t].cpu = ncpus ? cpus[(t + 1) % (uint32_t)ncpus] : -1;
+			threads[t].ret = pthread_create(&threads[t].pthread, NULL,
+				stress_tlb_toucher, (void *)&threads[t]);
+			if (threads[t].ret == 0)
+				started++;
+		}
+
+		for (round = 0; run && (round < TLB_SCALE_ROUNDS); round++)
+			run = stress_tlb_shootdown_round(&shared, started, scale);
+
+		shared.stop = true;
+		for (t = 0; t < touchers; t++) {
+			if (threads[t].ret == 0)
+				(void)pthread_join(threads[t].pthread, NULL);
+		}
+		/* A round cut short was left mapped for the touchers */
+		if (shared.mem) {
+			(void)munmap(shared.mem, shared.mmap_size);
+			shared.mem = NULL;
+		}
+
+		step = (step + 1) % steps;
+		inc_counter(args);
+	} while (run && keep_stressing(args));
+
+	(void)sched_setaffinity(0, sizeof(*proc_mask), proc_mask);
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	stress_tlb_shootdown_report(args, scales, steps);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_tlb_shootdown()
  *	stress out TLB shootdowns
@@ -47,6 +343,7 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 	const size_t mmap_size = page_size * MMAP_PAGES;
 	pid_t pids[MAX_TLB_PROCS];
 	cpu_set_t proc_mask_initial;
+	uint32_t tlb_shootdown_threads = 0;
 
 	if (sched_getaffinity(0, sizeof(proc_mask_initial), &proc_mask_initial) < 0) {
 		pr_fail("%s: sched_getaffinity could not get CPU affinity, errno=%d (%s)\n",
@@ -54,6 +351,19 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 		return EXIT_FAILURE;
 	}
 
+	(void)stress_get_setting("tlb-shootdown-threads", &tlb_shootdown_threads);
+	if (tlb_shootdown_threads > 0) {
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_AFFINITY)
+		return stress_tlb_shootdown_scale(args, &proc_mask_initial,
+			tlb_shootdown_threads);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: pthreads not supported, ignoring the "
+				"--tlb-shootdown-threads option\n", args->name);
+#endif
+	}
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	do {
@@ -170,9 +480,18 @@ static int stress_tlb_shootdown(const stress_args_t *args)
 	return EXIT_SUCCESS;
 }
 
+static const stress_opt_set_func_t opt_set_funcs[] = {
+#if defined(HAVE_LIB_PTHREAD) &&	\
+    defined(HAVE_AFFINITY)
+	{ OPT_tlb_shootdown_threads,	stress_set_tlb_shootdown_threads },
+#endif
+	{ 0,				NULL }
+};
+
 stressor_info_t stress_tlb_shootdown_info = {
 	.stressor = stress_tlb_shootdown,
 	.class = CLASS_OS | CLASS_MEMORY,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
@@ -24,11 +24,61 @@
  */
 #include "stress-ng.h"
 
+#define TREE_ALLOC_POOL		(0)	/* nodes from one contiguous pool */
+#define TREE_ALLOC_MALLOC	(1)	/* nodes individually allocated */
+
+#define BTREE_T			(4)	/* b-tree minimum degree */
+#define BTREE_KEYS		((2 * BTREE_T) - 1)
+#define VEB_NONE		(~(uint32_t)0)
+
 struct tree_node;
 
+/* Per method lookup rate and last level cache miss accounting */
+typedef struct {
+	double lookup_duration;		/* time spent on lookups */
+	uint64_t lookups;		/* number of lookups */
+	uint64_t llc_misses;		/* LLC read misses during lookups */
+	double t_start;			/* start of current lookup pass */
+	uint64_t llc_start;		/* LLC misses at start of pass */
+} stress_tree_metrics_t;
+
+/*
+ *  b-tree node, the keys and key count fill the first cache
+ *  line so a node is searched touching one cache line before
+ *  the child pointer in the second cache line is followed
+ */
+typedef struct btree_node {
+	uint64_t keys[BTREE_KEYS];
+	uint8_t n;
+	bool leaf;
+	struct btree_node *child[BTREE_KEYS + 1] ALIGN64;
+} ALIGN64 btree_node_t;
+
+/* static search tree node, stored in van Emde Boas order */
+typedef struct {
+	uint64_t key;
+	uint32_t left;
+	uint32_t right;
+} veb_node_t;
+
+/* Per stressor state for the tree methods that need more memory */
+typedef struct {
+	int llc_fd;			/* LLC miss counter fd */
+	btree_node_t *btree_pool;	/* arena of b-tree nodes */
+	size_t btree_pool_size;		/* number of b-tree nodes in arena */
+	size_t btree_pool_used;		/* b-tree nodes allocated */
+	uint64_t *veb_keys;		/* sorted keys for the veb tree */
+	veb_node_t *veb_nodes;		/* veb tree in veb order */
+	uint32_t *veb_map;		/* breadth first to veb order map */
+	size_t veb_size;		/* nodes in the perfect veb tree */
+	uint32_t veb_height;		/* height of the veb tree */
+} stress_tree_context_t;
+
 typedef void (*stress_tree_func)(const stress_args_t *args,
 				 const size_t n,
-				 struct tree_node *data);
+				 struct tree_node **nodes,
+				 stress_tree_context_t *ctx,
+				 stress_tree_metrics_t *metrics);
 
 typedef struct {
 	const char              *name;  /* human readable form of stressor */
@@ -40,14 +90,12 @@ static const stress_tree_method_info_t tree_methods[];
 static const stress_help_t help[] = {
 	{ NULL,	"tree N",	 "start N workers that exercise tree structures" },
 	{ NULL,	"tree-ops N",	 "stop after N bogo tree operations" },
-	{ NULL,	"tree-method M", "select tree method, all,avl,binary,rb,splay" },
+	{ NULL,	"tree-method M", "select tree method, all,avl,binary,btree,rb,splay,veb" },
 	{ NULL,	"tree-size N",	 "N is the number of items in the tree" },
+	{ NULL,	"tree-alloc A",	 "allocate nodes from a pool or with malloc" },
 	{ NULL,	NULL,		 NULL }
 };
 
-#if defined(HAVE_LIB_BSD) &&	\
-    !defined(__APPLE__)
-
 static volatile bool do_jmp = true;
 static sigjmp_buf jmp_env;
 
@@ -69,16 +117,17 @@ struct avl_node {
 struct tree_node {
 	uint64_t value;
 	union {
+#if defined(HAVE_LIB_BSD) &&	\
+    !defined(__APPLE__)
 		RB_ENTRY(tree_node)	rb;
 		SPLAY_ENTRY(tree_node)	splay;
+#endif
 		struct binary_node	binary;
 		struct avl_node		avl;
 		uint64_t		padding[3]; /* cppcheck-suppress unusedStructMember */
 	} u;
 };
 
-#endif
-
 /*
  *  stress_set_tree_size()
  *	set tree size
@@ -93,8 +142,24 @@ static int stress_set_tree_size(const char *opt)
 	return stress_set_setting("tree-size", TYPE_ID_UINT64, &tree_size);
 }
 
-#if defined(HAVE_LIB_BSD) &&	\
-    !defined(__APPLE__)
+/*
+ *  stress_set_tree_alloc()
+ *	set how the tree nodes are allocated
+ */
+static int stress_set_tree_alloc(const char *opt)
+{
+	int tree_alloc;
+
+	if (!strcmp(opt, "pool")) {
+		tree_alloc = TREE_ALLOC_POOL;
+	} else if (!strcmp(opt, "malloc")) {
+		tree_alloc = TREE_ALLOC_MALLOC;
+	} else {
+		(void)fprintf(stderr, "tree-alloc must be pool or malloc\n");
+		return -1;
+	}
+	return stress_set_setting("tree-alloc", TYPE_ID_INT, &tree_alloc);
+}
 
 /*
  *  stress_tree_handler()
@@ -110,6 +175,34 @@ static void MLOCKED_TEXT stress_tree_handler(int signum)
 	}
 }
 
+/*
+ *  stress_tree_lookups_begin()
+ *	start timing a pass of lookups
+ */
+static inline void stress_tree_lookups_begin(
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
+{
+	metrics->llc_start = stress_perf_llc_read(ctx->llc_fd);
+	metrics->t_start = stress_time_now();
+}
+
+/*
+ *  stress_tree_lookups_end()
+ *	account for a pass of n lookups
+ */
+static inline void stress_tree_lookups_end(
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics,
+	const size_t n)
+{
+	metrics->lookup_duration += stress_time_now() - metrics->t_start;
+	metrics->llc_misses += stress_perf_llc_read(ctx->llc_fd) - metrics->llc_start;
+	metrics->lookups += n;
+}
+
+#if defined(HAVE_LIB_BSD) &&	\
+    !defined(__APPLE__)
 static int tree_node_cmp_fwd(struct tree_node *n1, struct tree_node *n2)
 {
 	if (n1->value == n2->value)
@@ -131,28 +224,33 @@ SPLAY_GENERATE(stress_splay_tree, tree_node, u.splay, tree_node_cmp_fwd);
 static void stress_tree_rb(
 	const stress_args_t *args,
 	const size_t n,
-	struct tree_node *data)
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
 {
 	size_t i;
 	register struct tree_node *node, *next;
 
 	RB_INIT(&rb_root);
 
-	for (node = data, i = 0; i < n; i++, node++) {
+	for (i = 0; i < n; i++) {
 		register struct tree_node *res;
 
+		node = nodes[i];
 		res = RB_FIND(stress_rb_tree, &rb_root, node);
 		if (!res)
 			RB_INSERT(stress_rb_tree, &rb_root, node);
 	}
-	for (node = data, i = 0; i < n; i++, node++) {
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
 		struct tree_node *find;
 
-		find = RB_FIND(stress_rb_tree, &rb_root, node);
+		find = RB_FIND(stress_rb_tree, &rb_root, nodes[i]);
 		if (!find)
 			pr_err("%s: rb tree node #%zd not found\n",
 				args->name, i);
 	}
+	stress_tree_lookups_end(ctx, metrics, n);
 	for (node = RB_MIN(stress_rb_tree, &rb_root); node; node = next) {
 		next = RB_NEXT(stress_rb_tree, &rb_root, node);
 		RB_REMOVE(stress_rb_tree, &rb_root, node);
@@ -162,34 +260,40 @@ static void stress_tree_rb(
 static void stress_tree_splay(
 	const stress_args_t *args,
 	const size_t n,
-	struct tree_node *nodes)
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
 {
 	size_t i;
 	register struct tree_node *node, *next;
 
 	SPLAY_INIT(&splay_root);
 
-	for (node = nodes, i = 0; i < n; i++, node++) {
+	for (i = 0; i < n; i++) {
 		register struct tree_node *res;
 
+		node = nodes[i];
 		res = SPLAY_FIND(stress_splay_tree, &splay_root, node);
 		if (!res)
 			SPLAY_INSERT(stress_splay_tree, &splay_root, node);
 	}
-	for (node = nodes, i = 0; i < n; i++, node++) {
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
 		struct tree_node *find;
 
-		find = SPLAY_FIND(stress_splay_tree, &splay_root, node);
+		find = SPLAY_FIND(stress_splay_tree, &splay_root, nodes[i]);
 		if (!find)
 			pr_err("%s: splay tree node #%zd not found\n",
 				args->name, i);
 	}
+	stress_tree_lookups_end(ctx, metrics, n);
 	for (node = SPLAY_MIN(stress_splay_tree, &splay_root); node; node = next) {
 		next = SPLAY_NEXT(stress_splay_tree, &splay_root, node);
 		SPLAY_REMOVE(stress_splay_tree, &splay_root, node);
 		(void)memset(&node->u.splay, 0, sizeof(node->u.splay));
 	}
 }
+#endif
 
 static void binary_insert(
 	struct tree_node **head,
@@ -231,23 +335,27 @@ static void binary_remove_tree(struct tree_node *node)
 static void stress_tree_binary(
 	const stress_args_t *args,
 	const size_t n,
-	struct tree_node *data)
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
 {
 	size_t i;
-	struct tree_node *node, *head = NULL;
+	struct tree_node *head = NULL;
 
-	for (node = data, i = 0; i < n; i++, node++) {
-		binary_insert(&head, node);
+	for (i = 0; i < n; i++) {
+		binary_insert(&head, nodes[i]);
 	}
 
-	for (node = data, i = 0; i < n; i++, node++) {
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
 		struct tree_node *find;
 
-		find = binary_find(head, node);
+		find = binary_find(head, nodes[i]);
 		if (!find)
 			pr_err("%s: binary tree node #%zd not found\n",
 				args->name, i);
 	}
+	stress_tree_lookups_end(ctx, metrics, n);
 	binary_remove_tree(head);
 }
 
@@ -406,50 +514,320 @@ static void avl_remove_tree(struct tree_node *node)
 static void stress_tree_avl(
 	const stress_args_t *args,
 	const size_t n,
-	struct tree_node *data)
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
 {
 	size_t i;
-	struct tree_node *node, *head = NULL;
+	struct tree_node *head = NULL;
 
-	for (node = data, i = 0; i < n; i++, node++) {
+	for (i = 0; i < n; i++) {
 		bool taller = false;
-		avl_insert(&head, node, &taller);
+		avl_insert(&head, nodes[i], &taller);
 	}
-	for (node = data, i = 0; i < n; i++, node++) {
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
 		struct tree_node *find;
 
-		find = avl_find(head, node);
+		find = avl_find(head, nodes[i]);
 		if (!find)
 			pr_err("%s: avl tree node #%zd not found\n",
 				args->name, i);
 	}
+	stress_tree_lookups_end(ctx, metrics, n);
 	avl_remove_tree(head);
 }
 
-static void stress_tree_all(
+/*
+ *  btree_alloc()
+ *	get a b-tree node from the node arena, the whole
+ *	arena is released in one go at the end of each round
+ */
+static btree_node_t *btree_alloc(stress_tree_context_t *ctx, const bool leaf)
+{
+	btree_node_t *node;
+
+	if (UNLIKELY(ctx->btree_pool_used >= ctx->btree_pool_size))
+		return NULL;
+	node = &ctx->btree_pool[ctx->btree_pool_used++];
+	(void)memset(node->keys, 0xff, sizeof(node->keys));
+	node->n = 0;
+	node->leaf = leaf;
+	return node;
+}
+
+/*
+ *  btree_find()
+ *	unused keys are all ones so the position in a node is
+ *	found with a branch free count over the whole cache line
+ */
+static bool btree_find(const btree_node_t *node, const uint64_t key)
+{
+	while (node) {
+		register int i = 0, j;
+
+		for (j = 0; j < BTREE_KEYS; j++)
+			i += (key > node->keys[j]);
+		if ((i < node->n) && (key == node->keys[i]))
+			return true;
+		if (node->leaf)
+			return false;
+		node = node->child[i];
+	}
+	return false;
+}
+
+/*
+ *  btree_split_child()
+ *	split the full i'th child of node, moving its
+ *	median key up into node
+ */
+static int btree_split_child(
+	stress_tree_context_t *ctx,
+	btree_node_t *node,
+	const int i)
+{
+	btree_node_t *y = node->child[i];
+	btree_node_t *z = btree_alloc(ctx, y->leaf);
+	int j;
+
+	if (UNLIKELY(!z))
+		return -1;
+
+	z->n = BTREE_T - 1;
+	for (j = 0; j < BTREE_T - 1; j++)
+		z->keys[j] = y->keys[j + BTREE_T];
+	if (!y->leaf) {
+		for (j = 0; j < BTREE_T; j++)
+			z->child[j] = y->child[j + BTREE_T];
+	}
+	y->n = BTREE_T - 1;
+
+	for (j = node->n; j > i; j--)
+		node->child[j + 1] = node->child[j];
+	node->child[i + 1] = z;
+	for (j = node->n - 1; j >= i; j--)
+		node->keys[j + 1] = node->keys[j];
+	node->keys[i] = y->keys[BTREE_T - 1];
+	node->n++;
+	for (j = BTREE_T - 1; j < BTREE_KEYS; j++)
+		y->keys[j] = ~(uint64_t)0;
+
+	return 0;
+}
+
+/*
+ *  btree_insert()
+ *	insert a key, splitting full nodes on the way down
+ *	so that there is always room for the key in the leaf
+ */
+static int btree_insert(
+	stress_tree_context_t *ctx,
+	btree_node_t **root,
+	const uint64_t key)
+{
+	btree_node_t *node = *root;
+
+	if (node->n == BTREE_KEYS) {
+		btree_node_t *s = btree_alloc(ctx, false);
+
+		if (UNLIKELY(!s))
+			return -1;
+		s->child[0] = node;
+		if (btree_split_child(ctx, s, 0) < 0)
+			return -1;
+		*root = s;
+		node = s;
+	}
+
+	for (;;) {
+		int i = node->n - 1;
+
+		if (node->leaf) {
+			while ((i >= 0) && (key < node->keys[i])) {
+				node->keys[i + 1] = node->keys[i];
+				i--;
+			}
+			node->keys[i + 1] = key;
+			node->n++;
+			return 0;
+		}
+		while ((i >= 0) && (key < node->keys[i]))
+			i--;
+		i++;
+		if (node->child[i]->n == BTREE_KEYS) {
+			if (btree_split_child(ctx, node, i) < 0)
+				return -1;
+			if (key > node->keys[i])
+				i++;
+		}
+		node = node->child[i];
+	}
+}
+
+static void stress_tree_btree(
 	const stress_args_t *args,
 	const size_t n,
-	struct tree_node *data)
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
 {
-	stress_tree_rb(args, n, data);
-	stress_tree_splay(args, n, data);
-	stress_tree_binary(args, n, data);
-	stress_tree_avl(args, n, data);
+	btree_node_t *root;
+	size_t i;
+
+	ctx->btree_pool_used = 0;
+	root = btree_alloc(ctx, true);
+	if (!root)
+		return;
+
+	for (i = 0; i < n; i++) {
+		const uint64_t key = nodes[i]->value;
+
+		if (btree_find(root, key))
+			continue;
+		if (btree_insert(ctx, &root, key) < 0) {
+			pr_fail("%s: btree node arena of %zu nodes exhausted\n",
+				args->name, ctx->btree_pool_size);
+			return;
+		}
+	}
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
+		if (!btree_find(root, nodes[i]->value))
+			pr_err("%s: btree node #%zd not found\n",
+				args->name, i);
+	}
+	stress_tree_lookups_end(ctx, metrics, n);
+
+	/* Drop the whole tree by resetting the arena */
+	ctx->btree_pool_used = 0;
+}
+
+/*
+ *  veb_layout()
+ *	map the breadth first indices of a perfect binary tree of
+ *	the given height rooted at root to van Emde Boas order: the
+ *	top half of the tree is laid out recursively, followed by
+ *	each bottom subtree in turn, so that any root to leaf path
+ *	crosses O(log n / log B) cache lines of B nodes
+ */
+static void veb_layout(
+	uint32_t *map,
+	const size_t root,
+	const uint32_t height,
+	uint32_t *pos)
+{
+	uint32_t top, bottom;
+	size_t k, leaves;
+
+	if (height == 1) {
+		map[root] = (*pos)++;
+		return;
+	}
+	top = height / 2;
+	bottom = height - top;
+	veb_layout(map, root, top, pos);
+
+	leaves = (size_t)1 << top;
+	for (k = 0; k < leaves; k++)
+		veb_layout(map, ((root + 1) << top) - 1 + k, bottom, pos);
 }
-#endif
 
 /*
- * Table of tree stress methods
+ *  veb_fill()
+ *	fill the tree with the sorted keys in order, keys beyond
+ *	the n real keys are padded with the largest key
+ */
+static void veb_fill(
+	stress_tree_context_t *ctx,
+	const size_t bfs,
+	const size_t n,
+	size_t *i)
+{
+	veb_node_t *node;
+	const size_t left = (2 * bfs) + 1;
+
+	if (bfs >= ctx->veb_size)
+		return;
+
+	node = &ctx->veb_nodes[ctx->veb_map[bfs]];
+	veb_fill(ctx, left, n, i);
+	node->key = (*i < n) ? ctx->veb_keys[*i] : ~(uint64_t)0;
+	(*i)++;
+	veb_fill(ctx, left + 1, n, i);
+	if (left < ctx->veb_size) {
+		node->left = ctx->veb_map[left];
+		node->right = ctx->veb_map[left + 1];
+	} else {
+		node->left = VEB_NONE;
+		node->right = VEB_NONE;
+	}
+}
+
+static bool veb_find(const veb_node_t *veb, uint32_t idx, const uint64_t key)
+{
+	while (idx != VEB_NONE) {
+		const veb_node_t *node = &veb[idx];
+
+		if (key == node->key)
+			return true;
+		idx = (key < node->key) ? node->left : node->right;
+	}
+	return false;
+}
+
+static int veb_cmp(const void *p1, const void *p2)
+{
+	const uint64_t v1 = *(const uint64_t *)p1;
+	const uint64_t v2 = *(const uint64_t *)p2;
+
+	if (v1 == v2)
+		return 0;
+	return (v1 > v2) ? 1 : -1;
+}
+
+static void stress_tree_veb(
+	const stress_args_t *args,
+	const size_t n,
+	struct tree_node **nodes,
+	stress_tree_context_t *ctx,
+	stress_tree_metrics_t *metrics)
+{
+	size_t i;
+	uint32_t root;
+
+	/* A static tree is built in one go from the sorted keys */
+	for (i = 0; i < n; i++)
+		ctx->veb_keys[i] = nodes[i]->value;
+	qsort(ctx->veb_keys, n, sizeof(*ctx->veb_keys), veb_cmp);
+	i = 0;
+	veb_fill(ctx, 0, n, &i);
+	root = ctx->veb_map[0];
+
+	stress_tree_lookups_begin(ctx, metrics);
+	for (i = 0; i < n; i++) {
+		if (!veb_find(ctx->veb_nodes, root, nodes[i]->value))
+			pr_err("%s: veb tree node #%zd not found\n",
+				args->name, i);
+	}
+	stress_tree_lookups_end(ctx, metrics, n);
+}
+
+/*
+ * Table of tree stress methods, all has no function
+ * as it cycles through all the other methods
  */
 static const stress_tree_method_info_t tree_methods[] = {
-#if defined(HAVE_LIB_BSD) &&	\
-    !defined(__APPLE__)
-	{ "all",	stress_tree_all },
+	{ "all",	NULL },
 	{ "avl",	stress_tree_avl },
 	{ "binary",	stress_tree_binary },
+	{ "btree",	stress_tree_btree },
+#if defined(HAVE_LIB_BSD) &&	\
+    !defined(__APPLE__)
 	{ "rb",		stress_tree_rb },
 	{ "splay",	stress_tree_splay },
 #endif
+	{ "veb",	stress_tree_veb },
 	{ NULL,		NULL },
 };
 
@@ -461,7 +839,7 @@ static int stress_set_tree_method(const char *name)
 {
 	stress_tree_method_info_t const *info;
 
-	for (info = tree_methods; info->func; info++) {
+	for (info = tree_methods; info->name; info++) {
 		if (!strcmp(info->name, name)) {
 			stress_set_setting("tree-method", TYPE_ID_UINTPTR_T, &info);
 			return 0;
@@ -469,7 +847,7 @@ static int stress_set_tree_method(const char *name)
 	}
 
 	(void)fprintf(stderr, "tree-method must be one of:");
-	for (info = tree_methods; info->func; info++) {
+	for (info = tree_methods; info->name; info++) {
 		(void)fprintf(stderr, " %s", info->name);
 	}
 	(void)fprintf(stderr, "\n");
@@ -480,12 +858,10 @@ static int stress_set_tree_method(const char *name)
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_tree_method,	stress_set_tree_method },
 	{ OPT_tree_size,	stress_set_tree_size },
+	{ OPT_tree_alloc,	stress_set_tree_alloc },
 	{ 0,			NULL }
 };
 
-#if defined(HAVE_LIB_BSD) && 	\
-    !defined(__APPLE__)
-
 /*
  *  Rotate right a 64 bit value, compiler
  *  optimizes this down to a rotate and store
@@ -499,6 +875,119 @@ static inline uint64_t ror64(const uint64_t val)
 	return (tmp | bit0);
 }
 
+/*
+ *  stress_tree_uses()
+ *	true if the method or the all method runs the named method
+ */
+static bool stress_tree_uses(const stress_tree_method_info_t *info, const char *name)
+{
+	return !info->func || !strcmp(info->name, name);
+}
+
+/*
+ *  stress_tree_context_init()
+ *	allocate the b-tree node arena and the veb tree if
+ *	they are going to be used
+ */
+static int stress_tree_context_init(
+	const stress_args_t *args,
+	stress_tree_context_t *ctx,
+	const stress_tree_method_info_t *info,
+	const size_t n)
+{
+	(void)memset(ctx, 0, sizeof(*ctx));
+	ctx->llc_fd = stress_perf_llc_open();
+
+	if (stress_tree_uses(info, "btree")) {
+		/* Every node but the root is at least half full */
+		ctx->btree_pool_size = (n / (BTREE_T - 1)) + 2;
+		ctx->btree_pool = (btree_node_t *)mmap(NULL,
+			ctx->btree_pool_size * sizeof(*ctx->btree_pool),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ctx->btree_pool == MAP_FAILED) {
+			ctx->btree_pool = NULL;
+			pr_inf("%s: cannot allocate b-tree node arena\n", args->name);
+			return -1;
+		}
+	}
+	if (stress_tree_uses(info, "veb")) {
+		uint32_t pos = 0;
+
+		for (ctx->veb_height = 1; (((size_t)1 << ctx->veb_height) - 1) < n; ctx->veb_height++)
+			;
+		ctx->veb_size = ((size_t)1 << ctx->veb_height) - 1;
+		ctx->veb_keys = calloc(n, sizeof(*ctx->veb_keys));
+		ctx->veb_map = calloc(ctx->veb_size, sizeof(*ctx->veb_map));
+		ctx->veb_nodes = (veb_node_t *)mmap(NULL,
+			ctx->veb_size * sizeof(*ctx->veb_nodes),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ctx->veb_nodes == MAP_FAILED)
+			ctx->veb_nodes = NULL;
+		if (!ctx->veb_keys || !ctx->veb_map || !ctx->veb_nodes) {
+			pr_inf("%s: cannot allocate veb tree\n", args->name);
+			return -1;
+		}
+		/* The layout only depends on the tree height */
+		veb_layout(ctx->veb_map, 0, ctx->veb_height, &pos);
+	}
+	return 0;
+}
+
+/*
+ *  stress_tree_context_free()
+ *	free the b-tree node arena and veb tree
+ */
+static void stress_tree_context_free(stress_tree_context_t *ctx)
+{
+	if (ctx->veb_nodes)
+		(void)munmap((void *)ctx->veb_nodes, ctx->veb_size * sizeof(*ctx->veb_nodes));
+	free(ctx->veb_map);
+	free(ctx->veb_keys);
+	if (ctx->btree_pool)
+		(void)munmap((void *)ctx->btree_pool,
+			ctx->btree_pool_size * sizeof(*ctx->btree_pool));
+	if (ctx->llc_fd >= 0)
+		(void)close(ctx->llc_fd);
+}
+
+/*
+ *  stress_tree_report()
+ *	report the lookup rate and LLC misses per lookup
+ *	of each of the tree methods that were run
+ */
+static void stress_tree_report(
+	const stress_args_t *args,
+	const stress_tree_context_t *ctx,
+	const stress_tree_metrics_t *metrics)
+{
+	size_t i, misc = 0;
+	bool lock = false;
+
+	for (i = 1; tree_methods[i].name; i++) {
+		const stress_tree_metrics_t *m = &metrics[i];
+		const double rate = (m->lookup_duration > 0.0) ?
+			(double)m->lookups / m->lookup_duration : 0.0;
+		char desc[40];
+
+		if (!m->lookups)
+			continue;
+		if (args->instance == 0) {
+			if (ctx->llc_fd >= 0) {
+				pr_inf_lock(&lock, "%s: %-6s %10.2f M lookups/sec, "
+					"%.3f LLC misses per lookup\n", args->name,
+					tree_methods[i].name, rate / 1000000.0,
+					(double)m->llc_misses / (double)m->lookups);
+			} else {
+				pr_inf_lock(&lock, "%s: %-6s %10.2f M lookups/sec\n",
+					args->name, tree_methods[i].name, rate / 1000000.0);
+			}
+		}
+		(void)snprintf(desc, sizeof(desc), "M lookups/sec (%s)", tree_methods[i].name);
+		stress_misc_stats_set(args->misc_stats, misc++, desc, rate / 1000000.0);
+	}
+	pr_unlock(&lock);
+}
+
 /*
  *  stress_tree()
  *	stress tree
@@ -506,13 +995,18 @@ static inline uint64_t ror64(const uint64_t val)
 static int stress_tree(const stress_args_t *args)
 {
 	uint64_t v, tree_size = DEFAULT_TREE_SIZE;
-	struct tree_node *nodes, *node;
+	NOCLOBBER struct tree_node *pool = NULL;
+	struct tree_node **nodes;
 	size_t n, i, bit;
 	struct sigaction old_action;
-	int ret;
+	int ret, tree_alloc = TREE_ALLOC_POOL;
+	NOCLOBBER int rc = EXIT_SUCCESS;
 	stress_tree_method_info_t const *info = &tree_methods[0];
+	stress_tree_metrics_t metrics[SIZEOF_ARRAY(tree_methods)];
+	stress_tree_context_t ctx;
 
 	(void)stress_get_setting("tree-method", &info);
+	(void)stress_get_setting("tree-alloc", &tree_alloc);
 
 	if (!stress_get_setting("tree-size", &tree_size)) {
 		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -521,16 +1015,41 @@ static int stress_tree(const stress_args_t *args)
 			tree_size = MIN_TREE_SIZE;
 	}
 	n = (size_t)tree_size;
+	(void)memset(metrics, 0, sizeof(metrics));
 
 	nodes = calloc(n, sizeof(*nodes));
 	if (!nodes) {
 		pr_fail("%s: malloc failed, out of memory\n", args->name);
 		return EXIT_NO_RESOURCE;
 	}
+	if (tree_alloc == TREE_ALLOC_POOL) {
+		pool = calloc(n, sizeof(*pool));
+		if (!pool) {
+			pr_fail("%s: malloc failed, out of memory\n", args->name);
+			free(nodes);
+			return EXIT_NO_RESOURCE;
+		}
+		for (i = 0; i < n; i++)
+			nodes[i] = &pool[i];
+	} else {
+		for (i = 0; i < n; i++) {
+			nodes[i] = calloc(1, sizeof(*nodes[i]));
+			if (!nodes[i]) {
+				pr_fail("%s: malloc failed, out of memory\n", args->name);
+				rc = EXIT_NO_RESOURCE;
+				goto free_nodes;
+			}
+		}
+	}
+
+	if (stress_tree_context_init(args, &ctx, info, n) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto free_ctx;
+	}
 
 	if (stress_sighandler(args->name, SIGALRM, stress_tree_handler, &old_action) < 0) {
-		free(nodes);
-		return EXIT_FAILURE;
+		rc = EXIT_FAILURE;
+		goto free_ctx;
 	}
 
 	ret = sigsetjmp(jmp_env, 1);
@@ -543,7 +1062,7 @@ static int stress_tree(const stress_args_t *args)
 	}
 
 	v = 0;
-	for (node = nodes, i = 0, bit = 0; i < n; i++, node++) {
+	for (i = 0, bit = 0; i < n; i++) {
 		if (!bit) {
 			v = stress_mwc64();
 			bit = 1;
@@ -551,7 +1070,7 @@ static int stress_tree(const stress_args_t *args)
 			v ^= bit;
 			bit <<= 1;
 		}
-		node->value = v;
+		nodes[i]->value = v;
 		v = ror64(v);
 	}
 
@@ -560,11 +1079,18 @@ static int stress_tree(const stress_args_t *args)
 	do {
 		uint64_t rnd;
 
-		info->func(args, n, nodes);
+		if (info->func) {
+			info->func(args, n, nodes, &ctx, &metrics[info - tree_methods]);
+		} else {
+			size_t j;
+
+			for (j = 1; tree_methods[j].func; j++)
+				tree_methods[j].func(args, n, nodes, &ctx, &metrics[j]);
+		}
 
 		rnd = stress_mwc64();
-		for (node = nodes, i = 0; i < n; i++, node++)
-			node->value = ror64(node->value ^ rnd);
+		for (i = 0; i < n; i++)
+			nodes[i]->value = ror64(nodes[i]->value ^ rnd);
 
 		inc_counter(args);
 	} while (keep_stressing(args));
@@ -573,9 +1099,19 @@ static int stress_tree(const stress_args_t *args)
 	(void)stress_sigrestore(args->name, SIGALRM, &old_action);
 tidy:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	stress_tree_report(args, &ctx, metrics);
+free_ctx:
+	stress_tree_context_free(&ctx);
+free_nodes:
+	if (pool) {
+		free(pool);
+	} else {
+		for (i = 0; i < n; i++)
+			free(nodes[i]);
+	}
 	free(nodes);
 
-	return EXIT_SUCCESS;
+	return rc;
 }
 
 stressor_info_t stress_tree_info = {
@@ -584,11 +1120,3 @@ stressor_info_t stress_tree_info = {
 	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
-#else
-stressor_info_t stress_tree_info = {
-	.stressor = stress_not_implemented,
-	.class = CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY,
-	.opt_set_funcs = opt_set_funcs,
-	.help = help
-};
-#endif
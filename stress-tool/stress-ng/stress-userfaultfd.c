@@ -27,6 +27,10 @@
 static const stress_help_t help[] = {
 	{ NULL,	"userfaultfd N",	"start N page faulting workers with userspace handling" },
 	{ NULL,	"userfaultfd-ops N",	"stop after N page faults have been handled" },
+	{ NULL,	"userfaultfd-batch N",	"resolve N pages per fault" },
+	{ NULL,	"userfaultfd-bytes N",	"size of mmap'd region to fault on" },
+	{ NULL,	"userfaultfd-mode M",	"fault and resolve mode, mix, copy, zero, wp or minor" },
+	{ NULL,	"userfaultfd-threads N", "number of extra fault handling pthreads" },
 	{ NULL,	NULL,			NULL }
 };
 
@@ -45,10 +49,46 @@ typedef struct {
 	size_t page_size;
 	size_t sz;
 	pid_t parent;
+	int fd;			/* userfaultfd, for re-protecting in wp mode */
+	int mode;		/* USERFAULTFD_MODE_* */
+	double lat_total;	/* sum of page touch times, ns */
+	double lat_max;		/* slowest page touch, ns */
 } stress_context_t;
 
 #endif
 
+#define USERFAULTFD_MODE_MIX	(0)	/* missing faults, UFFDIO_COPY or ZEROPAGE */
+#define USERFAULTFD_MODE_COPY	(1)	/* missing faults, UFFDIO_COPY */
+#define USERFAULTFD_MODE_ZERO	(2)	/* missing faults, UFFDIO_ZEROPAGE */
+#define USERFAULTFD_MODE_WP	(3)	/* write protect faults, UFFDIO_WRITEPROTECT */
+#define USERFAULTFD_MODE_MINOR	(4)	/* shmem minor faults, UFFDIO_CONTINUE */
+
+#define MAX_USERFAULTFD_BATCH	(512)
+#define MAX_USERFAULTFD_THREADS	(64)
+
+typedef struct {
+	const char *name;
+	const int mode;
+} stress_userfaultfd_mode_t;
+
+static const stress_userfaultfd_mode_t userfaultfd_modes[] = {
+	{ "mix",	USERFAULTFD_MODE_MIX },
+	{ "copy",	USERFAULTFD_MODE_COPY },
+	{ "zero",	USERFAULTFD_MODE_ZERO },
+	{ "wp",		USERFAULTFD_MODE_WP },
+	{ "minor",	USERFAULTFD_MODE_MINOR },
+};
+
+static int stress_set_userfaultfd_batch(const char *opt)
+{
+	size_t userfaultfd_batch;
+
+	userfaultfd_batch = (size_t)stress_get_uint64(opt);
+	stress_check_range("userfaultfd-batch", userfaultfd_batch,
+		1, MAX_USERFAULTFD_BATCH);
+	return stress_set_setting("userfaultfd-batch", TYPE_ID_SIZE_T, &userfaultfd_batch);
+}
+
 static int stress_set_userfaultfd_bytes(const char *opt)
 {
 	size_t userfaultfd_bytes;
@@ -59,8 +99,37 @@ static int stress_set_userfaultfd_bytes(const char *opt)
 	return stress_set_setting("userfaultfd-bytes", TYPE_ID_SIZE_T, &userfaultfd_bytes);
 }
 
+static int stress_set_userfaultfd_mode(const char *opt)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(userfaultfd_modes); i++) {
+		if (!strcmp(opt, userfaultfd_modes[i].name))
+			return stress_set_setting("userfaultfd-mode", TYPE_ID_INT,
+				&userfaultfd_modes[i].mode);
+	}
+	(void)fprintf(stderr, "userfaultfd-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(userfaultfd_modes); i++)
+		(void)fprintf(stderr, " %s", userfaultfd_modes[i].name);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_userfaultfd_threads(const char *opt)
+{
+	size_t userfaultfd_threads;
+
+	userfaultfd_threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("userfaultfd-threads", userfaultfd_threads,
+		0, MAX_USERFAULTFD_THREADS);
+	return stress_set_setting("userfaultfd-threads", TYPE_ID_SIZE_T, &userfaultfd_threads);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_userfaultfd_batch,	stress_set_userfaultfd_batch },
 	{ OPT_userfaultfd_bytes,	stress_set_userfaultfd_bytes },
+	{ OPT_userfaultfd_mode,		stress_set_userfaultfd_mode },
+	{ OPT_userfaultfd_threads,	stress_set_userfaultfd_threads },
 	{ 0,				NULL }
 };
 
@@ -70,13 +139,15 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 
 /*
  *  stress_child_alarm_handler()
- *	SIGALRM handler to terminate child immediately
+ *	SIGALRM handler to stop the child, the handler is shared
+ *	with the parent (CLONE_SIGHAND) so just flag the end of the
+ *	run so the parent can report, the parent kills the child
  */
-static void MLOCKED_TEXT NORETURN stress_child_alarm_handler(int signum)
+static void MLOCKED_TEXT stress_child_alarm_handler(int signum)
 {
 	(void)signum;
 
-	_exit(0);
+	keep_stressing_set_flag(false);
 }
 
 /*
@@ -98,68 +169,336 @@ static int stress_userfaultfd_clone(void *arg)
 	do {
 		uint8_t *ptr, *end = c->data + c->sz;
 
-		/* hint we don't need these pages */
-		if (shim_madvise(c->data, c->sz, MADV_DONTNEED) < 0) {
-			pr_fail("%s: madvise failed, errno=%d (%s)\n",
-				args->name, errno, strerror(errno));
-			(void)kill(c->parent, SIGALRM);
-			return -1;
+#if defined(UFFDIO_WRITEPROTECT)
+		if (c->mode == USERFAULTFD_MODE_WP) {
+			struct uffdio_writeprotect wp;
+
+			/* write protect the pages again */
+			wp.range.start = (unsigned long)c->data;
+			wp.range.len = c->sz;
+			wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+			if (ioctl(c->fd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+				pr_fail("%s: ioctl UFFDIO_WRITEPROTECT failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				(void)kill(c->parent, SIGALRM);
+				return -1;
+			}
+		} else
+#endif
+		{
+			/* hint we don't need these pages */
+			if (shim_madvise(c->data, c->sz, MADV_DONTNEED) < 0) {
+				pr_fail("%s: madvise failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				(void)kill(c->parent, SIGALRM);
+				return -1;
+			}
 		}
-		/* and trigger some page faults */
-		for (ptr = c->data; ptr < end; ptr += c->page_size)
+		/* and trigger some page faults, timing each one */
+		for (ptr = c->data; ptr < end; ptr += c->page_size) {
+			const double t = stress_time_now_ns();
+			double delta;
+
 			*ptr = 0xff;
+			delta = stress_time_now_ns() - t;
+			c->lat_total += delta;
+			if (delta > c->lat_max)
+				c->lat_max = delta;
+		}
 	} while (keep_stressing(args));
 
 	return 0;
 }
 
+/* Fault handling state shared by the handler pthreads */
+typedef struct {
+	const stress_args_t *args;
+	int fd;
+	int mode;		/* USERFAULTFD_MODE_* */
+	bool do_poll;
+	pid_t self;
+	void *zero_page;	/* batch pages of source data */
+	uint8_t *data;
+	size_t sz;
+	size_t page_size;
+	size_t batch;		/* pages to resolve per fault */
+	volatile uint64_t faults;	/* faults handled by all handlers */
+	volatile bool stop;	/* true to stop the handler pthreads */
+} stress_userfaultfd_handler_t;
+
+/*
+ *  stress_userfaultfd_resolve()
+ *	resolve the faults in len bytes from start, returns 0 or -errno
+ */
+static int stress_userfaultfd_resolve(
+	const stress_userfaultfd_handler_t *h,
+	const unsigned long start,
+	const size_t len)
+{
+	int mode = h->mode;
+
+	if (mode == USERFAULTFD_MODE_MIX)
+		mode = (stress_mwc32() & 1) ? USERFAULTFD_MODE_COPY : USERFAULTFD_MODE_ZERO;
+
+	switch (mode) {
+	case USERFAULTFD_MODE_COPY: {
+			struct uffdio_copy copy;
+
+			copy.copy = 0;
+			copy.mode = 0;
+			copy.dst = start;
+			copy.src = (unsigned long)h->zero_page;
+			copy.len = len;
+			if (ioctl(h->fd, UFFDIO_COPY, &copy) < 0)
+				return -errno;
+		}
+		break;
+	case USERFAULTFD_MODE_ZERO: {
+			struct uffdio_zeropage zeropage;
+
+			zeropage.range.start = start;
+			zeropage.range.len = len;
+			zeropage.mode = 0;
+			if (ioctl(h->fd, UFFDIO_ZEROPAGE, &zeropage) < 0)
+				return -errno;
+		}
+		break;
+#if defined(UFFDIO_WRITEPROTECT)
+	case USERFAULTFD_MODE_WP: {
+			struct uffdio_writeprotect wp;
+
+			/* dropping the write protection wakes the faulter */
+			wp.range.start = start;
+			wp.range.len = len;
+			wp.mode = 0;
+			if (ioctl(h->fd, UFFDIO_WRITEPROTECT, &wp) < 0)
+				return -errno;
+		}
+		break;
+#endif
+#if defined(UFFDIO_CONTINUE)
+	case USERFAULTFD_MODE_MINOR: {
+			struct uffdio_continue cont;
+
+			cont.range.start = start;
+			cont.range.len = len;
+			cont.mode = 0;
+			if (ioctl(h->fd, UFFDIO_CONTINUE, &cont) < 0)
+				return -errno;
+		}
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
 /*
  *  handle_page_fault()
- *	handle a write page fault caused by child
+ *	handle a write page fault caused by child, resolving the
+ *	batch aligned block of pages around the faulting page
  */
 static inline int handle_page_fault(
-	const stress_args_t *args,
-	const int fd,
-	uint8_t *addr,
-	void *zero_page,
-	const uint8_t *data_start,
-	const uint8_t *data_end,
-	const size_t page_size)
+	const stress_userfaultfd_handler_t *h,
+	uint8_t *addr)
 {
-	if ((addr < data_start) || (addr >= data_end)) {
+	const stress_args_t *args = h->args;
+	const size_t block = h->batch * h->page_size;
+	const uint8_t *data_end = h->data + h->sz;
+	uint8_t *start;
+	size_t len;
+	int ret;
+
+	if ((addr < h->data) || (addr >= data_end)) {
 		pr_fail("%s: page fault address is out of range\n", args->name);
 		return -1;
 	}
 
-	if (stress_mwc32() & 1) {
-		struct uffdio_copy copy;
+	start = h->data + ((size_t)(addr - h->data) / block) * block;
+	len = STRESS_MINIMUM(block, (size_t)(data_end - start));
+	ret = stress_userfaultfd_resolve(h, (unsigned long)start, len);
 
-		copy.copy = 0;
-		copy.mode = 0;
-		copy.dst = (unsigned long)addr;
-		copy.src = (unsigned long)zero_page;
-		copy.len = page_size;
+	/*
+	 *  Part of the batch is already there, either another
+	 *  handler got to it first or an earlier batch did, so
+	 *  just resolve the page that faulted
+	 */
+	if ((ret == -EEXIST) && (len > h->page_size)) {
+		addr = (uint8_t *)((uintptr_t)addr & ~(h->page_size - 1));
+		ret = stress_userfaultfd_resolve(h, (unsigned long)addr, h->page_size);
+	}
+	if ((ret == -EEXIST) || (ret == -EAGAIN)) {
+		struct uffdio_range wake;
 
-		if (ioctl(fd, UFFDIO_COPY, &copy) < 0) {
-			pr_fail("%s: page fault ioctl UFFDIO_COPY failed, errno=%d (%s)\n",
-				args->name, errno, strerror(errno));
-			return -1;
+		/* Make sure the faulter is not left waiting */
+		wake.start = (unsigned long)addr & ~(h->page_size - 1);
+		wake.len = h->page_size;
+		(void)ioctl(h->fd, UFFDIO_WAKE, &wake);
+		ret = 0;
+	}
+	if (ret < 0) {
+		pr_fail("%s: page fault ioctl to resolve fault failed, errno=%d (%s)\n",
+			args->name, -ret, strerror(-ret));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_userfaultfd_keep_handling()
+ *	check if the handlers should keep on going, the
+ *	main handler stops on the bogo op count too
+ */
+static inline bool stress_userfaultfd_keep_handling(
+	const stress_userfaultfd_handler_t *h,
+	const bool main_handler)
+{
+	if (main_handler)
+		return keep_stressing(h->args);
+	return !h->stop && keep_stressing_flag();
+}
+
+/*
+ *  stress_userfaultfd_handler()
+ *	read and handle page fault events, this is run by the
+ *	stressor and by each of the extra handler pthreads
+ */
+static int stress_userfaultfd_handler(
+	stress_userfaultfd_handler_t *h,
+	const bool main_handler)
+{
+	const stress_args_t *args = h->args;
+	const int fd = h->fd;
+	int count = 0;
+
+	do {
+		struct uffd_msg msg;
+		struct uffdio_range wake;
+		ssize_t ret;
+
+		/* check we should break out before we block on the read */
+		if (!keep_stressing_flag())
+			break;
+
+		/*
+		 * polled wait exercises userfaultfd_poll
+		 * in the kernel, but only works if fd is NONBLOCKing
+		 */
+		if (h->do_poll) {
+			struct pollfd fds[1];
+
+			(void)memset(fds, 0, sizeof fds);
+			fds[0].fd = fd;
+			fds[0].events = POLLIN;
+			/*
+			 *  wait for 1 second max, the pthreads wait
+			 *  for less so they notice the stop sooner
+			 */
+			ret = poll(fds, 1, main_handler ? 1000 : 100);
+			if (ret == 0)
+				continue;	/* timed out, redo the poll */
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno != ENOMEM) {
+					pr_fail("%s: poll failed, errno=%d (%s)\n",
+						args->name, errno, strerror(errno));
+					if (!keep_stressing_flag())
+						break;
+				}
+				/*
+				 *  poll ran out of free space for internal
+				 *  fd tables, so give up and block on the
+				 *  read anyway
+				 */
+				goto do_read;
+			}
+			/* No data, re-poll */
+			if (!(fds[0].revents & POLLIN))
+				continue;
+
+			if (UNLIKELY(main_handler && (count++ >= COUNT_MAX))) {
+				(void)stress_read_fdinfo(h->self, fd);
+				count = 0;
+			}
 		}
-	} else {
-		struct uffdio_zeropage zeropage;
 
-		zeropage.range.start = (unsigned long)addr;
-		zeropage.range.len = page_size;
-		zeropage.mode = 0;
-		if (ioctl(fd, UFFDIO_ZEROPAGE, &zeropage) < 0) {
-			pr_fail("%s: page fault ioctl UFFDIO_ZEROPAGE failed, errno=%d (%s)\n",
+do_read:
+		ret = read(fd, &msg, sizeof(msg));
+		if (ret < 0) {
+			/* Another handler read the event first */
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			pr_fail("%s: read failed, errno=%d (%s)\n",
 				args->name, errno, strerror(errno));
-			return -1;
+			if (!keep_stressing_flag())
+				break;
+			continue;
 		}
-	}
+		/* We only expect a page fault event */
+		if (msg.event != UFFD_EVENT_PAGEFAULT) {
+			pr_fail("%s: msg event not a pagefault event\n", args->name);
+			continue;
+		}
+		/* We only expect a write fault */
+		if (!(msg.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WRITE)) {
+			pr_fail("%s: msg event not write page fault event\n", args->name);
+			continue;
+		}
+		/* Go handle the page fault */
+		if (handle_page_fault(h, (uint8_t *)(intptr_t)msg.arg.pagefault.address) < 0)
+			return -1;
+
+		(void)memset(&wake, 0, sizeof(wake));
+		wake.start = (uintptr_t)h->data;
+		wake.len = h->page_size;
+		ret = ioctl(fd, UFFDIO_WAKE, &wake);
+		(void)ret;
+
+		__sync_fetch_and_add(&h->faults, 1);
+		if (main_handler)
+			set_counter(args, h->faults);
+	} while (stress_userfaultfd_keep_handling(h, main_handler));
+
 	return 0;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+static void *stress_userfaultfd_handler_pthread(void *ptr)
+{
+	static void *nowt = NULL;
+
+	(void)stress_userfaultfd_handler((stress_userfaultfd_handler_t *)ptr, false);
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_userfaultfd_report()
+ *	report the fault handling rate and fault latency
+ */
+static void stress_userfaultfd_report(
+	const stress_args_t *args,
+	const stress_context_t *c,
+	const uint64_t faults,
+	const double duration,
+	const char *mode_name,
+	const size_t threads)
+{
+	const double rate = (duration > 0.0) ? (double)faults / duration : 0.0;
+	const double lat_mean = faults ? c->lat_total / ((double)faults * 1000.0) : 0.0;
+
+	stress_misc_stats_set(args->misc_stats, 0, "faults per sec", rate);
+	stress_misc_stats_set(args->misc_stats, 1, "mean fault usec", lat_mean);
+	stress_misc_stats_set(args->misc_stats, 2, "max fault usec", c->lat_max / 1000.0);
+	if (args->instance == 0)
+		pr_inf("%s: %.0f faults/sec, fault latency mean %.3f usec, max %.3f usec "
+			"(%s mode, %zu handler%s, instance 0)\n", args->name, rate,
+			lat_mean, c->lat_max / 1000.0, mode_name, threads + 1,
+			threads ? "s" : "");
+}
+
 /*
  *  stress_userfaultfd_oomable()
  *	stress userfaultfd system call, this
@@ -172,18 +511,27 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 	size_t sz;
 	uint8_t *data;
 	void *zero_page = NULL;
-	int fd = -1, status, rc = EXIT_SUCCESS, count = 0;
-	const unsigned int uffdio_copy = 1 << _UFFDIO_COPY;
-	const unsigned int uffdio_zeropage = 1 << _UFFDIO_ZEROPAGE;
+	int fd = -1, status, rc = EXIT_SUCCESS, memfd = -1;
+	unsigned int uffdio_ioctls;
 	pid_t pid;
 	const pid_t self = getpid();
 	struct uffdio_api api;
 	struct uffdio_register reg;
 	stress_context_t c;
-	bool do_poll = true;
+	stress_userfaultfd_handler_t h;
+	bool do_poll = true, unsupported = false;
 	static uint8_t stack[STACK_SIZE]; /* Child clone stack */
 	uint8_t *stack_top = (uint8_t *)stress_get_stack_top((void *)stack, STACK_SIZE);
 	size_t userfaultfd_bytes = DEFAULT_MMAP_BYTES;
+	size_t userfaultfd_batch = 1, userfaultfd_threads = 0;
+	size_t i;
+	int userfaultfd_mode = USERFAULTFD_MODE_MIX;
+	const char *mode_name = "mix";
+	double t_start;
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthreads[MAX_USERFAULTFD_THREADS];
+	int pthread_ret[MAX_USERFAULTFD_THREADS];
+#endif
 
 	(void)context;
 
@@ -199,20 +547,93 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 	if (userfaultfd_bytes < args->page_size)
 		userfaultfd_bytes = args->page_size;
 
+	(void)stress_get_setting("userfaultfd-batch", &userfaultfd_batch);
+	(void)stress_get_setting("userfaultfd-mode", &userfaultfd_mode);
+	(void)stress_get_setting("userfaultfd-threads", &userfaultfd_threads);
+	for (i = 0; i < SIZEOF_ARRAY(userfaultfd_modes); i++) {
+		if (userfaultfd_modes[i].mode == userfaultfd_mode)
+			mode_name = userfaultfd_modes[i].name;
+	}
+
 	sz = userfaultfd_bytes & ~(page_size - 1);
 
-	if (posix_memalign(&zero_page, page_size, page_size)) {
+	switch (userfaultfd_mode) {
+	case USERFAULTFD_MODE_COPY:
+		uffdio_ioctls = 1U << _UFFDIO_COPY;
+		break;
+	case USERFAULTFD_MODE_ZERO:
+		uffdio_ioctls = 1U << _UFFDIO_ZEROPAGE;
+		break;
+	case USERFAULTFD_MODE_WP:
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFDIO_REGISTER_MODE_WP) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+		uffdio_ioctls = 1U << _UFFDIO_WRITEPROTECT;
+#else
+		uffdio_ioctls = 0;
+		unsupported = true;
+#endif
+		break;
+	case USERFAULTFD_MODE_MINOR:
+#if defined(UFFDIO_CONTINUE) &&			\
+    defined(UFFDIO_REGISTER_MODE_MINOR) &&	\
+    defined(UFFD_FEATURE_MINOR_SHMEM)
+		uffdio_ioctls = 1U << _UFFDIO_CONTINUE;
+#else
+		uffdio_ioctls = 0;
+		unsupported = true;
+#endif
+		break;
+	default:
+		uffdio_ioctls = (1U << _UFFDIO_COPY) | (1U << _UFFDIO_ZEROPAGE);
+		break;
+	}
+	if (unsupported) {
+		if (args->instance == 0)
+			pr_inf_skip("%s: stressor will be skipped, %s mode not "
+				"supported by the userfaultfd headers\n",
+				args->name, mode_name);
+		return EXIT_NOT_IMPLEMENTED;
+	}
+
+	if (posix_memalign(&zero_page, page_size, page_size * userfaultfd_batch)) {
 		pr_err("%s: zero page allocation failed\n", args->name);
 		return EXIT_NO_RESOURCE;
 	}
+	(void)memset(zero_page, 0, page_size * userfaultfd_batch);
 
-	data = mmap(NULL, sz, PROT_READ | PROT_WRITE,
-		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (userfaultfd_mode == USERFAULTFD_MODE_MINOR) {
+		/* Minor faults need the pages in the shmem page cache */
+		memfd = shim_memfd_create("stress-userfaultfd", 0);
+		if (memfd < 0) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: stressor will be skipped, memfd_create "
+					"failed, errno=%d (%s)\n", args->name,
+					errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			goto free_zeropage;
+		}
+		if (ftruncate(memfd, (off_t)sz) < 0) {
+			pr_err("%s: ftruncate failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			rc = EXIT_NO_RESOURCE;
+			goto free_zeropage;
+		}
+		data = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED, memfd, 0);
+	} else {
+		data = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
 	if (data == MAP_FAILED) {
 		rc = EXIT_NO_RESOURCE;
 		pr_err("%s: mmap failed\n", args->name);
 		goto free_zeropage;
 	}
+	/* Write protect and minor faults are on pages that already exist */
+	if ((userfaultfd_mode == USERFAULTFD_MODE_WP) ||
+	    (userfaultfd_mode == USERFAULTFD_MODE_MINOR))
+		(void)memset(data, 0, sz);
 
 	/* Exercise invalid flags */
 	fd = shim_userfaultfd(~0);
@@ -252,7 +673,23 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 	(void)memset(&api, 0, sizeof(api));
 	api.api = UFFD_API;
 	api.features = 0;
+#if defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+	if (userfaultfd_mode == USERFAULTFD_MODE_WP)
+		api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+#endif
+#if defined(UFFD_FEATURE_MINOR_SHMEM)
+	if (userfaultfd_mode == USERFAULTFD_MODE_MINOR)
+		api.features = UFFD_FEATURE_MINOR_SHMEM;
+#endif
 	if (ioctl(fd, UFFDIO_API, &api) < 0) {
+		if (api.features && (errno == EINVAL)) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: stressor will be skipped, %s mode "
+					"not supported by the kernel\n",
+					args->name, mode_name);
+			rc = EXIT_NOT_IMPLEMENTED;
+			goto unmap_data;
+		}
 		pr_err("%s: ioctl UFFDIO_API failed, errno = %d (%s)\n",
 			args->name, errno, strerror(errno));
 		rc = EXIT_FAILURE;
@@ -270,34 +707,59 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 	reg.range.start = (unsigned long)data;
 	reg.range.len = sz;
 	reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+#if defined(UFFDIO_REGISTER_MODE_WP)
+	if (userfaultfd_mode == USERFAULTFD_MODE_WP)
+		reg.mode = UFFDIO_REGISTER_MODE_WP;
+#endif
+#if defined(UFFDIO_REGISTER_MODE_MINOR)
+	if (userfaultfd_mode == USERFAULTFD_MODE_MINOR)
+		reg.mode = UFFDIO_REGISTER_MODE_MINOR;
+#endif
 	if (ioctl(fd, UFFDIO_REGISTER, &reg) < 0) {
+		if ((userfaultfd_mode >= USERFAULTFD_MODE_WP) && (errno == EINVAL)) {
+			if (args->instance == 0)
+				pr_inf_skip("%s: stressor will be skipped, cannot "
+					"register for %s faults\n",
+					args->name, mode_name);
+			rc = EXIT_NOT_IMPLEMENTED;
+			goto unmap_data;
+		}
 		pr_err("%s: ioctl UFFDIO_REGISTER failed, errno = %d (%s)\n",
 			args->name, errno, strerror(errno));
 		rc = EXIT_FAILURE;
 		goto unmap_data;
 	}
 
-	/* OK, so do we have copy supported? */
-	if ((reg.ioctls & uffdio_copy) != uffdio_copy) {
-		pr_err("%s: ioctl UFFDIO_REGISTER did not support _UFFDIO_COPY\n",
-			args->name);
-		rc = EXIT_FAILURE;
-		goto unmap_data;
-	}
-	/* OK, so do we have zeropage supported? */
-	if ((reg.ioctls & uffdio_zeropage) != uffdio_zeropage) {
-		pr_err("%s: ioctl UFFDIO_REGISTER did not support _UFFDIO_ZEROPAGE\n",
-			args->name);
+	/* OK, so do we have the ioctls to resolve the faults supported? */
+	if ((reg.ioctls & uffdio_ioctls) != uffdio_ioctls) {
+		pr_err("%s: ioctl UFFDIO_REGISTER did not support the ioctls "
+			"for %s mode\n", args->name, mode_name);
 		rc = EXIT_FAILURE;
-		goto unmap_data;
+		goto unreg;
 	}
 
 	/* Set up context for child */
+	(void)memset(&c, 0, sizeof(c));
 	c.args = args;
 	c.data = data;
 	c.sz = sz;
 	c.page_size = page_size;
 	c.parent = self;
+	c.fd = fd;
+	c.mode = userfaultfd_mode;
+
+	/* and for the fault handlers */
+	(void)memset(&h, 0, sizeof(h));
+	h.args = args;
+	h.fd = fd;
+	h.mode = userfaultfd_mode;
+	h.do_poll = do_poll;
+	h.self = self;
+	h.zero_page = zero_page;
+	h.data = data;
+	h.sz = sz;
+	h.page_size = page_size;
+	h.batch = userfaultfd_batch;
 
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
@@ -313,91 +775,23 @@ static int stress_userfaultfd_child(const stress_args_t *args, void *context)
 		goto unreg;
 	}
 
-	/* Parent */
-	do {
-		struct uffd_msg msg;
-		struct uffdio_range wake;
-		ssize_t ret;
-
-		/* check we should break out before we block on the read */
-		if (!keep_stressing_flag())
-			break;
-
-		/*
-		 * polled wait exercises userfaultfd_poll
-		 * in the kernel, but only works if fd is NONBLOCKing
-		 */
-		if (do_poll) {
-			struct pollfd fds[1];
-
-			(void)memset(fds, 0, sizeof fds);
-			fds[0].fd = fd;
-			fds[0].events = POLLIN;
-			/* wait for 1 second max */
-
-			ret = poll(fds, 1, 1000);
-			if (ret == 0)
-				continue;	/* timed out, redo the poll */
-			if (ret < 0) {
-				if (errno == EINTR)
-					continue;
-				if (errno != ENOMEM) {
-					pr_fail("%s: poll failed, errno=%d (%s)\n",
-						args->name, errno, strerror(errno));
-					if (!keep_stressing_flag())
-						break;
-				}
-				/*
-				 *  poll ran out of free space for internal
-				 *  fd tables, so give up and block on the
-				 *  read anyway
-				 */
-				goto do_read;
-			}
-			/* No data, re-poll */
-			if (!(fds[0].revents & POLLIN))
-				continue;
-
-			if (UNLIKELY(count++ >= COUNT_MAX)) {
-				(void)stress_read_fdinfo(self, fd);
-				count = 0;
-			}
-		}
-
-do_read:
-		ret = read(fd, &msg, sizeof(msg));
-		if (ret < 0) {
-			if (errno == EINTR)
-				continue;
-			pr_fail("%s: read failed, errno=%d (%s)\n",
-				args->name, errno, strerror(errno));
-			if (!keep_stressing_flag())
-				break;
-			continue;
-		}
-		/* We only expect a page fault event */
-		if (msg.event != UFFD_EVENT_PAGEFAULT) {
-			pr_fail("%s: msg event not a pagefault event\n", args->name);
-			continue;
-		}
-		/* We only expect a write fault */
-		if (!(msg.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WRITE)) {
-			pr_fail("%s: msg event not write page fault event\n", args->name);
-			continue;
-		}
-		/* Go handle the page fault */
-		if (handle_page_fault(args, fd, (uint8_t *)(intptr_t)msg.arg.pagefault.address,
-				zero_page, data, data + sz, page_size) < 0)
-			break;
-
-		(void)memset(&wake, 0, sizeof(wake));
-		wake.start = (uintptr_t)data;
-		wake.len = page_size;
-		ret = ioctl(fd, UFFDIO_WAKE, &wake);
-		(void)ret;
+	t_start = stress_time_now();
+#if defined(HAVE_LIB_PTHREAD)
+	/* Extra handlers poll, they can't be left blocked on a read */
+	if (!do_poll)
+		userfaultfd_threads = 0;
+	for (i = 0; i < userfaultfd_threads; i++)
+		pthread_ret[i] = pthread_create(&pthreads[i], NULL,
+			stress_userfaultfd_handler_pthread, (void *)&h);
+#else
+	if ((args->instance == 0) && (userfaultfd_threads > 0))
+		pr_inf("%s: pthreads not supported, ignoring the "
+			"--userfaultfd-threads option\n", args->name);
+	userfaultfd_threads = 0;
+#endif
 
-		inc_counter(args);
-	} while (keep_stressing(args));
+	/* Parent */
+	(void)stress_userfaultfd_handler(&h, true);
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	/* Run it over, zap child */
@@ -406,6 +800,16 @@ do_read:
 		pr_dbg("%s: waitpid failed, errno = %d (%s)\n",
 			args->name, errno, strerror(errno));
 	}
+#if defined(HAVE_LIB_PTHREAD)
+	h.stop = true;
+	for (i = 0; i < userfaultfd_threads; i++) {
+		if (pthread_ret[i] == 0)
+			(void)pthread_join(pthreads[i], NULL);
+	}
+#endif
+	set_counter(args, h.faults);
+	stress_userfaultfd_report(args, &c, h.faults, stress_time_now() - t_start,
+		mode_name, userfaultfd_threads);
 unreg:
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	if (ioctl(fd, UFFDIO_UNREGISTER, &reg) < 0) {
@@ -422,6 +826,8 @@ free_zeropage:
 	free(zero_page);
 	if (fd > -1)
 		(void)close(fd);
+	if (memfd > -1)
+		(void)close(memfd);
 
 	return rc;
 }
@@ -27,9 +27,24 @@
 static const stress_help_t help[] = {
 	{ NULL,	"vecmath N",	 "start N workers performing vector math ops" },
 	{ NULL,	"vecmath-ops N", "stop after N vector math bogo operations" },
+	{ NULL,	"vecmath-freq",	 "measure FP throughput and core frequency per vector width" },
 	{ NULL,	NULL,		 NULL }
 };
 
+static int stress_set_vecmath_freq(const char *opt)
+{
+	bool vecmath_freq = true;
+
+	(void)opt;
+
+	return stress_set_setting("vecmath-freq", TYPE_ID_BOOL, &vecmath_freq);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecmath_freq,	stress_set_vecmath_freq },
+	{ 0,			NULL }
+};
+
 /*
  *  Clang 5.0 is the lowest version of clang that
  *  can build this without issues (clang 4.0 seems
@@ -180,9 +195,9 @@ do {				\
  *	stress GCC vector maths
  */
 #if defined(STRESS_ARCH_PPC64)
-static int HOT stress_vecmath(const stress_args_t *args)
+static int HOT stress_vecmath_vectors(const stress_args_t *args)
 #else
-static int HOT TARGET_CLONES stress_vecmath(const stress_args_t *args)
+static int HOT TARGET_CLONES stress_vecmath_vectors(const stress_args_t *args)
 #endif
 {
 	stress_vint8_t a8 = { A(INT16x8) };
@@ -291,15 +306,33 @@ static int HOT TARGET_CLONES stress_vecmath(const stress_args_t *args)
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_vecmath()
+ *	stress GCC vector maths or measure the explicit width
+ *	floating point kernels
+ */
+static int stress_vecmath(const stress_args_t *args)
+{
+	bool vecmath_freq = false;
+
+	(void)stress_get_setting("vecmath-freq", &vecmath_freq);
+	if (vecmath_freq)
+		return stress_vecfreq(args, true);
+	return stress_vecmath_vectors(args);
+}
+
 stressor_info_t stress_vecmath_info = {
 	.stressor = stress_vecmath,
 	.class = CLASS_CPU | CLASS_CPU_CACHE,
-	.help = help
+	.opt_set_funcs = opt_set_funcs,
+	.help = help,
+	.threaded = true
 };
 #else
 stressor_info_t stress_vecmath_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
@@ -21,9 +21,24 @@
 static const stress_help_t help[] = {
 	{ NULL,	"vecwide N",	 "start N workers performing vector math ops" },
 	{ NULL,	"vecwide-ops N", "stop after N vector math bogo operations" },
+	{ NULL,	"vecwide-freq",	 "measure integer throughput and core frequency per vector width" },
 	{ NULL,	NULL,		 NULL }
 };
 
+static int stress_set_vecwide_freq(const char *opt)
+{
+	bool vecwide_freq = true;
+
+	(void)opt;
+
+	return stress_set_setting("vecwide-freq", TYPE_ID_BOOL, &vecwide_freq);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_vecwide_freq,	stress_set_vecwide_freq },
+	{ 0,			NULL }
+};
+
 /*
  *  Clang 5.0 is the lowest version of clang that
  *  can build this without issues (clang 4.0 seems
@@ -141,6 +156,11 @@ static int stress_vecwide(const stress_args_t *args)
 	double total_duration = 0.0;
 	size_t total_bytes = 0;
 	const size_t vec_args_size = (sizeof(*vec_args) + args->page_size - 1) & ~(args->page_size - 1);
+	bool vecwide_freq = false;
+
+	(void)stress_get_setting("vecwide-freq", &vecwide_freq);
+	if (vecwide_freq)
+		return stress_vecfreq(args, false);
 
 	vec_args = (vec_args_t *)mmap(NULL, vec_args_size, PROT_READ | PROT_WRITE,
 					MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -214,12 +234,14 @@ static int stress_vecwide(const stress_args_t *args)
 stressor_info_t stress_vecwide_info = {
 	.stressor = stress_vecwide,
 	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #else
 stressor_info_t stress_vecwide_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU | CLASS_CPU_CACHE,
+	.opt_set_funcs = opt_set_funcs,
 	.help = help
 };
 #endif
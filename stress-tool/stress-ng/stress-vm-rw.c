@@ -28,6 +28,11 @@ static const stress_help_t help[] = {
 	{ NULL,	"vm-rw N",	 "start N vm read/write process_vm* copy workers" },
 	{ NULL,	"vm-rw-bytes N", "transfer N bytes of memory per bogo operation" },
 	{ NULL,	"vm-rw-ops N",	 "stop after N vm process_vm* copy bogo operations" },
+	{ NULL,	"vm-rw-bench",	 "benchmark cross-process copy throughput" },
+	{ NULL,	"vm-rw-iov N",	 "use N iovecs per benchmark copy" },
+	{ NULL,	"vm-rw-seg N",	 "copy N bytes per benchmark iovec" },
+	{ NULL,	"vm-rw-peers N", "benchmark up to N concurrent peers" },
+	{ NULL,	"vm-rw-hugepages", "use huge pages for benchmark buffers" },
 	{ NULL,	NULL,		 NULL }
 };
 
@@ -39,6 +44,11 @@ static const stress_help_t help[] = {
 #define STACK_SIZE	(64 * 1024)
 #define CHUNK_SIZE	(1 * GB)
 
+#define VM_RW_BENCH_NS		(100000000ULL)	/* 100ms per measurement */
+#define VM_RW_MAX_PEER_STEPS	(8)
+#define VM_RW_PATTERN(off)	((uint8_t)((off) >> 6))
+#define VM_RW_HUGE_ROUND(sz)	(((sz) + (2 * MB) - 1) & ~((size_t)(2 * MB) - 1))
+
 typedef struct {
 	const stress_args_t *args;
 	size_t sz;
@@ -53,6 +63,34 @@ typedef struct {
 	uint8_t val;	/* Value to check */
 } stress_addr_msg_t;
 
+typedef struct {
+	uint32_t ready;			/* Peers set up and waiting */
+	bool go;			/* Peers start copying */
+	bool corrupt;			/* Verify found bad data */
+	int err;			/* errno of a failed peer */
+	uint64_t bytes[VM_RW_MAX_PEERS];/* Bytes copied by each peer */
+	double ns[VM_RW_MAX_PEERS];	/* Time each peer took */
+} stress_vm_rw_sync_t;
+
+typedef struct {
+	const stress_args_t *args;
+	uint8_t *buf;			/* Target buffer, shared by all */
+	size_t sz;			/* Size of buf */
+	size_t iov;			/* iovecs per copy */
+	size_t seg;			/* Bytes per iovec */
+	bool hugepages;			/* Buffers on huge pages */
+	pid_t target;			/* Process peers copy to or from */
+	stress_vm_rw_sync_t *sync;	/* Peer start and results */
+} stress_vm_rw_bench_t;
+
+typedef struct {
+	const char *name;
+	bool write;			/* Copies into the target */
+	bool verify;			/* Data can be verified */
+	ssize_t (*func)(const stress_vm_rw_bench_t *bench, const int fd,
+		struct iovec *local, struct iovec *remote);
+} stress_vm_rw_method_t;
+
 #endif
 
 static int stress_set_vm_rw_bytes(const char *opt)
@@ -65,8 +103,56 @@ static int stress_set_vm_rw_bytes(const char *opt)
 	return stress_set_setting("vm-rw-bytes", TYPE_ID_SIZE_T, &vm_rw_bytes);
 }
 
+static int stress_set_vm_rw_bench(const char *opt)
+{
+	bool vm_rw_bench = true;
+
+	(void)opt;
+	return stress_set_setting("vm-rw-bench", TYPE_ID_BOOL, &vm_rw_bench);
+}
+
+static int stress_set_vm_rw_iov(const char *opt)
+{
+	size_t vm_rw_iov;
+
+	vm_rw_iov = (size_t)stress_get_uint64(opt);
+	stress_check_range("vm-rw-iov", vm_rw_iov, 1, VM_RW_MAX_IOV);
+	return stress_set_setting("vm-rw-iov", TYPE_ID_SIZE_T, &vm_rw_iov);
+}
+
+static int stress_set_vm_rw_seg(const char *opt)
+{
+	size_t vm_rw_seg;
+
+	vm_rw_seg = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("vm-rw-seg", vm_rw_seg, 64, 1 * GB);
+	return stress_set_setting("vm-rw-seg", TYPE_ID_SIZE_T, &vm_rw_seg);
+}
+
+static int stress_set_vm_rw_peers(const char *opt)
+{
+	size_t vm_rw_peers;
+
+	vm_rw_peers = (size_t)stress_get_uint64(opt);
+	stress_check_range("vm-rw-peers", vm_rw_peers, 1, VM_RW_MAX_PEERS);
+	return stress_set_setting("vm-rw-peers", TYPE_ID_SIZE_T, &vm_rw_peers);
+}
+
+static int stress_set_vm_rw_hugepages(const char *opt)
+{
+	bool vm_rw_hugepages = true;
+
+	(void)opt;
+	return stress_set_setting("vm-rw-hugepages", TYPE_ID_BOOL, &vm_rw_hugepages);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_vm_rw_bytes,	stress_set_vm_rw_bytes },
+	{ OPT_vm_rw_bench,	stress_set_vm_rw_bench },
+	{ OPT_vm_rw_iov,	stress_set_vm_rw_iov },
+	{ OPT_vm_rw_seg,	stress_set_vm_rw_seg },
+	{ OPT_vm_rw_peers,	stress_set_vm_rw_peers },
+	{ OPT_vm_rw_hugepages,	stress_set_vm_rw_hugepages },
 	{ 0,			NULL }
 };
 
@@ -350,6 +436,582 @@ fail:
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_vm_rw_bench_mmap()
+ *	mmap a benchmark buffer, on hugetlb pages or advised as THP with
+ *	vm-rw-hugepages, and describe the backing in *how
+ */
+static void *stress_vm_rw_bench_mmap(
+	const size_t sz,
+	const bool shared,
+	const bool hugepages,
+	const char **how)
+{
+	const int flags = (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS;
+	void *ptr;
+
+#if defined(MAP_HUGETLB)
+	if (hugepages) {
+		ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			*how = "hugetlb";
+			return ptr;
+		}
+	}
+#endif
+	ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (ptr == MAP_FAILED)
+		return ptr;
+	*how = "4K page";
+#if defined(MADV_HUGEPAGE)
+	if (hugepages && (shim_madvise(ptr, sz, MADV_HUGEPAGE) == 0))
+		*how = "THP";
+#endif
+	return ptr;
+}
+
+/*
+ *  stress_vm_rw_bench_fill()
+ *	fill the target buffer with a per cache line pattern
+ */
+static void stress_vm_rw_bench_fill(uint8_t *buf, const size_t sz)
+{
+	size_t i;
+
+	for (i = 0; i < sz; i += 64)
+		(void)memset(buf + i, (int)VM_RW_PATTERN(i), STRESS_MINIMUM(sz - i, 64));
+}
+
+static ssize_t stress_vm_rw_bench_vm_readv(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	(void)fd;
+	return process_vm_readv(bench->target, local, bench->iov, remote, bench->iov, 0);
+}
+
+static ssize_t stress_vm_rw_bench_vm_writev(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	(void)fd;
+	return process_vm_writev(bench->target, local, bench->iov, remote, bench->iov, 0);
+}
+
+static ssize_t stress_vm_rw_bench_proc_read(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	const off_t offset = (off_t)(uintptr_t)remote[0].iov_base;
+#if defined(HAVE_PREADV)
+	return preadv(fd, local, (int)bench->iov, offset);
+#else
+	ssize_t total = 0;
+	size_t i;
+
+	for (i = 0; i < bench->iov; i++) {
+		const ssize_t ret = pread(fd, local[i].iov_base, local[i].iov_len,
+					  offset + (off_t)(i * bench->seg));
+		if (ret < 0)
+			return ret;
+		total += ret;
+	}
+	return total;
+#endif
+}
+
+static ssize_t stress_vm_rw_bench_proc_write(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	const off_t offset = (off_t)(uintptr_t)remote[0].iov_base;
+#if defined(HAVE_PWRITEV)
+	return pwritev(fd, local, (int)bench->iov, offset);
+#else
+	ssize_t total = 0;
+	size_t i;
+
+	for (i = 0; i < bench->iov; i++) {
+		const ssize_t ret = pwrite(fd, local[i].iov_base, local[i].iov_len,
+					   offset + (off_t)(i * bench->seg));
+		if (ret < 0)
+			return ret;
+		total += ret;
+	}
+	return total;
+#endif
+}
+
+static ssize_t stress_vm_rw_bench_shm_read(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	size_t i;
+
+	(void)fd;
+	for (i = 0; i < bench->iov; i++)
+		(void)memcpy(local[i].iov_base, remote[i].iov_base, bench->seg);
+	return (ssize_t)(bench->iov * bench->seg);
+}
+
+static ssize_t stress_vm_rw_bench_shm_write(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	size_t i;
+
+	(void)fd;
+	for (i = 0; i < bench->iov; i++)
+		(void)memcpy(remote[i].iov_base, local[i].iov_base, bench->seg);
+	return (ssize_t)(bench->iov * bench->seg);
+}
+
+#if defined(HAVE_VMSPLICE)
+static ssize_t stress_vm_rw_bench_vmsplice(
+	const stress_vm_rw_bench_t *bench,
+	const int fd,
+	struct iovec *local,
+	struct iovec *remote)
+{
+	(void)remote;
+	return readv(fd, local, (int)bench->iov);
+}
+#endif
+
+/*
+ *  Transfer methods, the reads first so that verify mode checks a
+ *  freshly filled target
+ */
+static const stress_vm_rw_method_t vm_rw_methods[] = {
+	{ "vm_readv",	  false, true,	stress_vm_rw_bench_vm_readv },
+	{ "proc-mem rd",  false, true,	stress_vm_rw_bench_proc_read },
+	{ "shm rd",	  false, true,	stress_vm_rw_bench_shm_read },
+#if defined(HAVE_VMSPLICE)
+	{ "vmsplice rd",  false, false,	stress_vm_rw_bench_vmsplice },
+#endif
+	{ "vm_writev",	  true,	 false,	stress_vm_rw_bench_vm_writev },
+	{ "proc-mem wr",  true,	 false,	stress_vm_rw_bench_proc_write },
+	{ "shm wr",	  true,	 false,	stress_vm_rw_bench_shm_write },
+};
+
+/*
+ *  stress_vm_rw_bench_remote()
+ *	describe the next iov segments of the target buffer at offset
+ */
+static void stress_vm_rw_bench_remote(
+	const stress_vm_rw_bench_t *bench,
+	struct iovec *remote,
+	size_t *offset)
+{
+	const size_t span = bench->iov * bench->seg;
+	size_t i;
+
+	if (*offset + span > bench->sz)
+		*offset = 0;
+	for (i = 0; i < bench->iov; i++) {
+		remote[i].iov_base = bench->buf + *offset + (i * bench->seg);
+		remote[i].iov_len = bench->seg;
+	}
+	*offset += span;
+}
+
+/*
+ *  stress_vm_rw_bench_producer()
+ *	vmsplice the target buffer into a pipe until the reader closes it
+ */
+static void NORETURN stress_vm_rw_bench_producer(
+	const stress_vm_rw_bench_t *bench,
+	const int fd)
+{
+#if defined(HAVE_VMSPLICE)
+	struct iovec remote[VM_RW_MAX_IOV];
+	size_t offset = 0;
+
+	(void)signal(SIGPIPE, SIG_IGN);
+	for (;;) {
+		stress_vm_rw_bench_remote(bench, remote, &offset);
+		if (vmsplice(fd, remote, bench->iov, 0) < 0)
+			break;
+	}
+#else
+	(void)bench;
+	(void)fd;
+#endif
+	_exit(0);
+}
+
+/*
+ *  stress_vm_rw_bench_peer()
+ *	copy with one method for VM_RW_BENCH_NS once all the peers are
+ *	ready, and post the bytes moved and time taken
+ */
+static void NORETURN stress_vm_rw_bench_peer(
+	const stress_vm_rw_bench_t *bench,
+	const stress_vm_rw_method_t *method,
+	const size_t peer)
+{
+	stress_vm_rw_sync_t *sync = bench->sync;
+	struct iovec local[VM_RW_MAX_IOV], remote[VM_RW_MAX_IOV];
+	const size_t span = bench->iov * bench->seg;
+	const char *how;
+	uint8_t *localbuf;
+	size_t i, offset = (peer * span) % bench->sz, last = 0;
+	uint64_t bytes = 0;
+	double t_start, t_now;
+	int fd = -1, err = 0;
+	pid_t producer = -1;
+
+	(void)setpgid(0, g_pgrp);
+	stress_parent_died_alarm();
+
+	localbuf = stress_vm_rw_bench_mmap(bench->hugepages ?
+		VM_RW_HUGE_ROUND(span) : span, false, bench->hugepages, &how);
+	if (localbuf == MAP_FAILED) {
+		err = errno;
+		goto done;
+	}
+	(void)memset(localbuf, 0xa5, span);
+	for (i = 0; i < bench->iov; i++) {
+		local[i].iov_base = localbuf + (i * bench->seg);
+		local[i].iov_len = bench->seg;
+	}
+
+	if (method->func == stress_vm_rw_bench_proc_read ||
+	    method->func == stress_vm_rw_bench_proc_write) {
+		char path[64];
+
+		(void)snprintf(path, sizeof(path), "/proc/%" PRIdMAX "/mem", (intmax_t)bench->target);
+		fd = open(path, method->write ? O_WRONLY : O_RDONLY);
+		if (fd < 0) {
+			err = errno;
+			goto done;
+		}
+	}
+#if defined(HAVE_VMSPLICE)
+	if (method->func == stress_vm_rw_bench_vmsplice) {
+		int fds[2];
+
+		if (pipe(fds) < 0) {
+			err = errno;
+			goto done;
+		}
+#if defined(F_SETPIPE_SZ)
+		(void)fcntl(fds[1], F_SETPIPE_SZ, (int)STRESS_MAXIMUM(span, (size_t)MB));
+#endif
+		producer = fork();
+		if (producer < 0) {
+			err = errno;
+			(void)close(fds[0]);
+			(void)close(fds[1]);
+			goto done;
+		} else if (producer == 0) {
+			(void)close(fds[0]);
+			stress_vm_rw_bench_producer(bench, fds[1]);
+		}
+		(void)close(fds[1]);
+		fd = fds[0];
+	}
+#endif
+
+	__atomic_add_fetch(&sync->ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&sync->go, __ATOMIC_ACQUIRE)) {
+		if (!keep_stressing_flag())
+			goto done;
+		(void)shim_sched_yield();
+	}
+
+	t_start = stress_time_now_ns();
+	t_now = t_start;
+	do {
+		ssize_t ret;
+
+		stress_vm_rw_bench_remote(bench, remote, &offset);
+		last = offset - span;
+		ret = method->func(bench, fd, local, remote);
+		if (ret < 0) {
+			err = errno;
+			break;
+		}
+		bytes += (uint64_t)ret;
+		t_now = stress_time_now_ns();
+	} while ((t_now - t_start < (double)VM_RW_BENCH_NS) && keep_stressing_flag());
+
+	if (!err && method->verify && (g_opt_flags & OPT_FLAGS_VERIFY)) {
+		/* The last transfer has the pattern of its offsets */
+		for (i = 0; i < bench->iov; i++) {
+			const size_t remote_off = last + (i * bench->seg);
+			const uint8_t *ptr = local[i].iov_base;
+
+			if (*ptr != VM_RW_PATTERN(remote_off)) {
+				pr_fail("%s: %s data at offset %zx: %d vs %d\n",
+					bench->args->name, method->name,
+					remote_off, *ptr, VM_RW_PATTERN(remote_off));
+				sync->corrupt = true;
+				break;
+			}
+		}
+	}
+	sync->bytes[peer] = bytes;
+	sync->ns[peer] = t_now - t_start;
+done:
+	if (err)
+		sync->err = err;
+	if (fd >= 0)
+		(void)close(fd);
+	if (producer > 0) {
+		int status;
+
+		(void)stress_killpid(producer);
+		(void)shim_waitpid(producer, &status, 0);
+	}
+	_exit(0);
+}
+
+/*
+ *  stress_vm_rw_bench_run()
+ *	run peers concurrent copies with method, returns the aggregate
+ *	GB/s, or a negative value if the method failed
+ */
+static double stress_vm_rw_bench_run(
+	const stress_vm_rw_bench_t *bench,
+	const stress_vm_rw_method_t *method,
+	const size_t peers)
+{
+	stress_vm_rw_sync_t *sync = bench->sync;
+	pid_t pids[VM_RW_MAX_PEERS];
+	uint64_t bytes = 0;
+	double ns = 0.0;
+	size_t i, started;
+
+	(void)memset(sync, 0, sizeof(*sync));
+	for (started = 0; started < peers; started++) {
+		pids[started] = fork();
+		if (pids[started] < 0)
+			break;
+		if (pids[started] == 0)
+			stress_vm_rw_bench_peer(bench, method, started);
+	}
+	if (started == peers) {
+		while ((__atomic_load_n(&sync->ready, __ATOMIC_ACQUIRE) < (uint32_t)peers) &&
+		       !sync->err && keep_stressing_flag())
+			(void)shim_sched_yield();
+	}
+	__atomic_store_n(&sync->go, true, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++) {
+		int status;
+
+		(void)shim_waitpid(pids[i], &status, 0);
+	}
+	if (started < peers) {
+		pr_fail("%s: fork failed, errno=%d (%s)\n",
+			bench->args->name, errno, strerror(errno));
+		return -1.0;
+	}
+	if (sync->err) {
+		if (bench->args->instance == 0)
+			pr_inf("%s: %s failed, errno=%d (%s)\n", bench->args->name,
+				method->name, sync->err, strerror(sync->err));
+		return -1.0;
+	}
+	for (i = 0; i < peers; i++) {
+		bytes += sync->bytes[i];
+		ns = STRESS_MAXIMUM(ns, sync->ns[i]);
+	}
+	/* bytes per nanosecond is GB/s */
+	return ns > 0.0 ? (double)bytes / ns : -1.0;
+}
+
+/*
+ *  stress_vm_rw_bench_report()
+ *	report the mean GB/s of each method by peer count
+ */
+static void stress_vm_rw_bench_report(
+	const stress_vm_rw_bench_t *bench,
+	const char *how,
+	const size_t n_peers,
+	const size_t *peers,
+	double gbps[][VM_RW_MAX_PEER_STEPS],
+	uint64_t runs[][VM_RW_MAX_PEER_STEPS])
+{
+	const stress_args_t *args = bench->args;
+	char line[256];
+	bool lock = false;
+	size_t m, p, pos;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: cross-process copy GB/s by peers, %zu x %zu byte "
+		"iovecs, %zu MB %s target\n", args->name, bench->iov, bench->seg,
+		bench->sz / (size_t)MB, how);
+	pos = (size_t)snprintf(line, sizeof(line), "%-12s", "method");
+	for (p = 0; p < n_peers; p++)
+		pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %7zu", peers[p]);
+	(void)snprintf(line + pos, sizeof(line) - pos, " %7s", "scaling");
+	pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+
+	for (m = 0; m < SIZEOF_ARRAY(vm_rw_methods); m++) {
+		pos = (size_t)snprintf(line, sizeof(line), "%-12s", vm_rw_methods[m].name);
+		for (p = 0; p < n_peers; p++) {
+			if (runs[m][p])
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %7.2f",
+					gbps[m][p] / (double)runs[m][p]);
+			else
+				pos += (size_t)snprintf(line + pos, sizeof(line) - pos, " %7s", "n/a");
+		}
+		/* speedup of the most peers over one peer */
+		if (runs[m][0] && runs[m][n_peers - 1] && (gbps[m][0] > 0.0))
+			(void)snprintf(line + pos, sizeof(line) - pos, " %6.2fx",
+				(gbps[m][n_peers - 1] / (double)runs[m][n_peers - 1]) /
+				(gbps[m][0] / (double)runs[m][0]));
+		else
+			(void)snprintf(line + pos, sizeof(line) - pos, " %7s", "n/a");
+		pr_inf_lock(&lock, "%s: %s\n", args->name, line);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_vm_rw_bench()
+ *	measure cross-process copy throughput of process_vm_readv/writev
+ *	against /proc/pid/mem, shared memory memcpy and pipe+vmsplice with
+ *	doubling numbers of concurrent peers copying to or from one target
+ *	process, one bogo op per method and peer count
+ */
+static int stress_vm_rw_bench(const stress_args_t *args, const size_t vm_rw_bytes)
+{
+	static double gbps[SIZEOF_ARRAY(vm_rw_methods)][VM_RW_MAX_PEER_STEPS];
+	static uint64_t runs[SIZEOF_ARRAY(vm_rw_methods)][VM_RW_MAX_PEER_STEPS];
+	stress_vm_rw_bench_t bench;
+	size_t vm_rw_iov = VM_RW_DEFAULT_IOV;
+	size_t vm_rw_seg = VM_RW_DEFAULT_SEG;
+	size_t vm_rw_peers = VM_RW_DEFAULT_PEERS;
+	size_t peers[VM_RW_MAX_PEER_STEPS], n_peers = 0, p, m, map_sz;
+	const char *how = "4K page";
+	bool vm_rw_hugepages = false;
+	int status, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("vm-rw-iov", &vm_rw_iov);
+	(void)stress_get_setting("vm-rw-seg", &vm_rw_seg);
+	(void)stress_get_setting("vm-rw-peers", &vm_rw_peers);
+	(void)stress_get_setting("vm-rw-hugepages", &vm_rw_hugepages);
+
+	/* a transfer of iov segments has to fit in the target */
+	(void)memset(&bench, 0, sizeof(bench));
+	bench.args = args;
+	bench.sz = vm_rw_bytes;
+	bench.seg = STRESS_MINIMUM(vm_rw_seg, bench.sz);
+	bench.iov = STRESS_MAXIMUM((size_t)1, STRESS_MINIMUM(vm_rw_iov, bench.sz / bench.seg));
+	bench.hugepages = vm_rw_hugepages;
+	if ((bench.iov != vm_rw_iov) && (args->instance == 0))
+		pr_inf("%s: using %zu iovecs to fit the %zu byte target buffer\n",
+			args->name, bench.iov, bench.sz);
+
+	for (p = 1; (p <= vm_rw_peers) && (n_peers < VM_RW_MAX_PEER_STEPS); p <<= 1)
+		peers[n_peers++] = p;
+	if (peers[n_peers - 1] != vm_rw_peers)
+		peers[n_peers++] = vm_rw_peers;
+
+	bench.sync = mmap(NULL, sizeof(*bench.sync), PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (bench.sync == MAP_FAILED) {
+		pr_inf("%s: cannot mmap shared sync page, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	map_sz = bench.hugepages ? VM_RW_HUGE_ROUND(bench.sz) : bench.sz;
+	bench.buf = stress_vm_rw_bench_mmap(map_sz, true, bench.hugepages, &how);
+	if (bench.buf == MAP_FAILED) {
+		pr_inf("%s: cannot mmap %zu byte target buffer, errno=%d (%s), "
+			"skipping stressor\n", args->name, map_sz, errno, strerror(errno));
+		(void)munmap((void *)bench.sync, sizeof(*bench.sync));
+		return EXIT_NO_RESOURCE;
+	}
+	stress_vm_rw_bench_fill(bench.buf, bench.sz);
+
+	/* the target shares buf and lets its sibling peers attach to it */
+again:
+	bench.target = fork();
+	if (bench.target < 0) {
+		if (keep_stressing_flag() && (errno == EAGAIN))
+			goto again;
+		pr_fail("%s: fork failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		(void)munmap((void *)bench.buf, map_sz);
+		(void)munmap((void *)bench.sync, sizeof(*bench.sync));
+		return EXIT_NO_RESOURCE;
+	} else if (bench.target == 0) {
+		(void)setpgid(0, g_pgrp);
+		stress_parent_died_alarm();
+#if defined(PR_SET_PTRACER) &&	\
+    defined(PR_SET_PTRACER_ANY)
+		(void)prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0);
+#endif
+		while (keep_stressing_flag())
+			(void)pause();
+		_exit(0);
+	}
+	(void)setpgid(bench.target, g_pgrp);
+
+	(void)memset(gbps, 0, sizeof(gbps));
+	(void)memset(runs, 0, sizeof(runs));
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+	do {
+		if (g_opt_flags & OPT_FLAGS_VERIFY)
+			stress_vm_rw_bench_fill(bench.buf, bench.sz);
+		for (m = 0; (m < SIZEOF_ARRAY(vm_rw_methods)) && keep_stressing(args); m++) {
+			for (p = 0; (p < n_peers) && keep_stressing(args); p++) {
+				double rate;
+
+				/* skip methods that failed, the results are n/a */
+				if ((runs[m][p] == 0) && (gbps[m][p] < 0.0))
+					continue;
+				rate = stress_vm_rw_bench_run(&bench, &vm_rw_methods[m], peers[p]);
+				if (bench.sync->corrupt)
+					rc = EXIT_FAILURE;
+				if (rate < 0.0) {
+					if (!runs[m][p])
+						gbps[m][p] = -1.0;
+					continue;
+				}
+				gbps[m][p] += rate;
+				runs[m][p]++;
+				inc_counter(args);
+			}
+		}
+	} while (keep_stressing(args) && (rc == EXIT_SUCCESS));
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	(void)stress_killpid(bench.target);
+	(void)shim_waitpid(bench.target, &status, 0);
+	(void)munmap((void *)bench.buf, map_sz);
+	(void)munmap((void *)bench.sync, sizeof(*bench.sync));
+
+	if (args->instance == 0)
+		stress_vm_rw_bench_report(&bench, how, n_peers, peers, gbps, runs);
+
+	for (m = 0; m < SIZEOF_ARRAY(vm_rw_methods); m++) {
+		char desc[32];
+
+		p = n_peers - 1;
+		(void)snprintf(desc, sizeof(desc), "%s GB/s (%zu peers)",
+			vm_rw_methods[m].name, peers[p]);
+		stress_misc_stats_set(args->misc_stats, (int)m, desc,
+			runs[m][p] ? gbps[m][p] / (double)runs[m][p] : 0.0);
+	}
+	return rc;
+}
+
 /*
  *  stress_vm_rw
  *	stress vm_read_v/vm_write_v
@@ -360,6 +1022,7 @@ static int stress_vm_rw(const stress_args_t *args)
 	uint8_t stack[64*1024];
 	uint8_t *stack_top = (uint8_t *)stress_get_stack_top((void *)stack, STACK_SIZE);
 	size_t vm_rw_bytes = DEFAULT_VM_RW_BYTES;
+	bool vm_rw_bench = false;
 	int rc;
 
 	if (!stress_get_setting("vm-rw-bytes", &vm_rw_bytes)) {
@@ -377,6 +1040,10 @@ static int stress_vm_rw(const stress_args_t *args)
 	ctxt.sz = vm_rw_bytes & ~(args->page_size - 1);
 	ctxt.iov_count = (ctxt.sz + CHUNK_SIZE - 1) / CHUNK_SIZE;
 
+	(void)stress_get_setting("vm-rw-bench", &vm_rw_bench);
+	if (vm_rw_bench)
+		return stress_vm_rw_bench(args, ctxt.sz);
+
 	if (pipe(ctxt.pipe_wr) < 0) {
 		pr_fail("%s: pipe failed, errno=%d (%s)\n",
 			args->name, errno, strerror(errno));
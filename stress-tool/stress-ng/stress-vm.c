@@ -34,6 +34,9 @@
 
 #define NO_MEM_RETRIES_MAX	(100)
 
+#define VM_THREADS_MAX		(64)
+#define VM_REPORT_METHODS	(8)	/* methods with misc metrics */
+
 /*
  *  the VM stress test has diffent methods of vm stressor
  */
@@ -43,8 +46,16 @@ typedef size_t (*stress_vm_func)(void *buf, void *buf_end, const size_t sz,
 typedef struct {
 	const char *name;
 	const stress_vm_func func;
+	const double traffic;	/* bytes loaded + stored per buffer byte */
+	const bool threads;	/* can run on buffer slices in threads */
 } stress_vm_method_info_t;
 
+typedef struct {
+	uint64_t calls;		/* complete runs of the method */
+	double bytes;		/* bytes loaded and stored */
+	double duration;	/* time taken by the runs */
+} stress_vm_stats_t;
+
 typedef struct {
 	const char *name;
 	const int advice;
@@ -53,9 +64,25 @@ typedef struct {
 typedef struct {
 	uint64_t *bit_error_count;
 	const stress_vm_method_info_t *vm_method;
+	stress_vm_stats_t *stats;	/* per method, shared with the child */
 } stress_vm_context_t;
 
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	const stress_vm_method_info_t *method;
+	stress_args_t args;		/* with a private counter */
+	uint64_t counter;
+	bool counter_ready;
+	void *buf;
+	size_t sz;
+	uint64_t max_ops;
+	size_t bit_errors;
+} stress_vm_thread_t;
+#endif
+
 static const stress_vm_method_info_t vm_methods[];
+static stress_vm_stats_t *vm_stats;
+static size_t vm_threads = 1;
 
 static const stress_help_t help[] = {
 	{ "m N", "vm N",	 "start N workers spinning on anonymous mmap" },
@@ -71,6 +98,7 @@ static const stress_help_t help[] = {
 #if defined(MAP_POPULATE)
 	{ NULL,	 "vm-populate",	 "populate (prefault) page tables for a mapping" },
 #endif
+	{ NULL,	 "vm-threads N", "run methods in N threads per worker" },
 	{ NULL,	 NULL,		 NULL }
 };
 
@@ -191,6 +219,15 @@ static int stress_set_vm_madvise(const char *opt)
 	return -1;
 }
 
+static int stress_set_vm_threads(const char *opt)
+{
+	size_t threads;
+
+	threads = (size_t)stress_get_uint64(opt);
+	stress_check_range("vm-threads", threads, 1, VM_THREADS_MAX);
+	return stress_set_setting("vm-threads", TYPE_ID_SIZE_T, &threads);
+}
+
 static int stress_set_vm_keep(const char *opt)
 {
 	bool vm_keep = true;
@@ -233,6 +270,28 @@ do {						\
 #define UNSIGNED_ABS(a, b)			\
 	((a) > (b)) ? (a) - (b) : (b) - (a)
 
+/*
+ *  64 bit non-temporal stores, bypassing the cache
+ */
+#if defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    defined(HAVE_BUILTIN_NONTEMPORAL_STORE)
+/* Clang non-temporal stores */
+#define VM_NT_STORE64(ptr, val)		\
+	__builtin_nontemporal_store((uint64_t)(val), (uint64_t *)(ptr))
+#define HAVE_VM_NT_STORE64
+#elif defined(HAVE_XMMINTRIN_H) &&	\
+    defined(HAVE_BUILTIN_SUPPORTS) &&	\
+    defined(HAVE_BUILTIN_IA32_MOVNTI64)
+#define VM_NT_STORE64(ptr, val)		\
+	__builtin_ia32_movnti64((long long int *)(ptr), (long long int)(val))
+#define HAVE_VM_NT_STORE64
+#endif
+
+#if defined(HAVE_VECMATH)
+/* 128 byte vector, the compiler picks the widest SIMD it can */
+typedef uint64_t stress_vm_vec_t __attribute__ ((vector_size(128)));
+#endif
+
 #if INJECT_BIT_ERRORS
 /*
  *  inject_random_bit_errors()
@@ -318,17 +377,39 @@ static inline size_t stress_vm_count_bits(uint64_t v)
 }
 
 /*
- *  stress_vm_moving_inversion()
+ *  stress_vm_store64()
+ *	64 bit store, non-temporal if requested and supported
+ */
+static inline void ALWAYS_INLINE stress_vm_store64(
+	volatile uint64_t *ptr,
+	const uint64_t val,
+	const bool nt)
+{
+#if defined(HAVE_VM_NT_STORE64)
+	if (nt) {
+		VM_NT_STORE64(ptr, val);
+		return;
+	}
+#else
+	(void)nt;
+#endif
+	*ptr = val;
+}
+
+/*
+ *  stress_vm_moving_inversion_common()
  *	work sequentially through memory setting 8 bytes at at a time
  *	with a random value, then check if it is correct, invert it and
- *	then check if that is correct.
+ *	then check if that is correct; the stores are optionally
+ *	non-temporal to exercise the write combining path to memory.
  */
-static size_t TARGET_CLONES stress_vm_moving_inversion(
+static inline size_t ALWAYS_INLINE stress_vm_moving_inversion_common(
 	void *buf,
 	void *buf_end,
 	const size_t sz,
 	const stress_args_t *args,
-	const uint64_t max_ops)
+	const uint64_t max_ops,
+	const bool nt)
 {
 	uint64_t c = get_counter(args);
 	uint32_t w, z;
@@ -341,8 +422,10 @@ static size_t TARGET_CLONES stress_vm_moving_inversion(
 
 	stress_mwc_seed(w, z);
 	for (ptr = (uint64_t *)buf; ptr < (uint64_t *)buf_end; ) {
-		*(ptr++) = stress_mwc64();
+		stress_vm_store64(ptr++, stress_mwc64(), nt);
 	}
+	if (nt)
+		shim_mfence();
 
 	stress_mwc_seed(w, z);
 	for (bit_errors = 0, ptr = (uint64_t *)buf; ptr < (uint64_t *)buf_end; ) {
@@ -350,9 +433,11 @@ static size_t TARGET_CLONES stress_vm_moving_inversion(
 
 		if (UNLIKELY(*ptr != val))
 			bit_errors++;
-		*(ptr++) = ~val;
+		stress_vm_store64(ptr++, ~val, nt);
 		c++;
 	}
+	if (nt)
+		shim_mfence();
 	if (UNLIKELY(max_ops && c >= max_ops))
 		goto ret;
 	if (UNLIKELY(!keep_stressing_flag()))
@@ -377,8 +462,10 @@ static size_t TARGET_CLONES stress_vm_moving_inversion(
 
 	stress_mwc_seed(w, z);
 	for (ptr = (uint64_t *)buf_end; ptr > (uint64_t *)buf; ) {
-		*--ptr = stress_mwc64();
+		stress_vm_store64(--ptr, stress_mwc64(), nt);
 	}
+	if (nt)
+		shim_mfence();
 	if (UNLIKELY(!keep_stressing_flag()))
 		goto ret;
 
@@ -391,9 +478,11 @@ static size_t TARGET_CLONES stress_vm_moving_inversion(
 
 		if (UNLIKELY(*--ptr != val))
 			bit_errors++;
-		*ptr = ~val;
+		stress_vm_store64(ptr, ~val, nt);
 		c++;
 	}
+	if (nt)
+		shim_mfence();
 	if (UNLIKELY(max_ops && c >= max_ops))
 		goto ret;
 	if (UNLIKELY(!keep_stressing_flag()))
@@ -421,6 +510,38 @@ ret:
 	return bit_errors;
 }
 
+/*
+ *  stress_vm_moving_inversion()
+ *	moving inversion with regular stores
+ */
+static size_t TARGET_CLONES stress_vm_moving_inversion(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	return stress_vm_moving_inversion_common(buf, buf_end, sz,
+		args, max_ops, false);
+}
+
+#if defined(HAVE_VM_NT_STORE64)
+/*
+ *  stress_vm_moving_inversion_nt()
+ *	moving inversion with non-temporal stores
+ */
+static size_t TARGET_CLONES stress_vm_moving_inversion_nt(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	return stress_vm_moving_inversion_common(buf, buf_end, sz,
+		args, max_ops, true);
+}
+#endif
+
 /*
  *  stress_vm_modulo_x()
  *	set every 23rd byte to a random pattern and then set
@@ -1953,6 +2074,192 @@ static size_t TARGET_CLONES stress_vm_read64(
 	return 0;
 }
 
+#if defined(HAVE_VM_NT_STORE64)
+/*
+ *  stress_vm_write64nt()
+ *	simple 64 bit non-temporal write, no read check
+ */
+static size_t TARGET_CLONES stress_vm_write64nt(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	static uint64_t val;
+	uint64_t *ptr = (uint64_t *)buf;
+	register uint64_t v = val;
+	register size_t i = 0, n = sz / (sizeof(*ptr) * 32);
+
+	(void)buf_end;
+
+	while (i < n) {
+		register int j;
+
+		for (j = 0; j < 4; j++, ptr += 8) {
+			VM_NT_STORE64(ptr + 0, v);
+			VM_NT_STORE64(ptr + 1, v);
+			VM_NT_STORE64(ptr + 2, v);
+			VM_NT_STORE64(ptr + 3, v);
+			VM_NT_STORE64(ptr + 4, v);
+			VM_NT_STORE64(ptr + 5, v);
+			VM_NT_STORE64(ptr + 6, v);
+			VM_NT_STORE64(ptr + 7, v);
+		}
+		i++;
+		if (UNLIKELY(!keep_stressing_flag() || (max_ops && (i >= max_ops))))
+			break;
+	}
+	shim_mfence();
+	add_counter(args, i);
+	val++;
+
+	return 0;
+}
+#endif
+
+#if defined(HAVE_VECMATH)
+#define VM_VEC_LANES	(sizeof(stress_vm_vec_t) / sizeof(uint64_t))
+
+/*
+ *  stress_vm_write1024v()
+ *	128 byte vector write, no read check, same bogo units as write64
+ */
+static size_t TARGET_CLONES stress_vm_write1024v(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	static uint64_t val;
+	stress_vm_vec_t *ptr = (stress_vm_vec_t *)buf;
+	stress_vm_vec_t v;
+	register size_t i = 0, n = sz / (sizeof(*ptr) * 2);
+	size_t j;
+
+	(void)buf_end;
+
+	for (j = 0; j < VM_VEC_LANES; j++)
+		v[j] = val;
+
+	while (i < n) {
+		*ptr++ = v;
+		*ptr++ = v;
+		i++;
+		if (UNLIKELY(!keep_stressing_flag() || (max_ops && (i >= max_ops))))
+			break;
+	}
+	add_counter(args, i);
+	val++;
+
+	return 0;
+}
+
+/*
+ *  stress_vm_read1024v()
+ *	128 byte vector read, same bogo units as read64
+ */
+static size_t TARGET_CLONES stress_vm_read1024v(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	volatile stress_vm_vec_t *ptr = (stress_vm_vec_t *)buf;
+	stress_vm_vec_t sum;
+	register size_t i = 0, n = sz / (sizeof(*ptr) * 2);
+	uint64_t val = 0;
+	size_t j;
+
+	(void)buf_end;
+
+	(void)memset(&sum, 0, sizeof(sum));
+	while (i < n) {
+		sum ^= *(ptr++);
+		sum ^= *(ptr++);
+		i++;
+		if (UNLIKELY(!keep_stressing_flag() || (max_ops && (i >= max_ops))))
+			break;
+	}
+	add_counter(args, i);
+
+	for (j = 0; j < VM_VEC_LANES; j++)
+		val ^= sum[j];
+	stress_uint64_put(val);
+
+	return 0;
+}
+
+/*
+ *  stress_vm_zero_one_v()
+ *	zero-one using 128 byte vectors, the bits are only counted
+ *	for vectors that are not all zero or all one
+ */
+static size_t TARGET_CLONES stress_vm_zero_one_v(
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	stress_vm_vec_t *ptr, zero, ones;
+	uint64_t c = get_counter(args);
+	size_t bit_errors = 0, j;
+
+	(void)max_ops;
+
+	(void)memset(&zero, 0, sizeof(zero));
+	ones = ~zero;
+
+	for (ptr = (stress_vm_vec_t *)buf; ptr < (stress_vm_vec_t *)buf_end; ptr++)
+		*ptr = zero;
+	(void)stress_mincore_touch_pages(buf, sz);
+	inject_random_bit_errors(buf, sz);
+	c += sz / 8;
+
+	for (ptr = (stress_vm_vec_t *)buf; ptr < (stress_vm_vec_t *)buf_end; ptr++) {
+		const stress_vm_vec_t v = *(volatile stress_vm_vec_t *)ptr;
+		uint64_t any = 0;
+
+		for (j = 0; j < VM_VEC_LANES; j++)
+			any |= v[j];
+		if (UNLIKELY(any)) {
+			for (j = 0; j < VM_VEC_LANES; j++)
+				bit_errors += stress_vm_count_bits(v[j]);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			goto abort;
+	}
+
+	for (ptr = (stress_vm_vec_t *)buf; ptr < (stress_vm_vec_t *)buf_end; ptr++)
+		*ptr = ones;
+	(void)stress_mincore_touch_pages(buf, sz);
+	inject_random_bit_errors(buf, sz);
+	c += sz / 8;
+
+	for (ptr = (stress_vm_vec_t *)buf; ptr < (stress_vm_vec_t *)buf_end; ptr++) {
+		const stress_vm_vec_t v = *(volatile stress_vm_vec_t *)ptr;
+		uint64_t all = ~0ULL;
+
+		for (j = 0; j < VM_VEC_LANES; j++)
+			all &= v[j];
+		if (UNLIKELY(~all)) {
+			for (j = 0; j < VM_VEC_LANES; j++)
+				bit_errors += stress_vm_count_bits(~v[j]);
+		}
+		if (UNLIKELY(!keep_stressing_flag()))
+			break;
+	}
+abort:
+	stress_vm_check("zero-one-v", bit_errors);
+	set_counter(args, c);
+
+	return bit_errors;
+}
+#endif
+
 /*
  *  stress_vm_rowhammer()
  *
@@ -2109,6 +2416,135 @@ static size_t TARGET_CLONES stress_vm_mscan(
 }
 
 
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  stress_vm_slice()
+ *	run a vm method on one slice of the buffer
+ */
+static void stress_vm_slice(stress_vm_thread_t *t)
+{
+	t->bit_errors = t->method->func(t->buf, (uint8_t *)t->buf + t->sz,
+		t->sz, &t->args, t->max_ops);
+}
+
+/*
+ *  stress_vm_thread()
+ *	pthread wrapper for stress_vm_slice()
+ */
+static void *stress_vm_thread(void *arg)
+{
+	static void *nowt = NULL;
+	sigset_t set;
+
+	/*
+	 *  Block all signals, let controlling thread
+	 *  handle these
+	 */
+	(void)sigfillset(&set);
+	(void)sigprocmask(SIG_BLOCK, &set, NULL);
+
+	stress_vm_slice((stress_vm_thread_t *)arg);
+
+	return &nowt;
+}
+
+/*
+ *  stress_vm_run_threads()
+ *	split the buffer into page aligned slices and run the method
+ *	on each slice in its own thread, each with a private bogo
+ *	counter that is summed back into the stressor counter
+ */
+static size_t stress_vm_run_threads(
+	const stress_vm_method_info_t *method,
+	void *buf,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops,
+	size_t n)
+{
+	static stress_vm_thread_t threads[VM_THREADS_MAX];
+	pthread_t pthreads[VM_THREADS_MAX];
+	int rets[VM_THREADS_MAX];
+	const size_t page_size = args->page_size;
+	const uint64_t c = get_counter(args);
+	size_t i, slice, bit_errors = 0;
+	uint64_t sum = 0, remaining;
+
+	if (n > sz / page_size)
+		n = sz / page_size;
+	slice = (sz / n) & ~(page_size - 1);
+	remaining = (max_ops > c) ? (max_ops - c) / n : 0;
+
+	for (i = 0; i < n; i++) {
+		stress_vm_thread_t *t = &threads[i];
+
+		(void)memcpy(&t->args, args, sizeof(t->args));
+		t->method = method;
+		t->counter = 0;
+		t->counter_ready = true;
+		t->args.counter = &t->counter;
+		t->args.counter_ready = &t->counter_ready;
+		t->buf = (uint8_t *)buf + (i * slice);
+		t->sz = (i == n - 1) ? sz - (i * slice) : slice;
+		t->max_ops = max_ops ? (remaining ? remaining : 1) : 0;
+		t->bit_errors = 0;
+	}
+	for (i = 1; i < n; i++)
+		rets[i] = pthread_create(&pthreads[i], NULL, stress_vm_thread, &threads[i]);
+
+	/* the first slice runs in the calling thread */
+	stress_vm_slice(&threads[0]);
+
+	for (i = 1; i < n; i++) {
+		if (rets[i] == 0)
+			(void)pthread_join(pthreads[i], NULL);
+		else
+			stress_vm_slice(&threads[i]);
+	}
+	for (i = 0; i < n; i++) {
+		sum += threads[i].counter;
+		bit_errors += threads[i].bit_errors;
+	}
+	add_counter(args, sum);
+
+	return bit_errors;
+}
+#endif
+
+/*
+ *  stress_vm_run()
+ *	run a vm method, in threads if requested and the method
+ *	can be run on slices of the buffer, and account for the
+ *	bytes it loads and stores
+ */
+static size_t stress_vm_run(
+	const stress_vm_method_info_t *method,
+	void *buf,
+	void *buf_end,
+	const size_t sz,
+	const stress_args_t *args,
+	const uint64_t max_ops)
+{
+	const double t_start = stress_time_now_ns();
+	size_t bit_errors;
+
+#if defined(HAVE_LIB_PTHREAD)
+	if ((vm_threads > 1) && method->threads && (sz >= 2 * args->page_size))
+		bit_errors = stress_vm_run_threads(method, buf, sz, args, max_ops, vm_threads);
+	else
+#endif
+		bit_errors = method->func(buf, buf_end, sz, args, max_ops);
+
+	if (vm_stats && keep_stressing_flag()) {
+		stress_vm_stats_t *stats = &vm_stats[method - vm_methods];
+
+		stats->calls++;
+		stats->bytes += method->traffic * (double)sz;
+		stats->duration += stress_time_now_ns() - t_start;
+	}
+	return bit_errors;
+}
+
 /*
  *  stress_vm_all()
  *	work through all vm stressors sequentially
@@ -2123,7 +2559,7 @@ static size_t stress_vm_all(
 	static int i = 1;
 	size_t bit_errors = 0;
 
-	bit_errors = vm_methods[i].func(buf, buf_end, sz, args, max_ops);
+	bit_errors = stress_vm_run(&vm_methods[i], buf, buf_end, sz, args, max_ops);
 	i++;
 	if (vm_methods[i].func == NULL)
 		i = 1;
@@ -2132,35 +2568,50 @@ static size_t stress_vm_all(
 }
 
 static const stress_vm_method_info_t vm_methods[] = {
-	{ "all",	stress_vm_all },
-	{ "flip",	stress_vm_flip },
-	{ "galpat-0",	stress_vm_galpat_zero },
-	{ "galpat-1",	stress_vm_galpat_one },
-	{ "gray",	stress_vm_gray },
-	{ "grayflip",	stress_vm_grayflip },
-	{ "rowhammer",	stress_vm_rowhammer },
-	{ "incdec",	stress_vm_incdec },
-	{ "inc-nybble",	stress_vm_inc_nybble },
-	{ "rand-set",	stress_vm_rand_set },
-	{ "rand-sum",	stress_vm_rand_sum },
-	{ "read64",	stress_vm_read64 },
-	{ "ror",	stress_vm_ror },
-	{ "swap",	stress_vm_swap },
-	{ "move-inv",	stress_vm_moving_inversion },
-	{ "modulo-x",	stress_vm_modulo_x },
-	{ "mscan",	stress_vm_mscan },
-	{ "prime-0",	stress_vm_prime_zero },
-	{ "prime-1",	stress_vm_prime_one },
-	{ "prime-gray-0",stress_vm_prime_gray_zero },
-	{ "prime-gray-1",stress_vm_prime_gray_one },
-	{ "prime-incdec",stress_vm_prime_incdec },
-	{ "walk-0d",	stress_vm_walking_zero_data },
-	{ "walk-1d",	stress_vm_walking_one_data },
-	{ "walk-0a",	stress_vm_walking_zero_addr },
-	{ "walk-1a",	stress_vm_walking_one_addr },
-	{ "write64",	stress_vm_write64 },
-	{ "zero-one",	stress_vm_zero_one },
-	{ NULL,		NULL  }
+	{ "all",	stress_vm_all,			0.0,	false },
+	{ "flip",	stress_vm_flip,			18.0,	false },
+	{ "galpat-0",	stress_vm_galpat_zero,		2.0,	true },
+	{ "galpat-1",	stress_vm_galpat_one,		2.0,	true },
+	{ "gray",	stress_vm_gray,			2.0,	false },
+	{ "grayflip",	stress_vm_grayflip,		2.0,	false },
+	{ "rowhammer",	stress_vm_rowhammer,		2.0,	false },
+	{ "incdec",	stress_vm_incdec,		6.0,	false },
+	{ "inc-nybble",	stress_vm_inc_nybble,		6.0,	false },
+	{ "rand-set",	stress_vm_rand_set,		2.0,	false },
+	{ "rand-sum",	stress_vm_rand_sum,		0.25,	false },
+	{ "read64",	stress_vm_read64,		1.0,	true },
+#if defined(HAVE_VECMATH)
+	{ "read1024v",	stress_vm_read1024v,		1.0,	true },
+#endif
+	{ "ror",	stress_vm_ror,			4.0,	false },
+	{ "swap",	stress_vm_swap,			10.0,	false },
+	{ "move-inv",	stress_vm_moving_inversion,	8.0,	false },
+#if defined(HAVE_VM_NT_STORE64)
+	{ "move-inv-nt", stress_vm_moving_inversion_nt,	8.0,	false },
+#endif
+	{ "modulo-x",	stress_vm_modulo_x,		24.0,	true },
+	{ "mscan",	stress_vm_mscan,		34.0,	true },
+	{ "prime-0",	stress_vm_prime_zero,		18.0,	true },
+	{ "prime-1",	stress_vm_prime_one,		18.0,	true },
+	{ "prime-gray-0", stress_vm_prime_gray_zero,	6.0,	true },
+	{ "prime-gray-1", stress_vm_prime_gray_one,	6.0,	true },
+	{ "prime-incdec", stress_vm_prime_incdec,	6.0,	false },
+	{ "walk-0d",	stress_vm_walking_zero_data,	16.0,	true },
+	{ "walk-1d",	stress_vm_walking_one_data,	16.0,	true },
+	{ "walk-0a",	stress_vm_walking_zero_addr,	1.0,	true },
+	{ "walk-1a",	stress_vm_walking_one_addr,	1.0,	true },
+	{ "write64",	stress_vm_write64,		1.0,	true },
+#if defined(HAVE_VM_NT_STORE64)
+	{ "write64nt",	stress_vm_write64nt,		1.0,	true },
+#endif
+#if defined(HAVE_VECMATH)
+	{ "write1024v",	stress_vm_write1024v,		1.0,	true },
+#endif
+	{ "zero-one",	stress_vm_zero_one,		4.0,	true },
+#if defined(HAVE_VECMATH)
+	{ "zero-one-v",	stress_vm_zero_one_v,		4.0,	true },
+#endif
+	{ NULL,		NULL,				0.0,	false }
 };
 
 /*
@@ -2198,11 +2649,13 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 	size_t buf_sz;
 	size_t vm_bytes = DEFAULT_VM_BYTES;
 	const size_t page_size = args->page_size;
-	bool vm_keep = false;
+	bool vm_keep = false, numa_reported = false;
 	stress_vm_context_t *context = (stress_vm_context_t *)ctxt;
-	const stress_vm_func func = context->vm_method->func;
+	const stress_vm_method_info_t *method = context->vm_method;
 
 	(void)stress_get_setting("vm-hang", &vm_hang);
+	(void)stress_get_setting("vm-threads", &vm_threads);
+	vm_stats = context->stats;
 	(void)stress_get_setting("vm-keep", &vm_keep);
 	(void)stress_get_setting("vm-flags", &vm_flags);
 
@@ -2238,6 +2691,7 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 				continue;	/* Try again */
 			}
 			buf_end = (void *)((uint8_t *)buf + buf_sz);
+			stress_numa_mbind(args, buf, buf_sz);
 			if (vm_madvise < 0)
 				(void)stress_madvise_random(buf, buf_sz);
 			else
@@ -2246,7 +2700,19 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 
 		no_mem_retries = 0;
 		(void)stress_mincore_touch_pages(buf, buf_sz);
-		*(context->bit_error_count) += func(buf, buf_end, buf_sz, args, max_ops);
+		if (method->func == stress_vm_all)
+			*(context->bit_error_count) += stress_vm_all(buf, buf_end, buf_sz, args, max_ops);
+		else
+			*(context->bit_error_count) += stress_vm_run(method, buf, buf_end, buf_sz, args, max_ops);
+		if (!numa_reported) {
+			uint64_t numa_pages[STRESS_NUMA_MAX_NODES];
+
+			(void)memset(numa_pages, 0, sizeof(numa_pages));
+			(void)stress_numa_pages(args, buf, buf_sz, numa_pages,
+				STRESS_NUMA_MAX_NODES);
+			stress_numa_report(args, numa_pages, STRESS_NUMA_MAX_NODES, 0.0);
+			numa_reported = true;
+		}
 
 		if (vm_hang == 0) {
 			while (keep_stressing_vm(args)) {
@@ -2268,6 +2734,61 @@ static int stress_vm_child(const stress_args_t *args, void *ctxt)
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_vm_report()
+ *	report the bytes loaded and stored by each method and the
+ *	resulting rate, the busiest methods are also misc metrics
+ */
+static void stress_vm_report(const stress_args_t *args, const stress_vm_stats_t *stats)
+{
+	size_t i, j, n = 0, idx = 0;
+	size_t order[SIZEOF_ARRAY(vm_methods)];
+	double bytes = 0.0, duration = 0.0;
+	bool lock = false;
+
+	for (i = 0; i < SIZEOF_ARRAY(vm_methods); i++) {
+		if (!stats[i].calls || (stats[i].bytes <= 0.0))
+			continue;
+		bytes += stats[i].bytes;
+		duration += stats[i].duration;
+		/* insertion sort, most bytes first */
+		for (j = n; (j > 0) && (stats[order[j - 1]].bytes < stats[i].bytes); j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+		n++;
+	}
+	if (!n)
+		return;
+
+	stress_misc_stats_set(args->misc_stats, idx++, "GB touched", bytes / 1.0E9);
+	stress_misc_stats_set(args->misc_stats, idx++, "GB/s touched",
+		duration > 0.0 ? bytes / duration : 0.0);
+	for (i = 0; (i < n) && (i < VM_REPORT_METHODS); i++) {
+		const stress_vm_stats_t *st = &stats[order[i]];
+		char desc[32];
+
+		(void)snprintf(desc, sizeof(desc), "%s GB/s", vm_methods[order[i]].name);
+		stress_misc_stats_set(args->misc_stats, idx++, desc,
+			st->duration > 0.0 ? st->bytes / st->duration : 0.0);
+	}
+
+	if (args->instance != 0)
+		return;
+
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %-12s %10s %12s %10s\n", args->name,
+		"method", "calls", "GB touched", "GB/s");
+	for (i = 0; i < n; i++) {
+		const stress_vm_stats_t *st = &stats[order[i]];
+
+		pr_inf_lock(&lock, "%s: %-12s %10" PRIu64 " %12.3f %10.3f\n",
+			args->name, vm_methods[order[i]].name, st->calls,
+			st->bytes / 1.0E9,
+			st->duration > 0.0 ? st->bytes / st->duration : 0.0);
+	}
+	pr_unlock(&lock);
+}
+
 /*
  *  stress_vm()
  *	stress virtual memory
@@ -2277,6 +2798,7 @@ static int stress_vm(const stress_args_t *args)
 	uint64_t tmp_counter;
 	const size_t page_size = args->page_size;
 	size_t retries;
+	const size_t stats_sz = sizeof(stress_vm_stats_t) * SIZEOF_ARRAY(vm_methods);
 	int err = 0, ret = EXIT_SUCCESS;
 	stress_vm_context_t context;
 
@@ -2309,6 +2831,14 @@ static int stress_vm(const stress_args_t *args)
 
 	*context.bit_error_count = 0ULL;
 
+	/* per method byte accounting, not fatal if it can't be mapped */
+	context.stats = (stress_vm_stats_t *)mmap(NULL, stats_sz,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (context.stats == MAP_FAILED)
+		context.stats = NULL;
+	else
+		(void)memset(context.stats, 0, stats_sz);
+
 	stress_set_proc_state(args->name, STRESS_STATE_RUN);
 
 	ret = stress_oomable_child(args, &context, stress_vm_child, STRESS_OOMABLE_NORMAL);
@@ -2323,6 +2853,10 @@ static int stress_vm(const stress_args_t *args)
 
 	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
 	(void)munmap((void *)context.bit_error_count, page_size);
+	if (context.stats) {
+		stress_vm_report(args, context.stats);
+		(void)munmap((void *)context.stats, stats_sz);
+	}
 
 	tmp_counter = get_counter(args) >> VM_BOGO_SHIFT;
 	set_counter(args, tmp_counter);
@@ -2343,6 +2877,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_vm_method,	stress_set_vm_method },
 	{ OPT_vm_mmap_locked,	stress_set_vm_mmap_locked },
 	{ OPT_vm_mmap_populate,	stress_set_vm_mmap_populate },
+	{ OPT_vm_threads,	stress_set_vm_threads },
 	{ 0,			NULL }
 };
 
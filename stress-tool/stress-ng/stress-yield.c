@@ -168,7 +168,8 @@ static int stress_yield(const stress_args_t *args)
 stressor_info_t stress_yield_info = {
 	.stressor = stress_yield,
 	.class = CLASS_SCHEDULER | CLASS_OS,
-	.help = help
+	.help = help,
+	.threaded = true
 };
 #else
 stressor_info_t stress_yield_info = {
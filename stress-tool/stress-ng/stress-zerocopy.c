@@ -0,0 +1,1027 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+#include "io-uring.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"zerocopy N",		"start N workers comparing zero-copy data paths" },
+	{ NULL,	"zerocopy-ops N",	"stop after N zerocopy bogo dataset transfers" },
+	{ NULL,	"zerocopy-method M",	"data path and mechanism, default is all" },
+	{ NULL,	"zerocopy-bytes N",	"size of the dataset moved per transfer" },
+	{ NULL,	"zerocopy-chunk N",	"bytes moved per system call" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define ZEROCOPY_METHOD_ALL	(0)
+
+#define MIN_ZEROCOPY_BYTES	(1 * MB)
+#define MAX_ZEROCOPY_BYTES	(1 * GB)
+#define DEFAULT_ZEROCOPY_BYTES	(16 * MB)
+
+#define MIN_ZEROCOPY_CHUNK	(4 * KB)
+#define MAX_ZEROCOPY_CHUNK	(16 * MB)
+#define DEFAULT_ZEROCOPY_CHUNK	(64 * KB)
+
+/*
+ *  data paths and the mechanisms that move data along them,
+ *  copy is the read/write baseline that bounces through a buffer
+ */
+static const char * const zerocopy_methods[] = {
+	"file-sock-copy",
+	"file-sock-sendfile",
+	"file-sock-splice",
+	"file-sock-uring-splice",
+	"file-file-copy",
+	"file-file-copy-file-range",
+	"file-file-sendfile",
+	"file-file-splice",
+	"mem-pipe-copy",
+	"mem-pipe-vmsplice",
+};
+
+#define ZEROCOPY_METHODS	SIZEOF_ARRAY(zerocopy_methods)
+
+static int stress_set_zerocopy_method(const char *opt)
+{
+	size_t i;
+	int method;
+
+	if (!strcmp(opt, "all")) {
+		method = ZEROCOPY_METHOD_ALL;
+		return stress_set_setting("zerocopy-method", TYPE_ID_INT, &method);
+	}
+	for (i = 0; i < ZEROCOPY_METHODS; i++) {
+		if (!strcmp(opt, zerocopy_methods[i])) {
+			method = (int)i + 1;
+			return stress_set_setting("zerocopy-method", TYPE_ID_INT, &method);
+		}
+	}
+	(void)fprintf(stderr, "zerocopy-method must be one of: all");
+	for (i = 0; i < ZEROCOPY_METHODS; i++)
+		(void)fprintf(stderr, " %s", zerocopy_methods[i]);
+	(void)fprintf(stderr, "\n");
+	return -1;
+}
+
+static int stress_set_zerocopy_bytes(const char *opt)
+{
+	size_t zerocopy_bytes;
+
+	zerocopy_bytes = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("zerocopy-bytes", (uint64_t)zerocopy_bytes,
+		MIN_ZEROCOPY_BYTES, MAX_ZEROCOPY_BYTES);
+	return stress_set_setting("zerocopy-bytes", TYPE_ID_SIZE_T, &zerocopy_bytes);
+}
+
+static int stress_set_zerocopy_chunk(const char *opt)
+{
+	size_t zerocopy_chunk;
+
+	zerocopy_chunk = (size_t)stress_get_uint64_byte(opt);
+	stress_check_range_bytes("zerocopy-chunk", (uint64_t)zerocopy_chunk,
+		MIN_ZEROCOPY_CHUNK, MAX_ZEROCOPY_CHUNK);
+	return stress_set_setting("zerocopy-chunk", TYPE_ID_SIZE_T, &zerocopy_chunk);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_zerocopy_method,	stress_set_zerocopy_method },
+	{ OPT_zerocopy_bytes,	stress_set_zerocopy_bytes },
+	{ OPT_zerocopy_chunk,	stress_set_zerocopy_chunk },
+	{ 0,			NULL }
+};
+
+#if defined(__linux__) &&		\
+    defined(HAVE_SYS_SENDFILE_H) &&	\
+    defined(HAVE_SPLICE) &&		\
+    defined(HAVE_VMSPLICE) &&		\
+    defined(SPLICE_F_MOVE) &&		\
+    defined(F_SETPIPE_SZ) &&		\
+    defined(F_GETPIPE_SZ)
+
+#if defined(HAVE_LINUX_IO_URING_H) &&	\
+    defined(__NR_io_uring_setup) &&	\
+    defined(__NR_io_uring_enter) &&	\
+    defined(IORING_OFF_SQ_RING) &&	\
+    defined(IORING_OFF_CQ_RING) &&	\
+    defined(IORING_OFF_SQES) &&		\
+    defined(IORING_ENTER_GETEVENTS) &&	\
+    defined(IOSQE_IO_LINK) &&		\
+    defined(HAVE_IORING_OP_SPLICE)
+#define STRESS_ZEROCOPY_IO_URING
+#endif
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) &&	\
+    defined(__NR_perf_event_open)
+#define STRESS_ZEROCOPY_CYCLES
+#endif
+
+#if defined(STRESS_ZEROCOPY_IO_URING)
+#define VOID_ADDR_OFFSET(addr, offset)	\
+	((void *)(((uint8_t *)addr) + offset))
+
+/*
+ *  minimal io-uring, one linked pair of splices in flight at a time
+ */
+typedef struct {
+	int fd;			/* io-uring fd */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_mmap;
+	void *cq_mmap;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+	unsigned tail;		/* local tail of queued SQEs */
+	unsigned submitted;	/* SQEs consumed by the kernel */
+} stress_zerocopy_uring_t;
+#endif
+
+typedef struct {
+	const stress_args_t *args;
+	int fd_src;		/* dataset file */
+	int fd_dst;		/* destination of the file to file paths */
+	int fd_sock;		/* sending end of a loopback TCP connection */
+	int fd_null;		/* /dev/null to drain the pipe */
+	int fds[2];		/* pipe for splice and vmsplice */
+	uint8_t *buf;		/* bounce buffer of the copy baselines */
+	uint8_t *data;		/* dataset in memory */
+	size_t bytes;		/* dataset size */
+	size_t chunk;		/* bytes per system call */
+#if defined(STRESS_ZEROCOPY_IO_URING)
+	stress_zerocopy_uring_t ring;
+#endif
+} stress_zerocopy_t;
+
+typedef struct {
+	uint64_t transfers;	/* completed dataset transfers */
+	uint64_t bytes;		/* bytes moved */
+	double duration;	/* wall clock time of the transfers */
+	double cpu;		/* CPU time of the sender */
+	uint64_t cycles;	/* CPU cycles of the sender */
+	bool unsupported;	/* not supported by this kernel or file system */
+} stress_zerocopy_stats_t;
+
+typedef int (*stress_zerocopy_func_t)(stress_zerocopy_t *zc);
+
+/*
+ *  stress_zerocopy_write_all()
+ *	write all of len bytes, returns 0 or -1 with errno set
+ */
+static int stress_zerocopy_write_all(const int fd, const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		const ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_zerocopy_splice_out()
+ *	splice len bytes out of the pipe to fd at offset off,
+ *	or the current position of fd if off is NULL
+ */
+static int stress_zerocopy_splice_out(
+	stress_zerocopy_t *zc,
+	const int fd,
+	loff_t *off,
+	size_t len)
+{
+	while (len > 0) {
+		const ssize_t ret = splice(zc->fds[0], NULL, fd, off, len, SPLICE_F_MOVE);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0) {
+			errno = EPIPE;
+			return -1;
+		}
+		len -= (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_zerocopy_file_fd_copy()
+ *	pread chunks of the dataset and write them to fd
+ */
+static int stress_zerocopy_file_fd_copy(stress_zerocopy_t *zc, const int fd)
+{
+	off_t off = 0;
+
+	while ((size_t)off < zc->bytes) {
+		const ssize_t ret = pread(zc->fd_src, zc->buf,
+			STRESS_MINIMUM(zc->chunk, zc->bytes - (size_t)off), off);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			break;
+		if (stress_zerocopy_write_all(fd, zc->buf, (size_t)ret) < 0)
+			return -1;
+		off += ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_zerocopy_file_fd_sendfile()
+ *	sendfile the dataset to the current position of fd
+ */
+static int stress_zerocopy_file_fd_sendfile(stress_zerocopy_t *zc, const int fd)
+{
+	off_t off = 0;
+
+	while ((size_t)off < zc->bytes) {
+		const ssize_t ret = sendfile(fd, zc->fd_src, &off,
+			STRESS_MINIMUM(zc->chunk, zc->bytes - (size_t)off));
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			break;
+	}
+	return 0;
+}
+
+/*
+ *  stress_zerocopy_file_fd_splice()
+ *	splice the dataset into the pipe and out of the pipe to fd
+ */
+static int stress_zerocopy_file_fd_splice(stress_zerocopy_t *zc, const int fd, loff_t *off_out)
+{
+	loff_t off = 0;
+
+	while ((size_t)off < zc->bytes) {
+		const ssize_t ret = splice(zc->fd_src, &off, zc->fds[1], NULL,
+			STRESS_MINIMUM(zc->chunk, zc->bytes - (size_t)off), SPLICE_F_MOVE);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			break;
+		if (stress_zerocopy_splice_out(zc, fd, off_out, (size_t)ret) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int stress_zerocopy_file_sock_copy(stress_zerocopy_t *zc)
+{
+	return stress_zerocopy_file_fd_copy(zc, zc->fd_sock);
+}
+
+static int stress_zerocopy_file_sock_sendfile(stress_zerocopy_t *zc)
+{
+	return stress_zerocopy_file_fd_sendfile(zc, zc->fd_sock);
+}
+
+static int stress_zerocopy_file_sock_splice(stress_zerocopy_t *zc)
+{
+	return stress_zerocopy_file_fd_splice(zc, zc->fd_sock, NULL);
+}
+
+#if defined(STRESS_ZEROCOPY_IO_URING)
+/*
+ *  stress_zerocopy_uring_close()
+ *	tear down an io-uring
+ */
+static void stress_zerocopy_uring_close(stress_zerocopy_uring_t *ring)
+{
+	if (ring->sqes)
+		(void)munmap((void *)ring->sqes, ring->sqes_size);
+	if (ring->cq_mmap && (ring->cq_mmap != ring->sq_mmap))
+		(void)munmap(ring->cq_mmap, ring->cq_size);
+	if (ring->sq_mmap)
+		(void)munmap(ring->sq_mmap, ring->sq_size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+	(void)memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*
+ *  stress_zerocopy_uring_setup()
+ *	set up an io-uring of at least entries SQEs,
+ *	returns 0 or -1 with errno set
+ */
+static int stress_zerocopy_uring_setup(stress_zerocopy_uring_t *ring, const unsigned entries)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	(void)memset(ring, 0, sizeof(*ring));
+	(void)memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = ring->sq_size;
+	}
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sq_mmap = ptr;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_mmap = ring->sq_mmap;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto err;
+		ring->cq_mmap = ptr;
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto err;
+	ring->sqes = (struct io_uring_sqe *)ptr;
+
+	ring->sq_tail = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.tail);
+	ring->sq_mask = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.ring_mask);
+	ring->sq_array = VOID_ADDR_OFFSET(ring->sq_mmap, p.sq_off.array);
+	ring->cq_head = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.head);
+	ring->cq_tail = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.tail);
+	ring->cq_mask = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.ring_mask);
+	ring->cqes = VOID_ADDR_OFFSET(ring->cq_mmap, p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+	ring->submitted = ring->tail;
+
+	return 0;
+err:
+	err = errno;
+	stress_zerocopy_uring_close(ring);
+	errno = err;
+	return -1;
+}
+
+/*
+ *  stress_zerocopy_uring_splice()
+ *	queue a splice of len bytes from fd_in at off_in to fd_out,
+ *	an offset of -1 uses the pipe
+ */
+static void stress_zerocopy_uring_splice(
+	stress_zerocopy_uring_t *ring,
+	const int fd_in,
+	const int64_t off_in,
+	const int fd_out,
+	const size_t len,
+	const uint8_t flags)
+{
+	const unsigned idx = ring->tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	ring->sq_array[idx] = idx;
+	ring->tail++;
+	(void)memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_SPLICE;
+	sqe->flags = flags;
+	sqe->splice_fd_in = fd_in;
+	sqe->splice_off_in = (uint64_t)off_in;
+	sqe->fd = fd_out;
+	sqe->off = (uint64_t)-1;
+	sqe->len = (uint32_t)len;
+	sqe->splice_flags = SPLICE_F_MOVE;
+}
+
+/*
+ *  stress_zerocopy_file_sock_uring_splice()
+ *	splice the dataset into the pipe and out to the socket with
+ *	a linked pair of io-uring splices per chunk
+ */
+static int stress_zerocopy_file_sock_uring_splice(stress_zerocopy_t *zc)
+{
+	stress_zerocopy_uring_t *ring = &zc->ring;
+	size_t off = 0;
+
+	if (ring->fd < 0) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	while (off < zc->bytes) {
+		const size_t len = STRESS_MINIMUM(zc->chunk, zc->bytes - off);
+		int32_t res[2] = { 0, 0 };
+		unsigned head, reaped = 0;
+
+		stress_zerocopy_uring_splice(ring, zc->fd_src, (int64_t)off,
+			zc->fds[1], len, IOSQE_IO_LINK);
+		stress_zerocopy_uring_splice(ring, zc->fds[0], -1,
+			zc->fd_sock, len, 0);
+
+		while (reaped < 2) {
+			int ret;
+
+			*ring->sq_tail = ring->tail;
+			shim_mb();
+			ret = (int)syscall(__NR_io_uring_enter, ring->fd,
+				ring->tail - ring->submitted, 2 - reaped,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			ring->submitted += (unsigned)ret;
+			shim_mb();
+			for (head = *ring->cq_head; head != *ring->cq_tail; head++) {
+				const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+				if (reaped < 2)
+					res[reaped++] = cqe->res;
+			}
+			*ring->cq_head = head;
+			shim_mb();
+		}
+		if (res[0] < 0) {
+			errno = -res[0];
+			return -1;
+		}
+		if (res[0] == 0)
+			break;
+		/*
+		 *  The socket may take less than was spliced into the
+		 *  pipe, or the linked splice was cancelled, either way
+		 *  drain what is left before the next chunk
+		 */
+		if (res[1] < 0)
+			res[1] = 0;
+		if ((res[1] < res[0]) &&
+		    (stress_zerocopy_splice_out(zc, zc->fd_sock, NULL,
+			(size_t)(res[0] - res[1])) < 0))
+			return -1;
+		off += (size_t)res[0];
+	}
+	return 0;
+}
+#else
+static int stress_zerocopy_file_sock_uring_splice(stress_zerocopy_t *zc)
+{
+	(void)zc;
+
+	errno = ENOSYS;
+	return -1;
+}
+#endif
+
+static int stress_zerocopy_file_file_copy(stress_zerocopy_t *zc)
+{
+	return stress_zerocopy_file_fd_copy(zc, zc->fd_dst);
+}
+
+/*
+ *  stress_zerocopy_file_file_copy_file_range()
+ *	copy the dataset with copy_file_range, on file systems with
+ *	reflinks or server side copies this may move no data at all
+ */
+static int stress_zerocopy_file_file_copy_file_range(stress_zerocopy_t *zc)
+{
+	shim_loff_t off_in = 0, off_out = 0;
+
+	while ((size_t)off_in < zc->bytes) {
+		const ssize_t ret = shim_copy_file_range(zc->fd_src, &off_in,
+			zc->fd_dst, &off_out,
+			STRESS_MINIMUM(zc->chunk, zc->bytes - (size_t)off_in), 0);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			break;
+	}
+	return 0;
+}
+
+static int stress_zerocopy_file_file_sendfile(stress_zerocopy_t *zc)
+{
+	return stress_zerocopy_file_fd_sendfile(zc, zc->fd_dst);
+}
+
+static int stress_zerocopy_file_file_splice(stress_zerocopy_t *zc)
+{
+	loff_t off_out = 0;
+
+	return stress_zerocopy_file_fd_splice(zc, zc->fd_dst, &off_out);
+}
+
+/*
+ *  stress_zerocopy_mem_pipe_copy()
+ *	write the in memory dataset into the pipe, the pipe is
+ *	drained to /dev/null with splice which moves no data
+ */
+static int stress_zerocopy_mem_pipe_copy(stress_zerocopy_t *zc)
+{
+	size_t off = 0;
+
+	while (off < zc->bytes) {
+		const ssize_t ret = write(zc->fds[1], zc->data + off,
+			STRESS_MINIMUM(zc->chunk, zc->bytes - off));
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (stress_zerocopy_splice_out(zc, zc->fd_null, NULL, (size_t)ret) < 0)
+			return -1;
+		off += (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_zerocopy_mem_pipe_vmsplice()
+ *	map the pages of the in memory dataset into the pipe
+ */
+static int stress_zerocopy_mem_pipe_vmsplice(stress_zerocopy_t *zc)
+{
+	size_t off = 0;
+
+	while (off < zc->bytes) {
+		struct iovec iov;
+		ssize_t ret;
+
+		iov.iov_base = zc->data + off;
+		iov.iov_len = STRESS_MINIMUM(zc->chunk, zc->bytes - off);
+		ret = vmsplice(zc->fds[1], &iov, 1, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (stress_zerocopy_splice_out(zc, zc->fd_null, NULL, (size_t)ret) < 0)
+			return -1;
+		off += (size_t)ret;
+	}
+	return 0;
+}
+
+/* In the same order as zerocopy_methods[] */
+static const stress_zerocopy_func_t zerocopy_funcs[] = {
+	stress_zerocopy_file_sock_copy,
+	stress_zerocopy_file_sock_sendfile,
+	stress_zerocopy_file_sock_splice,
+	stress_zerocopy_file_sock_uring_splice,
+	stress_zerocopy_file_file_copy,
+	stress_zerocopy_file_file_copy_file_range,
+	stress_zerocopy_file_file_sendfile,
+	stress_zerocopy_file_file_splice,
+	stress_zerocopy_mem_pipe_copy,
+	stress_zerocopy_mem_pipe_vmsplice,
+};
+
+#if defined(STRESS_ZEROCOPY_CYCLES)
+/*
+ *  stress_zerocopy_cycles_open()
+ *	count the user and kernel CPU cycles of this process,
+ *	returns -1 if there is no cycle counter
+ */
+static int stress_zerocopy_cycles_open(void)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/*
+ *  stress_zerocopy_cycles()
+ *	read the cycle counter, 0 if there is none
+ */
+static uint64_t stress_zerocopy_cycles(const int fd)
+{
+	uint64_t cycles = 0;
+
+	if ((fd < 0) || (read(fd, &cycles, sizeof(cycles)) != (ssize_t)sizeof(cycles)))
+		return 0;
+	return cycles;
+}
+
+/*
+ *  stress_zerocopy_cpu()
+ *	user and system CPU time of this process in seconds
+ */
+static double stress_zerocopy_cpu(void)
+{
+	struct rusage usage;
+
+	if (shim_getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_zerocopy_sock()
+ *	connect a loopback TCP socket and fork a child that drains
+ *	the receiving end, returns the sending end or -1 on error
+ */
+static int stress_zerocopy_sock(const stress_args_t *args, pid_t *pid)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int fd_listen, fd_send, fd_recv;
+
+	fd_listen = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd_listen < 0)
+		return -1;
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if ((bind(fd_listen, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+	    (listen(fd_listen, 1) < 0) ||
+	    (getsockname(fd_listen, (struct sockaddr *)&addr, &len) < 0))
+		goto close_listen;
+
+	fd_send = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd_send < 0)
+		goto close_listen;
+	if (connect(fd_send, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto close_send;
+	fd_recv = accept(fd_listen, NULL, NULL);
+	if (fd_recv < 0)
+		goto close_send;
+	(void)close(fd_listen);
+
+	*pid = fork();
+	if (*pid < 0) {
+		(void)close(fd_recv);
+		(void)close(fd_send);
+		return -1;
+	} else if (*pid == 0) {
+		static char buf[64 * KB];
+
+		stress_parent_died_alarm();
+		(void)sched_settings_apply(true);
+		(void)close(fd_send);
+		while (read(fd_recv, buf, sizeof(buf)) > 0)
+			;
+		_exit(0);
+	}
+	(void)close(fd_recv);
+	(void)args;
+	return fd_send;
+
+close_send:
+	(void)close(fd_send);
+close_listen:
+	(void)close(fd_listen);
+	return -1;
+}
+
+/*
+ *  stress_zerocopy_report()
+ *	report the throughput and CPU cost per byte of each method
+ */
+static void stress_zerocopy_report(
+	const stress_args_t *args,
+	const stress_zerocopy_t *zc,
+	const stress_zerocopy_stats_t *stats,
+	const bool have_cycles)
+{
+	struct utsname uts;
+	bool lock = false;
+	size_t i;
+	int idx = 0;
+
+	if (uname(&uts) < 0)
+		(void)shim_strlcpy(uts.release, "unknown", sizeof(uts.release));
+
+	pr_lock(&lock);
+	if (args->instance == 0) {
+		pr_inf_lock(&lock, "%s: kernel %s, %zu MB dataset, %zu KB per call:\n",
+			args->name, uts.release, zc->bytes / (size_t)MB, zc->chunk / (size_t)KB);
+		pr_inf_lock(&lock, "%s: %-26s %8s %12s %12s\n", args->name,
+			"method", "GB/sec", "CPU ns/byte", "cycles/byte");
+	}
+	for (i = 0; i < ZEROCOPY_METHODS; i++) {
+		const stress_zerocopy_stats_t *s = &stats[i];
+		const double gb_per_sec = (s->duration > 0.0) ?
+			((double)s->bytes / (double)GB) / s->duration : 0.0;
+		const double ns_per_byte = s->bytes ?
+			(s->cpu * 1.0E9) / (double)s->bytes : 0.0;
+		char desc[32], cycles[32];
+
+		if (s->unsupported) {
+			if (args->instance == 0)
+				pr_inf_lock(&lock, "%s: %-26s %8s\n", args->name,
+					zerocopy_methods[i], "n/a");
+			continue;
+		}
+		if (!s->transfers)
+			continue;
+
+		(void)snprintf(desc, sizeof(desc), "%s GB/s", zerocopy_methods[i]);
+		stress_misc_stats_set(args->misc_stats, idx++, desc, gb_per_sec);
+
+		if (args->instance != 0)
+			continue;
+		if (have_cycles)
+			(void)snprintf(cycles, sizeof(cycles), "%12.3f",
+				(double)s->cycles / (double)s->bytes);
+		else
+			(void)shim_strlcpy(cycles, "         n/a", sizeof(cycles));
+		pr_inf_lock(&lock, "%s: %-26s %8.3f %12.3f %s\n", args->name,
+			zerocopy_methods[i], gb_per_sec, ns_per_byte, cycles);
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_zerocopy()
+ *	move the same dataset file to socket, file to file and
+ *	memory to pipe with each of the copy and zero-copy mechanisms
+ */
+static int stress_zerocopy(const stress_args_t *args)
+{
+	stress_zerocopy_t zc;
+	stress_zerocopy_stats_t stats[ZEROCOPY_METHODS];
+	char src_name[PATH_MAX], dst_name[PATH_MAX];
+	size_t zerocopy_bytes = DEFAULT_ZEROCOPY_BYTES;
+	size_t zerocopy_chunk = DEFAULT_ZEROCOPY_CHUNK;
+	size_t i, method_idx = ZEROCOPY_METHODS - 1, off;
+	int zerocopy_method = ZEROCOPY_METHOD_ALL;
+	int rc = EXIT_FAILURE, ret, fd_cycles = -1, pipe_size;
+	pid_t pid = -1;
+
+	(void)stress_get_setting("zerocopy-method", &zerocopy_method);
+	if (!stress_get_setting("zerocopy-bytes", &zerocopy_bytes)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			zerocopy_bytes = MAX_ZEROCOPY_BYTES;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			zerocopy_bytes = MIN_ZEROCOPY_BYTES;
+	}
+	(void)stress_get_setting("zerocopy-chunk", &zerocopy_chunk);
+
+	(void)memset(&zc, 0, sizeof(zc));
+	(void)memset(stats, 0, sizeof(stats));
+	zc.args = args;
+	zc.fd_src = -1;
+	zc.fd_dst = -1;
+	zc.fd_sock = -1;
+	zc.fd_null = -1;
+	zc.fds[0] = -1;
+	zc.fds[1] = -1;
+	zc.bytes = zerocopy_bytes;
+#if defined(STRESS_ZEROCOPY_IO_URING)
+	zc.ring.fd = -1;
+#endif
+
+	if (pipe(zc.fds) < 0) {
+		pr_fail("%s: pipe failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	/* A chunk has to fit in the pipe */
+	(void)fcntl(zc.fds[1], F_SETPIPE_SZ, (int)zerocopy_chunk);
+	pipe_size = fcntl(zc.fds[1], F_GETPIPE_SZ);
+	if (pipe_size <= 0)
+		pipe_size = (int)args->page_size;
+	zc.chunk = STRESS_MINIMUM(zerocopy_chunk, (size_t)pipe_size);
+	if ((zc.chunk < zerocopy_chunk) && (args->instance == 0))
+		pr_inf("%s: pipe size limits the chunk to %zu bytes\n",
+			args->name, zc.chunk);
+
+	zc.fd_null = open("/dev/null", O_WRONLY);
+	if (zc.fd_null < 0) {
+		pr_fail("%s: open /dev/null failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto tidy;
+	}
+
+	zc.data = (uint8_t *)mmap(NULL, zc.bytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	zc.buf = (uint8_t *)mmap(NULL, zc.chunk, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if ((zc.data == MAP_FAILED) || (zc.buf == MAP_FAILED)) {
+		pr_inf_skip("%s: cannot mmap %zu byte dataset, skipping stressor\n",
+			args->name, zc.bytes);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	stress_mwc_fill(zc.data, zc.bytes);
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		rc = exit_status(-ret);
+		goto tidy;
+	}
+	(void)stress_temp_filename_args(args, src_name, sizeof(src_name), stress_mwc32());
+	(void)stress_temp_filename_args(args, dst_name, sizeof(dst_name), stress_mwc32());
+	zc.fd_src = open(src_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	zc.fd_dst = open(dst_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if ((zc.fd_src < 0) || (zc.fd_dst < 0)) {
+		rc = exit_status(errno);
+		pr_fail("%s: open failed, errno=%d (%s)\n",
+			args->name, errno, strerror(errno));
+		goto tidy_files;
+	}
+	(void)unlink(src_name);
+	(void)unlink(dst_name);
+	for (off = 0; off < zc.bytes; off += zc.chunk) {
+		if (stress_zerocopy_write_all(zc.fd_src, zc.data + off,
+				STRESS_MINIMUM(zc.chunk, zc.bytes - off)) < 0) {
+			if (errno == ENOSPC) {
+				pr_inf_skip("%s: no space for the %zu byte dataset, "
+					"skipping stressor\n", args->name, zc.bytes);
+				rc = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail("%s: write failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+			}
+			goto tidy_files;
+		}
+	}
+
+	zc.fd_sock = stress_zerocopy_sock(args, &pid);
+	if (zc.fd_sock < 0) {
+		pr_inf_skip("%s: cannot connect a loopback TCP socket, errno=%d (%s), "
+			"skipping stressor\n", args->name, errno, strerror(errno));
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_files;
+	}
+#if defined(STRESS_ZEROCOPY_IO_URING)
+	if (stress_zerocopy_uring_setup(&zc.ring, 4) < 0)
+		zc.ring.fd = -1;
+#endif
+#if defined(STRESS_ZEROCOPY_CYCLES)
+	fd_cycles = stress_zerocopy_cycles_open();
+#endif
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		stress_zerocopy_stats_t *s;
+		double t, cpu;
+		uint64_t cycles;
+
+		if (zerocopy_method == ZEROCOPY_METHOD_ALL) {
+			/* Cycle round the supported methods */
+			for (i = 0; i < ZEROCOPY_METHODS; i++) {
+				method_idx = (method_idx + 1) % ZEROCOPY_METHODS;
+				if (!stats[method_idx].unsupported)
+					break;
+			}
+			if (i >= ZEROCOPY_METHODS)
+				break;
+		} else {
+			method_idx = (size_t)zerocopy_method - 1;
+			if (stats[method_idx].unsupported)
+				break;
+		}
+		s = &stats[method_idx];
+
+		/* Start each file to file transfer on an empty file */
+		if (!strncmp(zerocopy_methods[method_idx], "file-file-", 10)) {
+			if ((ftruncate(zc.fd_dst, 0) < 0) ||
+			    (lseek(zc.fd_dst, 0, SEEK_SET) < 0)) {
+				pr_fail("%s: truncate failed, errno=%d (%s)\n",
+					args->name, errno, strerror(errno));
+				goto tidy_sock;
+			}
+		}
+
+		cycles = stress_zerocopy_cycles(fd_cycles);
+		cpu = stress_zerocopy_cpu();
+		t = stress_time_now();
+		ret = zerocopy_funcs[method_idx](&zc);
+		t = stress_time_now() - t;
+		cpu = stress_zerocopy_cpu() - cpu;
+		cycles = stress_zerocopy_cycles(fd_cycles) - cycles;
+
+		if (ret < 0) {
+			if ((errno == ENOSYS) || (errno == EINVAL) ||
+			    (errno == EOPNOTSUPP) || (errno == EXDEV)) {
+				if (args->instance == 0)
+					pr_dbg("%s: %s not supported, errno=%d (%s)\n",
+						args->name, zerocopy_methods[method_idx],
+						errno, strerror(errno));
+				s->unsupported = true;
+				continue;
+			}
+			if (errno == ENOSPC)
+				continue;
+			if (!keep_stressing(args))
+				break;
+			pr_fail("%s: %s failed, errno=%d (%s)\n",
+				args->name, zerocopy_methods[method_idx],
+				errno, strerror(errno));
+			goto tidy_sock;
+		}
+		s->transfers++;
+		s->bytes += zc.bytes;
+		s->duration += t;
+		s->cpu += cpu;
+		s->cycles += cycles;
+		inc_counter(args);
+	} while (keep_stressing(args));
+
+	rc = EXIT_SUCCESS;
+	stress_zerocopy_report(args, &zc, stats, fd_cycles >= 0);
+tidy_sock:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+	if (fd_cycles >= 0)
+		(void)close(fd_cycles);
+#if defined(STRESS_ZEROCOPY_IO_URING)
+	stress_zerocopy_uring_close(&zc.ring);
+#endif
+	/* The drain child exits when the connection closes */
+	(void)close(zc.fd_sock);
+	if (pid > 0) {
+		int status;
+
+		if (shim_waitpid(pid, &status, 0) < 0) {
+			(void)kill(pid, SIGKILL);
+			(void)shim_waitpid(pid, &status, 0);
+		}
+	}
+tidy_files:
+	if (zc.fd_dst >= 0)
+		(void)close(zc.fd_dst);
+	if (zc.fd_src >= 0)
+		(void)close(zc.fd_src);
+	(void)stress_temp_dir_rm_args(args);
+tidy:
+	if (zc.buf && (zc.buf != MAP_FAILED))
+		(void)munmap((void *)zc.buf, zc.chunk);
+	if (zc.data && (zc.data != MAP_FAILED))
+		(void)munmap((void *)zc.data, zc.bytes);
+	if (zc.fd_null >= 0)
+		(void)close(zc.fd_null);
+	(void)close(zc.fds[0]);
+	(void)close(zc.fds[1]);
+
+	return rc;
+}
+
+stressor_info_t stress_zerocopy_info = {
+	.stressor = stress_zerocopy,
+	.class = CLASS_PIPE_IO | CLASS_FILESYSTEM | CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_zerocopy_info = {
+	.stressor = stress_not_implemented,
+	.class = CLASS_PIPE_IO | CLASS_FILESYSTEM | CLASS_NETWORK | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
@@ -32,6 +32,7 @@ static const stress_help_t help[] = {
 	{ NULL,	"zlib-ops N",		"stop after N zlib bogo compression operations" },
 	{ NULL,	"zlib-strategy S",	"specify zlib strategy 0=default, 1=filtered, 2=huffman only, 3=rle, 4=fixed" },
 	{ NULL,	"zlib-stream-bytes S",	"specify the number of bytes to deflate until the current stream will be closed" },
+	{ NULL,	"zlib-threads N",	"deflate and inflate independent chunks with N threads each" },
 	{ NULL,	"zlib-window-bits W",	"specify zlib window bits -8-(-15) | 8-15 | 24-31 | 40-47" },
 	{ NULL,	NULL,			NULL }
 };
@@ -251,13 +252,9 @@ static void stress_rand_data_binary(
 	uint8_t *data,
 	const size_t size)
 {
-	register uint32_t *ptr = (uint32_t*)data;
-	register uint32_t *end = (uint32_t*)(data + size);
-
 	(void)args;
 
-	while (ptr < end)
-		*(ptr++) = stress_mwc32();
+	stress_mwc_fill(data, size);
 }
 
 /*
@@ -1049,6 +1046,20 @@ static int stress_set_zlib_strategy(const char *opt)
 	return stress_set_setting("zlib-strategy", TYPE_ID_UINT32, &zlib_strategy);
 }
 
+/*
+ *  stress_set_zlib_threads
+ *	set the number of deflate and inflate threads of the
+ *	pipelined mode, 0 uses the deflate/inflate pipe
+ */
+static int stress_set_zlib_threads(const char *opt)
+{
+	uint32_t zlib_threads;
+
+	zlib_threads = stress_get_uint32(opt);
+	stress_check_range("zlib-threads", zlib_threads, 0, MAX_ZLIB_THREADS);
+	return stress_set_setting("zlib-threads", TYPE_ID_UINT32, &zlib_threads);
+}
+
 static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_zlib_level,		stress_set_zlib_level },
 	{ OPT_zlib_mem_level,		stress_set_zlib_mem_level },
@@ -1056,6 +1067,7 @@ static const stress_opt_set_func_t opt_set_funcs[] = {
 	{ OPT_zlib_window_bits,		stress_set_zlib_window_bits },
 	{ OPT_zlib_stream_bytes,	stress_set_zlib_stream_bytes },
 	{ OPT_zlib_strategy,		stress_set_zlib_strategy },
+	{ OPT_zlib_threads,		stress_set_zlib_threads },
 	{ 0,				NULL }
 };
 
@@ -1442,6 +1454,325 @@ xsum_error:
 	return ret;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+
+#define ZLIB_PIPE_CHUNK		(DATA_SIZE_128K)	/* bytes per independent chunk */
+#define ZLIB_PIPE_FREE		(0)	/* slot can be filled */
+#define ZLIB_PIPE_BUSY		(1)	/* slot is being filled or inflated */
+#define ZLIB_PIPE_DEFLATED	(2)	/* slot holds a deflated chunk */
+
+/* A ring slot, inflaters read the deflated data in place */
+typedef struct {
+	int		state;		/* ZLIB_PIPE_* */
+	size_t		def_size;	/* deflated size of the chunk */
+	uint8_t		*in;		/* ZLIB_PIPE_CHUNK of generated data */
+	uint8_t		*out;		/* deflated data */
+} stress_zlib_slot_t;
+
+typedef struct {
+	const stress_args_t *args;
+	stress_zlib_args_t zlib_args;
+	stress_zlib_rand_data_info_t *info;
+	pthread_mutex_t	lock;		/* protects the slot states and counters */
+	pthread_cond_t	cond;		/* signalled on every slot state change */
+	stress_zlib_slot_t *slots;
+	size_t		nslots;
+	size_t		out_size;	/* size of each deflated data buffer */
+	uint64_t	bytes_in;	/* bytes deflated */
+	uint64_t	bytes_out;	/* deflated bytes produced */
+	uint64_t	bytes_inflated;	/* bytes inflated and checked */
+	bool		stop;
+	bool		error;
+} stress_zlib_pipeline_t;
+
+/*
+ *  stress_zlib_pipe_get()
+ *	wait for a slot in state from and mark it busy, returns
+ *	NULL when the pipeline is stopping
+ */
+static stress_zlib_slot_t *stress_zlib_pipe_get(
+	stress_zlib_pipeline_t *pipeline,
+	const int from)
+{
+	stress_zlib_slot_t *slot = NULL;
+
+	(void)pthread_mutex_lock(&pipeline->lock);
+	while (!pipeline->stop) {
+		size_t i;
+
+		for (i = 0; i < pipeline->nslots; i++) {
+			if (pipeline->slots[i].state == from) {
+				slot = &pipeline->slots[i];
+				slot->state = ZLIB_PIPE_BUSY;
+				break;
+			}
+		}
+		if (slot)
+			break;
+		(void)pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+	}
+	(void)pthread_mutex_unlock(&pipeline->lock);
+	return slot;
+}
+
+/*
+ *  stress_zlib_pipe_put()
+ *	hand a slot on in state to, accounting for the bytes processed
+ */
+static void stress_zlib_pipe_put(
+	stress_zlib_pipeline_t *pipeline,
+	stress_zlib_slot_t *slot,
+	const int to)
+{
+	(void)pthread_mutex_lock(&pipeline->lock);
+	slot->state = to;
+	if (to == ZLIB_PIPE_DEFLATED) {
+		pipeline->bytes_in += ZLIB_PIPE_CHUNK;
+		pipeline->bytes_out += slot->def_size;
+		inc_counter(pipeline->args);
+	} else {
+		pipeline->bytes_inflated += ZLIB_PIPE_CHUNK;
+	}
+	(void)pthread_cond_broadcast(&pipeline->cond);
+	(void)pthread_mutex_unlock(&pipeline->lock);
+}
+
+/*
+ *  stress_zlib_pipe_error()
+ *	flag a pipeline error and stop all the threads
+ */
+static void stress_zlib_pipe_error(stress_zlib_pipeline_t *pipeline)
+{
+	(void)pthread_mutex_lock(&pipeline->lock);
+	pipeline->error = true;
+	pipeline->stop = true;
+	(void)pthread_cond_broadcast(&pipeline->cond);
+	(void)pthread_mutex_unlock(&pipeline->lock);
+}
+
+/*
+ *  stress_zlib_pipe_deflater()
+ *	generate and deflate chunks into free slots, each chunk is
+ *	an independent stream so many threads can deflate at once
+ */
+static void *stress_zlib_pipe_deflater(void *arg)
+{
+	stress_zlib_pipeline_t *pipeline = (stress_zlib_pipeline_t *)arg;
+	const stress_args_t *args = pipeline->args;
+	stress_zlib_args_t *zlib_args = &pipeline->zlib_args;
+	int32_t window_bits = zlib_args->window_bits;
+	stress_zlib_slot_t *slot;
+	z_stream stream_def;
+	int ret;
+
+	/* default to zlib format if inflate auto detect has been used */
+	if (window_bits > 31)
+		window_bits -= 32;
+
+	(void)memset(&stream_def, 0, sizeof(stream_def));
+	ret = deflateInit2(&stream_def, zlib_args->level, Z_DEFLATED,
+		window_bits, zlib_args->mem_level, zlib_args->strategy);
+	if (ret != Z_OK) {
+		pr_fail("%s: zlib deflateInit error: %s\n",
+			args->name, stress_zlib_err(ret));
+		stress_zlib_pipe_error(pipeline);
+		return NULL;
+	}
+
+	while ((slot = stress_zlib_pipe_get(pipeline, ZLIB_PIPE_FREE)) != NULL) {
+		pipeline->info->func(args, slot->in, ZLIB_PIPE_CHUNK);
+
+		(void)deflateReset(&stream_def);
+		stream_def.next_in = slot->in;
+		stream_def.avail_in = ZLIB_PIPE_CHUNK;
+		stream_def.next_out = slot->out;
+		stream_def.avail_out = (uInt)pipeline->out_size;
+		ret = deflate(&stream_def, Z_FINISH);
+		if (ret != Z_STREAM_END) {
+			pr_fail("%s: zlib deflate error: %s\n",
+				args->name, stress_zlib_err(ret));
+			stress_zlib_pipe_error(pipeline);
+			break;
+		}
+		slot->def_size = pipeline->out_size - stream_def.avail_out;
+		stress_zlib_pipe_put(pipeline, slot, ZLIB_PIPE_DEFLATED);
+	}
+	(void)deflateEnd(&stream_def);
+	return NULL;
+}
+
+/*
+ *  stress_zlib_pipe_inflater()
+ *	inflate deflated slots and check the result against the
+ *	generated data still in the slot
+ */
+static void *stress_zlib_pipe_inflater(void *arg)
+{
+	stress_zlib_pipeline_t *pipeline = (stress_zlib_pipeline_t *)arg;
+	const stress_args_t *args = pipeline->args;
+	stress_zlib_slot_t *slot;
+	z_stream stream_inf;
+	uint8_t *data;
+	int ret;
+
+	data = malloc(ZLIB_PIPE_CHUNK);
+	if (!data) {
+		pr_inf("%s: cannot allocate inflate buffer\n", args->name);
+		stress_zlib_pipe_error(pipeline);
+		return NULL;
+	}
+	(void)memset(&stream_inf, 0, sizeof(stream_inf));
+	ret = inflateInit2(&stream_inf, pipeline->zlib_args.window_bits);
+	if (ret != Z_OK) {
+		pr_fail("%s: zlib inflateInit error: %s\n",
+			args->name, stress_zlib_err(ret));
+		stress_zlib_pipe_error(pipeline);
+		free(data);
+		return NULL;
+	}
+
+	while ((slot = stress_zlib_pipe_get(pipeline, ZLIB_PIPE_DEFLATED)) != NULL) {
+		(void)inflateReset(&stream_inf);
+		stream_inf.next_in = slot->out;
+		stream_inf.avail_in = (uInt)slot->def_size;
+		stream_inf.next_out = data;
+		stream_inf.avail_out = ZLIB_PIPE_CHUNK;
+		ret = inflate(&stream_inf, Z_FINISH);
+		if ((ret != Z_STREAM_END) || stream_inf.avail_out) {
+			pr_fail("%s: zlib inflate error: %s, %u bytes short\n",
+				args->name, stress_zlib_err(ret), stream_inf.avail_out);
+			stress_zlib_pipe_error(pipeline);
+			break;
+		}
+		if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+		    memcmp(data, slot->in, ZLIB_PIPE_CHUNK)) {
+			pr_fail("%s: inflated data does not match the deflated data\n",
+				args->name);
+			stress_zlib_pipe_error(pipeline);
+			break;
+		}
+		stress_zlib_pipe_put(pipeline, slot, ZLIB_PIPE_FREE);
+	}
+	(void)inflateEnd(&stream_inf);
+	free(data);
+	return NULL;
+}
+
+/*
+ *  stress_zlib_pipeline()
+ *	deflate and inflate independent chunks with threads threads
+ *	each, chunks are handed over in a shared ring of slots rather
+ *	than copied through a pipe
+ */
+static int stress_zlib_pipeline(const stress_args_t *args, const uint32_t threads)
+{
+	stress_zlib_pipeline_t pipeline;
+	pthread_t *pthreads;
+	bool *started;
+	uint8_t *buf;
+	size_t i, buf_size, slot_size;
+	double t1, t2;
+	int ret = EXIT_SUCCESS;
+
+	(void)memset(&pipeline, 0, sizeof(pipeline));
+	pipeline.args = args;
+	stress_zlib_get_args(&pipeline.zlib_args);
+	pipeline.info = (stress_zlib_rand_data_info_t *)pipeline.zlib_args.data_func;
+	/* Room for a stored (incompressible) chunk plus a gzip wrapper */
+	pipeline.out_size = compressBound(ZLIB_PIPE_CHUNK) + 64;
+	pipeline.nslots = (size_t)threads * 2;
+
+	slot_size = ZLIB_PIPE_CHUNK + pipeline.out_size;
+	buf_size = pipeline.nslots * slot_size;
+	buf = (uint8_t *)mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf("%s: cannot mmap %zu byte ring, skipping stressor\n",
+			args->name, buf_size);
+		return EXIT_NO_RESOURCE;
+	}
+	pipeline.slots = calloc(pipeline.nslots, sizeof(*pipeline.slots));
+	pthreads = calloc((size_t)threads * 2, sizeof(*pthreads));
+	started = calloc((size_t)threads * 2, sizeof(*started));
+	if (!pipeline.slots || !pthreads || !started) {
+		pr_inf("%s: cannot allocate %" PRIu32 " threads, skipping stressor\n",
+			args->name, threads);
+		ret = EXIT_NO_RESOURCE;
+		goto free_all;
+	}
+	for (i = 0; i < pipeline.nslots; i++) {
+		pipeline.slots[i].state = ZLIB_PIPE_FREE;
+		pipeline.slots[i].in = buf + (i * slot_size);
+		pipeline.slots[i].out = pipeline.slots[i].in + ZLIB_PIPE_CHUNK;
+	}
+	(void)pthread_mutex_init(&pipeline.lock, NULL);
+	(void)pthread_cond_init(&pipeline.cond, NULL);
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	t1 = stress_time_now();
+	for (i = 0; i < (size_t)threads * 2; i++) {
+		started[i] = (pthread_create(&pthreads[i], NULL,
+			(i & 1) ? stress_zlib_pipe_inflater : stress_zlib_pipe_deflater,
+			&pipeline) == 0);
+		if (!started[i]) {
+			pr_inf("%s: pthread_create failed, errno=%d (%s)\n",
+				args->name, errno, strerror(errno));
+			stress_zlib_pipe_error(&pipeline);
+			break;
+		}
+	}
+
+	while (keep_stressing(args)) {
+		bool stop;
+
+		(void)pthread_mutex_lock(&pipeline.lock);
+		stop = pipeline.stop;
+		(void)pthread_mutex_unlock(&pipeline.lock);
+		if (stop)
+			break;
+		(void)shim_usleep(100000);
+	}
+	(void)pthread_mutex_lock(&pipeline.lock);
+	pipeline.stop = true;
+	(void)pthread_cond_broadcast(&pipeline.cond);
+	(void)pthread_mutex_unlock(&pipeline.lock);
+
+	for (i = 0; i < (size_t)threads * 2; i++) {
+		if (started[i])
+			(void)pthread_join(pthreads[i], NULL);
+	}
+	t2 = stress_time_now();
+
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if (pipeline.error) {
+		ret = EXIT_FAILURE;
+	} else if (t2 > t1) {
+		const double deflate_rate = ((double)pipeline.bytes_in / (t2 - t1)) / MB;
+		const double inflate_rate = ((double)pipeline.bytes_inflated / (t2 - t1)) / MB;
+
+		pr_inf("%s: instance %" PRIu32 ": compression ratio: %5.2f%%, "
+			"deflate %.2f MB/sec, inflate %.2f MB/sec (%" PRIu32
+			" threads each)\n", args->name, args->instance,
+			pipeline.bytes_in ? 100.0 * (double)pipeline.bytes_out /
+				(double)pipeline.bytes_in : 0.0,
+			deflate_rate, inflate_rate, threads);
+		stress_misc_stats_set(args->misc_stats, 0, "deflate MB per sec", deflate_rate);
+		stress_misc_stats_set(args->misc_stats, 1, "inflate MB per sec", inflate_rate);
+	}
+	(void)pthread_cond_destroy(&pipeline.cond);
+	(void)pthread_mutex_destroy(&pipeline.lock);
+free_all:
+	free(started);
+	free(pthreads);
+	free(pipeline.slots);
+	(void)munmap((void *)buf, buf_size);
+
+	return ret;
+}
+#endif
+
 /*
  *  stress_zlib()
  *	stress cpu with compression and decompression
@@ -1457,6 +1788,18 @@ static int stress_zlib(const stress_args_t *args)
 	bool bad_xsum_reads = false;
 	bool error = false;
 	bool interrupted = false;
+	uint32_t zlib_threads = 0;
+
+	(void)stress_get_setting("zlib-threads", &zlib_threads);
+	if (zlib_threads > 0) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_zlib_pipeline(args, zlib_threads);
+#else
+		if (args->instance == 0)
+			pr_inf("%s: --zlib-threads needs pthread support, "
+				"using the deflate/inflate pipe\n", args->name);
+#endif
+	}
 
 	(void)memset(&deflate_xsum, 0, sizeof(deflate_xsum));
 	(void)memset(&inflate_xsum, 0, sizeof(inflate_xsum));
@@ -1609,6 +1952,47 @@ static void stress_zlib_set_default(void)
 	stress_set_zlib_strategy(value);
 }
 
+/*
+ *  stress_zlib_rand_data_index()
+ *	index of a named zlib random data method, -1 if there is no
+ *	such method; lets other stressors generate data of the same
+ *	compressibility as the zlib stressor
+ */
+int stress_zlib_rand_data_index(const char *name)
+{
+	size_t i;
+
+	for (i = 0; zlib_rand_data_methods[i].name; i++) {
+		if (!strcmp(zlib_rand_data_methods[i].name, name))
+			return (int)i;
+	}
+	return -1;
+}
+
+/*
+ *  stress_zlib_rand_data_name()
+ *	name of the index'th zlib random data method, NULL at the end
+ */
+const char *stress_zlib_rand_data_name(const size_t index)
+{
+	if (index >= SIZEOF_ARRAY(zlib_rand_data_methods))
+		return NULL;
+	return zlib_rand_data_methods[index].name;
+}
+
+/*
+ *  stress_zlib_rand_data()
+ *	fill data using the index'th zlib random data method
+ */
+void stress_zlib_rand_data(
+	const stress_args_t *args,
+	const size_t index,
+	uint8_t *data,
+	const size_t size)
+{
+	zlib_rand_data_methods[index].func(args, data, size);
+}
+
 stressor_info_t stress_zlib_info = {
 	.stressor = stress_zlib,
 	.set_default = stress_zlib_set_default,
@@ -1617,6 +2001,55 @@ stressor_info_t stress_zlib_info = {
 	.help = help
 };
 #else
+/*
+ *  Without zlib just the binary, text and zero data methods are
+ *  available to other stressors
+ */
+static const char * const zlib_rand_data_names[] = {
+	"binary",
+	"text",
+	"zero",
+};
+
+int stress_zlib_rand_data_index(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(zlib_rand_data_names); i++) {
+		if (!strcmp(zlib_rand_data_names[i], name))
+			return (int)i;
+	}
+	return -1;
+}
+
+const char *stress_zlib_rand_data_name(const size_t index)
+{
+	if (index >= SIZEOF_ARRAY(zlib_rand_data_names))
+		return NULL;
+	return zlib_rand_data_names[index];
+}
+
+void stress_zlib_rand_data(
+	const stress_args_t *args,
+	const size_t index,
+	uint8_t *data,
+	const size_t size)
+{
+	(void)args;
+
+	switch (index) {
+	case 0:
+		stress_mwc_fill(data, size);
+		break;
+	case 1:
+		stress_strnrnd((char *)data, size);
+		break;
+	default:
+		(void)memset((void *)data, 0, size);
+		break;
+	}
+}
+
 stressor_info_t stress_zlib_info = {
 	.stressor = stress_not_implemented,
 	.class = CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY,
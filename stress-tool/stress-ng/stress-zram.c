@@ -0,0 +1,483 @@
+/*
+ * Copyright (C) 2022 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#include "stress-ng.h"
+
+static const stress_help_t help[] = {
+	{ NULL,	"zram N",		"start N workers measuring zram compressor throughput" },
+	{ NULL,	"zram-ops N",		"stop after N compressor and data measurements" },
+	{ NULL,	"zram-algos list",	"comma separated zram compressors, default all available" },
+	{ NULL,	"zram-data list",	"comma separated zlib data methods to compress" },
+	{ NULL,	"zram-size N",		"bytes written to the zram device per measurement" },
+	{ NULL,	NULL,			NULL }
+};
+
+#define MIN_ZRAM_SIZE		(1 * MB)
+#define MAX_ZRAM_SIZE		(MAX_MEM_LIMIT)
+#define DEFAULT_ZRAM_SIZE	(64 * MB)
+#define DEFAULT_ZRAM_DATA	"text,objcode,binary"
+
+#define ZRAM_MAX_LIST		(8)
+#define ZRAM_MAX_NAME		(32)
+#define ZRAM_CHUNK		(64 * KB)	/* data generation unit, as the zlib stressor */
+#define ZRAM_IO_SIZE		(1 * MB)
+#define ZRAM_CONTROL		"/sys/class/zram-control"
+
+typedef struct {
+	char algo[ZRAM_MAX_NAME];
+	int data;			/* zlib random data method index */
+	double bytes;			/* bytes written and read back */
+	double write_time;		/* wall clock seconds compressing */
+	double read_time;		/* wall clock seconds decompressing */
+	double write_cpu;		/* CPU seconds compressing */
+	double read_cpu;		/* CPU seconds decompressing */
+	double orig;			/* mm_stat orig_data_size */
+	double compr;			/* mm_stat compr_data_size */
+	double mem_used;		/* mm_stat mem_used_total */
+	bool unsupported;
+} stress_zram_point_t;
+
+/*
+ *  stress_zram_list()
+ *	split a comma separated list into names, returns the count or -1
+ */
+static int stress_zram_list(const char *option, const char *opt,
+	char names[ZRAM_MAX_LIST][ZRAM_MAX_NAME])
+{
+	char *str, *token, *save = NULL;
+	int n = 0;
+
+	str = stress_const_optdup(opt);
+	if (!str)
+		return -1;
+	for (token = strtok_r(str, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		if (n >= ZRAM_MAX_LIST) {
+			(void)fprintf(stderr, "%s has more than %d names\n", option, ZRAM_MAX_LIST);
+			free(str);
+			return -1;
+		}
+		(void)shim_strlcpy(names[n++], token, ZRAM_MAX_NAME);
+	}
+	free(str);
+	if (!n) {
+		(void)fprintf(stderr, "%s needs at least one name\n", option);
+		return -1;
+	}
+	return n;
+}
+
+static int stress_set_zram_algos(const char *opt)
+{
+	char names[ZRAM_MAX_LIST][ZRAM_MAX_NAME];
+
+	if (stress_zram_list("zram-algos", opt, names) < 0)
+		return -1;
+	return stress_set_setting("zram-algos", TYPE_ID_STR, opt);
+}
+
+static int stress_set_zram_data(const char *opt)
+{
+	char names[ZRAM_MAX_LIST][ZRAM_MAX_NAME];
+	int i, n;
+
+	n = stress_zram_list("zram-data", opt, names);
+	if (n < 0)
+		return -1;
+	for (i = 0; i < n; i++) {
+		if (stress_zlib_rand_data_index(names[i]) < 0) {
+			size_t j;
+			const char *name;
+
+			(void)fprintf(stderr, "zram-data '%s' is not one of:", names[i]);
+			for (j = 0; (name = stress_zlib_rand_data_name(j)) != NULL; j++)
+				(void)fprintf(stderr, " %s", name);
+			(void)fprintf(stderr, "\n");
+			return -1;
+		}
+	}
+	return stress_set_setting("zram-data", TYPE_ID_STR, opt);
+}
+
+static int stress_set_zram_size(const char *opt)
+{
+	size_t zram_size;
+
+	zram_size = (size_t)stress_get_uint64_byte_memory(opt, 1);
+	stress_check_range_bytes("zram-size", zram_size, MIN_ZRAM_SIZE, MAX_ZRAM_SIZE);
+	return stress_set_setting("zram-size", TYPE_ID_SIZE_T, &zram_size);
+}
+
+static const stress_opt_set_func_t opt_set_funcs[] = {
+	{ OPT_zram_algos,	stress_set_zram_algos },
+	{ OPT_zram_data,	stress_set_zram_data },
+	{ OPT_zram_size,	stress_set_zram_size },
+	{ 0,			NULL }
+};
+
+/*
+ *  stress_zram_supported()
+ *      check if we can run this as root
+ */
+static int stress_zram_supported(const char *name)
+{
+	if (!stress_check_capability(SHIM_CAP_SYS_ADMIN)) {
+		pr_inf_skip("%s stressor will be skipped, "
+			"need to be running with CAP_SYS_ADMIN "
+			"rights for this stressor\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+#if defined(__linux__) &&	\
+    defined(O_DIRECT)
+
+/*
+ *  stress_zram_attr_write()
+ *	write a string to a zram device sysfs attribute
+ */
+static int stress_zram_attr_write(const int id, const char *attr, const char *str)
+{
+	char path[PATH_MAX];
+	ssize_t ret;
+
+	(void)snprintf(path, sizeof(path), "/sys/block/zram%d/%s", id, attr);
+	ret = system_write(path, str, strlen(str));
+	return (ret < 0) ? (int)ret : 0;
+}
+
+/*
+ *  stress_zram_attr_read()
+ *	read a zram device sysfs attribute
+ */
+static ssize_t stress_zram_attr_read(const int id, const char *attr, char *buf, const size_t len)
+{
+	char path[PATH_MAX];
+
+	(void)snprintf(path, sizeof(path), "/sys/block/zram%d/%s", id, attr);
+	return system_read(path, buf, len);
+}
+
+/*
+ *  stress_zram_hot_add()
+ *	add a new zram device, returns its number or -1
+ */
+static int stress_zram_hot_add(void)
+{
+	char buf[32];
+
+	if (system_read(ZRAM_CONTROL "/hot_add", buf, sizeof(buf)) <= 0)
+		return -1;
+	return atoi(buf);
+}
+
+/*
+ *  stress_zram_hot_remove()
+ *	reset and remove a zram device
+ */
+static void stress_zram_hot_remove(const int id)
+{
+	char buf[32];
+
+	(void)stress_zram_attr_write(id, "reset", "1");
+	(void)snprintf(buf, sizeof(buf), "%d", id);
+	(void)system_write(ZRAM_CONTROL "/hot_remove", buf, strlen(buf));
+}
+
+/*
+ *  stress_zram_cpu()
+ *	CPU seconds used by this process, zram compresses and
+ *	decompresses in the context of the task doing the I/O
+ */
+static double stress_zram_cpu(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_zram_measure()
+ *	set up the device with a compressor, write the data through it
+ *	with direct I/O and read it back; returns -1 if the compressor
+ *	cannot be used, -2 for other failures
+ */
+static int stress_zram_measure(
+	const stress_args_t *args,
+	const int id,
+	stress_zram_point_t *pt,
+	uint8_t *wbuf,
+	uint8_t *rbuf,
+	const size_t size)
+{
+	char path[PATH_MAX], buf[256];
+	uint64_t orig = 0, compr = 0, mem_used = 0;
+	double t, cpu;
+	size_t off;
+	int fd, ret;
+
+	(void)stress_zram_attr_write(id, "reset", "1");
+	ret = stress_zram_attr_write(id, "comp_algorithm", pt->algo);
+	if (ret < 0) {
+		pr_inf("%s: cannot use zram compressor %s, errno=%d (%s)\n",
+			args->name, pt->algo, -ret, strerror(-ret));
+		return -1;
+	}
+	(void)snprintf(buf, sizeof(buf), "%zu", size);
+	ret = stress_zram_attr_write(id, "disksize", buf);
+	if (ret < 0) {
+		pr_inf("%s: cannot set zram%d disksize to %zu bytes, errno=%d (%s)\n",
+			args->name, id, size, -ret, strerror(-ret));
+		return -2;
+	}
+	(void)snprintf(path, sizeof(path), "/dev/zram%d", id);
+	fd = open(path, O_RDWR | O_DIRECT);
+	if (fd < 0) {
+		pr_inf("%s: cannot open %s, errno=%d (%s)\n",
+			args->name, path, errno, strerror(errno));
+		return -2;
+	}
+
+	for (off = 0; off < size; off += ZRAM_CHUNK)
+		stress_zlib_rand_data(args, (size_t)pt->data, wbuf + off, ZRAM_CHUNK);
+
+	cpu = stress_zram_cpu();
+	t = stress_time_now();
+	for (off = 0; off < size; off += ZRAM_IO_SIZE) {
+		if (pwrite(fd, wbuf + off, ZRAM_IO_SIZE, (off_t)off) != (ssize_t)ZRAM_IO_SIZE) {
+			pr_fail("%s: write to %s failed, errno=%d (%s)\n",
+				args->name, path, errno, strerror(errno));
+			(void)close(fd);
+			return -2;
+		}
+	}
+	pt->write_time += stress_time_now() - t;
+	pt->write_cpu += stress_zram_cpu() - cpu;
+
+	if (stress_zram_attr_read(id, "mm_stat", buf, sizeof(buf)) > 0) {
+		if (sscanf(buf, "%" SCNu64 " %" SCNu64 " %" SCNu64, &orig, &compr, &mem_used) != 3)
+			orig = compr = mem_used = 0;
+	}
+
+	cpu = stress_zram_cpu();
+	t = stress_time_now();
+	for (off = 0; off < size; off += ZRAM_IO_SIZE) {
+		if (pread(fd, rbuf + off, ZRAM_IO_SIZE, (off_t)off) != (ssize_t)ZRAM_IO_SIZE) {
+			pr_fail("%s: read from %s failed, errno=%d (%s)\n",
+				args->name, path, errno, strerror(errno));
+			(void)close(fd);
+			return -2;
+		}
+	}
+	pt->read_time += stress_time_now() - t;
+	pt->read_cpu += stress_zram_cpu() - cpu;
+	(void)close(fd);
+
+	if (memcmp(wbuf, rbuf, size)) {
+		pr_fail("%s: data read back from zram with %s compression differs "
+			"from the data written\n", args->name, pt->algo);
+		return -2;
+	}
+	pt->bytes += (double)size;
+	pt->orig += (double)orig;
+	pt->compr += (double)compr;
+	pt->mem_used += (double)mem_used;
+	return 0;
+}
+
+/*
+ *  stress_zram_report()
+ *	compress and decompress rates, ratios and CPU cost per point
+ */
+static void stress_zram_report(const stress_args_t *args,
+	const stress_zram_point_t *pts, const int n_pts, const size_t size)
+{
+	bool lock = false;
+	int i, idx = 0;
+	char str[32];
+
+	stress_uint64_to_str(str, sizeof(str), (uint64_t)size);
+	pr_lock(&lock);
+	pr_inf_lock(&lock, "%s: %sB per measurement, direct I/O, CPU cost in seconds per GB\n",
+		args->name, str);
+	pr_inf_lock(&lock, "%s: %-9s %-12s %8s %8s %7s %7s %7s %7s\n", args->name,
+		"algorithm", "data", "comp", "decomp", "ratio", "mem", "comp", "decomp");
+	pr_inf_lock(&lock, "%s: %-9s %-12s %8s %8s %7s %7s %7s %7s\n", args->name,
+		"", "", "GB/s", "GB/s", "", "ratio", "CPU", "CPU");
+	for (i = 0; i < n_pts; i++) {
+		const stress_zram_point_t *pt = &pts[i];
+		const char *data = stress_zlib_rand_data_name((size_t)pt->data);
+		double gb, comp, decomp;
+
+		if (pt->unsupported || (pt->bytes <= 0.0)) {
+			pr_inf_lock(&lock, "%s: %-9s %-12s %8s %8s %7s %7s %7s %7s\n", args->name,
+				pt->algo, data, "n/a", "n/a", "n/a", "n/a", "n/a", "n/a");
+			continue;
+		}
+		gb = pt->bytes / (double)GB;
+		comp = (pt->write_time > 0.0) ? gb / pt->write_time : 0.0;
+		decomp = (pt->read_time > 0.0) ? gb / pt->read_time : 0.0;
+		pr_inf_lock(&lock, "%s: %-9s %-12s %8.3f %8.3f %7.2f %7.2f %7.3f %7.3f\n", args->name,
+			pt->algo, data, comp, decomp,
+			(pt->compr > 0.0) ? pt->orig / pt->compr : 0.0,
+			(pt->mem_used > 0.0) ? pt->orig / pt->mem_used : 0.0,
+			pt->write_cpu / gb, pt->read_cpu / gb);
+		if (idx < 8) {
+			char desc[80];
+
+			(void)snprintf(desc, sizeof(desc), "%.31s %.24s compress GB/s", pt->algo, data);
+			stress_misc_stats_set(args->misc_stats, idx++, desc, comp);
+			(void)snprintf(desc, sizeof(desc), "%.31s %.24s ratio", pt->algo, data);
+			stress_misc_stats_set(args->misc_stats, idx++, desc,
+				(pt->compr > 0.0) ? pt->orig / pt->compr : 0.0);
+		}
+	}
+	pr_unlock(&lock);
+}
+
+/*
+ *  stress_zram()
+ *	measure zram compressor throughput, ratio and CPU cost for
+ *	each compressor and kind of data
+ */
+static int stress_zram(const stress_args_t *args)
+{
+	char algos[ZRAM_MAX_LIST][ZRAM_MAX_NAME], datas[ZRAM_MAX_LIST][ZRAM_MAX_NAME];
+	stress_zram_point_t pts[ZRAM_MAX_LIST * ZRAM_MAX_LIST];
+	size_t zram_size = DEFAULT_ZRAM_SIZE;
+	char *algos_opt = NULL, *data_opt = NULL;
+	uint8_t *wbuf, *rbuf;
+	int id, n_algos = 0, n_datas, n_pts = 0, i, j, rc = EXIT_SUCCESS;
+
+	(void)stress_get_setting("zram-algos", &algos_opt);
+	(void)stress_get_setting("zram-data", &data_opt);
+	(void)stress_get_setting("zram-size", &zram_size);
+	zram_size = (zram_size + ZRAM_IO_SIZE - 1) & ~(size_t)(ZRAM_IO_SIZE - 1);
+
+	id = stress_zram_hot_add();
+	if (id < 0) {
+		pr_inf_skip("%s: cannot add a zram device with %s/hot_add, "
+			"skipping stressor\n", args->name, ZRAM_CONTROL);
+		return EXIT_NO_RESOURCE;
+	}
+
+	if (algos_opt) {
+		n_algos = stress_zram_list("zram-algos", algos_opt, algos);
+	} else {
+		char buf[256], *token, *save = NULL;
+
+		/* comp_algorithm lists them all with the current one in [] */
+		if (stress_zram_attr_read(id, "comp_algorithm", buf, sizeof(buf)) > 0) {
+			for (token = strtok_r(buf, " []\n", &save); token && (n_algos < ZRAM_MAX_LIST);
+			     token = strtok_r(NULL, " []\n", &save))
+				(void)shim_strlcpy(algos[n_algos++], token, ZRAM_MAX_NAME);
+		}
+	}
+	n_datas = stress_zram_list("zram-data", data_opt ? data_opt : DEFAULT_ZRAM_DATA, datas);
+	if ((n_algos <= 0) || (n_datas <= 0)) {
+		pr_inf_skip("%s: no zram compressors or data methods, skipping stressor\n",
+			args->name);
+		stress_zram_hot_remove(id);
+		return EXIT_NO_RESOURCE;
+	}
+
+	(void)memset(pts, 0, sizeof(pts));
+	for (i = 0; i < n_algos; i++) {
+		for (j = 0; j < n_datas; j++) {
+			(void)shim_strlcpy(pts[n_pts].algo, algos[i], ZRAM_MAX_NAME);
+			pts[n_pts++].data = stress_zlib_rand_data_index(datas[j]);
+		}
+	}
+
+	wbuf = (uint8_t *)mmap(NULL, zram_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (wbuf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte write buffer, skipping stressor\n",
+			args->name, zram_size);
+		stress_zram_hot_remove(id);
+		return EXIT_NO_RESOURCE;
+	}
+	rbuf = (uint8_t *)mmap(NULL, zram_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (rbuf == MAP_FAILED) {
+		pr_inf_skip("%s: cannot mmap %zu byte read buffer, skipping stressor\n",
+			args->name, zram_size);
+		(void)munmap((void *)wbuf, zram_size);
+		stress_zram_hot_remove(id);
+		return EXIT_NO_RESOURCE;
+	}
+
+	stress_set_proc_state(args->name, STRESS_STATE_RUN);
+
+	do {
+		bool measured = false;
+
+		for (i = 0; keep_stressing(args) && (i < n_pts); i++) {
+			int ret;
+
+			if (pts[i].unsupported)
+				continue;
+			ret = stress_zram_measure(args, id, &pts[i], wbuf, rbuf, zram_size);
+			if (ret == -1) {
+				pts[i].unsupported = true;
+				continue;
+			} else if (ret < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			measured = true;
+			inc_counter(args);
+		}
+		if (!measured && keep_stressing(args)) {
+			pr_inf_skip("%s: none of the zram compressors can be used, "
+				"skipping stressor\n", args->name);
+			rc = EXIT_NO_RESOURCE;
+			goto done;
+		}
+	} while (keep_stressing(args));
+done:
+	stress_set_proc_state(args->name, STRESS_STATE_DEINIT);
+
+	if ((rc == EXIT_SUCCESS) && (args->instance == 0))
+		stress_zram_report(args, pts, n_pts, zram_size);
+
+	(void)munmap((void *)rbuf, zram_size);
+	(void)munmap((void *)wbuf, zram_size);
+	stress_zram_hot_remove(id);
+	return rc;
+}
+
+stressor_info_t stress_zram_info = {
+	.stressor = stress_zram,
+	.supported = stress_zram_supported,
+	.class = CLASS_CPU | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#else
+stressor_info_t stress_zram_info = {
+	.stressor = stress_not_implemented,
+	.supported = stress_zram_supported,
+	.class = CLASS_CPU | CLASS_MEMORY | CLASS_OS,
+	.opt_set_funcs = opt_set_funcs,
+	.help = help
+};
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2013-2021 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include <stdlib.h>
+#include <openssl/evp.h>
+
+int main(void)
+{
+	EVP_CIPHER_CTX *ctx;
+	EVP_MD_CTX *md;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx)
+		return -1;
+	if (!EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL))
+		return -1;
+	if (!EVP_EncryptInit_ex(ctx, EVP_chacha20(), NULL, NULL, NULL))
+		return -1;
+	EVP_CIPHER_CTX_free(ctx);
+
+	md = EVP_MD_CTX_new();
+	if (!md)
+		return -1;
+	if (!EVP_DigestInit_ex(md, EVP_sha256(), NULL))
+		return -1;
+	EVP_MD_CTX_free(md);
+
+	return 0;
+}